@@ -17,6 +17,7 @@
 // #define LOG_NDEBUG 0
 
 #define LOG_TAG "Camera2-Metadata"
+#include <cutils/atomic.h>
 #include <utils/Log.h>
 #include <utils/Errors.h>
 
@@ -32,22 +33,22 @@ typedef Parcel::WritableBlob WritableBlob;
 typedef Parcel::ReadableBlob ReadableBlob;
 
 CameraMetadata::CameraMetadata() :
-        mBuffer(NULL), mLocked(false) {
+        mBuffer(NULL), mLocked(false), mIndexReady(0) {
 }
 
 CameraMetadata::CameraMetadata(size_t entryCapacity, size_t dataCapacity) :
-        mLocked(false)
+        mLocked(false), mIndexReady(0)
 {
     mBuffer = allocate_camera_metadata(entryCapacity, dataCapacity);
 }
 
 CameraMetadata::CameraMetadata(const CameraMetadata &other) :
-        mLocked(false) {
+        mLocked(false), mIndexReady(0) {
     mBuffer = clone_camera_metadata(other.mBuffer);
 }
 
 CameraMetadata::CameraMetadata(camera_metadata_t *buffer) :
-        mBuffer(NULL), mLocked(false) {
+        mBuffer(NULL), mLocked(false), mIndexReady(0) {
     acquire(buffer);
 }
 
@@ -98,6 +99,7 @@ camera_metadata_t* CameraMetadata::release() {
         ALOGE("%s: CameraMetadata is locked", __FUNCTION__);
         return NULL;
     }
+    invalidateIndex();
     camera_metadata_t *released = mBuffer;
     mBuffer = NULL;
     return released;
@@ -108,6 +110,7 @@ void CameraMetadata::clear() {
         ALOGE("%s: CameraMetadata is locked", __FUNCTION__);
         return;
     }
+    invalidateIndex();
     if (mBuffer) {
         free_camera_metadata(mBuffer);
         mBuffer = NULL;
@@ -148,6 +151,8 @@ status_t CameraMetadata::append(const camera_metadata_t* other) {
     size_t extraData = get_camera_metadata_data_count(other);
     resizeIfNeeded(extraEntries, extraData);
 
+    // Appending may add entries with tags that are already present
+    invalidateIndex();
     return append_camera_metadata(mBuffer, other);
 }
 
@@ -165,6 +170,7 @@ status_t CameraMetadata::sort() {
         ALOGE("%s: CameraMetadata is locked", __FUNCTION__);
         return INVALID_OPERATION;
     }
+    invalidateIndex();
     return sort_camera_metadata(mBuffer);
 }
 
@@ -307,10 +313,13 @@ status_t CameraMetadata::updateImpl(uint32_t tag, const void *data,
 
     if (res == OK) {
         camera_metadata_entry_t entry;
-        res = find_camera_metadata_entry(mBuffer, tag, &entry);
+        res = findEntry(tag, &entry);
         if (res == NAME_NOT_FOUND) {
             res = add_camera_metadata_entry(mBuffer,
                     tag, data, data_count);
+            if (res == OK) {
+                addToIndex(tag, get_camera_metadata_entry_count(mBuffer) - 1);
+            }
         } else if (res == OK) {
             res = update_camera_metadata_entry(mBuffer,
                     entry.index, data, data_count, NULL);
@@ -336,7 +345,7 @@ status_t CameraMetadata::updateImpl(uint32_t tag, const void *data,
 
 bool CameraMetadata::exists(uint32_t tag) const {
     camera_metadata_ro_entry entry;
-    return find_camera_metadata_ro_entry(mBuffer, tag, &entry) == 0;
+    return findEntry(tag, &entry) == 0;
 }
 
 camera_metadata_entry_t CameraMetadata::find(uint32_t tag) {
@@ -347,7 +356,7 @@ camera_metadata_entry_t CameraMetadata::find(uint32_t tag) {
         entry.count = 0;
         return entry;
     }
-    res = find_camera_metadata_entry(mBuffer, tag, &entry);
+    res = findEntry(tag, &entry);
     if (CC_UNLIKELY( res != OK )) {
         entry.count = 0;
         entry.data.u8 = NULL;
@@ -358,7 +367,7 @@ camera_metadata_entry_t CameraMetadata::find(uint32_t tag) {
 camera_metadata_ro_entry_t CameraMetadata::find(uint32_t tag) const {
     status_t res;
     camera_metadata_ro_entry entry;
-    res = find_camera_metadata_ro_entry(mBuffer, tag, &entry);
+    res = findEntry(tag, &entry);
     if (CC_UNLIKELY( res != OK )) {
         entry.count = 0;
         entry.data.u8 = NULL;
@@ -373,7 +382,7 @@ status_t CameraMetadata::erase(uint32_t tag) {
         ALOGE("%s: CameraMetadata is locked", __FUNCTION__);
         return INVALID_OPERATION;
     }
-    res = find_camera_metadata_entry(mBuffer, tag, &entry);
+    res = findEntry(tag, &entry);
     if (res == NAME_NOT_FOUND) {
         return OK;
     } else if (res != OK) {
@@ -383,6 +392,7 @@ status_t CameraMetadata::erase(uint32_t tag) {
                 get_camera_metadata_tag_name(tag), tag, strerror(-res), res);
         return res;
     }
+    invalidateIndex();
     res = delete_camera_metadata_entry(mBuffer, entry.index);
     if (res != OK) {
         ALOGE("%s: Error deleting entry %s.%s (%x): %s %d",
@@ -393,6 +403,121 @@ status_t CameraMetadata::erase(uint32_t tag) {
     return res;
 }
 
+static inline uint32_t hashTag(uint32_t tag) {
+    uint32_t hash = tag * 0x9E3779B1u;
+    return hash ^ (hash >> 16);
+}
+
+ssize_t CameraMetadata::lookupIndex(uint32_t tag) const {
+    if (android_atomic_acquire_load(&mIndexReady) == 0) {
+        if (mBuffer == NULL ||
+                get_camera_metadata_entry_count(mBuffer) < kIndexMinEntries) {
+            return INVALID_OPERATION;
+        }
+        buildIndex();
+    }
+
+    size_t mask = mIndex.size() - 1;
+    for (size_t i = hashTag(tag) & mask; ; i = (i + 1) & mask) {
+        const IndexSlot &slot = mIndex[i];
+        if (slot.entry == kIndexEmptySlot) {
+            return NAME_NOT_FOUND;
+        }
+        if (slot.tag == tag) {
+            return slot.entry;
+        }
+    }
+}
+
+void CameraMetadata::buildIndex() const {
+    Mutex::Autolock l(mIndexLock);
+    if (mIndexReady) {
+        return;
+    }
+
+    // Keep the table at most half full
+    size_t count = get_camera_metadata_entry_count(mBuffer);
+    size_t size = 1;
+    while (size < count * 2) {
+        size <<= 1;
+    }
+
+    IndexSlot empty = { 0, kIndexEmptySlot };
+    mIndex.clear();
+    mIndex.insertAt(empty, 0, size);
+
+    size_t mask = size - 1;
+    for (size_t e = 0; e < count; e++) {
+        camera_metadata_ro_entry_t entry;
+        if (get_camera_metadata_ro_entry(mBuffer, e, &entry) != OK) {
+            continue;
+        }
+        for (size_t i = hashTag(entry.tag) & mask; ; i = (i + 1) & mask) {
+            IndexSlot &slot = mIndex.editItemAt(i);
+            if (slot.entry == kIndexEmptySlot) {
+                slot.tag = entry.tag;
+                slot.entry = e;
+                break;
+            }
+            if (slot.tag == entry.tag) {
+                // Duplicates resolve to the first entry, like a linear search
+                break;
+            }
+        }
+    }
+
+    android_atomic_release_store(1, &mIndexReady);
+}
+
+void CameraMetadata::addToIndex(uint32_t tag, size_t entryIndex) {
+    if (mIndexReady == 0) {
+        return;
+    }
+    if ((entryIndex + 1) * 2 > mIndex.size()) {
+        // Rebuild a larger table on the next lookup
+        invalidateIndex();
+        return;
+    }
+
+    size_t mask = mIndex.size() - 1;
+    for (size_t i = hashTag(tag) & mask; ; i = (i + 1) & mask) {
+        IndexSlot &slot = mIndex.editItemAt(i);
+        if (slot.entry == kIndexEmptySlot) {
+            slot.tag = tag;
+            slot.entry = entryIndex;
+            return;
+        }
+    }
+}
+
+void CameraMetadata::invalidateIndex() {
+    // Only called from non-const methods, which require exclusive access
+    if (mIndexReady) {
+        mIndexReady = 0;
+        mIndex.clear();
+    }
+}
+
+status_t CameraMetadata::findEntry(uint32_t tag, camera_metadata_entry_t *entry) {
+    ssize_t index = lookupIndex(tag);
+    if (index == INVALID_OPERATION) {
+        return find_camera_metadata_entry(mBuffer, tag, entry);
+    } else if (index < 0) {
+        return NAME_NOT_FOUND;
+    }
+    return get_camera_metadata_entry(mBuffer, index, entry);
+}
+
+status_t CameraMetadata::findEntry(uint32_t tag, camera_metadata_ro_entry_t *entry) const {
+    ssize_t index = lookupIndex(tag);
+    if (index == INVALID_OPERATION) {
+        return find_camera_metadata_ro_entry(mBuffer, tag, entry);
+    } else if (index < 0) {
+        return NAME_NOT_FOUND;
+    }
+    return get_camera_metadata_ro_entry(mBuffer, index, entry);
+}
+
 void CameraMetadata::dump(int fd, int verbosity, int indentation) const {
     dump_indented_camera_metadata(mBuffer, fd, verbosity, indentation);
 }
@@ -674,6 +799,9 @@ void CameraMetadata::swap(CameraMetadata& other) {
         return;
     }
 
+    invalidateIndex();
+    other.invalidateIndex();
+
     camera_metadata* thisBuf = mBuffer;
     camera_metadata* otherBuf = other.mBuffer;
 
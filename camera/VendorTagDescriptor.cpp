@@ -281,11 +281,11 @@ const char* VendorTagDescriptor::getTagName(uint32_t tag) const {
 }
 
 int VendorTagDescriptor::getTagType(uint32_t tag) const {
-    ssize_t index = mTagToNameMap.indexOfKey(tag);
+    ssize_t index = mTagToTypeMap.indexOfKey(tag);
     if (index < 0) {
         return VENDOR_TAG_TYPE_ERR;
     }
-    return mTagToTypeMap.valueFor(tag);
+    return mTagToTypeMap.valueAt(index);
 }
 
 status_t VendorTagDescriptor::writeToParcel(Parcel* parcel) const {
@@ -299,14 +299,16 @@ status_t VendorTagDescriptor::writeToParcel(Parcel* parcel) const {
         return res;
     }
 
+    // The tag maps are all keyed by the same set of tags, so index i refers to
+    // the same tag in each of them.
     size_t size = mTagToNameMap.size();
     uint32_t tag, sectionIndex;
     int32_t tagType;
     for (size_t i = 0; i < size; ++i) {
         tag = mTagToNameMap.keyAt(i);
-        String8 tagName = mTagToNameMap[i];
-        sectionIndex = mTagToSectionMap.valueFor(tag);
-        tagType = mTagToTypeMap.valueFor(tag);
+        const String8& tagName = mTagToNameMap.valueAt(i);
+        sectionIndex = mTagToSectionMap.valueAt(i);
+        tagType = mTagToTypeMap.valueAt(i);
         if ((res = parcel->writeInt32(tag)) != OK) break;
         if ((res = parcel->writeInt32(tagType)) != OK) break;
         if ((res = parcel->writeString8(tagName)) != OK) break;
@@ -328,7 +330,8 @@ SortedVector<String8> VendorTagDescriptor::getAllSectionNames() const {
     return mSections;
 }
 
-status_t VendorTagDescriptor::lookupTag(String8 name, String8 section, /*out*/uint32_t* tag) const {
+status_t VendorTagDescriptor::lookupTag(const String8& name, const String8& section,
+        /*out*/uint32_t* tag) const {
     ssize_t index = mReverseMapping.indexOfKey(section);
     if (index < 0) {
         ALOGE("%s: Section '%s' does not exist.", __FUNCTION__, section.string());
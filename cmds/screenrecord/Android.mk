@@ -20,6 +20,7 @@ LOCAL_SRC_FILES := \
 	screenrecord.cpp \
 	EglWindow.cpp \
 	FrameOutput.cpp \
+	MuxerWriter.cpp \
 	TextRenderer.cpp \
 	Overlay.cpp \
 	Program.cpp
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "ScreenRecord"
+//#define LOG_NDEBUG 0
+#include <utils/Log.h>
+
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+#include <utils/Trace.h>
+
+#include <string.h>
+
+#include "MuxerWriter.h"
+
+using namespace android;
+
+status_t MuxerWriter::start() {
+    return run("muxerwriter");
+}
+
+status_t MuxerWriter::queueSample(const sp<ABuffer>& buffer, size_t size,
+        int64_t ptsUsec, uint32_t flags) {
+    // The encoder wants its buffer back right away, so take a copy.
+    Sample sample;
+    sample.buffer = new ABuffer(size);
+    memcpy(sample.buffer->data(), buffer->data(), size);
+    sample.ptsUsec = ptsUsec;
+    sample.flags = flags;
+
+    Mutex::Autolock _l(mMutex);
+
+    while (mQueuedBytes > kMaxQueuedBytes && mWriteResult == NO_ERROR) {
+        ALOGV("Muxer writes falling behind, waiting");
+        mSampleWrittenCond.wait(mMutex);
+    }
+    if (mWriteResult != NO_ERROR) {
+        return mWriteResult;
+    }
+
+    mQueue.push_back(sample);
+    mQueuedBytes += size;
+    mSampleQueuedCond.signal();
+    return NO_ERROR;
+}
+
+status_t MuxerWriter::stop() {
+    {
+        Mutex::Autolock _l(mMutex);
+        mStopping = true;
+        mSampleQueuedCond.signal();
+    }
+
+    join();
+
+    Mutex::Autolock _l(mMutex);
+    return mWriteResult;
+}
+
+bool MuxerWriter::threadLoop() {
+    Sample sample;
+    {
+        Mutex::Autolock _l(mMutex);
+        while (mQueue.empty() && !mStopping) {
+            mSampleQueuedCond.wait(mMutex);
+        }
+        if (mQueue.empty()) {
+            return false;       // stopping, and everything is written
+        }
+        sample = *mQueue.begin();
+    }
+
+    // The MediaMuxer docs are unclear, but it appears that we need to pass
+    // either the full set of BufferInfo flags, or
+    // (flags & BUFFER_FLAG_SYNCFRAME).
+    status_t err;
+    { // scope
+        ATRACE_NAME("write sample");
+        err = mMuxer->writeSampleData(sample.buffer, mTrackIdx,
+                sample.ptsUsec, sample.flags);
+    }
+
+    Mutex::Autolock _l(mMutex);
+    mQueue.erase(mQueue.begin());
+    mQueuedBytes -= sample.buffer->size();
+    if (err != NO_ERROR) {
+        ALOGE("Failed writing data to muxer (err=%d)", err);
+        mWriteResult = err;
+        mQueue.clear();
+        mQueuedBytes = 0;
+    }
+    mSampleWrittenCond.signal();
+    return err == NO_ERROR;
+}
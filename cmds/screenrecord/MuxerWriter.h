@@ -0,0 +1,98 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SCREENRECORD_MUXERWRITER_H
+#define SCREENRECORD_MUXERWRITER_H
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/MediaMuxer.h>
+#include <utils/Condition.h>
+#include <utils/List.h>
+#include <utils/Mutex.h>
+#include <utils/Thread.h>
+
+namespace android {
+
+/*
+ * Writes encoded samples to a MediaMuxer on a dedicated thread, so that a
+ * slow write doesn't keep the encoder's output buffers from being released.
+ *
+ * queueSample() and stop() are called from the encoder loop.
+ */
+class MuxerWriter : public Thread {
+public:
+    MuxerWriter(const sp<MediaMuxer>& muxer, size_t trackIdx) : Thread(false),
+        mMuxer(muxer),
+        mTrackIdx(trackIdx),
+        mQueuedBytes(0),
+        mStopping(false),
+        mWriteResult(NO_ERROR)
+        {}
+
+    // Starts the writer thread.  The muxer must already be started.
+    status_t start();
+
+    // Copies the first "size" bytes of buffer and queues them for writing.
+    // Blocks if more than kMaxQueuedBytes are waiting to be written.
+    //
+    // Returns the error from an earlier write, if one failed.
+    status_t queueSample(const sp<ABuffer>& buffer, size_t size,
+            int64_t ptsUsec, uint32_t flags);
+
+    // Writes out all queued samples, then stops the thread.  Returns the
+    // first write error, if any.
+    status_t stop();
+
+private:
+    MuxerWriter(const MuxerWriter&);
+    MuxerWriter& operator=(const MuxerWriter&);
+
+    // Destruction via RefBase.
+    virtual ~MuxerWriter() {}
+
+    // (overrides Thread method)
+    virtual bool threadLoop();
+
+    // Enough for a few seconds of high bit rate video.
+    static const size_t kMaxQueuedBytes = 32 * 1024 * 1024;
+
+    struct Sample {
+        sp<ABuffer> buffer;
+        int64_t ptsUsec;
+        uint32_t flags;
+    };
+
+    sp<MediaMuxer> mMuxer;
+    size_t mTrackIdx;
+
+    // Guards all fields below.
+    Mutex mMutex;
+
+    // Signaled when a sample is queued or we're asked to stop.
+    Condition mSampleQueuedCond;
+
+    // Signaled when a sample has been written.
+    Condition mSampleWrittenCond;
+
+    List<Sample> mQueue;
+    size_t mQueuedBytes;
+    bool mStopping;
+    status_t mWriteResult;
+};
+
+}; // namespace android
+
+#endif /*SCREENRECORD_MUXERWRITER_H*/
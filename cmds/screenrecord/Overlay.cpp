@@ -115,11 +115,19 @@ bool Overlay::threadLoop() {
     mStartCond.broadcast();
 
     while (mState == RUNNING) {
-        mEventCond.wait(mMutex);
-        if (mFrameAvailable) {
-            ALOGV("Awake, frame available");
-            processFrame_l();
-            mFrameAvailable = false;
+        if (mFramesAvailable == 0) {
+            mEventCond.wait(mMutex);
+        }
+        if (mFramesAvailable > 0) {
+            ALOGV("Awake, %d frame(s) available", mFramesAvailable);
+            mFramesAvailable--;
+
+            // Don't block onFrameAvailable() while we draw and swap, or
+            // the virtual display stalls behind the encoder.  Frames that
+            // arrive meanwhile are counted and handled in turn.
+            mMutex.unlock();
+            processFrame();
+            mMutex.lock();
         } else {
             ALOGV("Awake, frame not available");
         }
@@ -196,7 +204,7 @@ void Overlay::release_l() {
     mEglWindow.release();
 }
 
-void Overlay::processFrame_l() {
+void Overlay::processFrame() {
     float texMatrix[16];
 
     mGlConsumer->updateTexImage();
@@ -235,7 +243,7 @@ void Overlay::processFrame_l() {
     }
 
     char textBuf[64];
-    getTimeString_l(monotonicNsec, textBuf, sizeof(textBuf));
+    getTimeString(monotonicNsec, textBuf, sizeof(textBuf));
     String8 timeStr(String8::format("%s f=%" PRId64 " (%zd)",
             textBuf, frameNumber, mTotalDroppedFrames));
     mTextRenderer.drawString(mTexProgram, Program::kIdentity, 0, 0, timeStr);
@@ -254,7 +262,7 @@ void Overlay::processFrame_l() {
     mEglWindow.swapBuffers();
 }
 
-void Overlay::getTimeString_l(nsecs_t monotonicNsec, char* buf, size_t bufLen) {
+void Overlay::getTimeString(nsecs_t monotonicNsec, char* buf, size_t bufLen) {
     //const char* format = "%m-%d %T";    // matches log output
     const char* format = "%T";
     struct tm tm;
@@ -277,7 +285,7 @@ void Overlay::getTimeString_l(nsecs_t monotonicNsec, char* buf, size_t bufLen) {
 void Overlay::onFrameAvailable(const BufferItem& /* item */) {
     ALOGV("Overlay::onFrameAvailable");
     Mutex::Autolock _l(mMutex);
-    mFrameAvailable = true;
+    mFramesAvailable++;
     mEventCond.signal();
 }
 
@@ -40,7 +40,7 @@ public:
     Overlay() : Thread(false),
         mThreadResult(UNKNOWN_ERROR),
         mState(UNINITIALIZED),
-        mFrameAvailable(false),
+        mFramesAvailable(0),
         mExtTextureName(0),
         mStartMonotonicNsecs(0),
         mStartRealtimeNsecs(0),
@@ -92,13 +92,16 @@ private:
     // Release EGL display, context, surface.
     void eglRelease_l();
 
-    // Process a frame received from the virtual display.
-    void processFrame_l();
+    // Process a frame received from the virtual display.  Called on the
+    // overlay thread without mMutex held, so the virtual display can keep
+    // queueing frames while we render.
+    void processFrame();
 
     // Convert a monotonic time stamp into a string with the current time.
-    void getTimeString_l(nsecs_t monotonicNsec, char* buf, size_t bufLen);
+    void getTimeString(nsecs_t monotonicNsec, char* buf, size_t bufLen);
 
-    // Guards all fields below.
+    // Guards all fields below, except for the EGL/GL state and frame
+    // bookkeeping that only the overlay thread touches once it's running.
     Mutex mMutex;
 
     // Initialization gate.
@@ -115,8 +118,8 @@ private:
     // arrives or it's time to shut down.
     Condition mEventCond;
 
-    // Set by the FrameAvailableListener callback.
-    bool mFrameAvailable;
+    // Incremented by the FrameAvailableListener callback, once per frame.
+    int mFramesAvailable;
 
     // The surface we send our output to, i.e. the video encoder's input
     // surface.
@@ -55,6 +55,7 @@
 #include "screenrecord.h"
 #include "Overlay.h"
 #include "FrameOutput.h"
+#include "MuxerWriter.h"
 
 using namespace android;
 
@@ -319,7 +320,7 @@ static status_t runEncoder(const sp<MediaCodec>& encoder,
         const sp<IBinder>& virtualDpy, uint8_t orientation) {
     static int kTimeout = 250000;   // be responsive on signal
     status_t err;
-    ssize_t trackIdx = -1;
+    sp<MuxerWriter> muxerWriter;
     uint32_t debugNumFrames = 0;
     int64_t startWhenNsec = systemTime(CLOCK_MONOTONIC);
     int64_t endWhenNsec = startWhenNsec + seconds_to_nanoseconds(gTimeLimitSec);
@@ -405,19 +406,16 @@ static status_t runEncoder(const sp<MediaCodec>& encoder,
                         fflush(rawFp);
                     }
                 } else {
-                    // The MediaMuxer docs are unclear, but it appears that we
-                    // need to pass either the full set of BufferInfo flags, or
-                    // (flags & BUFFER_FLAG_SYNCFRAME).
-                    //
-                    // If this blocks for too long we could drop frames.  We may
-                    // want to queue these up and do them on a different thread.
-                    ATRACE_NAME("write sample");
-                    assert(trackIdx != -1);
-                    err = muxer->writeSampleData(buffers[bufIndex], trackIdx,
+                    // Hand the sample to the writer thread, so a slow write
+                    // doesn't hold up the encoder and cause dropped frames.
+                    ATRACE_NAME("queue sample");
+                    assert(muxerWriter != NULL);
+                    err = muxerWriter->queueSample(buffers[bufIndex], size,
                             ptsUsec, flags);
                     if (err != NO_ERROR) {
                         fprintf(stderr,
                             "Failed writing data to muxer (err=%d)\n", err);
+                        muxerWriter->stop();
                         return err;
                     }
                 }
@@ -427,6 +425,7 @@ static status_t runEncoder(const sp<MediaCodec>& encoder,
             if (err != NO_ERROR) {
                 fprintf(stderr, "Unable to release output buffer (err=%d)\n",
                         err);
+                if (muxerWriter != NULL) muxerWriter->stop();
                 return err;
             }
             if ((flags & MediaCodec::BUFFER_FLAG_EOS) != 0) {
@@ -445,13 +444,21 @@ static status_t runEncoder(const sp<MediaCodec>& encoder,
                 sp<AMessage> newFormat;
                 encoder->getOutputFormat(&newFormat);
                 if (muxer != NULL) {
-                    trackIdx = muxer->addTrack(newFormat);
+                    ssize_t trackIdx = muxer->addTrack(newFormat);
                     ALOGV("Starting muxer");
                     err = muxer->start();
                     if (err != NO_ERROR) {
                         fprintf(stderr, "Unable to start muxer (err=%d)\n", err);
                         return err;
                     }
+                    muxerWriter = new MuxerWriter(muxer, trackIdx);
+                    err = muxerWriter->start();
+                    if (err != NO_ERROR) {
+                        fprintf(stderr,
+                                "Unable to start muxer writer (err=%d)\n", err);
+                        muxerWriter.clear();
+                        return err;
+                    }
                 }
             }
             break;
@@ -462,20 +469,30 @@ static status_t runEncoder(const sp<MediaCodec>& encoder,
             if (err != NO_ERROR) {
                 fprintf(stderr,
                         "Unable to get new output buffers (err=%d)\n", err);
+                if (muxerWriter != NULL) muxerWriter->stop();
                 return err;
             }
             break;
         case INVALID_OPERATION:
             ALOGW("dequeueOutputBuffer returned INVALID_OPERATION");
+            if (muxerWriter != NULL) muxerWriter->stop();
             return err;
         default:
             fprintf(stderr,
                     "Got weird result %d from dequeueOutputBuffer\n", err);
+            if (muxerWriter != NULL) muxerWriter->stop();
             return err;
         }
     }
 
     ALOGV("Encoder stopping (req=%d)", gStopRequested);
+    if (muxerWriter != NULL) {
+        err = muxerWriter->stop();
+        if (err != NO_ERROR) {
+            fprintf(stderr, "Failed writing data to muxer (err=%d)\n", err);
+            return err;
+        }
+    }
     if (gVerbose) {
         printf("Encoder stopping; recorded %u frames in %" PRId64 " seconds\n",
                 debugNumFrames, nanoseconds_to_seconds(
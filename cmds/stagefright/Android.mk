@@ -176,6 +176,158 @@ include $(BUILD_EXECUTABLE)
 
 include $(CLEAR_VARS)
 
+LOCAL_SRC_FILES:=               \
+        codecbench.cpp          \
+
+LOCAL_SHARED_LIBRARIES := \
+	libstagefright liblog libutils libbinder libstagefright_foundation \
+        libmedia libgui libcutils libui
+
+LOCAL_C_INCLUDES:= \
+	frameworks/av/media/libstagefright \
+	$(TOP)/frameworks/native/include/media/openmax
+
+LOCAL_CFLAGS += -Wno-multichar -Werror -Wall
+LOCAL_CLANG := true
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE:= codecbench
+
+include $(BUILD_EXECUTABLE)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=               \
+        mediabench.cpp          \
+
+LOCAL_SHARED_LIBRARIES := \
+	libstagefright liblog libutils libbinder libstagefright_foundation \
+        libmedia libgui libcutils libui
+
+LOCAL_C_INCLUDES:= \
+	frameworks/av/media/libstagefright \
+	$(TOP)/frameworks/native/include/media/openmax
+
+LOCAL_CFLAGS += -Wno-multichar -Werror -Wall
+LOCAL_CLANG := true
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE:= mediabench
+
+include $(BUILD_EXECUTABLE)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=               \
+        avcencbench.cpp         \
+
+LOCAL_STATIC_LIBRARIES := \
+	libstagefright_avcenc
+
+LOCAL_SHARED_LIBRARIES := \
+	libstagefright_avc_common libstagefright_foundation libutils liblog
+
+LOCAL_C_INCLUDES:= \
+	frameworks/av/media/libstagefright/codecs/avc/enc/src \
+	frameworks/av/media/libstagefright/codecs/avc/common/include
+
+LOCAL_CFLAGS += -Wno-multichar -Werror -Wall \
+	-DOSCL_IMPORT_REF= -D"OSCL_UNUSED_ARG(x)=(void)(x)" -DOSCL_EXPORT_REF=
+LOCAL_CLANG := true
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE:= avcencbench
+
+include $(BUILD_EXECUTABLE)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=               \
+        speechbench.cpp         \
+
+LOCAL_SHARED_LIBRARIES := \
+	libstagefright_omx libstagefright_foundation libutils liblog
+
+LOCAL_C_INCLUDES:= \
+	frameworks/av/media/libstagefright/omx \
+	$(TOP)/frameworks/native/include/media/hardware \
+	$(TOP)/frameworks/native/include/media/openmax
+
+LOCAL_CFLAGS += -Wno-multichar -Werror -Wall
+LOCAL_CLANG := true
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE:= speechbench
+
+include $(BUILD_EXECUTABLE)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=               \
+        aacencbench.cpp         \
+
+LOCAL_STATIC_LIBRARIES := \
+	libstagefright_aacenc libFraunhoferAAC
+
+LOCAL_SHARED_LIBRARIES := \
+	libstagefright_enc_common libstagefright_foundation libutils liblog
+
+LOCAL_C_INCLUDES:= \
+	frameworks/av/media/libstagefright/codecs/common/include \
+	external/aac/libAACdec/include \
+	external/aac/libAACenc/include \
+	external/aac/libFDK/include \
+	external/aac/libMpegTPDec/include \
+	external/aac/libMpegTPEnc/include \
+	external/aac/libSYS/include
+
+LOCAL_CFLAGS += -Wno-multichar -Werror -Wall
+LOCAL_CLANG := true
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE:= aacencbench
+
+include $(BUILD_EXECUTABLE)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=               \
+        colorconvbench.cpp      \
+
+LOCAL_SHARED_LIBRARIES := \
+	libstagefright libstagefright_foundation libutils liblog
+
+LOCAL_C_INCLUDES:= \
+	$(TOP)/frameworks/native/include/media/openmax
+
+LOCAL_CFLAGS += -Wno-multichar -Werror -Wall
+LOCAL_CLANG := true
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE:= colorconvbench
+
+include $(BUILD_EXECUTABLE)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
 LOCAL_SRC_FILES:= \
 	filters/argbtorgba.rs \
 	filters/nightvision.rs \
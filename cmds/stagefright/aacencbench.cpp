@@ -0,0 +1,477 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "aacencbench"
+#include <utils/Log.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <utils/Timers.h>
+#include <utils/misc.h>
+#include <utils/Vector.h>
+
+#include "voAAC.h"
+#include "cmnMemory.h"
+
+#include "aacenc_lib.h"
+#include "aacdecoder_lib.h"
+
+// Encodes the same PCM with the VisualOn and the Fraunhofer AAC-LC encoders at
+// a list of bitrates, and reports the encoding speed, the size of the output
+// and the SNR of the output decoded with the Fraunhofer decoder. The SNR is only
+// a rough stand-in for the perceived quality but is enough to line up the
+// bitrates at which both encoders give a similar result. The input is raw 16
+// bit PCM, or a synthetic mix of tones and noise.
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-i file] raw 16 bit pcm input (default synthetic)\n"
+                    "\t\t[-r rate] sample rate (default 44100)\n"
+                    "\t\t[-c channels] 1 or 2 (default 2)\n"
+                    "\t\t[-d seconds] length of the synthetic input (default 30)\n"
+                    "\t\t[-b bitrate] bitrate in bps, may be repeated"
+                    " (default 64000 to 192000)\n",
+                    me);
+    exit(1);
+}
+
+namespace android {
+
+static const size_t kFrameSamples = 1024;   // per channel, AAC-LC
+static const size_t kMaxFrameBytes = 6144 / 8 * 2;
+static const size_t kMaxDelay = 4096;       // encoder and decoder delay, in samples
+
+struct Result {
+    size_t mBytes;
+    double mCpuS;
+    double mSnrDb;
+};
+
+// Called with each encoded access unit.
+struct Sink {
+    Sink() : mBytes(0), mDecoder(NULL) {}
+
+    ~Sink() {
+        if (mDecoder != NULL) {
+            aacDecoder_Close(mDecoder);
+        }
+    }
+
+    status_t init(const uint8_t *config, size_t size) {
+        mDecoder = aacDecoder_Open(TT_MP4_RAW, 1 /* num layers */);
+        if (mDecoder == NULL) {
+            return UNKNOWN_ERROR;
+        }
+        UCHAR *buffer[] = { (UCHAR *)config };
+        UINT length[] = { (UINT)size };
+        return aacDecoder_ConfigRaw(mDecoder, buffer, length) == AAC_DEC_OK ? OK : UNKNOWN_ERROR;
+    }
+
+    status_t write(const uint8_t *data, size_t size) {
+        mBytes += size;
+
+        UCHAR *buffer[] = { (UCHAR *)data };
+        UINT length[] = { (UINT)size };
+        UINT valid[] = { (UINT)size };
+        if (aacDecoder_Fill(mDecoder, buffer, length, valid) != AAC_DEC_OK) {
+            return UNKNOWN_ERROR;
+        }
+        INT_PCM pcm[kFrameSamples * 2];
+        if (aacDecoder_DecodeFrame(mDecoder, pcm, NELEM(pcm), 0 /* flags */) != AAC_DEC_OK) {
+            return UNKNOWN_ERROR;
+        }
+        CStreamInfo *info = aacDecoder_GetStreamInfo(mDecoder);
+        mDecoded.appendArray(pcm, info->frameSize * info->numChannels);
+        return OK;
+    }
+
+    size_t mBytes;
+    Vector<int16_t> mDecoded;
+
+private:
+    HANDLE_AACDECODER mDecoder;
+};
+
+static status_t encodeVisualOn(
+        const Vector<int16_t> &pcm, int32_t sampleRate, int32_t channels, int32_t bitRate,
+        Sink *sink, double *cpuS) {
+    VO_AUDIO_CODECAPI api;
+    if (voGetAACEncAPI(&api) != VO_ERR_NONE) {
+        return UNKNOWN_ERROR;
+    }
+    VO_MEM_OPERATOR memOperator;
+    memOperator.Alloc = cmnMemAlloc;
+    memOperator.Copy = cmnMemCopy;
+    memOperator.Free = cmnMemFree;
+    memOperator.Set = cmnMemSet;
+    memOperator.Check = cmnMemCheck;
+    VO_CODEC_INIT_USERDATA userData;
+    memset(&userData, 0, sizeof(userData));
+    userData.memflag = VO_IMF_USERMEMOPERATOR;
+    userData.memData = (VO_PTR)&memOperator;
+
+    VO_HANDLE handle;
+    if (api.Init(&handle, VO_AUDIO_CodingAAC, &userData) != VO_ERR_NONE) {
+        return UNKNOWN_ERROR;
+    }
+
+    AACENC_PARAM params;
+    memset(&params, 0, sizeof(params));
+    params.sampleRate = sampleRate;
+    params.bitRate = bitRate;
+    params.nChannels = channels;
+    params.adtsUsed = 0;
+    status_t err = api.SetParam(handle, VO_PID_AAC_ENCPARAM, &params) == VO_ERR_NONE
+            ? OK : UNKNOWN_ERROR;
+
+    // AAC-LC, see SoftAACEncoder::setAudioSpecificConfigData()
+    static const int32_t kSampleRates[] = {
+        96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000
+    };
+    int32_t index = 0;
+    while (index < (int32_t)NELEM(kSampleRates) && kSampleRates[index] != sampleRate) {
+        ++index;
+    }
+    uint8_t config[2];
+    config[0] = (0x02 << 3) | (index >> 1);
+    config[1] = ((index & 0x01) << 7) | (channels << 3);
+    if (err == OK) {
+        err = sink->init(config, sizeof(config));
+    }
+
+    size_t frameLength = kFrameSamples * channels;
+    uint8_t out[kMaxFrameBytes];
+    nsecs_t encodeNs = 0;
+    for (size_t i = 0; err == OK && i + frameLength <= pcm.size(); i += frameLength) {
+        nsecs_t startNs = systemTime(SYSTEM_TIME_THREAD);
+
+        VO_CODECBUFFER input;
+        memset(&input, 0, sizeof(input));
+        input.Buffer = (unsigned char *)(pcm.array() + i);
+        input.Length = frameLength * sizeof(int16_t);
+        api.SetInputData(handle, &input);
+
+        VO_CODECBUFFER output;
+        memset(&output, 0, sizeof(output));
+        output.Buffer = out;
+        output.Length = sizeof(out);
+        VO_AUDIO_OUTPUTINFO outputInfo;
+        memset(&outputInfo, 0, sizeof(outputInfo));
+        VO_U32 ret = api.GetOutputData(handle, &output, &outputInfo);
+
+        encodeNs += systemTime(SYSTEM_TIME_THREAD) - startNs;
+
+        if (ret == VO_ERR_NONE) {
+            err = sink->write(out, output.Length);
+        } else if (ret != VO_ERR_INPUT_BUFFER_SMALL) {
+            err = UNKNOWN_ERROR;
+        }
+    }
+
+    api.Uninit(handle);
+    *cpuS = encodeNs / 1E9;
+    return err;
+}
+
+static status_t encodeFraunhofer(
+        const Vector<int16_t> &pcm, int32_t sampleRate, int32_t channels, int32_t bitRate,
+        Sink *sink, double *cpuS) {
+    HANDLE_AACENCODER encoder;
+    if (aacEncOpen(&encoder, 0, 0) != AACENC_OK) {
+        return UNKNOWN_ERROR;
+    }
+
+    status_t err = OK;
+    if (aacEncoder_SetParam(encoder, AACENC_AOT, AOT_AAC_LC) != AACENC_OK
+            || aacEncoder_SetParam(encoder, AACENC_SAMPLERATE, sampleRate) != AACENC_OK
+            || aacEncoder_SetParam(encoder, AACENC_BITRATE, bitRate) != AACENC_OK
+            || aacEncoder_SetParam(encoder, AACENC_CHANNELMODE,
+                    channels == 1 ? MODE_1 : MODE_2) != AACENC_OK
+            || aacEncoder_SetParam(encoder, AACENC_TRANSMUX, TT_MP4_RAW) != AACENC_OK
+            || aacEncEncode(encoder, NULL, NULL, NULL, NULL) != AACENC_OK) {
+        err = UNKNOWN_ERROR;
+    }
+
+    AACENC_InfoStruct encInfo;
+    if (err == OK && aacEncInfo(encoder, &encInfo) != AACENC_OK) {
+        err = UNKNOWN_ERROR;
+    }
+    if (err == OK) {
+        err = sink->init(encInfo.confBuf, encInfo.confSize);
+    }
+
+    size_t frameLength = kFrameSamples * channels;
+    uint8_t out[kMaxFrameBytes];
+    nsecs_t encodeNs = 0;
+    for (size_t i = 0; err == OK && i + frameLength <= pcm.size(); i += frameLength) {
+        nsecs_t startNs = systemTime(SYSTEM_TIME_THREAD);
+
+        void *inBuffer[] = { (void *)(pcm.array() + i) };
+        INT inBufferIds[] = { IN_AUDIO_DATA };
+        INT inBufferSize[] = { (INT)(frameLength * sizeof(int16_t)) };
+        INT inBufferElSize[] = { sizeof(int16_t) };
+        AACENC_BufDesc inBufDesc;
+        inBufDesc.numBufs = 1;
+        inBufDesc.bufs = inBuffer;
+        inBufDesc.bufferIdentifiers = inBufferIds;
+        inBufDesc.bufSizes = inBufferSize;
+        inBufDesc.bufElSizes = inBufferElSize;
+
+        void *outBuffer[] = { out };
+        INT outBufferIds[] = { OUT_BITSTREAM_DATA };
+        INT outBufferSize[] = { sizeof(out) };
+        INT outBufferElSize[] = { sizeof(UCHAR) };
+        AACENC_BufDesc outBufDesc;
+        outBufDesc.numBufs = 1;
+        outBufDesc.bufs = outBuffer;
+        outBufDesc.bufferIdentifiers = outBufferIds;
+        outBufDesc.bufSizes = outBufferSize;
+        outBufDesc.bufElSizes = outBufferElSize;
+
+        AACENC_InArgs inargs;
+        memset(&inargs, 0, sizeof(inargs));
+        inargs.numInSamples = frameLength;
+        AACENC_OutArgs outargs;
+        memset(&outargs, 0, sizeof(outargs));
+        AACENC_ERROR encoderErr = aacEncEncode(encoder, &inBufDesc, &outBufDesc, &inargs, &outargs);
+
+        encodeNs += systemTime(SYSTEM_TIME_THREAD) - startNs;
+
+        if (encoderErr != AACENC_OK) {
+            err = UNKNOWN_ERROR;
+        } else if (outargs.numOutBytes > 0) {
+            err = sink->write(out, outargs.numOutBytes);
+        }
+    }
+
+    aacEncClose(&encoder);
+    *cpuS = encodeNs / 1E9;
+    return err;
+}
+
+// SNR of the decoded output, after lining it up with the input.
+static double snr(const Vector<int16_t> &pcm, const Vector<int16_t> &decoded, int32_t channels) {
+    size_t numSamples = pcm.size() / channels;
+    size_t numDecoded = decoded.size() / channels;
+    if (numDecoded <= kMaxDelay || numSamples <= kMaxDelay) {
+        return 0.;
+    }
+
+    // the delay with the best correlation over the first second, on the first channel
+    size_t window = numSamples - kMaxDelay < 48000 ? numSamples - kMaxDelay : 48000;
+    if (window + kMaxDelay > numDecoded) {
+        window = numDecoded - kMaxDelay;
+    }
+    size_t delay = 0;
+    double best = -1E300;
+    for (size_t d = 0; d < kMaxDelay; ++d) {
+        double corr = 0.;
+        for (size_t i = 0; i < window; ++i) {
+            corr += (double)pcm[i * channels] * decoded[(i + d) * channels];
+        }
+        if (corr > best) {
+            best = corr;
+            delay = d;
+        }
+    }
+
+    double signal = 0., noise = 0.;
+    for (size_t i = 0; i + delay < numDecoded && i < numSamples; ++i) {
+        for (int32_t c = 0; c < channels; ++c) {
+            double x = pcm[i * channels + c];
+            double e = x - decoded[(i + delay) * channels + c];
+            signal += x * x;
+            noise += e * e;
+        }
+    }
+    return noise > 0. ? 10. * log10(signal / noise) : 99.;
+}
+
+// Tones with a slow vibrato, and bursts of noise for the transients.
+static void synthesize(int32_t sampleRate, int32_t channels, size_t seconds, Vector<int16_t> *pcm) {
+    static const double kTones[] = { 220., 659., 1318., 3520., 9000. };
+    size_t numSamples = seconds * sampleRate;
+    pcm->resize(numSamples * channels);
+    srand(1);
+    for (size_t i = 0; i < numSamples; ++i) {
+        double t = (double)i / sampleRate;
+        for (int32_t c = 0; c < channels; ++c) {
+            double x = 0.;
+            for (size_t k = 0; k < NELEM(kTones); ++k) {
+                double f = kTones[k] * (1. + 0.01 * sin(2. * M_PI * (0.5 + c) * t));
+                x += 3000. / (k + 1) * sin(2. * M_PI * f * t + k + c);
+            }
+            if (fmod(t, 1.) < 0.05) {
+                x += 4000. * ((double)rand() / RAND_MAX - 0.5);
+            }
+            pcm->editItemAt(i * channels + c) = (int16_t)x;
+        }
+    }
+}
+
+static void benchmark(
+        const Vector<int16_t> &pcm, int32_t sampleRate, int32_t channels,
+        const Vector<int32_t> &bitRates) {
+    static const char *kEncoders[] = { "visualon", "fraunhofer" };
+    double audioS = (double)pcm.size() / channels / sampleRate;
+
+    // one line per run, for scripts
+    printf("encoder,bitrate,audio_s,cpu_s,x_realtime,bytes,actual_bitrate,snr_db\n");
+
+    Vector<Result> results[NELEM(kEncoders)];
+    for (size_t e = 0; e < NELEM(kEncoders); ++e) {
+        for (size_t i = 0; i < bitRates.size(); ++i) {
+            Sink sink;
+            Result result;
+            status_t err = e == 0
+                    ? encodeVisualOn(pcm, sampleRate, channels, bitRates[i], &sink, &result.mCpuS)
+                    : encodeFraunhofer(pcm, sampleRate, channels, bitRates[i], &sink, &result.mCpuS);
+            if (err != OK) {
+                fprintf(stderr, "%s at %d bps failed\n", kEncoders[e], bitRates[i]);
+                result.mBytes = 0;
+                result.mSnrDb = 0.;
+            } else {
+                result.mBytes = sink.mBytes;
+                result.mSnrDb = snr(pcm, sink.mDecoded, channels);
+                printf("%s,%d,%.1f,%.3f,%.1f,%zu,%.0f,%.2f\n",
+                        kEncoders[e], bitRates[i], audioS, result.mCpuS,
+                        result.mCpuS > 0 ? audioS / result.mCpuS : 0., result.mBytes,
+                        result.mBytes * 8 / audioS, result.mSnrDb);
+                fflush(stdout);
+            }
+            results[e].push(result);
+        }
+    }
+
+    // for each VisualOn bitrate, the lowest Fraunhofer bitrate doing at least as well
+    printf("\nvisualon_bitrate,fraunhofer_bitrate,visualon_cpu_s,fraunhofer_cpu_s\n");
+    for (size_t i = 0; i < bitRates.size(); ++i) {
+        const Result &vo = results[0][i];
+        if (vo.mBytes == 0) {
+            continue;
+        }
+        ssize_t match = -1;
+        for (size_t j = 0; j < bitRates.size(); ++j) {
+            const Result &fdk = results[1][j];
+            if (fdk.mBytes > 0 && fdk.mSnrDb >= vo.mSnrDb
+                    && (match < 0 || bitRates[j] < bitRates[match])) {
+                match = j;
+            }
+        }
+        if (match >= 0) {
+            printf("%d,%d,%.3f,%.3f\n", bitRates[i], bitRates[match], vo.mCpuS,
+                    results[1][match].mCpuS);
+        } else {
+            printf("%d,,%.3f,\n", bitRates[i], vo.mCpuS);
+        }
+    }
+}
+
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+
+    const char *input = NULL;
+    int32_t sampleRate = 44100;
+    int32_t channels = 2;
+    size_t seconds = 30;
+    Vector<int32_t> bitRates;
+
+    int res;
+    while ((res = getopt(argc, argv, "hi:r:c:d:b:")) >= 0) {
+        switch (res) {
+            case 'i':
+            {
+                input = optarg;
+                break;
+            }
+            case 'r':
+            {
+                sampleRate = atoi(optarg);
+                if (sampleRate <= 0) {
+                    usage(me);
+                }
+                break;
+            }
+            case 'c':
+            {
+                channels = atoi(optarg);
+                if (channels != 1 && channels != 2) {
+                    usage(me);
+                }
+                break;
+            }
+            case 'd':
+            {
+                seconds = atoi(optarg);
+                if (seconds == 0) {
+                    usage(me);
+                }
+                break;
+            }
+            case 'b':
+            {
+                int32_t bitRate = atoi(optarg);
+                if (bitRate <= 0) {
+                    usage(me);
+                }
+                bitRates.push(bitRate);
+                break;
+            }
+            case '?':
+            case 'h':
+            default:
+            {
+                usage(me);
+            }
+        }
+    }
+
+    if (bitRates.isEmpty()) {
+        for (int32_t bitRate = 64000; bitRate <= 192000; bitRate += 16000) {
+            bitRates.push(bitRate);
+        }
+    }
+
+    Vector<int16_t> pcm;
+    if (input != NULL) {
+        FILE *file = fopen(input, "rb");
+        if (file == NULL) {
+            fprintf(stderr, "unable to open %s\n", input);
+            return 1;
+        }
+        int16_t buffer[4096];
+        size_t n;
+        while ((n = fread(buffer, sizeof(int16_t), NELEM(buffer), file)) > 0) {
+            pcm.appendArray(buffer, n);
+        }
+        fclose(file);
+    } else {
+        synthesize(sampleRate, channels, seconds, &pcm);
+    }
+
+    benchmark(pcm, sampleRate, channels, bitRates);
+
+    return 0;
+}
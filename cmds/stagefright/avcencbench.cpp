@@ -0,0 +1,390 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "avcencbench"
+#include <utils/Log.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <utils/Vector.h>
+
+#include "avcenc_api.h"
+
+// Measures the speed of the software AVC encoder library at a constant QP,
+// without OMX or MediaCodec in between. Since the QP is fixed, the size and
+// PSNR of the output stay the same from build to build as long as the encoder
+// makes the same decisions, and only the frame rate is expected to change.
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-s WxH] frame size (default 1280x720)\n"
+                    "\t\t[-i file] raw I420 input of that size, looped (default: synthetic)\n"
+                    "\t\t[-q qp] constant QP (default 28)\n"
+                    "\t\t[-n frames] frames to encode (default 300)\n"
+                    "\t\t[-t threads] motion search threads (default 1)\n"
+                    "\t\t[-o file] write the elementary stream to file\n",
+                    me);
+    exit(1);
+}
+
+namespace android {
+
+struct EncoderState {
+    Vector<uint8_t *> mFrames;
+};
+
+static int32_t DpbAlloc(void *userData, unsigned int sizeInMbs, unsigned int numBuffers) {
+    EncoderState *state = (EncoderState *)userData;
+    size_t frameSize = (sizeInMbs << 7) * 3;
+    for (unsigned int i = 0; i < numBuffers; ++i) {
+        uint8_t *frame = (uint8_t *)malloc(frameSize);
+        CHECK(frame != NULL);
+        state->mFrames.push(frame);
+    }
+    return 1;
+}
+
+static int32_t BindFrame(void *userData, int32_t index, uint8_t **yuv) {
+    EncoderState *state = (EncoderState *)userData;
+    CHECK(index >= 0 && index < (int32_t)state->mFrames.size());
+    *yuv = state->mFrames[index];
+    return 1;
+}
+
+static void UnbindFrame(void * /* userData */, int32_t /* index */) {
+}
+
+static void *Malloc(void * /* userData */, int32_t size, int32_t /* attrs */) {
+    void *ptr = malloc(size);
+    if (ptr != NULL) {
+        memset(ptr, 0, size);
+    }
+    return ptr;
+}
+
+static void Free(void * /* userData */, void *ptr) {
+    free(ptr);
+}
+
+// Fills frame with a textured pattern that pans and zooms slowly, so that
+// the motion search has sub-pel motion to find.
+static void synthesizeFrame(uint8_t *frame, int32_t width, int32_t height, int32_t index) {
+    double t = index / 30.0;
+    double dx = 40.0 * sin(t * 0.7);
+    double dy = 25.0 * cos(t * 0.5);
+    double scale = 1.0 + 0.1 * sin(t * 0.3);
+    for (int32_t y = 0; y < height; ++y) {
+        for (int32_t x = 0; x < width; ++x) {
+            double u = (x + dx) * scale;
+            double v = (y + dy) * scale;
+            double luma = 128 + 60 * sin(u * 0.05) * cos(v * 0.04) + 40 * sin((u + v) * 0.13);
+            frame[y * width + x] = (uint8_t)(luma < 0 ? 0 : luma > 255 ? 255 : luma);
+        }
+    }
+    uint8_t *cb = frame + width * height;
+    uint8_t *cr = cb + (width / 2) * (height / 2);
+    for (int32_t y = 0; y < height / 2; ++y) {
+        for (int32_t x = 0; x < width / 2; ++x) {
+            double u = (2 * x + dx) * scale;
+            double v = (2 * y + dy) * scale;
+            cb[y * (width / 2) + x] = (uint8_t)(128 + 30 * sin(u * 0.02));
+            cr[y * (width / 2) + x] = (uint8_t)(128 + 30 * cos(v * 0.03));
+        }
+    }
+}
+
+static double squaredError(const uint8_t *a, const uint8_t *b, int32_t width, int32_t height,
+        int32_t pitch) {
+    double sum = 0;
+    for (int32_t y = 0; y < height; ++y) {
+        for (int32_t x = 0; x < width; ++x) {
+            int32_t d = (int32_t)a[y * width + x] - b[y * pitch + x];
+            sum += d * d;
+        }
+    }
+    return sum;
+}
+
+static int encode(
+        int32_t width, int32_t height, const char *inPath, int32_t qp,
+        int32_t numFrames, int32_t numThreads, const char *outPath) {
+    FILE *in = NULL;
+    if (inPath != NULL) {
+        in = fopen(inPath, "rb");
+        if (in == NULL) {
+            fprintf(stderr, "unable to open %s\n", inPath);
+            return 1;
+        }
+    }
+    FILE *out = NULL;
+    if (outPath != NULL) {
+        out = fopen(outPath, "wb");
+        if (out == NULL) {
+            fprintf(stderr, "unable to create %s\n", outPath);
+            if (in != NULL) {
+                fclose(in);
+            }
+            return 1;
+        }
+    }
+
+    EncoderState state;
+    AVCHandle handle;
+    memset(&handle, 0, sizeof(handle));
+    handle.userData = &state;
+    handle.CBAVC_DPBAlloc = DpbAlloc;
+    handle.CBAVC_FrameBind = BindFrame;
+    handle.CBAVC_FrameUnbind = UnbindFrame;
+    handle.CBAVC_Malloc = Malloc;
+    handle.CBAVC_Free = Free;
+
+    int32_t numMbs = (width / 16) * (height / 16);
+    uint32_t *sliceGroup = (uint32_t *)calloc(numMbs, sizeof(uint32_t));
+    CHECK(sliceGroup != NULL);
+
+    // same tools as SoftAVCEncoder, with the rate control replaced by a fixed QP
+    AVCEncParams params;
+    memset(&params, 0, sizeof(params));
+    params.profile = AVC_BASELINE;
+    params.level = AVC_LEVEL4;
+    params.width = width;
+    params.height = height;
+    params.poc_type = 2;
+    params.log2_max_poc_lsb_minus_4 = 12;
+    params.num_ref_frame = 1;
+    params.num_slice_group = 1;
+    params.slice_group = sliceGroup;
+    params.db_filter = AVC_ON;
+    params.auto_scd = AVC_ON;
+    params.idr_period = 30;
+    params.search_range = 16;
+    params.rate_control = AVC_OFF;
+    params.initQP = qp;
+    params.bitrate = 10000000;
+    params.CPB_size = params.bitrate >> 1;
+    params.init_CBP_removal_delay = 1600;
+    params.frame_rate = 30000;
+    params.out_of_band_param_set = AVC_ON;
+    params.num_me_threads = numThreads;
+
+    AVCEnc_Status err = PVAVCEncInitialize(&handle, &params, NULL, NULL);
+    if (err != AVCENC_SUCCESS) {
+        fprintf(stderr, "failed to initialize the encoder: %d\n", err);
+        free(sliceGroup);
+        return 1;
+    }
+
+    size_t frameSize = width * height * 3 / 2;
+    uint8_t *frame = (uint8_t *)malloc(frameSize);
+    uint8_t *nal = (uint8_t *)malloc(frameSize);
+    CHECK(frame != NULL && nal != NULL);
+
+    uint32_t nalSize;
+    int32_t nalType;
+    size_t totalBytes = 0;
+
+    // parameter sets
+    for (;;) {
+        nalSize = frameSize;
+        if (PVAVCEncodeNAL(&handle, nal, &nalSize, &nalType) == AVCENC_WRONG_STATE) {
+            break;
+        }
+        if (out != NULL) {
+            fwrite("\x00\x00\x00\x01", 1, 4, out);
+            fwrite(nal, 1, nalSize, out);
+        }
+        totalBytes += nalSize + 4;
+    }
+
+    int64_t encodeTimeUs = 0;
+    int32_t numEncoded = 0;
+    double squaredErrorY = 0;
+    status_t result = OK;
+
+    for (int32_t i = 0; i < numFrames && result == OK; ++i) {
+        if (in != NULL) {
+            if (fread(frame, 1, frameSize, in) != frameSize) {
+                rewind(in);
+                if (fread(frame, 1, frameSize, in) != frameSize) {
+                    fprintf(stderr, "%s is smaller than one frame\n", inPath);
+                    result = UNKNOWN_ERROR;
+                    break;
+                }
+            }
+        } else {
+            synthesizeFrame(frame, width, height, i);
+        }
+
+        AVCFrameIO input;
+        memset(&input, 0, sizeof(input));
+        input.height = height;
+        input.pitch = width;
+        input.coding_timestamp = (i * 1000ll) / 30;
+        input.disp_order = i;
+        input.YCbCr[0] = frame;
+        input.YCbCr[1] = frame + width * height;
+        input.YCbCr[2] = input.YCbCr[1] + (width * height >> 2);
+
+        int64_t startUs = ALooper::GetNowUs();
+        err = PVAVCEncSetInput(&handle, &input);
+        if (err != AVCENC_SUCCESS && err != AVCENC_NEW_IDR) {
+            encodeTimeUs += ALooper::GetNowUs() - startUs;
+            if (err < AVCENC_SUCCESS) {
+                fprintf(stderr, "failed to set input %d: %d\n", i, err);
+                result = UNKNOWN_ERROR;
+            }
+            continue;
+        }
+
+        for (;;) {
+            nalSize = frameSize;
+            err = PVAVCEncodeNAL(&handle, nal, &nalSize, &nalType);
+            if (err < AVCENC_SUCCESS) {
+                fprintf(stderr, "failed to encode frame %d: %d\n", i, err);
+                result = UNKNOWN_ERROR;
+                break;
+            }
+            if (err == AVCENC_SKIPPED_PICTURE) {
+                break;
+            }
+            if (out != NULL) {
+                fwrite("\x00\x00\x00\x01", 1, 4, out);
+                fwrite(nal, 1, nalSize, out);
+            }
+            totalBytes += nalSize + 4;
+
+            if (err == AVCENC_PICTURE_READY) {
+                encodeTimeUs += ALooper::GetNowUs() - startUs;
+                ++numEncoded;
+
+                AVCFrameIO recon;
+                if (PVAVCEncGetRecon(&handle, &recon) == AVCENC_SUCCESS) {
+                    squaredErrorY += squaredError(
+                            frame, recon.YCbCr[0], width, height, recon.pitch);
+                    PVAVCEncReleaseRecon(&handle, &recon);
+                }
+                break;
+            }
+        }
+    }
+
+    PVAVCCleanUpEncoder(&handle);
+    for (size_t i = 0; i < state.mFrames.size(); ++i) {
+        free(state.mFrames[i]);
+    }
+    free(sliceGroup);
+    free(nal);
+    free(frame);
+    if (in != NULL) {
+        fclose(in);
+    }
+    if (out != NULL) {
+        fclose(out);
+    }
+
+    if (result != OK || numEncoded == 0) {
+        return 1;
+    }
+
+    double mse = squaredErrorY / ((double)width * height * numEncoded);
+    printf("%dx%d qp %d threads %d: %d frames in %.2f s, %.2f fps, %zu bytes, "
+            "%.1f kbps at 30 fps, PSNR-Y %.2f dB\n",
+            width, height, qp, numThreads, numEncoded, encodeTimeUs / 1E6,
+            numEncoded * 1E6 / encodeTimeUs, totalBytes,
+            totalBytes * 8 * 30.0 / numFrames / 1000,
+            mse > 0 ? 10 * log10(255.0 * 255.0 / mse) : 99.0);
+
+    return 0;
+}
+
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+
+    int32_t width = 1280;
+    int32_t height = 720;
+    const char *inPath = NULL;
+    const char *outPath = NULL;
+    int32_t qp = 28;
+    int32_t numFrames = 300;
+    int32_t numThreads = 1;
+
+    int res;
+    while ((res = getopt(argc, argv, "hs:i:q:n:t:o:")) >= 0) {
+        switch (res) {
+            case 's':
+            {
+                if (sscanf(optarg, "%dx%d", &width, &height) != 2
+                        || width <= 0 || height <= 0
+                        || width % 16 != 0 || height % 16 != 0) {
+                    usage(me);
+                }
+                break;
+            }
+            case 'i':
+            {
+                inPath = optarg;
+                break;
+            }
+            case 'q':
+            {
+                qp = atoi(optarg);
+                if (qp < 0 || qp > 51) {
+                    usage(me);
+                }
+                break;
+            }
+            case 'n':
+            {
+                numFrames = atoi(optarg);
+                if (numFrames <= 0) {
+                    usage(me);
+                }
+                break;
+            }
+            case 't':
+            {
+                numThreads = atoi(optarg);
+                if (numThreads <= 0) {
+                    usage(me);
+                }
+                break;
+            }
+            case 'o':
+            {
+                outPath = optarg;
+                break;
+            }
+            case '?':
+            case 'h':
+            default:
+            {
+                usage(me);
+            }
+        }
+    }
+
+    return encode(width, height, inPath, qp, numFrames, numThreads, outPath);
+}
@@ -0,0 +1,281 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "codecbench"
+#include <utils/Log.h>
+
+#include "MediaCodecListOverrides.h"
+
+#include <binder/ProcessState.h>
+#include <gui/ISurfaceComposer.h>
+#include <gui/Surface.h>
+#include <gui/SurfaceComposerClient.h>
+#include <media/IMediaCodecList.h>
+#include <media/MediaCodecInfo.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AString.h>
+#include <media/stagefright/MediaCodecList.h>
+#include <ui/DisplayInfo.h>
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-c codec] select codecs whose name contains codec\n"
+                    "\t\t[-s WxH] size to measure, may be repeated\n"
+                    "\t\t[-b bitrate] bitrate to measure, may be repeated\n"
+                    "\t\t[-n frames] frames per run (default 300)\n"
+                    "\t\t[-r runs] runs per configuration (default 3)\n"
+                    "\t\t[-S] also measure decoders rendering to a surface\n"
+                    "\t\t[-w] store the measured frame rates in the profiling results\n",
+                    me);
+    exit(1);
+}
+
+namespace android {
+
+struct BenchmarkSize {
+    int32_t mWidth;
+    int32_t mHeight;
+};
+
+static const BenchmarkSize kDefaultSizes[] = {
+    { 320, 240 }, { 720, 480 }, { 1280, 720 }, { 1920, 1080 },
+};
+
+static bool isSizeSupported(const sp<MediaCodecInfo::Capabilities> &caps, int32_t w, int32_t h) {
+    AString range;
+    AString minSize, maxSize;
+    int32_t minW, minH, maxW, maxH;
+    if (!caps->getDetails()->findString("size-range", &range)
+            || !splitString(range, "-", &minSize, &maxSize)
+            || sscanf(minSize.c_str(), "%dx%d", &minW, &minH) != 2
+            || sscanf(maxSize.c_str(), "%dx%d", &maxW, &maxH) != 2) {
+        return false;
+    }
+    return w >= minW && w <= maxW && h >= minH && h <= maxH;
+}
+
+static void benchmark(
+        const Vector<sp<MediaCodecInfo>> &infos, const char *filter,
+        const Vector<BenchmarkSize> &sizes, const Vector<int32_t> &bitrates,
+        size_t numFrames, size_t numRuns, const sp<Surface> &surface) {
+    // one line per run, for scripts
+    printf("codec,mime,type,output,width,height,bitrate,run,frames,fps,"
+            "latency_median_us,latency_p90_us,latency_max_us\n");
+
+    for (size_t i = 0; i < infos.size(); ++i) {
+        const sp<MediaCodecInfo> &info = infos[i];
+        AString name = info->getCodecName();
+        if (filter != NULL && name.find(filter) < 0) {
+            continue;
+        }
+
+        Vector<AString> mimes;
+        info->getSupportedMimes(&mimes);
+        for (size_t j = 0; j < mimes.size(); ++j) {
+            if (!mimes[j].startsWith("video/")) {
+                continue;
+            }
+            const sp<MediaCodecInfo::Capabilities> caps =
+                    info->getCapabilitiesFor(mimes[j].c_str());
+
+            for (size_t k = 0; k < sizes.size(); ++k) {
+                const BenchmarkSize &size = sizes[k];
+                if (!isSizeSupported(caps, size.mWidth, size.mHeight)) {
+                    continue;
+                }
+
+                Vector<int32_t> rates = bitrates;
+                if (rates.isEmpty()) {
+                    // about 0.1 bits per pixel
+                    rates.push(size.mWidth * size.mHeight * 3);
+                }
+
+                // decoders are measured once per output mode
+                size_t numOutputs = !info->isEncoder() && surface != NULL ? 2 : 1;
+                for (size_t l = 0; l < rates.size(); ++l) {
+                    for (size_t output = 0; output < numOutputs; ++output) {
+                        for (size_t run = 0; run < numRuns; ++run) {
+                            CodecBenchmarkResult result;
+                            status_t err = benchmarkCodec(
+                                    info->isEncoder(), name, mimes[j],
+                                    size.mWidth, size.mHeight, rates[l],
+                                    output == 1 ? surface : NULL, numFrames, &result);
+                            if (err != OK) {
+                                fprintf(stderr, "%s %s %dx%d failed: %d\n",
+                                        name.c_str(), mimes[j].c_str(),
+                                        size.mWidth, size.mHeight, err);
+                                break;
+                            }
+                            printf("%s,%s,%s,%s,%d,%d,%d,%zu,%zu,%.2f,%lld,%lld,%lld\n",
+                                    name.c_str(), mimes[j].c_str(),
+                                    info->isEncoder() ? "encoder" : "decoder",
+                                    output == 1 ? "surface" : "buffer",
+                                    size.mWidth, size.mHeight, rates[l], run,
+                                    result.mNumFrames, result.mFrameRate,
+                                    (long long)result.mMedianLatencyUs,
+                                    (long long)result.mP90LatencyUs,
+                                    (long long)result.mMaxLatencyUs);
+                            fflush(stdout);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Profiles the instance limits as the media server does on first boot, and adds the
+// measured frame rates, so that MediaCodecList reports them from now on.
+static void writeProfilingResults(const Vector<sp<MediaCodecInfo>> &infos, size_t numRuns) {
+    CodecSettings global_results;
+    KeyedVector<AString, CodecSettings> encoder_results;
+    KeyedVector<AString, CodecSettings> decoder_results;
+    profileCodecs(infos, &global_results, &encoder_results, &decoder_results);
+    measureFrameRates(infos, numRuns, &encoder_results, &decoder_results);
+    exportResultsToXML(kProfilingResults, global_results, encoder_results, decoder_results);
+    fprintf(stderr, "wrote %s\n", kProfilingResults);
+}
+
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+
+    const char *filter = NULL;
+    Vector<BenchmarkSize> sizes;
+    Vector<int32_t> bitrates;
+    size_t numFrames = 300;
+    size_t numRuns = 3;
+    bool useSurface = false;
+    bool writeResults = false;
+
+    int res;
+    while ((res = getopt(argc, argv, "hc:s:b:n:r:Sw")) >= 0) {
+        switch (res) {
+            case 'c':
+            {
+                filter = optarg;
+                break;
+            }
+            case 's':
+            {
+                BenchmarkSize size;
+                if (sscanf(optarg, "%dx%d", &size.mWidth, &size.mHeight) != 2
+                        || size.mWidth <= 0 || size.mHeight <= 0) {
+                    usage(me);
+                }
+                sizes.push(size);
+                break;
+            }
+            case 'b':
+            {
+                int32_t bitrate = atoi(optarg);
+                if (bitrate <= 0) {
+                    usage(me);
+                }
+                bitrates.push(bitrate);
+                break;
+            }
+            case 'n':
+            {
+                numFrames = atoi(optarg);
+                if (numFrames == 0) {
+                    usage(me);
+                }
+                break;
+            }
+            case 'r':
+            {
+                numRuns = atoi(optarg);
+                if (numRuns == 0) {
+                    usage(me);
+                }
+                break;
+            }
+            case 'S':
+            {
+                useSurface = true;
+                break;
+            }
+            case 'w':
+            {
+                writeResults = true;
+                break;
+            }
+            case '?':
+            case 'h':
+            default:
+            {
+                usage(me);
+            }
+        }
+    }
+
+    if (sizes.isEmpty()) {
+        sizes.appendArray(kDefaultSizes, sizeof(kDefaultSizes) / sizeof(kDefaultSizes[0]));
+    }
+
+    ProcessState::self()->startThreadPool();
+
+    sp<IMediaCodecList> list = MediaCodecList::getInstance();
+    CHECK(list != NULL);
+    Vector<sp<MediaCodecInfo>> infos;
+    for (size_t i = 0; i < list->countCodecs(); ++i) {
+        infos.push_back(list->getCodecInfo(i));
+    }
+
+    sp<SurfaceComposerClient> composerClient;
+    sp<SurfaceControl> control;
+    sp<Surface> surface;
+
+    if (useSurface) {
+        composerClient = new SurfaceComposerClient;
+        CHECK_EQ(composerClient->initCheck(), (status_t)OK);
+
+        sp<IBinder> display(SurfaceComposerClient::getBuiltInDisplay(
+                ISurfaceComposer::eDisplayIdMain));
+        DisplayInfo info;
+        SurfaceComposerClient::getDisplayInfo(display, &info);
+
+        control = composerClient->createSurface(
+                String8("codecbench"), info.w, info.h, PIXEL_FORMAT_RGB_565, 0);
+
+        CHECK(control != NULL);
+        CHECK(control->isValid());
+
+        SurfaceComposerClient::openGlobalTransaction();
+        CHECK_EQ(control->setLayer(INT_MAX), (status_t)OK);
+        CHECK_EQ(control->show(), (status_t)OK);
+        SurfaceComposerClient::closeGlobalTransaction();
+
+        surface = control->getSurface();
+        CHECK(surface != NULL);
+    }
+
+    benchmark(infos, filter, sizes, bitrates, numFrames, numRuns, surface);
+
+    if (writeResults) {
+        writeProfilingResults(infos, numRuns);
+    }
+
+    if (useSurface) {
+        composerClient->dispose();
+    }
+
+    return 0;
+}
@@ -0,0 +1,203 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "colorconvbench"
+#include <utils/Log.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <media/stagefright/ColorConverter.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <utils/Timers.h>
+#include <utils/misc.h>
+#include <utils/Vector.h>
+
+#include <OMX_IVCommon.h>
+
+// Converts a synthetic frame from each source format ColorConverter supports to RGB565,
+// as the thumbnail and software rendering paths do, and reports the time per frame for
+// each number of threads. The output of each thread count is checked against the
+// output of a single thread.
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-w width] (default 1920)\n"
+                    "\t\t[-h height] (default 1080)\n"
+                    "\t\t[-n frames] frames converted per run (default 100)\n"
+                    "\t\t[-t threads] may be repeated (default 1 and the number of cores)\n",
+                    me);
+    exit(1);
+}
+
+namespace android {
+
+struct SourceFormat {
+    OMX_COLOR_FORMATTYPE mFormat;
+    const char *mName;
+};
+
+static const SourceFormat kFormats[] = {
+    { OMX_COLOR_FormatYUV420Planar, "YUV420Planar" },
+    { OMX_COLOR_FormatYUV420SemiPlanar, "YUV420SemiPlanar" },
+    { OMX_QCOM_COLOR_FormatYVU420SemiPlanar, "QCOMYVU420SemiPlanar" },
+    { OMX_TI_COLOR_FormatYUV420PackedSemiPlanar, "TIYUV420PackedSemiPlanar" },
+    { OMX_COLOR_FormatCbYCrY, "CbYCrY" },
+    { OMX_COLOR_FormatYUV422Planar, "YUV422Planar" },
+};
+
+static void fillSource(uint8_t *data, size_t size, size_t width) {
+    // gradients with some noise, so that all the clip ranges are used
+    uint32_t seed = 1;
+    for (size_t i = 0; i < size; ++i) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (uint8_t)((i % width) + (i / width) + ((seed >> 16) & 0x3f));
+    }
+}
+
+static void benchmark(
+        size_t width, size_t height, size_t numFrames, const Vector<size_t> &numThreads) {
+    // big enough for the 4:2:2 formats
+    size_t srcSize = width * height * 2;
+    uint8_t *src = new uint8_t[srcSize];
+    uint16_t *dst = new uint16_t[width * height];
+    uint16_t *ref = new uint16_t[width * height];
+
+    printf("format,width,height,threads,frames,ms_per_frame,mpixels_per_s,matches\n");
+
+    for (size_t i = 0; i < NELEM(kFormats); ++i) {
+        const SourceFormat &format = kFormats[i];
+
+        for (size_t j = 0; j < numThreads.size(); ++j) {
+            ColorConverter converter(format.mFormat, OMX_COLOR_Format16bitRGB565);
+            if (!converter.isValid()) {
+                fprintf(stderr, "%s is not supported\n", format.mName);
+                break;
+            }
+            converter.setNumThreads(numThreads[j]);
+
+            // the 4:2:2 conversion goes through 4:2:0 in place, so the source is filled
+            // again before each conversion that is checked
+            fillSource(src, srcSize, width);
+
+            status_t err = OK;
+            nsecs_t startNs = systemTime(SYSTEM_TIME_MONOTONIC);
+            for (size_t n = 0; n < numFrames && err == OK; ++n) {
+                err = converter.convert(
+                        src, width, height, 0, 0, width - 1, height - 1,
+                        dst, width, height, 0, 0, width - 1, height - 1);
+            }
+            double ms = (systemTime(SYSTEM_TIME_MONOTONIC) - startNs) / 1E6 / numFrames;
+
+            if (err != OK) {
+                fprintf(stderr, "%s failed: %d\n", format.mName, err);
+                break;
+            }
+
+            // same result whatever the number of threads
+            fillSource(src, srcSize, width);
+            ColorConverter single(format.mFormat, OMX_COLOR_Format16bitRGB565);
+            single.convert(
+                    src, width, height, 0, 0, width - 1, height - 1,
+                    ref, width, height, 0, 0, width - 1, height - 1);
+            fillSource(src, srcSize, width);
+            converter.convert(
+                    src, width, height, 0, 0, width - 1, height - 1,
+                    dst, width, height, 0, 0, width - 1, height - 1);
+            bool matches = !memcmp(dst, ref, width * height * sizeof(uint16_t));
+
+            printf("%s,%zu,%zu,%zu,%zu,%.3f,%.1f,%s\n",
+                    format.mName, width, height, numThreads[j], numFrames,
+                    ms, width * height / ms / 1E3, matches ? "yes" : "no");
+        }
+    }
+
+    delete[] ref;
+    delete[] dst;
+    delete[] src;
+}
+
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+
+    size_t width = 1920;
+    size_t height = 1080;
+    size_t numFrames = 100;
+    Vector<size_t> numThreads;
+
+    int res;
+    while ((res = getopt(argc, argv, "w:h:n:t:")) >= 0) {
+        switch (res) {
+            case 'w':
+            {
+                // even, for the chroma subsampling
+                width = atoi(optarg) & ~1;
+                if (width == 0) {
+                    usage(me);
+                }
+                break;
+            }
+            case 'h':
+            {
+                height = atoi(optarg) & ~1;
+                if (height == 0) {
+                    usage(me);
+                }
+                break;
+            }
+            case 'n':
+            {
+                numFrames = atoi(optarg);
+                if (numFrames == 0) {
+                    usage(me);
+                }
+                break;
+            }
+            case 't':
+            {
+                int threads = atoi(optarg);
+                if (threads <= 0) {
+                    usage(me);
+                }
+                numThreads.push(threads);
+                break;
+            }
+            case '?':
+            default:
+            {
+                usage(me);
+            }
+        }
+    }
+
+    if (numThreads.isEmpty()) {
+        numThreads.push(1);
+        long numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+        if (numCpus > 1) {
+            numThreads.push(numCpus);
+        }
+    }
+
+    benchmark(width, height, numFrames, numThreads);
+
+    return 0;
+}
@@ -0,0 +1,916 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "mediabench"
+#include <inttypes.h>
+#include <utils/Log.h>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "MediaCodecListOverrides.h"
+
+#include <binder/ProcessState.h>
+#include <gui/ISurfaceComposer.h>
+#include <gui/Surface.h>
+#include <gui/SurfaceComposerClient.h>
+#include <media/ICrypto.h>
+#include <media/IMediaCodecList.h>
+#include <media/MediaCodecInfo.h>
+#include <media/openmax/OMX_IVCommon.h>
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/AString.h>
+#include <media/stagefright/DataSource.h>
+#include <media/stagefright/MediaCodec.h>
+#include <media/stagefright/MediaCodecList.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MediaMuxer.h>
+#include <media/stagefright/MetaData.h>
+#include <media/stagefright/NuMediaExtractor.h>
+#include <ui/DisplayInfo.h>
+#include <utils/misc.h>
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-s scenario] scenario to run, may be repeated (default all):\n"
+                    "\t\t   extract, decode, encode, transcode, mux, seek\n"
+                    "\t\t[-r runs] runs per scenario (default 3)\n"
+                    "\t\t[-n seeks] seeks per seek run (default 200)\n"
+                    "\t\t[-e WxH] size for the encode scenario (default 1280x720)\n"
+                    "\t\t[-S] decode to a surface instead of to buffers\n"
+                    "\t\t[-o file] write the JSON report to file instead of stdout\n"
+                    "\t\t[-m file] output file for the mux scenario\n"
+                    "\t\t   (default /data/local/tmp/mediabench.mp4)\n"
+                    "\t\tfile\n",
+                    me);
+    exit(1);
+}
+
+namespace android {
+
+static const int64_t kTimeoutUs = 10000ll;
+static const size_t kMaxSampleSize = 4 * 1024 * 1024;
+
+// Measurements of one stage of a scenario run.
+struct StageStats {
+    AString mName;
+    Vector<int64_t> mLatenciesUs;   // one per sample, frame or seek
+    int64_t mNumBytes;
+    int64_t mWallTimeUs;
+    int64_t mCpuTimeUs;             // user + system time of this process
+    int64_t mRssKb;                 // resident set size at the end
+    int64_t mPeakRssKb;             // process-wide peak so far
+
+    StageStats(const char *name = "")
+        : mName(name),
+          mNumBytes(0),
+          mWallTimeUs(0),
+          mCpuTimeUs(0),
+          mRssKb(0),
+          mPeakRssKb(0) {
+    }
+};
+
+static int64_t getCpuTimeUs(int64_t *peakRssKb) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    if (peakRssKb != NULL) {
+        *peakRssKb = usage.ru_maxrss;
+    }
+    return usage.ru_utime.tv_sec * 1000000ll + usage.ru_utime.tv_usec
+            + usage.ru_stime.tv_sec * 1000000ll + usage.ru_stime.tv_usec;
+}
+
+static int64_t getRssKb() {
+    FILE *fp = fopen("/proc/self/status", "r");
+    if (fp == NULL) {
+        return 0;
+    }
+
+    int64_t rssKb = 0;
+    char line[128];
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        long long value;
+        if (sscanf(line, "VmRSS: %lld kB", &value) == 1) {
+            rssKb = value;
+            break;
+        }
+    }
+    fclose(fp);
+    return rssKb;
+}
+
+// Measures wall and CPU time from construction to stop().
+struct StageTimer {
+    StageTimer(StageStats *stats)
+        : mStats(stats),
+          mStartUs(ALooper::GetNowUs()),
+          mStartCpuUs(getCpuTimeUs(NULL)) {
+    }
+
+    void stop() {
+        mStats->mWallTimeUs = ALooper::GetNowUs() - mStartUs;
+        mStats->mCpuTimeUs = getCpuTimeUs(&mStats->mPeakRssKb) - mStartCpuUs;
+        mStats->mRssKb = getRssKb();
+    }
+
+private:
+    StageStats *mStats;
+    int64_t mStartUs;
+    int64_t mStartCpuUs;
+};
+
+static status_t openExtractor(
+        const char *path, sp<NuMediaExtractor> *extractor,
+        Vector<StageStats> *stages) {
+    StageStats stats("open");
+    StageTimer timer(&stats);
+
+    *extractor = new NuMediaExtractor;
+    status_t err = (*extractor)->setDataSource(NULL /* httpService */, path);
+
+    timer.stop();
+    stages->push(stats);
+
+    if (err != OK) {
+        fprintf(stderr, "unable to open %s: %d\n", path, err);
+    }
+    return err;
+}
+
+// Selects the first video track, or the first audio track if there is none.
+static status_t selectMainTrack(
+        const sp<NuMediaExtractor> &extractor, sp<AMessage> *format) {
+    ssize_t audioTrack = -1;
+    for (size_t i = 0; i < extractor->countTracks(); ++i) {
+        sp<AMessage> trackFormat;
+        AString mime;
+        if (extractor->getTrackFormat(i, &trackFormat) != OK
+                || !trackFormat->findString("mime", &mime)) {
+            continue;
+        }
+        if (!strncasecmp(mime.c_str(), "video/", 6)) {
+            *format = trackFormat;
+            return extractor->selectTrack(i);
+        }
+        if (audioTrack < 0 && !strncasecmp(mime.c_str(), "audio/", 6)) {
+            audioTrack = i;
+        }
+    }
+
+    if (audioTrack < 0) {
+        return ERROR_UNSUPPORTED;
+    }
+    CHECK_EQ(extractor->getTrackFormat(audioTrack, format), (status_t)OK);
+    return extractor->selectTrack(audioTrack);
+}
+
+static status_t runExtract(const char *path, Vector<StageStats> *stages) {
+    sp<NuMediaExtractor> extractor;
+    status_t err = openExtractor(path, &extractor, stages);
+    if (err != OK) {
+        return err;
+    }
+
+    for (size_t i = 0; i < extractor->countTracks(); ++i) {
+        extractor->selectTrack(i);
+    }
+
+    StageStats stats("extract");
+    StageTimer timer(&stats);
+
+    sp<ABuffer> buffer = new ABuffer(kMaxSampleSize);
+    for (;;) {
+        int64_t startUs = ALooper::GetNowUs();
+        err = extractor->readSampleData(buffer);
+        if (err != OK) {
+            break;
+        }
+        extractor->advance();
+        stats.mLatenciesUs.push(ALooper::GetNowUs() - startUs);
+        stats.mNumBytes += buffer->size();
+    }
+
+    timer.stop();
+    stages->push(stats);
+
+    return err == ERROR_END_OF_STREAM ? OK : err;
+}
+
+// Feeds the extractor's selected track to the codec, and drains it either
+// to buffers or to the codec's surface. The latency of a frame runs from
+// queueing its sample to dequeueing the output with the same time stamp.
+static status_t decodeTrack(
+        const sp<NuMediaExtractor> &extractor, const sp<MediaCodec> &codec,
+        bool render, StageStats *stats) {
+    Vector<sp<ABuffer> > inBuffers;
+    status_t err = codec->getInputBuffers(&inBuffers);
+    if (err != OK) {
+        return err;
+    }
+
+    KeyedVector<int64_t, int64_t> queueTimesUs;
+    bool sawInputEOS = false;
+    bool sawOutputEOS = false;
+
+    while (!sawOutputEOS) {
+        if (!sawInputEOS) {
+            size_t index;
+            err = codec->dequeueInputBuffer(&index, kTimeoutUs);
+            if (err == OK) {
+                const sp<ABuffer> &buffer = inBuffers.itemAt(index);
+                int64_t timeUs = 0;
+                err = extractor->readSampleData(buffer);
+                if (err == OK) {
+                    CHECK_EQ(extractor->getSampleTime(&timeUs), (status_t)OK);
+                    extractor->advance();
+                    queueTimesUs.add(timeUs, ALooper::GetNowUs());
+                    stats->mNumBytes += buffer->size();
+                    err = codec->queueInputBuffer(
+                            index, buffer->offset(), buffer->size(), timeUs, 0);
+                } else {
+                    sawInputEOS = true;
+                    err = codec->queueInputBuffer(
+                            index, 0, 0, 0, MediaCodec::BUFFER_FLAG_EOS);
+                }
+                if (err != OK) {
+                    return err;
+                }
+            } else if (err != -EAGAIN) {
+                return err;
+            }
+        }
+
+        size_t index, offset, size;
+        int64_t timeUs;
+        uint32_t flags;
+        err = codec->dequeueOutputBuffer(
+                &index, &offset, &size, &timeUs, &flags, kTimeoutUs);
+        if (err == OK) {
+            ssize_t queued = queueTimesUs.indexOfKey(timeUs);
+            if (queued >= 0) {
+                stats->mLatenciesUs.push(
+                        ALooper::GetNowUs() - queueTimesUs.valueAt(queued));
+                queueTimesUs.removeItemsAt(queued);
+            }
+
+            if (render) {
+                err = codec->renderOutputBufferAndRelease(index);
+            } else {
+                err = codec->releaseOutputBuffer(index);
+            }
+            if (err != OK) {
+                return err;
+            }
+
+            if (flags & MediaCodec::BUFFER_FLAG_EOS) {
+                sawOutputEOS = true;
+            }
+        } else if (err != -EAGAIN
+                && err != INFO_FORMAT_CHANGED
+                && err != INFO_OUTPUT_BUFFERS_CHANGED) {
+            return err;
+        }
+    }
+
+    return OK;
+}
+
+static status_t runDecode(
+        const char *path, const sp<ALooper> &looper, const sp<Surface> &surface,
+        Vector<StageStats> *stages) {
+    sp<NuMediaExtractor> extractor;
+    status_t err = openExtractor(path, &extractor, stages);
+    if (err != OK) {
+        return err;
+    }
+
+    sp<AMessage> format;
+    err = selectMainTrack(extractor, &format);
+    if (err != OK) {
+        return err;
+    }
+
+    AString mime;
+    CHECK(format->findString("mime", &mime));
+    bool isVideo = !strncasecmp(mime.c_str(), "video/", 6);
+
+    StageStats setup("codec-setup");
+    StageTimer setupTimer(&setup);
+
+    sp<MediaCodec> codec = MediaCodec::CreateByType(looper, mime.c_str(), false);
+    if (codec == NULL) {
+        return NAME_NOT_FOUND;
+    }
+    err = codec->configure(
+            format, isVideo ? surface : NULL, NULL /* crypto */, 0 /* flags */);
+    if (err == OK) {
+        err = codec->start();
+    }
+
+    setupTimer.stop();
+    stages->push(setup);
+
+    if (err == OK) {
+        StageStats stats(isVideo && surface != NULL ? "decode-surface" : "decode");
+        StageTimer timer(&stats);
+
+        err = decodeTrack(extractor, codec, isVideo && surface != NULL, &stats);
+
+        timer.stop();
+        stages->push(stats);
+    }
+
+    codec->release();
+    return err;
+}
+
+// Encodes synthetic frames with the first AVC encoder.
+static status_t runEncode(
+        int32_t width, int32_t height, Vector<StageStats> *stages) {
+    sp<IMediaCodecList> list = MediaCodecList::getInstance();
+    ssize_t index = list == NULL ? -1 : list->findCodecByType(
+            MEDIA_MIMETYPE_VIDEO_AVC, true /* encoder */);
+    if (index < 0) {
+        return NAME_NOT_FOUND;
+    }
+
+    StageStats stats("encode");
+    StageTimer timer(&stats);
+
+    CodecBenchmarkResult result;
+    status_t err = benchmarkCodec(
+            true /* isEncoder */, list->getCodecInfo(index)->getCodecName(),
+            MEDIA_MIMETYPE_VIDEO_AVC,
+            width, height, width * height * 3 /* bitrate */, NULL /* surface */,
+            300 /* numFrames */, &result);
+
+    timer.stop();
+
+    // benchmarkCodec() only reports a summary of the latencies.
+    if (err == OK) {
+        stats.mLatenciesUs.push(result.mMedianLatencyUs);
+        stats.mLatenciesUs.push(result.mP90LatencyUs);
+        stats.mLatenciesUs.push(result.mMaxLatencyUs);
+    }
+    stages->push(stats);
+
+    return err;
+}
+
+// Decodes the video track straight into the input surface of an AVC
+// encoder, and drains the encoder. The latency of a frame runs from
+// queueing its sample to the decoder to dequeueing it from the encoder.
+static status_t runTranscode(
+        const char *path, const sp<ALooper> &looper, Vector<StageStats> *stages) {
+    sp<NuMediaExtractor> extractor;
+    status_t err = openExtractor(path, &extractor, stages);
+    if (err != OK) {
+        return err;
+    }
+
+    sp<AMessage> format;
+    err = selectMainTrack(extractor, &format);
+    AString mime;
+    int32_t width, height;
+    if (err != OK
+            || !format->findString("mime", &mime)
+            || strncasecmp(mime.c_str(), "video/", 6)
+            || !format->findInt32("width", &width)
+            || !format->findInt32("height", &height)) {
+        fprintf(stderr, "no video track to transcode\n");
+        return ERROR_UNSUPPORTED;
+    }
+
+    StageStats setup("codec-setup");
+    StageTimer setupTimer(&setup);
+
+    sp<MediaCodec> encoder =
+        MediaCodec::CreateByType(looper, MEDIA_MIMETYPE_VIDEO_AVC, true);
+    sp<MediaCodec> decoder = MediaCodec::CreateByType(looper, mime.c_str(), false);
+    if (encoder == NULL || decoder == NULL) {
+        return NAME_NOT_FOUND;
+    }
+
+    sp<AMessage> encFormat = new AMessage;
+    encFormat->setString("mime", MEDIA_MIMETYPE_VIDEO_AVC);
+    encFormat->setInt32("width", width);
+    encFormat->setInt32("height", height);
+    encFormat->setInt32("color-format", OMX_COLOR_FormatAndroidOpaque);
+    encFormat->setInt32("bitrate", width * height * 3);
+    encFormat->setFloat("frame-rate", 30.f);
+    encFormat->setInt32("i-frame-interval", 1);
+
+    sp<IGraphicBufferProducer> producer;
+    err = encoder->configure(
+            encFormat, NULL /* surface */, NULL /* crypto */,
+            MediaCodec::CONFIGURE_FLAG_ENCODE);
+    if (err == OK) {
+        err = encoder->createInputSurface(&producer);
+    }
+    if (err == OK) {
+        err = encoder->start();
+    }
+    if (err == OK) {
+        err = decoder->configure(
+                format, new Surface(producer), NULL /* crypto */, 0 /* flags */);
+    }
+    if (err == OK) {
+        err = decoder->start();
+    }
+
+    setupTimer.stop();
+    stages->push(setup);
+
+    if (err != OK) {
+        decoder->release();
+        encoder->release();
+        return err;
+    }
+
+    StageStats stats("transcode");
+    StageTimer timer(&stats);
+
+    Vector<sp<ABuffer> > inBuffers;
+    CHECK_EQ(decoder->getInputBuffers(&inBuffers), (status_t)OK);
+
+    KeyedVector<int64_t, int64_t> queueTimesUs;
+    bool sawInputEOS = false;
+    bool sawDecoderEOS = false;
+    bool sawEncoderEOS = false;
+
+    while (err == OK && !sawEncoderEOS) {
+        size_t index, offset, size;
+        int64_t timeUs;
+        uint32_t flags;
+
+        if (!sawInputEOS
+                && decoder->dequeueInputBuffer(&index, 0ll) == OK) {
+            const sp<ABuffer> &buffer = inBuffers.itemAt(index);
+            if (extractor->readSampleData(buffer) == OK) {
+                CHECK_EQ(extractor->getSampleTime(&timeUs), (status_t)OK);
+                extractor->advance();
+                queueTimesUs.add(timeUs, ALooper::GetNowUs());
+                stats.mNumBytes += buffer->size();
+                err = decoder->queueInputBuffer(
+                        index, buffer->offset(), buffer->size(), timeUs, 0);
+            } else {
+                sawInputEOS = true;
+                err = decoder->queueInputBuffer(
+                        index, 0, 0, 0, MediaCodec::BUFFER_FLAG_EOS);
+            }
+        }
+
+        if (err == OK && !sawDecoderEOS) {
+            status_t res = decoder->dequeueOutputBuffer(
+                    &index, &offset, &size, &timeUs, &flags, 0ll);
+            if (res == OK) {
+                if (flags & MediaCodec::BUFFER_FLAG_EOS) {
+                    sawDecoderEOS = true;
+                    err = decoder->releaseOutputBuffer(index);
+                    if (err == OK) {
+                        err = encoder->signalEndOfInputStream();
+                    }
+                } else {
+                    err = decoder->renderOutputBufferAndRelease(index, timeUs * 1000ll);
+                }
+            } else if (res != -EAGAIN
+                    && res != INFO_FORMAT_CHANGED
+                    && res != INFO_OUTPUT_BUFFERS_CHANGED) {
+                err = res;
+            }
+        }
+
+        if (err == OK) {
+            status_t res = encoder->dequeueOutputBuffer(
+                    &index, &offset, &size, &timeUs, &flags, kTimeoutUs);
+            if (res == OK) {
+                ssize_t queued = queueTimesUs.indexOfKey(timeUs);
+                if (queued >= 0) {
+                    stats.mLatenciesUs.push(
+                            ALooper::GetNowUs() - queueTimesUs.valueAt(queued));
+                    queueTimesUs.removeItemsAt(queued);
+                }
+                if (flags & MediaCodec::BUFFER_FLAG_EOS) {
+                    sawEncoderEOS = true;
+                }
+                err = encoder->releaseOutputBuffer(index);
+            } else if (res != -EAGAIN
+                    && res != INFO_FORMAT_CHANGED
+                    && res != INFO_OUTPUT_BUFFERS_CHANGED) {
+                err = res;
+            }
+        }
+    }
+
+    timer.stop();
+    stages->push(stats);
+
+    decoder->release();
+    encoder->release();
+    return err;
+}
+
+static status_t runMux(
+        const char *path, const char *outputPath, Vector<StageStats> *stages) {
+    sp<NuMediaExtractor> extractor;
+    status_t err = openExtractor(path, &extractor, stages);
+    if (err != OK) {
+        return err;
+    }
+
+    int fd = open(outputPath, O_CREAT | O_LARGEFILE | O_TRUNC | O_RDWR,
+            S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        fprintf(stderr, "unable to open %s\n", outputPath);
+        return -errno;
+    }
+    sp<MediaMuxer> muxer = new MediaMuxer(fd, MediaMuxer::OUTPUT_FORMAT_MPEG_4);
+    close(fd);
+
+    KeyedVector<size_t, ssize_t> trackIndexMap;
+    for (size_t i = 0; i < extractor->countTracks(); ++i) {
+        sp<AMessage> format;
+        AString mime;
+        if (extractor->getTrackFormat(i, &format) != OK
+                || !format->findString("mime", &mime)
+                || (strncasecmp(mime.c_str(), "video/", 6)
+                        && strncasecmp(mime.c_str(), "audio/", 6))) {
+            continue;
+        }
+        ssize_t trackIndex = muxer->addTrack(format);
+        if (trackIndex >= 0) {
+            extractor->selectTrack(i);
+            trackIndexMap.add(i, trackIndex);
+        }
+    }
+
+    if (trackIndexMap.isEmpty()) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    StageStats stats("mux");
+    StageTimer timer(&stats);
+
+    err = muxer->start();
+
+    sp<ABuffer> buffer = new ABuffer(kMaxSampleSize);
+    size_t trackIndex;
+    while (err == OK && extractor->getSampleTrackIndex(&trackIndex) == OK) {
+        int64_t timeUs;
+        sp<MetaData> meta;
+        CHECK_EQ(extractor->readSampleData(buffer), (status_t)OK);
+        CHECK_EQ(extractor->getSampleTime(&timeUs), (status_t)OK);
+        CHECK_EQ(extractor->getSampleMeta(&meta), (status_t)OK);
+
+        uint32_t flags = 0;
+        int32_t isSync;
+        if (meta->findInt32(kKeyIsSyncFrame, &isSync) && isSync) {
+            flags |= MediaCodec::BUFFER_FLAG_SYNCFRAME;
+        }
+
+        // Only the muxer is timed, not reading the sample.
+        int64_t startUs = ALooper::GetNowUs();
+        err = muxer->writeSampleData(
+                buffer, trackIndexMap.valueFor(trackIndex), timeUs, flags);
+        stats.mLatenciesUs.push(ALooper::GetNowUs() - startUs);
+        stats.mNumBytes += buffer->size();
+
+        extractor->advance();
+    }
+
+    status_t stopErr = muxer->stop();
+
+    timer.stop();
+    stages->push(stats);
+
+    return err != OK ? err : stopErr;
+}
+
+// Seeks to pseudo-random positions, from a fixed seed so that runs are
+// comparable, and reads the sample found there.
+static status_t runSeek(const char *path, size_t numSeeks, Vector<StageStats> *stages) {
+    sp<NuMediaExtractor> extractor;
+    status_t err = openExtractor(path, &extractor, stages);
+    if (err != OK) {
+        return err;
+    }
+
+    sp<AMessage> format;
+    int64_t durationUs;
+    err = selectMainTrack(extractor, &format);
+    if (err != OK || !format->findInt64("durationUs", &durationUs)
+            || durationUs <= 0) {
+        fprintf(stderr, "no track with a duration to seek in\n");
+        return ERROR_UNSUPPORTED;
+    }
+
+    StageStats stats("seek");
+    StageTimer timer(&stats);
+
+    sp<ABuffer> buffer = new ABuffer(kMaxSampleSize);
+    unsigned short seed[3] = { 0x1234, 0x5678, 0x9abc };
+    for (size_t i = 0; i < numSeeks; ++i) {
+        int64_t seekTimeUs = (int64_t)(erand48(seed) * durationUs);
+
+        int64_t startUs = ALooper::GetNowUs();
+        err = extractor->seekTo(seekTimeUs);
+        if (err == OK) {
+            err = extractor->readSampleData(buffer);
+        }
+        stats.mLatenciesUs.push(ALooper::GetNowUs() - startUs);
+
+        if (err == ERROR_END_OF_STREAM) {
+            err = OK;
+        } else if (err != OK) {
+            break;
+        }
+        stats.mNumBytes += buffer->size();
+    }
+
+    timer.stop();
+    stages->push(stats);
+
+    return err;
+}
+
+static int compareLatency(const int64_t *a, const int64_t *b) {
+    return *a < *b ? -1 : (*a > *b ? 1 : 0);
+}
+
+static int64_t percentile(const Vector<int64_t> &sorted, size_t p) {
+    return sorted.isEmpty() ? 0 : sorted[(sorted.size() - 1) * p / 100];
+}
+
+static AString jsonString(const char *s) {
+    AString out("\"");
+    for (; *s != '\0'; ++s) {
+        if (*s == '"' || *s == '\\') {
+            out.append('\\');
+        }
+        if ((unsigned char)*s < 0x20) {
+            out.append(AStringPrintf("\\u%04x", *s).c_str());
+        } else {
+            out.append(*s);
+        }
+    }
+    out.append('"');
+    return out;
+}
+
+static void appendRun(
+        AString *json, const char *scenario, size_t run, status_t err,
+        const Vector<StageStats> &stages) {
+    json->append(AStringPrintf(
+            "    {\"scenario\": \"%s\", \"run\": %zu, \"status\": %d, \"stages\": [",
+            scenario, run, err));
+
+    for (size_t i = 0; i < stages.size(); ++i) {
+        const StageStats &stats = stages[i];
+
+        Vector<int64_t> sorted = stats.mLatenciesUs;
+        sorted.sort(compareLatency);
+
+        double seconds = stats.mWallTimeUs / 1E6;
+        json->append(AStringPrintf(
+                "%s\n      {\"name\": %s, \"count\": %zu, \"bytes\": %lld, "
+                "\"wall_ms\": %.3f, \"per_sec\": %.2f, "
+                "\"latency_us\": {\"p50\": %lld, \"p90\": %lld, \"p99\": %lld, "
+                "\"max\": %lld}, "
+                "\"cpu_ms\": %.3f, \"cpu_percent\": %.1f, "
+                "\"rss_kb\": %lld, \"peak_rss_kb\": %lld}",
+                i == 0 ? "" : ",",
+                jsonString(stats.mName.c_str()).c_str(),
+                stats.mLatenciesUs.size(), (long long)stats.mNumBytes,
+                stats.mWallTimeUs / 1E3,
+                seconds > 0 ? stats.mLatenciesUs.size() / seconds : 0.,
+                (long long)percentile(sorted, 50),
+                (long long)percentile(sorted, 90),
+                (long long)percentile(sorted, 99),
+                (long long)percentile(sorted, 100),
+                stats.mCpuTimeUs / 1E3,
+                stats.mWallTimeUs > 0
+                        ? 100. * stats.mCpuTimeUs / stats.mWallTimeUs : 0.,
+                (long long)stats.mRssKb, (long long)stats.mPeakRssKb));
+    }
+
+    json->append("]}");
+}
+
+static const char *kScenarios[] = {
+    "extract", "decode", "encode", "transcode", "mux", "seek",
+};
+
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+
+    Vector<AString> scenarios;
+    size_t numRuns = 3;
+    size_t numSeeks = 200;
+    int32_t encodeWidth = 1280;
+    int32_t encodeHeight = 720;
+    bool useSurface = false;
+    const char *reportPath = NULL;
+    const char *muxPath = "/data/local/tmp/mediabench.mp4";
+
+    int res;
+    while ((res = getopt(argc, argv, "hs:r:n:e:So:m:")) >= 0) {
+        switch (res) {
+            case 's':
+            {
+                bool known = false;
+                for (size_t i = 0; i < NELEM(kScenarios); ++i) {
+                    known = known || !strcmp(optarg, kScenarios[i]);
+                }
+                if (!known) {
+                    usage(me);
+                }
+                scenarios.push(AString(optarg));
+                break;
+            }
+            case 'r':
+            {
+                numRuns = atoi(optarg);
+                if (numRuns == 0) {
+                    usage(me);
+                }
+                break;
+            }
+            case 'n':
+            {
+                numSeeks = atoi(optarg);
+                if (numSeeks == 0) {
+                    usage(me);
+                }
+                break;
+            }
+            case 'e':
+            {
+                if (sscanf(optarg, "%dx%d", &encodeWidth, &encodeHeight) != 2
+                        || encodeWidth <= 0 || encodeHeight <= 0) {
+                    usage(me);
+                }
+                break;
+            }
+            case 'S':
+            {
+                useSurface = true;
+                break;
+            }
+            case 'o':
+            {
+                reportPath = optarg;
+                break;
+            }
+            case 'm':
+            {
+                muxPath = optarg;
+                break;
+            }
+            case '?':
+            case 'h':
+            default:
+            {
+                usage(me);
+            }
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc != 1) {
+        usage(me);
+    }
+    const char *path = argv[0];
+
+    if (scenarios.isEmpty()) {
+        for (size_t i = 0; i < NELEM(kScenarios); ++i) {
+            scenarios.push(AString(kScenarios[i]));
+        }
+    }
+
+    ProcessState::self()->startThreadPool();
+    DataSource::RegisterDefaultSniffers();
+
+    sp<ALooper> looper = new ALooper;
+    looper->start();
+
+    sp<SurfaceComposerClient> composerClient;
+    sp<SurfaceControl> control;
+    sp<Surface> surface;
+
+    if (useSurface) {
+        composerClient = new SurfaceComposerClient;
+        CHECK_EQ(composerClient->initCheck(), (status_t)OK);
+
+        sp<IBinder> display(SurfaceComposerClient::getBuiltInDisplay(
+                ISurfaceComposer::eDisplayIdMain));
+        DisplayInfo info;
+        SurfaceComposerClient::getDisplayInfo(display, &info);
+
+        control = composerClient->createSurface(
+                String8("mediabench"), info.w, info.h, PIXEL_FORMAT_RGB_565, 0);
+
+        CHECK(control != NULL);
+        CHECK(control->isValid());
+
+        SurfaceComposerClient::openGlobalTransaction();
+        CHECK_EQ(control->setLayer(INT_MAX), (status_t)OK);
+        CHECK_EQ(control->show(), (status_t)OK);
+        SurfaceComposerClient::closeGlobalTransaction();
+
+        surface = control->getSurface();
+        CHECK(surface != NULL);
+    }
+
+    AString json("{\n");
+    json.append("  \"file\": ");
+    json.append(jsonString(path));
+    json.append(",\n  \"runs\": [\n");
+
+    bool first = true;
+    bool failed = false;
+    for (size_t i = 0; i < scenarios.size(); ++i) {
+        const char *scenario = scenarios[i].c_str();
+        for (size_t run = 0; run < numRuns; ++run) {
+            Vector<StageStats> stages;
+            status_t err;
+            if (!strcmp(scenario, "extract")) {
+                err = runExtract(path, &stages);
+            } else if (!strcmp(scenario, "decode")) {
+                err = runDecode(path, looper, surface, &stages);
+            } else if (!strcmp(scenario, "encode")) {
+                err = runEncode(encodeWidth, encodeHeight, &stages);
+            } else if (!strcmp(scenario, "transcode")) {
+                err = runTranscode(path, looper, &stages);
+            } else if (!strcmp(scenario, "mux")) {
+                err = runMux(path, muxPath, &stages);
+            } else {
+                err = runSeek(path, numSeeks, &stages);
+            }
+
+            if (err != OK) {
+                fprintf(stderr, "%s run %zu failed: %d\n", scenario, run, err);
+                failed = true;
+            }
+
+            if (!first) {
+                json.append(",\n");
+            }
+            first = false;
+            appendRun(&json, scenario, run, err, stages);
+        }
+    }
+
+    json.append("\n  ]\n}\n");
+
+    if (reportPath != NULL) {
+        FILE *fp = fopen(reportPath, "w");
+        if (fp == NULL) {
+            fprintf(stderr, "unable to open %s\n", reportPath);
+            return 1;
+        }
+        fputs(json.c_str(), fp);
+        fclose(fp);
+    } else {
+        fputs(json.c_str(), stdout);
+    }
+
+    if (useSurface) {
+        composerClient->dispose();
+    }
+
+    looper->stop();
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,501 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "speechbench"
+#include <utils/Log.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <utils/Condition.h>
+#include <utils/Mutex.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+
+#include <OMX_Component.h>
+
+#include "SoftOMXPlugin.h"
+
+// Decodes many speech streams at once through the software OMX components,
+// in process and as fast as possible, and reports how many real-time streams
+// one core sustains. The input is synthetic, each input buffer holds the given
+// number of codec frames and each output buffer is large enough for the
+// samples of one input buffer.
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-c codec] select components whose name contains codec\n"
+                    "\t\t[-n streams] streams decoded at once (default 8)\n"
+                    "\t\t[-d seconds] audio per stream (default 60)\n"
+                    "\t\t[-f frames] codec frames per input buffer, may be repeated"
+                    " (default 1 and 50)\n",
+                    me);
+    exit(1);
+}
+
+namespace android {
+
+struct SpeechCodec {
+    const char *mComponent;
+    int32_t mSampleRate;
+    size_t mSamplesPerFrame;
+    size_t mFrameSize;      // bytes of one input frame
+    uint8_t mHeader;        // first byte of each frame, if not 0
+};
+
+static const SpeechCodec kCodecs[] = {
+    // 12.2 kbps and 23.85 kbps, octet aligned with the frame type header
+    { "OMX.google.amrnb.decoder", 8000, 160, 32, (7 << 3) | 0x04 },
+    { "OMX.google.amrwb.decoder", 16000, 320, 61, (8 << 3) | 0x04 },
+    { "OMX.google.g711.alaw.decoder", 8000, 160, 160, 0 },
+    { "OMX.google.g711.mlaw.decoder", 8000, 160, 160, 0 },
+    // Microsoft GSM, two frames in 65 bytes
+    { "OMX.google.gsm.decoder", 8000, 320, 65, 0 },
+};
+
+static const size_t kNumBuffers = 4;
+static const size_t kNumRandomFrames = 64;
+
+template<class T>
+static void InitOMXParams(T *params) {
+    memset(params, 0, sizeof(T));
+    params->nSize = sizeof(T);
+    params->nVersion.s.nVersionMajor = 1;
+    params->nVersion.s.nVersionMinor = 0;
+    params->nVersion.s.nRevision = 0;
+    params->nVersion.s.nStep = 0;
+}
+
+struct Stream {
+    Stream(const SpeechCodec &codec, const uint8_t *frames,
+            size_t framesPerBuffer, size_t numFrames);
+    ~Stream();
+
+    // Creates the component and moves it to the executing state.
+    status_t init(SoftOMXPlugin *plugin);
+
+    // Queues all the buffers, decoding goes on on the component's thread.
+    void start();
+
+    status_t waitForEOS();
+
+    // Moves the component back to the loaded state and destroys it.
+    void stop();
+
+    size_t numOutputBuffers() const { return mNumOutputBuffers; }
+
+private:
+    const SpeechCodec &mCodec;
+    const uint8_t *mFrames;
+    size_t mFramesPerBuffer;
+    size_t mNumFrames;
+
+    SoftOMXPlugin *mPlugin;
+    OMX_COMPONENTTYPE *mComponent;
+    Vector<OMX_BUFFERHEADERTYPE *> mBuffers[2];
+
+    Mutex mLock;
+    Condition mCondition;
+    OMX_STATETYPE mState;
+    size_t mNumFramesQueued;
+    size_t mNumOutputBuffers;
+    bool mSentEOS;
+    bool mSawEOS;
+    bool mStopping;
+    status_t mError;
+
+    status_t setPortBufferSize(OMX_U32 portIndex, OMX_U32 size);
+    status_t setState(OMX_STATETYPE state, bool allocateBuffers, bool freeBuffers);
+    void queueInput(OMX_BUFFERHEADERTYPE *header);
+
+    static OMX_ERRORTYPE OnEvent(
+            OMX_HANDLETYPE component, OMX_PTR appData, OMX_EVENTTYPE event,
+            OMX_U32 data1, OMX_U32 data2, OMX_PTR eventData);
+    static OMX_ERRORTYPE OnEmptyBufferDone(
+            OMX_HANDLETYPE component, OMX_PTR appData, OMX_BUFFERHEADERTYPE *header);
+    static OMX_ERRORTYPE OnFillBufferDone(
+            OMX_HANDLETYPE component, OMX_PTR appData, OMX_BUFFERHEADERTYPE *header);
+
+    static OMX_CALLBACKTYPE kCallbacks;
+
+    DISALLOW_EVIL_CONSTRUCTORS(Stream);
+};
+
+OMX_CALLBACKTYPE Stream::kCallbacks = {
+    &OnEvent, &OnEmptyBufferDone, &OnFillBufferDone
+};
+
+Stream::Stream(const SpeechCodec &codec, const uint8_t *frames,
+        size_t framesPerBuffer, size_t numFrames)
+    : mCodec(codec),
+      mFrames(frames),
+      mFramesPerBuffer(framesPerBuffer),
+      mNumFrames(numFrames),
+      mPlugin(NULL),
+      mComponent(NULL),
+      mState(OMX_StateLoaded),
+      mNumFramesQueued(0),
+      mNumOutputBuffers(0),
+      mSentEOS(false),
+      mSawEOS(false),
+      mStopping(false),
+      mError(OK) {
+}
+
+Stream::~Stream() {
+    CHECK(mComponent == NULL);
+}
+
+status_t Stream::init(SoftOMXPlugin *plugin) {
+    mPlugin = plugin;
+    if (plugin->makeComponentInstance(
+                mCodec.mComponent, &kCallbacks, this, &mComponent) != OMX_ErrorNone) {
+        fprintf(stderr, "unable to create %s\n", mCodec.mComponent);
+        mComponent = NULL;
+        return UNKNOWN_ERROR;
+    }
+
+    status_t err = setPortBufferSize(0, mFramesPerBuffer * mCodec.mFrameSize);
+    if (err == OK) {
+        err = setPortBufferSize(
+                1, mFramesPerBuffer * mCodec.mSamplesPerFrame * sizeof(int16_t));
+    }
+    if (err == OK) {
+        err = setState(OMX_StateIdle, true /* allocateBuffers */, false /* freeBuffers */);
+    }
+    if (err == OK) {
+        err = setState(OMX_StateExecuting, false /* allocateBuffers */, false /* freeBuffers */);
+    }
+    return err;
+}
+
+status_t Stream::setPortBufferSize(OMX_U32 portIndex, OMX_U32 size) {
+    OMX_PARAM_PORTDEFINITIONTYPE def;
+    InitOMXParams(&def);
+    def.nPortIndex = portIndex;
+    if (OMX_GetParameter(mComponent, OMX_IndexParamPortDefinition, &def) != OMX_ErrorNone) {
+        return UNKNOWN_ERROR;
+    }
+    // components only let the size grow
+    def.nBufferSize = size;
+    def.nBufferCountActual = kNumBuffers;
+    if (OMX_SetParameter(mComponent, OMX_IndexParamPortDefinition, &def) != OMX_ErrorNone) {
+        return UNKNOWN_ERROR;
+    }
+    return OK;
+}
+
+status_t Stream::setState(OMX_STATETYPE state, bool allocateBuffers, bool freeBuffers) {
+    if (OMX_SendCommand(mComponent, OMX_CommandStateSet, state, NULL) != OMX_ErrorNone) {
+        return UNKNOWN_ERROR;
+    }
+
+    for (OMX_U32 portIndex = 0; portIndex < 2; ++portIndex) {
+        if (allocateBuffers) {
+            OMX_PARAM_PORTDEFINITIONTYPE def;
+            InitOMXParams(&def);
+            def.nPortIndex = portIndex;
+            CHECK_EQ(OMX_GetParameter(mComponent, OMX_IndexParamPortDefinition, &def),
+                    OMX_ErrorNone);
+
+            for (OMX_U32 i = 0; i < def.nBufferCountActual; ++i) {
+                OMX_U8 *data = (OMX_U8 *)malloc(def.nBufferSize);
+                CHECK(data != NULL);
+                OMX_BUFFERHEADERTYPE *header;
+                CHECK_EQ(OMX_UseBuffer(mComponent, &header, portIndex, NULL,
+                        def.nBufferSize, data), OMX_ErrorNone);
+                mBuffers[portIndex].push(header);
+            }
+        }
+        if (freeBuffers) {
+            for (size_t i = 0; i < mBuffers[portIndex].size(); ++i) {
+                OMX_U8 *data = mBuffers[portIndex][i]->pBuffer;
+                CHECK_EQ(OMX_FreeBuffer(mComponent, portIndex, mBuffers[portIndex][i]),
+                        OMX_ErrorNone);
+                free(data);
+            }
+            mBuffers[portIndex].clear();
+        }
+    }
+
+    Mutex::Autolock autoLock(mLock);
+    while (mState != state && mError == OK) {
+        mCondition.wait(mLock);
+    }
+    return mError;
+}
+
+void Stream::start() {
+    for (size_t i = 0; i < mBuffers[0].size(); ++i) {
+        queueInput(mBuffers[0][i]);
+    }
+    for (size_t i = 0; i < mBuffers[1].size(); ++i) {
+        OMX_FillThisBuffer(mComponent, mBuffers[1][i]);
+    }
+}
+
+// Called with mLock held, or before the buffers are handed to the component.
+void Stream::queueInput(OMX_BUFFERHEADERTYPE *header) {
+    if (mSentEOS) {
+        return;
+    }
+
+    size_t numFrames = mNumFrames - mNumFramesQueued;
+    if (numFrames > mFramesPerBuffer) {
+        numFrames = mFramesPerBuffer;
+    }
+
+    header->nOffset = 0;
+    header->nFilledLen = 0;
+    header->nFlags = 0;
+    header->nTimeStamp =
+        (int64_t)mNumFramesQueued * mCodec.mSamplesPerFrame * 1000000ll / mCodec.mSampleRate;
+
+    for (size_t i = 0; i < numFrames; ++i) {
+        const uint8_t *frame =
+            &mFrames[((mNumFramesQueued + i) % kNumRandomFrames) * mCodec.mFrameSize];
+        memcpy(header->pBuffer + header->nFilledLen, frame, mCodec.mFrameSize);
+        header->nFilledLen += mCodec.mFrameSize;
+    }
+    mNumFramesQueued += numFrames;
+
+    if (numFrames == 0) {
+        header->nFlags = OMX_BUFFERFLAG_EOS;
+        mSentEOS = true;
+    }
+
+    OMX_EmptyThisBuffer(mComponent, header);
+}
+
+status_t Stream::waitForEOS() {
+    Mutex::Autolock autoLock(mLock);
+    while (!mSawEOS && mError == OK) {
+        mCondition.wait(mLock);
+    }
+    return mError;
+}
+
+void Stream::stop() {
+    if (mComponent == NULL) {
+        return;
+    }
+
+    if (mState == OMX_StateExecuting) {
+        {
+            Mutex::Autolock autoLock(mLock);
+            mStopping = true;
+        }
+        setState(OMX_StateIdle, false /* allocateBuffers */, false /* freeBuffers */);
+    }
+    if (mState == OMX_StateIdle) {
+        setState(OMX_StateLoaded, false /* allocateBuffers */, true /* freeBuffers */);
+    }
+
+    mPlugin->destroyComponentInstance(mComponent);
+    mComponent = NULL;
+}
+
+// static
+OMX_ERRORTYPE Stream::OnEvent(
+        OMX_HANDLETYPE /* component */, OMX_PTR appData, OMX_EVENTTYPE event,
+        OMX_U32 data1, OMX_U32 data2, OMX_PTR /* eventData */) {
+    Stream *stream = (Stream *)appData;
+
+    Mutex::Autolock autoLock(stream->mLock);
+    if (event == OMX_EventCmdComplete && data1 == OMX_CommandStateSet) {
+        stream->mState = (OMX_STATETYPE)data2;
+    } else if (event == OMX_EventError) {
+        ALOGE("%s signalled error %#x", stream->mCodec.mComponent, data1);
+        stream->mError = UNKNOWN_ERROR;
+    }
+    stream->mCondition.broadcast();
+    return OMX_ErrorNone;
+}
+
+// static
+OMX_ERRORTYPE Stream::OnEmptyBufferDone(
+        OMX_HANDLETYPE /* component */, OMX_PTR appData, OMX_BUFFERHEADERTYPE *header) {
+    Stream *stream = (Stream *)appData;
+
+    Mutex::Autolock autoLock(stream->mLock);
+    if (!stream->mStopping) {
+        stream->queueInput(header);
+    }
+    return OMX_ErrorNone;
+}
+
+// static
+OMX_ERRORTYPE Stream::OnFillBufferDone(
+        OMX_HANDLETYPE /* component */, OMX_PTR appData, OMX_BUFFERHEADERTYPE *header) {
+    Stream *stream = (Stream *)appData;
+
+    Mutex::Autolock autoLock(stream->mLock);
+    if (stream->mStopping) {
+        return OMX_ErrorNone;
+    }
+
+    ++stream->mNumOutputBuffers;
+    if (header->nFlags & OMX_BUFFERFLAG_EOS) {
+        stream->mSawEOS = true;
+        stream->mCondition.broadcast();
+    } else {
+        OMX_FillThisBuffer(stream->mComponent, header);
+    }
+    return OMX_ErrorNone;
+}
+
+static void benchmark(
+        const char *filter, size_t numStreams, size_t seconds,
+        const Vector<size_t> &framesPerBuffer) {
+    // one line per run, for scripts
+    printf("codec,streams,frames_per_buffer,audio_s,wall_s,cpu_s,output_buffers,"
+            "streams_per_core\n");
+
+    SoftOMXPlugin plugin;
+
+    for (size_t i = 0; i < sizeof(kCodecs) / sizeof(kCodecs[0]); ++i) {
+        const SpeechCodec &codec = kCodecs[i];
+        if (filter != NULL && strstr(codec.mComponent, filter) == NULL) {
+            continue;
+        }
+
+        // random payload, the decoders do not mind
+        Vector<uint8_t> frames;
+        frames.resize(kNumRandomFrames * codec.mFrameSize);
+        for (size_t j = 0; j < frames.size(); ++j) {
+            frames.editItemAt(j) = rand();
+        }
+        if (codec.mHeader != 0) {
+            for (size_t j = 0; j < kNumRandomFrames; ++j) {
+                frames.editItemAt(j * codec.mFrameSize) = codec.mHeader;
+            }
+        }
+
+        size_t numFrames = seconds * codec.mSampleRate / codec.mSamplesPerFrame;
+
+        for (size_t j = 0; j < framesPerBuffer.size(); ++j) {
+            Vector<Stream *> streams;
+            status_t err = OK;
+            for (size_t k = 0; k < numStreams && err == OK; ++k) {
+                Stream *stream = new Stream(
+                        codec, frames.array(), framesPerBuffer[j], numFrames);
+                streams.push(stream);
+                err = stream->init(&plugin);
+            }
+
+            nsecs_t startWallNs = systemTime(SYSTEM_TIME_MONOTONIC);
+            nsecs_t startCpuNs = systemTime(SYSTEM_TIME_PROCESS);
+
+            if (err == OK) {
+                for (size_t k = 0; k < streams.size(); ++k) {
+                    streams[k]->start();
+                }
+                for (size_t k = 0; k < streams.size() && err == OK; ++k) {
+                    err = streams[k]->waitForEOS();
+                }
+            }
+
+            double wallS = (systemTime(SYSTEM_TIME_MONOTONIC) - startWallNs) / 1E9;
+            double cpuS = (systemTime(SYSTEM_TIME_PROCESS) - startCpuNs) / 1E9;
+
+            size_t numOutputBuffers = 0;
+            for (size_t k = 0; k < streams.size(); ++k) {
+                numOutputBuffers += streams[k]->numOutputBuffers();
+                streams[k]->stop();
+                delete streams[k];
+            }
+
+            if (err != OK) {
+                fprintf(stderr, "%s failed: %d\n", codec.mComponent, err);
+                break;
+            }
+
+            double audioS = (double)numStreams * numFrames * codec.mSamplesPerFrame
+                    / codec.mSampleRate;
+            printf("%s,%zu,%zu,%.1f,%.3f,%.3f,%zu,%.1f\n",
+                    codec.mComponent, numStreams, framesPerBuffer[j], audioS, wallS, cpuS,
+                    numOutputBuffers, cpuS > 0 ? audioS / cpuS : 0.);
+            fflush(stdout);
+        }
+    }
+}
+
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+
+    const char *filter = NULL;
+    size_t numStreams = 8;
+    size_t seconds = 60;
+    Vector<size_t> framesPerBuffer;
+
+    int res;
+    while ((res = getopt(argc, argv, "hc:n:d:f:")) >= 0) {
+        switch (res) {
+            case 'c':
+            {
+                filter = optarg;
+                break;
+            }
+            case 'n':
+            {
+                numStreams = atoi(optarg);
+                if (numStreams == 0) {
+                    usage(me);
+                }
+                break;
+            }
+            case 'd':
+            {
+                seconds = atoi(optarg);
+                if (seconds == 0) {
+                    usage(me);
+                }
+                break;
+            }
+            case 'f':
+            {
+                int frames = atoi(optarg);
+                if (frames <= 0) {
+                    usage(me);
+                }
+                framesPerBuffer.push(frames);
+                break;
+            }
+            case '?':
+            case 'h':
+            default:
+            {
+                usage(me);
+            }
+        }
+    }
+
+    if (framesPerBuffer.isEmpty()) {
+        framesPerBuffer.push(1);
+        framesPerBuffer.push(50);
+    }
+
+    benchmark(filter, numStreams, seconds, framesPerBuffer);
+
+    return 0;
+}
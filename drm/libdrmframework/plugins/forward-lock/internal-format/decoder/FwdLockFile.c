@@ -236,23 +236,38 @@ static void FwdLockFile_CalculateCounter(const unsigned char *pNonce,
 }
 
 /**
- * Decrypts the byte at the current file position using AES-128-CTR. In CTR (or "counter") mode,
- * encryption and decryption are performed using the same algorithm.
+ * Decrypts the given number of bytes starting at the current file position using AES-128-CTR, and
+ * advances the file position past them. In CTR (or "counter") mode, encryption and decryption are
+ * performed using the same algorithm.
  *
  * @param[in,out] pSession A reference to a file session.
- * @param[in] pByte The byte to decrypt.
+ * @param[in,out] pBuffer The bytes to decrypt.
+ * @param[in] numBytes The number of bytes to decrypt.
  */
-void FwdLockFile_DecryptByte(FwdLockFile_Session_t * pSession, unsigned char *pByte) {
-    uint64_t blockIndex = pSession->filePos / AES_BLOCK_SIZE;
-    uint64_t blockOffset = pSession->filePos % AES_BLOCK_SIZE;
-    if (blockIndex != pSession->blockIndex) {
-        // The first 16 bytes of the encrypted session key is used as the nonce.
-        unsigned char counter[AES_BLOCK_SIZE];
-        FwdLockFile_CalculateCounter(pSession->pEncryptedSessionKey, blockIndex, counter);
-        AES_encrypt(counter, pSession->keyStream, &pSession->encryptionRoundKeys);
-        pSession->blockIndex = blockIndex;
+static void FwdLockFile_DecryptBuffer(FwdLockFile_Session_t *pSession, unsigned char *pBuffer,
+                                      size_t numBytes) {
+    while (numBytes > 0) {
+        uint64_t blockIndex = pSession->filePos / AES_BLOCK_SIZE;
+        size_t blockOffset = pSession->filePos % AES_BLOCK_SIZE;
+        size_t numBlockBytes = AES_BLOCK_SIZE - blockOffset;
+        size_t i;
+        if (blockIndex != pSession->blockIndex) {
+            // The first 16 bytes of the encrypted session key is used as the nonce.
+            unsigned char counter[AES_BLOCK_SIZE];
+            FwdLockFile_CalculateCounter(pSession->pEncryptedSessionKey, blockIndex, counter);
+            AES_encrypt(counter, pSession->keyStream, &pSession->encryptionRoundKeys);
+            pSession->blockIndex = blockIndex;
+        }
+        if (numBlockBytes > numBytes) {
+            numBlockBytes = numBytes;
+        }
+        for (i = 0; i < numBlockBytes; ++i) {
+            pBuffer[i] ^= pSession->keyStream[blockOffset + i];
+        }
+        pBuffer += numBlockBytes;
+        numBytes -= numBlockBytes;
+        pSession->filePos += numBlockBytes;
     }
-    *pByte ^= pSession->keyStream[blockOffset];
 }
 
 int FwdLockFile_attach(int fileDesc) {
@@ -303,11 +318,9 @@ ssize_t FwdLockFile_read(int fileDesc, void *pBuffer, size_t numBytes) {
         numBytesRead = -1;
     } else {
         FwdLockFile_Session_t *pSession = sessionPtrs[sessionId];
-        ssize_t i;
         numBytesRead = read(pSession->fileDesc, pBuffer, numBytes);
-        for (i = 0; i < numBytesRead; ++i) {
-            FwdLockFile_DecryptByte(pSession, &((unsigned char *)pBuffer)[i]);
-            ++pSession->filePos;
+        if (numBytesRead > 0) {
+            FwdLockFile_DecryptBuffer(pSession, pBuffer, numBytesRead);
         }
     }
     return numBytesRead;
@@ -18,48 +18,64 @@
 #define LOG_TAG "ClearKeyCryptoPlugin"
 #include <utils/Log.h>
 
-#include <openssl/aes.h>
+#include <media/stagefright/MediaErrors.h>
+#include <openssl/evp.h>
 
 #include "AesCtrDecryptor.h"
 
 namespace clearkeydrm {
 
-static const size_t kBlockBitCount = kBlockSize * 8;
-
 android::status_t AesCtrDecryptor::decrypt(const android::Vector<uint8_t>& key,
         const Iv iv, const uint8_t* source,
         uint8_t* destination,
         const SubSample* subSamples,
         size_t numSubSamples,
         size_t* bytesDecryptedOut) {
-    uint32_t blockOffset = 0;
-    uint8_t previousEncryptedCounter[kBlockSize];
-    memset(previousEncryptedCounter, 0, kBlockSize);
+    if (key.size() != kBlockSize) {
+        ALOGE("Invalid key size %zu", key.size());
+        return android::ERROR_DRM_DECRYPT;
+    }
 
-    size_t offset = 0;
-    AES_KEY opensslKey;
-    AES_set_encrypt_key(key.array(), kBlockBitCount, &opensslKey);
-    Iv opensslIv;
-    memcpy(opensslIv, iv, sizeof(opensslIv));
+    // The EVP interface uses the bulk CTR routines, which run on the AES instructions of the CPU
+    // where available, instead of encrypting the counter one block at a time. The counter and
+    // the partial block position carry over from one encrypted range to the next.
+    EVP_CIPHER_CTX ctx;
+    EVP_CIPHER_CTX_init(&ctx);
+    if (EVP_EncryptInit_ex(&ctx, EVP_aes_128_ctr(), NULL, key.array(), iv) != 1) {
+        EVP_CIPHER_CTX_cleanup(&ctx);
+        return android::ERROR_DRM_DECRYPT;
+    }
 
+    size_t offset = 0;
+    android::status_t result = android::OK;
     for (size_t i = 0; i < numSubSamples; ++i) {
         const SubSample& subSample = subSamples[i];
 
         if (subSample.mNumBytesOfClearData > 0) {
-            memcpy(destination + offset, source + offset,
-                    subSample.mNumBytesOfClearData);
+            // nothing to copy when decrypting in place
+            if (destination != source) {
+                memcpy(destination + offset, source + offset,
+                        subSample.mNumBytesOfClearData);
+            }
             offset += subSample.mNumBytesOfClearData;
         }
 
         if (subSample.mNumBytesOfEncryptedData > 0) {
-            AES_ctr128_encrypt(source + offset, destination + offset,
-                    subSample.mNumBytesOfEncryptedData, &opensslKey,
-                    opensslIv, previousEncryptedCounter,
-                    &blockOffset);
+            int outLength;
+            if (EVP_EncryptUpdate(&ctx, destination + offset, &outLength,
+                    source + offset, subSample.mNumBytesOfEncryptedData) != 1 ||
+                    static_cast<uint32_t>(outLength) != subSample.mNumBytesOfEncryptedData) {
+                result = android::ERROR_DRM_DECRYPT;
+                break;
+            }
             offset += subSample.mNumBytesOfEncryptedData;
         }
     }
+    EVP_CIPHER_CTX_cleanup(&ctx);
 
+    if (result != android::OK) {
+        return result;
+    }
     *bytesDecryptedOut = offset;
     return android::OK;
 }
@@ -102,6 +102,51 @@ TEST_F(AesCtrDecryptorTest, DecryptsContiguousEncryptedBlock) {
                                                subSamples, kNumSubsamples);
 }
 
+TEST_F(AesCtrDecryptorTest, DecryptsInPlace) {
+    const size_t kTotalSize = 48;
+    const size_t kNumSubsamples = 2;
+
+    // Test vectors from NIST-800-38A
+    Key key = {
+        0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+        0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+    };
+
+    Iv iv = {
+        0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7,
+        0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff
+    };
+
+    uint8_t buffer[kTotalSize] = {
+        0x4c, 0x6f, 0x72, 0x65, 0x6d, 0x20, 0x69, 0x70,
+        0x73, 0x75, 0x6d, 0x20, 0x64, 0x6f, 0x6c, 0x6f,
+        0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26,
+        0x1b, 0xef, 0x68, 0x64, 0x99, 0x0d, 0xb6, 0xce,
+        0x98, 0x06, 0xf6, 0x6b, 0x79, 0x70, 0xfd, 0xff,
+        0x86, 0x17, 0x18, 0x7b, 0xb9, 0xff, 0xfd, 0xff
+    };
+
+    uint8_t decrypted[kTotalSize] = {
+        0x4c, 0x6f, 0x72, 0x65, 0x6d, 0x20, 0x69, 0x70,
+        0x73, 0x75, 0x6d, 0x20, 0x64, 0x6f, 0x6c, 0x6f,
+        0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96,
+        0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+        0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c,
+        0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51
+    };
+
+    SubSample subSamples[kNumSubsamples] = {
+        {16, 7},
+        {0, 25}
+    };
+
+    size_t bytesDecrypted = 0;
+    ASSERT_EQ(android::OK, attemptDecrypt(key, iv, buffer, buffer, subSamples,
+                                          kNumSubsamples, &bytesDecrypted));
+    EXPECT_EQ(kTotalSize, bytesDecrypted);
+    EXPECT_EQ(0, memcmp(buffer, decrypted, kTotalSize));
+}
+
 TEST_F(AesCtrDecryptorTest, DecryptsAlignedBifurcatedEncryptedBlock) {
     const size_t kTotalSize = 64;
     const size_t kNumSubsamples = 2;
@@ -18,6 +18,7 @@
 #define ANDROID_CLIENT_CAMERA2_CAMERAMETADATA_CPP
 
 #include "system/camera_metadata.h"
+#include <utils/Mutex.h>
 #include <utils/String8.h>
 #include <utils/Vector.h>
 
@@ -210,6 +211,36 @@ class CameraMetadata {
     camera_metadata_t *mBuffer;
     mutable bool       mLocked;
 
+    /**
+     * Tag to entry index hash table used by find(), exists(), update() and
+     * erase() on buffers with at least kIndexMinEntries entries. It is built
+     * by the first lookup and dropped whenever entries are reordered or
+     * removed. Const lookups may run concurrently, so the table is built under
+     * mIndexLock and published through mIndexReady.
+     */
+    struct IndexSlot {
+        uint32_t tag;
+        uint32_t entry;
+    };
+    static const size_t   kIndexMinEntries = 16;
+    static const uint32_t kIndexEmptySlot = 0xFFFFFFFF;
+
+    mutable Mutex             mIndexLock;
+    mutable Vector<IndexSlot> mIndex;
+    mutable volatile int32_t  mIndexReady;
+
+    /**
+     * Index of the first entry with the given tag, NAME_NOT_FOUND if there is
+     * none, or INVALID_OPERATION if the buffer isn't indexed.
+     */
+    ssize_t lookupIndex(uint32_t tag) const;
+    void buildIndex() const;
+    void addToIndex(uint32_t tag, size_t entryIndex);
+    void invalidateIndex();
+
+    status_t findEntry(uint32_t tag, camera_metadata_entry_t *entry);
+    status_t findEntry(uint32_t tag, camera_metadata_ro_entry_t *entry) const;
+
     /**
      * Check if tag has a given type
      */
@@ -23,6 +23,8 @@
 
 namespace android {
 
+class LocalClock;
+
 // CCHelper is a simple wrapper class to help with centralizing access to the
 // Common Clock service and implementing lifetime managment, as well as to
 // implement a simple policy of making a basic attempt to reconnect to the
@@ -40,6 +42,9 @@ namespace android {
 // ref counted ICommonClock interface across all clients and automatically
 // registering and unregistering a listener whenever there are CCHelper
 // instances active in the process.
+//
+// The local clock is read straight from the local time HAL when this process is
+// able to open it, since that is what the service would report anyway.
 class CCHelper {
   public:
     CCHelper();
@@ -61,10 +66,14 @@ class CCHelper {
 
     static bool verifyClock_l();
 
+    status_t getLocalTimeFromService(int64_t* localTime);
+    status_t getLocalFreqFromService(uint64_t* freq);
+
     static Mutex lock_;
     static sp<ICommonClock> common_clock_;
     static sp<ICommonClockListener> common_clock_listener_;
     static uint32_t ref_count_;
+    static LocalClock* local_clock_;
 };
 
 
@@ -118,6 +118,11 @@ public:
     // current CPU number and clock frequency periodically.
     uint32_t getCpukHz(int cpuNum);
 
+    // Return the number of times the current thread was involuntarily context switched,
+    // that is preempted, since it started, as reported by getrusage(RUSAGE_THREAD).
+    // Returns true if 'count' is valid, or false if invalid.
+    static bool getInvoluntaryContextSwitches(long& count);
+
 private:
     bool mIsEnabled;                // whether tracking is currently enabled
     bool mWasEverEnabled;           // whether tracking was ever enabled
@@ -41,6 +41,8 @@ public:
     //  keyInputSource: to change audio input source, value is an int in audio_source_t
     //     (defined in media/mediarecorder.h)
     //  keyScreenState: either "on" or "off"
+    //  keyMixerWorkers: number of AudioMixer worker threads for a mixer output, value is an int.
+    //     Handled by AudioFlinger and not forwarded to the HAL.
     static const char * const keyRouting;
     static const char * const keySamplingRate;
     static const char * const keyFormat;
@@ -48,6 +50,7 @@ public:
     static const char * const keyFrameCount;
     static const char * const keyInputSource;
     static const char * const keyScreenState;
+    static const char * const keyMixerWorkers;
 
     String8 toString();
 
@@ -19,6 +19,7 @@
 
 #include <cutils/sched_policy.h>
 #include <media/AudioSystem.h>
+#include <media/AudioTimestamp.h>
 #include <media/IAudioRecord.h>
 #include <utils/threads.h>
 
@@ -313,6 +314,18 @@ public:
      */
             status_t    getPosition(uint32_t *position) const;
 
+    /* Poll for the most recent capture timestamp.
+     * The server reports one for each capture period: the position, in getPosition() units,
+     * of the newest frame delivered to the client, and the CLOCK_MONOTONIC time at which
+     * the HAL read that captured it returned.
+     * Returns NO_ERROR    if timestamp is valid.
+     *         WOULD_BLOCK if no period was captured since the last start().
+     *         INVALID_OPERATION  if the record is stopped.
+     *
+     * The timestamp parameter is undefined on return, if status is not NO_ERROR.
+     */
+            status_t    getTimestamp(AudioTimestamp& timestamp);
+
     /* Returns a handle on the audio input used by this AudioRecord.
      *
      * Parameters:
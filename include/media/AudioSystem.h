@@ -370,6 +370,9 @@ private:
         status_t getInputBufferSize(uint32_t sampleRate, audio_format_t format,
                                     audio_channel_mask_t channelMask, size_t* buffSize);
         sp<AudioIoDescriptor> getIoDescriptor(audio_io_handle_t ioHandle);
+        // caches ioDesc unless a descriptor for its handle is already known, and returns
+        // the cached descriptor
+        sp<AudioIoDescriptor> addIoDescriptor(const sp<AudioIoDescriptor>& ioDesc);
 
         // DeathRecipient
         virtual void binderDied(const wp<IBinder>& who);
@@ -427,6 +430,7 @@ private:
 
     static const sp<AudioFlingerClient> getAudioFlingerClient();
     static sp<AudioIoDescriptor> getIoDescriptor(audio_io_handle_t ioHandle);
+    static sp<AudioIoDescriptor> getOutputDescriptor(audio_io_handle_t output);
 
     static sp<AudioFlingerClient> gAudioFlingerClient;
     static sp<AudioPolicyServiceClient> gAudioPolicyServiceClient;
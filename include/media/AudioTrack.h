@@ -17,6 +17,7 @@
 #ifndef ANDROID_AUDIOTRACK_H
 #define ANDROID_AUDIOTRACK_H
 
+#include <sys/uio.h>
 #include <cutils/sched_policy.h>
 #include <media/AudioSystem.h>
 #include <media/AudioTimestamp.h>
@@ -657,6 +658,18 @@ public:
      */
             ssize_t     write(const void* buffer, size_t size, bool blocking = true);
 
+    /* Vectored variant of write().
+     * The iovcnt regions described by iov are transferred in order, as if they were
+     * concatenated into a single buffer and passed to write().  Each contiguous region of the
+     * track buffer is obtained and released once, however many entries are gathered into it,
+     * so submitting several small pre-filled regions costs one proxy transaction per
+     * contiguous region rather than one per entry.  Individual entries need not be a
+     * multiple of the frame size, but a partial frame at the end of the last entry is
+     * not written.  Return value and status codes are the same as for write(),
+     * with BAD_VALUE also returned if iovcnt is negative or any entry is invalid.
+     */
+            ssize_t     writev(const struct iovec* iov, int iovcnt, bool blocking = true);
+
     /*
      * Dumps the state of an audio track.
      * Not a general-purpose API; intended only for use by media player service to dump its tracks.
@@ -52,8 +52,6 @@ class CharacterEncodingDetector {
         // singlenullbyte-terminated
         StringArray     mNames;
         StringArray     mValues;
-
-        UConverter*     mUtf8Conv;
 };
 
 
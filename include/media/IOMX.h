@@ -191,6 +191,12 @@ public:
             InternalOptionType type,
             const void *data,
             size_t size) = 0;
+
+    // Sets up the shared memory rings of OMXMessageRing for the buffer exchange with
+    // |node|. The client then queues its fillBuffer and emptyBuffer calls without fences
+    // on the command ring, and receives the buffer done messages without fences on the
+    // event ring.
+    virtual status_t createMessageRing(node_id node, sp<IMemory> *memory) = 0;
 };
 
 struct omx_message {
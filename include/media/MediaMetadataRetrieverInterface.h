@@ -19,6 +19,7 @@
 #define ANDROID_MEDIAMETADATARETRIEVERINTERFACE_H
 
 #include <utils/RefBase.h>
+#include <utils/Vector.h>
 #include <media/mediametadataretriever.h>
 #include <media/mediascanner.h>
 #include <private/media/VideoFrame.h>
@@ -45,6 +46,28 @@ public:
     virtual VideoFrame* getFrameAtTime(int64_t timeUs, int option) = 0;
     virtual MediaAlbumArt* extractAlbumArt() = 0;
     virtual const char* extractMetadata(int keyCode) = 0;
+
+    // Receives the frames of getFramesAtTimes() as they are extracted.
+    struct FrameSink {
+        virtual ~FrameSink() {}
+
+        // |index| is the index of the frame time. Takes |frame|. Returns false to stop
+        // the extraction.
+        virtual bool onFrame(size_t index, VideoFrame *frame) = 0;
+    };
+
+    // Extracts the frames at |timesUs|, in any order, with the same |option| for all of
+    // them. The frames that cannot be extracted are not passed to |sink|.
+    virtual status_t getFramesAtTimes(
+            const Vector<int64_t> &timesUs, int option, FrameSink *sink) {
+        for (size_t i = 0; i < timesUs.size(); ++i) {
+            VideoFrame *frame = getFrameAtTime(timesUs[i], option);
+            if (frame != NULL && !sink->onFrame(i, frame)) {
+                break;
+            }
+        }
+        return OK;
+    }
 };
 
 // MediaMetadataRetrieverInterface
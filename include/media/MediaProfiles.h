@@ -338,6 +338,13 @@ private:
     // If the xml configuration file does exist, use the settings
     // from the xml
     static MediaProfiles* createInstanceFromXmlFile(const char *xml);
+
+    // The settings parsed from the xml file (after adding the required
+    // profiles) are kept in a binary cache file, so that processes do not
+    // need to parse the xml again as long as it does not change.
+    static MediaProfiles* createInstanceFromCacheFile(const char *cache, const char *xml);
+    static bool readCache(const int32_t *data, size_t size, MediaProfiles *profiles);
+    void writeCacheFile(const char *cache, const char *xml) const;
     static output_format createEncoderOutputFileFormat(const char **atts);
     static VideoCodec* createVideoCodec(const char **atts, MediaProfiles *profiles);
     static AudioCodec* createAudioCodec(const char **atts, MediaProfiles *profiles);
@@ -418,6 +425,7 @@ private:
     static const NameToTagMap sAudioDecoderNameMap[];
     static const NameToTagMap sCamcorderQualityNameMap[];
 
+    static const char *kCacheFile;
     static bool sIsInitialized;
     static MediaProfiles *sInstance;
     static Mutex sLock;
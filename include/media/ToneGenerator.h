@@ -279,9 +279,11 @@ private:
     bool prepareWave();
     unsigned int numWaves(unsigned int segmentIdx);
     void clearWaveGens();
+    void generateWaves(short *outBuffer, unsigned int count, unsigned int command);
     tone_type getToneForRegion(tone_type toneType);
 
-    // WaveGenerator generates a single sine wave
+    // WaveGenerator generates a single sine wave by stepping a phase accumulator through a
+    // precomputed sine table shared by all generators of the process.
     class WaveGenerator {
     public:
         enum gen_command {
@@ -294,18 +296,22 @@ private:
                 float volume);
         ~WaveGenerator();
 
-        void getSamples(short *outBuffer, unsigned int count,
-                unsigned int command);
+        // Generates count samples of the sum of numGens sine waves and accumulates the
+        // result in outBuffer. All generators are advanced in a single pass over the buffer.
+        static void mixSamples(WaveGenerator * const *gens, unsigned int numGens,
+                short *outBuffer, unsigned int count, unsigned int command);
 
     private:
-        static const short GEN_AMP = 32000;  // amplitude of generator
-        static const short S_Q14 = 14;  // shift for Q14
+        static const unsigned int SINE_TABLE_BITS = 10;  // log2 of sine table size
+        static const unsigned int SINE_TABLE_SIZE = 1 << SINE_TABLE_BITS;
         static const short S_Q15 = 15;  // shift for Q15
 
-        short mA1_Q14;  // Q14 coefficient
-        // delay line of full amplitude generator
-        short mS1, mS2;  // delay line S2 oldest
-        short mS2_0;  // saved value for reinitialisation
+        // One period of a full scale sine wave, plus a guard entry for interpolation
+        static short sSineTable[SINE_TABLE_SIZE + 1];
+        static void initSineTable();
+
+        uint32_t mPhase;  // current phase, a full period spans the 32 bit range
+        uint32_t mPhaseInc;  // phase increment per sample
         short mAmplitude_Q15;  // Q15 amplitude
     };
 
@@ -171,6 +171,13 @@ private:
     void *mCaptureCbkUser;
     sp<CaptureThread> mCaptureThread;
     uint32_t mCaptureFlags;
+
+    // Last waveform transformed by doFft() and its FFT: a poll that returns the same waveform,
+    // e.g. because no new audio was played since the previous one, reuses the result.
+    Mutex mFftCacheLock;
+    uint32_t mFftCacheSize;     // 0 if the cache is empty
+    uint8_t mFftCacheWaveform[VISUALIZER_CAPTURE_SIZE_MAX];
+    uint8_t mFftCacheResult[VISUALIZER_CAPTURE_SIZE_MAX];
 };
 
 
@@ -63,6 +63,12 @@ enum {
     // Add more here...
 };
 
+// Or'ed with the seek option of getFrameAtTime(). The frame is then meant for a
+// thumbnail, and large frames are downscaled by a power of 2.
+enum {
+    GET_FRAME_OPTION_THUMBNAIL = 0x100,
+};
+
 class MediaMetadataRetriever: public RefBase
 {
 public:
@@ -78,6 +84,9 @@ public:
     status_t setDataSource(int fd, int64_t offset, int64_t length);
     status_t setDataSource(const sp<IDataSource>& dataSource);
     sp<IMemory> getFrameAtTime(int64_t timeUs, int option);
+    // Returns a VideoFrameList. Decoding the frames of a clip in one call is much faster
+    // than calling getFrameAtTime() for each of them.
+    sp<IMemory> getFramesAtTimes(const Vector<int64_t> &timesUs, int option);
     sp<IMemory> extractAlbumArt();
     const char* extractMetadata(int keyCode);
 
@@ -198,6 +198,11 @@ enum media_recorder_info_type {
     // Total number of bytes of the media data.
     MEDIA_RECORDER_TRACK_INFO_DATA_KBYTES          = 1009,
 
+    // The max number of chunks waiting for the file writer, and the max
+    // time taken by a single write, to measure storage backpressure.
+    MEDIA_RECORDER_TRACK_INFO_MAX_QUEUED_CHUNKS    = 1010,
+    MEDIA_RECORDER_TRACK_INFO_MAX_CHUNK_WRITE_MS   = 1011,
+
     MEDIA_RECORDER_TRACK_INFO_LIST_END             = 2000,
 };
 
@@ -40,6 +40,12 @@ enum Event {
     EVENT_RESERVED,
     EVENT_STRING,               // ASCII string, not NUL-terminated
     EVENT_TIMESTAMP,            // clock_gettime(CLOCK_MONOTONIC)
+    // A record logged by logFormat(): EVENT_START_FMT, EVENT_TIMESTAMP, then one event per
+    // argument (EVENT_INTEGER, EVENT_FLOAT or EVENT_STRING), then EVENT_END_FMT.
+    EVENT_START_FMT,            // printf format string, not NUL-terminated
+    EVENT_INTEGER,              // int64_t argument
+    EVENT_FLOAT,                // double argument
+    EVENT_END_FMT,              // end of record, no data
 };
 
 // ---------------------------------------------------------------------------
@@ -50,8 +56,6 @@ struct Entry {
         : mEvent(event), mLength(length), mData(data) { }
     /*virtual*/ ~Entry() { }
 
-    int     readAt(size_t offset) const;
-
 private:
     friend class Writer;
     Event       mEvent;     // event type
@@ -128,6 +132,13 @@ public:
     virtual void    logTimestamp();
     virtual void    logTimestamp(const struct timespec& ts);
 
+    // Like logf(), but the arguments are logged in binary form with a timestamp and the
+    // formatting is left to the Reader, which is much cheaper for the logging thread.
+    // Supports the d i u o x X c, f e g a E G A and s conversions, with optional
+    // h hh l ll j z t length modifiers; '*' widths and precisions are not supported.
+    virtual void    logFormat(const char *fmt, ...) __attribute__ ((format (printf, 2, 3)));
+    virtual void    logVFormat(const char *fmt, va_list ap);
+
     virtual bool    isEnabled() const;
 
     // return value for all of these is the previous isEnabled()
@@ -161,6 +172,8 @@ public:
     virtual void    logvf(const char *fmt, va_list ap);
     virtual void    logTimestamp();
     virtual void    logTimestamp(const struct timespec& ts);
+    virtual void    logFormat(const char *fmt, ...) __attribute__ ((format (printf, 2, 3)));
+    virtual void    logVFormat(const char *fmt, va_list ap);
 
     virtual bool    isEnabled() const;
     virtual bool    setEnabled(bool enabled);
@@ -194,6 +207,10 @@ private:
 
     void    dumpLine(const String8& timestamp, String8& body);
 
+    // Formats the logFormat() record starting at copy[i], and returns the index just past it.
+    size_t  dumpFormat(const uint8_t *copy, size_t i, size_t avail, String8& timestamp,
+                       String8& body);
+
     static const size_t kSquashTimestamp = 5; // squash this many or more adjacent timestamps
 };
 
@@ -47,8 +47,16 @@ public:
 
     virtual ssize_t read(void *buffer, size_t count, int64_t readPTS);
 
+    // Passes the frames to 'via' directly from the pipe buffer, without an intermediate copy.
+    // The 'block' hint is ignored; there are at most two callbacks per call, due to wraparound.
+    virtual ssize_t readVia(readVia_t via, size_t total, void *user,
+                            int64_t readPTS, size_t block = 0);
+
     // NBAIO_Source end
 
+    // Number of read() or readVia() calls that found this reader caught up with the writer
+    size_t underruns() const { return mUnderruns; }
+
 #if 0   // until necessary
     Pipe& pipe() const { return mPipe; }
 #endif
@@ -58,6 +66,7 @@ private:
     int32_t     mFront;         // follows behind mPipe.mRear
     size_t      mFramesOverrun;
     size_t      mOverruns;
+    size_t      mUnderruns;
 };
 
 }   // namespace android
@@ -33,12 +33,18 @@ class AudioRecord;
 struct AudioSource : public MediaSource, public MediaBufferObserver {
     // Note that the "channels" parameter _is_ the number of channels,
     // _not_ a bitmask of audio_channels_t constants.
+    //
+    // With a positive capturePeriodUs, AudioRecord's callback thread is not
+    // used; instead read() wakes up once per capture period and collects all
+    // the data AudioRecord gathered in the meantime. This trades latency for
+    // far fewer wakeups, e.g. for long background recordings.
     AudioSource(
             audio_source_t inputSource,
             const String16 &opPackageName,
             uint32_t sampleRate,
             uint32_t channels,
-            uint32_t outSampleRate = 0);
+            uint32_t outSampleRate = 0,
+            int64_t capturePeriodUs = 0);
 
     status_t initCheck() const;
 
@@ -69,6 +75,9 @@ private:
         // This is the initial mute duration to suppress
         // the video recording signal tone
         kAutoRampStartUs = 0,
+
+        // Returned buffers kept for reuse in callback mode.
+        kMaxPooledBuffers = 8,
     };
 
     Mutex mLock;
@@ -80,6 +89,7 @@ private:
     bool mStarted;
     int32_t mSampleRate;
     int32_t mOutSampleRate;
+    int64_t mCapturePeriodUs;
 
     bool mTrackMaxAmplitude;
     int64_t mStartTimeUs;
@@ -92,6 +102,10 @@ private:
 
     List<MediaBuffer * > mBuffersReceived;
 
+    // kMaxBufferSize buffers returned by the client, for reuse
+    List<MediaBuffer * > mFreeBuffers;
+    size_t mMaxFreeBuffers;
+
     void trackMaxAmplitude(int16_t *data, int nSamples);
 
     // This is used to raise the volume from mute to the
@@ -100,6 +114,18 @@ private:
         int32_t startFrame, int32_t rampDurationFrames,
         uint8_t *data,   size_t bytes);
 
+    MediaBuffer *acquireBuffer_l(size_t size);
+    void recycleBuffer_l(MediaBuffer *buffer);
+
+    // Collects everything AudioRecord has buffered, in capture period mode.
+    void captureData_l();
+
+    // Queues |buffer| (may be NULL), whose first sample was captured at
+    // timeUs, preceded by silence for any frames AudioRecord lost if
+    // checkLostFrames is set.
+    void queueCapturedData_l(
+            MediaBuffer *buffer, int64_t timeUs, bool checkLostFrames);
+
     void queueInputBuffer_l(MediaBuffer *buffer, int64_t timeUs);
     void releaseQueuedFrames_l();
     void waitOutstandingEncodingFrames_l();
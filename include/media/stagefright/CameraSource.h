@@ -209,6 +209,10 @@ private:
     void releaseQueuedFrames();
     void releaseOneRecordingFrame(const sp<IMemory>& frame);
 
+    // Queue a recording frame from dataCallbackTimestamp() for read().
+    // Returns false if the frame is dropped; the caller must release it.
+    bool queueFrameLocked(int64_t timestampUs, const sp<IMemory> &data);
+
 
     status_t init(const sp<ICamera>& camera, const sp<ICameraRecordingProxy>& proxy,
                   int32_t cameraId, const String16& clientName, uid_t clientUid,
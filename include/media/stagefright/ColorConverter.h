@@ -34,6 +34,16 @@ struct ColorConverter {
 
     bool isValid() const;
 
+    // Whether convert() can downscale from the source format.
+    bool supportsDownscaling() const;
+
+    // Splits the YUV 4:2:0 conversions into bands of rows converted on up to |numThreads|
+    // threads, the calling thread included. The default is 1.
+    void setNumThreads(size_t numThreads);
+
+    // The destination crop is either the size of the source crop, or for the YUV 4:2:0
+    // formats the source crop divided by a power of 2 up to 16. The source is then
+    // downscaled by averaging blocks of pixels.
     status_t convert(
             const void *srcBits,
             size_t srcWidth, size_t srcHeight,
@@ -60,11 +70,21 @@ private:
         size_t mCropLeft, mCropTop, mCropRight, mCropBottom;
     };
 
+    struct YUV420Image;
+
     OMX_COLOR_FORMATTYPE mSrcFormat, mDstFormat;
     uint8_t *mClip;
+    size_t mNumThreads;
 
     uint8_t *initClip();
 
+    void convertYUV420ToRGB565(const YUV420Image &image);
+    static void *ConvertYUV420Thread(void *image);
+    static void ConvertYUV420Rows(const YUV420Image &image);
+    static void ConvertYUV420RowsDownscaled(const YUV420Image &image);
+    static bool GetDownscaleShift(
+            const BitmapParams &src, const BitmapParams &dst, size_t *shift);
+
     status_t convertCbYCrY(
             const BitmapParams &src, const BitmapParams &dst);
 
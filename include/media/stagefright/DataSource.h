@@ -26,10 +26,12 @@
 #include <utils/List.h>
 #include <utils/RefBase.h>
 #include <utils/threads.h>
+#include <utils/Vector.h>
 #include <drm/DrmManagerClient.h>
 
 namespace android {
 
+struct ABuffer;
 struct AMessage;
 struct AString;
 class  IDataSource;
@@ -65,6 +67,13 @@ public:
     // beyond, the end of the source.
     virtual ssize_t readAt(off64_t offset, void *data, size_t size) = 0;
 
+    // Like readAt(), but appends the data to |views| as one or more read-only
+    // buffers, in order. Sources that keep data in memory hand out views of
+    // their own storage instead of copying it; by default the data is read
+    // into a single new buffer.
+    virtual ssize_t readAtViews(
+            off64_t offset, size_t size, Vector<sp<ABuffer> > *views);
+
     // Convenience methods:
     bool getUInt16(off64_t offset, uint16_t *x);
     bool getUInt24(off64_t offset, uint32_t *x); // 3 byte int, returned as a 32-bit int
@@ -105,6 +114,13 @@ public:
         return String8();
     }
 
+    // Returns a string identifying the current contents of a local file
+    // (device, inode, range and modification time), or an empty string if
+    // the source is not backed by a plain file.
+    virtual String8 getFileIdentity() {
+        return String8();
+    }
+
     virtual String8 getMIMEType() const;
 
 protected:
@@ -37,21 +37,41 @@ public:
 
     virtual ssize_t readAt(off64_t offset, void *data, size_t size);
 
+    virtual ssize_t readAtViews(
+            off64_t offset, size_t size, Vector<sp<ABuffer> > *views);
+
     virtual status_t getSize(off64_t *size);
 
     virtual sp<DecryptHandle> DrmInitialization(const char *mime);
 
     virtual void getDrmInfo(sp<DecryptHandle> &handle, DrmManagerClient **client);
 
+    virtual String8 getFileIdentity();
+
 protected:
     virtual ~FileSource();
 
 private:
+    struct MappedWindow;
+
     int mFd;
     int64_t mOffset;
     int64_t mLength;
     Mutex mLock;
 
+    // With media.stagefright.mmap-file-source set, reads are served from a
+    // sliding window of the file mapped into memory.
+    bool mMmapEnabled;
+    sp<MappedWindow> mWindow;
+    off64_t mNextReadOffset;
+    int32_t mNumSequentialReads;
+    off64_t mReadAheadOffset;
+
+    void initMmap();
+    const uint8_t *mapRange_l(off64_t offset, size_t size, sp<MappedWindow> *window);
+    bool mapWindow_l(off64_t start);
+    void adviseAccess_l(off64_t start, size_t size);
+
     /*for DRM*/
     sp<DecryptHandle> mDecryptHandle;
     DrmManagerClient *mDrmManagerClient;
@@ -58,9 +58,11 @@ struct FrameRenderTracker : public RefBase {
         ssize_t getIndex() const        { return mIndex; }
 
         // creates information for a queued frame
-        Info(int64_t mediaTimeUs, const sp<GraphicBuffer> &graphicBuffer, const sp<Fence> &fence)
+        Info(int64_t mediaTimeUs, const sp<GraphicBuffer> &graphicBuffer, const sp<Fence> &fence,
+                nsecs_t queueTimeNs)
             : mMediaTimeUs(mediaTimeUs),
               mRenderTimeNs(-1),
+              mQueueTimeNs(queueTimeNs),
               mIndex(-1),
               mGraphicBuffer(graphicBuffer),
               mFence(fence) {
@@ -70,6 +72,7 @@ struct FrameRenderTracker : public RefBase {
         Info(int64_t mediaTimeUs, nsecs_t renderTimeNs)
             : mMediaTimeUs(mediaTimeUs),
               mRenderTimeNs(renderTimeNs),
+              mQueueTimeNs(-1),
               mIndex(-1),
               mGraphicBuffer(NULL),
               mFence(NULL) {
@@ -78,6 +81,7 @@ struct FrameRenderTracker : public RefBase {
     private:
         int64_t mMediaTimeUs;
         nsecs_t mRenderTimeNs;
+        nsecs_t mQueueTimeNs;   // when the frame was queued; -1 for tunneled frames
         ssize_t mIndex;         // to be used by client
         sp<GraphicBuffer> mGraphicBuffer;
         sp<Fence> mFence;
@@ -85,8 +89,37 @@ struct FrameRenderTracker : public RefBase {
         friend class FrameRenderTracker;
     };
 
+    // Render quality statistics, accumulated over the lifetime of a component (across flushes).
+    struct Stats {
+        enum {
+            // queue-to-render latency buckets: [0, 1ms), [1, 2ms), [2, 4ms) ... [256ms, inf)
+            kNumLatencyBuckets = 10,
+        };
+
+        size_t mRenderedFrames;
+        size_t mDroppedOnDequeue;       // returned by the surface without being rendered
+        size_t mDroppedInvalidFence;    // render fence was invalid
+        size_t mDroppedIncomplete;      // not yet rendered when the client stopped waiting
+
+        // queue-to-render latency of non-tunneled frames
+        size_t mLatencyCount;
+        nsecs_t mLatencyMinNs;
+        nsecs_t mLatencyMaxNs;
+        nsecs_t mLatencySumNs;
+        size_t mLatencyBuckets[kNumLatencyBuckets];
+
+        // difference between consecutive render time deltas and media time deltas
+        size_t mJitterCount;
+        nsecs_t mJitterMaxNs;
+        nsecs_t mJitterSumNs;
+
+        Stats() { reset(); }
+        void reset();
+    };
+
     FrameRenderTracker();
 
+    // also resets the render statistics, as a new component name starts a new session
     void setComponentName(const AString &componentName);
 
     // clears all tracked frames, and resets last render time
@@ -125,6 +158,12 @@ struct FrameRenderTracker : public RefBase {
 
     void dumpRenderQueue() const;
 
+    // Returns the render statistics accumulated since the last setComponentName.
+    const Stats &getStats() const { return mStats; }
+
+    // Logs a summary of the render statistics, if any frames were tracked.
+    void dumpStats() const;
+
     virtual ~FrameRenderTracker();
 
 private:
@@ -135,6 +174,15 @@ private:
     nsecs_t mLastRenderTimeNs;
     AString mComponentName;
 
+    Stats mStats;
+    // last rendered frame seen by updateStats, for jitter; -1 if none since the last clear
+    nsecs_t mStatsLastRenderTimeNs;
+    int64_t mStatsLastMediaTimeUs;
+
+    // accounts for a frame returned by checkFencesAndGetRenderedFrames; frames without a render
+    // time were dropped, because of an |invalidFence| or because they were incomplete
+    void updateStats(const Info &info, bool invalidFence);
+
     DISALLOW_EVIL_CONSTRUCTORS(FrameRenderTracker);
 };
 
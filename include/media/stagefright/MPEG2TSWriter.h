@@ -48,9 +48,24 @@ protected:
 
 private:
     enum {
-        kWhatSourceNotify = 'noti'
+        kWhatSourceNotify = 'noti',
+        kWhatFlushOutput  = 'flus',
     };
 
+    enum {
+        kTSPacketSize = 188,
+
+        // Packets are collected into a buffer of this size (a whole number
+        // of packets, about 64KB) before being handed to the file or the
+        // write callback.
+        kOutputBufferSize = 348 * kTSPacketSize,
+    };
+
+    // The PCR is carried in adaptation field only packets on its own PID,
+    // at least this often.
+    static const unsigned kPCR_PID = 0x100;
+    static const int64_t kPCRIntervalUs = 40000ll;
+
     struct SourceInfo;
 
     FILE *mFile;
@@ -70,17 +85,26 @@ private:
     int64_t mNumTSPacketsBeforeMeta;
     int mPATContinuityCounter;
     int mPMTContinuityCounter;
+    int64_t mLastPCRTimeUs;
     uint32_t mCrcTable[256];
 
+    sp<ABuffer> mOutputBuffer;
+
     void init();
 
     void writeTS();
     void writeProgramAssociationTable();
     void writeProgramMap();
     void writeAccessUnit(int32_t sourceIndex, const sp<ABuffer> &buffer);
+    void writePCR(int64_t timeUs);
     void initCrcTable();
     uint32_t crc32(const uint8_t *start, size_t length);
 
+    // Returns the next kTSPacketSize bytes of the output buffer, filled
+    // with 0xff, flushing the buffer first if it is full.
+    uint8_t *appendPacket();
+    void flushOutput();
+
     ssize_t internalWrite(const void *data, size_t size);
     status_t reset();
 
@@ -23,6 +23,7 @@
 #include <media/stagefright/MediaWriter.h>
 #include <utils/List.h>
 #include <utils/threads.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -62,6 +63,7 @@ public:
     uint32_t interleaveDuration() const { return mInterleaveDurationUs; }
     status_t setInterleaveDuration(uint32_t duration);
     int32_t getTimeScale() const { return mTimeScale; }
+    bool isFragmented() const { return mFragmented; }
 
     status_t setGeoData(int latitudex10000, int longitudex10000);
     status_t setCaptureRate(float captureFps);
@@ -114,16 +116,29 @@ private:
     size_t numTracks();
     int64_t estimateMoovBoxSize(int32_t bitRate);
 
+    // Per sample information for the trun box of a movie fragment
+    struct FragmentSample {
+        uint32_t mDurationTicks;            // In the track time scale
+        int32_t  mCompositionOffsetTicks;   // Composition minus decoding time
+        bool     mIsSync;
+    };
+
     struct Chunk {
         Track               *mTrack;        // Owner
         int64_t             mTimeStampUs;   // Timestamp of the 1st sample
         List<MediaBuffer *> mSamples;       // Sample data
 
+        // Fragmented mode only: decoding time of the 1st sample in the
+        // track time scale and one entry for each of mSamples
+        int64_t                 mDecodingTimeTicks;
+        Vector<FragmentSample>  mFragmentSamples;
+
         // Convenient constructor
-        Chunk(): mTrack(NULL), mTimeStampUs(0) {}
+        Chunk(): mTrack(NULL), mTimeStampUs(0), mDecodingTimeTicks(0) {}
 
         Chunk(Track *track, int64_t timeUs, List<MediaBuffer *> samples)
-            : mTrack(track), mTimeStampUs(timeUs), mSamples(samples) {
+            : mTrack(track), mTimeStampUs(timeUs), mSamples(samples),
+              mDecodingTimeTicks(0) {
         }
 
     };
@@ -137,6 +152,11 @@ private:
         // Max time interval between neighboring chunks
         int64_t mMaxInterChunkDurUs;
 
+        // Backpressure from the file writer: chunks currently queued, the
+        // most ever queued, and the longest write that included this track
+        size_t mQueuedChunks;
+        size_t mMaxQueuedChunks;
+        int64_t mMaxWriteTimeUs;
     };
 
     bool            mIsFirstChunk;
@@ -161,8 +181,35 @@ private:
     // Return true if a chunk is found; otherwise, return false.
     bool findChunkToWrite(Chunk *chunk);
 
-    // Actually write the given chunk to the file.
-    void writeChunkToFile(Chunk* chunk);
+    // Write the given chunks to the file, coalescing their samples into as
+    // few writev() calls as possible.
+    void writeChunksToFile(List<Chunk> *chunks);
+
+    // Record how long the write of the given chunks took
+    void updateWriteStats_l(const List<Chunk> &chunks, int64_t writeTimeUs);
+
+    // Optional preallocation of the file ahead of the write offset, see
+    // kPreallocationProperty
+    off64_t mPreallocationSize;
+    off64_t mPreallocatedOffset;
+    void preallocate(off64_t endOffset);
+
+    // Faststart: if the moov box outgrows the space reserved for it, move
+    // the mdat up instead of writing the moov at the end of the file, see
+    // kFaststartProperty
+    bool mFaststart;
+    size_t mMoovBoxBufferSize;
+    bool relocateMdat(off64_t delta);
+
+    // Fragmented mode: a moov box without samples goes out ahead of the
+    // first chunk, then every chunk is written as its own moof/mdat pair,
+    // see kKeyFragmentDurationUs
+    bool mFragmented;
+    bool mFragmentedMoovWritten;
+    uint32_t mFragmentSequenceNumber;
+    bool canWriteChunks_l();
+    size_t writeFragmentHeader(const Chunk &chunk, uint8_t *data);
+    void writeMvexBox();
 
     // Adjust other track media clock (presumably wall clock)
     // based on audio track media clock with the drift time.
@@ -54,6 +54,7 @@ public:
 
     // pushBuffer() will wait for the read() finish, and read() will have a
     // deep copy, such that after pushBuffer return, the buffer can be re-used.
+    // Buffers pushed concurrently from several threads are handed over one at a time.
     status_t pushBuffer(MediaBuffer *buffer);
 
 private:
@@ -64,6 +65,8 @@ private:
     Condition mBufferReturnedCond;
 
     MediaBuffer *mCurrentMediaBuffer;
+    // A pushed buffer has not been returned yet.
+    bool mBufferPending;
 
     bool mStarted;
     sp<MetaData> mOutputFormat;
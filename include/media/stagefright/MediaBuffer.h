@@ -100,6 +100,7 @@ private:
 
     MediaBufferObserver *mObserver;
     MediaBuffer *mNextBuffer;
+    MediaBuffer *mNextFree; // free list link of the owning MediaBufferGroup
     int mRefCount;
 
     void *mData;
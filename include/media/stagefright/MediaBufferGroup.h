@@ -29,7 +29,9 @@ class MetaData;
 
 class MediaBufferGroup : public MediaBufferObserver {
 public:
-    MediaBufferGroup();
+    // A group with a growth limit allocates buffers on demand, up to that
+    // many in total, for requests with a requestedSize (see acquire_buffer).
+    MediaBufferGroup(size_t growthLimit = 0);
     ~MediaBufferGroup();
 
     void add_buffer(MediaBuffer *buffer);
@@ -39,7 +41,17 @@ public:
     // The returned buffer will have a reference count of 1.
     // If nonBlocking is true and a buffer is not immediately available,
     // buffer is set to NULL and it returns WOULD_BLOCK.
-    status_t acquire_buffer(MediaBuffer **buffer, bool nonBlocking = false);
+    // If requestedSize is not 0, only buffers of at least that size are
+    // handed out, the smallest one that fits first. A growing group makes
+    // room for a request that no buffer fits by allocating a new buffer,
+    // possibly replacing a smaller free one once the limit is reached.
+    status_t acquire_buffer(
+            MediaBuffer **buffer, bool nonBlocking = false, size_t requestedSize = 0);
+
+    // Like the blocking acquire_buffer(), but gives up and returns TIMED_OUT
+    // after timeoutUs.
+    status_t acquire_buffer_timed(
+            MediaBuffer **buffer, int64_t timeoutUs, size_t requestedSize = 0);
 
 protected:
     virtual void signalBufferReturned(MediaBuffer *buffer);
@@ -47,10 +59,27 @@ protected:
 private:
     friend class MediaBuffer;
 
+    // Returned buffers are pushed onto mReturnedBuffers without taking
+    // mLock, acquirers move them over to mFreeBuffers under mLock. mLock
+    // is only taken on return if an acquirer is waiting.
+    MediaBuffer * volatile mReturnedBuffers;
+    volatile int32_t mNumWaiters;
+
     Mutex mLock;
     Condition mCondition;
 
     MediaBuffer *mFirstBuffer, *mLastBuffer;
+    MediaBuffer *mFreeBuffers;
+    size_t mNumBuffers;
+    size_t mGrowthLimit;
+
+    status_t acquireBuffer(
+            MediaBuffer **buffer, bool nonBlocking, int64_t timeoutUs,
+            size_t requestedSize);
+    void addBuffer_l(MediaBuffer *buffer);
+    void removeBuffer_l(MediaBuffer *buffer);
+    MediaBuffer *takeFreeBuffer_l(size_t requestedSize);
+    MediaBuffer *grow_l(size_t requestedSize);
 
     MediaBufferGroup(const MediaBufferGroup &);
     MediaBufferGroup &operator=(const MediaBufferGroup &);
@@ -58,19 +58,30 @@ protected:
     virtual ~MediaClock();
 
 private:
-    status_t getMediaTime_l(
+    struct State {
+        int64_t mAnchorTimeMediaUs;
+        int64_t mAnchorTimeRealUs;
+        int64_t mMaxTimeMediaUs;
+        int64_t mStartingTimeMediaUs;
+        float mPlaybackRate;
+    };
+
+    static status_t GetMediaTime(
+            const State &state,
             int64_t realUs,
             int64_t *outMediaUs,
-            bool allowPastMaxTime) const;
+            bool allowPastMaxTime);
 
-    mutable Mutex mLock;
-
-    int64_t mAnchorTimeMediaUs;
-    int64_t mAnchorTimeRealUs;
-    int64_t mMaxTimeMediaUs;
-    int64_t mStartingTimeMediaUs;
+    // Readers do not take mLock: writers serialize on it and publish mState
+    // under the sequence count mSeq (odd while an update is in progress),
+    // and readers retry until they copy a consistent snapshot.
+    void beginUpdate_l();
+    void endUpdate_l();
+    void readState(State *state) const;
 
-    float mPlaybackRate;
+    mutable Mutex mLock;
+    volatile int32_t mSeq;
+    State mState;
 
     DISALLOW_EVIL_CONSTRUCTORS(MediaClock);
 };
@@ -125,6 +125,32 @@ struct MediaCodec : public AHandler {
 
     status_t dequeueInputBuffer(size_t *index, int64_t timeoutUs = 0ll);
 
+    // One buffer of queueInputBuffers() or dequeueOutputBuffers().
+    struct BatchBuffer {
+        size_t mIndex;
+        size_t mOffset;
+        size_t mSize;
+        int64_t mPresentationTimeUs;
+        uint32_t mFlags;
+    };
+
+    // Queues count input buffers in a single round-trip to the codec looper,
+    // in order. Stops at the first buffer that fails to queue and returns its
+    // error; numQueued is the number of buffers queued before it.
+    status_t queueInputBuffers(
+            const BatchBuffer *buffers,
+            size_t count,
+            size_t *numQueued,
+            AString *errorDetailMsg = NULL);
+
+    // Like dequeueOutputBuffer(), but once a buffer is available also takes
+    // up to maxCount - 1 more that are already available, without waiting.
+    status_t dequeueOutputBuffers(
+            BatchBuffer *buffers,
+            size_t maxCount,
+            size_t *count,
+            int64_t timeoutUs = 0ll);
+
     status_t dequeueOutputBuffer(
             size_t *index,
             size_t *offset,
@@ -210,6 +236,7 @@ private:
         kWhatRelease                        = 'rele',
         kWhatDequeueInputBuffer             = 'deqI',
         kWhatQueueInputBuffer               = 'queI',
+        kWhatQueueInputBuffers              = 'qIBs',
         kWhatDequeueOutputBuffer            = 'deqO',
         kWhatReleaseOutputBuffer            = 'relO',
         kWhatSignalEndOfInputStream         = 'eois',
@@ -319,7 +346,26 @@ private:
     // stop/flush/reset/release.
     Mutex mBufferLock;
 
-    List<size_t> mAvailPortBuffers[2];
+    // Indices of the buffers the codec handed to us, oldest first. An index
+    // is queued at most once, so a ring with one slot per port buffer holds
+    // them all without allocating per buffer.
+    struct AvailableBuffers {
+        AvailableBuffers() : mHead(0), mCount(0) {}
+
+        void setCapacity(size_t capacity);
+        bool empty() const { return mCount == 0; }
+        size_t size() const { return mCount; }
+        void push(size_t index);
+        size_t pop();
+        void clear() { mHead = mCount = 0; }
+
+    private:
+        Vector<size_t> mSlots;
+        size_t mHead;
+        size_t mCount;
+    };
+
+    AvailableBuffers mAvailPortBuffers[2];
     Vector<BufferInfo> mPortBuffers[2];
 
     int32_t mDequeueInputTimeoutGeneration;
@@ -327,6 +373,9 @@ private:
 
     int32_t mDequeueOutputTimeoutGeneration;
     sp<AReplyToken> mDequeueOutputReplyID;
+    // client array of the current dequeueOutputBuffers() request, or NULL
+    BatchBuffer *mDequeueOutputBatch;
+    size_t mDequeueOutputBatchSize;
 
     sp<ICrypto> mCrypto;
 
@@ -360,6 +409,7 @@ private:
 
     bool handleDequeueInputBuffer(const sp<AReplyToken> &replyID, bool newRequest = false);
     bool handleDequeueOutputBuffer(const sp<AReplyToken> &replyID, bool newRequest = false);
+    void takeOutputBuffer(size_t index, BatchBuffer *buffer);
     void cancelPendingDequeueOperations();
 
     void extractCSD(const sp<AMessage> &format);
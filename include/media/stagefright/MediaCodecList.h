@@ -97,6 +97,9 @@ private:
     sp<AMessage> mGlobalSettings;
     KeyedVector<AString, CodecSettings> mOverrides;
 
+    // every xml file parsed (or attempted), to validate the cache against
+    Vector<AString> mParsedFiles;
+
     Vector<sp<MediaCodecInfo> > mCodecInfos;
     sp<MediaCodecInfo> mCurrentInfo;
     sp<IOMX> mOMX;
@@ -107,6 +110,10 @@ private:
     status_t initCheck() const;
     void parseXMLFile(const char *path);
 
+    bool loadCache();
+    void writeCache() const;
+    void configureResourcePolicies();
+
     static void StartElementHandlerWrapper(
             void *me, const char *name, const char **attrs);
 
@@ -20,6 +20,7 @@
 #include <media/stagefright/foundation/ABase.h>
 #include <media/stagefright/foundation/AHandlerReflector.h>
 #include <media/stagefright/MediaSource.h>
+#include <utils/KeyedVector.h>
 
 namespace android {
 
@@ -75,6 +76,7 @@ private:
         kWhatStart,
         kWhatStop,
         kWhatPause,
+        kWhatReleaseOutputBuffer,
     };
 
     MediaCodecSource(
@@ -102,6 +104,8 @@ private:
     sp<MetaData> mMeta;
     sp<Puller> mPuller;
     sp<MediaCodec> mEncoder;
+    // released encoder kept alive until its wrapped output buffers return
+    sp<MediaCodec> mReleasingEncoder;
     uint32_t mFlags;
     List<sp<AReplyToken>> mStopReplyIDQueue;
     bool mIsVideo;
@@ -117,6 +121,7 @@ private:
     List<MediaBuffer *> mInputBufferQueue;
     List<size_t> mAvailEncoderInputIndices;
     List<int64_t> mDecodingTimeQueue; // decoding time (us) for video
+    size_t mNumEncoderOutputBuffers; // lower bound, from the indices seen
 
     // audio drift time
     int64_t mFirstSampleTimeUs;
@@ -126,6 +131,8 @@ private:
     Mutex mOutputBufferLock;
     Condition mOutputBufferCond;
     List<MediaBuffer*> mOutputBufferQueue;
+    // output buffers handed out without a copy, and their codec buffer index
+    KeyedVector<MediaBuffer *, size_t> mWrappedOutputIndices;
     bool mEncoderReachedEOS;
     status_t mErrorCode;
 
@@ -97,6 +97,16 @@ extern const char *MEDIA_MIMETYPE_AUDIO_APE;
 extern const char *MEDIA_MIMETYPE_TEXT_SRT;
 extern const char *MEDIA_MIMETYPE_TEXT_SSA;
 extern const char *MEDIA_MIMETYPE_TEXT_ASS;
+
+// These values need to be in sync with the encodings in
+// frameworks/base/media/java/android/media/AudioFormat.java, which are not
+// defined anywhere in frameworks/av.
+enum AudioEncoding {
+    kAudioEncodingPcm16bit = 2,
+    kAudioEncodingPcm8bit = 3,
+    kAudioEncodingPcmFloat = 4,
+};
+
 }  // namespace android
 
 #endif  // MEDIA_DEFS_H_
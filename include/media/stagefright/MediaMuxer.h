@@ -88,6 +88,15 @@ public:
      */
     status_t setLocation(int latitude, int longitude);
 
+    /**
+     * Write a fragmented file, for .mp4 output only.
+     * @param durationUs The minimum duration of each movie fragment in
+     * microseconds. Video fragments start at a sync frame. 0 writes a
+     * file with a single moov box, which is the default.
+     * @return OK if no error.
+     */
+    status_t setFragmentDuration(int64_t durationUs);
+
     /**
      * Stop muxing.
      * This method is a blocking call. Depending on how
@@ -113,6 +113,10 @@ enum {
     kKey64BitFileOffset   = 'fobt',  // int32_t (bool)
     kKey2ByteNalLength    = '2NAL',  // int32_t (bool)
 
+    // Set this key to author a fragmented file, one moof/mdat pair per
+    // fragment of (at least) the given duration
+    kKeyFragmentDurationUs = 'frdu', // int64_t
+
     // Identify the file output format for authoring
     // Please see <media/mediarecorder.h> for the supported
     // file output formats.
@@ -192,6 +196,21 @@ enum {
     kKeyIsEndianBig             = 'edbg', //bool (int32_t)
     kKeySpecialThumbnail            = 'sThb',//int32_t
 
+    // Set in a source's format if the MediaBuffers it returns from read()
+    // may be held by the consumer indefinitely, i.e. they do not tie up
+    // buffers of the producer.
+    kKeyCanRetainOutputBuffers  = 'retn', // bool (int32_t)
+
+    // Set in a source's format if its read() honors
+    // ReadOptions::setNonBlocking(), returning WOULD_BLOCK instead of
+    // waiting for the next buffer.
+    kKeySupportsNonBlockingRead = 'nblk', // bool (int32_t)
+
+    // Sample encoding of raw PCM audio, one of the AudioEncoding values
+    // in MediaDefs.h. Also passed to MediaSource::start() to ask a source
+    // for a particular output encoding.
+    kKeyPcmEncoding             = 'PCMe', // int32_t
+
 };
 
 enum {
@@ -248,6 +267,11 @@ public:
 
     bool hasData(uint32_t key) const;
 
+    // Returns a stamp identifying the current contents of this object. It is
+    // unique within the process and changes whenever an item is set, removed
+    // or cleared, so (object, generation) can key caches of derived data.
+    uint32_t generation() const;
+
     void dumpToLog() const;
 
 protected:
@@ -270,9 +294,11 @@ private:
         uint32_t mType;
         size_t mSize;
 
+        // Values up to 16 bytes (including rects, pointers and short
+        // strings) are stored inline.
         union {
             void *ext_data;
-            float reservoir;
+            int64_t reservoir[2];
         } u;
 
         bool usesReservoir() const {
@@ -283,11 +309,11 @@ private:
         void freeStorage();
 
         void *storage() {
-            return usesReservoir() ? &u.reservoir : u.ext_data;
+            return usesReservoir() ? u.reservoir : u.ext_data;
         }
 
         const void *storage() const {
-            return usesReservoir() ? &u.reservoir : u.ext_data;
+            return usesReservoir() ? u.reservoir : u.ext_data;
         }
     };
 
@@ -295,8 +321,32 @@ private:
         int32_t mLeft, mTop, mRight, mBottom;
     };
 
+    struct InlineItem {
+        uint32_t mKey;
+        typed_data mData;
+    };
+
+    enum {
+        // Per-sample metadata (time, sync flag, duration...) rarely has more
+        // entries than this; these live in the object and clear() keeps them
+        // allocation free.
+        kMaxInlineItems = 6,
+    };
+
+    // The first kMaxInlineItems keys set are stored in mInlineItems, in no
+    // particular order; further keys go to mItems, which is shared
+    // copy-on-write between copies of this MetaData.
+    InlineItem mInlineItems[kMaxInlineItems];
+    size_t mNumInlineItems;
+
     KeyedVector<uint32_t, typed_data> mItems;
 
+    // 0 until generation() is called after a modification
+    mutable uint32_t mGeneration;
+
+    ssize_t indexOfInlineKey(uint32_t key) const;
+    const typed_data *findItem(uint32_t key) const;
+
     // MetaData &operator=(const MetaData &);
 };
 
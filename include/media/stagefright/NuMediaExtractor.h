@@ -43,6 +43,14 @@ struct NuMediaExtractor : public RefBase {
         SAMPLE_FLAG_ENCRYPTED   = 2,
     };
 
+    struct SampleInfo {
+        size_t mOffset;     // offset of the sample data in the batch buffer
+        size_t mSize;
+        int64_t mTimeUs;
+        size_t mTrackIndex;
+        uint32_t mFlags;    // bitmask of "SampleFlags"
+    };
+
     NuMediaExtractor();
 
     status_t setDataSource(
@@ -73,6 +81,16 @@ struct NuMediaExtractor : public RefBase {
     status_t getSampleTime(int64_t *sampleTimeUs);
     status_t getSampleMeta(sp<MetaData> *sampleMeta);
 
+    // Reads up to maxSamples consecutive samples into buffer, back to back, and
+    // advances past them, in the same order as readSampleData() and advance().
+    // Stops early at the first sample that does not fit, at an encrypted sample (whose
+    // crypto info must be read through getSampleMeta()), or at the end of the stream.
+    // Returns ERROR_END_OF_STREAM if no sample is left, -ENOMEM if the first sample does
+    // not fit, and ERROR_UNSUPPORTED if the first sample is encrypted.
+    status_t readSampleDataBatch(
+            const sp<ABuffer> &buffer, SampleInfo *infos, size_t maxSamples,
+            size_t *numSamples);
+
     bool getCachedDuration(int64_t *durationUs, bool *eos) const;
 
 protected:
@@ -83,8 +101,16 @@ private:
         kIsVorbis       = 1,
     };
 
+    enum {
+        // samples read ahead per track when more than one track is selected
+        kMaxPrefetchedSamples = 16,
+    };
+
+    struct SamplePrefetcher;
+
     struct TrackInfo {
         sp<MediaSource> mSource;
+        sp<SamplePrefetcher> mPrefetcher;
         size_t mTrackIndex;
         status_t mFinalResult;
         MediaBuffer *mSample;
@@ -110,6 +136,10 @@ private:
                 MediaSource::ReadOptions::SEEK_CLOSEST_SYNC);
 
     void releaseTrackSamples();
+    void stopPrefetching(TrackInfo *info);
+
+    status_t copySampleData(const TrackInfo &info, uint8_t *dst, size_t capacity,
+            size_t *sampleSize) const;
 
     bool getTotalBitrate(int64_t *bitRate) const;
     void updateDurationAndBitrate();
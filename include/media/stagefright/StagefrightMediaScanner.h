@@ -19,6 +19,9 @@
 #define STAGEFRIGHT_MEDIA_SCANNER_H_
 
 #include <media/mediascanner.h>
+#include <utils/KeyedVector.h>
+#include <utils/RefBase.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -33,12 +36,37 @@ struct StagefrightMediaScanner : public MediaScanner {
     virtual MediaAlbumArt *extractAlbumArt(int fd);
 
 private:
+    struct Metadata;
+    struct Worker;
+
     StagefrightMediaScanner(const StagefrightMediaScanner &);
     StagefrightMediaScanner &operator=(const StagefrightMediaScanner &);
 
+    // With media.stagefright.scanner-threads set, the metadata of the files
+    // following the one being processed in its directory is retrieved ahead
+    // of time on that many worker threads. The client still sees the same
+    // calls in the same order, on the calling thread.
+    Mutex mLock;
+    Condition mCondition;
+    Vector<sp<Worker> > mWorkers;
+    size_t mNumWorkers;
+    bool mStopping;
+    KeyedVector<String8, sp<Metadata> > mLookahead;
+    List<sp<Metadata> > mQueue;
+
+    // cached listing of the directory the last processed file was in
+    String8 mListedDir;
+    Vector<String8> mListedFiles;
+    size_t mListedPos;
+
     MediaScanResult processFileInternal(
             const char *path, const char *mimeType,
             MediaScannerClient &client);
+
+    sp<Metadata> getMetadata(const char *path);
+    void scheduleLookahead_l(const char *path);
+    void listDirectory_l(const String8 &dir);
+    bool runJob();
 };
 
 }  // namespace android
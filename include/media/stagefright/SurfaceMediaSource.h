@@ -156,9 +156,19 @@ private:
     struct SlotData {
         sp<GraphicBuffer> mGraphicBuffer;
         uint64_t mFrameNumber;
+        // mMediaBuffer is the metadata wrapper handed to the encoder for this
+        // slot. It is allocated the first time the slot is read and reused
+        // for every later frame acquired into the same slot.
+        MediaBuffer *mMediaBuffer;
+        // mAcquiredBuffer holds the graphic buffer being used by the buffer
+        // consumer (i.e. the video encoder), since onBuffersReleased may drop
+        // mGraphicBuffer while the encoder still has it. Set in read, and
+        // cleared in signalBufferReturned.
+        sp<GraphicBuffer> mAcquiredBuffer;
     };
 
-    // mSlots caches GraphicBuffers and frameNumbers from the buffer queue
+    // mSlots caches GraphicBuffers, frameNumbers and MediaBuffer wrappers
+    // from the buffer queue
     SlotData mSlots[BufferQueue::NUM_BUFFER_SLOTS];
 
     // The permenent width and height of SMS buffers
@@ -176,13 +186,6 @@ private:
     // reset mCurrentTexture to INVALID_BUFFER_SLOT.
     int mCurrentSlot;
 
-    // mCurrentBuffers is a list of the graphic buffers that are being used by
-    // buffer consumer (i.e. the video encoder). It's possible that these
-    // buffers are not associated with any buffer slots, so we must track them
-    // separately.  Buffers are added to this list in read, and removed from
-    // this list in signalBufferReturned
-    Vector<sp<GraphicBuffer> > mCurrentBuffers;
-
     size_t mNumPendingBuffers;
 
 #if DEBUG_PENDING_BUFFERS
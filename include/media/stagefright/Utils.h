@@ -43,6 +43,9 @@ uint64_t hton64(uint64_t x);
 
 class MetaData;
 struct AMessage;
+// Results are cached per MetaData generation; the returned message is the
+// caller's own, but its "csd-*" buffers are shared and must be treated as
+// read-only.
 status_t convertMetaDataToMessage(
         const sp<MetaData> &meta, sp<AMessage> *format);
 void convertMessageToMetaData(
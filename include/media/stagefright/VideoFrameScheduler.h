@@ -24,6 +24,7 @@
 
 namespace android {
 
+struct AMessage;
 class ISurfaceComposer;
 
 struct VideoFrameScheduler : public RefBase {
@@ -42,6 +43,14 @@ struct VideoFrameScheduler : public RefBase {
     // returns the current frames-per-second, or 0.f if not primed
     float getFrameRate();
 
+    // account for a frame scheduled for renderTime that was handed to the
+    // display at releaseTime, or that was dropped for being too late
+    void onFrameReleased(nsecs_t renderTime, nsecs_t releaseTime);
+    void onFrameDropped();
+
+    // adds frame release and cadence histograms to stats
+    void getStats(const sp<AMessage> &stats) const;
+
     void release();
 
     static const size_t kHistorySize = 8;
@@ -83,6 +92,16 @@ private:
 
     void updateVsync();
 
+    enum {
+        kReleasedEarly,         // more than 3 VSYNCs ahead of render time
+        kReleasedOnTime,        // 1-3 VSYNCs ahead of render time
+        kReleasedLate,          // less than a VSYNC ahead of render time
+        kReleasedAfterDue,      // after render time
+        kNumReleaseBuckets,
+    };
+
+    static const size_t kMaxCadenceVsyncs = 5;
+
     nsecs_t mVsyncTime;        // vsync timing from display
     nsecs_t mVsyncPeriod;
     nsecs_t mVsyncRefreshAt;   // next time to refresh timing info
@@ -92,6 +111,12 @@ private:
 
     PLL mPll;                  // PLL for video frame rate based on render time
 
+    int64_t mReleaseHistogram[kNumReleaseBuckets];
+    // number of frames held on the display for N VSYNCs (last bucket is N or more),
+    // e.g. alternating 3 and 2 for 24fps on 60Hz
+    int64_t mCadenceHistogram[kMaxCadenceVsyncs + 1];
+    int64_t mNumFramesDropped;
+
     sp<ISurfaceComposer> mComposer;
 
     DISALLOW_EVIL_CONSTRUCTORS(VideoFrameScheduler);
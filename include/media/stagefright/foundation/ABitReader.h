@@ -30,9 +30,22 @@ public:
     ABitReader(const uint8_t *data, size_t size);
     virtual ~ABitReader();
 
-    uint32_t getBits(size_t n);
+    inline uint32_t getBits(size_t n) {
+        if (n > 0 && n <= 32 && n <= mNumBitsLeft) {
+            uint32_t result = mReservoir >> (64 - n);
+            mReservoir <<= n;
+            mNumBitsLeft -= n;
+            return result;
+        }
+        return getBitsSlow(n);
+    }
+
     void skipBits(size_t n);
 
+    // Exp-Golomb coded unsigned and signed integers, ue(v) and se(v).
+    uint32_t getUE();
+    int32_t getSE();
+
     void putBits(uint32_t x, size_t n);
 
     size_t numBitsLeft() const;
@@ -43,14 +56,18 @@ protected:
     const uint8_t *mData;
     size_t mSize;
 
-    uint32_t mReservoir;  // left-aligned bits
+    uint64_t mReservoir;  // left-aligned bits, the bits below them are 0
     size_t mNumBitsLeft;
 
     virtual void fillReservoir();
 
+private:
+    uint32_t getBitsSlow(size_t n);
+
     DISALLOW_EVIL_CONSTRUCTORS(ABitReader);
 };
 
+// Skips the emulation_prevention_three_byte of H.264/HEVC NAL unit payloads.
 class NALBitReader : public ABitReader {
 public:
     NALBitReader(const uint8_t *data, size_t size);
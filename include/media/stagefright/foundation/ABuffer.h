@@ -46,6 +46,11 @@ struct ABuffer : public RefBase {
     // create buffer from dup of some memory block
     static sp<ABuffer> CreateAsCopy(const void *data, size_t capacity);
 
+    // Returns a buffer that shares the given sub-range of this buffer's
+    // current range without copying. The slice keeps this buffer alive;
+    // while it exists, neither buffer may overwrite the other's bytes.
+    sp<ABuffer> slice(size_t offset, size_t size);
+
     void setInt32Data(int32_t data) { mInt32Data = data; }
     int32_t int32Data() const { return mInt32Data; }
 
@@ -60,6 +65,7 @@ protected:
 private:
     sp<AMessage> mFarewell;
     sp<AMessage> mMeta;
+    sp<ABuffer> mParent;    // owner of mData if this is a slice
 
     MediaBufferBase *mMediaBufferBase;
 
@@ -21,6 +21,7 @@
 #include <media/stagefright/foundation/ALooper.h>
 #include <utils/KeyedVector.h>
 #include <utils/RefBase.h>
+#include <utils/threads.h>
 
 namespace android {
 
@@ -67,7 +68,10 @@ private:
 
     bool mVerboseStats;
     uint32_t mMessageCounter;
-    KeyedVector<uint32_t, uint32_t> mMessages;
+
+    // handling time per message what, only collected with verbose stats
+    Mutex mStatsLock;
+    KeyedVector<uint32_t, ALooper::DurationStats> mMessages;
 
     void deliverMessage(const sp<AMessage> &msg);
 
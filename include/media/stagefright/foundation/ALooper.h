@@ -24,6 +24,7 @@
 #include <utils/KeyedVector.h>
 #include <utils/List.h>
 #include <utils/RefBase.h>
+#include <utils/Vector.h>
 #include <utils/threads.h>
 
 namespace android {
@@ -58,6 +59,36 @@ struct ALooper : public RefBase {
         return mName.c_str();
     }
 
+    // Durations counted in power of two millisecond buckets, < 1ms to >= 64ms.
+    struct DurationStats {
+        enum {
+            kNumBuckets = 8,
+        };
+
+        DurationStats() {
+            clear();
+        }
+
+        void add(int64_t durationUs);
+        void clear();
+
+        uint32_t mCount;
+        int64_t mTotalUs;
+        int64_t mMaxUs;
+        uint32_t mBuckets[kNumBuckets];
+    };
+
+    struct Stats {
+        size_t mQueueDepth;
+        size_t mMaxQueueDepth;
+        // how late messages were delivered, relative to when they were due
+        DurationStats mLatency;
+    };
+
+    // Returns the queue statistics since the looper started or since the
+    // last call that cleared them.
+    void getStats(Stats *stats, bool clear = false);
+
 protected:
     virtual ~ALooper();
 
@@ -66,6 +97,7 @@ private:
 
     struct Event {
         int64_t mWhenUs;
+        uint64_t mSeq;      // orders events with the same mWhenUs
         sp<AMessage> mMessage;
     };
 
@@ -74,7 +106,17 @@ private:
 
     AString mName;
 
-    List<Event> mEventQueue;
+    // messages posted without a delay, in posting (and so mWhenUs) order
+    List<Event> mImmediateQueue;
+    // delayed messages, a binary min-heap ordered by mWhenUs, then mSeq
+    Vector<Event> mTimedQueue;
+    uint64_t mNextSeq;
+    // when the waiting loop() wakes up on its own (INT64_MAX: never), -1 if
+    // loop() is not waiting; post() only signals for events due before that
+    int64_t mWakeUpUs;
+
+    size_t mMaxQueueDepth;
+    DurationStats mLatency;
 
     struct LooperThread;
     sp<LooperThread> mThread;
@@ -103,6 +145,9 @@ private:
 
     bool loop();
 
+    void pushTimedEvent_l(const Event &event);
+    void popTimedEvent_l(Event *event);
+
     DISALLOW_EVIL_CONSTRUCTORS(ALooper);
 };
 
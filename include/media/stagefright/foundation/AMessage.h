@@ -149,6 +149,10 @@ struct AMessage : public RefBase {
 protected:
     virtual ~AMessage();
 
+    // Messages are recycled through small per-thread free lists.
+    static void *operator new(size_t size);
+    static void operator delete(void *ptr, size_t size);
+
 private:
     friend struct ALooper; // deliver()
 
@@ -176,10 +180,13 @@ private:
             AString *stringValue;
             Rect rectValue;
         } u;
-        const char *mName;
-        size_t      mNameLength;
+        const char *mName;      // mInlineName or allocated
+        uint32_t    mNameLength;
+        uint32_t    mNameHash;
         Type mType;
-        void setName(const char *name, size_t len);
+        char mInlineName[16];
+        void setName(const char *name, size_t len, uint32_t hash);
+        void freeName();
     };
 
     enum {
@@ -195,7 +202,7 @@ private:
     void setObjectInternal(
             const char *name, const sp<RefBase> &obj, Type type);
 
-    size_t findItemIndex(const char *name, size_t len) const;
+    size_t findItemIndex(const char *name, size_t len, uint32_t hash) const;
 
     void deliver();
 
@@ -20,19 +20,24 @@
 
 #include <media/stagefright/foundation/ABase.h>
 #include <utils/KeyedVector.h>
+#include <utils/List.h>
 #include <utils/RefBase.h>
 #include <utils/Thread.h>
+#include <utils/Vector.h>
 
 #include <netinet/in.h>
 
 namespace android {
 
+struct ABuffer;
 struct AMessage;
 
 // Helper class to manage a number of live sockets (datagram and stream-based)
-// on a single thread. Clients are notified about activity through AMessages.
+// on one or more threads. Clients are notified about activity through AMessages.
 struct ANetworkSession : public RefBase {
-    ANetworkSession();
+    // The sessions are spread over |numThreads| threads by session ID, each waiting
+    // on its own epoll instance.
+    ANetworkSession(size_t numThreads = 1);
 
     status_t start();
     status_t stop();
@@ -77,6 +82,13 @@ struct ANetworkSession : public RefBase {
             int32_t sessionID, const void *data, ssize_t size = -1,
             bool timeValid = false, int64_t timeUs = -1ll);
 
+    // Queues |datagrams| at once. UDP sessions keep references to the buffers instead of
+    // copying them, so they must not change afterwards. |timeValid| and |timeUs| describe
+    // the last datagram.
+    status_t sendDatagrams(
+            int32_t sessionID, const List<sp<ABuffer> > &datagrams,
+            bool timeValid = false, int64_t timeUs = -1ll);
+
     status_t switchToWebSocketMode(int32_t sessionID);
 
     enum NotificationReason {
@@ -96,15 +108,12 @@ protected:
 private:
     struct NetworkThread;
     struct Session;
+    struct Shard;
 
-    Mutex mLock;
-    sp<Thread> mThread;
-
-    int32_t mNextSessionID;
+    Vector<sp<Shard> > mShards;
+    bool mStarted;
 
-    int mPipeFd[2];
-
-    KeyedVector<int32_t, sp<Session> > mSessions;
+    volatile int32_t mNextSessionID;
 
     enum Mode {
         kModeCreateUDPSession,
@@ -122,8 +131,15 @@ private:
             const sp<AMessage> &notify,
             int32_t *sessionID);
 
-    void threadLoop();
-    void interrupt();
+    const sp<Shard> &shardFor(int32_t sessionID) const;
+    status_t startShard(const sp<Shard> &shard);
+    void stopShard(const sp<Shard> &shard);
+
+    void addSession(const sp<Session> &session);
+    void updateEvents(const sp<Shard> &shard, const sp<Session> &session);
+
+    void threadLoop(const sp<Shard> &shard);
+    void interrupt(const sp<Shard> &shard);
 
     static status_t MakeSocketNonBlocking(int s);
 
@@ -26,6 +26,7 @@ struct ABuffer;
 struct AString;
 
 sp<ABuffer> decodeBase64(const AString &s);
+sp<ABuffer> decodeBase64(const char *s, size_t n);
 void encodeBase64(const void *data, size_t size, AString *out);
 
 }  // namespace android
@@ -48,8 +48,64 @@ struct AMediaCodecBufferInfo {
     uint32_t flags;
 };
 typedef struct AMediaCodecBufferInfo AMediaCodecBufferInfo;
+
+struct AMediaCodecBatchBuffer {
+    size_t index;
+    AMediaCodecBufferInfo info;
+};
+typedef struct AMediaCodecBatchBuffer AMediaCodecBatchBuffer;
 typedef struct AMediaCodecCryptoInfo AMediaCodecCryptoInfo;
 
+/**
+ * Called when an input buffer becomes available.
+ * The specified index is the index of the available input buffer.
+ */
+typedef void (*AMediaCodecOnAsyncInputAvailable)(
+        AMediaCodec *codec,
+        void *userdata,
+        int32_t index);
+
+/**
+ * Called when an output buffer becomes available.
+ * The specified index is the index of the available output buffer.
+ * The specified bufferInfo contains information regarding the available output buffer.
+ */
+typedef void (*AMediaCodecOnAsyncOutputAvailable)(
+        AMediaCodec *codec,
+        void *userdata,
+        int32_t index,
+        AMediaCodecBufferInfo *bufferInfo);
+
+/**
+ * Called when the output format has changed.
+ * The specified format contains the new output format; the callback must delete it.
+ */
+typedef void (*AMediaCodecOnAsyncFormatChanged)(
+        AMediaCodec *codec,
+        void *userdata,
+        AMediaFormat *format);
+
+/**
+ * Called when the MediaCodec encountered an error.
+ * The specified actionCode indicates the possible actions that client can take,
+ * and it can be checked against the Java MediaCodec.CodecException action codes.
+ * The specified detail may contain more detailed messages about this error.
+ */
+typedef void (*AMediaCodecOnAsyncError)(
+        AMediaCodec *codec,
+        void *userdata,
+        media_status_t error,
+        int32_t actionCode,
+        const char *detail);
+
+struct AMediaCodecOnAsyncNotifyCallback {
+      AMediaCodecOnAsyncInputAvailable  onAsyncInputAvailable;
+      AMediaCodecOnAsyncOutputAvailable onAsyncOutputAvailable;
+      AMediaCodecOnAsyncFormatChanged   onAsyncFormatChanged;
+      AMediaCodecOnAsyncError           onAsyncError;
+};
+typedef struct AMediaCodecOnAsyncNotifyCallback AMediaCodecOnAsyncNotifyCallback;
+
 enum {
     AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM = 4,
     AMEDIACODEC_CONFIGURE_FLAG_ENCODE = 1,
@@ -144,6 +200,21 @@ media_status_t AMediaCodec_queueSecureInputBuffer(AMediaCodec*,
  */
 ssize_t AMediaCodec_dequeueOutputBuffer(AMediaCodec*, AMediaCodecBufferInfo *info,
         int64_t timeoutUs);
+
+/**
+ * Send count buffers to the codec for processing, in order, in a single call into the codec.
+ * Stops at the first buffer that fails; numQueued returns how many were sent before it.
+ */
+media_status_t AMediaCodec_queueInputBuffers(AMediaCodec*,
+        const AMediaCodecBatchBuffer *buffers, size_t count, size_t *numQueued);
+
+/**
+ * Like AMediaCodec_dequeueOutputBuffer, but once a buffer is available also returns up to
+ * maxCount - 1 more that are already available. Returns the number of buffers stored in
+ * buffers, or one of the AMEDIACODEC_INFO_* codes or an error.
+ */
+ssize_t AMediaCodec_dequeueOutputBuffers(AMediaCodec*, AMediaCodecBatchBuffer *buffers,
+        size_t maxCount, int64_t timeoutUs);
 AMediaFormat* AMediaCodec_getOutputFormat(AMediaCodec*);
 
 /**
@@ -164,6 +235,24 @@ media_status_t AMediaCodec_releaseOutputBuffer(AMediaCodec*, size_t idx, bool re
 media_status_t AMediaCodec_releaseOutputBufferAtTime(
         AMediaCodec *mData, size_t idx, int64_t timestampNs);
 
+/**
+ * Set an asynchronous callback for actionable AMediaCodec events, and put the codec in
+ * asynchronous mode. Must be called before AMediaCodec_configure.
+ *
+ * In asynchronous mode the codec announces input and output buffers through the callback,
+ * and AMediaCodec_dequeueInputBuffer and AMediaCodec_dequeueOutputBuffer must not be used.
+ * The announced buffers are accessed directly with AMediaCodec_getInputBuffer and
+ * AMediaCodec_getOutputBuffer, then returned with AMediaCodec_queueInputBuffer and
+ * AMediaCodec_releaseOutputBuffer as usual.
+ *
+ * The callbacks are made on the codec's internal thread and should not block.
+ * Calling this again replaces the callback.
+ */
+media_status_t AMediaCodec_setAsyncNotifyCallback(
+        AMediaCodec*,
+        AMediaCodecOnAsyncNotifyCallback callback,
+        void *userdata);
+
 
 typedef enum {
     AMEDIACODECRYPTOINFO_MODE_CLEAR = 0,
@@ -93,6 +93,28 @@ media_status_t AMediaExtractor_unselectTrack(AMediaExtractor*, size_t idx);
  */
 ssize_t AMediaExtractor_readSampleData(AMediaExtractor*, uint8_t *buffer, size_t capacity);
 
+typedef struct AMediaExtractorSampleInfo {
+    size_t offset;              // offset of the sample data in the buffer
+    size_t size;
+    int64_t presentationTimeUs;
+    int trackIndex;
+    uint32_t flags;             // see definitions below
+} AMediaExtractorSampleInfo;
+
+/**
+ * Read up to maxSamples samples, starting with the current one, back to back into buffer,
+ * and describe each in infos. Unlike AMediaExtractor_readSampleData, this also advances
+ * past the samples that were read.
+ *
+ * Stops early when the next sample does not fit in the remaining capacity, or at an
+ * encrypted sample, which has to be read with AMediaExtractor_readSampleData so that its
+ * AMediaExtractor_getSampleCryptoInfo is available.
+ *
+ * Returns the number of samples read, or -1 if the current sample could not be read.
+ */
+ssize_t AMediaExtractor_readSampleDataBatch(AMediaExtractor*, uint8_t *buffer, size_t capacity,
+        AMediaExtractorSampleInfo *infos, size_t maxSamples);
+
 /**
  * Read the current sample's flags.
  */
@@ -26,6 +26,7 @@
 #include <utils/RefBase.h>
 #include <audio_utils/roundup.h>
 #include <media/AudioResamplerPublic.h>
+#include <media/AudioTimestamp.h>
 #include <media/SingleStateQueue.h>
 
 namespace android {
@@ -116,6 +117,10 @@ struct AudioTrackSharedStatic {
 
 typedef SingleStateQueue<AudioPlaybackRate> PlaybackRateQueue;
 
+// AudioRecord only: the server position (mServer) after the most recent capture period, and the
+// CLOCK_MONOTONIC time at which the HAL read that delivered its last frame returned.
+typedef SingleStateQueue<AudioTimestamp> CaptureTimestampQueue;
+
 // ----------------------------------------------------------------------------
 
 // Important: do not add any virtual methods, including ~
@@ -183,6 +188,9 @@ public:
                 } u;
 
                 // Cache line boundary (32 bytes)
+
+                // AudioRecord only: written by server once per capture period, read by client
+                CaptureTimestampQueue::Shared mCaptureTimestampQueue;
 };
 
 // ----------------------------------------------------------------------------
@@ -414,8 +422,22 @@ public:
     AudioRecordClientProxy(audio_track_cblk_t* cblk, void *buffers, size_t frameCount,
             size_t frameSize)
         : ClientProxy(cblk, buffers, frameCount, frameSize,
-            false /*isOut*/, false /*clientInServer*/) { }
+            false /*isOut*/, false /*clientInServer*/),
+          mTimestampObserver(&cblk->mCaptureTimestampQueue),
+          mTimestampValid(false) { }
     ~AudioRecordClientProxy() { }
+
+    // Returns the most recent capture timestamp, with the position in getPosition() units,
+    // or WOULD_BLOCK if none was reported since the last resetTimestamp().
+    status_t    getTimestamp(AudioTimestamp *timestamp);
+
+    // Forget the timestamps reported so far; call when the epoch is changed by start().
+    void        resetTimestamp();
+
+private:
+    CaptureTimestampQueue::Observer mTimestampObserver;
+    AudioTimestamp                  mTimestamp;         // last timestamp polled from server
+    bool                            mTimestampValid;
 };
 
 // ----------------------------------------------------------------------------
@@ -557,9 +579,17 @@ class AudioRecordServerProxy : public ServerProxy {
 public:
     AudioRecordServerProxy(audio_track_cblk_t* cblk, void *buffers, size_t frameCount,
             size_t frameSize, bool clientInServer)
-        : ServerProxy(cblk, buffers, frameCount, frameSize, false /*isOut*/, clientInServer) { }
+        : ServerProxy(cblk, buffers, frameCount, frameSize, false /*isOut*/, clientInServer),
+          mTimestampMutator(&cblk->mCaptureTimestampQueue) { }
+
+    // Report that the frames released so far were all captured by the given time.
+    // Must be called by the same thread that releases the buffers.
+    void        setTimestamp(const struct timespec& time);
 protected:
     virtual ~AudioRecordServerProxy() { }
+
+private:
+    CaptureTimestampQueue::Mutator  mTimestampMutator;
 };
 
 // ----------------------------------------------------------------------------
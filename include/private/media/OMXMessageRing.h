@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_OMX_MESSAGE_RING_H
+#define ANDROID_OMX_MESSAGE_RING_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <media/IOMX.h>
+#include <utils/RefBase.h>
+
+namespace android {
+
+class IMemory;
+
+// The buffer exchange of a remote OMX node, without binder calls. Memory shared by the
+// client and mediaserver holds two single producer, single consumer rings: buffer commands
+// from the client to the node, and buffer done messages from the node to the client. Each
+// ring has a futex doorbell for its consumer.
+//
+// Fences cannot go through the rings, and all the other calls and messages still use
+// binder. To keep everything in order, whoever receives a binder call or message for the
+// node first handles what is already queued on the ring.
+class OMXMessageRing : public RefBase {
+public:
+    enum Ring {
+        kCommands,  // written by the client, read by the node
+        kEvents,    // written by the node, read by the client
+        kNumRings,
+    };
+
+    enum {
+        // after the omx_message types used on kEvents
+        kEmptyBuffer = 0x100,
+        kFillBuffer,
+    };
+
+    struct Entry {
+        int32_t mType;          // omx_message::EMPTY_BUFFER_DONE, FILL_BUFFER_DONE or above
+        uint32_t mBuffer;
+        uint32_t mRangeOffset;  // kEmptyBuffer and FILL_BUFFER_DONE
+        uint32_t mRangeLength;
+        uint32_t mFlags;
+        uint32_t mReserved;
+        int64_t mTimestamp;
+    };
+
+    // Allocates the shared memory for the rings of a node.
+    static sp<IMemory> Allocate();
+
+    // One end of |ring| in |memory|, which comes from Allocate() in either process.
+    OMXMessageRing(const sp<IMemory> &memory, Ring ring);
+
+    // false if |memory| is too small for the rings.
+    bool isValid() const { return mShared != NULL; }
+
+    // Producer: queues |entry| and rings the doorbell. Returns false if the ring is full or
+    // broken, then the entry must go through binder.
+    bool write(const Entry &entry);
+
+    // Consumer: reads up to |count| entries without blocking. Returns the number of entries
+    // read, or a negative error once the other process has corrupted the ring.
+    ssize_t read(Entry *entries, size_t count);
+
+    // Consumer: waits for the doorbell until the ring is not empty. Returns false once
+    // interrupt() has been called.
+    bool wait();
+    void interrupt();
+
+    // Conversions for kEvents, false if |msg| cannot go through the ring.
+    static bool MessageToEntry(const omx_message &msg, Entry *entry);
+    static bool EntryToMessage(const Entry &entry, IOMX::node_id node, omx_message *msg);
+
+protected:
+    virtual ~OMXMessageRing();
+
+private:
+    struct Shared;
+
+    const sp<IMemory> mMemory;
+    Shared *mShared;
+    int32_t mIndex;         // local copy of the rear for the producer, front for the consumer
+    bool mBroken;
+    volatile int32_t mInterrupted;
+
+    OMXMessageRing(const OMXMessageRing &);
+    OMXMessageRing &operator=(const OMXMessageRing &);
+};
+
+}  // namespace android
+
+#endif  // ANDROID_OMX_MESSAGE_RING_H
@@ -70,6 +70,51 @@ public:
     char     mPadding[8 - sizeof(mData)];
 };
 
+// The memory returned by getFramesAtTimes(): this header, then one offset per requested
+// time, then the frames. Each frame is a VideoFrame followed by its pixels, like the memory
+// returned by getFrameAtTime(). The offset of a frame that was not extracted is 0.
+class VideoFrameList
+{
+public:
+    static size_t HeaderSize(size_t numFrames) {
+        return align(sizeof(VideoFrameList) + numFrames * sizeof(uint32_t));
+    }
+
+    static size_t FrameSize(const VideoFrame &frame) {
+        return align(sizeof(VideoFrame) + frame.mSize);
+    }
+
+    // Checks the offsets against |size|, the size of the memory. NULL if frame |index| was
+    // not extracted.
+    const VideoFrame *frameAt(size_t index, size_t size) const {
+        if (index >= mNumFrames || HeaderSize(mNumFrames) > size) {
+            return NULL;
+        }
+        uint32_t offset = offsets()[index];
+        if (offset == 0 || offset > size || size - offset < sizeof(VideoFrame)) {
+            return NULL;
+        }
+        const VideoFrame *frame =
+            reinterpret_cast<const VideoFrame *>((const uint8_t *)this + offset);
+        if (size - offset - sizeof(VideoFrame) < frame->mSize) {
+            return NULL;
+        }
+        return frame;
+    }
+
+    uint32_t *offsets() { return reinterpret_cast<uint32_t *>(this + 1); }
+    const uint32_t *offsets() const { return reinterpret_cast<const uint32_t *>(this + 1); }
+
+    uint32_t mNumFrames;
+    uint32_t mReserved;
+
+private:
+    // keeps the VideoFrames 64 bit aligned
+    static size_t align(size_t size) {
+        return (size + 7) & ~(size_t)7;
+    }
+};
+
 }; // namespace android
 
 #endif // ANDROID_VIDEO_FRAME_H
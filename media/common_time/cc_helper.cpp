@@ -18,6 +18,7 @@
 
 #include <common_time/cc_helper.h>
 #include <common_time/ICommonClock.h>
+#include <common_time/local_clock.h>
 #include <utils/threads.h>
 
 namespace android {
@@ -26,6 +27,7 @@ Mutex CCHelper::lock_;
 sp<ICommonClock> CCHelper::common_clock_;
 sp<ICommonClockListener> CCHelper::common_clock_listener_;
 uint32_t CCHelper::ref_count_ = 0;
+LocalClock* CCHelper::local_clock_ = NULL;
 
 bool CCHelper::verifyClock_l() {
     bool ret = false;
@@ -61,6 +63,11 @@ CCHelper::CCHelper() {
     Mutex::Autolock lock(&lock_);
     ref_count_++;
     verifyClock_l();
+
+    // kept for the lifetime of the process, like the HAL device it wraps
+    if (local_clock_ == NULL) {
+        local_clock_ = new LocalClock();
+    }
 }
 
 CCHelper::~CCHelper() {
@@ -121,9 +128,27 @@ CCHELPER_METHOD(getCommonTime(int64_t* commonTime),
                 getCommonTime(commonTime))
 CCHELPER_METHOD(getCommonFreq(uint64_t* freq),
                 getCommonFreq(freq))
-CCHELPER_METHOD(getLocalTime(int64_t* localTime),
+CCHELPER_METHOD(getLocalTimeFromService(int64_t* localTime),
                 getLocalTime(localTime))
-CCHELPER_METHOD(getLocalFreq(uint64_t* freq),
+CCHELPER_METHOD(getLocalFreqFromService(uint64_t* freq),
                 getLocalFreq(freq))
 
+// local_clock_ is set by the constructor and never changes afterwards, so no
+// lock is needed to read it.
+status_t CCHelper::getLocalTime(int64_t* localTime) {
+    if (local_clock_->initCheck()) {
+        *localTime = local_clock_->getLocalTime();
+        return OK;
+    }
+    return getLocalTimeFromService(localTime);
+}
+
+status_t CCHelper::getLocalFreq(uint64_t* freq) {
+    if (local_clock_->initCheck()) {
+        *freq = local_clock_->getLocalFreq();
+        return OK;
+    }
+    return getLocalFreqFromService(freq);
+}
+
 }  // namespace android
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMG_UTILS_ASYNC_FILE_OUTPUT_H
+#define IMG_UTILS_ASYNC_FILE_OUTPUT_H
+
+#include <img_utils/Output.h>
+
+#include <cutils/compiler.h>
+#include <utils/Condition.h>
+#include <utils/Errors.h>
+#include <utils/Mutex.h>
+#include <utils/String8.h>
+#include <utils/Thread.h>
+
+#include <stdio.h>
+#include <stdint.h>
+
+namespace android {
+namespace img_utils {
+
+/**
+ * A file Output that hands the written bytes to a background thread in large chunks, so that
+ * producing the image data (e.g. converting raw strips) overlaps with the file writes.
+ *
+ * At most maxQueuedChunks chunks wait to be written; write() blocks once that many are queued.
+ * Errors from the background writes are reported by the next write() call, or by close().
+ */
+class ANDROID_API AsyncFileOutput : public Output {
+    public:
+        enum {
+            DEFAULT_CHUNK_SIZE = 1 << 20,
+            DEFAULT_MAX_QUEUED_CHUNKS = 4,
+        };
+
+        AsyncFileOutput(String8 path, size_t chunkSize = DEFAULT_CHUNK_SIZE,
+                size_t maxQueuedChunks = DEFAULT_MAX_QUEUED_CHUNKS);
+        virtual ~AsyncFileOutput();
+        virtual status_t open();
+        virtual status_t write(const uint8_t* buf, size_t offset, size_t count);
+
+        /**
+         * Write out all queued data, stop the writer thread and close the file.
+         *
+         * Returns OK on success, or the first error that occurred while writing or closing.
+         */
+        virtual status_t close();
+    private:
+        class WriterThread : public Thread {
+            public:
+                WriterThread(AsyncFileOutput* parent);
+            private:
+                virtual bool threadLoop();
+                AsyncFileOutput* mParent;
+        };
+
+        struct Chunk {
+            uint8_t* data;
+            size_t size;
+        };
+
+        // Queue the chunk being filled for writing. Blocks while the queue is full.
+        status_t queueFillChunk();
+
+        // Write the oldest queued chunk. Returns false once closing and out of chunks.
+        bool writeNextChunk();
+
+        void freeChunks();
+
+        String8 mPath;
+        FILE *mFp;
+        bool mOpen;
+        size_t mChunkSize;
+        sp<WriterThread> mWriter;
+
+        // Ring of chunks; the queued chunks start at mWriteIdx, and the chunk being filled by
+        // write() immediately follows the last queued one.
+        Chunk* mChunks;
+        size_t mChunkCount;
+        size_t mFillIdx;
+
+        Mutex mLock;
+        Condition mChunkQueued;
+        Condition mChunkWritten;
+        // Guarded by mLock
+        size_t mWriteIdx;
+        size_t mQueuedCount;
+        bool mClosing;
+        status_t mError;
+};
+
+} /*namespace img_utils*/
+} /*namespace android*/
+
+#endif /*IMG_UTILS_ASYNC_FILE_OUTPUT_H*/
@@ -120,6 +120,9 @@ class ANDROID_API EndianOutput : public Output {
         virtual status_t write(const double* buf, size_t offset, size_t count);
 
     protected:
+        // Elements converted per call to the wrapped output's write.
+        static const size_t kConvertBatchSize = 256;
+
         template<typename T>
         inline status_t writeHelper(const T* buf, size_t offset, size_t count);
 
@@ -133,31 +136,24 @@ inline status_t EndianOutput::writeHelper(const T* buf, size_t offset, size_t co
     assert(offset <= count);
     status_t res = OK;
     size_t size = sizeof(T);
-    switch(mEndian) {
-        case BIG: {
-            for (size_t i = offset; i < count; ++i) {
-                T tmp = convertToBigEndian<T>(buf[offset + i]);
-                if ((res = mOutput->write(reinterpret_cast<uint8_t*>(&tmp), 0, size))
-                        != OK) {
-                    return res;
-                }
-                mOffset += size;
-            }
-            break;
-        }
-        case LITTLE: {
-            for (size_t i = offset; i < count; ++i) {
-                T tmp = convertToLittleEndian<T>(buf[offset + i]);
-                if ((res = mOutput->write(reinterpret_cast<uint8_t*>(&tmp), 0, size))
-                        != OK) {
-                    return res;
-                }
-                mOffset += size;
+    if (mEndian != BIG && mEndian != LITTLE) {
+        return BAD_VALUE;
+    }
+
+    // Convert into a local batch so the wrapped output sees a few large writes rather than
+    // one write per element.
+    T tmp[kConvertBatchSize];
+    size_t batched = 0;
+    for (size_t i = offset; i < count; ++i) {
+        tmp[batched++] = (mEndian == BIG) ? convertToBigEndian<T>(buf[offset + i]) :
+                convertToLittleEndian<T>(buf[offset + i]);
+        if (batched == kConvertBatchSize || i + 1 == count) {
+            if ((res = mOutput->write(reinterpret_cast<uint8_t*>(tmp), 0, batched * size))
+                    != OK) {
+                return res;
             }
-            break;
-        }
-        default: {
-            return BAD_VALUE;
+            mOffset += batched * size;
+            batched = 0;
         }
     }
     return res;
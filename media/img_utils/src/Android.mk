@@ -17,6 +17,7 @@ LOCAL_PATH := $(call my-dir)
 include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES := \
+  AsyncFileOutput.cpp \
   EndianUtils.cpp \
   FileInput.cpp \
   FileOutput.cpp \
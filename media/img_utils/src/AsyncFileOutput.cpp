@@ -0,0 +1,219 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "AsyncFileOutput"
+
+#include <img_utils/AsyncFileOutput.h>
+
+#include <utils/Log.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace android {
+namespace img_utils {
+
+AsyncFileOutput::WriterThread::WriterThread(AsyncFileOutput* parent)
+        : Thread(/*canCallJava*/false), mParent(parent) {}
+
+bool AsyncFileOutput::WriterThread::threadLoop() {
+    return mParent->writeNextChunk();
+}
+
+AsyncFileOutput::AsyncFileOutput(String8 path, size_t chunkSize, size_t maxQueuedChunks)
+        : mPath(path), mFp(NULL), mOpen(false), mChunkSize(chunkSize > 0 ? chunkSize : 1),
+          mChunks(NULL), mChunkCount((maxQueuedChunks > 0 ? maxQueuedChunks : 1) + 1),
+          mFillIdx(0), mWriteIdx(0), mQueuedCount(0), mClosing(false), mError(OK) {}
+
+AsyncFileOutput::~AsyncFileOutput() {
+    if (mOpen) {
+        ALOGW("%s: Destructor called with %s still open.", __FUNCTION__, mPath.string());
+        close();
+    }
+}
+
+status_t AsyncFileOutput::open() {
+    if (mOpen) {
+        ALOGW("%s: Open called when file %s already open.", __FUNCTION__, mPath.string());
+        return OK;
+    }
+
+    mChunks = new Chunk[mChunkCount];
+    for (size_t i = 0; i < mChunkCount; ++i) {
+        mChunks[i].size = 0;
+        mChunks[i].data = static_cast<uint8_t*>(malloc(mChunkSize));
+        if (mChunks[i].data == NULL) {
+            ALOGE("%s: Could not allocate %zu byte chunk for file %s", __FUNCTION__, mChunkSize,
+                    mPath.string());
+            freeChunks();
+            return NO_MEMORY;
+        }
+    }
+
+    mFp = ::fopen(mPath, "wb");
+    if (!mFp) {
+        ALOGE("%s: Could not open file %s", __FUNCTION__, mPath.string());
+        freeChunks();
+        return BAD_VALUE;
+    }
+
+    mFillIdx = 0;
+    mWriteIdx = 0;
+    mQueuedCount = 0;
+    mClosing = false;
+    mError = OK;
+
+    mWriter = new WriterThread(this);
+    status_t res = mWriter->run("AsyncFileOutput");
+    if (res != OK) {
+        ALOGE("%s: Could not start writer thread for file %s: %d", __FUNCTION__, mPath.string(),
+                res);
+        mWriter.clear();
+        ::fclose(mFp);
+        mFp = NULL;
+        freeChunks();
+        return res;
+    }
+
+    mOpen = true;
+    return OK;
+}
+
+status_t AsyncFileOutput::write(const uint8_t* buf, size_t offset, size_t count) {
+    if (!mOpen) {
+        ALOGE("%s: Could not write file %s, file not open.", __FUNCTION__, mPath.string());
+        return BAD_VALUE;
+    }
+
+    while (count > 0) {
+        Chunk& chunk = mChunks[mFillIdx];
+        size_t toCopy = mChunkSize - chunk.size;
+        if (toCopy > count) {
+            toCopy = count;
+        }
+        memcpy(chunk.data + chunk.size, buf + offset, toCopy);
+        chunk.size += toCopy;
+        offset += toCopy;
+        count -= toCopy;
+
+        if (chunk.size == mChunkSize) {
+            status_t res = queueFillChunk();
+            if (res != OK) {
+                return res;
+            }
+        }
+    }
+    return OK;
+}
+
+status_t AsyncFileOutput::close() {
+    if (!mOpen) {
+        ALOGW("%s: Close called when file %s already close.", __FUNCTION__, mPath.string());
+        return OK;
+    }
+
+    status_t ret = OK;
+    if (mChunks[mFillIdx].size > 0) {
+        ret = queueFillChunk();
+    }
+
+    {
+        Mutex::Autolock l(mLock);
+        mClosing = true;
+        mChunkQueued.signal();
+    }
+    mWriter->join();
+    mWriter.clear();
+
+    if (ret == OK) {
+        ret = mError;
+    }
+    if (::fclose(mFp) != 0) {
+        ALOGE("%s: Failed to close file %s.", __FUNCTION__, mPath.string());
+        if (ret == OK) {
+            ret = BAD_VALUE;
+        }
+    }
+    mFp = NULL;
+    freeChunks();
+    mOpen = false;
+    return ret;
+}
+
+status_t AsyncFileOutput::queueFillChunk() {
+    Mutex::Autolock l(mLock);
+    while (mQueuedCount == mChunkCount - 1 && mError == OK) {
+        mChunkWritten.wait(mLock);
+    }
+    if (mError != OK) {
+        return mError;
+    }
+    mQueuedCount++;
+    mFillIdx = (mFillIdx + 1) % mChunkCount;
+    mChunks[mFillIdx].size = 0;
+    mChunkQueued.signal();
+    return OK;
+}
+
+bool AsyncFileOutput::writeNextChunk() {
+    Chunk* chunk;
+    bool skip;
+    {
+        Mutex::Autolock l(mLock);
+        while (mQueuedCount == 0 && !mClosing) {
+            mChunkQueued.wait(mLock);
+        }
+        if (mQueuedCount == 0) {
+            return false;
+        }
+        chunk = &mChunks[mWriteIdx];
+        // After an error, keep consuming chunks so the producer never blocks, but drop them
+        skip = (mError != OK);
+    }
+
+    int error = 0;
+    if (!skip) {
+        ::fwrite(chunk->data, sizeof(uint8_t), chunk->size, mFp);
+        error = ::ferror(mFp);
+        if (error != 0) {
+            ALOGE("%s: Error %d occurred while writing file %s.", __FUNCTION__, error,
+                    mPath.string());
+        }
+    }
+
+    Mutex::Autolock l(mLock);
+    if (error != 0) {
+        mError = BAD_VALUE;
+    }
+    mWriteIdx = (mWriteIdx + 1) % mChunkCount;
+    mQueuedCount--;
+    mChunkWritten.signal();
+    return true;
+}
+
+void AsyncFileOutput::freeChunks() {
+    if (mChunks == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < mChunkCount; ++i) {
+        free(mChunks[i].data);
+    }
+    delete[] mChunks;
+    mChunks = NULL;
+}
+
+} /*namespace img_utils*/
+} /*namespace android*/
@@ -20,6 +20,7 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
 #include <time.h>
 
 #include <utils/Log.h>
@@ -251,4 +252,15 @@ uint32_t ThreadCpuUsage::getCpukHz(int cpuNum)
     return ret;
 }
 
+/*static*/
+bool ThreadCpuUsage::getInvoluntaryContextSwitches(long& count)
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_THREAD, &usage) != 0) {
+        return false;
+    }
+    count = usage.ru_nivcsw;
+    return true;
+}
+
 }   // namespace android
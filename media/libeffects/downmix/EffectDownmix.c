@@ -29,6 +29,7 @@
 //#define DOWNMIX_ALWAYS_USE_GENERIC_DOWNMIXER 0
 
 #define MINUS_3_DB_IN_Q19_12 2896 // -3dB = 0.707 * 2^12 = 2896
+#define MINUS_3_DB_IN_FLOAT 0.70710678f // -3dB = 0.70710678
 
 // subset of possible audio_channel_mask_t values, and AUDIO_CHANNEL_OUT_* renamed to CHANNEL_MASK_*
 typedef enum {
@@ -290,6 +291,11 @@ static int Downmix_Process(effect_handle_t self,
             (pDwmModule->config.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE);
     const uint32_t downmixInputChannelMask = pDwmModule->config.inputCfg.channels;
 
+    if (pDwmModule->config.inputCfg.format == AUDIO_FORMAT_PCM_FLOAT) {
+        return Downmix_ProcessFloat(pDownmixer, downmixInputChannelMask,
+                inBuffer->f32, outBuffer->f32, numFrames, accumulate);
+    }
+
     switch(pDownmixer->type) {
 
       case DOWNMIX_TYPE_STRIP:
@@ -609,8 +615,9 @@ int Downmix_Configure(downmix_module_t *pDwmModule, effect_config_t *pConfig, bo
     // Check configuration compatibility with build options, and effect capabilities
     if (pConfig->inputCfg.samplingRate != pConfig->outputCfg.samplingRate
         || pConfig->outputCfg.channels != DOWNMIX_OUTPUT_CHANNELS
-        || pConfig->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT
-        || pConfig->outputCfg.format != AUDIO_FORMAT_PCM_16_BIT) {
+        || (pConfig->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT
+                && pConfig->inputCfg.format != AUDIO_FORMAT_PCM_FLOAT)
+        || pConfig->outputCfg.format != pConfig->inputCfg.format) {
         ALOGE("Downmix_Configure error: invalid config");
         return -EINVAL;
     }
@@ -941,6 +948,42 @@ void Downmix_foldFrom7Point1(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool
 }
 
 
+/*----------------------------------------------------------------------------
+ * Downmix_validGenericMask()
+ *----------------------------------------------------------------------------
+ * Purpose:
+ * check that a channel mask can be handled by Downmix_foldGeneric() and
+ * Downmix_foldGenericFloat(), see below.
+ *
+ * Returns: false if multichannel format is not supported
+ *
+ *----------------------------------------------------------------------------
+ */
+bool Downmix_validGenericMask(uint32_t mask) {
+    // check against unsupported channels
+    if (mask & kUnsupported) {
+        ALOGE("Unsupported channels (top or front left/right of center)");
+        return false;
+    }
+    // verify has FL/FR
+    if ((mask & AUDIO_CHANNEL_OUT_STEREO) != AUDIO_CHANNEL_OUT_STEREO) {
+        ALOGE("Front channels must be present");
+        return false;
+    }
+    // verify uses SIDE as a pair (ok if not using SIDE at all)
+    if ((mask & kSides) != 0 && (mask & kSides) != kSides) {
+        ALOGE("Side channels must be used as a pair");
+        return false;
+    }
+    // verify uses BACK as a pair (ok if not using BACK at all)
+    if ((mask & kBacks) != 0 && (mask & kBacks) != kBacks) {
+        ALOGE("Back channels must be used as a pair");
+        return false;
+    }
+    return true;
+}
+
+
 /*----------------------------------------------------------------------------
  * Downmix_foldGeneric()
  *----------------------------------------------------------------------------
@@ -969,34 +1012,11 @@ void Downmix_foldFrom7Point1(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool
  */
 bool Downmix_foldGeneric(
         uint32_t mask, int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate) {
-    // check against unsupported channels
-    if (mask & kUnsupported) {
-        ALOGE("Unsupported channels (top or front left/right of center)");
+    if (!Downmix_validGenericMask(mask)) {
         return false;
     }
-    // verify has FL/FR
-    if ((mask & AUDIO_CHANNEL_OUT_STEREO) != AUDIO_CHANNEL_OUT_STEREO) {
-        ALOGE("Front channels must be present");
-        return false;
-    }
-    // verify uses SIDE as a pair (ok if not using SIDE at all)
-    bool hasSides = false;
-    if ((mask & kSides) != 0) {
-        if ((mask & kSides) != kSides) {
-            ALOGE("Side channels must be used as a pair");
-            return false;
-        }
-        hasSides = true;
-    }
-    // verify uses BACK as a pair (ok if not using BACK at all)
-    bool hasBacks = false;
-    if ((mask & kBacks) != 0) {
-        if ((mask & kBacks) != kBacks) {
-            ALOGE("Back channels must be used as a pair");
-            return false;
-        }
-        hasBacks = true;
-    }
+    const bool hasSides = (mask & kSides) != 0;
+    const bool hasBacks = (mask & kBacks) != 0;
 
     const int numChan = audio_channel_count_from_out_mask(mask);
     const bool hasFC = ((mask & AUDIO_CHANNEL_OUT_FRONT_CENTER) == AUDIO_CHANNEL_OUT_FRONT_CENTER);
@@ -1079,3 +1099,233 @@ bool Downmix_foldGeneric(
     }
     return true;
 }
+
+
+/*----------------------------------------------------------------------------
+ * Downmix_ProcessFloat()
+ *----------------------------------------------------------------------------
+ * Purpose:
+ * float version of the processing done by Downmix_Process(), used when the effect is
+ * configured with AUDIO_FORMAT_PCM_FLOAT, e.g. by the mixer's float pipeline.
+ * The gains are the same as for 16 bit samples, but the output is not clamped.
+ *
+ * Returns:
+ *  0            indicates success
+ *  -EINVAL      the downmix type or channel mask is not supported
+ *
+ *----------------------------------------------------------------------------
+ */
+int Downmix_ProcessFloat(downmix_object_t *pDownmixer, uint32_t mask,
+        float *pSrc, float *pDst, size_t numFrames, bool accumulate) {
+    switch (pDownmixer->type) {
+
+      case DOWNMIX_TYPE_STRIP: {
+          const size_t numChan = pDownmixer->input_channel_count;
+          if (accumulate) {
+              for (; numFrames > 0; numFrames--) {
+                  pDst[0] += pSrc[0];
+                  pDst[1] += pSrc[1];
+                  pSrc += numChan;
+                  pDst += 2;
+              }
+          } else {
+              for (; numFrames > 0; numFrames--) {
+                  pDst[0] = pSrc[0];
+                  pDst[1] = pSrc[1];
+                  pSrc += numChan;
+                  pDst += 2;
+              }
+          }
+        } break;
+
+      case DOWNMIX_TYPE_FOLD:
+#ifdef DOWNMIX_ALWAYS_USE_GENERIC_DOWNMIXER
+          if (!Downmix_foldGenericFloat(mask, pSrc, pDst, numFrames, accumulate)) {
+              ALOGE("Multichannel configuration 0x%" PRIx32 " is not supported", mask);
+              return -EINVAL;
+          }
+          break;
+#endif
+        switch ((downmix_input_channel_mask_t)mask) {
+        case CHANNEL_MASK_QUAD_BACK:
+        case CHANNEL_MASK_QUAD_SIDE:
+            Downmix_foldFromQuadFloat(pSrc, pDst, numFrames, accumulate);
+            break;
+        case CHANNEL_MASK_5POINT1_BACK:
+        case CHANNEL_MASK_5POINT1_SIDE:
+            Downmix_foldFrom5Point1Float(pSrc, pDst, numFrames, accumulate);
+            break;
+        case CHANNEL_MASK_7POINT1:
+            Downmix_foldFrom7Point1Float(pSrc, pDst, numFrames, accumulate);
+            break;
+        default:
+            if (!Downmix_foldGenericFloat(mask, pSrc, pDst, numFrames, accumulate)) {
+                ALOGE("Multichannel configuration 0x%" PRIx32 " is not supported", mask);
+                return -EINVAL;
+            }
+            break;
+        }
+        break;
+
+      default:
+        return -EINVAL;
+    }
+    return 0;
+}
+
+
+/*----------------------------------------------------------------------------
+ * Downmix_foldFromQuadFloat(), Downmix_foldFrom5Point1Float(), Downmix_foldFrom7Point1Float()
+ *----------------------------------------------------------------------------
+ * Purpose:
+ * float versions of Downmix_foldFromQuad(), Downmix_foldFrom5Point1() and
+ * Downmix_foldFrom7Point1(). The loops have no clamping and no data dependent branches so
+ * that the compiler can vectorize them.
+ *
+ *----------------------------------------------------------------------------
+ */
+void Downmix_foldFromQuadFloat(float *pSrc, float *pDst, size_t numFrames, bool accumulate) {
+    // FL FR RL RR
+    if (accumulate) {
+        for (; numFrames > 0; numFrames--) {
+            pDst[0] += (pSrc[0] + pSrc[2]) * 0.5f;
+            pDst[1] += (pSrc[1] + pSrc[3]) * 0.5f;
+            pSrc += 4;
+            pDst += 2;
+        }
+    } else {
+        for (; numFrames > 0; numFrames--) {
+            pDst[0] = (pSrc[0] + pSrc[2]) * 0.5f;
+            pDst[1] = (pSrc[1] + pSrc[3]) * 0.5f;
+            pSrc += 4;
+            pDst += 2;
+        }
+    }
+}
+
+void Downmix_foldFrom5Point1Float(float *pSrc, float *pDst, size_t numFrames, bool accumulate) {
+    float lt, rt, centerPlusLfeContrib;
+    // FL FR FC LFE RL RR
+    if (accumulate) {
+        for (; numFrames > 0; numFrames--) {
+            centerPlusLfeContrib = (pSrc[2] + pSrc[3]) * MINUS_3_DB_IN_FLOAT;
+            lt = pSrc[0] + centerPlusLfeContrib + pSrc[4];
+            rt = pSrc[1] + centerPlusLfeContrib + pSrc[5];
+            pDst[0] += lt * 0.5f;
+            pDst[1] += rt * 0.5f;
+            pSrc += 6;
+            pDst += 2;
+        }
+    } else {
+        for (; numFrames > 0; numFrames--) {
+            centerPlusLfeContrib = (pSrc[2] + pSrc[3]) * MINUS_3_DB_IN_FLOAT;
+            lt = pSrc[0] + centerPlusLfeContrib + pSrc[4];
+            rt = pSrc[1] + centerPlusLfeContrib + pSrc[5];
+            pDst[0] = lt * 0.5f;
+            pDst[1] = rt * 0.5f;
+            pSrc += 6;
+            pDst += 2;
+        }
+    }
+}
+
+void Downmix_foldFrom7Point1Float(float *pSrc, float *pDst, size_t numFrames, bool accumulate) {
+    float lt, rt, centerPlusLfeContrib;
+    // FL FR FC LFE RL RR SL SR
+    if (accumulate) {
+        for (; numFrames > 0; numFrames--) {
+            centerPlusLfeContrib = (pSrc[2] + pSrc[3]) * MINUS_3_DB_IN_FLOAT;
+            lt = pSrc[0] + centerPlusLfeContrib + pSrc[6] + pSrc[4];
+            rt = pSrc[1] + centerPlusLfeContrib + pSrc[7] + pSrc[5];
+            pDst[0] += lt * 0.5f;
+            pDst[1] += rt * 0.5f;
+            pSrc += 8;
+            pDst += 2;
+        }
+    } else {
+        for (; numFrames > 0; numFrames--) {
+            centerPlusLfeContrib = (pSrc[2] + pSrc[3]) * MINUS_3_DB_IN_FLOAT;
+            lt = pSrc[0] + centerPlusLfeContrib + pSrc[6] + pSrc[4];
+            rt = pSrc[1] + centerPlusLfeContrib + pSrc[7] + pSrc[5];
+            pDst[0] = lt * 0.5f;
+            pDst[1] = rt * 0.5f;
+            pSrc += 8;
+            pDst += 2;
+        }
+    }
+}
+
+
+/*----------------------------------------------------------------------------
+ * Downmix_foldGenericFloat()
+ *----------------------------------------------------------------------------
+ * Purpose:
+ * float version of Downmix_foldGeneric(). Instead of testing for each channel
+ * on every frame, the left and right gains of each input channel are computed once
+ * from the channel mask.
+ *
+ * Returns: false if multichannel format is not supported
+ *
+ *----------------------------------------------------------------------------
+ */
+bool Downmix_foldGenericFloat(
+        uint32_t mask, float *pSrc, float *pDst, size_t numFrames, bool accumulate) {
+    if (!Downmix_validGenericMask(mask)) {
+        return false;
+    }
+
+    // channels are interleaved in increasing order of their position bit
+    float leftGain[AUDIO_CHANNEL_COUNT_MAX];
+    float rightGain[AUDIO_CHANNEL_COUNT_MAX];
+    size_t numChan = 0;
+    uint32_t bits;
+    for (bits = mask; bits != 0 && numChan < AUDIO_CHANNEL_COUNT_MAX; bits &= bits - 1) {
+        const uint32_t channel = bits & -bits;
+        switch (channel) {
+        case AUDIO_CHANNEL_OUT_FRONT_LEFT:
+        case AUDIO_CHANNEL_OUT_BACK_LEFT:
+        case AUDIO_CHANNEL_OUT_SIDE_LEFT:
+            leftGain[numChan] = 0.5f;
+            rightGain[numChan] = 0.f;
+            break;
+        case AUDIO_CHANNEL_OUT_FRONT_RIGHT:
+        case AUDIO_CHANNEL_OUT_BACK_RIGHT:
+        case AUDIO_CHANNEL_OUT_SIDE_RIGHT:
+            leftGain[numChan] = 0.f;
+            rightGain[numChan] = 0.5f;
+            break;
+        case AUDIO_CHANNEL_OUT_FRONT_CENTER:
+        case AUDIO_CHANNEL_OUT_LOW_FREQUENCY:
+        case AUDIO_CHANNEL_OUT_BACK_CENTER:
+            leftGain[numChan] = MINUS_3_DB_IN_FLOAT * 0.5f;
+            rightGain[numChan] = MINUS_3_DB_IN_FLOAT * 0.5f;
+            break;
+        default:
+            // not mixed in, like in Downmix_foldGeneric()
+            leftGain[numChan] = 0.f;
+            rightGain[numChan] = 0.f;
+            break;
+        }
+        numChan++;
+    }
+
+    for (; numFrames > 0; numFrames--) {
+        float lt = 0.f;
+        float rt = 0.f;
+        size_t i;
+        for (i = 0; i < numChan; i++) {
+            lt += pSrc[i] * leftGain[i];
+            rt += pSrc[i] * rightGain[i];
+        }
+        if (accumulate) {
+            pDst[0] += lt;
+            pDst[1] += rt;
+        } else {
+            pDst[0] = lt;
+            pDst[1] = rt;
+        }
+        pSrc += numChan;
+        pDst += 2;
+    }
+    return true;
+}
@@ -101,5 +101,14 @@ void Downmix_foldFrom5Point1(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool
 void Downmix_foldFrom7Point1(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate);
 bool Downmix_foldGeneric(
         uint32_t mask, int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate);
+bool Downmix_validGenericMask(uint32_t mask);
+
+int Downmix_ProcessFloat(downmix_object_t *pDownmixer, uint32_t mask,
+        float *pSrc, float *pDst, size_t numFrames, bool accumulate);
+void Downmix_foldFromQuadFloat(float *pSrc, float *pDst, size_t numFrames, bool accumulate);
+void Downmix_foldFrom5Point1Float(float *pSrc, float *pDst, size_t numFrames, bool accumulate);
+void Downmix_foldFrom7Point1Float(float *pSrc, float *pDst, size_t numFrames, bool accumulate);
+bool Downmix_foldGenericFloat(
+        uint32_t mask, float *pSrc, float *pDst, size_t numFrames, bool accumulate);
 
 #endif /*ANDROID_EFFECTDOWNMIX_H_*/
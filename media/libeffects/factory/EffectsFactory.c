@@ -21,6 +21,10 @@
 #include <string.h>
 #include <stdlib.h>
 #include <dlfcn.h>
+#include <errno.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <cutils/misc.h>
 #include <cutils/config_utils.h>
@@ -40,6 +44,11 @@ static list_elem_t *gCurEffect; // current effect in enumeration process
 static uint32_t gCurEffectIdx;       // current effect index in enumeration process
 static lib_entry_t *gCachedLibrary;  // last library accessed by getLibrary()
 
+static list_elem_t *gLibCacheList; // list of lib_cache_t read from the descriptor cache file
+                                   // and not claimed by a library of the configuration file
+static int gUseLibCache;   // descriptors are cached and libraries opened on demand
+static int gLibCacheDirty; // the descriptor cache file must be rewritten
+
 static int gInitDone; // true is global initialization has been preformed
 static int gCanQueryEffect; // indicates that call to EffectQueryEffect() is valid, i.e. that the list of effects
                           // was not modified since last call to EffectQueryNumberEffects()
@@ -53,6 +62,17 @@ static int init();
 static int loadEffectConfigFile(const char *path);
 static int loadLibraries(cnode *root);
 static int loadLibrary(cnode *root, const char *name);
+static int openLibrary(const char *path, void **handle, audio_effect_library_t **desc);
+// Opens the library if only its cached descriptors were loaded so far
+static int loadLibraryCode(lib_entry_t *l);
+// Returns the descriptor for uuid from the library cache, or queries it from the library
+static int getEffectDescriptor(lib_entry_t *l, const effect_uuid_t *uuid, effect_descriptor_t *d);
+static int getLibFileId(const char *path, int64_t *mtime, int64_t *size);
+static lib_cache_t *takeLibCache(const char *path);
+static lib_cache_t *newLibCache(const char *path);
+static void freeLibCache(lib_cache_t *cache);
+static void readDescriptorCache();
+static void writeDescriptorCache();
 static int loadEffects(cnode *root);
 static int loadEffect(cnode *node);
 // To get and add the effect pointed by the passed node to the gSubEffectList
@@ -306,6 +326,12 @@ int EffectCreate(const effect_uuid_t *uuid, int32_t sessionId, int32_t ioId, eff
         }
     }
 
+    ret = loadLibraryCode(l);
+    if (ret != 0) {
+        ALOGW("EffectCreate() could not open library %s for fx %s", l->name, d->name);
+        goto exit;
+    }
+
     // create effect in library
     ret = l->desc->create_effect(uuid, sessionId, ioId, &itfe);
     if (ret != 0) {
@@ -456,11 +482,28 @@ int init() {
     if (ignoreFxConfFiles) {
         ALOGI("Audio effects in configuration files will be ignored");
     } else {
+        gUseLibCache = property_get_bool(PROPERTY_EFFECTS_DESCRIPTOR_CACHE, true);
+        if (gUseLibCache) {
+            readDescriptorCache();
+        }
         if (access(AUDIO_EFFECT_VENDOR_CONFIG_FILE, R_OK) == 0) {
             loadEffectConfigFile(AUDIO_EFFECT_VENDOR_CONFIG_FILE);
         } else if (access(AUDIO_EFFECT_DEFAULT_CONFIG_FILE, R_OK) == 0) {
             loadEffectConfigFile(AUDIO_EFFECT_DEFAULT_CONFIG_FILE);
         }
+        if (gUseLibCache) {
+            // entries left over belong to libraries no longer in the configuration
+            while (gLibCacheList != NULL) {
+                list_elem_t *e = gLibCacheList;
+                gLibCacheList = e->next;
+                freeLibCache((lib_cache_t *)e->object);
+                free(e);
+                gLibCacheDirty = 1;
+            }
+            if (gLibCacheDirty) {
+                writeDescriptorCache();
+            }
+        }
     }
 
     updateNumEffects();
@@ -510,6 +553,7 @@ int loadLibrary(cnode *root, const char *name)
     cnode *node;
     void *hdl;
     audio_effect_library_t *desc;
+    lib_cache_t *cache;
     list_elem_t *e;
     lib_entry_t *l;
     char path[PATH_MAX];
@@ -534,27 +578,22 @@ int loadLibrary(cnode *root, const char *name)
     if (strlen(path) >= PATH_MAX - 1)
         return -EINVAL;
 
-    hdl = dlopen(path, RTLD_NOW);
-    if (hdl == NULL) {
-        ALOGW("loadLibrary() failed to open %s", path);
-        goto error;
-    }
-
-    desc = (audio_effect_library_t *)dlsym(hdl, AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR);
-    if (desc == NULL) {
-        ALOGW("loadLibrary() could not find symbol %s", AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR);
-        goto error;
-    }
-
-    if (AUDIO_EFFECT_LIBRARY_TAG != desc->tag) {
-        ALOGW("getLibrary() bad tag %08x in lib info struct", desc->tag);
-        goto error;
-    }
-
-    if (EFFECT_API_VERSION_MAJOR(desc->version) !=
-            EFFECT_API_VERSION_MAJOR(EFFECT_LIBRARY_API_VERSION)) {
-        ALOGW("loadLibrary() bad lib version %08x", desc->version);
-        goto error;
+    // A library whose descriptors are all cached is only opened when one of its effects
+    // is created. Libraries were successfully opened before being cached.
+    hdl = NULL;
+    desc = NULL;
+    cache = NULL;
+    if (gUseLibCache) {
+        cache = takeLibCache(path);
+    }
+    if (cache == NULL) {
+        if (openLibrary(path, &hdl, &desc) != 0) {
+            return -EINVAL;
+        }
+        if (gUseLibCache) {
+            cache = newLibCache(path);
+            gLibCacheDirty = 1;
+        }
     }
 
     // add entry for library in gLibraryList
@@ -565,6 +604,7 @@ int loadLibrary(cnode *root, const char *name)
     l->desc = desc;
     l->effects = NULL;
     pthread_mutex_init(&l->lock, NULL);
+    l->cache = cache;
 
     e = malloc(sizeof(list_elem_t));
     e->object = l;
@@ -572,17 +612,322 @@ int loadLibrary(cnode *root, const char *name)
     e->next = gLibraryList;
     gLibraryList = e;
     pthread_mutex_unlock(&gLibLock);
-    ALOGV("getLibrary() linked library %p for path %s", l, path);
+    ALOGV("getLibrary() linked library %p for path %s%s", l, path,
+            hdl == NULL ? " (cached)" : "");
 
     return 0;
+}
 
-error:
-    if (hdl != NULL) {
-        dlclose(hdl);
+int openLibrary(const char *path, void **handle, audio_effect_library_t **desc)
+{
+    void *hdl;
+    audio_effect_library_t *d;
+
+    hdl = dlopen(path, RTLD_NOW);
+    if (hdl == NULL) {
+        ALOGW("loadLibrary() failed to open %s", path);
+        return -EINVAL;
+    }
+
+    d = (audio_effect_library_t *)dlsym(hdl, AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR);
+    if (d == NULL) {
+        ALOGW("loadLibrary() could not find symbol %s", AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR);
+        goto error;
+    }
+
+    if (AUDIO_EFFECT_LIBRARY_TAG != d->tag) {
+        ALOGW("getLibrary() bad tag %08x in lib info struct", d->tag);
+        goto error;
+    }
+
+    if (EFFECT_API_VERSION_MAJOR(d->version) !=
+            EFFECT_API_VERSION_MAJOR(EFFECT_LIBRARY_API_VERSION)) {
+        ALOGW("loadLibrary() bad lib version %08x", d->version);
+        goto error;
     }
+
+    *handle = hdl;
+    *desc = d;
+    return 0;
+
+error:
+    dlclose(hdl);
     return -EINVAL;
 }
 
+int loadLibraryCode(lib_entry_t *l)
+{
+    if (l->desc != NULL) {
+        return 0;
+    }
+    ALOGV("loadLibraryCode() opening cached library %s", l->path);
+    return openLibrary(l->path, &l->handle, &l->desc);
+}
+
+int getEffectDescriptor(lib_entry_t *l, const effect_uuid_t *uuid, effect_descriptor_t *d)
+{
+    list_elem_t *e;
+    desc_cache_entry_t *entry;
+    int ret;
+
+    if (l->cache != NULL) {
+        for (e = l->cache->descs; e != NULL; e = e->next) {
+            entry = (desc_cache_entry_t *)e->object;
+            if (memcmp(&entry->uuid, uuid, sizeof(effect_uuid_t)) == 0) {
+                *d = entry->desc;
+                return 0;
+            }
+        }
+    }
+
+    ret = loadLibraryCode(l);
+    if (ret != 0) {
+        return ret;
+    }
+    ret = l->desc->get_descriptor(uuid, d);
+    if (ret == 0 && l->cache != NULL) {
+        entry = malloc(sizeof(desc_cache_entry_t));
+        entry->uuid = *uuid;
+        entry->desc = *d;
+        e = malloc(sizeof(list_elem_t));
+        e->object = entry;
+        e->next = l->cache->descs;
+        l->cache->descs = e;
+        gLibCacheDirty = 1;
+    }
+    return ret;
+}
+
+// Descriptor cache file layout: a desc_cache_header_t followed by numLibs records, each made of
+// a desc_cache_lib_t, the NUL terminated library path and numDescs desc_cache_entry_t.
+#define DESC_CACHE_MAGIC 0x43584645 // 'EFXC'
+#define DESC_CACHE_VERSION 1
+
+typedef struct desc_cache_header_s {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entrySize;
+    uint32_t numLibs;
+    char fingerprint[PROPERTY_VALUE_MAX]; // the cache is dropped on system updates
+} desc_cache_header_t;
+
+typedef struct desc_cache_lib_s {
+    int64_t mtime;
+    int64_t size;
+    uint32_t pathLen;
+    uint32_t numDescs;
+} desc_cache_lib_t;
+
+int getLibFileId(const char *path, int64_t *mtime, int64_t *size)
+{
+    struct stat st;
+
+    if (stat(path, &st) != 0) {
+        return -errno;
+    }
+    *mtime = (int64_t)st.st_mtime * 1000000000LL + st.st_mtim.tv_nsec;
+    *size = (int64_t)st.st_size;
+    return 0;
+}
+
+// Removes the cache entry for path from gLibCacheList and returns it if the library file
+// did not change since its descriptors were cached
+lib_cache_t *takeLibCache(const char *path)
+{
+    list_elem_t *e = gLibCacheList;
+    list_elem_t *prev = NULL;
+    lib_cache_t *cache;
+    int64_t mtime;
+    int64_t size;
+
+    while (e != NULL) {
+        cache = (lib_cache_t *)e->object;
+        if (strcmp(cache->path, path) == 0) {
+            break;
+        }
+        prev = e;
+        e = e->next;
+    }
+    if (e == NULL) {
+        return NULL;
+    }
+    if (prev != NULL) {
+        prev->next = e->next;
+    } else {
+        gLibCacheList = e->next;
+    }
+    free(e);
+
+    if (getLibFileId(path, &mtime, &size) != 0 || mtime != cache->mtime || size != cache->size) {
+        ALOGV("takeLibCache() library %s changed", path);
+        freeLibCache(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+lib_cache_t *newLibCache(const char *path)
+{
+    lib_cache_t *cache;
+    int64_t mtime;
+    int64_t size;
+
+    if (getLibFileId(path, &mtime, &size) != 0) {
+        return NULL;
+    }
+    cache = malloc(sizeof(lib_cache_t));
+    cache->path = strndup(path, PATH_MAX);
+    cache->mtime = mtime;
+    cache->size = size;
+    cache->descs = NULL;
+    return cache;
+}
+
+void freeLibCache(lib_cache_t *cache)
+{
+    list_elem_t *e;
+
+    while (cache->descs != NULL) {
+        e = cache->descs;
+        cache->descs = e->next;
+        free(e->object);
+        free(e);
+    }
+    free(cache->path);
+    free(cache);
+}
+
+void readDescriptorCache()
+{
+    FILE *file;
+    desc_cache_header_t header;
+    desc_cache_lib_t lib;
+    char fingerprint[PROPERTY_VALUE_MAX];
+    lib_cache_t *cache;
+    desc_cache_entry_t *entry;
+    list_elem_t *e;
+    uint32_t i;
+    uint32_t j;
+
+    file = fopen(EFFECTS_DESCRIPTOR_CACHE_FILE, "rb");
+    if (file == NULL) {
+        return;
+    }
+    memset(fingerprint, 0, sizeof(fingerprint));
+    property_get("ro.build.fingerprint", fingerprint, "");
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+            header.magic != DESC_CACHE_MAGIC ||
+            header.version != DESC_CACHE_VERSION ||
+            header.entrySize != sizeof(desc_cache_entry_t) ||
+            strncmp(header.fingerprint, fingerprint, PROPERTY_VALUE_MAX) != 0) {
+        ALOGV("readDescriptorCache() ignoring stale cache");
+        goto exit;
+    }
+    for (i = 0; i < header.numLibs; i++) {
+        if (fread(&lib, sizeof(lib), 1, file) != 1 ||
+                lib.pathLen == 0 || lib.pathLen > PATH_MAX) {
+            goto bad_file;
+        }
+        cache = malloc(sizeof(lib_cache_t));
+        cache->path = malloc(lib.pathLen);
+        cache->mtime = lib.mtime;
+        cache->size = lib.size;
+        cache->descs = NULL;
+        e = malloc(sizeof(list_elem_t));
+        e->object = cache;
+        e->next = gLibCacheList;
+        gLibCacheList = e;
+        if (fread(cache->path, lib.pathLen, 1, file) != 1 ||
+                cache->path[lib.pathLen - 1] != '\0') {
+            goto bad_file;
+        }
+        for (j = 0; j < lib.numDescs; j++) {
+            entry = malloc(sizeof(desc_cache_entry_t));
+            if (fread(entry, sizeof(desc_cache_entry_t), 1, file) != 1) {
+                free(entry);
+                goto bad_file;
+            }
+            e = malloc(sizeof(list_elem_t));
+            e->object = entry;
+            e->next = cache->descs;
+            cache->descs = e;
+        }
+    }
+    ALOGV("readDescriptorCache() read %u libraries", header.numLibs);
+    goto exit;
+
+bad_file:
+    ALOGW("readDescriptorCache() corrupted cache file %s", EFFECTS_DESCRIPTOR_CACHE_FILE);
+    while (gLibCacheList != NULL) {
+        e = gLibCacheList;
+        gLibCacheList = e->next;
+        freeLibCache((lib_cache_t *)e->object);
+        free(e);
+    }
+exit:
+    fclose(file);
+}
+
+void writeDescriptorCache()
+{
+    char tmpPath[PATH_MAX];
+    FILE *file;
+    desc_cache_header_t header;
+    desc_cache_lib_t lib;
+    lib_entry_t *l;
+    list_elem_t *e;
+    list_elem_t *d;
+    int ok = 1;
+
+    memset(&header, 0, sizeof(header));
+    header.magic = DESC_CACHE_MAGIC;
+    header.version = DESC_CACHE_VERSION;
+    header.entrySize = sizeof(desc_cache_entry_t);
+    property_get("ro.build.fingerprint", header.fingerprint, "");
+    for (e = gLibraryList; e != NULL; e = e->next) {
+        if (((lib_entry_t *)e->object)->cache != NULL) {
+            header.numLibs++;
+        }
+    }
+
+    // write to a temporary file so that a partially written cache is never read
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", EFFECTS_DESCRIPTOR_CACHE_FILE);
+    file = fopen(tmpPath, "wb");
+    if (file == NULL) {
+        ALOGV("writeDescriptorCache() cannot create %s: %s", tmpPath, strerror(errno));
+        return;
+    }
+    ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (e = gLibraryList; e != NULL && ok; e = e->next) {
+        l = (lib_entry_t *)e->object;
+        if (l->cache == NULL) {
+            continue;
+        }
+        memset(&lib, 0, sizeof(lib));
+        lib.mtime = l->cache->mtime;
+        lib.size = l->cache->size;
+        lib.pathLen = strlen(l->cache->path) + 1;
+        for (d = l->cache->descs; d != NULL; d = d->next) {
+            lib.numDescs++;
+        }
+        ok = fwrite(&lib, sizeof(lib), 1, file) == 1 &&
+                fwrite(l->cache->path, lib.pathLen, 1, file) == 1;
+        for (d = l->cache->descs; d != NULL && ok; d = d->next) {
+            ok = fwrite(d->object, sizeof(desc_cache_entry_t), 1, file) == 1;
+        }
+    }
+    if (fclose(file) != 0) {
+        ok = 0;
+    }
+    if (!ok || rename(tmpPath, EFFECTS_DESCRIPTOR_CACHE_FILE) != 0) {
+        ALOGW("writeDescriptorCache() failed to write %s", EFFECTS_DESCRIPTOR_CACHE_FILE);
+        unlink(tmpPath);
+        return;
+    }
+    gLibCacheDirty = 0;
+    ALOGV("writeDescriptorCache() wrote %u libraries", header.numLibs);
+}
+
 // This will find the library and UUID tags of the sub effect pointed by the
 // node, gets the effect descriptor and lib_entry_t and adds the subeffect -
 // sub_entry_t to the gSubEffectList
@@ -612,7 +957,7 @@ int addSubEffect(cnode *root)
         return -EINVAL;
     }
     d = malloc(sizeof(effect_descriptor_t));
-    if (l->desc->get_descriptor(&uuid, d) != 0) {
+    if (getEffectDescriptor(l, &uuid, d) != 0) {
         char s[40];
         uuidToString(&uuid, s, 40);
         ALOGW("Error querying effect %s on lib %s", s, l->name);
@@ -694,7 +1039,7 @@ int loadEffect(cnode *root)
     }
 
     d = malloc(sizeof(effect_descriptor_t));
-    if (l->desc->get_descriptor(&uuid, d) != 0) {
+    if (getEffectDescriptor(l, &uuid, d) != 0) {
         char s[40];
         uuidToString(&uuid, s, 40);
         ALOGW("Error querying effect %s on lib %s", s, l->name);
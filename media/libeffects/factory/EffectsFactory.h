@@ -27,6 +27,16 @@ extern "C" {
 #endif
 
 #define PROPERTY_IGNORE_EFFECTS "ro.audio.ignore_effects"
+// Set to false to always open every library listed in the configuration file at init time
+#define PROPERTY_EFFECTS_DESCRIPTOR_CACHE "ro.audio.effects_descriptor_cache"
+
+// Descriptors returned by the effect libraries, kept across restarts so that a library is only
+// opened when one of its effects is created
+#ifdef __LP64__
+#define EFFECTS_DESCRIPTOR_CACHE_FILE "/data/misc/media/audio_effects_descriptors64.cache"
+#else
+#define EFFECTS_DESCRIPTOR_CACHE_FILE "/data/misc/media/audio_effects_descriptors.cache"
+#endif
 
 typedef struct list_elem_s {
     void *object;
@@ -42,13 +52,29 @@ typedef struct list_sub_elem_s {
     struct list_sub_elem_s *next;
 } list_sub_elem_t;
 
+// Descriptor returned by a library's get_descriptor() for a given uuid
+typedef struct desc_cache_entry_s {
+    effect_uuid_t uuid;
+    effect_descriptor_t desc;
+} desc_cache_entry_t;
+
+// Descriptors cached for a library file. They are only valid while the file keeps
+// the modification time and size it had when they were queried.
+typedef struct lib_cache_s {
+    char *path;
+    int64_t mtime;
+    int64_t size;
+    list_elem_t *descs; // list of desc_cache_entry_t
+} lib_cache_t;
+
 typedef struct lib_entry_s {
-    audio_effect_library_t *desc;
+    audio_effect_library_t *desc; // NULL until the library is opened
     char *name;
     char *path;
     void *handle;
     list_elem_t *effects; //list of effect_descriptor_t
     pthread_mutex_t lock;
+    lib_cache_t *cache; // cached descriptors, NULL if the library is not cached
 } lib_entry_t;
 
 typedef struct effect_entry_s {
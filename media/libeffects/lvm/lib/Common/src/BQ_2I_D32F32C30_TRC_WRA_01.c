@@ -19,6 +19,11 @@
 #include "BQ_2I_D32F32Cll_TRC_WRA_01_Private.h"
 #include "LVM_Macros.h"
 
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define BQ_2I_D32F32C30_NEON
+#endif
+
 /**************************************************************************
  ASSUMPTIONS:
  COEFS-
@@ -44,6 +49,41 @@ void BQ_2I_D32F32C30_TRC_WRA_01 (           Biquad_Instance_t       *pInstance,
 
 
     {
+#ifdef BQ_2I_D32F32C30_NEON
+        /* Left and right channels are processed in the two lanes of a vector. The products are
+           computed on 64 bits and truncated like MUL32x32INTO32, so the output is bit-exact with
+           the C version. */
+        LVM_INT16 ii;
+        PFilter_State pBiquadState = (PFilter_State) pInstance;
+        int32x2_t xn, yn;
+        int32x2_t x1 = vld1_s32(&pBiquadState->pDelays[0]);   /* x(n-1) L,R */
+        int32x2_t x2 = vld1_s32(&pBiquadState->pDelays[2]);   /* x(n-2) L,R */
+        int32x2_t y1 = vld1_s32(&pBiquadState->pDelays[4]);   /* y(n-1) L,R */
+        int32x2_t y2 = vld1_s32(&pBiquadState->pDelays[6]);   /* y(n-2) L,R */
+
+        for (ii = NrSamples; ii != 0; ii--)
+        {
+            xn = vld1_s32(pDataIn);
+            yn = vshrn_n_s64(vmull_n_s32(x2, pBiquadState->coefs[0]), 30);
+            yn = vadd_s32(yn, vshrn_n_s64(vmull_n_s32(x1, pBiquadState->coefs[1]), 30));
+            yn = vadd_s32(yn, vshrn_n_s64(vmull_n_s32(xn, pBiquadState->coefs[2]), 30));
+            yn = vadd_s32(yn, vshrn_n_s64(vmull_n_s32(y2, pBiquadState->coefs[3]), 30));
+            yn = vadd_s32(yn, vshrn_n_s64(vmull_n_s32(y1, pBiquadState->coefs[4]), 30));
+            vst1_s32(pDataOut, yn);
+
+            x2 = x1;
+            x1 = xn;
+            y2 = y1;
+            y1 = yn;
+            pDataIn += 2;
+            pDataOut += 2;
+        }
+
+        vst1_s32(&pBiquadState->pDelays[0], x1);
+        vst1_s32(&pBiquadState->pDelays[2], x2);
+        vst1_s32(&pBiquadState->pDelays[4], y1);
+        vst1_s32(&pBiquadState->pDelays[6], y2);
+#else
         LVM_INT32 ynL,ynR,templ,tempd;
         LVM_INT16 ii;
         PFilter_State pBiquadState = (PFilter_State) pInstance;
@@ -122,5 +162,6 @@ void BQ_2I_D32F32C30_TRC_WRA_01 (           Biquad_Instance_t       *pInstance,
 
         }
 
+#endif
     }
 
@@ -19,6 +19,11 @@
 #include "PK_2I_D32F32CssGss_TRC_WRA_01_Private.h"
 #include "LVM_Macros.h"
 
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PK_2I_D32F32C14G11_NEON
+#endif
+
 /**************************************************************************
  ASSUMPTIONS:
  COEFS-
@@ -43,6 +48,40 @@ void PK_2I_D32F32C14G11_TRC_WRA_01 ( Biquad_Instance_t       *pInstance,
                                      LVM_INT32               *pDataOut,
                                      LVM_INT16               NrSamples)
     {
+#ifdef PK_2I_D32F32C14G11_NEON
+        /* Left and right channels are processed in the two lanes of a vector. The products are
+           computed on 64 bits and truncated like MUL32x16INTO32, so the output is bit-exact with
+           the C version. */
+        LVM_INT16 ii;
+        PFilter_State pBiquadState = (PFilter_State) pInstance;
+        int32x2_t xn, yn, yo;
+        int32x2_t x1 = vld1_s32(&pBiquadState->pDelays[0]);   /* x(n-1) L,R */
+        int32x2_t x2 = vld1_s32(&pBiquadState->pDelays[2]);   /* x(n-2) L,R */
+        int32x2_t y1 = vld1_s32(&pBiquadState->pDelays[4]);   /* y(n-1) L,R */
+        int32x2_t y2 = vld1_s32(&pBiquadState->pDelays[6]);   /* y(n-2) L,R */
+
+        for (ii = NrSamples; ii != 0; ii--)
+        {
+            xn = vld1_s32(pDataIn);
+            yn = vshrn_n_s64(vmull_n_s32(vsub_s32(xn, x2), pBiquadState->coefs[0]), 14);
+            yn = vadd_s32(yn, vshrn_n_s64(vmull_n_s32(y2, pBiquadState->coefs[1]), 14));
+            yn = vadd_s32(yn, vshrn_n_s64(vmull_n_s32(y1, pBiquadState->coefs[2]), 14));
+            yo = vadd_s32(vshrn_n_s64(vmull_n_s32(yn, pBiquadState->coefs[3]), 11), xn);
+            vst1_s32(pDataOut, yo);
+
+            x2 = x1;
+            x1 = xn;
+            y2 = y1;
+            y1 = yn;
+            pDataIn += 2;
+            pDataOut += 2;
+        }
+
+        vst1_s32(&pBiquadState->pDelays[0], x1);
+        vst1_s32(&pBiquadState->pDelays[2], x2);
+        vst1_s32(&pBiquadState->pDelays[4], y1);
+        vst1_s32(&pBiquadState->pDelays[6], y2);
+#else
         LVM_INT32 ynL,ynR,ynLO,ynRO,templ;
         LVM_INT16 ii;
         PFilter_State pBiquadState = (PFilter_State) pInstance;
@@ -117,5 +156,6 @@ void PK_2I_D32F32C14G11_TRC_WRA_01 ( Biquad_Instance_t       *pInstance,
 
         }
 
+#endif
     }
 
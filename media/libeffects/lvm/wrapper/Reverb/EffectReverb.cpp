@@ -753,7 +753,7 @@ int Reverb_init(ReverbContext *pContext){
     bool                      bMallocFailure = LVM_FALSE;
 
     /* Set the capabilities */
-    InstParams.MaxBlockSize  = MAX_CALL_SIZE;
+    InstParams.MaxBlockSize  = LVREV_MAX_BLOCK_SIZE;
     InstParams.SourceFormat  = LVM_STEREO;          // Max format, could be mono during process
     InstParams.NumDelays     = LVREV_DELAYLINES_4;
 
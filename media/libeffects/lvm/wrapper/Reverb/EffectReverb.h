@@ -29,8 +29,12 @@ extern "C" {
 #define LVREV_MAX_T60           7000
 #define LVREV_MAX_REVERB_LEVEL  2000
 #define LVREV_MAX_FRAME_SIZE    2560
+// Largest internal block. The library also limits blocks to the shortest delay line, but each
+// block shifts every delay line, so larger blocks are much cheaper per sample.
+#define LVREV_MAX_BLOCK_SIZE    1024
 #define LVREV_CUP_LOAD_ARM9E    470    // Expressed in 0.1 MIPS
-#define LVREV_MEM_USAGE         71+(LVREV_MAX_FRAME_SIZE>>7)     // Expressed in kB
+// 7 scratch buffers of LVREV_MAX_BLOCK_SIZE 32 bit samples
+#define LVREV_MEM_USAGE         64+(LVREV_MAX_FRAME_SIZE>>7)+(LVREV_MAX_BLOCK_SIZE*28>>10)     // Expressed in kB
 //#define LVM_PCM
 
 typedef struct _LPFPair_t
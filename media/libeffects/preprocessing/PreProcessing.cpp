@@ -1208,6 +1208,40 @@ int PreProcessingFx_Process(effect_handle_t     self,
             return 0;
         }
 
+        // Without resampling and with nothing buffered, process all the whole 10 ms frames of
+        // the input buffer in one call, reading from the input buffer and writing to the output
+        // buffer directly instead of going through the session output buffer.
+        if (session->inResampler == NULL && framesWr == 0 && session->framesIn == 0 &&
+                inBuffer->frameCount >= session->frameCount &&
+                framesRq >= session->frameCount) {
+            size_t frames = inBuffer->frameCount < framesRq ? inBuffer->frameCount : framesRq;
+            frames -= frames % session->frameCount;
+#ifdef DUAL_MIC_TEST
+            pthread_mutex_lock(&gPcmDumpLock);
+            if (gPcmDumpFh != NULL) {
+                fwrite(inBuffer->raw,
+                       frames * session->inChannelCount * sizeof(int16_t), 1, gPcmDumpFh);
+            }
+            pthread_mutex_unlock(&gPcmDumpLock);
+#endif
+            for (size_t i = 0; i < frames; i += session->frameCount) {
+                memcpy(session->procFrame->_payloadData,
+                       inBuffer->s16 + i * session->inChannelCount,
+                       session->frameCount * session->inChannelCount * sizeof(int16_t));
+                session->procFrame->_payloadDataLengthInSamples =
+                        session->apmFrameCount * session->inChannelCount;
+
+                effect->session->apm->ProcessStream(session->procFrame);
+
+                memcpy(outBuffer->s16 + i * session->outChannelCount,
+                       session->procFrame->_payloadData,
+                       session->frameCount * session->outChannelCount * sizeof(int16_t));
+            }
+            inBuffer->frameCount = frames;
+            outBuffer->frameCount = frames;
+            return 0;
+        }
+
         if (session->inResampler != NULL) {
             size_t fr = session->frameCount - session->framesIn;
             if (inBuffer->frameCount < fr) {
@@ -1738,6 +1772,22 @@ int PreProcessingFx_ProcessReverse(effect_handle_t     self,
 
     if ((session->revProcessedMsk & session->revEnabledMsk) == session->revEnabledMsk) {
         effect->session->revProcessedMsk = 0;
+        // Without resampling and with nothing buffered, analyze all the whole 10 ms frames of
+        // the reverse buffer in one call.
+        if (session->revResampler == NULL && session->framesRev == 0 &&
+                inBuffer->frameCount >= session->frameCount) {
+            size_t frames = inBuffer->frameCount - inBuffer->frameCount % session->frameCount;
+            for (size_t i = 0; i < frames; i += session->frameCount) {
+                memcpy(session->revFrame->_payloadData,
+                       inBuffer->s16 + i * session->inChannelCount,
+                       session->frameCount * session->inChannelCount * sizeof(int16_t));
+                session->revFrame->_payloadDataLengthInSamples =
+                        session->apmFrameCount * session->inChannelCount;
+                effect->session->apm->AnalyzeReverseStream(session->revFrame);
+            }
+            inBuffer->frameCount = frames;
+            return 0;
+        }
         if (session->revResampler != NULL) {
             size_t fr = session->frameCount - session->framesRev;
             if (inBuffer->frameCount < fr) {
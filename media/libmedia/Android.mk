@@ -52,6 +52,7 @@ LOCAL_SRC_FILES:= \
     ToneGenerator.cpp \
     JetPlayer.cpp \
     IOMX.cpp \
+    OMXMessageRing.cpp \
     IAudioPolicyService.cpp \
     IAudioPolicyServiceClient.cpp \
     MediaScanner.cpp \
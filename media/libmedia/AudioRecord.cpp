@@ -301,6 +301,8 @@ status_t AudioRecord::start(AudioSystem::sync_event_t event, int triggerSession)
 
     // reset current position as seen by client to 0
     mProxy->setEpoch(mProxy->getEpoch() - mProxy->getPosition());
+    // timestamps reported before the reset use the old epoch
+    mProxy->resetTimestamp();
     // force refresh of remaining frames by processAudioBuffer() as last
     // read before stop could be partial.
     mRefreshRemaining = true;
@@ -438,6 +440,15 @@ status_t AudioRecord::getPosition(uint32_t *position) const
     return NO_ERROR;
 }
 
+status_t AudioRecord::getTimestamp(AudioTimestamp& timestamp)
+{
+    AutoMutex lock(mLock);
+    if (!mActive) {
+        return INVALID_OPERATION;
+    }
+    return mProxy->getTimestamp(&timestamp);
+}
+
 uint32_t AudioRecord::getInputFramesLost() const
 {
     // no need to check mActive, because if inactive this will return 0, which is what we want
@@ -483,24 +494,16 @@ status_t AudioRecord::openRecord_l(size_t epoch, const String16& opPackageName)
         return NO_INIT;
     }
 
-    // Fast tracks must be at the primary _output_ [sic] sampling rate,
-    // because there is currently no concept of a primary input sampling rate
-    uint32_t afSampleRate = AudioSystem::getPrimaryOutputSamplingRate();
-    if (afSampleRate == 0) {
-        ALOGW("getPrimaryOutputSamplingRate failed");
-    }
-
-    // Client can only express a preference for FAST.  Server will perform additional tests.
-    if ((mFlags & AUDIO_INPUT_FLAG_FAST) && !((
+    // Client can only express a preference for FAST.  Server will perform additional tests,
+    // including whether the sample rate can be converted from the input's.
+    if ((mFlags & AUDIO_INPUT_FLAG_FAST) && !(
             // either of these use cases:
             // use case 1: callback transfer mode
             (mTransfer == TRANSFER_CALLBACK) ||
             // use case 2: obtain/release mode
-            (mTransfer == TRANSFER_OBTAIN)) &&
-            // matching sample rate
-            (mSampleRate == afSampleRate))) {
-        ALOGW("AUDIO_INPUT_FLAG_FAST denied by client; transfer %d, track %u Hz, primary %u Hz",
-                mTransfer, mSampleRate, afSampleRate);
+            (mTransfer == TRANSFER_OBTAIN))) {
+        ALOGW("AUDIO_INPUT_FLAG_FAST denied by client; transfer %d, track %u Hz",
+                mTransfer, mSampleRate);
         // once denied, do not request again if IAudioRecord is re-created
         mFlags = (audio_input_flags_t) (mFlags & ~AUDIO_INPUT_FLAG_FAST);
     }
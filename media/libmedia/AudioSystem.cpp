@@ -95,6 +95,31 @@ sp<AudioIoDescriptor> AudioSystem::getIoDescriptor(audio_io_handle_t ioHandle)
     return desc;
 }
 
+// Returns the descriptor of an output, caching the output parameters queried from AudioFlinger
+// if the AUDIO_OUTPUT_OPENED event for it has not reached this process yet. This way creating a
+// track queries them at most once, rather than once per getter until the event arrives.
+sp<AudioIoDescriptor> AudioSystem::getOutputDescriptor(audio_io_handle_t output)
+{
+    const sp<IAudioFlinger>& af = AudioSystem::get_audio_flinger();
+    if (af == 0) return 0;
+    const sp<AudioFlingerClient> afc = getAudioFlingerClient();
+    if (afc == 0) return 0;
+    sp<AudioIoDescriptor> desc = afc->getIoDescriptor(output);
+    if (desc == 0) {
+        ALOGV("getOutputDescriptor() no output descriptor for output %d, querying", output);
+        desc = new AudioIoDescriptor();
+        desc->mIoHandle = output;
+        desc->mSamplingRate = af->sampleRate(output);
+        desc->mFrameCount = af->frameCount(output);
+        desc->mLatency = af->latency(output);
+        // zero values mean AudioFlinger does not know the output, don't cache those
+        if (desc->mSamplingRate != 0 && desc->mFrameCount != 0) {
+            desc = afc->addIoDescriptor(desc);
+        }
+    }
+    return desc;
+}
+
 /* static */ status_t AudioSystem::checkAudioFlinger()
 {
     if (defaultServiceManager()->checkService(String16("media.audio_flinger")) != 0) {
@@ -266,16 +291,9 @@ status_t AudioSystem::getOutputSamplingRate(uint32_t* samplingRate, audio_stream
 status_t AudioSystem::getSamplingRate(audio_io_handle_t output,
                                       uint32_t* samplingRate)
 {
-    const sp<IAudioFlinger>& af = AudioSystem::get_audio_flinger();
-    if (af == 0) return PERMISSION_DENIED;
-    sp<AudioIoDescriptor> outputDesc = getIoDescriptor(output);
-    if (outputDesc == 0) {
-        ALOGV("getOutputSamplingRate() no output descriptor for output %d in gOutputs", output);
-        *samplingRate = af->sampleRate(output);
-    } else {
-        ALOGV("getOutputSamplingRate() reading from output desc");
-        *samplingRate = outputDesc->mSamplingRate;
-    }
+    sp<AudioIoDescriptor> outputDesc = getOutputDescriptor(output);
+    if (outputDesc == 0) return PERMISSION_DENIED;
+    *samplingRate = outputDesc->mSamplingRate;
     if (*samplingRate == 0) {
         ALOGE("AudioSystem::getSamplingRate failed for output %d", output);
         return BAD_VALUE;
@@ -305,14 +323,9 @@ status_t AudioSystem::getOutputFrameCount(size_t* frameCount, audio_stream_type_
 status_t AudioSystem::getFrameCount(audio_io_handle_t output,
                                     size_t* frameCount)
 {
-    const sp<IAudioFlinger>& af = AudioSystem::get_audio_flinger();
-    if (af == 0) return PERMISSION_DENIED;
-    sp<AudioIoDescriptor> outputDesc = getIoDescriptor(output);
-    if (outputDesc == 0) {
-        *frameCount = af->frameCount(output);
-    } else {
-        *frameCount = outputDesc->mFrameCount;
-    }
+    sp<AudioIoDescriptor> outputDesc = getOutputDescriptor(output);
+    if (outputDesc == 0) return PERMISSION_DENIED;
+    *frameCount = outputDesc->mFrameCount;
     if (*frameCount == 0) {
         ALOGE("AudioSystem::getFrameCount failed for output %d", output);
         return BAD_VALUE;
@@ -342,14 +355,9 @@ status_t AudioSystem::getOutputLatency(uint32_t* latency, audio_stream_type_t st
 status_t AudioSystem::getLatency(audio_io_handle_t output,
                                  uint32_t* latency)
 {
-    const sp<IAudioFlinger>& af = AudioSystem::get_audio_flinger();
-    if (af == 0) return PERMISSION_DENIED;
-    sp<AudioIoDescriptor> outputDesc = getIoDescriptor(output);
-    if (outputDesc == 0) {
-        *latency = af->latency(output);
-    } else {
-        *latency = outputDesc->mLatency;
-    }
+    sp<AudioIoDescriptor> outputDesc = getOutputDescriptor(output);
+    if (outputDesc == 0) return PERMISSION_DENIED;
+    *latency = outputDesc->mLatency;
 
     ALOGV("getLatency() output %d, latency %d", output, *latency);
 
@@ -591,6 +599,19 @@ sp<AudioIoDescriptor> AudioSystem::AudioFlingerClient::getIoDescriptor(audio_io_
     return getIoDescriptor_l(ioHandle);
 }
 
+sp<AudioIoDescriptor> AudioSystem::AudioFlingerClient::addIoDescriptor(
+        const sp<AudioIoDescriptor>& ioDesc)
+{
+    Mutex::Autolock _l(mLock);
+    // a descriptor received through ioConfigChanged() in the meantime is more complete
+    sp<AudioIoDescriptor> desc = getIoDescriptor_l(ioDesc->mIoHandle);
+    if (desc == 0) {
+        mIoDescriptors.add(ioDesc->mIoHandle, ioDesc);
+        desc = ioDesc;
+    }
+    return desc;
+}
+
 status_t AudioSystem::AudioFlingerClient::addAudioDeviceCallback(
         const sp<AudioDeviceCallback>& callback, audio_io_handle_t audioIo)
 {
@@ -120,23 +120,33 @@ status_t AudioTrack::getMinFrameCount(
     //          audio_format_t format
     //          audio_channel_mask_t channelMask
     //          audio_output_flags_t flags (FAST)
+    // Resolve the output once rather than in each of the getOutputXxx() queries.
+    if (streamType == AUDIO_STREAM_DEFAULT) {
+        streamType = AUDIO_STREAM_MUSIC;
+    }
+    audio_io_handle_t output = AudioSystem::getOutput(streamType);
+    if (output == AUDIO_IO_HANDLE_NONE) {
+        ALOGE("Unable to get output for stream type %d", streamType);
+        return PERMISSION_DENIED;
+    }
+
     uint32_t afSampleRate;
     status_t status;
-    status = AudioSystem::getOutputSamplingRate(&afSampleRate, streamType);
+    status = AudioSystem::getSamplingRate(output, &afSampleRate);
     if (status != NO_ERROR) {
         ALOGE("Unable to query output sample rate for stream type %d; status %d",
                 streamType, status);
         return status;
     }
     size_t afFrameCount;
-    status = AudioSystem::getOutputFrameCount(&afFrameCount, streamType);
+    status = AudioSystem::getFrameCount(output, &afFrameCount);
     if (status != NO_ERROR) {
         ALOGE("Unable to query output frame count for stream type %d; status %d",
                 streamType, status);
         return status;
     }
     uint32_t afLatency;
-    status = AudioSystem::getOutputLatency(&afLatency, streamType);
+    status = AudioSystem::getLatency(output, &afLatency);
     if (status != NO_ERROR) {
         ALOGE("Unable to query output latency for stream type %d; status %d",
                 streamType, status);
@@ -1589,6 +1599,15 @@ void AudioTrack::releaseBuffer(const Buffer* audioBuffer)
 // -------------------------------------------------------------------------
 
 ssize_t AudioTrack::write(const void* buffer, size_t userSize, bool blocking)
+{
+    // writev() does the sanity-checks on buffer and userSize
+    struct iovec iov;
+    iov.iov_base = const_cast<void *>(buffer);
+    iov.iov_len = userSize;
+    return writev(&iov, 1, blocking);
+}
+
+ssize_t AudioTrack::writev(const struct iovec* iov, int iovcnt, bool blocking)
 {
     if (mTransfer != TRANSFER_SYNC || mIsTimed) {
         return INVALID_OPERATION;
@@ -1604,15 +1623,28 @@ ssize_t AudioTrack::write(const void* buffer, size_t userSize, bool blocking)
         }
     }
 
-    if (ssize_t(userSize) < 0 || (buffer == NULL && userSize != 0)) {
+    if (iovcnt < 0 || (iov == NULL && iovcnt != 0)) {
+        ALOGE("AudioTrack::writev(iov=%p, iovcnt=%d)", iov, iovcnt);
+        return BAD_VALUE;
+    }
+    size_t userSize = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        const size_t len = iov[i].iov_len;
         // Sanity-check: user is most-likely passing an error code, and it would
         // make the return value ambiguous (actualSize vs error).
-        ALOGE("AudioTrack::write(buffer=%p, size=%zu (%zd)", buffer, userSize, userSize);
-        return BAD_VALUE;
+        if (ssize_t(len) < 0 || (iov[i].iov_base == NULL && len != 0)
+                || ssize_t(userSize + len) < 0) {
+            ALOGE("AudioTrack::writev(iov[%d].iov_base=%p, iov_len=%zu (%zd)",
+                    i, iov[i].iov_base, len, len);
+            return BAD_VALUE;
+        }
+        userSize += len;
     }
 
     size_t written = 0;
     Buffer audioBuffer;
+    int index = 0;      // current entry of iov
+    size_t offset = 0;  // bytes of iov[index] already consumed
 
     while (userSize >= mFrameSize) {
         audioBuffer.frameCount = userSize / mFrameSize;
@@ -1626,9 +1658,21 @@ ssize_t AudioTrack::write(const void* buffer, size_t userSize, bool blocking)
             return ssize_t(err);
         }
 
+        // gather as many entries as fit into this contiguous region
         size_t toWrite = audioBuffer.size;
-        memcpy(audioBuffer.i8, buffer, toWrite);
-        buffer = ((const char *) buffer) + toWrite;
+        char *dst = (char *) audioBuffer.raw;
+        for (size_t remaining = toWrite; remaining > 0; ) {
+            const size_t len = iov[index].iov_len - offset;
+            const size_t copy = len < remaining ? len : remaining;
+            memcpy(dst, (const char *) iov[index].iov_base + offset, copy);
+            dst += copy;
+            remaining -= copy;
+            offset += copy;
+            if (offset == iov[index].iov_len) {
+                ++index;
+                offset = 0;
+            }
+        }
         userSize -= toWrite;
         written += toWrite;
 
@@ -590,6 +590,29 @@ void StaticAudioTrackClientProxy::getBufferPositionAndLoopCount(
 
 // ---------------------------------------------------------------------------
 
+status_t AudioRecordClientProxy::getTimestamp(AudioTimestamp *timestamp)
+{
+    if (mTimestampObserver.poll(mTimestamp)) {
+        mTimestampValid = true;
+    }
+    if (!mTimestampValid) {
+        return WOULD_BLOCK;
+    }
+    *timestamp = mTimestamp;
+    // the server reports mServer, which getPosition() offsets by the epoch
+    timestamp->mPosition += (uint32_t) getEpoch();
+    return NO_ERROR;
+}
+
+void AudioRecordClientProxy::resetTimestamp()
+{
+    // drain a timestamp pushed before the epoch change
+    (void) mTimestampObserver.poll(mTimestamp);
+    mTimestampValid = false;
+}
+
+// ---------------------------------------------------------------------------
+
 ServerProxy::ServerProxy(audio_track_cblk_t* cblk, void *buffers, size_t frameCount,
         size_t frameSize, bool isOut, bool clientInServer)
     : Proxy(cblk, buffers, frameCount, frameSize, isOut, clientInServer),
@@ -1042,4 +1065,14 @@ void StaticAudioTrackServerProxy::tallyUnderrunFrames(uint32_t frameCount __unus
 
 // ---------------------------------------------------------------------------
 
+void AudioRecordServerProxy::setTimestamp(const struct timespec& time)
+{
+    AudioTimestamp timestamp;
+    timestamp.mPosition = mCblk->mServer;
+    timestamp.mTime = time;
+    mTimestampMutator.push(timestamp);
+}
+
+// ---------------------------------------------------------------------------
+
 }   // namespace android
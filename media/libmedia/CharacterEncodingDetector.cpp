@@ -28,20 +28,124 @@
 #include "unicode/ucsdet.h"
 #include "unicode/ustring.h"
 
+#include <pthread.h>
+
 namespace android {
 
-CharacterEncodingDetector::CharacterEncodingDetector() {
+// Opening ICU detectors and converters is expensive compared to running them on a few short
+// tags, so every thread keeps its own set alive and reuses it for all the files it scans.
+static const size_t kMaxCachedConverters = 8;
+
+struct DetectorContext {
+    UCharsetDetector *mDetector;
+    UConverter *mUtf8Conv;
+
+    struct CachedConverter {
+        char mName[32];
+        UConverter *mConv;
+    };
+    CachedConverter mConverters[kMaxCachedConverters];
+    size_t mNextConverter;  // slot to evict next, round robin
+};
+
+static pthread_key_t sContextKey;
+static pthread_once_t sContextKeyOnce = PTHREAD_ONCE_INIT;
+
+static void deleteContext(void *data) {
+    DetectorContext *ctx = (DetectorContext *)data;
+    for (size_t i = 0; i < kMaxCachedConverters; i++) {
+        if (ctx->mConverters[i].mConv != NULL) {
+            ucnv_close(ctx->mConverters[i].mConv);
+        }
+    }
+    ucnv_close(ctx->mUtf8Conv);
+    ucsdet_close(ctx->mDetector);
+    delete ctx;
+}
+
+static void createContextKey() {
+    pthread_key_create(&sContextKey, deleteContext);
+}
+
+// Returns the calling thread's detector context, or NULL if ICU could not provide one.
+static DetectorContext *getContext() {
+    pthread_once(&sContextKeyOnce, createContextKey);
+
+    DetectorContext *ctx = (DetectorContext *)pthread_getspecific(sContextKey);
+    if (ctx != NULL) {
+        return ctx;
+    }
 
     UErrorCode status = U_ZERO_ERROR;
-    mUtf8Conv = ucnv_open("UTF-8", &status);
+    UConverter *utf8Conv = ucnv_open("UTF-8", &status);
     if (U_FAILURE(status)) {
         ALOGE("could not create UConverter for UTF-8");
-        mUtf8Conv = NULL;
+        return NULL;
+    }
+    status = U_ZERO_ERROR;
+    UCharsetDetector *detector = ucsdet_open(&status);
+    if (U_FAILURE(status)) {
+        ALOGE("could not create UCharsetDetector");
+        ucnv_close(utf8Conv);
+        return NULL;
+    }
+
+    ctx = new DetectorContext;
+    ctx->mDetector = detector;
+    ctx->mUtf8Conv = utf8Conv;
+    for (size_t i = 0; i < kMaxCachedConverters; i++) {
+        ctx->mConverters[i].mName[0] = 0;
+        ctx->mConverters[i].mConv = NULL;
     }
+    ctx->mNextConverter = 0;
+    pthread_setspecific(sContextKey, ctx);
+    return ctx;
+}
+
+// Returns a reset converter for the given encoding from the thread's cache, opening it if
+// needed. The converter is owned by the cache and must not be closed.
+static UConverter *getConverter(DetectorContext *ctx, const char *enc, UErrorCode *status) {
+    for (size_t i = 0; i < kMaxCachedConverters; i++) {
+        DetectorContext::CachedConverter &cached = ctx->mConverters[i];
+        if (cached.mConv != NULL && !strcmp(cached.mName, enc)) {
+            ucnv_reset(cached.mConv);
+            return cached.mConv;
+        }
+    }
+
+    UConverter *conv = ucnv_open(enc, status);
+    if (U_FAILURE(*status)) {
+        return NULL;
+    }
+    if (strlen(enc) >= sizeof(ctx->mConverters[0].mName)) {
+        // not worth caching; should not happen with the names ICU detects
+        ALOGW("not caching converter for %s", enc);
+        return conv;
+    }
+
+    DetectorContext::CachedConverter &slot = ctx->mConverters[ctx->mNextConverter];
+    if (slot.mConv != NULL) {
+        ucnv_close(slot.mConv);
+    }
+    strlcpy(slot.mName, enc, sizeof(slot.mName));
+    slot.mConv = conv;
+    ctx->mNextConverter = (ctx->mNextConverter + 1) % kMaxCachedConverters;
+    return conv;
+}
+
+static bool isCachedConverter(DetectorContext *ctx, UConverter *conv) {
+    for (size_t i = 0; i < kMaxCachedConverters; i++) {
+        if (ctx->mConverters[i].mConv == conv) {
+            return true;
+        }
+    }
+    return false;
+}
+
+CharacterEncodingDetector::CharacterEncodingDetector() {
 }
 
 CharacterEncodingDetector::~CharacterEncodingDetector() {
-    ucnv_close(mUtf8Conv);
 }
 
 void CharacterEncodingDetector::addTag(const char *name, const char *value) {
@@ -72,18 +176,90 @@ static bool isPrintableAscii(const char *value, size_t len) {
     return true;
 }
 
+// Returns true if value is printable text in well-formed UTF-8 with at least one multibyte
+// sequence. Legacy 8-bit and CJK encodings practically never produce such byte sequences, so
+// these values need no detection or conversion.
+static bool isPrintableUtf8(const char *value, size_t len) {
+    const uint8_t *s = (const uint8_t *)value;
+    bool multibyte = false;
+    size_t i = 0;
+    while (i < len) {
+        uint8_t c = s[i];
+        if (c < 0x80) {
+            if (c < 0x20 || c == 0x7f) {
+                return false;
+            }
+            i++;
+            continue;
+        }
+
+        size_t n;
+        uint32_t cp;
+        if (c >= 0xc2 && c <= 0xdf) {
+            n = 1;
+            cp = c & 0x1f;
+        } else if (c >= 0xe0 && c <= 0xef) {
+            n = 2;
+            cp = c & 0x0f;
+        } else if (c >= 0xf0 && c <= 0xf4) {
+            n = 3;
+            cp = c & 0x07;
+        } else {
+            return false;
+        }
+        if (len - i <= n) {
+            return false;
+        }
+        for (size_t j = 1; j <= n; j++) {
+            if ((s[i + j] & 0xc0) != 0x80) {
+                return false;
+            }
+            cp = (cp << 6) | (s[i + j] & 0x3f);
+        }
+        // reject overlong forms, surrogates, C1 controls and values past U+10FFFF
+        if ((n == 2 && cp < 0x800) || (n == 3 && (cp < 0x10000 || cp > 0x10ffff))
+                || (cp >= 0xd800 && cp <= 0xdfff) || (cp >= 0x80 && cp <= 0x9f)) {
+            return false;
+        }
+        multibyte = true;
+        i += n + 1;
+    }
+    return multibyte;
+}
+
 void CharacterEncodingDetector::detectAndConvert() {
 
     int size = mNames.size();
     ALOGV("%d tags before conversion", size);
+    bool needsdetection = false;
     for (int i = 0; i < size; i++) {
-        ALOGV("%s: %s", mNames.getEntry(i), mValues.getEntry(i));
+        const char *value = mValues.getEntry(i);
+        ALOGV("%s: %s", mNames.getEntry(i), value);
+        size_t len = strlen(value);
+        if (!isPrintableAscii(value, len) && !isPrintableUtf8(value, len)) {
+            needsdetection = true;
+        }
+    }
+
+    if (size && !needsdetection) {
+        // all tags are already ascii or UTF-8, no need to even open ICU
+        ALOGV("all tags are ascii or UTF-8");
+        for (int i = size - 1; i >= 0; --i) {
+            if (strlen(mValues.getEntry(i)) == 0) {
+                ALOGV("erasing %s because entry is empty", mNames.getEntry(i));
+                mNames.erase(i);
+                mValues.erase(i);
+            }
+        }
+        return;
     }
 
-    if (size && mUtf8Conv) {
+    DetectorContext *ctx = size ? getContext() : NULL;
+
+    if (ctx != NULL) {
 
         UErrorCode status = U_ZERO_ERROR;
-        UCharsetDetector *csd = ucsdet_open(&status);
+        UCharsetDetector *csd = ctx->mDetector;
         const UCharsetMatch *ucm;
 
         // try combined detection of artist/album/title etc.
@@ -186,6 +362,9 @@ void CharacterEncodingDetector::detectAndConvert() {
                 if (isPrintableAscii(s, inputLength)) {
                     enc = "UTF-8";
                     ALOGV("@@@@ %s is ascii", mNames.getEntry(i));
+                } else if (isPrintableUtf8(s, inputLength)) {
+                    enc = "UTF-8";
+                    ALOGV("@@@@ %s is UTF-8", mNames.getEntry(i));
                 } else {
                     ucsdet_setText(csd, s, inputLength, &status);
                     ucm = ucsdet_detect(csd, &status);
@@ -203,12 +382,12 @@ void CharacterEncodingDetector::detectAndConvert() {
                 // only convert if the source encoding isn't already UTF-8
                 ALOGV("@@@ using converter %s for %s", enc, mNames.getEntry(i));
                 status = U_ZERO_ERROR;
-                UConverter *conv = ucnv_open(enc, &status);
+                UConverter *conv = getConverter(ctx, enc, &status);
                 if (U_FAILURE(status)) {
                     ALOGW("could not create UConverter for %s (%d), falling back to ISO-8859-1",
                             enc, status);
                     status = U_ZERO_ERROR;
-                    conv = ucnv_open("ISO-8859-1", &status);
+                    conv = getConverter(ctx, "ISO-8859-1", &status);
                     if (U_FAILURE(status)) {
                         ALOGW("could not create UConverter for ISO-8859-1 either");
                         continue;
@@ -224,7 +403,7 @@ void CharacterEncodingDetector::detectAndConvert() {
                     break;
                 char* target = buffer;
 
-                ucnv_convertEx(mUtf8Conv, conv, &target, target + targetLength,
+                ucnv_convertEx(ctx->mUtf8Conv, conv, &target, target + targetLength,
                         &source, source + strlen(source),
                         NULL, NULL, NULL, NULL, TRUE, TRUE, &status);
 
@@ -248,7 +427,9 @@ void CharacterEncodingDetector::detectAndConvert() {
 
                 delete[] buffer;
 
-                ucnv_close(conv);
+                if (!isCachedConverter(ctx, conv)) {
+                    ucnv_close(conv);
+                }
             }
         }
 
@@ -259,8 +440,6 @@ void CharacterEncodingDetector::detectAndConvert() {
                 mValues.erase(i);
             }
         }
-
-        ucsdet_close(csd);
     }
 }
 
@@ -285,6 +464,7 @@ const UCharsetMatch *CharacterEncodingDetector::getPreferred(
     *goodmatch = false;
     Vector<const UCharsetMatch*> matches;
     UErrorCode status = U_ZERO_ERROR;
+    DetectorContext *ctx = getContext();
 
     ALOGV("%zu matches", nummatches);
     for (size_t i = 0; i < nummatches; i++) {
@@ -336,9 +516,9 @@ const UCharsetMatch *CharacterEncodingDetector::getPreferred(
 
         ALOGV("%zu: %s %d", i, encname, confidence);
         status = U_ZERO_ERROR;
-        UConverter *conv = ucnv_open(encname, &status);
+        UConverter *conv = ctx != NULL ? getConverter(ctx, encname, &status) : NULL;
         int demerit = 0;
-        if (U_FAILURE(status)) {
+        if (conv == NULL || U_FAILURE(status)) {
             ALOGV("failed to open %s: %d", encname, status);
             confidence = 0;
             demerit += 1000;
@@ -348,7 +528,7 @@ const UCharsetMatch *CharacterEncodingDetector::getPreferred(
         status = U_ZERO_ERROR;
         int frequentchars = 0;
         int totalchars = 0;
-        while (true) {
+        while (conv != NULL) {
             // demerit the current encoding for each "special" character found after conversion.
             // The amount of demerit is somewhat arbitrarily chosen.
             int inchar;
@@ -399,7 +579,9 @@ const UCharsetMatch *CharacterEncodingDetector::getPreferred(
         }
         ALOGV("%d-%d=%d", confidence, demerit, confidence - demerit);
         newconfidence.push_back(confidence - demerit);
-        ucnv_close(conv);
+        if (conv != NULL && !isCachedConverter(ctx, conv)) {
+            ucnv_close(conv);
+        }
         if (i == 0 && (confidence - demerit) == 100) {
             // no need to check any further, we'll end up using this match anyway
             break;
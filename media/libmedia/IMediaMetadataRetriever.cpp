@@ -70,6 +70,7 @@ enum {
     GET_FRAME_AT_TIME,
     EXTRACT_ALBUM_ART,
     EXTRACT_METADATA,
+    GET_FRAMES_AT_TIMES,
 };
 
 class BpMediaMetadataRetriever: public BpInterface<IMediaMetadataRetriever>
@@ -154,6 +155,27 @@ public:
         return interface_cast<IMemory>(reply.readStrongBinder());
     }
 
+    sp<IMemory> getFramesAtTimes(const Vector<int64_t> &timesUs, int option)
+    {
+        ALOGV("getFramesAtTimes: %zu times and option(%d)", timesUs.size(), option);
+        Parcel data, reply;
+        data.writeInterfaceToken(IMediaMetadataRetriever::getInterfaceDescriptor());
+        data.writeInt32(timesUs.size());
+        for (size_t i = 0; i < timesUs.size(); ++i) {
+            data.writeInt64(timesUs[i]);
+        }
+        data.writeInt32(option);
+#ifndef DISABLE_GROUP_SCHEDULE_HACK
+        sendSchedPolicy(data);
+#endif
+        remote()->transact(GET_FRAMES_AT_TIMES, data, &reply);
+        status_t ret = reply.readInt32();
+        if (ret != NO_ERROR) {
+            return NULL;
+        }
+        return interface_cast<IMemory>(reply.readStrongBinder());
+    }
+
     sp<IMemory> extractAlbumArt()
     {
         Parcel data, reply;
@@ -270,6 +292,35 @@ status_t BnMediaMetadataRetriever::onTransact(
             }
 #ifndef DISABLE_GROUP_SCHEDULE_HACK
             restoreSchedPolicy();
+#endif
+            return NO_ERROR;
+        } break;
+        case GET_FRAMES_AT_TIMES: {
+            CHECK_INTERFACE(IMediaMetadataRetriever, data, reply);
+            size_t numTimes = data.readInt32();
+            if (numTimes > data.dataAvail() / sizeof(int64_t)) {
+                reply->writeInt32(BAD_VALUE);
+                return NO_ERROR;
+            }
+            Vector<int64_t> timesUs;
+            timesUs.setCapacity(numTimes);
+            for (size_t i = 0; i < numTimes; ++i) {
+                timesUs.push_back(data.readInt64());
+            }
+            int option = data.readInt32();
+            ALOGV("getFramesAtTimes: %zu times and option(%d)", numTimes, option);
+#ifndef DISABLE_GROUP_SCHEDULE_HACK
+            setSchedPolicy(data);
+#endif
+            sp<IMemory> frames = getFramesAtTimes(timesUs, option);
+            if (frames != 0) {  // Don't send NULL across the binder interface
+                reply->writeInt32(NO_ERROR);
+                reply->writeStrongBinder(IInterface::asBinder(frames));
+            } else {
+                reply->writeInt32(UNKNOWN_ERROR);
+            }
+#ifndef DISABLE_GROUP_SCHEDULE_HACK
+            restoreSchedPolicy();
 #endif
             return NO_ERROR;
         } break;
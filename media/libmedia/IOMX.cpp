@@ -57,6 +57,7 @@ enum {
     SET_INTERNAL_OPTION,
     UPDATE_GRAPHIC_BUFFER_IN_META,
     CONFIGURE_VIDEO_TUNNEL_MODE,
+    CREATE_MESSAGE_RING,
 };
 
 class BpOMX : public BpInterface<IOMX> {
@@ -585,6 +586,24 @@ public:
 
         return reply.readInt32();
     }
+
+    virtual status_t createMessageRing(node_id node, sp<IMemory> *memory) {
+        Parcel data, reply;
+        data.writeInterfaceToken(IOMX::getInterfaceDescriptor());
+        data.writeInt32((int32_t)node);
+        // also fails with an older mediaserver
+        status_t err = remote()->transact(CREATE_MESSAGE_RING, data, &reply);
+        if (err == OK) {
+            err = reply.readInt32();
+        }
+        if (err == OK) {
+            *memory = interface_cast<IMemory>(reply.readStrongBinder());
+        } else {
+            memory->clear();
+        }
+
+        return err;
+    }
 };
 
 IMPLEMENT_META_INTERFACE(OMX, "android.hardware.IOMX");
@@ -1070,6 +1089,23 @@ status_t BnOMX::onTransact(
             return OK;
         }
 
+        case CREATE_MESSAGE_RING:
+        {
+            CHECK_OMX_INTERFACE(IOMX, data, reply);
+
+            node_id node = (node_id)data.readInt32();
+
+            sp<IMemory> memory;
+            status_t err = createMessageRing(node, &memory);
+
+            reply->writeInt32(err);
+            if (err == OK) {
+                reply->writeStrongBinder(IInterface::asBinder(memory));
+            }
+
+            return NO_ERROR;
+        }
+
         default:
             return BBinder::onTransact(code, data, reply, flags);
     }
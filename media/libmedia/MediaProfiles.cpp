@@ -20,6 +20,10 @@
 #define LOG_TAG "MediaProfiles"
 
 #include <stdlib.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <utils/Log.h>
 #include <utils/Vector.h>
 #include <cutils/properties.h>
@@ -33,6 +37,7 @@ namespace android {
 Mutex MediaProfiles::sLock;
 bool MediaProfiles::sIsInitialized = false;
 MediaProfiles *MediaProfiles::sInstance = NULL;
+const char *MediaProfiles::kCacheFile = "/data/misc/media/media_profiles.cache";
 
 const MediaProfiles::NameToTagMap MediaProfiles::sVideoEncoderNameMap[] = {
     {"h263", VIDEO_ENCODER_H263},
@@ -591,21 +596,33 @@ MediaProfiles::getInstance()
     Mutex::Autolock lock(sLock);
     if (!sIsInitialized) {
         char value[PROPERTY_VALUE_MAX];
+        const char *xmlFile = NULL;
         if (property_get("media.settings.xml", value, NULL) <= 0) {
             const char *defaultXmlFile = "/etc/media_profiles.xml";
             FILE *fp = fopen(defaultXmlFile, "r");
             if (fp == NULL) {
                 ALOGW("could not find media config xml file");
-                sInstance = createDefaultInstance();
             } else {
                 fclose(fp);  // close the file first.
-                sInstance = createInstanceFromXmlFile(defaultXmlFile);
+                xmlFile = defaultXmlFile;
             }
         } else {
-            sInstance = createInstanceFromXmlFile(value);
+            xmlFile = value;
+        }
+
+        if (xmlFile == NULL) {
+            sInstance = createDefaultInstance();
+            CHECK(sInstance != NULL);
+            sInstance->checkAndAddRequiredProfilesIfNecessary();
+        } else {
+            sInstance = createInstanceFromCacheFile(kCacheFile, xmlFile);
+            if (sInstance == NULL) {
+                sInstance = createInstanceFromXmlFile(xmlFile);
+                CHECK(sInstance != NULL);
+                sInstance->checkAndAddRequiredProfilesIfNecessary();
+                sInstance->writeCacheFile(kCacheFile, xmlFile);
+            }
         }
-        CHECK(sInstance != NULL);
-        sInstance->checkAndAddRequiredProfilesIfNecessary();
         sIsInitialized = true;
     }
 
@@ -890,6 +907,328 @@ exit:
     return profiles;
 }
 
+namespace {
+
+// Layout of the cache file, all in native endian 32 bit words:
+//   header: magic, version, xml size, xml mtime, xml inode, xml path hash
+//   camcorder profiles, audio encoders, video encoders, audio decoders,
+//   video decoders, output file formats: count, then fixed size records
+//   image encoding quality levels: count, then camera id, count, levels
+//   start time offsets: count, then camera id, offset pairs
+//   camera ids: count, then ids
+//   trailer: magic
+const int32_t kCacheMagic = 0x4d505246;  // 'MPRF'
+const int32_t kCacheVersion = 1;
+const size_t kCacheHeaderSize = 6;
+
+struct CacheReader {
+    CacheReader(const int32_t *data, size_t size)
+        : mData(data), mSize(size), mPos(0) {}
+
+    bool read(int32_t *value) {
+        if (mPos >= mSize) {
+            return false;
+        }
+        *value = mData[mPos++];
+        return true;
+    }
+
+    // Reads a record count, checking that that many records of recordSize
+    // words remain.
+    bool readCount(size_t *count, size_t recordSize) {
+        int32_t value;
+        if (!read(&value) || value < 0
+                || (size_t)value > (mSize - mPos) / recordSize) {
+            return false;
+        }
+        *count = value;
+        return true;
+    }
+
+    bool done() const { return mPos == mSize; }
+
+private:
+    const int32_t *mData;
+    size_t mSize;
+    size_t mPos;
+};
+
+static int32_t hashPath(const char *path) {
+    uint32_t hash = 5381;
+    for (const char *c = path; *c != '\0'; ++c) {
+        hash = hash * 33 + (uint8_t)*c;
+    }
+    return (int32_t)hash;
+}
+
+static void getCacheHeader(const char *xml, const struct stat &st, int32_t header[]) {
+    header[0] = kCacheMagic;
+    header[1] = kCacheVersion;
+    header[2] = (int32_t)st.st_size;
+    header[3] = (int32_t)st.st_mtime;
+    header[4] = (int32_t)st.st_ino;
+    header[5] = hashPath(xml);
+}
+
+}  // namespace
+
+/*static*/ MediaProfiles*
+MediaProfiles::createInstanceFromCacheFile(const char *cache, const char *xml)
+{
+    struct stat xmlStat, cacheStat;
+    if (stat(xml, &xmlStat) != 0) {
+        return NULL;
+    }
+
+    int fd = open(cache, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        ALOGV("no media profiles cache %s", cache);
+        return NULL;
+    }
+
+    MediaProfiles *profiles = NULL;
+    int32_t *data = NULL;
+    size_t size = 0;
+    int32_t header[kCacheHeaderSize];
+    getCacheHeader(xml, xmlStat, header);
+
+    if (fstat(fd, &cacheStat) != 0 || cacheStat.st_size % sizeof(int32_t) != 0
+            || cacheStat.st_size < (off_t)(kCacheHeaderSize * sizeof(int32_t))
+            || cacheStat.st_size > 1024 * 1024) {
+        ALOGW("ignoring media profiles cache of size %lld", (long long)cacheStat.st_size);
+        goto exit;
+    }
+
+    size = cacheStat.st_size / sizeof(int32_t);
+    data = new int32_t[size];
+    if (read(fd, data, size * sizeof(int32_t)) != (ssize_t)(size * sizeof(int32_t))) {
+        ALOGW("failed to read media profiles cache");
+        goto exit;
+    }
+
+    if (memcmp(data, header, sizeof(header))) {
+        ALOGV("media profiles cache is stale");
+        goto exit;
+    }
+
+    // Validate the whole cache first, as a MediaProfiles is never deleted
+    if (!readCache(data + kCacheHeaderSize, size - kCacheHeaderSize, NULL)) {
+        ALOGW("ignoring malformed media profiles cache");
+        goto exit;
+    }
+
+    profiles = new MediaProfiles();
+    readCache(data + kCacheHeaderSize, size - kCacheHeaderSize, profiles);
+    ALOGV("loaded media profiles from cache %s", cache);
+
+exit:
+    delete[] data;
+    close(fd);
+    return profiles;
+}
+
+// Reads the cache payload into profiles, or only validates it if profiles is NULL.
+/*static*/ bool
+MediaProfiles::readCache(const int32_t *data, size_t size, MediaProfiles *profiles)
+{
+    CacheReader reader(data, size);
+    int32_t v[13];
+    size_t count;
+
+    if (!reader.readCount(&count, 13)) return false;
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t j = 0; j < 13; ++j) reader.read(&v[j]);
+        if (profiles == NULL) continue;
+        CamcorderProfile *profile = new CamcorderProfile;
+        profile->mCameraId = v[0];
+        profile->mFileFormat = static_cast<output_format>(v[1]);
+        profile->mQuality = static_cast<camcorder_quality>(v[2]);
+        profile->mDuration = v[3];
+        profile->mVideoCodec = new VideoCodec(
+                static_cast<video_encoder>(v[4]), v[5], v[6], v[7], v[8]);
+        profile->mAudioCodec = new AudioCodec(
+                static_cast<audio_encoder>(v[9]), v[10], v[11], v[12]);
+        profiles->mCamcorderProfiles.add(profile);
+    }
+
+    if (!reader.readCount(&count, 7)) return false;
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t j = 0; j < 7; ++j) reader.read(&v[j]);
+        if (profiles == NULL) continue;
+        profiles->mAudioEncoders.add(new AudioEncoderCap(
+                static_cast<audio_encoder>(v[0]), v[1], v[2], v[3], v[4], v[5], v[6]));
+    }
+
+    if (!reader.readCount(&count, 9)) return false;
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t j = 0; j < 9; ++j) reader.read(&v[j]);
+        if (profiles == NULL) continue;
+        profiles->mVideoEncoders.add(new VideoEncoderCap(
+                static_cast<video_encoder>(v[0]), v[1], v[2], v[3], v[4], v[5], v[6],
+                v[7], v[8]));
+    }
+
+    if (!reader.readCount(&count, 1)) return false;
+    for (size_t i = 0; i < count; ++i) {
+        reader.read(&v[0]);
+        if (profiles == NULL) continue;
+        profiles->mAudioDecoders.add(new AudioDecoderCap(static_cast<audio_decoder>(v[0])));
+    }
+
+    if (!reader.readCount(&count, 1)) return false;
+    for (size_t i = 0; i < count; ++i) {
+        reader.read(&v[0]);
+        if (profiles == NULL) continue;
+        profiles->mVideoDecoders.add(new VideoDecoderCap(static_cast<video_decoder>(v[0])));
+    }
+
+    if (!reader.readCount(&count, 1)) return false;
+    for (size_t i = 0; i < count; ++i) {
+        reader.read(&v[0]);
+        if (profiles == NULL) continue;
+        profiles->mEncoderOutputFileFormats.add(static_cast<output_format>(v[0]));
+    }
+
+    if (!reader.readCount(&count, 2)) return false;
+    for (size_t i = 0; i < count; ++i) {
+        size_t numLevels;
+        if (!reader.read(&v[0]) || !reader.readCount(&numLevels, 1)) return false;
+        ImageEncodingQualityLevels *levels = NULL;
+        if (profiles != NULL) {
+            levels = new ImageEncodingQualityLevels();
+            levels->mCameraId = v[0];
+            profiles->mImageEncodingQualityLevels.add(levels);
+        }
+        for (size_t j = 0; j < numLevels; ++j) {
+            reader.read(&v[1]);
+            if (levels != NULL) {
+                levels->mLevels.add(v[1]);
+            }
+        }
+    }
+
+    if (!reader.readCount(&count, 2)) return false;
+    for (size_t i = 0; i < count; ++i) {
+        reader.read(&v[0]);
+        reader.read(&v[1]);
+        if (profiles == NULL) continue;
+        profiles->mStartTimeOffsets.replaceValueFor(v[0], v[1]);
+    }
+
+    if (!reader.readCount(&count, 1)) return false;
+    for (size_t i = 0; i < count; ++i) {
+        reader.read(&v[0]);
+        if (profiles == NULL) continue;
+        profiles->mCameraIds.add(v[0]);
+    }
+
+    if (!reader.read(&v[0]) || v[0] != kCacheMagic) return false;
+    return reader.done();
+}
+
+void MediaProfiles::writeCacheFile(const char *cache, const char *xml) const
+{
+    struct stat xmlStat;
+    if (stat(xml, &xmlStat) != 0) {
+        return;
+    }
+
+    Vector<int32_t> data;
+    int32_t header[kCacheHeaderSize];
+    getCacheHeader(xml, xmlStat, header);
+    data.appendArray(header, kCacheHeaderSize);
+
+    data.add(mCamcorderProfiles.size());
+    for (size_t i = 0; i < mCamcorderProfiles.size(); ++i) {
+        const CamcorderProfile *profile = mCamcorderProfiles[i];
+        const int32_t record[] = {
+            profile->mCameraId, profile->mFileFormat, profile->mQuality, profile->mDuration,
+            profile->mVideoCodec->mCodec, profile->mVideoCodec->mBitRate,
+            profile->mVideoCodec->mFrameWidth, profile->mVideoCodec->mFrameHeight,
+            profile->mVideoCodec->mFrameRate,
+            profile->mAudioCodec->mCodec, profile->mAudioCodec->mBitRate,
+            profile->mAudioCodec->mSampleRate, profile->mAudioCodec->mChannels,
+        };
+        data.appendArray(record, sizeof(record)/sizeof(record[0]));
+    }
+
+    data.add(mAudioEncoders.size());
+    for (size_t i = 0; i < mAudioEncoders.size(); ++i) {
+        const AudioEncoderCap *cap = mAudioEncoders[i];
+        const int32_t record[] = {
+            cap->mCodec, cap->mMinBitRate, cap->mMaxBitRate,
+            cap->mMinSampleRate, cap->mMaxSampleRate, cap->mMinChannels, cap->mMaxChannels,
+        };
+        data.appendArray(record, sizeof(record)/sizeof(record[0]));
+    }
+
+    data.add(mVideoEncoders.size());
+    for (size_t i = 0; i < mVideoEncoders.size(); ++i) {
+        const VideoEncoderCap *cap = mVideoEncoders[i];
+        const int32_t record[] = {
+            cap->mCodec, cap->mMinBitRate, cap->mMaxBitRate,
+            cap->mMinFrameWidth, cap->mMaxFrameWidth, cap->mMinFrameHeight, cap->mMaxFrameHeight,
+            cap->mMinFrameRate, cap->mMaxFrameRate,
+        };
+        data.appendArray(record, sizeof(record)/sizeof(record[0]));
+    }
+
+    data.add(mAudioDecoders.size());
+    for (size_t i = 0; i < mAudioDecoders.size(); ++i) {
+        data.add(mAudioDecoders[i]->mCodec);
+    }
+
+    data.add(mVideoDecoders.size());
+    for (size_t i = 0; i < mVideoDecoders.size(); ++i) {
+        data.add(mVideoDecoders[i]->mCodec);
+    }
+
+    data.add(mEncoderOutputFileFormats.size());
+    for (size_t i = 0; i < mEncoderOutputFileFormats.size(); ++i) {
+        data.add(mEncoderOutputFileFormats[i]);
+    }
+
+    data.add(mImageEncodingQualityLevels.size());
+    for (size_t i = 0; i < mImageEncodingQualityLevels.size(); ++i) {
+        const ImageEncodingQualityLevels *levels = mImageEncodingQualityLevels[i];
+        data.add(levels->mCameraId);
+        data.add(levels->mLevels.size());
+        data.appendVector(levels->mLevels);
+    }
+
+    data.add(mStartTimeOffsets.size());
+    for (size_t i = 0; i < mStartTimeOffsets.size(); ++i) {
+        data.add(mStartTimeOffsets.keyAt(i));
+        data.add(mStartTimeOffsets.valueAt(i));
+    }
+
+    data.add(mCameraIds.size());
+    data.appendVector(mCameraIds);
+
+    data.add(kCacheMagic);
+
+    // Write to a temporary file and rename it, so that readers never see a
+    // partially written cache.
+    char tmp[PATH_MAX];
+    snprintf(tmp, sizeof(tmp), "%s.%d", cache, getpid());
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        ALOGV("cannot create media profiles cache %s", tmp);
+        return;
+    }
+
+    size_t bytes = data.size() * sizeof(int32_t);
+    bool written = write(fd, data.array(), bytes) == (ssize_t)bytes;
+    close(fd);
+
+    if (!written || rename(tmp, cache) != 0) {
+        ALOGW("failed to write media profiles cache %s", cache);
+        unlink(tmp);
+        return;
+    }
+    ALOGV("wrote media profiles cache %s (%zu bytes)", cache, bytes);
+}
+
 Vector<output_format> MediaProfiles::getOutputFileFormats() const
 {
     return mEncoderOutputFileFormats;  // copy out
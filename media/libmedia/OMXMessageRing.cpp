@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "OMXMessageRing"
+#include <utils/Log.h>
+
+#include <private/media/OMXMessageRing.h>
+
+#include <binder/MemoryBase.h>
+#include <binder/MemoryHeapBase.h>
+#include <cutils/atomic.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <string.h>
+#include <sys/syscall.h>
+
+namespace android {
+
+// a power of 2, more than the buffers of a port
+static const int32_t kNumEntries = 64;
+
+// set by the producer when there is something new on the ring, cleared by the consumer
+#define RING_FUTEX_WAKE 0x01
+
+// Like audio_track_cblk_t, in continuously incrementing entry units. Both processes map
+// the memory, so the futex must not be private.
+struct OMXMessageRing::Shared {
+    volatile int32_t mFront;    // written by the consumer
+    volatile int32_t mRear;     // written by the producer
+    volatile int32_t mFutex;
+    int32_t mReserved;
+    Entry mEntries[kNumEntries];
+};
+
+// static
+sp<IMemory> OMXMessageRing::Allocate() {
+    size_t size = sizeof(Shared) * kNumRings;
+    sp<MemoryHeapBase> heap = new MemoryHeapBase(size, 0, "OMXMessageRing");
+    if (heap->getHeapID() < 0) {
+        return NULL;
+    }
+    memset(heap->getBase(), 0, size);
+    return new MemoryBase(heap, 0, size);
+}
+
+OMXMessageRing::OMXMessageRing(const sp<IMemory> &memory, Ring ring)
+    : mMemory(memory),
+      mShared(NULL),
+      mIndex(0),
+      mBroken(false),
+      mInterrupted(0) {
+    if (memory != NULL && memory->pointer() != NULL
+            && memory->size() >= sizeof(Shared) * kNumRings) {
+        mShared = (Shared *)memory->pointer() + ring;
+    }
+}
+
+OMXMessageRing::~OMXMessageRing() {
+}
+
+bool OMXMessageRing::write(const Entry &entry) {
+    if (mShared == NULL || mBroken) {
+        return false;
+    }
+
+    int32_t front = android_atomic_acquire_load(&mShared->mFront);
+    int32_t filled = mIndex - front;
+    if (filled < 0 || filled > kNumEntries) {
+        ALOGE("ring corrupted: front %d rear %d", front, mIndex);
+        mBroken = true;
+        return false;
+    }
+    if (filled == kNumEntries) {
+        return false;
+    }
+
+    mShared->mEntries[mIndex & (kNumEntries - 1)] = entry;
+    android_atomic_release_store(++mIndex, &mShared->mRear);
+
+    int32_t old = android_atomic_or(RING_FUTEX_WAKE, &mShared->mFutex);
+    if (!(old & RING_FUTEX_WAKE)) {
+        (void) syscall(__NR_futex, &mShared->mFutex, FUTEX_WAKE, 1);
+    }
+    return true;
+}
+
+ssize_t OMXMessageRing::read(Entry *entries, size_t count) {
+    if (mShared == NULL) {
+        return NO_INIT;
+    }
+    if (mBroken) {
+        return BAD_VALUE;
+    }
+
+    int32_t rear = android_atomic_acquire_load(&mShared->mRear);
+    int32_t filled = rear - mIndex;
+    if (filled < 0 || filled > kNumEntries) {
+        ALOGE("ring corrupted: front %d rear %d", mIndex, rear);
+        mBroken = true;
+        return BAD_VALUE;
+    }
+
+    size_t n = (size_t)filled < count ? (size_t)filled : count;
+    for (size_t i = 0; i < n; ++i) {
+        // copy, as the other process may be changing the memory
+        memcpy(&entries[i], (const void *)&mShared->mEntries[(mIndex + i) & (kNumEntries - 1)],
+                sizeof(Entry));
+    }
+    mIndex += n;
+    android_atomic_release_store(mIndex, &mShared->mFront);
+    return n;
+}
+
+bool OMXMessageRing::wait() {
+    if (mShared == NULL) {
+        return false;
+    }
+
+    while (!android_atomic_acquire_load(&mInterrupted)) {
+        if (mBroken || android_atomic_acquire_load(&mShared->mRear) != mIndex) {
+            return true;
+        }
+        int32_t old = android_atomic_and(~RING_FUTEX_WAKE, &mShared->mFutex);
+        if (!(old & RING_FUTEX_WAKE)) {
+            (void) syscall(__NR_futex, &mShared->mFutex, FUTEX_WAIT,
+                    old & ~RING_FUTEX_WAKE, NULL);
+        }
+    }
+    return false;
+}
+
+void OMXMessageRing::interrupt() {
+    android_atomic_release_store(1, &mInterrupted);
+    if (mShared != NULL) {
+        android_atomic_or(RING_FUTEX_WAKE, &mShared->mFutex);
+        (void) syscall(__NR_futex, &mShared->mFutex, FUTEX_WAKE, INT_MAX);
+    }
+}
+
+// static
+bool OMXMessageRing::MessageToEntry(const omx_message &msg, Entry *entry) {
+    if (msg.fenceFd >= 0) {
+        return false;
+    }
+
+    memset(entry, 0, sizeof(*entry));
+    entry->mType = msg.type;
+    switch (msg.type) {
+        case omx_message::EMPTY_BUFFER_DONE:
+            entry->mBuffer = msg.u.buffer_data.buffer;
+            return true;
+
+        case omx_message::FILL_BUFFER_DONE:
+            entry->mBuffer = msg.u.extended_buffer_data.buffer;
+            entry->mRangeOffset = msg.u.extended_buffer_data.range_offset;
+            entry->mRangeLength = msg.u.extended_buffer_data.range_length;
+            entry->mFlags = msg.u.extended_buffer_data.flags;
+            entry->mTimestamp = msg.u.extended_buffer_data.timestamp;
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+// static
+bool OMXMessageRing::EntryToMessage(const Entry &entry, IOMX::node_id node, omx_message *msg) {
+    msg->node = node;
+    msg->fenceFd = -1;
+    switch (entry.mType) {
+        case omx_message::EMPTY_BUFFER_DONE:
+            msg->type = omx_message::EMPTY_BUFFER_DONE;
+            msg->u.buffer_data.buffer = entry.mBuffer;
+            return true;
+
+        case omx_message::FILL_BUFFER_DONE:
+            msg->type = omx_message::FILL_BUFFER_DONE;
+            msg->u.extended_buffer_data.buffer = entry.mBuffer;
+            msg->u.extended_buffer_data.range_offset = entry.mRangeOffset;
+            msg->u.extended_buffer_data.range_length = entry.mRangeLength;
+            msg->u.extended_buffer_data.flags = entry.mFlags;
+            msg->u.extended_buffer_data.timestamp = entry.mTimestamp;
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+}  // namespace android
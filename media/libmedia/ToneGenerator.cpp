@@ -18,6 +18,7 @@
 #define LOG_TAG "ToneGenerator"
 
 #include <math.h>
+#include <pthread.h>
 #include <utils/Log.h>
 #include <cutils/properties.h>
 #include "media/ToneGenerator.h"
@@ -1174,14 +1175,7 @@ void ToneGenerator::audioCallback(int event, void* user, void *info) {
             // If segment,  ON -> OFF transition : ramp volume down
             if (lpToneDesc->segments[lpToneGen->mCurSegment].waveFreq[0] != 0) {
                 lWaveCmd = WaveGenerator::WAVEGEN_STOP;
-                unsigned int lFreqIdx = 0;
-                unsigned short lFrequency = lpToneDesc->segments[lpToneGen->mCurSegment].waveFreq[lFreqIdx];
-
-                while (lFrequency != 0) {
-                    WaveGenerator *lpWaveGen = lpToneGen->mWaveGens.valueFor(lFrequency);
-                    lpWaveGen->getSamples(lpOut, lGenSmp, lWaveCmd);
-                    lFrequency = lpToneDesc->segments[lpToneGen->mCurSegment].waveFreq[++lFreqIdx];
-                }
+                lpToneGen->generateWaves(lpOut, lGenSmp, lWaveCmd);
                 ALOGV("ON->OFF, lGenSmp: %d, lReqSmp: %d", lGenSmp, lReqSmp);
             }
 
@@ -1259,15 +1253,8 @@ void ToneGenerator::audioCallback(int event, void* user, void *info) {
         }
 
         if (lGenSmp) {
-            // If samples must be generated, call all active wave generators and acumulate waves in lpOut
-            unsigned int lFreqIdx = 0;
-            unsigned short lFrequency = lpToneDesc->segments[lpToneGen->mCurSegment].waveFreq[lFreqIdx];
-
-            while (lFrequency != 0) {
-                WaveGenerator *lpWaveGen = lpToneGen->mWaveGens.valueFor(lFrequency);
-                lpWaveGen->getSamples(lpOut, lGenSmp, lWaveCmd);
-                lFrequency = lpToneDesc->segments[lpToneGen->mCurSegment].waveFreq[++lFreqIdx];
-            }
+            // If samples must be generated, mix all active wave generators into lpOut
+            lpToneGen->generateWaves(lpOut, lGenSmp, lWaveCmd);
         }
 
         lNumSmp -= lReqSmp;
@@ -1449,6 +1436,35 @@ void ToneGenerator::clearWaveGens() {
     mWaveGens.clear();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+//
+//    Method:        ToneGenerator::generateWaves()
+//
+//    Description:    Generates count samples of the current tone segment by mixing
+//      all its wave generators in one pass, and accumulates the result in outBuffer.
+//      Must be called with mLock held.
+//
+//    Input:
+//        outBuffer:      Output buffer where to accumulate samples.
+//        count:          number of samples to produce.
+//        command:        special action requested (see enum WaveGenerator::gen_command).
+//
+//    Output:
+//        none
+//
+////////////////////////////////////////////////////////////////////////////////
+void ToneGenerator::generateWaves(short *outBuffer, unsigned int count, unsigned int command) {
+    WaveGenerator *lpWaveGens[TONEGEN_MAX_WAVES];
+    unsigned int lNumGens = 0;
+    const unsigned short *lpFreqs = mpToneDesc->segments[mCurSegment].waveFreq;
+
+    while (lNumGens < TONEGEN_MAX_WAVES && lpFreqs[lNumGens] != 0) {
+        lpWaveGens[lNumGens] = mWaveGens.valueFor(lpFreqs[lNumGens]);
+        lNumGens++;
+    }
+    WaveGenerator::mixSamples(lpWaveGens, lNumGens, outBuffer, count, command);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 //    Method:       ToneGenerator::getToneForRegion()
@@ -1482,6 +1498,9 @@ ToneGenerator::tone_type ToneGenerator::getToneForRegion(tone_type toneType) {
 //                WaveGenerator::WaveGenerator class    Implementation
 ////////////////////////////////////////////////////////////////////////////////
 
+short ToneGenerator::WaveGenerator::sSineTable[SINE_TABLE_SIZE + 1];
+static pthread_once_t sSineTableOnce = PTHREAD_ONCE_INIT;
+
 //---------------------------------- public methods ----------------------------
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1501,27 +1520,19 @@ ToneGenerator::tone_type ToneGenerator::getToneForRegion(tone_type toneType) {
 ////////////////////////////////////////////////////////////////////////////////
 ToneGenerator::WaveGenerator::WaveGenerator(unsigned short samplingRate,
         unsigned short frequency, float volume) {
-    double d0;
-    double F_div_Fs;  // frequency / samplingRate
-
-    F_div_Fs = frequency / (double)samplingRate;
-    d0 = - (float)GEN_AMP * sin(2 * M_PI * F_div_Fs);
-    mS2_0 = (short)d0;
-    mS1 = 0;
-    mS2 = mS2_0;
-
-    mAmplitude_Q15 = (short)(32767. * 32767. * volume / GEN_AMP);
-    // take some margin for amplitude fluctuation
-    if (mAmplitude_Q15 > 32500)
-        mAmplitude_Q15 = 32500;
-
-    d0 = 32768.0 * cos(2 * M_PI * F_div_Fs);  // Q14*2*cos()
-    if (d0 > 32767)
-        d0 = 32767;
-    mA1_Q14 = (short) d0;
-
-    ALOGV("WaveGenerator init, mA1_Q14: %d, mS2_0: %d, mAmplitude_Q15: %d",
-            mA1_Q14, mS2_0, mAmplitude_Q15);
+    pthread_once(&sSineTableOnce, initSineTable);
+
+    // frequency / samplingRate expressed as a fraction of the 32 bit phase range
+    mPhaseInc = (uint32_t)(((uint64_t)frequency << 32) / samplingRate);
+    mPhase = 0;
+
+    double amplitude = 32767. * volume;
+    if (amplitude > 32767.)
+        amplitude = 32767.;
+    mAmplitude_Q15 = (short)amplitude;
+
+    ALOGV("WaveGenerator init, mPhaseInc: %u, mAmplitude_Q15: %d",
+            mPhaseInc, mAmplitude_Q15);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1542,12 +1553,17 @@ ToneGenerator::WaveGenerator::~WaveGenerator() {
 
 ////////////////////////////////////////////////////////////////////////////////
 //
-//    Method:        WaveGenerator::getSamples()
+//    Method:        WaveGenerator::mixSamples()
 //
-//    Description:    Generates count samples of a sine wave and accumulates
-//        result in outBuffer.
+//    Description:    Generates count samples of the sum of several sine waves and
+//        accumulates result in outBuffer. Each wave is read from the shared sine
+//        table with linear interpolation, so no trigonometry or recursive filter
+//        runs per sample and the phase never drifts. A WAVEGEN_STOP command ramps
+//        the mixed signal down to 0 over the count samples.
 //
 //    Input:
+//        gens:           wave generators to mix.
+//        numGens:        number of generators in gens (at most TONEGEN_MAX_WAVES).
 //        outBuffer:      Output buffer where to accumulate samples.
 //        count:          number of samples to produce.
 //        command:        special action requested (see enum gen_command).
@@ -1556,54 +1572,81 @@ ToneGenerator::WaveGenerator::~WaveGenerator() {
 //        none
 //
 ////////////////////////////////////////////////////////////////////////////////
-void ToneGenerator::WaveGenerator::getSamples(short *outBuffer,
-        unsigned int count, unsigned int command) {
-    long lS1, lS2;
-    long lA1, lAmplitude;
-    long Sample;  // current sample
+void ToneGenerator::WaveGenerator::mixSamples(WaveGenerator * const *gens,
+        unsigned int numGens, short *outBuffer, unsigned int count, unsigned int command) {
+    uint32_t lPhase[TONEGEN_MAX_WAVES];
+    uint32_t lPhaseInc[TONEGEN_MAX_WAVES];
+    int32_t lAmplitude[TONEGEN_MAX_WAVES];
+
+    if (numGens == 0 || count == 0) {
+        return;
+    }
+    if (numGens > TONEGEN_MAX_WAVES) {
+        numGens = TONEGEN_MAX_WAVES;
+    }
 
     // init local
-    if (command == WAVEGEN_START) {
-        lS1 = (long)0;
-        lS2 = (long)mS2_0;
-    } else {
-        lS1 = (long)mS1;
-        lS2 = (long)mS2;
+    for (unsigned int i = 0; i < numGens; i++) {
+        if (command == WAVEGEN_START) {
+            gens[i]->mPhase = 0;
+        }
+        lPhase[i] = gens[i]->mPhase;
+        lPhaseInc[i] = gens[i]->mPhaseInc;
+        lAmplitude[i] = gens[i]->mAmplitude_Q15;
     }
-    lA1 = (long)mA1_Q14;
-    lAmplitude = (long)mAmplitude_Q15;
 
-    if (command == WAVEGEN_STOP) {
-        lAmplitude <<= 16;
-        if (count == 0) {
-            return;
+    // Q30 gain of the fade out ramp, constant full scale unless stopping
+    int32_t lRamp = 1 << 30;
+    int32_t lRampDec = (command == WAVEGEN_STOP) ? (int32_t)((1 << 30) / count) : 0;
+
+    // loop generation
+    while (count--) {
+        int32_t lSample = 0;
+        for (unsigned int i = 0; i < numGens; i++) {
+            uint32_t lIdx = lPhase[i] >> (32 - SINE_TABLE_BITS);
+            int32_t lFrac = (lPhase[i] >> (32 - SINE_TABLE_BITS - S_Q15)) & ((1 << S_Q15) - 1);
+            int32_t lS0 = sSineTable[lIdx];
+            int32_t lSine = lS0 + (((sSineTable[lIdx + 1] - lS0) * lFrac) >> S_Q15);
+            lSample += (lAmplitude[i] * lSine) >> S_Q15;
+            lPhase[i] += lPhaseInc[i];
         }
-        long dec = lAmplitude/count;
-        // loop generation
-        while (count--) {
-            Sample = ((lA1 * lS1) >> S_Q14) - lS2;
-            // shift delay
-            lS2 = lS1;
-            lS1 = Sample;
-            Sample = ((lAmplitude>>16) * Sample) >> S_Q15;
-            *(outBuffer++) += (short)Sample;  // put result in buffer
-            lAmplitude -= dec;
+        if (lRampDec != 0) {
+            lSample = (lSample * (lRamp >> S_Q15)) >> S_Q15;
+            lRamp -= lRampDec;
         }
-    } else {
-        // loop generation
-        while (count--) {
-            Sample = ((lA1 * lS1) >> S_Q14) - lS2;
-            // shift delay
-            lS2 = lS1;
-            lS1 = Sample;
-            Sample = (lAmplitude * Sample) >> S_Q15;
-            *(outBuffer++) += (short)Sample;  // put result in buffer
+        lSample += *outBuffer;
+        if (lSample > 32767) {
+            lSample = 32767;
+        } else if (lSample < -32768) {
+            lSample = -32768;
         }
+        *(outBuffer++) = (short)lSample;  // put result in buffer
     }
 
     // save status
-    mS1 = (short)lS1;
-    mS2 = (short)lS2;
+    for (unsigned int i = 0; i < numGens; i++) {
+        gens[i]->mPhase = lPhase[i];
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//    Method:        WaveGenerator::initSineTable()
+//
+//    Description:    Fills the sine table shared by all wave generators. Called
+//        once per process.
+//
+//    Input:
+//        none
+//
+//    Output:
+//        none
+//
+////////////////////////////////////////////////////////////////////////////////
+void ToneGenerator::WaveGenerator::initSineTable() {
+    for (unsigned int i = 0; i <= SINE_TABLE_SIZE; i++) {
+        sSineTable[i] = (short)lrint(32767. * sin(2 * M_PI * i / SINE_TABLE_SIZE));
+    }
 }
 
 }  // end namespace android
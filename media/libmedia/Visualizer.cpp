@@ -46,7 +46,8 @@ Visualizer::Visualizer (const String16& opPackageName,
         mScalingMode(VISUALIZER_SCALING_MODE_NORMALIZED),
         mMeasurementMode(MEASUREMENT_MODE_NONE),
         mCaptureCallBack(NULL),
-        mCaptureCbkUser(NULL)
+        mCaptureCbkUser(NULL),
+        mFftCacheSize(0)
 {
     initCaptureSize();
 }
@@ -304,6 +305,15 @@ status_t Visualizer::getFft(uint8_t *fft)
 
 status_t Visualizer::doFft(uint8_t *fft, uint8_t *waveform)
 {
+    {
+        Mutex::Autolock _l(mFftCacheLock);
+        if (mFftCacheSize == mCaptureSize &&
+                memcmp(waveform, mFftCacheWaveform, mCaptureSize) == 0) {
+            memcpy(fft, mFftCacheResult, mCaptureSize);
+            return NO_ERROR;
+        }
+    }
+
     int32_t workspace[mCaptureSize >> 1];
     int32_t nonzero = 0;
 
@@ -327,6 +337,11 @@ status_t Visualizer::doFft(uint8_t *fft, uint8_t *waveform)
         fft[i + 1] = tmp;
     }
 
+    Mutex::Autolock _l(mFftCacheLock);
+    memcpy(mFftCacheWaveform, waveform, mCaptureSize);
+    memcpy(mFftCacheResult, fft, mCaptureSize);
+    mFftCacheSize = mCaptureSize;
+
     return NO_ERROR;
 }
 
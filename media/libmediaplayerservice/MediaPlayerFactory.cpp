@@ -201,6 +201,26 @@ enum {
     INCOGNITO           = 0x8000,
 };
 
+typedef WVMLoadableExtractor *(*WVMSnifferFunc)(const sp<DataSource>&);
+
+// libwvm.so is opened and its sniffer looked up once, not for every data source.
+static WVMSnifferFunc getWVMSniffer() {
+    static Mutex sWVMLock;
+    static bool sWVMLoaded = false;
+    static WVMSnifferFunc sWVMSniffer = NULL;
+
+    Mutex::Autolock autoLock(sWVMLock);
+    if (!sWVMLoaded) {
+        sWVMLoaded = true;
+        void *vendorLibHandle = dlopen("libwvm.so", RTLD_NOW);
+        if (vendorLibHandle != NULL) {
+            sWVMSniffer = (WVMSnifferFunc) dlsym(vendorLibHandle,
+                    "_ZN7android15IsWidevineMediaERKNS_2spINS_10DataSourceEEE");
+        }
+    }
+    return sWVMSniffer;
+}
+
 bool isWVM(const char* url,
            const KeyedVector<String8, String8> *headers,
            IMediaHTTPService* httpService) {
@@ -213,12 +233,8 @@ bool isWVM(const char* url,
 
     mUri = url;
 
-    void *VendorLibHandle = NULL;
-    if (VendorLibHandle == NULL) {
-        VendorLibHandle = dlopen("libwvm.so", RTLD_NOW);
-    }
-
-    if (!VendorLibHandle) {
+    WVMSnifferFunc snifferFunc = getWVMSniffer();
+    if (snifferFunc == NULL) {
         return false;
     }
 
@@ -285,18 +301,7 @@ bool isWVM(const char* url,
         return false;
     }
 
-    typedef WVMLoadableExtractor *(*SnifferFunc)(const sp<DataSource>&);
-    SnifferFunc snifferFunc =
-        (SnifferFunc) dlsym(VendorLibHandle,
-                "_ZN7android15IsWidevineMediaERKNS_2spINS_10DataSourceEEE");
-
-    if (snifferFunc) {
-        if ((*snifferFunc)(dataSource)) {
-            return true;
-        }
-    }
-
-    return false;
+    return (*snifferFunc)(dataSource) != NULL;
 }
 
 bool isWVM(int fd,
@@ -304,12 +309,8 @@ bool isWVM(int fd,
            int64_t length) {
     sp<DataSource> dataSource;
 
-    void *VendorLibHandle = NULL;
-    if (VendorLibHandle == NULL) {
-        VendorLibHandle = dlopen("libwvm.so", RTLD_NOW);
-    }
-
-    if (!VendorLibHandle) {
+    WVMSnifferFunc snifferFunc = getWVMSniffer();
+    if (snifferFunc == NULL) {
         return false;
     }
 
@@ -319,18 +320,7 @@ bool isWVM(int fd,
         return false;
     }
 
-    typedef WVMLoadableExtractor *(*SnifferFunc)(const sp<DataSource>&);
-    SnifferFunc snifferFunc =
-        (SnifferFunc) dlsym(VendorLibHandle,
-                "_ZN7android15IsWidevineMediaERKNS_2spINS_10DataSourceEEE");
-
-    if (snifferFunc) {
-        if ((*snifferFunc)(dataSource)) {
-            return true;
-        }
-    }
-
-    return false;
+    return (*snifferFunc)(dataSource) != NULL;
 }
 
 class OMXPlayerFactory : public MediaPlayerFactory::IFactory {
@@ -386,32 +376,36 @@ class OMXPlayerFactory : public MediaPlayerFactory::IFactory {
             if (kOurScore <= curScore)
                 return 0.0;
 
-            if (!strncasecmp(url, "http://", 7)) { 
-                if (isWVM(url, headers, (IMediaHTTPService*)httpService))
-                return 0.0;
-            }
-            
+            bool supported = false;
             URL_TYPE url_type;
             OMXPlayerType *pType = new OMXPlayerType();
             url_type = pType->IsSupportedUrl(url);
             delete pType;
             if(url_type == URL_SUPPORT)
-                return kOurScore;
+                supported = true;
             else if(url_type == URL_NOT_SUPPORT)
                 return 0.0;
 
             int lenURL = strlen(url);
-            for (int i = 0; i < NELEM(FILE_EXTS); ++i) {
+            for (int i = 0; i < NELEM(FILE_EXTS) && !supported; ++i) {
                 int len = strlen(FILE_EXTS[i]);
                 int start = lenURL - len;
                 if (start > 0) {
                     if (!strncasecmp(url + start, FILE_EXTS[i], len)) {
-                        return kOurScore;
+                        supported = true;
                     }
                 }
             }
+            if (!supported)
+                return 0.0;
 
-            return 0.0;
+            // Sniffing for widevine connects to the server, only do it for urls we would take
+            if (!strncasecmp(url, "http://", 7)) {
+                if (isWVM(url, headers, (IMediaHTTPService*)httpService))
+                    return 0.0;
+            }
+
+            return kOurScore;
         }
 
         virtual float scoreFactory(const sp<IMediaPlayer>& /*client*/,
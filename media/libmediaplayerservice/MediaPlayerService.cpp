@@ -538,6 +538,12 @@ status_t MediaPlayerService::dump(int fd, const Vector<String16>& args)
             result.append("\n");
         }
 
+        if (mOMX != NULL) {
+            write(fd, result.string(), result.size());
+            result = "\n";
+            IInterface::asBinder(mOMX)->dump(fd, args);
+        }
+
         gLooperRoster.dump(fd, args);
 
         bool dumpMem = false;
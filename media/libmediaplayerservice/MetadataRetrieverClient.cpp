@@ -47,11 +47,63 @@
 
 namespace android {
 
+// The memory for the frames of getFramesAtTimes() is reserved for the largest batch at once,
+// ashmem only backs the pages of the frames written.
+static const size_t kMaxFramesMemorySize = 64 * 1024 * 1024;
+
+// Copies the frames to the shared memory as they are extracted.
+struct SharedFrameSink : public MediaMetadataRetrieverBase::FrameSink {
+    SharedFrameSink(const sp<MemoryHeapBase> &heap, size_t numFrames)
+        : mHeap(heap),
+          mList(static_cast<VideoFrameList *>(heap->getBase())),
+          mUsed(VideoFrameList::HeaderSize(numFrames)) {
+        memset(mList, 0, mUsed);
+        mList->mNumFrames = numFrames;
+    }
+
+    virtual bool onFrame(size_t index, VideoFrame *frame) {
+        if (index >= mList->mNumFrames || mList->offsets()[index] != 0) {
+            delete frame;
+            return true;
+        }
+
+        size_t frameSize = VideoFrameList::FrameSize(*frame);
+        if (frameSize > mHeap->getSize() - mUsed) {
+            ALOGW("no room for the frames after %zu bytes", mUsed);
+            delete frame;
+            return false;
+        }
+
+        VideoFrame *frameCopy = (VideoFrame *)((uint8_t *)mHeap->getBase() + mUsed);
+        frameCopy->mWidth = frame->mWidth;
+        frameCopy->mHeight = frame->mHeight;
+        frameCopy->mDisplayWidth = frame->mDisplayWidth;
+        frameCopy->mDisplayHeight = frame->mDisplayHeight;
+        frameCopy->mSize = frame->mSize;
+        frameCopy->mRotationAngle = frame->mRotationAngle;
+        frameCopy->mData = (uint8_t *)frameCopy + sizeof(VideoFrame);
+        memcpy(frameCopy->mData, frame->mData, frame->mSize);
+        delete frame;
+
+        mList->offsets()[index] = mUsed;
+        mUsed += frameSize;
+        return true;
+    }
+
+    size_t used() const { return mUsed; }
+
+private:
+    sp<MemoryHeapBase> mHeap;
+    VideoFrameList *mList;
+    size_t mUsed;
+};
+
 MetadataRetrieverClient::MetadataRetrieverClient(pid_t pid)
 {
     ALOGV("MetadataRetrieverClient constructor pid(%d)", pid);
     mPid = pid;
     mThumbnail = NULL;
+    mFrames = NULL;
     mAlbumArt = NULL;
     mRetriever = NULL;
 }
@@ -81,6 +133,7 @@ void MetadataRetrieverClient::disconnect()
     Mutex::Autolock lock(mLock);
     mRetriever.clear();
     mThumbnail.clear();
+    mFrames.clear();
     mAlbumArt.clear();
     IPCThreadState::self()->flushCommands();
 }
@@ -247,6 +300,38 @@ sp<IMemory> MetadataRetrieverClient::getFrameAtTime(int64_t timeUs, int option)
     return mThumbnail;
 }
 
+sp<IMemory> MetadataRetrieverClient::getFramesAtTimes(
+        const Vector<int64_t> &timesUs, int option)
+{
+    ALOGV("getFramesAtTimes: %zu times option(%d)", timesUs.size(), option);
+    Mutex::Autolock lock(mLock);
+    Mutex::Autolock glock(sLock);
+    mFrames.clear();
+    if (mRetriever == NULL) {
+        ALOGE("retriever is not initialized");
+        return NULL;
+    }
+    if (timesUs.isEmpty()
+            || VideoFrameList::HeaderSize(timesUs.size()) > kMaxFramesMemorySize) {
+        ALOGE("cannot capture %zu video frames", timesUs.size());
+        return NULL;
+    }
+    sp<MemoryHeapBase> heap =
+        new MemoryHeapBase(kMaxFramesMemorySize, 0, "MetadataRetrieverClient");
+    if (heap->getHeapID() < 0) {
+        ALOGE("failed to create the memory for %zu video frames", timesUs.size());
+        return NULL;
+    }
+    SharedFrameSink sink(heap, timesUs.size());
+    status_t err = mRetriever->getFramesAtTimes(timesUs, option, &sink);
+    if (err != OK) {
+        ALOGE("failed to capture video frames: %d", err);
+        return NULL;
+    }
+    mFrames = new MemoryBase(heap, 0, sink.used());
+    return mFrames;
+}
+
 sp<IMemory> MetadataRetrieverClient::extractAlbumArt()
 {
     ALOGV("extractAlbumArt");
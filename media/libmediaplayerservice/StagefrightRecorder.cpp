@@ -51,6 +51,7 @@
 #include <utils/Errors.h>
 #include <sys/types.h>
 #include <ctype.h>
+#include <pthread.h>
 #include <unistd.h>
 
 #include <system/audio.h>
@@ -491,6 +492,16 @@ status_t StagefrightRecorder::setParam64BitFileOffset(bool use64Bit) {
     return OK;
 }
 
+status_t StagefrightRecorder::setParamFragmentDuration(int64_t durationUs) {
+    ALOGV("setParamFragmentDuration: %" PRId64 " us", durationUs);
+    if (durationUs < 0) {
+        ALOGE("Fragment duration must not be negative: %" PRId64 " us", durationUs);
+        return BAD_VALUE;
+    }
+    mFragmentDurationUs = durationUs;
+    return OK;
+}
+
 status_t StagefrightRecorder::setParamVideoCameraId(int32_t cameraId) {
     ALOGV("setParamVideoCameraId: %d", cameraId);
     if (cameraId < 0) {
@@ -566,6 +577,19 @@ status_t StagefrightRecorder::setParamAudioTimeScale(int32_t timeScale) {
     return OK;
 }
 
+status_t StagefrightRecorder::setParamAudioCapturePeriodUs(int64_t capturePeriodUs) {
+    ALOGV("setParamAudioCapturePeriodUs: %lld", (long long)capturePeriodUs);
+
+    // 0 restores callback driven capture
+    if (capturePeriodUs < 0 || capturePeriodUs > 10000000ll) {
+        ALOGE("Audio capture period (%lld us) is out of range [0, 10 s]",
+                (long long)capturePeriodUs);
+        return BAD_VALUE;
+    }
+    mAudioCapturePeriodUs = capturePeriodUs;
+    return OK;
+}
+
 status_t StagefrightRecorder::setParamCaptureFpsEnable(int32_t captureFpsEnable) {
     ALOGV("setParamCaptureFpsEnable: %d", captureFpsEnable);
 
@@ -643,6 +667,11 @@ status_t StagefrightRecorder::setParameter(
         if (safe_strtoi32(value.string(), &use64BitOffset)) {
             return setParam64BitFileOffset(use64BitOffset != 0);
         }
+    } else if (key == "param-fragment-duration-us") {
+        int64_t durationUs;
+        if (safe_strtoi64(value.string(), &durationUs)) {
+            return setParamFragmentDuration(durationUs);
+        }
     } else if (key == "param-geotag-longitude") {
         int64_t longitudex10000;
         if (safe_strtoi64(value.string(), &longitudex10000)) {
@@ -678,6 +707,11 @@ status_t StagefrightRecorder::setParameter(
         if (safe_strtoi32(value.string(), &timeScale)) {
             return setParamAudioTimeScale(timeScale);
         }
+    } else if (key == "audio-param-capture-period-us") {
+        int64_t capturePeriodUs;
+        if (safe_strtoi64(value.string(), &capturePeriodUs)) {
+            return setParamAudioCapturePeriodUs(capturePeriodUs);
+        }
     } else if (key == "video-param-encoding-bitrate") {
         int32_t video_bitrate;
         if (safe_strtoi32(value.string(), &video_bitrate)) {
@@ -851,6 +885,7 @@ status_t StagefrightRecorder::start() {
         return UNKNOWN_ERROR;
     }
 
+    int64_t writerStartUs = systemTime() / 1000;
     switch (mOutputFormat) {
         case OUTPUT_FORMAT_DEFAULT:
         case OUTPUT_FORMAT_THREE_GPP:
@@ -886,6 +921,8 @@ status_t StagefrightRecorder::start() {
         }
     }
 
+    mWriterStartTimeUs = systemTime() / 1000 - writerStartUs;
+
     if (status != OK) {
         mWriter.clear();
         mWriter = NULL;
@@ -934,7 +971,8 @@ sp<MediaSource> StagefrightRecorder::createAudioSource() {
                 mOpPackageName,
                 sourceSampleRate,
                 mAudioChannels,
-                mSampleRate);
+                mSampleRate,
+                mAudioCapturePeriodUs);
 
     status_t err = audioSource->initCheck();
 
@@ -1601,6 +1639,17 @@ status_t StagefrightRecorder::setupVideoEncoder(
 }
 
 status_t StagefrightRecorder::setupAudioEncoder(const sp<MediaWriter>& writer) {
+    sp<MediaSource> audioEncoder;
+    status_t status = createAudioEncoder(&audioEncoder);
+    if (status != OK) {
+        return status;
+    }
+
+    writer->addSource(audioEncoder);
+    return OK;
+}
+
+status_t StagefrightRecorder::createAudioEncoder(sp<MediaSource> *audioEncoder) {
     status_t status = BAD_VALUE;
     if (OK != (status = checkAudioEncoderCapabilities())) {
         return status;
@@ -1619,15 +1668,22 @@ status_t StagefrightRecorder::setupAudioEncoder(const sp<MediaWriter>& writer) {
             return UNKNOWN_ERROR;
     }
 
-    sp<MediaSource> audioEncoder = createAudioSource();
-    if (audioEncoder == NULL) {
+    *audioEncoder = createAudioSource();
+    if (*audioEncoder == NULL) {
         return UNKNOWN_ERROR;
     }
-
-    writer->addSource(audioEncoder);
     return OK;
 }
 
+// static
+void *StagefrightRecorder::AudioSetupThreadWrapper(void *me) {
+    StagefrightRecorder *recorder = static_cast<StagefrightRecorder *>(me);
+    int64_t startUs = systemTime() / 1000;
+    recorder->mAudioSetupStatus = recorder->createAudioEncoder(&recorder->mAudioSetupEncoder);
+    recorder->mAudioSetupTimeUs = systemTime() / 1000 - startUs;
+    return NULL;
+}
+
 status_t StagefrightRecorder::setupMPEG4orWEBMRecording() {
     mWriter.clear();
     mTotalBitRate = 0;
@@ -1641,22 +1697,49 @@ status_t StagefrightRecorder::setupMPEG4orWEBMRecording() {
         writer = mp4writer = new MPEG4Writer(mOutputFd);
     }
 
+    // TODO Audio source is currently unsupported for webm output; vorbis encoder needed.
+    // disable audio for time lapse recording
+    bool setupAudio = mOutputFormat != OUTPUT_FORMAT_WEBM
+            && !(mCaptureFpsEnable && mCaptureFps < mFrameRate)
+            && mAudioSource != AUDIO_SOURCE_CNT;
+    mVideoSetupTimeUs = -1;
+    mAudioSetupTimeUs = -1;
+
+    // The audio encoder only depends on the audio parameters: create it while the camera or
+    // surface source and the video encoder are set up, as both open a codec.
+    pthread_t audioSetupThread;
+    bool audioSetupThreadStarted = false;
+    if (setupAudio && mVideoSource < VIDEO_SOURCE_LIST_END) {
+        audioSetupThreadStarted =
+                pthread_create(&audioSetupThread, NULL, AudioSetupThreadWrapper, this) == 0;
+    }
+
+    sp<MediaSource> videoEncoder;
     if (mVideoSource < VIDEO_SOURCE_LIST_END) {
+        int64_t startUs = systemTime() / 1000;
         setDefaultVideoEncoderIfNecessary();
 
         sp<MediaSource> mediaSource;
         err = setupMediaSource(&mediaSource);
-        if (err != OK) {
-            return err;
+        if (err == OK) {
+            err = setupVideoEncoder(mediaSource, &videoEncoder);
         }
+        mVideoSetupTimeUs = systemTime() / 1000 - startUs;
+    }
 
-        sp<MediaSource> encoder;
-        err = setupVideoEncoder(mediaSource, &encoder);
-        if (err != OK) {
-            return err;
-        }
+    if (audioSetupThreadStarted) {
+        pthread_join(audioSetupThread, NULL);
+    } else if (setupAudio && err == OK) {
+        AudioSetupThreadWrapper(this);
+    }
+    sp<MediaSource> audioEncoder = mAudioSetupEncoder;
+    mAudioSetupEncoder.clear();
+    if (err != OK) {
+        return err;
+    }
 
-        writer->addSource(encoder);
+    if (videoEncoder != NULL) {
+        writer->addSource(videoEncoder);
         mTotalBitRate += mVideoBitRate;
     }
 
@@ -1664,12 +1747,9 @@ status_t StagefrightRecorder::setupMPEG4orWEBMRecording() {
         // Audio source is added at the end if it exists.
         // This help make sure that the "recoding" sound is suppressed for
         // camcorder applications in the recorded files.
-        // TODO Audio source is currently unsupported for webm output; vorbis encoder needed.
-        // disable audio for time lapse recording
-        bool disableAudio = mCaptureFpsEnable && mCaptureFps < mFrameRate;
-        if (!disableAudio && mAudioSource != AUDIO_SOURCE_CNT) {
-            err = setupAudioEncoder(writer);
-            if (err != OK) return err;
+        if (setupAudio) {
+            if (mAudioSetupStatus != OK) return mAudioSetupStatus;
+            writer->addSource(audioEncoder);
             mTotalBitRate += mAudioBitRate;
         }
 
@@ -1720,6 +1800,9 @@ void StagefrightRecorder::setupMPEG4orWEBMMetaData(sp<MetaData> *meta) {
         if (mTrackEveryTimeDurationUs > 0) {
             (*meta)->setInt64(kKeyTrackTimeStatus, mTrackEveryTimeDurationUs);
         }
+        if (mFragmentDurationUs > 0) {
+            (*meta)->setInt64(kKeyFragmentDurationUs, mFragmentDurationUs);
+        }
         if (mRotationDegrees != 0) {
             (*meta)->setInt32(kKeyRotation, mRotationDegrees);
         }
@@ -1822,6 +1905,7 @@ status_t StagefrightRecorder::reset() {
     mUse64BitFileOffset = false;
     mMovieTimeScale  = -1;
     mAudioTimeScale  = -1;
+    mAudioCapturePeriodUs = 0;
     mVideoTimeScale  = -1;
     mCameraId        = 0;
     mStartTimeOffsetMs = -1;
@@ -1830,6 +1914,7 @@ status_t StagefrightRecorder::reset() {
     mMaxFileDurationUs = 0;
     mMaxFileSizeBytes = 0;
     mTrackEveryTimeDurationUs = 0;
+    mFragmentDurationUs = 0;
     mCaptureFpsEnable = false;
     mCaptureFps = 0.0f;
     mTimeBetweenCaptureUs = -1;
@@ -1840,6 +1925,11 @@ status_t StagefrightRecorder::reset() {
     mLatitudex10000 = -3600000;
     mLongitudex10000 = -3600000;
     mTotalBitRate = 0;
+    mVideoSetupTimeUs = -1;
+    mAudioSetupTimeUs = -1;
+    mWriterStartTimeUs = -1;
+    mAudioSetupStatus = OK;
+    mAudioSetupEncoder.clear();
 
     mOutputFd = -1;
 
@@ -1876,6 +1966,10 @@ status_t StagefrightRecorder::dump(
         result.append(buffer);
     }
     snprintf(buffer, SIZE, "   Recorder: %p\n", this);
+    result.append(buffer);
+    snprintf(buffer, SIZE, "   Start latency (us): video setup %" PRId64 ", audio setup %" PRId64
+            ", writer start %" PRId64 "\n",
+            mVideoSetupTimeUs, mAudioSetupTimeUs, mWriterStartTimeUs);
     snprintf(buffer, SIZE, "   Output file (fd %d):\n", mOutputFd);
     result.append(buffer);
     snprintf(buffer, SIZE, "     File format: %d\n", mOutputFormat);
@@ -1888,6 +1982,8 @@ status_t StagefrightRecorder::dump(
     result.append(buffer);
     snprintf(buffer, SIZE, "     Interleave duration (us): %d\n", mInterleaveDurationUs);
     result.append(buffer);
+    snprintf(buffer, SIZE, "     Fragment duration (us): %" PRId64 "\n", mFragmentDurationUs);
+    result.append(buffer);
     snprintf(buffer, SIZE, "     Progress notification: %" PRId64 " us\n", mTrackEveryTimeDurationUs);
     result.append(buffer);
     snprintf(buffer, SIZE, "   Audio\n");
@@ -102,9 +102,11 @@ private:
     int32_t mMovieTimeScale;
     int32_t mVideoTimeScale;
     int32_t mAudioTimeScale;
+    int64_t mAudioCapturePeriodUs;  // 0: AudioRecord callback driven
     int64_t mMaxFileSizeBytes;
     int64_t mMaxFileDurationUs;
     int64_t mTrackEveryTimeDurationUs;
+    int64_t mFragmentDurationUs;  // 0: not fragmented
     int32_t mRotationDegrees;  // Clockwise
     int32_t mLatitudex10000;
     int32_t mLongitudex10000;
@@ -129,6 +131,15 @@ private:
     sp<IGraphicBufferProducer> mGraphicBufferProducer;
     sp<ALooper> mLooper;
 
+    // Duration of the start stages of the last recording, -1 if the stage did not run
+    int64_t mVideoSetupTimeUs;
+    int64_t mAudioSetupTimeUs;
+    int64_t mWriterStartTimeUs;
+
+    // Result of the audio encoder set up in parallel with the video pipeline
+    status_t mAudioSetupStatus;
+    sp<MediaSource> mAudioSetupEncoder;
+
     static const int kMaxHighSpeedFps = 1000;
 
     status_t prepareInternal();
@@ -148,6 +159,8 @@ private:
     status_t setupMediaSource(sp<MediaSource> *mediaSource);
     status_t setupCameraSource(sp<CameraSource> *cameraSource);
     status_t setupAudioEncoder(const sp<MediaWriter>& writer);
+    status_t createAudioEncoder(sp<MediaSource> *audioEncoder);
+    static void *AudioSetupThreadWrapper(void *me);
     status_t setupVideoEncoder(sp<MediaSource> cameraSource, sp<MediaSource> *source);
 
     // Encoding parameter handling utilities
@@ -156,6 +169,7 @@ private:
     status_t setParamAudioNumberOfChannels(int32_t channles);
     status_t setParamAudioSamplingRate(int32_t sampleRate);
     status_t setParamAudioTimeScale(int32_t timeScale);
+    status_t setParamAudioCapturePeriodUs(int64_t capturePeriodUs);
     status_t setParamCaptureFpsEnable(int32_t timeLapseEnable);
     status_t setParamCaptureFps(float fps);
     status_t setParamVideoEncodingBitRate(int32_t bitRate);
@@ -168,6 +182,7 @@ private:
     status_t setParamTrackTimeStatus(int64_t timeDurationUs);
     status_t setParamInterleaveDuration(int32_t durationUs);
     status_t setParam64BitFileOffset(bool use64BitFileOffset);
+    status_t setParamFragmentDuration(int64_t durationUs);
     status_t setParamMaxFileDurationUs(int64_t timeUs);
     status_t setParamMaxFileSizeBytes(int64_t bytes);
     status_t setParamMovieTimeScale(int32_t timeScale);
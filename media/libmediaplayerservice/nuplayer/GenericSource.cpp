@@ -41,8 +41,16 @@
 
 namespace android {
 
-static int64_t kLowWaterMarkUs = 2000000ll;  // 2secs
-static int64_t kHighWaterMarkUs = 5000000ll;  // 5secs
+static const int64_t kLowWaterMarkUs = 2000000ll;  // 2secs
+static const int64_t kHighWaterMarkUs = 5000000ll;  // 5secs
+static const int64_t kMinLowWaterMarkUs = 1000000ll;  // 1sec
+static const int64_t kMaxLowWaterMarkUs = 10000000ll;  // 10secs
+static const int64_t kMaxHighWaterMarkUs = 30000000ll;  // 30secs
+static const int64_t kWaterMarkMarginUs = 2000000ll;  // 2secs
+// Stay below NuCachedSource2's default high water threshold (20MB) so the
+// cache keeps fetching until the time based high watermark is reached.
+static const int64_t kMaxHighWaterMarkBytes = 16 * 1024 * 1024;
+// Only used if the content bitrate cannot be determined.
 static const ssize_t kLowWaterMarkBytes = 40000;
 static const ssize_t kHighWaterMarkBytes = 200000;
 
@@ -67,6 +75,8 @@ NuPlayer::GenericSource::GenericSource(
       mFd(-1),
       mDrmManagerClient(NULL),
       mBitrate(-1ll),
+      mLowWaterMarkUs(kLowWaterMarkUs),
+      mHighWaterMarkUs(kHighWaterMarkUs),
       mPollBufferingGeneration(0),
       mPendingReadBufferTypes(0),
       mBuffering(false),
@@ -333,6 +343,9 @@ bool NuPlayer::GenericSource::isStreaming() const {
 }
 
 NuPlayer::GenericSource::~GenericSource() {
+    stopReader(&mAudioTrack);
+    stopReader(&mVideoTrack);
+
     if (mLooper != NULL) {
         mLooper->unregisterHandler(id());
         mLooper->stop();
@@ -349,6 +362,9 @@ void NuPlayer::GenericSource::prepareAsync() {
         mLooper->registerHandler(this);
     }
 
+    startReader(&mAudioTrack, "generic-audio");
+    startReader(&mVideoTrack, "generic-video");
+
     sp<AMessage> msg = new AMessage(kWhatPrepareAsync, this);
     msg->post();
 }
@@ -710,16 +726,11 @@ void NuPlayer::GenericSource::onPollBuffering() {
                 mCachedSource->approxDataRemaining(&finalStatus);
 
         if (finalStatus == OK) {
-            off64_t size;
-            int64_t bitrate = 0ll;
-            if (mDurationUs > 0 && mCachedSource->getSize(&size) == OK) {
-                bitrate = size * 8000000ll / mDurationUs;
-            } else if (mBitrate > 0) {
-                bitrate = mBitrate;
-            }
+            int64_t bitrate = estimateBitrate();
             if (bitrate > 0) {
                 cachedDurationUs = cachedDataRemaining * 8000000ll / bitrate;
             }
+            updateWaterMarks(bitrate);
         }
     }
 
@@ -746,9 +757,9 @@ void NuPlayer::GenericSource::onPollBuffering() {
         ALOGV("onPollBuffering: cachedDurationUs %.1f sec",
                 cachedDurationUs / 1000000.0f);
 
-        if (cachedDurationUs < kLowWaterMarkUs) {
+        if (cachedDurationUs < mLowWaterMarkUs) {
             startBufferingIfNecessary();
-        } else if (cachedDurationUs > kHighWaterMarkUs) {
+        } else if (cachedDurationUs > mHighWaterMarkUs) {
             stopBufferingIfNecessary();
         }
     } else if (cachedDataRemaining >= 0) {
@@ -765,6 +776,61 @@ void NuPlayer::GenericSource::onPollBuffering() {
     schedulePollBuffering();
 }
 
+int64_t NuPlayer::GenericSource::estimateBitrate() {
+    off64_t size;
+    if (mDurationUs > 0 && mCachedSource != NULL
+            && mCachedSource->getSize(&size) == OK) {
+        return size * 8000000ll / mDurationUs;
+    }
+    return mBitrate;
+}
+
+void NuPlayer::GenericSource::updateWaterMarks(int64_t bitrate) {
+    int64_t lowWaterMarkUs = kLowWaterMarkUs;
+    int64_t highWaterMarkUs = kHighWaterMarkUs;
+
+    int32_t kbps;
+    if (bitrate > 0 && mCachedSource != NULL
+            && mCachedSource->getEstimatedBandwidthKbps(&kbps) == OK
+            && kbps > 0) {
+        // The cache drains at (bitrate - bandwidth) while playing, so keep
+        // proportionally more playback time in reserve on slow links, and
+        // resume sooner when the link comfortably outpaces the content.
+        int64_t bandwidth = kbps * 1000ll;
+        lowWaterMarkUs = kLowWaterMarkUs * bitrate / bandwidth;
+        if (lowWaterMarkUs < kMinLowWaterMarkUs) {
+            lowWaterMarkUs = kMinLowWaterMarkUs;
+        } else if (lowWaterMarkUs > kMaxLowWaterMarkUs) {
+            lowWaterMarkUs = kMaxLowWaterMarkUs;
+        }
+
+        highWaterMarkUs = kHighWaterMarkUs * bitrate / bandwidth;
+        if (highWaterMarkUs < lowWaterMarkUs + kWaterMarkMarginUs) {
+            highWaterMarkUs = lowWaterMarkUs + kWaterMarkMarginUs;
+        } else if (highWaterMarkUs > kMaxHighWaterMarkUs) {
+            highWaterMarkUs = kMaxHighWaterMarkUs;
+        }
+    }
+
+    if (bitrate > 0) {
+        int64_t maxHighWaterMarkUs = kMaxHighWaterMarkBytes * 8000000ll / bitrate;
+        if (highWaterMarkUs > maxHighWaterMarkUs) {
+            highWaterMarkUs = maxHighWaterMarkUs;
+            if (lowWaterMarkUs > highWaterMarkUs - kWaterMarkMarginUs) {
+                lowWaterMarkUs = highWaterMarkUs / 2;
+            }
+        }
+    }
+
+    if (lowWaterMarkUs != mLowWaterMarkUs || highWaterMarkUs != mHighWaterMarkUs) {
+        ALOGV("bitrate %lld, watermarks %.1f - %.1f sec",
+                (long long)bitrate,
+                lowWaterMarkUs / 1E6, highWaterMarkUs / 1E6);
+        mLowWaterMarkUs = lowWaterMarkUs;
+        mHighWaterMarkUs = highWaterMarkUs;
+    }
+}
+
 void NuPlayer::GenericSource::onMessageReceived(const sp<AMessage> &msg) {
     switch (msg->what()) {
       case kWhatPrepareAsync:
@@ -822,12 +888,15 @@ void NuPlayer::GenericSource::onMessageReceived(const sp<AMessage> &msg) {
           }
 
 
-          if (track->mSource != NULL) {
-              track->mSource->stop();
+          {
+              Mutex::Autolock _l(track->mReadLock);
+              if (track->mSource != NULL) {
+                  track->mSource->stop();
+              }
+              track->mSource = source;
+              track->mSource->start();
+              track->mIndex = trackIndex;
           }
-          track->mSource = source;
-          track->mSource->start();
-          track->mIndex = trackIndex;
 
           int64_t timeUs, actualTimeUs;
           const bool formatChange = true;
@@ -905,9 +974,12 @@ void NuPlayer::GenericSource::onMessageReceived(const sp<AMessage> &msg) {
       {
           // mStopRead is only used for Widevine to prevent the video source
           // from being read while the associated video decoder is shutting down.
-          mStopRead = true;
-          if (mVideoTrack.mSource != NULL) {
-              mVideoTrack.mPackets->clear();
+          {
+              Mutex::Autolock _l(mVideoTrack.mReadLock);
+              mStopRead = true;
+              if (mVideoTrack.mSource != NULL) {
+                  mVideoTrack.mPackets->clear();
+              }
           }
           sp<AMessage> response = new AMessage;
           sp<AReplyToken> replyID;
@@ -1501,12 +1573,43 @@ sp<ABuffer> NuPlayer::GenericSource::mediaBufferToABuffer(
     return ab;
 }
 
+void NuPlayer::GenericSource::startReader(Track *track, const char *name) {
+    if (track->mReadLooper != NULL) {
+        return;
+    }
+
+    track->mReadLooper = new ALooper;
+    track->mReadLooper->setName(name);
+    track->mReadLooper->start();
+
+    track->mReader = new AHandlerReflector<GenericSource>(this);
+    track->mReadLooper->registerHandler(track->mReader);
+}
+
+void NuPlayer::GenericSource::stopReader(Track *track) {
+    if (track->mReadLooper == NULL) {
+        return;
+    }
+
+    track->mReadLooper->unregisterHandler(track->mReader->id());
+    track->mReadLooper->stop();
+    track->mReadLooper.clear();
+    track->mReader.clear();
+}
+
 void NuPlayer::GenericSource::postReadBuffer(media_track_type trackType) {
     Mutex::Autolock _l(mReadBufferLock);
 
     if ((mPendingReadBufferTypes & (1 << trackType)) == 0) {
         mPendingReadBufferTypes |= (1 << trackType);
-        sp<AMessage> msg = new AMessage(kWhatReadBuffer, this);
+        sp<AMessage> msg;
+        if (trackType == MEDIA_TRACK_TYPE_AUDIO && mAudioTrack.mReader != NULL) {
+            msg = new AMessage(kWhatReadBuffer, mAudioTrack.mReader);
+        } else if (trackType == MEDIA_TRACK_TYPE_VIDEO && mVideoTrack.mReader != NULL) {
+            msg = new AMessage(kWhatReadBuffer, mVideoTrack.mReader);
+        } else {
+            msg = new AMessage(kWhatReadBuffer, this);
+        }
         msg->setInt32("trackType", trackType);
         msg->post();
     }
@@ -1527,10 +1630,6 @@ void NuPlayer::GenericSource::onReadBuffer(sp<AMessage> msg) {
 
 void NuPlayer::GenericSource::readBuffer(
         media_track_type trackType, int64_t seekTimeUs, int64_t *actualTimeUs, bool formatChange) {
-    // Do not read data if Widevine source is stopped
-    if (mStopRead) {
-        return;
-    }
     Track *track;
     size_t maxBuffers = 1;
     switch (trackType) {
@@ -1560,6 +1659,15 @@ void NuPlayer::GenericSource::readBuffer(
             TRESPASS();
     }
 
+    // Reads may come from the track's reader looper as well as from seeks
+    // on the main looper.
+    Mutex::Autolock _l(track->mReadLock);
+
+    // Do not read data if Widevine source is stopped
+    if (mStopRead) {
+        return;
+    }
+
     if (track->mSource == NULL) {
         return;
     }
@@ -24,6 +24,7 @@
 #include "ATSParser.h"
 
 #include <media/mediaplayer.h>
+#include <media/stagefright/foundation/AHandlerReflector.h>
 
 namespace android {
 
@@ -109,6 +110,14 @@ private:
         size_t mIndex;
         sp<MediaSource> mSource;
         sp<AnotherPacketSource> mPackets;
+
+        // Audio and video are read ahead on their own loopers so that a
+        // slow read on one track does not starve the other. mReadLock
+        // serializes those reads against seeks and source changes, which
+        // still run on the main looper.
+        sp<ALooper> mReadLooper;
+        sp<AHandlerReflector<GenericSource> > mReader;
+        Mutex mReadLock;
     };
 
     Vector<sp<MediaSource> > mSources;
@@ -147,6 +156,8 @@ private:
     bool mStarted;
     bool mStopRead;
     int64_t mBitrate;
+    int64_t mLowWaterMarkUs;
+    int64_t mHighWaterMarkUs;
     int32_t mPollBufferingGeneration;
     uint32_t mPendingReadBufferTypes;
     bool mBuffering;
@@ -205,6 +216,9 @@ private:
             int64_t seekTimeUs,
             int64_t *actualTimeUs = NULL);
 
+    void startReader(Track *track, const char *name);
+    void stopReader(Track *track);
+
     void postReadBuffer(media_track_type trackType);
     void onReadBuffer(sp<AMessage> msg);
     void readBuffer(
@@ -218,12 +232,16 @@ private:
     void cancelPollBuffering();
     void restartPollBuffering();
     void onPollBuffering();
+    int64_t estimateBitrate();
+    void updateWaterMarks(int64_t bitrate);
     void notifyBufferingUpdate(int32_t percentage);
     void startBufferingIfNecessary();
     void stopBufferingIfNecessary();
     void sendCacheStats();
     void ensureCacheIsFetching();
 
+    friend struct AHandlerReflector<GenericSource>;
+
     DISALLOW_EVIL_CONSTRUCTORS(GenericSource);
 };
 
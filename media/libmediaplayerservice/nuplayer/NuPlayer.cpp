@@ -36,6 +36,7 @@
 
 #include "ATSParser.h"
 
+#include <cutils/atomic.h>
 #include <cutils/properties.h>
 
 #include <media/AudioResamplerPublic.h>
@@ -171,6 +172,12 @@ NuPlayer::NuPlayer(pid_t pid)
     : mUIDValid(false),
       mPID(pid),
       mSourceFlags(0),
+      mSourceID(0),
+      mNextSourceIDToUse(1),
+      mNextSourceID(0),
+      mNextSourceFlags(0),
+      mNextSourcePrepared(false),
+      mSwitchToNextPending(false),
       mOffloadAudio(false),
       mAudioDecoderGeneration(0),
       mVideoDecoderGeneration(0),
@@ -235,16 +242,13 @@ static bool IsHTTPLiveURL(const char *url) {
     return false;
 }
 
-void NuPlayer::setDataSourceAsync(
+sp<NuPlayer::Source> NuPlayer::makeSource(
+        const sp<AMessage> &notify,
         const sp<IMediaHTTPService> &httpService,
         const char *url,
         const KeyedVector<String8, String8> *headers) {
-
-    sp<AMessage> msg = new AMessage(kWhatSetDataSource, this);
     size_t len = strlen(url);
 
-    sp<AMessage> notify = new AMessage(kWhatSourceNotify, this);
-
     sp<Source> source;
     if (IsHTTPLiveURL(url)) {
         source = new HTTPLiveSource(notify, httpService, url, headers);
@@ -272,7 +276,20 @@ void NuPlayer::setDataSourceAsync(
             ALOGE("Failed to set data source!");
         }
     }
-    msg->setObject("source", source);
+
+    return source;
+}
+
+void NuPlayer::setDataSourceAsync(
+        const sp<IMediaHTTPService> &httpService,
+        const char *url,
+        const KeyedVector<String8, String8> *headers) {
+
+    sp<AMessage> msg = new AMessage(kWhatSetDataSource, this);
+
+    sp<AMessage> notify = new AMessage(kWhatSourceNotify, this);
+
+    msg->setObject("source", makeSource(notify, httpService, url, headers));
     msg->post();
 }
 
@@ -315,6 +332,54 @@ void NuPlayer::prepareAsync() {
     (new AMessage(kWhatPrepare, this))->post();
 }
 
+sp<AMessage> NuPlayer::makeNextSourceNotify() {
+    sp<AMessage> notify = new AMessage(kWhatSourceNotify, this);
+    notify->setInt32("source-id", android_atomic_inc(&mNextSourceIDToUse));
+    return notify;
+}
+
+status_t NuPlayer::preloadNextAsync(
+        const sp<IMediaHTTPService> &httpService,
+        const char *url,
+        const KeyedVector<String8, String8> *headers) {
+    sp<AMessage> notify = makeNextSourceNotify();
+
+    sp<Source> source = makeSource(notify, httpService, url, headers);
+    if (source == NULL) {
+        return UNKNOWN_ERROR;
+    }
+
+    sp<AMessage> msg = new AMessage(kWhatPreloadNext, this);
+    msg->setObject("source", source);
+    msg->setMessage("notify", notify);
+    msg->post();
+
+    return OK;
+}
+
+status_t NuPlayer::preloadNextAsync(int fd, int64_t offset, int64_t length) {
+    sp<AMessage> notify = makeNextSourceNotify();
+
+    sp<GenericSource> source = new GenericSource(notify, mUIDValid, mUID);
+
+    status_t err = source->setDataSource(fd, offset, length);
+    if (err != OK) {
+        ALOGE("Failed to set next data source!");
+        return err;
+    }
+
+    sp<AMessage> msg = new AMessage(kWhatPreloadNext, this);
+    msg->setObject("source", source);
+    msg->setMessage("notify", notify);
+    msg->post();
+
+    return OK;
+}
+
+void NuPlayer::switchToNextAsync() {
+    (new AMessage(kWhatSwitchToNext, this))->post();
+}
+
 void NuPlayer::setVideoSurfaceTextureAsync(
         const sp<IGraphicBufferProducer> &bufferProducer) {
     sp<AMessage> msg = new AMessage(kWhatSetVideoSurface, this);
@@ -492,6 +557,47 @@ void NuPlayer::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatPreloadNext:
+        {
+            sp<RefBase> obj;
+            CHECK(msg->findObject("source", &obj));
+
+            sp<AMessage> notify;
+            CHECK(msg->findMessage("notify", &notify));
+
+            if (mNextSource != NULL) {
+                ALOGI("replacing preloaded source %d", mNextSourceID);
+                mNextSource->disconnect();
+            }
+
+            mNextSource = static_cast<Source *>(obj.get());
+            CHECK(notify->findInt32("source-id", &mNextSourceID));
+            mNextSourceFlags = 0;
+            mNextSourcePrepared = false;
+            mSwitchToNextPending = false;
+
+            mNextSource->prepareAsync();
+            break;
+        }
+
+        case kWhatSwitchToNext:
+        {
+            if (mSource == NULL || mNextSource == NULL) {
+                ALOGW("no source preloaded to switch to");
+                notifyListener(MEDIA_INFO, MEDIA_INFO_UNKNOWN, INVALID_OPERATION);
+                break;
+            }
+
+            if (!mNextSourcePrepared) {
+                // Switch as soon as it is.
+                mSwitchToNextPending = true;
+                break;
+            }
+
+            onSwitchToNext();
+            break;
+        }
+
         case kWhatGetTrackInfo:
         {
             sp<AReplyToken> replyID;
@@ -1226,6 +1332,14 @@ void NuPlayer::onMessageReceived(const sp<AMessage> &msg) {
 
         case kWhatSourceNotify:
         {
+            int32_t sourceID = 0;
+            msg->findInt32("source-id", &sourceID);
+
+            if (sourceID != mSourceID) {
+                onNextSourceNotify(msg);
+                break;
+            }
+
             onSourceNotify(msg);
             break;
         }
@@ -1836,7 +1950,11 @@ void NuPlayer::getStats(Vector<sp<AMessage> > *mTrackStats) {
 
     mTrackStats->clear();
     if (mVideoDecoder != NULL) {
-        mTrackStats->push_back(mVideoDecoder->getStats());
+        sp<AMessage> stats = mVideoDecoder->getStats()->dup();
+        if (mRenderer != NULL) {
+            mRenderer->getVideoFrameStats(stats);
+        }
+        mTrackStats->push_back(stats);
     }
     if (mAudioDecoder != NULL) {
         mTrackStats->push_back(mAudioDecoder->getStats());
@@ -1966,6 +2084,14 @@ void NuPlayer::performReset() {
         mSource.clear();
     }
 
+    if (mNextSource != NULL) {
+        mNextSource->disconnect();
+        mNextSource.clear();
+    }
+    mSourceID = 0;
+    mNextSourcePrepared = false;
+    mSwitchToNextPending = false;
+
     if (mDriver != NULL) {
         sp<NuPlayerDriver> driver = mDriver.promote();
         if (driver != NULL) {
@@ -2006,6 +2132,152 @@ void NuPlayer::performSetSurface(const sp<Surface> &surface) {
     }
 }
 
+// Whether a decoder configured for |from| can go on to decode |to| after
+// nothing more than a flush, which resubmits the same codec specific data.
+static bool IsCompatibleFormat(
+        const sp<AMessage> &from, const sp<AMessage> &to, bool audio) {
+    if (from == NULL || to == NULL) {
+        return false;
+    }
+
+    AString fromMime, toMime;
+    if (!from->findString("mime", &fromMime)
+            || !to->findString("mime", &toMime)
+            || strcasecmp(fromMime.c_str(), toMime.c_str())) {
+        return false;
+    }
+
+    static const char *kAudioKeys[] = { "sample-rate", "channel-count" };
+    static const char *kVideoKeys[] = { "width", "height" };
+
+    const char **keys = audio ? kAudioKeys : kVideoKeys;
+    for (size_t i = 0; i < 2; ++i) {
+        int32_t fromVal, toVal;
+        if (!from->findInt32(keys[i], &fromVal)
+                || !to->findInt32(keys[i], &toVal)
+                || fromVal != toVal) {
+            return false;
+        }
+    }
+
+    for (int32_t i = 0; ; ++i) {
+        AString tag = "csd-";
+        tag.append(i);
+
+        sp<ABuffer> fromBuf, toBuf;
+        bool hasFrom = from->findBuffer(tag.c_str(), &fromBuf);
+        bool hasTo = to->findBuffer(tag.c_str(), &toBuf);
+
+        if (hasFrom != hasTo) {
+            return false;
+        }
+
+        if (!hasFrom) {
+            break;
+        }
+
+        if (fromBuf->size() != toBuf->size()
+                || memcmp(fromBuf->data(), toBuf->data(), fromBuf->size())) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void NuPlayer::onSwitchToNext() {
+    mSwitchToNextPending = false;
+
+    bool secure = (mSourceFlags | mNextSourceFlags) & Source::FLAG_SECURE;
+
+    bool keepAudio = mAudioDecoder != NULL && !mOffloadAudio && !secure
+            && IsCompatibleFormat(
+                    mSource->getFormat(true /* audio */),
+                    mNextSource->getFormat(true /* audio */),
+                    true /* audio */);
+
+    bool keepVideo = mVideoDecoder != NULL && !secure
+            && IsCompatibleFormat(
+                    mSource->getFormat(false /* audio */),
+                    mNextSource->getFormat(false /* audio */),
+                    false /* audio */);
+
+    ALOGI("switching to source %d, keeping audio decoder %d, video decoder %d",
+          mNextSourceID, keepAudio, keepVideo);
+
+    // The renderer, and with it the audio sink, stays. Decoders that can't
+    // carry over are shut down and instantiated again by scanning sources.
+    mDeferredActions.push_back(
+            new FlushDecoderAction(
+                keepAudio ? FLUSH_CMD_FLUSH : FLUSH_CMD_SHUTDOWN,
+                keepVideo ? FLUSH_CMD_FLUSH : FLUSH_CMD_SHUTDOWN));
+
+    mDeferredActions.push_back(
+            new SimpleAction(&NuPlayer::performSwitchToNext));
+
+    // After a flush without shutdown, decoder is paused.
+    // Don't resume it until it reads from the new source.
+    mDeferredActions.push_back(
+            new ResumeDecoderAction(false /* needNotify */));
+
+    processDeferredActions();
+}
+
+void NuPlayer::performSwitchToNext() {
+    ALOGV("performSwitchToNext");
+
+    if (mSource == NULL || mNextSource == NULL) {
+        // reset() got in between.
+        return;
+    }
+
+    if (mSourceStarted) {
+        mSource->stop();
+    }
+
+    mSource = mNextSource;
+    mNextSource.clear();
+    mSourceID = mNextSourceID;
+    mSourceFlags = mNextSourceFlags;
+    mNextSourcePrepared = false;
+
+    if (mSourceStarted) {
+        mSource->start();
+        if (mPaused) {
+            mSource->pause();
+        }
+    }
+
+    mPreviousSeekTimeUs = 0;
+    mAudioEOS = false;
+    mVideoEOS = false;
+    ++mTimedTextGeneration;
+
+    if (mAudioDecoder != NULL) {
+        mAudioDecoder->setSource(mSource);
+    }
+    if (mVideoDecoder != NULL) {
+        mVideoDecoder->setSource(mSource);
+    }
+
+    cancelPollDuration();
+    if ((mSourceFlags & Source::FLAG_DYNAMIC_DURATION)
+            && (mAudioDecoder != NULL || mVideoDecoder != NULL)) {
+        schedulePollDuration();
+    }
+
+    sp<NuPlayerDriver> driver = mDriver.promote();
+    if (driver != NULL) {
+        int64_t durationUs;
+        if (mSource->getDuration(&durationUs) == OK) {
+            driver->notifyDuration(durationUs);
+        }
+        driver->notifyFlagsChanged(mSourceFlags);
+    }
+
+    performScanSources();
+}
+
 void NuPlayer::performResumeDecoders(bool needNotify) {
     if (needNotify) {
         mResumePending = true;
@@ -2283,6 +2555,80 @@ void NuPlayer::onSourceNotify(const sp<AMessage> &msg) {
     }
 }
 
+void NuPlayer::onNextSourceNotify(const sp<AMessage> &msg) {
+    int32_t sourceID = 0;
+    msg->findInt32("source-id", &sourceID);
+
+    int32_t what;
+    CHECK(msg->findInt32("what", &what));
+
+    // Sources that were switched away from or replaced before being used
+    // only get their replies.
+    bool isNextSource = (mNextSource != NULL && sourceID == mNextSourceID);
+
+    switch (what) {
+        case Source::kWhatPrepared:
+        {
+            if (!isNextSource) {
+                break;
+            }
+
+            int32_t err;
+            CHECK(msg->findInt32("err", &err));
+
+            if (err != OK) {
+                ALOGE("failed to prepare next source %d (%d)", sourceID, err);
+
+                mNextSource.clear();
+                if (mSwitchToNextPending) {
+                    mSwitchToNextPending = false;
+                    notifyListener(MEDIA_INFO, MEDIA_INFO_UNKNOWN, err);
+                }
+                break;
+            }
+
+            mNextSourcePrepared = true;
+
+            if (mSwitchToNextPending) {
+                onSwitchToNext();
+            }
+            break;
+        }
+
+        case Source::kWhatFlagsChanged:
+        {
+            if (isNextSource) {
+                CHECK(msg->findInt32("flags", (int32_t *)&mNextSourceFlags));
+            }
+            break;
+        }
+
+        case Source::kWhatInstantiateSecureDecoders:
+        {
+            // Secure decoders belong to the source playing, the next one
+            // can't have any of its own until it is switched to.
+            sp<AMessage> reply;
+            CHECK(msg->findMessage("reply", &reply));
+            reply->setInt32("err", INVALID_OPERATION);
+            reply->post();
+            break;
+        }
+
+        case Source::kWhatQueueDecoderShutdown:
+        {
+            // There are no decoders of its own to shut down.
+            sp<AMessage> reply;
+            CHECK(msg->findMessage("reply", &reply));
+            reply->post();
+            break;
+        }
+
+        default:
+            ALOGV("ignoring notification %d of source %d", what, sourceID);
+            break;
+    }
+}
+
 void NuPlayer::onClosedCaptionNotify(const sp<AMessage> &msg) {
     int32_t what;
     CHECK(msg->findInt32("what", &what));
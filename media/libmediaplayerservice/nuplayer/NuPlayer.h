@@ -52,6 +52,18 @@ struct NuPlayer : public AHandler {
 
     void prepareAsync();
 
+    // Prepares another source in the background while the current one keeps
+    // playing. switchToNextAsync() changes over to it, keeping the decoders
+    // and the renderer whose formats carry over and only flushing them.
+    status_t preloadNextAsync(
+            const sp<IMediaHTTPService> &httpService,
+            const char *url,
+            const KeyedVector<String8, String8> *headers);
+
+    status_t preloadNextAsync(int fd, int64_t offset, int64_t length);
+
+    void switchToNextAsync();
+
     void setVideoSurfaceTextureAsync(
             const sp<IGraphicBufferProducer> &bufferProducer);
 
@@ -135,6 +147,8 @@ private:
         kWhatGetSelectedTrack           = 'gSel',
         kWhatSelectTrack                = 'selT',
         kWhatSetTime                    = 'setT',
+        kWhatPreloadNext                = 'preN',
+        kWhatSwitchToNext               = 'swtN',
     };
 
     wp<NuPlayerDriver> mDriver;
@@ -143,6 +157,17 @@ private:
     pid_t mPID;
     sp<Source> mSource;
     uint32_t mSourceFlags;
+
+    // Notifications of a source carry its "source-id", 0 for the ones set
+    // through setDataSourceAsync().
+    int32_t mSourceID;
+    volatile int32_t mNextSourceIDToUse;
+
+    sp<Source> mNextSource;
+    int32_t mNextSourceID;
+    uint32_t mNextSourceFlags;
+    bool mNextSourcePrepared;
+    bool mSwitchToNextPending;
     sp<Surface> mSurface;
     sp<MediaPlayerBase::AudioSink> mAudioSink;
     sp<DecoderBase> mVideoDecoder;
@@ -222,6 +247,14 @@ private:
         mFlushComplete[1][1] = false;
     }
 
+    sp<Source> makeSource(
+            const sp<AMessage> &notify,
+            const sp<IMediaHTTPService> &httpService,
+            const char *url,
+            const KeyedVector<String8, String8> *headers);
+
+    sp<AMessage> makeNextSourceNotify();
+
     void tryOpenAudioSinkForOffload(const sp<AMessage> &format, bool hasVideo);
     void closeAudioSink();
     void determineAudioModeChange();
@@ -263,8 +296,11 @@ private:
     void performScanSources();
     void performSetSurface(const sp<Surface> &wrapper);
     void performResumeDecoders(bool needNotify);
+    void performSwitchToNext();
 
     void onSourceNotify(const sp<AMessage> &msg);
+    void onNextSourceNotify(const sp<AMessage> &msg);
+    void onSwitchToNext();
     void onClosedCaptionNotify(const sp<AMessage> &msg);
 
     void queueDecoderShutdown(
@@ -192,6 +192,18 @@ bool NuPlayer::CCDecoder::extractFromSEI(const sp<ABuffer> &accessUnit) {
         return false;
     }
 
+    // Caption data is only kept for display while a track is selected;
+    // otherwise the SEI is parsed just to find new channels, and once all of
+    // them have been found not at all.
+    bool storeCC = isSelected();
+    if (!storeCC) {
+        // drop what was kept for a track that has since been unselected
+        flush();
+        if (mFoundChannels.size() == kNumChannels) {
+            return false;
+        }
+    }
+
     int64_t timeUs;
     CHECK(accessUnit->meta()->findInt64("timeUs", &timeUs));
 
@@ -201,7 +213,7 @@ bool NuPlayer::CCDecoder::extractFromSEI(const sp<ABuffer> &accessUnit) {
 
     for (size_t i = 0; i < sei->size() / sizeof(NALPosition); ++i, ++nal) {
         trackAdded |= parseSEINalUnit(
-                timeUs, accessUnit->data() + nal->nalOffset, nal->nalSize);
+                timeUs, accessUnit->data() + nal->nalOffset, nal->nalSize, storeCC);
     }
 
     return trackAdded;
@@ -209,7 +221,7 @@ bool NuPlayer::CCDecoder::extractFromSEI(const sp<ABuffer> &accessUnit) {
 
 // returns true if a new CC track is found
 bool NuPlayer::CCDecoder::parseSEINalUnit(
-        int64_t timeUs, const uint8_t *nalStart, size_t nalSize) {
+        int64_t timeUs, const uint8_t *nalStart, size_t nalSize, bool storeCC) {
     unsigned nalType = nalStart[0] & 0x1f;
 
     // the buffer should only have SEI in it
@@ -266,10 +278,10 @@ bool NuPlayer::CCDecoder::parseSEINalUnit(
                 payload_size -= 2;
 
                 if (process_cc_data_flag) {
-                    AString out;
-
-                    sp<ABuffer> ccBuf = new ABuffer(cc_count * sizeof(CCData));
-                    ccBuf->setRange(0, 0);
+                    sp<ABuffer> ccBuf;
+                    if (storeCC) {
+                        ccBuf = acquireCCBuf();
+                    }
 
                     for (size_t i = 0; i < cc_count && payload_size >= 3; i++) {
                         uint8_t marker = br.getBits(5);
@@ -293,14 +305,28 @@ bool NuPlayer::CCDecoder::parseSEINalUnit(
                                     mFoundChannels.push_back(channel);
                                     trackAdded = true;
                                 }
-                                memcpy(ccBuf->data() + ccBuf->size(),
-                                        (void *)&cc, sizeof(cc));
-                                ccBuf->setRange(0, ccBuf->size() + sizeof(CCData));
+                                if (ccBuf != NULL) {
+                                    memcpy(ccBuf->data() + ccBuf->size(),
+                                            (void *)&cc, sizeof(cc));
+                                    ccBuf->setRange(0, ccBuf->size() + sizeof(CCData));
+                                }
                             }
                         }
                     }
 
-                    mCCMap.add(timeUs, ccBuf);
+                    if (ccBuf != NULL) {
+                        if (ccBuf->size() == 0) {
+                            recycleCCBuf(ccBuf);
+                        } else {
+                            ssize_t index = mCCMap.indexOfKey(timeUs);
+                            if (index >= 0) {
+                                recycleCCBuf(mCCMap.valueAt(index));
+                                mCCMap.replaceValueAt(index, ccBuf);
+                            } else {
+                                mCCMap.add(timeUs, ccBuf);
+                            }
+                        }
+                    }
                     break;
                 }
             } else {
@@ -317,11 +343,9 @@ bool NuPlayer::CCDecoder::parseSEINalUnit(
     return trackAdded;
 }
 
-sp<ABuffer> NuPlayer::CCDecoder::filterCCBuf(
-        const sp<ABuffer> &ccBuf, size_t index) {
-    sp<ABuffer> filteredCCBuf = new ABuffer(ccBuf->size());
-    filteredCCBuf->setRange(0, 0);
-
+// appends the pairs of track |index| in |ccBuf| to |filteredCCBuf|
+void NuPlayer::CCDecoder::filterCCBuf(
+        const sp<ABuffer> &ccBuf, size_t index, const sp<ABuffer> &filteredCCBuf) {
     size_t cc_count = ccBuf->size() / sizeof(CCData);
     const CCData* cc_data = (const CCData*)ccBuf->data();
     for (size_t i = 0; i < cc_count; ++i) {
@@ -335,8 +359,24 @@ sp<ABuffer> NuPlayer::CCDecoder::filterCCBuf(
             filteredCCBuf->setRange(0, filteredCCBuf->size() + sizeof(CCData));
         }
     }
+}
+
+sp<ABuffer> NuPlayer::CCDecoder::acquireCCBuf() {
+    sp<ABuffer> ccBuf;
+    if (mFreeBuffers.isEmpty()) {
+        ccBuf = new ABuffer(kMaxCCPairs * sizeof(CCData));
+    } else {
+        ccBuf = mFreeBuffers.top();
+        mFreeBuffers.pop();
+    }
+    ccBuf->setRange(0, 0);
+    return ccBuf;
+}
 
-    return filteredCCBuf;
+void NuPlayer::CCDecoder::recycleCCBuf(const sp<ABuffer> &ccBuf) {
+    if (mFreeBuffers.size() < kMaxFreeBuffers) {
+        mFreeBuffers.push(ccBuf);
+    }
 }
 
 void NuPlayer::CCDecoder::decode(const sp<ABuffer> &accessUnit) {
@@ -355,13 +395,26 @@ void NuPlayer::CCDecoder::display(int64_t timeUs) {
         return;
     }
 
-    ssize_t index = mCCMap.indexOfKey(timeUs);
-    if (index < 0) {
+    // Deliver the captions of all frames up to this one together, so that
+    // frames dropped before rendering don't lose theirs.
+    size_t count = 0;
+    size_t size = 0;
+    while (count < mCCMap.size() && mCCMap.keyAt(count) <= timeUs) {
+        size += mCCMap.valueAt(count)->size();
+        ++count;
+    }
+    if (count == 0) {
         ALOGV("cc for timestamp %" PRId64 " not found", timeUs);
         return;
     }
 
-    sp<ABuffer> ccBuf = filterCCBuf(mCCMap.valueAt(index), mSelectedTrack);
+    sp<ABuffer> ccBuf = new ABuffer(size);
+    ccBuf->setRange(0, 0);
+    for (size_t i = 0; i < count; ++i) {
+        filterCCBuf(mCCMap.valueAt(i), mSelectedTrack, ccBuf);
+        recycleCCBuf(mCCMap.valueAt(i));
+    }
+    mCCMap.removeItemsAt(0, count);
 
     if (ccBuf->size() > 0) {
 #if 0
@@ -377,12 +430,12 @@ void NuPlayer::CCDecoder::display(int64_t timeUs) {
         msg->setBuffer("buffer", ccBuf);
         msg->post();
     }
-
-    // remove all entries before timeUs
-    mCCMap.removeItemsAt(0, index + 1);
 }
 
 void NuPlayer::CCDecoder::flush() {
+    for (size_t i = 0; i < mCCMap.size(); ++i) {
+        recycleCCBuf(mCCMap.valueAt(i));
+    }
     mCCMap.clear();
 }
 
@@ -39,18 +39,31 @@ struct NuPlayer::CCDecoder : public RefBase {
     void flush();
 
 private:
+    enum {
+        kNumChannels = 4,
+        // cc_count is a 5-bit field
+        kMaxCCPairs = 31,
+        kMaxFreeBuffers = 16,
+    };
+
     sp<AMessage> mNotify;
     KeyedVector<int64_t, sp<ABuffer> > mCCMap;
+    // Recycled mCCMap buffers, all able to hold kMaxCCPairs pairs.
+    Vector<sp<ABuffer> > mFreeBuffers;
     size_t mCurrentChannel;
     int32_t mSelectedTrack;
-    int32_t mTrackIndices[4];
+    int32_t mTrackIndices[kNumChannels];
     Vector<size_t> mFoundChannels;
 
     bool isTrackValid(size_t index) const;
     int32_t getTrackIndex(size_t channel) const;
     bool extractFromSEI(const sp<ABuffer> &accessUnit);
-    bool parseSEINalUnit(int64_t timeUs, const uint8_t *nalStart, size_t nalSize);
-    sp<ABuffer> filterCCBuf(const sp<ABuffer> &ccBuf, size_t index);
+    bool parseSEINalUnit(
+            int64_t timeUs, const uint8_t *nalStart, size_t nalSize, bool storeCC);
+    void filterCCBuf(
+            const sp<ABuffer> &ccBuf, size_t index, const sp<ABuffer> &filteredCCBuf);
+    sp<ABuffer> acquireCCBuf();
+    void recycleCCBuf(const sp<ABuffer> &ccBuf);
 
     DISALLOW_EVIL_CONSTRUCTORS(CCDecoder);
 };
@@ -351,6 +351,12 @@ void NuPlayer::Decoder::onSetRenderer(const sp<Renderer> &renderer) {
     }
 }
 
+void NuPlayer::Decoder::onSetSource(const sp<Source> &source) {
+    // The new source's codec specific data matches what doFlush() queued up
+    // for resubmission, see IsCompatibleFormat() in NuPlayer.
+    mSource = source;
+}
+
 void NuPlayer::Decoder::onGetInputBuffers(
         Vector<sp<ABuffer> > *dstBuffers) {
     CHECK_EQ((status_t)OK, mCodec->getWidevineLegacyBuffers(dstBuffers));
@@ -23,6 +23,7 @@
 #include "NuPlayerDecoderBase.h"
 
 #include "NuPlayerRenderer.h"
+#include "NuPlayerSource.h"
 
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
@@ -84,6 +85,12 @@ void NuPlayer::DecoderBase::setRenderer(const sp<Renderer> &renderer) {
     msg->post();
 }
 
+void NuPlayer::DecoderBase::setSource(const sp<Source> &source) {
+    sp<AMessage> msg = new AMessage(kWhatSetSource, this);
+    msg->setObject("source", source);
+    msg->post();
+}
+
 status_t NuPlayer::DecoderBase::getInputBuffers(Vector<sp<ABuffer> > *buffers) const {
     sp<AMessage> msg = new AMessage(kWhatGetInputBuffers, this);
     msg->setPointer("buffers", buffers);
@@ -147,6 +154,14 @@ void NuPlayer::DecoderBase::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatSetSource:
+        {
+            sp<RefBase> obj;
+            CHECK(msg->findObject("source", &obj));
+            onSetSource(static_cast<Source *>(obj.get()));
+            break;
+        }
+
         case kWhatGetInputBuffers:
         {
             sp<AReplyToken> replyID;
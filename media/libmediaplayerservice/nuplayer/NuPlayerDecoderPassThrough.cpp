@@ -34,10 +34,14 @@
 
 namespace android {
 
-// TODO optimize buffer size for power consumption
+// Used when the offload sink does not report its buffer size.
 // The offload read buffer size is 32 KB but 24 KB uses less power.
 static const size_t kAggregateBufferSizeBytes = 24 * 1024;
+static const size_t kMaxAggregateBufferSizeBytes = 256 * 1024;
+// Cache up to kMaxCachedDurationUs of compressed audio, within these bounds.
+static const int64_t kMaxCachedDurationUs = 4000000ll;
 static const size_t kMaxCachedBytes = 200000;
+static const size_t kMaxCachedBytesLimit = 2 * 1024 * 1024;
 
 NuPlayer::DecoderPassThrough::DecoderPassThrough(
         const sp<AMessage> &notify,
@@ -52,6 +56,9 @@ NuPlayer::DecoderPassThrough::DecoderPassThrough(
       mPendingAudioErr(OK),
       mPendingBuffersToDrain(0),
       mCachedBytes(0),
+      mAggregateBufferSizeBytes(kAggregateBufferSizeBytes),
+      mMaxCachedBytes(kMaxCachedBytes),
+      mRefillCachedBytes(kMaxCachedBytes),
       mComponentName("pass through decoder") {
     ALOGW_IF(renderer == NULL, "expect a non-NULL renderer");
 }
@@ -66,22 +73,61 @@ void NuPlayer::DecoderPassThrough::onConfigure(const sp<AMessage> &format) {
     mReachedEOS = false;
     ++mBufferGeneration;
 
-    onRequestInputBuffers();
-
     int32_t hasVideo = 0;
     format->findInt32("has-video", &hasVideo);
 
     // The audio sink is already opened before the PassThrough decoder is created.
     // Opening again might be relevant if decoder is instantiated after shutdown and
     // format is different.
+    size_t sinkBufferSize = 0;
     status_t err = mRenderer->openAudioSink(
             format, true /* offloadOnly */, hasVideo,
-            AUDIO_OUTPUT_FLAG_NONE /* flags */, NULL /* isOffloaded */);
+            AUDIO_OUTPUT_FLAG_NONE /* flags */, NULL /* isOffloaded */,
+            &sinkBufferSize);
+    updateAggregation(format, sinkBufferSize);
+
+    onRequestInputBuffers();
+
     if (err != OK) {
         handleError(err);
     }
 }
 
+void NuPlayer::DecoderPassThrough::updateAggregation(
+        const sp<AMessage> &format, size_t sinkBufferSize) {
+    // Hand the sink one aggregate buffer per refill callback, so the
+    // renderer only wakes up when the offload HAL drains its buffer.
+    mAggregateBufferSizeBytes = kAggregateBufferSizeBytes;
+    if (sinkBufferSize > mAggregateBufferSizeBytes) {
+        mAggregateBufferSizeBytes = sinkBufferSize;
+    }
+    if (mAggregateBufferSizeBytes > kMaxAggregateBufferSizeBytes) {
+        mAggregateBufferSizeBytes = kMaxAggregateBufferSizeBytes;
+    }
+
+    mMaxCachedBytes = kMaxCachedBytes;
+    int32_t bitRate;
+    if (format->findInt32("bit-rate", &bitRate) && bitRate > 0) {
+        mMaxCachedBytes = bitRate * kMaxCachedDurationUs / 8000000ll;
+        if (mMaxCachedBytes < kMaxCachedBytes) {
+            mMaxCachedBytes = kMaxCachedBytes;
+        } else if (mMaxCachedBytes > kMaxCachedBytesLimit) {
+            mMaxCachedBytes = kMaxCachedBytesLimit;
+        }
+    }
+    if (mMaxCachedBytes < 4 * mAggregateBufferSizeBytes) {
+        mMaxCachedBytes = 4 * mAggregateBufferSizeBytes;
+    }
+
+    // Refill in bursts once the cache has drained to a quarter, rather
+    // than fetching again after every consumed buffer.
+    mRefillCachedBytes = mMaxCachedBytes / 4;
+
+    ALOGV("[%s] aggregate %zu bytes, cache %zu bytes, refill at %zu bytes",
+            mComponentName.c_str(), mAggregateBufferSizeBytes,
+            mMaxCachedBytes, mRefillCachedBytes);
+}
+
 void NuPlayer::DecoderPassThrough::onSetParameters(const sp<AMessage> &/*params*/) {
     ALOGW("onSetParameters() called unexpectedly");
 }
@@ -93,6 +139,10 @@ void NuPlayer::DecoderPassThrough::onSetRenderer(
             "ignoring request to change renderer");
 }
 
+void NuPlayer::DecoderPassThrough::onSetSource(const sp<Source> &source) {
+    mSource = source;
+}
+
 void NuPlayer::DecoderPassThrough::onGetInputBuffers(
         Vector<sp<ABuffer> > * /* dstBuffers */) {
     ALOGE("onGetInputBuffers() called unexpectedly");
@@ -108,7 +158,7 @@ bool NuPlayer::DecoderPassThrough::isDoneFetching() const {
     ALOGV("[%s] mCachedBytes = %zu, mReachedEOS = %d mPaused = %d",
             mComponentName.c_str(), mCachedBytes, mReachedEOS, mPaused);
 
-    return mCachedBytes >= kMaxCachedBytes || mReachedEOS || mPaused;
+    return mCachedBytes >= mMaxCachedBytes || mReachedEOS || mPaused;
 }
 
 /*
@@ -173,9 +223,9 @@ sp<ABuffer> NuPlayer::DecoderPassThrough::aggregateBuffer(
     size_t smallSize = accessUnit->size();
     if ((mAggregateBuffer == NULL)
             // Don't bother if only room for a few small buffers.
-            && (smallSize < (kAggregateBufferSizeBytes / 3))) {
+            && (smallSize < (mAggregateBufferSizeBytes / 3))) {
         // Create a larger buffer for combining smaller buffers from the extractor.
-        mAggregateBuffer = new ABuffer(kAggregateBufferSizeBytes);
+        mAggregateBuffer = new ABuffer(mAggregateBufferSizeBytes);
         mAggregateBuffer->setRange(0, 0); // start empty
     }
 
@@ -351,7 +401,9 @@ void NuPlayer::DecoderPassThrough::onBufferConsumed(int32_t size) {
     mCachedBytes -= size;
     ALOGV("onBufferConsumed: #ToDrain = %zu, cachedBytes = %zu",
             mPendingBuffersToDrain, mCachedBytes);
-    onRequestInputBuffers();
+    if (mCachedBytes <= mRefillCachedBytes) {
+        onRequestInputBuffers();
+    }
 }
 
 void NuPlayer::DecoderPassThrough::onResume(bool notifyComplete) {
@@ -38,6 +38,7 @@ protected:
     virtual void onConfigure(const sp<AMessage> &format);
     virtual void onSetParameters(const sp<AMessage> &params);
     virtual void onSetRenderer(const sp<Renderer> &renderer);
+    virtual void onSetSource(const sp<Source> &source);
     virtual void onGetInputBuffers(Vector<sp<ABuffer> > *dstBuffers);
     virtual void onResume(bool notifyComplete);
     virtual void onFlush();
@@ -66,10 +67,16 @@ private:
     // when the power investigation is done.
     size_t  mPendingBuffersToDrain;
     size_t  mCachedBytes;
+
+    // Sized from the offload sink and the stream bitrate in onConfigure().
+    size_t  mAggregateBufferSizeBytes;
+    size_t  mMaxCachedBytes;
+    size_t  mRefillCachedBytes;
     AString mComponentName;
 
     bool isStaleReply(const sp<AMessage> &msg);
     bool isDoneFetching() const;
+    void updateAggregation(const sp<AMessage> &format, size_t sinkBufferSize);
 
     status_t dequeueAccessUnit(sp<ABuffer> *accessUnit);
     sp<ABuffer> aggregateBuffer(const sp<ABuffer> &accessUnit);
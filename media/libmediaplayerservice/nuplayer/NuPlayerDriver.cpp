@@ -156,6 +156,67 @@ status_t NuPlayerDriver::setDataSource(const sp<DataSource> &source) {
     return mAsyncResult;
 }
 
+status_t NuPlayerDriver::preloadNext(
+        const sp<IMediaHTTPService> &httpService,
+        const char *url,
+        const KeyedVector<String8, String8> *headers) {
+    ALOGV("preloadNext(%p) url(%s)", this, uriDebugString(url, false).c_str());
+    Mutex::Autolock autoLock(mLock);
+
+    switch (mState) {
+        case STATE_IDLE:
+        case STATE_SET_DATASOURCE_PENDING:
+        case STATE_RESET_IN_PROGRESS:
+            return INVALID_OPERATION;
+
+        default:
+            break;
+    }
+
+    return mPlayer->preloadNextAsync(httpService, url, headers);
+}
+
+status_t NuPlayerDriver::preloadNext(int fd, int64_t offset, int64_t length) {
+    ALOGV("preloadNext(%p) file(%d)", this, fd);
+    Mutex::Autolock autoLock(mLock);
+
+    switch (mState) {
+        case STATE_IDLE:
+        case STATE_SET_DATASOURCE_PENDING:
+        case STATE_RESET_IN_PROGRESS:
+            return INVALID_OPERATION;
+
+        default:
+            break;
+    }
+
+    return mPlayer->preloadNextAsync(fd, offset, length);
+}
+
+status_t NuPlayerDriver::switchToNext() {
+    ALOGD("switchToNext(%p)", this);
+    Mutex::Autolock autoLock(mLock);
+
+    switch (mState) {
+        case STATE_PREPARED:
+        case STATE_RUNNING:
+        case STATE_PAUSED:
+        case STATE_STOPPED_AND_PREPARED:
+            break;
+
+        default:
+            return INVALID_OPERATION;
+    }
+
+    // The next stream starts from its beginning.
+    mAtEOS = false;
+    mPositionUs = 0;
+
+    mPlayer->switchToNextAsync();
+
+    return OK;
+}
+
 status_t NuPlayerDriver::setVideoSurfaceTexture(
         const sp<IGraphicBufferProducer> &bufferProducer) {
     ALOGV("setVideoSurfaceTexture(%p)", this);
@@ -711,6 +772,31 @@ status_t NuPlayerDriver::dump(
                      (double)(numFramesTotal - numFramesDropped-numFramesInputDropped)
                      /(mDurationUs/1000000));
             logString.append(buf);
+
+            int64_t early, onTime, late, afterDue, droppedLate;
+            if (stats->findInt64("frames-released-early", &early)
+                    && stats->findInt64("frames-released-on-time", &onTime)
+                    && stats->findInt64("frames-released-late", &late)
+                    && stats->findInt64("frames-released-after-due", &afterDue)
+                    && stats->findInt64("frames-dropped-late", &droppedLate)) {
+                snprintf(buf, sizeof(buf), "    released early(%lld), on time(%lld), "
+                         "late(%lld), after due(%lld), dropped late(%lld)\n",
+                         (long long)early, (long long)onTime, (long long)late,
+                         (long long)afterDue, (long long)droppedLate);
+                logString.append(buf);
+
+                AString cadence("    vsyncs per frame:");
+                for (size_t i = 1; ; ++i) {
+                    int64_t numFrames;
+                    if (!stats->findInt64(
+                            AStringPrintf("frames-held-%zu-vsyncs", i).c_str(), &numFrames)) {
+                        break;
+                    }
+                    cadence.append(AStringPrintf(" %zu(%lld)", i, (long long)numFrames));
+                }
+                cadence.append("\n");
+                logString.append(cadence);
+            }
         }
     }
 
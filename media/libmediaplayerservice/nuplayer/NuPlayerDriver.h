@@ -64,6 +64,17 @@ struct NuPlayerDriver : public MediaPlayerInterface {
     virtual status_t setParameter(int key, const Parcel &request);
     virtual status_t getParameter(int key, Parcel *reply);
 
+    // Prepares the next stream in the background while the current one keeps
+    // playing, for switchToNext() to change over to it without a reset.
+    status_t preloadNext(
+            const sp<IMediaHTTPService> &httpService,
+            const char *url,
+            const KeyedVector<String8, String8> *headers);
+
+    status_t preloadNext(int fd, int64_t offset, int64_t length);
+
+    status_t switchToNext();
+
     virtual status_t getMetadata(
             const media::Metadata::Filter& ids, Parcel *records);
 
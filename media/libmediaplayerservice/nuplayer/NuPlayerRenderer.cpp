@@ -20,6 +20,7 @@
 #include <utils/Log.h>
 
 #include "NuPlayerRenderer.h"
+#include <cutils/atomic.h>
 #include <cutils/properties.h>
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
@@ -121,6 +122,18 @@ NuPlayer::Renderer::Renderer(
       mTotalBuffersQueued(0),
       mLastAudioBufferDrained(0),
       mUseAudioCallback(false),
+      mAudioRingRead(0),
+      mAudioRingWrite(0),
+      mAudioRingGeneration(0),
+      mAudioRingFull(0),
+      mUseAudioRing(false),
+      mAudioRingPendingGeneration(0),
+      mAudioRingOffset(0),
+      mAudioRingFirstMediaTimeUs(-1),
+      mAudioRingFramesWritten(0),
+      mAudioRingDataDelivered(false),
+      mAudioRingEOS(false),
+      mAudioRingFinalResult(OK),
       mWakeLock(new AWakeLock()) {
     mMediaClock = new MediaClock;
     mPlaybackRate = mPlaybackSettings.mSpeed;
@@ -341,6 +354,14 @@ void NuPlayer::Renderer::setVideoLateByUs(int64_t lateUs) {
     mVideoLateByUs = lateUs;
 }
 
+void NuPlayer::Renderer::getVideoFrameStats(const sp<AMessage> &stats) {
+    sp<AMessage> msg = new AMessage(kWhatGetVideoFrameStats, this);
+    msg->setMessage("stats", stats);
+
+    sp<AMessage> response;
+    msg->postAndAwaitResponse(&response);
+}
+
 int64_t NuPlayer::Renderer::getVideoLateByUs() {
     Mutex::Autolock autoLock(mLock);
     return mVideoLateByUs;
@@ -351,7 +372,8 @@ status_t NuPlayer::Renderer::openAudioSink(
         bool offloadOnly,
         bool hasVideo,
         uint32_t flags,
-        bool *isOffloaded) {
+        bool *isOffloaded,
+        size_t *sinkBufferSize) {
     sp<AMessage> msg = new AMessage(kWhatOpenAudioSink, this);
     msg->setMessage("format", format);
     msg->setInt32("offload-only", offloadOnly);
@@ -369,6 +391,11 @@ status_t NuPlayer::Renderer::openAudioSink(
         CHECK(response->findInt32("offload", &offload));
         *isOffloaded = (offload != 0);
     }
+    if (sinkBufferSize != NULL) {
+        int32_t size;
+        *sinkBufferSize = (err == OK && response->findInt32("sink-buffer-size", &size))
+                ? (size_t)size : 0;
+    }
     return err;
 }
 
@@ -400,6 +427,12 @@ void NuPlayer::Renderer::onMessageReceived(const sp<AMessage> &msg) {
             sp<AMessage> response = new AMessage;
             response->setInt32("err", err);
             response->setInt32("offload", offloadingAudio());
+            if (err == OK) {
+                ssize_t sinkBufferSize = mAudioSink->bufferSize();
+                if (sinkBufferSize > 0) {
+                    response->setInt32("sink-buffer-size", sinkBufferSize);
+                }
+            }
 
             sp<AReplyToken> replyID;
             CHECK(msg->senderAwaitsResponse(&replyID));
@@ -426,6 +459,13 @@ void NuPlayer::Renderer::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatFeedAudioRing:
+        {
+            Mutex::Autolock autoLock(mLock);
+            feedAudioRing_l();
+            break;
+        }
+
         case kWhatDrainAudioQueue:
         {
             mDrainAudioQueuePending = false;
@@ -600,6 +640,21 @@ void NuPlayer::Renderer::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatGetVideoFrameStats:
+        {
+            sp<AReplyToken> replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+
+            sp<AMessage> stats;
+            CHECK(msg->findMessage("stats", &stats));
+            if (mVideoScheduler != NULL) {
+                mVideoScheduler->getStats(stats);
+            }
+
+            (new AMessage)->postReply(replyID);
+            break;
+        }
+
         case kWhatAudioTearDown:
         {
             onAudioTearDown(kDueToError);
@@ -626,6 +681,11 @@ void NuPlayer::Renderer::onMessageReceived(const sp<AMessage> &msg) {
 }
 
 void NuPlayer::Renderer::postDrainAudioQueue_l(int64_t delayUs) {
+    if (mUseAudioRing) {
+        feedAudioRing_l();
+        return;
+    }
+
     if (mDrainAudioQueuePending || mSyncQueues || mUseAudioCallback) {
         return;
     }
@@ -705,6 +765,11 @@ size_t NuPlayer::Renderer::AudioSinkCallback(
 }
 
 size_t NuPlayer::Renderer::fillAudioBuffer(void *buffer, size_t size) {
+    // mUseAudioRing only changes while the AudioSink is closed.
+    if (mUseAudioRing) {
+        return fillAudioBufferFromRing(buffer, size);
+    }
+
     Mutex::Autolock autoLock(mLock);
 
     if (!mUseAudioCallback) {
@@ -787,6 +852,203 @@ size_t NuPlayer::Renderer::fillAudioBuffer(void *buffer, size_t size) {
     return sizeCopied;
 }
 
+size_t NuPlayer::Renderer::fillAudioBufferFromRing(void *buffer, size_t size) {
+    const int32_t generation = android_atomic_acquire_load(&mAudioRingGeneration);
+    if (generation != mAudioRingPendingGeneration) {
+        // flushed, anything not accounted for yet is obsolete
+        mAudioRingPendingGeneration = generation;
+        mAudioRingFirstMediaTimeUs = -1;
+        mAudioRingFramesWritten = 0;
+        mAudioRingDataDelivered = false;
+        mAudioRingEOS = false;
+    }
+
+    uint32_t read = mAudioRingRead;
+    const uint32_t write = android_atomic_acquire_load(&mAudioRingWrite);
+
+    size_t sizeCopied = 0;
+    bool firstEntry = true;
+    while (sizeCopied < size && read != write) {
+        AudioRingEntry *ringEntry = &mAudioRing[read % kAudioRingSize];
+        QueueEntry *entry = &ringEntry->mEntry;
+
+        bool consumed = true;
+        bool hasEOS = false;
+        if (ringEntry->mGeneration != generation) {
+            // queued before a flush, drop it
+        } else if (entry->mBuffer == NULL) {
+            hasEOS = true;
+            mAudioRingEOS = true;
+            mAudioRingFinalResult = entry->mFinalResult;
+        } else {
+            if (mAudioRingOffset < entry->mOffset) {
+                mAudioRingOffset = entry->mOffset;
+            }
+            if (firstEntry && mAudioRingOffset == 0 && mAudioRingFirstMediaTimeUs < 0) {
+                CHECK(entry->mBuffer->meta()->findInt64(
+                        "timeUs", &mAudioRingFirstMediaTimeUs));
+            }
+            firstEntry = false;
+
+            size_t copy = entry->mBuffer->size() - mAudioRingOffset;
+            size_t sizeRemaining = size - sizeCopied;
+            if (copy > sizeRemaining) {
+                copy = sizeRemaining;
+            }
+
+            memcpy((char *)buffer + sizeCopied,
+                   entry->mBuffer->data() + mAudioRingOffset,
+                   copy);
+
+            mAudioRingOffset += copy;
+            sizeCopied += copy;
+            mAudioRingDataDelivered = true;
+            consumed = (mAudioRingOffset == entry->mBuffer->size());
+        }
+
+        if (!consumed) {
+            break;
+        }
+
+        if (entry->mBuffer != NULL) {
+            entry->mNotifyConsumed->post();
+        }
+        entry->mBuffer.clear();
+        entry->mNotifyConsumed.clear();
+        mAudioRingOffset = 0;
+
+        android_atomic_release_store(++read, &mAudioRingRead);
+        if (android_atomic_acquire_load(&mAudioRingFull)
+                && android_atomic_release_cas(1, 0, &mAudioRingFull) == 0) {
+            (new AMessage(kWhatFeedAudioRing, this))->post();
+        }
+
+        if (hasEOS) {
+            break;
+        }
+    }
+
+    mAudioRingFramesWritten += sizeCopied / mAudioSink->frameSize();
+
+    // Bring the renderer state up to date only if that doesn't mean waiting
+    // for the looper, otherwise try again on the next callback.
+    if (mLock.tryLock() != NO_ERROR) {
+        return sizeCopied;
+    }
+
+    // flushes bump the generation with mLock held
+    if (generation == mAudioRingGeneration) {
+        if (mAudioRingFirstMediaTimeUs >= 0) {
+            ALOGV("fillAudioBufferFromRing: rendering audio at media time %.2f secs",
+                    mAudioRingFirstMediaTimeUs / 1E6);
+            setAudioFirstAnchorTimeIfNeeded_l(mAudioRingFirstMediaTimeUs);
+            mAudioRingFirstMediaTimeUs = -1;
+        }
+
+        if (mAudioRingDataDelivered) {
+            notifyIfMediaRenderingStarted_l();
+            mAudioRingDataDelivered = false;
+        }
+
+        mNumFramesWritten += mAudioRingFramesWritten;
+        mAudioRingFramesWritten = 0;
+
+        if (mAudioFirstAnchorTimeMediaUs >= 0) {
+            int64_t nowUs = ALooper::GetNowUs();
+            int64_t nowMediaUs =
+                mAudioFirstAnchorTimeMediaUs + getPlayedOutAudioDurationUs(nowUs);
+            mMediaClock->updateAnchor(nowMediaUs, nowUs, INT64_MAX);
+        }
+
+        if (mAudioRingEOS) {
+            mAudioRingEOS = false;
+            (new AMessage(kWhatStopAudioSink, this))->post();
+
+            int64_t postEOSDelayUs = 0;
+            if (mAudioSink->needsTrailingPadding()) {
+                postEOSDelayUs = getPendingAudioPlayoutDurationUs(ALooper::GetNowUs());
+            }
+            ALOGV("fillAudioBufferFromRing: notifyEOS "
+                    "mNumFramesWritten:%u  finalResult:%d  postEOSDelay:%lld",
+                    mNumFramesWritten, mAudioRingFinalResult, (long long)postEOSDelayUs);
+            notifyEOS(true /* audio */, mAudioRingFinalResult, postEOSDelayUs);
+        }
+    }
+
+    mLock.unlock();
+    return sizeCopied;
+}
+
+void NuPlayer::Renderer::feedAudioRing_l() {
+    if (mSyncQueues) {
+        return;
+    }
+
+    while (!mAudioQueue.empty()) {
+        const uint32_t write = mAudioRingWrite;
+        if (write - (uint32_t)android_atomic_acquire_load(&mAudioRingRead)
+                >= kAudioRingSize) {
+            // Ask the callback thread to post kWhatFeedAudioRing, then check
+            // again in case it freed a slot before seeing the request.
+            android_atomic_release_store(1, &mAudioRingFull);
+            if (write - (uint32_t)android_atomic_acquire_load(&mAudioRingRead)
+                    >= kAudioRingSize) {
+                return;
+            }
+        }
+
+        AudioRingEntry *ringEntry = &mAudioRing[write % kAudioRingSize];
+        ringEntry->mEntry = *mAudioQueue.begin();
+        ringEntry->mGeneration = mAudioRingGeneration;
+        android_atomic_release_store(write + 1, &mAudioRingWrite);
+
+        mAudioQueue.erase(mAudioQueue.begin());
+    }
+}
+
+// Called once the AudioSink is closed and its callback thread is gone.
+// Unplayed entries go back to the front of mAudioQueue.
+void NuPlayer::Renderer::reclaimAudioRing() {
+    Mutex::Autolock autoLock(mLock);
+    if (!mUseAudioRing) {
+        return;
+    }
+    mUseAudioRing = false;
+
+    List<QueueEntry>::iterator head = mAudioQueue.begin();
+    if (mAudioRingEOS && mAudioRingPendingGeneration == mAudioRingGeneration) {
+        // consumed, but not reported yet
+        QueueEntry entry;
+        entry.mOffset = 0;
+        entry.mFinalResult = mAudioRingFinalResult;
+        mAudioQueue.insert(head, entry);
+    }
+
+    for (uint32_t read = mAudioRingRead; read != (uint32_t)mAudioRingWrite; ++read) {
+        AudioRingEntry *ringEntry = &mAudioRing[read % kAudioRingSize];
+        QueueEntry *entry = &ringEntry->mEntry;
+        if (ringEntry->mGeneration == mAudioRingGeneration) {
+            if (read == (uint32_t)mAudioRingRead && mAudioRingOffset > entry->mOffset) {
+                entry->mOffset = mAudioRingOffset;
+            }
+            mAudioQueue.insert(head, *entry);
+        } else if (entry->mBuffer != NULL) {
+            entry->mNotifyConsumed->post();
+        }
+        entry->mBuffer.clear();
+        entry->mNotifyConsumed.clear();
+    }
+
+    mAudioRingRead = mAudioRingWrite;
+    mAudioRingFull = 0;
+    mAudioRingPendingGeneration = mAudioRingGeneration;
+    mAudioRingOffset = 0;
+    mAudioRingFirstMediaTimeUs = -1;
+    mAudioRingFramesWritten = 0;
+    mAudioRingDataDelivered = false;
+    mAudioRingEOS = false;
+}
+
 void NuPlayer::Renderer::drainAudioQueueUntilLastEOS() {
     List<QueueEntry>::iterator it = mAudioQueue.begin(), itEOS = it;
     bool foundEOS = false;
@@ -1125,6 +1387,14 @@ void NuPlayer::Renderer::onDrainVideoQueue() {
         setVideoLateByUs(nowUs - realTimeUs);
         tooLate = (mVideoLateByUs > 40000);
 
+        if (mVideoScheduler != NULL) {
+            if (tooLate) {
+                mVideoScheduler->onFrameDropped();
+            } else {
+                mVideoScheduler->onFrameReleased(realTimeUs * 1000ll, nowUs * 1000ll);
+            }
+        }
+
         if (tooLate) {
             ALOGV("video late by %lld us (%.2f secs)",
                  (long long)mVideoLateByUs, mVideoLateByUs / 1E6);
@@ -1344,6 +1614,7 @@ void NuPlayer::Renderer::onFlush(const sp<AMessage> &msg) {
         {
             Mutex::Autolock autoLock(mLock);
             flushQueue(&mAudioQueue);
+            android_atomic_inc(&mAudioRingGeneration);
 
             ++mAudioDrainGeneration;
             prepareForMediaRenderingStart_l();
@@ -1729,6 +2000,7 @@ status_t NuPlayer::Renderer::onOpenAudioSink(
             offloadFlags &= ~AUDIO_OUTPUT_FLAG_DEEP_BUFFER;
             audioSinkChanged = true;
             mAudioSink->close();
+            reclaimAudioRing();
 
             err = mAudioSink->open(
                     sampleRate,
@@ -1790,6 +2062,7 @@ status_t NuPlayer::Renderer::onOpenAudioSink(
 
         audioSinkChanged = true;
         mAudioSink->close();
+        reclaimAudioRing();
         mCurrentOffloadInfo = AUDIO_INFO_INITIALIZER;
         // Note: It is possible to set up the callback, but not use it to send audio data.
         // This requires a fix in AudioSink to explicitly specify the transfer mode.
@@ -1797,6 +2070,10 @@ status_t NuPlayer::Renderer::onOpenAudioSink(
         if (mUseAudioCallback) {
             ++mAudioDrainGeneration;  // discard pending kWhatDrainAudioQueue message.
         }
+        {
+            Mutex::Autolock autoLock(mLock);
+            mUseAudioRing = mUseAudioCallback;
+        }
 
         // Compute the desired buffer size.
         // For callback mode, the amount of time before wakeup is about half the buffer size.
@@ -1827,10 +2104,15 @@ status_t NuPlayer::Renderer::onOpenAudioSink(
         if (err != OK) {
             ALOGW("openAudioSink: non offloaded open failed status: %d", err);
             mAudioSink->close();
+            reclaimAudioRing();
             mCurrentPcmInfo = AUDIO_PCMINFO_INITIALIZER;
             return err;
         }
         mCurrentPcmInfo = info;
+        if (mUseAudioRing) {
+            Mutex::Autolock autoLock(mLock);
+            feedAudioRing_l();
+        }
         if (!mPaused) { // for preview mode, don't start if paused
             mAudioSink->start();
         }
@@ -1844,6 +2126,7 @@ status_t NuPlayer::Renderer::onOpenAudioSink(
 
 void NuPlayer::Renderer::onCloseAudioSink() {
     mAudioSink->close();
+    reclaimAudioRing();
     mCurrentOffloadInfo = AUDIO_INFO_INITIALIZER;
     mCurrentPcmInfo = AUDIO_PCMINFO_INITIALIZER;
 }
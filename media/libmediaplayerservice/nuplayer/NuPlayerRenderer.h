@@ -74,12 +74,16 @@ struct NuPlayer::Renderer : public AHandler {
     status_t getCurrentPosition(int64_t *mediaUs);
     int64_t getVideoLateByUs();
 
+    // adds video frame release and cadence statistics to stats
+    void getVideoFrameStats(const sp<AMessage> &stats);
+
     status_t openAudioSink(
             const sp<AMessage> &format,
             bool offloadOnly,
             bool hasVideo,
             uint32_t flags,
-            bool *isOffloaded);
+            bool *isOffloaded,
+            size_t *sinkBufferSize = NULL);
     void closeAudioSink();
 
     enum {
@@ -122,6 +126,8 @@ private:
         kWhatDisableOffloadAudio = 'noOA',
         kWhatEnableOffloadAudio  = 'enOA',
         kWhatSetVideoFrameRate   = 'sVFR',
+        kWhatGetVideoFrameStats  = 'gVFS',
+        kWhatFeedAudioRing       = 'fdAR',
     };
 
     struct QueueEntry {
@@ -200,6 +206,35 @@ private:
     int32_t mLastAudioBufferDrained;
     bool mUseAudioCallback;
 
+    // In PCM callback mode the AudioSink callback thread pulls audio from a
+    // single producer/single consumer ring instead of mAudioQueue, so that
+    // it never waits for mLock while copying data. The renderer looper
+    // moves entries from mAudioQueue into the ring; entries queued before
+    // the last flush carry an old generation and are skipped.
+    enum {
+        kAudioRingSize = 64,
+    };
+    struct AudioRingEntry {
+        QueueEntry mEntry;
+        int32_t mGeneration;
+    };
+    AudioRingEntry mAudioRing[kAudioRingSize];
+    volatile int32_t mAudioRingRead;        // advanced by the callback thread
+    volatile int32_t mAudioRingWrite;       // advanced by the renderer looper
+    volatile int32_t mAudioRingGeneration;  // bumped by the looper on flush
+    volatile int32_t mAudioRingFull;        // looper waits for free slots
+    bool mUseAudioRing;
+
+    // Owned by the callback thread. Updates to the renderer state are
+    // only made when mLock is free, until then they are kept here.
+    int32_t mAudioRingPendingGeneration;
+    size_t mAudioRingOffset;
+    int64_t mAudioRingFirstMediaTimeUs;
+    uint32_t mAudioRingFramesWritten;
+    bool mAudioRingDataDelivered;
+    bool mAudioRingEOS;
+    status_t mAudioRingFinalResult;
+
     sp<AWakeLock> mWakeLock;
 
     status_t getCurrentPositionOnLooper(int64_t *mediaUs);
@@ -210,6 +245,9 @@ private:
             int64_t *mediaUs, int64_t nowUs, bool allowPastQueuedVideo = false);
 
     size_t fillAudioBuffer(void *buffer, size_t size);
+    size_t fillAudioBufferFromRing(void *buffer, size_t size);
+    void feedAudioRing_l();
+    void reclaimAudioRing();
 
     bool onDrainAudioQueue();
     void drainAudioQueueUntilLastEOS();
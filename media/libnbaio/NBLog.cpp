@@ -30,23 +30,6 @@
 
 namespace android {
 
-int NBLog::Entry::readAt(size_t offset) const
-{
-    // FIXME This is too slow, despite the name it is used during writing
-    if (offset == 0)
-        return mEvent;
-    else if (offset == 1)
-        return mLength;
-    else if (offset < (size_t) (mLength + 2))
-        return ((char *) mData)[offset - 2];
-    else if (offset == (size_t) (mLength + 2))
-        return mLength;
-    else
-        return 0;
-}
-
-// ---------------------------------------------------------------------------
-
 #if 0   // FIXME see note in NBLog.h
 NBLog::Timeline::Timeline(size_t size, void *shared)
     : mSize(roundup(size)), mOwn(shared == NULL),
@@ -147,6 +130,101 @@ void NBLog::Writer::logTimestamp(const struct timespec& ts)
     log(EVENT_TIMESTAMP, &ts, sizeof(struct timespec));
 }
 
+void NBLog::Writer::logFormat(const char *fmt, ...)
+{
+    if (!mEnabled) {
+        return;
+    }
+    va_list ap;
+    va_start(ap, fmt);
+    Writer::logVFormat(fmt, ap);    // the Writer:: is needed to avoid virtual dispatch
+    va_end(ap);
+}
+
+void NBLog::Writer::logVFormat(const char *fmt, va_list ap)
+{
+    if (!mEnabled) {
+        return;
+    }
+    size_t length = strlen(fmt);
+    if (length > 255) {
+        length = 255;
+    }
+    log(EVENT_START_FMT, fmt, length);
+    Writer::logTimestamp();
+
+    // log each argument according to its conversion, the Reader parses the format the same way
+    for (const char *p = fmt; *p != '\0'; ) {
+        if (*p++ != '%') {
+            continue;
+        }
+        if (*p == '%') {
+            p++;
+            continue;
+        }
+        while (*p != '\0' && strchr("-+ #0123456789.", *p) != NULL) {
+            p++;
+        }
+        int longs = 0;
+        bool sizeT = false;
+        for (;; p++) {
+            if (*p == 'l') {
+                longs++;
+            } else if (*p == 'j') {
+                longs = 2;
+            } else if (*p == 'z' || *p == 't') {
+                sizeT = true;
+            } else if (*p != 'h') {
+                break;
+            }
+        }
+        const char conv = *p;
+        if (conv == '\0') {
+            break;
+        }
+        p++;
+        int64_t integer;
+        double value;
+        switch (conv) {
+        case 'd':
+        case 'i':
+        case 'c':
+            integer = longs >= 2 ? va_arg(ap, long long) : longs == 1 ? va_arg(ap, long) :
+                    sizeT ? va_arg(ap, ssize_t) : va_arg(ap, int);
+            log(EVENT_INTEGER, &integer, sizeof(integer));
+            continue;
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            integer = longs >= 2 ? va_arg(ap, unsigned long long) :
+                    longs == 1 ? va_arg(ap, unsigned long) :
+                    sizeT ? va_arg(ap, size_t) : va_arg(ap, unsigned);
+            log(EVENT_INTEGER, &integer, sizeof(integer));
+            continue;
+        case 'f':
+        case 'e':
+        case 'g':
+        case 'a':
+        case 'E':
+        case 'G':
+        case 'A':
+            value = va_arg(ap, double);
+            log(EVENT_FLOAT, &value, sizeof(value));
+            continue;
+        case 's': {
+            const char *string = va_arg(ap, const char *);
+            Writer::log(string != NULL ? string : "(null)");
+            } continue;
+        default:
+            // '*' or an unsupported conversion: the type of the next argument is unknown
+            break;
+        }
+        break;
+    }
+    log(EVENT_END_FMT, fmt, 0);
+}
+
 void NBLog::Writer::log(Event event, const void *data, size_t length)
 {
     if (!mEnabled) {
@@ -158,6 +236,10 @@ void NBLog::Writer::log(Event event, const void *data, size_t length)
     switch (event) {
     case EVENT_STRING:
     case EVENT_TIMESTAMP:
+    case EVENT_START_FMT:
+    case EVENT_INTEGER:
+    case EVENT_FLOAT:
+    case EVENT_END_FMT:
         break;
     case EVENT_RESERVED:
     default:
@@ -176,23 +258,22 @@ void NBLog::Writer::log(const NBLog::Entry *entry, bool trusted)
         log(entry->mEvent, entry->mData, entry->mLength);
         return;
     }
+    // serialize the Entry: mEvent, mLength, data[length], mLength
+    uint8_t temp[255 + 3];
+    size_t need = entry->mLength + 3;   // need = number of bytes remaining to write
+    temp[0] = entry->mEvent;
+    temp[1] = entry->mLength;
+    memcpy(&temp[2], entry->mData, entry->mLength);
+    temp[entry->mLength + 2] = entry->mLength;
+
     size_t rear = mRear & (mSize - 1);
     size_t written = mSize - rear;      // written = number of bytes that have been written so far
-    size_t need = entry->mLength + 3;   // mEvent, mLength, data[length], mLength
-                                        // need = number of bytes remaining to write
     if (written > need) {
         written = need;
     }
-    size_t i;
-    // FIXME optimize this using memcpy for the data part of the Entry.
-    // The Entry could have a method copyTo(ptr, offset, size) to optimize the copy.
-    for (i = 0; i < written; ++i) {
-        mShared->mBuffer[rear + i] = entry->readAt(i);
-    }
+    memcpy(&mShared->mBuffer[rear], temp, written);
     if (rear + written == mSize && (need -= written) > 0)  {
-        for (i = 0; i < need; ++i) {
-            mShared->mBuffer[i] = entry->readAt(written + i);
-        }
+        memcpy(mShared->mBuffer, &temp[written], need);
         written += need;
     }
     android_atomic_release_store(mRear += written, &mShared->mRear);
@@ -258,6 +339,21 @@ void NBLog::LockedWriter::logTimestamp(const struct timespec& ts)
     Writer::logTimestamp(ts);
 }
 
+void NBLog::LockedWriter::logFormat(const char *fmt, ...)
+{
+    Mutex::Autolock _l(mLock);
+    va_list ap;
+    va_start(ap, fmt);
+    Writer::logVFormat(fmt, ap);
+    va_end(ap);
+}
+
+void NBLog::LockedWriter::logVFormat(const char *fmt, va_list ap)
+{
+    Mutex::Autolock _l(mLock);
+    Writer::logVFormat(fmt, ap);
+}
+
 bool NBLog::LockedWriter::isEnabled() const
 {
     Mutex::Autolock _l(mLock);
@@ -416,6 +512,19 @@ void NBLog::Reader::dump(int fd, size_t indent)
                     (int) (ts.tv_nsec / 1000000));
             deferredTimestamp = true;
             } break;
+        case EVENT_START_FMT:
+            if (deferredTimestamp) {
+                dumpLine(timestamp, body);
+                deferredTimestamp = false;
+            }
+            i = dumpFormat(copy, i, avail, timestamp, body);
+            advance = 0;
+            break;
+        case EVENT_INTEGER:
+        case EVENT_FLOAT:
+        case EVENT_END_FMT:
+            // rest of a logFormat() record whose start was lost
+            break;
         case EVENT_RESERVED:
         default:
             body.appendFormat("warning: unknown event %d", event);
@@ -445,6 +554,121 @@ void NBLog::Reader::dumpLine(const String8& timestamp, String8& body)
     body.clear();
 }
 
+size_t NBLog::Reader::dumpFormat(const uint8_t *copy, size_t i, size_t avail,
+        String8& timestamp, String8& body)
+{
+    // copy[i] is an EVENT_START_FMT, and all entries up to avail have been checked by dump()
+    String8 fmt((const char *) &copy[i + 2], copy[i + 1]);
+    i += copy[i + 1] + 3;
+    if (i < avail && (Event) copy[i] == EVENT_TIMESTAMP &&
+            copy[i + 1] == sizeof(struct timespec)) {
+        struct timespec ts;
+        memcpy(&ts, &copy[i + 2], sizeof(struct timespec));
+        timestamp.clear();
+        timestamp.appendFormat("[%d.%03d]", (int) ts.tv_sec, (int) (ts.tv_nsec / 1000000));
+        i += sizeof(struct timespec) + 3;
+    }
+
+    // Parse the format like Writer::logVFormat(). The format comes from another process, so
+    // only conversion specifications made of known characters are handed to appendFormat().
+    const char *p = fmt.string();
+    while (*p != '\0') {
+        const char *percent = strchr(p, '%');
+        if (percent == NULL) {
+            body.append(p);
+            break;
+        }
+        body.append(p, percent - p);
+        p = percent + 1;
+        if (*p == '%') {
+            body.append("%");
+            p++;
+            continue;
+        }
+        while (*p != '\0' && strchr("-+ #0123456789.", *p) != NULL) {
+            p++;
+        }
+        String8 spec(percent, p - percent);
+        while (*p != '\0' && strchr("hljzt", *p) != NULL) {
+            p++;
+        }
+        const char conv = *p;
+        if (conv == '\0') {
+            break;
+        }
+        p++;
+        if (i >= avail || (Event) copy[i] == EVENT_END_FMT) {
+            body.appendFormat("<missing %%%c>", conv);
+            continue;
+        }
+        const Event event = (Event) copy[i];
+        const size_t length = copy[i + 1];
+        const uint8_t *data = &copy[i + 2];
+        i += length + 3;
+        bool valid = false;
+        switch (conv) {
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+        case 'c':
+            if (event == EVENT_INTEGER && length == sizeof(int64_t)) {
+                int64_t integer;
+                memcpy(&integer, data, sizeof(integer));
+                if (conv == 'c') {
+                    spec.append("c");
+                    body.appendFormat(spec.string(), (int) integer);
+                } else {
+                    spec.appendFormat("ll%c", conv);
+                    body.appendFormat(spec.string(), (long long) integer);
+                }
+                valid = true;
+            }
+            break;
+        case 'f':
+        case 'e':
+        case 'g':
+        case 'a':
+        case 'E':
+        case 'G':
+        case 'A':
+            if (event == EVENT_FLOAT && length == sizeof(double)) {
+                double value;
+                memcpy(&value, data, sizeof(value));
+                spec.appendFormat("%c", conv);
+                body.appendFormat(spec.string(), value);
+                valid = true;
+            }
+            break;
+        case 's':
+            if (event == EVENT_STRING) {
+                String8 string((const char *) data, length);
+                spec.append("s");
+                body.appendFormat(spec.string(), string.string());
+                valid = true;
+            }
+            break;
+        default:
+            break;
+        }
+        if (!valid) {
+            body.appendFormat("<bad %%%c>", conv);
+        }
+    }
+
+    // skip any remaining arguments
+    while (i < avail) {
+        const Event event = (Event) copy[i];
+        i += copy[i + 1] + 3;
+        if (event == EVENT_END_FMT) {
+            break;
+        }
+    }
+    return i;
+}
+
 bool NBLog::Reader::isIMemory(const sp<IMemory>& iMemory) const
 {
     return iMemory != 0 && mIMemory != 0 && iMemory->pointer() == mIMemory->pointer();
@@ -29,7 +29,8 @@ PipeReader::PipeReader(Pipe& pipe) :
         // any data already in the pipe is not visible to this PipeReader
         mFront(android_atomic_acquire_load(&pipe.mRear)),
         mFramesOverrun(0),
-        mOverruns(0)
+        mOverruns(0),
+        mUnderruns(0)
 {
     android_atomic_inc(&pipe.mReaders);
 }
@@ -63,6 +64,9 @@ ssize_t PipeReader::read(void *buffer, size_t count, int64_t readPTS __unused)
 {
     ssize_t avail = availableToRead();
     if (CC_UNLIKELY(avail <= 0)) {
+        if (avail == 0 && count > 0) {
+            ++mUnderruns;
+        }
         return avail;
     }
     // An overrun can occur from here on and be silently ignored,
@@ -92,4 +96,40 @@ ssize_t PipeReader::read(void *buffer, size_t count, int64_t readPTS __unused)
     return red;
 }
 
+ssize_t PipeReader::readVia(readVia_t via, size_t total, void *user,
+                            int64_t readPTS, size_t block __unused)
+{
+    ssize_t avail = availableToRead();
+    if (CC_UNLIKELY(avail <= 0)) {
+        if (avail == 0 && total > 0) {
+            ++mUnderruns;
+        }
+        return avail;
+    }
+    if (CC_LIKELY(total > (size_t) avail)) {
+        total = avail;
+    }
+    // As for read(), an overrun while the callback is consuming the frames goes undetected
+    size_t accumulator = 0;
+    while (accumulator < total) {
+        size_t front = mFront & (mPipe.mMaxFrames - 1);
+        size_t count = mPipe.mMaxFrames - front;
+        if (count > total - accumulator) {
+            count = total - accumulator;
+        }
+        ssize_t ret = via(user, (char *) mPipe.mBuffer + (front * mFrameSize), count, readPTS);
+        if (ret <= 0) {
+            return accumulator > 0 ? accumulator : ret;
+        }
+        ALOG_ASSERT((size_t) ret <= count);
+        mFront += ret;
+        mFramesRead += ret;
+        accumulator += ret;
+        if ((size_t) ret < count) {
+            break;
+        }
+    }
+    return accumulator;
+}
+
 }   // namespace android
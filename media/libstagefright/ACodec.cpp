@@ -821,6 +821,17 @@ status_t ACodec::allocateBuffersOnPort(OMX_U32 portIndex) {
             size_t totalSize = def.nBufferCountActual * bufSize;
             mDealer[portIndex] = new MemoryDealer(totalSize, "ACodec");
 
+            uint32_t requiresAllocateBufferBit =
+                (portIndex == kPortIndexInput)
+                    ? OMXCodec::kRequiresAllocateBufferOnInputPorts
+                    : OMXCodec::kRequiresAllocateBufferOnOutputPorts;
+
+            // Components with the allocate-buffer quirk get a backup buffer that is copied
+            // to and from on every buffer. Most of them take our shared memory just fine, so
+            // only fall back to the copies if the component rejects the first useBuffer.
+            bool useBackup = false;
+            bool probeUseBuffer = (mQuirks & requiresAllocateBufferBit) != 0;
+
             for (OMX_U32 i = 0; i < def.nBufferCountActual && err == OK; ++i) {
                 sp<IMemory> mem = mDealer[portIndex]->allocate(bufSize);
                 if (mem == NULL || mem->pointer() == NULL) {
@@ -832,11 +843,6 @@ status_t ACodec::allocateBuffersOnPort(OMX_U32 portIndex) {
                 info.mFenceFd = -1;
                 info.mRenderInfo = NULL;
 
-                uint32_t requiresAllocateBufferBit =
-                    (portIndex == kPortIndexInput)
-                        ? OMXCodec::kRequiresAllocateBufferOnInputPorts
-                        : OMXCodec::kRequiresAllocateBufferOnOutputPorts;
-
                 if ((portIndex == kPortIndexInput && (mFlags & kFlagIsSecure))
                         || (portIndex == kPortIndexOutput && usingMetadataOnEncoderOutput())) {
                     mem.clear();
@@ -847,12 +853,21 @@ status_t ACodec::allocateBuffersOnPort(OMX_U32 portIndex) {
                             &ptr);
 
                     info.mData = new ABuffer(ptr, bufSize);
-                } else if (mQuirks & requiresAllocateBufferBit) {
+                } else if (useBackup) {
                     err = mOMX->allocateBufferWithBackup(
                             mNode, portIndex, mem, &info.mBufferID, allottedSize);
                 } else {
                     err = mOMX->useBuffer(mNode, portIndex, mem, &info.mBufferID, allottedSize);
+                    if (err != OK && probeUseBuffer) {
+                        ALOGI("[%s] useBuffer failed on %s port (%d), using backup buffers",
+                                mComponentName.c_str(),
+                                portIndex == kPortIndexInput ? "input" : "output", err);
+                        useBackup = true;
+                        err = mOMX->allocateBufferWithBackup(
+                                mNode, portIndex, mem, &info.mBufferID, allottedSize);
+                    }
                 }
+                probeUseBuffer = false;
 
                 if (mem != NULL) {
                     info.mData = new ABuffer(mem->pointer(), bufSize);
@@ -1974,9 +1989,14 @@ status_t ACodec::configureCodec(
     }
 
     if (video) {
-        // determine need for software renderer
+        // determine need for software renderer, software decoders supporting native buffers
+        // write their frames straight into the buffers of the native window
         bool usingSwRenderer = false;
-        if (haveNativeWindow && mComponentName.startsWith("OMX.google.")) {
+        OMX_INDEXTYPE nativeBuffersIndex;
+        if (haveNativeWindow && mComponentName.startsWith("OMX.google.")
+                && mOMX->getExtensionIndex(
+                        mNode, "OMX.google.android.index.enableAndroidNativeBuffers",
+                        &nativeBuffersIndex) != OK) {
             usingSwRenderer = true;
             haveNativeWindow = false;
         }
@@ -6248,6 +6268,7 @@ void ACodec::LoadedState::stateEntered() {
 
 void ACodec::LoadedState::onShutdown(bool keepComponentAllocated) {
     if (!keepComponentAllocated) {
+        mCodec->mRenderTracker.dumpStats();
         (void)mCodec->mOMX->freeNode(mCodec->mNode);
 
         mCodec->changeState(mCodec->mUninitializedState);
@@ -105,8 +105,9 @@ status_t AVIExtractor::AVISource::start(MetaData *params) {
 
     mBufferGroup = new MediaBufferGroup;
 
-    mBufferGroup->add_buffer(new MediaBuffer(mTrack.mMaxSampleSize));
-    mBufferGroup->add_buffer(new MediaBuffer(mTrack.mMaxSampleSize));
+    // room for the chunk header, which is read along with the payload
+    mBufferGroup->add_buffer(new MediaBuffer(mTrack.mMaxSampleSize + 8));
+    mBufferGroup->add_buffer(new MediaBuffer(mTrack.mMaxSampleSize + 8));
     mSampleIndex = 0;
 
     const char *mime;
@@ -185,13 +186,26 @@ status_t AVIExtractor::AVISource::read(
         MediaBuffer *out;
         CHECK_EQ(mBufferGroup->acquire_buffer(&out), (status_t)OK);
 
-        ssize_t n = mExtractor->mDataSource->readAt(offset, out->data(), size);
+        // Read the chunk header along with the payload and check it against
+        // the index.
+        uint8_t *data = (uint8_t *)out->data();
+        ssize_t n = mExtractor->readSampleData(offset - 8, data, size + 8);
 
-        if (n < (ssize_t)size) {
+        if (n < (ssize_t)size + 8) {
+            out->release();
             return n < 0 ? (status_t)n : (status_t)ERROR_MALFORMED;
         }
 
-        out->set_range(0, size);
+        uint32_t chunkType = U32_AT(data);
+        size_t chunkSize = U32LE_AT(&data[4]);
+
+        if (!IsCorrectChunkType(mTrackIndex, mTrack.mKind, chunkType)
+                || chunkSize > size) {
+            out->release();
+            return ERROR_MALFORMED;
+        }
+
+        out->set_range(8, chunkSize);
 
         out->meta_data()->setInt64(kKeyTime, timeUs);
 
@@ -366,7 +380,8 @@ status_t AVIExtractor::MP3Splitter::read(MediaBuffer **out) {
 ////////////////////////////////////////////////////////////////////////////////
 
 AVIExtractor::AVIExtractor(const sp<DataSource> &dataSource)
-    : mDataSource(dataSource) {
+    : mDataSource(dataSource),
+      mReadAheadOffset(0) {
     mInitCheck = parseHeaders();
 
     if (mInitCheck != OK) {
@@ -405,6 +420,7 @@ status_t AVIExtractor::parseHeaders() {
     mMovieOffset = 0;
     mFoundIndex = false;
     mOffsetsAreAbsolute = false;
+    mUseSuperIndex = false;
 
     ssize_t res = parseChunk(0ll, -1ll);
 
@@ -412,11 +428,31 @@ status_t AVIExtractor::parseHeaders() {
         return (status_t)res;
     }
 
-    if (mMovieOffset == 0ll || !mFoundIndex) {
+    if (mMovieOffset == 0ll) {
         return ERROR_MALFORMED;
     }
 
-    return OK;
+    // OpenDML files index all of their RIFF segments in the streams' super
+    // indexes, idx1 (if present) only covers the first one.
+    if (hasSuperIndexes()) {
+        mUseSuperIndex = true;
+
+        for (size_t i = 0; i < mTracks.size(); ++i) {
+            status_t err = parseSuperIndex(i);
+
+            if (err != OK) {
+                return err;
+            }
+        }
+
+        mFoundIndex = true;
+    }
+
+    if (!mFoundIndex) {
+        return ERROR_MALFORMED;
+    }
+
+    return finishIndex();
 }
 
 ssize_t AVIExtractor::parseChunk(off64_t offset, off64_t size, int depth) {
@@ -509,6 +545,29 @@ ssize_t AVIExtractor::parseChunk(off64_t offset, off64_t size, int depth) {
                 break;
             }
 
+            case FOURCC('i', 'n', 'd', 'x'):
+            {
+                // Only super indexes (AVI_INDEX_OF_INDEXES) are used, any
+                // other index falls back to idx1.
+                uint8_t header[24];
+                if (mTracks.isEmpty() || chunkSize < sizeof(header)) {
+                    break;
+                }
+
+                n = mDataSource->readAt(offset + 8, header, sizeof(header));
+
+                if (n < (ssize_t)sizeof(header)) {
+                    return (n < 0) ? n : (ssize_t)ERROR_MALFORMED;
+                }
+
+                if (U16LE_AT(header) == 4 && header[2] == 0 && header[3] == 0) {
+                    Track *track = &mTracks.editItemAt(mTracks.size() - 1);
+                    track->mSuperIndexOffset = offset + 8;
+                    track->mSuperIndexSize = chunkSize;
+                }
+                break;
+            }
+
             case FOURCC('i', 'd', 'x', '1'):
             {
                 err = parseIndex(offset + 8, chunkSize);
@@ -652,6 +711,10 @@ status_t AVIExtractor::parseStreamHeader(off64_t offset, size_t size) {
     Track *track = &mTracks.editItemAt(mTracks.size() - 1);
 
     track->mMeta = meta;
+    track->mLoadedIndexChunk = -1;
+    track->mNumSamples = 0;
+    track->mSuperIndexOffset = 0;
+    track->mSuperIndexSize = 0;
     track->mRate = rate;
     track->mScale = scale;
     track->mBytesPerSample = sampleSize;
@@ -764,93 +827,122 @@ bool AVIExtractor::IsCorrectChunkType(
     return true;
 }
 
+// Index entries are read in blocks of this size, not all at once.
+static const size_t kIndexBlockSize = 4096 * 16;
+
+bool AVIExtractor::hasSuperIndexes() const {
+    bool found = false;
+    for (size_t i = 0; i < mTracks.size(); ++i) {
+        const Track &track = mTracks.itemAt(i);
+
+        if (track.mKind == Track::OTHER) {
+            continue;
+        }
+
+        if (track.mSuperIndexOffset == 0) {
+            return false;
+        }
+        found = true;
+    }
+    return found;
+}
+
+void AVIExtractor::updateSampleStats(
+        Track *track, size_t sampleIndex, const SampleInfo &info) {
+    if (info.mSize > track->mMaxSampleSize) {
+        track->mMaxSampleSize = info.mSize;
+    }
+
+    if (info.mIsKey) {
+        static const size_t kMaxNumSyncSamplesToScan = 20;
+
+        if (track->mNumSyncSamples < kMaxNumSyncSamplesToScan) {
+            if (info.mSize > track->mThumbnailSampleSize) {
+                track->mThumbnailSampleSize = info.mSize;
+
+                track->mThumbnailSampleIndex = sampleIndex;
+            }
+        }
+
+        ++track->mNumSyncSamples;
+    }
+}
+
 status_t AVIExtractor::parseIndex(off64_t offset, size_t size) {
     if ((size % 16) != 0) {
         return ERROR_MALFORMED;
     }
 
-    sp<ABuffer> buffer = new ABuffer(size);
-    ssize_t n = mDataSource->readAt(offset, buffer->data(), buffer->size());
-
-    if (n < (ssize_t)size) {
-        return n < 0 ? (status_t)n : ERROR_MALFORMED;
+    if (hasSuperIndexes()) {
+        ALOGV("Using the OpenDML index instead of idx1");
+        return OK;
     }
 
-    const uint8_t *data = buffer->data();
+    sp<ABuffer> buffer = new ABuffer(size < kIndexBlockSize ? size : kIndexBlockSize);
 
     while (size > 0) {
-        uint32_t chunkType = U32_AT(data);
-
-        uint8_t hi = chunkType >> 24;
-        uint8_t lo = (chunkType >> 16) & 0xff;
+        size_t blockSize = size < kIndexBlockSize ? size : kIndexBlockSize;
+        ssize_t n = mDataSource->readAt(offset, buffer->data(), blockSize);
 
-        if (hi < '0' || hi > '9' || lo < '0' || lo > '9') {
-            return ERROR_MALFORMED;
+        if (n < (ssize_t)blockSize) {
+            return n < 0 ? (status_t)n : ERROR_MALFORMED;
         }
 
-        size_t trackIndex = 10 * (hi - '0') + (lo - '0');
-
-        if (trackIndex >= mTracks.size()) {
-            return ERROR_MALFORMED;
-        }
+        offset += blockSize;
+        size -= blockSize;
 
-        Track *track = &mTracks.editItemAt(trackIndex);
+        const uint8_t *data = buffer->data();
 
-        if (!IsCorrectChunkType(-1, track->mKind, chunkType)) {
-            return ERROR_MALFORMED;
-        }
+        for (; blockSize > 0; data += 16, blockSize -= 16) {
+            uint32_t chunkType = U32_AT(data);
 
-        if (track->mKind == Track::OTHER) {
-            data += 16;
-            size -= 16;
-            continue;
-        }
+            uint8_t hi = chunkType >> 24;
+            uint8_t lo = (chunkType >> 16) & 0xff;
 
-        uint32_t flags = U32LE_AT(&data[4]);
-        uint32_t offset = U32LE_AT(&data[8]);
-        uint32_t chunkSize = U32LE_AT(&data[12]);
+            if (hi < '0' || hi > '9' || lo < '0' || lo > '9') {
+                return ERROR_MALFORMED;
+            }
 
-        if (chunkSize > track->mMaxSampleSize) {
-            track->mMaxSampleSize = chunkSize;
-        }
+            size_t trackIndex = 10 * (hi - '0') + (lo - '0');
 
-        track->mSamples.push();
+            if (trackIndex >= mTracks.size()) {
+                return ERROR_MALFORMED;
+            }
 
-        SampleInfo *info =
-            &track->mSamples.editItemAt(track->mSamples.size() - 1);
+            Track *track = &mTracks.editItemAt(trackIndex);
 
-        info->mOffset = offset;
-        info->mIsKey = (flags & 0x10) != 0;
+            if (!IsCorrectChunkType(-1, track->mKind, chunkType)) {
+                return ERROR_MALFORMED;
+            }
 
-        if (info->mIsKey) {
-            static const size_t kMaxNumSyncSamplesToScan = 20;
+            if (track->mKind == Track::OTHER) {
+                continue;
+            }
 
-            if (track->mNumSyncSamples < kMaxNumSyncSamplesToScan) {
-                if (chunkSize > track->mThumbnailSampleSize) {
-                    track->mThumbnailSampleSize = chunkSize;
+            uint32_t flags = U32LE_AT(&data[4]);
+            uint32_t chunkOffset = U32LE_AT(&data[8]);
+            uint32_t chunkSize = U32LE_AT(&data[12]);
 
-                    track->mThumbnailSampleIndex =
-                        track->mSamples.size() - 1;
-                }
+            if (chunkSize > 0x7fffffff) {
+                return ERROR_MALFORMED;
             }
 
-            ++track->mNumSyncSamples;
-        }
+            SampleInfo info;
+            info.mOffset = chunkOffset;
+            info.mSize = chunkSize;
+            info.mIsKey = (flags & 0x10) != 0;
 
-        data += 16;
-        size -= 16;
+            track->mSamples.push(info);
+            updateSampleStats(track, track->mNumSamples++, info);
+        }
     }
 
     if (!mTracks.isEmpty()) {
-        off64_t offset;
-        size_t size;
-        bool isKey;
-        int64_t timeUs;
-        status_t err = getSampleInfo(0, 0, &offset, &size, &isKey, &timeUs);
+        status_t err = checkChunkHeader(0, 0);
 
         if (err != OK) {
             mOffsetsAreAbsolute = !mOffsetsAreAbsolute;
-            err = getSampleInfo(0, 0, &offset, &size, &isKey, &timeUs);
+            err = checkChunkHeader(0, 0);
 
             if (err != OK) {
                 return err;
@@ -861,6 +953,251 @@ status_t AVIExtractor::parseIndex(off64_t offset, size_t size) {
              mOffsetsAreAbsolute ? "absolute" : "movie-chunk relative");
     }
 
+    mFoundIndex = true;
+
+    return OK;
+}
+
+status_t AVIExtractor::parseSuperIndex(size_t trackIndex) {
+    Track *track = &mTracks.editItemAt(trackIndex);
+
+    if (track->mKind == Track::OTHER) {
+        return OK;
+    }
+
+    uint8_t header[24];
+    ssize_t n = mDataSource->readAt(track->mSuperIndexOffset, header, sizeof(header));
+
+    if (n < (ssize_t)sizeof(header)) {
+        return n < 0 ? (status_t)n : ERROR_MALFORMED;
+    }
+
+    size_t numEntries = U32LE_AT(&header[4]);
+
+    if (numEntries > (track->mSuperIndexSize - sizeof(header)) / 16) {
+        return ERROR_MALFORMED;
+    }
+
+    sp<ABuffer> entries = new ABuffer(numEntries * 16);
+    n = mDataSource->readAt(
+            track->mSuperIndexOffset + sizeof(header), entries->data(), entries->size());
+
+    if (n < (ssize_t)entries->size()) {
+        return n < 0 ? (status_t)n : ERROR_MALFORMED;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+
+    for (size_t i = 0; i < numEntries; ++i) {
+        const uint8_t *entry = entries->data() + i * 16;
+        off64_t chunkOffset = U64LE_AT(entry);
+
+        // 'ix##' chunk header followed by an AVISTDINDEX header
+        uint8_t chunkHeader[32];
+        n = mDataSource->readAt(chunkOffset, chunkHeader, sizeof(chunkHeader));
+
+        if (n < (ssize_t)sizeof(chunkHeader)) {
+            return n < 0 ? (status_t)n : ERROR_MALFORMED;
+        }
+
+        uint32_t chunkSize = U32LE_AT(&chunkHeader[4]);
+        size_t numSamples = U32LE_AT(&chunkHeader[12]);
+
+        if (U16LE_AT(&chunkHeader[8]) != 2     // wLongsPerEntry
+                || chunkHeader[10] != 0        // bIndexSubType, no fields
+                || chunkHeader[11] != 1        // bIndexType, AVI_INDEX_OF_CHUNKS
+                || chunkSize < 24
+                || numSamples > (chunkSize - 24) / 8) {
+            return ERROR_MALFORMED;
+        }
+
+        IndexChunk chunk;
+        chunk.mOffset = chunkOffset + sizeof(chunkHeader);
+        chunk.mBaseOffset = U64LE_AT(&chunkHeader[20]);
+        chunk.mFirstSample = track->mNumSamples;
+        chunk.mNumSamples = numSamples;
+        track->mIndexChunks.push(chunk);
+
+        // Each standard index is read once now for the statistics; only the
+        // last one stays loaded.
+        status_t err = loadIndexChunk_l(track, track->mIndexChunks.size() - 1);
+
+        if (err != OK) {
+            return err;
+        }
+
+        for (size_t j = 0; j < numSamples; ++j) {
+            updateSampleStats(track, chunk.mFirstSample + j, track->mSamples.itemAt(j));
+        }
+
+        track->mNumSamples += numSamples;
+    }
+
+    return OK;
+}
+
+status_t AVIExtractor::loadIndexChunk_l(Track *track, size_t chunkIndex) {
+    const IndexChunk &chunk = track->mIndexChunks.itemAt(chunkIndex);
+
+    track->mSamples.clear();
+    track->mLoadedIndexChunk = -1;
+    track->mSamples.setCapacity(chunk.mNumSamples);
+
+    off64_t offset = chunk.mOffset;
+    size_t size = chunk.mNumSamples * 8;
+
+    sp<ABuffer> buffer = new ABuffer(size < kIndexBlockSize ? size : kIndexBlockSize);
+
+    while (size > 0) {
+        size_t blockSize = size < kIndexBlockSize ? size : kIndexBlockSize;
+        ssize_t n = mDataSource->readAt(offset, buffer->data(), blockSize);
+
+        if (n < (ssize_t)blockSize) {
+            track->mSamples.clear();
+            return n < 0 ? (status_t)n : ERROR_MALFORMED;
+        }
+
+        offset += blockSize;
+        size -= blockSize;
+
+        for (const uint8_t *data = buffer->data(); blockSize > 0; data += 8, blockSize -= 8) {
+            uint32_t sizeAndFlags = U32LE_AT(&data[4]);
+
+            SampleInfo info;
+            info.mOffset = U32LE_AT(data);
+            info.mSize = sizeAndFlags & 0x7fffffff;
+            info.mIsKey = (sizeAndFlags & 0x80000000) == 0;  // bit 31 flags delta frames
+            track->mSamples.push(info);
+        }
+    }
+
+    track->mLoadedIndexChunk = chunkIndex;
+
+    return OK;
+}
+
+status_t AVIExtractor::findSample(
+        size_t trackIndex, size_t sampleIndex,
+        SampleInfo *info, off64_t *chunkOffset) {
+    if (trackIndex >= mTracks.size()) {
+        return -ERANGE;
+    }
+
+    if (!mUseSuperIndex) {
+        const Track &track = mTracks.itemAt(trackIndex);
+
+        if (sampleIndex >= track.mSamples.size()) {
+            return -ERANGE;
+        }
+
+        *info = track.mSamples.itemAt(sampleIndex);
+
+        if (!mOffsetsAreAbsolute) {
+            *chunkOffset = info->mOffset + mMovieOffset + 8;
+        } else {
+            *chunkOffset = info->mOffset;
+        }
+
+        return OK;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+
+    Track *track = &mTracks.editItemAt(trackIndex);
+
+    if (sampleIndex >= track->mNumSamples) {
+        return -ERANGE;
+    }
+
+    size_t lo = 0;
+    size_t hi = track->mIndexChunks.size();
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (track->mIndexChunks.itemAt(mid).mFirstSample <= sampleIndex) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if ((ssize_t)lo != track->mLoadedIndexChunk) {
+        status_t err = loadIndexChunk_l(track, lo);
+
+        if (err != OK) {
+            return err;
+        }
+    }
+
+    const IndexChunk &chunk = track->mIndexChunks.itemAt(lo);
+
+    *info = track->mSamples.itemAt(sampleIndex - chunk.mFirstSample);
+
+    // standard index entries point at the chunk data, not its header
+    *chunkOffset = chunk.mBaseOffset + info->mOffset - 8;
+
+    return OK;
+}
+
+status_t AVIExtractor::checkChunkHeader(size_t trackIndex, size_t sampleIndex) {
+    SampleInfo info;
+    off64_t chunkOffset;
+    status_t err = findSample(trackIndex, sampleIndex, &info, &chunkOffset);
+
+    if (err != OK) {
+        return err;
+    }
+
+    uint8_t tmp[8];
+    ssize_t n = mDataSource->readAt(chunkOffset, tmp, 8);
+
+    if (n < 8) {
+        return n < 0 ? (status_t)n : (status_t)ERROR_MALFORMED;
+    }
+
+    if (!IsCorrectChunkType(trackIndex, mTracks.itemAt(trackIndex).mKind, U32_AT(tmp))) {
+        return ERROR_MALFORMED;
+    }
+
+    return OK;
+}
+
+ssize_t AVIExtractor::readSampleData(off64_t offset, void *data, size_t size) {
+    if (size > kMaxReadAheadRequest) {
+        return mDataSource->readAt(offset, data, size);
+    }
+
+    Mutex::Autolock autoLock(mLock);
+
+    if (mReadAhead != NULL
+            && offset >= mReadAheadOffset
+            && offset + (off64_t)size <= mReadAheadOffset + (off64_t)mReadAhead->size()) {
+        memcpy(data, mReadAhead->data() + (offset - mReadAheadOffset), size);
+        return size;
+    }
+
+    if (mReadAhead == NULL) {
+        mReadAhead = new ABuffer(kReadAheadSize);
+    }
+
+    ssize_t n = mDataSource->readAt(offset, mReadAhead->base(), kReadAheadSize);
+
+    if (n <= 0) {
+        mReadAhead->setRange(0, 0);
+        return n;
+    }
+
+    mReadAheadOffset = offset;
+    mReadAhead->setRange(0, n);
+
+    if ((size_t)n < size) {
+        size = n;
+    }
+    memcpy(data, mReadAhead->data(), size);
+
+    return size;
+}
+
+status_t AVIExtractor::finishIndex() {
     for (size_t i = 0; i < mTracks.size(); ++i) {
         Track *track = &mTracks.editItemAt(i);
 
@@ -870,7 +1207,7 @@ status_t AVIExtractor::parseIndex(off64_t offset, size_t size) {
             // Compute the avg. size of the first 128 chunks (if there are
             // that many), but exclude the size of the first one, since
             // it may be an outlier.
-            size_t numSamplesToAverage = track->mSamples.size();
+            size_t numSamplesToAverage = track->mNumSamples;
             if (numSamplesToAverage > 256) {
                 numSamplesToAverage = 256;
             }
@@ -907,7 +1244,7 @@ status_t AVIExtractor::parseIndex(off64_t offset, size_t size) {
 
         int64_t durationUs;
         CHECK_EQ((status_t)OK,
-                 getSampleTime(i, track->mSamples.size() - 1, &durationUs));
+                 getSampleTime(i, track->mNumSamples - 1, &durationUs));
 
         ALOGV("track %d duration = %.2f secs", i, durationUs / 1E6);
 
@@ -943,8 +1280,6 @@ status_t AVIExtractor::parseIndex(off64_t offset, size_t size) {
         }
     }
 
-    mFoundIndex = true;
-
     return OK;
 }
 
@@ -1105,42 +1440,18 @@ status_t AVIExtractor::getSampleInfo(
         size_t trackIndex, size_t sampleIndex,
         off64_t *offset, size_t *size, bool *isKey,
         int64_t *sampleTimeUs) {
-    if (trackIndex >= mTracks.size()) {
-        return -ERANGE;
-    }
+    SampleInfo info;
+    off64_t chunkOffset;
+    status_t err = findSample(trackIndex, sampleIndex, &info, &chunkOffset);
 
-    const Track &track = mTracks.itemAt(trackIndex);
-
-    if (sampleIndex >= track.mSamples.size()) {
-        return -ERANGE;
-    }
-
-    const SampleInfo &info = track.mSamples.itemAt(sampleIndex);
-
-    if (!mOffsetsAreAbsolute) {
-        *offset = info.mOffset + mMovieOffset + 8;
-    } else {
-        *offset = info.mOffset;
-    }
-
-    *size = 0;
-
-    uint8_t tmp[8];
-    ssize_t n = mDataSource->readAt(*offset, tmp, 8);
-
-    if (n < 8) {
-        return n < 0 ? (status_t)n : (status_t)ERROR_MALFORMED;
-    }
-
-    uint32_t chunkType = U32_AT(tmp);
-
-    if (!IsCorrectChunkType(trackIndex, track.mKind, chunkType)) {
-        return ERROR_MALFORMED;
+    if (err != OK) {
+        return err;
     }
 
-    *offset += 8;
-    *size = U32LE_AT(&tmp[4]);
+    const Track &track = mTracks.itemAt(trackIndex);
 
+    *offset = chunkOffset + 8;
+    *size = info.mSize;
     *isKey = info.mIsKey;
 
     if (track.mBytesPerSample > 0) {
@@ -1172,7 +1483,7 @@ status_t AVIExtractor::getSampleTime(
 status_t AVIExtractor::getSampleIndexAtTime(
         size_t trackIndex,
         int64_t timeUs, MediaSource::ReadOptions::SeekMode mode,
-        size_t *sampleIndex) const {
+        size_t *sampleIndex) {
     if (trackIndex >= mTracks.size()) {
         return -ERANGE;
     }
@@ -1198,7 +1509,7 @@ status_t AVIExtractor::getSampleIndexAtTime(
         closestSampleIndex = timeUs / track.mRate * track.mScale / 1000000ll;
     }
 
-    ssize_t numSamples = track.mSamples.size();
+    ssize_t numSamples = track.mNumSamples;
 
     if (closestSampleIndex < 0) {
         closestSampleIndex = 0;
@@ -1212,10 +1523,16 @@ status_t AVIExtractor::getSampleIndexAtTime(
         return OK;
     }
 
+    SampleInfo info;
+    off64_t chunkOffset;
+
     ssize_t prevSyncSampleIndex = closestSampleIndex;
     while (prevSyncSampleIndex >= 0) {
-        const SampleInfo &info =
-            track.mSamples.itemAt(prevSyncSampleIndex);
+        status_t err = findSample(trackIndex, prevSyncSampleIndex, &info, &chunkOffset);
+
+        if (err != OK) {
+            return err;
+        }
 
         if (info.mIsKey) {
             break;
@@ -1226,8 +1543,11 @@ status_t AVIExtractor::getSampleIndexAtTime(
 
     ssize_t nextSyncSampleIndex = closestSampleIndex;
     while (nextSyncSampleIndex < numSamples) {
-        const SampleInfo &info =
-            track.mSamples.itemAt(nextSyncSampleIndex);
+        status_t err = findSample(trackIndex, nextSyncSampleIndex, &info, &chunkOffset);
+
+        if (err != OK) {
+            return err;
+        }
 
         if (info.mIsKey) {
             break;
@@ -24,6 +24,7 @@ LOCAL_SRC_FILES:=                         \
         FileSource.cpp                    \
         FLACExtractor.cpp                 \
         FrameRenderTracker.cpp            \
+        FrameScanSeeker.cpp               \
         HTTPBase.cpp                      \
         JPEGSource.cpp                    \
         MP3Extractor.cpp                  \
@@ -82,9 +83,11 @@ LOCAL_C_INCLUDES:= \
         $(TOP)/external/libvpx/libwebm \
         $(TOP)/system/netd/include \
         $(TOP)/device/fsl-codec/ghdr/common \
+        $(call include-path-for, audio-utils) \
 
 
 LOCAL_SHARED_LIBRARIES := \
+        libaudioutils \
         libbinder \
         libcamera_client \
         libcutils \
@@ -51,16 +51,19 @@ static void AudioRecordCallbackFunction(int event, void *user, void *info) {
 
 AudioSource::AudioSource(
         audio_source_t inputSource, const String16 &opPackageName,
-        uint32_t sampleRate, uint32_t channelCount, uint32_t outSampleRate)
+        uint32_t sampleRate, uint32_t channelCount, uint32_t outSampleRate,
+        int64_t capturePeriodUs)
     : mStarted(false),
       mSampleRate(sampleRate),
       mOutSampleRate(outSampleRate > 0 ? outSampleRate : sampleRate),
+      mCapturePeriodUs(capturePeriodUs > 0 ? capturePeriodUs : 0),
       mPrevSampleTimeUs(0),
       mFirstSampleTimeUs(-1ll),
       mNumFramesReceived(0),
-      mNumClientOwnedBuffers(0) {
-    ALOGV("sampleRate: %u, outSampleRate: %u, channelCount: %u",
-            sampleRate, outSampleRate, channelCount);
+      mNumClientOwnedBuffers(0),
+      mMaxFreeBuffers(kMaxPooledBuffers) {
+    ALOGV("sampleRate: %u, outSampleRate: %u, channelCount: %u, capturePeriodUs: %" PRId64,
+            sampleRate, outSampleRate, channelCount, capturePeriodUs);
     CHECK(channelCount == 1 || channelCount == 2);
     CHECK(sampleRate > 0);
 
@@ -69,7 +72,35 @@ AudioSource::AudioSource(
                                            sampleRate,
                                            AUDIO_FORMAT_PCM_16_BIT,
                                            audio_channel_in_mask_from_count(channelCount));
-    if (status == OK) {
+    if (status == OK && mCapturePeriodUs > 0) {
+        // hold two capture periods, so that nothing is lost while read()
+        // sleeps through one of them
+        size_t periodFrames = (size_t)(mCapturePeriodUs * sampleRate / 1000000ll);
+        size_t frameCount = 2 * periodFrames;
+        if (frameCount < minFrameCount) {
+            frameCount = minFrameCount;
+        }
+
+        // enough buffers to pass a whole AudioRecord buffer on without
+        // allocating
+        size_t frameSize = sizeof(int16_t) * channelCount;
+        mMaxFreeBuffers = (frameCount * frameSize + kMaxBufferSize - 1) / kMaxBufferSize;
+
+        mRecord = new AudioRecord(
+                    inputSource, sampleRate, AUDIO_FORMAT_PCM_16_BIT,
+                    audio_channel_in_mask_from_count(channelCount),
+                    opPackageName,
+                    frameCount,
+                    NULL /* cbf */,
+                    NULL /* user */,
+                    0 /* notificationFrames */,
+                    AUDIO_SESSION_ALLOCATE,
+                    AudioRecord::TRANSFER_OBTAIN);
+        mInitCheck = mRecord->initCheck();
+        if (mInitCheck != OK) {
+            mRecord.clear();
+        }
+    } else if (status == OK) {
         // make sure that the AudioRecord callback never returns more than the maximum
         // buffer size
         uint32_t frameCount = kMaxBufferSize / sizeof(int16_t) / channelCount;
@@ -101,6 +132,11 @@ AudioSource::~AudioSource() {
     if (mStarted) {
         reset();
     }
+
+    while (!mFreeBuffers.empty()) {
+        (*mFreeBuffers.begin())->release();
+        mFreeBuffers.erase(mFreeBuffers.begin());
+    }
 }
 
 status_t AudioSource::initCheck() const {
@@ -141,7 +177,7 @@ void AudioSource::releaseQueuedFrames_l() {
     List<MediaBuffer *>::iterator it;
     while (!mBuffersReceived.empty()) {
         it = mBuffersReceived.begin();
-        (*it)->release();
+        recycleBuffer_l(*it);
         mBuffersReceived.erase(it);
     }
 }
@@ -184,6 +220,7 @@ sp<MetaData> AudioSource::getFormat() {
     meta->setInt32(kKeySampleRate, mSampleRate);
     meta->setInt32(kKeyChannelCount, mRecord->channelCount());
     meta->setInt32(kKeyMaxInputSize, kMaxBufferSize);
+    meta->setInt32(kKeySupportsNonBlockingRead, true);
 
     return meta;
 }
@@ -221,7 +258,7 @@ void AudioSource::rampVolume(
 }
 
 status_t AudioSource::read(
-        MediaBuffer **out, const ReadOptions * /* options */) {
+        MediaBuffer **out, const ReadOptions *options) {
     Mutex::Autolock autoLock(mLock);
     *out = NULL;
 
@@ -230,7 +267,20 @@ status_t AudioSource::read(
     }
 
     while (mStarted && mBuffersReceived.empty()) {
-        mFrameAvailableCondition.wait(mLock);
+        if (options != NULL && options->getNonBlocking()) {
+            return WOULD_BLOCK;
+        }
+        if (mCapturePeriodUs > 0) {
+            // There is no callback thread in this mode; sleep through a
+            // capture period (reset() wakes us up early), then take
+            // everything that AudioRecord collected meanwhile.
+            mFrameAvailableCondition.waitRelative(mLock, mCapturePeriodUs * 1000ll);
+            if (mStarted) {
+                captureData_l();
+            }
+        } else {
+            mFrameAvailableCondition.wait(mLock);
+        }
     }
     if (!mStarted) {
         return OK;
@@ -283,7 +333,7 @@ void AudioSource::signalBufferReturned(MediaBuffer *buffer) {
     Mutex::Autolock autoLock(mLock);
     --mNumClientOwnedBuffers;
     buffer->setObserver(0);
-    buffer->release();
+    recycleBuffer_l(buffer);
     mFrameEncodingCompletionCondition.signal();
     return;
 }
@@ -302,11 +352,69 @@ status_t AudioSource::dataCallback(const AudioRecord::Buffer& audioBuffer) {
         return OK;
     }
 
+    MediaBuffer *buffer = NULL;
+    if (audioBuffer.size > 0) {
+        buffer = acquireBuffer_l(audioBuffer.size);
+        memcpy((uint8_t *) buffer->data(),
+                audioBuffer.i16, audioBuffer.size);
+    }
+    queueCapturedData_l(buffer, timeUs, true /* checkLostFrames */);
+    return OK;
+}
+
+void AudioSource::captureData_l() {
+    int64_t nowUs = systemTime() / 1000ll;
+    const size_t frameSize = mRecord->frameSize();
+
+    List<MediaBuffer *> buffers;
+    size_t numFrames = 0;
+    for (;;) {
+        AudioRecord::Buffer audioBuffer;
+        audioBuffer.frameCount = kMaxBufferSize / frameSize;
+        status_t err = mRecord->obtainBuffer(&audioBuffer, 0 /* waitCount */);
+        if (err != OK) {
+            if (err != WOULD_BLOCK) {
+                ALOGW("obtainBuffer failed: %d", err);
+            }
+            break;
+        }
+
+        MediaBuffer *buffer = acquireBuffer_l(audioBuffer.size);
+        memcpy((uint8_t *) buffer->data(),
+                audioBuffer.i16, audioBuffer.size);
+        mRecord->releaseBuffer(&audioBuffer);
+
+        buffers.push_back(buffer);
+        numFrames += audioBuffer.frameCount;
+    }
+
+    ALOGV("captured %zu frames in %zu buffers", numFrames, buffers.size());
+
+    // What we just drained is about everything AudioRecord captured up to
+    // now, so date the buffers back from the current time. (latency()
+    // covers the whole AudioRecord buffer, which is mostly what we took.)
+    int64_t timeUs = nowUs - (int64_t)numFrames * 1000000ll / mSampleRate;
+    bool first = true;
+    for (List<MediaBuffer *>::iterator it = buffers.begin();
+            it != buffers.end(); ++it) {
+        size_t bufferFrames = (*it)->range_length() / frameSize;
+        // lost frames are only queried once per capture, it is a binder call
+        queueCapturedData_l(*it, timeUs, first /* checkLostFrames */);
+        timeUs += (int64_t)bufferFrames * 1000000ll / mSampleRate;
+        first = false;
+    }
+}
+
+void AudioSource::queueCapturedData_l(
+        MediaBuffer *buffer, int64_t timeUs, bool checkLostFrames) {
     // Drop retrieved and previously lost audio data.
     if (mNumFramesReceived == 0 && timeUs < mStartTimeUs) {
         (void) mRecord->getInputFramesLost();
         ALOGV("Drop audio data at %" PRId64 "/%" PRId64 " us", timeUs, mStartTimeUs);
-        return OK;
+        if (buffer != NULL) {
+            recycleBuffer_l(buffer);
+        }
+        return;
     }
 
     if (mNumFramesReceived == 0 && mPrevSampleTimeUs == 0) {
@@ -323,14 +431,13 @@ status_t AudioSource::dataCallback(const AudioRecord::Buffer& audioBuffer) {
     }
 
     size_t numLostBytes = 0;
-    if (mNumFramesReceived > 0) {  // Ignore earlier frame lost
+    if (checkLostFrames && mNumFramesReceived > 0) {  // Ignore earlier frame lost
         // getInputFramesLost() returns the number of lost frames.
         // Convert number of frames lost to number of bytes lost.
         numLostBytes = mRecord->getInputFramesLost() * mRecord->frameSize();
     }
 
     CHECK_EQ(numLostBytes & 1, 0u);
-    CHECK_EQ(audioBuffer.size & 1, 0u);
     if (numLostBytes > 0) {
         // Loss of audio frames should happen rarely; thus the LOGW should
         // not cause a logging spam
@@ -345,24 +452,41 @@ status_t AudioSource::dataCallback(const AudioRecord::Buffer& audioBuffer) {
         } else {
             numLostBytes = 0;
         }
-        MediaBuffer *lostAudioBuffer = new MediaBuffer(bufferSize);
+        MediaBuffer *lostAudioBuffer = acquireBuffer_l(bufferSize);
         memset(lostAudioBuffer->data(), 0, bufferSize);
-        lostAudioBuffer->set_range(0, bufferSize);
         queueInputBuffer_l(lostAudioBuffer, timeUs);
     }
 
-    if (audioBuffer.size == 0) {
+    if (buffer == NULL) {
         ALOGW("Nothing is available from AudioRecord callback buffer");
-        return OK;
+        return;
     }
 
-    const size_t bufferSize = audioBuffer.size;
-    MediaBuffer *buffer = new MediaBuffer(bufferSize);
-    memcpy((uint8_t *) buffer->data(),
-            audioBuffer.i16, audioBuffer.size);
-    buffer->set_range(0, bufferSize);
+    CHECK_EQ(buffer->range_length() & 1, 0u);
     queueInputBuffer_l(buffer, timeUs);
-    return OK;
+}
+
+MediaBuffer *AudioSource::acquireBuffer_l(size_t size) {
+    CHECK_LE(size, (size_t)kMaxBufferSize);
+
+    MediaBuffer *buffer;
+    if (!mFreeBuffers.empty()) {
+        buffer = *mFreeBuffers.begin();
+        mFreeBuffers.erase(mFreeBuffers.begin());
+        buffer->reset();
+    } else {
+        buffer = new MediaBuffer(kMaxBufferSize);
+    }
+    buffer->set_range(0, size);
+    return buffer;
+}
+
+void AudioSource::recycleBuffer_l(MediaBuffer *buffer) {
+    if (buffer->size() == kMaxBufferSize && mFreeBuffers.size() < mMaxFreeBuffers) {
+        mFreeBuffers.push_back(buffer);
+    } else {
+        buffer->release();
+    }
 }
 
 void AudioSource::queueInputBuffer_l(MediaBuffer *buffer, int64_t timeUs) {
@@ -96,7 +96,7 @@ status_t CallbackDataSource::getSize(off64_t *size) {
 }
 
 TinyCacheSource::TinyCacheSource(const sp<DataSource>& source)
-    : mSource(source), mCachedOffset(0), mCachedSize(0) {
+    : mSource(source), mCachedOffset(0), mCachedSize(0), mCacheWindow(kMinCacheSize) {
 }
 
 status_t TinyCacheSource::initCheck() const {
@@ -104,7 +104,7 @@ status_t TinyCacheSource::initCheck() const {
 }
 
 ssize_t TinyCacheSource::readAt(off64_t offset, void* data, size_t size) {
-    if (size >= kCacheSize) {
+    if (size >= mCacheWindow) {
         return mSource->readAt(offset, data, size);
     }
 
@@ -131,18 +131,26 @@ ssize_t TinyCacheSource::readAt(off64_t offset, void* data, size_t size) {
         }
     }
 
+    // Grow the read-ahead window while the reads continue where the cache
+    // ends, and fall back to the small window on any other access.
+    if (mCachedSize > 0 && offset == (off64_t) (mCachedOffset + mCachedSize)) {
+        mCacheWindow = std::min(mCacheWindow * 2, (size_t)kMaxCacheSize);
+    } else {
+        mCacheWindow = kMinCacheSize;
+    }
+
     // Fill the cache and copy to the caller.
-    const ssize_t numRead = mSource->readAt(offset, mCache, kCacheSize);
+    const ssize_t numRead = mSource->readAt(offset, mCache, mCacheWindow);
     if (numRead <= 0) {
         return numRead;
     }
-    if ((size_t)numRead > kCacheSize) {
+    if ((size_t)numRead > mCacheWindow) {
         return ERROR_OUT_OF_RANGE;
     }
 
     mCachedSize = numRead;
     mCachedOffset = offset;
-    CHECK(mCachedSize <= kCacheSize && mCachedOffset >= 0);
+    CHECK(mCachedSize <= kMaxCacheSize && mCachedOffset >= 0);
     const size_t numToReturn = std::min(size, (size_t)numRead);
     memcpy(data, mCache, numToReturn);
 
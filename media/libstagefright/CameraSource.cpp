@@ -810,20 +810,37 @@ void CameraSource::releaseOneRecordingFrame(const sp<IMemory>& frame) {
 
 void CameraSource::signalBufferReturned(MediaBuffer *buffer) {
     ALOGV("signalBufferReturned: %p", buffer->data());
+    sp<IMemory> frame;
+    {
+        Mutex::Autolock autoLock(mLock);
+        for (List<sp<IMemory> >::iterator it = mFramesBeingEncoded.begin();
+             it != mFramesBeingEncoded.end(); ++it) {
+            if ((*it)->pointer() ==  buffer->data()) {
+                frame = *it;
+                break;
+            }
+        }
+    }
+    CHECK(frame != NULL && "signalBufferReturned: bogus buffer");
+
+    // Hand the frame back to the camera without holding mLock; it is a binder
+    // call and would otherwise stall dataCallbackTimestamp() and read(). The
+    // frame stays in mFramesBeingEncoded until then so that reset() doesn't
+    // stop recording with a release still in flight.
+    releaseOneRecordingFrame(frame);
+    buffer->setObserver(0);
+    buffer->release();
+
     Mutex::Autolock autoLock(mLock);
     for (List<sp<IMemory> >::iterator it = mFramesBeingEncoded.begin();
          it != mFramesBeingEncoded.end(); ++it) {
-        if ((*it)->pointer() ==  buffer->data()) {
-            releaseOneRecordingFrame((*it));
+        if (*it == frame) {
             mFramesBeingEncoded.erase(it);
-            ++mNumFramesEncoded;
-            buffer->setObserver(0);
-            buffer->release();
-            mFrameCompleteCondition.signal();
-            return;
+            break;
         }
     }
-    CHECK(!"signalBufferReturned: bogus buffer");
+    ++mNumFramesEncoded;
+    mFrameCompleteCondition.signal();
 }
 
 status_t CameraSource::read(
@@ -876,26 +893,35 @@ status_t CameraSource::read(
 void CameraSource::dataCallbackTimestamp(int64_t timestampUs,
         int32_t msgType __unused, const sp<IMemory> &data) {
     ALOGV("dataCallbackTimestamp: timestamp %lld us, mStartTimeUs %lld", (long long)timestampUs, mStartTimeUs);
-    Mutex::Autolock autoLock(mLock);
+    bool queued;
+    {
+        Mutex::Autolock autoLock(mLock);
+        queued = queueFrameLocked(timestampUs, data);
+    }
+    if (!queued) {
+        // Dropped frames go back to the camera outside mLock, as in
+        // signalBufferReturned().
+        releaseOneRecordingFrame(data);
+    }
+}
+
+bool CameraSource::queueFrameLocked(int64_t timestampUs, const sp<IMemory> &data) {
     if (!mStarted || (mNumFramesReceived == 0 && timestampUs < mStartTimeUs)) {
         ALOGV("Drop frame at %lld/%lld us", (long long)timestampUs, (long long)mStartTimeUs);
-        releaseOneRecordingFrame(data);
-        return;
+        return false;
     }
 
     // May need to skip frame or modify timestamp. Currently implemented
     // by the subclass CameraSourceTimeLapse.
     if (skipCurrentFrame(timestampUs)) {
-        releaseOneRecordingFrame(data);
-        return;
+        return false;
     }
 
     if (mNumFramesReceived > 0) {
         if (timestampUs <= mLastFrameTimestampUs) {
             ALOGW("Dropping frame with backward timestamp %lld (last %lld)",
                     (long long)timestampUs, (long long)mLastFrameTimestampUs);
-            releaseOneRecordingFrame(data);
-            return;
+            return false;
         }
         if (timestampUs - mLastFrameTimestampUs > mGlitchDurationThresholdUs) {
             ++mNumGlitches;
@@ -912,8 +938,7 @@ void CameraSource::dataCallbackTimestamp(int64_t timestampUs,
             if (timestampUs < mStartTimeUs) {
                 // Frame was captured before recording was started
                 // Drop it without updating the statistical data.
-                releaseOneRecordingFrame(data);
-                return;
+                return false;
             }
             mStartTimeUs = timestampUs - mStartTimeUs;
             ALOGD("dataCallbackTimestamp mStartTimeUs changed to %lld", mStartTimeUs);
@@ -931,6 +956,7 @@ void CameraSource::dataCallbackTimestamp(int64_t timestampUs,
     ALOGV("initial delay: %" PRId64 ", current time stamp: %" PRId64,
         mStartTimeUs, timeUs);
     mFrameAvailableCondition.signal();
+    return true;
 }
 
 bool CameraSource::isMetaDataStoredInVideoBuffers() const {
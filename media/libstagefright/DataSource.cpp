@@ -39,6 +39,7 @@
 #include "include/FslInspector.h"
 #include <media/IMediaHTTPConnection.h>
 #include <media/IMediaHTTPService.h>
+#include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/DataSource.h>
@@ -47,6 +48,7 @@
 #include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/MediaHTTP.h>
 #include <utils/String8.h>
+#include <utils/Vector.h>
 
 #include <cutils/properties.h>
 
@@ -110,12 +112,202 @@ status_t DataSource::getSize(off64_t *size) {
     return ERROR_UNSUPPORTED;
 }
 
+ssize_t DataSource::readAtViews(
+        off64_t offset, size_t size, Vector<sp<ABuffer> > *views) {
+    sp<ABuffer> buffer = new ABuffer(size);
+    ssize_t n = readAt(offset, buffer->data(), size);
+    if (n > 0) {
+        buffer->setRange(0, n);
+        views->push(buffer);
+    }
+    return n;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 Mutex DataSource::gSnifferMutex;
 List<DataSource::SnifferFunc> DataSource::gSniffers;
 bool DataSource::gSniffersRegistered = false;
 
+// Serves the sniffers' reads of the start of a source from one buffer that is
+// read up front, so that the many small header reads of the individual
+// sniffers don't each go to the underlying source.
+struct SniffSource : public DataSource {
+    SniffSource(const sp<DataSource> &source)
+        : mSource(source) {
+    }
+
+    virtual status_t initCheck() const {
+        return mSource->initCheck();
+    }
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size) {
+        if (mHeader == NULL) {
+            mHeader = new ABuffer(kHeaderSize);
+            ssize_t n = mSource->readAt(0, mHeader->data(), kHeaderSize);
+            mHeader->setRange(0, n > 0 ? n : 0);
+        }
+
+        size_t copied = 0;
+        if (offset >= 0 && offset < (off64_t)mHeader->size()) {
+            copied = mHeader->size() - offset;
+            if (copied > size) {
+                copied = size;
+            }
+            memcpy(data, mHeader->data() + offset, copied);
+        }
+
+        if (copied == size) {
+            return copied;
+        }
+
+        ssize_t n = mSource->readAt(
+                offset + copied, (uint8_t *)data + copied, size - copied);
+        if (n < 0) {
+            return copied > 0 ? (ssize_t)copied : n;
+        }
+        return copied + n;
+    }
+
+    virtual status_t getSize(off64_t *size) {
+        return mSource->getSize(size);
+    }
+
+    virtual uint32_t flags() {
+        return mSource->flags();
+    }
+
+    virtual String8 getUri() {
+        return mSource->getUri();
+    }
+
+    virtual String8 getFileIdentity() {
+        return mSource->getFileIdentity();
+    }
+
+    virtual String8 getMIMEType() const {
+        return mSource->getMIMEType();
+    }
+
+private:
+    enum {
+        kHeaderSize = 32768,
+    };
+
+    sp<DataSource> mSource;
+    sp<ABuffer> mHeader;
+
+    DISALLOW_EVIL_CONSTRUCTORS(SniffSource);
+};
+
+// Sniffers to try first for a file extension or content type. This only
+// changes the order in which the sniffers run, a wrong hint costs nothing.
+struct SnifferHint {
+    const char *mKey;
+    DataSource::SnifferFunc mSniffer;
+};
+
+static const SnifferHint kExtensionHints[] = {
+    { "mp4",    SniffMPEG4 },
+    { "m4a",    SniffMPEG4 },
+    { "m4v",    SniffMPEG4 },
+    { "3gp",    SniffMPEG4 },
+    { "3gpp",   SniffMPEG4 },
+    { "3g2",    SniffMPEG4 },
+    { "mov",    SniffMPEG4 },
+    { "mkv",    SniffMatroska },
+    { "mka",    SniffMatroska },
+    { "webm",   SniffMatroska },
+    { "ogg",    SniffOgg },
+    { "oga",    SniffOgg },
+    { "opus",   SniffOgg },
+    { "wav",    SniffWAV },
+    { "flac",   SniffFLAC },
+    { "amr",    SniffAMR },
+    { "awb",    SniffAMR },
+    { "ts",     SniffMPEG2TS },
+    { "mp3",    SniffMP3 },
+    { "aac",    SniffAAC },
+    { "mpg",    SniffMPEG2PS },
+    { "mpeg",   SniffMPEG2PS },
+    { "mid",    SniffMidi },
+    { "midi",   SniffMidi },
+    { "xmf",    SniffMidi },
+    { "mxmf",   SniffMidi },
+    { "rtttl",  SniffMidi },
+    { "imy",    SniffMidi },
+    { "ota",    SniffMidi },
+};
+
+static const SnifferHint kMIMETypeHints[] = {
+    { "video/mp4",          SniffMPEG4 },
+    { "audio/mp4",          SniffMPEG4 },
+    { "video/webm",         SniffMatroska },
+    { "audio/webm",         SniffMatroska },
+    { "video/x-matroska",   SniffMatroska },
+    { "application/ogg",    SniffOgg },
+    { "audio/ogg",          SniffOgg },
+    { "audio/wav",          SniffWAV },
+    { "audio/x-wav",        SniffWAV },
+    { "audio/flac",         SniffFLAC },
+    { "audio/amr",          SniffAMR },
+    { "video/mp2t",         SniffMPEG2TS },
+    { "audio/mpeg",         SniffMP3 },
+    { "audio/aac",          SniffAAC },
+    { "audio/aac-adts",     SniffAAC },
+    { "audio/midi",         SniffMidi },
+};
+
+static DataSource::SnifferFunc findSnifferHint(
+        const SnifferHint *hints, size_t numHints, const char *key) {
+    for (size_t i = 0; i < numHints; ++i) {
+        if (!strcasecmp(hints[i].mKey, key)) {
+            return hints[i].mSniffer;
+        }
+    }
+    return NULL;
+}
+
+static DataSource::SnifferFunc getSnifferHint(const sp<DataSource> &source) {
+    String8 uri = source->getUri();
+    ssize_t end = uri.find("?");
+    if (end >= 0) {
+        uri.setTo(uri.string(), end);
+    }
+    const char *name = strrchr(uri.string(), '/');
+    const char *extension = strrchr(name != NULL ? name : uri.string(), '.');
+    if (extension != NULL) {
+        DataSource::SnifferFunc func = findSnifferHint(
+                kExtensionHints, sizeof(kExtensionHints) / sizeof(kExtensionHints[0]),
+                extension + 1);
+        if (func != NULL) {
+            return func;
+        }
+    }
+
+    String8 mimeType = source->getMIMEType();
+    end = mimeType.find(";");
+    if (end >= 0) {
+        mimeType.setTo(mimeType.string(), end);
+    }
+    return findSnifferHint(
+            kMIMETypeHints, sizeof(kMIMETypeHints) / sizeof(kMIMETypeHints[0]),
+            mimeType.string());
+}
+
+// The DRM sniffers report a confidence no other sniffer can beat, and they do
+// their own reads (possibly through the DRM framework), so they run first and
+// on the source itself.
+static bool isDrmSniffer(DataSource::SnifferFunc func) {
+    return func == SniffWVM || func == SniffDRM;
+}
+
+// Once a sniffer reports at least this confidence no later sniffer can report
+// a higher one for the same data: all sniffers at or above it check for magic
+// numbers that exclude each other, and everything below (MP3, AAC, FSL, ...)
+// is a weaker guess.
+static const float kMinConfidenceToStopSniffing = 0.4f;
+
 bool DataSource::sniff(
         String8 *mimeType, float *confidence, sp<AMessage> *meta) {
     *mimeType = "";
@@ -129,18 +321,54 @@ bool DataSource::sniff(
         }
     }
 
+    sp<DataSource> source = this;
+    SnifferFunc hint = getSnifferHint(source);
+
+    // Run order as indices into gSniffers: the DRM sniffers, then the hinted
+    // sniffer, then everything else in registration order.
+    Vector<SnifferFunc> sniffers;
+    Vector<size_t> order;
     for (List<SnifferFunc>::iterator it = gSniffers.begin();
          it != gSniffers.end(); ++it) {
+        sniffers.push(*it);
+    }
+    for (size_t pass = 0; pass < 3; ++pass) {
+        for (size_t i = 0; i < sniffers.size(); ++i) {
+            size_t wantedPass = isDrmSniffer(sniffers[i]) ? 0
+                    : sniffers[i] == hint ? 1 : 2;
+            if (wantedPass == pass) {
+                order.push(i);
+            }
+        }
+    }
+
+    sp<DataSource> sniffSource = new SniffSource(source);
+    size_t bestIndex = sniffers.size();
+    for (size_t i = 0; i < order.size(); ++i) {
+        size_t index = order[i];
+        SnifferFunc func = sniffers[index];
+
         String8 newMimeType;
         float newConfidence;
         sp<AMessage> newMeta;
-        if ((*it)(this, &newMimeType, &newConfidence, &newMeta)) {
-            if (newConfidence > *confidence) {
+        if ((*func)(isDrmSniffer(func) ? source : sniffSource,
+                &newMimeType, &newConfidence, &newMeta)) {
+            // on a tie the sniffer registered first wins, as if all of
+            // them had run in registration order
+            if (newConfidence > *confidence
+                    || (newConfidence == *confidence && index < bestIndex)) {
                 *mimeType = newMimeType;
                 *confidence = newConfidence;
                 *meta = newMeta;
+                bestIndex = index;
             }
         }
+
+        if (*confidence >= kMinConfidenceToStopSniffing) {
+            ALOGV("sniffing stopped after %zu of %zu sniffers",
+                    i + 1, order.size());
+            break;
+        }
     }
 
     return *confidence > 0.0;
@@ -39,16 +39,28 @@ sp<DataURISource> DataURISource::Create(const char *uri) {
     AString tmp(&uri[5], commaPos - &uri[5]);
 
     if (tmp.endsWith(";base64")) {
-        AString encoded(commaPos + 1);
-
-        // Strip CR and LF...
-        for (size_t i = encoded.size(); i-- > 0;) {
-            if (encoded.c_str()[i] == '\r' || encoded.c_str()[i] == '\n') {
-                encoded.erase(i, 1);
+        const char *encoded = commaPos + 1;
+        const size_t encodedLen = strlen(encoded);
+
+        if (strpbrk(encoded, "\r\n") == NULL) {
+            // Decode in place, without copying the payload first.
+            buffer = decodeBase64(encoded, encodedLen);
+        } else {
+            // Strip CR and LF in a single pass.
+            char *stripped = (char *)malloc(encodedLen);
+            if (stripped == NULL) {
+                return NULL;
+            }
+            size_t strippedLen = 0;
+            for (size_t i = 0; i < encodedLen; ++i) {
+                if (encoded[i] != '\r' && encoded[i] != '\n') {
+                    stripped[strippedLen++] = encoded[i];
+                }
             }
-        }
 
-        buffer = decodeBase64(encoded);
+            buffer = decodeBase64(stripped, strippedLen);
+            free(stripped);
+        }
 
         if (buffer == NULL) {
             ALOGE("Malformed base64 encoded content found.");
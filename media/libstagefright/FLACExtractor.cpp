@@ -24,6 +24,8 @@
 // libFLAC parser
 #include "FLAC/stream_decoder.h"
 
+#include <cutils/properties.h>
+#include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/DataSource.h>
 #include <media/stagefright/MediaBufferGroup.h>
@@ -31,6 +33,9 @@
 #include <media/stagefright/MetaData.h>
 #include <media/stagefright/MediaSource.h>
 #include <media/stagefright/MediaBuffer.h>
+#include <utils/List.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -144,8 +149,57 @@ private:
     // most recent error reported by libFLAC parser
     FLAC__StreamDecoderErrorStatus mErrorStatus;
 
+    // offset of the first audio frame, and the SEEKTABLE entries if any
+    off64_t mFirstFramePos;
+    Vector<FLAC__StreamMetadata_SeekPoint> mSeekTable;
+
+    // Frame-parallel decoding, enabled by media.stagefright.flac-decode-threads.
+    // The reading thread splits the stream into frames at their sync codes,
+    // decode threads each decode whole frames with their own libFLAC decoder,
+    // and the decoded frames are returned in stream order.
+    struct DecodeJob;
+    struct DecodeThread;
+    struct SeekPoints;
+
+    Vector<sp<DecodeThread> > mDecodeThreads;
+
+    Mutex mDecodeLock;
+    Condition mJobQueued;
+    Condition mJobDone;
+    // Guarded by mDecodeLock; the jobs not yet taken by a decode thread
+    List<sp<DecodeJob> > mQueuedJobs;
+    bool mStopDecoding;
+
+    // Only used by the reading thread
+    List<sp<DecodeJob> > mJobs;     // all jobs in flight, in stream order
+    sp<SeekPoints> mSeekPoints;
+    uint8_t *mSplitBuffer;
+    size_t mSplitBufferCapacity;
+    off64_t mSplitBufferPos;
+    size_t mSplitBufferSize;
+    bool mSplitBufferAtEOS;
+    off64_t mSplitPos;
+    FLAC__uint64 mSkipUntilSample;
+
+    // "fLaC" followed by a copy of STREAMINFO, fed to each decode thread's
+    // decoder before the frames
+    uint8_t mStreamHeader[4 + 4 + 34];
+
     status_t init();
     MediaBuffer *readBuffer(bool doSeek, FLAC__uint64 sample);
+    MediaBuffer *readSerialBuffer(bool doSeek, FLAC__uint64 sample);
+    bool checkFrameHeader(const FLAC__FrameHeader &header) const;
+
+    void startDecodeThreads(size_t numThreads);
+    void stopDecodeThreads();
+    MediaBuffer *readParallelBuffer();
+    MediaBuffer *seekParallel(FLAC__uint64 sample);
+    void queueDecodeJobs();
+    bool splitFrame(DecodeJob *job);
+    size_t fillSplitBuffer(off64_t pos, size_t size);
+    size_t parseFrameHeader(
+            const uint8_t *data, size_t size,
+            FLAC__uint64 *firstSample, unsigned *blockSize) const;
 
     // no copy constructor or assignment
     FLACParser(const FLACParser &);
@@ -365,6 +419,16 @@ void FLACParser::metadataCallback(const FLAC__StreamMetadata *metadata)
             mFileMetadata->setCString(kKeyAlbumArtMIME, p->mime_type);
         }
         break;
+    case FLAC__METADATA_TYPE_SEEKTABLE:
+        {
+        const FLAC__StreamMetadata_SeekTable *st = &metadata->data.seek_table;
+        for (unsigned i = 0; i < st->num_points; ++i) {
+            if (st->points[i].sample_number != FLAC__STREAM_METADATA_SEEKPOINT_PLACEHOLDER) {
+                mSeekTable.push(st->points[i]);
+            }
+        }
+        }
+        break;
     default:
         ALOGW("FLACParser::metadataCallback unexpected type %u", metadata->type);
         break;
@@ -480,6 +544,375 @@ static void copyTrespass(
     TRESPASS();
 }
 
+// Frame-parallel decoding
+
+static const size_t kMaxDecodeThreads = 8;
+// frames in flight per decode thread, so that a thread never waits for the reader
+static const size_t kJobsPerThread = 2;
+
+static const size_t kSplitBlockSize = 64 * 1024;
+static const size_t kMaxFrameHeaderSize = 16;
+// far beyond any real frame, a frame this long means sync was lost
+static const size_t kMaxFrameSize = 4 * 1024 * 1024;
+
+// Number of files whose seek points are kept around.
+static const size_t kMaxCachedSeekPoints = 8;
+
+// CRC-8 of frame headers (x^8 + x^2 + x + 1) and CRC-16 of whole frames
+// (x^16 + x^15 + x^2 + 1), both MSB first with a zero initial value.
+struct FLACCrcTables {
+    FLACCrcTables() {
+        for (unsigned i = 0; i < 256; ++i) {
+            unsigned crc8 = i;
+            unsigned crc16 = i << 8;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc8 = (crc8 << 1) ^ ((crc8 & 0x80) ? 0x07 : 0);
+                crc16 = (crc16 << 1) ^ ((crc16 & 0x8000) ? 0x8005 : 0);
+            }
+            mCrc8[i] = crc8 & 0xff;
+            mCrc16[i] = crc16 & 0xffff;
+        }
+    }
+
+    uint8_t mCrc8[256];
+    uint16_t mCrc16[256];
+};
+
+static const FLACCrcTables gCrcTables;
+
+struct FLACParser::DecodeJob : public RefBase {
+    DecodeJob()
+        : mSkipSamples(0),
+          mTimeUs(0),
+          mDone(false) {
+    }
+
+    sp<ABuffer> mFrame;         // one complete frame
+    unsigned mSkipSamples;      // leading samples to drop after a seek
+    sp<ABuffer> mOutput;        // interleaved PCM, NULL if decoding failed
+    int64_t mTimeUs;
+    bool mDone;                 // guarded by mDecodeLock
+};
+
+// Sample numbers and offsets of frames seen so far, plus the SEEKTABLE if the
+// file has one. Shared by all parsers opening the same local file, so that
+// e.g. the player reuses the frames seen by the scanner and a seek back into
+// played audio does not need to search the stream.
+struct FLACParser::SeekPoints : public RefBase {
+    static sp<SeekPoints> Get(
+            const sp<DataSource> &source, off64_t firstFramePos,
+            FLAC__uint64 spacing, bool *created);
+
+    // Records the start of a frame, unless a known one is closer than the spacing.
+    void add(FLAC__uint64 sample, off64_t offset);
+
+    // Finds the last known frame starting at or before sample.
+    bool find(FLAC__uint64 sample, FLAC__uint64 *pointSample, off64_t *offset);
+
+private:
+    struct Point {
+        FLAC__uint64 mSample;
+        off64_t mOffset;
+    };
+
+    const FLAC__uint64 mSpacing;
+
+    Mutex mLock;
+    Vector<Point> mPoints;  // sorted by sample
+
+    SeekPoints(FLAC__uint64 spacing)
+        : mSpacing(spacing) {
+    }
+
+    // index of the first point after sample
+    size_t upperBound_l(FLAC__uint64 sample) const;
+
+    SeekPoints(const SeekPoints &);
+    SeekPoints &operator=(const SeekPoints &);
+};
+
+// Process wide cache of seek points, keyed by DataSource::getFileIdentity()
+// and the first frame's offset; most recently used first.
+struct CachedSeekPoints {
+    String8 mKey;
+    sp<RefBase> mPoints;
+};
+
+static Mutex gSeekPointsLock;
+static List<CachedSeekPoints> gSeekPoints;
+
+// static
+sp<FLACParser::SeekPoints> FLACParser::SeekPoints::Get(
+        const sp<DataSource> &source, off64_t firstFramePos,
+        FLAC__uint64 spacing, bool *created)
+{
+    *created = true;
+
+    String8 identity = source->getFileIdentity();
+    if (identity.isEmpty()) {
+        return new SeekPoints(spacing);
+    }
+
+    String8 key = String8::format("%s@%lld", identity.string(), (long long)firstFramePos);
+
+    Mutex::Autolock autoLock(gSeekPointsLock);
+
+    sp<SeekPoints> points;
+    for (List<CachedSeekPoints>::iterator it = gSeekPoints.begin();
+            it != gSeekPoints.end(); ++it) {
+        if (it->mKey == key) {
+            points = static_cast<SeekPoints *>(it->mPoints.get());
+            gSeekPoints.erase(it);
+            *created = false;
+            break;
+        }
+    }
+
+    if (points == NULL) {
+        points = new SeekPoints(spacing);
+    }
+
+    CachedSeekPoints entry;
+    entry.mKey = key;
+    entry.mPoints = points;
+    gSeekPoints.push_front(entry);
+    while (gSeekPoints.size() > kMaxCachedSeekPoints) {
+        gSeekPoints.erase(--gSeekPoints.end());
+    }
+
+    return points;
+}
+
+size_t FLACParser::SeekPoints::upperBound_l(FLAC__uint64 sample) const
+{
+    size_t lo = 0;
+    size_t hi = mPoints.size();
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (mPoints.itemAt(mid).mSample <= sample) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+void FLACParser::SeekPoints::add(FLAC__uint64 sample, off64_t offset)
+{
+    Mutex::Autolock autoLock(mLock);
+
+    size_t index = upperBound_l(sample);
+    if (index > 0 && sample - mPoints.itemAt(index - 1).mSample < mSpacing) {
+        return;
+    }
+    if (index < mPoints.size() && mPoints.itemAt(index).mSample - sample < mSpacing) {
+        return;
+    }
+
+    Point point;
+    point.mSample = sample;
+    point.mOffset = offset;
+    mPoints.insertAt(point, index);
+}
+
+bool FLACParser::SeekPoints::find(
+        FLAC__uint64 sample, FLAC__uint64 *pointSample, off64_t *offset)
+{
+    Mutex::Autolock autoLock(mLock);
+
+    size_t index = upperBound_l(sample);
+    if (index == 0) {
+        return false;
+    }
+
+    const Point &point = mPoints.itemAt(index - 1);
+    *pointSample = point.mSample;
+    *offset = point.mOffset;
+    return true;
+}
+
+// Decodes single frames handed over by the reading thread. Its decoder is
+// first fed the stream header, so that it knows the STREAMINFO, and then the
+// bytes of exactly one frame per job.
+struct FLACParser::DecodeThread : public Thread {
+    DecodeThread(FLACParser *parser);
+
+    status_t init();
+
+protected:
+    virtual ~DecodeThread();
+
+private:
+    FLACParser *mParser;
+    FLAC__StreamDecoder *mDecoder;
+
+    const uint8_t *mInput;
+    size_t mInputSize;
+    sp<DecodeJob> mJob;
+    bool mWritten;
+
+    virtual bool threadLoop();
+    void decode(const sp<DecodeJob> &job);
+
+    static FLAC__StreamDecoderReadStatus read_callback(
+            const FLAC__StreamDecoder *decoder,
+            FLAC__byte buffer[], size_t *bytes,
+            void *client_data);
+    static FLAC__StreamDecoderWriteStatus write_callback(
+            const FLAC__StreamDecoder *decoder,
+            const FLAC__Frame *frame, const FLAC__int32 * const buffer[],
+            void *client_data);
+    static void error_callback(
+            const FLAC__StreamDecoder *decoder,
+            FLAC__StreamDecoderErrorStatus status,
+            void *client_data);
+
+    DecodeThread(const DecodeThread &);
+    DecodeThread &operator=(const DecodeThread &);
+};
+
+FLACParser::DecodeThread::DecodeThread(FLACParser *parser)
+    : Thread(false /* canCallJava */),
+      mParser(parser),
+      mDecoder(NULL),
+      mInput(NULL),
+      mInputSize(0),
+      mWritten(false)
+{
+}
+
+FLACParser::DecodeThread::~DecodeThread()
+{
+    if (mDecoder != NULL) {
+        FLAC__stream_decoder_delete(mDecoder);
+        mDecoder = NULL;
+    }
+}
+
+status_t FLACParser::DecodeThread::init()
+{
+    mDecoder = FLAC__stream_decoder_new();
+    if (mDecoder == NULL) {
+        return NO_MEMORY;
+    }
+    FLAC__stream_decoder_set_md5_checking(mDecoder, false);
+    FLAC__stream_decoder_set_metadata_ignore_all(mDecoder);
+    if (FLAC__stream_decoder_init_stream(
+            mDecoder,
+            read_callback, NULL, NULL, NULL, NULL, write_callback,
+            NULL, error_callback, (void *) this)
+                    != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
+        return NO_INIT;
+    }
+    mInput = mParser->mStreamHeader;
+    mInputSize = sizeof(mParser->mStreamHeader);
+    if (!FLAC__stream_decoder_process_until_end_of_metadata(mDecoder)) {
+        return NO_INIT;
+    }
+    return OK;
+}
+
+bool FLACParser::DecodeThread::threadLoop()
+{
+    sp<DecodeJob> job;
+    {
+        Mutex::Autolock autoLock(mParser->mDecodeLock);
+        while (mParser->mQueuedJobs.empty() && !mParser->mStopDecoding) {
+            mParser->mJobQueued.wait(mParser->mDecodeLock);
+        }
+        if (mParser->mStopDecoding) {
+            return false;
+        }
+        job = *mParser->mQueuedJobs.begin();
+        mParser->mQueuedJobs.erase(mParser->mQueuedJobs.begin());
+    }
+
+    decode(job);
+
+    Mutex::Autolock autoLock(mParser->mDecodeLock);
+    job->mDone = true;
+    mParser->mJobDone.broadcast();
+    return true;
+}
+
+void FLACParser::DecodeThread::decode(const sp<DecodeJob> &job)
+{
+    mJob = job;
+    mInput = job->mFrame->data();
+    mInputSize = job->mFrame->size();
+    mWritten = false;
+
+    if (!FLAC__stream_decoder_process_single(mDecoder) || !mWritten) {
+        job->mOutput.clear();
+    }
+
+    // after a bad frame, get ready for the next one
+    if (FLAC__stream_decoder_get_state(mDecoder) != FLAC__STREAM_DECODER_SEARCH_FOR_FRAME_SYNC) {
+        FLAC__stream_decoder_flush(mDecoder);
+    }
+
+    mJob.clear();
+    mInput = NULL;
+    mInputSize = 0;
+}
+
+FLAC__StreamDecoderReadStatus FLACParser::DecodeThread::read_callback(
+        const FLAC__StreamDecoder * /* decoder */, FLAC__byte buffer[],
+        size_t *bytes, void *client_data)
+{
+    DecodeThread *me = (DecodeThread *) client_data;
+    if (me->mInputSize == 0) {
+        *bytes = 0;
+        return FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+    }
+    size_t n = *bytes < me->mInputSize ? *bytes : me->mInputSize;
+    memcpy(buffer, me->mInput, n);
+    me->mInput += n;
+    me->mInputSize -= n;
+    *bytes = n;
+    return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+}
+
+FLAC__StreamDecoderWriteStatus FLACParser::DecodeThread::write_callback(
+        const FLAC__StreamDecoder * /* decoder */, const FLAC__Frame *frame,
+        const FLAC__int32 * const buffer[], void *client_data)
+{
+    DecodeThread *me = (DecodeThread *) client_data;
+    FLACParser *parser = me->mParser;
+    DecodeJob *job = me->mJob.get();
+
+    if (me->mWritten || job == NULL || !parser->checkFrameHeader(frame->header)
+            || frame->header.number_type != FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER
+            || job->mSkipSamples >= frame->header.blocksize) {
+        return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+    }
+
+    unsigned channels = parser->getChannels();
+    unsigned numSamples = frame->header.blocksize - job->mSkipSamples;
+
+    const FLAC__int32 *src[8];
+    for (unsigned c = 0; c < channels; ++c) {
+        src[c] = buffer[c] + job->mSkipSamples;
+    }
+
+    job->mOutput = new ABuffer(numSamples * channels * sizeof(short));
+    (*parser->mCopy)((short *) job->mOutput->data(), src, numSamples, channels);
+
+    FLAC__uint64 sampleNumber = frame->header.number.sample_number + job->mSkipSamples;
+    job->mTimeUs = (1000000LL * sampleNumber) / parser->getSampleRate();
+
+    me->mWritten = true;
+    return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+void FLACParser::DecodeThread::error_callback(
+        const FLAC__StreamDecoder * /* decoder */,
+        FLAC__StreamDecoderErrorStatus status, void * /* client_data */)
+{
+    ALOGE("FLACParser::DecodeThread error status=%d", status);
+}
+
 // FLACParser
 
 FLACParser::FLACParser(
@@ -500,17 +933,30 @@ FLACParser::FLACParser(
       mWriteRequested(false),
       mWriteCompleted(false),
       mWriteBuffer(NULL),
-      mErrorStatus((FLAC__StreamDecoderErrorStatus) -1)
+      mErrorStatus((FLAC__StreamDecoderErrorStatus) -1),
+      mFirstFramePos(0),
+      mStopDecoding(false),
+      mSplitBuffer(NULL),
+      mSplitBufferCapacity(0),
+      mSplitBufferPos(0),
+      mSplitBufferSize(0),
+      mSplitBufferAtEOS(false),
+      mSplitPos(0),
+      mSkipUntilSample(0)
 {
     ALOGV("FLACParser::FLACParser");
     memset(&mStreamInfo, 0, sizeof(mStreamInfo));
     memset(&mWriteHeader, 0, sizeof(mWriteHeader));
+    memset(mStreamHeader, 0, sizeof(mStreamHeader));
     mInitCheck = init();
 }
 
 FLACParser::~FLACParser()
 {
     ALOGV("FLACParser::~FLACParser");
+    if (!mDecodeThreads.isEmpty()) {
+        stopDecodeThreads();
+    }
     if (mDecoder != NULL) {
         FLAC__stream_decoder_delete(mDecoder);
         mDecoder = NULL;
@@ -536,6 +982,8 @@ status_t FLACParser::init()
             mDecoder, FLAC__METADATA_TYPE_PICTURE);
     FLAC__stream_decoder_set_metadata_respond(
             mDecoder, FLAC__METADATA_TYPE_VORBIS_COMMENT);
+    FLAC__stream_decoder_set_metadata_respond(
+            mDecoder, FLAC__METADATA_TYPE_SEEKTABLE);
     FLAC__StreamDecoderInitStatus initStatus;
     initStatus = FLAC__stream_decoder_init_stream(
             mDecoder,
@@ -553,6 +1001,10 @@ status_t FLACParser::init()
         ALOGE("end_of_metadata failed");
         return NO_INIT;
     }
+    FLAC__uint64 firstFramePos;
+    if (FLAC__stream_decoder_get_decode_position(mDecoder, &firstFramePos)) {
+        mFirstFramePos = firstFramePos;
+    }
     if (mStreamInfoValid) {
         // check channel count
         if (getChannels() == 0 || getChannels() > 8) {
@@ -635,16 +1087,55 @@ void FLACParser::allocateBuffers()
     mGroup = new MediaBufferGroup;
     mMaxBufferSize = getMaxBlockSize() * getChannels() * sizeof(short);
     mGroup->add_buffer(new MediaBuffer(mMaxBufferSize));
+
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.stagefright.flac-decode-threads", value, NULL)) {
+        int numThreads = atoi(value);
+        if (numThreads > 0) {
+            startDecodeThreads(numThreads < (int) kMaxDecodeThreads
+                    ? numThreads : kMaxDecodeThreads);
+        }
+    }
 }
 
 void FLACParser::releaseBuffers()
 {
     CHECK(mGroup != NULL);
+    if (!mDecodeThreads.isEmpty()) {
+        stopDecodeThreads();
+    }
     delete mGroup;
     mGroup = NULL;
 }
 
 MediaBuffer *FLACParser::readBuffer(bool doSeek, FLAC__uint64 sample)
+{
+    if (!mDecodeThreads.isEmpty()) {
+        return doSeek ? seekParallel(sample) : readParallelBuffer();
+    }
+    return readSerialBuffer(doSeek, sample);
+}
+
+bool FLACParser::checkFrameHeader(const FLAC__FrameHeader &header) const
+{
+    // verify that block header keeps the promises made by STREAMINFO
+    unsigned blocksize = header.blocksize;
+    if (blocksize == 0 || blocksize > getMaxBlockSize()) {
+        ALOGE("FLACParser::readBuffer write invalid blocksize %u", blocksize);
+        return false;
+    }
+    if (header.sample_rate != getSampleRate() ||
+        header.channels != getChannels() ||
+        header.bits_per_sample != getBitsPerSample()) {
+        ALOGE("FLACParser::readBuffer write changed parameters mid-stream: %d/%d/%d -> %d/%d/%d",
+                getSampleRate(), getChannels(), getBitsPerSample(),
+                header.sample_rate, header.channels, header.bits_per_sample);
+        return false;
+    }
+    return true;
+}
+
+MediaBuffer *FLACParser::readSerialBuffer(bool doSeek, FLAC__uint64 sample)
 {
     mWriteRequested = true;
     mWriteCompleted = false;
@@ -665,20 +1156,10 @@ MediaBuffer *FLACParser::readBuffer(bool doSeek, FLAC__uint64 sample)
         ALOGV("FLACParser::readBuffer write did not complete");
         return NULL;
     }
-    // verify that block header keeps the promises made by STREAMINFO
-    unsigned blocksize = mWriteHeader.blocksize;
-    if (blocksize == 0 || blocksize > getMaxBlockSize()) {
-        ALOGE("FLACParser::readBuffer write invalid blocksize %u", blocksize);
-        return NULL;
-    }
-    if (mWriteHeader.sample_rate != getSampleRate() ||
-        mWriteHeader.channels != getChannels() ||
-        mWriteHeader.bits_per_sample != getBitsPerSample()) {
-        ALOGE("FLACParser::readBuffer write changed parameters mid-stream: %d/%d/%d -> %d/%d/%d",
-                getSampleRate(), getChannels(), getBitsPerSample(),
-                mWriteHeader.sample_rate, mWriteHeader.channels, mWriteHeader.bits_per_sample);
+    if (!checkFrameHeader(mWriteHeader)) {
         return NULL;
     }
+    unsigned blocksize = mWriteHeader.blocksize;
     // acquire a media buffer
     CHECK(mGroup != NULL);
     MediaBuffer *buffer;
@@ -701,6 +1182,404 @@ MediaBuffer *FLACParser::readBuffer(bool doSeek, FLAC__uint64 sample)
     return buffer;
 }
 
+void FLACParser::startDecodeThreads(size_t numThreads)
+{
+    // "fLaC" and STREAMINFO as the last metadata block
+    memcpy(mStreamHeader, "fLaC", 4);
+    mStreamHeader[4] = 0x80;
+    mStreamHeader[5] = 0;
+    mStreamHeader[6] = 0;
+    mStreamHeader[7] = 34;
+    uint8_t *info = &mStreamHeader[8];
+    info[0] = mStreamInfo.min_blocksize >> 8;
+    info[1] = mStreamInfo.min_blocksize;
+    info[2] = mStreamInfo.max_blocksize >> 8;
+    info[3] = mStreamInfo.max_blocksize;
+    info[4] = mStreamInfo.min_framesize >> 16;
+    info[5] = mStreamInfo.min_framesize >> 8;
+    info[6] = mStreamInfo.min_framesize;
+    info[7] = mStreamInfo.max_framesize >> 16;
+    info[8] = mStreamInfo.max_framesize >> 8;
+    info[9] = mStreamInfo.max_framesize;
+    uint64_t bits = ((uint64_t) mStreamInfo.sample_rate << 44)
+            | ((uint64_t) (mStreamInfo.channels - 1) << 41)
+            | ((uint64_t) (mStreamInfo.bits_per_sample - 1) << 36)
+            | (mStreamInfo.total_samples & 0xfffffffffULL);
+    for (int i = 0; i < 8; ++i) {
+        info[10 + i] = bits >> (56 - 8 * i);
+    }
+    memcpy(&info[18], mStreamInfo.md5sum, 16);
+
+    mStopDecoding = false;
+    for (size_t i = 0; i < numThreads; ++i) {
+        sp<DecodeThread> thread = new DecodeThread(this);
+        if (thread->init() != OK || thread->run("FLACDecode", ANDROID_PRIORITY_AUDIO) != OK) {
+            ALOGW("FLACParser could not start decode thread %zu", i);
+            break;
+        }
+        mDecodeThreads.push(thread);
+    }
+    if (mDecodeThreads.isEmpty()) {
+        return;
+    }
+
+    // a seek point about every half second
+    bool created;
+    mSeekPoints = SeekPoints::Get(mDataSource, mFirstFramePos, getSampleRate() / 2, &created);
+    if (created) {
+        mSeekPoints->add(0, mFirstFramePos);
+        for (size_t i = 0; i < mSeekTable.size(); ++i) {
+            const FLAC__StreamMetadata_SeekPoint &point = mSeekTable.itemAt(i);
+            mSeekPoints->add(point.sample_number, mFirstFramePos + point.stream_offset);
+        }
+    }
+
+    mSplitBufferCapacity = kSplitBlockSize;
+    mSplitBuffer = (uint8_t *) malloc(mSplitBufferCapacity);
+    mSplitBufferPos = 0;
+    mSplitBufferSize = 0;
+    mSplitBufferAtEOS = false;
+    mSplitPos = mFirstFramePos;
+    mSkipUntilSample = 0;
+
+    ALOGD("FLACParser decoding on %zu threads", mDecodeThreads.size());
+}
+
+void FLACParser::stopDecodeThreads()
+{
+    {
+        Mutex::Autolock autoLock(mDecodeLock);
+        mStopDecoding = true;
+        mQueuedJobs.clear();
+        mJobQueued.broadcast();
+    }
+    for (size_t i = 0; i < mDecodeThreads.size(); ++i) {
+        mDecodeThreads.itemAt(i)->requestExitAndWait();
+    }
+    mDecodeThreads.clear();
+    mJobs.clear();
+    mSeekPoints.clear();
+
+    free(mSplitBuffer);
+    mSplitBuffer = NULL;
+    mSplitBufferCapacity = 0;
+    mSplitBufferSize = 0;
+}
+
+MediaBuffer *FLACParser::readParallelBuffer()
+{
+    sp<DecodeJob> job;
+    for (;;) {
+        queueDecodeJobs();
+        if (mJobs.empty()) {
+            return NULL;
+        }
+        job = *mJobs.begin();
+        mJobs.erase(mJobs.begin());
+        {
+            Mutex::Autolock autoLock(mDecodeLock);
+            while (!job->mDone) {
+                mJobDone.wait(mDecodeLock);
+            }
+        }
+        if (job->mOutput != NULL) {
+            break;
+        }
+        ALOGW("FLACParser::readBuffer skipping a frame that failed to decode");
+    }
+    // keep the decode threads busy while this frame is consumed
+    queueDecodeJobs();
+
+    CHECK(mGroup != NULL);
+    MediaBuffer *buffer;
+    status_t err = mGroup->acquire_buffer(&buffer);
+    if (err != OK) {
+        return NULL;
+    }
+    size_t bufferSize = job->mOutput->size();
+    CHECK(bufferSize <= mMaxBufferSize);
+    memcpy(buffer->data(), job->mOutput->data(), bufferSize);
+    buffer->set_range(0, bufferSize);
+    buffer->meta_data()->setInt64(kKeyTime, job->mTimeUs);
+    buffer->meta_data()->setInt32(kKeyIsSyncFrame, 1);
+    return buffer;
+}
+
+MediaBuffer *FLACParser::seekParallel(FLAC__uint64 sample)
+{
+    // drop the frames in flight, decode threads finish the ones they hold
+    {
+        Mutex::Autolock autoLock(mDecodeLock);
+        mQueuedJobs.clear();
+    }
+    mJobs.clear();
+
+    // Split from a known frame up to two seconds before the target, only
+    // decoding from the frame holding the target sample on.
+    FLAC__uint64 pointSample;
+    off64_t pointOffset;
+    if (mSeekPoints->find(sample, &pointSample, &pointOffset)
+            && sample - pointSample <= 2 * (FLAC__uint64) getSampleRate()) {
+        mSplitPos = pointOffset;
+        mSkipUntilSample = sample;
+        return readParallelBuffer();
+    }
+
+    // Otherwise let libFLAC seek, using the SEEKTABLE or searching the
+    // stream, and continue splitting after the frame it decoded.
+    MediaBuffer *buffer = readSerialBuffer(true, sample);
+    if (buffer == NULL) {
+        return NULL;
+    }
+    FLAC__uint64 pos;
+    if (!FLAC__stream_decoder_get_decode_position(mDecoder, &pos)) {
+        buffer->release();
+        return NULL;
+    }
+    mSplitPos = pos;
+    mSkipUntilSample = 0;
+    mSeekPoints->add(mWriteHeader.number.sample_number + mWriteHeader.blocksize, pos);
+    return buffer;
+}
+
+void FLACParser::queueDecodeJobs()
+{
+    size_t maxJobs = mDecodeThreads.size() * kJobsPerThread;
+    while (mJobs.size() < maxJobs) {
+        sp<DecodeJob> job = new DecodeJob;
+        if (!splitFrame(job.get())) {
+            break;
+        }
+        mJobs.push_back(job);
+
+        Mutex::Autolock autoLock(mDecodeLock);
+        mQueuedJobs.push_back(job);
+        mJobQueued.signal();
+    }
+}
+
+// Finds the next frame from mSplitPos on. A frame ends where the CRC-16 of
+// its bytes so far is zero and a header with a valid CRC-8 continues the
+// sample numbering, or where the stream ends.
+bool FLACParser::splitFrame(DecodeJob *job)
+{
+    for (;;) {
+        size_t avail = fillSplitBuffer(mSplitPos, kMaxFrameHeaderSize);
+        if (avail == 0) {
+            return false;
+        }
+
+        const uint8_t *frame = mSplitBuffer + (mSplitPos - mSplitBufferPos);
+        FLAC__uint64 firstSample;
+        unsigned blockSize;
+        size_t headerSize = parseFrameHeader(frame, avail, &firstSample, &blockSize);
+        if (headerSize == 0) {
+            // lost sync, skip to the next candidate
+            const uint8_t *next = (const uint8_t *) memchr(frame + 1, 0xff, avail - 1);
+            mSplitPos += next != NULL ? next - frame : avail;
+            continue;
+        }
+
+        FLAC__uint64 nextSample = firstSample + blockSize;
+        uint16_t crc = 0;
+        size_t frameSize = 0;
+        size_t lastCrcMatch = 0;    // where the frame ends if nothing follows
+        size_t i = 0;
+        while (frameSize == 0 && i <= kMaxFrameSize) {
+            avail = fillSplitBuffer(mSplitPos, i + kMaxFrameHeaderSize + 1);
+            frame = mSplitBuffer + (mSplitPos - mSplitBufferPos);
+
+            // look for the next header only where all of it is buffered
+            size_t limit = avail;
+            if (!mSplitBufferAtEOS) {
+                if (avail <= i + kMaxFrameHeaderSize) {
+                    break;
+                }
+                limit = avail - kMaxFrameHeaderSize;
+            }
+            for (; i < limit; ++i) {
+                if (crc == 0 && i > headerSize + 1) {
+                    lastCrcMatch = i;
+                    FLAC__uint64 sample;
+                    unsigned size;
+                    if (frame[i] == 0xff
+                            && parseFrameHeader(&frame[i], avail - i, &sample, &size) > 0
+                            && sample == nextSample) {
+                        frameSize = i;
+                        break;
+                    }
+                }
+                crc = (crc << 8) ^ gCrcTables.mCrc16[(crc >> 8) ^ frame[i]];
+            }
+
+            if (frameSize == 0 && mSplitBufferAtEOS) {
+                // the last frame, possibly followed by a tag
+                frameSize = (crc == 0 && i > headerSize + 1) ? i : lastCrcMatch;
+                break;
+            }
+        }
+
+        if (frameSize == 0) {
+            // a false sync code, or a damaged frame
+            ++mSplitPos;
+            continue;
+        }
+
+        off64_t framePos = mSplitPos;
+        mSplitPos += frameSize;
+        mSeekPoints->add(firstSample, framePos);
+
+        if (nextSample <= mSkipUntilSample) {
+            // before the seek target
+            continue;
+        }
+
+        job->mSkipSamples = mSkipUntilSample > firstSample ? mSkipUntilSample - firstSample : 0;
+        mSkipUntilSample = 0;
+        job->mFrame = new ABuffer(frameSize);
+        memcpy(job->mFrame->data(), frame, frameSize);
+        return true;
+    }
+}
+
+// Makes the split buffer hold the stream from pos on, at least size bytes of
+// it unless the stream ends first. Returns the number of bytes held from pos on.
+size_t FLACParser::fillSplitBuffer(off64_t pos, size_t size)
+{
+    if (pos < mSplitBufferPos || pos > mSplitBufferPos + (off64_t) mSplitBufferSize) {
+        mSplitBufferPos = pos;
+        mSplitBufferSize = 0;
+        mSplitBufferAtEOS = false;
+    }
+
+    size_t skip = pos - mSplitBufferPos;
+    if (mSplitBufferSize - skip >= size || mSplitBufferAtEOS) {
+        return mSplitBufferSize - skip;
+    }
+
+    memmove(mSplitBuffer, mSplitBuffer + skip, mSplitBufferSize - skip);
+    mSplitBufferPos = pos;
+    mSplitBufferSize -= skip;
+
+    if (size > mSplitBufferCapacity) {
+        size_t capacity = (size + kSplitBlockSize - 1) / kSplitBlockSize * kSplitBlockSize;
+        uint8_t *buffer = (uint8_t *) realloc(mSplitBuffer, capacity);
+        if (buffer == NULL) {
+            return mSplitBufferSize;
+        }
+        mSplitBuffer = buffer;
+        mSplitBufferCapacity = capacity;
+    }
+
+    while (mSplitBufferSize < size) {
+        ssize_t n = mDataSource->readAt(
+                mSplitBufferPos + mSplitBufferSize, mSplitBuffer + mSplitBufferSize,
+                mSplitBufferCapacity - mSplitBufferSize);
+        if (n <= 0) {
+            mSplitBufferAtEOS = true;
+            break;
+        }
+        mSplitBufferSize += n;
+    }
+    return mSplitBufferSize;
+}
+
+// Parses the frame header at data, checking its CRC-8. Returns its size, or
+// 0 if there is no valid header.
+size_t FLACParser::parseFrameHeader(
+        const uint8_t *data, size_t size,
+        FLAC__uint64 *firstSample, unsigned *blockSize) const
+{
+    if (size < 6 || data[0] != 0xff || (data[1] & 0xfe) != 0xf8) {
+        return 0;
+    }
+
+    unsigned blockSizeCode = data[2] >> 4;
+    unsigned sampleRateCode = data[2] & 0x0f;
+    unsigned channelCode = data[3] >> 4;
+    unsigned bitsCode = (data[3] >> 1) & 0x07;
+    if (blockSizeCode == 0 || sampleRateCode == 0x0f || (data[3] & 0x01)
+            || bitsCode == 3 || bitsCode == 7) {
+        return 0;
+    }
+    unsigned channels = channelCode < 8 ? channelCode + 1 : 2;
+    if (channelCode > 10 || channels != getChannels()) {
+        return 0;
+    }
+
+    // frame or sample number, coded like UTF-8
+    size_t pos = 4;
+    unsigned leadingOnes = 0;
+    while (leadingOnes < 8 && (data[pos] & (0x80 >> leadingOnes))) {
+        ++leadingOnes;
+    }
+    if (leadingOnes == 1 || leadingOnes == 8) {
+        return 0;
+    }
+    FLAC__uint64 number = data[pos++] & (0x7f >> leadingOnes);
+    unsigned extraBytes = leadingOnes > 0 ? leadingOnes - 1 : 0;
+    if (pos + extraBytes > size) {
+        return 0;
+    }
+    for (unsigned i = 0; i < extraBytes; ++i) {
+        if ((data[pos] & 0xc0) != 0x80) {
+            return 0;
+        }
+        number = (number << 6) | (data[pos++] & 0x3f);
+    }
+
+    unsigned samples;
+    if (blockSizeCode == 1) {
+        samples = 192;
+    } else if (blockSizeCode <= 5) {
+        samples = 576 << (blockSizeCode - 2);
+    } else if (blockSizeCode == 6) {
+        if (pos + 1 > size) {
+            return 0;
+        }
+        samples = data[pos++] + 1;
+    } else if (blockSizeCode == 7) {
+        if (pos + 2 > size) {
+            return 0;
+        }
+        samples = ((data[pos] << 8) | data[pos + 1]) + 1;
+        pos += 2;
+    } else {
+        samples = 256 << (blockSizeCode - 8);
+    }
+    if (samples > getMaxBlockSize()) {
+        return 0;
+    }
+
+    if (sampleRateCode == 12) {
+        pos += 1;
+    } else if (sampleRateCode >= 13) {
+        pos += 2;
+    }
+    if (pos + 1 > size) {
+        return 0;
+    }
+
+    uint8_t crc = 0;
+    for (size_t i = 0; i < pos; ++i) {
+        crc = gCrcTables.mCrc8[crc ^ data[i]];
+    }
+    if (crc != data[pos]) {
+        return 0;
+    }
+
+    if (data[1] & 0x01) {
+        // variable block size, numbered by sample
+        *firstSample = number;
+    } else if (mStreamInfo.min_blocksize == mStreamInfo.max_blocksize) {
+        *firstSample = number * mStreamInfo.max_blocksize;
+    } else {
+        *firstSample = number * samples;
+    }
+    *blockSize = samples;
+    return pos + 1;
+}
+
 // FLACsource
 
 FLACSource::FLACSource(
@@ -19,8 +19,12 @@
 #define LOG_TAG "FileSource"
 #include <utils/Log.h>
 
+#include <cutils/properties.h>
+#include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/FileSource.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <sys/types.h>
@@ -29,6 +33,37 @@
 
 namespace android {
 
+// Size of the mapped part of the file, small enough for 32-bit processes.
+static const size_t kMmapWindowSize = 16 * 1024 * 1024;
+// Part of a new window placed before the read that caused the remap, for
+// extractors that step back to re-read a header.
+static const size_t kMmapWindowBackoff = kMmapWindowSize / 8;
+// Reads larger than this bypass the mapping.
+static const size_t kMaxMappedReadSize = kMmapWindowSize / 2;
+// Consecutive sequential reads before the kernel is told about it.
+static const int32_t kSequentialReadsThreshold = 8;
+static const size_t kReadAheadSize = 1024 * 1024;
+
+struct FileSource::MappedWindow : public RefBase {
+    MappedWindow(void *data, off64_t start, size_t size)
+        : mData((uint8_t *)data),
+          mStart(start),
+          mSize(size) {
+    }
+
+    uint8_t *mData;
+    off64_t mStart;     // file offset of mData[0]
+    size_t mSize;
+
+protected:
+    virtual ~MappedWindow() {
+        munmap(mData, mSize);
+    }
+
+private:
+    DISALLOW_EVIL_CONSTRUCTORS(MappedWindow);
+};
+
 FileSource::FileSource(const char *filename)
     : mFd(-1),
       mOffset(0),
@@ -46,6 +81,8 @@ FileSource::FileSource(const char *filename)
     } else {
         ALOGE("Failed to open file '%s'. (%s)", filename, strerror(errno));
     }
+
+    initMmap();
 }
 
 FileSource::FileSource(int fd, int64_t offset, int64_t length)
@@ -63,9 +100,13 @@ FileSource::FileSource(int fd, int64_t offset, int64_t length)
     if (mFd >= 0 && mLength >= 0x7ffffffffffffffL) {
         mLength = lseek64(mFd, 0, SEEK_END);
     }
+
+    initMmap();
 }
 
 FileSource::~FileSource() {
+    mWindow.clear();
+
     if (mFd >= 0) {
         close(mFd);
         mFd = -1;
@@ -114,6 +155,15 @@ ssize_t FileSource::readAt(off64_t offset, void *data, size_t size) {
             == mDecryptHandle->decryptApiType) {
         return readAtDRM(offset, data, size);
    } else {
+        if (mMmapEnabled) {
+            sp<MappedWindow> window;
+            const uint8_t *ptr = mapRange_l(offset, size, &window);
+            if (ptr != NULL) {
+                memcpy(data, ptr, size);
+                return size;
+            }
+        }
+
         off64_t result = lseek64(mFd, offset + mOffset, SEEK_SET);
         if (result == -1) {
             ALOGE("seek to %lld failed", (long long)(offset + mOffset));
@@ -124,6 +174,175 @@ ssize_t FileSource::readAt(off64_t offset, void *data, size_t size) {
     }
 }
 
+ssize_t FileSource::readAtViews(
+        off64_t offset, size_t size, Vector<sp<ABuffer> > *views) {
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        if (mMmapEnabled && mDecryptHandle == NULL) {
+            if (mLength >= 0) {
+                if (offset >= mLength) {
+                    return 0;  // read beyond EOF.
+                }
+                int64_t numAvailable = mLength - offset;
+                if ((int64_t)size > numAvailable) {
+                    size = numAvailable;
+                }
+            }
+
+            sp<MappedWindow> window;
+            const uint8_t *ptr = mapRange_l(offset, size, &window);
+            if (ptr != NULL) {
+                // the view keeps the window mapped
+                sp<ABuffer> view = new ABuffer((void *)ptr, size);
+                view->meta()->setObject("window", window);
+                views->push(view);
+                return size;
+            }
+        }
+    }
+
+    return DataSource::readAtViews(offset, size, views);
+}
+
+void FileSource::initMmap() {
+    mMmapEnabled = false;
+    mNextReadOffset = -1;
+    mNumSequentialReads = 0;
+    mReadAheadOffset = -1;
+
+    if (mFd < 0 || mLength <= 0
+            || !property_get_bool("media.stagefright.mmap-file-source", false)) {
+        return;
+    }
+
+    // Only plain files can be mapped. Note that a mapped file that gets
+    // truncated underneath us raises SIGBUS, which is why this is opt-in.
+    struct stat st;
+    if (fstat(mFd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return;
+    }
+
+    mMmapEnabled = true;
+}
+
+// Returns a pointer to |size| bytes at |offset| within the mapped window,
+// remapping the window if necessary, or NULL if the read should go
+// through read() instead.
+const uint8_t *FileSource::mapRange_l(
+        off64_t offset, size_t size, sp<MappedWindow> *window) {
+    if (size > kMaxMappedReadSize) {
+        return NULL;
+    }
+
+    off64_t start = mOffset + offset;
+    if (mWindow == NULL
+            || start < mWindow->mStart
+            || start + (off64_t)size > mWindow->mStart + (off64_t)mWindow->mSize) {
+        if (!mapWindow_l(start)) {
+            return NULL;
+        }
+    }
+
+    adviseAccess_l(start, size);
+
+    *window = mWindow;
+    return mWindow->mData + (start - mWindow->mStart);
+}
+
+bool FileSource::mapWindow_l(off64_t start) {
+    static const off64_t kPageSize = sysconf(_SC_PAGESIZE);
+
+    off64_t mapStart = start - (off64_t)kMmapWindowBackoff;
+    if (mapStart < mOffset) {
+        mapStart = mOffset;
+    }
+    mapStart = mapStart / kPageSize * kPageSize;
+
+    off64_t end = mOffset + mLength;
+    size_t length = kMmapWindowSize;
+    if (end - mapStart < (off64_t)length) {
+        length = end - mapStart;
+    }
+
+    mWindow.clear();
+
+    void *data = mmap64(NULL, length, PROT_READ, MAP_SHARED, mFd, mapStart);
+    if (data == MAP_FAILED) {
+        ALOGW("mmap failed (%s), falling back to read()", strerror(errno));
+        mMmapEnabled = false;
+        return false;
+    }
+
+    ALOGV("mapped %zu bytes at %lld", length, (long long)mapStart);
+    mWindow = new MappedWindow(data, mapStart, length);
+    mReadAheadOffset = -1;
+
+    if (mNumSequentialReads >= kSequentialReadsThreshold) {
+        madvise(data, length, MADV_SEQUENTIAL);
+    }
+    return true;
+}
+
+// Derives madvise() hints from the access pattern: a run of back-to-back
+// reads marks the window sequential and keeps kReadAheadSize ahead of the
+// reader requested, anything else reverts to normal readahead.
+void FileSource::adviseAccess_l(off64_t start, size_t size) {
+    static const off64_t kPageSize = sysconf(_SC_PAGESIZE);
+
+    if (start == mNextReadOffset) {
+        if (++mNumSequentialReads == kSequentialReadsThreshold) {
+            madvise(mWindow->mData, mWindow->mSize, MADV_SEQUENTIAL);
+        }
+    } else {
+        if (mNumSequentialReads >= kSequentialReadsThreshold) {
+            madvise(mWindow->mData, mWindow->mSize, MADV_NORMAL);
+            mReadAheadOffset = -1;
+        }
+        mNumSequentialReads = 0;
+    }
+    mNextReadOffset = start + size;
+
+    if (mNumSequentialReads < kSequentialReadsThreshold
+            || mNextReadOffset < mReadAheadOffset) {
+        return;
+    }
+
+    off64_t windowEnd = mWindow->mStart + mWindow->mSize;
+    off64_t aheadStart = mNextReadOffset / kPageSize * kPageSize;
+    if (aheadStart >= windowEnd) {
+        return;
+    }
+    size_t aheadSize = kReadAheadSize;
+    if (windowEnd - aheadStart < (off64_t)aheadSize) {
+        aheadSize = windowEnd - aheadStart;
+    }
+
+    madvise(mWindow->mData + (aheadStart - mWindow->mStart), aheadSize, MADV_WILLNEED);
+
+    // ask again once the reader is halfway through
+    mReadAheadOffset = aheadStart + aheadSize / 2;
+}
+
+String8 FileSource::getFileIdentity() {
+    Mutex::Autolock autoLock(mLock);
+
+    // decrypted content must not be shared with other instances
+    if (mFd < 0 || mDecryptHandle != NULL) {
+        return String8();
+    }
+
+    struct stat st;
+    if (fstat(mFd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return String8();
+    }
+
+    return String8::format("%llu:%llu:%lld:%lld:%lld:%lld.%09ld",
+            (unsigned long long)st.st_dev, (unsigned long long)st.st_ino,
+            (long long)mOffset, (long long)mLength, (long long)st.st_size,
+            (long long)st.st_mtim.tv_sec, (long)st.st_mtim.tv_nsec);
+}
+
 status_t FileSource::getSize(off64_t *size) {
     Mutex::Autolock autoLock(mLock);
 
@@ -18,6 +18,7 @@
 #define LOG_TAG "FrameRenderTracker"
 
 #include <inttypes.h>
+#include <string.h>
 #include <gui/Surface.h>
 
 #include <media/stagefright/foundation/ADebug.h>
@@ -25,9 +26,26 @@
 
 namespace android {
 
+void FrameRenderTracker::Stats::reset() {
+    mRenderedFrames = 0;
+    mDroppedOnDequeue = 0;
+    mDroppedInvalidFence = 0;
+    mDroppedIncomplete = 0;
+    mLatencyCount = 0;
+    mLatencyMinNs = INT64_MAX;
+    mLatencyMaxNs = 0;
+    mLatencySumNs = 0;
+    memset(mLatencyBuckets, 0, sizeof(mLatencyBuckets));
+    mJitterCount = 0;
+    mJitterMaxNs = 0;
+    mJitterSumNs = 0;
+}
+
 FrameRenderTracker::FrameRenderTracker()
     : mLastRenderTimeNs(-1),
-      mComponentName("unknown component") {
+      mComponentName("unknown component"),
+      mStatsLastRenderTimeNs(-1),
+      mStatsLastMediaTimeUs(-1) {
 }
 
 FrameRenderTracker::~FrameRenderTracker() {
@@ -35,16 +53,22 @@ FrameRenderTracker::~FrameRenderTracker() {
 
 void FrameRenderTracker::setComponentName(const AString &componentName) {
     mComponentName = componentName;
+    mStats.reset();
+    mStatsLastRenderTimeNs = -1;
+    mStatsLastMediaTimeUs = -1;
 }
 
 void FrameRenderTracker::clear(nsecs_t lastRenderTimeNs) {
     mRenderQueue.clear();
     mLastRenderTimeNs = lastRenderTimeNs;
+    // don't measure jitter across a flush or seek
+    mStatsLastRenderTimeNs = -1;
 }
 
 void FrameRenderTracker::onFrameQueued(
         int64_t mediaTimeUs, const sp<GraphicBuffer> &graphicBuffer, const sp<Fence> &fence) {
-    mRenderQueue.emplace_back(mediaTimeUs, graphicBuffer, fence);
+    mRenderQueue.emplace_back(
+            mediaTimeUs, graphicBuffer, fence, systemTime(SYSTEM_TIME_MONOTONIC));
 }
 
 FrameRenderTracker::Info *FrameRenderTracker::updateInfoForDequeuedBuffer(
@@ -76,6 +100,7 @@ FrameRenderTracker::Info *FrameRenderTracker::updateInfoForDequeuedBuffer(
     // the queued fence; however, there is no way to figure that out.)
     if (fenceFd < 0) {
         // frame is new or was dropped
+        ++mStats.mDroppedOnDequeue;
         mRenderQueue.erase(renderInfo);
         return NULL;
     }
@@ -114,6 +139,7 @@ std::list<FrameRenderTracker::Info> FrameRenderTracker::checkFencesAndGetRendere
     for (std::list<Info>::iterator it = mRenderQueue.begin();
             it != mRenderQueue.end(); ) {
         bool drop = false; // whether to drop each frame
+        bool invalidFence = false;
         if (it->mIndex < 0) {
             // frame not yet dequeued (or already rendered on a tunneled surface)
             drop = dropIncomplete;
@@ -122,6 +148,7 @@ std::list<FrameRenderTracker::Info> FrameRenderTracker::checkFencesAndGetRendere
             nsecs_t signalTime = it->mFence->getSignalTime();
             if (signalTime < 0) { // invalid fence
                 drop = true;
+                invalidFence = true;
             } else if (signalTime == INT64_MAX) { // unsignaled fence
                 drop = dropIncomplete;
             } else { // signaled
@@ -137,6 +164,7 @@ std::list<FrameRenderTracker::Info> FrameRenderTracker::checkFencesAndGetRendere
         // Also return any dropped frames.
         if (drop || (it->mFence == NULL && it == mRenderQueue.begin())) {
             // (unrendered) dropped frames have their mRenderTimeNs still set to -1
+            updateStats(*it, invalidFence);
             done.splice(done.end(), mRenderQueue, it++);
         } else {
             ++it;
@@ -149,6 +177,54 @@ std::list<FrameRenderTracker::Info> FrameRenderTracker::checkFencesAndGetRendere
     return done;
 }
 
+void FrameRenderTracker::updateStats(const FrameRenderTracker::Info &info, bool invalidFence) {
+    if (info.mRenderTimeNs < 0) {
+        if (invalidFence) {
+            ++mStats.mDroppedInvalidFence;
+        } else {
+            ++mStats.mDroppedIncomplete;
+        }
+        return;
+    }
+
+    ++mStats.mRenderedFrames;
+
+    if (info.mQueueTimeNs >= 0 && info.mRenderTimeNs >= info.mQueueTimeNs) {
+        nsecs_t latencyNs = info.mRenderTimeNs - info.mQueueTimeNs;
+        ++mStats.mLatencyCount;
+        mStats.mLatencySumNs += latencyNs;
+        if (latencyNs < mStats.mLatencyMinNs) {
+            mStats.mLatencyMinNs = latencyNs;
+        }
+        if (latencyNs > mStats.mLatencyMaxNs) {
+            mStats.mLatencyMaxNs = latencyNs;
+        }
+        size_t bucket = 0;
+        for (nsecs_t limitNs = 1000000; latencyNs >= limitNs
+                && bucket + 1 < (size_t)Stats::kNumLatencyBuckets; limitNs <<= 1) {
+            ++bucket;
+        }
+        ++mStats.mLatencyBuckets[bucket];
+    }
+
+    // only frames advancing in both media and render time contribute to jitter
+    if (mStatsLastRenderTimeNs >= 0 && info.mRenderTimeNs > mStatsLastRenderTimeNs
+            && info.mMediaTimeUs > mStatsLastMediaTimeUs) {
+        nsecs_t jitterNs = (info.mRenderTimeNs - mStatsLastRenderTimeNs)
+                - (info.mMediaTimeUs - mStatsLastMediaTimeUs) * 1000;
+        if (jitterNs < 0) {
+            jitterNs = -jitterNs;
+        }
+        ++mStats.mJitterCount;
+        mStats.mJitterSumNs += jitterNs;
+        if (jitterNs > mStats.mJitterMaxNs) {
+            mStats.mJitterMaxNs = jitterNs;
+        }
+    }
+    mStatsLastRenderTimeNs = info.mRenderTimeNs;
+    mStatsLastMediaTimeUs = info.mMediaTimeUs;
+}
+
 void FrameRenderTracker::untrackFrame(const FrameRenderTracker::Info *info, ssize_t index) {
     if (info == NULL && index == SSIZE_MAX) {
         // nothing to do
@@ -188,4 +264,34 @@ void FrameRenderTracker::dumpRenderQueue() const {
     }
 }
 
+void FrameRenderTracker::dumpStats() const {
+    size_t dropped = mStats.mDroppedOnDequeue + mStats.mDroppedInvalidFence
+            + mStats.mDroppedIncomplete;
+    if (mStats.mRenderedFrames == 0 && dropped == 0) {
+        return;
+    }
+    ALOGI("[%s] Render stats: rendered %zu, dropped %zu (on dequeue %zu, invalid fence %zu, "
+            "incomplete %zu)",
+            mComponentName.c_str(), mStats.mRenderedFrames, dropped, mStats.mDroppedOnDequeue,
+            mStats.mDroppedInvalidFence, mStats.mDroppedIncomplete);
+    if (mStats.mLatencyCount > 0) {
+        AString buckets;
+        for (size_t i = 0; i < (size_t)Stats::kNumLatencyBuckets; ++i) {
+            buckets.append(i == 0 ? "" : " ");
+            buckets.append((int32_t)mStats.mLatencyBuckets[i]);
+        }
+        ALOGI("[%s]   queue-to-render latency: min %lldus avg %lldus max %lldus, "
+                "per power of 2 ms: %s",
+                mComponentName.c_str(), (long long)mStats.mLatencyMinNs / 1000,
+                (long long)(mStats.mLatencySumNs / (nsecs_t)mStats.mLatencyCount) / 1000,
+                (long long)mStats.mLatencyMaxNs / 1000, buckets.c_str());
+    }
+    if (mStats.mJitterCount > 0) {
+        ALOGI("[%s]   render jitter vs media time: avg %lldus max %lldus over %zu frames",
+                mComponentName.c_str(),
+                (long long)(mStats.mJitterSumNs / (nsecs_t)mStats.mJitterCount) / 1000,
+                (long long)mStats.mJitterMaxNs / 1000, mStats.mJitterCount);
+    }
+}
+
 }  // namespace android
@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "FrameScanSeeker"
+#include <utils/Log.h>
+
+#include "include/FrameScanSeeker.h"
+
+#include "include/avc_utils.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/DataSource.h>
+#include <media/stagefright/Utils.h>
+#include <utils/List.h>
+#include <utils/String8.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+// Same as MP3Extractor: the frame headers that must match the first frame's.
+static const uint32_t kMask = 0xfffe0c00;
+
+// One table entry per this many frames, about a second of audio at 44.1kHz.
+static const size_t kFramesPerEntry = 38;
+
+static const size_t kScanBlockSize = 64 * 1024;
+
+// Number of scanned files whose tables are kept around.
+static const size_t kMaxCachedTables = 8;
+
+struct FrameScanSeeker::FrameTable : public RefBase {
+    FrameTable(int sampleRate, int samplesPerFrame)
+        : mSampleRate(sampleRate),
+          mSamplesPerFrame(samplesPerFrame),
+          mNumFrames(0),
+          mComplete(false) {
+    }
+
+    const int mSampleRate;
+    const int mSamplesPerFrame;
+
+    Mutex mLock;
+    // Offset of every kFramesPerEntry-th frame; all frames in the stream
+    // hold the same number of samples, so entry i starts at a known time.
+    Vector<off64_t> mOffsets;
+    int64_t mNumFrames;
+    bool mComplete;
+
+    int64_t entryDurationUs() const {
+        return (int64_t)kFramesPerEntry * mSamplesPerFrame * 1000000ll / mSampleRate;
+    }
+
+private:
+    DISALLOW_EVIL_CONSTRUCTORS(FrameTable);
+};
+
+struct FrameScanSeeker::ScanThread : public Thread {
+    ScanThread(const sp<DataSource> &source, const sp<FrameTable> &table,
+            off64_t firstFramePos, uint32_t fixedHeader)
+        : Thread(false /* canCallJava */),
+          mSource(source),
+          mTable(table),
+          mFirstFramePos(firstFramePos),
+          mFixedHeader(fixedHeader) {
+    }
+
+private:
+    sp<DataSource> mSource;
+    sp<FrameTable> mTable;
+    off64_t mFirstFramePos;
+    uint32_t mFixedHeader;
+
+    void publish(const Vector<off64_t> &offsets, int64_t numFrames, bool complete);
+
+    virtual bool threadLoop();
+
+    DISALLOW_EVIL_CONSTRUCTORS(ScanThread);
+};
+
+void FrameScanSeeker::ScanThread::publish(
+        const Vector<off64_t> &offsets, int64_t numFrames, bool complete) {
+    Mutex::Autolock autoLock(mTable->mLock);
+    mTable->mOffsets.appendVector(offsets);
+    mTable->mNumFrames = numFrames;
+    mTable->mComplete = complete;
+}
+
+bool FrameScanSeeker::ScanThread::threadLoop() {
+    uint8_t *block = new uint8_t[kScanBlockSize];
+    off64_t blockPos = 0;
+    size_t blockSize = 0;
+
+    off64_t pos = mFirstFramePos;
+    int64_t numFrames = 0;
+    Vector<off64_t> pending;
+    for (;;) {
+        if (pos < blockPos || pos + 4 > blockPos + (off64_t)blockSize) {
+            ssize_t n = mSource->readAt(pos, block, kScanBlockSize);
+            if (n < 4) {
+                break;
+            }
+            blockPos = pos;
+            blockSize = n;
+        }
+
+        uint32_t header = U32_AT(&block[pos - blockPos]);
+        size_t frameSize;
+        if ((header & kMask) != (mFixedHeader & kMask)
+                || !GetMPEGAudioFrameSize(header, &frameSize)) {
+            // Lost sync, look for the next frame header.
+            ++pos;
+            continue;
+        }
+
+        if (numFrames % kFramesPerEntry == 0) {
+            pending.push(pos);
+            if (pending.size() == 64) {
+                publish(pending, numFrames, false /* complete */);
+                pending.clear();
+            }
+        }
+
+        ++numFrames;
+        pos += frameSize;
+    }
+
+    publish(pending, numFrames, true /* complete */);
+    ALOGV("scanned %lld frames", (long long)numFrames);
+
+    delete[] block;
+    block = NULL;
+
+    mSource.clear();
+
+    return false;
+}
+
+// Process wide cache of frame tables, keyed by DataSource::getFileIdentity()
+// and the first frame's offset; most recently used first.
+struct CachedFrameTable {
+    String8 mKey;
+    sp<RefBase> mTable;
+};
+
+static Mutex gTableLock;
+static List<CachedFrameTable> gTables;
+
+// static
+sp<FrameScanSeeker> FrameScanSeeker::CreateFromSource(
+        const sp<DataSource> &source, off64_t first_frame_pos, uint32_t fixed_header) {
+    String8 identity = source->getFileIdentity();
+    if (identity.isEmpty()) {
+        return NULL;
+    }
+
+    size_t frameSize;
+    int sampleRate;
+    int numSamples;
+    if (!GetMPEGAudioFrameSize(
+                fixed_header, &frameSize, &sampleRate, NULL, NULL, &numSamples)
+            || sampleRate <= 0 || numSamples <= 0) {
+        return NULL;
+    }
+
+    String8 key = String8::format("%s@%lld", identity.string(), (long long)first_frame_pos);
+
+    Mutex::Autolock autoLock(gTableLock);
+
+    sp<FrameTable> table;
+    for (List<CachedFrameTable>::iterator it = gTables.begin(); it != gTables.end(); ++it) {
+        if (it->mKey == key) {
+            table = static_cast<FrameTable *>(it->mTable.get());
+            gTables.erase(it);
+            break;
+        }
+    }
+
+    if (table == NULL) {
+        table = new FrameTable(sampleRate, numSamples);
+
+        sp<ScanThread> thread = new ScanThread(source, table, first_frame_pos, fixed_header);
+        if (thread->run("MP3FrameScan", ANDROID_PRIORITY_BACKGROUND) != OK) {
+            return NULL;
+        }
+    }
+
+    CachedFrameTable entry;
+    entry.mKey = key;
+    entry.mTable = table;
+    gTables.push_front(entry);
+    while (gTables.size() > kMaxCachedTables) {
+        gTables.erase(--gTables.end());
+    }
+
+    return new FrameScanSeeker(table);
+}
+
+FrameScanSeeker::FrameScanSeeker(const sp<FrameTable> &table)
+    : mTable(table) {
+}
+
+bool FrameScanSeeker::getDuration(int64_t *durationUs) {
+    Mutex::Autolock autoLock(mTable->mLock);
+
+    if (!mTable->mComplete || mTable->mNumFrames == 0) {
+        return false;
+    }
+
+    *durationUs = mTable->mNumFrames * mTable->mSamplesPerFrame * 1000000ll
+            / mTable->mSampleRate;
+
+    return true;
+}
+
+bool FrameScanSeeker::getOffsetForTime(int64_t *timeUs, off64_t *pos) {
+    Mutex::Autolock autoLock(mTable->mLock);
+
+    if (mTable->mOffsets.isEmpty()) {
+        return false;
+    }
+
+    int64_t entryDurationUs = mTable->entryDurationUs();
+    size_t index = (*timeUs > 0) ? *timeUs / entryDurationUs : 0;
+
+    if (index >= mTable->mOffsets.size()) {
+        if (!mTable->mComplete) {
+            // not scanned that far yet
+            return false;
+        }
+        index = mTable->mOffsets.size() - 1;
+    }
+
+    *pos = mTable->mOffsets.itemAt(index);
+    *timeUs = index * entryDurationUs;
+
+    ALOGV("getOffsetForTime %lld us => 0x%016llx", (long long)*timeUs, (long long)*pos);
+
+    return true;
+}
+
+}  // namespace android
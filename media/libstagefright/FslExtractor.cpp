@@ -22,6 +22,7 @@
 #include <media/stagefright/MetaData.h>
 #include <utils/String8.h>
 #include <utils/RefBase.h>
+#include <utils/Thread.h>
 #include <dlfcn.h>
 #include <OMX_Video.h>
 #include <OMX_Audio.h>
@@ -34,9 +35,80 @@ namespace android {
 #define MAX_AUDIO_BUFFER_SIZE (16*1024)
 #define MAX_TEXT_BUFFER_SIZE (1024)
 #define MAX_TRACK_COUNT 32
+#define MAX_DEMUX_DEPTH 256
 
 bool isForceUseGoogleAACCodec = false;
 
+// A MediaBufferGroup that stays alive until all of its buffers are returned,
+// so that buffers still held downstream outlive the source that owns them.
+struct FslBufferGroup : public MediaBufferGroup, public RefBase {
+    FslBufferGroup(size_t bufferSize, size_t maxBuffers)
+        : MediaBufferGroup(maxBuffers),
+          mBufferSize(bufferSize) {
+    }
+
+    // Returns NULL instead of blocking when all buffers are in use.
+    MediaBuffer *acquire() {
+        MediaBuffer *buffer = NULL;
+        if(acquire_buffer(&buffer, true /* nonBlocking */, mBufferSize) != OK)
+            return NULL;
+        incStrong(this);
+        return buffer;
+    }
+
+protected:
+    virtual void signalBufferReturned(MediaBuffer *buffer) {
+        MediaBufferGroup::signalBufferReturned(buffer);
+        decStrong(this);
+    }
+
+private:
+    size_t mBufferSize;
+
+    FslBufferGroup(const FslBufferGroup &);
+    FslBufferGroup &operator=(const FslBufferGroup &);
+};
+
+// The sample buffers of one FslMediaSource, in power of two size classes.
+// The parser's buffer requests for the source's stream are served from it.
+struct FslBufferPool : public RefBase {
+    FslBufferPool() {}
+
+    // Never blocks, a request that can't be pooled gets a buffer of its own.
+    MediaBuffer *acquire(size_t size) {
+        size_t sizeClass = 0;
+        while(sizeClass < kNumSizeClasses && (kMinBufferSize << sizeClass) < size)
+            sizeClass++;
+        if(sizeClass == kNumSizeClasses)
+            return new MediaBuffer(size);
+
+        MediaBuffer *buffer = NULL;
+        {
+            Mutex::Autolock autoLock(mLock);
+            if(mGroups[sizeClass] == NULL)
+                mGroups[sizeClass] = new FslBufferGroup(
+                        kMinBufferSize << sizeClass, kMaxBuffersPerSizeClass);
+            buffer = mGroups[sizeClass]->acquire();
+        }
+        if(buffer == NULL)
+            return new MediaBuffer(size);
+        return buffer;
+    }
+
+private:
+    enum {
+        kMinBufferSize = 4096,
+        kNumSizeClasses = 10,   // up to 2MB
+        kMaxBuffersPerSizeClass = 16,
+    };
+
+    Mutex mLock;
+    sp<FslBufferGroup> mGroups[kNumSizeClasses];
+
+    FslBufferPool(const FslBufferPool &);
+    FslBufferPool &operator=(const FslBufferPool &);
+};
+
 struct FslMediaSource : public MediaSource {
     FslMediaSource(
             const sp<FslExtractor> &extractor, size_t index, sp<MetaData>& metadata);
@@ -52,6 +124,11 @@ struct FslMediaSource : public MediaSource {
     bool started();
     void addMediaBuffer(MediaBuffer *buffer);
     bool full();
+    size_t pendingFrames();
+    void clearPendingFrames();
+    status_t demuxError();
+    void setDemuxError(status_t err);
+    const sp<FslBufferPool> &bufferPool() const;
 protected:
     virtual ~FslMediaSource();
 private:
@@ -60,14 +137,18 @@ private:
     Mutex mLock;
     sp<MetaData> mFormat;
     List<MediaBuffer *> mPendingFrames;
+    sp<FslBufferPool> mBufferPool;
+    Condition mFrameAvailable;
+    status_t mDemuxError;
     bool mStarted;
+    bool mIsText;
     bool mIsAVC;
     bool mIsHEVC;
     size_t mNALLengthSize;
     size_t mBufferSize;
     uint32 mFrameSent;
 
-    void clearPendingFrames();
+    status_t waitForFrame();
     FslMediaSource(const FslMediaSource &);
     FslMediaSource &operator=(const FslMediaSource &);
 };
@@ -75,12 +156,16 @@ private:
 FslMediaSource::FslMediaSource(const sp<FslExtractor> &extractor, size_t index,sp<MetaData>& metadata)
     : mExtractor(extractor),
       mSourceIndex(index),
-      mFormat(metadata)
+      mFormat(metadata),
+      mBufferPool(new FslBufferPool)
 {
     mStarted = false;
+    mDemuxError = OK;
     const char *mime;
     CHECK(mFormat->findCString(kKeyMIMEType, &mime));
 
+    mIsText = !strncasecmp(mime, "text/", 5);
+
     mIsAVC = !strcasecmp(mime, MEDIA_MIMETYPE_VIDEO_AVC);
     mIsHEVC = !strcasecmp(mime, MEDIA_MIMETYPE_VIDEO_HEVC);
 
@@ -128,12 +213,17 @@ FslMediaSource::~FslMediaSource()
 }
 status_t FslMediaSource::start(MetaData * /* params */)
 {
-    mStarted = true;
+    {
+        Mutex::Autolock autoLock(mLock);
+        mStarted = true;
+        mDemuxError = OK;
+    }
     mExtractor->ActiveTrack(mSourceIndex);
     ALOGD("source start track %d",mSourceIndex);
     return OK;
 }
 void FslMediaSource::clearPendingFrames() {
+    Mutex::Autolock autoLock(mLock);
     while (!mPendingFrames.empty()) {
         MediaBuffer *frame = *mPendingFrames.begin();
         mPendingFrames.erase(mPendingFrames.begin());
@@ -148,7 +238,10 @@ void FslMediaSource::clearPendingFrames() {
 status_t FslMediaSource::stop()
 {
     clearPendingFrames();
-    mStarted = false;
+    {
+        Mutex::Autolock autoLock(mLock);
+        mStarted = false;
+    }
     mExtractor->DisableTrack(mSourceIndex);
     return OK;
 }
@@ -168,7 +261,6 @@ status_t FslMediaSource::read(
     //int64_t targetSampleTimeUs = -1ll;
     size_t srcSize = 0;
     size_t srcOffset = 0;
-    int32_t i = 0;
     int64_t seekTimeUs;
     ReadOptions::SeekMode mode;
     int64_t outTs = 0;
@@ -204,20 +296,12 @@ status_t FslMediaSource::read(
             {
                 ALOGV("read first frame before seeking track, mFrameSent %d", mFrameSent);
                 int64_t time = 0;
-                int32_t j=0;
                 ret = mExtractor->HandleSeekOperation(mSourceIndex,&time,seekFlag);
-                while (mPendingFrames.empty()) {
-                    status_t err = mExtractor->GetNextSample(mSourceIndex,false);
-                    if (err != OK) {
-                        clearPendingFrames();
-                        return err;
-                    }
-                    j++;
-                    if(j > 1 && OK != mExtractor->CheckInterleaveEos(mSourceIndex)){
-                        ALOGE("get interleave eos");
-                        return ERROR_END_OF_STREAM;
-                    }
+                status_t err = waitForFrame();
+                if (err != OK) {
+                    return err;
                 }
+                Mutex::Autolock autoLock(mLock);
                 MediaBuffer *frame = *mPendingFrames.begin();
                 frame->meta_data()->setInt64(kKeyTime, seekTimeUs);
             }
@@ -227,26 +311,22 @@ status_t FslMediaSource::read(
         ret = mExtractor->HandleSeekOperation(mSourceIndex,&seekTimeUs,seekFlag);
     }
 
-    while (mPendingFrames.empty()) {
-        status_t err = mExtractor->GetNextSample(mSourceIndex,false);
-
-        if (err != OK) {
-            clearPendingFrames();
-
-            return err;
-        }
-        i++;
-        if(i > 1 && OK != mExtractor->CheckInterleaveEos(mSourceIndex)){
-            ALOGE("get interleave eos");
-            return ERROR_END_OF_STREAM;
-        }
+    status_t err = waitForFrame();
+    if (err != OK) {
+        return err;
     }
 
-    MediaBuffer *frame = *mPendingFrames.begin();
-    mPendingFrames.erase(mPendingFrames.begin());
+    MediaBuffer *frame = NULL;
+    {
+        Mutex::Autolock autoLock(mLock);
+        frame = *mPendingFrames.begin();
+        mPendingFrames.erase(mPendingFrames.begin());
+        mBufferSize -= frame->size();
+    }
+    if(mExtractor->isDemuxing())
+        mExtractor->SignalDemux();
 
     *out = frame;
-    mBufferSize -= frame->size();
 
     mFrameSent++;
     //frame->meta_data()->findInt64(kKeyTime, &outTs);
@@ -372,21 +452,79 @@ status_t FslMediaSource::read(
     return OK;
 }
 
+// Makes sure at least one frame is pending. Without a demux thread the
+// samples are demuxed on the calling thread.
+status_t FslMediaSource::waitForFrame()
+{
+    if(mExtractor->isDemuxing()){
+        Mutex::Autolock autoLock(mLock);
+        while(mPendingFrames.empty()){
+            if(mDemuxError != OK)
+                return mDemuxError;
+            // subtitle samples are sparse, don't hold the reader up for them
+            if(mIsText)
+                return WOULD_BLOCK;
+            mFrameAvailable.wait(mLock);
+        }
+        return OK;
+    }
+
+    int32_t i = 0;
+    while(pendingFrames() == 0){
+        status_t err = mExtractor->GetNextSample(mSourceIndex,false);
+        if (err != OK) {
+            clearPendingFrames();
+            return err;
+        }
+        i++;
+        if(i > 1 && OK != mExtractor->CheckInterleaveEos(mSourceIndex)){
+            ALOGE("get interleave eos");
+            return ERROR_END_OF_STREAM;
+        }
+    }
+    return OK;
+}
+
 void FslMediaSource::addMediaBuffer(MediaBuffer *buffer)
 {
     if(buffer == NULL)
         return;
+
+    Mutex::Autolock autoLock(mLock);
     mBufferSize += buffer->size();
 
     mPendingFrames.push_back(buffer);
+    mFrameAvailable.signal();
     return;
 }
 bool FslMediaSource::started()
 {
+    Mutex::Autolock autoLock(mLock);
     return mStarted;
 }
+size_t FslMediaSource::pendingFrames()
+{
+    Mutex::Autolock autoLock(mLock);
+    return mPendingFrames.size();
+}
+const sp<FslBufferPool> &FslMediaSource::bufferPool() const
+{
+    return mBufferPool;
+}
+status_t FslMediaSource::demuxError()
+{
+    Mutex::Autolock autoLock(mLock);
+    return mDemuxError;
+}
+void FslMediaSource::setDemuxError(status_t err)
+{
+    Mutex::Autolock autoLock(mLock);
+    mDemuxError = err;
+    mFrameAvailable.signal();
+}
 bool FslMediaSource::full()
 {
+    Mutex::Autolock autoLock(mLock);
     if(mBufferSize > MAX_FRAME_BUFFER_LENGTH)
         return true;
     else
@@ -401,6 +539,10 @@ public:
     bool isLiveStreaming() const;
     bool AddBufferReadLimitation(uint32_t index,uint32_t size);
     uint32_t GetBufferReadLimitation(uint32_t index);
+    void SetCurrentStream_l(uint32_t streamNum);
+    ssize_t ReadAt_l(int64_t offset, void *data, size_t size);
+    void SetBufferPool(uint32_t streamNum, const sp<FslBufferPool> &pool);
+    MediaBuffer *AcquireBuffer(uint32_t streamNum, size_t size);
     sp<DataSource> mDataSource;
     Mutex mLock;
     int64_t mOffset;
@@ -412,6 +554,23 @@ private:
     bool mIsStreaming;
     uint32_t mMaxBufferSize[MAX_TRACK_COUNT];
 
+    // The parser issues many small reads. They are served from read-ahead
+    // windows, one per stream whose sample is being read plus one for all
+    // other reads (headers, index), so interleaved streams don't keep
+    // evicting each other's data.
+    enum {
+        kReadAheadSize = 64 * 1024,
+        kControlWindow = MAX_TRACK_COUNT,
+    };
+    struct ReadAheadWindow {
+        sp<ABuffer> mBuffer;
+        int64_t mOffset;
+    };
+    ReadAheadWindow mWindows[MAX_TRACK_COUNT + 1];
+    sp<FslBufferPool> mBufferPools[MAX_TRACK_COUNT];
+    uint32_t mCurrentWindow;
+    bool mReadAhead;
+
     FslDataSourceReader(const FslDataSourceReader &);
     FslDataSourceReader &operator=(const FslDataSourceReader &);
 };
@@ -450,7 +609,7 @@ static uint32  appReadFile( FslFileHandle file_handle, void * buffer, uint32 nb,
 
     //ALOGV("appLocalReadFile nb %u",(unsigned int)nb);
 
-    ret = h->mDataSource->readAt(h->mOffset, buffer, nb);
+    ret = h->ReadAt_l(h->mOffset, buffer, nb);
 
     //ALOGD("appReadFile at %lld nb %u, result %d", h->mOffset, (unsigned int)nb, ret);
 
@@ -637,8 +796,7 @@ static uint8* appRequestBuffer(   uint32 streamNum,
                                 void * parserContext)
 {
     FslDataSourceReader *h;
-    uint8 * dataBuf = NULL;
-    ABuffer * buffer = NULL;
+    MediaBuffer * buffer = NULL;
     uint32_t limitSize = 0;
 
     if (!size || !bufContext || !parserContext)
@@ -652,31 +810,31 @@ static uint8* appRequestBuffer(   uint32 streamNum,
         return NULL;
     }
 
+    {
+        Mutex::Autolock autoLock(h->mLock);
+        h->SetCurrentStream_l(streamNum);
+    }
+
     limitSize = h->GetBufferReadLimitation(streamNum);
     if((*size) > limitSize && limitSize > 0)
         *size = limitSize;
 
-    buffer = new ABuffer((size_t)(*size));
+    buffer = h->AcquireBuffer(streamNum, (size_t)(*size));
 
     *bufContext = (void*)buffer;
-    dataBuf = buffer->data();
 
-    return dataBuf;
+    return (uint8 *)buffer->data();
 }
 
 
 static void appReleaseBuffer(uint32 streamNum, uint8 * pBuffer, void * bufContext, void * parserContext)
 {
-    FslDataSourceReader *h;
-    sp<ABuffer> buffer = NULL;
-
     ALOGV("appReleaseBuffer streamNum=%u",streamNum);
 
     if (!pBuffer || !bufContext || !parserContext)
         return;
-    h = (FslDataSourceReader *)parserContext;
-    buffer = (ABuffer *)(bufContext);
-    buffer.clear();
+
+    ((MediaBuffer *)bufContext)->release();
 
     return;
 }
@@ -708,6 +866,68 @@ FslDataSourceReader::FslDataSourceReader(const sp<DataSource> &source)
 
     bStopReading = false;
     memset(&mMaxBufferSize[0],0,MAX_TRACK_COUNT*sizeof(uint32_t));
+
+    // data of a live stream may not have arrived yet, reading ahead would
+    // block the parser until it does
+    mReadAhead = !mIsLiveStreaming;
+    mCurrentWindow = kControlWindow;
+    for(uint32_t i = 0; i <= kControlWindow; i++)
+        mWindows[i].mOffset = 0;
+}
+void FslDataSourceReader::SetBufferPool(uint32_t streamNum, const sp<FslBufferPool> &pool)
+{
+    Mutex::Autolock autoLock(mLock);
+    if(streamNum < MAX_TRACK_COUNT)
+        mBufferPools[streamNum] = pool;
+}
+MediaBuffer *FslDataSourceReader::AcquireBuffer(uint32_t streamNum, size_t size)
+{
+    sp<FslBufferPool> pool;
+    {
+        Mutex::Autolock autoLock(mLock);
+        if(streamNum < MAX_TRACK_COUNT)
+            pool = mBufferPools[streamNum];
+    }
+    if(pool == NULL)
+        return new MediaBuffer(size);
+    return pool->acquire(size);
+}
+void FslDataSourceReader::SetCurrentStream_l(uint32_t streamNum)
+{
+    mCurrentWindow = streamNum < MAX_TRACK_COUNT ? streamNum : kControlWindow;
+}
+ssize_t FslDataSourceReader::ReadAt_l(int64_t offset, void *data, size_t size)
+{
+    if(!mReadAhead || size >= kReadAheadSize)
+        return mDataSource->readAt(offset, data, size);
+
+    // the parser often reads the next chunk header right behind another
+    // stream's payload, so look in all windows
+    for(uint32_t i = 0; i <= kControlWindow; i++){
+        const ReadAheadWindow &w = mWindows[i];
+        if(w.mBuffer != NULL && offset >= w.mOffset
+                && offset + (int64_t)size <= w.mOffset + (int64_t)w.mBuffer->size()){
+            memcpy(data, w.mBuffer->data() + (offset - w.mOffset), size);
+            return size;
+        }
+    }
+
+    ReadAheadWindow &w = mWindows[mCurrentWindow];
+    if(w.mBuffer == NULL)
+        w.mBuffer = new ABuffer(kReadAheadSize);
+
+    ssize_t n = mDataSource->readAt(offset, w.mBuffer->base(), kReadAheadSize);
+    if(n <= 0){
+        w.mBuffer->setRange(0, 0);
+        return n;
+    }
+    w.mOffset = offset;
+    w.mBuffer->setRange(0, n);
+
+    if((size_t)n < size)
+        size = n;
+    memcpy(data, w.mBuffer->data(), size);
+    return size;
 }
 bool FslDataSourceReader::isStreaming() const
 {
@@ -807,7 +1027,10 @@ FslExtractor::FslExtractor(const sp<DataSource> &source,const char *mime)
     mReader(new FslDataSourceReader(mDataSource)),
     mMime(strdup(mime)),
     bInit(false),
-    mFileMetaData(new MetaData)
+    mFileMetaData(new MetaData),
+    mDemuxDepth(0),
+    mDemuxSignals(0),
+    mStopDemux(false)
 {
     memset(&mLibName,0,255);
     mLibHandle = NULL;
@@ -822,12 +1045,30 @@ FslExtractor::FslExtractor(const sp<DataSource> &source,const char *mime)
 }
 FslExtractor::~FslExtractor()
 {
+    if(mDemuxThread != NULL){
+        {
+            Mutex::Autolock autoLock(mDemuxLock);
+            mStopDemux = true;
+            mDemuxCondition.broadcast();
+        }
+        mDemuxThread->requestExitAndWait();
+        mDemuxThread.clear();
+    }
+
     if(parserHandle)
     {
         IParser->deleteParser(parserHandle);
         parserHandle = NULL;
     }
 
+    for(size_t i = 0; i < mTracks.size(); i++){
+        TrackInfo *pInfo = &mTracks.editItemAt(i);
+        if(pInfo->buffer != NULL){
+            pInfo->buffer->release();
+            pInfo->buffer = NULL;
+        }
+    }
+
     if(IParser){
         delete IParser;
         IParser = NULL;
@@ -881,8 +1122,10 @@ status_t FslExtractor::Init()
 
     ALOGD("FslExtractor::Init ret=%d",ret);
 
-    if(ret == OK)
+    if(ret == OK){
         bInit = true;
+        StartDemuxing();
+    }
     return ret;
 }
 size_t FslExtractor::countTracks()
@@ -915,6 +1158,7 @@ sp<MediaSource> FslExtractor::getTrack(size_t index)
     source = new FslMediaSource(this,index,meta);
 
     trackInfo->mSource = source;
+    mReader->SetBufferPool(trackInfo->mTrackNum, source->bufferPool());
     source->decStrong(this);
     ALOGE("getTrack source string cnt=%d",source->getStrongCount());
 
@@ -2090,6 +2334,7 @@ status_t FslExtractor::ActiveTrack(uint32 index)
     if(seek)
         IParser->seek(parserHandle, trackInfo->mTrackNum, &seekPos, SEEK_FLAG_NO_LATER);
 
+    SignalDemux();
     ALOGD("start track %d",trackInfo->mTrackNum);
     return OK;
 }
@@ -2116,6 +2361,7 @@ status_t FslExtractor::HandleSeekOperation(uint32_t index,int64_t * ts,uint32_t
     if(ts == NULL)
         return UNKNOWN_ERROR;
 
+    Mutex::Autolock autoLock(mLock);
     target = *ts;
     pInfo = &mTracks.editItemAt(index);
 
@@ -2138,7 +2384,7 @@ status_t FslExtractor::HandleSeekOperation(uint32_t index,int64_t * ts,uint32_t
         //clear temp buffer
 
         if(pInfo->buffer != NULL){
-            pInfo->buffer.clear();
+            pInfo->buffer->release();
             pInfo->buffer = NULL;
         }
         ALOGD("HandleSeekOperation do seek index=%d",index);
@@ -2151,10 +2397,27 @@ status_t FslExtractor::HandleSeekOperation(uint32_t index,int64_t * ts,uint32_t
     else if(pInfo->type == MEDIA_AUDIO)
         currentAudioTs = target;
 
+    if(isDemuxing()){
+        // drop what the demux thread queued before the seek; in file mode
+        // the seek moved all tracks, so they can all continue after an error
+        if(pInfo->mSource != NULL)
+            pInfo->mSource->clearPendingFrames();
+        for(size_t i = 0; i < mTracks.size(); i++){
+            if(i == index || (seek && mReadMode != PARSER_READ_MODE_TRACK_BASED))
+                SetDemuxError_l(i, OK);
+        }
+        SignalDemux();
+    }
+
     ALOGD("HandleSeekOperation index=%d,ts=%lld,flag=%x",index,*ts,flag);
     return OK;
 }
 status_t FslExtractor::GetNextSample(uint32_t index,bool is_sync)
+{
+    Mutex::Autolock autoLock(mLock);
+    return GetNextSample_l(index, is_sync);
+}
+status_t FslExtractor::GetNextSample_l(uint32_t index,bool is_sync)
 {
     int32 err = (int32)PARSER_SUCCESS;
     void * buffer_context = NULL;
@@ -2167,7 +2430,6 @@ status_t FslExtractor::GetNextSample(uint32_t index,bool is_sync)
     uint32 direction = 0;
 
     TrackInfo *pInfo = NULL;
-    Mutex::Autolock autoLock(mLock);
 
     pInfo = &mTracks.editItemAt(index);
     track_num_got = pInfo->mTrackNum;
@@ -2249,58 +2511,56 @@ status_t FslExtractor::GetNextSample(uint32_t index,bool is_sync)
                     break;
                 pInfo = NULL;
             }
-            if(pInfo == NULL)
+            if(pInfo == NULL){
+                if(tmp && buffer_context)
+                    ((MediaBuffer *)buffer_context)->release();
                 continue;
+            }
         }
 
         if(tmp && buffer_context) {
-            sp<ABuffer> buffer = pInfo->buffer;
+            MediaBuffer *buffer = (MediaBuffer *)buffer_context;
 
             if(sampleFlag & FLAG_SAMPLE_NOT_FINISHED)
                 pInfo->bPartial = true;
 
-            if(pInfo->bPartial){
-
-                if(buffer == NULL){
-                    buffer = (ABuffer *)buffer_context;
-                    pInfo->outTs = ts;
-                    pInfo->syncFrame = (sampleFlag & FLAG_SYNC_SAMPLE);
-                    buffer->setRange(0,datasize);
-                    pInfo->buffer = buffer;
-                    ALOGV("bPartial first buffer");
-                }else {
-                    sp<ABuffer> lastBuf = buffer;
-                    sp<ABuffer> currBuf = (ABuffer *)buffer_context;
-                    size_t tempLen = lastBuf->size();
-                    buffer = new ABuffer(tempLen + (size_t)datasize);
-                    memcpy(buffer->data(),lastBuf->data(),tempLen);
-                    memcpy(buffer->data()+tempLen,currBuf->data(),currBuf->size());
-                    lastBuf.clear();
-                    currBuf.clear();
-                    pInfo->buffer = buffer;
-                    ALOGV("bPartial second buffer,");
-                }
-
-                if(!(sampleFlag & FLAG_SAMPLE_NOT_FINISHED))
-                    pInfo->bPartial = false;
-            }
-            else{
-                buffer = (ABuffer *)buffer_context;
+            if(pInfo->bPartial && pInfo->buffer != NULL){
+                MediaBuffer *lastBuf = pInfo->buffer;
+                size_t tempLen = lastBuf->range_length();
+                MediaBuffer *joined = mReader->AcquireBuffer(
+                        track_num_got, tempLen + (size_t)datasize);
+                memcpy(joined->data(), lastBuf->data(), tempLen);
+                memcpy((uint8_t *)joined->data() + tempLen, buffer->data(), datasize);
+                joined->set_range(0, tempLen + (size_t)datasize);
+                lastBuf->release();
+                buffer->release();
+                pInfo->buffer = joined;
+                ALOGV("bPartial second buffer,");
+            }else{
+                if(pInfo->buffer != NULL)
+                    pInfo->buffer->release();
                 pInfo->outTs = ts;
                 pInfo->syncFrame = (sampleFlag & FLAG_SYNC_SAMPLE);
+                buffer->set_range(0, datasize);
                 pInfo->buffer = buffer;
-                buffer->setRange(0,datasize);
+                if(pInfo->bPartial)
+                    ALOGV("bPartial first buffer");
             }
+
+            if(pInfo->bPartial && !(sampleFlag & FLAG_SAMPLE_NOT_FINISHED))
+                pInfo->bPartial = false;
         }else {
             // mpg2 parser often send an empty buffer as the last partial frame.
             if(pInfo->bPartial && !(sampleFlag & FLAG_SAMPLE_NOT_FINISHED))
                 pInfo->bPartial = false;
         }
 
-    }while((sampleFlag & FLAG_SAMPLE_NOT_FINISHED) && (pInfo->buffer->size() < pInfo->max_input_size));
+    }while((sampleFlag & FLAG_SAMPLE_NOT_FINISHED) && (pInfo->buffer->range_length() < pInfo->max_input_size));
 
     if(pInfo && pInfo->buffer != NULL ){
-        sp<FslMediaSource> source = pInfo->mSource;
+        // not a strong reference, so that the demux thread never ends up
+        // destroying a source that was released meanwhile
+        FslMediaSource *source = pInfo->mSource.get();
         bool add = false;
         if(source != NULL  && source->started()){
             add = true;
@@ -2315,17 +2575,21 @@ status_t FslExtractor::GetNextSample(uint32_t index,bool is_sync)
             if(pInfo->bIsNeedConvert) {
                 int32_t bitPerSample = 16;
                 pInfo->mMeta->findInt32(kKeyBitPerSample, &bitPerSample);
-                sp<ABuffer> buffer = pInfo->buffer;
-                sp<ABuffer> tmp = new ABuffer(2 * buffer->size());
-                convertPCMData(buffer, tmp, bitPerSample);
-                pInfo->buffer = tmp;
-                buffer.clear();
+                MediaBuffer *buffer = pInfo->buffer;
+                MediaBuffer *converted = mReader->AcquireBuffer(
+                        track_num_got, 2 * buffer->range_length());
+                sp<ABuffer> in = new ABuffer(buffer->data(), buffer->range_length());
+                sp<ABuffer> out = new ABuffer(converted->data(), 2 * buffer->range_length());
+                convertPCMData(in, out, bitPerSample);
+                converted->set_range(0, out->size());
+                buffer->release();
+                pInfo->buffer = converted;
             }
 
-            MediaBuffer *mbuf = new MediaBuffer(pInfo->buffer);
+            MediaBuffer *mbuf = pInfo->buffer;
             mbuf->meta_data()->setInt64(kKeyTime, pInfo->outTs);
             mbuf->meta_data()->setInt32(kKeyIsSyncFrame, pInfo->syncFrame);
-            ALOGV("addMediaBuffer ts=%lld,size=%d",pInfo->outTs,pInfo->buffer->size());
+            ALOGV("addMediaBuffer ts=%lld,size=%zu",pInfo->outTs,mbuf->range_length());
 
             source->addMediaBuffer(mbuf);
             if(pInfo->type == MEDIA_VIDEO)
@@ -2333,9 +2597,10 @@ status_t FslExtractor::GetNextSample(uint32_t index,bool is_sync)
             else if(pInfo->type == MEDIA_AUDIO)
                 currentAudioTs = pInfo->outTs;
 
+        }else{
+            pInfo->buffer->release();
         }
 
-        pInfo->buffer.clear();
         pInfo->buffer = NULL;
     }
 
@@ -2378,10 +2643,142 @@ status_t FslExtractor::ClearTrackSource(uint32_t index)
     TrackInfo *trackInfo = &mTracks.editItemAt(index);
     if(trackInfo){
         trackInfo->mSource = NULL;
+        mReader->SetBufferPool(trackInfo->mTrackNum, NULL);
     }
     return OK;
 }
 
+struct FslExtractor::DemuxThread : public Thread {
+    DemuxThread(FslExtractor *extractor)
+        : Thread(false /* canCallJava */),
+          mExtractor(extractor) {
+    }
+
+private:
+    FslExtractor *mExtractor;
+
+    virtual bool threadLoop() {
+        return mExtractor->DemuxNextSample();
+    }
+
+    DemuxThread(const DemuxThread &);
+    DemuxThread &operator=(const DemuxThread &);
+};
+
+void FslExtractor::StartDemuxing()
+{
+    char value[PROPERTY_VALUE_MAX];
+    if(!property_get("media.stagefright.fsl-demux-depth", value, NULL))
+        return;
+
+    int depth = atoi(value);
+    if(depth <= 0)
+        return;
+    if(depth > MAX_DEMUX_DEPTH)
+        depth = MAX_DEMUX_DEPTH;
+
+    mDemuxDepth = depth;
+    mDemuxThread = new DemuxThread(this);
+    mDemuxThread->run("FslDemux");
+    ALOGD("FslExtractor demux thread started, depth %zu", mDemuxDepth);
+}
+bool FslExtractor::isDemuxing() const
+{
+    return mDemuxThread != NULL;
+}
+void FslExtractor::SignalDemux()
+{
+    Mutex::Autolock autoLock(mDemuxLock);
+    mDemuxSignals++;
+    mDemuxCondition.signal();
+}
+bool FslExtractor::DemuxNextSample()
+{
+    uint32_t signals;
+    {
+        Mutex::Autolock autoLock(mDemuxLock);
+        if(mStopDemux)
+            return false;
+        signals = mDemuxSignals;
+    }
+
+    // a source that has consumed a frame or a track that was started or
+    // seeked since the signal count was taken signals again, so nothing
+    // is missed while the tracks are examined without mDemuxLock
+    status_t err = OK;
+    {
+        Mutex::Autolock autoLock(mLock);
+        ssize_t index = PickDemuxTrack_l();
+        if(index >= 0){
+            err = GetNextSample_l(index, false);
+            if(err == OK)
+                return true;
+            if(err != WOULD_BLOCK){
+                ALOGV("demux thread got err %d for track %zd", err, index);
+                if(mReadMode == PARSER_READ_MODE_TRACK_BASED){
+                    SetDemuxError_l(index, err);
+                }else{
+                    for(size_t i = 0; i < mTracks.size(); i++)
+                        SetDemuxError_l(i, err);
+                }
+            }
+        }
+    }
+
+    Mutex::Autolock autoLock(mDemuxLock);
+    if(err == WOULD_BLOCK){
+        // the parser is waiting for data
+        mDemuxCondition.waitRelative(mDemuxLock, 10000000ll);
+    }else{
+        while(!mStopDemux && signals == mDemuxSignals)
+            mDemuxCondition.wait(mDemuxLock);
+    }
+    return !mStopDemux;
+}
+// Returns the started track with the fewest queued frames if that is below
+// the demux depth, or -1 if no track needs frames.
+ssize_t FslExtractor::PickDemuxTrack_l()
+{
+    bool fileMode = (mReadMode != PARSER_READ_MODE_TRACK_BASED);
+    bool trackFull = false;
+    ssize_t pick = -1;
+    size_t pickFrames = mDemuxDepth;
+
+    for(size_t i = 0; i < mTracks.size(); i++){
+        FslMediaSource *source = mTracks[i].mSource.get();
+        if(source == NULL || !source->started() || source->demuxError() != OK)
+            continue;
+        if(source->full())
+            trackFull = true;
+        // in file mode subtitles arrive along with the other tracks
+        if(fileMode && mTracks[i].type == MEDIA_TEXT)
+            continue;
+        size_t frames = source->pendingFrames();
+        if(frames < pickFrames){
+            pick = i;
+            pickFrames = frames;
+        }
+    }
+
+    if(pick >= 0 && trackFull && fileMode){
+        // the interleaving is too poor to carry on, see CheckInterleaveEos()
+        for(size_t i = 0; i < mTracks.size(); i++){
+            FslMediaSource *source = mTracks[i].mSource.get();
+            if(source != NULL && source->started() && source->pendingFrames() == 0){
+                ALOGE("get interleave eos");
+                source->setDemuxError(ERROR_END_OF_STREAM);
+            }
+        }
+        return -1;
+    }
+    return pick;
+}
+void FslExtractor::SetDemuxError_l(size_t index,status_t err)
+{
+    FslMediaSource *source = mTracks[index].mSource.get();
+    if(source != NULL)
+        source->setDemuxError(err);
+}
 bool FslExtractor::isTrackModeParser()
 {
     if(!strcmp(mMime, MEDIA_MIMETYPE_CONTAINER_MPEG4) || !strcmp(mMime, MEDIA_MIMETYPE_CONTAINER_AVI))
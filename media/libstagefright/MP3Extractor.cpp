@@ -21,6 +21,7 @@
 #include "include/MP3Extractor.h"
 
 #include "include/avc_utils.h"
+#include "include/FrameScanSeeker.h"
 #include "include/ID3.h"
 #include "include/VBRISeeker.h"
 #include "include/XINGSeeker.h"
@@ -316,6 +317,10 @@ MP3Extractor::MP3Extractor(
         }
         mFirstFramePos = pos;
         mFixedHeader = header;
+    } else {
+        // Without a seek table in the stream, index the frames of local files
+        // so that seeking in VBR streams lands on the right frame.
+        mSeeker = FrameScanSeeker::CreateFromSource(mDataSource, mFirstFramePos, mFixedHeader);
     }
 
     size_t frame_size;
@@ -365,7 +370,9 @@ MP3Extractor::MP3Extractor(
     // Get iTunes-style gapless info if present.
     // When getting the id3 tag, skip the V1 tags to prevent the source cache
     // from being iterated to the end of the file.
-    ID3 id3(mDataSource, true);
+    // Only the comments are needed here, so leave large frames such as album
+    // art in the source.
+    ID3 id3(mDataSource, true /* ignoreV1 */, 0 /* offset */, true /* lazyFrames */);
     if (id3.isValid()) {
         ID3::Iterator *com = new ID3::Iterator(id3, "COM");
         if (com->done()) {
@@ -602,7 +609,7 @@ sp<MetaData> MP3Extractor::getMetaData() {
 
     meta->setCString(kKeyMIMEType, "audio/mpeg");
 
-    ID3 id3(mDataSource);
+    ID3 id3(mDataSource, false /* ignoreV1 */, 0 /* offset */, true /* lazyFrames */);
 
     if (!id3.isValid()) {
         return meta;
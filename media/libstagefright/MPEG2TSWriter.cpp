@@ -476,7 +476,8 @@ MPEG2TSWriter::MPEG2TSWriter(int fd)
       mNumTSPacketsWritten(0),
       mNumTSPacketsBeforeMeta(0),
       mPATContinuityCounter(0),
-      mPMTContinuityCounter(0) {
+      mPMTContinuityCounter(0),
+      mLastPCRTimeUs(-1ll) {
     init();
 }
 
@@ -491,7 +492,8 @@ MPEG2TSWriter::MPEG2TSWriter(
       mNumTSPacketsWritten(0),
       mNumTSPacketsBeforeMeta(0),
       mPATContinuityCounter(0),
-      mPMTContinuityCounter(0) {
+      mPMTContinuityCounter(0),
+      mLastPCRTimeUs(-1ll) {
     init();
 }
 
@@ -500,6 +502,9 @@ void MPEG2TSWriter::init() {
 
     initCrcTable();
 
+    mOutputBuffer = new ABuffer(kOutputBufferSize);
+    mOutputBuffer->setRange(0, 0);
+
     mLooper = new ALooper;
     mLooper->setName("MPEG2TSWriter");
 
@@ -549,6 +554,8 @@ status_t MPEG2TSWriter::start(MetaData * /* param */) {
     mNumSourcesDone = 0;
     mNumTSPacketsWritten = 0;
     mNumTSPacketsBeforeMeta = 0;
+    mLastPCRTimeUs = -1ll;
+    mOutputBuffer->setRange(0, 0);
 
     for (size_t i = 0; i < mSources.size(); ++i) {
         sp<AMessage> notify =
@@ -568,6 +575,12 @@ status_t MPEG2TSWriter::reset() {
     for (size_t i = 0; i < mSources.size(); ++i) {
         mSources.editItemAt(i)->stop();
     }
+
+    // Write out whatever is still buffered, after any notifications the
+    // sources have already queued up.
+    sp<AMessage> response;
+    (new AMessage(kWhatFlushOutput, mReflector))->postAndAwaitResponse(&response);
+
     mStarted = false;
 
     return OK;
@@ -611,7 +624,9 @@ void MPEG2TSWriter::onMessageReceived(const sp<AMessage> &msg) {
                     writeAccessUnit(sourceIndex, buffer);
                 }
 
-                ++mNumSourcesDone;
+                if (++mNumSourcesDone == mSources.size()) {
+                    flushOutput();
+                }
             } else if (what == SourceInfo::kNotifyBuffer) {
                 sp<ABuffer> buffer;
                 CHECK(msg->findBuffer("buffer", &buffer));
@@ -685,6 +700,17 @@ void MPEG2TSWriter::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatFlushOutput:
+        {
+            sp<AReplyToken> replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+
+            flushOutput();
+
+            (new AMessage)->postReply(replyID);
+            break;
+        }
+
         default:
             TRESPASS();
     }
@@ -727,19 +753,16 @@ void MPEG2TSWriter::writeProgramAssociationTable() {
         0x00, 0x00, 0x00, 0x00   // b???? ???? ???? ???? ???? ???? ???? ????
     };
 
-    sp<ABuffer> buffer = new ABuffer(188);
-    memset(buffer->data(), 0xff, buffer->size());
-    memcpy(buffer->data(), kData, sizeof(kData));
+    uint8_t *packet = appendPacket();
+    memcpy(packet, kData, sizeof(kData));
 
     if (++mPATContinuityCounter == 16) {
         mPATContinuityCounter = 0;
     }
-    buffer->data()[3] |= mPATContinuityCounter;
+    packet[3] |= mPATContinuityCounter;
 
-    uint32_t crc = htonl(crc32(&buffer->data()[5], 12));
-    memcpy(&buffer->data()[17], &crc, sizeof(crc));
-
-    CHECK_EQ(internalWrite(buffer->data(), buffer->size()), buffer->size());
+    uint32_t crc = htonl(crc32(&packet[5], 12));
+    memcpy(&packet[17], &crc, sizeof(crc));
 }
 
 void MPEG2TSWriter::writeProgramMap() {
@@ -784,24 +807,22 @@ void MPEG2TSWriter::writeProgramMap() {
         0xe0, 0x00, 0xf0, 0x00   // b111? ???? ???? ???? 1111 0000 0000 0000
     };
 
-    sp<ABuffer> buffer = new ABuffer(188);
-    memset(buffer->data(), 0xff, buffer->size());
-    memcpy(buffer->data(), kData, sizeof(kData));
+    uint8_t *packet = appendPacket();
+    memcpy(packet, kData, sizeof(kData));
 
     if (++mPMTContinuityCounter == 16) {
         mPMTContinuityCounter = 0;
     }
-    buffer->data()[3] |= mPMTContinuityCounter;
+    packet[3] |= mPMTContinuityCounter;
 
     size_t section_length = 5 * mSources.size() + 4 + 9;
-    buffer->data()[6] |= section_length >> 8;
-    buffer->data()[7] = section_length & 0xff;
+    packet[6] |= section_length >> 8;
+    packet[7] = section_length & 0xff;
 
-    static const unsigned kPCR_PID = 0x1e1;
-    buffer->data()[13] |= (kPCR_PID >> 8) & 0x1f;
-    buffer->data()[14] = kPCR_PID & 0xff;
+    packet[13] |= (kPCR_PID >> 8) & 0x1f;
+    packet[14] = kPCR_PID & 0xff;
 
-    uint8_t *ptr = &buffer->data()[sizeof(kData)];
+    uint8_t *ptr = &packet[sizeof(kData)];
     for (size_t i = 0; i < mSources.size(); ++i) {
         *ptr++ = mSources.editItemAt(i)->streamType();
 
@@ -812,10 +833,8 @@ void MPEG2TSWriter::writeProgramMap() {
         *ptr++ = 0x00;
     }
 
-    uint32_t crc = htonl(crc32(&buffer->data()[5], 12+mSources.size()*5));
-    memcpy(&buffer->data()[17+mSources.size()*5], &crc, sizeof(crc));
-
-    CHECK_EQ(internalWrite(buffer->data(), buffer->size()), buffer->size());
+    uint32_t crc = htonl(crc32(&packet[5], 12+mSources.size()*5));
+    memcpy(&packet[17+mSources.size()*5], &crc, sizeof(crc));
 }
 
 void MPEG2TSWriter::writeAccessUnit(
@@ -855,9 +874,6 @@ void MPEG2TSWriter::writeAccessUnit(
     // reserved = b1
     // the first fragment of "buffer" follows
 
-    sp<ABuffer> buffer = new ABuffer(188);
-    memset(buffer->data(), 0xff, buffer->size());
-
     const unsigned PID = 0x1e0 + sourceIndex + 1;
 
     const unsigned continuity_counter =
@@ -871,6 +887,10 @@ void MPEG2TSWriter::writeAccessUnit(
     int64_t timeUs;
     CHECK(accessUnit->meta()->findInt64("timeUs", &timeUs));
 
+    if (mLastPCRTimeUs < 0 || timeUs >= mLastPCRTimeUs + kPCRIntervalUs) {
+        writePCR(timeUs);
+    }
+
     uint32_t PTS = (timeUs * 9ll) / 100ll;
 
     size_t PES_packet_length = accessUnit->size() + 8;
@@ -884,7 +904,8 @@ void MPEG2TSWriter::writeAccessUnit(
         PES_packet_length = 0;
     }
 
-    uint8_t *ptr = buffer->data();
+    uint8_t *packet = appendPacket();
+    uint8_t *ptr = packet;
     *ptr++ = 0x47;
     *ptr++ = 0x40 | (PID >> 8);
     *ptr++ = PID & 0xff;
@@ -912,7 +933,7 @@ void MPEG2TSWriter::writeAccessUnit(
     *ptr++ = (PTS >> 7) & 0xff;
     *ptr++ = ((PTS & 0x7f) << 1) | 1;
 
-    size_t sizeLeft = buffer->data() + buffer->size() - ptr;
+    size_t sizeLeft = packet + kTSPacketSize - ptr;
     size_t copy = accessUnit->size();
     if (copy > sizeLeft) {
         copy = sizeLeft;
@@ -920,8 +941,6 @@ void MPEG2TSWriter::writeAccessUnit(
 
     memcpy(ptr, accessUnit->data(), copy);
 
-    CHECK_EQ(internalWrite(buffer->data(), buffer->size()), buffer->size());
-
     size_t offset = copy;
     while (offset < accessUnit->size()) {
         bool lastAccessUnit = ((accessUnit->size() - offset) < 184);
@@ -936,12 +955,11 @@ void MPEG2TSWriter::writeAccessUnit(
         // continuity_counter = b????
         // the fragment of "buffer" follows.
 
-        memset(buffer->data(), 0xff, buffer->size());
-
         const unsigned continuity_counter =
             mSources.editItemAt(sourceIndex)->incrementContinuityCounter();
 
-        ptr = buffer->data();
+        packet = appendPacket();
+        ptr = packet;
         *ptr++ = 0x47;
         *ptr++ = 0x00 | (PID >> 8);
         *ptr++ = PID & 0xff;
@@ -958,18 +976,64 @@ void MPEG2TSWriter::writeAccessUnit(
             }
         }
 
-        size_t sizeLeft = buffer->data() + buffer->size() - ptr;
+        size_t sizeLeft = packet + kTSPacketSize - ptr;
         size_t copy = accessUnit->size() - offset;
         if (copy > sizeLeft) {
             copy = sizeLeft;
         }
 
         memcpy(ptr, accessUnit->data() + offset, copy);
-        CHECK_EQ(internalWrite(buffer->data(), buffer->size()),
-                 buffer->size());
 
         offset += copy;
     }
+
+    if (mWriteFunc != NULL) {
+        // The callback usually feeds a live consumer, don't hold on to
+        // complete access units.
+        flushOutput();
+    }
+}
+
+void MPEG2TSWriter::writePCR(int64_t timeUs) {
+    // 0x47
+    // transport_error_indicator = b0
+    // payload_unit_start_indicator = b0
+    // transport_priority = b0
+    // PID = b0 0001 0000 0000 (13 bits) [kPCR_PID]
+    // transport_scrambling_control = b00
+    // adaptation_field_control = b10 (adaptation field only, no payload)
+    // continuity_counter = b0000 (not incremented without payload)
+    // adaptation_field_length = 0xb7
+    // discontinuity_indicator = b0
+    // random_access_indicator = b0
+    // elementary_stream_priority_indicator = b0
+    // PCR_flag = b1
+    // OPCR_flag = b0
+    // splicing_point_flag = b0
+    // transport_private_data_flag = b0
+    // adaptation_field_extension_flag = b0
+    // program_clock_reference_base = b? ???? ???? ... (33 bits, 90kHz)
+    // reserved = b111111
+    // program_clock_reference_extension = b0 0000 0000 (9 bits)
+    // stuffing bytes follow
+
+    uint64_t PCR = (timeUs * 9ll) / 100ll;
+
+    uint8_t *ptr = appendPacket();
+    *ptr++ = 0x47;
+    *ptr++ = kPCR_PID >> 8;
+    *ptr++ = kPCR_PID & 0xff;
+    *ptr++ = 0x20;
+    *ptr++ = kTSPacketSize - 5;
+    *ptr++ = 0x10;
+    *ptr++ = (PCR >> 25) & 0xff;
+    *ptr++ = (PCR >> 17) & 0xff;
+    *ptr++ = (PCR >> 9) & 0xff;
+    *ptr++ = (PCR >> 1) & 0xff;
+    *ptr++ = ((PCR & 1) << 7) | 0x7e;
+    *ptr++ = 0x00;
+
+    mLastPCRTimeUs = timeUs;
 }
 
 void MPEG2TSWriter::writeTS() {
@@ -1008,6 +1072,31 @@ uint32_t MPEG2TSWriter::crc32(const uint8_t *p_start, size_t length) {
     return crc;
 }
 
+uint8_t *MPEG2TSWriter::appendPacket() {
+    if (mOutputBuffer->size() + kTSPacketSize > mOutputBuffer->capacity()) {
+        flushOutput();
+    }
+
+    uint8_t *packet = mOutputBuffer->data() + mOutputBuffer->size();
+    mOutputBuffer->setRange(0, mOutputBuffer->size() + kTSPacketSize);
+    memset(packet, 0xff, kTSPacketSize);
+
+    ++mNumTSPacketsWritten;
+
+    return packet;
+}
+
+void MPEG2TSWriter::flushOutput() {
+    if (mOutputBuffer->size() == 0) {
+        return;
+    }
+
+    CHECK_EQ(internalWrite(mOutputBuffer->data(), mOutputBuffer->size()),
+             (ssize_t)mOutputBuffer->size());
+
+    mOutputBuffer->setRange(0, 0);
+}
+
 ssize_t MPEG2TSWriter::internalWrite(const void *data, size_t size) {
     if (mFile != NULL) {
         return fwrite(data, 1, size, mFile);
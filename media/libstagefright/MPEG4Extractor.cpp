@@ -39,6 +39,7 @@
 #include <media/stagefright/MediaDefs.h>
 #include <media/stagefright/MediaSource.h>
 #include <media/stagefright/MetaData.h>
+#include <utils/List.h>
 #include <utils/String8.h>
 
 #include <byteswap.h>
@@ -50,6 +51,8 @@
 
 namespace android {
 
+struct MPEG4DataSource;
+
 class MPEG4Source : public MediaSource {
 public:
     // Caller retains ownership of both "dataSource" and "sampleTable".
@@ -80,6 +83,8 @@ private:
     sp<MPEG4Extractor> mOwner;
     sp<MetaData> mFormat;
     sp<DataSource> mDataSource;
+    // for fragmented files, wraps the extractor's source and holds the current fragment
+    sp<MPEG4DataSource> mFragmentSource;
     int32_t mTimescale;
     sp<SampleTable> mSampleTable;
     uint32_t mCurrentSampleIndex;
@@ -121,6 +126,14 @@ private:
     uint8_t *mSrcBuffer;
 
     size_t parseNALSize(const uint8_t *data) const;
+
+    // Reads |size| bytes of sample data at |offset| for NAL unit conversion.
+    // *data points into the caching source's own page if the sample lies
+    // within one, |view| then keeps it alive; otherwise into mSrcBuffer.
+    ssize_t readSrcData(
+            off64_t offset, size_t size, const uint8_t **data, sp<ABuffer> *view);
+
+    void readAheadFragment(off64_t moofOffset);
     status_t parseChunk(off64_t *offset);
     status_t parseTrackFragmentHeader(off64_t offset, off64_t size);
     status_t parseTrackFragmentRun(off64_t offset, off64_t size);
@@ -178,9 +191,13 @@ struct MPEG4DataSource : public DataSource {
     virtual ssize_t readAt(off64_t offset, void *data, size_t size);
     virtual status_t getSize(off64_t *size);
     virtual uint32_t flags();
+    virtual String8 getFileIdentity();
 
     status_t setCachedRange(off64_t offset, size_t size);
 
+    // serves [offset, offset + buffer->size()) from buffer, which may be shared
+    void setCachedBuffer(off64_t offset, const sp<ABuffer> &buffer);
+
 protected:
     virtual ~MPEG4DataSource();
 
@@ -190,7 +207,7 @@ private:
     sp<DataSource> mSource;
     off64_t mCachedOffset;
     size_t mCachedSize;
-    uint8_t *mCache;
+    sp<ABuffer> mCache;
 
     void clearCache();
 
@@ -201,8 +218,7 @@ private:
 MPEG4DataSource::MPEG4DataSource(const sp<DataSource> &source)
     : mSource(source),
       mCachedOffset(0),
-      mCachedSize(0),
-      mCache(NULL) {
+      mCachedSize(0) {
 }
 
 MPEG4DataSource::~MPEG4DataSource() {
@@ -210,11 +226,7 @@ MPEG4DataSource::~MPEG4DataSource() {
 }
 
 void MPEG4DataSource::clearCache() {
-    if (mCache) {
-        free(mCache);
-        mCache = NULL;
-    }
-
+    mCache.clear();
     mCachedOffset = 0;
     mCachedSize = 0;
 }
@@ -227,7 +239,7 @@ ssize_t MPEG4DataSource::readAt(off64_t offset, void *data, size_t size) {
     Mutex::Autolock autoLock(mLock);
 
     if (isInRange(mCachedOffset, mCachedSize, offset, size)) {
-        memcpy(data, &mCache[offset - mCachedOffset], size);
+        memcpy(data, mCache->data() + (offset - mCachedOffset), size);
         return size;
     }
 
@@ -242,21 +254,26 @@ uint32_t MPEG4DataSource::flags() {
     return mSource->flags();
 }
 
+String8 MPEG4DataSource::getFileIdentity() {
+    return mSource->getFileIdentity();
+}
+
 status_t MPEG4DataSource::setCachedRange(off64_t offset, size_t size) {
     Mutex::Autolock autoLock(mLock);
 
     clearCache();
 
-    mCache = (uint8_t *)malloc(size);
+    mCache = new ABuffer(size);
 
-    if (mCache == NULL) {
+    if (mCache->data() == NULL) {
+        mCache.clear();
         return -ENOMEM;
     }
 
     mCachedOffset = offset;
     mCachedSize = size;
 
-    ssize_t err = mSource->readAt(mCachedOffset, mCache, mCachedSize);
+    ssize_t err = mSource->readAt(mCachedOffset, mCache->data(), mCachedSize);
 
     if (err < (ssize_t)size) {
         clearCache();
@@ -267,6 +284,83 @@ status_t MPEG4DataSource::setCachedRange(off64_t offset, size_t size) {
     return OK;
 }
 
+void MPEG4DataSource::setCachedBuffer(off64_t offset, const sp<ABuffer> &buffer) {
+    Mutex::Autolock autoLock(mLock);
+
+    clearCache();
+
+    mCache = buffer;
+    mCachedOffset = offset;
+    mCachedSize = buffer->size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Process wide cache of the 'moov' boxes of recently opened local files.
+// Reopening a file (e.g. when a media library scans, thumbnails and then
+// plays it) parses the sample tables from memory instead of re-reading
+// them from storage.  Entries are keyed by DataSource::getFileIdentity(),
+// which changes whenever the file is modified.
+struct MoovCache {
+    static const size_t kMaxEntrySize = 4 * 1024 * 1024;
+    static const size_t kMaxTotalSize = 16 * 1024 * 1024;
+
+    static sp<ABuffer> lookup(const String8 &identity, off64_t offset, size_t size);
+    static void insert(const String8 &identity, off64_t offset, const sp<ABuffer> &buffer);
+
+private:
+    struct Entry {
+        String8 mKey;
+        sp<ABuffer> mBuffer;
+    };
+
+    static Mutex sLock;
+    static List<Entry> sEntries;  // most recently used first
+    static size_t sTotalSize;
+
+    static String8 makeKey(const String8 &identity, off64_t offset, size_t size) {
+        return String8::format("%s@%lld+%zu", identity.string(), (long long)offset, size);
+    }
+};
+
+Mutex MoovCache::sLock;
+List<MoovCache::Entry> MoovCache::sEntries;
+size_t MoovCache::sTotalSize = 0;
+
+// static
+sp<ABuffer> MoovCache::lookup(const String8 &identity, off64_t offset, size_t size) {
+    Mutex::Autolock autoLock(sLock);
+
+    String8 key = makeKey(identity, offset, size);
+    for (List<Entry>::iterator it = sEntries.begin(); it != sEntries.end(); ++it) {
+        if (it->mKey == key) {
+            Entry entry = *it;
+            sEntries.erase(it);
+            sEntries.push_front(entry);
+            return entry.mBuffer;
+        }
+    }
+
+    return NULL;
+}
+
+// static
+void MoovCache::insert(const String8 &identity, off64_t offset, const sp<ABuffer> &buffer) {
+    Mutex::Autolock autoLock(sLock);
+
+    Entry entry;
+    entry.mKey = makeKey(identity, offset, buffer->size());
+    entry.mBuffer = buffer;
+    sEntries.push_front(entry);
+    sTotalSize += buffer->size();
+
+    while (sTotalSize > kMaxTotalSize) {
+        List<Entry>::iterator last = --sEntries.end();
+        sTotalSize -= last->mBuffer->size();
+        sEntries.erase(last);
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 static const bool kUseHexDump = false;
@@ -852,6 +946,31 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
         return OK;
     }
 
+    if (chunk_type == FOURCC('m', 'o', 'o', 'v') && depth == 0
+            && chunk_size <= MoovCache::kMaxEntrySize) {
+        // Serve the whole 'moov' box from memory while it is parsed, and keep
+        // it around so reopening the same file skips the reads.
+        String8 identity = mDataSource->getFileIdentity();
+        if (!identity.isEmpty()) {
+            sp<ABuffer> moov = MoovCache::lookup(identity, *offset, chunk_size);
+            if (moov == NULL) {
+                moov = new ABuffer(chunk_size);
+                if (moov->data() != NULL
+                        && mDataSource->readAt(*offset, moov->data(), chunk_size)
+                                == (ssize_t)chunk_size) {
+                    MoovCache::insert(identity, *offset, moov);
+                } else {
+                    moov.clear();
+                }
+            }
+            if (moov != NULL) {
+                sp<MPEG4DataSource> cachedSource = new MPEG4DataSource(mDataSource);
+                cachedSource->setCachedBuffer(*offset, moov);
+                mDataSource = cachedSource;
+            }
+        }
+    }
+
     switch(chunk_type) {
         case FOURCC('m', 'o', 'o', 'v'):
         case FOURCC('t', 'r', 'a', 'k'):
@@ -3319,7 +3438,11 @@ MPEG4Source::MPEG4Source(
     CHECK(format->findInt32(kKeyTrackID, &mTrackId));
 
     if (mFirstMoofOffset != 0) {
+        mFragmentSource = new MPEG4DataSource(mDataSource);
+        mDataSource = mFragmentSource;
+
         off64_t offset = mFirstMoofOffset;
+        readAheadFragment(offset);
         parseChunk(&offset);
     }
 }
@@ -3393,6 +3516,55 @@ status_t MPEG4Source::stop() {
     return OK;
 }
 
+// Returns the size and type of the box at offset, or false if it can't be read.
+static bool readBoxHeader(
+        const sp<DataSource> &source, off64_t offset, uint64_t *size, uint32_t *type) {
+    uint32_t hdr[2];
+    if (source->readAt(offset, hdr, 8) < 8) {
+        return false;
+    }
+    *size = ntohl(hdr[0]);
+    *type = ntohl(hdr[1]);
+    if (*size == 1) {
+        if (source->readAt(offset + 8, size, 8) < 8) {
+            return false;
+        }
+        *size = ntoh64(*size);
+    }
+    return *size >= 8;
+}
+
+// Reads the moof at moofOffset together with the mdat that follows it, if
+// that fits in kMaxFragmentReadAheadSize, using a single read.  Parsing the
+// fragment's many small boxes and reading its samples are then served from
+// memory instead of issuing a DataSource read each.
+void MPEG4Source::readAheadFragment(off64_t moofOffset) {
+    static const uint64_t kMaxFragmentReadAheadSize = 2 * 1024 * 1024;
+
+    if (mFragmentSource == NULL) {
+        return;
+    }
+
+    uint64_t moofSize, mdatSize;
+    uint32_t type;
+    if (!readBoxHeader(mDataSource, moofOffset, &moofSize, &type)
+            || type != FOURCC('m', 'o', 'o', 'f')
+            || moofSize > kMaxFragmentReadAheadSize) {
+        return;
+    }
+
+    uint64_t size = moofSize;
+    if (readBoxHeader(mDataSource, moofOffset + moofSize, &mdatSize, &type)
+            && type == FOURCC('m', 'd', 'a', 't')
+            && mdatSize <= kMaxFragmentReadAheadSize - moofSize) {
+        size += mdatSize;
+    }
+
+    if (mFragmentSource->setCachedRange(moofOffset, size) != OK) {
+        ALOGV("fragment read ahead of %" PRIu64 " bytes failed", size);
+    }
+}
+
 status_t MPEG4Source::parseChunk(off64_t *offset) {
     uint32_t hdr[2];
     if (mDataSource->readAt(*offset, hdr, 8) < 8) {
@@ -3904,6 +4076,11 @@ status_t MPEG4Source::parseTrackFragmentRun(off64_t offset, off64_t size) {
         return -EINVAL;
     }
 
+    if (bytesPerSample > 0) {
+        // sampleCount is bounded by the box size here, grow the vector once
+        mCurrentSamples.setCapacity(mCurrentSamples.size() + sampleCount);
+    }
+
     Sample tmp;
     for (uint32_t i = 0; i < sampleCount; ++i) {
         if (flags & kSampleDurationPresent) {
@@ -3978,6 +4155,35 @@ size_t MPEG4Source::parseNALSize(const uint8_t *data) const {
     return 0;
 }
 
+ssize_t MPEG4Source::readSrcData(
+        off64_t offset, size_t size, const uint8_t **data, sp<ABuffer> *view) {
+    *data = mSrcBuffer;
+
+    if (!(mDataSource->flags() & DataSource::kIsCachingDataSource)) {
+        return mDataSource->readAt(offset, mSrcBuffer, size);
+    }
+
+    Vector<sp<ABuffer> > views;
+    ssize_t n = mDataSource->readAtViews(offset, size, &views);
+    if (n < (ssize_t)size) {
+        return n;
+    }
+
+    if (views.size() == 1) {
+        *view = views[0];
+        *data = (*view)->data();
+        return n;
+    }
+
+    // the sample straddles cache pages
+    size_t copied = 0;
+    for (size_t i = 0; i < views.size(); ++i) {
+        memcpy(mSrcBuffer + copied, views[i]->data(), views[i]->size());
+        copied += views[i]->size();
+    }
+    return n;
+}
+
 status_t MPEG4Source::read(
         MediaBuffer **out, const ReadOptions *options) {
     Mutex::Autolock autoLock(mLock);
@@ -4185,11 +4391,13 @@ status_t MPEG4Source::read(
         ssize_t num_bytes_read = 0;
         int32_t drm = 0;
         bool usesDRM = (mFormat->findInt32(kKeyIsDRM, &drm) && drm != 0);
+        const uint8_t *srcData = mSrcBuffer;
+        sp<ABuffer> srcView;
         if (usesDRM) {
             num_bytes_read =
                 mDataSource->readAt(offset, (uint8_t*)mBuffer->data(), size);
         } else {
-            num_bytes_read = mDataSource->readAt(offset, mSrcBuffer, size);
+            num_bytes_read = readSrcData(offset, size, &srcData, &srcView);
         }
 
         if (num_bytes_read < (ssize_t)size) {
@@ -4212,7 +4420,7 @@ status_t MPEG4Source::read(
                 bool isMalFormed = !isInRange((size_t)0u, size, srcOffset, mNALLengthSize);
                 size_t nalLength = 0;
                 if (!isMalFormed) {
-                    nalLength = parseNALSize(&mSrcBuffer[srcOffset]);
+                    nalLength = parseNALSize(&srcData[srcOffset]);
                     srcOffset += mNALLengthSize;
                     isMalFormed = !isInRange((size_t)0u, size, srcOffset, nalLength);
                 }
@@ -4234,7 +4442,7 @@ status_t MPEG4Source::read(
                 dstData[dstOffset++] = 0;
                 dstData[dstOffset++] = 0;
                 dstData[dstOffset++] = 1;
-                memcpy(&dstData[dstOffset], &mSrcBuffer[srcOffset], nalLength);
+                memcpy(&dstData[dstOffset], &srcData[srcOffset], nalLength);
                 srcOffset += nalLength;
                 dstOffset += nalLength;
             }
@@ -4306,6 +4514,7 @@ status_t MPEG4Source::fragmentedRead(
             mCurrentMoofOffset = totalOffset;
             mCurrentSamples.clear();
             mCurrentSampleIndex = 0;
+            readAheadFragment(totalOffset);
             parseChunk(&totalOffset);
             mCurrentTime = totalTime * mTimescale / 1000000ll;
         } else {
@@ -4314,6 +4523,7 @@ status_t MPEG4Source::fragmentedRead(
             mCurrentSamples.clear();
             mCurrentSampleIndex = 0;
             off64_t tmp = mCurrentMoofOffset;
+            readAheadFragment(tmp);
             parseChunk(&tmp);
             mCurrentTime = 0;
         }
@@ -4343,6 +4553,7 @@ status_t MPEG4Source::fragmentedRead(
             mCurrentMoofOffset = nextMoof;
             mCurrentSamples.clear();
             mCurrentSampleIndex = 0;
+            readAheadFragment(nextMoof);
             parseChunk(&nextMoof);
             if (mCurrentSampleIndex >= mCurrentSamples.size()) {
                 return ERROR_END_OF_STREAM;
@@ -4504,7 +4715,13 @@ status_t MPEG4Source::fragmentedRead(
             }
             return ERROR_MALFORMED;
         }
-        num_bytes_read = mDataSource->readAt(offset, data, size);
+        const uint8_t *srcData = mSrcBuffer;
+        sp<ABuffer> srcView;
+        if (usesDRM) {
+            num_bytes_read = mDataSource->readAt(offset, data, size);
+        } else {
+            num_bytes_read = readSrcData(offset, size, &srcData, &srcView);
+        }
 
         if (num_bytes_read < (ssize_t)size) {
             mBuffer->release();
@@ -4527,7 +4744,7 @@ status_t MPEG4Source::fragmentedRead(
                 isMalFormed = !isInRange((size_t)0u, size, srcOffset, mNALLengthSize);
                 size_t nalLength = 0;
                 if (!isMalFormed) {
-                    nalLength = parseNALSize(&mSrcBuffer[srcOffset]);
+                    nalLength = parseNALSize(&srcData[srcOffset]);
                     srcOffset += mNALLengthSize;
                     isMalFormed = !isInRange((size_t)0u, size, srcOffset, nalLength)
                             || !isInRange((size_t)0u, mBuffer->size(), dstOffset, (size_t)4u)
@@ -4559,7 +4776,7 @@ status_t MPEG4Source::fragmentedRead(
                 dstData[dstOffset++] = 0;
                 dstData[dstOffset++] = 0;
                 dstData[dstOffset++] = 1;
-                memcpy(&dstData[dstOffset], &mSrcBuffer[srcOffset], nalLength);
+                memcpy(&dstData[dstOffset], &srcData[srcOffset], nalLength);
                 srcOffset += nalLength;
                 dstOffset += nalLength;
             }
@@ -20,10 +20,13 @@
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <limits.h>
+#include <linux/falloc.h>
 #include <pthread.h>
 #include <sys/prctl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include <utils/Log.h>
@@ -56,7 +59,32 @@
 namespace android {
 
 static const int64_t kMinStreamableFileSizeInBytes = 5 * 1024 * 1024;
+
+// Chunks written by a single pass of the writer thread
+static const size_t kMaxChunksPerWrite = 16;
+
+// If set to a number of MB, the file is preallocated (without changing its
+// size) that far ahead of the write offset.  Reduces fragmentation and
+// metadata updates on slow storage.
+static const char *kPreallocationProperty = "media.mp4writer.prealloc-mb";
+
+// If true, streamable files stay streamable when the moov box does not fit
+// in the space reserved for it: the mdat is moved up by the difference at
+// stop, with one pass over the media data.
+static const char *kFaststartProperty = "media.mp4writer.faststart";
+
+// Block size used to move the mdat, and alignment of the distance moved
+static const size_t kMdatRelocationBlockSize = 1024 * 1024;
+static const off64_t kMdatRelocationAlignment = 4096;
 static const int64_t kMax32BitFileSize = 0x00ffffffffLL; // 2^32-1 : max FAT32
+
+// Fragmented mode: each fragment is a moof box with one traf, holding mfhd,
+// tfhd, tfdt (version 1) and a trun (version 1) with all per sample fields,
+// followed by the mdat box header.
+static const size_t kFragmentHeaderSize = 8 + 16 + 8 + 16 + 20 + 20 + 8;
+static const size_t kFragmentSampleEntrySize = 16;
+static const uint32_t kSyncSampleFlags = 0x02000000;     // depends on no other sample
+static const uint32_t kNonSyncSampleFlags = 0x01010000;  // depends on others, non sync
                                                          // filesystem file size
                                                          // used by most SD cards
 static const uint8_t kNalUnitTypeSeqParamSet = 0x07;
@@ -92,7 +120,12 @@ public:
     bool isAudio() const { return mIsAudio; }
     bool isMPEG4() const { return mIsMPEG4; }
     void addChunkOffset(off64_t offset);
+    void shiftChunkOffsets(off64_t delta);
     int32_t getTrackId() const { return mTrackId; }
+    int32_t getStartTimeOffsetScaledTime() const;
+
+    // Simple validation on the codec specific data
+    status_t checkCodecSpecificData() const;
     status_t dump(int fd, const Vector<String16>& args) const;
     static const char *getFourCCForMime(const char *mime);
 
@@ -210,6 +243,23 @@ private:
             }
         }
 
+        // Replace every value v by adjust(v, delta).
+        // @arg adjust takes and returns values in network byte order.
+        void adjust(TYPE (*adjust)(TYPE, off64_t), off64_t delta) {
+            uint32_t nValues = mTotalNumTableEntries * mEntryCapacity + mNumValuesInCurrEntry;
+            for (typename List<TYPE *>::iterator it = mTableEntryList.begin();
+                it != mTableEntryList.end() && nValues > 0; ++it) {
+                uint32_t n = mElementCapacity * mEntryCapacity;
+                if (n > nValues) {
+                    n = nValues;
+                }
+                for (uint32_t i = 0; i < n; ++i) {
+                    (*it)[i] = adjust((*it)[i], delta);
+                }
+                nValues -= n;
+            }
+        }
+
         // Return the number of entries in the table.
         uint32_t count() const { return mTotalNumTableEntries; }
 
@@ -236,6 +286,7 @@ private:
     bool mIsAvc;
     bool mIsAudio;
     bool mIsMPEG4;
+    bool mCanRetainSourceBuffers;
     int32_t mTrackId;
     int64_t mTrackDurationUs;
     int64_t mMaxChunkDurationUs;
@@ -248,6 +299,12 @@ private:
 
 
     List<MediaBuffer *> mChunkSamples;
+    uint32_t            mNumSamples;
+    uint32_t            mNumSyncSamples;
+
+    // Fragmented mode only, see Chunk
+    int64_t                 mChunkDecodingTimeTicks;
+    Vector<FragmentSample>  mFragmentSamples;
 
     bool                mSamplesHaveSameSize;
     ListTableEntries<uint32_t> *mStszTableEntries;
@@ -291,8 +348,6 @@ private:
     // Update the audio track's drift information.
     void updateDriftTime(const sp<MetaData>& meta);
 
-    int32_t getStartTimeOffsetScaledTime() const;
-
     static void *ThreadWrapper(void *me);
     status_t threadEntry();
 
@@ -315,8 +370,6 @@ private:
     // value, the user-supplied time scale will be used.
     void setTimeScale();
 
-    // Simple validation on the codec specific data
-    status_t checkCodecSpecificData() const;
     int32_t mRotation;
 
     void updateTrackSizeEstimate();
@@ -385,7 +438,14 @@ MPEG4Writer::MPEG4Writer(int fd)
       mLongitudex10000(0),
       mAreGeoTagsAvailable(false),
       mStartTimeOffsetMs(-1),
-      mMetaKeys(new AMessage()) {
+      mMetaKeys(new AMessage()),
+      mPreallocationSize(0),
+      mPreallocatedOffset(0),
+      mFaststart(false),
+      mMoovBoxBufferSize(0),
+      mFragmented(false),
+      mFragmentedMoovWritten(false),
+      mFragmentSequenceNumber(0) {
     addDeviceMeta();
 
     // Verify mFd is seekable
@@ -417,6 +477,17 @@ status_t MPEG4Writer::dump(
     result.append(buffer);
     snprintf(buffer, SIZE, "     mStarted: %s\n", mStarted? "true": "false");
     result.append(buffer);
+    {
+        Mutex::Autolock autoLock(mLock);
+        for (List<ChunkInfo>::iterator it = mChunkInfos.begin();
+             it != mChunkInfos.end(); ++it) {
+            snprintf(buffer, SIZE, "     %s track chunks: %zu queued, %zu max queued,"
+                    " %" PRId64 " us max write\n",
+                    it->mTrack->isAudio()? "Audio": "Video", it->mQueuedChunks,
+                    it->mMaxQueuedChunks, it->mMaxWriteTimeUs);
+            result.append(buffer);
+        }
+    }
     ::write(fd, result.string(), result.size());
     for (List<Track *>::iterator it = mTracks.begin();
          it != mTracks.end(); ++it) {
@@ -435,7 +506,7 @@ status_t MPEG4Writer::Track::dump(
     snprintf(buffer, SIZE, "       reached EOS: %s\n",
             mReachedEOS? "true": "false");
     result.append(buffer);
-    snprintf(buffer, SIZE, "       frames encoded : %d\n", mStszTableEntries->count());
+    snprintf(buffer, SIZE, "       frames encoded : %d\n", mNumSamples);
     result.append(buffer);
     snprintf(buffer, SIZE, "       duration encoded : %" PRId64 " us\n", mTrackDurationUs);
     result.append(buffer);
@@ -687,6 +758,17 @@ status_t MPEG4Writer::start(MetaData *param) {
         return OK;
     }
 
+    int64_t fragmentDurationUs;
+    if (param &&
+        param->findInt64(kKeyFragmentDurationUs, &fragmentDurationUs) &&
+        fragmentDurationUs > 0) {
+        // Chunks are cut at the fragment duration and each one becomes a fragment
+        mFragmented = true;
+        mInterleaveDurationUs =
+            fragmentDurationUs < UINT32_MAX ? fragmentDurationUs : UINT32_MAX;
+        ALOGV("fragment duration: %u us", mInterleaveDurationUs);
+    }
+
     if (!param ||
         !param->findInt32(kKeyTimeScale, &mTimeScale)) {
         mTimeScale = 1000;
@@ -701,7 +783,8 @@ status_t MPEG4Writer::start(MetaData *param) {
      * whether the actual recorded file is streamable or not.
      */
     mStreamableFile =
-        (mMaxFileSizeLimitBytes != 0 &&
+        (!mFragmented &&
+         mMaxFileSizeLimitBytes != 0 &&
          mMaxFileSizeLimitBytes >= kMinStreamableFileSizeInBytes);
 
     /*
@@ -768,7 +851,24 @@ status_t MPEG4Writer::start(MetaData *param) {
 
     mOffset = mMdatOffset;
     lseek64(mFd, mMdatOffset, SEEK_SET);
-    if (mUse32BitOffset) {
+
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get(kPreallocationProperty, value, NULL) > 0) {
+        mPreallocationSize = (off64_t)atoi(value) * 1024 * 1024;
+        if (mPreallocationSize < 0) {
+            mPreallocationSize = 0;
+        }
+    }
+    mPreallocatedOffset = 0;
+
+    mFaststart = property_get(kFaststartProperty, value, NULL)
+            && (!strcasecmp(value, "true") || !strcasecmp(value, "1"));
+    if (mFragmented) {
+        // The moov box and the fragments follow the ftyp box, see
+        // writeChunksToFile()
+        mFragmentedMoovWritten = false;
+        mFragmentSequenceNumber = 0;
+    } else if (mUse32BitOffset) {
         write("????mdat", 8);
     } else {
         write("\x00\x00\x00\x01mdat????????", 16);
@@ -880,6 +980,14 @@ void MPEG4Writer::writeCompositionMatrix(int degrees) {
 }
 
 void MPEG4Writer::release() {
+    if (mPreallocatedOffset > 0) {
+        // give back the blocks preallocated beyond the end of the file
+        off64_t end = lseek64(mFd, 0, SEEK_END);
+        if (end >= 0 && ftruncate64(mFd, end) != 0) {
+            ALOGW("cannot trim preallocated space: %s", strerror(errno));
+        }
+        mPreallocatedOffset = 0;
+    }
     close(mFd);
     mFd = -1;
     mInitCheck = NO_INIT;
@@ -934,6 +1042,14 @@ status_t MPEG4Writer::reset() {
         return err;
     }
 
+    // Every fragment is complete as soon as it is written, there is
+    // neither an mdat size nor a moov box left to write.
+    if (mFragmented) {
+        CHECK(mBoxes.empty());
+        release();
+        return err;
+    }
+
     // Fix up the size of the 'mdat' chunk.
     if (mUse32BitOffset) {
         lseek64(mFd, mMdatOffset, SEEK_SET);
@@ -956,9 +1072,29 @@ status_t MPEG4Writer::reset() {
 
         mMoovBoxBuffer = (uint8_t *) malloc(mEstimatedMoovBoxSize);
         CHECK(mMoovBoxBuffer != NULL);
+        mMoovBoxBufferSize = mEstimatedMoovBoxSize;
     }
     writeMoovBox(maxDurationUs);
 
+    // In faststart mode the moov box stays in memory even when it outgrows
+    // the reserved space.  Move the mdat up to make room for it.
+    if (mWriteMoovBoxToMemory && mMoovBoxBufferOffset + 8 > mEstimatedMoovBoxSize) {
+        off64_t delta = mMoovBoxBufferOffset + 8 - mEstimatedMoovBoxSize;
+        delta = (delta + kMdatRelocationAlignment - 1)
+                / kMdatRelocationAlignment * kMdatRelocationAlignment;
+        if (relocateMdat(delta)) {
+            // Only the chunk offsets change, not the size of the moov box.
+            mEstimatedMoovBoxSize += delta;
+            mMoovBoxBufferOffset = 0;
+            writeMoovBox(maxDurationUs);
+        } else {
+            mWriteMoovBoxToMemory = false;
+            lseek64(mFd, mOffset, SEEK_SET);
+            ::write(mFd, mMoovBoxBuffer, mMoovBoxBufferOffset);
+            mOffset += mMoovBoxBufferOffset;
+        }
+    }
+
     // mWriteMoovBoxToMemory could be set to false in
     // MPEG4Writer::write() method
     if (mWriteMoovBoxToMemory) {
@@ -994,6 +1130,47 @@ status_t MPEG4Writer::reset() {
     return err;
 }
 
+bool MPEG4Writer::relocateMdat(off64_t delta) {
+    if (mUse32BitOffset && mOffset + delta > kMax32BitFileSize) {
+        ALOGW("cannot move the mdat by %" PRId64 " bytes with 32 bit offsets", delta);
+        return false;
+    }
+
+    uint8_t *buffer = (uint8_t *) malloc(kMdatRelocationBlockSize);
+    if (buffer == NULL) {
+        return false;
+    }
+
+    ALOGI("moving %" PRId64 " bytes of media data by %" PRId64 " bytes for the moov box",
+            mOffset - mMdatOffset, delta);
+
+    // Copy from the end backwards, the destination overlaps the source.
+    off64_t end = mOffset;
+    while (end > mMdatOffset) {
+        size_t n = kMdatRelocationBlockSize;
+        if ((off64_t)n > end - mMdatOffset) {
+            n = end - mMdatOffset;
+        }
+        off64_t start = end - n;
+        if (pread64(mFd, buffer, n, start) != (ssize_t)n
+                || pwrite64(mFd, buffer, n, start + delta) != (ssize_t)n) {
+            // The part already moved has overwritten the original data.
+            ALOGE("failed to move the mdat: %s", strerror(errno));
+            free(buffer);
+            return false;
+        }
+        end = start;
+    }
+    free(buffer);
+
+    for (List<Track *>::iterator it = mTracks.begin(); it != mTracks.end(); ++it) {
+        (*it)->shiftChunkOffsets(delta);
+    }
+    mMdatOffset += delta;
+    mOffset += delta;
+    return true;
+}
+
 uint32_t MPEG4Writer::getMpeg4Time() {
     time_t now = time(NULL);
     // MP4 file uses time counting seconds since midnight, Jan. 1, 1904
@@ -1040,9 +1217,28 @@ void MPEG4Writer::writeMoovBox(int64_t durationUs) {
         it != mTracks.end(); ++it, ++id) {
         (*it)->writeTrackHeader(mUse32BitOffset);
     }
+    if (mFragmented) {
+        writeMvexBox();
+    }
     endBox();  // moov
 }
 
+void MPEG4Writer::writeMvexBox() {
+    beginBox("mvex");
+    for (List<Track *>::iterator it = mTracks.begin();
+        it != mTracks.end(); ++it) {
+        beginBox("trex");
+        writeInt32(0);                    // version=0, flags=0
+        writeInt32((*it)->getTrackId());  // track id
+        writeInt32(1);                    // default sample description index
+        writeInt32(0);                    // default sample duration
+        writeInt32(0);                    // default sample size
+        writeInt32(0);                    // default sample flags
+        endBox();  // trex
+    }
+    endBox();  // mvex
+}
+
 void MPEG4Writer::writeFtypBox(MetaData *param) {
     beginBox("ftyp");
 
@@ -1090,6 +1286,12 @@ void MPEG4Writer::sendSessionSummary() {
         notify(MEDIA_RECORDER_TRACK_EVENT_INFO,
                 trackNum | MEDIA_RECORDER_TRACK_INTER_CHUNK_TIME_MS,
                 it->mMaxInterChunkDurUs);
+        notify(MEDIA_RECORDER_TRACK_EVENT_INFO,
+                trackNum | MEDIA_RECORDER_TRACK_INFO_MAX_QUEUED_CHUNKS,
+                it->mMaxQueuedChunks);
+        notify(MEDIA_RECORDER_TRACK_EVENT_INFO,
+                trackNum | MEDIA_RECORDER_TRACK_INFO_MAX_CHUNK_WRITE_MS,
+                it->mMaxWriteTimeUs / 1000);
     }
 }
 
@@ -1173,7 +1375,19 @@ size_t MPEG4Writer::write(
     if (mWriteMoovBoxToMemory) {
 
         off64_t moovBoxSize = 8 + mMoovBoxBufferOffset + bytes;
-        if (moovBoxSize > mEstimatedMoovBoxSize) {
+        if (mFaststart && moovBoxSize > mEstimatedMoovBoxSize) {
+            // Keep building the moov box in memory, reset() makes room
+            // for it at the front of the file.
+            if (mMoovBoxBufferOffset + bytes > mMoovBoxBufferSize) {
+                size_t newSize = 2 * (mMoovBoxBufferOffset + bytes);
+                uint8_t *newBuffer = (uint8_t *) realloc(mMoovBoxBuffer, newSize);
+                CHECK(newBuffer != NULL);
+                mMoovBoxBuffer = newBuffer;
+                mMoovBoxBufferSize = newSize;
+            }
+            memcpy(mMoovBoxBuffer + mMoovBoxBufferOffset, ptr, bytes);
+            mMoovBoxBufferOffset += bytes;
+        } else if (moovBoxSize > mEstimatedMoovBoxSize) {
             // The reserved moov box at the beginning of the file
             // is not big enough. Moov box should be written to
             // the end of the file from now on, but not to the
@@ -1443,6 +1657,9 @@ MPEG4Writer::Track::Track(
       mTrackId(trackId),
       mTrackDurationUs(0),
       mEstimatedTrackSizeBytes(0),
+      mNumSamples(0),
+      mNumSyncSamples(0),
+      mChunkDecodingTimeTicks(0),
       mSamplesHaveSameSize(true),
       mStszTableEntries(new ListTableEntries<uint32_t>(1000, 1)),
       mStcoTableEntries(new ListTableEntries<uint32_t>(1000, 1)),
@@ -1465,6 +1682,10 @@ MPEG4Writer::Track::Track(
     mIsMPEG4 = !strcasecmp(mime, MEDIA_MIMETYPE_VIDEO_MPEG4) ||
                !strcasecmp(mime, MEDIA_MIMETYPE_AUDIO_AAC);
 
+    int32_t canRetain;
+    mCanRetainSourceBuffers =
+        mMeta->findInt32(kKeyCanRetainOutputBuffers, &canRetain) && canRetain;
+
     setTimeScale();
 }
 
@@ -1474,10 +1695,13 @@ void MPEG4Writer::Track::updateTrackSizeEstimate() {
                             ? mStcoTableEntries->count()
                             : mCo64TableEntries->count());
     int64_t stcoBoxSizeBytes = stcoBoxCount * 4;
-    int64_t stszBoxSizeBytes = mSamplesHaveSameSize? 4: (mStszTableEntries->count() * 4);
+    int64_t stszBoxSizeBytes = mSamplesHaveSameSize? 4: (mNumSamples * 4);
 
     mEstimatedTrackSizeBytes = mMdatSizeBytes;  // media data size
-    if (!mOwner->isFileStreamable()) {
+    if (mOwner->isFragmented()) {
+        // trun box entries
+        mEstimatedTrackSizeBytes += mNumSamples * kFragmentSampleEntrySize;
+    } else if (!mOwner->isFileStreamable()) {
         // Reserved free space is not large enough to hold
         // all meta data and thus wasted.
         mEstimatedTrackSizeBytes += mStscTableEntries->count() * 12 +  // stsc box size
@@ -1492,12 +1716,19 @@ void MPEG4Writer::Track::updateTrackSizeEstimate() {
 void MPEG4Writer::Track::addOneStscTableEntry(
         size_t chunkId, size_t sampleId) {
 
+        if (mOwner->isFragmented()) {  // described by the trun boxes
+            return;
+        }
         mStscTableEntries->add(htonl(chunkId));
         mStscTableEntries->add(htonl(sampleId));
         mStscTableEntries->add(htonl(1));
 }
 
 void MPEG4Writer::Track::addOneStssTableEntry(size_t sampleId) {
+    ++mNumSyncSamples;
+    if (mOwner->isFragmented()) {
+        return;
+    }
     mStssTableEntries->add(htonl(sampleId));
 }
 
@@ -1507,6 +1738,9 @@ void MPEG4Writer::Track::addOneSttsTableEntry(
     if (duration == 0) {
         ALOGW("0-duration samples found: %zu", sampleCount);
     }
+    if (mOwner->isFragmented()) {
+        return;
+    }
     mSttsTableEntries->add(htonl(sampleCount));
     mSttsTableEntries->add(htonl(duration));
 }
@@ -1514,7 +1748,7 @@ void MPEG4Writer::Track::addOneSttsTableEntry(
 void MPEG4Writer::Track::addOneCttsTableEntry(
         size_t sampleCount, int32_t duration) {
 
-    if (mIsAudio) {
+    if (mIsAudio || mOwner->isFragmented()) {
         return;
     }
     mCttsTableEntries->add(htonl(sampleCount));
@@ -1530,6 +1764,22 @@ void MPEG4Writer::Track::addChunkOffset(off64_t offset) {
     }
 }
 
+static uint32_t shiftStcoEntry(uint32_t value, off64_t delta) {
+    return htonl(ntohl(value) + (uint32_t)delta);
+}
+
+static off64_t shiftCo64Entry(off64_t value, off64_t delta) {
+    return hton64(ntoh64(value) + delta);
+}
+
+void MPEG4Writer::Track::shiftChunkOffsets(off64_t delta) {
+    if (mOwner->use32BitFileOffset()) {
+        mStcoTableEntries->adjust(shiftStcoEntry, delta);
+    } else {
+        mCo64TableEntries->adjust(shiftCo64Entry, delta);
+    }
+}
+
 void MPEG4Writer::Track::setTimeScale() {
     ALOGV("setTimeScale");
     // Default time scale
@@ -1641,6 +1891,9 @@ void MPEG4Writer::bufferChunk(const Chunk& chunk) {
 
         if (chunk.mTrack == it->mTrack) {  // Found owner
             it->mChunks.push_back(chunk);
+            if (++it->mQueuedChunks > it->mMaxQueuedChunks) {
+                it->mMaxQueuedChunks = it->mQueuedChunks;
+            }
             mChunkReadyCondition.signal();
             return;
         }
@@ -1649,37 +1902,272 @@ void MPEG4Writer::bufferChunk(const Chunk& chunk) {
     CHECK(!"Received a chunk for a unknown track");
 }
 
-void MPEG4Writer::writeChunkToFile(Chunk* chunk) {
-    ALOGV("writeChunkToFile: %" PRId64 " from %s track",
-        chunk->mTimeStampUs, chunk->mTrack->isAudio()? "audio": "video");
+// Writes count iovecs with as few writev() calls as possible, continuing
+// after partial writes.  Returns the number of bytes written, or -errno.
+static ssize_t writevFully(int fd, struct iovec *iov, size_t count) {
+    ssize_t total = 0;
+    while (count > 0) {
+        ssize_t n = ::writev(fd, iov, count < IOV_MAX ? count : IOV_MAX);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        total += n;
+        while (count > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if (count > 0) {
+            if (n == 0 && total == 0) {
+                return -EIO;  // no progress
+            }
+            iov->iov_base = (uint8_t *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return total;
+}
+
+void MPEG4Writer::preallocate(off64_t endOffset) {
+    if (mPreallocationSize == 0 || endOffset <= mPreallocatedOffset) {
+        return;
+    }
+
+    off64_t start = mPreallocatedOffset > mOffset ? mPreallocatedOffset : mOffset;
+    off64_t length = endOffset - start + mPreallocationSize;
+    if (fallocate64(mFd, FALLOC_FL_KEEP_SIZE, start, length) != 0) {
+        // e.g. vfat SD cards, don't try again
+        ALOGW("preallocation not available: %s", strerror(errno));
+        mPreallocationSize = 0;
+        return;
+    }
+    mPreallocatedOffset = start + length;
+}
+
+static uint8_t *putInt32(uint8_t *ptr, uint32_t x) {
+    ptr[0] = x >> 24;
+    ptr[1] = (x >> 16) & 0xff;
+    ptr[2] = (x >> 8) & 0xff;
+    ptr[3] = x & 0xff;
+    return ptr + 4;
+}
+
+static uint8_t *putInt64(uint8_t *ptr, uint64_t x) {
+    ptr = putInt32(ptr, x >> 32);
+    return putInt32(ptr, x & 0xffffffff);
+}
+
+static uint8_t *putBoxHeader(uint8_t *ptr, uint32_t size, const char *fourcc) {
+    ptr = putInt32(ptr, size);
+    memcpy(ptr, fourcc, 4);
+    return ptr + 4;
+}
+
+size_t MPEG4Writer::writeFragmentHeader(const Chunk &chunk, uint8_t *data) {
+    const Vector<FragmentSample> &samples = chunk.mFragmentSamples;
+    CHECK_EQ(samples.size(), chunk.mSamples.size());
+
+    const size_t trunSize = 20 + samples.size() * kFragmentSampleEntrySize;
+    const size_t trafSize = 8 + 16 + 20 + trunSize;
+    const size_t moofSize = 8 + 16 + trafSize;
+    const size_t prefixSize =
+        chunk.mTrack->isAvc() ? (mUse4ByteNalLength ? 4 : 2) : 0;
+
+    uint8_t *ptr = putBoxHeader(data, moofSize, "moof");
+    ptr = putBoxHeader(ptr, 16, "mfhd");
+    ptr = putInt32(ptr, 0);              // version=0, flags=0
+    ptr = putInt32(ptr, ++mFragmentSequenceNumber);
+    ptr = putBoxHeader(ptr, trafSize, "traf");
+    ptr = putBoxHeader(ptr, 16, "tfhd");
+    ptr = putInt32(ptr, 0x020000);       // version=0, flags=default-base-is-moof
+    ptr = putInt32(ptr, chunk.mTrack->getTrackId());
+    ptr = putBoxHeader(ptr, 20, "tfdt");
+    ptr = putInt32(ptr, 0x01000000);     // version=1, flags=0
+    ptr = putInt64(ptr, chunk.mDecodingTimeTicks
+            + chunk.mTrack->getStartTimeOffsetScaledTime());
+    ptr = putBoxHeader(ptr, trunSize, "trun");
+    // version=1 for signed composition offsets, flags=data offset, sample
+    // duration, sample size, sample flags and composition offset present
+    ptr = putInt32(ptr, 0x01000f01);
+    ptr = putInt32(ptr, samples.size());
+    ptr = putInt32(ptr, moofSize + 8);   // samples follow the mdat header
+
+    uint32_t mdatSize = 8;
+    List<MediaBuffer *>::const_iterator sampleIt = chunk.mSamples.begin();
+    for (size_t i = 0; i < samples.size(); ++i, ++sampleIt) {
+        uint32_t size = (*sampleIt)->range_length() + prefixSize;
+        ptr = putInt32(ptr, samples[i].mDurationTicks);
+        ptr = putInt32(ptr, size);
+        ptr = putInt32(ptr, samples[i].mIsSync ? kSyncSampleFlags : kNonSyncSampleFlags);
+        ptr = putInt32(ptr, samples[i].mCompositionOffsetTicks);
+        mdatSize += size;
+    }
+    ptr = putBoxHeader(ptr, mdatSize, "mdat");
+
+    CHECK_EQ((size_t)(ptr - data), moofSize + 8);
+    return moofSize + 8;
+}
+
+void MPEG4Writer::writeChunksToFile(List<Chunk> *chunks) {
+    if (mFragmented && !mFragmentedMoovWritten) {
+        // All tracks have buffered their first chunk, see canWriteChunks_l(),
+        // so the codec specific data is known.
+        writeMoovBox(0);
+        mFragmentedMoovWritten = true;
+    }
+
+    size_t numSamples = 0;
+    size_t headersSize = 0;
+    for (List<Chunk>::iterator it = chunks->begin(); it != chunks->end(); ++it) {
+        numSamples += it->mSamples.size();
+        if (mFragmented) {
+            headersSize += kFragmentHeaderSize
+                    + it->mSamples.size() * kFragmentSampleEntrySize;
+        }
+    }
+
+    // Each sample takes one iovec, plus one for its NAL length prefix,
+    // and each fragment one for its moof box and mdat header.
+    Vector<struct iovec> iovs;
+    iovs.setCapacity(numSamples * 2 + (mFragmented ? chunks->size() : 0));
+    uint8_t *prefixes = new uint8_t[numSamples * 4];
+    uint8_t *headers = mFragmented ? new uint8_t[headersSize] : NULL;
+
+    off64_t offset = mOffset;
+    size_t prefixIndex = 0;
+    size_t headersOffset = 0;
+    for (List<Chunk>::iterator it = chunks->begin(); it != chunks->end(); ++it) {
+        ALOGV("writeChunksToFile: %" PRId64 " from %s track",
+            it->mTimeStampUs, it->mTrack->isAudio()? "audio": "video");
+
+        if (mFragmented) {
+            struct iovec iov;
+            iov.iov_base = headers + headersOffset;
+            iov.iov_len = writeFragmentHeader(*it, headers + headersOffset);
+            iovs.push_back(iov);
+            headersOffset += iov.iov_len;
+            offset += iov.iov_len;
+        }
+
+        // Fragments address their samples relative to the moof box
+        bool isFirstSample = !mFragmented;
+        for (List<MediaBuffer *>::iterator sampleIt = it->mSamples.begin();
+             sampleIt != it->mSamples.end(); ++sampleIt) {
+            MediaBuffer *buffer = *sampleIt;
+            size_t length = buffer->range_length();
+
+            if (isFirstSample) {
+                it->mTrack->addChunkOffset(offset);
+                isFirstSample = false;
+            }
+
+            struct iovec iov;
+            if (it->mTrack->isAvc() && mUse4ByteNalLength && buffer->range_offset() >= 4) {
+                // Overwrite the start code stripped by StripStartcode() with
+                // the length, so that the sample is written with one iovec.
+                uint8_t *prefix = (uint8_t *)buffer->data() + buffer->range_offset() - 4;
+                prefix[0] = length >> 24;
+                prefix[1] = (length >> 16) & 0xff;
+                prefix[2] = (length >> 8) & 0xff;
+                prefix[3] = length & 0xff;
+                length += 4;
+                iov.iov_base = prefix;
+            } else if (it->mTrack->isAvc()) {
+                uint8_t *prefix = &prefixes[4 * prefixIndex++];
+                if (mUse4ByteNalLength) {
+                    prefix[0] = length >> 24;
+                    prefix[1] = (length >> 16) & 0xff;
+                    prefix[2] = (length >> 8) & 0xff;
+                    prefix[3] = length & 0xff;
+                    iov.iov_len = 4;
+                } else {
+                    CHECK_LT(length, 65536);
+                    prefix[0] = length >> 8;
+                    prefix[1] = length & 0xff;
+                    iov.iov_len = 2;
+                }
+                iov.iov_base = prefix;
+                iovs.push_back(iov);
+                offset += iov.iov_len;
+                iov.iov_base = (uint8_t *)buffer->data() + buffer->range_offset();
+            } else {
+                iov.iov_base = (uint8_t *)buffer->data() + buffer->range_offset();
+            }
 
-    int32_t isFirstSample = true;
-    while (!chunk->mSamples.empty()) {
-        List<MediaBuffer *>::iterator it = chunk->mSamples.begin();
+            iov.iov_len = length;
+            iovs.push_back(iov);
+            offset += length;
+        }
+    }
 
-        off64_t offset = chunk->mTrack->isAvc()
-                                ? addLengthPrefixedSample_l(*it)
-                                : addSample_l(*it);
+    preallocate(offset);
 
-        if (isFirstSample) {
-            chunk->mTrack->addChunkOffset(offset);
-            isFirstSample = false;
+    ssize_t written = writevFully(mFd, iovs.editArray(), iovs.size());
+    if (written != offset - mOffset) {
+        ALOGE("wrote %zd of %" PRId64 " bytes: %s", written, offset - mOffset,
+                written < 0 ? strerror(-written) : "short write");
+    }
+    mOffset = offset;
+    delete[] prefixes;
+    delete[] headers;
+
+    for (List<Chunk>::iterator it = chunks->begin(); it != chunks->end(); ++it) {
+        for (List<MediaBuffer *>::iterator sampleIt = it->mSamples.begin();
+             sampleIt != it->mSamples.end(); ++sampleIt) {
+            (*sampleIt)->release();
+            *sampleIt = NULL;
         }
+        it->mSamples.clear();
+    }
+}
 
-        (*it)->release();
-        (*it) = NULL;
-        chunk->mSamples.erase(it);
+void MPEG4Writer::updateWriteStats_l(const List<Chunk> &chunks, int64_t writeTimeUs) {
+    for (List<ChunkInfo>::iterator it = mChunkInfos.begin();
+         it != mChunkInfos.end(); ++it) {
+        for (List<Chunk>::const_iterator chunkIt = chunks.begin();
+             chunkIt != chunks.end(); ++chunkIt) {
+            if (chunkIt->mTrack == it->mTrack) {
+                if (writeTimeUs > it->mMaxWriteTimeUs) {
+                    it->mMaxWriteTimeUs = writeTimeUs;
+                }
+                break;
+            }
+        }
     }
-    chunk->mSamples.clear();
 }
 
 void MPEG4Writer::writeAllChunks() {
     ALOGV("writeAllChunks");
     size_t outstandingChunks = 0;
+    List<Chunk> chunks;
     Chunk chunk;
+    if (!canWriteChunks_l()) {
+        // A track without samples or codec specific data fails the
+        // recording anyway, see Track::isTrackMalFormed().
+        ALOGW("Not writing the fragments of an incomplete recording");
+        while (findChunkToWrite(&chunk)) {
+            for (List<MediaBuffer *>::iterator it = chunk.mSamples.begin();
+                 it != chunk.mSamples.end(); ++it) {
+                (*it)->release();
+            }
+        }
+        mChunkInfos.clear();
+        return;
+    }
     while (findChunkToWrite(&chunk)) {
-        writeChunkToFile(&chunk);
-        ++outstandingChunks;
+        chunks.push_back(chunk);
+        if (chunks.size() == kMaxChunksPerWrite) {
+            outstandingChunks += chunks.size();
+            writeChunksToFile(&chunks);
+            chunks.clear();
+        }
+    }
+    if (!chunks.empty()) {
+        outstandingChunks += chunks.size();
+        writeChunksToFile(&chunks);
     }
 
     sendSessionSummary();
@@ -1718,6 +2206,7 @@ bool MPEG4Writer::findChunkToWrite(Chunk *chunk) {
         if (it->mTrack == track) {
             *chunk = *(it->mChunks.begin());
             it->mChunks.erase(it->mChunks.begin());
+            --it->mQueuedChunks;
             CHECK_EQ(chunk->mTrack, track);
 
             int64_t interChunkTimeUs =
@@ -1733,6 +2222,22 @@ bool MPEG4Writer::findChunkToWrite(Chunk *chunk) {
     return false;
 }
 
+bool MPEG4Writer::canWriteChunks_l() {
+    if (!mFragmented || mFragmentedMoovWritten) {
+        return true;
+    }
+
+    // The moov box goes out first, hold the chunks back until every track
+    // has buffered one, at which point all codec specific data is known.
+    for (List<ChunkInfo>::iterator it = mChunkInfos.begin();
+         it != mChunkInfos.end(); ++it) {
+        if (it->mChunks.empty() || it->mTrack->checkCodecSpecificData() != OK) {
+            return false;
+        }
+    }
+    return true;
+}
+
 void MPEG4Writer::threadFunc() {
     ALOGV("threadFunc");
 
@@ -1743,22 +2248,35 @@ void MPEG4Writer::threadFunc() {
         Chunk chunk;
         bool chunkFound = false;
 
-        while (!mDone && !(chunkFound = findChunkToWrite(&chunk))) {
+        while (!mDone && !(chunkFound = canWriteChunks_l() && findChunkToWrite(&chunk))) {
             mChunkReadyCondition.wait(mLock);
         }
 
+        // Take every chunk that is ready, up to a limit, so that interleaved
+        // chunks of all tracks go out in one batch of writes.
+        List<Chunk> chunks;
+        if (chunkFound) {
+            chunks.push_back(chunk);
+            while (chunks.size() < kMaxChunksPerWrite && findChunkToWrite(&chunk)) {
+                chunks.push_back(chunk);
+            }
+        }
+
         // In real time recording mode, write without holding the lock in order
         // to reduce the blocking time for media track threads.
         // Otherwise, hold the lock until the existing chunks get written to the
         // file.
-        if (chunkFound) {
+        if (!chunks.empty()) {
             if (mIsRealTimeRecording) {
                 mLock.unlock();
             }
-            writeChunkToFile(&chunk);
+            nsecs_t startNs = systemTime();
+            writeChunksToFile(&chunks);
+            int64_t writeTimeUs = (systemTime() - startNs) / 1000;
             if (mIsRealTimeRecording) {
                 mLock.lock();
             }
+            updateWriteStats_l(chunks, writeTimeUs);
         }
     }
 
@@ -1777,6 +2295,9 @@ status_t MPEG4Writer::startWriterThread() {
         info.mTrack = *it;
         info.mPrevChunkTimestampUs = 0;
         info.mMaxInterChunkDurUs = 0;
+        info.mQueuedChunks = 0;
+        info.mMaxQueuedChunks = 0;
+        info.mMaxWriteTimeUs = 0;
         mChunkInfos.push_back(info);
     }
 
@@ -2162,6 +2683,8 @@ status_t MPEG4Writer::Track::threadEntry() {
     int32_t count = 0;
     const int64_t interleaveDurationUs = mOwner->interleaveDuration();
     const bool hasMultipleTracks = (mOwner->numTracks() > 1);
+    const bool isFragmented = mOwner->isFragmented();
+    int64_t decodingTimeTicks = 0;    // Fragmented mode only
     int64_t chunkTimestampUs = 0;
     int32_t nChunks = 0;
     int32_t nZeroLengthFrames = 0;
@@ -2240,14 +2763,22 @@ status_t MPEG4Writer::Track::threadEntry() {
             continue;
         }
 
-        // Make a deep copy of the MediaBuffer and Metadata and release
-        // the original as soon as we can
-        MediaBuffer *copy = new MediaBuffer(buffer->range_length());
-        memcpy(copy->data(), (uint8_t *)buffer->data() + buffer->range_offset(),
-                buffer->range_length());
-        copy->set_range(0, buffer->range_length());
-        meta_data = new MetaData(*buffer->meta_data().get());
-        buffer->release();
+        MediaBuffer *copy;
+        if (mCanRetainSourceBuffers) {
+            // Keep the source's buffer until its chunk is written, the file
+            // is written straight from it.
+            copy = buffer;
+            meta_data = buffer->meta_data();
+        } else {
+            // Make a deep copy of the MediaBuffer and Metadata and release
+            // the original as soon as we can
+            copy = new MediaBuffer(buffer->range_length());
+            memcpy(copy->data(), (uint8_t *)buffer->data() + buffer->range_offset(),
+                    buffer->range_length());
+            copy->set_range(0, buffer->range_length());
+            meta_data = new MetaData(*buffer->meta_data().get());
+            buffer->release();
+        }
         buffer = NULL;
 
         if (mIsAvc) StripStartcode(copy);
@@ -2280,7 +2811,7 @@ status_t MPEG4Writer::Track::threadEntry() {
         CHECK(meta_data->findInt64(kKeyTime, &timestampUs));
 
 ////////////////////////////////////////////////////////////////////////////////
-        if (mStszTableEntries->count() == 0) {
+        if (mNumSamples == 0) {
             mFirstSampleTimeRealUs = systemTime() / 1000;
             mStartTimestampUs = timestampUs;
             mOwner->setStartTimestampUs(mStartTimestampUs);
@@ -2338,7 +2869,7 @@ status_t MPEG4Writer::Track::threadEntry() {
                 return ERROR_MALFORMED;
             }
 
-            if (mStszTableEntries->count() == 0) {
+            if (mNumSamples == 0) {
                 // Force the first ctts table entry to have one single entry
                 // so that we can do adjustment for the initial track start
                 // time offset easily in writeCttsBox().
@@ -2356,7 +2887,7 @@ status_t MPEG4Writer::Track::threadEntry() {
             }
 
             // Update ctts time offset range
-            if (mStszTableEntries->count() == 0) {
+            if (mNumSamples == 0) {
                 mMinCttsOffsetTimeUs = currCttsOffsetTimeTicks;
                 mMaxCttsOffsetTimeUs = currCttsOffsetTimeTicks;
             } else {
@@ -2417,12 +2948,15 @@ status_t MPEG4Writer::Track::threadEntry() {
             }
         }
 
-        mStszTableEntries->add(htonl(sampleSize));
-        if (mStszTableEntries->count() > 2) {
+        if (!isFragmented) {
+            mStszTableEntries->add(htonl(sampleSize));
+        }
+        ++mNumSamples;
+        if (mNumSamples > 2) {
 
             // Force the first sample to have its own stts entry so that
             // we can adjust its value later to maintain the A/V sync.
-            if (mStszTableEntries->count() == 3 || currDurationTicks != lastDurationTicks) {
+            if (mNumSamples == 3 || currDurationTicks != lastDurationTicks) {
                 addOneSttsTableEntry(sampleCount, lastDurationTicks);
                 sampleCount = 1;
             } else {
@@ -2431,7 +2965,7 @@ status_t MPEG4Writer::Track::threadEntry() {
 
         }
         if (mSamplesHaveSameSize) {
-            if (mStszTableEntries->count() >= 2 && previousSampleSize != sampleSize) {
+            if (mNumSamples >= 2 && previousSampleSize != sampleSize) {
                 mSamplesHaveSameSize = false;
             }
             previousSampleSize = sampleSize;
@@ -2441,9 +2975,10 @@ status_t MPEG4Writer::Track::threadEntry() {
         lastDurationUs = timestampUs - lastTimestampUs;
         lastDurationTicks = currDurationTicks;
         lastTimestampUs = timestampUs;
+        decodingTimeTicks += currDurationTicks;
 
         if (isSync != 0) {
-            addOneStssTableEntry(mStszTableEntries->count());
+            addOneStssTableEntry(mNumSamples);
         }
 
         if (mTrackingProgressStatus) {
@@ -2452,6 +2987,38 @@ status_t MPEG4Writer::Track::threadEntry() {
             }
             trackProgressStatus(timestampUs);
         }
+        if (isFragmented) {
+            // The duration of the previous sample is known now
+            if (!mFragmentSamples.isEmpty()) {
+                mFragmentSamples.editTop().mDurationTicks = currDurationTicks;
+            }
+
+            // Start a new fragment once the fragment duration is reached, at a
+            // sync sample for video so that each fragment decodes on its own.
+            if (!mChunkSamples.empty() &&
+                timestampUs - chunkTimestampUs >= interleaveDurationUs &&
+                (mIsAudio || isSync)) {
+                if (timestampUs - chunkTimestampUs > mMaxChunkDurationUs) {
+                    mMaxChunkDurationUs = timestampUs - chunkTimestampUs;
+                }
+                bufferChunk(chunkTimestampUs);
+            }
+            if (mChunkSamples.empty()) {
+                chunkTimestampUs = timestampUs;
+                mChunkDecodingTimeTicks = decodingTimeTicks;
+            }
+
+            FragmentSample sample;
+            sample.mDurationTicks = 0;
+            sample.mCompositionOffsetTicks = mIsAudio ? 0 :
+                currCttsOffsetTimeTicks -
+                    (kMaxCttsOffsetTimeUs * mTimeScale + 500000LL) / 1000000LL;
+            sample.mIsSync = mIsAudio || isSync;
+            mFragmentSamples.push(sample);
+            mChunkSamples.push_back(copy);
+            continue;
+        }
+
         if (!hasMultipleTracks) {
             off64_t offset = mIsAvc? mOwner->addLengthPrefixedSample_l(copy)
                                  : mOwner->addSample_l(copy);
@@ -2502,9 +3069,13 @@ status_t MPEG4Writer::Track::threadEntry() {
     mOwner->trackProgressStatus(mTrackId, -1, err);
 
     // Last chunk
-    if (!hasMultipleTracks) {
-        addOneStscTableEntry(1, mStszTableEntries->count());
+    if (!hasMultipleTracks && !isFragmented) {
+        addOneStscTableEntry(1, mNumSamples);
     } else if (!mChunkSamples.empty()) {
+        if (isFragmented) {
+            // Repeat the previous sample's duration, as for stts below
+            mFragmentSamples.editTop().mDurationTicks = lastDurationTicks;
+        }
         addOneStscTableEntry(++nChunks, mChunkSamples.size());
         bufferChunk(timestampUs);
     }
@@ -2512,14 +3083,14 @@ status_t MPEG4Writer::Track::threadEntry() {
     // We don't really know how long the last frame lasts, since
     // there is no frame time after it, just repeat the previous
     // frame's duration.
-    if (mStszTableEntries->count() == 1) {
+    if (mNumSamples == 1) {
         lastDurationUs = 0;  // A single sample's duration
         lastDurationTicks = 0;
     } else {
         ++sampleCount;  // Count for the last sample
     }
 
-    if (mStszTableEntries->count() <= 2) {
+    if (mNumSamples <= 2) {
         addOneSttsTableEntry(1, lastDurationTicks);
         if (sampleCount - 1 > 0) {
             addOneSttsTableEntry(sampleCount - 1, lastDurationTicks);
@@ -2542,7 +3113,7 @@ status_t MPEG4Writer::Track::threadEntry() {
     sendTrackSummary(hasMultipleTracks);
 
     ALOGI("Received total/0-length (%d/%d) buffers and encoded %d frames. - %s",
-            count, nZeroLengthFrames, mStszTableEntries->count(), trackName);
+            count, nZeroLengthFrames, mNumSamples, trackName);
     if (mIsAudio) {
         ALOGI("Audio track drift time: %" PRId64 " us", mOwner->getDriftTimeUs());
     }
@@ -2554,12 +3125,12 @@ status_t MPEG4Writer::Track::threadEntry() {
 }
 
 bool MPEG4Writer::Track::isTrackMalFormed() const {
-    if (mStszTableEntries->count() == 0) {                      // no samples written
+    if (mNumSamples == 0) {                      // no samples written
         ALOGE("The number of recorded samples is 0");
         return true;
     }
 
-    if (!mIsAudio && mStssTableEntries->count() == 0) {  // no sync frames for video
+    if (!mIsAudio && mNumSyncSamples == 0) {  // no sync frames for video
         ALOGE("There are no sync frames for video track");
         return true;
     }
@@ -2590,7 +3161,7 @@ void MPEG4Writer::Track::sendTrackSummary(bool hasMultipleTracks) {
 
     mOwner->notify(MEDIA_RECORDER_TRACK_EVENT_INFO,
                     trackNum | MEDIA_RECORDER_TRACK_INFO_ENCODED_FRAMES,
-                    mStszTableEntries->count());
+                    mNumSamples);
 
     {
         // The system delay time excluding the requested initial delay that
@@ -2688,8 +3259,11 @@ void MPEG4Writer::Track::bufferChunk(int64_t timestampUs) {
     ALOGV("bufferChunk");
 
     Chunk chunk(this, timestampUs, mChunkSamples);
+    chunk.mDecodingTimeTicks = mChunkDecodingTimeTicks;
+    chunk.mFragmentSamples = mFragmentSamples;
     mOwner->bufferChunk(chunk);
     mChunkSamples.clear();
+    mFragmentSamples.clear();
 }
 
 int64_t MPEG4Writer::Track::getDurationUs() const {
@@ -2756,6 +3330,28 @@ void MPEG4Writer::Track::writeStblBox(bool use32BitOffset) {
         writeVideoFourCCBox();
     }
     mOwner->endBox();  // stsd
+    if (mOwner->isFragmented()) {
+        // The samples are described by the movie fragments
+        mOwner->beginBox("stts");
+        mOwner->writeInt32(0);  // version=0, flags=0
+        mOwner->writeInt32(0);  // entry count
+        mOwner->endBox();  // stts
+        mOwner->beginBox("stsz");
+        mOwner->writeInt32(0);  // version=0, flags=0
+        mOwner->writeInt32(0);  // sample size
+        mOwner->writeInt32(0);  // sample count
+        mOwner->endBox();  // stsz
+        mOwner->beginBox("stsc");
+        mOwner->writeInt32(0);  // version=0, flags=0
+        mOwner->writeInt32(0);  // entry count
+        mOwner->endBox();  // stsc
+        mOwner->beginBox("stco");
+        mOwner->writeInt32(0);  // version=0, flags=0
+        mOwner->writeInt32(0);  // entry count
+        mOwner->endBox();  // stco
+        mOwner->endBox();  // stbl
+        return;
+    }
     writeSttsBox();
     writeCttsBox();
     if (!mIsAudio) {
@@ -2941,7 +3537,8 @@ void MPEG4Writer::Track::writeTkhdBox(uint32_t now) {
     mOwner->writeInt32(now);           // modification time
     mOwner->writeInt32(mTrackId);      // track id starts with 1
     mOwner->writeInt32(0);             // reserved
-    int64_t trakDurationUs = getDurationUs();
+    // The duration of a fragmented file is the sum of its fragments
+    int64_t trakDurationUs = mOwner->isFragmented() ? 0 : getDurationUs();
     int32_t mvhdTimeScale = mOwner->getTimeScale();
     int32_t tkhdDuration =
         (trakDurationUs * mvhdTimeScale + 5E5) / 1E6;
@@ -3002,7 +3599,7 @@ void MPEG4Writer::Track::writeHdlrBox() {
 }
 
 void MPEG4Writer::Track::writeMdhdBox(uint32_t now) {
-    int64_t trakDurationUs = getDurationUs();
+    int64_t trakDurationUs = mOwner->isFragmented() ? 0 : getDurationUs();
     mOwner->beginBox("mdhd");
     mOwner->writeInt32(0);             // version=0, flags=0
     mOwner->writeInt32(now);           // creation time
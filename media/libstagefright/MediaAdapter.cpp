@@ -26,6 +26,7 @@ namespace android {
 
 MediaAdapter::MediaAdapter(const sp<MetaData> &meta)
     : mCurrentMediaBuffer(NULL),
+      mBufferPending(false),
       mStarted(false),
       mOutputFormat(meta) {
 }
@@ -56,6 +57,9 @@ status_t MediaAdapter::stop() {
         }
         // While read() is still waiting, we should signal it to finish.
         mBufferReadCond.signal();
+        // Likewise for pushBuffer() waiting for its buffer to be returned.
+        mBufferPending = false;
+        mBufferReturnedCond.broadcast();
     }
     return OK;
 }
@@ -71,7 +75,8 @@ void MediaAdapter::signalBufferReturned(MediaBuffer *buffer) {
     buffer->setObserver(0);
     buffer->release();
     ALOGV("buffer returned %p", buffer);
-    mBufferReturnedCond.signal();
+    mBufferPending = false;
+    mBufferReturnedCond.broadcast();
 }
 
 status_t MediaAdapter::read(
@@ -113,11 +118,23 @@ status_t MediaAdapter::pushBuffer(MediaBuffer *buffer) {
         ALOGE("pushBuffer called before start");
         return INVALID_OPERATION;
     }
+    while (mBufferPending && mStarted) {
+        ALOGV("wait for the previous buffer returned @ pushBuffer! %p", buffer);
+        mBufferReturnedCond.wait(mAdapterLock);
+    }
+    if (!mStarted) {
+        ALOGV("pushBuffer interrupted after stop");
+        buffer->release();
+        return INVALID_OPERATION;
+    }
     mCurrentMediaBuffer = buffer;
+    mBufferPending = true;
     mBufferReadCond.signal();
 
     ALOGV("wait for the buffer returned @ pushBuffer! %p", buffer);
-    mBufferReturnedCond.wait(mAdapterLock);
+    while (mBufferPending && mStarted) {
+        mBufferReturnedCond.wait(mAdapterLock);
+    }
 
     return OK;
 }
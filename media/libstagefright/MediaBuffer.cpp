@@ -33,6 +33,7 @@ namespace android {
 MediaBuffer::MediaBuffer(void *data, size_t size)
     : mObserver(NULL),
       mNextBuffer(NULL),
+      mNextFree(NULL),
       mRefCount(0),
       mData(data),
       mSize(size),
@@ -46,6 +47,7 @@ MediaBuffer::MediaBuffer(void *data, size_t size)
 MediaBuffer::MediaBuffer(size_t size)
     : mObserver(NULL),
       mNextBuffer(NULL),
+      mNextFree(NULL),
       mRefCount(0),
       mData(malloc(size)),
       mSize(size),
@@ -59,6 +61,7 @@ MediaBuffer::MediaBuffer(size_t size)
 MediaBuffer::MediaBuffer(const sp<GraphicBuffer>& graphicBuffer)
     : mObserver(NULL),
       mNextBuffer(NULL),
+      mNextFree(NULL),
       mRefCount(0),
       mData(NULL),
       mSize(1),
@@ -73,6 +76,7 @@ MediaBuffer::MediaBuffer(const sp<GraphicBuffer>& graphicBuffer)
 MediaBuffer::MediaBuffer(const sp<ABuffer> &buffer)
     : mObserver(NULL),
       mNextBuffer(NULL),
+      mNextFree(NULL),
       mRefCount(0),
       mData(buffer->data()),
       mSize(buffer->size()),
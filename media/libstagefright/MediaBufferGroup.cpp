@@ -23,9 +23,18 @@
 
 namespace android {
 
-MediaBufferGroup::MediaBufferGroup()
-    : mFirstBuffer(NULL),
-      mLastBuffer(NULL) {
+// Buffers that a growing group allocates are rounded up to a power of two of
+// at least this size, so that they can be reused for similar requests.
+static const size_t kMinGrowthBufferSize = 4096;
+
+MediaBufferGroup::MediaBufferGroup(size_t growthLimit)
+    : mReturnedBuffers(NULL),
+      mNumWaiters(0),
+      mFirstBuffer(NULL),
+      mLastBuffer(NULL),
+      mFreeBuffers(NULL),
+      mNumBuffers(0),
+      mGrowthLimit(growthLimit) {
 }
 
 MediaBufferGroup::~MediaBufferGroup() {
@@ -44,6 +53,16 @@ MediaBufferGroup::~MediaBufferGroup() {
 void MediaBufferGroup::add_buffer(MediaBuffer *buffer) {
     Mutex::Autolock autoLock(mLock);
 
+    addBuffer_l(buffer);
+
+    if (buffer->refcount() == 0) {
+        buffer->mNextFree = mFreeBuffers;
+        mFreeBuffers = buffer;
+        mCondition.broadcast();
+    }
+}
+
+void MediaBufferGroup::addBuffer_l(MediaBuffer *buffer) {
     buffer->setObserver(this);
 
     if (mLastBuffer) {
@@ -53,40 +72,202 @@ void MediaBufferGroup::add_buffer(MediaBuffer *buffer) {
     }
 
     mLastBuffer = buffer;
+    ++mNumBuffers;
+}
+
+void MediaBufferGroup::removeBuffer_l(MediaBuffer *buffer) {
+    MediaBuffer *prev = NULL;
+    for (MediaBuffer *it = mFirstBuffer; it != NULL; it = it->nextBuffer()) {
+        if (it == buffer) {
+            if (prev != NULL) {
+                prev->setNextBuffer(it->nextBuffer());
+            } else {
+                mFirstBuffer = it->nextBuffer();
+            }
+            if (mLastBuffer == it) {
+                mLastBuffer = prev;
+            }
+            --mNumBuffers;
+            break;
+        }
+        prev = it;
+    }
+
+    buffer->setNextBuffer(NULL);
+    buffer->setObserver(NULL);
+    buffer->release();
+}
+
+MediaBuffer *MediaBufferGroup::takeFreeBuffer_l(size_t requestedSize) {
+    // collect everything returned since the last call
+    MediaBuffer *returned =
+        (MediaBuffer *)__sync_lock_test_and_set(&mReturnedBuffers, NULL);
+    while (returned != NULL) {
+        MediaBuffer *next = returned->mNextFree;
+        returned->mNextFree = mFreeBuffers;
+        mFreeBuffers = returned;
+        returned = next;
+    }
+
+    MediaBuffer **best = NULL;
+    for (MediaBuffer **it = &mFreeBuffers; *it != NULL; it = &(*it)->mNextFree) {
+        size_t size = (*it)->size();
+        if (size >= requestedSize && (best == NULL || size < (*best)->size())) {
+            best = it;
+            if (size == requestedSize || requestedSize == 0) {
+                break;
+            }
+        }
+    }
+
+    if (best == NULL) {
+        return NULL;
+    }
+
+    MediaBuffer *buffer = *best;
+    *best = buffer->mNextFree;
+    buffer->mNextFree = NULL;
+    return buffer;
+}
+
+MediaBuffer *MediaBufferGroup::grow_l(size_t requestedSize) {
+    if (requestedSize == 0 || mGrowthLimit == 0) {
+        return NULL;
+    }
+
+    if (mNumBuffers >= mGrowthLimit) {
+        // none of the free buffers fits, give up the smallest one
+        MediaBuffer **smallest = NULL;
+        for (MediaBuffer **it = &mFreeBuffers; *it != NULL; it = &(*it)->mNextFree) {
+            if (smallest == NULL || (*it)->size() < (*smallest)->size()) {
+                smallest = it;
+            }
+        }
+        if (smallest == NULL) {
+            return NULL;
+        }
+        MediaBuffer *buffer = *smallest;
+        *smallest = buffer->mNextFree;
+        buffer->mNextFree = NULL;
+        removeBuffer_l(buffer);
+    }
+
+    size_t size = kMinGrowthBufferSize;
+    while (size < requestedSize && size <= SIZE_MAX / 2) {
+        size *= 2;
+    }
+    if (size < requestedSize) {
+        size = requestedSize;
+    }
+
+    MediaBuffer *buffer = new MediaBuffer(size);
+    if (buffer->data() == NULL) {
+        ALOGE("failed to allocate a buffer of %zu bytes", size);
+        buffer->release();
+        return NULL;
+    }
+    addBuffer_l(buffer);
+    ALOGV("grew to %zu buffers for a request of %zu bytes", mNumBuffers, requestedSize);
+    return buffer;
 }
 
 status_t MediaBufferGroup::acquire_buffer(
-        MediaBuffer **out, bool nonBlocking) {
+        MediaBuffer **out, bool nonBlocking, size_t requestedSize) {
+    return acquireBuffer(out, nonBlocking, -1 /* timeoutUs */, requestedSize);
+}
+
+status_t MediaBufferGroup::acquire_buffer_timed(
+        MediaBuffer **out, int64_t timeoutUs, size_t requestedSize) {
+    return acquireBuffer(out, false /* nonBlocking */, timeoutUs, requestedSize);
+}
+
+status_t MediaBufferGroup::acquireBuffer(
+        MediaBuffer **out, bool nonBlocking, int64_t timeoutUs,
+        size_t requestedSize) {
     Mutex::Autolock autoLock(mLock);
 
-    for (;;) {
+    *out = NULL;
+
+    if (requestedSize > 0 && mGrowthLimit == 0) {
+        bool fits = false;
         for (MediaBuffer *buffer = mFirstBuffer;
              buffer != NULL; buffer = buffer->nextBuffer()) {
-            if (buffer->refcount() == 0) {
-                buffer->add_ref();
-                buffer->reset();
-
-                *out = buffer;
-                goto exit;
+            if (buffer->size() >= requestedSize) {
+                fits = true;
+                break;
             }
         }
+        if (!fits) {
+            // waiting would never end
+            ALOGE("no buffer holds the requested %zu bytes", requestedSize);
+            return BAD_VALUE;
+        }
+    }
+
+    nsecs_t deadline = timeoutUs >= 0
+            ? systemTime(SYSTEM_TIME_MONOTONIC) + timeoutUs * 1000ll : 0;
+
+    MediaBuffer *buffer = NULL;
+    for (;;) {
+        buffer = takeFreeBuffer_l(requestedSize);
+        if (buffer == NULL) {
+            buffer = grow_l(requestedSize);
+        }
+        if (buffer != NULL) {
+            break;
+        }
 
         if (nonBlocking) {
-            *out = NULL;
             return WOULD_BLOCK;
         }
 
-        // All buffers are in use. Block until one of them is returned to us.
-        mCondition.wait(mLock);
+        // All buffers are in use. Block until one of them is returned to
+        // us. The wait is announced before looking once more, so that a
+        // buffer returned after that look takes mLock to wake us up.
+        bool timedOut = false;
+        __sync_fetch_and_add(&mNumWaiters, 1);
+        buffer = takeFreeBuffer_l(requestedSize);
+        if (buffer == NULL) {
+            if (timeoutUs < 0) {
+                mCondition.wait(mLock);
+            } else {
+                nsecs_t remaining = deadline - systemTime(SYSTEM_TIME_MONOTONIC);
+                timedOut = remaining <= 0
+                        || mCondition.waitRelative(mLock, remaining) == TIMED_OUT;
+            }
+        }
+        __sync_fetch_and_sub(&mNumWaiters, 1);
+
+        if (buffer != NULL) {
+            break;
+        }
+        if (timedOut) {
+            buffer = takeFreeBuffer_l(requestedSize);
+            if (buffer == NULL) {
+                return TIMED_OUT;
+            }
+            break;
+        }
     }
 
-exit:
+    buffer->add_ref();
+    buffer->reset();
+
+    *out = buffer;
     return OK;
 }
 
-void MediaBufferGroup::signalBufferReturned(MediaBuffer *) {
-    Mutex::Autolock autoLock(mLock);
-    mCondition.signal();
+void MediaBufferGroup::signalBufferReturned(MediaBuffer *buffer) {
+    MediaBuffer *head;
+    do {
+        head = mReturnedBuffers;
+        buffer->mNextFree = head;
+    } while (!__sync_bool_compare_and_swap(&mReturnedBuffers, head, buffer));
+
+    if (__sync_fetch_and_add(&mNumWaiters, 0) > 0) {
+        Mutex::Autolock autoLock(mLock);
+        mCondition.broadcast();
+    }
 }
 
 }  // namespace android
@@ -20,31 +20,67 @@
 
 #include <media/stagefright/MediaClock.h>
 
+#include <cutils/atomic.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/ALooper.h>
 
+#include <sched.h>
+
 namespace android {
 
 MediaClock::MediaClock()
-    : mAnchorTimeMediaUs(-1),
-      mAnchorTimeRealUs(-1),
-      mMaxTimeMediaUs(INT64_MAX),
-      mStartingTimeMediaUs(-1),
-      mPlaybackRate(1.0) {
+    : mSeq(0) {
+    mState.mAnchorTimeMediaUs = -1;
+    mState.mAnchorTimeRealUs = -1;
+    mState.mMaxTimeMediaUs = INT64_MAX;
+    mState.mStartingTimeMediaUs = -1;
+    mState.mPlaybackRate = 1.0;
 }
 
 MediaClock::~MediaClock() {
 }
 
+void MediaClock::beginUpdate_l() {
+    // full barrier: the odd count is visible before any field changes
+    android_atomic_inc(&mSeq);
+}
+
+void MediaClock::endUpdate_l() {
+    // full barrier: all field changes are visible before the even count
+    android_atomic_inc(&mSeq);
+}
+
+void MediaClock::readState(State *state) const {
+    for (;;) {
+        int32_t seq = android_atomic_acquire_load(&mSeq);
+        if (seq & 1) {
+            // an update is in progress, it only touches a few fields
+            sched_yield();
+            continue;
+        }
+
+        *state = mState;
+
+        android_memory_barrier();
+        if (seq == mSeq) {
+            return;
+        }
+    }
+}
+
 void MediaClock::setStartingTimeMedia(int64_t startingTimeMediaUs) {
     Mutex::Autolock autoLock(mLock);
-    mStartingTimeMediaUs = startingTimeMediaUs;
+    beginUpdate_l();
+    mState.mStartingTimeMediaUs = startingTimeMediaUs;
+    endUpdate_l();
 }
 
 void MediaClock::clearAnchor() {
     Mutex::Autolock autoLock(mLock);
-    mAnchorTimeMediaUs = -1;
-    mAnchorTimeRealUs = -1;
+    beginUpdate_l();
+    mState.mAnchorTimeMediaUs = -1;
+    mState.mAnchorTimeRealUs = -1;
+    endUpdate_l();
 }
 
 void MediaClock::updateAnchor(
@@ -59,42 +95,53 @@ void MediaClock::updateAnchor(
     Mutex::Autolock autoLock(mLock);
     int64_t nowUs = ALooper::GetNowUs();
     int64_t nowMediaUs =
-        anchorTimeMediaUs + (nowUs - anchorTimeRealUs) * (double)mPlaybackRate;
+        anchorTimeMediaUs + (nowUs - anchorTimeRealUs) * (double)mState.mPlaybackRate;
     if (nowMediaUs < 0) {
         ALOGW("reject anchor time since it leads to negative media time.");
         return;
     }
-    mAnchorTimeRealUs = nowUs;
-    mAnchorTimeMediaUs = nowMediaUs;
-    mMaxTimeMediaUs = maxTimeMediaUs;
+    beginUpdate_l();
+    mState.mAnchorTimeRealUs = nowUs;
+    mState.mAnchorTimeMediaUs = nowMediaUs;
+    mState.mMaxTimeMediaUs = maxTimeMediaUs;
+    endUpdate_l();
 }
 
 void MediaClock::updateMaxTimeMedia(int64_t maxTimeMediaUs) {
     Mutex::Autolock autoLock(mLock);
-    mMaxTimeMediaUs = maxTimeMediaUs;
+    beginUpdate_l();
+    mState.mMaxTimeMediaUs = maxTimeMediaUs;
+    endUpdate_l();
 }
 
 void MediaClock::setPlaybackRate(float rate) {
     CHECK_GE(rate, 0.0);
     Mutex::Autolock autoLock(mLock);
-    if (mAnchorTimeRealUs == -1) {
-        mPlaybackRate = rate;
+    if (mState.mAnchorTimeRealUs == -1) {
+        beginUpdate_l();
+        mState.mPlaybackRate = rate;
+        endUpdate_l();
         return;
     }
 
     int64_t nowUs = ALooper::GetNowUs();
-    mAnchorTimeMediaUs += (nowUs - mAnchorTimeRealUs) * (double)mPlaybackRate;
-    if (mAnchorTimeMediaUs < 0) {
+    int64_t anchorTimeMediaUs = mState.mAnchorTimeMediaUs
+            + (nowUs - mState.mAnchorTimeRealUs) * (double)mState.mPlaybackRate;
+    if (anchorTimeMediaUs < 0) {
         ALOGW("setRate: anchor time should not be negative, set to 0.");
-        mAnchorTimeMediaUs = 0;
+        anchorTimeMediaUs = 0;
     }
-    mAnchorTimeRealUs = nowUs;
-    mPlaybackRate = rate;
+    beginUpdate_l();
+    mState.mAnchorTimeMediaUs = anchorTimeMediaUs;
+    mState.mAnchorTimeRealUs = nowUs;
+    mState.mPlaybackRate = rate;
+    endUpdate_l();
 }
 
 float MediaClock::getPlaybackRate() const {
-    Mutex::Autolock autoLock(mLock);
-    return mPlaybackRate;
+    State state;
+    readState(&state);
+    return state.mPlaybackRate;
 }
 
 status_t MediaClock::getMediaTime(
@@ -103,23 +150,25 @@ status_t MediaClock::getMediaTime(
         return BAD_VALUE;
     }
 
-    Mutex::Autolock autoLock(mLock);
-    return getMediaTime_l(realUs, outMediaUs, allowPastMaxTime);
+    State state;
+    readState(&state);
+    return GetMediaTime(state, realUs, outMediaUs, allowPastMaxTime);
 }
 
-status_t MediaClock::getMediaTime_l(
-        int64_t realUs, int64_t *outMediaUs, bool allowPastMaxTime) const {
-    if (mAnchorTimeRealUs == -1) {
+// static
+status_t MediaClock::GetMediaTime(
+        const State &state, int64_t realUs, int64_t *outMediaUs, bool allowPastMaxTime) {
+    if (state.mAnchorTimeRealUs == -1) {
         return NO_INIT;
     }
 
-    int64_t mediaUs = mAnchorTimeMediaUs
-            + (realUs - mAnchorTimeRealUs) * (double)mPlaybackRate;
-    if (mediaUs > mMaxTimeMediaUs && !allowPastMaxTime) {
-        mediaUs = mMaxTimeMediaUs;
+    int64_t mediaUs = state.mAnchorTimeMediaUs
+            + (realUs - state.mAnchorTimeRealUs) * (double)state.mPlaybackRate;
+    if (mediaUs > state.mMaxTimeMediaUs && !allowPastMaxTime) {
+        mediaUs = state.mMaxTimeMediaUs;
     }
-    if (mediaUs < mStartingTimeMediaUs) {
-        mediaUs = mStartingTimeMediaUs;
+    if (mediaUs < state.mStartingTimeMediaUs) {
+        mediaUs = state.mStartingTimeMediaUs;
     }
     if (mediaUs < 0) {
         mediaUs = 0;
@@ -134,19 +183,20 @@ status_t MediaClock::getRealTimeFor(
         return BAD_VALUE;
     }
 
-    Mutex::Autolock autoLock(mLock);
-    if (mPlaybackRate == 0.0) {
+    State state;
+    readState(&state);
+    if (state.mPlaybackRate == 0.0) {
         return NO_INIT;
     }
 
     int64_t nowUs = ALooper::GetNowUs();
     int64_t nowMediaUs;
     status_t status =
-            getMediaTime_l(nowUs, &nowMediaUs, true /* allowPastMaxTime */);
+            GetMediaTime(state, nowUs, &nowMediaUs, true /* allowPastMaxTime */);
     if (status != OK) {
         return status;
     }
-    *outRealUs = (targetMediaUs - nowMediaUs) / (double)mPlaybackRate + nowUs;
+    *outRealUs = (targetMediaUs - nowMediaUs) / (double)state.mPlaybackRate + nowUs;
     return OK;
 }
 
@@ -263,6 +263,8 @@ MediaCodec::MediaCodec(const sp<ALooper> &looper, pid_t pid)
       mDequeueInputReplyID(0),
       mDequeueOutputTimeoutGeneration(0),
       mDequeueOutputReplyID(0),
+      mDequeueOutputBatch(NULL),
+      mDequeueOutputBatchSize(0),
       mHaveInputSurface(false),
       mHavePendingInputBuffers(false) {
 }
@@ -674,6 +676,32 @@ status_t MediaCodec::queueInputBuffer(
     return PostAndAwaitResponse(msg, &response);
 }
 
+status_t MediaCodec::queueInputBuffers(
+        const BatchBuffer *buffers,
+        size_t count,
+        size_t *numQueued,
+        AString *errorDetailMsg) {
+    if (errorDetailMsg != NULL) {
+        errorDetailMsg->clear();
+    }
+    *numQueued = 0;
+    if (count == 0) {
+        return OK;
+    }
+
+    sp<AMessage> msg = new AMessage(kWhatQueueInputBuffers, this);
+    msg->setPointer("buffers", (void *)buffers);
+    msg->setSize("count", count);
+    msg->setPointer("errorDetailMsg", errorDetailMsg);
+
+    sp<AMessage> response;
+    status_t err = PostAndAwaitResponse(msg, &response);
+    if (response != NULL) {
+        response->findSize("numQueued", numQueued);
+    }
+    return err;
+}
+
 status_t MediaCodec::queueSecureInputBuffer(
         size_t index,
         size_t offset,
@@ -747,6 +775,32 @@ status_t MediaCodec::dequeueOutputBuffer(
     return OK;
 }
 
+status_t MediaCodec::dequeueOutputBuffers(
+        BatchBuffer *buffers,
+        size_t maxCount,
+        size_t *count,
+        int64_t timeoutUs) {
+    if (maxCount == 0) {
+        return -EINVAL;
+    }
+
+    // the looper fills in buffers directly, we are blocked until it replies
+    sp<AMessage> msg = new AMessage(kWhatDequeueOutputBuffer, this);
+    msg->setInt64("timeoutUs", timeoutUs);
+    msg->setPointer("buffers", buffers);
+    msg->setSize("maxCount", maxCount);
+
+    sp<AMessage> response;
+    status_t err;
+    if ((err = PostAndAwaitResponse(msg, &response)) != OK) {
+        return err;
+    }
+
+    CHECK(response->findSize("count", count));
+
+    return OK;
+}
+
 status_t MediaCodec::renderOutputBufferAndRelease(size_t index) {
     sp<AMessage> msg = new AMessage(kWhatReleaseOutputBuffer, this);
     msg->setSize("index", index);
@@ -967,6 +1021,32 @@ bool MediaCodec::handleDequeueInputBuffer(const sp<AReplyToken> &replyID, bool n
     return true;
 }
 
+void MediaCodec::takeOutputBuffer(size_t index, BatchBuffer *info) {
+    const sp<ABuffer> &buffer =
+        mPortBuffers[kPortIndexOutput].itemAt(index).mData;
+
+    info->mIndex = index;
+    info->mOffset = buffer->offset();
+    info->mSize = buffer->size();
+
+    CHECK(buffer->meta()->findInt64("timeUs", &info->mPresentationTimeUs));
+
+    int32_t omxFlags;
+    CHECK(buffer->meta()->findInt32("omxFlags", &omxFlags));
+
+    uint32_t flags = 0;
+    if (omxFlags & OMX_BUFFERFLAG_SYNCFRAME) {
+        flags |= BUFFER_FLAG_SYNCFRAME;
+    }
+    if (omxFlags & OMX_BUFFERFLAG_CODECCONFIG) {
+        flags |= BUFFER_FLAG_CODECCONFIG;
+    }
+    if (omxFlags & OMX_BUFFERFLAG_EOS) {
+        flags |= BUFFER_FLAG_EOS;
+    }
+    info->mFlags = flags;
+}
+
 bool MediaCodec::handleDequeueOutputBuffer(const sp<AReplyToken> &replyID, bool newRequest) {
     if (!isExecuting() || (mFlags & kFlagIsAsync)
             || (newRequest && (mFlags & kFlagDequeueOutputPending))) {
@@ -988,33 +1068,29 @@ bool MediaCodec::handleDequeueOutputBuffer(const sp<AReplyToken> &replyID, bool
             return false;
         }
 
-        const sp<ABuffer> &buffer =
-            mPortBuffers[kPortIndexOutput].itemAt(index).mData;
-
-        response->setSize("index", index);
-        response->setSize("offset", buffer->offset());
-        response->setSize("size", buffer->size());
-
-        int64_t timeUs;
-        CHECK(buffer->meta()->findInt64("timeUs", &timeUs));
-
-        response->setInt64("timeUs", timeUs);
+        if (mDequeueOutputBatch != NULL) {
+            // Format and buffer changes are only flagged from other messages,
+            // so everything available now can go out with this reply.
+            size_t count = 0;
+            do {
+                takeOutputBuffer(index, &mDequeueOutputBatch[count++]);
+            } while (count < mDequeueOutputBatchSize
+                    && (index = dequeuePortBuffer(kPortIndexOutput)) >= 0);
 
-        int32_t omxFlags;
-        CHECK(buffer->meta()->findInt32("omxFlags", &omxFlags));
-
-        uint32_t flags = 0;
-        if (omxFlags & OMX_BUFFERFLAG_SYNCFRAME) {
-            flags |= BUFFER_FLAG_SYNCFRAME;
-        }
-        if (omxFlags & OMX_BUFFERFLAG_CODECCONFIG) {
-            flags |= BUFFER_FLAG_CODECCONFIG;
-        }
-        if (omxFlags & OMX_BUFFERFLAG_EOS) {
-            flags |= BUFFER_FLAG_EOS;
+            mDequeueOutputBatch = NULL;
+            response->setSize("count", count);
+            response->postReply(replyID);
+            return true;
         }
 
-        response->setInt32("flags", flags);
+        BatchBuffer info;
+        takeOutputBuffer(index, &info);
+
+        response->setSize("index", index);
+        response->setSize("offset", info.mOffset);
+        response->setSize("size", info.mSize);
+        response->setInt64("timeUs", info.mPresentationTimeUs);
+        response->setInt32("flags", info.mFlags);
         response->postReply(replyID);
     }
 
@@ -1314,6 +1390,7 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
 
                         buffers->push_back(info);
                     }
+                    mAvailPortBuffers[portIndex].setCapacity(numBuffers);
 
                     if (portIndex == kPortIndexOutput) {
                         if (mState == STARTING) {
@@ -1964,6 +2041,49 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatQueueInputBuffers:
+        {
+            sp<AReplyToken> replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+
+            if (!isExecuting()) {
+                PostReplyWithError(replyID, INVALID_OPERATION);
+                break;
+            } else if (mFlags & kFlagStickyError) {
+                PostReplyWithError(replyID, getStickyError());
+                break;
+            }
+
+            const BatchBuffer *buffers;
+            size_t count;
+            CHECK(msg->findPointer("buffers", (void **)&buffers));
+            CHECK(msg->findSize("count", &count));
+
+            // reuse the request as the per-buffer message, its items are
+            // overwritten in place
+            status_t err = OK;
+            size_t numQueued = 0;
+            for (; numQueued < count; ++numQueued) {
+                const BatchBuffer &buffer = buffers[numQueued];
+                msg->setSize("index", buffer.mIndex);
+                msg->setSize("offset", buffer.mOffset);
+                msg->setSize("size", buffer.mSize);
+                msg->setInt64("timeUs", buffer.mPresentationTimeUs);
+                msg->setInt32("flags", buffer.mFlags);
+
+                err = onQueueInputBuffer(msg);
+                if (err != OK) {
+                    break;
+                }
+            }
+
+            sp<AMessage> response = new AMessage;
+            response->setInt32("err", err);
+            response->setSize("numQueued", numQueued);
+            response->postReply(replyID);
+            break;
+        }
+
         case kWhatDequeueOutputBuffer:
         {
             sp<AReplyToken> replyID;
@@ -1975,6 +2095,14 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
                 break;
             }
 
+            if (!(mFlags & kFlagDequeueOutputPending)) {
+                mDequeueOutputBatch = NULL;
+                mDequeueOutputBatchSize = 0;
+                if (msg->findPointer("buffers", (void **)&mDequeueOutputBatch)) {
+                    CHECK(msg->findSize("maxCount", &mDequeueOutputBatchSize));
+                }
+            }
+
             if (handleDequeueOutputBuffer(replyID, true /* new request */)) {
                 break;
             }
@@ -2327,7 +2455,7 @@ size_t MediaCodec::updateBuffers(
 
             info->mFormat =
                 (portIndex == kPortIndexInput) ? mInputFormat : mOutputFormat;
-            mAvailPortBuffers[portIndex].push_back(i);
+            mAvailPortBuffers[portIndex].push(i);
 
             return i;
         }
@@ -2540,17 +2668,41 @@ status_t MediaCodec::onReleaseOutputBuffer(const sp<AMessage> &msg) {
     return OK;
 }
 
+void MediaCodec::AvailableBuffers::setCapacity(size_t capacity) {
+    mSlots.resize(capacity);
+    clear();
+}
+
+void MediaCodec::AvailableBuffers::push(size_t index) {
+    CHECK_LT(mCount, mSlots.size());
+    size_t slot = mHead + mCount;
+    if (slot >= mSlots.size()) {
+        slot -= mSlots.size();
+    }
+    mSlots.editItemAt(slot) = index;
+    ++mCount;
+}
+
+size_t MediaCodec::AvailableBuffers::pop() {
+    CHECK_GT(mCount, 0u);
+    size_t index = mSlots[mHead];
+    if (++mHead == mSlots.size()) {
+        mHead = 0;
+    }
+    --mCount;
+    return index;
+}
+
 ssize_t MediaCodec::dequeuePortBuffer(int32_t portIndex) {
     CHECK(portIndex == kPortIndexInput || portIndex == kPortIndexOutput);
 
-    List<size_t> *availBuffers = &mAvailPortBuffers[portIndex];
+    AvailableBuffers *availBuffers = &mAvailPortBuffers[portIndex];
 
     if (availBuffers->empty()) {
         return -EAGAIN;
     }
 
-    size_t index = *availBuffers->begin();
-    availBuffers->erase(availBuffers->begin());
+    size_t index = availBuffers->pop();
 
     BufferInfo *info = &mPortBuffers[portIndex].editItemAt(index);
     CHECK(!info->mOwnedByClient);
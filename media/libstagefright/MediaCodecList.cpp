@@ -21,6 +21,7 @@
 #include "MediaCodecListOverrides.h"
 
 #include <binder/IServiceManager.h>
+#include <binder/Parcel.h>
 
 #include <media/IMediaCodecList.h>
 #include <media/IMediaPlayerService.h>
@@ -35,7 +36,10 @@
 #include <media/stagefright/OMXClient.h>
 #include <media/stagefright/OMXCodec.h>
 
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #include <utils/threads.h>
 
 #include <cutils/properties.h>
@@ -45,6 +49,12 @@ namespace android {
 
 const char *kMaxEncoderInputBuffers = "max-video-encoder-input-buffers";
 
+// The fully parsed list, including the capabilities queried from OMX, so that
+// processes do not have to parse the xml files and query every component.
+static const char *kCodecListCache = "/data/misc/media/media_codecs_cache.bin";
+static const int32_t kCodecListCacheMagic = 'MCLc';
+static const int32_t kCodecListCacheVersion = 1;
+
 static Mutex sInitMutex;
 
 static bool parseBoolean(const char *s) {
@@ -174,9 +184,137 @@ MediaCodecList::MediaCodecList()
     : mInitCheck(NO_INIT),
       mUpdate(false),
       mGlobalSettings(new AMessage()) {
+    if (loadCache()) {
+        configureResourcePolicies();
+        return;
+    }
+
     parseTopLevelXMLFile("/etc/media_codecs.xml");
     parseTopLevelXMLFile("/etc/media_codecs_performance.xml", true/* ignore_errors */);
     parseTopLevelXMLFile(kProfilingResults, true/* ignore_errors */);
+
+    if (mInitCheck == OK) {
+        writeCache();
+    }
+}
+
+// Identifies the version of an xml file, or its absence (-1).
+static void getFileStamp(const char *path, int64_t *size, int64_t *mtimeNs) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        *size = -1;
+        *mtimeNs = -1;
+        return;
+    }
+    *size = st.st_size;
+    *mtimeNs = st.st_mtim.tv_sec * 1000000000ll + st.st_mtim.tv_nsec;
+}
+
+static void writeCacheHeader(Parcel *parcel) {
+    char fingerprint[PROPERTY_VALUE_MAX];
+    property_get("ro.build.fingerprint", fingerprint, "");
+
+    parcel->writeInt32(kCodecListCacheMagic);
+    parcel->writeInt32(kCodecListCacheVersion);
+    AString(fingerprint).writeToParcel(parcel);
+}
+
+bool MediaCodecList::loadCache() {
+    int fd = open(kCodecListCache, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    void *data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    Parcel cache;
+    cache.setData((const uint8_t *)data, st.st_size);
+    munmap(data, st.st_size);
+
+    // the header must match exactly what we would write now
+    Parcel expected;
+    writeCacheHeader(&expected);
+    if (cache.dataSize() < expected.dataSize()
+            || memcmp(cache.data(), expected.data(), expected.dataSize())) {
+        ALOGV("codec list cache is from another version or build");
+        return false;
+    }
+    cache.setDataPosition(expected.dataSize());
+
+    int32_t numFiles = cache.readInt32();
+    if (numFiles <= 0) {
+        return false;
+    }
+    for (int32_t i = 0; i < numFiles; ++i) {
+        AString path = AString::FromParcel(cache);
+        int64_t size = cache.readInt64();
+        int64_t mtimeNs = cache.readInt64();
+
+        int64_t currentSize, currentMtimeNs;
+        getFileStamp(path.c_str(), &currentSize, &currentMtimeNs);
+        if (currentSize != size || currentMtimeNs != mtimeNs) {
+            ALOGV("codec list cache is stale, %s changed", path.c_str());
+            return false;
+        }
+    }
+
+    sp<AMessage> globalSettings = AMessage::FromParcel(cache);
+    Vector<sp<MediaCodecInfo> > infos;
+    int32_t numCodecs = cache.readInt32();
+    for (int32_t i = 0; i < numCodecs && cache.dataAvail() > 0; ++i) {
+        infos.push_back(MediaCodecInfo::FromParcel(cache));
+    }
+    if (globalSettings == NULL || numCodecs <= 0 || (int32_t)infos.size() != numCodecs) {
+        ALOGW("ignoring malformed codec list cache");
+        return false;
+    }
+
+    mGlobalSettings = globalSettings;
+    mCodecInfos = infos;
+    mInitCheck = OK;
+    return true;
+}
+
+void MediaCodecList::writeCache() const {
+    Parcel cache;
+    writeCacheHeader(&cache);
+
+    cache.writeInt32(mParsedFiles.size());
+    for (size_t i = 0; i < mParsedFiles.size(); ++i) {
+        int64_t size, mtimeNs;
+        getFileStamp(mParsedFiles[i].c_str(), &size, &mtimeNs);
+        mParsedFiles[i].writeToParcel(&cache);
+        cache.writeInt64(size);
+        cache.writeInt64(mtimeNs);
+    }
+
+    mGlobalSettings->writeToParcel(&cache);
+    cache.writeInt32(mCodecInfos.size());
+    for (size_t i = 0; i < mCodecInfos.size(); ++i) {
+        mCodecInfos[i]->writeToParcel(&cache);
+    }
+
+    // Only the media server can write the cache directory. Write a private
+    // file first, so readers never see a partial cache.
+    AString tmpPath = AStringPrintf("%s.%d", kCodecListCache, getpid());
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return;
+    }
+    bool ok = write(fd, cache.data(), cache.dataSize()) == (ssize_t)cache.dataSize();
+    close(fd);
+    if (!ok || rename(tmpPath.c_str(), kCodecListCache) != 0) {
+        ALOGW("failed to write codec list cache");
+        unlink(tmpPath.c_str());
+    }
 }
 
 void MediaCodecList::parseTopLevelXMLFile(const char *codecs_xml, bool ignore_errors) {
@@ -208,30 +346,7 @@ void MediaCodecList::parseTopLevelXMLFile(const char *codecs_xml, bool ignore_er
         return;
     }
 
-    Vector<MediaResourcePolicy> policies;
-    AString value;
-    if (mGlobalSettings->findString(kPolicySupportsMultipleSecureCodecs, &value)) {
-        policies.push_back(
-                MediaResourcePolicy(
-                        String8(kPolicySupportsMultipleSecureCodecs),
-                        String8(value.c_str())));
-    }
-    if (mGlobalSettings->findString(kPolicySupportsSecureWithNonSecureCodec, &value)) {
-        policies.push_back(
-                MediaResourcePolicy(
-                        String8(kPolicySupportsSecureWithNonSecureCodec),
-                        String8(value.c_str())));
-    }
-    if (policies.size() > 0) {
-        sp<IServiceManager> sm = defaultServiceManager();
-        sp<IBinder> binder = sm->getService(String16("media.resource_manager"));
-        sp<IResourceManagerService> service = interface_cast<IResourceManagerService>(binder);
-        if (service == NULL) {
-            ALOGE("MediaCodecList: failed to get ResourceManagerService");
-        } else {
-            service->config(policies);
-        }
-    }
+    configureResourcePolicies();
 
     for (size_t i = mCodecInfos.size(); i > 0;) {
         i--;
@@ -314,6 +429,33 @@ void MediaCodecList::parseTopLevelXMLFile(const char *codecs_xml, bool ignore_er
 #endif
 }
 
+void MediaCodecList::configureResourcePolicies() {
+    Vector<MediaResourcePolicy> policies;
+    AString value;
+    if (mGlobalSettings->findString(kPolicySupportsMultipleSecureCodecs, &value)) {
+        policies.push_back(
+                MediaResourcePolicy(
+                        String8(kPolicySupportsMultipleSecureCodecs),
+                        String8(value.c_str())));
+    }
+    if (mGlobalSettings->findString(kPolicySupportsSecureWithNonSecureCodec, &value)) {
+        policies.push_back(
+                MediaResourcePolicy(
+                        String8(kPolicySupportsSecureWithNonSecureCodec),
+                        String8(value.c_str())));
+    }
+    if (policies.size() > 0) {
+        sp<IServiceManager> sm = defaultServiceManager();
+        sp<IBinder> binder = sm->getService(String16("media.resource_manager"));
+        sp<IResourceManagerService> service = interface_cast<IResourceManagerService>(binder);
+        if (service == NULL) {
+            ALOGE("MediaCodecList: failed to get ResourceManagerService");
+        } else {
+            service->config(policies);
+        }
+    }
+}
+
 MediaCodecList::~MediaCodecList() {
 }
 
@@ -322,6 +464,8 @@ status_t MediaCodecList::initCheck() const {
 }
 
 void MediaCodecList::parseXMLFile(const char *path) {
+    mParsedFiles.push_back(AString(path));
+
     FILE *file = fopen(path, "r");
 
     if (file == NULL) {
@@ -27,9 +27,13 @@
 #include <media/MediaCodecInfo.h>
 #include <media/MediaResourcePolicy.h>
 #include <media/openmax/OMX_IVCommon.h>
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/MediaCodec.h>
 #include <media/stagefright/MediaCodecList.h>
+#include <media/stagefright/MediaErrors.h>
 
 namespace android {
 
@@ -48,8 +52,34 @@ AString getProfilingVersionString() {
 // this should be in sync with the MAX_SUPPORTED_INSTANCES defined in MediaCodecInfo.java.
 static const int kMaxInstances = 32;
 
+// the sizes measured-frame-rate limits are reported for
+static const int32_t kMeasuredSizes[][2] = {
+    { 320, 240 }, { 720, 480 }, { 1280, 720 }, { 1920, 1080 },
+};
+
+static const int64_t kFrameDurationUs = 33333;
+static const int64_t kCodecTimeoutUs = 10000;
+// a run is abandoned if the codec consumes or produces nothing for this long
+static const int64_t kCodecStallUs = 5000000;
+
+static bool parseSize(const AString &size, int32_t *width, int32_t *height) {
+    AString sWidth;
+    AString sHeight;
+    if (!splitString(size, "x", &sWidth, &sHeight)) {
+        if (!splitString(size, "*", &sWidth, &sHeight)) {
+            return false;
+        }
+    }
+
+    *width = strtol(sWidth.c_str(), NULL, 10);
+    *height = strtol(sHeight.c_str(), NULL, 10);
+    return (*width > 0) && (*height > 0);
+}
+
 // TODO: move MediaCodecInfo to C++. Until then, some temp methods to parse out info.
-static bool getMeasureSize(sp<MediaCodecInfo::Capabilities> caps, int32_t *width, int32_t *height) {
+static bool getSizeRange(
+        sp<MediaCodecInfo::Capabilities> caps,
+        int32_t *minWidth, int32_t *minHeight, int32_t *maxWidth, int32_t *maxHeight) {
     AString sizeRange;
     if (!caps->getDetails()->findString("size-range", &sizeRange)) {
         return false;
@@ -59,17 +89,12 @@ static bool getMeasureSize(sp<MediaCodecInfo::Capabilities> caps, int32_t *width
     if (!splitString(sizeRange, "-", &minSize, &maxSize)) {
         return false;
     }
-    AString sWidth;
-    AString sHeight;
-    if (!splitString(minSize, "x", &sWidth, &sHeight)) {
-        if (!splitString(minSize, "*", &sWidth, &sHeight)) {
-            return false;
-        }
-    }
+    return parseSize(minSize, minWidth, minHeight) && parseSize(maxSize, maxWidth, maxHeight);
+}
 
-    *width = strtol(sWidth.c_str(), NULL, 10);
-    *height = strtol(sHeight.c_str(), NULL, 10);
-    return (*width > 0) && (*height > 0);
+static bool getMeasureSize(sp<MediaCodecInfo::Capabilities> caps, int32_t *width, int32_t *height) {
+    int32_t maxWidth, maxHeight;
+    return getSizeRange(caps, width, height, &maxWidth, &maxHeight);
 }
 
 static void getMeasureBitrate(sp<MediaCodecInfo::Capabilities> caps, int32_t *bitrate) {
@@ -260,6 +285,353 @@ bool splitString(
     return true;
 }
 
+// Fills |buffer| with frame |index| of a clip whose luma pattern moves diagonally, so that
+// encoders see motion. Chroma is flat, so planar and semi-planar layouts are the same.
+static status_t fillSyntheticFrame(
+        const sp<ABuffer> &buffer, const sp<ABuffer> &pattern,
+        int32_t width, int32_t height, int32_t stride, int32_t sliceHeight, size_t index) {
+    size_t lumaSize = (size_t)stride * sliceHeight;
+    if (lumaSize * 3 / 2 > buffer->capacity()) {
+        return ERROR_BUFFER_TOO_SMALL;
+    }
+    uint8_t *dst = buffer->base();
+    for (int32_t y = 0; y < height; ++y) {
+        memcpy(dst + y * stride, pattern->data() + ((y + index * 4) & 0xff), width);
+    }
+    memset(dst + lumaSize, 128, lumaSize / 2);
+    buffer->setRange(0, lumaSize * 3 / 2);
+    return OK;
+}
+
+static int compareLatency(const int64_t *a, const int64_t *b) {
+    return *a < *b ? -1 : *a > *b ? 1 : 0;
+}
+
+// Feeds a started |codec| with |clip| or, if it is NULL, with |numFrames| synthetic frames,
+// until it signals the end of stream. Encoded access units are saved to |encoded| if it is
+// not NULL; codec config data is marked with a "csd" entry in their meta data.
+static status_t runCodec(
+        const sp<MediaCodec> &codec, bool render, const Vector<sp<ABuffer> > *clip,
+        int32_t width, int32_t height, size_t numFrames,
+        Vector<sp<ABuffer> > *encoded, CodecBenchmarkResult *result) {
+    int32_t stride = width;
+    int32_t sliceHeight = height;
+    sp<AMessage> inputFormat;
+    if (clip == NULL && codec->getInputFormat(&inputFormat) == OK) {
+        inputFormat->findInt32("stride", &stride);
+        inputFormat->findInt32("slice-height", &sliceHeight);
+        stride = stride < width ? width : stride;
+        sliceHeight = sliceHeight < height ? height : sliceHeight;
+    }
+    sp<ABuffer> pattern = new ABuffer(width + 256);
+    for (size_t i = 0; i < pattern->size(); ++i) {
+        pattern->data()[i] = i & 0xff;
+    }
+
+    size_t numInputs = clip != NULL ? clip->size() : numFrames;
+    size_t inputIndex = 0;
+    bool sawOutputEOS = false;
+    KeyedVector<int64_t, int64_t> queuedAtUs;
+    Vector<int64_t> latenciesUs;
+
+    const int64_t startUs = ALooper::GetNowUs();
+    int64_t lastProgressUs = startUs;
+    while (!sawOutputEOS) {
+        if (ALooper::GetNowUs() - lastProgressUs > kCodecStallUs) {
+            ALOGW("codec stalled after %zu of %zu inputs", inputIndex, numInputs);
+            return TIMED_OUT;
+        }
+
+        size_t index;
+        if (inputIndex <= numInputs && codec->dequeueInputBuffer(&index) == OK) {
+            sp<ABuffer> buffer;
+            status_t err = codec->getInputBuffer(index, &buffer);
+            if (err != OK) {
+                return err;
+            }
+
+            int64_t timeUs = 0;
+            uint32_t flags = 0;
+            buffer->setRange(0, 0);
+            if (inputIndex == numInputs) {
+                flags = MediaCodec::BUFFER_FLAG_EOS;
+            } else if (clip != NULL) {
+                const sp<ABuffer> &unit = clip->itemAt(inputIndex);
+                if (unit->size() > buffer->capacity()) {
+                    return ERROR_BUFFER_TOO_SMALL;
+                }
+                memcpy(buffer->base(), unit->data(), unit->size());
+                buffer->setRange(0, unit->size());
+                int32_t csd;
+                if (unit->meta()->findInt32("csd", &csd) && csd) {
+                    flags = MediaCodec::BUFFER_FLAG_CODECCONFIG;
+                } else {
+                    CHECK(unit->meta()->findInt64("timeUs", &timeUs));
+                }
+            } else {
+                err = fillSyntheticFrame(
+                        buffer, pattern, width, height, stride, sliceHeight, inputIndex);
+                if (err != OK) {
+                    return err;
+                }
+                timeUs = inputIndex * kFrameDurationUs;
+            }
+
+            lastProgressUs = ALooper::GetNowUs();
+            if (flags == 0) {
+                queuedAtUs.add(timeUs, lastProgressUs);
+            }
+            err = codec->queueInputBuffer(index, 0, buffer->size(), timeUs, flags);
+            if (err != OK) {
+                return err;
+            }
+            ++inputIndex;
+        }
+
+        size_t offset;
+        size_t size;
+        int64_t timeUs;
+        uint32_t flags;
+        status_t err = codec->dequeueOutputBuffer(
+                &index, &offset, &size, &timeUs, &flags,
+                inputIndex <= numInputs ? 1000ll : kCodecTimeoutUs);
+        if (err == -EAGAIN || err == INFO_FORMAT_CHANGED || err == INFO_OUTPUT_BUFFERS_CHANGED) {
+            continue;
+        } else if (err != OK) {
+            return err;
+        }
+        lastProgressUs = ALooper::GetNowUs();
+
+        if (encoded != NULL && size > 0) {
+            sp<ABuffer> buffer;
+            err = codec->getOutputBuffer(index, &buffer);
+            if (err != OK) {
+                return err;
+            }
+            sp<ABuffer> unit = new ABuffer(size);
+            memcpy(unit->data(), buffer->base() + offset, size);
+            if (flags & MediaCodec::BUFFER_FLAG_CODECCONFIG) {
+                unit->meta()->setInt32("csd", true);
+            } else {
+                unit->meta()->setInt64("timeUs", timeUs);
+            }
+            encoded->push(unit);
+        }
+
+        if (!(flags & MediaCodec::BUFFER_FLAG_CODECCONFIG)) {
+            ssize_t ix = queuedAtUs.indexOfKey(timeUs);
+            if (ix >= 0) {
+                latenciesUs.push(lastProgressUs - queuedAtUs.valueAt(ix));
+                queuedAtUs.removeItemsAt(ix);
+            }
+        }
+        sawOutputEOS = (flags & MediaCodec::BUFFER_FLAG_EOS) != 0;
+
+        err = render ? codec->renderOutputBufferAndRelease(index)
+                : codec->releaseOutputBuffer(index);
+        if (err != OK) {
+            return err;
+        }
+    }
+
+    if (latenciesUs.isEmpty()) {
+        return ERROR_MALFORMED;
+    }
+    latenciesUs.sort(compareLatency);
+    int64_t elapsedUs = ALooper::GetNowUs() - startUs;
+    result->mNumFrames = latenciesUs.size();
+    result->mFrameRate = elapsedUs > 0 ? latenciesUs.size() * 1E6 / elapsedUs : 0;
+    result->mMedianLatencyUs = latenciesUs[latenciesUs.size() / 2];
+    result->mP90LatencyUs = latenciesUs[latenciesUs.size() * 9 / 10];
+    result->mMaxLatencyUs = latenciesUs.top();
+    return OK;
+}
+
+static status_t getBenchmarkColorFormat(
+        const AString &name, const AString &mime, int32_t *colorFormat) {
+    sp<IMediaCodecList> list = MediaCodecList::getInstance();
+    ssize_t index = list == NULL ? -1 : list->findCodecByName(name.c_str());
+    if (index < 0) {
+        return NAME_NOT_FOUND;
+    }
+    const sp<MediaCodecInfo::Capabilities> caps =
+            list->getCodecInfo(index)->getCapabilitiesFor(mime.c_str());
+    if (caps == NULL) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    // only layouts that fillSyntheticFrame() can produce
+    Vector<uint32_t> colorFormats;
+    caps->getSupportedColorFormats(&colorFormats);
+    for (size_t i = 0; i < colorFormats.size(); ++i) {
+        if (colorFormats[i] == OMX_COLOR_FormatYUV420Planar
+                || colorFormats[i] == OMX_COLOR_FormatYUV420SemiPlanar) {
+            *colorFormat = colorFormats[i];
+            return OK;
+        }
+    }
+    return ERROR_UNSUPPORTED;
+}
+
+static status_t doBenchmarkCodec(
+        bool isEncoder, const AString &name, const AString &mime,
+        int32_t width, int32_t height, int32_t bitrate,
+        const sp<Surface> &surface, const Vector<sp<ABuffer> > *clip, size_t numFrames,
+        Vector<sp<ABuffer> > *encoded, CodecBenchmarkResult *result) {
+    sp<AMessage> format = new AMessage();
+    format->setString("mime", mime);
+    format->setInt32("width", width);
+    format->setInt32("height", height);
+    if (isEncoder) {
+        int32_t colorFormat;
+        status_t err = getBenchmarkColorFormat(name, mime, &colorFormat);
+        if (err != OK) {
+            return err;
+        }
+        format->setInt32("color-format", colorFormat);
+        format->setInt32("bitrate", bitrate);
+        format->setFloat("frame-rate", 1E6 / kFrameDurationUs);
+        format->setInt32("i-frame-interval", 1);
+    }
+
+    sp<ALooper> looper = new ALooper;
+    looper->setName("MediaCodec_benchmark");
+    looper->start(
+            false /* runOnCallingThread */, false /* canCallJava */, ANDROID_PRIORITY_AUDIO);
+
+    status_t err = OK;
+    sp<MediaCodec> codec = MediaCodec::CreateByComponentName(looper, name.c_str(), &err);
+    if (codec == NULL) {
+        ALOGV("Failed to create codec: %s", name.c_str());
+        return err != OK ? err : UNKNOWN_ERROR;
+    }
+
+    err = codec->configure(
+            format, surface, NULL /* crypto */,
+            isEncoder ? MediaCodec::CONFIGURE_FLAG_ENCODE : 0);
+    if (err == OK) {
+        err = codec->start();
+    }
+    if (err == OK) {
+        err = runCodec(codec, !isEncoder && surface != NULL, clip,
+                width, height, numFrames, encoded, result);
+    }
+    if (err != OK) {
+        ALOGV("benchmark of %s with %s at %dx%d failed: %d",
+                name.c_str(), mime.c_str(), width, height, err);
+    }
+    codec->release();
+    looper->stop();
+    return err;
+}
+
+status_t benchmarkCodec(
+        bool isEncoder,
+        const AString &name,
+        const AString &mime,
+        int32_t width,
+        int32_t height,
+        int32_t bitrate,
+        const sp<Surface> &surface,
+        size_t numFrames,
+        CodecBenchmarkResult *result) {
+    if (isEncoder) {
+        return doBenchmarkCodec(true /* isEncoder */, name, mime, width, height, bitrate,
+                NULL /* surface */, NULL /* clip */, numFrames, NULL /* encoded */, result);
+    }
+
+    // decoders need a bitstream, encode one with the first encoder for the mime
+    sp<IMediaCodecList> list = MediaCodecList::getInstance();
+    ssize_t index = list == NULL ? -1 : list->findCodecByType(mime.c_str(), true /* encoder */);
+    if (index < 0) {
+        ALOGV("no encoder to make a %s clip for %s", mime.c_str(), name.c_str());
+        return NAME_NOT_FOUND;
+    }
+
+    Vector<sp<ABuffer> > clip;
+    CodecBenchmarkResult encoderResult;
+    status_t err = doBenchmarkCodec(
+            true /* isEncoder */, list->getCodecInfo(index)->getCodecName(), mime,
+            width, height, bitrate, NULL /* surface */, NULL /* clip */, numFrames,
+            &clip, &encoderResult);
+    if (err != OK) {
+        return err;
+    }
+    return doBenchmarkCodec(false /* isEncoder */, name, mime, width, height, bitrate,
+            surface, &clip, numFrames, NULL /* encoded */, result);
+}
+
+void measureFrameRates(
+        const Vector<sp<MediaCodecInfo>> &infos,
+        size_t numRuns,
+        KeyedVector<AString, CodecSettings> *encoder_results,
+        KeyedVector<AString, CodecSettings> *decoder_results) {
+    for (size_t i = 0; i < infos.size(); ++i) {
+        const sp<MediaCodecInfo> info = infos[i];
+        AString name = info->getCodecName();
+        if (name.startsWith("OMX.google.") || name.endsWith(".secure")) {
+            continue;
+        }
+
+        Vector<AString> mimes;
+        info->getSupportedMimes(&mimes);
+        for (size_t j = 0; j < mimes.size(); ++j) {
+            const sp<MediaCodecInfo::Capabilities> &caps =
+                    info->getCapabilitiesFor(mimes[j].c_str());
+            int32_t minWidth, minHeight, maxWidth, maxHeight;
+            if (!mimes[j].startsWith("video/")
+                    || !getSizeRange(caps, &minWidth, &minHeight, &maxWidth, &maxHeight)) {
+                continue;
+            }
+
+            AString key = name;
+            key.append(" ");
+            key.append(mimes[j]);
+            KeyedVector<AString, CodecSettings> *results =
+                    info->isEncoder() ? encoder_results : decoder_results;
+
+            for (size_t k = 0; k < sizeof(kMeasuredSizes) / sizeof(kMeasuredSizes[0]); ++k) {
+                int32_t width = kMeasuredSizes[k][0];
+                int32_t height = kMeasuredSizes[k][1];
+                if (width < minWidth || width > maxWidth
+                        || height < minHeight || height > maxHeight) {
+                    continue;
+                }
+
+                // about 0.1 bits per pixel
+                int32_t bitrate = width * height * 3;
+                double minFps = 0;
+                double maxFps = 0;
+                size_t run = 0;
+                for (; run < numRuns; ++run) {
+                    CodecBenchmarkResult result;
+                    if (benchmarkCodec(info->isEncoder(), name, mimes[j], width, height,
+                            bitrate, NULL /* surface */, 300 /* numFrames */, &result) != OK) {
+                        break;
+                    }
+                    if (run == 0 || result.mFrameRate < minFps) {
+                        minFps = result.mFrameRate;
+                    }
+                    if (run == 0 || result.mFrameRate > maxFps) {
+                        maxFps = result.mFrameRate;
+                    }
+                }
+                if (run == 0 || run < numRuns) {
+                    continue;
+                }
+
+                ssize_t index = results->indexOfKey(key);
+                if (index < 0) {
+                    index = results->add(key, CodecSettings());
+                }
+                results->editValueAt(index).add(
+                        AStringPrintf("measured-frame-rate-%dx%d", width, height),
+                        AStringPrintf("%d-%d", (int)minFps, (int)(maxFps + 0.5)));
+            }
+        }
+    }
+}
+
 void profileCodecs(const Vector<sp<MediaCodecInfo>> &infos) {
     CodecSettings global_results;
     KeyedVector<AString, CodecSettings> encoder_results;
@@ -364,11 +736,12 @@ static AString codecResultsToXml(const KeyedVector<AString, CodecSettings>& resu
         ret.append(codec);
         CodecSettings settings = results.valueAt(i);
         for (size_t i = 0; i < settings.size(); ++i) {
-            // WARNING: we assume all the settings are "Limit". Currently we have only one type
-            // of setting in this case, which is "max-supported-instances".
+            // WARNING: we assume all the settings are "Limit". Currently these are
+            // "max-supported-instances" and the "measured-frame-rate-WxH" ranges.
             AString setting = AStringPrintf(
-                    "            <Limit name=\"%s\" value=\"%s\" />\n",
+                    "            <Limit name=\"%s\" %s=\"%s\" />\n",
                     settings.keyAt(i).c_str(),
+                    settings.keyAt(i).startsWith("measured-") ? "range" : "value",
                     settings.valueAt(i).c_str());
             ret.append(setting);
         }
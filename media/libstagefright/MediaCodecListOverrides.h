@@ -30,6 +30,15 @@ extern const char *kProfilingVersionString;
 extern const char *kProfilingResults;
 
 struct MediaCodecInfo;
+class Surface;
+
+struct CodecBenchmarkResult {
+    size_t mNumFrames;
+    double mFrameRate;          // sustained, over the whole run
+    int64_t mMedianLatencyUs;   // from queueing a frame to dequeueing it
+    int64_t mP90LatencyUs;
+    int64_t mMaxLatencyUs;
+};
 
 AString getProfilingVersionString();
 
@@ -46,6 +55,29 @@ void profileCodecs(
         KeyedVector<AString, CodecSettings> *decoder_results,
         bool forceToMeasure = false);
 
+// Runs |numFrames| frames of |width|x|height| video through the codec |name| and measures
+// its throughput. Encoders are fed synthetic YUV frames from buffers. Decoders decode a
+// clip that is first encoded from the same frames by an encoder for |mime|, and render
+// to |surface| unless it is NULL.
+status_t benchmarkCodec(
+        bool isEncoder,
+        const AString &name,
+        const AString &mime,
+        int32_t width,
+        int32_t height,
+        int32_t bitrate,
+        const sp<Surface> &surface,
+        size_t numFrames,
+        CodecBenchmarkResult *result);
+
+// benchmark the video codecs at the standard sizes they support, and add the range of
+// frame rates over |numRuns| runs as measured-frame-rate-WxH limits to the results.
+void measureFrameRates(
+        const Vector<sp<MediaCodecInfo>> &infos,
+        size_t numRuns,
+        KeyedVector<AString, CodecSettings> *encoder_results,
+        KeyedVector<AString, CodecSettings> *decoder_results);
+
 void exportResultsToXML(
         const char *fileName,
         const CodecSettings& global_results,
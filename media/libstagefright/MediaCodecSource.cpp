@@ -52,6 +52,10 @@ struct MediaCodecSource::Puller : public AHandler {
     void pause();
     void resume();
 
+    // Moves the buffers pulled so far into |buffers|, may be called from
+    // any thread. A notify is posted whenever new buffers become available.
+    void readBuffers(List<MediaBuffer *> *buffers);
+
 protected:
     virtual void onMessageReceived(const sp<AMessage> &msg);
     virtual ~Puller();
@@ -65,6 +69,12 @@ private:
         kWhatResume,
     };
 
+    enum {
+        // at most this many pulled buffers wait for the encoder's looper
+        kMaxQueuedBuffers = 16,
+        kPullRetryDelayUs = 10000,
+    };
+
     sp<MediaSource> mSource;
     sp<AMessage> mNotify;
     sp<ALooper> mLooper;
@@ -72,10 +82,19 @@ private:
     bool mIsAudio;
     bool mPaused;
     bool mReachedEOS;
+    bool mSupportsNonBlockingRead;
+
+    Mutex mQueueLock;
+    // following variables are protected by mQueueLock
+    List<MediaBuffer *> mQueuedBuffers;
+    bool mNotifyPending;
 
     status_t postSynchronouslyAndReturnError(const sp<AMessage> &msg);
     void schedulePull();
     void handleEOS();
+    size_t numQueuedBuffers();
+    void queueBuffers(const List<MediaBuffer *> &buffers);
+    void flushQueuedBuffers();
 
     DISALLOW_EVIL_CONSTRUCTORS(Puller);
 };
@@ -86,19 +105,28 @@ MediaCodecSource::Puller::Puller(const sp<MediaSource> &source)
       mPullGeneration(0),
       mIsAudio(false),
       mPaused(false),
-      mReachedEOS(false) {
+      mReachedEOS(false),
+      mSupportsNonBlockingRead(false),
+      mNotifyPending(false) {
     sp<MetaData> meta = source->getFormat();
     const char *mime;
     CHECK(meta->findCString(kKeyMIMEType, &mime));
 
     mIsAudio = !strncasecmp(mime, "audio/", 6);
 
+    int32_t supportsNonBlockingRead;
+    mSupportsNonBlockingRead =
+        meta->findInt32(kKeySupportsNonBlockingRead, &supportsNonBlockingRead)
+            && supportsNonBlockingRead;
+
     mLooper->setName("pull_looper");
 }
 
 MediaCodecSource::Puller::~Puller() {
     mLooper->unregisterHandler(id());
     mLooper->stop();
+
+    flushQueuedBuffers();
 }
 
 status_t MediaCodecSource::Puller::postSynchronouslyAndReturnError(
@@ -139,6 +167,10 @@ void MediaCodecSource::Puller::stop() {
     // If source gets stuck in read(), the looper would never
     // be able to process the stop(), which could lead to ANR.
 
+    // Sources may wait for their buffers to come back, so don't leave that
+    // to the encoder's looper.
+    flushQueuedBuffers();
+
     ALOGV("source (%s) stopping", mIsAudio ? "audio" : "video");
     mSource->stop();
     ALOGV("source (%s) stopped", mIsAudio ? "audio" : "video");
@@ -165,11 +197,49 @@ void MediaCodecSource::Puller::handleEOS() {
         ALOGV("puller (%s) posting EOS", mIsAudio ? "audio" : "video");
         mReachedEOS = true;
         sp<AMessage> notify = mNotify->dup();
-        notify->setPointer("accessUnit", NULL);
+        notify->setInt32("eos", true);
         notify->post();
     }
 }
 
+size_t MediaCodecSource::Puller::numQueuedBuffers() {
+    Mutex::Autolock autoLock(mQueueLock);
+    return mQueuedBuffers.size();
+}
+
+void MediaCodecSource::Puller::queueBuffers(const List<MediaBuffer *> &buffers) {
+    Mutex::Autolock autoLock(mQueueLock);
+    for (List<MediaBuffer *>::const_iterator it = buffers.begin();
+            it != buffers.end(); ++it) {
+        mQueuedBuffers.push_back(*it);
+    }
+
+    // one notify covers everything queued until the buffers are read
+    if (!mNotifyPending) {
+        mNotifyPending = true;
+        mNotify->dup()->post();
+    }
+}
+
+void MediaCodecSource::Puller::readBuffers(List<MediaBuffer *> *buffers) {
+    Mutex::Autolock autoLock(mQueueLock);
+    for (List<MediaBuffer *>::iterator it = mQueuedBuffers.begin();
+            it != mQueuedBuffers.end(); ++it) {
+        buffers->push_back(*it);
+    }
+    mQueuedBuffers.clear();
+    mNotifyPending = false;
+}
+
+void MediaCodecSource::Puller::flushQueuedBuffers() {
+    List<MediaBuffer *> buffers;
+    readBuffers(&buffers);
+    for (List<MediaBuffer *>::iterator it = buffers.begin();
+            it != buffers.end(); ++it) {
+        (*it)->release();
+    }
+}
+
 void MediaCodecSource::Puller::onMessageReceived(const sp<AMessage> &msg) {
     switch (msg->what()) {
         case kWhatStart:
@@ -211,6 +281,12 @@ void MediaCodecSource::Puller::onMessageReceived(const sp<AMessage> &msg) {
                 break;
             }
 
+            if (numQueuedBuffers() >= kMaxQueuedBuffers) {
+                // the encoder is behind, let the source buffer for a while
+                msg->post(kPullRetryDelayUs);
+                break;
+            }
+
             MediaBuffer *mbuf;
             status_t err = mSource->read(&mbuf);
 
@@ -224,18 +300,32 @@ void MediaCodecSource::Puller::onMessageReceived(const sp<AMessage> &msg) {
                 break;
             }
 
-            if (err != OK) {
-                if (err == ERROR_END_OF_STREAM) {
+            if (err != OK || mbuf == NULL) {
+                if (err == OK || err == ERROR_END_OF_STREAM) {
                     ALOGV("stream ended, mbuf %p", mbuf);
                 } else {
                     ALOGE("error %d reading stream.", err);
                 }
                 handleEOS();
             } else {
-                sp<AMessage> notify = mNotify->dup();
+                List<MediaBuffer *> buffers;
+                buffers.push_back(mbuf);
+
+                // Take whatever else the source already has, so that a
+                // burst of buffers costs a single notify.
+                if (mSupportsNonBlockingRead) {
+                    MediaSource::ReadOptions options;
+                    options.setNonBlocking();
+
+                    size_t maxBuffers = kMaxQueuedBuffers - numQueuedBuffers();
+                    while (buffers.size() < maxBuffers
+                            && mSource->read(&mbuf, &options) == OK
+                            && mbuf != NULL) {
+                        buffers.push_back(mbuf);
+                    }
+                }
 
-                notify->setPointer("accessUnit", mbuf);
-                notify->post();
+                queueBuffers(buffers);
 
                 msg->post();
             }
@@ -327,8 +417,26 @@ status_t MediaCodecSource::read(
 }
 
 void MediaCodecSource::signalBufferReturned(MediaBuffer *buffer) {
+    ssize_t wrapped;
+    size_t index = 0;
+    {
+        Mutex::Autolock autoLock(mOutputBufferLock);
+        wrapped = mWrappedOutputIndices.indexOfKey(buffer);
+        if (wrapped >= 0) {
+            index = mWrappedOutputIndices.valueAt(wrapped);
+            mWrappedOutputIndices.removeItemsAt(wrapped);
+        }
+    }
+
     buffer->setObserver(0);
     buffer->release();
+
+    if (wrapped >= 0) {
+        // the codec buffer can only be released on our looper
+        sp<AMessage> msg = new AMessage(kWhatReleaseOutputBuffer, mReflector);
+        msg->setSize("index", index);
+        msg->post();
+    }
 }
 
 MediaCodecSource::MediaCodecSource(
@@ -349,6 +457,7 @@ MediaCodecSource::MediaCodecSource(
       mEncoderFormat(0),
       mEncoderDataSpace(0),
       mGraphicBufferConsumer(consumer),
+      mNumEncoderOutputBuffers(0),
       mFirstSampleTimeUs(-1ll),
       mEncoderReachedEOS(false),
       mErrorCode(OK) {
@@ -369,6 +478,11 @@ MediaCodecSource::MediaCodecSource(
 MediaCodecSource::~MediaCodecSource() {
     releaseEncoder();
 
+    if (mReleasingEncoder != NULL) {
+        mReleasingEncoder->release();
+        mReleasingEncoder.clear();
+    }
+
     mCodecLooper->stop();
     mLooper->unregisterHandler(mReflector->id());
 }
@@ -427,6 +541,11 @@ status_t MediaCodecSource::initEncoder() {
     mEncoder->getOutputFormat(&mOutputFormat);
     convertMessageToMetaData(mOutputFormat, mMeta);
 
+    // output buffers either own a copy of the data, or wrap at most half of the
+    // codec's buffers so that the encoder never runs dry while a reader holds
+    // on to them, see onMessageReceived()
+    mMeta->setInt32(kKeyCanRetainOutputBuffers, true);
+
     if (mFlags & FLAG_USE_SURFACE_INPUT) {
         CHECK(mIsVideo);
 
@@ -474,7 +593,21 @@ void MediaCodecSource::releaseEncoder() {
         return;
     }
 
-    mEncoder->release();
+    size_t numOutputBuffersHeld;
+    {
+        Mutex::Autolock autoLock(mOutputBufferLock);
+        numOutputBuffersHeld = mWrappedOutputIndices.size();
+    }
+
+    if (numOutputBuffersHeld > 0) {
+        // Readers still point into the codec's output buffers, release the
+        // codec once the last of them comes back.
+        ALOGV("encoder (%s) release deferred, %zu output buffers held",
+                mIsVideo ? "video" : "audio", numOutputBuffersHeld);
+        mReleasingEncoder = mEncoder;
+    } else {
+        mEncoder->release();
+    }
     mEncoder.clear();
 
     while (!mInputBufferQueue.empty()) {
@@ -505,19 +638,23 @@ status_t MediaCodecSource::postSynchronouslyAndReturnError(
 void MediaCodecSource::signalEOS(status_t err) {
     if (!mEncoderReachedEOS) {
         ALOGV("encoder (%s) reached EOS", mIsVideo ? "video" : "audio");
+        List<MediaBuffer*> unreadBuffers;
         {
             Mutex::Autolock autoLock(mOutputBufferLock);
-            // release all unread media buffers
-            for (List<MediaBuffer*>::iterator it = mOutputBufferQueue.begin();
-                    it != mOutputBufferQueue.end(); it++) {
-                (*it)->release();
-            }
+            unreadBuffers = mOutputBufferQueue;
             mOutputBufferQueue.clear();
             mEncoderReachedEOS = true;
             mErrorCode = err;
             mOutputBufferCond.signal();
         }
 
+        // release all unread media buffers, outside of mOutputBufferLock as
+        // signalBufferReturned() takes it
+        for (List<MediaBuffer*>::iterator it = unreadBuffers.begin();
+                it != unreadBuffers.end(); it++) {
+            (*it)->release();
+        }
+
         releaseEncoder();
     }
     if (mStopping && mEncoderReachedEOS) {
@@ -677,30 +814,32 @@ void MediaCodecSource::onMessageReceived(const sp<AMessage> &msg) {
     switch (msg->what()) {
     case kWhatPullerNotify:
     {
-        MediaBuffer *mbuf;
-        CHECK(msg->findPointer("accessUnit", (void**)&mbuf));
-
-        if (mbuf == NULL) {
-            ALOGV("puller (%s) reached EOS",
-                    mIsVideo ? "video" : "audio");
-            signalEOS();
-        }
+        List<MediaBuffer *> buffers;
+        mPuller->readBuffers(&buffers);
 
         if (mEncoder == NULL) {
             ALOGV("got msg '%s' after encoder shutdown.",
                   msg->debugString().c_str());
 
-            if (mbuf != NULL) {
-                mbuf->release();
+            for (List<MediaBuffer *>::iterator it = buffers.begin();
+                    it != buffers.end(); ++it) {
+                (*it)->release();
+            }
+        } else if (!buffers.empty()) {
+            for (List<MediaBuffer *>::iterator it = buffers.begin();
+                    it != buffers.end(); ++it) {
+                mInputBufferQueue.push_back(*it);
             }
 
-            break;
+            feedEncoderInputBuffers();
         }
 
-        mInputBufferQueue.push_back(mbuf);
-
-        feedEncoderInputBuffers();
-
+        int32_t eos;
+        if (msg->findInt32("eos", &eos) && eos) {
+            ALOGV("puller (%s) reached EOS",
+                    mIsVideo ? "video" : "audio");
+            signalEOS();
+        }
         break;
     }
     case kWhatEncoderActivity:
@@ -743,8 +882,27 @@ void MediaCodecSource::onMessageReceived(const sp<AMessage> &msg) {
                 break;
             }
 
-            MediaBuffer *mbuf = new MediaBuffer(outbuf->size());
-            memcpy(mbuf->data(), outbuf->data(), outbuf->size());
+            if ((size_t)index >= mNumEncoderOutputBuffers) {
+                mNumEncoderOutputBuffers = index + 1;
+            }
+
+            // Hand the codec's buffer out directly as long as the encoder
+            // keeps at least half of the buffers seen so far; it is released
+            // back to the codec in signalBufferReturned(). Otherwise copy, as
+            // readers such as MPEG4Writer may hold buffers for a while.
+            bool wrap;
+            {
+                Mutex::Autolock autoLock(mOutputBufferLock);
+                wrap = mWrappedOutputIndices.size() < mNumEncoderOutputBuffers / 2;
+            }
+
+            MediaBuffer *mbuf;
+            if (wrap) {
+                mbuf = new MediaBuffer(outbuf->data(), outbuf->size());
+            } else {
+                mbuf = new MediaBuffer(outbuf->size());
+                memcpy(mbuf->data(), outbuf->data(), outbuf->size());
+            }
 
             if (!(flags & MediaCodec::BUFFER_FLAG_CODECCONFIG)) {
                 if (mIsVideo) {
@@ -791,11 +949,16 @@ void MediaCodecSource::onMessageReceived(const sp<AMessage> &msg) {
 
             {
                 Mutex::Autolock autoLock(mOutputBufferLock);
+                if (wrap) {
+                    mWrappedOutputIndices.add(mbuf, index);
+                }
                 mOutputBufferQueue.push_back(mbuf);
                 mOutputBufferCond.signal();
             }
 
-            mEncoder->releaseOutputBuffer(index);
+            if (!wrap) {
+                mEncoder->releaseOutputBuffer(index);
+            }
        } else if (cbID == MediaCodec::CB_ERROR) {
             status_t err;
             CHECK(msg->findInt32("err", &err));
@@ -805,6 +968,30 @@ void MediaCodecSource::onMessageReceived(const sp<AMessage> &msg) {
        }
        break;
     }
+    case kWhatReleaseOutputBuffer:
+    {
+        size_t index;
+        CHECK(msg->findSize("index", &index));
+
+        if (mEncoder != NULL) {
+            mEncoder->releaseOutputBuffer(index);
+        } else if (mReleasingEncoder != NULL) {
+            mReleasingEncoder->releaseOutputBuffer(index);
+
+            bool outputBuffersHeld;
+            {
+                Mutex::Autolock autoLock(mOutputBufferLock);
+                outputBuffersHeld = !mWrappedOutputIndices.isEmpty();
+            }
+            if (!outputBuffersHeld) {
+                ALOGV("encoder (%s) releasing after last output buffer",
+                        mIsVideo ? "video" : "audio");
+                mReleasingEncoder->release();
+                mReleasingEncoder.clear();
+            }
+        }
+        break;
+    }
     case kWhatStart:
     {
         sp<AReplyToken> replyID;
@@ -118,6 +118,25 @@ status_t MediaMuxer::setLocation(int latitude, int longitude) {
     return static_cast<MPEG4Writer*>(mWriter.get())->setGeoData(latitude, longitude);
 }
 
+status_t MediaMuxer::setFragmentDuration(int64_t durationUs) {
+    Mutex::Autolock autoLock(mMuxerLock);
+    if (mState != INITIALIZED) {
+        ALOGE("setFragmentDuration() must be called before start().");
+        return INVALID_OPERATION;
+    }
+    if (mFormat != OUTPUT_FORMAT_MPEG_4) {
+        ALOGE("setFragmentDuration() is only supported for .mp4 output.");
+        return INVALID_OPERATION;
+    }
+    if (durationUs < 0) {
+        ALOGE("setFragmentDuration() get invalid duration");
+        return -EINVAL;
+    }
+
+    mFileMeta->setInt64(kKeyFragmentDurationUs, durationUs);
+    return OK;
+}
+
 status_t MediaMuxer::start() {
     Mutex::Autolock autoLock(mMuxerLock);
     if (mState == INITIALIZED) {
@@ -149,21 +168,28 @@ status_t MediaMuxer::stop() {
 
 status_t MediaMuxer::writeSampleData(const sp<ABuffer> &buffer, size_t trackIndex,
                                      int64_t timeUs, uint32_t flags) {
-    Mutex::Autolock autoLock(mMuxerLock);
-
     if (buffer.get() == NULL) {
         ALOGE("WriteSampleData() get an NULL buffer.");
         return -EINVAL;
     }
 
-    if (mState != STARTED) {
-        ALOGE("WriteSampleData() is called in invalid state %d", mState);
-        return INVALID_OPERATION;
-    }
+    // The muxer lock is not held while the sample is pushed, so that samples
+    // written to other tracks from other threads are not held up by this
+    // track's writer thread.
+    sp<MediaAdapter> currentTrack;
+    {
+        Mutex::Autolock autoLock(mMuxerLock);
 
-    if (trackIndex >= mTrackList.size()) {
-        ALOGE("WriteSampleData() get an invalid index %zu", trackIndex);
-        return -EINVAL;
+        if (mState != STARTED) {
+            ALOGE("WriteSampleData() is called in invalid state %d", mState);
+            return INVALID_OPERATION;
+        }
+
+        if (trackIndex >= mTrackList.size()) {
+            ALOGE("WriteSampleData() get an invalid index %zu", trackIndex);
+            return -EINVAL;
+        }
+        currentTrack = mTrackList[trackIndex];
     }
 
     MediaBuffer* mediaBuffer = new MediaBuffer(buffer);
@@ -180,7 +206,6 @@ status_t MediaMuxer::writeSampleData(const sp<ABuffer> &buffer, size_t trackInde
         sampleMetaData->setInt32(kKeyIsSyncFrame, true);
     }
 
-    sp<MediaAdapter> currentTrack = mTrackList[trackIndex];
     // This pushBuffer will wait until the mediaBuffer is consumed.
     return currentTrack->pushBuffer(mediaBuffer);
 }
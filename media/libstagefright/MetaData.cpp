@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <cutils/atomic.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AString.h>
 #include <media/stagefright/foundation/hexdump.h>
@@ -29,12 +30,21 @@
 
 namespace android {
 
-MetaData::MetaData() {
+static volatile int32_t gLastGeneration = 0;
+
+MetaData::MetaData()
+    : mNumInlineItems(0),
+      mGeneration(0) {
 }
 
 MetaData::MetaData(const MetaData &from)
     : RefBase(),
-      mItems(from.mItems) {
+      mNumInlineItems(from.mNumInlineItems),
+      mItems(from.mItems),
+      mGeneration(0) {
+    for (size_t i = 0; i < mNumInlineItems; ++i) {
+        mInlineItems[i] = from.mInlineItems[i];
+    }
 }
 
 MetaData::~MetaData() {
@@ -42,16 +52,39 @@ MetaData::~MetaData() {
 }
 
 void MetaData::clear() {
-    mItems.clear();
+    mGeneration = 0;
+
+    for (size_t i = 0; i < mNumInlineItems; ++i) {
+        mInlineItems[i].mData.clear();
+    }
+    mNumInlineItems = 0;
+
+    if (!mItems.isEmpty()) {
+        mItems.clear();
+    }
 }
 
 bool MetaData::remove(uint32_t key) {
-    ssize_t i = mItems.indexOfKey(key);
+    ssize_t i = indexOfInlineKey(key);
+
+    if (i >= 0) {
+        mGeneration = 0;
+        size_t last = mNumInlineItems - 1;
+        if ((size_t)i != last) {
+            mInlineItems[i] = mInlineItems[last];
+        }
+        mInlineItems[last].mData.clear();
+        mNumInlineItems = last;
+        return true;
+    }
+
+    i = mItems.indexOfKey(key);
 
     if (i < 0) {
         return false;
     }
 
+    mGeneration = 0;
     mItems.removeItemsAt(i);
 
     return true;
@@ -188,48 +221,85 @@ bool MetaData::findRect(
     return true;
 }
 
+ssize_t MetaData::indexOfInlineKey(uint32_t key) const {
+    for (size_t i = 0; i < mNumInlineItems; ++i) {
+        if (mInlineItems[i].mKey == key) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const MetaData::typed_data *MetaData::findItem(uint32_t key) const {
+    ssize_t i = indexOfInlineKey(key);
+    if (i >= 0) {
+        return &mInlineItems[i].mData;
+    }
+
+    if (mItems.isEmpty()) {
+        return NULL;
+    }
+
+    i = mItems.indexOfKey(key);
+    if (i < 0) {
+        return NULL;
+    }
+    return &mItems.valueAt(i);
+}
+
 bool MetaData::setData(
         uint32_t key, uint32_t type, const void *data, size_t size) {
-    bool overwrote_existing = true;
+    mGeneration = 0;
 
-    ssize_t i = mItems.indexOfKey(key);
-    if (i < 0) {
-        typed_data item;
-        i = mItems.add(key, item);
+    ssize_t i = indexOfInlineKey(key);
+    if (i >= 0) {
+        mInlineItems[i].mData.setData(type, data, size);
+        return true;
+    }
 
-        overwrote_existing = false;
+    i = mItems.isEmpty() ? -1 : mItems.indexOfKey(key);
+    if (i >= 0) {
+        mItems.editValueAt(i).setData(type, data, size);
+        return true;
     }
 
-    typed_data &item = mItems.editValueAt(i);
+    if (mNumInlineItems < kMaxInlineItems) {
+        InlineItem &item = mInlineItems[mNumInlineItems++];
+        item.mKey = key;
+        item.mData.setData(type, data, size);
+        return false;
+    }
 
-    item.setData(type, data, size);
+    typed_data item;
+    i = mItems.add(key, item);
+    mItems.editValueAt(i).setData(type, data, size);
 
-    return overwrote_existing;
+    return false;
 }
 
 bool MetaData::findData(uint32_t key, uint32_t *type,
                         const void **data, size_t *size) const {
-    ssize_t i = mItems.indexOfKey(key);
+    const typed_data *item = findItem(key);
 
-    if (i < 0) {
+    if (item == NULL) {
         return false;
     }
 
-    const typed_data &item = mItems.valueAt(i);
-
-    item.getData(type, data, size);
+    item->getData(type, data, size);
 
     return true;
 }
 
 bool MetaData::hasData(uint32_t key) const {
-    ssize_t i = mItems.indexOfKey(key);
+    return findItem(key) != NULL;
+}
 
-    if (i < 0) {
-        return false;
+uint32_t MetaData::generation() const {
+    while (mGeneration == 0) {
+        // skip 0 on wrap-around
+        mGeneration = (uint32_t)android_atomic_inc(&gLastGeneration) + 1;
     }
-
-    return true;
+    return mGeneration;
 }
 
 MetaData::typed_data::typed_data()
@@ -273,11 +343,17 @@ void MetaData::typed_data::clear() {
 
 void MetaData::typed_data::setData(
         uint32_t type, const void *data, size_t size) {
-    clear();
+    void *dst;
+    if (size == mSize) {
+        // same size, e.g. a per-sample timestamp being updated: reuse the storage
+        dst = storage();
+    } else {
+        freeStorage();
+        dst = allocateStorage(size);
+    }
 
     mType = type;
 
-    void *dst = allocateStorage(size);
     if (dst) {
         memcpy(dst, data, size);
     }
@@ -294,7 +370,7 @@ void *MetaData::typed_data::allocateStorage(size_t size) {
     mSize = size;
 
     if (usesReservoir()) {
-        return &u.reservoir;
+        return u.reservoir;
     }
 
     u.ext_data = malloc(mSize);
@@ -368,6 +444,11 @@ static void MakeFourCCString(uint32_t x, char *s) {
 }
 
 void MetaData::dumpToLog() const {
+    for (size_t i = 0; i < mNumInlineItems; ++i) {
+        char cc[5];
+        MakeFourCCString(mInlineItems[i].mKey, cc);
+        ALOGI("%s: %s", cc, mInlineItems[i].mData.asString().string());
+    }
     for (int i = mItems.size(); --i >= 0;) {
         int32_t key = mItems.keyAt(i);
         char cc[5];
@@ -20,6 +20,7 @@
 
 #include "include/MidiExtractor.h"
 
+#include <cutils/properties.h>
 #include <media/MidiIoWrapper.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/MediaBufferGroup.h>
@@ -28,10 +29,14 @@
 #include <media/stagefright/MediaSource.h>
 #include <libsonivox/eas_reverb.h>
 
+#include <stdlib.h>
+
 namespace android {
 
-// how many Sonivox output buffers to aggregate into one MediaBuffer
+// how many Sonivox output buffers to aggregate into one MediaBuffer by default,
+// and the most that can be requested through media.stagefright.midi.combine
 static const int NUM_COMBINE_BUFFERS = 4;
+static const int MAX_COMBINE_BUFFERS = 32;
 
 class MidiSource : public MediaSource {
 
@@ -148,7 +153,20 @@ MidiEngine::MidiEngine(const sp<DataSource> &dataSource,
             mEasData(NULL),
             mEasHandle(NULL),
             mEasConfig(NULL),
+            mNumCombineBuffers(NUM_COMBINE_BUFFERS),
             mIsInitialized(false) {
+    // Rendering more Sonivox buffers per MediaBuffer means fewer reads and
+    // wakeups during playback, at the cost of a larger output buffer.
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.stagefright.midi.combine", value, NULL) > 0) {
+        int numCombineBuffers = atoi(value);
+        if (numCombineBuffers >= 1 && numCombineBuffers <= MAX_COMBINE_BUFFERS) {
+            mNumCombineBuffers = numCombineBuffers;
+        } else {
+            ALOGW("ignoring media.stagefright.midi.combine=%s", value);
+        }
+    }
+
     mIoWrapper = new MidiIoWrapper(dataSource);
     // spin up a new EAS engine
     EAS_I32 temp;
@@ -204,7 +222,7 @@ status_t MidiEngine::allocateBuffers() {
 
     mGroup = new MediaBufferGroup;
     int bufsize = sizeof(EAS_PCM)
-            * mEasConfig->mixBufferSize * mEasConfig->numChannels * NUM_COMBINE_BUFFERS;
+            * mEasConfig->mixBufferSize * mEasConfig->numChannels * mNumCombineBuffers;
     ALOGV("using %d byte buffer", bufsize);
     mGroup->add_buffer(new MediaBuffer(bufsize));
     return OK;
@@ -241,7 +259,7 @@ MediaBuffer* MidiEngine::readBuffer() {
 
     EAS_PCM* p = (EAS_PCM*) buffer->data();
     int numBytesOutput = 0;
-    for (int i = 0; i < NUM_COMBINE_BUFFERS; i++) {
+    for (int i = 0; i < mNumCombineBuffers; i++) {
         EAS_I32 numRendered;
         EAS_RESULT result = EAS_Render(mEasData, p, mEasConfig->mixBufferSize, &numRendered);
         if (result != EAS_SUCCESS) {
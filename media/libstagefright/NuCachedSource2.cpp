@@ -24,9 +24,18 @@
 #include "include/HTTPBase.h"
 
 #include <cutils/properties.h>
+#include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/MediaErrors.h>
+#include <utils/Vector.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace android {
 
@@ -37,6 +46,10 @@ struct PageCache {
     struct Page {
         void *mData;
         size_t mSize;
+
+        // Owns mData. Views handed out by getViews() hold a reference too,
+        // a page still referenced that way is not recycled.
+        sp<ABuffer> mBuffer;
     };
 
     Page *acquirePage();
@@ -51,25 +64,48 @@ struct PageCache {
 
     void copy(size_t from, void *data, size_t size);
 
+    // Appends read-only views of [from, from + size) backed by the pages.
+    void getViews(size_t from, size_t size, Vector<sp<ABuffer> > *views);
+
 private:
+    struct ActivePage {
+        Page *mPage;
+        // offset of the page's first byte in the stream of appended pages
+        uint64_t mOffset;
+    };
+
     size_t mPageSize;
     size_t mTotalSize;
 
-    List<Page *> mActivePages;
+    // Pages in [mFirstActivePage, mActivePages.size()) are in the cache.
+    // Released entries at the front are removed in batches.
+    Vector<ActivePage> mActivePages;
+    size_t mFirstActivePage;
+    uint64_t mEndOffset;
+
     List<Page *> mFreePages;
 
     void freePages(List<Page *> *list);
 
+    // Returns the index of the active page containing the byte at |from|.
+    size_t findPage(size_t from, size_t *delta) const;
+
     DISALLOW_EVIL_CONSTRUCTORS(PageCache);
 };
 
 PageCache::PageCache(size_t pageSize)
     : mPageSize(pageSize),
-      mTotalSize(0) {
+      mTotalSize(0),
+      mFirstActivePage(0),
+      mEndOffset(0) {
 }
 
 PageCache::~PageCache() {
-    freePages(&mActivePages);
+    List<Page *> activePages;
+    for (size_t i = mFirstActivePage; i < mActivePages.size(); ++i) {
+        activePages.push_back(mActivePages[i].mPage);
+    }
+    freePages(&activePages);
     freePages(&mFreePages);
 }
 
@@ -78,7 +114,6 @@ void PageCache::freePages(List<Page *> *list) {
     while (it != list->end()) {
         Page *page = *it;
 
-        free(page->mData);
         delete page;
         page = NULL;
 
@@ -96,35 +131,45 @@ PageCache::Page *PageCache::acquirePage() {
     }
 
     Page *page = new Page;
-    page->mData = malloc(mPageSize);
+    page->mBuffer = new ABuffer(mPageSize);
+    page->mData = page->mBuffer->data();
     page->mSize = 0;
 
     return page;
 }
 
 void PageCache::releasePage(Page *page) {
+    if (page->mBuffer->getStrongCount() > 1) {
+        // Somebody is still looking at the data, leave it to them.
+        delete page;
+        return;
+    }
+
     page->mSize = 0;
     mFreePages.push_back(page);
 }
 
 void PageCache::appendPage(Page *page) {
+    ActivePage entry;
+    entry.mPage = page;
+    entry.mOffset = mEndOffset;
+    mActivePages.push(entry);
+
+    mEndOffset += page->mSize;
     mTotalSize += page->mSize;
-    mActivePages.push_back(page);
 }
 
 size_t PageCache::releaseFromStart(size_t maxBytes) {
     size_t bytesReleased = 0;
 
-    while (maxBytes > 0 && !mActivePages.empty()) {
-        List<Page *>::iterator it = mActivePages.begin();
-
-        Page *page = *it;
+    while (maxBytes > 0 && mFirstActivePage < mActivePages.size()) {
+        Page *page = mActivePages[mFirstActivePage].mPage;
 
         if (maxBytes < page->mSize) {
             break;
         }
 
-        mActivePages.erase(it);
+        ++mFirstActivePage;
 
         maxBytes -= page->mSize;
         bytesReleased += page->mSize;
@@ -132,10 +177,46 @@ size_t PageCache::releaseFromStart(size_t maxBytes) {
         releasePage(page);
     }
 
+    if (mFirstActivePage == mActivePages.size()) {
+        mActivePages.clear();
+        mFirstActivePage = 0;
+        mEndOffset = 0;
+    } else if (mFirstActivePage >= 64 && mFirstActivePage * 2 >= mActivePages.size()) {
+        mActivePages.removeItemsAt(0, mFirstActivePage);
+        mFirstActivePage = 0;
+    }
+
     mTotalSize -= bytesReleased;
     return bytesReleased;
 }
 
+size_t PageCache::findPage(size_t from, size_t *delta) const {
+    uint64_t offset = mActivePages[mFirstActivePage].mOffset + from;
+
+    // Pages are normally full, so start with a direct guess.
+    size_t lo = mFirstActivePage;
+    size_t hi = mActivePages.size();
+    size_t index = mFirstActivePage + from / mPageSize;
+    if (index < hi && mActivePages[index].mOffset <= offset
+            && offset < mActivePages[index].mOffset + mActivePages[index].mPage->mSize) {
+        *delta = offset - mActivePages[index].mOffset;
+        return index;
+    }
+
+    // Otherwise find the last page starting at or before offset.
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (mActivePages[mid].mOffset <= offset) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    *delta = offset - mActivePages[lo].mOffset;
+    return lo;
+}
+
 void PageCache::copy(size_t from, void *data, size_t size) {
     ALOGV("copy from %zu size %zu", from, size);
 
@@ -145,36 +226,317 @@ void PageCache::copy(size_t from, void *data, size_t size) {
 
     CHECK_LE(from + size, mTotalSize);
 
-    size_t offset = 0;
-    List<Page *>::iterator it = mActivePages.begin();
-    while (from >= offset + (*it)->mSize) {
-        offset += (*it)->mSize;
-        ++it;
-    }
+    size_t delta;
+    size_t index = findPage(from, &delta);
 
-    size_t delta = from - offset;
-    size_t avail = (*it)->mSize - delta;
+    while (size > 0) {
+        const Page *page = mActivePages[index++].mPage;
+        size_t copy = page->mSize - delta;
+        if (copy > size) {
+            copy = size;
+        }
+        memcpy(data, (const uint8_t *)page->mData + delta, copy);
+        data = (uint8_t *)data + copy;
+        size -= copy;
+        delta = 0;
+    }
+}
 
-    if (avail >= size) {
-        memcpy(data, (const uint8_t *)(*it)->mData + delta, size);
+void PageCache::getViews(size_t from, size_t size, Vector<sp<ABuffer> > *views) {
+    if (size == 0) {
         return;
     }
 
-    memcpy(data, (const uint8_t *)(*it)->mData + delta, avail);
-    ++it;
-    data = (uint8_t *)data + avail;
-    size -= avail;
+    CHECK_LE(from + size, mTotalSize);
+
+    size_t delta;
+    size_t index = findPage(from, &delta);
 
     while (size > 0) {
-        size_t copy = (*it)->mSize;
+        const Page *page = mActivePages[index++].mPage;
+        size_t length = page->mSize - delta;
+        if (length > size) {
+            length = size;
+        }
+
+        sp<ABuffer> view = new ABuffer((uint8_t *)page->mData + delta, length);
+        view->meta()->setObject("page", page->mBuffer);
+        views->push(view);
+
+        size -= length;
+        delta = 0;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Second cache tier: pages released from the PageCache are kept on disk in
+// blocks of one page each, named after the source and the block index, and
+// evicted least recently used first once the directory grows beyond
+// mMaxBytes. Blocks are queued in memory and written out by the looper so
+// that no disk writes happen while a reader may be waiting for mLock.
+struct DiskCache {
+    DiskCache(const char *dir, const String8 &uri, off64_t sourceSize,
+              size_t blockSize, off64_t maxBytes);
+
+    // Queues |data| holding the block at |blockIndex| for writing out later.
+    void queueBlock(off64_t blockIndex, const sp<ABuffer> &data);
+
+    // Writes up to |maxBlocks| queued blocks to disk.
+    void writeQueuedBlocks(size_t maxBlocks);
+
+    // Reads |size| bytes at |offset| if all the blocks covering them are
+    // cached, returns -ENOENT otherwise.
+    ssize_t read(off64_t offset, void *data, size_t size);
+
+private:
+    struct Block {
+        off64_t mIndex;
+        sp<ABuffer> mData;
+    };
+
+    Mutex mLock;
+    String8 mDir;
+    String8 mPrefix;
+    size_t mBlockSize;
+    off64_t mMaxBytes;
+    off64_t mTotalBytes;
+    List<Block> mQueuedBlocks;
+
+    String8 pathForBlock(off64_t blockIndex) const;
+    const Block *findQueuedBlock_l(off64_t blockIndex) const;
+    void writeBlock(const Block &block);
+    void trim();
+
+    DISALLOW_EVIL_CONSTRUCTORS(DiskCache);
+};
+
+static const char kDiskCacheFilePrefix[] = "nc2-";
+
+// FNV-1a, only used to give every source its own block names.
+static uint64_t hashString(const char *s) {
+    uint64_t hash = 14695981039346656037ull;
+    for (; *s != '\0'; ++s) {
+        hash ^= (uint8_t)*s;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+DiskCache::DiskCache(
+        const char *dir, const String8 &uri, off64_t sourceSize,
+        size_t blockSize, off64_t maxBytes)
+    : mDir(dir),
+      mBlockSize(blockSize),
+      mMaxBytes(maxBytes),
+      mTotalBytes(0) {
+    // Tie the blocks to the size of the resource as well, so that a changed
+    // resource at the same URI does not use stale data.
+    mPrefix = String8::format(
+            "%s%016" PRIx64 "-%" PRIx64 "-", kDiskCacheFilePrefix,
+            hashString(uri.string()), (uint64_t)sourceSize);
+
+    // picks up mTotalBytes from the blocks left by earlier sessions
+    trim();
+}
+
+String8 DiskCache::pathForBlock(off64_t blockIndex) const {
+    return String8::format(
+            "%s/%s%" PRIx64, mDir.string(), mPrefix.string(), (uint64_t)blockIndex);
+}
+
+void DiskCache::queueBlock(off64_t blockIndex, const sp<ABuffer> &data) {
+    CHECK_EQ(data->size(), mBlockSize);
+
+    Mutex::Autolock autoLock(mLock);
+    if (findQueuedBlock_l(blockIndex) != NULL) {
+        return;
+    }
+
+    Block block;
+    block.mIndex = blockIndex;
+    block.mData = data;
+    mQueuedBlocks.push_back(block);
+}
+
+void DiskCache::writeQueuedBlocks(size_t maxBlocks) {
+    while (maxBlocks-- > 0) {
+        Block block;
+        {
+            Mutex::Autolock autoLock(mLock);
+            if (mQueuedBlocks.empty()) {
+                break;
+            }
+            block = *mQueuedBlocks.begin();
+        }
+
+        // Keep the block queued until it is on disk so that reads in the
+        // meantime find it.
+        writeBlock(block);
+
+        Mutex::Autolock autoLock(mLock);
+        mQueuedBlocks.erase(mQueuedBlocks.begin());
+    }
+}
+
+void DiskCache::writeBlock(const Block &block) {
+    String8 path = pathForBlock(block.mIndex);
+    if (access(path.string(), F_OK) == 0) {
+        // already spilled by an earlier release of the same range
+        return;
+    }
+
+    String8 tmpPath = path;
+    tmpPath.append(".tmp");
+
+    int fd = open(tmpPath.string(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        ALOGW("failed to create disk cache block '%s' (%s)",
+                tmpPath.string(), strerror(errno));
+        return;
+    }
+
+    ssize_t n = write(fd, block.mData->data(), mBlockSize);
+    close(fd);
+
+    if (n != (ssize_t)mBlockSize || rename(tmpPath.string(), path.string()) < 0) {
+        ALOGW("failed to write disk cache block '%s'", path.string());
+        unlink(tmpPath.string());
+        return;
+    }
+
+    bool needsTrim;
+    {
+        Mutex::Autolock autoLock(mLock);
+        mTotalBytes += mBlockSize;
+        needsTrim = mTotalBytes > mMaxBytes;
+    }
+
+    if (needsTrim) {
+        trim();
+    }
+}
+
+const DiskCache::Block *DiskCache::findQueuedBlock_l(off64_t blockIndex) const {
+    for (List<Block>::const_iterator it = mQueuedBlocks.begin();
+            it != mQueuedBlocks.end(); ++it) {
+        if (it->mIndex == blockIndex) {
+            return &*it;
+        }
+    }
+    return NULL;
+}
+
+ssize_t DiskCache::read(off64_t offset, void *data, size_t size) {
+    if (size == 0) {
+        return 0;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+
+    // check that every block is there before copying anything
+    off64_t firstBlock = offset / mBlockSize;
+    off64_t lastBlock = (offset + size - 1) / mBlockSize;
+    Vector<int> fds;
+    bool complete = true;
+    for (off64_t index = firstBlock; index <= lastBlock; ++index) {
+        int fd = open(pathForBlock(index).string(), O_RDONLY);
+        fds.push(fd);
+        if (fd < 0 && findQueuedBlock_l(index) == NULL) {
+            complete = false;
+            break;
+        }
+    }
+
+    ssize_t result = complete ? (ssize_t)size : -ENOENT;
+    uint8_t *out = (uint8_t *)data;
+    for (size_t i = 0; i < fds.size(); ++i) {
+        int fd = fds[i];
+        if (result < 0) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            continue;
+        }
+
+        off64_t blockStart = (firstBlock + i) * mBlockSize;
+        size_t from = offset > blockStart ? offset - blockStart : 0;
+        size_t copy = mBlockSize - from;
         if (copy > size) {
             copy = size;
         }
-        memcpy(data, (*it)->mData, copy);
-        data = (uint8_t *)data + copy;
+
+        if (fd < 0) {
+            const Block *block = findQueuedBlock_l(firstBlock + i);
+            memcpy(out, block->mData->data() + from, copy);
+        } else {
+            if (pread(fd, out, copy, from) != (ssize_t)copy) {
+                result = -ENOENT;
+            }
+            // bump the block in the LRU order
+            futimens(fd, NULL);
+            close(fd);
+        }
+
+        out += copy;
         size -= copy;
-        ++it;
     }
+
+    return result;
+}
+
+void DiskCache::trim() {
+    struct Entry {
+        String8 mPath;
+        time_t mTime;
+        off64_t mSize;
+    };
+
+    DIR *dir = opendir(mDir.string());
+    if (dir == NULL) {
+        ALOGW("cannot open disk cache directory '%s'", mDir.string());
+        return;
+    }
+
+    Vector<Entry> entries;
+    off64_t totalBytes = 0;
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        if (strncmp(ent->d_name, kDiskCacheFilePrefix,
+                    sizeof(kDiskCacheFilePrefix) - 1)) {
+            continue;
+        }
+
+        Entry entry;
+        entry.mPath = String8::format("%s/%s", mDir.string(), ent->d_name);
+
+        struct stat st;
+        if (stat(entry.mPath.string(), &st) < 0 || !S_ISREG(st.st_mode)) {
+            continue;
+        }
+        entry.mTime = st.st_mtime;
+        entry.mSize = st.st_size;
+        totalBytes += st.st_size;
+        entries.push(entry);
+    }
+    closedir(dir);
+
+    // evict down to 90% so that we don't scan again on the next write
+    off64_t targetBytes = mMaxBytes / 10 * 9;
+    while (totalBytes > targetBytes && !entries.isEmpty()) {
+        size_t oldest = 0;
+        for (size_t i = 1; i < entries.size(); ++i) {
+            if (entries[i].mTime < entries[oldest].mTime) {
+                oldest = i;
+            }
+        }
+        unlink(entries[oldest].mPath.string());
+        totalBytes -= entries[oldest].mSize;
+        entries.removeAt(oldest);
+    }
+
+    Mutex::Autolock autoLock(mLock);
+    mTotalBytes = totalBytes;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -187,6 +549,7 @@ NuCachedSource2::NuCachedSource2(
       mReflector(new AHandlerReflector<NuCachedSource2>(this)),
       mLooper(new ALooper),
       mCache(new PageCache(kPageSize)),
+      mDiskCache(NULL),
       mCacheOffset(0),
       mFinalStatus(OK),
       mLastAccessPos(0),
@@ -209,6 +572,8 @@ NuCachedSource2::NuCachedSource2(
         updateCacheParamsFromString(cacheConfig);
     }
 
+    createDiskCacheFromSystemProperty();
+
     if (mDisconnectAtHighwatermark) {
         // Makes no sense to disconnect and do keep-alives...
         mKeepAliveIntervalUs = 0;
@@ -232,6 +597,9 @@ NuCachedSource2::~NuCachedSource2() {
 
     delete mCache;
     mCache = NULL;
+
+    delete mDiskCache;
+    mDiskCache = NULL;
 }
 
 // static
@@ -394,6 +762,10 @@ void NuCachedSource2::fetchInternal() {
 void NuCachedSource2::onFetch() {
     ALOGV("onFetch");
 
+    if (mDiskCache != NULL) {
+        mDiskCache->writeQueuedBlocks(kMaxDiskCacheBlocksPerFetch);
+    }
+
     if (mFinalStatus != OK && mNumRetriesLeft == 0) {
         ALOGV("EOS reached, done prefetching for now");
         mFetching = false;
@@ -502,6 +874,8 @@ void NuCachedSource2::restartPrefetcherIfNecessary_l(
         maxBytes -= kGrayArea;
     }
 
+    spillToDiskCache_l(maxBytes);
+
     size_t actualBytes = mCache->releaseFromStart(maxBytes);
     mCacheOffset += actualBytes;
 
@@ -531,6 +905,23 @@ ssize_t NuCachedSource2::readAt(off64_t offset, void *data, size_t size) {
         return size;
     }
 
+    // Then from the disk cache. This does not move mLastAccessPos, the
+    // PageCache keeps prefetching ahead of the last network-backed read.
+    if (mDiskCache != NULL) {
+        // don't hold up the fetcher while reading from disk
+        mLock.unlock();
+        ssize_t n = mDiskCache->read(offset, data, size);
+        mLock.lock();
+
+        if (mDisconnecting) {
+            return ERROR_END_OF_STREAM;
+        }
+
+        if (n >= 0) {
+            return n;
+        }
+    }
+
     sp<AMessage> msg = new AMessage(kWhatRead, mReflector);
     msg->setInt64("offset", offset);
     msg->setPointer("data", data);
@@ -560,6 +951,31 @@ ssize_t NuCachedSource2::readAt(off64_t offset, void *data, size_t size) {
     return (ssize_t)result;
 }
 
+ssize_t NuCachedSource2::readAtViews(
+        off64_t offset, size_t size, Vector<sp<ABuffer> > *views) {
+    {
+        Mutex::Autolock autoSerializer(mSerializer);
+
+        ALOGV("readAtViews offset %lld, size %zu", (long long)offset, size);
+
+        Mutex::Autolock autoLock(mLock);
+        if (mDisconnecting) {
+            return ERROR_END_OF_STREAM;
+        }
+
+        if (offset >= mCacheOffset
+                && offset + size <= mCacheOffset + mCache->totalSize()) {
+            mCache->getViews(offset - mCacheOffset, size, views);
+
+            mLastAccessPos = offset + size;
+
+            return size;
+        }
+    }
+
+    return DataSource::readAtViews(offset, size, views);
+}
+
 size_t NuCachedSource2::cachedSize() {
     Mutex::Autolock autoLock(mLock);
     return mCacheOffset + mCache->totalSize();
@@ -661,6 +1077,7 @@ status_t NuCachedSource2::seekInternal_l(off64_t offset) {
     mCacheOffset = offset;
 
     size_t totalSize = mCache->totalSize();
+    spillToDiskCache_l(totalSize);
     CHECK_EQ(mCache->releaseFromStart(totalSize), totalSize);
 
     mNumRetriesLeft = kMaxNumRetries;
@@ -700,6 +1117,59 @@ void NuCachedSource2::updateCacheParamsFromSystemProperty() {
     updateCacheParamsFromString(value);
 }
 
+void NuCachedSource2::createDiskCacheFromSystemProperty() {
+    if (!(mSource->flags() & kIsHTTPBasedSource)) {
+        // local sources are cheap to read again
+        return;
+    }
+
+    char dir[PROPERTY_VALUE_MAX];
+    if (!property_get("media.stagefright.cache-dir", dir, NULL)) {
+        return;
+    }
+
+    String8 uri = mSource->getUri();
+    if (uri.isEmpty()) {
+        return;
+    }
+
+    off64_t maxBytes = kDefaultDiskCacheSize;
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.stagefright.disk-cache-kb", value, NULL)) {
+        maxBytes = strtoll(value, NULL, 10) * 1024;
+        if (maxBytes < (off64_t)kPageSize) {
+            return;
+        }
+    }
+
+    off64_t sourceSize;
+    if (mSource->getSize(&sourceSize) != OK) {
+        sourceSize = -1;
+    }
+
+    ALOGV("disk cache in '%s', %lld bytes", dir, (long long)maxBytes);
+    mDiskCache = new DiskCache(dir, uri, sourceSize, kPageSize, maxBytes);
+}
+
+void NuCachedSource2::spillToDiskCache_l(size_t maxBytes) {
+    if (mDiskCache == NULL) {
+        return;
+    }
+
+    if (maxBytes > mCache->totalSize()) {
+        maxBytes = mCache->totalSize();
+    }
+
+    // The disk cache only keeps whole pages at multiples of kPageSize.
+    off64_t blockOffset = (mCacheOffset + kPageSize - 1) / kPageSize * kPageSize;
+    off64_t endOffset = mCacheOffset + maxBytes;
+    for (; blockOffset + kPageSize <= endOffset; blockOffset += kPageSize) {
+        sp<ABuffer> block = new ABuffer(kPageSize);
+        mCache->copy(blockOffset - mCacheOffset, block->data(), kPageSize);
+        mDiskCache->queueBlock(blockOffset / kPageSize, block);
+    }
+}
+
 void NuCachedSource2::updateCacheParamsFromString(const char *s) {
     ssize_t lowwaterMarkKb, highwaterMarkKb;
     int keepAliveSecs;
@@ -36,9 +36,142 @@
 #include <media/stagefright/MediaSource.h>
 #include <media/stagefright/MetaData.h>
 #include <media/stagefright/Utils.h>
+#include <utils/List.h>
 
 namespace android {
 
+// Reads samples from a track's source on its own thread, so that with several tracks
+// selected their read latencies overlap instead of adding up on the caller's thread.
+// The source is only read by this thread while it runs.
+struct NuMediaExtractor::SamplePrefetcher : public Thread {
+    SamplePrefetcher(const sp<MediaSource> &source, size_t maxQueued);
+
+    void start();
+
+    // Stops the thread but keeps the samples read so far; the caller may read the
+    // source directly once they are consumed.
+    void stop();
+
+    // Stops the thread and releases the samples read so far.
+    void flush();
+
+    // Returns the next sample, or the error that ended the track. Blocks while
+    // the thread is running and nothing has been read yet; returns WOULD_BLOCK
+    // once the thread has stopped and all samples are consumed.
+    status_t dequeue(MediaBuffer **sample);
+
+protected:
+    virtual ~SamplePrefetcher();
+
+private:
+    sp<MediaSource> mSource;
+    size_t mMaxQueued;
+
+    Mutex mLock;
+    Condition mCondition;
+    List<MediaBuffer *> mSamples;
+    status_t mFinalResult;
+    bool mRunning;
+
+    virtual bool threadLoop();
+
+    DISALLOW_EVIL_CONSTRUCTORS(SamplePrefetcher);
+};
+
+NuMediaExtractor::SamplePrefetcher::SamplePrefetcher(
+        const sp<MediaSource> &source, size_t maxQueued)
+    : Thread(false /* canCallJava */),
+      mSource(source),
+      mMaxQueued(maxQueued),
+      mFinalResult(OK),
+      mRunning(false) {
+}
+
+NuMediaExtractor::SamplePrefetcher::~SamplePrefetcher() {
+    flush();
+}
+
+void NuMediaExtractor::SamplePrefetcher::start() {
+    Mutex::Autolock autoLock(mLock);
+
+    if (mRunning || mFinalResult != OK) {
+        return;
+    }
+
+    mRunning = (run("NuMediaExtractor") == OK);
+}
+
+void NuMediaExtractor::SamplePrefetcher::stop() {
+    {
+        Mutex::Autolock autoLock(mLock);
+        if (!mRunning) {
+            return;
+        }
+        requestExit();
+        mCondition.broadcast();
+    }
+
+    requestExitAndWait();
+
+    Mutex::Autolock autoLock(mLock);
+    mRunning = false;
+}
+
+void NuMediaExtractor::SamplePrefetcher::flush() {
+    stop();
+
+    Mutex::Autolock autoLock(mLock);
+    while (!mSamples.empty()) {
+        (*mSamples.begin())->release();
+        mSamples.erase(mSamples.begin());
+    }
+    mFinalResult = OK;
+}
+
+status_t NuMediaExtractor::SamplePrefetcher::dequeue(MediaBuffer **sample) {
+    Mutex::Autolock autoLock(mLock);
+
+    while (mSamples.empty() && mFinalResult == OK && mRunning) {
+        mCondition.wait(mLock);
+    }
+
+    if (mSamples.empty()) {
+        return mFinalResult != OK ? mFinalResult : WOULD_BLOCK;
+    }
+
+    *sample = *mSamples.begin();
+    mSamples.erase(mSamples.begin());
+    mCondition.broadcast();
+    return OK;
+}
+
+bool NuMediaExtractor::SamplePrefetcher::threadLoop() {
+    {
+        Mutex::Autolock autoLock(mLock);
+        while (mSamples.size() >= mMaxQueued && !exitPending()) {
+            mCondition.wait(mLock);
+        }
+        if (exitPending()) {
+            return false;
+        }
+    }
+
+    MediaBuffer *sample;
+    status_t err = mSource->read(&sample);
+
+    Mutex::Autolock autoLock(mLock);
+    if (err != OK) {
+        CHECK(sample == NULL);
+        mFinalResult = err;
+        mRunning = false;
+        mCondition.broadcast();
+        return false;
+    }
+    mSamples.push_back(sample);
+    mCondition.broadcast();
+    return true;
+}
+
 NuMediaExtractor::NuMediaExtractor()
     : mIsWidevineExtractor(false),
       mTotalBitrate(-1ll),
@@ -51,6 +184,7 @@ NuMediaExtractor::~NuMediaExtractor() {
     for (size_t i = 0; i < mSelectedTracks.size(); ++i) {
         TrackInfo *info = &mSelectedTracks.editItemAt(i);
 
+        stopPrefetching(info);
         CHECK_EQ((status_t)OK, info->mSource->stop());
     }
 
@@ -336,6 +470,8 @@ status_t NuMediaExtractor::unselectTrack(size_t index) {
         info->mSampleTimeUs = -1ll;
     }
 
+    stopPrefetching(info);
+
     CHECK_EQ((status_t)OK, info->mSource->stop());
 
     mSelectedTracks.removeAt(i);
@@ -343,6 +479,13 @@ status_t NuMediaExtractor::unselectTrack(size_t index) {
     return OK;
 }
 
+void NuMediaExtractor::stopPrefetching(TrackInfo *info) {
+    if (info->mPrefetcher != NULL) {
+        info->mPrefetcher->flush();
+        info->mPrefetcher.clear();
+    }
+}
+
 void NuMediaExtractor::releaseTrackSamples() {
     for (size_t i = 0; i < mSelectedTracks.size(); ++i) {
         TrackInfo *info = &mSelectedTracks.editItemAt(i);
@@ -367,6 +510,11 @@ ssize_t NuMediaExtractor::fetchTrackSamples(
         if (seekTimeUs >= 0ll) {
             info->mFinalResult = OK;
 
+            if (info->mPrefetcher != NULL) {
+                // the source has to be read on this thread to seek
+                info->mPrefetcher->flush();
+            }
+
             if (info->mSample != NULL) {
                 info->mSample->release();
                 info->mSample = NULL;
@@ -377,11 +525,17 @@ ssize_t NuMediaExtractor::fetchTrackSamples(
         }
 
         if (info->mSample == NULL) {
-            MediaSource::ReadOptions options;
-            if (seekTimeUs >= 0ll) {
-                options.setSeekTo(seekTimeUs, mode);
+            status_t err = WOULD_BLOCK;
+            if (info->mPrefetcher != NULL && seekTimeUs < 0ll) {
+                err = info->mPrefetcher->dequeue(&info->mSample);
+            }
+            if (err == WOULD_BLOCK) {
+                MediaSource::ReadOptions options;
+                if (seekTimeUs >= 0ll) {
+                    options.setSeekTo(seekTimeUs, mode);
+                }
+                err = info->mSource->read(&info->mSample, &options);
             }
-            status_t err = info->mSource->read(&info->mSample, &options);
 
             if (err != OK) {
                 CHECK(info->mSample == NULL);
@@ -408,6 +562,22 @@ ssize_t NuMediaExtractor::fetchTrackSamples(
         }
     }
 
+    // Read ahead on every track once more than one is selected, so that the next call
+    // does not wait on the slowest source. Widevine sources stay on the caller's thread.
+    if (mSelectedTracks.size() > 1 && !mIsWidevineExtractor) {
+        for (size_t i = 0; i < mSelectedTracks.size(); ++i) {
+            TrackInfo *info = &mSelectedTracks.editItemAt(i);
+
+            if (info->mFinalResult != OK) {
+                continue;
+            }
+            if (info->mPrefetcher == NULL) {
+                info->mPrefetcher = new SamplePrefetcher(info->mSource, kMaxPrefetchedSamples);
+            }
+            info->mPrefetcher->start();
+        }
+    }
+
     return minIndex;
 }
 
@@ -442,52 +612,122 @@ status_t NuMediaExtractor::advance() {
     return OK;
 }
 
-status_t NuMediaExtractor::readSampleData(const sp<ABuffer> &buffer) {
-    Mutex::Autolock autoLock(mLock);
-
-    ssize_t minIndex = fetchTrackSamples();
-
-    if (minIndex < 0) {
-        return ERROR_END_OF_STREAM;
-    }
-
-    TrackInfo *info = &mSelectedTracks.editItemAt(minIndex);
-
-    size_t sampleSize = info->mSample->range_length();
+status_t NuMediaExtractor::copySampleData(
+        const TrackInfo &info, uint8_t *dst, size_t capacity, size_t *sampleSize) const {
+    *sampleSize = info.mSample->range_length();
 
-    if (info->mTrackFlags & kIsVorbis) {
+    if (info.mTrackFlags & kIsVorbis) {
         // Each sample's data is suffixed by the number of page samples
         // or -1 if not available.
-        sampleSize += sizeof(int32_t);
+        *sampleSize += sizeof(int32_t);
     }
 
-    if (buffer->capacity() < sampleSize) {
+    if (capacity < *sampleSize) {
         return -ENOMEM;
     }
 
     const uint8_t *src =
-        (const uint8_t *)info->mSample->data()
-            + info->mSample->range_offset();
+        (const uint8_t *)info.mSample->data()
+            + info.mSample->range_offset();
 
-    memcpy((uint8_t *)buffer->data(), src, info->mSample->range_length());
+    memcpy(dst, src, info.mSample->range_length());
 
-    if (info->mTrackFlags & kIsVorbis) {
+    if (info.mTrackFlags & kIsVorbis) {
         int32_t numPageSamples;
-        if (!info->mSample->meta_data()->findInt32(
+        if (!info.mSample->meta_data()->findInt32(
                     kKeyValidSamples, &numPageSamples)) {
             numPageSamples = -1;
         }
 
-        memcpy((uint8_t *)buffer->data() + info->mSample->range_length(),
+        memcpy(dst + info.mSample->range_length(),
                &numPageSamples,
                sizeof(numPageSamples));
     }
 
+    return OK;
+}
+
+status_t NuMediaExtractor::readSampleData(const sp<ABuffer> &buffer) {
+    Mutex::Autolock autoLock(mLock);
+
+    ssize_t minIndex = fetchTrackSamples();
+
+    if (minIndex < 0) {
+        return ERROR_END_OF_STREAM;
+    }
+
+    TrackInfo *info = &mSelectedTracks.editItemAt(minIndex);
+
+    size_t sampleSize;
+    status_t err = copySampleData(*info, buffer->data(), buffer->capacity(), &sampleSize);
+    if (err != OK) {
+        return err;
+    }
+
     buffer->setRange(0, sampleSize);
 
     return OK;
 }
 
+status_t NuMediaExtractor::readSampleDataBatch(
+        const sp<ABuffer> &buffer, SampleInfo *infos, size_t maxSamples,
+        size_t *numSamples) {
+    Mutex::Autolock autoLock(mLock);
+
+    *numSamples = 0;
+    size_t offset = 0;
+    status_t err = OK;
+
+    while (*numSamples < maxSamples) {
+        ssize_t minIndex = fetchTrackSamples();
+
+        if (minIndex < 0) {
+            err = ERROR_END_OF_STREAM;
+            break;
+        }
+
+        TrackInfo *info = &mSelectedTracks.editItemAt(minIndex);
+        sp<MetaData> meta = info->mSample->meta_data();
+
+        uint32_t type;
+        const void *data;
+        size_t size;
+        if (meta->findData(kKeyEncryptedSizes, &type, &data, &size)) {
+            err = ERROR_UNSUPPORTED;
+            break;
+        }
+
+        size_t sampleSize;
+        err = copySampleData(
+                *info, buffer->data() + offset, buffer->capacity() - offset, &sampleSize);
+        if (err != OK) {
+            break;
+        }
+
+        SampleInfo *sampleInfo = &infos[(*numSamples)++];
+        sampleInfo->mOffset = offset;
+        sampleInfo->mSize = sampleSize;
+        sampleInfo->mTimeUs = info->mSampleTimeUs;
+        sampleInfo->mTrackIndex = info->mTrackIndex;
+        sampleInfo->mFlags = 0;
+
+        int32_t val;
+        if (meta->findInt32(kKeyIsSyncFrame, &val) && val != 0) {
+            sampleInfo->mFlags |= SAMPLE_FLAG_SYNC;
+        }
+
+        offset += sampleSize;
+
+        info->mSample->release();
+        info->mSample = NULL;
+        info->mSampleTimeUs = -1ll;
+    }
+
+    buffer->setRange(0, offset);
+
+    return *numSamples > 0 ? OK : err;
+}
+
 status_t NuMediaExtractor::getSampleTrackIndex(size_t *trackIndex) {
     Mutex::Autolock autoLock(mLock);
 
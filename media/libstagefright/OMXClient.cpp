@@ -27,12 +27,149 @@
 #include <media/IMediaPlayerService.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/OMXClient.h>
+#include <private/media/OMXMessageRing.h>
 #include <utils/KeyedVector.h>
+#include <utils/threads.h>
 
 #include "include/OMX.h"
 
 namespace android {
 
+// The client end of the message ring of a remote node, see OMXMessageRing. It stands in
+// for the client's observer, and delivers the buffer done messages read from the ring and
+// those coming through binder, in order.
+struct MessageRingObserver : public BnOMXObserver {
+    MessageRingObserver(const sp<IOMXObserver> &observer);
+
+    status_t start(IOMX::node_id node, const sp<IMemory> &memory);
+    void stop();
+
+    // Queues a buffer command for the node, false if it must go through binder.
+    bool writeCommand(const OMXMessageRing::Entry &entry);
+
+    virtual void onMessages(const std::list<omx_message> &messages);
+
+protected:
+    virtual ~MessageRingObserver();
+
+private:
+    struct EventThread : public Thread {
+        EventThread(MessageRingObserver *observer)
+            : Thread(false /* canCallJava */),
+              mObserver(observer) {
+        }
+
+    private:
+        MessageRingObserver *mObserver;
+
+        virtual bool threadLoop() {
+            if (!mObserver->mEventRing->wait()) {
+                return false;
+            }
+            mObserver->onMessages(std::list<omx_message>());
+            return true;
+        }
+    };
+
+    const sp<IOMXObserver> mObserver;
+    IOMX::node_id mNode;
+
+    Mutex mCommandLock;
+    sp<OMXMessageRing> mCommandRing;
+
+    Mutex mEventLock;   // held while delivering messages
+    sp<OMXMessageRing> mEventRing;
+    sp<EventThread> mEventThread;
+
+    DISALLOW_EVIL_CONSTRUCTORS(MessageRingObserver);
+};
+
+MessageRingObserver::MessageRingObserver(const sp<IOMXObserver> &observer)
+    : mObserver(observer),
+      mNode(0) {
+}
+
+MessageRingObserver::~MessageRingObserver() {
+    stop();
+}
+
+status_t MessageRingObserver::start(IOMX::node_id node, const sp<IMemory> &memory) {
+    sp<OMXMessageRing> commandRing = new OMXMessageRing(memory, OMXMessageRing::kCommands);
+    sp<OMXMessageRing> eventRing = new OMXMessageRing(memory, OMXMessageRing::kEvents);
+    if (!commandRing->isValid() || !eventRing->isValid()) {
+        return BAD_VALUE;
+    }
+
+    {
+        Mutex::Autolock autoLock(mEventLock);
+        mNode = node;
+        mEventRing = eventRing;
+        mEventThread = new EventThread(this);
+        status_t err = mEventThread->run("OMXEventRing", ANDROID_PRIORITY_FOREGROUND);
+        if (err != OK) {
+            mEventThread.clear();
+            mEventRing.clear();
+            return err;
+        }
+    }
+
+    Mutex::Autolock autoLock(mCommandLock);
+    mCommandRing = commandRing;
+    return OK;
+}
+
+void MessageRingObserver::stop() {
+    {
+        Mutex::Autolock autoLock(mCommandLock);
+        mCommandRing.clear();
+    }
+
+    sp<EventThread> thread;
+    {
+        Mutex::Autolock autoLock(mEventLock);
+        if (mEventThread == NULL) {
+            return;
+        }
+        mEventRing->interrupt();
+        thread = mEventThread;
+        mEventThread.clear();
+    }
+
+    // the thread takes mEventLock
+    thread->requestExitAndWait();
+}
+
+bool MessageRingObserver::writeCommand(const OMXMessageRing::Entry &entry) {
+    Mutex::Autolock autoLock(mCommandLock);
+    return mCommandRing != NULL && mCommandRing->write(entry);
+}
+
+void MessageRingObserver::onMessages(const std::list<omx_message> &messages) {
+    Mutex::Autolock autoLock(mEventLock);
+
+    // what is on the ring was sent first
+    std::list<omx_message> ordered;
+    if (mEventRing != NULL) {
+        OMXMessageRing::Entry entries[16];
+        ssize_t n;
+        while ((n = mEventRing->read(entries, NELEM(entries))) > 0) {
+            for (ssize_t i = 0; i < n; ++i) {
+                omx_message msg;
+                if (OMXMessageRing::EntryToMessage(entries[i], mNode, &msg)) {
+                    ordered.push_back(msg);
+                }
+            }
+        }
+    }
+    ordered.insert(ordered.end(), messages.begin(), messages.end());
+
+    if (!ordered.empty()) {
+        mObserver->onMessages(ordered);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 struct MuxOMX : public IOMX {
     MuxOMX(const sp<IOMX> &remoteOMX);
     virtual ~MuxOMX();
@@ -145,6 +282,8 @@ struct MuxOMX : public IOMX {
             const void *data,
             size_t size);
 
+    virtual status_t createMessageRing(node_id node, sp<IMemory> *memory);
+
 private:
     mutable Mutex mLock;
 
@@ -153,6 +292,10 @@ private:
 
     KeyedVector<node_id, bool> mIsLocalNode;
 
+    // remote nodes using a message ring for their buffers
+    KeyedVector<node_id, sp<MessageRingObserver> > mMessageRings;
+    bool writeCommand(node_id node, const OMXMessageRing::Entry &entry);
+
     bool isLocalNode(node_id node) const;
     bool isLocalNode_l(node_id node) const;
     const sp<IOMX> &getOMX(node_id node) const;
@@ -230,7 +373,14 @@ status_t MuxOMX::allocateNode(
         omx = mRemoteOMX;
     }
 
-    status_t err = omx->allocateNode(name, observer, node);
+    // remote buffers go through a message ring when mediaserver supports it
+    sp<MessageRingObserver> ringObserver;
+    if (omx == mRemoteOMX) {
+        ringObserver = new MessageRingObserver(observer);
+    }
+
+    status_t err = omx->allocateNode(
+            name, ringObserver != NULL ? ringObserver : observer, node);
 
     if (err != OK) {
         return err;
@@ -238,6 +388,17 @@ status_t MuxOMX::allocateNode(
 
     if (omx == mLocalOMX) {
         mIsLocalNode.add(*node, true);
+    } else {
+        sp<IMemory> memory;
+        err = omx->createMessageRing(*node, &memory);
+        if (err == OK) {
+            err = ringObserver->start(*node, memory);
+        }
+        if (err == OK) {
+            mMessageRings.add(*node, ringObserver);
+        } else {
+            ALOGW("not using a message ring for node %#x: %d", *node, err);
+        }
     }
 
     return OK;
@@ -254,9 +415,28 @@ status_t MuxOMX::freeNode(node_id node) {
 
     mIsLocalNode.removeItem(node);
 
+    ssize_t index = mMessageRings.indexOfKey(node);
+    if (index >= 0) {
+        mMessageRings.valueAt(index)->stop();
+        mMessageRings.removeItemsAt(index);
+    }
+
     return OK;
 }
 
+bool MuxOMX::writeCommand(node_id node, const OMXMessageRing::Entry &entry) {
+    sp<MessageRingObserver> ring;
+    {
+        Mutex::Autolock autoLock(mLock);
+        ssize_t index = mMessageRings.indexOfKey(node);
+        if (index < 0) {
+            return false;
+        }
+        ring = mMessageRings.valueAt(index);
+    }
+    return ring->writeCommand(entry);
+}
+
 status_t MuxOMX::sendCommand(
         node_id node, OMX_COMMANDTYPE cmd, OMX_S32 param) {
     return getOMX(node)->sendCommand(node, cmd, param);
@@ -386,6 +566,16 @@ status_t MuxOMX::freeBuffer(
 }
 
 status_t MuxOMX::fillBuffer(node_id node, buffer_id buffer, int fenceFd) {
+    if (fenceFd < 0) {
+        OMXMessageRing::Entry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.mType = OMXMessageRing::kFillBuffer;
+        entry.mBuffer = buffer;
+        if (writeCommand(node, entry)) {
+            return OK;
+        }
+    }
+
     return getOMX(node)->fillBuffer(node, buffer, fenceFd);
 }
 
@@ -394,6 +584,20 @@ status_t MuxOMX::emptyBuffer(
         buffer_id buffer,
         OMX_U32 range_offset, OMX_U32 range_length,
         OMX_U32 flags, OMX_TICKS timestamp, int fenceFd) {
+    if (fenceFd < 0) {
+        OMXMessageRing::Entry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.mType = OMXMessageRing::kEmptyBuffer;
+        entry.mBuffer = buffer;
+        entry.mRangeOffset = range_offset;
+        entry.mRangeLength = range_length;
+        entry.mFlags = flags;
+        entry.mTimestamp = timestamp;
+        if (writeCommand(node, entry)) {
+            return OK;
+        }
+    }
+
     return getOMX(node)->emptyBuffer(
             node, buffer, range_offset, range_length, flags, timestamp, fenceFd);
 }
@@ -414,6 +618,10 @@ status_t MuxOMX::setInternalOption(
     return getOMX(node)->setInternalOption(node, port_index, type, data, size);
 }
 
+status_t MuxOMX::createMessageRing(node_id node, sp<IMemory> *memory) {
+    return getOMX(node)->createMessageRing(node, memory);
+}
+
 OMXClient::OMXClient() {
 }
 
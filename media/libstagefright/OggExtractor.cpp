@@ -105,6 +105,23 @@ protected:
         int64_t mTimeUs;
     };
 
+    struct SeekIndexEntry {
+        off64_t mPageOffset;
+        size_t mPageSize;
+        uint64_t mGranulePosition;
+        int64_t mTimeUs;
+    };
+
+    enum {
+        // Bytes scanned per read while looking for a page's capture pattern.
+        kPageSyncBlockSize = 4096,
+        // Once bisection has narrowed a seek down to this many bytes, the
+        // remaining pages are read in order.
+        kSeekScanBytes = 65536,
+        kMaxSeekProbes = 16,
+        kMaxSeekIndexSize = 16384,
+    };
+
     sp<DataSource> mSource;
     off64_t mOffset;
     Page mCurrentPage;
@@ -129,9 +146,20 @@ protected:
 
     Vector<TOCEntry> mTableOfContents;
 
+    // Pages visited while reading or seeking, sorted by offset. Used to
+    // narrow down seeks when there is no table of contents.
+    Vector<SeekIndexEntry> mSeekIndex;
+
     ssize_t readPage(off64_t offset, Page *page);
     status_t findNextPage(off64_t startOffset, off64_t *pageOffset);
 
+    void addToSeekIndex(off64_t pageOffset, size_t pageSize, const Page &page);
+    size_t seekIndexLowerBound(off64_t pageOffset) const;
+
+    // Finds the first page ending at or after timeUs by interpolated bisection
+    // between the closest pages known from mSeekIndex.
+    status_t bisectToTime(int64_t timeUs, off64_t *pageOffset);
+
     virtual int64_t getTimeUsOfGranule(uint64_t granulePos) const = 0;
 
     // Extract codec format, metadata tags, and various codec specific data;
@@ -326,9 +354,9 @@ status_t MyOggExtractor::findNextPage(
         off64_t startOffset, off64_t *pageOffset) {
     *pageOffset = startOffset;
 
+    uint8_t block[kPageSyncBlockSize];
     for (;;) {
-        char signature[4];
-        ssize_t n = mSource->readAt(*pageOffset, &signature, 4);
+        ssize_t n = mSource->readAt(*pageOffset, block, sizeof(block));
 
         if (n < 4) {
             *pageOffset = 0;
@@ -336,17 +364,65 @@ status_t MyOggExtractor::findNextPage(
             return (n < 0) ? n : (status_t)ERROR_END_OF_STREAM;
         }
 
-        if (!memcmp(signature, "OggS", 4)) {
-            if (*pageOffset > startOffset) {
-                ALOGV("skipped %lld bytes of junk to reach next frame",
-                     (long long)(*pageOffset - startOffset));
+        for (ssize_t i = 0; i + 4 <= n; ++i) {
+            if (!memcmp(&block[i], "OggS", 4)) {
+                *pageOffset += i;
+
+                if (*pageOffset > startOffset) {
+                    ALOGV("skipped %lld bytes of junk to reach next frame",
+                         (long long)(*pageOffset - startOffset));
+                }
+
+                return OK;
             }
+        }
 
-            return OK;
+        // the capture pattern may straddle the end of this block
+        *pageOffset += n - 3;
+    }
+}
+
+void MyOggExtractor::addToSeekIndex(
+        off64_t pageOffset, size_t pageSize, const Page &page) {
+    if (page.mGranulePosition == (uint64_t)-1) {
+        // no packet ends on this page
+        return;
+    }
+
+    size_t i = seekIndexLowerBound(pageOffset);
+    if (i < mSeekIndex.size() && mSeekIndex.itemAt(i).mPageOffset == pageOffset) {
+        return;
+    }
+
+    static const size_t kMaxNumSeekIndexEntries = kMaxSeekIndexSize / sizeof(SeekIndexEntry);
+    if (mSeekIndex.size() >= kMaxNumSeekIndexEntries) {
+        // thin out the index evenly
+        for (ssize_t j = mSeekIndex.size() - 1; j >= 0; j -= 2) {
+            mSeekIndex.removeAt(j);
         }
+        i = seekIndexLowerBound(pageOffset);
+    }
+
+    SeekIndexEntry entry;
+    entry.mPageOffset = pageOffset;
+    entry.mPageSize = pageSize;
+    entry.mGranulePosition = page.mGranulePosition;
+    entry.mTimeUs = getTimeUsOfGranule(page.mGranulePosition);
+    mSeekIndex.insertAt(entry, i);
+}
 
-        ++*pageOffset;
+size_t MyOggExtractor::seekIndexLowerBound(off64_t pageOffset) const {
+    size_t left = 0;
+    size_t right = mSeekIndex.size();
+    while (left < right) {
+        size_t center = left + (right - left) / 2;
+        if (mSeekIndex.itemAt(center).mPageOffset < pageOffset) {
+            left = center + 1;
+        } else {
+            right = center;
+        }
     }
+    return left;
 }
 
 // Given the offset of the "current" page, find the page immediately preceding
@@ -414,6 +490,12 @@ status_t MyOggExtractor::seekToTime(int64_t timeUs) {
     }
 
     if (mTableOfContents.isEmpty()) {
+        off64_t pageOffset;
+        if (bisectToTime(timeUs, &pageOffset) == OK) {
+            ALOGV("seeking to offset %lld", (long long)pageOffset);
+            return seekToOffset(pageOffset);
+        }
+
         // Perform approximate seeking based on avg. bitrate.
         uint64_t bps = approxBitrate();
         if (bps <= 0) {
@@ -455,6 +537,134 @@ status_t MyOggExtractor::seekToTime(int64_t timeUs) {
     return seekToOffset(entry.mPageOffset);
 }
 
+status_t MyOggExtractor::bisectToTime(int64_t timeUs, off64_t *pageOffset) {
+    off64_t size;
+    if (mFirstDataOffset < 0 || mSource->getSize(&size) != OK || size <= mFirstDataOffset) {
+        return INVALID_OPERATION;
+    }
+
+    int64_t durationUs;
+    if (!mMeta->findInt64(kKeyDuration, &durationUs)) {
+        // Only the interpolation needs the duration, an estimate will do.
+        uint64_t bps = approxBitrate();
+        if (bps > 0) {
+            durationUs = (size - mFirstDataOffset) * 8000000ll / bps;
+        } else if (!mSeekIndex.isEmpty() && mSeekIndex.top().mTimeUs > 0) {
+            const SeekIndexEntry &last = mSeekIndex.top();
+            durationUs = (double)last.mTimeUs * (size - mFirstDataOffset)
+                    / (last.mPageOffset + last.mPageSize - mFirstDataOffset);
+        } else {
+            return INVALID_OPERATION;
+        }
+    }
+
+    // [loOffset, hiOffset) is the range that may still hold the first page ending
+    // at or after timeUs; loPageOffset is the last page known to end before it.
+    off64_t loPageOffset = mFirstDataOffset;
+    off64_t loOffset = mFirstDataOffset;
+    int64_t loTimeUs = 0;
+    off64_t hiOffset = size;
+    int64_t hiTimeUs = durationUs;
+    bool hiIsPage = false;
+
+    size_t left = 0;
+    size_t right = mSeekIndex.size();
+    while (left < right) {
+        size_t center = left + (right - left) / 2;
+        if (mSeekIndex.itemAt(center).mTimeUs < timeUs) {
+            left = center + 1;
+        } else {
+            right = center;
+        }
+    }
+    if (left > 0) {
+        const SeekIndexEntry &entry = mSeekIndex.itemAt(left - 1);
+        loPageOffset = entry.mPageOffset;
+        loOffset = entry.mPageOffset + entry.mPageSize;
+        loTimeUs = entry.mTimeUs;
+    }
+    if (left < mSeekIndex.size()) {
+        const SeekIndexEntry &entry = mSeekIndex.itemAt(left);
+        hiOffset = entry.mPageOffset;
+        hiTimeUs = entry.mTimeUs;
+        hiIsPage = true;
+    }
+
+    for (size_t probes = 0;
+            hiOffset - loOffset > kSeekScanBytes && probes < kMaxSeekProbes; ++probes) {
+        off64_t guess = loOffset + (hiOffset - loOffset) / 2;
+        if (hiTimeUs > loTimeUs && timeUs > loTimeUs) {
+            guess = loOffset + (off64_t)((double)(timeUs - loTimeUs)
+                    * (hiOffset - loOffset) / (hiTimeUs - loTimeUs));
+            // land just before the page rather than just after it
+            guess -= kSeekScanBytes / 2;
+        }
+        if (guess < loOffset) {
+            guess = loOffset;
+        } else if (guess >= hiOffset) {
+            guess = hiOffset - 1;
+        }
+
+        ALOGV("seek probe %zu at %lld in [%lld, %lld)", probes,
+                (long long)guess, (long long)loOffset, (long long)hiOffset);
+
+        off64_t offset;
+        Page page;
+        ssize_t n = 0;
+        status_t err = findNextPage(guess, &offset);
+        while (err == OK && offset < hiOffset) {
+            n = readPage(offset, &page);
+            if (n <= 0) {
+                err = (n < 0) ? (status_t)n : (status_t)ERROR_END_OF_STREAM;
+                break;
+            }
+            addToSeekIndex(offset, n, page);
+            if (page.mGranulePosition != (uint64_t)-1) {
+                break;
+            }
+            offset += n;
+        }
+
+        if (err != OK || offset >= hiOffset) {
+            // nothing usable past the guess
+            hiOffset = guess;
+            continue;
+        }
+
+        int64_t pageTimeUs = getTimeUsOfGranule(page.mGranulePosition);
+        if (pageTimeUs < timeUs) {
+            loPageOffset = offset;
+            loOffset = offset + n;
+            loTimeUs = pageTimeUs;
+        } else {
+            hiOffset = offset;
+            hiTimeUs = pageTimeUs;
+            hiIsPage = true;
+        }
+    }
+
+    off64_t offset = loOffset;
+    while (offset < hiOffset && findNextPage(offset, &offset) == OK && offset < hiOffset) {
+        Page page;
+        ssize_t n = readPage(offset, &page);
+        if (n <= 0) {
+            break;
+        }
+        addToSeekIndex(offset, n, page);
+        if (page.mGranulePosition != (uint64_t)-1) {
+            if (getTimeUsOfGranule(page.mGranulePosition) >= timeUs) {
+                *pageOffset = offset;
+                return OK;
+            }
+            loPageOffset = offset;
+        }
+        offset += n;
+    }
+
+    *pageOffset = hiIsPage ? hiOffset : loPageOffset;
+    return OK;
+}
+
 status_t MyOggExtractor::seekToOffset(off64_t offset) {
     if (mFirstDataOffset >= 0 && offset < mFirstDataOffset) {
         // Once we know where the actual audio data starts (past the headers)
@@ -472,7 +682,13 @@ status_t MyOggExtractor::seekToOffset(off64_t offset) {
     // We found the page we wanted to seek to, but we'll also need
     // the page preceding it to determine how many valid samples are on
     // this page.
-    findPrevGranulePosition(pageOffset, &mPrevGranulePosition);
+    size_t i = seekIndexLowerBound(pageOffset);
+    if (i > 0 && mSeekIndex.itemAt(i - 1).mPageOffset
+            + (off64_t)mSeekIndex.itemAt(i - 1).mPageSize == pageOffset) {
+        mPrevGranulePosition = mSeekIndex.itemAt(i - 1).mGranulePosition;
+    } else {
+        findPrevGranulePosition(pageOffset, &mPrevGranulePosition);
+    }
 
     mOffset = pageOffset;
 
@@ -489,12 +705,14 @@ status_t MyOggExtractor::seekToOffset(off64_t offset) {
 }
 
 ssize_t MyOggExtractor::readPage(off64_t offset, Page *page) {
-    uint8_t header[27];
+    // Read the fixed header and the largest possible segment table at once.
+    static const size_t kHeaderSize = 27;
+    uint8_t header[kHeaderSize + sizeof(page->mLace)];
     ssize_t n;
     if ((n = mSource->readAt(offset, header, sizeof(header)))
-            < (ssize_t)sizeof(header)) {
+            < (ssize_t)kHeaderSize) {
         ALOGV("failed to read %zu bytes at offset %#016llx, got %zd bytes",
-                sizeof(header), (long long)offset, n);
+                kHeaderSize, (long long)offset, n);
 
         if (n < 0) {
             return n;
@@ -533,11 +751,10 @@ ssize_t MyOggExtractor::readPage(off64_t offset, Page *page) {
     page->mPageNo = U32LE_AT(&header[18]);
 
     page->mNumSegments = header[26];
-    if (mSource->readAt(
-                offset + sizeof(header), page->mLace, page->mNumSegments)
-            < (ssize_t)page->mNumSegments) {
+    if (n < (ssize_t)(kHeaderSize + page->mNumSegments)) {
         return ERROR_IO;
     }
+    memcpy(page->mLace, &header[kHeaderSize], page->mNumSegments);
 
     size_t totalSize = 0;;
     for (size_t i = 0; i < page->mNumSegments; ++i) {
@@ -556,7 +773,7 @@ ssize_t MyOggExtractor::readPage(off64_t offset, Page *page) {
     ALOGV("%c %s", page->mFlags & 1 ? '+' : ' ', tmp.string());
 #endif
 
-    return sizeof(header) + page->mNumSegments + totalSize;
+    return kHeaderSize + page->mNumSegments + totalSize;
 }
 
 status_t MyOpusExtractor::readNextPacket(MediaBuffer **out) {
@@ -771,6 +988,8 @@ status_t MyOggExtractor::_readNextPacket(MediaBuffer **out, bool calcVorbisTimes
             return n < 0 ? n : (status_t)ERROR_END_OF_STREAM;
         }
 
+        addToSeekIndex(mOffset, n, mCurrentPage);
+
         mCurrentPageSamples =
             mCurrentPage.mGranulePosition - mPrevGranulePosition;
         mFirstPacketInPage = true;
@@ -1207,7 +1426,7 @@ static void extractAlbumArt(
         const sp<MetaData> &fileMeta, const void *data, size_t size) {
     ALOGV("extractAlbumArt from '%s'", (const char *)data);
 
-    sp<ABuffer> flacBuffer = decodeBase64(AString((const char *)data, size));
+    sp<ABuffer> flacBuffer = decodeBase64((const char *)data, size);
     if (flacBuffer == NULL) {
         ALOGE("malformed base64 encoded data.");
         return;
@@ -124,10 +124,20 @@ status_t SampleIterator::seekTo(uint32_t sampleIndex) {
     }
 
     mCurrentSampleSize = mCurrentChunkSampleSizes[chunkRelativeSampleIndex];
-    if (sampleIndex < mTTSSampleIndex) {
-        mTimeToSampleIndex = 0;
-        mTTSSampleIndex = 0;
-        mTTSSampleTime = 0;
+    if (sampleIndex < mTTSSampleIndex || sampleIndex >= mTTSSampleIndex + mTTSCount) {
+        // Reposition on the stts run containing sampleIndex instead of
+        // walking the runs from the start (or from the current run).
+        ssize_t run = mTable->findTimeToSampleRun(sampleIndex);
+        if (run >= 0) {
+            const SampleTable::TimeToSampleRun &entry = mTable->mTimeToSampleRuns[run];
+            mTimeToSampleIndex = run;
+            mTTSSampleIndex = entry.mFirstSample;
+            mTTSSampleTime = entry.mStartTime;
+        } else {
+            mTimeToSampleIndex = 0;
+            mTTSSampleIndex = 0;
+            mTTSSampleTime = 0;
+        }
         mTTSCount = 0;
         mTTSDuration = 0;
     }
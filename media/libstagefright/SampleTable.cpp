@@ -123,7 +123,13 @@ SampleTable::SampleTable(const sp<DataSource> &source)
       mNumSampleSizes(0),
       mTimeToSampleCount(0),
       mTimeToSample(NULL),
+      mTimeToSampleRuns(NULL),
+      mTimeToSampleTotalTime(0),
       mSampleTimeEntries(NULL),
+      mSampleTimeIndexBuilt(false),
+      mPresentationInDecodeOrder(false),
+      mUniformCompositionOffset(0),
+      mNumPresentationSamples(0),
       mCompositionTimeDeltaEntries(NULL),
       mNumCompositionTimeDeltaEntries(0),
       mCompositionDeltaLookup(new CompositionDeltaLookup),
@@ -151,6 +157,9 @@ SampleTable::~SampleTable() {
     delete[] mSampleTimeEntries;
     mSampleTimeEntries = NULL;
 
+    delete[] mTimeToSampleRuns;
+    mTimeToSampleRuns = NULL;
+
     delete[] mTimeToSample;
     mTimeToSample = NULL;
 
@@ -361,6 +370,21 @@ status_t SampleTable::setTimeToSampleParams(
         mTimeToSample[i] = ntohl(mTimeToSample[i]);
     }
 
+    mTimeToSampleRuns = new (std::nothrow) TimeToSampleRun[mTimeToSampleCount];
+    if (!mTimeToSampleRuns)
+        return ERROR_OUT_OF_RANGE;
+
+    uint64_t firstSample = 0;
+    uint64_t startTime = 0;
+    for (uint32_t i = 0; i < mTimeToSampleCount; ++i) {
+        mTimeToSampleRuns[i].mFirstSample = firstSample;
+        mTimeToSampleRuns[i].mStartTime = startTime;
+
+        firstSample += mTimeToSample[2 * i];
+        startTime += (uint64_t)mTimeToSample[2 * i] * mTimeToSample[2 * i + 1];
+    }
+    mTimeToSampleTotalTime = startTime;
+
     return OK;
 }
 
@@ -512,10 +536,85 @@ int SampleTable::CompareIncreasingTime(const void *_a, const void *_b) {
     return 0;
 }
 
+ssize_t SampleTable::findTimeToSampleRun(uint32_t sampleIndex) const {
+    if (mTimeToSampleRuns == NULL || mTimeToSampleCount == 0) {
+        return -1;
+    }
+
+    // last run starting at or before sampleIndex; this skips empty runs.
+    uint32_t left = 0;
+    uint32_t right = mTimeToSampleCount - 1;
+    while (left < right) {
+        uint32_t center = left + (right - left + 1) / 2;
+        if (mTimeToSampleRuns[center].mFirstSample <= sampleIndex) {
+            left = center;
+        } else {
+            right = center - 1;
+        }
+    }
+
+    return left;
+}
+
+uint32_t SampleTable::getPresentationTime(uint32_t index) const {
+    if (!mPresentationInDecodeOrder) {
+        return mSampleTimeEntries[index].mCompositionTime;
+    }
+
+    ssize_t run = findTimeToSampleRun(index);
+    if (run < 0) {
+        return 0;
+    }
+
+    const TimeToSampleRun &entry = mTimeToSampleRuns[run];
+    uint64_t delta = mTimeToSample[2 * run + 1];
+    return (uint32_t)(entry.mStartTime + delta * (index - entry.mFirstSample))
+            + mUniformCompositionOffset;
+}
+
 void SampleTable::buildSampleEntriesTable() {
     Mutex::Autolock autoLock(mLock);
 
-    if (mSampleTimeEntries != NULL || mNumSampleSizes == 0) {
+    if (mSampleTimeIndexBuilt || mNumSampleSizes == 0) {
+        return;
+    }
+
+    // Without reordering, presentation order is decode order and the stts
+    // run index is enough to binary search by time.  This avoids allocating
+    // and sorting an entry per sample, which is expensive for long files.
+    uint64_t numSamples = mTimeToSampleCount > 0 && mTimeToSampleRuns != NULL
+            ? mTimeToSampleRuns[mTimeToSampleCount - 1].mFirstSample
+                    + mTimeToSample[2 * (mTimeToSampleCount - 1)]
+            : 0;
+
+    bool uniformOffset = true;
+    bool haveOffset = false;
+    uint32_t offset = 0;
+    uint64_t numOffsetSamples = 0;
+    for (size_t i = 0; i < mNumCompositionTimeDeltaEntries; ++i) {
+        if (mCompositionTimeDeltaEntries[2 * i] == 0) {
+            continue;
+        }
+        if (haveOffset && mCompositionTimeDeltaEntries[2 * i + 1] != offset) {
+            uniformOffset = false;
+            break;
+        }
+        haveOffset = true;
+        offset = mCompositionTimeDeltaEntries[2 * i + 1];
+        numOffsetSamples += mCompositionTimeDeltaEntries[2 * i];
+    }
+    if (offset != 0 && numOffsetSamples < numSamples) {
+        // samples past the end of the ctts table have no offset
+        uniformOffset = false;
+    }
+
+    if (uniformOffset && mTimeToSampleRuns != NULL
+            && mTimeToSampleTotalTime + offset <= UINT32_MAX) {
+        mPresentationInDecodeOrder = true;
+        mUniformCompositionOffset = offset;
+        mNumPresentationSamples =
+                numSamples < mNumSampleSizes ? (uint32_t)numSamples : mNumSampleSizes;
+        mSampleTimeIndexBuilt = true;
         return;
     }
 
@@ -553,6 +652,9 @@ void SampleTable::buildSampleEntriesTable() {
 
     qsort(mSampleTimeEntries, mNumSampleSizes, sizeof(SampleTimeEntry),
           CompareIncreasingTime);
+
+    mNumPresentationSamples = mNumSampleSizes;
+    mSampleTimeIndexBuilt = true;
 }
 
 status_t SampleTable::findSampleAtTime(
@@ -560,12 +662,12 @@ status_t SampleTable::findSampleAtTime(
         uint32_t *sample_index, uint32_t flags) {
     buildSampleEntriesTable();
 
-    if (mSampleTimeEntries == NULL) {
+    if (!mSampleTimeIndexBuilt || mNumPresentationSamples == 0) {
         return ERROR_OUT_OF_RANGE;
     }
 
     uint32_t left = 0;
-    uint32_t right_plus_one = mNumSampleSizes;
+    uint32_t right_plus_one = mNumPresentationSamples;
     while (left < right_plus_one) {
         uint32_t center = left + (right_plus_one - left) / 2;
         uint64_t centerTime =
@@ -576,14 +678,14 @@ status_t SampleTable::findSampleAtTime(
         } else if (req_time > centerTime) {
             left = center + 1;
         } else {
-            *sample_index = mSampleTimeEntries[center].mSampleIndex;
+            *sample_index = getPresentationSampleIndex(center);
             return OK;
         }
     }
 
     uint32_t closestIndex = left;
 
-    if (closestIndex == mNumSampleSizes) {
+    if (closestIndex == mNumPresentationSamples) {
         if (flags == kFlagAfter) {
             return ERROR_OUT_OF_RANGE;
         }
@@ -625,7 +727,7 @@ status_t SampleTable::findSampleAtTime(
         }
     }
 
-    *sample_index = mSampleTimeEntries[closestIndex].mSampleIndex;
+    *sample_index = getPresentationSampleIndex(closestIndex);
     return OK;
 }
 
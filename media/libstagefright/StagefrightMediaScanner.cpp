@@ -22,19 +22,172 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <dirent.h>
 #include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 #include <media/stagefright/StagefrightMediaScanner.h>
 
+#include <cutils/properties.h>
 #include <media/IMediaHTTPService.h>
 #include <media/mediametadataretriever.h>
+#include <media/stagefright/foundation/ABase.h>
 #include <private/media/VideoFrame.h>
+#include <utils/Thread.h>
 
 namespace android {
 
-StagefrightMediaScanner::StagefrightMediaScanner() {}
+// upper bound for media.stagefright.scanner-threads
+static const size_t kMaxNumWorkers = 8;
+// files retrieved ahead of the client, per worker
+static const size_t kLookaheadPerWorker = 2;
 
-StagefrightMediaScanner::~StagefrightMediaScanner() {}
+struct KeyMap {
+    const char *tag;
+    int key;
+};
+static const KeyMap kKeyMap[] = {
+    { "tracknumber", METADATA_KEY_CD_TRACK_NUMBER },
+    { "discnumber", METADATA_KEY_DISC_NUMBER },
+    { "album", METADATA_KEY_ALBUM },
+    { "artist", METADATA_KEY_ARTIST },
+    { "albumartist", METADATA_KEY_ALBUMARTIST },
+    { "composer", METADATA_KEY_COMPOSER },
+    { "genre", METADATA_KEY_GENRE },
+    { "title", METADATA_KEY_TITLE },
+    { "year", METADATA_KEY_YEAR },
+    { "duration", METADATA_KEY_DURATION },
+    { "writer", METADATA_KEY_WRITER },
+    { "compilation", METADATA_KEY_COMPILATION },
+    { "isdrm", METADATA_KEY_IS_DRM },
+    { "width", METADATA_KEY_VIDEO_WIDTH },
+    { "height", METADATA_KEY_VIDEO_HEIGHT },
+};
+static const size_t kNumEntries = sizeof(kKeyMap) / sizeof(kKeyMap[0]);
+
+// What processFileInternal() reports to the client for one file.
+struct StagefrightMediaScanner::Metadata : public RefBase {
+    Metadata(const String8 &path)
+        : mPath(path),
+          mStarted(false),
+          mDone(false),
+          mStatus(OK),
+          mSize(-1),
+          mModified(0),
+          mHasMimeType(false) {
+    }
+
+    void retrieve();
+    bool isCurrent() const;
+
+    String8 mPath;
+    bool mStarted;
+    bool mDone;
+
+    status_t mStatus;
+    off64_t mSize;
+    time_t mModified;
+    bool mHasMimeType;
+    String8 mMimeType;
+    Vector<size_t> mTagKeys;    // indices into kKeyMap
+    Vector<String8> mTagValues;
+
+private:
+    DISALLOW_EVIL_CONSTRUCTORS(Metadata);
+};
+
+void StagefrightMediaScanner::Metadata::retrieve() {
+    struct stat st;
+    if (stat(mPath.string(), &st) == 0) {
+        mSize = st.st_size;
+        mModified = st.st_mtime;
+    }
+
+    sp<MediaMetadataRetriever> mRetriever(new MediaMetadataRetriever);
+
+    int fd = open(mPath.string(), O_RDONLY | O_LARGEFILE);
+    if (fd < 0) {
+        // couldn't open it locally, maybe the media server can?
+        mStatus = mRetriever->setDataSource(NULL /* httpService */, mPath.string());
+    } else {
+        mStatus = mRetriever->setDataSource(fd, 0, 0x7ffffffffffffffL);
+        close(fd);
+    }
+
+    if (mStatus) {
+        return;
+    }
+
+    const char *value;
+    if ((value = mRetriever->extractMetadata(
+                    METADATA_KEY_MIMETYPE)) != NULL) {
+        mHasMimeType = true;
+        mMimeType = value;
+    }
+
+    for (size_t i = 0; i < kNumEntries; ++i) {
+        if ((value = mRetriever->extractMetadata(kKeyMap[i].key)) != NULL) {
+            mTagKeys.push(i);
+            mTagValues.push(String8(value));
+        }
+    }
+}
+
+// Whether the file is still the one that was retrieved.
+bool StagefrightMediaScanner::Metadata::isCurrent() const {
+    struct stat st;
+    if (stat(mPath.string(), &st) != 0) {
+        return mSize < 0;
+    }
+    return st.st_size == mSize && st.st_mtime == mModified;
+}
+
+struct StagefrightMediaScanner::Worker : public Thread {
+    Worker(StagefrightMediaScanner *owner)
+        : Thread(false /* canCallJava */),
+          mOwner(owner) {
+    }
+
+private:
+    StagefrightMediaScanner *mOwner;
+
+    virtual bool threadLoop() {
+        return mOwner->runJob();
+    }
+
+    DISALLOW_EVIL_CONSTRUCTORS(Worker);
+};
+
+StagefrightMediaScanner::StagefrightMediaScanner()
+    : mNumWorkers(0),
+      mStopping(false),
+      mListedPos(0) {
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.stagefright.scanner-threads", value, NULL)) {
+        // a negative count means one thread per core
+        long numWorkers = strtol(value, NULL, 10);
+        if (numWorkers < 0) {
+            numWorkers = sysconf(_SC_NPROCESSORS_ONLN);
+        }
+        if (numWorkers > (long)kMaxNumWorkers) {
+            numWorkers = kMaxNumWorkers;
+        }
+        mNumWorkers = numWorkers > 0 ? numWorkers : 0;
+    }
+}
+
+StagefrightMediaScanner::~StagefrightMediaScanner() {
+    {
+        Mutex::Autolock autoLock(mLock);
+        mStopping = true;
+        mCondition.broadcast();
+    }
+
+    for (size_t i = 0; i < mWorkers.size(); ++i) {
+        mWorkers[i]->requestExitAndWait();
+    }
+}
 
 static bool FileHasAcceptableExtension(const char *extension) {
     static const char *kValidExtensions[] = {
@@ -85,65 +238,191 @@ MediaScanResult StagefrightMediaScanner::processFileInternal(
         return MEDIA_SCAN_RESULT_SKIPPED;
     }
 
-    sp<MediaMetadataRetriever> mRetriever(new MediaMetadataRetriever);
+    sp<Metadata> metadata = getMetadata(path);
+    if (metadata->mStatus) {
+        return MEDIA_SCAN_RESULT_ERROR;
+    }
 
-    int fd = open(path, O_RDONLY | O_LARGEFILE);
     status_t status;
-    if (fd < 0) {
-        // couldn't open it locally, maybe the media server can?
-        status = mRetriever->setDataSource(NULL /* httpService */, path);
-    } else {
-        status = mRetriever->setDataSource(fd, 0, 0x7ffffffffffffffL);
-        close(fd);
+    if (metadata->mHasMimeType) {
+        status = client.setMimeType(metadata->mMimeType.string());
+        if (status) {
+            return MEDIA_SCAN_RESULT_ERROR;
+        }
     }
 
-    if (status) {
-        return MEDIA_SCAN_RESULT_ERROR;
+    for (size_t i = 0; i < metadata->mTagKeys.size(); ++i) {
+        status = client.addStringTag(
+                kKeyMap[metadata->mTagKeys[i]].tag, metadata->mTagValues[i].string());
+        if (status != OK) {
+            return MEDIA_SCAN_RESULT_ERROR;
+        }
     }
 
-    const char *value;
-    if ((value = mRetriever->extractMetadata(
-                    METADATA_KEY_MIMETYPE)) != NULL) {
-        status = client.setMimeType(value);
-        if (status) {
-            return MEDIA_SCAN_RESULT_ERROR;
+    return MEDIA_SCAN_RESULT_OK;
+}
+
+sp<StagefrightMediaScanner::Metadata> StagefrightMediaScanner::getMetadata(
+        const char *path) {
+    sp<Metadata> metadata;
+
+    if (mNumWorkers > 0) {
+        Mutex::Autolock autoLock(mLock);
+
+        ssize_t index = mLookahead.indexOfKey(String8(path));
+        if (index >= 0) {
+            metadata = mLookahead.valueAt(index);
+            mLookahead.removeItemsAt(index);
+            if (!metadata->mStarted) {
+                // not picked up yet, faster to do it right here
+                for (List<sp<Metadata> >::iterator it = mQueue.begin();
+                        it != mQueue.end(); ++it) {
+                    if (*it == metadata) {
+                        mQueue.erase(it);
+                        break;
+                    }
+                }
+                metadata.clear();
+            }
+        }
+
+        scheduleLookahead_l(path);
+
+        while (metadata != NULL && !metadata->mDone) {
+            mCondition.wait(mLock);
         }
     }
 
-    struct KeyMap {
-        const char *tag;
-        int key;
-    };
-    static const KeyMap kKeyMap[] = {
-        { "tracknumber", METADATA_KEY_CD_TRACK_NUMBER },
-        { "discnumber", METADATA_KEY_DISC_NUMBER },
-        { "album", METADATA_KEY_ALBUM },
-        { "artist", METADATA_KEY_ARTIST },
-        { "albumartist", METADATA_KEY_ALBUMARTIST },
-        { "composer", METADATA_KEY_COMPOSER },
-        { "genre", METADATA_KEY_GENRE },
-        { "title", METADATA_KEY_TITLE },
-        { "year", METADATA_KEY_YEAR },
-        { "duration", METADATA_KEY_DURATION },
-        { "writer", METADATA_KEY_WRITER },
-        { "compilation", METADATA_KEY_COMPILATION },
-        { "isdrm", METADATA_KEY_IS_DRM },
-        { "width", METADATA_KEY_VIDEO_WIDTH },
-        { "height", METADATA_KEY_VIDEO_HEIGHT },
-    };
-    static const size_t kNumEntries = sizeof(kKeyMap) / sizeof(kKeyMap[0]);
+    if (metadata == NULL || !metadata->isCurrent()) {
+        metadata = new Metadata(String8(path));
+        metadata->retrieve();
+    }
 
-    for (size_t i = 0; i < kNumEntries; ++i) {
-        const char *value;
-        if ((value = mRetriever->extractMetadata(kKeyMap[i].key)) != NULL) {
-            status = client.addStringTag(kKeyMap[i].tag, value);
-            if (status != OK) {
-                return MEDIA_SCAN_RESULT_ERROR;
+    return metadata;
+}
+
+// Makes the files that follow |path| in its directory the lookahead set.
+void StagefrightMediaScanner::scheduleLookahead_l(const char *path) {
+    String8 file(path);
+    String8 dir = file.getPathDir();
+    String8 name = file.getPathLeaf();
+
+    if (dir != mListedDir) {
+        listDirectory_l(dir);
+    }
+
+    // The scanner walks the directory in readdir() order too, so the
+    // search normally succeeds right at mListedPos.
+    ssize_t found = -1;
+    for (size_t i = 0; i < mListedFiles.size(); ++i) {
+        size_t pos = (mListedPos + i) % mListedFiles.size();
+        if (mListedFiles[pos] == name) {
+            found = pos;
+            break;
+        }
+    }
+
+    Vector<String8> wanted;
+    if (found >= 0) {
+        mListedPos = found + 1;
+        for (size_t pos = mListedPos; pos < mListedFiles.size()
+                && wanted.size() < mNumWorkers * kLookaheadPerWorker; ++pos) {
+            wanted.push(dir.appendPathCopy(mListedFiles[pos]));
+        }
+    }
+
+    // drop what the client has skipped over
+    for (size_t i = mLookahead.size(); i-- > 0;) {
+        bool keep = false;
+        for (size_t j = 0; j < wanted.size(); ++j) {
+            if (mLookahead.keyAt(i) == wanted[j]) {
+                keep = true;
+                break;
+            }
+        }
+        if (keep) {
+            continue;
+        }
+
+        const sp<Metadata> &metadata = mLookahead.valueAt(i);
+        if (!metadata->mStarted) {
+            for (List<sp<Metadata> >::iterator it = mQueue.begin();
+                    it != mQueue.end(); ++it) {
+                if (*it == metadata) {
+                    mQueue.erase(it);
+                    break;
+                }
             }
         }
+        mLookahead.removeItemsAt(i);
     }
 
-    return MEDIA_SCAN_RESULT_OK;
+    for (size_t j = 0; j < wanted.size(); ++j) {
+        if (mLookahead.indexOfKey(wanted[j]) < 0) {
+            sp<Metadata> metadata = new Metadata(wanted[j]);
+            mLookahead.add(wanted[j], metadata);
+            mQueue.push_back(metadata);
+        }
+    }
+
+    if (mWorkers.isEmpty() && !mQueue.empty()) {
+        for (size_t i = 0; i < mNumWorkers; ++i) {
+            sp<Worker> worker = new Worker(this);
+            worker->run("MediaScannerWorker");
+            mWorkers.push(worker);
+        }
+    }
+    mCondition.broadcast();
+}
+
+void StagefrightMediaScanner::listDirectory_l(const String8 &dir) {
+    mListedDir = dir;
+    mListedFiles.clear();
+    mListedPos = 0;
+
+    DIR *d = opendir(dir.string());
+    if (d == NULL) {
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        if (entry->d_type != DT_REG && entry->d_type != DT_UNKNOWN) {
+            continue;
+        }
+
+        const char *extension = strrchr(entry->d_name, '.');
+        if (extension != NULL && FileHasAcceptableExtension(extension)) {
+            mListedFiles.push(String8(entry->d_name));
+        }
+    }
+    closedir(d);
+}
+
+bool StagefrightMediaScanner::runJob() {
+    sp<Metadata> metadata;
+    {
+        Mutex::Autolock autoLock(mLock);
+        while (!mStopping && mQueue.empty()) {
+            mCondition.wait(mLock);
+        }
+
+        if (mStopping) {
+            return false;
+        }
+
+        metadata = *mQueue.begin();
+        mQueue.erase(mQueue.begin());
+        metadata->mStarted = true;
+    }
+
+    metadata->retrieve();
+
+    Mutex::Autolock autoLock(mLock);
+    metadata->mDone = true;
+    mCondition.broadcast();
+
+    return true;
 }
 
 MediaAlbumArt *StagefrightMediaScanner::extractAlbumArt(int fd) {
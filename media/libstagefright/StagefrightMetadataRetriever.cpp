@@ -19,6 +19,7 @@
 #define LOG_TAG "StagefrightMetadataRetriever"
 
 #include <inttypes.h>
+#include <unistd.h>
 
 #include <utils/Log.h>
 #include <gui/Surface.h>
@@ -27,10 +28,14 @@
 
 #include <media/ICrypto.h>
 #include <media/IMediaHTTPService.h>
+#include <media/mediametadataretriever.h>
 
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/AUtils.h>
 #include <media/stagefright/ColorConverter.h>
 #include <media/stagefright/DataSource.h>
 #include <media/stagefright/FileSource.h>
@@ -50,6 +55,133 @@ namespace android {
 static const int64_t kBufferTimeOutUs = 30000ll; // 30 msec
 static const size_t kRetryCount = 20; // must be >0
 
+// Thumbnails are downscaled as long as their short side stays at least this large, the
+// short side of the MediaStore mini thumbnails.
+static const int32_t kThumbnailMinSize = 384;
+static const size_t kThumbnailMaxShift = 4;
+
+// Keeps the decoder of the last frame extraction, stopped, for a few seconds. Extracting
+// the frames of a series of files, as for a gallery of thumbnails, then configures the
+// same component again instead of allocating a new one for each file.
+struct WarmDecoderCache : public AHandler {
+    static sp<WarmDecoderCache> Get();
+
+    // Returns the cached decoder if it is |componentName|, or a new one.
+    sp<MediaCodec> acquire(const char *componentName, status_t *err);
+
+    // Takes |decoder|, stopped by the caller, and releases the decoder cached before.
+    void recycle(const char *componentName, const sp<MediaCodec> &decoder);
+
+protected:
+    virtual ~WarmDecoderCache() {}
+
+    virtual void onMessageReceived(const sp<AMessage> &msg);
+
+private:
+    enum {
+        kWhatExpire = 'expi',
+    };
+
+    static const int64_t kKeepAliveUs = 3000000ll;
+
+    static Mutex sLock;
+    static sp<WarmDecoderCache> sCache;
+
+    Mutex mLock;
+    sp<ALooper> mLooper;        // for the expiry, not for the decoders
+    sp<ALooper> mCodecLooper;
+    AString mComponentName;
+    sp<MediaCodec> mDecoder;
+    int32_t mGeneration;
+
+    WarmDecoderCache();
+};
+
+Mutex WarmDecoderCache::sLock;
+sp<WarmDecoderCache> WarmDecoderCache::sCache;
+
+// static
+sp<WarmDecoderCache> WarmDecoderCache::Get() {
+    Mutex::Autolock autoLock(sLock);
+    if (sCache == NULL) {
+        sCache = new WarmDecoderCache;
+        sCache->mLooper->registerHandler(sCache);
+    }
+    return sCache;
+}
+
+WarmDecoderCache::WarmDecoderCache()
+    : mLooper(new ALooper),
+      mCodecLooper(new ALooper),
+      mGeneration(0) {
+    mLooper->setName("WarmDecoderCache");
+    mLooper->start();
+    mCodecLooper->setName("ThumbnailDecoder");
+    mCodecLooper->start();
+}
+
+sp<MediaCodec> WarmDecoderCache::acquire(const char *componentName, status_t *err) {
+    {
+        Mutex::Autolock autoLock(mLock);
+        if (mDecoder != NULL && mComponentName == componentName) {
+            sp<MediaCodec> decoder = mDecoder;
+            mDecoder.clear();
+            ++mGeneration;
+            *err = OK;
+            return decoder;
+        }
+    }
+
+    return MediaCodec::CreateByComponentName(mCodecLooper, componentName, err);
+}
+
+void WarmDecoderCache::recycle(const char *componentName, const sp<MediaCodec> &decoder) {
+    sp<MediaCodec> previous;
+    {
+        Mutex::Autolock autoLock(mLock);
+        previous = mDecoder;
+        mDecoder = decoder;
+        mComponentName = componentName;
+
+        sp<AMessage> msg = new AMessage(kWhatExpire, this);
+        msg->setInt32("generation", ++mGeneration);
+        msg->post(kKeepAliveUs);
+    }
+
+    if (previous != NULL) {
+        previous->release();
+    }
+}
+
+void WarmDecoderCache::onMessageReceived(const sp<AMessage> &msg) {
+    switch (msg->what()) {
+        case kWhatExpire:
+        {
+            int32_t generation;
+            CHECK(msg->findInt32("generation", &generation));
+
+            sp<MediaCodec> decoder;
+            {
+                Mutex::Autolock autoLock(mLock);
+                if (generation != mGeneration) {
+                    break;
+                }
+                decoder = mDecoder;
+                mDecoder.clear();
+            }
+
+            if (decoder != NULL) {
+                ALOGV("releasing the idle %s", mComponentName.c_str());
+                decoder->release();
+            }
+            break;
+        }
+
+        default:
+            TRESPASS();
+    }
+}
+
 StagefrightMetadataRetriever::StagefrightMetadataRetriever()
     : mParsedMetaData(false),
       mAlbumArt(NULL) {
@@ -137,12 +269,103 @@ status_t StagefrightMetadataRetriever::setDataSource(
     return OK;
 }
 
+// Converts the decoder output |buffer| to a VideoFrame, NULL if that is not possible.
+static VideoFrame *convertVideoFrame(
+        const sp<MetaData> &trackMeta,
+        const sp<AMessage> &outputFormat,
+        const sp<ABuffer> &buffer,
+        bool thumbnail) {
+    int32_t width, height;
+    CHECK(outputFormat->findInt32("width", &width));
+    CHECK(outputFormat->findInt32("height", &height));
+
+    int32_t stride, slice_height;
+    if(outputFormat->findInt32("stride", &stride) && stride > 0)
+        width = stride;
+
+    if(outputFormat->findInt32("slice-height", &slice_height) && slice_height > 0)
+        height = slice_height;
+
+    int32_t crop_left, crop_top, crop_right, crop_bottom;
+    if (!outputFormat->findRect("crop", &crop_left, &crop_top, &crop_right, &crop_bottom)) {
+        crop_left = crop_top = 0;
+        crop_right = width - 1;
+        crop_bottom = height - 1;
+    }
+
+    int32_t rotationAngle;
+    if (!trackMeta->findInt32(kKeyRotation, &rotationAngle)) {
+        rotationAngle = 0;  // By default, no rotation
+    }
+
+    int32_t srcFormat;
+    CHECK(outputFormat->findInt32("color-format", &srcFormat));
+
+    ColorConverter converter((OMX_COLOR_FORMATTYPE)srcFormat, OMX_COLOR_Format16bitRGB565);
+
+    // none of the decoders scale their output, so downscale while converting
+    size_t shift = 0;
+    if (thumbnail && converter.supportsDownscaling()) {
+        int32_t minSize = min(crop_right - crop_left + 1, crop_bottom - crop_top + 1);
+        while (shift < kThumbnailMaxShift && (minSize >> (shift + 1)) >= kThumbnailMinSize) {
+            ++shift;
+        }
+    }
+
+    VideoFrame *frame = new VideoFrame;
+    frame->mWidth = (crop_right - crop_left + 1) >> shift;
+    frame->mHeight = (crop_bottom - crop_top + 1) >> shift;
+    frame->mDisplayWidth = frame->mWidth;
+    frame->mDisplayHeight = frame->mHeight;
+    frame->mSize = frame->mWidth * frame->mHeight * 2;
+    frame->mData = new uint8_t[frame->mSize];
+    frame->mRotationAngle = rotationAngle;
+
+    int32_t sarWidth, sarHeight;
+    if (trackMeta->findInt32(kKeySARWidth, &sarWidth)
+            && trackMeta->findInt32(kKeySARHeight, &sarHeight)
+            && sarHeight != 0) {
+        frame->mDisplayWidth = (frame->mDisplayWidth * sarWidth) / sarHeight;
+    }
+
+    // the decoder is idle now, so the conversion can use all the cores
+    long numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+    converter.setNumThreads(numCpus > 0 ? numCpus : 1);
+
+    status_t err;
+
+    if (converter.isValid()) {
+        err = converter.convert(
+                (const uint8_t *)buffer->data(),
+                width, height,
+                crop_left, crop_top, crop_right, crop_bottom,
+                frame->mData,
+                frame->mWidth,
+                frame->mHeight,
+                0, 0, frame->mWidth - 1, frame->mHeight - 1);
+    } else {
+        ALOGE("Unable to convert from format 0x%08x to RGB565", srcFormat);
+
+        err = ERROR_UNSUPPORTED;
+    }
+
+    if (err != OK) {
+        ALOGE("Colorconverter failed to convert frame.");
+
+        delete frame;
+        return NULL;
+    }
+
+    return frame;
+}
+
 static VideoFrame *extractVideoFrame(
         const char *componentName,
         const sp<MetaData> &trackMeta,
         const sp<MediaSource> &source,
         int64_t frameTimeUs,
-        int seekMode) {
+        int seekMode,
+        bool thumbnail) {
 
     int decodeTwice = 0;
     sp<MetaData> format = source->getFormat();
@@ -157,10 +380,7 @@ static VideoFrame *extractVideoFrame(
     videoFormat->setInt32("color-format", OMX_COLOR_FormatYUV420Planar);
 
     status_t err;
-    sp<ALooper> looper = new ALooper;
-    looper->start();
-    sp<MediaCodec> decoder = MediaCodec::CreateByComponentName(
-            looper, componentName, &err);
+    sp<MediaCodec> decoder = WarmDecoderCache::Get()->acquire(componentName, &err);
 
     if (decoder.get() == NULL || err != OK) {
         ALOGW("Failed to instantiate decoder [%s]", componentName);
@@ -208,6 +428,11 @@ static VideoFrame *extractVideoFrame(
 
     trackMeta->findInt32(kKeySpecialThumbnail, &decodeTwice);
 
+    // With the sync seek modes the frame is the sync sample at the seek position, e.g. the
+    // one SampleTable::findThumbnailSample() picked. Nothing after it needs decoding, so
+    // end the input right after it to get the frame out without feeding more samples.
+    bool syncSampleOnly = mode != MediaSource::ReadOptions::SEEK_CLOSEST && decodeTwice == 0;
+
     err = source->start();
     if (err != OK) {
         ALOGW("source failed to start: %d (%s)", err, asString(err));
@@ -307,6 +532,14 @@ static VideoFrame *extractVideoFrame(
             if (flags & MediaCodec::BUFFER_FLAG_CODECCONFIG) {
                 continue;
             }
+
+            if (err == OK && syncSampleOnly
+                    && decoder->dequeueInputBuffer(&inputIndex, kBufferTimeOutUs) == OK) {
+                ALOGV("QueueInput: EOS after the sync sample");
+                err = decoder->queueInputBuffer(
+                        inputIndex, 0, 0, ptsUs, MediaCodec::BUFFER_FLAG_EOS);
+                haveMoreInputs = false;
+            }
         }
 
         while (err == OK) {
@@ -367,86 +600,344 @@ static VideoFrame *extractVideoFrame(
         }
     }
 
-    int32_t width, height;
-    CHECK(outputFormat->findInt32("width", &width));
-    CHECK(outputFormat->findInt32("height", &height));
+    VideoFrame *frame = convertVideoFrame(trackMeta, outputFormat, videoFrameBuffer, thumbnail);
 
-    int32_t stride, slice_height;
-    if(outputFormat->findInt32("stride", &stride) && stride > 0)
-        width = stride;
+    videoFrameBuffer.clear();
+    source->stop();
+    decoder->releaseOutputBuffer(index);
+    if (decoder->stop() == OK) {
+        WarmDecoderCache::Get()->recycle(componentName, decoder);
+    } else {
+        decoder->release();
+    }
 
-    if(outputFormat->findInt32("slice-height", &slice_height) && slice_height > 0)
-        height = slice_height;
+    return frame;
+}
 
-    int32_t crop_left, crop_top, crop_right, crop_bottom;
-    if (!outputFormat->findRect("crop", &crop_left, &crop_top, &crop_right, &crop_bottom)) {
-        crop_left = crop_top = 0;
-        crop_right = width - 1;
-        crop_bottom = height - 1;
+// Decodes the frames of a batch through one session of the decoder.
+struct BatchFrameDecoder {
+    BatchFrameDecoder(
+            const sp<MetaData> &trackMeta, const sp<MediaSource> &source, bool thumbnail);
+
+    status_t start(const char *componentName);
+
+    // Recycles the decoder if |ok|, releases it otherwise.
+    void stop(bool ok);
+
+    // Moves the input to |timeUs|. With |syncSampleOnly|, the input ends after the first
+    // sample.
+    status_t seek(int64_t timeUs, MediaSource::ReadOptions::SeekMode mode, bool syncSampleOnly);
+
+    // Decodes forward up to the first frame at or after |minTimeUs|, or the last frame of
+    // the input.
+    status_t decodeFrame(int64_t minTimeUs, VideoFrame **frame, int64_t *frameTimeUs);
+
+    bool endOfInput() const { return mInputEOS; }
+
+private:
+    sp<MetaData> mTrackMeta;
+    sp<MediaSource> mSource;
+    bool mThumbnail;
+    const char *mComponentName;
+
+    sp<MediaCodec> mDecoder;
+    bool mSourceStarted;
+    Vector<sp<ABuffer> > mInputBuffers;
+    Vector<sp<ABuffer> > mOutputBuffers;
+    sp<AMessage> mOutputFormat;
+
+    MediaSource::ReadOptions mOptions;
+    bool mSyncSampleOnly;
+    size_t mSamplesQueued;      // since the last seek
+    bool mInputEOS;
+
+    status_t queueInput(size_t index);
+};
+
+BatchFrameDecoder::BatchFrameDecoder(
+        const sp<MetaData> &trackMeta, const sp<MediaSource> &source, bool thumbnail)
+    : mTrackMeta(trackMeta),
+      mSource(source),
+      mThumbnail(thumbnail),
+      mComponentName(NULL),
+      mSourceStarted(false),
+      mSyncSampleOnly(false),
+      mSamplesQueued(0),
+      mInputEOS(false) {
+}
+
+status_t BatchFrameDecoder::start(const char *componentName) {
+    mComponentName = componentName;
+
+    sp<AMessage> videoFormat;
+    if (convertMetaDataToMessage(mTrackMeta, &videoFormat) != OK) {
+        ALOGW("Failed to convert meta data to message");
+        return UNKNOWN_ERROR;
     }
 
-    int32_t rotationAngle;
-    if (!trackMeta->findInt32(kKeyRotation, &rotationAngle)) {
-        rotationAngle = 0;  // By default, no rotation
+    // TODO: Use Flexible color instead
+    videoFormat->setInt32("color-format", OMX_COLOR_FormatYUV420Planar);
+
+    status_t err;
+    mDecoder = WarmDecoderCache::Get()->acquire(componentName, &err);
+    if (mDecoder == NULL || err != OK) {
+        ALOGW("Failed to instantiate decoder [%s]", componentName);
+        mDecoder.clear();
+        return err != OK ? err : UNKNOWN_ERROR;
     }
 
-    VideoFrame *frame = new VideoFrame;
-    frame->mWidth = crop_right - crop_left + 1;
-    frame->mHeight = crop_bottom - crop_top + 1;
-    frame->mDisplayWidth = frame->mWidth;
-    frame->mDisplayHeight = frame->mHeight;
-    frame->mSize = frame->mWidth * frame->mHeight * 2;
-    frame->mData = new uint8_t[frame->mSize];
-    frame->mRotationAngle = rotationAngle;
+    err = mDecoder->configure(videoFormat, NULL /* surface */, NULL /* crypto */, 0 /* flags */);
+    if (err != OK) {
+        ALOGW("configure returned error %d (%s)", err, asString(err));
+        return err;
+    }
 
-    int32_t sarWidth, sarHeight;
-    if (trackMeta->findInt32(kKeySARWidth, &sarWidth)
-            && trackMeta->findInt32(kKeySARHeight, &sarHeight)
-            && sarHeight != 0) {
-        frame->mDisplayWidth = (frame->mDisplayWidth * sarWidth) / sarHeight;
+    err = mDecoder->start();
+    if (err != OK) {
+        ALOGW("start returned error %d (%s)", err, asString(err));
+        return err;
     }
 
-    int32_t srcFormat;
-    CHECK(outputFormat->findInt32("color-format", &srcFormat));
+    err = mSource->start();
+    if (err != OK) {
+        ALOGW("source failed to start: %d (%s)", err, asString(err));
+        return err;
+    }
+    mSourceStarted = true;
 
-    ColorConverter converter((OMX_COLOR_FORMATTYPE)srcFormat, OMX_COLOR_Format16bitRGB565);
+    err = mDecoder->getInputBuffers(&mInputBuffers);
+    if (err != OK) {
+        ALOGW("failed to get input buffers: %d (%s)", err, asString(err));
+        return err;
+    }
 
-    if (converter.isValid()) {
-        err = converter.convert(
-                (const uint8_t *)videoFrameBuffer->data(),
-                width, height,
-                crop_left, crop_top, crop_right, crop_bottom,
-                frame->mData,
-                frame->mWidth,
-                frame->mHeight,
-                0, 0, frame->mWidth - 1, frame->mHeight - 1);
+    err = mDecoder->getOutputBuffers(&mOutputBuffers);
+    if (err != OK) {
+        ALOGW("failed to get output buffers: %d (%s)", err, asString(err));
+    }
+    return err;
+}
+
+void BatchFrameDecoder::stop(bool ok) {
+    if (mSourceStarted) {
+        mSource->stop();
+        mSourceStarted = false;
+    }
+    if (mDecoder == NULL) {
+        return;
+    }
+
+    if (ok && mDecoder->stop() == OK) {
+        WarmDecoderCache::Get()->recycle(mComponentName, mDecoder);
     } else {
-        ALOGE("Unable to convert from format 0x%08x to RGB565", srcFormat);
+        mDecoder->stop();
+        mDecoder->release();
+    }
+    mDecoder.clear();
+}
 
-        err = ERROR_UNSUPPORTED;
+status_t BatchFrameDecoder::seek(
+        int64_t timeUs, MediaSource::ReadOptions::SeekMode mode, bool syncSampleOnly) {
+    if (mSamplesQueued > 0 || mInputEOS) {
+        status_t err = mDecoder->flush();
+        if (err != OK) {
+            ALOGW("flush returned error %d (%s)", err, asString(err));
+            return err;
+        }
     }
 
-    videoFrameBuffer.clear();
-    source->stop();
-    decoder->releaseOutputBuffer(index);
-    decoder->stop();
-    decoder->release();
+    mOptions.setSeekTo(timeUs, mode);
+    mSyncSampleOnly = syncSampleOnly;
+    mSamplesQueued = 0;
+    mInputEOS = false;
+    return OK;
+}
+
+status_t BatchFrameDecoder::queueInput(size_t index) {
+    MediaBuffer *mediaBuffer = NULL;
+    status_t err = ERROR_END_OF_STREAM;
+    if (!mSyncSampleOnly || mSamplesQueued == 0) {
+        err = mSource->read(&mediaBuffer, &mOptions);
+        mOptions.clearSeekTo();
+    }
 
     if (err != OK) {
-        ALOGE("Colorconverter failed to convert frame.");
+        ALOGV("QueueInput: EOS (%d)", err);
+        mInputEOS = true;
+        return mDecoder->queueInputBuffer(index, 0, 0, 0ll, MediaCodec::BUFFER_FLAG_EOS);
+    }
 
-        delete frame;
-        frame = NULL;
+    const sp<ABuffer> &codecBuffer = mInputBuffers[index];
+    if (mediaBuffer->range_length() > codecBuffer->capacity()) {
+        ALOGE("buffer size (%zu) too large for codec input size (%zu)",
+                mediaBuffer->range_length(), codecBuffer->capacity());
+        mediaBuffer->release();
+        return BAD_VALUE;
     }
 
-    return frame;
+    int64_t ptsUs;
+    CHECK(mediaBuffer->meta_data()->findInt64(kKeyTime, &ptsUs));
+    codecBuffer->setRange(0, mediaBuffer->range_length());
+    memcpy(codecBuffer->data(),
+            (const uint8_t *)mediaBuffer->data() + mediaBuffer->range_offset(),
+            mediaBuffer->range_length());
+    mediaBuffer->release();
+
+    ALOGV("QueueInput: size=%zu ts=%" PRId64 " us", codecBuffer->size(), ptsUs);
+    ++mSamplesQueued;
+    return mDecoder->queueInputBuffer(index, 0, codecBuffer->size(), ptsUs, 0);
 }
 
-VideoFrame *StagefrightMetadataRetriever::getFrameAtTime(
-        int64_t timeUs, int option) {
+status_t BatchFrameDecoder::decodeFrame(
+        int64_t minTimeUs, VideoFrame **frame, int64_t *frameTimeUs) {
+    *frame = NULL;
+    size_t retriesLeft = kRetryCount;
 
-    ALOGV("getFrameAtTime: %" PRId64 " us option: %d", timeUs, option);
+    for (;;) {
+        status_t err;
+
+        // keep the input full, the wait is on the output
+        size_t inputIndex;
+        while (!mInputEOS && mDecoder->dequeueInputBuffer(&inputIndex, 0ll) == OK) {
+            err = queueInput(inputIndex);
+            if (err != OK) {
+                return err;
+            }
+        }
 
+        size_t index, offset, size;
+        int64_t timeUs;
+        uint32_t flags;
+        err = mDecoder->dequeueOutputBuffer(
+                &index, &offset, &size, &timeUs, &flags, kBufferTimeOutUs);
+
+        if (err == INFO_FORMAT_CHANGED) {
+            ALOGV("Received format change");
+            err = mDecoder->getOutputFormat(&mOutputFormat);
+            if (err != OK) {
+                return err;
+            }
+            continue;
+        } else if (err == INFO_OUTPUT_BUFFERS_CHANGED) {
+            ALOGV("Output buffers changed");
+            err = mDecoder->getOutputBuffers(&mOutputBuffers);
+            if (err != OK) {
+                return err;
+            }
+            continue;
+        } else if (err == -EAGAIN /* INFO_TRY_AGAIN_LATER */) {
+            if (--retriesLeft == 0) {
+                ALOGW("Timed out waiting for output");
+                return TIMED_OUT;
+            }
+            continue;
+        } else if (err != OK) {
+            ALOGW("Received error %d (%s) instead of output", err, asString(err));
+            return err;
+        }
+        retriesLeft = kRetryCount;
+
+        bool eos = (flags & MediaCodec::BUFFER_FLAG_EOS) != 0;
+        if (size == 0 || mOutputFormat == NULL || (timeUs < minTimeUs && !eos)) {
+            mDecoder->releaseOutputBuffer(index);
+            if (eos) {
+                return ERROR_END_OF_STREAM;
+            }
+            continue;
+        }
+
+        ALOGV("Received an output buffer at %" PRId64 " us", timeUs);
+        *frame = convertVideoFrame(mTrackMeta, mOutputFormat, mOutputBuffers[index], mThumbnail);
+        *frameTimeUs = timeUs;
+        mDecoder->releaseOutputBuffer(index);
+        return *frame != NULL ? OK : ERROR_UNSUPPORTED;
+    }
+}
+
+// For the closest frames, seeking again only pays off when the next frame is further than
+// this from the last one; below, decoding forward through the frames in between is cheaper.
+static const int64_t kMaxDecodeAheadUs = 2000000ll;
+
+// Extracts the frames at the sorted |timesUs|, seeking to the first of them and decoding
+// forward: the sync frames are decoded alone, and the closest frames in the same stretch
+// come out of one pass. |indices| maps the times to the indices for |sink|. Returns the
+// number of frames passed to |sink|, or an error if there is none.
+static ssize_t extractVideoFrames(
+        const char *componentName,
+        const sp<MetaData> &trackMeta,
+        const sp<MediaSource> &source,
+        const Vector<int64_t> &timesUs,
+        const Vector<size_t> &indices,
+        int seekMode,
+        bool thumbnail,
+        MediaMetadataRetrieverBase::FrameSink *sink) {
+    if (seekMode < MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC ||
+        seekMode > MediaSource::ReadOptions::SEEK_CLOSEST) {
+        ALOGE("Unknown seek mode: %d", seekMode);
+        return BAD_VALUE;
+    }
+
+    MediaSource::ReadOptions::SeekMode mode =
+            static_cast<MediaSource::ReadOptions::SeekMode>(seekMode);
+    bool closest = mode == MediaSource::ReadOptions::SEEK_CLOSEST;
+
+    BatchFrameDecoder decoder(trackMeta, source, thumbnail);
+    status_t err = decoder.start(componentName);
+
+    ssize_t numFrames = 0;
+    bool decoded = false;
+    int64_t frameTimeUs = -1ll;
+    VideoFrame *lastFrame = NULL;   // kept while the next times map to it
+    for (size_t i = 0; err == OK && i < timesUs.size(); ++i) {
+        int64_t timeUs = timesUs[i];
+        VideoFrame *frame = NULL;
+
+        if (closest && lastFrame != NULL && timeUs <= frameTimeUs) {
+            frame = lastFrame;
+            lastFrame = NULL;
+        } else {
+            delete lastFrame;
+            lastFrame = NULL;
+
+            if (!closest || !decoded || decoder.endOfInput()
+                    || timeUs - frameTimeUs > kMaxDecodeAheadUs) {
+                err = decoder.seek(
+                        timeUs, closest ? MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC : mode,
+                        !closest /* syncSampleOnly */);
+            }
+            if (err == OK) {
+                err = decoder.decodeFrame(closest ? timeUs : -1ll, &frame, &frameTimeUs);
+                decoded = true;
+            }
+            if (err == ERROR_END_OF_STREAM && !closest) {
+                // no frame at this time, the others may still be there
+                err = OK;
+            }
+        }
+
+        if (frame == NULL) {
+            continue;
+        }
+        if (closest && i + 1 < timesUs.size() && timesUs[i + 1] <= frameTimeUs) {
+            lastFrame = new VideoFrame(*frame);
+        }
+        ++numFrames;
+        if (!sink->onFrame(indices[i], frame)) {
+            break;
+        }
+    }
+    delete lastFrame;
+
+    // running out of input only ends the batch early
+    if (err == ERROR_END_OF_STREAM) {
+        err = OK;
+    }
+    decoder.stop(err == OK);
+
+    return numFrames > 0 || err == OK ? numFrames : err;
+}
+
+sp<MediaSource> StagefrightMetadataRetriever::getVideoTrack(sp<MetaData> *trackMeta) {
     if (mExtractor.get() == NULL) {
         ALOGV("no extractor.");
         return NULL;
@@ -483,7 +974,7 @@ VideoFrame *StagefrightMetadataRetriever::getFrameAtTime(
         return NULL;
     }
 
-    sp<MetaData> trackMeta = mExtractor->getTrackMetaData(
+    *trackMeta = mExtractor->getTrackMetaData(
             i, MediaExtractor::kIncludeExtensiveMetaData);
 
     sp<MediaSource> source = mExtractor->getTrack(i);
@@ -501,21 +992,43 @@ VideoFrame *StagefrightMetadataRetriever::getFrameAtTime(
         mAlbumArt = MediaAlbumArt::fromData(dataSize, data);
     }
 
+    return source;
+}
+
+static void findVideoDecoders(
+        const sp<MetaData> &trackMeta, Vector<OMXCodec::CodecNameAndQuirks> *matchingCodecs) {
     const char *mime;
     CHECK(trackMeta->findCString(kKeyMIMEType, &mime));
 
-    Vector<OMXCodec::CodecNameAndQuirks> matchingCodecs;
     OMXCodec::findMatchingCodecs(
             mime,
             false, /* encoder */
             NULL, /* matchComponentName */
             0,//do not use kPreferSoftwareCodecs
-            &matchingCodecs);
+            matchingCodecs);
+}
+
+VideoFrame *StagefrightMetadataRetriever::getFrameAtTime(
+        int64_t timeUs, int option) {
+
+    ALOGV("getFrameAtTime: %" PRId64 " us option: %d", timeUs, option);
+
+    sp<MetaData> trackMeta;
+    sp<MediaSource> source = getVideoTrack(&trackMeta);
+    if (source == NULL) {
+        return NULL;
+    }
+
+    Vector<OMXCodec::CodecNameAndQuirks> matchingCodecs;
+    findVideoDecoders(trackMeta, &matchingCodecs);
+
+    bool thumbnail = (option & GET_FRAME_OPTION_THUMBNAIL) != 0;
+    option &= ~GET_FRAME_OPTION_THUMBNAIL;
 
     for (size_t i = 0; i < matchingCodecs.size(); ++i) {
         const char *componentName = matchingCodecs[i].mName.string();
         VideoFrame *frame =
-            extractVideoFrame(componentName, trackMeta, source, timeUs, option);
+            extractVideoFrame(componentName, trackMeta, source, timeUs, option, thumbnail);
 
         if (frame != NULL) {
             return frame;
@@ -526,6 +1039,70 @@ VideoFrame *StagefrightMetadataRetriever::getFrameAtTime(
     return NULL;
 }
 
+struct FrameTime {
+    int64_t mTimeUs;
+    size_t mIndex;
+};
+
+static int compareFrameTimes(const FrameTime *a, const FrameTime *b) {
+    if (a->mTimeUs != b->mTimeUs) {
+        return a->mTimeUs < b->mTimeUs ? -1 : 1;
+    }
+    return a->mIndex < b->mIndex ? -1 : (a->mIndex > b->mIndex ? 1 : 0);
+}
+
+status_t StagefrightMetadataRetriever::getFramesAtTimes(
+        const Vector<int64_t> &timesUs, int option, FrameSink *sink) {
+
+    ALOGV("getFramesAtTimes: %zu times option: %d", timesUs.size(), option);
+
+    sp<MetaData> trackMeta;
+    sp<MediaSource> source = getVideoTrack(&trackMeta);
+    if (source == NULL) {
+        return UNKNOWN_ERROR;
+    }
+
+    // decode in presentation order, one pass for the whole batch
+    Vector<FrameTime> frameTimes;
+    frameTimes.setCapacity(timesUs.size());
+    for (size_t i = 0; i < timesUs.size(); ++i) {
+        FrameTime frameTime;
+        frameTime.mTimeUs = timesUs[i] < 0 ? 0 : timesUs[i];
+        frameTime.mIndex = i;
+        frameTimes.push_back(frameTime);
+    }
+    frameTimes.sort(compareFrameTimes);
+
+    Vector<int64_t> sortedTimesUs;
+    Vector<size_t> indices;
+    sortedTimesUs.setCapacity(frameTimes.size());
+    indices.setCapacity(frameTimes.size());
+    for (size_t i = 0; i < frameTimes.size(); ++i) {
+        sortedTimesUs.push_back(frameTimes[i].mTimeUs);
+        indices.push_back(frameTimes[i].mIndex);
+    }
+
+    Vector<OMXCodec::CodecNameAndQuirks> matchingCodecs;
+    findVideoDecoders(trackMeta, &matchingCodecs);
+
+    bool thumbnail = (option & GET_FRAME_OPTION_THUMBNAIL) != 0;
+    option &= ~GET_FRAME_OPTION_THUMBNAIL;
+
+    for (size_t i = 0; i < matchingCodecs.size(); ++i) {
+        const char *componentName = matchingCodecs[i].mName.string();
+        ssize_t numFrames = extractVideoFrames(
+                componentName, trackMeta, source, sortedTimesUs, indices, option, thumbnail,
+                sink);
+
+        if (numFrames >= 0) {
+            return OK;
+        }
+        ALOGV("%s failed to extract frames, trying next decoder.", componentName);
+    }
+
+    return UNKNOWN_ERROR;
+}
+
 MediaAlbumArt *StagefrightMetadataRetriever::extractAlbumArt() {
     ALOGV("extractAlbumArt (extractor: %s)", mExtractor.get() != NULL ? "YES" : "NO");
 
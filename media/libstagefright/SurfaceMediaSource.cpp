@@ -53,6 +53,11 @@ SurfaceMediaSource::SurfaceMediaSource(uint32_t bufferWidth, uint32_t bufferHeig
     mUseAbsoluteTimestamps(false) {
     ALOGV("SurfaceMediaSource");
 
+    for (int i = 0; i < BufferQueue::NUM_BUFFER_SLOTS; i++) {
+        mSlots[i].mFrameNumber = 0;
+        mSlots[i].mMediaBuffer = NULL;
+    }
+
     if (bufferWidth == 0 || bufferHeight == 0) {
         ALOGE("Invalid dimensions %dx%d", bufferWidth, bufferHeight);
     }
@@ -81,6 +86,14 @@ SurfaceMediaSource::SurfaceMediaSource(uint32_t bufferWidth, uint32_t bufferHeig
 SurfaceMediaSource::~SurfaceMediaSource() {
     ALOGV("~SurfaceMediaSource");
     CHECK(!mStarted);
+
+    for (int i = 0; i < BufferQueue::NUM_BUFFER_SLOTS; i++) {
+        if (mSlots[i].mMediaBuffer != NULL) {
+            mSlots[i].mMediaBuffer->setObserver(0);
+            mSlots[i].mMediaBuffer->release();
+            mSlots[i].mMediaBuffer = NULL;
+        }
+    }
 }
 
 nsecs_t SurfaceMediaSource::getTimestamp() {
@@ -259,21 +272,25 @@ sp<MetaData> SurfaceMediaSource::getFormat()
 // --------------------------------------------------------------
 // |  kMetadataBufferTypeGrallocSource | sizeof(buffer_handle_t) |
 // --------------------------------------------------------------
+// The slot index is stored right after the metadata, outside of the range
+// seen by the encoder, so that signalBufferReturned can find the slot
+// without searching.
 // Note: Call only when you have the lock
-static void passMetadataBuffer(MediaBuffer **buffer,
-        buffer_handle_t bufferHandle) {
-    *buffer = new MediaBuffer(4 + sizeof(buffer_handle_t));
-    char *data = (char *)(*buffer)->data();
-    if (data == NULL) {
-        ALOGE("Cannot allocate memory for metadata buffer!");
-        return;
-    }
+static const size_t kMetadataSize = 4 + sizeof(buffer_handle_t);
+
+static void passMetadataBuffer(MediaBuffer *buffer,
+        buffer_handle_t bufferHandle, int slot) {
+    buffer->reset();
+    buffer->set_range(0, kMetadataSize);
+
+    char *data = (char *)buffer->data();
     OMX_U32 type = kMetadataBufferTypeGrallocSource;
     memcpy(data, &type, 4);
     memcpy(data + 4, &bufferHandle, sizeof(buffer_handle_t));
+    memcpy(data + kMetadataSize, &slot, sizeof(slot));
 
     ALOGV("handle = %p, , offset = %zu, length = %zu",
-            bufferHandle, (*buffer)->range_length(), (*buffer)->range_offset());
+            bufferHandle, buffer->range_length(), buffer->range_offset());
 }
 
 status_t SurfaceMediaSource::read(
@@ -354,16 +371,20 @@ status_t SurfaceMediaSource::read(
     }
     mSlots[item.mBuf].mFrameNumber = item.mFrameNumber;
 
-    mCurrentBuffers.push_back(mSlots[mCurrentSlot].mGraphicBuffer);
+    mSlots[mCurrentSlot].mAcquiredBuffer = mSlots[mCurrentSlot].mGraphicBuffer;
     int64_t prevTimeStamp = mCurrentTimestamp;
     mCurrentTimestamp = item.mTimestamp;
 
     mNumFramesEncoded++;
     // Pass the data to the MediaBuffer. Pass in only the metadata
 
-    passMetadataBuffer(buffer, mSlots[mCurrentSlot].mGraphicBuffer->handle);
+    if (mSlots[mCurrentSlot].mMediaBuffer == NULL) {
+        mSlots[mCurrentSlot].mMediaBuffer = new MediaBuffer(kMetadataSize + sizeof(int));
+        mSlots[mCurrentSlot].mMediaBuffer->setObserver(this);
+    }
+    *buffer = mSlots[mCurrentSlot].mMediaBuffer;
+    passMetadataBuffer(*buffer, mSlots[mCurrentSlot].mGraphicBuffer->handle, mCurrentSlot);
 
-    (*buffer)->setObserver(this);
     (*buffer)->add_ref();
     (*buffer)->meta_data()->setInt64(kKeyTime, mCurrentTimestamp / 1000);
     ALOGV("Frames encoded = %d, timestamp = %" PRId64 ", time diff = %" PRId64,
@@ -381,59 +402,34 @@ status_t SurfaceMediaSource::read(
     return OK;
 }
 
-static buffer_handle_t getMediaBufferHandle(MediaBuffer *buffer) {
+static int getMediaBufferSlot(MediaBuffer *buffer) {
     // need to convert to char* for pointer arithmetic and then
-    // copy the byte stream into our handle
-    buffer_handle_t bufferHandle;
-    memcpy(&bufferHandle, (char*)(buffer->data()) + 4, sizeof(buffer_handle_t));
-    return bufferHandle;
+    // copy the byte stream into our slot index
+    int slot;
+    memcpy(&slot, (char*)(buffer->data()) + kMetadataSize, sizeof(slot));
+    return slot;
 }
 
 void SurfaceMediaSource::signalBufferReturned(MediaBuffer *buffer) {
     ALOGV("signalBufferReturned");
 
-    bool foundBuffer = false;
-
     Mutex::Autolock lock(mMutex);
 
-    buffer_handle_t bufferHandle = getMediaBufferHandle(buffer);
-
-    for (size_t i = 0; i < mCurrentBuffers.size(); i++) {
-        if (mCurrentBuffers[i]->handle == bufferHandle) {
-            mCurrentBuffers.removeAt(i);
-            foundBuffer = true;
-            break;
-        }
-    }
-
-    if (!foundBuffer) {
-        ALOGW("returned buffer was not found in the current buffer list");
+    int id = getMediaBufferSlot(buffer);
+    if (id < 0 || id >= BufferQueue::NUM_BUFFER_SLOTS
+            || mSlots[id].mMediaBuffer != buffer) {
+        CHECK(!"signalBufferReturned: bogus buffer");
     }
 
-    for (int id = 0; id < BufferQueue::NUM_BUFFER_SLOTS; id++) {
-        if (mSlots[id].mGraphicBuffer == NULL) {
-            continue;
-        }
-
-        if (bufferHandle == mSlots[id].mGraphicBuffer->handle) {
-            ALOGV("Slot %d returned, matches handle = %p", id,
-                    mSlots[id].mGraphicBuffer->handle);
-
-            mConsumer->releaseBuffer(id, mSlots[id].mFrameNumber,
-                                        EGL_NO_DISPLAY, EGL_NO_SYNC_KHR,
-                    Fence::NO_FENCE);
+    ALOGV("Slot %d returned, handle = %p", id,
+            mSlots[id].mAcquiredBuffer != NULL ? mSlots[id].mAcquiredBuffer->handle : NULL);
 
-            buffer->setObserver(0);
-            buffer->release();
+    mConsumer->releaseBuffer(id, mSlots[id].mFrameNumber,
+                                EGL_NO_DISPLAY, EGL_NO_SYNC_KHR,
+            Fence::NO_FENCE);
 
-            foundBuffer = true;
-            break;
-        }
-    }
-
-    if (!foundBuffer) {
-        CHECK(!"signalBufferReturned: bogus buffer");
-    }
+    // Keep the wrapper and its observer for the next frame in this slot.
+    mSlots[id].mAcquiredBuffer.clear();
 
 #if DEBUG_PENDING_BUFFERS
     for (size_t i = 0; i < mPendingBuffers.size(); ++i) {
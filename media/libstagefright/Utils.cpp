@@ -35,6 +35,7 @@
 #include <hardware/audio.h>
 #include <media/stagefright/Utils.h>
 #include <media/AudioParameter.h>
+#include <utils/Mutex.h>
 
 namespace android {
 
@@ -88,7 +89,7 @@ static status_t copyNALUToABuffer(sp<ABuffer> *buffer, const uint8_t *ptr, size_
     return OK;
 }
 
-status_t convertMetaDataToMessage(
+static status_t buildMessageFromMetaData(
         const sp<MetaData> &meta, sp<AMessage> *format) {
     format->clear();
 
@@ -194,6 +195,11 @@ status_t convertMetaDataToMessage(
             msg->setInt32("bit-per-sample", bitPerSample);
         }
 
+        int32_t pcmEncoding;
+        if (meta->findInt32(kKeyPcmEncoding, &pcmEncoding)) {
+            msg->setInt32("pcm-encoding", pcmEncoding);
+        }
+
         int32_t audioBlockAlign = -1;
         if (meta->findInt32(kKeyAudioBlockAlign, &audioBlockAlign)) {
             msg->setInt32("audio-block-align", audioBlockAlign);
@@ -497,6 +503,86 @@ status_t convertMetaDataToMessage(
     return OK;
 }
 
+namespace {
+
+// Track formats are converted over and over (getTrackFormat, getFormat, codec
+// setup...), so the most recent conversions are kept, keyed on the MetaData
+// object and its generation. Entries only compare the MetaData pointer and never
+// dereference it; as generations are unique, a new object reusing the address
+// of a destroyed one cannot match a stale entry.
+struct FormatCache {
+    FormatCache() : mNext(0) {
+        for (size_t i = 0; i < kNumEntries; ++i) {
+            mEntries[i].mMeta = NULL;
+            mEntries[i].mGeneration = 0;
+        }
+    }
+
+    bool find(const MetaData *meta, uint32_t generation, sp<AMessage> *format) {
+        Mutex::Autolock autoLock(mLock);
+        for (size_t i = 0; i < kNumEntries; ++i) {
+            const Entry &entry = mEntries[i];
+            if (entry.mMeta == meta && entry.mGeneration == generation) {
+                *format = entry.mFormat;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void add(const MetaData *meta, uint32_t generation, const sp<AMessage> &format) {
+        Mutex::Autolock autoLock(mLock);
+        Entry &entry = mEntries[mNext];
+        entry.mMeta = meta;
+        entry.mGeneration = generation;
+        entry.mFormat = format;
+        mNext = (mNext + 1) % kNumEntries;
+    }
+
+private:
+    enum {
+        kNumEntries = 16,
+    };
+
+    struct Entry {
+        const MetaData *mMeta;
+        uint32_t mGeneration;
+        sp<AMessage> mFormat;
+    };
+
+    Mutex mLock;
+    Entry mEntries[kNumEntries];
+    size_t mNext;
+};
+
+FormatCache gFormatCache;
+
+}  // namespace
+
+status_t convertMetaDataToMessage(
+        const sp<MetaData> &meta, sp<AMessage> *format) {
+    const uint32_t generation = meta->generation();
+
+    // Callers get their own copy of the message, but the codec specific data
+    // buffers in it are shared with the cache and must not be modified.
+    sp<AMessage> cached;
+    if (gFormatCache.find(meta.get(), generation, &cached)) {
+        *format = cached->dup();
+        return OK;
+    }
+
+    status_t err = buildMessageFromMetaData(meta, &cached);
+    if (err != OK) {
+        format->clear();
+        return err;
+    }
+
+    gFormatCache.add(meta.get(), generation, cached);
+    *format = cached->dup();
+
+    return OK;
+}
+
 static size_t reassembleAVCC(const sp<ABuffer> &csd0, const sp<ABuffer> csd1, char *avcc) {
 
     avcc[0] = 1;        // version
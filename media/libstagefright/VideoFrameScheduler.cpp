@@ -27,6 +27,8 @@
 #include <ui/DisplayStatInfo.h>
 
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/AString.h>
 #include <media/stagefright/foundation/AUtils.h>
 #include <media/stagefright/VideoFrameScheduler.h>
 
@@ -332,7 +334,10 @@ VideoFrameScheduler::VideoFrameScheduler()
       mVsyncPeriod(0),
       mVsyncRefreshAt(0),
       mLastVsyncTime(-1),
-      mTimeCorrection(0) {
+      mTimeCorrection(0),
+      mNumFramesDropped(0) {
+    memset(mReleaseHistogram, 0, sizeof(mReleaseHistogram));
+    memset(mCadenceHistogram, 0, sizeof(mCadenceHistogram));
 }
 
 void VideoFrameScheduler::updateVsync() {
@@ -470,6 +475,7 @@ nsecs_t VideoFrameScheduler::schedule(nsecs_t renderTime) {
                 ++vsyncsForLastFrame;
             }
             ATRACE_INT("FRAME_VSYNCS", vsyncsForLastFrame);
+            ++mCadenceHistogram[min(vsyncsForLastFrame, (size_t)kMaxCadenceVsyncs)];
         }
         mLastVsyncTime = nextVsyncTime;
     }
@@ -482,6 +488,43 @@ nsecs_t VideoFrameScheduler::schedule(nsecs_t renderTime) {
     return renderTime;
 }
 
+void VideoFrameScheduler::onFrameReleased(nsecs_t renderTime, nsecs_t releaseTime) {
+    const nsecs_t vsyncPeriod = getVsyncPeriod();
+    const nsecs_t margin = renderTime - releaseTime;
+
+    size_t bucket;
+    if (margin > 3 * vsyncPeriod) {
+        bucket = kReleasedEarly;
+    } else if (margin >= vsyncPeriod) {
+        bucket = kReleasedOnTime;
+    } else if (margin >= 0) {
+        bucket = kReleasedLate;
+    } else {
+        bucket = kReleasedAfterDue;
+    }
+    ++mReleaseHistogram[bucket];
+}
+
+void VideoFrameScheduler::onFrameDropped() {
+    ++mNumFramesDropped;
+}
+
+void VideoFrameScheduler::getStats(const sp<AMessage> &stats) const {
+    stats->setInt64("vsync-period-ns", mVsyncPeriod);
+    stats->setFloat("frame-rate", mPll.getPeriod() > 0 ? 1e9 / mPll.getPeriod() : 0.f);
+
+    stats->setInt64("frames-released-early", mReleaseHistogram[kReleasedEarly]);
+    stats->setInt64("frames-released-on-time", mReleaseHistogram[kReleasedOnTime]);
+    stats->setInt64("frames-released-late", mReleaseHistogram[kReleasedLate]);
+    stats->setInt64("frames-released-after-due", mReleaseHistogram[kReleasedAfterDue]);
+    stats->setInt64("frames-dropped-late", mNumFramesDropped);
+
+    for (size_t i = 1; i <= kMaxCadenceVsyncs; ++i) {
+        stats->setInt64(AStringPrintf("frames-held-%zu-vsyncs", i).c_str(),
+                mCadenceHistogram[i]);
+    }
+}
+
 void VideoFrameScheduler::release() {
     mComposer.clear();
 }
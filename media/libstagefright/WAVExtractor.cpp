@@ -20,6 +20,8 @@
 
 #include "include/WAVExtractor.h"
 
+#include <audio_utils/primitives.h>
+#include <cutils/properties.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/DataSource.h>
 #include <media/stagefright/MediaBufferGroup.h>
@@ -36,6 +38,7 @@ namespace android {
 
 enum {
     WAVE_FORMAT_PCM        = 0x0001,
+    WAVE_FORMAT_IEEE_FLOAT = 0x0003,
     WAVE_FORMAT_ALAW       = 0x0006,
     WAVE_FORMAT_MULAW      = 0x0007,
     WAVE_FORMAT_MSGSM      = 0x0031,
@@ -74,6 +77,13 @@ protected:
 private:
     static const size_t kMaxFrameSize;
 
+    // Output buffers cover kBufferDurationUs of audio, but no less than
+    // kMinBufferSize. media.stagefright.wav-read-size overrides the size;
+    // either way it is capped at kMaxBufferSize.
+    static const size_t kMinBufferSize;
+    static const size_t kMaxBufferSize;
+    static const int64_t kBufferDurationUs;
+
     sp<DataSource> mDataSource;
     sp<MetaData> mMeta;
     uint16_t mWaveFormat;
@@ -83,9 +93,15 @@ private:
     off64_t mOffset;
     size_t mSize;
     bool mStarted;
+    bool mOutputFloat;
+    size_t mBufferSize;
     MediaBufferGroup *mGroup;
     off64_t mCurrentPos;
 
+    bool isPcm() const;
+    size_t outputFrameSize() const;
+    size_t computeBufferSize() const;
+
     WAVSource(const WAVSource &);
     WAVSource &operator=(const WAVSource &);
 };
@@ -177,6 +193,7 @@ status_t WAVExtractor::init() {
 
             mWaveFormat = U16_LE_AT(formatSpec);
             if (mWaveFormat != WAVE_FORMAT_PCM
+                    && mWaveFormat != WAVE_FORMAT_IEEE_FLOAT
                     && mWaveFormat != WAVE_FORMAT_ALAW
                     && mWaveFormat != WAVE_FORMAT_MULAW
                     && mWaveFormat != WAVE_FORMAT_MSGSM
@@ -214,8 +231,16 @@ status_t WAVExtractor::init() {
 
             if (mWaveFormat == WAVE_FORMAT_PCM
                     || mWaveFormat == WAVE_FORMAT_EXTENSIBLE) {
+                // 32 bits is only valid for an IEEE float subformat, which
+                // is checked once the subformat is known below.
                 if (mBitsPerSample != 8 && mBitsPerSample != 16
-                    && mBitsPerSample != 24) {
+                    && mBitsPerSample != 24
+                    && (mWaveFormat != WAVE_FORMAT_EXTENSIBLE
+                            || mBitsPerSample != 32)) {
+                    return ERROR_UNSUPPORTED;
+                }
+            } else if (mWaveFormat == WAVE_FORMAT_IEEE_FLOAT) {
+                if (mBitsPerSample != 32) {
                     return ERROR_UNSUPPORTED;
                 }
             } else if (mWaveFormat == WAVE_FORMAT_MSGSM) {
@@ -262,10 +287,14 @@ status_t WAVExtractor::init() {
                 // the sample format, using the same definitions as a regular WAV header
                 mWaveFormat = U16_LE_AT(&formatSpec[24]);
                 if (mWaveFormat != WAVE_FORMAT_PCM
+                        && mWaveFormat != WAVE_FORMAT_IEEE_FLOAT
                         && mWaveFormat != WAVE_FORMAT_ALAW
                         && mWaveFormat != WAVE_FORMAT_MULAW) {
                     return ERROR_UNSUPPORTED;
                 }
+                if ((mWaveFormat == WAVE_FORMAT_IEEE_FLOAT) != (mBitsPerSample == 32)) {
+                    return ERROR_UNSUPPORTED;
+                }
                 if (memcmp(&formatSpec[26], WAVEEXT_SUBFORMAT, 14)) {
                     ALOGE("unsupported GUID");
                     return ERROR_UNSUPPORTED;
@@ -282,6 +311,7 @@ status_t WAVExtractor::init() {
 
                 switch (mWaveFormat) {
                     case WAVE_FORMAT_PCM:
+                    case WAVE_FORMAT_IEEE_FLOAT:
                         mTrackMeta->setCString(
                                 kKeyMIMEType, MEDIA_MIMETYPE_AUDIO_RAW);
                         break;
@@ -329,6 +359,9 @@ status_t WAVExtractor::init() {
 }
 
 const size_t WAVSource::kMaxFrameSize = 32768;
+const size_t WAVSource::kMinBufferSize = 32768;
+const size_t WAVSource::kMaxBufferSize = 1024 * 1024;
+const int64_t WAVSource::kBufferDurationUs = 40000;
 
 WAVSource::WAVSource(
         const sp<DataSource> &dataSource,
@@ -345,11 +378,17 @@ WAVSource::WAVSource(
       mOffset(offset),
       mSize(size),
       mStarted(false),
+      mOutputFloat(false),
+      mBufferSize(0),
       mGroup(NULL) {
     CHECK(mMeta->findInt32(kKeySampleRate, &mSampleRate));
     CHECK(mMeta->findInt32(kKeyChannelCount, &mNumChannels));
 
-    mMeta->setInt32(kKeyMaxInputSize, kMaxFrameSize);
+    // The output encoding is chosen in start(), so keep a format of our own
+    // rather than updating the extractor's track meta data.
+    mMeta = new MetaData(*meta);
+    mBufferSize = computeBufferSize();
+    mMeta->setInt32(kKeyMaxInputSize, mBufferSize);
 }
 
 WAVSource::~WAVSource() {
@@ -358,19 +397,71 @@ WAVSource::~WAVSource() {
     }
 }
 
-status_t WAVSource::start(MetaData * /* params */) {
+bool WAVSource::isPcm() const {
+    return mWaveFormat == WAVE_FORMAT_PCM
+            || mWaveFormat == WAVE_FORMAT_EXTENSIBLE
+            || mWaveFormat == WAVE_FORMAT_IEEE_FLOAT;
+}
+
+size_t WAVSource::outputFrameSize() const {
+    if (!isPcm()) {
+        return mNumChannels * (mBitsPerSample >> 3);
+    }
+    return mNumChannels * (mOutputFloat ? sizeof(float) : sizeof(int16_t));
+}
+
+size_t WAVSource::computeBufferSize() const {
+    if (mWaveFormat == WAVE_FORMAT_MSGSM) {
+        return kMaxFrameSize;
+    }
+
+    const size_t frameSize = outputFrameSize();
+
+    size_t size;
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.stagefright.wav-read-size", value, NULL)) {
+        size = atoi(value);
+    } else {
+        size = frameSize * (mSampleRate * kBufferDurationUs / 1000000);
+        if (size < kMinBufferSize) {
+            size = kMinBufferSize;
+        }
+    }
+    if (size > kMaxBufferSize) {
+        size = kMaxBufferSize;
+    }
+
+    // Always hold at least one whole output frame.
+    size -= size % frameSize;
+    if (size < frameSize) {
+        size = frameSize;
+    }
+    return size;
+}
+
+status_t WAVSource::start(MetaData *params) {
     ALOGV("WAVSource::start");
 
     CHECK(!mStarted);
 
-    mGroup = new MediaBufferGroup;
-    mGroup->add_buffer(new MediaBuffer(kMaxFrameSize));
-
-    if (mBitsPerSample == 8) {
-        // As a temporary buffer for 8->16 bit conversion.
-        mGroup->add_buffer(new MediaBuffer(kMaxFrameSize));
+    // Linear PCM is delivered as 16-bit by default; a consumer that mixes in
+    // float may ask for float output to keep 24-bit and float sources lossless.
+    int32_t encoding;
+    mOutputFloat = isPcm() && params != NULL
+            && params->findInt32(kKeyPcmEncoding, &encoding)
+            && encoding == kAudioEncodingPcmFloat;
+    if (isPcm()) {
+        mMeta->setInt32(kKeyPcmEncoding,
+                mOutputFloat ? kAudioEncodingPcmFloat : kAudioEncodingPcm16bit);
     }
 
+    mBufferSize = computeBufferSize();
+    mMeta->setInt32(kKeyMaxInputSize, mBufferSize);
+
+    // Samples are converted in place, so a single buffer is enough.
+    mGroup = new MediaBufferGroup;
+    mGroup->add_buffer(new MediaBuffer(mBufferSize));
+
     mCurrentPos = mOffset;
 
     mStarted = true;
@@ -426,10 +517,12 @@ status_t WAVSource::read(
         return err;
     }
 
-    // make sure that maxBytesToRead is multiple of 3, in 24-bit case
-    size_t maxBytesToRead =
-        mBitsPerSample == 8 ? kMaxFrameSize / 2 : 
-        (mBitsPerSample == 24 ? 3*(kMaxFrameSize/3): kMaxFrameSize);
+    // Read as many whole frames as still fit in the buffer once converted.
+    const size_t inputUnitFrameSize = mNumChannels * mBitsPerSample / 8;
+    size_t maxBytesToRead = mBufferSize;
+    if (isPcm()) {
+        maxBytesToRead = (mBufferSize / outputFrameSize()) * inputUnitFrameSize;
+    }
 
     size_t maxBytesAvailable =
         (mCurrentPos - mOffset >= (off64_t)mSize)
@@ -448,7 +541,6 @@ status_t WAVSource::read(
         maxBytesToRead = (maxBytesToRead / 65) * 65;
     } else {
         // read only integral amounts of audio unit frames.
-        const size_t inputUnitFrameSize = mNumChannels * mBitsPerSample / 8;
         maxBytesToRead -= maxBytesToRead % inputUnitFrameSize;
     }
 
@@ -463,51 +555,34 @@ status_t WAVSource::read(
         return ERROR_END_OF_STREAM;
     }
 
-    buffer->set_range(0, n);
-
-    if (mWaveFormat == WAVE_FORMAT_PCM || mWaveFormat == WAVE_FORMAT_EXTENSIBLE) {
-        if (mBitsPerSample == 8) {
-            // Convert 8-bit unsigned samples to 16-bit signed.
-
-            MediaBuffer *tmp;
-            CHECK_EQ(mGroup->acquire_buffer(&tmp), (status_t)OK);
-
-            // The new buffer holds the sample number of samples, but each
-            // one is 2 bytes wide.
-            tmp->set_range(0, 2 * n);
-
-            int16_t *dst = (int16_t *)tmp->data();
-            const uint8_t *src = (const uint8_t *)buffer->data();
-            ssize_t numBytes = n;
-
-            while (numBytes-- > 0) {
-                *dst++ = ((int16_t)(*src) - 128) * 256;
-                ++src;
+    // Convert in place; the buffer was sized for the converted samples.
+    if (isPcm()) {
+        const size_t numSamples = n / (mBitsPerSample >> 3);
+        void *data = buffer->data();
+
+        if (mOutputFloat) {
+            if (mBitsPerSample == 8) {
+                memcpy_to_float_from_u8((float *)data, (const uint8_t *)data, numSamples);
+            } else if (mBitsPerSample == 16) {
+                memcpy_to_float_from_i16((float *)data, (const int16_t *)data, numSamples);
+            } else if (mBitsPerSample == 24) {
+                memcpy_to_float_from_p24((float *)data, (const uint8_t *)data, numSamples);
             }
-
-            buffer->release();
-            buffer = tmp;
-        } else if (mBitsPerSample == 24) {
-            // Convert 24-bit signed samples to 16-bit signed.
-
-            const uint8_t *src =
-                (const uint8_t *)buffer->data() + buffer->range_offset();
-            int16_t *dst = (int16_t *)src;
-
-            size_t numSamples = buffer->range_length() / 3;
-            for (size_t i = 0; i < numSamples; ++i) {
-                int32_t x = (int32_t)(src[0] | src[1] << 8 | src[2] << 16);
-                x = (x << 8) >> 8;  // sign extension
-
-                x = x >> 8;
-                *dst++ = (int16_t)x;
-                src += 3;
+            n = numSamples * sizeof(float);
+        } else {
+            if (mBitsPerSample == 8) {
+                memcpy_to_i16_from_u8((int16_t *)data, (const uint8_t *)data, numSamples);
+            } else if (mBitsPerSample == 24) {
+                memcpy_to_i16_from_p24((int16_t *)data, (const uint8_t *)data, numSamples);
+            } else if (mBitsPerSample == 32) {
+                memcpy_to_i16_from_float((int16_t *)data, (const float *)data, numSamples);
             }
-
-            buffer->set_range(buffer->range_offset(), 2 * numSamples);
+            n = numSamples * sizeof(int16_t);
         }
     }
 
+    buffer->set_range(0, n);
+
     int64_t timeStampUs = 0;
 
     if (mWaveFormat == WAVE_FORMAT_MSGSM) {
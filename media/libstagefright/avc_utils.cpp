@@ -31,20 +31,11 @@
 namespace android {
 
 unsigned parseUE(ABitReader *br) {
-    unsigned numZeroes = 0;
-    while (br->getBits(1) == 0) {
-        ++numZeroes;
-    }
-
-    unsigned x = br->getBits(numZeroes);
-
-    return x + (1u << numZeroes) - 1;
+    return br->getUE();
 }
 
 signed parseSE(ABitReader *br) {
-    unsigned codeNum = parseUE(br);
-
-    return (codeNum & 1) ? (codeNum + 1) / 2 : -(codeNum / 2);
+    return br->getSE();
 }
 
 static void skipScalingList(ABitReader *br, size_t sizeOfScalingList) {
@@ -65,7 +56,7 @@ void FindAVCDimensions(
         const sp<ABuffer> &seqParamSet,
         int32_t *width, int32_t *height,
         int32_t *sarWidth, int32_t *sarHeight) {
-    ABitReader br(seqParamSet->data() + 1, seqParamSet->size() - 1);
+    NALBitReader br(seqParamSet->data() + 1, seqParamSet->size() - 1);
 
     unsigned profile_idc = br.getBits(8);
     br.skipBits(16);
@@ -227,6 +218,25 @@ void FindAVCDimensions(
     }
 }
 
+// Returns the offset of the first 0x00 0x00 0x01 start code at or after
+// offset, or size if there is none. Candidates are located with memchr,
+// which libc vectorizes, instead of testing every byte of the slice data.
+static size_t findStartCode(const uint8_t *data, size_t size, size_t offset) {
+    while (offset + 2 < size) {
+        const uint8_t *one = (const uint8_t *)memchr(
+                &data[offset + 2], 0x01, size - offset - 2);
+        if (one == NULL) {
+            break;
+        }
+        size_t pos = one - data;
+        if (data[pos - 1] == 0x00 && data[pos - 2] == 0x00) {
+            return pos - 2;
+        }
+        offset = pos - 1;
+    }
+    return size;
+}
+
 status_t getNextNALUnit(
         const uint8_t **_data, size_t *_size,
         const uint8_t **nalStart, size_t *nalSize,
@@ -241,46 +251,22 @@ status_t getNextNALUnit(
         return -EAGAIN;
     }
 
-    size_t offset = 0;
-
     // A valid startcode consists of at least two 0x00 bytes followed by 0x01.
-    for (; offset + 2 < size; ++offset) {
-        if (data[offset + 2] == 0x01 && data[offset] == 0x00
-                && data[offset + 1] == 0x00) {
-            break;
-        }
-    }
-    if (offset + 2 >= size) {
-        *_data = &data[offset];
+    size_t offset = findStartCode(data, size, 0);
+    if (offset == size) {
+        *_data = &data[size - 2];
         *_size = 2;
         return -EAGAIN;
     }
-    offset += 3;
 
-    size_t startOffset = offset;
-
-    for (;;) {
-        while (offset < size && data[offset] != 0x01) {
-            ++offset;
-        }
+    size_t startOffset = offset + 3;
 
-        if (offset == size) {
-            if (startCodeFollows) {
-                offset = size + 2;
-                break;
-            }
-
-            return -EAGAIN;
-        }
-
-        if (data[offset - 1] == 0x00 && data[offset - 2] == 0x00) {
-            break;
-        }
-
-        ++offset;
+    size_t nextStartCode = findStartCode(data, size, startOffset);
+    if (nextStartCode == size && !startCodeFollows) {
+        return -EAGAIN;
     }
 
-    size_t endOffset = offset - 2;
+    size_t endOffset = nextStartCode;
     while (endOffset > startOffset + 1 && data[endOffset - 1] == 0x00) {
         --endOffset;
     }
@@ -288,9 +274,9 @@ status_t getNextNALUnit(
     *nalStart = &data[startOffset];
     *nalSize = endOffset - startOffset;
 
-    if (offset + 2 < size) {
-        *_data = &data[offset - 2];
-        *_size = size - offset + 2;
+    if (nextStartCode + 4 < size) {
+        *_data = &data[nextStartCode];
+        *_size = size - nextStartCode;
     } else {
         *_data = NULL;
         *_size = 0;
@@ -299,20 +285,6 @@ status_t getNextNALUnit(
     return OK;
 }
 
-static sp<ABuffer> FindNAL(const uint8_t *data, size_t size, unsigned nalType) {
-    const uint8_t *nalStart;
-    size_t nalSize;
-    while (getNextNALUnit(&data, &size, &nalStart, &nalSize, true) == OK) {
-        if ((nalStart[0] & 0x1f) == nalType) {
-            sp<ABuffer> buffer = new ABuffer(nalSize);
-            memcpy(buffer->data(), nalStart, nalSize);
-            return buffer;
-        }
-    }
-
-    return NULL;
-}
-
 const char *AVCProfileToString(uint8_t profile) {
     switch (profile) {
         case kAVCProfileBaseline:
@@ -339,7 +311,22 @@ sp<MetaData> MakeAVCCodecSpecificData(const sp<ABuffer> &accessUnit) {
     const uint8_t *data = accessUnit->data();
     size_t size = accessUnit->size();
 
-    sp<ABuffer> seqParamSet = FindNAL(data, size, 7);
+    // Find the first SPS and PPS in a single pass; they are referenced in
+    // place, the access unit outlives them.
+    sp<ABuffer> seqParamSet;
+    sp<ABuffer> picParamSet;
+    const uint8_t *nalStart;
+    size_t nalSize;
+    while ((seqParamSet == NULL || picParamSet == NULL)
+            && getNextNALUnit(&data, &size, &nalStart, &nalSize, true) == OK) {
+        unsigned nalType = nalStart[0] & 0x1f;
+        if (nalType == 7 && seqParamSet == NULL) {
+            seqParamSet = new ABuffer((void *)nalStart, nalSize);
+        } else if (nalType == 8 && picParamSet == NULL) {
+            picParamSet = new ABuffer((void *)nalStart, nalSize);
+        }
+    }
+
     if (seqParamSet == NULL) {
         return NULL;
     }
@@ -349,7 +336,6 @@ sp<MetaData> MakeAVCCodecSpecificData(const sp<ABuffer> &accessUnit) {
     FindAVCDimensions(
             seqParamSet, &width, &height, &sarWidth, &sarHeight);
 
-    sp<ABuffer> picParamSet = FindNAL(data, size, 8);
     CHECK(picParamSet != NULL);
 
     size_t csdSize =
@@ -420,45 +406,44 @@ sp<MetaData> MakeAVCCodecSpecificData(const sp<ABuffer> &accessUnit) {
     return meta;
 }
 
+// Only the NAL unit headers are looked at, so these walk the start codes
+// directly instead of delimiting each NAL unit, and stop at the first slice:
+// all slices of a picture are either IDR or not, and the slice data (the
+// bulk of the access unit) is never scanned.
 bool IsIDR(const sp<ABuffer> &buffer) {
     const uint8_t *data = buffer->data();
     size_t size = buffer->size();
 
-    bool foundIDR = false;
-
-    const uint8_t *nalStart;
-    size_t nalSize;
-    while (getNextNALUnit(&data, &size, &nalStart, &nalSize, true) == OK) {
-        CHECK_GT(nalSize, 0u);
-
-        unsigned nalType = nalStart[0] & 0x1f;
+    size_t offset = 0;
+    while ((offset = findStartCode(data, size, offset)) + 3 < size) {
+        unsigned nalType = data[offset + 3] & 0x1f;
 
         if (nalType == 5) {
-            foundIDR = true;
-            break;
+            return true;
+        } else if (nalType >= 1 && nalType <= 4) {
+            return false;
         }
+        offset += 3;
     }
 
-    return foundIDR;
+    return false;
 }
 
 bool IsAVCReferenceFrame(const sp<ABuffer> &accessUnit) {
     const uint8_t *data = accessUnit->data();
     size_t size = accessUnit->size();
 
-    const uint8_t *nalStart;
-    size_t nalSize;
-    while (getNextNALUnit(&data, &size, &nalStart, &nalSize, true) == OK) {
-        CHECK_GT(nalSize, 0u);
-
-        unsigned nalType = nalStart[0] & 0x1f;
+    size_t offset = 0;
+    while ((offset = findStartCode(data, size, offset)) + 3 < size) {
+        unsigned nalType = data[offset + 3] & 0x1f;
 
         if (nalType == 5) {
             return true;
         } else if (nalType == 1) {
-            unsigned nal_ref_idc = (nalStart[0] >> 5) & 3;
+            unsigned nal_ref_idc = (data[offset + 3] >> 5) & 3;
             return nal_ref_idc != 0;
         }
+        offset += 3;
     }
 
     return true;
@@ -28,6 +28,7 @@
 #include <media/stagefright/MediaErrors.h>
 
 #include <math.h>
+#include <string.h>
 
 #define FILEREAD_MAX_LAYERS 2
 
@@ -420,27 +421,22 @@ bool SoftAAC2::outputDelayRingBufferPutSamples(INT_PCM *samples, int32_t numSamp
         ALOGE("RING BUFFER WOULD OVERFLOW");
         return false;
     }
-    if (mOutputDelayRingBufferWritePos + numSamples <= mOutputDelayRingBufferSize
-            && (mOutputDelayRingBufferReadPos <= mOutputDelayRingBufferWritePos
-                    || mOutputDelayRingBufferReadPos > mOutputDelayRingBufferWritePos + numSamples)) {
-        // faster memcopy loop without checks, if the preconditions allow this
-        for (int32_t i = 0; i < numSamples; i++) {
-            mOutputDelayRingBuffer[mOutputDelayRingBufferWritePos++] = samples[i];
-        }
-
-        if (mOutputDelayRingBufferWritePos >= mOutputDelayRingBufferSize) {
-            mOutputDelayRingBufferWritePos -= mOutputDelayRingBufferSize;
-        }
-    } else {
-        ALOGV("slow SoftAAC2::outputDelayRingBufferPutSamples()");
-
-        for (int32_t i = 0; i < numSamples; i++) {
-            mOutputDelayRingBuffer[mOutputDelayRingBufferWritePos] = samples[i];
-            mOutputDelayRingBufferWritePos++;
-            if (mOutputDelayRingBufferWritePos >= mOutputDelayRingBufferSize) {
-                mOutputDelayRingBufferWritePos -= mOutputDelayRingBufferSize;
-            }
-        }
+    // The space check above guarantees the write never passes the read
+    // position, so copy in at most two contiguous chunks around the wrap.
+    int32_t firstChunk = mOutputDelayRingBufferSize - mOutputDelayRingBufferWritePos;
+    if (firstChunk > numSamples) {
+        firstChunk = numSamples;
+    }
+    memcpy(&mOutputDelayRingBuffer[mOutputDelayRingBufferWritePos], samples,
+            firstChunk * sizeof(mOutputDelayRingBuffer[0]));
+    if (numSamples > firstChunk) {
+        ALOGV("wrapping SoftAAC2::outputDelayRingBufferPutSamples()");
+        memcpy(mOutputDelayRingBuffer, samples + firstChunk,
+                (numSamples - firstChunk) * sizeof(mOutputDelayRingBuffer[0]));
+    }
+    mOutputDelayRingBufferWritePos += numSamples;
+    if (mOutputDelayRingBufferWritePos >= mOutputDelayRingBufferSize) {
+        mOutputDelayRingBufferWritePos -= mOutputDelayRingBufferSize;
     }
     mOutputDelayRingBufferFilled += numSamples;
     return true;
@@ -453,33 +449,25 @@ int32_t SoftAAC2::outputDelayRingBufferGetSamples(INT_PCM *samples, int32_t numS
         return -1;
     }
 
-    if (mOutputDelayRingBufferReadPos + numSamples <= mOutputDelayRingBufferSize
-            && (mOutputDelayRingBufferWritePos < mOutputDelayRingBufferReadPos
-                    || mOutputDelayRingBufferWritePos >= mOutputDelayRingBufferReadPos + numSamples)) {
-        // faster memcopy loop without checks, if the preconditions allow this
-        if (samples != 0) {
-            for (int32_t i = 0; i < numSamples; i++) {
-                samples[i] = mOutputDelayRingBuffer[mOutputDelayRingBufferReadPos++];
-            }
-        } else {
-            mOutputDelayRingBufferReadPos += numSamples;
+    if (samples != 0) {
+        // The fill check above guarantees the read never passes the write
+        // position, so copy out in at most two contiguous chunks.
+        int32_t firstChunk = mOutputDelayRingBufferSize - mOutputDelayRingBufferReadPos;
+        if (firstChunk > numSamples) {
+            firstChunk = numSamples;
         }
-        if (mOutputDelayRingBufferReadPos >= mOutputDelayRingBufferSize) {
-            mOutputDelayRingBufferReadPos -= mOutputDelayRingBufferSize;
-        }
-    } else {
-        ALOGV("slow SoftAAC2::outputDelayRingBufferGetSamples()");
-
-        for (int32_t i = 0; i < numSamples; i++) {
-            if (samples != 0) {
-                samples[i] = mOutputDelayRingBuffer[mOutputDelayRingBufferReadPos];
-            }
-            mOutputDelayRingBufferReadPos++;
-            if (mOutputDelayRingBufferReadPos >= mOutputDelayRingBufferSize) {
-                mOutputDelayRingBufferReadPos -= mOutputDelayRingBufferSize;
-            }
+        memcpy(samples, &mOutputDelayRingBuffer[mOutputDelayRingBufferReadPos],
+                firstChunk * sizeof(mOutputDelayRingBuffer[0]));
+        if (numSamples > firstChunk) {
+            ALOGV("wrapping SoftAAC2::outputDelayRingBufferGetSamples()");
+            memcpy(samples + firstChunk, mOutputDelayRingBuffer,
+                    (numSamples - firstChunk) * sizeof(mOutputDelayRingBuffer[0]));
         }
     }
+    mOutputDelayRingBufferReadPos += numSamples;
+    if (mOutputDelayRingBufferReadPos >= mOutputDelayRingBufferSize) {
+        mOutputDelayRingBufferReadPos -= mOutputDelayRingBufferSize;
+    }
     mOutputDelayRingBufferFilled -= numSamples;
     return numSamples;
 }
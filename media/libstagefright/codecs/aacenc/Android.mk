@@ -55,6 +55,10 @@ LOCAL_SRC_FILES += \
 	src/asm/ARMV7/Radix4FFT_v7.s
 endif
 
+LOCAL_SRC_FILES_arm64 := \
+	src/band_nrg_neon.c \
+	src/transform_neon.c
+
 LOCAL_MODULE := libstagefright_aacenc
 
 LOCAL_ARM_MODE := arm
@@ -82,6 +86,8 @@ LOCAL_C_INCLUDES += $(LOCAL_PATH)/src/asm/ARMV5E
 LOCAL_C_INCLUDES += $(LOCAL_PATH)/src/asm/ARMV7
 endif
 
+LOCAL_CFLAGS_arm64 := -DAACENC_NEON
+
 LOCAL_CFLAGS += -Werror
 
 include $(BUILD_STATIC_LIBRARY)
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/*******************************************************************************
+	File:		band_nrg_neon.c
+
+	Content:	AArch64 NEON versions of the band energy functions in band_nrg.c.
+				The lines of a band are summed with 64 bit accumulators and the
+				sum is saturated once: all the terms are positive, so this gives
+				the same result as the saturating L_add of each term.
+
+*******************************************************************************/
+
+#include <arm_neon.h>
+
+#include "basic_op.h"
+#include "band_nrg.h"
+
+/* sum of MULHIGH(a[j], a[j]) for bgn <= j < end */
+__inline Word64 sumSquares(const Word32 *a, Word32 bgn, Word32 end)
+{
+  int64x2_t accu = vdupq_n_s64(0);
+  Word64 sum;
+  Word32 j;
+
+  for (j = bgn; j + 4 <= end; j += 4) {
+    int32x4_t x = vld1q_s32(a + j);
+    accu = vaddq_s64(accu, vshrq_n_s64(vmull_s32(vget_low_s32(x), vget_low_s32(x)), 32));
+    accu = vaddq_s64(accu, vshrq_n_s64(vmull_high_s32(x, x), 32));
+  }
+
+  sum = vaddvq_s64(accu);
+  for (; j < end; j++)
+    sum += MULHIGH(a[j], a[j]);
+
+  return sum;
+}
+
+__inline Word32 saturateSum(Word64 sum)
+{
+  return sum > MAX_32 ? MAX_32 : (Word32)sum;
+}
+
+/********************************************************************************
+*
+* function name: CalcBandEnergy
+* description:   Calc sfb-bandwise mdct-energies for left and right channel
+*
+**********************************************************************************/
+void CalcBandEnergy(const Word32 *mdctSpectrum,
+                    const Word16 *bandOffset,
+                    const Word16  numBands,
+                    Word32       *bandEnergy,
+                    Word32       *bandEnergySum)
+{
+  Word32 i;
+  Word32 accuSum = 0;
+
+  for (i=0; i<numBands; i++) {
+    Word32 accu = saturateSum(sumSquares(mdctSpectrum, bandOffset[i], bandOffset[i+1]));
+
+    accu = L_add(accu, accu);
+    accuSum = L_add(accuSum, accu);
+    bandEnergy[i] = accu;
+  }
+  *bandEnergySum = accuSum;
+}
+
+/********************************************************************************
+*
+* function name: CalcBandEnergyMS
+* description:   Calc sfb-bandwise mdct-energies for left add or minus right channel
+*
+**********************************************************************************/
+void CalcBandEnergyMS(const Word32 *mdctSpectrumLeft,
+                      const Word32 *mdctSpectrumRight,
+                      const Word16 *bandOffset,
+                      const Word16  numBands,
+                      Word32       *bandEnergyMid,
+                      Word32       *bandEnergyMidSum,
+                      Word32       *bandEnergySide,
+                      Word32       *bandEnergySideSum)
+{
+  Word32 i, j;
+  Word32 accuMidSum = 0;
+  Word32 accuSideSum = 0;
+
+  for(i=0; i<numBands; i++) {
+    int64x2_t mid = vdupq_n_s64(0);
+    int64x2_t side = vdupq_n_s64(0);
+    Word64 sumMid, sumSide;
+    Word32 accuMid, accuSide;
+
+    for (j = bandOffset[i]; j + 4 <= bandOffset[i+1]; j += 4) {
+      int32x4_t l = vshrq_n_s32(vld1q_s32(mdctSpectrumLeft + j), 1);
+      int32x4_t r = vshrq_n_s32(vld1q_s32(mdctSpectrumRight + j), 1);
+      int32x4_t specm = vaddq_s32(l, r);
+      int32x4_t specs = vsubq_s32(l, r);
+
+      mid = vaddq_s64(mid, vshrq_n_s64(
+              vmull_s32(vget_low_s32(specm), vget_low_s32(specm)), 32));
+      mid = vaddq_s64(mid, vshrq_n_s64(vmull_high_s32(specm, specm), 32));
+      side = vaddq_s64(side, vshrq_n_s64(
+              vmull_s32(vget_low_s32(specs), vget_low_s32(specs)), 32));
+      side = vaddq_s64(side, vshrq_n_s64(vmull_high_s32(specs, specs), 32));
+    }
+
+    sumMid = vaddvq_s64(mid);
+    sumSide = vaddvq_s64(side);
+    for (; j < bandOffset[i+1]; j++) {
+      Word32 l = mdctSpectrumLeft[j] >> 1;
+      Word32 r = mdctSpectrumRight[j] >> 1;
+      Word32 specm = l + r;
+      Word32 specs = l - r;
+      sumMid += MULHIGH(specm, specm);
+      sumSide += MULHIGH(specs, specs);
+    }
+
+    accuMid = saturateSum(sumMid);
+    accuSide = saturateSum(sumSide);
+
+    accuMid = L_add(accuMid, accuMid);
+    accuSide = L_add(accuSide, accuSide);
+    bandEnergyMid[i] = accuMid;
+    accuMidSum = L_add(accuMidSum, accuMid);
+    bandEnergySide[i] = accuSide;
+    accuSideSum = L_add(accuSideSum, accuSide);
+  }
+  *bandEnergyMidSum = accuMidSum;
+  *bandEnergySideSum = accuSideSum;
+}
@@ -26,6 +26,10 @@
 #include "quantize.h"
 #include "aac_rom.h"
 
+#ifdef AACENC_NEON
+#include <arm_neon.h>
+#endif
+
 #define MANT_DIGITS 9
 #define MANT_SIZE   (1<<MANT_DIGITS)
 
@@ -92,6 +96,78 @@ static Word16 quantizeSingleLine(const Word16 gain, const Word32 absSpectrum)
   return qua;
 }
 
+#ifdef AACENC_NEON
+/*****************************************************************************
+*
+* function name:quantizeLinesNeon
+* description: quantizeLines for 0 <= g < 32, 4 lines at a time. The lines
+*              above quantBorders[m][3] go through quantizeSingleLine.
+*
+*****************************************************************************/
+static void quantizeLinesNeon(const Word16 gain,
+                              const Word32 g,
+                              const Word16 *pquat,
+                              const Word16 noOfLines,
+                              const Word32 *mdctSpectrum,
+                              Word16 *quaSpectrum)
+{
+  const int32x4_t shift = vdupq_n_s32(-g);
+  const int32x4_t p0 = vdupq_n_s32(pquat[0]);
+  const int32x4_t p1 = vdupq_n_s32(pquat[1]);
+  const int32x4_t p2 = vdupq_n_s32(pquat[2]);
+  const int32x4_t p3 = vdupq_n_s32(pquat[3]);
+  Word32 line, k;
+
+  for (line=0; line+4<=noOfLines; line+=4) {
+    int32x4_t x = vld1q_s32(mdctSpectrum + line);
+    int32x4_t sa = vqabsq_s32(x);
+    int32x4_t saShft = vshlq_s32(sa, shift);
+    int32x4_t sign = vshrq_n_s32(x, 31);
+    /* the masks are -1 where set, so this is minus the quantized value */
+    int32x4_t qua = vreinterpretq_s32_u32(vcgtq_s32(saShft, p0));
+    uint32x4_t large = vcgeq_s32(saShft, p3);
+    Word32 tmp[4];
+
+    qua = vaddq_s32(qua, vreinterpretq_s32_u32(vcgeq_s32(saShft, p1)));
+    qua = vaddq_s32(qua, vreinterpretq_s32_u32(vcgeq_s32(saShft, p2)));
+    /* apply the sign of the line */
+    qua = vsubq_s32(veorq_s32(vnegq_s32(qua), sign), sign);
+    vst1_s16(quaSpectrum + line, vmovn_s32(qua));
+
+    if (vmaxvq_u32(large)) {
+      vst1q_s32(tmp, saShft);
+      for (k=0; k<4; k++) {
+        if (tmp[k] >= pquat[3]) {
+          Word16 q = quantizeSingleLine(gain, L_abs(mdctSpectrum[line+k]));
+          quaSpectrum[line+k] = mdctSpectrum[line+k] < 0 ? -q : q;
+        }
+      }
+    }
+  }
+
+  for (; line<noOfLines; line++) {
+    Word32 mdctSpeL = mdctSpectrum[line];
+    Word32 sa = L_abs(mdctSpeL);
+    Word32 saShft = sa >> g;
+    Word16 qua = 0;
+
+    if (saShft > pquat[0]) {
+      if (saShft < pquat[1])
+        qua = 1;
+      else if (saShft < pquat[2])
+        qua = 2;
+      else if (saShft < pquat[3])
+        qua = 3;
+      else
+        qua = quantizeSingleLine(gain, sa);
+      if (mdctSpeL < 0)
+        qua = -qua;
+    }
+    quaSpectrum[line] = qua;
+  }
+}
+#endif
+
 /*****************************************************************************
 *
 * function name:quantizeLines
@@ -117,6 +193,14 @@ static void quantizeLines(const Word16 gain,
 
   g += 16;
 
+#ifdef AACENC_NEON
+  if(g >= 0 && g < INT_BITS)
+  {
+	quantizeLinesNeon(gain, g, pquat, noOfLines, mdctSpectrum, quaSpectrum);
+	return;
+  }
+#endif
+
   if(g >= 0)
   {
 	for (line=0; line<noOfLines; line++) {
@@ -316,6 +400,93 @@ void QuantizeSpectrum(Word16 sfbCnt,
 }
 
 
+#ifdef AACENC_NEON
+/*****************************************************************************
+*
+* function name:calcSfbDistNeon
+* description: first case of calcSfbDist (0 <= g < 16), 4 lines at a time.
+*              The distortions are positive, so adding them up in 64 bit
+*              and saturating the sum gives the same result as L_add.
+*
+*****************************************************************************/
+static Word32 calcSfbDistNeon(const Word32 *spec,
+                              Word16  sfbWidth,
+                              Word16  gain,
+                              Word32  g,
+                              Word32  g2,
+                              const Word16 *pquat,
+                              const Word16 *repquat)
+{
+  const int32x4_t shift = vdupq_n_s32(-g);
+  const int32x4_t shift2 = vdupq_n_s32(-g2);
+  const int32x4_t p0 = vdupq_n_s32(pquat[0]);
+  const int32x4_t p1 = vdupq_n_s32(pquat[1]);
+  const int32x4_t p2 = vdupq_n_s32(pquat[2]);
+  const int32x4_t p3 = vdupq_n_s32(pquat[3]);
+  const int32x4_t r0 = vdupq_n_s32(repquat[0]);
+  const int32x4_t r1 = vdupq_n_s32(repquat[1]);
+  const int32x4_t r2 = vdupq_n_s32(repquat[2]);
+  int64x2_t accu = vdupq_n_s64(0);
+  Word64 dist = 0;
+  Word32 line, k;
+
+  for(line=0; line+4<=sfbWidth; line+=4) {
+    int32x4_t sa = vqabsq_s32(vld1q_s32(spec + line));
+    int32x4_t saShft = vshlq_s32(sa, shift);
+    uint32x4_t large = vcgeq_s32(saShft, p3);
+    int32x4_t recon = vdupq_n_s32(0);
+    int32x4_t diff, distSingle;
+
+    /* zero lines give a zero distortion */
+    recon = vbslq_s32(vcgeq_s32(saShft, p0), r0, recon);
+    recon = vbslq_s32(vcgeq_s32(saShft, p1), r1, recon);
+    recon = vbslq_s32(vcgeq_s32(saShft, p2), r2, recon);
+    diff = vsubq_s32(saShft, recon);
+    distSingle = vshlq_s32(vmulq_s32(diff, diff), shift2);
+    distSingle = vbicq_s32(distSingle, vreinterpretq_s32_u32(large));
+    accu = vpadalq_s32(accu, distSingle);
+
+    if (vmaxvq_u32(large)) {
+      Word32 tmp[4];
+      vst1q_s32(tmp, sa);
+      for (k=0; k<4; k++) {
+        if ((tmp[k] >> g) >= pquat[3]) {
+          Word16 qua = quantizeSingleLine(gain, tmp[k]);
+          Word32 iqval, diff32;
+          iquantizeLines(gain, 1, &qua, &iqval);
+          diff32 = tmp[k] - iqval;
+          dist += fixmul(diff32, diff32);
+        }
+      }
+    }
+  }
+
+  dist += vaddvq_s64(accu);
+  for(; line<sfbWidth; line++) {
+    Word32 sa = L_abs(spec[line]);
+    Word32 saShft = sa >> g;
+    Word32 diff;
+
+    if (saShft < pquat[0]) {
+      dist += (saShft * saShft) >> g2;
+    }
+    else if (saShft < pquat[3]) {
+      diff = saShft - repquat[saShft < pquat[1] ? 0 : saShft < pquat[2] ? 1 : 2];
+      dist += (diff * diff) >> g2;
+    }
+    else {
+      Word16 qua = quantizeSingleLine(gain, sa);
+      Word32 iqval, diff32;
+      iquantizeLines(gain, 1, &qua, &iqval);
+      diff32 = sa - iqval;
+      dist += fixmul(diff32, diff32);
+    }
+  }
+
+  return dist > MAX_32 ? MAX_32 : (Word32)dist;
+}
+#endif
+
 /*****************************************************************************
 *
 * function name:calcSfbDist
@@ -344,6 +515,9 @@ Word32 calcSfbDist(const Word32 *spec,
   if(g2 < 0 && g >= 0)
   {
 	  g2 = -g2;
+#ifdef AACENC_NEON
+	  return calcSfbDistNeon(spec, sfbWidth, gain, g, g2, pquat, repquat);
+#endif
 	  for(line=0; line<sfbWidth; line++) {
 		  if (spec[line]) {
 			  Word32 diff;
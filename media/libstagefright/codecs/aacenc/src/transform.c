@@ -179,6 +179,7 @@ static void Radix8First(int *buf, int num)
 	}
 }
 
+#if !defined(AACENC_NEON)
 /*****************************************************************************
 *
 * function name: Radix4FFT
@@ -340,6 +341,12 @@ static void PostMDCT(int *buf0, int num, const int *csptr)
 	}
 }
 #else
+/* transform_neon.c */
+void Radix4FFT(int *buf, int num, int bgn, int *twidTab);
+void PreMDCT(int *buf0, int num, const int *csptr);
+void PostMDCT(int *buf0, int num, const int *csptr);
+#endif
+#else
 void Radix4First(int *buf, int num);
 void Radix8First(int *buf, int num);
 void Radix4FFT(int *buf, int num, int bgn, int *twidTab);
@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/*******************************************************************************
+	File:		transform_neon.c
+
+	Content:	AArch64 NEON versions of the MDCT pre/post twiddle and of the
+				radix 4 FFT passes in transform.c, 4 butterflies at a time.
+				The products are truncated like MULHIGH, so the output is
+				bit-exact with the C versions.
+
+*******************************************************************************/
+
+#include <arm_neon.h>
+
+#include "basic_op.h"
+
+/* MULHIGH on each lane */
+__inline int32x4_t mulhigh_s32(int32x4_t a, int32x4_t b)
+{
+	int64x2_t lo = vmull_s32(vget_low_s32(a), vget_low_s32(b));
+	int64x2_t hi = vmull_high_s32(a, b);
+
+	return vuzp2q_s32(vreinterpretq_s32_s64(lo), vreinterpretq_s32_s64(hi));
+}
+
+__inline int32x4_t reverse_s32(int32x4_t a)
+{
+	a = vrev64q_s32(a);
+	return vextq_s32(a, a, 2);
+}
+
+/*****************************************************************************
+*
+* function name: Radix4FFT
+* description:  Radix 4 point fft core function
+*
+**********************************************************************************/
+void Radix4FFT(int *buf, int num, int bgn, int *twidTab)
+{
+	int i, j, step;
+	int *xptr, *csptr;
+
+	for (num >>= 2; num != 0; num >>= 2)
+	{
+		step = 2*bgn;
+		xptr = buf;
+
+		for (i = num; i != 0; i--)
+		{
+			csptr = twidTab;
+
+			/* bgn is a multiple of 4 */
+			for (j = bgn; j != 0; j -= 4)
+			{
+				int32x4x3_t cs01 = vld3q_s32(csptr);
+				int32x4x3_t cs23 = vld3q_s32(csptr + 12);
+				int32x4_t cos1 = vuzp1q_s32(cs01.val[0], cs23.val[0]);
+				int32x4_t sin2 = vuzp2q_s32(cs01.val[0], cs23.val[0]);
+				int32x4_t sin1 = vuzp1q_s32(cs01.val[1], cs23.val[1]);
+				int32x4_t cos3 = vuzp2q_s32(cs01.val[1], cs23.val[1]);
+				int32x4_t cos2 = vuzp1q_s32(cs01.val[2], cs23.val[2]);
+				int32x4_t sin3 = vuzp2q_s32(cs01.val[2], cs23.val[2]);
+				int32x4x2_t a, b, c, d;
+				int32x4_t r0, r1, r2, r3, r4, r5, r6, r7, t0, t1;
+
+				a = vld2q_s32(xptr);
+				b = vld2q_s32(xptr + step);
+				c = vld2q_s32(xptr + 2*step);
+				d = vld2q_s32(xptr + 3*step);
+
+				/* cos*br + sin*bi, cos*bi - sin*br */
+				r2 = vaddq_s32(mulhigh_s32(cos1, b.val[0]), mulhigh_s32(sin1, b.val[1]));
+				r3 = vsubq_s32(mulhigh_s32(cos1, b.val[1]), mulhigh_s32(sin1, b.val[0]));
+
+				t0 = vshrq_n_s32(a.val[0], 2);
+				t1 = vshrq_n_s32(a.val[1], 2);
+				r0 = vsubq_s32(t0, r2);
+				r1 = vsubq_s32(t1, r3);
+				r2 = vaddq_s32(t0, r2);
+				r3 = vaddq_s32(t1, r3);
+
+				r4 = vaddq_s32(mulhigh_s32(cos2, c.val[0]), mulhigh_s32(sin2, c.val[1]));
+				r5 = vsubq_s32(mulhigh_s32(cos2, c.val[1]), mulhigh_s32(sin2, c.val[0]));
+
+				r6 = vaddq_s32(mulhigh_s32(cos3, d.val[0]), mulhigh_s32(sin3, d.val[1]));
+				r7 = vsubq_s32(mulhigh_s32(cos3, d.val[1]), mulhigh_s32(sin3, d.val[0]));
+
+				t0 = r4;
+				t1 = r5;
+				r4 = vaddq_s32(t0, r6);
+				r5 = vsubq_s32(r7, t1);
+				r6 = vsubq_s32(t0, r6);
+				r7 = vaddq_s32(r7, t1);
+
+				d.val[0] = vaddq_s32(r0, r5);
+				d.val[1] = vaddq_s32(r1, r6);
+				c.val[0] = vsubq_s32(r2, r4);
+				c.val[1] = vsubq_s32(r3, r7);
+				b.val[0] = vsubq_s32(r0, r5);
+				b.val[1] = vsubq_s32(r1, r6);
+				a.val[0] = vaddq_s32(r2, r4);
+				a.val[1] = vaddq_s32(r3, r7);
+
+				vst2q_s32(xptr + 3*step, d);
+				vst2q_s32(xptr + 2*step, c);
+				vst2q_s32(xptr + step, b);
+				vst2q_s32(xptr, a);
+
+				xptr += 8;
+				csptr += 24;
+			}
+			xptr += 3*step;
+		}
+		twidTab += 3*step;
+		bgn <<= 2;
+	}
+}
+
+/*********************************************************************************
+*
+* function name: PreMDCT
+* description:  prepare MDCT process for next FFT compute
+*
+**********************************************************************************/
+void PreMDCT(int *buf0, int num, const int *csptr)
+{
+	int i;
+	int *buf1;
+
+	/* the 4 pairs at the end of the buffer, in reverse order */
+	buf1 = buf0 + num - 8;
+
+	for(i = num >> 4; i != 0; i--)
+	{
+		int32x4x4_t cs = vld4q_s32(csptr);
+		int32x4x2_t x0 = vld2q_s32(buf0);
+		int32x4x2_t x1 = vld2q_s32(buf1);
+		int32x4_t tr1 = x0.val[0];
+		int32x4_t ti2 = x0.val[1];
+		int32x4_t tr2 = reverse_s32(x1.val[0]);
+		int32x4_t ti1 = reverse_s32(x1.val[1]);
+
+		x0.val[0] = vaddq_s32(mulhigh_s32(cs.val[0], tr1), mulhigh_s32(cs.val[1], ti1));
+		x0.val[1] = vsubq_s32(mulhigh_s32(cs.val[0], ti1), mulhigh_s32(cs.val[1], tr1));
+
+		x1.val[1] = reverse_s32(
+				vsubq_s32(mulhigh_s32(cs.val[2], ti2), mulhigh_s32(cs.val[3], tr2)));
+		x1.val[0] = reverse_s32(
+				vaddq_s32(mulhigh_s32(cs.val[2], tr2), mulhigh_s32(cs.val[3], ti2)));
+
+		vst2q_s32(buf0, x0);
+		vst2q_s32(buf1, x1);
+
+		csptr += 16;
+		buf0 += 8;
+		buf1 -= 8;
+	}
+}
+
+/*********************************************************************************
+*
+* function name: PostMDCT
+* description:   post MDCT process after next FFT for MDCT
+*
+**********************************************************************************/
+void PostMDCT(int *buf0, int num, const int *csptr)
+{
+	int i;
+	int *buf1;
+
+	/* the 4 pairs at the end of the buffer, in reverse order */
+	buf1 = buf0 + num - 8;
+
+	for(i = num >> 4; i != 0; i--)
+	{
+		int32x4x4_t cs = vld4q_s32(csptr);
+		int32x4x2_t x0 = vld2q_s32(buf0);
+		int32x4x2_t x1 = vld2q_s32(buf1);
+		int32x4_t tr1 = x0.val[0];
+		int32x4_t ti1 = x0.val[1];
+		int32x4_t tr2 = reverse_s32(x1.val[0]);
+		int32x4_t ti2 = reverse_s32(x1.val[1]);
+
+		x0.val[0] = vaddq_s32(mulhigh_s32(cs.val[0], tr1), mulhigh_s32(cs.val[1], ti1));
+		x1.val[1] = reverse_s32(
+				vsubq_s32(mulhigh_s32(cs.val[1], tr1), mulhigh_s32(cs.val[0], ti1)));
+
+		x0.val[1] = vsubq_s32(mulhigh_s32(cs.val[3], tr2), mulhigh_s32(cs.val[2], ti2));
+		x1.val[0] = reverse_s32(
+				vaddq_s32(mulhigh_s32(cs.val[2], tr2), mulhigh_s32(cs.val[3], ti2)));
+
+		vst2q_s32(buf0, x0);
+		vst2q_s32(buf1, x1);
+
+		csptr += 16;
+		buf0 += 8;
+		buf1 -= 8;
+	}
+}
@@ -105,9 +105,11 @@ void SoftAMR::initPorts() {
     def.nBufferCountMin = kNumBuffers;
     def.nBufferCountActual = def.nBufferCountMin;
 
+    // An input buffer holding several frames is decoded into one output
+    // buffer, up to kMaxNumFramesPerOutputBuffer frames.
     def.nBufferSize =
         (mMode == MODE_NARROW ? kNumSamplesPerFrameNB : kNumSamplesPerFrameWB)
-            * sizeof(int16_t);
+            * sizeof(int16_t) * kMaxNumFramesPerOutputBuffer;
 
     def.bEnabled = OMX_TRUE;
     def.bPopulated = OMX_FALSE;
@@ -274,6 +276,77 @@ static size_t getFrameSize(unsigned FT) {
     return frameSize;
 }
 
+bool SoftAMR::decodeFrame(
+        const uint8_t *inputPtr, size_t inSize, int16_t *outPtr,
+        size_t *numBytesRead) {
+    if (mMode == MODE_NARROW) {
+        int32_t numBytes =
+            AMRDecode(mState,
+              (Frame_Type_3GPP)((inputPtr[0] >> 3) & 0x0f),
+              (UWord8 *)&inputPtr[1],
+              outPtr,
+              MIME_IETF);
+
+        if (numBytes == -1) {
+            ALOGE("PV AMR decoder AMRDecode() call failed");
+            return false;
+        }
+
+        ++numBytes;  // Include the frame type header byte.
+
+        if (static_cast<size_t>(numBytes) > inSize) {
+            // This is bad, should never have happened, but did. Abort now.
+            return false;
+        }
+
+        *numBytesRead = numBytes;
+        return true;
+    }
+
+    int16 mode = ((inputPtr[0] >> 3) & 0x0f);
+
+    if (mode >= 10 && mode <= 13) {
+        ALOGE("encountered illegal frame type %d in AMR WB content.", mode);
+        return false;
+    }
+
+    size_t frameSize = getFrameSize(mode);
+    if (inSize < frameSize) {
+        ALOGE("truncated AMR WB frame (%zu < %zu bytes).", inSize, frameSize);
+        return false;
+    }
+
+    if (mode >= 9) {
+        // Produce silence instead of comfort noise and for
+        // speech lost/no data.
+        memset(outPtr, 0, kNumSamplesPerFrameWB * sizeof(int16_t));
+    } else if (mode < 9) {
+        int16 frameType;
+        RX_State_wb rx_state;
+        mime_unsorting(
+                const_cast<uint8_t *>(&inputPtr[1]),
+                mInputSampleBuffer,
+                &frameType, &mode, 1, &rx_state);
+
+        int16_t numSamplesOutput;
+        pvDecoder_AmrWb(
+                mode, mInputSampleBuffer,
+                outPtr,
+                &numSamplesOutput,
+                mDecoderBuf, frameType, mDecoderCookie);
+
+        CHECK_EQ((int)numSamplesOutput, (int)kNumSamplesPerFrameWB);
+
+        for (int i = 0; i < kNumSamplesPerFrameWB; ++i) {
+            /* Delete the 2 LSBs (14-bit output) */
+            outPtr[i] &= 0xfffC;
+        }
+    }
+
+    *numBytesRead = frameSize;
+    return true;
+}
+
 void SoftAMR::onQueueFilled(OMX_U32 /* portIndex */) {
     List<BufferInfo *> &inQueue = getPortQueue(0);
     List<BufferInfo *> &outQueue = getPortQueue(1);
@@ -308,106 +381,49 @@ void SoftAMR::onQueueFilled(OMX_U32 /* portIndex */) {
             mNumSamplesOutput = 0;
         }
 
-        const uint8_t *inputPtr = inHeader->pBuffer + inHeader->nOffset;
-        int32_t numBytesRead;
-
-        if (mMode == MODE_NARROW) {
-            numBytesRead =
-                AMRDecode(mState,
-                  (Frame_Type_3GPP)((inputPtr[0] >> 3) & 0x0f),
-                  (UWord8 *)&inputPtr[1],
-                  reinterpret_cast<int16_t *>(outHeader->pBuffer),
-                  MIME_IETF);
-
-            if (numBytesRead == -1) {
-                ALOGE("PV AMR decoder AMRDecode() call failed");
-
-                notify(OMX_EventError, OMX_ErrorUndefined, 0, NULL);
-                mSignalledError = true;
-
-                return;
-            }
-
-            ++numBytesRead;  // Include the frame type header byte.
+        const int32_t sampleRate =
+            (mMode == MODE_NARROW) ? kSampleRateNB : kSampleRateWB;
+        const size_t numSamplesPerFrame =
+            (mMode == MODE_NARROW) ? kNumSamplesPerFrameNB : kNumSamplesPerFrameWB;
 
-            if (static_cast<size_t>(numBytesRead) > inHeader->nFilledLen) {
-                // This is bad, should never have happened, but did. Abort now.
+        if (outHeader->nAllocLen < numSamplesPerFrame * sizeof(int16_t)) {
+            ALOGE("output buffer too small (%u).", outHeader->nAllocLen);
 
-                notify(OMX_EventError, OMX_ErrorUndefined, 0, NULL);
-                mSignalledError = true;
+            notify(OMX_EventError, OMX_ErrorUndefined, 0, NULL);
+            mSignalledError = true;
 
-                return;
-            }
-        } else {
-            int16 mode = ((inputPtr[0] >> 3) & 0x0f);
-
-            if (mode >= 10 && mode <= 13) {
-                ALOGE("encountered illegal frame type %d in AMR WB content.",
-                      mode);
+            return;
+        }
 
+        outHeader->nFlags = 0;
+        outHeader->nOffset = 0;
+        outHeader->nFilledLen = 0;
+        outHeader->nTimeStamp =
+            mAnchorTimeUs + (mNumSamplesOutput * 1000000ll) / sampleRate;
+
+        // Decode as many of the frames in the input buffer as fit in the
+        // output buffer, the rest goes into the next output buffer.
+        while (inHeader->nFilledLen > 0
+                && outHeader->nFilledLen + numSamplesPerFrame * sizeof(int16_t)
+                        <= outHeader->nAllocLen) {
+            size_t numBytesRead;
+            if (!decodeFrame(
+                        inHeader->pBuffer + inHeader->nOffset,
+                        inHeader->nFilledLen,
+                        reinterpret_cast<int16_t *>(
+                                outHeader->pBuffer + outHeader->nFilledLen),
+                        &numBytesRead)) {
                 notify(OMX_EventError, OMX_ErrorUndefined, 0, NULL);
                 mSignalledError = true;
 
                 return;
             }
 
-            size_t frameSize = getFrameSize(mode);
-            CHECK_GE(inHeader->nFilledLen, frameSize);
-
-            int16_t *outPtr = (int16_t *)outHeader->pBuffer;
-
-            if (mode >= 9) {
-                // Produce silence instead of comfort noise and for
-                // speech lost/no data.
-                memset(outPtr, 0, kNumSamplesPerFrameWB * sizeof(int16_t));
-            } else if (mode < 9) {
-                int16 frameType;
-                RX_State_wb rx_state;
-                mime_unsorting(
-                        const_cast<uint8_t *>(&inputPtr[1]),
-                        mInputSampleBuffer,
-                        &frameType, &mode, 1, &rx_state);
-
-                int16_t numSamplesOutput;
-                pvDecoder_AmrWb(
-                        mode, mInputSampleBuffer,
-                        outPtr,
-                        &numSamplesOutput,
-                        mDecoderBuf, frameType, mDecoderCookie);
-
-                CHECK_EQ((int)numSamplesOutput, (int)kNumSamplesPerFrameWB);
-
-                for (int i = 0; i < kNumSamplesPerFrameWB; ++i) {
-                    /* Delete the 2 LSBs (14-bit output) */
-                    outPtr[i] &= 0xfffC;
-                }
-            }
-
-            numBytesRead = frameSize;
-        }
-
-        inHeader->nOffset += numBytesRead;
-        inHeader->nFilledLen -= numBytesRead;
-
-        outHeader->nFlags = 0;
-        outHeader->nOffset = 0;
-
-        if (mMode == MODE_NARROW) {
-            outHeader->nFilledLen = kNumSamplesPerFrameNB * sizeof(int16_t);
-
-            outHeader->nTimeStamp =
-                mAnchorTimeUs
-                    + (mNumSamplesOutput * 1000000ll) / kSampleRateNB;
-
-            mNumSamplesOutput += kNumSamplesPerFrameNB;
-        } else {
-            outHeader->nFilledLen = kNumSamplesPerFrameWB * sizeof(int16_t);
-
-            outHeader->nTimeStamp =
-                mAnchorTimeUs
-                    + (mNumSamplesOutput * 1000000ll) / kSampleRateWB;
+            inHeader->nOffset += numBytesRead;
+            inHeader->nFilledLen -= numBytesRead;
 
-            mNumSamplesOutput += kNumSamplesPerFrameWB;
+            outHeader->nFilledLen += numSamplesPerFrame * sizeof(int16_t);
+            mNumSamplesOutput += numSamplesPerFrame;
         }
 
         if (inHeader->nFilledLen == 0) {
@@ -49,6 +49,7 @@ private:
         kSampleRateWB           = 16000,
         kNumSamplesPerFrameNB   = 160,
         kNumSamplesPerFrameWB   = 320,
+        kMaxNumFramesPerOutputBuffer = 16,
     };
 
     enum {
@@ -79,6 +80,12 @@ private:
     status_t initDecoder();
     bool isConfigured() const;
 
+    // Decodes the frame at inputPtr, of at most inSize bytes, into one
+    // frame of samples at outPtr.
+    bool decodeFrame(
+            const uint8_t *inputPtr, size_t inSize, int16_t *outPtr,
+            size_t *numBytesRead);
+
     DISALLOW_EVIL_CONSTRUCTORS(SoftAMR);
 };
 
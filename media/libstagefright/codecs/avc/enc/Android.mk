@@ -18,6 +18,20 @@ LOCAL_SRC_FILES := \
     src/slice.cpp \
     src/vlc_encode.cpp
 
+# Motion search kernels, installed in AVCEncFuncPtr by PVAVCEncInitialize.
+LOCAL_SRC_FILES_arm64 := src/motion_est_neon.cpp
+LOCAL_CFLAGS_arm64 := -DAVCENC_NEON
+
+ifeq ($(ARCH_ARM_HAVE_NEON),true)
+    LOCAL_SRC_FILES_arm := src/motion_est_neon.cpp.neon
+    LOCAL_CFLAGS_arm := -DAVCENC_NEON
+endif
+
+LOCAL_SRC_FILES_x86 := src/motion_est_sse2.cpp
+LOCAL_CFLAGS_x86 := -DAVCENC_SSE2
+LOCAL_SRC_FILES_x86_64 := src/motion_est_sse2.cpp
+LOCAL_CFLAGS_x86_64 := -DAVCENC_SSE2
+
 
 LOCAL_MODULE := libstagefright_avcenc
 
@@ -138,6 +138,19 @@ static int32_t DpbAllocWrapper(void *userData,
     return encoder->allocOutputBuffers(sizeInMbs, numBuffers);
 }
 
+static size_t GetCPUCoreCount() {
+    long cpuCoreCount = 1;
+#if defined(_SC_NPROCESSORS_ONLN)
+    cpuCoreCount = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    // _SC_NPROC_ONLN must be defined...
+    cpuCoreCount = sysconf(_SC_NPROC_ONLN);
+#endif
+    CHECK(cpuCoreCount >= 1);
+    ALOGV("Number of CPU cores: %ld", cpuCoreCount);
+    return (size_t)cpuCoreCount;
+}
+
 static int32_t BindFrameWrapper(
         void *userData, int32_t index, uint8_t **yuv) {
     SoftAVCEncoder *encoder = static_cast<SoftAVCEncoder *>(userData);
@@ -164,6 +177,7 @@ SoftAVCEncoder::SoftAVCEncoder(
       mIDRFrameRefreshIntervalInSec(1),
       mAVCEncProfile(AVC_BASELINE),
       mAVCEncLevel(AVC_LEVEL2),
+      mNumMotionSearchThreads(0),
       mNumInputFrames(-1),
       mPrevTimestampUs(-1),
       mStarted(false),
@@ -242,6 +256,10 @@ OMX_ERRORTYPE SoftAVCEncoder::initEncParams() {
 
     mEncParams->use_overrun_buffer = AVC_OFF;
 
+    // the rows of a frame are searched in a wavefront, the output does not change
+    mEncParams->num_me_threads = mNumMotionSearchThreads > 0
+            ? mNumMotionSearchThreads : GetCPUCoreCount();
+
     if (mColorFormat != OMX_COLOR_FormatYUV420Planar || mInputDataIsMeta) {
         // Color conversion is needed.
         free(mInputFrameData);
@@ -365,7 +383,9 @@ void SoftAVCEncoder::releaseOutputBuffers() {
 
 OMX_ERRORTYPE SoftAVCEncoder::internalGetParameter(
         OMX_INDEXTYPE index, OMX_PTR params) {
-    switch (index) {
+    int32_t indexFull = index;
+
+    switch (indexFull) {
         case OMX_IndexParamVideoBitrate:
         {
             OMX_VIDEO_PARAM_BITRATETYPE *bitRate =
@@ -413,6 +433,18 @@ OMX_ERRORTYPE SoftAVCEncoder::internalGetParameter(
             return OMX_ErrorNone;
         }
 
+        case kMotionSearchThreadsIndex:
+        {
+            OMX_PARAM_U32TYPE *threadsParams = (OMX_PARAM_U32TYPE *)params;
+
+            if (threadsParams->nPortIndex != 1) {
+                return OMX_ErrorUndefined;
+            }
+
+            threadsParams->nU32 = mNumMotionSearchThreads;
+            return OMX_ErrorNone;
+        }
+
         default:
             return SoftVideoEncoderOMXComponent::internalGetParameter(index, params);
     }
@@ -470,11 +502,33 @@ OMX_ERRORTYPE SoftAVCEncoder::internalSetParameter(
             return OMX_ErrorNone;
         }
 
+        case kMotionSearchThreadsIndex:
+        {
+            const OMX_PARAM_U32TYPE *threadsParams = (const OMX_PARAM_U32TYPE *)params;
+
+            // takes effect when the encoder is (re)initialized
+            if (threadsParams->nPortIndex != 1 || mStarted) {
+                return OMX_ErrorUndefined;
+            }
+
+            mNumMotionSearchThreads = threadsParams->nU32;
+            return OMX_ErrorNone;
+        }
+
         default:
             return SoftVideoEncoderOMXComponent::internalSetParameter(index, params);
     }
 }
 
+OMX_ERRORTYPE SoftAVCEncoder::getExtensionIndex(
+        const char *name, OMX_INDEXTYPE *index) {
+    if (!strcmp(name, "OMX.google.android.index.motionSearchThreads")) {
+        *(int32_t*)index = kMotionSearchThreadsIndex;
+        return OMX_ErrorNone;
+    }
+    return SoftVideoEncoderOMXComponent::getExtensionIndex(name, index);
+}
+
 void SoftAVCEncoder::onQueueFilled(OMX_U32 /* portIndex */) {
     if (mSignalledError || mSawInputEOS) {
         return;
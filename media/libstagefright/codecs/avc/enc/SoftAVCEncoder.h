@@ -41,6 +41,9 @@ struct SoftAVCEncoder : public MediaBufferObserver,
     virtual OMX_ERRORTYPE internalSetParameter(
             OMX_INDEXTYPE index, const OMX_PTR params);
 
+    virtual OMX_ERRORTYPE getExtensionIndex(
+            const char *name, OMX_INDEXTYPE *index);
+
     virtual void onQueueFilled(OMX_U32 portIndex);
 
     // Implement MediaBufferObserver
@@ -60,6 +63,12 @@ private:
         kNumBuffers = 2,
     };
 
+    enum {
+        // OMX_PARAM_U32TYPE on the output port, the number of threads for motion
+        // estimation. 0 picks one per CPU core, 1 keeps it on the encoding thread.
+        kMotionSearchThreadsIndex = kPrepareForAdaptivePlaybackIndex + 1,
+    };
+
     // OMX input buffer's timestamp and flags
     typedef struct {
         int64_t mTimeUs;
@@ -70,6 +79,7 @@ private:
     AVCProfile mAVCEncProfile;
     AVCLevel   mAVCEncLevel;
 
+    OMX_U32  mNumMotionSearchThreads;
     int64_t  mNumInputFrames;
     int64_t  mPrevTimestampUs;
     bool     mStarted;
@@ -222,6 +222,20 @@ OSCL_EXPORT_REF AVCEnc_Status PVAVCEncInitialize(AVCHandle *avcHandle, AVCEncPar
     encvid->functionPointer->SAD_MB_HalfPel[1] = &AVCSAD_MB_HalfPel_Cxh;
     encvid->functionPointer->SAD_MB_HalfPel[2] = &AVCSAD_MB_HalfPel_Cyh;
     encvid->functionPointer->SAD_MB_HalfPel[3] = &AVCSAD_MB_HalfPel_Cxhyh;
+    encvid->functionPointer->GenerateHalfPelPred = &GenerateHalfPelPred;
+    encvid->functionPointer->GenerateQuartPelPred = &GenerateQuartPelPred;
+    encvid->functionPointer->SATD_MB = &SATD_MB;
+#if defined(AVCENC_NEON)
+    encvid->functionPointer->SAD_Macroblock = &AVCSAD_Macroblock_NEON;
+    encvid->functionPointer->GenerateHalfPelPred = &GenerateHalfPelPred_NEON;
+    encvid->functionPointer->GenerateQuartPelPred = &GenerateQuartPelPred_NEON;
+    encvid->functionPointer->SATD_MB = &SATD_MB_NEON;
+#elif defined(AVCENC_SSE2)
+    encvid->functionPointer->SAD_Macroblock = &AVCSAD_Macroblock_SSE2;
+    encvid->functionPointer->GenerateHalfPelPred = &GenerateHalfPelPred_SSE2;
+    encvid->functionPointer->GenerateQuartPelPred = &GenerateQuartPelPred_SSE2;
+    encvid->functionPointer->SATD_MB = &SATD_MB_SSE2;
+#endif
 
     /* initialize timing control */
     encvid->modTimeRef = 0;     /* ALWAYS ASSUME THAT TIMESTAMP START FROM 0 !!!*/
@@ -158,6 +158,9 @@ typedef struct tagAVCEncParam
 
     AVCFlag use_overrun_buffer;  /* do not throw away the frame if output buffer is not big enough.
                                     copy excess bits to the overrun buffer */
+
+    int num_me_threads; /* number of threads searching macroblock rows in parallel during
+                        motion estimation, 0 or 1 for none. The output is the same. */
 } AVCEncParams;
 
 
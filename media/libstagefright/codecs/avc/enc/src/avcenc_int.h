@@ -337,6 +337,11 @@ typedef struct tagAVCEncFuncPtr
     int (*SAD_MB_HalfPel[4])(uint8*, uint8*, int, void *);
     int (*SAD_Macroblock)(uint8 *ref, uint8 *blk, int dmin_lx, void *extra_info);
 
+    /* sub-pel search */
+    void (*GenerateHalfPelPred)(uint8 *subpel_pred, uint8 *ncand, int lx);
+    void (*GenerateQuartPelPred)(uint8 **bilin_base, uint8 *qpel_cand, int hpel_pos);
+    int (*SATD_MB)(uint8 *cand, uint8 *cur, int dmin);
+
 } AVCEncFuncPtr;
 
 /**
@@ -367,6 +372,12 @@ This structure is the main object for AVC encoder library providing access to al
 global variables. It is allocated at PVAVCInitEncoder and freed at PVAVCCleanUpEncoder.
 @publishedAll
 */
+/**
+This structure holds the worker threads for wavefront parallel motion estimation,
+it is private to motion_est.cpp.
+*/
+typedef struct tagAVCMEThreads AVCMEThreads;
+
 typedef struct tagEncObject
 {
 
@@ -440,6 +451,8 @@ typedef struct tagEncObject
 
     /* encoding complexity control */
     uint fullsearch_enable; /* flag to enable full-pel full-search */
+    int numMEThreads;       /* number of threads for motion estimation */
+    AVCMEThreads *meThreads; /* NULL if motion estimation is not threaded */
 
     /* misc.*/
     bool outOfBandParamSet; /* flag to enable out-of-band param set */
@@ -805,6 +805,22 @@ extern "C"
     int AVCSAD_MB_HalfPel_Cxh(uint8 *ref, uint8 *blk, int dmin_lx, void *extra_info);
     int AVCSAD_Macroblock_C(uint8 *ref, uint8 *blk, int dmin_lx, void *extra_info);
 
+#ifdef AVCENC_NEON
+    /*------------- motion_est_neon.cpp -------------*/
+    int AVCSAD_Macroblock_NEON(uint8 *ref, uint8 *blk, int dmin_lx, void *extra_info);
+    int SATD_MB_NEON(uint8 *cand, uint8 *cur, int dmin);
+    void GenerateHalfPelPred_NEON(uint8 *subpel_pred, uint8 *ncand, int lx);
+    void GenerateQuartPelPred_NEON(uint8 **bilin_base, uint8 *qpel_pred, int hpel_pos);
+#endif
+
+#ifdef AVCENC_SSE2
+    /*------------- motion_est_sse2.cpp -------------*/
+    int AVCSAD_Macroblock_SSE2(uint8 *ref, uint8 *blk, int dmin_lx, void *extra_info);
+    int SATD_MB_SSE2(uint8 *cand, uint8 *cur, int dmin);
+    void GenerateHalfPelPred_SSE2(uint8 *subpel_pred, uint8 *ncand, int lx);
+    void GenerateQuartPelPred_SSE2(uint8 **bilin_base, uint8 *qpel_pred, int hpel_pos);
+#endif
+
 #ifdef HTFM /*  3/2/1, Hypothesis Testing Fast Matching */
     int AVCSAD_MB_HP_HTFM_Collectxhyh(uint8 *ref, uint8 *blk, int dmin_x, void *extra_info);
     int AVCSAD_MB_HP_HTFM_Collectyh(uint8 *ref, uint8 *blk, int dmin_x, void *extra_info);
@@ -64,6 +64,7 @@ int AVCFindHalfPelMB(AVCEncObject *encvid, uint8 *cur, AVCMV *mot, uint8 *ncand,
     /* list of candidate to go through for half-pel search*/
     uint8 *subpel_pred = (uint8*) encvid->subpel_pred; // all 16 sub-pel positions
     uint8 **hpel_cand = (uint8**) encvid->hpel_cand; /* half-pel position */
+    int (*SATD_MB)(uint8*, uint8*, int) = encvid->functionPointer->SATD_MB;
 
     int xh[9] = {0, 0, 2, 2, 2, 0, -2, -2, -2};
     int yh[9] = {0, -2, -2, 0, 2, 2, 2, 0, -2};
@@ -75,14 +76,14 @@ int AVCFindHalfPelMB(AVCEncObject *encvid, uint8 *cur, AVCMV *mot, uint8 *ncand,
     OSCL_UNUSED_ARG(ypos);
     OSCL_UNUSED_ARG(hp_guess);
 
-    GenerateHalfPelPred(subpel_pred, ncand, lx);
+    (*encvid->functionPointer->GenerateHalfPelPred)(subpel_pred, ncand, lx);
 
     cur = encvid->currYMB; // pre-load current original MB
 
     cand = hpel_cand[0];
 
     // find cost for the current full-pel position
-    dmin = SATD_MB(cand, cur, 65535); // get Hadamaard transform SAD
+    dmin = (*SATD_MB)(cand, cur, 65535); // get Hadamaard transform SAD
     mvcost = MV_COST_S(lambda_motion, mot->x, mot->y, cmvx, cmvy);
     satd_min = dmin;
     dmin += mvcost;
@@ -91,7 +92,7 @@ int AVCFindHalfPelMB(AVCEncObject *encvid, uint8 *cur, AVCMV *mot, uint8 *ncand,
     /* find half-pel */
     for (h = 1; h < 9; h++)
     {
-        d = SATD_MB(hpel_cand[h], cur, dmin);
+        d = (*SATD_MB)(hpel_cand[h], cur, dmin);
         mvcost = MV_COST_S(lambda_motion, mot->x + xh[h], mot->y + yh[h], cmvx, cmvy);
         d += mvcost;
 
@@ -109,13 +110,14 @@ int AVCFindHalfPelMB(AVCEncObject *encvid, uint8 *cur, AVCMV *mot, uint8 *ncand,
     encvid->best_hpel_pos = hmin;
 
     /*** search for quarter-pel ****/
-    GenerateQuartPelPred(encvid->bilin_base[hmin], &(encvid->qpel_cand[0][0]), hmin);
+    (*encvid->functionPointer->GenerateQuartPelPred)(encvid->bilin_base[hmin],
+            &(encvid->qpel_cand[0][0]), hmin);
 
     encvid->best_qpel_pos = qmin = -1;
 
     for (q = 0; q < 8; q++)
     {
-        d = SATD_MB(encvid->qpel_cand[q], cur, dmin);
+        d = (*SATD_MB)(encvid->qpel_cand[q], cur, dmin);
         mvcost = MV_COST_S(lambda_motion, mot->x + xq[q], mot->y + yq[q], cmvx, cmvy);
         d += mvcost;
         if (d < dmin)
@@ -54,6 +54,8 @@ AVCEnc_Status  SetEncodeParam(AVCHandle* avcHandle, AVCEncParams* encParam,
     and VerifyLevel() functions later. */
 
     encvid->fullsearch_enable = encParam->fullsearch;
+    encvid->numMEThreads = encParam->num_me_threads;
+    encvid->meThreads = NULL;
 
     encvid->outOfBandParamSet = ((encParam->out_of_band_param_set == AVC_ON) ? TRUE : FALSE);
 
@@ -17,6 +17,8 @@
  */
 #include "avcenc_lib.h"
 
+#include <pthread.h>
+
 #define MIN_GOP     1   /* minimum size of GOP, 1/23/01, need to be tested */
 
 #define DEFAULT_REF_IDX     0  /* always from the first frame in the reflist */
@@ -64,6 +66,291 @@ uint32 num_cand = 0;
 #define FIXED_SUBMB_MODE    AVC_4x4
 /*************************************************************************/
 
+/*************************************************************************/
+/* Wavefront parallel motion estimation. The rows of macroblocks of a pass are handed
+   out to the encoding thread and (numMEThreads - 1) workers. A macroblock only starts
+   once the row above is done up to its top-right neighbor, the motion vectors it uses as
+   candidates from below and to the right are not overwritten yet, so the search results
+   are the same as those of the serial raster scan. */
+
+#define MAX_ME_THREADS  8
+
+typedef struct tagAVCMEWorker
+{
+    AVCMEThreads *threads;
+    pthread_t thread;
+    AVCEncObject encvid;    /* private copy, for the per-macroblock scratch memory */
+    AVCCommonObj common;
+} AVCMEWorker;
+
+struct tagAVCMEThreads
+{
+    pthread_mutex_t lock;
+    pthread_cond_t cond;    /* signals a new pass, row progress and the end of a pass */
+    int numWorkers;         /* worker[0] is used by the encoding thread */
+    AVCMEWorker *worker;
+    int *rowProgress;       /* the macroblocks before this one are done, for each row */
+    bool exit;
+
+    /* current pass */
+    int generation;
+    AVCEncObject *encvid;
+    int start_i;
+    int incr_i;
+    int type_pred;
+    int nextRow;
+    int rowsDone;
+    int NumIntraSearch;
+    int totalSAD;
+};
+
+static void AVCMotionEstimationRow(AVCEncObject *encvid, AVCMEThreads *threads, int j,
+                                   int start_i, int incr_i, int type_pred,
+                                   int *NumIntraSearch, int *totalSAD);
+
+static void AVCWaitForRowAbove(AVCMEThreads *threads, int j, int i, int mbwidth)
+{
+    int needed = (i + 2 < mbwidth) ? i + 2 : mbwidth;
+
+    if (j == 0)
+    {
+        return ;
+    }
+
+    pthread_mutex_lock(&threads->lock);
+    while (threads->rowProgress[j - 1] < needed)
+    {
+        pthread_cond_wait(&threads->cond, &threads->lock);
+    }
+    pthread_mutex_unlock(&threads->lock);
+}
+
+static void AVCSetRowProgress(AVCMEThreads *threads, int j, int progress, int mbwidth)
+{
+    pthread_mutex_lock(&threads->lock);
+    threads->rowProgress[j] = (progress < mbwidth) ? progress : mbwidth;
+    pthread_cond_broadcast(&threads->cond);
+    pthread_mutex_unlock(&threads->lock);
+}
+
+/* copy the encoder state to a worker, pointing its scratch memory to its own copy */
+static void AVCSetupMEWorker(AVCMEWorker *worker, AVCEncObject *encvid)
+{
+    uint8 *subpel_pred = (uint8*) encvid->subpel_pred;
+    uint8 *worker_subpel_pred = (uint8*) worker->encvid.subpel_pred;
+    int i, k;
+
+    worker->encvid = *encvid;
+    worker->common = *encvid->common;
+    worker->encvid.common = &worker->common;
+
+    for (i = 0; i < 9; i++)
+    {
+        worker->encvid.hpel_cand[i] = worker_subpel_pred + (encvid->hpel_cand[i] - subpel_pred);
+        for (k = 0; k < 4; k++)
+        {
+            worker->encvid.bilin_base[i][k] =
+                worker_subpel_pred + (encvid->bilin_base[i][k] - subpel_pred);
+        }
+    }
+}
+
+/* Searches rows of the pass |generation| until there are none left. */
+static void AVCMotionEstimationRows(AVCMEWorker *worker, int generation)
+{
+    AVCMEThreads *threads = worker->threads;
+    bool setup = false;
+    int j, start_i, NumIntraSearch, totalSAD;
+
+    pthread_mutex_lock(&threads->lock);
+    while (threads->generation == generation
+            && threads->nextRow < (int) threads->encvid->common->PicHeightInMbs)
+    {
+        j = threads->nextRow++;
+        start_i = threads->start_i;
+        if (threads->incr_i > 1)
+        {
+            start_i = start_i ^ 1 ^ (j & 1); /* toggle 0 and 1 as in the serial scan */
+        }
+        pthread_mutex_unlock(&threads->lock);
+
+        /* the pass cannot end before the claimed row is done, so the encoder state is
+           not changing while it is copied */
+        if (!setup)
+        {
+            AVCSetupMEWorker(worker, threads->encvid);
+            setup = true;
+        }
+
+        NumIntraSearch = 0;
+        totalSAD = 0;
+        AVCMotionEstimationRow(&worker->encvid, threads, j, start_i, threads->incr_i,
+                               threads->type_pred, &NumIntraSearch, &totalSAD);
+
+        pthread_mutex_lock(&threads->lock);
+        threads->NumIntraSearch += NumIntraSearch;
+        threads->totalSAD += totalSAD;
+        threads->rowsDone++;
+        pthread_cond_broadcast(&threads->cond);
+    }
+    pthread_mutex_unlock(&threads->lock);
+}
+
+static void *AVCMEWorkerMain(void *arg)
+{
+    AVCMEWorker *worker = (AVCMEWorker*) arg;
+    AVCMEThreads *threads = worker->threads;
+    int generation = 0;
+
+    pthread_mutex_lock(&threads->lock);
+    for (;;)
+    {
+        while (!threads->exit && threads->generation == generation)
+        {
+            pthread_cond_wait(&threads->cond, &threads->lock);
+        }
+        if (threads->exit)
+        {
+            break;
+        }
+        generation = threads->generation;
+        pthread_mutex_unlock(&threads->lock);
+
+        AVCMotionEstimationRows(worker, generation);
+
+        pthread_mutex_lock(&threads->lock);
+    }
+    pthread_mutex_unlock(&threads->lock);
+
+    return NULL;
+}
+
+/* One pass of AVCMotionEstimation() over all rows, using all threads. */
+static void AVCMotionEstimationPass(AVCMEThreads *threads, AVCEncObject *encvid,
+                                    int start_i, int incr_i, int type_pred,
+                                    int *NumIntraSearch, int *totalSAD)
+{
+    int mbheight = encvid->common->PicHeightInMbs;
+    int generation;
+
+    pthread_mutex_lock(&threads->lock);
+    memset(threads->rowProgress, 0, sizeof(int) * mbheight);
+    threads->encvid = encvid;
+    threads->start_i = start_i;
+    threads->incr_i = incr_i;
+    threads->type_pred = type_pred;
+    threads->nextRow = 0;
+    threads->rowsDone = 0;
+    threads->NumIntraSearch = 0;
+    threads->totalSAD = 0;
+    generation = ++threads->generation;
+    pthread_cond_broadcast(&threads->cond);
+    pthread_mutex_unlock(&threads->lock);
+
+    AVCMotionEstimationRows(&threads->worker[0], generation);
+
+    pthread_mutex_lock(&threads->lock);
+    while (threads->rowsDone < mbheight)
+    {
+        pthread_cond_wait(&threads->cond, &threads->lock);
+    }
+    *NumIntraSearch += threads->NumIntraSearch;
+    *totalSAD += threads->totalSAD;
+    pthread_mutex_unlock(&threads->lock);
+}
+
+static void CleanMotionSearchThreads(AVCHandle *avcHandle, AVCMEThreads *threads,
+                                     int numStarted)
+{
+    void *userData = avcHandle->userData;
+    int i;
+
+    pthread_mutex_lock(&threads->lock);
+    threads->exit = true;
+    pthread_cond_broadcast(&threads->cond);
+    pthread_mutex_unlock(&threads->lock);
+
+    for (i = 1; i < numStarted; i++)
+    {
+        pthread_join(threads->worker[i].thread, NULL);
+    }
+
+    pthread_cond_destroy(&threads->cond);
+    pthread_mutex_destroy(&threads->lock);
+
+    if (threads->rowProgress)
+    {
+        avcHandle->CBAVC_Free(userData, threads->rowProgress);
+    }
+    if (threads->worker)
+    {
+        avcHandle->CBAVC_Free(userData, threads->worker);
+    }
+    avcHandle->CBAVC_Free(userData, threads);
+}
+
+/* Starts the motion estimation workers. Motion estimation stays on the encoding thread
+   if that fails. */
+static void InitMotionSearchThreads(AVCHandle *avcHandle)
+{
+    AVCEncObject *encvid = (AVCEncObject*) avcHandle->AVCObject;
+    void *userData = avcHandle->userData;
+    int numWorkers = encvid->numMEThreads;
+    int mbheight = encvid->common->PicHeightInMbs;
+    AVCMEThreads *threads;
+    int i;
+
+    encvid->meThreads = NULL;
+
+    /* each thread handles at least two rows of a frame */
+    if (numWorkers > MAX_ME_THREADS)
+    {
+        numWorkers = MAX_ME_THREADS;
+    }
+    if (numWorkers > (mbheight >> 1))
+    {
+        numWorkers = mbheight >> 1;
+    }
+    if (numWorkers <= 1)
+    {
+        return ;
+    }
+
+    threads = (AVCMEThreads*) avcHandle->CBAVC_Malloc(userData, sizeof(AVCMEThreads), DEFAULT_ATTR);
+    if (threads == NULL)
+    {
+        return ;
+    }
+    memset(threads, 0, sizeof(AVCMEThreads));
+    pthread_mutex_init(&threads->lock, NULL);
+    pthread_cond_init(&threads->cond, NULL);
+
+    threads->worker = (AVCMEWorker*) avcHandle->CBAVC_Malloc(userData,
+                      sizeof(AVCMEWorker) * numWorkers, DEFAULT_ATTR);
+    threads->rowProgress = (int*) avcHandle->CBAVC_Malloc(userData,
+                           sizeof(int) * mbheight, DEFAULT_ATTR);
+    if (threads->worker == NULL || threads->rowProgress == NULL)
+    {
+        CleanMotionSearchThreads(avcHandle, threads, 0);
+        return ;
+    }
+
+    threads->numWorkers = numWorkers;
+    threads->worker[0].threads = threads;
+    for (i = 1; i < numWorkers; i++)
+    {
+        threads->worker[i].threads = threads;
+        if (pthread_create(&threads->worker[i].thread, NULL, AVCMEWorkerMain,
+                           &threads->worker[i]) != 0)
+        {
+            CleanMotionSearchThreads(avcHandle, threads, i);
+            return ;
+        }
+    }
+
+    encvid->meThreads = threads;
+}
+
 /* Initialize arrays necessary for motion search */
 AVCEnc_Status InitMotionSearchModule(AVCHandle *avcHandle)
 {
@@ -165,6 +452,7 @@ AVCEnc_Status InitMotionSearchModule(AVCHandle *avcHandle)
     encvid->bilin_base[8][2] = subpel_pred + V2Q_H0Q * SUBPEL_PRED_BLK_SIZE;
     encvid->bilin_base[8][3] = subpel_pred + V2Q_H2Q * SUBPEL_PRED_BLK_SIZE;
 
+    InitMotionSearchThreads(avcHandle);
 
     return AVCENC_SUCCESS;
 }
@@ -174,6 +462,12 @@ void CleanMotionSearchModule(AVCHandle *avcHandle)
 {
     AVCEncObject *encvid = (AVCEncObject*) avcHandle->AVCObject;
 
+    if (encvid->meThreads)
+    {
+        CleanMotionSearchThreads(avcHandle, encvid->meThreads, encvid->meThreads->numWorkers);
+        encvid->meThreads = NULL;
+    }
+
     if (encvid->mvbits_array)
     {
         avcHandle->CBAVC_Free(avcHandle->userData, encvid->mvbits_array);
@@ -232,45 +526,151 @@ bool IntraDecisionABE(int *min_cost, uint8 *cur, int pitch, bool ave)
     return intra;
 }
 
-/******* main function for macroblock prediction for the entire frame ***/
-/* if turns out to be IDR frame, set video->nal_unit_type to AVC_NALTYPE_IDR */
-void AVCMotionEstimation(AVCEncObject *encvid)
+/* Motion search of the macroblocks start_i, start_i + incr_i, ... of row j, accumulating
+   the statistics the scene change detection and rate control need. With wavefront
+   threads, each macroblock waits until the row above is done up to its top-right
+   neighbor, so that it sees the same motion vectors of its neighbors as in raster order. */
+static void AVCMotionEstimationRow(AVCEncObject *encvid, AVCMEThreads *threads, int j,
+                                   int start_i, int incr_i, int type_pred,
+                                   int *NumIntraSearch, int *totalSAD)
 {
     AVCCommonObj *video = encvid->common;
-    int slice_type = video->slice_type;
     AVCFrameIO *currInput = encvid->currInput;
-    AVCPictureData *refPic = video->RefPicList0[0];
-    int i, j, k;
+    int i, k;
     int mbwidth = video->PicWidthInMbs;
     int mbheight = video->PicHeightInMbs;
-    int totalMB = video->PicSizeInMbs;
     int pitch = currInput->pitch;
     AVCMacroblock *currMB, *mblock = video->mblock;
     AVCMV *mot_mb_16x16, *mot16x16 = encvid->mot16x16;
-    // AVCMV *mot_mb_16x8, *mot_mb_8x16, *mot_mb_8x8, etc;
     AVCRateControl *rateCtrl = encvid->rateCtrl;
     uint8 *intraSearch = encvid->intraSearch;
     uint FS_en = encvid->fullsearch_enable;
 
-    int NumIntraSearch, start_i, numLoop, incr_i;
     int mbnum, offset;
     uint8 *cur, *best_cand[5];
+    int abe_cost;
+    int hp_guess = 0;
+    uint32 mv_uint32;
+
+    offset = pitch * (j << 4) + (start_i << 4);
+
+    mbnum = j * mbwidth + start_i;
+
+    for (i = start_i; i < mbwidth; i += incr_i)
+    {
+        if (threads)
+        {
+            AVCWaitForRowAbove(threads, j, i, mbwidth);
+        }
+
+        video->mbNum = mbnum;
+        video->currMB = currMB = mblock + mbnum;
+        mot_mb_16x16 = mot16x16 + mbnum;
+
+        cur = currInput->YCbCr[0] + offset;
+
+        if (currMB->mb_intra == 0) /* for INTER mode */
+        {
+#if defined(HTFM)
+            HTFMPrepareCurMB_AVC(encvid, &encvid->htfm_stat, cur, pitch);
+#else
+            AVCPrepareCurMB(encvid, cur, pitch);
+#endif
+            /************************************************************/
+            /******** full-pel 1MV search **********************/
+
+            AVCMBMotionSearch(encvid, cur, best_cand, i << 4, j << 4, type_pred,
+                              FS_en, &hp_guess);
+
+            abe_cost = encvid->min_cost[mbnum] = mot_mb_16x16->sad;
+
+            /* set mbMode and MVs */
+            currMB->mbMode = AVC_P16;
+            currMB->MBPartPredMode[0][0] = AVC_Pred_L0;
+            mv_uint32 = ((mot_mb_16x16->y) << 16) | ((mot_mb_16x16->x) & 0xffff);
+            for (k = 0; k < 32; k += 2)
+            {
+                currMB->mvL0[k>>1] = mv_uint32;
+            }
+
+            /* make a decision whether it should be tested for intra or not */
+            if (i != mbwidth - 1 && j != mbheight - 1 && i != 0 && j != 0)
+            {
+                if (false == IntraDecisionABE(&abe_cost, cur, pitch, true))
+                {
+                    intraSearch[mbnum] = 0;
+                }
+                else
+                {
+                    (*NumIntraSearch)++;
+                    rateCtrl->MADofMB[mbnum] = abe_cost;
+                }
+            }
+            else // boundary MBs, always do intra search
+            {
+                (*NumIntraSearch)++;
+            }
+
+            *totalSAD += (int) rateCtrl->MADofMB[mbnum];//mot_mb_16x16->sad;
+        }
+        else    /* INTRA update, use for prediction */
+        {
+            mot_mb_16x16[0].x = mot_mb_16x16[0].y = 0;
+
+            /* reset all other MVs to zero */
+            /* mot_mb_16x8, mot_mb_8x16, mot_mb_8x8, etc. */
+            abe_cost = encvid->min_cost[mbnum] = 0x7FFFFFFF;  /* max value for int */
+
+            if (i != mbwidth - 1 && j != mbheight - 1 && i != 0 && j != 0)
+            {
+                IntraDecisionABE(&abe_cost, cur, pitch, false);
+
+                rateCtrl->MADofMB[mbnum] = abe_cost;
+                *totalSAD += abe_cost;
+            }
+
+            (*NumIntraSearch)++ ;
+            /* cannot do I16 prediction here because it needs full decoding. */
+            // intraSearch[mbnum] = 1;
+
+        }
+
+        if (threads)
+        {
+            AVCSetRowProgress(threads, j, i + incr_i, mbwidth);
+        }
+
+        mbnum += incr_i;
+        offset += (incr_i << 4);
+
+    } /* for i */
+}
+
+/******* main function for macroblock prediction for the entire frame ***/
+/* if turns out to be IDR frame, set video->nal_unit_type to AVC_NALTYPE_IDR */
+void AVCMotionEstimation(AVCEncObject *encvid)
+{
+    AVCCommonObj *video = encvid->common;
+    int slice_type = video->slice_type;
+    AVCPictureData *refPic = video->RefPicList0[0];
+    int i, j;
+    int mbheight = video->PicHeightInMbs;
+    int totalMB = video->PicSizeInMbs;
+    AVCMacroblock *mblock = video->mblock;
+    AVCRateControl *rateCtrl = encvid->rateCtrl;
+    uint8 *intraSearch = encvid->intraSearch;
+
+    int NumIntraSearch, start_i, numLoop, incr_i;
     int totalSAD = 0;   /* average SAD for rate control */
     int type_pred;
-    int abe_cost;
 
 #ifdef HTFM
     /***** HYPOTHESIS TESTING ********/  /* 2/28/01 */
     int collect = 0;
-    HTFM_Stat htfm_stat;
     double newvar[16];
     double exp_lamda[15];
     /*********************************/
 #endif
-    int hp_guess = 0;
-    uint32 mv_uint32;
-
-    offset = 0;
 
     if (slice_type == AVC_I_SLICE)
     {
@@ -309,7 +709,7 @@ void AVCMotionEstimation(AVCEncObject *encvid)
     encvid->sad_extra_info = NULL;
 #ifdef HTFM
     /***** HYPOTHESIS TESTING ********/
-    InitHTFM(video, &htfm_stat, newvar, &collect);
+    InitHTFM(video, &encvid->htfm_stat, newvar, &collect);
     /*********************************/
 #endif
 
@@ -336,94 +736,22 @@ void AVCMotionEstimation(AVCEncObject *encvid)
     NumIntraSearch = 0; // to be intra searched in the encoding loop.
     while (numLoop--)
     {
-        for (j = 0; j < mbheight; j++)
+        if (encvid->meThreads)
         {
-            if (incr_i > 1)
-                start_i = (start_i == 0 ? 1 : 0) ; /* toggle 0 and 1 */
-
-            offset = pitch * (j << 4) + (start_i << 4);
-
-            mbnum = j * mbwidth + start_i;
-
-            for (i = start_i; i < mbwidth; i += incr_i)
+            AVCMotionEstimationPass(encvid->meThreads, encvid, start_i, incr_i, type_pred,
+                                    &NumIntraSearch, &totalSAD);
+        }
+        else
+        {
+            for (j = 0; j < mbheight; j++)
             {
-                video->mbNum = mbnum;
-                video->currMB = currMB = mblock + mbnum;
-                mot_mb_16x16 = mot16x16 + mbnum;
-
-                cur = currInput->YCbCr[0] + offset;
-
-                if (currMB->mb_intra == 0) /* for INTER mode */
-                {
-#if defined(HTFM)
-                    HTFMPrepareCurMB_AVC(encvid, &htfm_stat, cur, pitch);
-#else
-                    AVCPrepareCurMB(encvid, cur, pitch);
-#endif
-                    /************************************************************/
-                    /******** full-pel 1MV search **********************/
+                if (incr_i > 1)
+                    start_i = (start_i == 0 ? 1 : 0) ; /* toggle 0 and 1 */
 
-                    AVCMBMotionSearch(encvid, cur, best_cand, i << 4, j << 4, type_pred,
-                                      FS_en, &hp_guess);
-
-                    abe_cost = encvid->min_cost[mbnum] = mot_mb_16x16->sad;
-
-                    /* set mbMode and MVs */
-                    currMB->mbMode = AVC_P16;
-                    currMB->MBPartPredMode[0][0] = AVC_Pred_L0;
-                    mv_uint32 = ((mot_mb_16x16->y) << 16) | ((mot_mb_16x16->x) & 0xffff);
-                    for (k = 0; k < 32; k += 2)
-                    {
-                        currMB->mvL0[k>>1] = mv_uint32;
-                    }
-
-                    /* make a decision whether it should be tested for intra or not */
-                    if (i != mbwidth - 1 && j != mbheight - 1 && i != 0 && j != 0)
-                    {
-                        if (false == IntraDecisionABE(&abe_cost, cur, pitch, true))
-                        {
-                            intraSearch[mbnum] = 0;
-                        }
-                        else
-                        {
-                            NumIntraSearch++;
-                            rateCtrl->MADofMB[mbnum] = abe_cost;
-                        }
-                    }
-                    else // boundary MBs, always do intra search
-                    {
-                        NumIntraSearch++;
-                    }
-
-                    totalSAD += (int) rateCtrl->MADofMB[mbnum];//mot_mb_16x16->sad;
-                }
-                else    /* INTRA update, use for prediction */
-                {
-                    mot_mb_16x16[0].x = mot_mb_16x16[0].y = 0;
-
-                    /* reset all other MVs to zero */
-                    /* mot_mb_16x8, mot_mb_8x16, mot_mb_8x8, etc. */
-                    abe_cost = encvid->min_cost[mbnum] = 0x7FFFFFFF;  /* max value for int */
-
-                    if (i != mbwidth - 1 && j != mbheight - 1 && i != 0 && j != 0)
-                    {
-                        IntraDecisionABE(&abe_cost, cur, pitch, false);
-
-                        rateCtrl->MADofMB[mbnum] = abe_cost;
-                        totalSAD += abe_cost;
-                    }
-
-                    NumIntraSearch++ ;
-                    /* cannot do I16 prediction here because it needs full decoding. */
-                    // intraSearch[mbnum] = 1;
-
-                }
-
-                mbnum += incr_i;
-                offset += (incr_i << 4);
-
-            } /* for i */
-        } /* for j */
+                AVCMotionEstimationRow(encvid, NULL, j, start_i, incr_i, type_pred,
+                                       &NumIntraSearch, &totalSAD);
+            } /* for j */
+        }
 
         /* since we cannot do intra/inter decision here, the SCD has to be
         based on other criteria such as motion vectors coherency or the SAD */
@@ -464,7 +792,7 @@ void AVCMotionEstimation(AVCEncObject *encvid)
     if (collect)
     {
         collect = 0;
-        UpdateHTFM(encvid, newvar, exp_lamda, &htfm_stat);
+        UpdateHTFM(encvid, newvar, exp_lamda, &encvid->htfm_stat);
     }
     /*********************************/
 #endif
@@ -0,0 +1,303 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* NEON versions of the motion search kernels in sad.cpp and findhalfpel.cpp.
+   The results are bit-exact with the C versions, so the encoder output does
+   not depend on which set of kernels is installed in AVCEncFuncPtr. */
+
+#include "avcenc_lib.h"
+
+#include <arm_neon.h>
+
+#define CLIP_RESULT(x)      if((uint)x > 0xFF){ \
+                 x = 0xFF & (~(x>>31));}
+
+static inline uint16x8_t paddq_u16(uint16x8_t a, uint16x8_t b)
+{
+#if defined(__aarch64__)
+    return vpaddq_u16(a, b);
+#else
+    return vcombine_u16(vpadd_u16(vget_low_u16(a), vget_high_u16(a)),
+                        vpadd_u16(vget_low_u16(b), vget_high_u16(b)));
+#endif
+}
+
+/* 6-tap filter (1, -5, 20, 20, -5, 1) on 16-bit lanes */
+static inline int16x8_t filter6_s16(int16x8_t a, int16x8_t b, int16x8_t c,
+                                    int16x8_t d, int16x8_t e, int16x8_t f)
+{
+    int16x8_t sum = vaddq_s16(a, f);
+    sum = vmlsq_n_s16(sum, vaddq_s16(b, e), 5);
+    return vmlaq_n_s16(sum, vaddq_s16(c, d), 20);
+}
+
+/* Filters 16 pixels from six rows (or columns) of 8-bit samples into
+   unrounded 16-bit sums, lo for the first 8 pixels and hi for the rest. */
+static inline void filter6_u8(const uint8x16_t p[6], int16x8_t *lo, int16x8_t *hi)
+{
+#define LO(x)   vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(x)))
+#define HI(x)   vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(x)))
+    *lo = filter6_s16(LO(p[0]), LO(p[1]), LO(p[2]), LO(p[3]), LO(p[4]), LO(p[5]));
+    *hi = filter6_s16(HI(p[0]), HI(p[1]), HI(p[2]), HI(p[3]), HI(p[4]), HI(p[5]));
+#undef LO
+#undef HI
+}
+
+/* 6-tap filter of the 16-bit horizontal sums, rounded and clipped to 8 bits */
+static inline uint8x8_t filter6_s16_clip10(const int16 *col)
+{
+    int16x8_t a = vld1q_s16(col);
+    int16x8_t b = vld1q_s16(col + 16);
+    int16x8_t c = vld1q_s16(col + 32);
+    int16x8_t d = vld1q_s16(col + 48);
+    int16x8_t e = vld1q_s16(col + 64);
+    int16x8_t f = vld1q_s16(col + 80);
+    int16x8_t be = vaddq_s16(b, e);
+    int16x8_t cd = vaddq_s16(c, d);
+
+    int32x4_t sum_lo = vaddl_s16(vget_low_s16(a), vget_low_s16(f));
+    int32x4_t sum_hi = vaddl_s16(vget_high_s16(a), vget_high_s16(f));
+    sum_lo = vmlsl_n_s16(sum_lo, vget_low_s16(be), 5);
+    sum_hi = vmlsl_n_s16(sum_hi, vget_high_s16(be), 5);
+    sum_lo = vmlal_n_s16(sum_lo, vget_low_s16(cd), 20);
+    sum_hi = vmlal_n_s16(sum_hi, vget_high_s16(cd), 20);
+
+    return vqmovn_u16(vcombine_u16(vqrshrun_n_s32(sum_lo, 10), vqrshrun_n_s32(sum_hi, 10)));
+}
+
+/* Same early termination as simd_sad_mb(): the SAD is checked against dmin
+   after every row and the partial sum is returned once it exceeds dmin. */
+static inline int sad_mb_neon(uint8 *ref, uint8 *blk, int lx, int dmin)
+{
+    uint32 rows[4];
+    int sad = 0;
+    int i, j;
+
+    for (j = 0; j < 16; j += 4)
+    {
+        uint16x8_t s0 = vpaddlq_u8(vabdq_u8(vld1q_u8(ref), vld1q_u8(blk)));
+        uint16x8_t s1 = vpaddlq_u8(vabdq_u8(vld1q_u8(ref + lx), vld1q_u8(blk + 16)));
+        uint16x8_t s2 = vpaddlq_u8(vabdq_u8(vld1q_u8(ref + 2 * lx), vld1q_u8(blk + 32)));
+        uint16x8_t s3 = vpaddlq_u8(vabdq_u8(vld1q_u8(ref + 3 * lx), vld1q_u8(blk + 48)));
+
+        /* reduce to one sum per row */
+        vst1q_u32(rows, vpaddlq_u16(paddq_u16(paddq_u16(s0, s1), paddq_u16(s2, s3))));
+
+        for (i = 0; i < 4; i++)
+        {
+            sad += rows[i];
+            if (sad > dmin)
+            {
+                return sad;
+            }
+        }
+
+        ref += (lx << 2);
+        blk += 64;
+    }
+
+    return sad;
+}
+
+int AVCSAD_Macroblock_NEON(uint8 *ref, uint8 *blk, int dmin_lx, void *extra_info)
+{
+    (void)(extra_info);
+
+    int dmin = (uint32)dmin_lx >> 16;
+    int lx = dmin_lx & 0xFFFF;
+
+    return sad_mb_neon(ref, blk, lx, dmin);
+}
+
+/* assuming cand always has a pitch of 24 */
+int SATD_MB_NEON(uint8 *cand, uint8 *cur, int dmin)
+{
+    return sad_mb_neon(cand, cur, 24, dmin);
+}
+
+void GenerateHalfPelPred_NEON(uint8 *subpel_pred, uint8 *ncand, int lx)
+{
+    uint8 *full = subpel_pred; /* 24x22 full-pel, starting at (-3,-3) */
+    uint8 *vert = subpel_pred + V2Q_H0Q * SUBPEL_PRED_BLK_SIZE;
+    uint8 *horz = subpel_pred + V0Q_H2Q * SUBPEL_PRED_BLK_SIZE;
+    uint8 *diag = subpel_pred + V2Q_H2Q * SUBPEL_PRED_BLK_SIZE;
+    int16 tmp_horz[22*16];  /* unrounded horizontal interp. of the first 16 columns */
+    int tmp_col16[22];      /* and of the 17th column */
+    uint8 *ref, *src;
+    uint8x16_t p[6];
+    int16x8_t lo, hi;
+    int32 tmp32;
+    int i, j, k;
+
+    /* first copy full-pel to the first array */
+    ref = ncand - 3 - lx - (lx << 1); /* move back (-3,-3) */
+    for (j = 0; j < 22; j++) /* 24x22 */
+    {
+        vst1q_u8(full + j * 24, vld1q_u8(ref));
+        vst1_u8(full + j * 24 + 16, vld1_u8(ref + 16));
+        ref += lx;
+    }
+
+    /* horizontal interp of all 22 rows, the middle 18 rows are the V0Q_H2Q
+       candidates and all of them feed the middle point filtering */
+    for (j = 0; j < 22; j++)
+    {
+        src = full + j * 24;
+        for (k = 0; k < 6; k++)
+        {
+            p[k] = vld1q_u8(src + k);
+        }
+        filter6_u8(p, &lo, &hi);
+        vst1q_s16(tmp_horz + j * 16, lo);
+        vst1q_s16(tmp_horz + j * 16 + 8, hi);
+
+        tmp_col16[j] = src[16] + src[21] - 5 * (src[17] + src[20]) + 20 * (src[18] + src[19]);
+
+        if (j >= 2 && j < 20)
+        {
+            vst1q_u8(horz + (j - 2) * 24,
+                     vcombine_u8(vqrshrun_n_s16(lo, 5), vqrshrun_n_s16(hi, 5)));
+
+            tmp32 = (tmp_col16[j] + 16) >> 5;
+            CLIP_RESULT(tmp32)
+            horz[(j - 2) * 24 + 16] = tmp32;
+        }
+    }
+
+    /* Do middle point filtering */
+    for (j = 0; j < 17; j++)
+    {
+        vst1q_u8(diag + j * 24, vcombine_u8(filter6_s16_clip10(tmp_horz + j * 16),
+                                            filter6_s16_clip10(tmp_horz + j * 16 + 8)));
+
+        int *col16 = tmp_col16 + j;
+        tmp32 = col16[0] + col16[5] - 5 * (col16[1] + col16[4]) + 20 * (col16[2] + col16[3]);
+        tmp32 = (tmp32 + 512) >> 10;
+        CLIP_RESULT(tmp32)
+        diag[j * 24 + 16] = tmp32;
+    }
+
+    /* do vertical interpolation */
+    /* The C version packs two pixels four columns apart into one word for all
+       but the first two columns, so a negative third or fourth filter output of
+       each group of four borrows one from its neighbor two columns to the right.
+       That neighbor rounds down by one if its sum is a multiple of 32. Do the
+       same here to stay bit-exact. */
+    static const uint16 kBorrowLanes[8] = { 0, 0, 0xFFFF, 0xFFFF, 0, 0, 0xFFFF, 0xFFFF };
+    const uint16x8_t borrow_lanes = vld1q_u16(kBorrowLanes);
+    const int16x8_t zero = vdupq_n_s16(0);
+    for (j = 0; j < 17; j++)
+    {
+        src = full + j * 24;
+
+        for (i = 0; i < 2; i++)
+        {
+            ref = src + 2 + i;
+            tmp32 = ref[0] + ref[120] - 5 * (ref[24] + ref[96]) + 20 * (ref[48] + ref[72]);
+            tmp32 = (tmp32 + 16) >> 5;
+            CLIP_RESULT(tmp32)
+            vert[j * 24 + i] = tmp32;
+        }
+
+        for (k = 0; k < 6; k++)
+        {
+            p[k] = vld1q_u8(src + 4 + k * 24);
+        }
+        filter6_u8(p, &lo, &hi);
+
+        int16x8_t half[2] = { lo, hi };
+        for (i = 0; i < 2; i++)
+        {
+            int16x8_t sum = vaddq_s16(half[i], vdupq_n_s16(16));
+            uint16x8_t borrow = vandq_u16(borrow_lanes,
+                    vcltq_s16(vextq_s16(zero, sum, 6), zero));
+            borrow = vandq_u16(borrow, vceqq_s16(vandq_s16(sum, vdupq_n_s16(31)), zero));
+            borrow = vandq_u16(borrow, vcgtq_s16(sum, zero));
+            borrow = vandq_u16(borrow, vcltq_s16(sum, vdupq_n_s16(8192)));
+            half[i] = vaddq_s16(vshrq_n_s16(sum, 5), vreinterpretq_s16_u16(borrow));
+        }
+        vst1q_u8(vert + j * 24 + 2, vcombine_u8(vqmovun_s16(half[0]), vqmovun_s16(half[1])));
+    }
+
+    return ;
+}
+
+void GenerateQuartPelPred_NEON(uint8 **bilin_base, uint8 *qpel_cand, int hpel_pos)
+{
+    // for even value of hpel_pos, start with pattern 1, otherwise, start with pattern 2
+    uint8 *tl = bilin_base[0];
+    uint8 *tr = bilin_base[1];
+    uint8 *bl = bilin_base[2];
+    uint8 *br = bilin_base[3];
+    uint8 *c1 = qpel_cand;
+    int j;
+
+#define STORE(q, v)     vst1q_u8(c1 + (q) * 384, v)
+
+    if (!(hpel_pos&1)) // diamond pattern
+    {
+        for (j = 0; j < 16; j++)
+        {
+            uint8x16_t a = vld1q_u8(tr);
+            uint8x16_t b1 = vld1q_u8(bl + 1);
+            uint8x16_t b0 = vld1q_u8(bl);
+            uint8x16_t c = vld1q_u8(br);
+            uint8x16_t d = vld1q_u8(tr + 24);
+
+            STORE(0, vrhaddq_u8(c, a));
+            STORE(1, vrhaddq_u8(b1, a));
+            STORE(2, vrhaddq_u8(b1, c));
+            STORE(3, vrhaddq_u8(b1, d));
+            STORE(4, vrhaddq_u8(c, d));
+            STORE(5, vrhaddq_u8(b0, d));
+            STORE(6, vrhaddq_u8(b0, c));
+            STORE(7, vrhaddq_u8(b0, a));
+
+            // advance to the next line, pitch is 24
+            tr += 24;
+            bl += 24;
+            br += 24;
+            c1 += 24;
+        }
+    }
+    else // star pattern
+    {
+        for (j = 0; j < 16; j++)
+        {
+            uint8x16_t a = vld1q_u8(br);
+
+            STORE(0, vrhaddq_u8(a, vld1q_u8(tr)));
+            STORE(1, vrhaddq_u8(a, vld1q_u8(tl + 1)));
+            STORE(2, vrhaddq_u8(a, vld1q_u8(bl + 1)));
+            STORE(3, vrhaddq_u8(a, vld1q_u8(tl + 25)));
+            STORE(4, vrhaddq_u8(a, vld1q_u8(tr + 24)));
+            STORE(5, vrhaddq_u8(a, vld1q_u8(tl + 24)));
+            STORE(6, vrhaddq_u8(a, vld1q_u8(bl)));
+            STORE(7, vrhaddq_u8(a, vld1q_u8(tl)));
+
+            // advance to the next line, pitch is 24
+            tl += 24;
+            tr += 24;
+            bl += 24;
+            br += 24;
+            c1 += 24;
+        }
+    }
+
+#undef STORE
+
+    return ;
+}
@@ -0,0 +1,314 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* SSE2 versions of the motion search kernels in sad.cpp and findhalfpel.cpp.
+   The results are bit-exact with the C versions, so the encoder output does
+   not depend on which set of kernels is installed in AVCEncFuncPtr. */
+
+#include "avcenc_lib.h"
+
+#include <emmintrin.h>
+
+#define CLIP_RESULT(x)      if((uint)x > 0xFF){ \
+                 x = 0xFF & (~(x>>31));}
+
+/* 6-tap filter (1, -5, 20, 20, -5, 1) on 16-bit lanes */
+static inline __m128i filter6_epi16(__m128i a, __m128i b, __m128i c,
+                                    __m128i d, __m128i e, __m128i f)
+{
+    __m128i be = _mm_add_epi16(b, e);
+    __m128i cd = _mm_add_epi16(c, d);
+    __m128i sum = _mm_add_epi16(a, f);
+    sum = _mm_sub_epi16(sum, _mm_add_epi16(_mm_slli_epi16(be, 2), be));
+    return _mm_add_epi16(sum, _mm_add_epi16(_mm_slli_epi16(cd, 4), _mm_slli_epi16(cd, 2)));
+}
+
+/* Filters 16 pixels from six rows (or columns) of 8-bit samples into
+   unrounded 16-bit sums, lo for the first 8 pixels and hi for the rest. */
+static inline void filter6_u8(const __m128i p[6], __m128i *lo, __m128i *hi)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    *lo = filter6_epi16(_mm_unpacklo_epi8(p[0], zero), _mm_unpacklo_epi8(p[1], zero),
+                        _mm_unpacklo_epi8(p[2], zero), _mm_unpacklo_epi8(p[3], zero),
+                        _mm_unpacklo_epi8(p[4], zero), _mm_unpacklo_epi8(p[5], zero));
+    *hi = filter6_epi16(_mm_unpackhi_epi8(p[0], zero), _mm_unpackhi_epi8(p[1], zero),
+                        _mm_unpackhi_epi8(p[2], zero), _mm_unpackhi_epi8(p[3], zero),
+                        _mm_unpackhi_epi8(p[4], zero), _mm_unpackhi_epi8(p[5], zero));
+}
+
+/* Same early termination as simd_sad_mb(): the SAD is checked against dmin
+   after every row and the partial sum is returned once it exceeds dmin. */
+static inline int sad_mb_sse2(uint8 *ref, uint8 *blk, int lx, int dmin)
+{
+    int32 rows[4];
+    int sad = 0;
+    int i, j;
+
+    for (j = 0; j < 16; j += 4)
+    {
+        __m128i s0 = _mm_sad_epu8(_mm_loadu_si128((const __m128i*) ref),
+                                  _mm_loadu_si128((const __m128i*) blk));
+        __m128i s1 = _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(ref + lx)),
+                                  _mm_loadu_si128((const __m128i*)(blk + 16)));
+        __m128i s2 = _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(ref + 2 * lx)),
+                                  _mm_loadu_si128((const __m128i*)(blk + 32)));
+        __m128i s3 = _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(ref + 3 * lx)),
+                                  _mm_loadu_si128((const __m128i*)(blk + 48)));
+
+        /* gather the two halves of each row sum, then add them up */
+        __m128i s01 = _mm_or_si128(s0, _mm_slli_si128(s1, 4));
+        __m128i s23 = _mm_or_si128(s2, _mm_slli_si128(s3, 4));
+        _mm_storeu_si128((__m128i*) rows, _mm_add_epi32(_mm_unpacklo_epi64(s01, s23),
+                         _mm_unpackhi_epi64(s01, s23)));
+
+        for (i = 0; i < 4; i++)
+        {
+            sad += rows[i];
+            if (sad > dmin)
+            {
+                return sad;
+            }
+        }
+
+        ref += (lx << 2);
+        blk += 64;
+    }
+
+    return sad;
+}
+
+int AVCSAD_Macroblock_SSE2(uint8 *ref, uint8 *blk, int dmin_lx, void *extra_info)
+{
+    (void)(extra_info);
+
+    int dmin = (uint32)dmin_lx >> 16;
+    int lx = dmin_lx & 0xFFFF;
+
+    return sad_mb_sse2(ref, blk, lx, dmin);
+}
+
+/* assuming cand always has a pitch of 24 */
+int SATD_MB_SSE2(uint8 *cand, uint8 *cur, int dmin)
+{
+    return sad_mb_sse2(cand, cur, 24, dmin);
+}
+
+void GenerateHalfPelPred_SSE2(uint8 *subpel_pred, uint8 *ncand, int lx)
+{
+    uint8 *full = subpel_pred; /* 24x22 full-pel, starting at (-3,-3) */
+    uint8 *vert = subpel_pred + V2Q_H0Q * SUBPEL_PRED_BLK_SIZE;
+    uint8 *horz = subpel_pred + V0Q_H2Q * SUBPEL_PRED_BLK_SIZE;
+    uint8 *diag = subpel_pred + V2Q_H2Q * SUBPEL_PRED_BLK_SIZE;
+    int16 tmp_horz[22*16];  /* unrounded horizontal interp. of the first 16 columns */
+    int tmp_col16[22];      /* and of the 17th column */
+    uint8 *ref, *src;
+    __m128i p[6], lo, hi;
+    int32 tmp32;
+    int i, j, k;
+
+    const __m128i round5 = _mm_set1_epi16(16);
+    const __m128i round10 = _mm_set1_epi32(512);
+
+    /* first copy full-pel to the first array */
+    ref = ncand - 3 - lx - (lx << 1); /* move back (-3,-3) */
+    for (j = 0; j < 22; j++) /* 24x22 */
+    {
+        _mm_storeu_si128((__m128i*)(full + j * 24), _mm_loadu_si128((const __m128i*) ref));
+        _mm_storel_epi64((__m128i*)(full + j * 24 + 16), _mm_loadl_epi64((const __m128i*)(ref + 16)));
+        ref += lx;
+    }
+
+    /* horizontal interp of all 22 rows, the middle 18 rows are the V0Q_H2Q
+       candidates and all of them feed the middle point filtering */
+    for (j = 0; j < 22; j++)
+    {
+        src = full + j * 24;
+        for (k = 0; k < 6; k++)
+        {
+            p[k] = _mm_loadu_si128((const __m128i*)(src + k));
+        }
+        filter6_u8(p, &lo, &hi);
+        _mm_storeu_si128((__m128i*)(tmp_horz + j * 16), lo);
+        _mm_storeu_si128((__m128i*)(tmp_horz + j * 16 + 8), hi);
+
+        tmp_col16[j] = src[16] + src[21] - 5 * (src[17] + src[20]) + 20 * (src[18] + src[19]);
+
+        if (j >= 2 && j < 20)
+        {
+            lo = _mm_srai_epi16(_mm_add_epi16(lo, round5), 5);
+            hi = _mm_srai_epi16(_mm_add_epi16(hi, round5), 5);
+            _mm_storeu_si128((__m128i*)(horz + (j - 2) * 24), _mm_packus_epi16(lo, hi));
+
+            tmp32 = (tmp_col16[j] + 16) >> 5;
+            CLIP_RESULT(tmp32)
+            horz[(j - 2) * 24 + 16] = tmp32;
+        }
+    }
+
+    /* Do middle point filtering */
+    const __m128i coef_ab = _mm_set_epi16(-5, 1, -5, 1, -5, 1, -5, 1);
+    const __m128i coef_cd = _mm_set1_epi16(20);
+    const __m128i coef_ef = _mm_set_epi16(1, -5, 1, -5, 1, -5, 1, -5);
+    for (j = 0; j < 17; j++)
+    {
+        __m128i out[2];
+        for (i = 0; i < 2; i++)
+        {
+            const int16 *col = tmp_horz + j * 16 + i * 8;
+            __m128i a = _mm_loadu_si128((const __m128i*) col);
+            __m128i b = _mm_loadu_si128((const __m128i*)(col + 16));
+            __m128i c = _mm_loadu_si128((const __m128i*)(col + 32));
+            __m128i d = _mm_loadu_si128((const __m128i*)(col + 48));
+            __m128i e = _mm_loadu_si128((const __m128i*)(col + 64));
+            __m128i f = _mm_loadu_si128((const __m128i*)(col + 80));
+
+            __m128i sum_lo = _mm_add_epi32(
+                    _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(a, b), coef_ab),
+                                  _mm_madd_epi16(_mm_unpacklo_epi16(c, d), coef_cd)),
+                    _mm_madd_epi16(_mm_unpacklo_epi16(e, f), coef_ef));
+            __m128i sum_hi = _mm_add_epi32(
+                    _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(a, b), coef_ab),
+                                  _mm_madd_epi16(_mm_unpackhi_epi16(c, d), coef_cd)),
+                    _mm_madd_epi16(_mm_unpackhi_epi16(e, f), coef_ef));
+
+            sum_lo = _mm_srai_epi32(_mm_add_epi32(sum_lo, round10), 10);
+            sum_hi = _mm_srai_epi32(_mm_add_epi32(sum_hi, round10), 10);
+            out[i] = _mm_packs_epi32(sum_lo, sum_hi);
+        }
+        _mm_storeu_si128((__m128i*)(diag + j * 24), _mm_packus_epi16(out[0], out[1]));
+
+        int *col16 = tmp_col16 + j;
+        tmp32 = col16[0] + col16[5] - 5 * (col16[1] + col16[4]) + 20 * (col16[2] + col16[3]);
+        tmp32 = (tmp32 + 512) >> 10;
+        CLIP_RESULT(tmp32)
+        diag[j * 24 + 16] = tmp32;
+    }
+
+    /* do vertical interpolation */
+    /* The C version packs two pixels four columns apart into one word for all
+       but the first two columns, so a negative third or fourth filter output of
+       each group of four borrows one from its neighbor two columns to the right.
+       That neighbor rounds down by one if its sum is a multiple of 32. Do the
+       same here to stay bit-exact. */
+    const __m128i borrow_lanes = _mm_set_epi16(-1, -1, 0, 0, -1, -1, 0, 0);
+    const __m128i mask31 = _mm_set1_epi16(31);
+    const __m128i max_sum = _mm_set1_epi16(8192);
+    const __m128i zero = _mm_setzero_si128();
+    for (j = 0; j < 17; j++)
+    {
+        src = full + j * 24;
+
+        for (i = 0; i < 2; i++)
+        {
+            ref = src + 2 + i;
+            tmp32 = ref[0] + ref[120] - 5 * (ref[24] + ref[96]) + 20 * (ref[48] + ref[72]);
+            tmp32 = (tmp32 + 16) >> 5;
+            CLIP_RESULT(tmp32)
+            vert[j * 24 + i] = tmp32;
+        }
+
+        for (k = 0; k < 6; k++)
+        {
+            p[k] = _mm_loadu_si128((const __m128i*)(src + 4 + k * 24));
+        }
+        filter6_u8(p, &lo, &hi);
+
+        __m128i half[2] = { lo, hi };
+        for (i = 0; i < 2; i++)
+        {
+            __m128i sum = _mm_add_epi16(half[i], round5);
+            __m128i borrow = _mm_and_si128(borrow_lanes,
+                    _mm_cmplt_epi16(_mm_slli_si128(sum, 4), zero));
+            borrow = _mm_and_si128(borrow, _mm_cmpeq_epi16(_mm_and_si128(sum, mask31), zero));
+            borrow = _mm_and_si128(borrow, _mm_cmpgt_epi16(sum, zero));
+            borrow = _mm_and_si128(borrow, _mm_cmplt_epi16(sum, max_sum));
+            half[i] = _mm_add_epi16(_mm_srai_epi16(sum, 5), borrow);
+        }
+        _mm_storeu_si128((__m128i*)(vert + j * 24 + 2), _mm_packus_epi16(half[0], half[1]));
+    }
+
+    return ;
+}
+
+void GenerateQuartPelPred_SSE2(uint8 **bilin_base, uint8 *qpel_cand, int hpel_pos)
+{
+    // for even value of hpel_pos, start with pattern 1, otherwise, start with pattern 2
+    uint8 *tl = bilin_base[0];
+    uint8 *tr = bilin_base[1];
+    uint8 *bl = bilin_base[2];
+    uint8 *br = bilin_base[3];
+    uint8 *c1 = qpel_cand;
+    int j;
+
+#define LOAD(p)         _mm_loadu_si128((const __m128i*)(p))
+#define STORE(q, v)     _mm_storeu_si128((__m128i*)(c1 + (q) * 384), v)
+
+    if (!(hpel_pos&1)) // diamond pattern
+    {
+        for (j = 0; j < 16; j++)
+        {
+            __m128i a = LOAD(tr);
+            __m128i b1 = LOAD(bl + 1);
+            __m128i b0 = LOAD(bl);
+            __m128i c = LOAD(br);
+            __m128i d = LOAD(tr + 24);
+
+            STORE(0, _mm_avg_epu8(c, a));
+            STORE(1, _mm_avg_epu8(b1, a));
+            STORE(2, _mm_avg_epu8(b1, c));
+            STORE(3, _mm_avg_epu8(b1, d));
+            STORE(4, _mm_avg_epu8(c, d));
+            STORE(5, _mm_avg_epu8(b0, d));
+            STORE(6, _mm_avg_epu8(b0, c));
+            STORE(7, _mm_avg_epu8(b0, a));
+
+            // advance to the next line, pitch is 24
+            tr += 24;
+            bl += 24;
+            br += 24;
+            c1 += 24;
+        }
+    }
+    else // star pattern
+    {
+        for (j = 0; j < 16; j++)
+        {
+            __m128i a = LOAD(br);
+
+            STORE(0, _mm_avg_epu8(a, LOAD(tr)));
+            STORE(1, _mm_avg_epu8(a, LOAD(tl + 1)));
+            STORE(2, _mm_avg_epu8(a, LOAD(bl + 1)));
+            STORE(3, _mm_avg_epu8(a, LOAD(tl + 25)));
+            STORE(4, _mm_avg_epu8(a, LOAD(tr + 24)));
+            STORE(5, _mm_avg_epu8(a, LOAD(tl + 24)));
+            STORE(6, _mm_avg_epu8(a, LOAD(bl)));
+            STORE(7, _mm_avg_epu8(a, LOAD(tl)));
+
+            // advance to the next line, pitch is 24
+            tl += 24;
+            tr += 24;
+            bl += 24;
+            br += 24;
+            c1 += 24;
+        }
+    }
+
+#undef LOAD
+#undef STORE
+
+    return ;
+}
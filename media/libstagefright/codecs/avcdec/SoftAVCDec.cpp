@@ -116,6 +116,7 @@ SoftAVC::SoftAVC(
             appData, component),
       mCodecCtx(NULL),
       mFlushOutBuffer(NULL),
+      mBounceBuffer(NULL),
       mOmxColorFormat(OMX_COLOR_FormatYUV420Planar),
       mIvColorFormat(IV_YUV_420P),
       mChangingResolution(false),
@@ -123,6 +124,7 @@ SoftAVC::SoftAVC(
       mStride(mWidth){
     initPorts(
             kNumBuffers, INPUT_BUF_SIZE, kNumBuffers, CODEC_MIME_TYPE);
+    supportNativeBuffers();
 
     GETTIME(&mTimeStart, NULL);
 
@@ -146,19 +148,6 @@ static void ivd_aligned_free(void *ctxt, void *buf) {
     return;
 }
 
-static size_t GetCPUCoreCount() {
-    long cpuCoreCount = 1;
-#if defined(_SC_NPROCESSORS_ONLN)
-    cpuCoreCount = sysconf(_SC_NPROCESSORS_ONLN);
-#else
-    // _SC_NPROC_ONLN must be defined...
-    cpuCoreCount = sysconf(_SC_NPROC_ONLN);
-#endif
-    CHECK(cpuCoreCount >= 1);
-    ALOGV("Number of CPU cores: %ld", cpuCoreCount);
-    return (size_t)cpuCoreCount;
-}
-
 void SoftAVC::logVersion() {
     ivd_ctl_getversioninfo_ip_t s_ctl_ip;
     ivd_ctl_getversioninfo_op_t s_ctl_op;
@@ -244,6 +233,9 @@ status_t SoftAVC::resetDecoder() {
     /* Set number of cores/threads to be used by the codec */
     setNumCores();
 
+    /* The output buffers may have a new size */
+    freeBounceBuffer();
+
     mStride = 0;
     return OK;
 }
@@ -254,7 +246,8 @@ status_t SoftAVC::setNumCores() {
     IV_API_CALL_STATUS_T status;
     s_set_cores_ip.e_cmd = IVD_CMD_VIDEO_CTL;
     s_set_cores_ip.e_sub_cmd = IVDEXT_CMD_CTL_SET_NUM_CORES;
-    s_set_cores_ip.u4_num_cores = MIN(mNumCores, CODEC_MAX_NUM_CORES);
+    mNumCores = acquireDecoderCores(CODEC_MAX_NUM_CORES);
+    s_set_cores_ip.u4_num_cores = mNumCores;
     s_set_cores_ip.u4_size = sizeof(ivdext_ctl_set_num_cores_ip_t);
     s_set_cores_op.u4_size = sizeof(ivdext_ctl_set_num_cores_op_t);
     status = ivdec_api_function(
@@ -294,7 +287,6 @@ status_t SoftAVC::setFlushMode() {
 status_t SoftAVC::initDecoder() {
     IV_API_CALL_STATUS_T status;
 
-    mNumCores = GetCPUCoreCount();
     mCodecCtx = NULL;
 
     mStride = outputBufferWidth();
@@ -368,6 +360,8 @@ status_t SoftAVC::deInitDecoder() {
     }
 
 
+    freeBounceBuffer();
+    releaseDecoderCores();
     mChangingResolution = false;
 
     return OK;
@@ -385,11 +379,10 @@ void SoftAVC::setDecodeArgs(
         ivd_video_decode_ip_t *ps_dec_ip,
         ivd_video_decode_op_t *ps_dec_op,
         OMX_BUFFERHEADERTYPE *inHeader,
-        OMX_BUFFERHEADERTYPE *outHeader,
+        const OutputPlanes *outPlanes,
         size_t timeStampIx) {
-    size_t sizeY = outputBufferWidth() * outputBufferHeight();
-    size_t sizeUV;
-    uint8_t *pBuf;
+    OutputPlanes flushPlanes;
+    size_t sizeY, sizeUV;
 
     ps_dec_ip->u4_size = sizeof(ivd_video_decode_ip_t);
     ps_dec_op->u4_size = sizeof(ivd_video_decode_op_t);
@@ -409,28 +402,77 @@ void SoftAVC::setDecodeArgs(
         ps_dec_ip->u4_num_Bytes = 0;
     }
 
-    if (outHeader) {
-        pBuf = outHeader->pBuffer;
-    } else {
-        pBuf = mFlushOutBuffer;
+    /* The frames flushed out of the decoder are dropped */
+    if (NULL == outPlanes) {
+        flushPlanes.mYStride = outputBufferWidth();
+        flushPlanes.mUVStride = flushPlanes.mYStride / 2;
+        flushPlanes.mY = mFlushOutBuffer;
+        flushPlanes.mU = flushPlanes.mY + flushPlanes.mYStride * outputBufferHeight();
+        flushPlanes.mV = flushPlanes.mU + flushPlanes.mUVStride * (outputBufferHeight() / 2);
+        outPlanes = &flushPlanes;
     }
 
+    sizeY = outPlanes->mYStride * outputBufferHeight();
     sizeUV = sizeY / 4;
     ps_dec_ip->s_out_buffer.u4_min_out_buf_size[0] = sizeY;
     ps_dec_ip->s_out_buffer.u4_min_out_buf_size[1] = sizeUV;
     ps_dec_ip->s_out_buffer.u4_min_out_buf_size[2] = sizeUV;
 
-    ps_dec_ip->s_out_buffer.pu1_bufs[0] = pBuf;
-    ps_dec_ip->s_out_buffer.pu1_bufs[1] = pBuf + sizeY;
-    ps_dec_ip->s_out_buffer.pu1_bufs[2] = pBuf + sizeY + sizeUV;
+    ps_dec_ip->s_out_buffer.pu1_bufs[0] = outPlanes->mY;
+    ps_dec_ip->s_out_buffer.pu1_bufs[1] = outPlanes->mU;
+    ps_dec_ip->s_out_buffer.pu1_bufs[2] = outPlanes->mV;
     ps_dec_ip->s_out_buffer.u4_num_bufs = 3;
     return;
 }
+
+/* The codec writes the chroma planes at half the luma stride. The frames for output buffers
+ * laid out otherwise are decoded into mBounceBuffer and copied afterwards. */
+bool SoftAVC::lockDecodePlanes(
+        OMX_BUFFERHEADERTYPE *outHeader, OutputPlanes *planes, bool *bounced) {
+    *bounced = false;
+    if (!lockOutputBuffer(outHeader, planes)) {
+        return false;
+    }
+    if (planes->mUVStride * 2 == planes->mYStride) {
+        return true;
+    }
+    unlockOutputBuffer(outHeader);
+
+    if (NULL == mBounceBuffer) {
+        uint32_t bufferSize = outputBufferWidth() * outputBufferHeight() * 3 / 2;
+        mBounceBuffer = (uint8_t *)memalign(128, bufferSize);
+        if (NULL == mBounceBuffer) {
+            ALOGE("Could not allocate bounceBuffer of size %u", bufferSize);
+            return false;
+        }
+    }
+
+    planes->mYStride = outputBufferWidth();
+    planes->mUVStride = planes->mYStride / 2;
+    planes->mY = mBounceBuffer;
+    planes->mU = planes->mY + planes->mYStride * outputBufferHeight();
+    planes->mV = planes->mU + planes->mUVStride * (outputBufferHeight() / 2);
+    *bounced = true;
+    return true;
+}
+
+void SoftAVC::freeBounceBuffer() {
+    if (mBounceBuffer) {
+        free(mBounceBuffer);
+        mBounceBuffer = NULL;
+    }
+}
 void SoftAVC::onPortFlushCompleted(OMX_U32 portIndex) {
     /* Once the output buffers are flushed, ignore any buffers that are held in decoder */
     if (kOutputPortIndex == portIndex) {
         setFlushMode();
 
+        /* The flushed data goes to a picture buffer of the output buffer width */
+        if (outputBufferWidth() != mStride) {
+            mStride = outputBufferWidth();
+            setParams(mStride);
+        }
+
         /* Allocate a picture buffer to flushed data */
         uint32_t displayStride = outputBufferWidth();
         uint32_t displayHeight = outputBufferHeight();
@@ -483,12 +525,6 @@ void SoftAVC::onQueueFilled(OMX_U32 portIndex) {
             return;
         }
     }
-    if (outputBufferWidth() != mStride) {
-        /* Set the run-time (dynamic) parameters */
-        mStride = outputBufferWidth();
-        setParams(mStride);
-    }
-
     List<BufferInfo *> &inQueue = getPortQueue(kInputPortIndex);
     List<BufferInfo *> &outQueue = getPortQueue(kOutputPortIndex);
 
@@ -573,7 +609,21 @@ void SoftAVC::onQueueFilled(OMX_U32 portIndex) {
             WORD32 timeDelay, timeTaken;
             size_t sizeY, sizeUV;
 
-            setDecodeArgs(&s_dec_ip, &s_dec_op, inHeader, outHeader, timeStampIx);
+            OutputPlanes outPlanes;
+            bool bounced;
+            if (!lockDecodePlanes(outHeader, &outPlanes, &bounced)) {
+                ALOGE("Failed to access the output buffer");
+                notify(OMX_EventError, OMX_ErrorUndefined, 0, NULL);
+                mSignalledError = true;
+                return;
+            }
+            if (outPlanes.mYStride != mStride) {
+                /* Set the run-time (dynamic) parameters */
+                mStride = outPlanes.mYStride;
+                setParams(mStride);
+            }
+
+            setDecodeArgs(&s_dec_ip, &s_dec_op, inHeader, &outPlanes, timeStampIx);
             // If input dump is enabled, then write to file
             DUMP_TO_FILE(mInFile, s_dec_ip.pv_stream_buffer, s_dec_ip.u4_num_Bytes);
 
@@ -584,6 +634,9 @@ void SoftAVC::onQueueFilled(OMX_U32 portIndex) {
 
             IV_API_CALL_STATUS_T status;
             status = ivdec_api_function(mCodecCtx, (void *)&s_dec_ip, (void *)&s_dec_op);
+            if (!bounced) {
+                unlockOutputBuffer(outHeader);
+            }
 
             bool unsupportedResolution =
                 (IVD_STREAM_WIDTH_HEIGHT_NOT_SUPPORTED == (s_dec_op.u4_error_code & 0xFF));
@@ -652,6 +705,14 @@ void SoftAVC::onQueueFilled(OMX_U32 portIndex) {
             }
 
             if (s_dec_op.u4_output_present) {
+                if (bounced && !copyYV12FrameToOutputBuffer(
+                        outHeader, outPlanes.mY, outPlanes.mU, outPlanes.mV,
+                        outPlanes.mYStride, outPlanes.mUVStride, outPlanes.mUVStride)) {
+                    ALOGE("Failed to copy to the output buffer");
+                    notify(OMX_EventError, OMX_ErrorUndefined, 0, NULL);
+                    mSignalledError = true;
+                    return;
+                }
                 outHeader->nFilledLen = (outputBufferWidth() * outputBufferHeight() * 3) / 2;
 
                 outHeader->nTimeStamp = mTimeStamps[s_dec_op.u4_ts];
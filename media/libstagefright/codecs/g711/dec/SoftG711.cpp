@@ -43,7 +43,8 @@ SoftG711::SoftG711(
       mIsMLaw(true),
       mSignalledError(false),
       mNumChannels(1),
-      mSamplingRate(8000) {
+      mSamplingRate(8000),
+      mNumSamplesOutput(0) {
     if (!strcmp(name, "OMX.google.g711.alaw.decoder")) {
         mIsMLaw = false;
     } else {
@@ -221,11 +222,19 @@ void SoftG711::onQueueFilled(OMX_U32 /* portIndex */) {
             return;
         }
 
-        if (inHeader->nFilledLen > kMaxNumSamplesPerFrame) {
-            ALOGE("input buffer too large (%d).", inHeader->nFilledLen);
+        // Decode as much of the input buffer as fits in the output buffer,
+        // the rest goes into the next output buffer.
+        size_t numSamples = outHeader->nAllocLen / sizeof(int16_t);
+        numSamples -= numSamples % mNumChannels;
+        if (numSamples == 0) {
+            ALOGE("output buffer too small (%u).", outHeader->nAllocLen);
 
             notify(OMX_EventError, OMX_ErrorUndefined, 0, NULL);
             mSignalledError = true;
+            return;
+        }
+        if (numSamples > inHeader->nFilledLen) {
+            numSamples = inHeader->nFilledLen;
         }
 
         const uint8_t *inputptr = inHeader->pBuffer + inHeader->nOffset;
@@ -233,23 +242,32 @@ void SoftG711::onQueueFilled(OMX_U32 /* portIndex */) {
         if (mIsMLaw) {
             DecodeMLaw(
                     reinterpret_cast<int16_t *>(outHeader->pBuffer),
-                    inputptr, inHeader->nFilledLen);
+                    inputptr, numSamples);
         } else {
             DecodeALaw(
                     reinterpret_cast<int16_t *>(outHeader->pBuffer),
-                    inputptr, inHeader->nFilledLen);
+                    inputptr, numSamples);
         }
 
-        outHeader->nTimeStamp = inHeader->nTimeStamp;
+        outHeader->nTimeStamp = inHeader->nTimeStamp
+                + (mNumSamplesOutput / mNumChannels) * 1000000ll / mSamplingRate;
         outHeader->nOffset = 0;
-        outHeader->nFilledLen = inHeader->nFilledLen * sizeof(int16_t);
+        outHeader->nFilledLen = numSamples * sizeof(int16_t);
         outHeader->nFlags = 0;
 
-        inInfo->mOwnedByUs = false;
-        inQueue.erase(inQueue.begin());
-        inInfo = NULL;
-        notifyEmptyBufferDone(inHeader);
-        inHeader = NULL;
+        inHeader->nOffset += numSamples;
+        inHeader->nFilledLen -= numSamples;
+        mNumSamplesOutput += numSamples;
+
+        if (inHeader->nFilledLen == 0) {
+            inInfo->mOwnedByUs = false;
+            inQueue.erase(inQueue.begin());
+            inInfo = NULL;
+            notifyEmptyBufferDone(inHeader);
+            inHeader = NULL;
+
+            mNumSamplesOutput = 0;
+        }
 
         outInfo->mOwnedByUs = false;
         outQueue.erase(outQueue.begin());
@@ -259,6 +277,17 @@ void SoftG711::onQueueFilled(OMX_U32 /* portIndex */) {
     }
 }
 
+void SoftG711::onPortFlushCompleted(OMX_U32 portIndex) {
+    if (portIndex == 0) {
+        mNumSamplesOutput = 0;
+    }
+}
+
+void SoftG711::onReset() {
+    mSignalledError = false;
+    mNumSamplesOutput = 0;
+}
+
 // static
 void SoftG711::DecodeALaw(
         int16_t *out, const uint8_t *in, size_t inSize) {
@@ -38,6 +38,8 @@ protected:
             OMX_INDEXTYPE index, const OMX_PTR params);
 
     virtual void onQueueFilled(OMX_U32 portIndex);
+    virtual void onPortFlushCompleted(OMX_U32 portIndex);
+    virtual void onReset();
 
 private:
     enum {
@@ -50,6 +52,10 @@ private:
     OMX_U32 mNumChannels;
     int32_t mSamplingRate;
 
+    // Samples of the current input buffer already decoded, when it does
+    // not fit in one output buffer.
+    int64_t mNumSamplesOutput;
+
     void initPorts();
 
     static void DecodeALaw(int16_t *out, const uint8_t *in, size_t inSize);
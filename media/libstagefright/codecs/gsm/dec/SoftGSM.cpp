@@ -36,6 +36,8 @@ static void InitOMXParams(T *params) {
 
 // Microsoft WAV GSM encoding packs two GSM frames into 65 bytes.
 static const int kMSGSMFrameSize = 65;
+static const int kMSGSMFrameSamples = 320;
+static const int kSampleRate = 8000;
 
 SoftGSM::SoftGSM(
         const char *name,
@@ -43,7 +45,8 @@ SoftGSM::SoftGSM(
         OMX_PTR appData,
         OMX_COMPONENTTYPE **component)
     : SimpleSoftOMXComponent(name, callbacks, appData, component),
-      mSignalledError(false) {
+      mSignalledError(false),
+      mNumSamplesOutput(0) {
 
     CHECK(!strcmp(name, "OMX.google.gsm.decoder"));
 
@@ -204,33 +207,51 @@ void SoftGSM::onQueueFilled(OMX_U32 /* portIndex */) {
             return;
         }
 
-        if (inHeader->nFilledLen > kMaxNumSamplesPerFrame) {
-            ALOGE("input buffer too large (%d).", inHeader->nFilledLen);
+        if(((inHeader->nFilledLen / kMSGSMFrameSize) * kMSGSMFrameSize) != inHeader->nFilledLen) {
+            ALOGE("input buffer not multiple of %d (%d).", kMSGSMFrameSize, inHeader->nFilledLen);
             notify(OMX_EventError, OMX_ErrorUndefined, 0, NULL);
             mSignalledError = true;
+            return;
         }
 
-        if(((inHeader->nFilledLen / kMSGSMFrameSize) * kMSGSMFrameSize) != inHeader->nFilledLen) {
-            ALOGE("input buffer not multiple of %d (%d).", kMSGSMFrameSize, inHeader->nFilledLen);
+        // Decode as many of the frames in the input buffer as fit in the
+        // output buffer, the rest goes into the next output buffer.
+        size_t numFrames = outHeader->nAllocLen / (kMSGSMFrameSamples * sizeof(int16_t));
+        if (numFrames == 0) {
+            ALOGE("output buffer too small (%u).", outHeader->nAllocLen);
             notify(OMX_EventError, OMX_ErrorUndefined, 0, NULL);
             mSignalledError = true;
+            return;
+        }
+        if (numFrames > inHeader->nFilledLen / kMSGSMFrameSize) {
+            numFrames = inHeader->nFilledLen / kMSGSMFrameSize;
         }
 
         uint8_t *inputptr = inHeader->pBuffer + inHeader->nOffset;
 
-        int n = mSignalledError ? 0 : DecodeGSM(mGsm,
-                  reinterpret_cast<int16_t *>(outHeader->pBuffer), inputptr, inHeader->nFilledLen);
+        int n = DecodeGSM(mGsm,
+                  reinterpret_cast<int16_t *>(outHeader->pBuffer), inputptr,
+                  numFrames * kMSGSMFrameSize);
 
-        outHeader->nTimeStamp = inHeader->nTimeStamp;
+        outHeader->nTimeStamp =
+            inHeader->nTimeStamp + (mNumSamplesOutput * 1000000ll) / kSampleRate;
         outHeader->nOffset = 0;
         outHeader->nFilledLen = n * sizeof(int16_t);
         outHeader->nFlags = 0;
 
-        inInfo->mOwnedByUs = false;
-        inQueue.erase(inQueue.begin());
-        inInfo = NULL;
-        notifyEmptyBufferDone(inHeader);
-        inHeader = NULL;
+        inHeader->nOffset += numFrames * kMSGSMFrameSize;
+        inHeader->nFilledLen -= numFrames * kMSGSMFrameSize;
+        mNumSamplesOutput += n;
+
+        if (inHeader->nFilledLen == 0) {
+            inInfo->mOwnedByUs = false;
+            inQueue.erase(inQueue.begin());
+            inInfo = NULL;
+            notifyEmptyBufferDone(inHeader);
+            inHeader = NULL;
+
+            mNumSamplesOutput = 0;
+        }
 
         outInfo->mOwnedByUs = false;
         outQueue.erase(outQueue.begin());
@@ -263,6 +284,7 @@ int SoftGSM::DecodeGSM(gsm handle,
 
 void SoftGSM::onPortFlushCompleted(OMX_U32 portIndex) {
     if (portIndex == 0) {
+        mNumSamplesOutput = 0;
         gsm_destroy(mGsm);
         mGsm = gsm_create();
         int msopt = 1;
@@ -276,6 +298,7 @@ void SoftGSM::onReset() {
     int msopt = 1;
     gsm_option(mGsm, GSM_OPT_WAV49, &msopt);
     mSignalledError = false;
+    mNumSamplesOutput = 0;
 }
 
 
@@ -55,6 +55,10 @@ private:
     bool mSignalledError;
     gsm mGsm;
 
+    // Samples of the current input buffer already decoded, when it does
+    // not fit in one output buffer.
+    int64_t mNumSamplesOutput;
+
     void initPorts();
 
     static int DecodeGSM(gsm handle, int16_t *out, uint8_t *in, size_t inSize);
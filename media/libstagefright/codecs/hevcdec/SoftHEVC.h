@@ -77,6 +77,10 @@ private:
     // Internal buffer to be used to flush out the buffers from decoder
     uint8_t *mFlushOutBuffer;
 
+    // Internal buffer the frames are decoded into for output buffers with another layout,
+    // see lockDecodePlanes()
+    uint8_t *mBounceBuffer;
+
     // Status of entries in the timestamp array
     bool mTimeStampsValid[MAX_TIME_STAMPS];
 
@@ -109,8 +113,11 @@ private:
     void setDecodeArgs(ivd_video_decode_ip_t *ps_dec_ip,
         ivd_video_decode_op_t *ps_dec_op,
         OMX_BUFFERHEADERTYPE *inHeader,
-        OMX_BUFFERHEADERTYPE *outHeader,
+        const OutputPlanes *outPlanes,
         size_t timeStampIx);
+    bool lockDecodePlanes(
+        OMX_BUFFERHEADERTYPE *outHeader, OutputPlanes *planes, bool *bounced);
+    void freeBounceBuffer();
 
     DISALLOW_EVIL_CONSTRUCTORS (SoftHEVC);
 };
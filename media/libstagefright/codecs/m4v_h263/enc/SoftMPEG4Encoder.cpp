@@ -36,6 +36,7 @@
 #include "SoftMPEG4Encoder.h"
 
 #include <inttypes.h>
+#include <unistd.h>
 
 #ifndef INT32_MAX
 #define INT32_MAX   2147483647
@@ -52,6 +53,19 @@ static void InitOMXParams(T *params) {
     params->nVersion.s.nStep = 0;
 }
 
+static size_t GetCPUCoreCount() {
+    long cpuCoreCount = 1;
+#if defined(_SC_NPROCESSORS_ONLN)
+    cpuCoreCount = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    // _SC_NPROC_ONLN must be defined...
+    cpuCoreCount = sysconf(_SC_NPROC_ONLN);
+#endif
+    CHECK(cpuCoreCount >= 1);
+    ALOGV("Number of CPU cores: %ld", cpuCoreCount);
+    return (size_t)cpuCoreCount;
+}
+
 static const CodecProfileLevel kMPEG4ProfileLevels[] = {
     { OMX_VIDEO_MPEG4ProfileCore, OMX_VIDEO_MPEG4Level2 },
 };
@@ -77,6 +91,7 @@ SoftMPEG4Encoder::SoftMPEG4Encoder(
             callbacks, appData, component),
       mEncodeMode(COMBINE_MODE_WITH_ERR_RES),
       mIDRFrameRefreshIntervalInSec(1),
+      mNumEncoderThreads(0),
       mNumInputFrames(-1),
       mStarted(false),
       mSawInputEOS(false),
@@ -176,6 +191,10 @@ OMX_ERRORTYPE SoftMPEG4Encoder::initEncParams() {
     mEncParams->useACPred = PV_ON;
     mEncParams->intraDCVlcTh = 0;
 
+    // motion search and CodeMB of the rows run on worker threads, the output does not change
+    mEncParams->numThreads = mNumEncoderThreads > 0
+            ? mNumEncoderThreads : GetCPUCoreCount();
+
     return OMX_ErrorNone;
 }
 
@@ -286,6 +305,18 @@ OMX_ERRORTYPE SoftMPEG4Encoder::internalGetParameter(
             return OMX_ErrorNone;
         }
 
+        case kEncoderThreadsIndex:
+        {
+            OMX_PARAM_U32TYPE *threadsParams = (OMX_PARAM_U32TYPE *)params;
+
+            if (threadsParams->nPortIndex != 1) {
+                return OMX_ErrorUndefined;
+            }
+
+            threadsParams->nU32 = mNumEncoderThreads;
+            return OMX_ErrorNone;
+        }
+
         default:
             return SoftVideoEncoderOMXComponent::internalGetParameter(index, params);
     }
@@ -357,11 +388,33 @@ OMX_ERRORTYPE SoftMPEG4Encoder::internalSetParameter(
             return OMX_ErrorNone;
         }
 
+        case kEncoderThreadsIndex:
+        {
+            const OMX_PARAM_U32TYPE *threadsParams = (const OMX_PARAM_U32TYPE *)params;
+
+            // takes effect when the encoder is (re)initialized
+            if (threadsParams->nPortIndex != 1 || mStarted) {
+                return OMX_ErrorUndefined;
+            }
+
+            mNumEncoderThreads = threadsParams->nU32;
+            return OMX_ErrorNone;
+        }
+
         default:
             return SoftVideoEncoderOMXComponent::internalSetParameter(index, params);
     }
 }
 
+OMX_ERRORTYPE SoftMPEG4Encoder::getExtensionIndex(
+        const char *name, OMX_INDEXTYPE *index) {
+    if (!strcmp(name, "OMX.google.android.index.encoderThreads")) {
+        *(int32_t*)index = kEncoderThreadsIndex;
+        return OMX_ErrorNone;
+    }
+    return SoftVideoEncoderOMXComponent::getExtensionIndex(name, index);
+}
+
 void SoftMPEG4Encoder::onQueueFilled(OMX_U32 /* portIndex */) {
     if (mSignalledError || mSawInputEOS) {
         return;
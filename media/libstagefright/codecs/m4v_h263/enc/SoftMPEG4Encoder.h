@@ -46,6 +46,9 @@ struct SoftMPEG4Encoder : public SoftVideoEncoderOMXComponent {
     virtual OMX_ERRORTYPE internalSetParameter(
             OMX_INDEXTYPE index, const OMX_PTR params);
 
+    virtual OMX_ERRORTYPE getExtensionIndex(
+            const char *name, OMX_INDEXTYPE *index);
+
     virtual void onQueueFilled(OMX_U32 portIndex);
 
 protected:
@@ -56,6 +59,12 @@ private:
         kNumBuffers = 2,
     };
 
+    enum {
+        // OMX_PARAM_U32TYPE on the output port, the number of threads encoding the
+        // rows of a frame. 0 picks one per CPU core, 1 keeps it on the encoding thread.
+        kEncoderThreadsIndex = kPrepareForAdaptivePlaybackIndex + 1,
+    };
+
     // OMX input buffer's timestamp and flags
     typedef struct {
         int64_t mTimeUs;
@@ -65,6 +74,7 @@ private:
     MP4EncodingMode mEncodeMode;
     int32_t  mIDRFrameRefreshIntervalInSec;
 
+    OMX_U32  mNumEncoderThreads;
     int64_t  mNumInputFrames;
     bool     mStarted;
     bool     mSawInputEOS;
@@ -234,6 +234,10 @@ typedef struct tagvideoEncOptions
     /** @brief This flag turns on the use of AC prediction */
     Bool                useACPred;
 
+    /** @brief  Number of threads encoding the rows of macroblocks of a frame, including the calling
+    *           thread. The bitstream is the same for any value. 0 or 1 encodes on the calling thread only.*/
+    Int                 numThreads;
+
 } VideoEncOptions;
 
 #ifdef __cplusplus
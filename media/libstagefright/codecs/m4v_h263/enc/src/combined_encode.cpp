@@ -24,6 +24,52 @@
 
 PV_STATUS EncodeGOBHeader(VideoEncData *video, Int GOB_number, Int quant_scale, Int bs1stream);
 
+typedef struct tagCodeMBPass
+{
+    PV_STATUS(*CodeMB)(VideoEncData *, approxDCT *, Int, Int[]);
+} CodeMBPass;
+
+/* ======================================================================== */
+/*  Function : CodeMBRow()                                                  */
+/*  Purpose  : Motion compensation and CodeMB() of the macroblocks of row j */
+/*             on the row threads, into the coded macroblocks VLC encoded   */
+/*             by EncodeFrameCombinedMode().                                */
+/* ======================================================================== */
+static void CodeMBRow(VideoEncData *video, Int j, Int worker, void *arg)
+{
+    CodeMBPass *pass = (CodeMBPass*) arg;
+    Vol *currVol = video->vol[video->currLayer];
+    Int lx = video->currVop->pitch;
+    Int offset = j * (lx << 4);
+    Int mbnum = j * currVol->nMBPerRow;
+    UChar *QPMB = video->QPMB;
+    approxDCT fastDCTfunction;
+    CodedMB *coded;
+    Int i;
+
+    OSCL_UNUSED_ARG(worker);
+
+    coded = BeginCodedMBRow(video->rowThreads, j);
+
+    for (i = 0; i < currVol->nMBPerRow; i++)
+    {
+        video->outputMB = &coded[i].mb;
+        video->outputMB->mb_x = i;
+        video->outputMB->mb_y = j;
+        video->mbnum = mbnum;
+
+        getMotionCompensatedMB(video, i, j, offset);
+
+        (*pass->CodeMB)(video, &fastDCTfunction, (offset << 5) + QPMB[mbnum], coded[i].ncoefblck);
+        M4VENC_MEMCPY(coded[i].bitmapzz, video->bitmapzz, sizeof(coded[i].bitmapzz));
+
+        mbnum++;
+        offset += 16;
+    }
+
+    EndCodedMBRow(video->rowThreads, j);
+}
+
 /* ======================================================================== */
 /*  Function : EncodeFrameCombinedMode()                                    */
 /*  Date     : 09/01/2000                                                   */
@@ -57,6 +103,10 @@ PV_STATUS EncodeFrameCombinedMode(VideoEncData *video)
     PV_STATUS(*CodeMB)(VideoEncData *, approxDCT *, Int, Int[]);
     void (*MBVlcEncode)(VideoEncData*, Int[], void *);
     void (*BlockCodeCoeff)(RunLevelBlock*, BitstreamEncVideo*, Int, Int, UChar);
+    RowThreads *threads = video->rowThreads;
+    MacroBlock *outputMB = video->outputMB;
+    CodedMB *coded = NULL;
+    CodeMBPass pass;
 
     /* for H263 GOB changes */
 //MP4RateControlType rc_type = encParams->RC_Type;
@@ -104,8 +154,20 @@ PV_STATUS EncodeFrameCombinedMode(VideoEncData *video)
 
     video->usePrevQP = 0;
 
+    /* with row threads, the macroblocks are coded ahead on the workers and VLC encoded here */
+    if (threads)
+    {
+        pass.CodeMB = CodeMB;
+        StartRowThreads(video, currVol->nMBPerCol, &CodeMBRow, &pass);
+    }
+
     for (ind_y = 0; ind_y < currVol->nMBPerCol; ind_y++)    /* Col MB Loop */
     {
+        if (threads)
+        {
+            coded = GetCodedMBRow(threads, ind_y);
+            video->outputMB = &coded[0].mb;
+        }
 
         video->outputMB->mb_y = ind_y; /*  5/28/01 */
 
@@ -124,6 +186,12 @@ PV_STATUS EncodeFrameCombinedMode(VideoEncData *video)
 
         for (ind_x = 0; ind_x < currVol->nMBPerRow; ind_x++)  /* Row MB Loop */
         {
+            if (threads)
+            {
+                video->outputMB = &coded[ind_x].mb;
+                M4VENC_MEMCPY(video->bitmapzz, coded[ind_x].bitmapzz, sizeof(coded[ind_x].bitmapzz));
+            }
+
             video->outputMB->mb_x = ind_x; /*  5/28/01 */
             video->mbnum = mbnum;
             QP = QPMB[mbnum];   /* always read new QP */
@@ -136,7 +204,8 @@ PV_STATUS EncodeFrameCombinedMode(VideoEncData *video)
             /****************************************************************************************/
             /* MB Prediction:Put into MC macroblock, substract from currVop, put in predMB */
             /****************************************************************************************/
-            getMotionCompensatedMB(video, ind_x, ind_y, offset);
+            if (!threads)
+                getMotionCompensatedMB(video, ind_x, ind_y, offset);
 
 #ifndef H263_ONLY
             if (start_packet_header)
@@ -156,13 +225,21 @@ PV_STATUS EncodeFrameCombinedMode(VideoEncData *video)
             /* Code_MB:  DCT, Q, Q^(-1), IDCT, Motion Comp */
             /***********************************************/
 
-            status = (*CodeMB)(video, &fastDCTfunction, (offset << 5) + QP, ncoefblck);
+            if (threads)
+            {
+                /* done by CodeMBRow() */
+                (*MBVlcEncode)(video, coded[ind_x].ncoefblck, (void*)BlockCodeCoeff);
+            }
+            else
+            {
+                status = (*CodeMB)(video, &fastDCTfunction, (offset << 5) + QP, ncoefblck);
 
-            /************************************/
-            /* MB VLC Encode: VLC Encode MB     */
-            /************************************/
+                /************************************/
+                /* MB VLC Encode: VLC Encode MB     */
+                /************************************/
 
-            (*MBVlcEncode)(video, ncoefblck, (void*)BlockCodeCoeff);
+                (*MBVlcEncode)(video, ncoefblck, (void*)BlockCodeCoeff);
+            }
 
             /*************************************************************/
             /* Assemble Packets:  Assemble the MB VLC codes into Packets */
@@ -207,6 +284,9 @@ PV_STATUS EncodeFrameCombinedMode(VideoEncData *video)
             offset += 16;
         } /* End of For ind_x */
 
+        if (threads)
+            ReleaseCodedMBRow(threads, ind_y);
+
         offset += (lx << 4) - width;
         if (currVol->shortVideoHeader)  /* ShortVideoHeader = 1 */
         {
@@ -216,6 +296,12 @@ PV_STATUS EncodeFrameCombinedMode(VideoEncData *video)
 
     } /* End of For ind_y */
 
+    if (threads)
+    {
+        FinishRowThreads(video, FALSE);
+        video->outputMB = outputMB;
+    }
+
     if (currVol->shortVideoHeader) /* ShortVideoHeader = 1 */
     {
 
@@ -208,11 +208,52 @@ void GetHalfPelBlkRegion(UChar *cand, UChar *hmem, Int lx)
 }
 
 
+/* pad the 8-pixel border of a chrominance plane */
+static void PaddingEdgeChrom(UChar *chan, Int width, Int height, Int pitch)
+{
+    UChar *src, *dst;
+    Int i;
+
+    /* pad sides */
+    src = chan;
+    i = height;
+    while (i--)
+    {
+        M4VENC_MEMSET(src - 8, src[0], 8);
+        M4VENC_MEMSET(src + width, src[width-1], 8);
+        src += pitch;
+    }
+
+    /* pad top and bottom, with the corners */
+    src = chan - 8;
+    dst = src - (pitch << 3);
+    i = 8;
+    while (i--)
+    {
+        M4VENC_MEMCPY(dst, src, width + 16);
+        dst += pitch;
+    }
+
+    src = chan - 8 + (height - 1) * pitch;
+    dst = src + pitch;
+    i = 8;
+    while (i--)
+    {
+        M4VENC_MEMCPY(dst, src, width + 16);
+        dst += pitch;
+    }
+
+    return ;
+}
+
 /*=====================================================================
     Function:   PaddingEdge
     Date:       09/16/2000
     Purpose:    Pad edge of a Vop
     Modification: 09/20/05.
+                Pad the chrominance too, so that EncPrediction_Chrom()
+                reads the reference without padding it on the fly,
+                which the row threads would race on.
 =====================================================================*/
 
 void  PaddingEdge(Vop *refVop)
@@ -295,6 +336,8 @@ void  PaddingEdge(Vop *refVop)
         dst += pitch;
     }
 
+    PaddingEdgeChrom(refVop->uChan, width >> 1, height >> 1, pitch >> 1);
+    PaddingEdgeChrom(refVop->vChan, width >> 1, height >> 1, pitch >> 1);
 
     return ;
 }
@@ -155,7 +155,7 @@ void getMotionCompensatedMB(VideoEncData *video, Int ind_x, Int ind_y, Int offse
         cv_prev = prevVop->vChan;
 
         EncPrediction_Chrom(xpred, ypred, cu_prev, cv_prev, cu_rec, cv_rec,
-                            pitch_uv, (currVop->width) >> 1, height_uv, round1);
+                            pitch_uv, (currVop->width) >> 1, height_uv, round1, prevVop->padded);
     }
 #ifndef NO_INTER4V
     else if (mode == MODE_INTER4V)
@@ -179,7 +179,7 @@ void getMotionCompensatedMB(VideoEncData *video, Int ind_x, Int ind_y, Int offse
         xpred = xpos + dx;
 
         EncPrediction_Chrom(xpred, ypred, cu_prev, cv_prev, cu_rec, cv_rec,
-                            pitch_uv, (currVop->width) >> 1, height_uv, round1);
+                            pitch_uv, (currVop->width) >> 1, height_uv, round1, prevVop->padded);
     }
 #endif
     else
@@ -299,16 +299,18 @@ void EncPrediction_Chrom(
     Int lx,
     Int width_uv,           /* i */
     Int height_uv,          /* i */
-    Int round1          /* i */
+    Int round1,         /* i */
+    Int padded          /* i, the edges are padded by PaddingEdge() */
 )
 {
     /* check whether the MV points outside the frame */
     /* Compute prediction for Chrominance b block (block[4]) */
-    if (xpred >= 0 && xpred <= ((width_uv << 1) - (2*B_SIZE)) && ypred >= 0 &&
-            ypred <= ((height_uv << 1) - (2*B_SIZE)))
+    if (padded || (xpred >= 0 && xpred <= ((width_uv << 1) - (2*B_SIZE)) && ypred >= 0 &&
+                   ypred <= ((height_uv << 1) - (2*B_SIZE))))
     {
         /*****************************/
         /* (x,y) is inside the frame */
+        /* or in the padded edges    */
         /*****************************/
 
         /* Compute prediction for Chrominance b (block[4]) */
@@ -126,6 +126,301 @@ ULong num_hp_not_zero = 0;
 
 
 
+/* statistics of the motion search of a frame, for scene change detection and rate control */
+typedef struct tagMEStat
+{
+    Int numIntra;
+    Int totalSAD;
+    Int max_mag;
+    Int min_mag;
+#ifdef HTFM
+    Int abs_dif_mad_avg;
+    UInt countbreak;
+#endif
+} MEStat;
+
+/* a pass of MotionEstimation() over the rows of macroblocks on the row threads */
+typedef struct tagMEPass
+{
+    Int start_i;
+    Int incr_i;
+    Int type_pred;
+    MEStat stat[MAX_ROW_THREADS];   /* for each worker */
+} MEPass;
+
+/*==================================================================
+    Function:   MotionEstimationRow
+    Purpose:    Motion search of the macroblocks start_i, start_i + incr_i,
+                ... of row j. With row threads, a macroblock waits until
+                the row above is done up to its top-right neighbor, so it
+                uses the same candidates as in raster order.
+====================================================================*/
+static void MotionEstimationRow(VideoEncData *video, RowThreads *threads, Int j,
+                                Int start_i, Int incr_i, Int type_pred, MEStat *stat)
+{
+    UChar use_4mv = video->encParams->MV8x8_Enabled;
+    Vol *currVol = video->vol[video->currLayer];
+    VideoEncFrameIO *currFrame = video->input;
+    Int i, comp;
+    Int mbwidth = currVol->nMBPerRow;
+    Int width = currFrame->pitch;
+    UChar *mode_mb, *Mode = video->headerInfo.Mode;
+    MOT *mot_mb, **mot = video->mot;
+    Int FS_en = video->encParams->FullSearch_Enabled;
+    void (*ComputeMBSum)(UChar *, Int, MOT *) = video->functionPointer->ComputeMBSum;
+    void (*ChooseMode)(UChar*, UChar*, Int, Int) = video->functionPointer->ChooseMode;
+
+    Int mbnum, offset;
+    UChar *cur, *best_cand[5];
+    Int sad8 = 0, sad16 = 0;
+    Int skip_halfpel_4mv;
+    Int xh[5] = {0, 0, 0, 0, 0};
+    Int yh[5] = {0, 0, 0, 0, 0}; /* half-pel */
+    UChar hp_mem4MV[17*17*4];
+#ifdef HTFM
+    HTFM_Stat *htfm_stat = &video->htfm_stat;
+#endif
+    Int hp_guess = 0;
+#ifdef PRINT_MV
+    FILE *fp_debug;
+#endif
+
+    offset = width * (j << 4) + (start_i << 4);
+
+    mbnum = j * mbwidth + start_i;
+
+    for (i = start_i; i < mbwidth; i += incr_i)
+    {
+        if (threads && j > 0)
+        {
+            WaitForRow(threads, j - 1, PV_MIN(i + 2, mbwidth));
+        }
+
+        video->mbnum = mbnum;
+        mot_mb = mot[mbnum];
+        mode_mb = Mode + mbnum;
+
+        cur = currFrame->yChan + offset;
+
+
+        if (*mode_mb != MODE_INTRA)
+        {
+#if defined(HTFM)
+            HTFMPrepareCurMB(video, htfm_stat, cur);
+#else
+            PrepareCurMB(video, cur);
+#endif
+            /************************************************************/
+            /******** full-pel 1MV and 4MVs search **********************/
+
+#ifdef _SAD_STAT
+            num_MB++;
+#endif
+            MBMotionSearch(video, cur, best_cand, i << 4, j << 4, type_pred,
+                           FS_en, &hp_guess);
+
+#ifdef PRINT_MV
+            fp_debug = fopen("c:\\bitstream\\mv1_debug.txt", "a");
+            fprintf(fp_debug, "#%d (%d,%d,%d) : ", mbnum, mot_mb[0].x, mot_mb[0].y, mot_mb[0].sad);
+            fprintf(fp_debug, "(%d,%d,%d) : (%d,%d,%d) : (%d,%d,%d) : (%d,%d,%d) : ==>\n",
+                    mot_mb[1].x, mot_mb[1].y, mot_mb[1].sad,
+                    mot_mb[2].x, mot_mb[2].y, mot_mb[2].sad,
+                    mot_mb[3].x, mot_mb[3].y, mot_mb[3].sad,
+                    mot_mb[4].x, mot_mb[4].y, mot_mb[4].sad);
+            fclose(fp_debug);
+#endif
+            sad16 = mot_mb[0].sad;
+#ifdef NO_INTER4V
+            sad8 = sad16;
+#else
+            sad8 = mot_mb[1].sad + mot_mb[2].sad + mot_mb[3].sad + mot_mb[4].sad;
+#endif
+
+            /* choose between INTRA or INTER */
+            (*ChooseMode)(mode_mb, cur, width, ((sad8 < sad16) ? sad8 : sad16));
+        }
+        else    /* INTRA update, use for prediction 3/23/01 */
+        {
+            mot_mb[0].x = mot_mb[0].y = 0;
+        }
+
+        if (*mode_mb == MODE_INTRA)
+        {
+            stat->numIntra++ ;
+
+            /* compute SAV for rate control and fast DCT, 11/28/00 */
+            (*ComputeMBSum)(cur, width, mot_mb);
+
+            /* leave mot_mb[0] as it is for fast motion search */
+            /* set the 4 MVs to zeros */
+            for (comp = 1; comp <= 4; comp++)
+            {
+                mot_mb[comp].x = 0;
+                mot_mb[comp].y = 0;
+            }
+#ifdef PRINT_MV
+            fp_debug = fopen("c:\\bitstream\\mv1_debug.txt", "a");
+            fprintf(fp_debug, "\n");
+            fclose(fp_debug);
+#endif
+        }
+        else /* *mode_mb = MODE_INTER;*/
+        {
+            if (video->encParams->HalfPel_Enabled)
+            {
+#ifdef _SAD_STAT
+                num_HP_MB++;
+#endif
+                /* find half-pel resolution motion vector */
+                FindHalfPelMB(video, cur, mot_mb, best_cand[0],
+                              i << 4, j << 4, xh, yh, hp_guess);
+#ifdef PRINT_MV
+                fp_debug = fopen("c:\\bitstream\\mv1_debug.txt", "a");
+                fprintf(fp_debug, "(%d,%d), %d\n", mot_mb[0].x, mot_mb[0].y, mot_mb[0].sad);
+                fclose(fp_debug);
+#endif
+                skip_halfpel_4mv = ((sad16 - mot_mb[0].sad) <= (MB_Nb >> 1) + 1);
+                sad16 = mot_mb[0].sad;
+
+#ifndef NO_INTER4V
+                if (use_4mv && !skip_halfpel_4mv)
+                {
+                    /* Also decide 1MV or 4MV !!!!!!!!*/
+                    sad8 = FindHalfPelBlk(video, cur, mot_mb, sad16,
+                                          best_cand, mode_mb, i << 4, j << 4, xh, yh, hp_mem4MV);
+
+#ifdef PRINT_MV
+                    fp_debug = fopen("c:\\bitstream\\mv1_debug.txt", "a");
+                    fprintf(fp_debug, " (%d,%d,%d) : (%d,%d,%d) : (%d,%d,%d) : (%d,%d,%d) \n",
+                            mot_mb[1].x, mot_mb[1].y, mot_mb[1].sad,
+                            mot_mb[2].x, mot_mb[2].y, mot_mb[2].sad,
+                            mot_mb[3].x, mot_mb[3].y, mot_mb[3].sad,
+                            mot_mb[4].x, mot_mb[4].y, mot_mb[4].sad);
+                    fclose(fp_debug);
+#endif
+                }
+#endif /* NO_INTER4V */
+            }
+            else    /* HalfPel_Enabled ==0  */
+            {
+#ifndef NO_INTER4V
+                //if(sad16 < sad8-PREF_16_VEC)
+                if (sad16 - PREF_16_VEC > sad8)
+                {
+                    *mode_mb = MODE_INTER4V;
+                }
+#endif
+            }
+#if (ZERO_MV_PREF==2)   /* use mot_mb[7].sad as d0 computed in MBMotionSearch*/
+            /******************************************************/
+            if (mot_mb[7].sad - PREF_NULL_VEC < sad16 && mot_mb[7].sad - PREF_NULL_VEC < sad8)
+            {
+                mot_mb[0].sad = mot_mb[7].sad - PREF_NULL_VEC;
+                mot_mb[0].x = mot_mb[0].y = 0;
+                *mode_mb = MODE_INTER;
+            }
+            /******************************************************/
+#endif
+            if (*mode_mb == MODE_INTER)
+            {
+                if (mot_mb[0].x == 0 && mot_mb[0].y == 0)   /* use zero vector */
+                    mot_mb[0].sad += PREF_NULL_VEC; /* add back the bias */
+
+                mot_mb[1].sad = mot_mb[2].sad = mot_mb[3].sad = mot_mb[4].sad = (mot_mb[0].sad + 2) >> 2;
+                mot_mb[1].x = mot_mb[2].x = mot_mb[3].x = mot_mb[4].x = mot_mb[0].x;
+                mot_mb[1].y = mot_mb[2].y = mot_mb[3].y = mot_mb[4].y = mot_mb[0].y;
+
+            }
+        }
+
+        /* find maximum magnitude */
+        /* compute average SAD for rate control, 11/28/00 */
+        if (*mode_mb == MODE_INTER)
+        {
+#ifdef PRINT_MV
+            fp_debug = fopen("c:\\bitstream\\mv1_debug.txt", "a");
+            fprintf(fp_debug, "%d MODE_INTER\n", mbnum);
+            fclose(fp_debug);
+#endif
+            stat->totalSAD += mot_mb[0].sad;
+            if (mot_mb[0].x > stat->max_mag)
+                stat->max_mag = mot_mb[0].x;
+            if (mot_mb[0].y > stat->max_mag)
+                stat->max_mag = mot_mb[0].y;
+            if (mot_mb[0].x < stat->min_mag)
+                stat->min_mag = mot_mb[0].x;
+            if (mot_mb[0].y < stat->min_mag)
+                stat->min_mag = mot_mb[0].y;
+        }
+        else if (*mode_mb == MODE_INTER4V)
+        {
+#ifdef PRINT_MV
+            fp_debug = fopen("c:\\bitstream\\mv1_debug.txt", "a");
+            fprintf(fp_debug, "%d MODE_INTER4V\n", mbnum);
+            fclose(fp_debug);
+#endif
+            stat->totalSAD += sad8;
+            for (comp = 1; comp <= 4; comp++)
+            {
+                if (mot_mb[comp].x > stat->max_mag)
+                    stat->max_mag = mot_mb[comp].x;
+                if (mot_mb[comp].y > stat->max_mag)
+                    stat->max_mag = mot_mb[comp].y;
+                if (mot_mb[comp].x < stat->min_mag)
+                    stat->min_mag = mot_mb[comp].x;
+                if (mot_mb[comp].y < stat->min_mag)
+                    stat->min_mag = mot_mb[comp].y;
+            }
+        }
+        else    /* MODE_INTRA */
+        {
+#ifdef PRINT_MV
+            fp_debug = fopen("c:\\bitstream\\mv1_debug.txt", "a");
+            fprintf(fp_debug, "%d MODE_INTRA\n", mbnum);
+            fclose(fp_debug);
+#endif
+            stat->totalSAD += mot_mb[0].sad;
+        }
+
+        if (threads)
+        {
+            SetRowProgress(threads, j, i + incr_i);
+        }
+
+        mbnum += incr_i;
+        offset += (incr_i << 4);
+
+    }
+
+    if (threads)
+    {
+        SetRowProgress(threads, j, mbwidth); /* also if no macroblock of the row is in this pass */
+    }
+}
+
+/* Runs MotionEstimationRow() on the row threads. */
+static void MotionEstimationRowThread(VideoEncData *video, Int j, Int worker, void *arg)
+{
+    MEPass *pass = (MEPass*) arg;
+    MEStat *stat = pass->stat + worker;
+    Int start_i = pass->start_i;
+#ifdef HTFM
+    Int abs_dif_mad_avg = video->htfm_stat.abs_dif_mad_avg;
+    UInt countbreak = video->htfm_stat.countbreak;
+#endif
+
+    if (pass->incr_i > 1)
+        start_i = start_i ^ 1 ^ (j & 1); /* toggle 0 and 1 as in the serial scan */
+
+    MotionEstimationRow(video, video->rowThreads, j, start_i, pass->incr_i, pass->type_pred, stat);
+
+#ifdef HTFM
+    /* add the statistics collected by this row on the copy of video to those of the pass */
+    stat->abs_dif_mad_avg += video->htfm_stat.abs_dif_mad_avg - abs_dif_mad_avg;
+    stat->countbreak += video->htfm_stat.countbreak - countbreak;
+#endif
+}
+
 /*==================================================================
     Function:   MotionEstimation
     Date:       10/3/2000
@@ -135,46 +430,36 @@ ULong num_hp_not_zero = 0;
 
 void MotionEstimation(VideoEncData *video)
 {
-    UChar use_4mv = video->encParams->MV8x8_Enabled;
     Vol *currVol = video->vol[video->currLayer];
     Vop *currVop = video->currVop;
     VideoEncFrameIO *currFrame = video->input;
-    Int i, j, comp;
+    Int i, j, k;
     Int mbwidth = currVol->nMBPerRow;
     Int mbheight = currVol->nMBPerCol;
     Int totalMB = currVol->nTotalMB;
     Int width = currFrame->pitch;
-    UChar *mode_mb, *Mode = video->headerInfo.Mode;
+    UChar *Mode = video->headerInfo.Mode;
     MOT *mot_mb, **mot = video->mot;
     UChar *intraArray = video->intraArray;
-    Int FS_en = video->encParams->FullSearch_Enabled;
     void (*ComputeMBSum)(UChar *, Int, MOT *) = video->functionPointer->ComputeMBSum;
-    void (*ChooseMode)(UChar*, UChar*, Int, Int) = video->functionPointer->ChooseMode;
 
-    Int numIntra, start_i, numLoop, incr_i;
+    Int start_i, numLoop, incr_i;
     Int mbnum, offset;
-    UChar *cur, *best_cand[5];
-    Int sad8 = 0, sad16 = 0;
+    UChar *cur;
     Int totalSAD = 0;   /* average SAD for rate control */
-    Int skip_halfpel_4mv;
-    Int f_code_p, f_code_n, max_mag = 0, min_mag = 0;
+    Int f_code_p, f_code_n, max_mag, min_mag;
     Int type_pred;
-    Int xh[5] = {0, 0, 0, 0, 0};
-    Int yh[5] = {0, 0, 0, 0, 0}; /* half-pel */
-    UChar hp_mem4MV[17*17*4];
+    MEStat stat;
+    MEPass pass;
 
 #ifdef HTFM
     /***** HYPOTHESIS TESTING ********/  /* 2/28/01 */
     Int collect = 0;
-    HTFM_Stat htfm_stat;
+    HTFM_Stat *htfm_stat = &video->htfm_stat;
     double newvar[16];
     double exp_lamda[15];
     /*********************************/
 #endif
-    Int hp_guess = 0;
-#ifdef PRINT_MV
-    FILE *fp_debug;
-#endif
 
 //  FILE *fstat;
 //  static int frame_num = 0;
@@ -229,7 +514,7 @@ void MotionEstimation(VideoEncData *video)
 
 #ifdef HTFM
     /***** HYPOTHESIS TESTING ********/  /* 2/28/01 */
-    InitHTFM(video, &htfm_stat, newvar, &collect);
+    InitHTFM(video, htfm_stat, newvar, &collect);
     /*********************************/
 #endif
 
@@ -253,215 +538,47 @@ void MotionEstimation(VideoEncData *video)
     /* First pass, loop thru half the macroblock */
     /* determine scene change */
     /* Second pass, for the rest of macroblocks */
-    numIntra = 0;
+    M4VENC_MEMSET(&stat, 0, sizeof(MEStat));
     while (numLoop--)
     {
-        for (j = 0; j < mbheight; j++)
+        if (video->rowThreads)
         {
-            if (incr_i > 1)
-                start_i = (start_i == 0 ? 1 : 0) ; /* toggle 0 and 1 */
+            /* rows in a wavefront, the results are the same as in the serial scan */
+            M4VENC_MEMSET(&pass, 0, sizeof(MEPass));
+            pass.start_i = start_i;
+            pass.incr_i = incr_i;
+            pass.type_pred = type_pred;
 
-            offset = width * (j << 4) + (start_i << 4);
+            StartRowThreads(video, mbheight, &MotionEstimationRowThread, &pass);
+            FinishRowThreads(video, TRUE);
 
-            mbnum = j * mbwidth + start_i;
-
-            for (i = start_i; i < mbwidth; i += incr_i)
+            for (k = 0; k < MAX_ROW_THREADS; k++)
             {
-                video->mbnum = mbnum;
-                mot_mb = mot[mbnum];
-                mode_mb = Mode + mbnum;
-
-                cur = currFrame->yChan + offset;
-
-
-                if (*mode_mb != MODE_INTRA)
-                {
-#if defined(HTFM)
-                    HTFMPrepareCurMB(video, &htfm_stat, cur);
-#else
-                    PrepareCurMB(video, cur);
-#endif
-                    /************************************************************/
-                    /******** full-pel 1MV and 4MVs search **********************/
-
-#ifdef _SAD_STAT
-                    num_MB++;
-#endif
-                    MBMotionSearch(video, cur, best_cand, i << 4, j << 4, type_pred,
-                                   FS_en, &hp_guess);
-
-#ifdef PRINT_MV
-                    fp_debug = fopen("c:\\bitstream\\mv1_debug.txt", "a");
-                    fprintf(fp_debug, "#%d (%d,%d,%d) : ", mbnum, mot_mb[0].x, mot_mb[0].y, mot_mb[0].sad);
-                    fprintf(fp_debug, "(%d,%d,%d) : (%d,%d,%d) : (%d,%d,%d) : (%d,%d,%d) : ==>\n",
-                            mot_mb[1].x, mot_mb[1].y, mot_mb[1].sad,
-                            mot_mb[2].x, mot_mb[2].y, mot_mb[2].sad,
-                            mot_mb[3].x, mot_mb[3].y, mot_mb[3].sad,
-                            mot_mb[4].x, mot_mb[4].y, mot_mb[4].sad);
-                    fclose(fp_debug);
-#endif
-                    sad16 = mot_mb[0].sad;
-#ifdef NO_INTER4V
-                    sad8 = sad16;
-#else
-                    sad8 = mot_mb[1].sad + mot_mb[2].sad + mot_mb[3].sad + mot_mb[4].sad;
-#endif
-
-                    /* choose between INTRA or INTER */
-                    (*ChooseMode)(mode_mb, cur, width, ((sad8 < sad16) ? sad8 : sad16));
-                }
-                else    /* INTRA update, use for prediction 3/23/01 */
-                {
-                    mot_mb[0].x = mot_mb[0].y = 0;
-                }
-
-                if (*mode_mb == MODE_INTRA)
-                {
-                    numIntra++ ;
-
-                    /* compute SAV for rate control and fast DCT, 11/28/00 */
-                    (*ComputeMBSum)(cur, width, mot_mb);
-
-                    /* leave mot_mb[0] as it is for fast motion search */
-                    /* set the 4 MVs to zeros */
-                    for (comp = 1; comp <= 4; comp++)
-                    {
-                        mot_mb[comp].x = 0;
-                        mot_mb[comp].y = 0;
-                    }
-#ifdef PRINT_MV
-                    fp_debug = fopen("c:\\bitstream\\mv1_debug.txt", "a");
-                    fprintf(fp_debug, "\n");
-                    fclose(fp_debug);
-#endif
-                }
-                else /* *mode_mb = MODE_INTER;*/
-                {
-                    if (video->encParams->HalfPel_Enabled)
-                    {
-#ifdef _SAD_STAT
-                        num_HP_MB++;
-#endif
-                        /* find half-pel resolution motion vector */
-                        FindHalfPelMB(video, cur, mot_mb, best_cand[0],
-                                      i << 4, j << 4, xh, yh, hp_guess);
-#ifdef PRINT_MV
-                        fp_debug = fopen("c:\\bitstream\\mv1_debug.txt", "a");
-                        fprintf(fp_debug, "(%d,%d), %d\n", mot_mb[0].x, mot_mb[0].y, mot_mb[0].sad);
-                        fclose(fp_debug);
-#endif
-                        skip_halfpel_4mv = ((sad16 - mot_mb[0].sad) <= (MB_Nb >> 1) + 1);
-                        sad16 = mot_mb[0].sad;
-
-#ifndef NO_INTER4V
-                        if (use_4mv && !skip_halfpel_4mv)
-                        {
-                            /* Also decide 1MV or 4MV !!!!!!!!*/
-                            sad8 = FindHalfPelBlk(video, cur, mot_mb, sad16,
-                                                  best_cand, mode_mb, i << 4, j << 4, xh, yh, hp_mem4MV);
-
-#ifdef PRINT_MV
-                            fp_debug = fopen("c:\\bitstream\\mv1_debug.txt", "a");
-                            fprintf(fp_debug, " (%d,%d,%d) : (%d,%d,%d) : (%d,%d,%d) : (%d,%d,%d) \n",
-                                    mot_mb[1].x, mot_mb[1].y, mot_mb[1].sad,
-                                    mot_mb[2].x, mot_mb[2].y, mot_mb[2].sad,
-                                    mot_mb[3].x, mot_mb[3].y, mot_mb[3].sad,
-                                    mot_mb[4].x, mot_mb[4].y, mot_mb[4].sad);
-                            fclose(fp_debug);
-#endif
-                        }
-#endif /* NO_INTER4V */
-                    }
-                    else    /* HalfPel_Enabled ==0  */
-                    {
-#ifndef NO_INTER4V
-                        //if(sad16 < sad8-PREF_16_VEC)
-                        if (sad16 - PREF_16_VEC > sad8)
-                        {
-                            *mode_mb = MODE_INTER4V;
-                        }
-#endif
-                    }
-#if (ZERO_MV_PREF==2)   /* use mot_mb[7].sad as d0 computed in MBMotionSearch*/
-                    /******************************************************/
-                    if (mot_mb[7].sad - PREF_NULL_VEC < sad16 && mot_mb[7].sad - PREF_NULL_VEC < sad8)
-                    {
-                        mot_mb[0].sad = mot_mb[7].sad - PREF_NULL_VEC;
-                        mot_mb[0].x = mot_mb[0].y = 0;
-                        *mode_mb = MODE_INTER;
-                    }
-                    /******************************************************/
-#endif
-                    if (*mode_mb == MODE_INTER)
-                    {
-                        if (mot_mb[0].x == 0 && mot_mb[0].y == 0)   /* use zero vector */
-                            mot_mb[0].sad += PREF_NULL_VEC; /* add back the bias */
-
-                        mot_mb[1].sad = mot_mb[2].sad = mot_mb[3].sad = mot_mb[4].sad = (mot_mb[0].sad + 2) >> 2;
-                        mot_mb[1].x = mot_mb[2].x = mot_mb[3].x = mot_mb[4].x = mot_mb[0].x;
-                        mot_mb[1].y = mot_mb[2].y = mot_mb[3].y = mot_mb[4].y = mot_mb[0].y;
-
-                    }
-                }
-
-                /* find maximum magnitude */
-                /* compute average SAD for rate control, 11/28/00 */
-                if (*mode_mb == MODE_INTER)
-                {
-#ifdef PRINT_MV
-                    fp_debug = fopen("c:\\bitstream\\mv1_debug.txt", "a");
-                    fprintf(fp_debug, "%d MODE_INTER\n", mbnum);
-                    fclose(fp_debug);
-#endif
-                    totalSAD += mot_mb[0].sad;
-                    if (mot_mb[0].x > max_mag)
-                        max_mag = mot_mb[0].x;
-                    if (mot_mb[0].y > max_mag)
-                        max_mag = mot_mb[0].y;
-                    if (mot_mb[0].x < min_mag)
-                        min_mag = mot_mb[0].x;
-                    if (mot_mb[0].y < min_mag)
-                        min_mag = mot_mb[0].y;
-                }
-                else if (*mode_mb == MODE_INTER4V)
-                {
-#ifdef PRINT_MV
-                    fp_debug = fopen("c:\\bitstream\\mv1_debug.txt", "a");
-                    fprintf(fp_debug, "%d MODE_INTER4V\n", mbnum);
-                    fclose(fp_debug);
-#endif
-                    totalSAD += sad8;
-                    for (comp = 1; comp <= 4; comp++)
-                    {
-                        if (mot_mb[comp].x > max_mag)
-                            max_mag = mot_mb[comp].x;
-                        if (mot_mb[comp].y > max_mag)
-                            max_mag = mot_mb[comp].y;
-                        if (mot_mb[comp].x < min_mag)
-                            min_mag = mot_mb[comp].x;
-                        if (mot_mb[comp].y < min_mag)
-                            min_mag = mot_mb[comp].y;
-                    }
-                }
-                else    /* MODE_INTRA */
-                {
-#ifdef PRINT_MV
-                    fp_debug = fopen("c:\\bitstream\\mv1_debug.txt", "a");
-                    fprintf(fp_debug, "%d MODE_INTRA\n", mbnum);
-                    fclose(fp_debug);
+                stat.numIntra += pass.stat[k].numIntra;
+                stat.totalSAD += pass.stat[k].totalSAD;
+                stat.max_mag = PV_MAX(stat.max_mag, pass.stat[k].max_mag);
+                stat.min_mag = PV_MIN(stat.min_mag, pass.stat[k].min_mag);
+#ifdef HTFM
+                htfm_stat->abs_dif_mad_avg += pass.stat[k].abs_dif_mad_avg;
+                htfm_stat->countbreak += pass.stat[k].countbreak;
 #endif
-                    totalSAD += mot_mb[0].sad;
-                }
-                mbnum += incr_i;
-                offset += (incr_i << 4);
+            }
+        }
+        else
+        {
+            for (j = 0; j < mbheight; j++)
+            {
+                if (incr_i > 1)
+                    start_i = (start_i == 0 ? 1 : 0) ; /* toggle 0 and 1 */
 
+                MotionEstimationRow(video, NULL, j, start_i, incr_i, type_pred, &stat);
             }
         }
 
         if (incr_i > 1 && numLoop) /* scene change on and first loop */
         {
             //if(numIntra > ((totalMB>>3)<<1) + (totalMB>>3)) /* 75% of 50%MBs */
-            if (numIntra > (0.30*(totalMB / 2.0))) /* 15% of 50%MBs */
+            if (stat.numIntra > (0.30*(totalMB / 2.0))) /* 15% of 50%MBs */
             {
                 /******** scene change detected *******************/
                 currVop->predictionType = I_VOP;
@@ -502,6 +619,10 @@ void MotionEstimation(VideoEncData *video)
         type_pred++; /* second pass */
     }
 
+    totalSAD = stat.totalSAD;
+    max_mag = stat.max_mag;
+    min_mag = stat.min_mag;
+
     video->sumMAD = (float)totalSAD / (float)NumPixelMB;    /* avg SAD */
 
     /* find f_code , 10/27/2000 */
@@ -521,7 +642,7 @@ void MotionEstimation(VideoEncData *video)
     if (collect)
     {
         collect = 0;
-        UpdateHTFM(video, newvar, exp_lamda, &htfm_stat);
+        UpdateHTFM(video, newvar, exp_lamda, htfm_stat);
     }
     /*********************************/
 #endif
@@ -165,7 +165,7 @@ OSCL_EXPORT_REF Bool PVGetDefaultEncOption(VideoEncOptions *encOption, Int encUs
 {
     VideoEncOptions defaultUseCase = {H263_MODE, profile_level_max_packet_size[SIMPLE_PROFILE_LEVEL0] >> 3,
                                       SIMPLE_PROFILE_LEVEL0, PV_OFF, 0, 1, 1000, 33, {144, 144}, {176, 176}, {15, 30}, {64000, 128000},
-                                      {10, 10}, {12, 12}, {0, 0}, CBR_1, 0.0, PV_OFF, -1, 0, PV_OFF, 16, PV_OFF, 0, PV_ON
+                                      {10, 10}, {12, 12}, {0, 0}, CBR_1, 0.0, PV_OFF, -1, 0, PV_OFF, 16, PV_OFF, 0, PV_ON, 1
                                      };
 
     OSCL_UNUSED_ARG(encUseCase); // unused for now. Later we can add more defaults setting and use this
@@ -309,6 +309,7 @@ OSCL_EXPORT_REF Bool    PVInitVideoEncoder(VideoEncControls *encoderControl, Vid
     encParams->RC_Type = encOption->rcType;
     encParams->Refresh = encOption->numIntraMB;
     encParams->ResyncMarkerDisable = 0; /* Enable Resync Marker */
+    encParams->NumThreads = encOption->numThreads;
 
     for (i = 0; i < encOption->numLayers; i++)
     {
@@ -719,6 +720,9 @@ OSCL_EXPORT_REF Bool    PVInitVideoEncoder(VideoEncControls *encoderControl, Vid
     if (video->outputMB == NULL) goto CLEAN_UP;
     M4VENC_MEMSET(video->outputMB->block[0], 0, (sizeof(Short) << 6)*6);
 
+    /* runs on the encoding thread alone if the threads cannot be started */
+    InitRowThreads(video, max_width >> 4, max_height >> 4);
+
     M4VENC_MEMSET(video->dataBlock, 0, sizeof(Short) << 7);
     /* Allocate (2*packetsize) working bitstreams */
 
@@ -1176,6 +1180,7 @@ OSCL_EXPORT_REF Bool    PVCleanUpVideoEncoder(VideoEncControls *encoderControl)
         video->predDCAC_row = NULL;
         if (video->predDCAC_col) M4VENC_FREE(video->predDCAC_col);
         if (video->outputMB)M4VENC_FREE(video->outputMB);
+        if (video->rowThreads) CleanRowThreads(video);
 
         if (video->bitstream1)BitstreamCloseEnc(video->bitstream1);
         if (video->bitstream2)BitstreamCloseEnc(video->bitstream2);
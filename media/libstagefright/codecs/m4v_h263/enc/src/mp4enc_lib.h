@@ -106,7 +106,7 @@ extern "C"
                                Int width, Int round1);
 
     void EncPrediction_Chrom(Int xpred, Int ypred, UChar *cu_prev, UChar *cv_prev, UChar *cu_rec,
-                             UChar *cv_rec, Int pitch_uv, Int width_uv, Int height_uv, Int round1);
+                             UChar *cv_rec, Int pitch_uv, Int width_uv, Int height_uv, Int round1, Int padded);
 
     void get_MB(UChar *c_prev, UChar *c_prev_u  , UChar *c_prev_v,
                 Short mb[6][64], Int width, Int width_uv);
@@ -120,6 +120,18 @@ extern "C"
     void UpdateHTFM(VideoEncData *video, double *newvar, double *exp_lamda, HTFM_Stat *htfm_stat);
 #endif
 
+    /* defined in row_threads.cpp */
+    void InitRowThreads(VideoEncData *video, Int mbwidth, Int mbheight);
+    void CleanRowThreads(VideoEncData *video);
+    void StartRowThreads(VideoEncData *video, Int numRows, RowThreadFunc func, void *arg);
+    void FinishRowThreads(VideoEncData *video, Bool help);
+    void WaitForRow(RowThreads *threads, Int j, Int progress);
+    void SetRowProgress(RowThreads *threads, Int j, Int progress);
+    CodedMB *BeginCodedMBRow(RowThreads *threads, Int j);
+    void EndCodedMBRow(RowThreads *threads, Int j);
+    CodedMB *GetCodedMBRow(RowThreads *threads, Int j);
+    void ReleaseCodedMBRow(RowThreads *threads, Int j);
+
     /* defined in ME_utils.c */
     void ChooseMode_C(UChar *Mode, UChar *cur, Int lx, Int min_SAD);
     void ChooseMode_MMX(UChar *Mode, UChar *cur, Int lx, Int min_SAD);
@@ -134,6 +134,14 @@ typedef struct tagMacroBlock
     Short   block[9][64];       /* 4-Y, U and V blocks , and AAN Scale*/
 } MacroBlock;
 
+/* CodeMB() output of a macroblock, kept until it is VLC encoded */
+typedef struct tagCodedMB
+{
+    MacroBlock  mb;             /* quantized coefficients, VLC encoding resets them to zero */
+    UInt    bitmapzz[6][2];     /* zigzag bitmap */
+    Int     ncoefblck[6];       /* last nonzero coefficient of each block */
+} CodedMB;
+
 typedef struct tagRunLevelBlock
 {
     Int run[64];        /* Runlength */
@@ -227,6 +235,7 @@ typedef struct tagVideoEncParams
     float   VBV_delay;              /* VBV buffer size in the form of delay */
     Int     maxFrameSize;           /* maximum frame size(bits) for H263/Short header mode, k*16384 */
     Int     profile_table_index;    /* index for profile and level tables given the specified profile and level */
+    Int     NumThreads;             /* Number of threads processing macroblock rows, 0 or 1 for none */
 
 } VideoEncParams;
 
@@ -313,6 +322,11 @@ typedef struct tagHTFM_Stat
 } HTFM_Stat;
 #endif
 
+/* Worker threads processing rows of macroblocks in parallel, private to row_threads.cpp */
+typedef struct tagRowThreads RowThreads;
+
+#define MAX_ROW_THREADS 8
+
 /* Global structure that can be passed around */
 typedef struct tagVideoEncData
 {
@@ -430,8 +444,14 @@ typedef struct tagVideoEncData
 
     MultiPass *pMP[4]; /* for multipass encoding, 4 represents 4 layer encoding */
 
+    RowThreads *rowThreads; /* NULL if all macroblock rows are processed on the encoding thread */
+
 } VideoEncData;
 
+/* Processes macroblock row j on a worker thread, video is the worker's copy of the encoder
+   data and worker its index, 0 for the encoding thread */
+typedef void (*RowThreadFunc)(VideoEncData *video, Int j, Int worker, void *arg);
+
 /*************************************************************/
 /*                  VLC structures                           */
 /*************************************************************/
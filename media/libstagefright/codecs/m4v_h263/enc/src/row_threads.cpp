@@ -0,0 +1,319 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Worker threads processing the rows of macroblocks of a VOP in parallel. A pass hands out
+   the rows in order to the workers, each working on its own copy of VideoEncData for the
+   per-macroblock scratch memory. Dependencies between rows are expressed with the row
+   progress counters, see MotionEstimation() and EncodeFrameCombinedMode(). */
+
+#include "mp4def.h"
+#include "mp4enc_lib.h"
+#include "mp4lib_int.h"
+#include "m4venc_oscl.h"
+
+#include <pthread.h>
+
+typedef struct tagRowWorker
+{
+    RowThreads *threads;
+    pthread_t thread;
+    Int index;
+    VideoEncData video;     /* private copy, set up when a pass starts */
+} RowWorker;
+
+struct tagRowThreads
+{
+    pthread_mutex_t lock;
+    pthread_cond_t cond;    /* signals a new pass, row progress and the end of a pass */
+    Int numWorkers;         /* worker[0] is used by the encoding thread */
+    RowWorker *worker;
+    Int *rowProgress;       /* for each row, see WaitForRow() */
+    Int numWaiting;         /* threads in WaitForRow(), no need to signal progress if none */
+    Bool exit;
+
+    /* coded macroblocks between CodeMB() and the VLC encoding */
+    CodedMB *codedMB;       /* numCodedRows rows of mbwidth macroblocks */
+    Int numCodedRows;
+    Int mbwidth;
+
+    /* current pass */
+    Int generation;
+    RowThreadFunc func;
+    void *arg;
+    Int numRows;
+    Int nextRow;
+    Int rowsDone;
+};
+
+/* Runs rows of the pass |generation| until there are none left. */
+static void RunRows(RowWorker *worker, Int generation)
+{
+    RowThreads *threads = worker->threads;
+    Int j;
+
+    pthread_mutex_lock(&threads->lock);
+    while (threads->generation == generation && threads->nextRow < threads->numRows)
+    {
+        j = threads->nextRow++;
+        pthread_mutex_unlock(&threads->lock);
+
+        (*threads->func)(&worker->video, j, worker->index, threads->arg);
+
+        pthread_mutex_lock(&threads->lock);
+        threads->rowsDone++;
+        pthread_cond_broadcast(&threads->cond);
+    }
+    pthread_mutex_unlock(&threads->lock);
+}
+
+static void *RowWorkerMain(void *arg)
+{
+    RowWorker *worker = (RowWorker*) arg;
+    RowThreads *threads = worker->threads;
+    Int generation = 0;
+
+    pthread_mutex_lock(&threads->lock);
+    for (;;)
+    {
+        while (!threads->exit && threads->generation == generation)
+        {
+            pthread_cond_wait(&threads->cond, &threads->lock);
+        }
+        if (threads->exit)
+        {
+            break;
+        }
+        generation = threads->generation;
+        pthread_mutex_unlock(&threads->lock);
+
+        RunRows(worker, generation);
+
+        pthread_mutex_lock(&threads->lock);
+    }
+    pthread_mutex_unlock(&threads->lock);
+
+    return NULL;
+}
+
+static void FreeRowThreads(RowThreads *threads, Int numStarted)
+{
+    Int i;
+
+    pthread_mutex_lock(&threads->lock);
+    threads->exit = TRUE;
+    pthread_cond_broadcast(&threads->cond);
+    pthread_mutex_unlock(&threads->lock);
+
+    for (i = 1; i < numStarted; i++)
+    {
+        pthread_join(threads->worker[i].thread, NULL);
+    }
+
+    pthread_cond_destroy(&threads->cond);
+    pthread_mutex_destroy(&threads->lock);
+
+    if (threads->codedMB) M4VENC_FREE(threads->codedMB);
+    if (threads->rowProgress) M4VENC_FREE(threads->rowProgress);
+    if (threads->worker) M4VENC_FREE(threads->worker);
+    M4VENC_FREE(threads);
+}
+
+/* ======================================================================== */
+/*  Function : InitRowThreads()                                             */
+/*  Purpose  : Start encParams->NumThreads - 1 workers for VOPs of at most  */
+/*             mbwidth x mbheight macroblocks. The rows are processed on    */
+/*             the encoding thread if that fails.                           */
+/* ======================================================================== */
+void InitRowThreads(VideoEncData *video, Int mbwidth, Int mbheight)
+{
+    Int numWorkers = video->encParams->NumThreads;
+    RowThreads *threads;
+    Int i;
+
+    video->rowThreads = NULL;
+
+    /* each thread handles at least two rows of a frame */
+    if (numWorkers > MAX_ROW_THREADS)
+        numWorkers = MAX_ROW_THREADS;
+    if (numWorkers > (mbheight >> 1))
+        numWorkers = mbheight >> 1;
+    if (numWorkers <= 1)
+        return ;
+
+    threads = (RowThreads*) M4VENC_MALLOC(sizeof(RowThreads));
+    if (threads == NULL)
+        return ;
+    M4VENC_MEMSET(threads, 0, sizeof(RowThreads));
+    pthread_mutex_init(&threads->lock, NULL);
+    pthread_cond_init(&threads->cond, NULL);
+
+    /* the rows being coded and those waiting for the VLC encoding */
+    threads->numCodedRows = PV_MIN(numWorkers << 1, mbheight);
+    threads->mbwidth = mbwidth;
+
+    threads->worker = (RowWorker*) M4VENC_MALLOC(sizeof(RowWorker) * numWorkers);
+    threads->rowProgress = (Int*) M4VENC_MALLOC(sizeof(Int) * mbheight);
+    threads->codedMB = (CodedMB*) M4VENC_MALLOC(sizeof(CodedMB) * threads->numCodedRows * mbwidth);
+    if (threads->worker == NULL || threads->rowProgress == NULL || threads->codedMB == NULL)
+    {
+        FreeRowThreads(threads, 0);
+        return ;
+    }
+    /* CodeMB() only writes the nonzero coefficients */
+    M4VENC_MEMSET(threads->codedMB, 0, sizeof(CodedMB) * threads->numCodedRows * mbwidth);
+
+    threads->numWorkers = numWorkers;
+    for (i = 0; i < numWorkers; i++)
+    {
+        threads->worker[i].threads = threads;
+        threads->worker[i].index = i;
+        if (i > 0 && pthread_create(&threads->worker[i].thread, NULL, RowWorkerMain,
+                                    &threads->worker[i]) != 0)
+        {
+            FreeRowThreads(threads, i);
+            return ;
+        }
+    }
+
+    video->rowThreads = threads;
+}
+
+void CleanRowThreads(VideoEncData *video)
+{
+    if (video->rowThreads)
+    {
+        FreeRowThreads(video->rowThreads, video->rowThreads->numWorkers);
+        video->rowThreads = NULL;
+    }
+}
+
+/* ======================================================================== */
+/*  Function : StartRowThreads()                                            */
+/*  Purpose  : Start a pass running func on rows 0 to numRows - 1, each     */
+/*             worker on a copy of video taken now. The caller must not     */
+/*             change video in ways the rows depend on until the pass is    */
+/*             finished.                                                    */
+/* ======================================================================== */
+void StartRowThreads(VideoEncData *video, Int numRows, RowThreadFunc func, void *arg)
+{
+    RowThreads *threads = video->rowThreads;
+    UChar *base = (UChar*) video;
+    UChar *extra_info = (UChar*) video->sad_extra_info;
+    Int i;
+
+    for (i = 0; i < threads->numWorkers; i++)
+    {
+        M4VENC_MEMCPY(&threads->worker[i].video, video, sizeof(VideoEncData));
+
+        /* point to the copy of the HTFM statistics and thresholds */
+        if (extra_info >= base && extra_info < base + sizeof(VideoEncData))
+        {
+            threads->worker[i].video.sad_extra_info =
+                (void*)((UChar*) &threads->worker[i].video + (extra_info - base));
+        }
+    }
+
+    pthread_mutex_lock(&threads->lock);
+    M4VENC_MEMSET(threads->rowProgress, 0, sizeof(Int) * numRows);
+    threads->func = func;
+    threads->arg = arg;
+    threads->numRows = numRows;
+    threads->nextRow = 0;
+    threads->rowsDone = 0;
+    threads->generation++;
+    pthread_cond_broadcast(&threads->cond);
+    pthread_mutex_unlock(&threads->lock);
+}
+
+/* ======================================================================== */
+/*  Function : FinishRowThreads()                                           */
+/*  Purpose  : Wait for the end of the pass, running rows on the encoding   */
+/*             thread too if help is set.                                   */
+/* ======================================================================== */
+void FinishRowThreads(VideoEncData *video, Bool help)
+{
+    RowThreads *threads = video->rowThreads;
+
+    if (help)
+    {
+        RunRows(&threads->worker[0], threads->generation);
+    }
+
+    pthread_mutex_lock(&threads->lock);
+    while (threads->rowsDone < threads->numRows)
+    {
+        pthread_cond_wait(&threads->cond, &threads->lock);
+    }
+    pthread_mutex_unlock(&threads->lock);
+}
+
+/* Waits until row j of the current pass has reached progress, the meaning of which is up
+   to the pass. Rows start at 0. */
+void WaitForRow(RowThreads *threads, Int j, Int progress)
+{
+    pthread_mutex_lock(&threads->lock);
+    while (threads->rowProgress[j] < progress)
+    {
+        threads->numWaiting++;
+        pthread_cond_wait(&threads->cond, &threads->lock);
+        threads->numWaiting--;
+    }
+    pthread_mutex_unlock(&threads->lock);
+}
+
+void SetRowProgress(RowThreads *threads, Int j, Int progress)
+{
+    pthread_mutex_lock(&threads->lock);
+    threads->rowProgress[j] = progress;
+    if (threads->numWaiting)
+    {
+        pthread_cond_broadcast(&threads->cond);
+    }
+    pthread_mutex_unlock(&threads->lock);
+}
+
+/* A row of coded macroblocks goes through the states below, the buffer of row j is reused
+   for row j + numCodedRows once its VLC encoding is done. */
+#define ROW_CODING      0
+#define ROW_CODED       1
+#define ROW_RELEASED    2
+
+/* Returns the buffer for coding row j on a worker. */
+CodedMB *BeginCodedMBRow(RowThreads *threads, Int j)
+{
+    if (j >= threads->numCodedRows)
+    {
+        WaitForRow(threads, j - threads->numCodedRows, ROW_RELEASED);
+    }
+    return threads->codedMB + (j % threads->numCodedRows) * threads->mbwidth;
+}
+
+void EndCodedMBRow(RowThreads *threads, Int j)
+{
+    SetRowProgress(threads, j, ROW_CODED);
+}
+
+/* Returns row j once it is coded, for the VLC encoding on the encoding thread. */
+CodedMB *GetCodedMBRow(RowThreads *threads, Int j)
+{
+    WaitForRow(threads, j, ROW_CODED);
+    return threads->codedMB + (j % threads->numCodedRows) * threads->mbwidth;
+}
+
+void ReleaseCodedMBRow(RowThreads *threads, Int j)
+{
+    SetRowProgress(threads, j, ROW_RELEASED);
+}
@@ -42,6 +42,15 @@ LOCAL_SRC_FILES += \
  	src/pvmp3_dct_16.cpp
 endif
 
+# Vector versions of the polyphase synthesis window, called from the C version.
+LOCAL_SRC_FILES_arm64 := src/pvmp3_polyphase_filter_window_neon.cpp
+LOCAL_CFLAGS_arm64 := -DPV_MP3DEC_NEON
+
+LOCAL_SRC_FILES_x86 := src/pvmp3_polyphase_filter_window_sse2.cpp
+LOCAL_CFLAGS_x86 := -DPV_MP3DEC_SSE2
+LOCAL_SRC_FILES_x86_64 := src/pvmp3_polyphase_filter_window_sse2.cpp
+LOCAL_CFLAGS_x86_64 := -DPV_MP3DEC_SSE2
+
 LOCAL_C_INCLUDES := \
         frameworks/av/media/libstagefright/include \
         $(LOCAL_PATH)/src \
@@ -122,6 +122,10 @@ void pvmp3_polyphase_filter_window(int32 *synth_buffer,
     int32 i;
 
 
+#if defined(PV_MP3DEC_NEON) || defined(PV_MP3DEC_SSE2)
+    pvmp3_polyphase_filter_window_bands(synth_buffer, outPcm, numChannels);
+    winPtr += (SUBBANDS_NUMBER / 2 - 1) << 4;
+#else
     for (int16 j = 1; j < SUBBANDS_NUMBER / 2; j++)
     {
         sum1 = 0x00000020;
@@ -199,6 +203,7 @@ void pvmp3_polyphase_filter_window(int32 *synth_buffer,
         outPcm[k] = saturate16(sum1 >> 6);
         outPcm[(numChannels<<5) - k] = saturate16(sum2 >> 6);
     }
+#endif
 
 
 
@@ -122,6 +122,16 @@ extern "C"
                                        int16 *outPcm,
                                        int32 numChannels);
 
+#if defined(PV_MP3DEC_NEON) || defined(PV_MP3DEC_SSE2)
+    /*
+     *  Outputs 1 to 15 and 17 to 31 of pvmp3_polyphase_filter_window, 4 values of j
+     *  at a time. Bit exact with the C code.
+     */
+    void pvmp3_polyphase_filter_window_bands(int32 *synth_buffer,
+            int16 *outPcm,
+            int32 numChannels);
+#endif
+
 
 #ifdef __cplusplus
 }
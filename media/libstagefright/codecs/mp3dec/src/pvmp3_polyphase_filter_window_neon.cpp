@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* NEON version of the main loop of pvmp3_polyphase_filter_window(), computing
+   the sums of 4 consecutive values of j in the lanes of a vector. The products
+   are truncated the same way as fxp_mac32_Q32(), so the output is bit-exact
+   with the C version. */
+
+#include "pvmp3_polyphase_filter_window.h"
+#include "pvmp3_dec_defs.h"
+#include "pvmp3_tables.h"
+
+#include <arm_neon.h>
+
+/* (int32)(((int64)a * b) >> 32) on each lane */
+static inline int32x4_t mulhi_s32(int32x4_t a, int32x4_t b)
+{
+    int64x2_t lo = vmull_s32(vget_low_s32(a), vget_low_s32(b));
+    int64x2_t hi = vmull_high_s32(a, b);
+
+    return vuzp2q_s32(vreinterpretq_s32_s64(lo), vreinterpretq_s32_s64(hi));
+}
+
+/* loads p[3], p[2], p[1], p[0] */
+static inline int32x4_t load_reversed(const int32 *p)
+{
+    int32x4_t v = vrev64q_s32(vld1q_s32(p));
+
+    return vextq_s32(v, v, 2);
+}
+
+void pvmp3_polyphase_filter_window_bands(int32 *synth_buffer,
+        int16 *outPcm,
+        int32 numChannels)
+{
+    const int32 *winPtr = pqmfSynthWinBands;
+    int32 sum1[4];
+    int32 sum2[4];
+
+    /* the last group also computes j = 16 with a zero window, it is not stored */
+    for (int32 j = 1; j < SUBBANDS_NUMBER / 2; j += 4)
+    {
+        const int32 *pt_1 = &synth_buffer[(SUBBANDS_NUMBER >> 1) + j];
+        const int32 *pt_2 = &synth_buffer[(SUBBANDS_NUMBER >> 1) - j - 3];
+        int32x4_t s1 = vdupq_n_s32(0x00000020);
+        int32x4_t s2 = vdupq_n_s32(0x00000020);
+
+        for (int32 n = 0; n < 8; n += 2)
+        {
+            int32x4_t temp1 = vld1q_s32(&pt_1[SUBBANDS_NUMBER * n]);
+            int32x4_t temp3 = load_reversed(&pt_2[SUBBANDS_NUMBER * (15 - n)]);
+            int32x4_t temp2 = load_reversed(&pt_2[SUBBANDS_NUMBER * (n + 1)]);
+            int32x4_t temp4 = vld1q_s32(&pt_1[SUBBANDS_NUMBER * (14 - n)]);
+            int32x4_t w0 = vld1q_s32(&winPtr[ 0]);
+            int32x4_t w1 = vld1q_s32(&winPtr[ 4]);
+            int32x4_t w2 = vld1q_s32(&winPtr[ 8]);
+            int32x4_t w3 = vld1q_s32(&winPtr[12]);
+
+            s1 = vaddq_s32(s1, mulhi_s32(temp1, w0));
+            s2 = vaddq_s32(s2, mulhi_s32(temp3, w0));
+            s2 = vaddq_s32(s2, mulhi_s32(temp1, w1));
+            s1 = vsubq_s32(s1, mulhi_s32(temp3, w1));
+            s1 = vaddq_s32(s1, mulhi_s32(temp2, w2));
+            s2 = vsubq_s32(s2, mulhi_s32(temp4, w2));
+            s2 = vaddq_s32(s2, mulhi_s32(temp2, w3));
+            s1 = vaddq_s32(s1, mulhi_s32(temp4, w3));
+
+            winPtr += 16;
+        }
+
+        vst1q_s32(sum1, s1);
+        vst1q_s32(sum2, s2);
+
+        for (int32 i = 0; i < 4 && j + i < SUBBANDS_NUMBER / 2; i++)
+        {
+            int32 k = (j + i) << (numChannels - 1);
+            outPcm[k] = saturate16(sum1[i] >> 6);
+            outPcm[(numChannels<<5) - k] = saturate16(sum2[i] >> 6);
+        }
+    }
+}
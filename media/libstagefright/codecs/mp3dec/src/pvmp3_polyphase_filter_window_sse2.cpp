@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* SSE2 version of the main loop of pvmp3_polyphase_filter_window(), computing
+   the sums of 4 consecutive values of j in the lanes of a vector. The products
+   are truncated the same way as fxp_mac32_Q32(), so the output is bit-exact
+   with the C version. */
+
+#include "pvmp3_polyphase_filter_window.h"
+#include "pvmp3_dec_defs.h"
+#include "pvmp3_tables.h"
+
+#include <emmintrin.h>
+
+/* (int32)(((int64)a * b) >> 32) on each lane. SSE2 only has the unsigned
+   32x32->64 multiply, the high word is corrected for negative operands. */
+static inline __m128i mulhi_epi32(__m128i a, __m128i b)
+{
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    __m128i hi = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(3, 1, 3, 1)),
+                                    _mm_shuffle_epi32(odd, _MM_SHUFFLE(3, 1, 3, 1)));
+
+    hi = _mm_sub_epi32(hi, _mm_and_si128(_mm_srai_epi32(a, 31), b));
+    return _mm_sub_epi32(hi, _mm_and_si128(_mm_srai_epi32(b, 31), a));
+}
+
+/* loads p[3], p[2], p[1], p[0] */
+static inline __m128i load_reversed(const int32 *p)
+{
+    return _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) p), _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+void pvmp3_polyphase_filter_window_bands(int32 *synth_buffer,
+        int16 *outPcm,
+        int32 numChannels)
+{
+    const int32 *winPtr = pqmfSynthWinBands;
+    int32 sum1[4];
+    int32 sum2[4];
+
+    /* the last group also computes j = 16 with a zero window, it is not stored */
+    for (int32 j = 1; j < SUBBANDS_NUMBER / 2; j += 4)
+    {
+        const int32 *pt_1 = &synth_buffer[(SUBBANDS_NUMBER >> 1) + j];
+        const int32 *pt_2 = &synth_buffer[(SUBBANDS_NUMBER >> 1) - j - 3];
+        __m128i s1 = _mm_set1_epi32(0x00000020);
+        __m128i s2 = _mm_set1_epi32(0x00000020);
+
+        for (int32 n = 0; n < 8; n += 2)
+        {
+            __m128i temp1 = _mm_loadu_si128((const __m128i *) &pt_1[SUBBANDS_NUMBER * n]);
+            __m128i temp3 = load_reversed(&pt_2[SUBBANDS_NUMBER * (15 - n)]);
+            __m128i temp2 = load_reversed(&pt_2[SUBBANDS_NUMBER * (n + 1)]);
+            __m128i temp4 = _mm_loadu_si128((const __m128i *) &pt_1[SUBBANDS_NUMBER * (14 - n)]);
+            __m128i w0 = _mm_loadu_si128((const __m128i *) &winPtr[ 0]);
+            __m128i w1 = _mm_loadu_si128((const __m128i *) &winPtr[ 4]);
+            __m128i w2 = _mm_loadu_si128((const __m128i *) &winPtr[ 8]);
+            __m128i w3 = _mm_loadu_si128((const __m128i *) &winPtr[12]);
+
+            s1 = _mm_add_epi32(s1, mulhi_epi32(temp1, w0));
+            s2 = _mm_add_epi32(s2, mulhi_epi32(temp3, w0));
+            s2 = _mm_add_epi32(s2, mulhi_epi32(temp1, w1));
+            s1 = _mm_sub_epi32(s1, mulhi_epi32(temp3, w1));
+            s1 = _mm_add_epi32(s1, mulhi_epi32(temp2, w2));
+            s2 = _mm_sub_epi32(s2, mulhi_epi32(temp4, w2));
+            s2 = _mm_add_epi32(s2, mulhi_epi32(temp2, w3));
+            s1 = _mm_add_epi32(s1, mulhi_epi32(temp4, w3));
+
+            winPtr += 16;
+        }
+
+        _mm_storeu_si128((__m128i *) sum1, s1);
+        _mm_storeu_si128((__m128i *) sum2, s2);
+
+        for (int32 i = 0; i < 4 && j + i < SUBBANDS_NUMBER / 2; i++)
+        {
+            int32 k = (j + i) << (numChannels - 1);
+            outPcm[k] = saturate16(sum1[i] >> 6);
+            outPcm[(numChannels<<5) - k] = saturate16(sum2[i] >> 6);
+        }
+    }
+}
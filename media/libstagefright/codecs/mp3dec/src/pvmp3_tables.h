@@ -92,6 +92,9 @@ extern "C"
     extern const  mp3_scaleFactorBandIndex mp3_sfBandIndex[9];
     extern const int32 mp3_shortwindBandWidths[9][13];
     extern const int32 pqmfSynthWin[(HAN_SIZE/2) + 8];
+#if defined(PV_MP3DEC_NEON) || defined(PV_MP3DEC_SSE2)
+    extern const int32 pqmfSynthWinBands[16*16];
+#endif
 
 
     extern const uint16 huffTable_1[];
@@ -103,19 +103,6 @@ static size_t getMinTimestampIdx(OMX_S64 *pNTimeStamp, bool *pIsTimeStampValid)
     return idx;
 }
 
-static size_t GetCPUCoreCount() {
-    long cpuCoreCount = 1;
-#if defined(_SC_NPROCESSORS_ONLN)
-    cpuCoreCount = sysconf(_SC_NPROCESSORS_ONLN);
-#else
-    // _SC_NPROC_ONLN must be defined...
-    cpuCoreCount = sysconf(_SC_NPROC_ONLN);
-#endif
-    CHECK(cpuCoreCount >= 1);
-    ALOGV("Number of CPU cores: %ld", cpuCoreCount);
-    return (size_t)cpuCoreCount;
-}
-
 void SoftMPEG2::logVersion() {
     ivd_ctl_getversioninfo_ip_t s_ctl_ip;
     ivd_ctl_getversioninfo_op_t s_ctl_op;
@@ -211,7 +198,8 @@ status_t SoftMPEG2::setNumCores() {
     IV_API_CALL_STATUS_T status;
     s_set_cores_ip.e_cmd = IVD_CMD_VIDEO_CTL;
     s_set_cores_ip.e_sub_cmd = IVDEXT_CMD_CTL_SET_NUM_CORES;
-    s_set_cores_ip.u4_num_cores = MIN(mNumCores, CODEC_MAX_NUM_CORES);
+    mNumCores = acquireDecoderCores(CODEC_MAX_NUM_CORES);
+    s_set_cores_ip.u4_num_cores = mNumCores;
     s_set_cores_ip.u4_size = sizeof(ivdext_ctl_set_num_cores_ip_t);
     s_set_cores_op.u4_size = sizeof(ivdext_ctl_set_num_cores_op_t);
 
@@ -256,7 +244,6 @@ status_t SoftMPEG2::initDecoder() {
     UWORD32 u4_num_ref_frames;
     UWORD32 u4_share_disp_buf;
 
-    mNumCores = GetCPUCoreCount();
     mWaitForI = true;
 
     /* Initialize number of ref and reorder modes (for MPEG2) */
@@ -428,6 +415,7 @@ status_t SoftMPEG2::deInitDecoder() {
     }
 
     mInitNeeded = true;
+    releaseDecoderCores();
     mChangingResolution = false;
 
     return OK;
@@ -460,7 +448,9 @@ OMX_ERRORTYPE SoftMPEG2::internalSetParameter(OMX_INDEXTYPE index, const OMX_PTR
     const uint32_t oldWidth = mWidth;
     const uint32_t oldHeight = mHeight;
     OMX_ERRORTYPE ret = SoftVideoDecoderOMXComponent::internalSetParameter(index, params);
-    if (mWidth != oldWidth || mHeight != oldHeight) {
+    const int32_t indexFull = index;
+    if (mWidth != oldWidth || mHeight != oldHeight
+            || (indexFull == kDecoderThreadsIndex && ret == OMX_ErrorNone)) {
         reInitDecoder();
     }
     return ret;
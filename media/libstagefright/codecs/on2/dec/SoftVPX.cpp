@@ -50,6 +50,7 @@ SoftVPX::SoftVPX(
     initPorts(
             kNumBuffers, kMaxOutputBufferSize / kMinCompressionRatio /* inputBufferSize */,
             kNumBuffers, mime, kMinCompressionRatio);
+    supportNativeBuffers();
     CHECK_EQ(initDecoder(), (status_t)OK);
 }
 
@@ -57,19 +58,6 @@ SoftVPX::~SoftVPX() {
     destroyDecoder();
 }
 
-static int GetCPUCoreCount() {
-    int cpuCoreCount = 1;
-#if defined(_SC_NPROCESSORS_ONLN)
-    cpuCoreCount = sysconf(_SC_NPROCESSORS_ONLN);
-#else
-    // _SC_NPROC_ONLN must be defined...
-    cpuCoreCount = sysconf(_SC_NPROC_ONLN);
-#endif
-    CHECK(cpuCoreCount >= 1);
-    ALOGV("Number of CPU cores: %d", cpuCoreCount);
-    return cpuCoreCount;
-}
-
 status_t SoftVPX::initDecoder() {
     mCtx = new vpx_codec_ctx_t;
     vpx_codec_err_t vpx_err;
@@ -77,7 +65,7 @@ status_t SoftVPX::initDecoder() {
     vpx_codec_flags_t flags;
     memset(&cfg, 0, sizeof(vpx_codec_dec_cfg_t));
     memset(&flags, 0, sizeof(vpx_codec_flags_t));
-    cfg.threads = GetCPUCoreCount();
+    cfg.threads = acquireDecoderCores(kMaxDecoderThreads);
 
     if (mFrameParallelMode) {
         flags |= VPX_CODEC_USE_FRAME_THREADING;
@@ -91,6 +79,14 @@ status_t SoftVPX::initDecoder() {
         return UNKNOWN_ERROR;
     }
 
+#ifdef VPX_CTRL_VP9D_SET_ROW_MT
+    // decode the rows of the tiles in parallel too, when there are fewer tiles than threads
+    if (mMode == MODE_VP9 && !mFrameParallelMode && cfg.threads > 1
+            && vpx_codec_control((vpx_codec_ctx_t *)mCtx, VP9D_SET_ROW_MT, 1)) {
+        ALOGW("on2 decoder failed to enable row based multi-threading.");
+    }
+#endif
+
     return OK;
 }
 
@@ -98,6 +94,8 @@ status_t SoftVPX::destroyDecoder() {
     vpx_codec_destroy((vpx_codec_ctx_t *)mCtx);
     delete (vpx_codec_ctx_t *)mCtx;
     mCtx = NULL;
+    mImg = NULL;
+    releaseDecoderCores();
     return OK;
 }
 
@@ -150,14 +148,16 @@ bool SoftVPX::outputBuffers(bool flushDecoder, bool display, bool eos, bool *por
         outHeader->nFilledLen = (outputBufferWidth() * outputBufferHeight() * 3) / 2;
         outHeader->nTimeStamp = *(OMX_TICKS *)mImg->user_priv;
 
-        uint8_t *dst = outHeader->pBuffer;
         const uint8_t *srcY = (const uint8_t *)mImg->planes[VPX_PLANE_Y];
         const uint8_t *srcU = (const uint8_t *)mImg->planes[VPX_PLANE_U];
         const uint8_t *srcV = (const uint8_t *)mImg->planes[VPX_PLANE_V];
         size_t srcYStride = mImg->stride[VPX_PLANE_Y];
         size_t srcUStride = mImg->stride[VPX_PLANE_U];
         size_t srcVStride = mImg->stride[VPX_PLANE_V];
-        copyYV12FrameToOutputBuffer(dst, srcY, srcU, srcV, srcYStride, srcUStride, srcVStride);
+        if (!copyYV12FrameToOutputBuffer(
+                outHeader, srcY, srcU, srcV, srcYStride, srcUStride, srcVStride)) {
+            return false;
+        }
 
         mImg = NULL;
         outInfo->mOwnedByUs = false;
@@ -266,6 +266,79 @@ void SoftVPX::onPortFlushCompleted(OMX_U32 portIndex) {
     }
 }
 
+OMX_ERRORTYPE SoftVPX::internalGetParameter(OMX_INDEXTYPE index, OMX_PTR params) {
+    // Include extension index OMX_INDEXEXTTYPE.
+    const int32_t indexFull = index;
+
+    switch (indexFull) {
+        case kFrameParallelIndex:
+        {
+            OMX_PARAM_U32TYPE *frameParallelParams = (OMX_PARAM_U32TYPE *)params;
+
+            if (frameParallelParams->nPortIndex != kOutputPortIndex) {
+                return OMX_ErrorUndefined;
+            }
+
+            frameParallelParams->nU32 = mFrameParallelMode;
+            return OMX_ErrorNone;
+        }
+
+        default:
+            return SoftVideoDecoderOMXComponent::internalGetParameter(index, params);
+    }
+}
+
+OMX_ERRORTYPE SoftVPX::internalSetParameter(OMX_INDEXTYPE index, const OMX_PTR params) {
+    // Include extension index OMX_INDEXEXTTYPE.
+    const int32_t indexFull = index;
+
+    switch (indexFull) {
+        case kFrameParallelIndex:
+        {
+            const OMX_PARAM_U32TYPE *frameParallelParams = (const OMX_PARAM_U32TYPE *)params;
+
+            if (frameParallelParams->nPortIndex != kOutputPortIndex || mMode != MODE_VP9) {
+                return OMX_ErrorUndefined;
+            }
+
+            bool frameParallelMode = frameParallelParams->nU32 != 0;
+            if (frameParallelMode != mFrameParallelMode) {
+                mFrameParallelMode = frameParallelMode;
+                destroyDecoder();
+                if (initDecoder() != OK) {
+                    return OMX_ErrorUndefined;
+                }
+            }
+            return OMX_ErrorNone;
+        }
+
+        case kDecoderThreadsIndex:
+        {
+            OMX_ERRORTYPE err = SoftVideoDecoderOMXComponent::internalSetParameter(index, params);
+            if (err == OMX_ErrorNone) {
+                // the threads are set up when the decoder is created
+                destroyDecoder();
+                if (initDecoder() != OK) {
+                    return OMX_ErrorUndefined;
+                }
+            }
+            return err;
+        }
+
+        default:
+            return SoftVideoDecoderOMXComponent::internalSetParameter(index, params);
+    }
+}
+
+OMX_ERRORTYPE SoftVPX::getExtensionIndex(const char *name, OMX_INDEXTYPE *index) {
+    if (mMode == MODE_VP9 && !strcmp(name, "OMX.google.android.index.frameParallelDecoding")) {
+        *(int32_t*)index = kFrameParallelIndex;
+        return OMX_ErrorNone;
+    }
+
+    return SoftVideoDecoderOMXComponent::getExtensionIndex(name, index);
+}
+
 void SoftVPX::onReset() {
     bool portWillReset = false;
     if (!outputBuffers(
@@ -41,11 +41,26 @@ protected:
     virtual void onPortFlushCompleted(OMX_U32 portIndex);
     virtual void onReset();
 
+    virtual OMX_ERRORTYPE internalGetParameter(OMX_INDEXTYPE index, OMX_PTR params);
+    virtual OMX_ERRORTYPE internalSetParameter(OMX_INDEXTYPE index, const OMX_PTR params);
+    virtual OMX_ERRORTYPE getExtensionIndex(const char *name, OMX_INDEXTYPE *index);
+
 private:
     enum {
         kNumBuffers = 4
     };
 
+    enum {
+        // the most tile columns, and so VP9 decoder threads, of a 4K stream
+        kMaxDecoderThreads = 16
+    };
+
+    enum {
+        // OMX_PARAM_U32TYPE on the output port, nonzero to decode VP9 frames in parallel.
+        // This adds the latency of a frame per thread.
+        kFrameParallelIndex = kUseNativeBufferIndex + 1,
+    };
+
     enum {
         MODE_VP8,
         MODE_VP9
@@ -5,6 +5,15 @@ LOCAL_SRC_FILES:=                     \
         ColorConverter.cpp            \
         SoftwareRenderer.cpp
 
+# Vector versions of the YUV 4:2:0 row conversion, called from ColorConverter.cpp.
+LOCAL_SRC_FILES_arm64 := ColorConverter_neon.cpp
+LOCAL_CFLAGS_arm64 := -DCOLOR_CONVERSION_NEON
+
+LOCAL_SRC_FILES_x86 := ColorConverter_sse2.cpp
+LOCAL_CFLAGS_x86 := -DCOLOR_CONVERSION_SSE2
+LOCAL_SRC_FILES_x86_64 := ColorConverter_sse2.cpp
+LOCAL_CFLAGS_x86_64 := -DCOLOR_CONVERSION_SSE2
+
 LOCAL_C_INCLUDES := \
         $(TOP)/frameworks/native/include/media/openmax \
         $(TOP)/hardware/msm7k
@@ -23,13 +23,18 @@
 #include <media/stagefright/ColorConverter.h>
 #include <media/stagefright/MediaErrors.h>
 
+#include <pthread.h>
+
+#include "ColorConverterRows.h"
+
 namespace android {
 
 ColorConverter::ColorConverter(
         OMX_COLOR_FORMATTYPE from, OMX_COLOR_FORMATTYPE to)
     : mSrcFormat(from),
       mDstFormat(to),
-      mClip(NULL) {
+      mClip(NULL),
+      mNumThreads(1) {
 }
 
 ColorConverter::~ColorConverter() {
@@ -56,6 +61,28 @@ bool ColorConverter::isValid() const {
     }
 }
 
+bool ColorConverter::supportsDownscaling() const {
+    if (!isValid()) {
+        return false;
+    }
+
+    switch (mSrcFormat) {
+        case OMX_COLOR_FormatYUV420Planar:
+        case OMX_QCOM_COLOR_FormatYVU420SemiPlanar:
+        case OMX_COLOR_FormatYUV420SemiPlanar:
+        case OMX_TI_COLOR_FormatYUV420PackedSemiPlanar:
+        case OMX_COLOR_FormatYUV422Planar:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+void ColorConverter::setNumThreads(size_t numThreads) {
+    mNumThreads = numThreads > 0 ? numThreads : 1;
+}
+
 ColorConverter::BitmapParams::BitmapParams(
         void *bits,
         size_t width, size_t height,
@@ -201,31 +228,130 @@ status_t ColorConverter::convertCbYCrY(
     return OK;
 }
 
-status_t ColorConverter::convertYUV420Planar(
-        const BitmapParams &src, const BitmapParams &dst) {
-    if (!((src.mCropLeft & 1) == 0
-            && src.cropWidth() == dst.cropWidth()
-            && src.cropHeight() == dst.cropHeight())) {
-        return ERROR_UNSUPPORTED;
+// static
+bool ColorConverter::GetDownscaleShift(
+        const BitmapParams &src, const BitmapParams &dst, size_t *shift) {
+    static const size_t kMaxShift = 4;
+
+    for (size_t i = 0; i <= kMaxShift; ++i) {
+        if (src.cropWidth() >> i == dst.cropWidth()
+                && src.cropHeight() >> i == dst.cropHeight()) {
+            *shift = i;
+            return true;
+        }
     }
+    return false;
+}
 
-    uint8_t *kAdjustedClip = initClip();
+// A YUV 4:2:0 image with its chroma planes either separate or interleaved, and the
+// RGB565 destination for the same rows.
+struct ColorConverter::YUV420Image {
+    const uint8_t *mY;
+    size_t mYStride;
+    const uint8_t *mU;
+    const uint8_t *mV;
+    size_t mChromaStride;
+    size_t mChromaStep;     // 1 for separate planes, 2 for interleaved
+    bool mSwapRB;           // blue in the high bits
+    uint16_t *mDst;
+    size_t mDstStride;
+    size_t mWidth;          // of the source
+    size_t mHeight;
+    size_t mShift;          // the destination is downscaled by 1 << mShift
+    const uint8_t *mClip;
+};
+
+// One RGB565 pixel, see ConvertYUV420Rows() for the arithmetic.
+static inline uint16_t YUVToRGB565(
+        const uint8_t *kAdjustedClip, signed y, signed u, signed v, bool swapRB) {
+    signed tmp = (y - 16) * 298;
+    u -= 128;
+    v -= 128;
+
+    signed b = (tmp + u * 517) / 256;
+    signed g = (tmp - v * 208 - u * 100) / 256;
+    signed r = (tmp + v * 409) / 256;
+
+    if (swapRB) {
+        signed t = r; r = b; b = t;
+    }
 
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
-        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
+    return ((kAdjustedClip[r] >> 3) << 11)
+        | ((kAdjustedClip[g] >> 2) << 5)
+        | (kAdjustedClip[b] >> 3);
+}
 
-    const uint8_t *src_y =
-        (const uint8_t *)src.mBits + src.mCropTop * src.mWidth + src.mCropLeft;
+// static
+void ColorConverter::ConvertYUV420RowsDownscaled(const YUV420Image &image) {
+    // each pixel is the average of a block of factor x factor pixels
+    const size_t shift = image.mShift;
+    const size_t factor = 1 << shift;
+    const size_t chromaFactor = factor / 2;
+    const size_t step = image.mChromaStep;
+    const size_t width = image.mWidth >> shift;
+    const size_t height = image.mHeight >> shift;
+
+    for (size_t y = 0; y < height; ++y) {
+        const uint8_t *src_y = image.mY + (y << shift) * image.mYStride;
+        const uint8_t *src_u = image.mU + y * chromaFactor * image.mChromaStride;
+        const uint8_t *src_v = image.mV + y * chromaFactor * image.mChromaStride;
+        uint16_t *dst_ptr = image.mDst + y * image.mDstStride;
+
+        for (size_t x = 0; x < width; ++x) {
+            unsigned sumY = 0;
+            for (size_t j = 0; j < factor; ++j) {
+                const uint8_t *row = src_y + j * image.mYStride + (x << shift);
+                for (size_t i = 0; i < factor; ++i) {
+                    sumY += row[i];
+                }
+            }
 
-    const uint8_t *src_u =
-        (const uint8_t *)src_y + src.mWidth * src.mHeight
-        + src.mCropTop * (src.mWidth / 2) + src.mCropLeft / 2;
+            unsigned sumU = 0;
+            unsigned sumV = 0;
+            for (size_t j = 0; j < chromaFactor; ++j) {
+                size_t offset = j * image.mChromaStride + x * chromaFactor * step;
+                for (size_t i = 0; i < chromaFactor; ++i) {
+                    sumU += src_u[offset + i * step];
+                    sumV += src_v[offset + i * step];
+                }
+            }
 
-    const uint8_t *src_v =
-        src_u + (src.mWidth / 2) * (src.mHeight / 2);
+            dst_ptr[x] = YUVToRGB565(image.mClip,
+                    sumY >> (2 * shift), sumU >> (2 * shift - 2), sumV >> (2 * shift - 2),
+                    image.mSwapRB);
+        }
+    }
+}
 
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
+// static
+void ColorConverter::ConvertYUV420Rows(const YUV420Image &image) {
+    if (image.mShift > 0) {
+        ConvertYUV420RowsDownscaled(image);
+        return;
+    }
+
+    const uint8_t *kAdjustedClip = image.mClip;
+
+    const uint8_t *src_y = image.mY;
+    const uint8_t *src_u = image.mU;
+    const uint8_t *src_v = image.mV;
+    uint16_t *dst_ptr = image.mDst;
+    const size_t step = image.mChromaStep;
+
+    for (size_t y = 0; y < image.mHeight; ++y) {
+        size_t x = 0;
+#if defined(COLOR_CONVERSION_NEON) || defined(COLOR_CONVERSION_SSE2)
+        if (step == 1) {
+            x = ConvertPlanarRowToRGB565(
+                    src_y, src_u, src_v, dst_ptr, image.mWidth, image.mSwapRB);
+        } else {
+            x = ConvertSemiPlanarRowToRGB565(
+                    src_y, src_u < src_v ? src_u : src_v, src_v < src_u,
+                    dst_ptr, image.mWidth, image.mSwapRB);
+        }
+#endif
+
+        for (; x < image.mWidth; x += 2) {
             // B = 1.164 * (Y - 16) + 2.018 * (U - 128)
             // G = 1.164 * (Y - 16) - 0.813 * (V - 128) - 0.391 * (U - 128)
             // R = 1.164 * (Y - 16) + 1.596 * (V - 128)
@@ -247,8 +373,8 @@ status_t ColorConverter::convertYUV420Planar(
             signed y1 = (signed)src_y[x] - 16;
             signed y2 = (signed)src_y[x + 1] - 16;
 
-            signed u = (signed)src_u[x / 2] - 128;
-            signed v = (signed)src_v[x / 2] - 128;
+            signed u = (signed)src_u[(x / 2) * step] - 128;
+            signed v = (signed)src_v[(x / 2) * step] - 128;
 
             signed u_b = u * 517;
             signed u_g = -u * 100;
@@ -265,6 +391,11 @@ status_t ColorConverter::convertYUV420Planar(
             signed g2 = (tmp2 + v_g + u_g) / 256;
             signed r2 = (tmp2 + v_r) / 256;
 
+            if (image.mSwapRB) {
+                signed t = r1; r1 = b1; b1 = t;
+                t = r2; r2 = b2; b2 = t;
+            }
+
             uint32_t rgb1 =
                 ((kAdjustedClip[r1] >> 3) << 11)
                 | ((kAdjustedClip[g1] >> 2) << 5)
@@ -275,94 +406,146 @@ status_t ColorConverter::convertYUV420Planar(
                 | ((kAdjustedClip[g2] >> 2) << 5)
                 | (kAdjustedClip[b2] >> 3);
 
-            if (x + 1 < src.cropWidth()) {
+            if (x + 1 < image.mWidth) {
                 *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
             } else {
                 dst_ptr[x] = rgb1;
             }
         }
 
-        src_y += src.mWidth;
+        src_y += image.mYStride;
 
         if (y & 1) {
-            src_u += src.mWidth / 2;
-            src_v += src.mWidth / 2;
+            src_u += image.mChromaStride;
+            src_v += image.mChromaStride;
         }
 
-        dst_ptr += dst.mWidth;
+        dst_ptr += image.mDstStride;
     }
+}
 
-    return OK;
+// static
+void *ColorConverter::ConvertYUV420Thread(void *image) {
+    ConvertYUV420Rows(*(const YUV420Image *)image);
+    return NULL;
 }
 
-status_t ColorConverter::convertQCOMYUV420SemiPlanar(
-        const BitmapParams &src, const BitmapParams &dst) {
-    uint8_t *kAdjustedClip = initClip();
+void ColorConverter::convertYUV420ToRGB565(const YUV420Image &image) {
+    // Bands start on even rows, so that they do not share chroma rows, and on the rows
+    // of a destination row when downscaling.
+    static const size_t kMinRowsPerBand = 32;
+    static const size_t kMaxThreads = 8;
 
-    if (!((src.mCropLeft & 1) == 0
-            && src.cropWidth() == dst.cropWidth()
-            && src.cropHeight() == dst.cropHeight())) {
+    size_t numBands = mNumThreads;
+    if (numBands > kMaxThreads) {
+        numBands = kMaxThreads;
+    }
+    if (numBands > image.mHeight / kMinRowsPerBand) {
+        numBands = image.mHeight / kMinRowsPerBand;
+    }
+    if (numBands <= 1) {
+        ConvertYUV420Rows(image);
+        return;
+    }
+
+    YUV420Image bands[kMaxThreads];
+    pthread_t threads[kMaxThreads];
+    bool started[kMaxThreads];
+
+    size_t rowAlign = image.mShift > 0 ? 1 << image.mShift : 2;
+    size_t rowsPerBand =
+        (image.mHeight / numBands + rowAlign - 1) / rowAlign * rowAlign;
+    size_t firstRow = 0;
+    for (size_t i = 0; i < numBands; ++i) {
+        YUV420Image &band = bands[i];
+        band = image;
+        band.mY += firstRow * image.mYStride;
+        band.mU += (firstRow / 2) * image.mChromaStride;
+        band.mV += (firstRow / 2) * image.mChromaStride;
+        band.mDst += (firstRow >> image.mShift) * image.mDstStride;
+        band.mHeight = (i + 1 < numBands) ? rowsPerBand : image.mHeight - firstRow;
+        firstRow += band.mHeight;
+    }
+
+    // the calling thread converts the first band
+    for (size_t i = 1; i < numBands; ++i) {
+        started[i] = pthread_create(&threads[i], NULL, ConvertYUV420Thread, &bands[i]) == 0;
+        if (!started[i]) {
+            ConvertYUV420Rows(bands[i]);
+        }
+    }
+    ConvertYUV420Rows(bands[0]);
+    for (size_t i = 1; i < numBands; ++i) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+}
+
+status_t ColorConverter::convertYUV420Planar(
+        const BitmapParams &src, const BitmapParams &dst) {
+    YUV420Image image;
+    if ((src.mCropLeft & 1) != 0 || !GetDownscaleShift(src, dst, &image.mShift)) {
         return ERROR_UNSUPPORTED;
     }
 
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
+    image.mClip = initClip();
+
+    image.mDst = (uint16_t *)dst.mBits
         + dst.mCropTop * dst.mWidth + dst.mCropLeft;
+    image.mDstStride = dst.mWidth;
 
-    const uint8_t *src_y =
+    image.mY =
         (const uint8_t *)src.mBits + src.mCropTop * src.mWidth + src.mCropLeft;
+    image.mYStride = src.mWidth;
 
-    const uint8_t *src_u =
-        (const uint8_t *)src_y + src.mWidth * src.mHeight
-        + src.mCropTop * src.mWidth + src.mCropLeft;
+    image.mU =
+        image.mY + src.mWidth * src.mHeight
+        + src.mCropTop * (src.mWidth / 2) + src.mCropLeft / 2;
 
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
+    image.mV =
+        image.mU + (src.mWidth / 2) * (src.mHeight / 2);
 
-            signed u = (signed)src_u[x & ~1] - 128;
-            signed v = (signed)src_u[(x & ~1) + 1] - 128;
+    image.mChromaStride = src.mWidth / 2;
+    image.mChromaStep = 1;
+    image.mSwapRB = false;
+    image.mWidth = src.cropWidth();
+    image.mHeight = src.cropHeight();
 
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
+    convertYUV420ToRGB565(image);
 
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
+    return OK;
+}
 
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
+status_t ColorConverter::convertQCOMYUV420SemiPlanar(
+        const BitmapParams &src, const BitmapParams &dst) {
+    YUV420Image image;
+    if ((src.mCropLeft & 1) != 0 || !GetDownscaleShift(src, dst, &image.mShift)) {
+        return ERROR_UNSUPPORTED;
+    }
 
-            uint32_t rgb1 =
-                ((kAdjustedClip[b1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[r1] >> 3);
+    image.mClip = initClip();
 
-            uint32_t rgb2 =
-                ((kAdjustedClip[b2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[r2] >> 3);
+    image.mDst = (uint16_t *)dst.mBits
+        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
+    image.mDstStride = dst.mWidth;
 
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
-        }
+    image.mY =
+        (const uint8_t *)src.mBits + src.mCropTop * src.mWidth + src.mCropLeft;
+    image.mYStride = src.mWidth;
 
-        src_y += src.mWidth;
+    image.mU =
+        image.mY + src.mWidth * src.mHeight
+        + src.mCropTop * src.mWidth + src.mCropLeft;
+    image.mV = image.mU + 1;
 
-        if (y & 1) {
-            src_u += src.mWidth;
-        }
+    image.mChromaStride = src.mWidth;
+    image.mChromaStep = 2;
+    image.mSwapRB = true;
+    image.mWidth = src.cropWidth();
+    image.mHeight = src.cropHeight();
 
-        dst_ptr += dst.mWidth;
-    }
+    convertYUV420ToRGB565(image);
 
     return OK;
 }
@@ -371,145 +554,68 @@ status_t ColorConverter::convertYUV420SemiPlanar(
         const BitmapParams &src, const BitmapParams &dst) {
     // XXX Untested
 
-    uint8_t *kAdjustedClip = initClip();
-
-    if (!((src.mCropLeft & 1) == 0
-            && src.cropWidth() == dst.cropWidth()
-            && src.cropHeight() == dst.cropHeight())) {
+    YUV420Image image;
+    if ((src.mCropLeft & 1) != 0 || !GetDownscaleShift(src, dst, &image.mShift)) {
         return ERROR_UNSUPPORTED;
     }
 
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
+    image.mClip = initClip();
+
+    image.mDst = (uint16_t *)dst.mBits
         + dst.mCropTop * dst.mWidth + dst.mCropLeft;
+    image.mDstStride = dst.mWidth;
 
-    const uint8_t *src_y =
+    image.mY =
         (const uint8_t *)src.mBits + src.mCropTop * src.mWidth + src.mCropLeft;
+    image.mYStride = src.mWidth;
 
-    const uint8_t *src_u =
-        (const uint8_t *)src_y + src.mWidth * src.mHeight
+    image.mV =
+        image.mY + src.mWidth * src.mHeight
         + src.mCropTop * src.mWidth + src.mCropLeft;
+    image.mU = image.mV + 1;
 
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
-
-            signed v = (signed)src_u[x & ~1] - 128;
-            signed u = (signed)src_u[(x & ~1) + 1] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
-
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[b1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[r1] >> 3);
+    image.mChromaStride = src.mWidth;
+    image.mChromaStep = 2;
+    image.mSwapRB = true;
+    image.mWidth = src.cropWidth();
+    image.mHeight = src.cropHeight();
 
-            uint32_t rgb2 =
-                ((kAdjustedClip[b2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[r2] >> 3);
-
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
-        }
-
-        src_y += src.mWidth;
-
-        if (y & 1) {
-            src_u += src.mWidth;
-        }
-
-        dst_ptr += dst.mWidth;
-    }
+    convertYUV420ToRGB565(image);
 
     return OK;
 }
 
 status_t ColorConverter::convertTIYUV420PackedSemiPlanar(
         const BitmapParams &src, const BitmapParams &dst) {
-    uint8_t *kAdjustedClip = initClip();
-
-    if (!((src.mCropLeft & 1) == 0
-            && src.cropWidth() == dst.cropWidth()
-            && src.cropHeight() == dst.cropHeight())) {
+    YUV420Image image;
+    if ((src.mCropLeft & 1) != 0 || !GetDownscaleShift(src, dst, &image.mShift)) {
         return ERROR_UNSUPPORTED;
     }
 
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
-        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
-
-    const uint8_t *src_y = (const uint8_t *)src.mBits;
-
-    const uint8_t *src_u =
-        (const uint8_t *)src_y + src.mWidth * (src.mHeight - src.mCropTop / 2);
-
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
-
-            signed u = (signed)src_u[x & ~1] - 128;
-            signed v = (signed)src_u[(x & ~1) + 1] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
-
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
+    image.mClip = initClip();
 
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[r1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[b1] >> 3);
-
-            uint32_t rgb2 =
-                ((kAdjustedClip[r2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[b2] >> 3);
+    image.mDst = (uint16_t *)dst.mBits
+        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
+    image.mDstStride = dst.mWidth;
 
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
-        }
+    image.mY = (const uint8_t *)src.mBits;
+    image.mYStride = src.mWidth;
 
-        src_y += src.mWidth;
+    image.mU =
+        image.mY + src.mWidth * (src.mHeight - src.mCropTop / 2);
+    image.mV = image.mU + 1;
 
-        if (y & 1) {
-            src_u += src.mWidth;
-        }
+    image.mChromaStride = src.mWidth;
+    image.mChromaStep = 2;
+    image.mSwapRB = false;
+    image.mWidth = src.cropWidth();
+    image.mHeight = src.cropHeight();
 
-        dst_ptr += dst.mWidth;
-    }
+    convertYUV420ToRGB565(image);
 
     return OK;
 }
+
 status_t ColorConverter::convertYUV422PlanartoYUV420Planar(const BitmapParams &src)
 {
     uint8_t *dst_ptr = (uint8_t *)src.mBits;
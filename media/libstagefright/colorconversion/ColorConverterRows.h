@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COLOR_CONVERTER_ROWS_H_
+#define COLOR_CONVERTER_ROWS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+// Vector versions of the YUV 4:2:0 to RGB565 row conversion in ColorConverter.cpp, built
+// with COLOR_CONVERSION_NEON or COLOR_CONVERSION_SSE2. They convert the pixels of a row
+// 16 at a time with the same integer arithmetic, and return the number of pixels done;
+// the caller converts the rest.
+
+// |u| and |v| are separate chroma rows.
+size_t ConvertPlanarRowToRGB565(
+        const uint8_t *y, const uint8_t *u, const uint8_t *v,
+        uint16_t *dst, size_t width, bool swapRB);
+
+// |uv| is an interleaved chroma row, starting with V if |vFirst|.
+size_t ConvertSemiPlanarRowToRGB565(
+        const uint8_t *y, const uint8_t *uv, bool vFirst,
+        uint16_t *dst, size_t width, bool swapRB);
+
+}  // namespace android
+
+#endif  // COLOR_CONVERTER_ROWS_H_
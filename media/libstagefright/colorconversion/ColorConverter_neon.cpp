@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <arm_neon.h>
+
+#include "ColorConverterRows.h"
+
+namespace android {
+
+// x / 256, rounded towards zero like the C division
+static inline int32x4_t div256(int32x4_t x) {
+    uint32x4_t bias = vshrq_n_u32(vreinterpretq_u32_s32(vshrq_n_s32(x, 31)), 24);
+    return vshrq_n_s32(vaddq_s32(x, vreinterpretq_s32_u32(bias)), 8);
+}
+
+// one channel of 4 pixels, clipped to 0..255 when narrowed
+static inline uint16x4_t channel(int32x4_t luma, int32x4_t chroma) {
+    return vqmovun_s32(div256(vaddq_s32(luma, chroma)));
+}
+
+// one channel of 8 pixels from their luma and the chroma of the first 4 of them
+static inline uint8x8_t channel8(int32x4_t luma0, int32x4_t luma1, int32x4_t chroma) {
+    int32x4x2_t c = vzipq_s32(chroma, chroma);
+    return vqmovn_u16(vcombine_u16(channel(luma0, c.val[0]), channel(luma1, c.val[1])));
+}
+
+static inline uint16x8_t pack565(uint8x8_t hi, uint8x8_t g, uint8x8_t lo) {
+    uint16x8_t rgb = vshll_n_u8(hi, 8);
+    rgb = vsriq_n_u16(rgb, vshll_n_u8(g, 8), 5);
+    return vsriq_n_u16(rgb, vshll_n_u8(lo, 8), 11);
+}
+
+// Converts 8 pixels from |y| and the chroma of the first 4 in the low half of |u| and |v|.
+static inline uint16x8_t convert8(
+        uint8x8_t y, int16x4_t u, int16x4_t v, bool swapRB) {
+    int16x8_t y16 = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(y)), vdupq_n_s16(16));
+    int32x4_t luma0 = vmull_n_s16(vget_low_s16(y16), 298);
+    int32x4_t luma1 = vmull_n_s16(vget_high_s16(y16), 298);
+
+    int32x4_t u_b = vmull_n_s16(u, 517);
+    int32x4_t uv_g = vmlal_n_s16(vmull_n_s16(u, -100), v, -208);
+    int32x4_t v_r = vmull_n_s16(v, 409);
+
+    uint8x8_t b = channel8(luma0, luma1, u_b);
+    uint8x8_t g = channel8(luma0, luma1, uv_g);
+    uint8x8_t r = channel8(luma0, luma1, v_r);
+
+    return swapRB ? pack565(b, g, r) : pack565(r, g, b);
+}
+
+static inline int16x8_t centered(uint8x8_t c) {
+    return vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(c)), vdupq_n_s16(128));
+}
+
+static inline void convert16(
+        const uint8_t *y, uint8x8_t u8, uint8x8_t v8, uint16_t *dst, bool swapRB) {
+    uint8x16_t y16 = vld1q_u8(y);
+    int16x8_t u = centered(u8);
+    int16x8_t v = centered(v8);
+
+    vst1q_u16(dst, convert8(vget_low_u8(y16), vget_low_s16(u), vget_low_s16(v), swapRB));
+    vst1q_u16(dst + 8,
+            convert8(vget_high_u8(y16), vget_high_s16(u), vget_high_s16(v), swapRB));
+}
+
+size_t ConvertPlanarRowToRGB565(
+        const uint8_t *y, const uint8_t *u, const uint8_t *v,
+        uint16_t *dst, size_t width, bool swapRB) {
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        convert16(y + x, vld1_u8(u + x / 2), vld1_u8(v + x / 2), dst + x, swapRB);
+    }
+    return x;
+}
+
+size_t ConvertSemiPlanarRowToRGB565(
+        const uint8_t *y, const uint8_t *uv, bool vFirst,
+        uint16_t *dst, size_t width, bool swapRB) {
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint8x8x2_t c = vld2_u8(uv + x);
+        if (vFirst) {
+            convert16(y + x, c.val[1], c.val[0], dst + x, swapRB);
+        } else {
+            convert16(y + x, c.val[0], c.val[1], dst + x, swapRB);
+        }
+    }
+    return x;
+}
+
+}  // namespace android
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <emmintrin.h>
+
+#include "ColorConverterRows.h"
+
+namespace android {
+
+// x / 256, rounded towards zero like the C division
+static inline __m128i div256(__m128i x) {
+    __m128i bias = _mm_srli_epi32(_mm_srai_epi32(x, 31), 24);
+    return _mm_srai_epi32(_mm_add_epi32(x, bias), 8);
+}
+
+// one channel of 8 pixels from their luma and the chroma of the first 4 of them,
+// clipped to 0..255 in 16 bit lanes
+static inline __m128i channel8(__m128i luma0, __m128i luma1, __m128i chroma) {
+    __m128i c0 = _mm_unpacklo_epi32(chroma, chroma);
+    __m128i c1 = _mm_unpackhi_epi32(chroma, chroma);
+    __m128i x = _mm_packs_epi32(
+            div256(_mm_add_epi32(luma0, c0)), div256(_mm_add_epi32(luma1, c1)));
+    return _mm_min_epi16(_mm_max_epi16(x, _mm_setzero_si128()), _mm_set1_epi16(255));
+}
+
+static inline __m128i pack565(__m128i hi, __m128i g, __m128i lo) {
+    return _mm_or_si128(
+            _mm_or_si128(
+                    _mm_slli_epi16(_mm_and_si128(hi, _mm_set1_epi16(0xf8)), 8),
+                    _mm_slli_epi16(_mm_and_si128(g, _mm_set1_epi16(0xfc)), 3)),
+            _mm_srli_epi16(lo, 3));
+}
+
+// Converts 8 pixels from |y|, 16 bit lanes, and the chroma of the first 4 in the low half
+// of |uv|, interleaved U and V centered 16 bit lanes.
+static inline __m128i convert8(__m128i y, __m128i uv, bool swapRB) {
+    y = _mm_sub_epi16(y, _mm_set1_epi16(16));
+    // (coefficient, 0) pairs in the 32 bit constants, multiplied with U, V pairs by madd
+    __m128i luma0 = _mm_madd_epi16(_mm_unpacklo_epi16(y, _mm_setzero_si128()),
+            _mm_set1_epi32(298));
+    __m128i luma1 = _mm_madd_epi16(_mm_unpackhi_epi16(y, _mm_setzero_si128()),
+            _mm_set1_epi32(298));
+
+    __m128i u_b = _mm_madd_epi16(uv, _mm_set1_epi32(517));
+    __m128i uv_g = _mm_madd_epi16(uv,
+            _mm_set_epi16(-208, -100, -208, -100, -208, -100, -208, -100));
+    __m128i v_r = _mm_madd_epi16(uv, _mm_set1_epi32(409 << 16));
+
+    __m128i b = channel8(luma0, luma1, u_b);
+    __m128i g = channel8(luma0, luma1, uv_g);
+    __m128i r = channel8(luma0, luma1, v_r);
+
+    return swapRB ? pack565(b, g, r) : pack565(r, g, b);
+}
+
+// |u| and |v| have 8 chroma samples in 16 bit lanes
+static inline void convert16(
+        const uint8_t *y, __m128i u, __m128i v, uint16_t *dst, bool swapRB) {
+    __m128i y8 = _mm_loadu_si128((const __m128i *)y);
+    __m128i y0 = _mm_unpacklo_epi8(y8, _mm_setzero_si128());
+    __m128i y1 = _mm_unpackhi_epi8(y8, _mm_setzero_si128());
+
+    u = _mm_sub_epi16(u, _mm_set1_epi16(128));
+    v = _mm_sub_epi16(v, _mm_set1_epi16(128));
+
+    _mm_storeu_si128((__m128i *)dst, convert8(y0, _mm_unpacklo_epi16(u, v), swapRB));
+    _mm_storeu_si128((__m128i *)(dst + 8), convert8(y1, _mm_unpackhi_epi16(u, v), swapRB));
+}
+
+size_t ConvertPlanarRowToRGB565(
+        const uint8_t *y, const uint8_t *u, const uint8_t *v,
+        uint16_t *dst, size_t width, bool swapRB) {
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i u8 = _mm_loadl_epi64((const __m128i *)(u + x / 2));
+        __m128i v8 = _mm_loadl_epi64((const __m128i *)(v + x / 2));
+        convert16(y + x,
+                _mm_unpacklo_epi8(u8, _mm_setzero_si128()),
+                _mm_unpacklo_epi8(v8, _mm_setzero_si128()),
+                dst + x, swapRB);
+    }
+    return x;
+}
+
+size_t ConvertSemiPlanarRowToRGB565(
+        const uint8_t *y, const uint8_t *uv, bool vFirst,
+        uint16_t *dst, size_t width, bool swapRB) {
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i c = _mm_loadu_si128((const __m128i *)(uv + x));
+        __m128i even = _mm_and_si128(c, _mm_set1_epi16(0xff));
+        __m128i odd = _mm_srli_epi16(c, 8);
+        if (vFirst) {
+            convert16(y + x, odd, even, dst + x, swapRB);
+        } else {
+            convert16(y + x, even, odd, dst + x, swapRB);
+        }
+    }
+    return x;
+}
+
+}  // namespace android
@@ -44,11 +44,45 @@ static bool supportYUVComposer() {
     return !(property_get("sys.composer.no-yuv-support", prop, NULL) > 0);
 }
 
+// Copies |height| rows of |width| bytes, with a single copy if the rows are contiguous
+// in both planes.
+static void copyPlane(
+        uint8_t *dst, size_t dstStride, const uint8_t *src, size_t srcStride,
+        size_t width, size_t height) {
+    if (width == srcStride && width == dstStride) {
+        memcpy(dst, src, width * height);
+        return;
+    }
+
+    for (size_t y = 0; y < height; ++y) {
+        memcpy(dst, src, width);
+        src += srcStride;
+        dst += dstStride;
+    }
+}
+
+// Splits |height| rows of |width| interleaved pairs into two planes.
+static void splitPlane(
+        uint8_t *dst0, uint8_t *dst1, size_t dstStride, const uint8_t *src, size_t srcStride,
+        size_t width, size_t height) {
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < width; ++x) {
+            dst0[x] = src[2 * x];
+            dst1[x] = src[2 * x + 1];
+        }
+        src += srcStride;
+        dst0 += dstStride;
+        dst1 += dstStride;
+    }
+}
+
 SoftwareRenderer::SoftwareRenderer(
         const sp<ANativeWindow> &nativeWindow, int32_t rotation)
     : mColorFormat(OMX_COLOR_FormatUnused),
       mConverter(NULL),
       mYUVMode(None),
+      mHalFormat(HAL_PIXEL_FORMAT_RGB_565),
+      mYUVRejected(false),
       mNativeWindow(nativeWindow),
       mWidth(0),
       mHeight(0),
@@ -112,7 +146,7 @@ void SoftwareRenderer::resetFormatIfChanged(const sp<AMessage> &format) {
     size_t bufHeight = mCropHeight;
 
     // hardware has YUV12 and RGBA8888 support, so convert known formats
-    if (!runningInEmulator()) {
+    if (!runningInEmulator() && !mYUVRejected) {
         switch (mColorFormat) {
             case OMX_COLOR_FormatYUV420Planar:
             case OMX_COLOR_FormatYUV420SemiPlanar:
@@ -147,6 +181,10 @@ void SoftwareRenderer::resetFormatIfChanged(const sp<AMessage> &format) {
         }
     }
 
+    delete mConverter;
+    mConverter = NULL;
+    mHalFormat = halFormat;
+
     if (halFormat == HAL_PIXEL_FORMAT_RGB_565) {
         mConverter = new ColorConverter(
                 mColorFormat, OMX_COLOR_Format16bitRGB565);
@@ -219,14 +257,22 @@ std::list<FrameRenderTracker::Info> SoftwareRenderer::render(
     ANativeWindowBuffer *buf;
     int fenceFd = -1;
     int err = mNativeWindow->dequeueBuffer(mNativeWindow.get(), &buf, &fenceFd);
+    if (err == 0 && buf->format != mHalFormat && mHalFormat == HAL_PIXEL_FORMAT_YV12) {
+        // the window did not take YV12, convert to RGB565 from now on
+        ALOGW("window buffers have format %#x instead of YV12, converting to RGB565",
+                buf->format);
+        mNativeWindow->cancelBuffer(mNativeWindow.get(), buf, fenceFd);
+        fenceFd = -1;
+        mYUVRejected = true;
+        mColorFormat = OMX_COLOR_FormatUnused;
+        resetFormatIfChanged(format);
+        err = mNativeWindow->dequeueBuffer(mNativeWindow.get(), &buf, &fenceFd);
+    }
     if (err == 0 && fenceFd >= 0) {
         info = mRenderTracker.updateInfoForDequeuedBuffer(buf, fenceFd, 0);
-        sp<Fence> fence = new Fence(fenceFd);
-        err = fence->waitForever("SoftwareRenderer::render");
     }
     if (err != 0) {
         ALOGW("Surface::dequeueBuffer returned error %d", err);
-        // complete (drop) dequeued frame if fence wait failed; otherwise,
         // this returns an empty list as no frames should have rendered and not yet returned.
         return mRenderTracker.checkFencesAndGetRenderedFrames(info, false /* dropIncomplete */);
     }
@@ -235,9 +281,11 @@ std::list<FrameRenderTracker::Info> SoftwareRenderer::render(
 
     Rect bounds(mCropWidth, mCropHeight);
 
+    // The mapper waits for the dequeue fence, and takes ownership of it. The unlock
+    // below returns a fence for the CPU writes instead of waiting for them.
     void *dst;
-    CHECK_EQ(0, mapper.lock(
-                buf->handle, GRALLOC_USAGE_SW_WRITE_OFTEN, bounds, &dst));
+    CHECK_EQ(0, mapper.lockAsync(
+                buf->handle, GRALLOC_USAGE_SW_WRITE_OFTEN, bounds, &dst, fenceFd));
 
     // TODO move the other conversions also into ColorConverter, and
     // fix cropping issues (when mCropLeft/Top != 0 or mWidth != mCropWidth)
@@ -265,22 +313,11 @@ std::list<FrameRenderTracker::Info> SoftwareRenderer::render(
         uint8_t *dst_v = dst_y + dst_y_size;
         uint8_t *dst_u = dst_v + dst_c_size;
 
-        for (int y = 0; y < mCropHeight; ++y) {
-            memcpy(dst_y, src_y, mCropWidth);
-
-            src_y += mWidth;
-            dst_y += buf->stride;
-        }
-
-        for (int y = 0; y < (mCropHeight + 1) / 2; ++y) {
-            memcpy(dst_u, src_u, (mCropWidth + 1) / 2);
-            memcpy(dst_v, src_v, (mCropWidth + 1) / 2);
-
-            src_u += mWidth / 2;
-            src_v += mWidth / 2;
-            dst_u += dst_c_stride;
-            dst_v += dst_c_stride;
-        }
+        copyPlane(dst_y, buf->stride, src_y, mWidth, mCropWidth, mCropHeight);
+        copyPlane(dst_u, dst_c_stride, src_u, mWidth / 2,
+                (mCropWidth + 1) / 2, (mCropHeight + 1) / 2);
+        copyPlane(dst_v, dst_c_stride, src_v, mWidth / 2,
+                (mCropWidth + 1) / 2, (mCropHeight + 1) / 2);
     } else if (mColorFormat == OMX_TI_COLOR_FormatYUV420PackedSemiPlanar
             || mColorFormat == OMX_COLOR_FormatYUV420SemiPlanar) {
         if ((size_t)mWidth * mHeight * 3 / 2 > size) {
@@ -298,24 +335,9 @@ std::list<FrameRenderTracker::Info> SoftwareRenderer::render(
         uint8_t *dst_v = dst_y + dst_y_size;
         uint8_t *dst_u = dst_v + dst_c_size;
 
-        for (int y = 0; y < mCropHeight; ++y) {
-            memcpy(dst_y, src_y, mCropWidth);
-
-            src_y += mWidth;
-            dst_y += buf->stride;
-        }
-
-        for (int y = 0; y < (mCropHeight + 1) / 2; ++y) {
-            size_t tmp = (mCropWidth + 1) / 2;
-            for (size_t x = 0; x < tmp; ++x) {
-                dst_u[x] = src_uv[2 * x];
-                dst_v[x] = src_uv[2 * x + 1];
-            }
-
-            src_uv += mWidth;
-            dst_u += dst_c_stride;
-            dst_v += dst_c_stride;
-        }
+        copyPlane(dst_y, buf->stride, src_y, mWidth, mCropWidth, mCropHeight);
+        splitPlane(dst_u, dst_v, dst_c_stride, src_uv, mWidth,
+                (mCropWidth + 1) / 2, (mCropHeight + 1) / 2);
     } else if (mColorFormat == OMX_COLOR_Format24bitRGB888) {
         if ((size_t)mWidth * mHeight * 3 > size) {
             goto skip_copying;
@@ -323,11 +345,7 @@ std::list<FrameRenderTracker::Info> SoftwareRenderer::render(
         uint8_t* srcPtr = (uint8_t*)data;
         uint8_t* dstPtr = (uint8_t*)dst;
 
-        for (size_t y = 0; y < (size_t)mCropHeight; ++y) {
-            memcpy(dstPtr, srcPtr, mCropWidth * 3);
-            srcPtr += mWidth * 3;
-            dstPtr += buf->stride * 3;
-        }
+        copyPlane(dstPtr, buf->stride * 3, srcPtr, mWidth * 3, mCropWidth * 3, mCropHeight);
     } else if (mColorFormat == OMX_COLOR_Format32bitARGB8888) {
         if ((size_t)mWidth * mHeight * 4 > size) {
             goto skip_copying;
@@ -352,17 +370,14 @@ std::list<FrameRenderTracker::Info> SoftwareRenderer::render(
         uint8_t* srcPtr = (uint8_t*)data;
         uint8_t* dstPtr = (uint8_t*)dst;
 
-        for (size_t y = 0; y < (size_t)mCropHeight; ++y) {
-            memcpy(dstPtr, srcPtr, mCropWidth * 4);
-            srcPtr += mWidth * 4;
-            dstPtr += buf->stride * 4;
-        }
+        copyPlane(dstPtr, buf->stride * 4, srcPtr, mWidth * 4, mCropWidth * 4, mCropHeight);
     } else {
         LOG_ALWAYS_FATAL("bad color format %#x", mColorFormat);
     }
 
 skip_copying:
-    CHECK_EQ(0, mapper.unlock(buf->handle));
+    int releaseFenceFd = -1;
+    CHECK_EQ(0, mapper.unlockAsync(buf->handle, &releaseFenceFd));
 
     if (renderTimeNs >= 0) {
         if ((err = native_window_set_buffers_timestamp(mNativeWindow.get(),
@@ -371,7 +386,8 @@ skip_copying:
         }
     }
 
-    if ((err = mNativeWindow->queueBuffer(mNativeWindow.get(), buf, -1)) != 0) {
+    // the window takes ownership of the fence
+    if ((err = mNativeWindow->queueBuffer(mNativeWindow.get(), buf, releaseFenceFd)) != 0) {
         ALOGW("Surface::queueBuffer returned error %d", err);
     } else {
         mRenderTracker.onFrameQueued(mediaTimeUs, (GraphicBuffer *)buf, Fence::NO_FENCE);
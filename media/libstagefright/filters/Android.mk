@@ -10,6 +10,7 @@ LOCAL_SRC_FILES := \
         SaturationFilter.cpp      \
         saturationARGB.rs         \
         SimpleFilter.cpp          \
+        TileThreadPool.cpp        \
         ZeroFilter.cpp
 
 LOCAL_C_INCLUDES := \
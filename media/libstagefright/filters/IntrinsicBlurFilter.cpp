@@ -17,8 +17,14 @@
 //#define LOG_NDEBUG 0
 #define LOG_TAG "IntrinsicBlurFilter"
 
+#include <math.h>
+
 #include <utils/Log.h>
 
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
@@ -27,6 +33,192 @@
 
 namespace android {
 
+// dst[i] = sum over k of weights[k] * taps[k][i], with Q16 weights adding up
+// to 1.0, for numBytes bytes.
+static void convolveBytes(
+        const uint8_t * const *taps, const uint32_t *weights, size_t numTaps,
+        uint8_t *dst, size_t numBytes) {
+    size_t i = 0;
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+    for (; i + 16 <= numBytes; i += 16) {
+        uint32x4_t acc0 = vdupq_n_u32(1 << 15);
+        uint32x4_t acc1 = acc0;
+        uint32x4_t acc2 = acc0;
+        uint32x4_t acc3 = acc0;
+
+        for (size_t k = 0; k < numTaps; ++k) {
+            const uint8x16_t v = vld1q_u8(taps[k] + i);
+            const uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+            const uint16x8_t hi = vmovl_u8(vget_high_u8(v));
+
+            acc0 = vmlaq_n_u32(acc0, vmovl_u16(vget_low_u16(lo)), weights[k]);
+            acc1 = vmlaq_n_u32(acc1, vmovl_u16(vget_high_u16(lo)), weights[k]);
+            acc2 = vmlaq_n_u32(acc2, vmovl_u16(vget_low_u16(hi)), weights[k]);
+            acc3 = vmlaq_n_u32(acc3, vmovl_u16(vget_high_u16(hi)), weights[k]);
+        }
+
+        const uint8x8_t lo = vmovn_u16(
+                vcombine_u16(vshrn_n_u32(acc0, 16), vshrn_n_u32(acc1, 16)));
+        const uint8x8_t hi = vmovn_u16(
+                vcombine_u16(vshrn_n_u32(acc2, 16), vshrn_n_u32(acc3, 16)));
+        vst1q_u8(dst + i, vcombine_u8(lo, hi));
+    }
+#endif
+
+    for (; i < numBytes; ++i) {
+        uint32_t acc = 1 << 15;
+        for (size_t k = 0; k < numTaps; ++k) {
+            acc += weights[k] * taps[k][i];
+        }
+        dst[i] = acc >> 16;
+    }
+}
+
+namespace {
+
+// Separable Gaussian blur of 4 byte pixels: a horizontal pass over bands of
+// rows into a scratch frame, then a vertical pass over tiles of it.
+struct BlurJob : public TileThreadPool::Job {
+    enum Pass {
+        HORIZONTAL,
+        VERTICAL,
+    };
+
+    enum {
+        kMaxTaps = 51,
+        kRowsPerVerticalTile = 32,
+    };
+
+    BlurJob(const uint8_t *src, uint8_t *scratch, uint8_t *dst,
+            int32_t width, int32_t height, const Vector<uint32_t> &weights)
+        : mSrc(src),
+          mScratch(scratch),
+          mDst(dst),
+          mWidth(width),
+          mHeight(height),
+          mPitch(width * 4),
+          mWeights(weights.array()),
+          mNumTaps(weights.size()),
+          mRadius(weights.size() / 2),
+          mPass(HORIZONTAL) {
+        CHECK_LE(mNumTaps, (size_t)kMaxTaps);
+
+        mRowsPerHorizontalTile = TileThreadPool::kTileBytes / mPitch;
+        if (mRowsPerHorizontalTile == 0) {
+            mRowsPerHorizontalTile = 1;
+        }
+
+        // The vertical pass reads mNumTaps rows of a strip for every row it
+        // writes, keep those within a tile's worth of cache.
+        mStripBytes = (TileThreadPool::kTileBytes / mNumTaps) & ~15;
+        if (mStripBytes < 256) {
+            mStripBytes = 256;
+        }
+        if (mStripBytes > mPitch) {
+            mStripBytes = mPitch;
+        }
+        mNumStrips = (mPitch + mStripBytes - 1) / mStripBytes;
+    }
+
+    void setPass(Pass pass) {
+        mPass = pass;
+    }
+
+    size_t numTiles() const {
+        if (mPass == HORIZONTAL) {
+            return (mHeight + mRowsPerHorizontalTile - 1)
+                    / mRowsPerHorizontalTile;
+        }
+
+        return ((mHeight + kRowsPerVerticalTile - 1) / kRowsPerVerticalTile)
+                * mNumStrips;
+    }
+
+    virtual void processTile(size_t index) {
+        if (mPass == HORIZONTAL) {
+            const int32_t y0 = index * mRowsPerHorizontalTile;
+            for (int32_t y = y0;
+                    y < mHeight && y < y0 + mRowsPerHorizontalTile; ++y) {
+                blurRow(mSrc + y * mPitch, mScratch + y * mPitch);
+            }
+            return;
+        }
+
+        const size_t strip = index % mNumStrips;
+        const int32_t y0 = (index / mNumStrips) * kRowsPerVerticalTile;
+        const size_t offset = strip * mStripBytes;
+        size_t numBytes = mPitch - offset;
+        if (numBytes > mStripBytes) {
+            numBytes = mStripBytes;
+        }
+
+        const uint8_t *taps[kMaxTaps];
+        for (int32_t y = y0;
+                y < mHeight && y < y0 + kRowsPerVerticalTile; ++y) {
+            for (size_t k = 0; k < mNumTaps; ++k) {
+                int32_t row = clamp(y + (int32_t)k - mRadius, mHeight);
+                taps[k] = mScratch + row * mPitch + offset;
+            }
+            convolveBytes(
+                    taps, mWeights, mNumTaps, mDst + y * mPitch + offset,
+                    numBytes);
+        }
+    }
+
+private:
+    const uint8_t *mSrc;
+    uint8_t *mScratch;
+    uint8_t *mDst;
+    int32_t mWidth, mHeight;
+    size_t mPitch;
+    const uint32_t *mWeights;
+    size_t mNumTaps;
+    int32_t mRadius;
+    Pass mPass;
+
+    int32_t mRowsPerHorizontalTile;
+    size_t mStripBytes;
+    size_t mNumStrips;
+
+    static int32_t clamp(int32_t x, int32_t size) {
+        return x < 0 ? 0 : (x >= size ? size - 1 : x);
+    }
+
+    void blurRow(const uint8_t *in, uint8_t *out) {
+        const uint8_t *taps[kMaxTaps];
+
+        // Away from the edges the taps for pixel x are the consecutive
+        // pixels starting at x - radius.
+        int32_t interiorStart = mRadius;
+        int32_t interiorEnd = mWidth - mRadius;
+        if (interiorEnd > interiorStart) {
+            for (size_t k = 0; k < mNumTaps; ++k) {
+                taps[k] = in + k * 4;
+            }
+            convolveBytes(
+                    taps, mWeights, mNumTaps, out + interiorStart * 4,
+                    (interiorEnd - interiorStart) * 4);
+        } else {
+            interiorStart = interiorEnd = mWidth;
+        }
+
+        for (int32_t x = 0; x < mWidth; ++x) {
+            if (x == interiorStart) {
+                x = interiorEnd - 1;
+                continue;
+            }
+
+            for (size_t k = 0; k < mNumTaps; ++k) {
+                taps[k] = in + clamp(x + (int32_t)k - mRadius, mWidth) * 4;
+            }
+            convolveBytes(taps, mWeights, mNumTaps, out + x * 4, 4);
+        }
+    }
+};
+
+}  // namespace
+
 status_t IntrinsicBlurFilter::configure(const sp<AMessage> &msg) {
     status_t err = SimpleFilter::configure(msg);
     if (err != OK) {
@@ -38,16 +230,31 @@ status_t IntrinsicBlurFilter::configure(const sp<AMessage> &msg) {
         return NAME_NOT_FOUND;
     }
 
+    int32_t useCpu;
+    if (msg->findInt32("use-cpu", &useCpu)) {
+        mUseCpu = (useCpu != 0);
+    }
+
     return OK;
 }
 
 status_t IntrinsicBlurFilter::start() {
-    // TODO: use a single RS context object for entire application
-    mRS = new RSC::RS();
+    if (!mUseCpu) {
+        // TODO: use a single RS context object for entire application
+        mRS = new RSC::RS();
+
+        if (!mRS->init(mCacheDir.c_str())) {
+            ALOGW("Failed to initialize RenderScript context, "
+                    "filtering on the CPU instead.");
+            mRS.clear();
+            mUseCpu = true;
+        }
+    }
 
-    if (!mRS->init(mCacheDir.c_str())) {
-        ALOGE("Failed to initialize RenderScript context.");
-        return NO_INIT;
+    if (mUseCpu) {
+        mThreadPool = new TileThreadPool;
+        mScratch = new ABuffer(mWidth * mHeight * 4);
+        return OK;
     }
 
     // 32-bit elements for ARGB8888
@@ -73,6 +280,8 @@ void IntrinsicBlurFilter::reset() {
     mAllocOut.clear();
     mAllocIn.clear();
     mRS.clear();
+    mScratch.clear();
+    mThreadPool.clear();
 }
 
 status_t IntrinsicBlurFilter::setParameters(const sp<AMessage> &msg) {
@@ -89,6 +298,10 @@ status_t IntrinsicBlurFilter::setParameters(const sp<AMessage> &msg) {
 
 status_t IntrinsicBlurFilter::processBuffers(
         const sp<ABuffer> &srcBuffer, const sp<ABuffer> &outBuffer) {
+    if (mUseCpu) {
+        return processBuffersCpu(srcBuffer, outBuffer);
+    }
+
     mAllocIn->copy1DRangeFrom(0, mWidth * mHeight, srcBuffer->data());
     mBlur->forEach(mAllocOut);
     mAllocOut->copy1DRangeTo(0, mWidth * mHeight, outBuffer->data());
@@ -96,4 +309,64 @@ status_t IntrinsicBlurFilter::processBuffers(
     return OK;
 }
 
+void IntrinsicBlurFilter::updateWeights() {
+    // Same kernel as ScriptIntrinsicBlur, which supports radii up to 25.
+    float radius = mBlurRadius;
+    if (radius > 25.f) {
+        radius = 25.f;
+    } else if (radius < 0.f) {
+        radius = 0.f;
+    }
+
+    const int32_t iRadius = (int32_t)ceilf(radius);
+    const float sigma = 0.4f * radius + 0.6f;
+
+    float weights[2 * 25 + 1];
+    float sum = 0.f;
+    for (int32_t r = -iRadius; r <= iRadius; ++r) {
+        weights[r + iRadius] = expf(-(r * r) / (2.f * sigma * sigma));
+        sum += weights[r + iRadius];
+    }
+
+    mWeights.clear();
+    uint32_t total = 0;
+    for (int32_t i = 0; i <= 2 * iRadius; ++i) {
+        uint32_t weight = (uint32_t)(weights[i] / sum * 65536.f + .5f);
+        mWeights.push(weight);
+        total += weight;
+    }
+
+    // Put the rounding error on the center tap so a flat image stays flat.
+    mWeights.editItemAt(iRadius) += 65536 - total;
+
+    mWeightsRadius = mBlurRadius;
+}
+
+status_t IntrinsicBlurFilter::processBuffersCpu(
+        const sp<ABuffer> &srcBuffer, const sp<ABuffer> &outBuffer) {
+    const size_t frameSize = mWidth * mHeight * 4;
+    if (srcBuffer->size() < frameSize || outBuffer->capacity() < frameSize) {
+        ALOGE("Buffers too small for a %dx%d frame.", mWidth, mHeight);
+        return BAD_VALUE;
+    }
+
+    if (mWeights.isEmpty() || mWeightsRadius != mBlurRadius) {
+        updateWeights();
+    }
+
+    // Works straight on the buffers, there is nothing to copy in or out.
+    BlurJob job(
+            srcBuffer->data(), mScratch->data(), outBuffer->data(),
+            mWidth, mHeight, mWeights);
+
+    mThreadPool->run(&job, job.numTiles());
+
+    job.setPass(BlurJob::VERTICAL);
+    mThreadPool->run(&job, job.numTiles());
+
+    outBuffer->setRange(0, frameSize);
+
+    return OK;
+}
+
 }   // namespace android
@@ -19,12 +19,16 @@
 
 #include "RenderScript.h"
 #include "SimpleFilter.h"
+#include "TileThreadPool.h"
+
+#include <utils/Vector.h>
 
 namespace android {
 
 struct IntrinsicBlurFilter : public SimpleFilter {
 public:
-    IntrinsicBlurFilter() : mBlurRadius(1.f) {};
+    IntrinsicBlurFilter()
+        : mUseCpu(false), mBlurRadius(1.f), mWeightsRadius(0.f) {};
 
     virtual status_t configure(const sp<AMessage> &msg);
     virtual status_t start();
@@ -38,11 +42,23 @@ protected:
 
 private:
     AString mCacheDir;
+    bool mUseCpu;
+    sp<TileThreadPool> mThreadPool;
     RSC::sp<RSC::RS> mRS;
     RSC::sp<RSC::Allocation> mAllocIn;
     RSC::sp<RSC::Allocation> mAllocOut;
     RSC::sp<RSC::ScriptIntrinsicBlur> mBlur;
     float mBlurRadius;
+
+    // CPU path: Q16 Gaussian weights for mWeightsRadius, and the output of
+    // the horizontal pass.
+    Vector<uint32_t> mWeights;
+    float mWeightsRadius;
+    sp<ABuffer> mScratch;
+
+    void updateWeights();
+    status_t processBuffersCpu(
+            const sp<ABuffer> &srcBuffer, const sp<ABuffer> &outBuffer);
 };
 
 }   // namespace android
@@ -19,6 +19,10 @@
 
 #include <utils/Log.h>
 
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
@@ -27,6 +31,99 @@
 
 namespace android {
 
+// Q8 weights of the luma used as the fully desaturated value, matching
+// gMonoMult in saturationARGB.rs.
+static const uint8_t kMonoR = 77;
+static const uint8_t kMonoG = 150;
+static const uint8_t kMonoB = 29;
+
+// CPU version of saturationARGB.rs, for pixels stored as A, R, G, B bytes.
+static void saturateARGB(
+        const uint8_t *src, uint8_t *dst, size_t numPixels,
+        int16_t saturationQ8) {
+    size_t i = 0;
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+    const int16x4_t saturation = vdup_n_s16(saturationQ8);
+    for (; i + 8 <= numPixels; i += 8) {
+        uint8x8x4_t argb = vld4_u8(src + i * 4);
+
+        uint16x8_t mono = vmull_u8(argb.val[1], vdup_n_u8(kMonoR));
+        mono = vmlal_u8(mono, argb.val[2], vdup_n_u8(kMonoG));
+        mono = vmlal_u8(mono, argb.val[3], vdup_n_u8(kMonoB));
+        const int16x8_t mono16 =
+            vreinterpretq_s16_u16(vmovl_u8(vrshrn_n_u16(mono, 8)));
+
+        for (size_t c = 1; c < 4; ++c) {
+            const int16x8_t diff = vsubq_s16(
+                    vreinterpretq_s16_u16(vmovl_u8(argb.val[c])), mono16);
+            const int32x4_t lo = vmull_s16(vget_low_s16(diff), saturation);
+            const int32x4_t hi = vmull_s16(vget_high_s16(diff), saturation);
+            const int16x8_t scaled =
+                vcombine_s16(vrshrn_n_s32(lo, 8), vrshrn_n_s32(hi, 8));
+            argb.val[c] = vqmovun_s16(vqaddq_s16(mono16, scaled));
+        }
+
+        vst4_u8(dst + i * 4, argb);
+    }
+#endif
+
+    for (; i < numPixels; ++i) {
+        const uint8_t *in = src + i * 4;
+        uint8_t *out = dst + i * 4;
+
+        const int32_t mono =
+            (kMonoR * in[1] + kMonoG * in[2] + kMonoB * in[3] + 128) >> 8;
+
+        out[0] = in[0];
+        for (size_t c = 1; c < 4; ++c) {
+            int32_t value =
+                mono + (((in[c] - mono) * saturationQ8 + 128) >> 8);
+            out[c] = value < 0 ? 0 : (value > 255 ? 255 : value);
+        }
+    }
+}
+
+namespace {
+
+struct SaturationJob : public TileThreadPool::Job {
+    enum {
+        kPixelsPerTile = TileThreadPool::kTileBytes / 4,
+    };
+
+    SaturationJob(
+            const uint8_t *src, uint8_t *dst, size_t numPixels,
+            int16_t saturationQ8)
+        : mSrc(src),
+          mDst(dst),
+          mNumPixels(numPixels),
+          mSaturationQ8(saturationQ8) {
+    }
+
+    size_t numTiles() const {
+        return (mNumPixels + kPixelsPerTile - 1) / kPixelsPerTile;
+    }
+
+    virtual void processTile(size_t index) {
+        size_t offset = index * kPixelsPerTile;
+        size_t count = mNumPixels - offset;
+        if (count > kPixelsPerTile) {
+            count = kPixelsPerTile;
+        }
+
+        saturateARGB(
+                mSrc + offset * 4, mDst + offset * 4, count, mSaturationQ8);
+    }
+
+private:
+    const uint8_t *mSrc;
+    uint8_t *mDst;
+    size_t mNumPixels;
+    int16_t mSaturationQ8;
+};
+
+}  // namespace
+
 status_t SaturationFilter::configure(const sp<AMessage> &msg) {
     status_t err = SimpleFilter::configure(msg);
     if (err != OK) {
@@ -38,16 +135,30 @@ status_t SaturationFilter::configure(const sp<AMessage> &msg) {
         return NAME_NOT_FOUND;
     }
 
+    int32_t useCpu;
+    if (msg->findInt32("use-cpu", &useCpu)) {
+        mUseCpu = (useCpu != 0);
+    }
+
     return OK;
 }
 
 status_t SaturationFilter::start() {
-    // TODO: use a single RS context object for entire application
-    mRS = new RSC::RS();
+    if (!mUseCpu) {
+        // TODO: use a single RS context object for entire application
+        mRS = new RSC::RS();
+
+        if (!mRS->init(mCacheDir.c_str())) {
+            ALOGW("Failed to initialize RenderScript context, "
+                    "filtering on the CPU instead.");
+            mRS.clear();
+            mUseCpu = true;
+        }
+    }
 
-    if (!mRS->init(mCacheDir.c_str())) {
-        ALOGE("Failed to initialize RenderScript context.");
-        return NO_INIT;
+    if (mUseCpu) {
+        mThreadPool = new TileThreadPool;
+        return OK;
     }
 
     // 32-bit elements for ARGB8888
@@ -73,6 +184,7 @@ void SaturationFilter::reset() {
     mAllocOut.clear();
     mAllocIn.clear();
     mRS.clear();
+    mThreadPool.clear();
 }
 
 status_t SaturationFilter::setParameters(const sp<AMessage> &msg) {
@@ -89,6 +201,10 @@ status_t SaturationFilter::setParameters(const sp<AMessage> &msg) {
 
 status_t SaturationFilter::processBuffers(
         const sp<ABuffer> &srcBuffer, const sp<ABuffer> &outBuffer) {
+    if (mUseCpu) {
+        return processBuffersCpu(srcBuffer, outBuffer);
+    }
+
     mAllocIn->copy1DRangeFrom(0, mWidth * mHeight, srcBuffer->data());
     mScript->forEach_root(mAllocIn, mAllocOut);
     mAllocOut->copy1DRangeTo(0, mWidth * mHeight, outBuffer->data());
@@ -96,4 +212,31 @@ status_t SaturationFilter::processBuffers(
     return OK;
 }
 
+status_t SaturationFilter::processBuffersCpu(
+        const sp<ABuffer> &srcBuffer, const sp<ABuffer> &outBuffer) {
+    const size_t numPixels = mWidth * mHeight;
+    if (srcBuffer->size() < numPixels * 4
+            || outBuffer->capacity() < numPixels * 4) {
+        ALOGE("Buffers too small for a %dx%d frame.", mWidth, mHeight);
+        return BAD_VALUE;
+    }
+
+    // Works straight on the buffers, there is nothing to copy in or out.
+    float saturationQ8 = mSaturation * 256.f + (mSaturation < 0 ? -.5f : .5f);
+    if (saturationQ8 > INT16_MAX) {
+        saturationQ8 = INT16_MAX;
+    } else if (saturationQ8 < -INT16_MAX) {
+        saturationQ8 = -INT16_MAX;
+    }
+
+    SaturationJob job(
+            srcBuffer->data(), outBuffer->data(), numPixels,
+            (int16_t)saturationQ8);
+    mThreadPool->run(&job, job.numTiles());
+
+    outBuffer->setRange(0, numPixels * 4);
+
+    return OK;
+}
+
 }   // namespace android
@@ -21,12 +21,13 @@
 
 #include "ScriptC_saturationARGB.h"
 #include "SimpleFilter.h"
+#include "TileThreadPool.h"
 
 namespace android {
 
 struct SaturationFilter : public SimpleFilter {
 public:
-    SaturationFilter() : mSaturation(1.f) {};
+    SaturationFilter() : mUseCpu(false), mSaturation(1.f) {};
 
     virtual status_t configure(const sp<AMessage> &msg);
     virtual status_t start();
@@ -40,11 +41,16 @@ protected:
 
 private:
     AString mCacheDir;
+    bool mUseCpu;
+    sp<TileThreadPool> mThreadPool;
     RSC::sp<RSC::RS> mRS;
     RSC::sp<RSC::Allocation> mAllocIn;
     RSC::sp<RSC::Allocation> mAllocOut;
     RSC::sp<ScriptC_saturationARGB> mScript;
     float mSaturation;
+
+    status_t processBuffersCpu(
+            const sp<ABuffer> &srcBuffer, const sp<ABuffer> &outBuffer);
 };
 
 }   // namespace android
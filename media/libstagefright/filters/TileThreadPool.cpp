@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "TileThreadPool"
+
+#include <unistd.h>
+
+#include <utils/Log.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+
+#include "TileThreadPool.h"
+
+namespace android {
+
+struct TileThreadPool::WorkerThread : public Thread {
+    WorkerThread(TileThreadPool *pool)
+        : Thread(false /* canCallJava */),
+          mPool(pool) {
+    }
+
+private:
+    TileThreadPool *mPool;
+
+    virtual bool threadLoop() {
+        return mPool->workerLoop();
+    }
+};
+
+TileThreadPool::TileThreadPool(size_t numThreads)
+    : mJob(NULL),
+      mNumTiles(0),
+      mNextTile(0),
+      mNumTilesDone(0),
+      mExiting(false) {
+    if (numThreads == 0) {
+        long numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+        numThreads = numCpus > 0 ? numCpus : 1;
+    }
+    if (numThreads > kMaxThreads) {
+        numThreads = kMaxThreads;
+    }
+
+    // The thread calling run() works on tiles too.
+    for (size_t i = 1; i < numThreads; ++i) {
+        sp<WorkerThread> thread = new WorkerThread(this);
+        if (thread->run("TileWorker", ANDROID_PRIORITY_DISPLAY) != OK) {
+            ALOGW("Failed to start tile worker thread, using %zu", i);
+            break;
+        }
+        mThreads.push(thread);
+    }
+}
+
+TileThreadPool::~TileThreadPool() {
+    for (size_t i = 0; i < mThreads.size(); ++i) {
+        mThreads.editItemAt(i)->requestExit();
+    }
+
+    {
+        Mutex::Autolock autoLock(mLock);
+        mExiting = true;
+        mWorkAvailable.broadcast();
+    }
+
+    for (size_t i = 0; i < mThreads.size(); ++i) {
+        mThreads.editItemAt(i)->requestExitAndWait();
+    }
+}
+
+void TileThreadPool::run(Job *job, size_t numTiles) {
+    if (numTiles == 0) {
+        return;
+    }
+
+    if (mThreads.isEmpty() || numTiles == 1) {
+        for (size_t i = 0; i < numTiles; ++i) {
+            job->processTile(i);
+        }
+        return;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+    CHECK(mJob == NULL);
+
+    mJob = job;
+    mNumTiles = numTiles;
+    mNextTile = 0;
+    mNumTilesDone = 0;
+    mWorkAvailable.broadcast();
+
+    processTiles();
+
+    while (mNumTilesDone < mNumTiles) {
+        mWorkDone.wait(mLock);
+    }
+
+    mJob = NULL;
+}
+
+bool TileThreadPool::workerLoop() {
+    Mutex::Autolock autoLock(mLock);
+
+    while (!mExiting && (mJob == NULL || mNextTile >= mNumTiles)) {
+        mWorkAvailable.wait(mLock);
+    }
+
+    if (mExiting) {
+        return false;
+    }
+
+    processTiles();
+
+    return true;
+}
+
+// Called with mLock held, drops it while working on a tile.
+void TileThreadPool::processTiles() {
+    while (mNextTile < mNumTiles) {
+        Job *job = mJob;
+        size_t index = mNextTile++;
+
+        mLock.unlock();
+        job->processTile(index);
+        mLock.lock();
+
+        if (++mNumTilesDone == mNumTiles) {
+            mWorkDone.signal();
+        }
+    }
+}
+
+}   // namespace android
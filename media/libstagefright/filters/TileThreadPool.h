@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TILE_THREAD_POOL_H_
+#define TILE_THREAD_POOL_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/Condition.h>
+#include <utils/Mutex.h>
+#include <utils/RefBase.h>
+#include <utils/Thread.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+// Runs the CPU paths of the filters over a frame split into tiles, on a
+// small pool of worker threads plus the calling thread.
+struct TileThreadPool : public RefBase {
+public:
+    struct Job {
+        virtual void processTile(size_t index) = 0;
+
+    protected:
+        virtual ~Job() {};
+    };
+
+    enum {
+        kMaxThreads = 4,
+
+        // Tiles are sized to stay within this many bytes of a frame, so
+        // the rows a tile works on stay in cache.
+        kTileBytes = 64 * 1024,
+    };
+
+    // numThreads of 0 uses one thread per online CPU, up to kMaxThreads.
+    TileThreadPool(size_t numThreads = 0);
+
+    // Calls job->processTile() for every index in [0, numTiles) and returns
+    // once all of them are done.
+    void run(Job *job, size_t numTiles);
+
+protected:
+    virtual ~TileThreadPool();
+
+private:
+    struct WorkerThread;
+
+    Mutex mLock;
+    Condition mWorkAvailable;
+    Condition mWorkDone;
+
+    Vector<sp<WorkerThread> > mThreads;
+
+    // Guarded by mLock
+    Job *mJob;
+    size_t mNumTiles;
+    size_t mNextTile;
+    size_t mNumTilesDone;
+    bool mExiting;
+
+    // Returns false once the pool is shutting down.
+    bool workerLoop();
+    void processTiles();
+
+    DISALLOW_EVIL_CONSTRUCTORS(TileThreadPool);
+};
+
+}   // namespace android
+
+#endif  // TILE_THREAD_POOL_H_
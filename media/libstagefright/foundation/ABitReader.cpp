@@ -33,23 +33,24 @@ ABitReader::~ABitReader() {
 void ABitReader::fillReservoir() {
     CHECK_GT(mSize, 0u);
 
+    size_t n = mSize < 8 ? mSize : 8;
     mReservoir = 0;
-    size_t i;
-    for (i = 0; mSize > 0 && i < 4; ++i) {
-        mReservoir = (mReservoir << 8) | *mData;
-
-        ++mData;
-        --mSize;
+    for (size_t i = 0; i < n; ++i) {
+        mReservoir = (mReservoir << 8) | mData[i];
     }
+    mData += n;
+    mSize -= n;
 
-    mNumBitsLeft = 8 * i;
-    mReservoir <<= 32 - mNumBitsLeft;
+    mNumBitsLeft = 8 * n;
+    if (mNumBitsLeft < 64) {
+        mReservoir <<= 64 - mNumBitsLeft;
+    }
 }
 
-uint32_t ABitReader::getBits(size_t n) {
+uint32_t ABitReader::getBitsSlow(size_t n) {
     CHECK_LE(n, 32u);
 
-    uint32_t result = 0;
+    uint64_t result = 0;
     while (n > 0) {
         if (mNumBitsLeft == 0) {
             fillReservoir();
@@ -60,38 +61,78 @@ uint32_t ABitReader::getBits(size_t n) {
             m = mNumBitsLeft;
         }
 
-        result = (result << m) | (mReservoir >> (32 - m));
+        result = (result << m) | (mReservoir >> (64 - m));
         mReservoir <<= m;
         mNumBitsLeft -= m;
 
         n -= m;
     }
 
-    return result;
+    return (uint32_t)result;
 }
 
 void ABitReader::skipBits(size_t n) {
-    while (n > 32) {
-        getBits(32);
-        n -= 32;
+    // drop whole reservoirs without extracting any bits
+    while (n > mNumBitsLeft) {
+        n -= mNumBitsLeft;
+        mNumBitsLeft = 0;
+        fillReservoir();
+    }
+
+    mReservoir = (n < 64) ? mReservoir << n : 0;
+    mNumBitsLeft -= n;
+}
+
+uint32_t ABitReader::getUE() {
+    // Fast path: the leading zeros, the marker bit and the suffix are all in
+    // the reservoir.
+    if (mReservoir != 0) {
+        size_t numZeros = __builtin_clzll(mReservoir);
+        size_t codeLength = 2 * numZeros + 1;
+        if (codeLength <= mNumBitsLeft) {
+            uint64_t code = mReservoir >> (64 - codeLength);
+            mReservoir <<= codeLength;  // codeLength is odd, so < 64
+            mNumBitsLeft -= codeLength;
+            return (uint32_t)code - 1;
+        }
     }
 
-    if (n > 0) {
-        getBits(n);
+    size_t numZeros = 0;
+    while (getBits(1) == 0) {
+        ++numZeros;
     }
+
+    uint32_t x = getBits(numZeros);
+
+    return x + (1u << numZeros) - 1;
+}
+
+int32_t ABitReader::getSE() {
+    uint32_t codeNum = getUE();
+
+    return (codeNum & 1) ? (codeNum + 1) / 2 : -(int32_t)(codeNum / 2);
 }
 
 void ABitReader::putBits(uint32_t x, size_t n) {
     CHECK_LE(n, 32u);
 
-    while (mNumBitsLeft + n > 32) {
+    if (n == 0) {
+        return;
+    }
+
+    while (mNumBitsLeft + n > 64) {
         mNumBitsLeft -= 8;
         --mData;
         ++mSize;
     }
 
-    mReservoir = (mReservoir >> n) | (x << (32 - n));
+    mReservoir = (mReservoir >> n) | ((uint64_t)x << (64 - n));
     mNumBitsLeft += n;
+
+    // keep the bits below the reservoir clear for getUE()
+    if (mNumBitsLeft < 64) {
+        mReservoir &= ~(~0ull >> mNumBitsLeft);
+    }
 }
 
 size_t ABitReader::numBitsLeft() const {
@@ -144,7 +185,7 @@ void NALBitReader::fillReservoir() {
 
     mReservoir = 0;
     size_t i = 0;
-    while (mSize > 0 && i < 4) {
+    while (mSize > 0 && i < 8) {
         bool isEmulationPreventionByte = (mNumZeros >= 2 && *mData == 3);
 
         if (*mData == 0) {
@@ -164,7 +205,9 @@ void NALBitReader::fillReservoir() {
     }
 
     mNumBitsLeft = 8 * i;
-    mReservoir <<= 32 - mNumBitsLeft;
+    if (mNumBitsLeft < 64) {
+        mReservoir <<= 64 - mNumBitsLeft;
+    }
 }
 
 }  // namespace android
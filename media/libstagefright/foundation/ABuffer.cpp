@@ -59,6 +59,15 @@ sp<ABuffer> ABuffer::CreateAsCopy(const void *data, size_t capacity)
     return res;
 }
 
+sp<ABuffer> ABuffer::slice(size_t offset, size_t size) {
+    CHECK_LE(offset, mRangeLength);
+    CHECK_LE(size, mRangeLength - offset);
+
+    sp<ABuffer> res = new ABuffer(data() + offset, size);
+    res->mParent = this;
+    return res;
+}
+
 ABuffer::~ABuffer() {
     if (mOwnsData) {
         if (mData != NULL) {
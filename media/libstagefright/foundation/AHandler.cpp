@@ -24,18 +24,24 @@
 namespace android {
 
 void AHandler::deliverMessage(const sp<AMessage> &msg) {
+    if (!mVerboseStats) {
+        onMessageReceived(msg);
+        mMessageCounter++;
+        return;
+    }
+
+    uint32_t what = msg->what();
+    int64_t startUs = ALooper::GetNowUs();
     onMessageReceived(msg);
+    int64_t durationUs = ALooper::GetNowUs() - startUs;
     mMessageCounter++;
 
-    if (mVerboseStats) {
-        uint32_t what = msg->what();
-        ssize_t idx = mMessages.indexOfKey(what);
-        if (idx < 0) {
-            mMessages.add(what, 1);
-        } else {
-            mMessages.editValueAt(idx)++;
-        }
+    Mutex::Autolock autoLock(mStatsLock);
+    ssize_t idx = mMessages.indexOfKey(what);
+    if (idx < 0) {
+        idx = mMessages.add(what, ALooper::DurationStats());
     }
+    mMessages.editValueAt(idx).add(durationUs);
 }
 
 }  // namespace android
@@ -21,6 +21,8 @@
 
 #include <utils/Log.h>
 
+#include <stdint.h>
+#include <string.h>
 #include <sys/time.h>
 
 #include "ALooper.h"
@@ -70,7 +72,10 @@ int64_t ALooper::GetNowUs() {
 }
 
 ALooper::ALooper()
-    : mRunningLocally(false) {
+    : mNextSeq(0),
+      mWakeUpUs(-1),
+      mMaxQueueDepth(0),
+      mRunningLocally(false) {
     // clean up stale AHandlers. Doing it here instead of in the destructor avoids
     // the side effect of objects being deleted from the unregister function recursively.
     gLooperRoster.unregisterStaleHandlers();
@@ -85,6 +90,42 @@ void ALooper::setName(const char *name) {
     mName = name;
 }
 
+void ALooper::DurationStats::add(int64_t durationUs) {
+    if (durationUs < 0) {
+        durationUs = 0;
+    }
+    ++mCount;
+    mTotalUs += durationUs;
+    if (durationUs > mMaxUs) {
+        mMaxUs = durationUs;
+    }
+
+    size_t bucket = 0;
+    for (int64_t limitUs = 1000; durationUs >= limitUs && bucket < kNumBuckets - 1;
+            limitUs *= 2) {
+        ++bucket;
+    }
+    ++mBuckets[bucket];
+}
+
+void ALooper::DurationStats::clear() {
+    mCount = 0;
+    mTotalUs = 0;
+    mMaxUs = 0;
+    memset(mBuckets, 0, sizeof(mBuckets));
+}
+
+void ALooper::getStats(Stats *stats, bool clear) {
+    Mutex::Autolock autoLock(mLock);
+    stats->mQueueDepth = mImmediateQueue.size() + mTimedQueue.size();
+    stats->mMaxQueueDepth = mMaxQueueDepth;
+    stats->mLatency = mLatency;
+    if (clear) {
+        mMaxQueueDepth = stats->mQueueDepth;
+        mLatency.clear();
+    }
+}
+
 ALooper::handler_id ALooper::registerHandler(const sp<AHandler> &handler) {
     return gLooperRoster.registerHandler(this, handler);
 }
@@ -165,30 +206,82 @@ status_t ALooper::stop() {
     return OK;
 }
 
+static inline bool isEarlier(int64_t whenUs, uint64_t seq, int64_t otherWhenUs, uint64_t otherSeq) {
+    return whenUs < otherWhenUs || (whenUs == otherWhenUs && seq < otherSeq);
+}
+
+void ALooper::pushTimedEvent_l(const Event &event) {
+    mTimedQueue.push();
+    size_t i = mTimedQueue.size() - 1;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        const Event &p = mTimedQueue[parent];
+        if (!isEarlier(event.mWhenUs, event.mSeq, p.mWhenUs, p.mSeq)) {
+            break;
+        }
+        mTimedQueue.editItemAt(i) = p;
+        i = parent;
+    }
+    mTimedQueue.editItemAt(i) = event;
+}
+
+void ALooper::popTimedEvent_l(Event *event) {
+    *event = mTimedQueue[0];
+
+    Event last = mTimedQueue[mTimedQueue.size() - 1];
+    mTimedQueue.removeAt(mTimedQueue.size() - 1);
+    size_t n = mTimedQueue.size();
+    if (n == 0) {
+        return;
+    }
+
+    size_t i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= n) {
+            break;
+        }
+        if (child + 1 < n && isEarlier(
+                mTimedQueue[child + 1].mWhenUs, mTimedQueue[child + 1].mSeq,
+                mTimedQueue[child].mWhenUs, mTimedQueue[child].mSeq)) {
+            ++child;
+        }
+        const Event &c = mTimedQueue[child];
+        if (!isEarlier(c.mWhenUs, c.mSeq, last.mWhenUs, last.mSeq)) {
+            break;
+        }
+        mTimedQueue.editItemAt(i) = c;
+        i = child;
+    }
+    mTimedQueue.editItemAt(i) = last;
+}
+
 void ALooper::post(const sp<AMessage> &msg, int64_t delayUs) {
     Mutex::Autolock autoLock(mLock);
 
-    int64_t whenUs;
+    Event event;
+    event.mWhenUs = GetNowUs();
+    event.mSeq = mNextSeq++;
+    event.mMessage = msg;
+
     if (delayUs > 0) {
-        whenUs = GetNowUs() + delayUs;
+        event.mWhenUs += delayUs;
+        pushTimedEvent_l(event);
     } else {
-        whenUs = GetNowUs();
+        // immediate messages skip the heap, they are always due in posting order
+        mImmediateQueue.push_back(event);
     }
 
-    List<Event>::iterator it = mEventQueue.begin();
-    while (it != mEventQueue.end() && (*it).mWhenUs <= whenUs) {
-        ++it;
+    size_t depth = mImmediateQueue.size() + mTimedQueue.size();
+    if (depth > mMaxQueueDepth) {
+        mMaxQueueDepth = depth;
     }
 
-    Event event;
-    event.mWhenUs = whenUs;
-    event.mMessage = msg;
-
-    if (it == mEventQueue.begin()) {
+    // only wake the looper if it would otherwise sleep past this event
+    if (mWakeUpUs != -1 && event.mWhenUs < mWakeUpUs) {
+        mWakeUpUs = -1;
         mQueueChangedCondition.signal();
     }
-
-    mEventQueue.insert(it, event);
 }
 
 bool ALooper::loop() {
@@ -199,22 +292,42 @@ bool ALooper::loop() {
         if (mThread == NULL && !mRunningLocally) {
             return false;
         }
-        if (mEventQueue.empty()) {
+        if (mImmediateQueue.empty() && mTimedQueue.empty()) {
+            mWakeUpUs = INT64_MAX;  // until something is posted
             mQueueChangedCondition.wait(mLock);
+            mWakeUpUs = -1;
             return true;
         }
-        int64_t whenUs = (*mEventQueue.begin()).mWhenUs;
+
+        // deliver whichever of the two queue heads is earlier; a delayed
+        // message that fell due before an immediate one was posted goes first
+        bool fromTimedQueue = mImmediateQueue.empty();
+        if (!fromTimedQueue && !mTimedQueue.empty()) {
+            const Event &timed = mTimedQueue[0];
+            const Event &immediate = *mImmediateQueue.begin();
+            fromTimedQueue = isEarlier(
+                    timed.mWhenUs, timed.mSeq, immediate.mWhenUs, immediate.mSeq);
+        }
+
         int64_t nowUs = GetNowUs();
+        if (fromTimedQueue) {
+            int64_t whenUs = mTimedQueue[0].mWhenUs;
 
-        if (whenUs > nowUs) {
-            int64_t delayUs = whenUs - nowUs;
-            mQueueChangedCondition.waitRelative(mLock, delayUs * 1000ll);
+            if (whenUs > nowUs) {
+                int64_t delayUs = whenUs - nowUs;
+                mWakeUpUs = whenUs;
+                mQueueChangedCondition.waitRelative(mLock, delayUs * 1000ll);
+                mWakeUpUs = -1;
 
-            return true;
-        }
+                return true;
+            }
 
-        event = *mEventQueue.begin();
-        mEventQueue.erase(mEventQueue.begin());
+            popTimedEvent_l(&event);
+        } else {
+            event = *mImmediateQueue.begin();
+            mImmediateQueue.erase(mImmediateQueue.begin());
+        }
+        mLatency.add(nowUs - event.mWhenUs);
     }
 
     event.mMessage->deliver();
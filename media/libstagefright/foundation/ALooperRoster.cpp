@@ -112,6 +112,20 @@ static void makeFourCC(uint32_t fourcc, char *s) {
     }
 }
 
+static void appendDurationStats(String8 *s, const ALooper::DurationStats &stats) {
+    s->appendFormat("%u, avg %.2f ms, max %.2f ms, histogram",
+            stats.mCount,
+            stats.mCount > 0 ? stats.mTotalUs / (stats.mCount * 1000.) : 0.,
+            stats.mMaxUs / 1000.);
+    for (size_t i = 0; i < ALooper::DurationStats::kNumBuckets; ++i) {
+        if (i + 1 < ALooper::DurationStats::kNumBuckets) {
+            s->appendFormat(" <%dms:%u", 1 << i, stats.mBuckets[i]);
+        } else {
+            s->appendFormat(" >=%dms:%u", 1 << (i - 1), stats.mBuckets[i]);
+        }
+    }
+}
+
 void ALooperRoster::dump(int fd, const Vector<String16>& args) {
     bool clear = false;
     bool oldVerbose = verboseStats;
@@ -129,9 +143,39 @@ void ALooperRoster::dump(int fd, const Vector<String16>& args) {
         s.append("(verbose stats collection enabled, stats will be cleared)\n");
     }
 
+    // a looper usually serves several handlers, list each one once. The
+    // references must outlive the lock, see unregisterStaleHandlers().
+    Vector<sp<ALooper> > loopers;
+
     Mutex::Autolock autoLock(mLock);
     size_t n = mHandlers.size();
-    s.appendFormat(" %zu registered handlers:\n", n);
+
+    for (size_t i = 0; i < n; i++) {
+        sp<ALooper> looper = mHandlers.valueAt(i).mLooper.promote();
+        if (looper == NULL) {
+            continue;
+        }
+        bool found = false;
+        for (size_t j = 0; j < loopers.size() && !found; j++) {
+            found = loopers[j] == looper;
+        }
+        if (!found) {
+            loopers.push(looper);
+        }
+    }
+    s.appendFormat(" %zu active loopers (messages delivered, delivery latency):\n",
+            loopers.size());
+    for (size_t i = 0; i < loopers.size(); i++) {
+        ALooper::Stats stats;
+        loopers[i]->getStats(&stats, clear);
+        s.appendFormat("  %s: queue depth %zu (max %zu), messages ",
+                loopers[i]->getName(), stats.mQueueDepth, stats.mMaxQueueDepth);
+        appendDurationStats(&s, stats.mLatency);
+        s.append("\n");
+    }
+
+    s.appendFormat(" %zu registered handlers%s:\n",
+            n, verboseStats ? " (messages handled, handling time)" : "");
 
     for (size_t i = 0; i < n; i++) {
         s.appendFormat("  %d: ", mHandlers.keyAt(i));
@@ -143,13 +187,13 @@ void ALooperRoster::dump(int fd, const Vector<String16>& args) {
             if (handler != NULL) {
                 handler->mVerboseStats = verboseStats;
                 s.appendFormat(": %u messages processed", handler->mMessageCounter);
+                Mutex::Autolock statsLock(handler->mStatsLock);
                 if (verboseStats) {
                     for (size_t j = 0; j < handler->mMessages.size(); j++) {
                         char fourcc[15];
                         makeFourCC(handler->mMessages.keyAt(j), fourcc);
-                        s.appendFormat("\n    %s: %u",
-                                fourcc,
-                                handler->mMessages.valueAt(j));
+                        s.appendFormat("\n    %s: ", fourcc);
+                        appendDurationStats(&s, handler->mMessages.valueAt(j));
                     }
                 } else {
                     handler->mMessages.clear();
@@ -22,6 +22,7 @@
 #include "AMessage.h"
 
 #include <ctype.h>
+#include <pthread.h>
 
 #include "AAtomizer.h"
 #include "ABuffer.h"
@@ -48,6 +49,64 @@ status_t AReplyToken::setReply(const sp<AMessage> &reply) {
     return OK;
 }
 
+// Each thread keeps up to this many freed messages for reuse. A looper thread
+// typically frees the message it just delivered and allocates the next one.
+static const size_t kMaxCachedMessages = 8;
+
+struct MessageCache {
+    void *mMessages[kMaxCachedMessages];
+    size_t mNumMessages;
+};
+
+static pthread_once_t gMessageCacheOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t gMessageCacheKey;
+
+static void freeMessageCache(void *data) {
+    MessageCache *cache = (MessageCache *)data;
+    for (size_t i = 0; i < cache->mNumMessages; ++i) {
+        ::operator delete(cache->mMessages[i]);
+    }
+    delete cache;
+}
+
+static void createMessageCacheKey() {
+    CHECK_EQ(pthread_key_create(&gMessageCacheKey, freeMessageCache), 0);
+}
+
+static MessageCache *getMessageCache() {
+    pthread_once(&gMessageCacheOnce, createMessageCacheKey);
+    MessageCache *cache = (MessageCache *)pthread_getspecific(gMessageCacheKey);
+    if (cache == NULL) {
+        cache = new MessageCache;
+        cache->mNumMessages = 0;
+        pthread_setspecific(gMessageCacheKey, cache);
+    }
+    return cache;
+}
+
+// static
+void *AMessage::operator new(size_t size) {
+    if (size == sizeof(AMessage)) {
+        MessageCache *cache = getMessageCache();
+        if (cache->mNumMessages > 0) {
+            return cache->mMessages[--cache->mNumMessages];
+        }
+    }
+    return ::operator new(size);
+}
+
+// static
+void AMessage::operator delete(void *ptr, size_t size) {
+    if (ptr != NULL && size == sizeof(AMessage)) {
+        MessageCache *cache = getMessageCache();
+        if (cache->mNumMessages < kMaxCachedMessages) {
+            cache->mMessages[cache->mNumMessages++] = ptr;
+            return;
+        }
+    }
+    ::operator delete(ptr);
+}
+
 AMessage::AMessage(void)
     : mWhat(0),
       mTarget(0),
@@ -88,8 +147,7 @@ void AMessage::setTarget(const sp<const AHandler> &handler) {
 void AMessage::clear() {
     for (size_t i = 0; i < mNumItems; ++i) {
         Item *item = &mItems[i];
-        delete[] item->mName;
-        item->mName = NULL;
+        item->freeName();
         freeItemValue(item);
     }
     mNumItems = 0;
@@ -152,13 +210,25 @@ static void reportStats() {
 }
 #endif
 
-inline size_t AMessage::findItemIndex(const char *name, size_t len) const {
+// Returns the length of name and computes its hash in the same pass.
+static inline size_t hashName(const char *name, uint32_t *hash) {
+    uint32_t h = 2166136261u;
+    const char *s = name;
+    for (; *s != '\0'; ++s) {
+        h = (h ^ (uint8_t)*s) * 16777619u;
+    }
+    *hash = h;
+    return s - name;
+}
+
+inline size_t AMessage::findItemIndex(
+        const char *name, size_t len, uint32_t hash) const {
 #ifdef DUMP_STATS
     size_t memchecks = 0;
 #endif
     size_t i = 0;
     for (; i < mNumItems; i++) {
-        if (len != mItems[i].mNameLength) {
+        if (hash != mItems[i].mNameHash || len != mItems[i].mNameLength) {
             continue;
         }
 #ifdef DUMP_STATS
@@ -182,15 +252,28 @@ inline size_t AMessage::findItemIndex(const char *name, size_t len) const {
 }
 
 // assumes item's name was uninitialized or NULL
-void AMessage::Item::setName(const char *name, size_t len) {
+void AMessage::Item::setName(const char *name, size_t len, uint32_t hash) {
     mNameLength = len;
-    mName = new char[len + 1];
+    mNameHash = hash;
+    if (len < sizeof(mInlineName)) {
+        mName = mInlineName;
+    } else {
+        mName = new char[len + 1];
+    }
     memcpy((void*)mName, name, len + 1);
 }
 
+void AMessage::Item::freeName() {
+    if (mName != mInlineName) {
+        delete[] mName;
+    }
+    mName = NULL;
+}
+
 AMessage::Item *AMessage::allocateItem(const char *name) {
-    size_t len = strlen(name);
-    size_t i = findItemIndex(name, len);
+    uint32_t hash;
+    size_t len = hashName(name, &hash);
+    size_t i = findItemIndex(name, len, hash);
     Item *item;
 
     if (i < mNumItems) {
@@ -200,7 +283,7 @@ AMessage::Item *AMessage::allocateItem(const char *name) {
         CHECK(mNumItems < kMaxNumItems);
         i = mNumItems++;
         item = &mItems[i];
-        item->setName(name, len);
+        item->setName(name, len, hash);
     }
 
     return item;
@@ -208,7 +291,9 @@ AMessage::Item *AMessage::allocateItem(const char *name) {
 
 const AMessage::Item *AMessage::findItem(
         const char *name, Type type) const {
-    size_t i = findItemIndex(name, strlen(name));
+    uint32_t hash;
+    size_t len = hashName(name, &hash);
+    size_t i = findItemIndex(name, len, hash);
     if (i < mNumItems) {
         const Item *item = &mItems[i];
         return item->mType == type ? item : NULL;
@@ -218,7 +303,9 @@ const AMessage::Item *AMessage::findItem(
 }
 
 bool AMessage::contains(const char *name) const {
-    size_t i = findItemIndex(name, strlen(name));
+    uint32_t hash;
+    size_t len = hashName(name, &hash);
+    size_t i = findItemIndex(name, len, hash);
     return i < mNumItems;
 }
 
@@ -434,7 +521,7 @@ sp<AMessage> AMessage::dup() const {
         const Item *from = &mItems[i];
         Item *to = &msg->mItems[i];
 
-        to->setName(from->mName, from->mNameLength);
+        to->setName(from->mName, from->mNameLength, from->mNameHash);
         to->mType = from->mType;
 
         switch (from->mType) {
@@ -686,7 +773,9 @@ sp<AMessage> AMessage::FromParcel(const Parcel &parcel) {
             }
         }
 
-        item->setName(name, strlen(name));
+        uint32_t hash;
+        size_t len = hashName(name, &hash);
+        item->setName(name, len, hash);
     }
 
     return msg;
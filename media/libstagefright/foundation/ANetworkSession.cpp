@@ -22,11 +22,13 @@
 #include "ParsedMessage.h"
 
 #include <arpa/inet.h>
+#include <cutils/atomic.h>
 #include <fcntl.h>
 #include <linux/tcp.h>
 #include <net/if.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <sys/epoll.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 
@@ -52,14 +54,49 @@ static uint64_t U64_AT(const uint8_t *ptr) {
 static const size_t kMaxUDPSize = 1500;
 static const int32_t kMaxUDPRetries = 200;
 
+// datagrams handed to the kernel per sendmmsg() call
+static const size_t kMaxDatagramsPerSend = 32;
+
+// datagrams taken from the kernel per recvmmsg() call
+static const size_t kMaxDatagramsPerReceive = 16;
+
+// received datagram buffers a UDP session reuses once its clients let go of them
+static const size_t kNumPooledDatagrams = 4 * kMaxDatagramsPerReceive;
+
+// epoll events handled per wakeup of a network thread
+static const int kMaxEventsPerWait = 64;
+
+// epoll data of the wakeup pipe, session IDs start at 1
+static const uint32_t kWakeupEventID = 0;
+
+// The sessions of one network thread, and what it waits on.
+struct ANetworkSession::Shard : public RefBase {
+    Shard()
+        : mEpollFd(-1) {
+        mPipeFd[0] = mPipeFd[1] = -1;
+    }
+
+    Mutex mLock;
+    sp<Thread> mThread;
+
+    int mEpollFd;
+    int mPipeFd[2];
+
+    KeyedVector<int32_t, sp<Session> > mSessions;
+
+private:
+    DISALLOW_EVIL_CONSTRUCTORS(Shard);
+};
+
 struct ANetworkSession::NetworkThread : public Thread {
-    NetworkThread(ANetworkSession *session);
+    NetworkThread(ANetworkSession *session, const sp<Shard> &shard);
 
 protected:
     virtual ~NetworkThread();
 
 private:
     ANetworkSession *mSession;
+    sp<Shard> mShard;
 
     virtual bool threadLoop();
 
@@ -96,12 +133,18 @@ struct ANetworkSession::Session : public RefBase {
     bool wantsToRead();
     bool wantsToWrite();
 
+    // what the session is registered for with the epoll instance of its shard
+    uint32_t epollEvents() const;
+    void setEpollEvents(uint32_t events);
+
     status_t readMore();
     status_t writeMore();
 
     status_t sendRequest(
             const void *data, ssize_t size, bool timeValid, int64_t timeUs);
 
+    status_t sendDatagram(const sp<ABuffer> &datagram, bool timeValid, int64_t timeUs);
+
     void setMode(Mode mode);
 
     status_t switchToWebSocketMode();
@@ -131,6 +174,11 @@ private:
 
     AString mInBuffer;
 
+    uint32_t mEpollEvents;
+
+    Vector<sp<ABuffer> > mDatagramPool;
+    size_t mNextPooledDatagram;
+
     int64_t mLastStallReportUs;
 
     void notifyError(bool send, status_t err, const char *detail);
@@ -138,19 +186,23 @@ private:
 
     void dumpFragmentStats(const Fragment &frag);
 
+    sp<ABuffer> obtainDatagramBuffer();
+
     DISALLOW_EVIL_CONSTRUCTORS(Session);
 };
 ////////////////////////////////////////////////////////////////////////////////
 
-ANetworkSession::NetworkThread::NetworkThread(ANetworkSession *session)
-    : mSession(session) {
+ANetworkSession::NetworkThread::NetworkThread(
+        ANetworkSession *session, const sp<Shard> &shard)
+    : mSession(session),
+      mShard(shard) {
 }
 
 ANetworkSession::NetworkThread::~NetworkThread() {
 }
 
 bool ANetworkSession::NetworkThread::threadLoop() {
-    mSession->threadLoop();
+    mSession->threadLoop(mShard);
 
     return true;
 }
@@ -170,6 +222,8 @@ ANetworkSession::Session::Session(
       mSawReceiveFailure(false),
       mSawSendFailure(false),
       mUDPRetries(kMaxUDPRetries),
+      mEpollEvents(0),
+      mNextPooledDatagram(0),
       mLastStallReportUs(-1ll) {
     if (mState == CONNECTED) {
         struct sockaddr_in localAddr;
@@ -265,22 +319,70 @@ bool ANetworkSession::Session::wantsToWrite() {
             || (mState == DATAGRAM && !mOutFragments.empty()));
 }
 
+uint32_t ANetworkSession::Session::epollEvents() const {
+    return mEpollEvents;
+}
+
+void ANetworkSession::Session::setEpollEvents(uint32_t events) {
+    mEpollEvents = events;
+}
+
+sp<ABuffer> ANetworkSession::Session::obtainDatagramBuffer() {
+    if (mDatagramPool.size() < kNumPooledDatagrams) {
+        sp<ABuffer> buf = new ABuffer(kMaxUDPSize);
+        mDatagramPool.push_back(buf);
+        return buf;
+    }
+
+    for (size_t i = 0; i < kNumPooledDatagrams; ++i) {
+        size_t index = mNextPooledDatagram;
+        mNextPooledDatagram = (mNextPooledDatagram + 1) % kNumPooledDatagrams;
+
+        // nothing but the pool refers to it any more
+        sp<ABuffer> &buf = mDatagramPool.editItemAt(index);
+        if (buf->getStrongCount() == 1) {
+            buf->setRange(0, buf->capacity());
+            buf->meta()->clear();
+            return buf;
+        }
+    }
+
+    // the clients hold on to all of them, replace the oldest
+    sp<ABuffer> buf = new ABuffer(kMaxUDPSize);
+    mDatagramPool.editItemAt(mNextPooledDatagram) = buf;
+    mNextPooledDatagram = (mNextPooledDatagram + 1) % kNumPooledDatagrams;
+    return buf;
+}
+
 status_t ANetworkSession::Session::readMore() {
     if (mState == DATAGRAM) {
         CHECK_EQ(mMode, MODE_DATAGRAM);
 
+        struct mmsghdr msgs[kMaxDatagramsPerReceive];
+        struct iovec iovs[kMaxDatagramsPerReceive];
+        struct sockaddr_in remoteAddrs[kMaxDatagramsPerReceive];
+        sp<ABuffer> bufs[kMaxDatagramsPerReceive];
+
         status_t err;
         do {
-            sp<ABuffer> buf = new ABuffer(kMaxUDPSize);
+            for (size_t i = 0; i < kMaxDatagramsPerReceive; ++i) {
+                if (bufs[i] == NULL) {
+                    bufs[i] = obtainDatagramBuffer();
+                }
+
+                iovs[i].iov_base = bufs[i]->data();
+                iovs[i].iov_len = bufs[i]->capacity();
 
-            struct sockaddr_in remoteAddr;
-            socklen_t remoteAddrLen = sizeof(remoteAddr);
+                memset(&msgs[i], 0, sizeof(msgs[i]));
+                msgs[i].msg_hdr.msg_name = &remoteAddrs[i];
+                msgs[i].msg_hdr.msg_namelen = sizeof(remoteAddrs[i]);
+                msgs[i].msg_hdr.msg_iov = &iovs[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+            }
 
-            ssize_t n;
+            int n;
             do {
-                n = recvfrom(
-                        mSocket, buf->data(), buf->capacity(), 0,
-                        (struct sockaddr *)&remoteAddr, &remoteAddrLen);
+                n = recvmmsg(mSocket, msgs, kMaxDatagramsPerReceive, 0, NULL /* timeout */);
             } while (n < 0 && errno == EINTR);
 
             err = OK;
@@ -289,29 +391,40 @@ status_t ANetworkSession::Session::readMore() {
             } else if (n == 0) {
                 err = -ECONNRESET;
             } else {
-                buf->setRange(0, n);
-
                 int64_t nowUs = ALooper::GetNowUs();
-                buf->meta()->setInt64("arrivalTimeUs", nowUs);
 
-                sp<AMessage> notify = mNotify->dup();
-                notify->setInt32("sessionID", mSessionID);
-                notify->setInt32("reason", kWhatDatagram);
+                for (int i = 0; i < n; ++i) {
+                    if (msgs[i].msg_len == 0) {
+                        err = -ECONNRESET;
+                        break;
+                    }
 
-                uint32_t ip = ntohl(remoteAddr.sin_addr.s_addr);
-                notify->setString(
-                        "fromAddr",
-                        AStringPrintf(
-                            "%u.%u.%u.%u",
-                            ip >> 24,
-                            (ip >> 16) & 0xff,
-                            (ip >> 8) & 0xff,
-                            ip & 0xff).c_str());
+                    sp<ABuffer> buf = bufs[i];
+                    bufs[i].clear();
 
-                notify->setInt32("fromPort", ntohs(remoteAddr.sin_port));
+                    buf->setRange(0, msgs[i].msg_len);
+                    buf->meta()->setInt64("arrivalTimeUs", nowUs);
 
-                notify->setBuffer("data", buf);
-                notify->post();
+                    sp<AMessage> notify = mNotify->dup();
+                    notify->setInt32("sessionID", mSessionID);
+                    notify->setInt32("reason", kWhatDatagram);
+
+                    const struct sockaddr_in &remoteAddr = remoteAddrs[i];
+                    uint32_t ip = ntohl(remoteAddr.sin_addr.s_addr);
+                    notify->setString(
+                            "fromAddr",
+                            AStringPrintf(
+                                "%u.%u.%u.%u",
+                                ip >> 24,
+                                (ip >> 16) & 0xff,
+                                (ip >> 8) & 0xff,
+                                ip & 0xff).c_str());
+
+                    notify->setInt32("fromPort", ntohs(remoteAddr.sin_port));
+
+                    notify->setBuffer("data", buf);
+                    notify->post();
+                }
             }
         } while (err == OK);
 
@@ -552,24 +665,39 @@ status_t ANetworkSession::Session::writeMore() {
     if (mState == DATAGRAM) {
         CHECK(!mOutFragments.empty());
 
+        struct mmsghdr msgs[kMaxDatagramsPerSend];
+        struct iovec iovs[kMaxDatagramsPerSend];
+
         status_t err;
         do {
-            const Fragment &frag = *mOutFragments.begin();
-            const sp<ABuffer> &datagram = frag.mBuffer;
+            size_t count = 0;
+            for (List<Fragment>::iterator it = mOutFragments.begin();
+                    it != mOutFragments.end() && count < kMaxDatagramsPerSend; ++it) {
+                iovs[count].iov_base = (*it).mBuffer->data();
+                iovs[count].iov_len = (*it).mBuffer->size();
+
+                memset(&msgs[count], 0, sizeof(msgs[count]));
+                msgs[count].msg_hdr.msg_iov = &iovs[count];
+                msgs[count].msg_hdr.msg_iovlen = 1;
+                ++count;
+            }
 
             int n;
             do {
-                n = send(mSocket, datagram->data(), datagram->size(), 0);
+                n = sendmmsg(mSocket, msgs, count, 0);
             } while (n < 0 && errno == EINTR);
 
             err = OK;
 
             if (n > 0) {
-                if (frag.mFlags & FRAGMENT_FLAG_TIME_VALID) {
-                    dumpFragmentStats(frag);
-                }
+                for (int i = 0; i < n; ++i) {
+                    const Fragment &frag = *mOutFragments.begin();
+                    if (frag.mFlags & FRAGMENT_FLAG_TIME_VALID) {
+                        dumpFragmentStats(frag);
+                    }
 
-                mOutFragments.erase(mOutFragments.begin());
+                    mOutFragments.erase(mOutFragments.begin());
+                }
             } else if (n < 0) {
                 err = -errno;
             } else if (n == 0) {
@@ -777,6 +905,31 @@ status_t ANetworkSession::Session::sendRequest(
     return OK;
 }
 
+status_t ANetworkSession::Session::sendDatagram(
+        const sp<ABuffer> &datagram, bool timeValid, int64_t timeUs) {
+    if (mState != DATAGRAM) {
+        return sendRequest(datagram->data(), datagram->size(), timeValid, timeUs);
+    }
+
+    if (datagram->size() == 0) {
+        return OK;
+    }
+
+    Fragment frag;
+
+    frag.mFlags = 0;
+    if (timeValid) {
+        frag.mFlags = FRAGMENT_FLAG_TIME_VALID;
+        frag.mTimeUs = timeUs;
+    }
+
+    frag.mBuffer = datagram;
+
+    mOutFragments.push_back(frag);
+
+    return OK;
+}
+
 void ANetworkSession::Session::notifyError(
         bool send, status_t err, const char *detail) {
     sp<AMessage> msg = mNotify->dup();
@@ -797,9 +950,13 @@ void ANetworkSession::Session::notify(NotificationReason reason) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
-ANetworkSession::ANetworkSession()
-    : mNextSessionID(1) {
-    mPipeFd[0] = mPipeFd[1] = -1;
+ANetworkSession::ANetworkSession(size_t numThreads)
+    : mStarted(false),
+      mNextSessionID(1) {
+    CHECK_GT(numThreads, 0u);
+    for (size_t i = 0; i < numThreads; ++i) {
+        mShards.push_back(new Shard);
+    }
 }
 
 ANetworkSession::~ANetworkSession() {
@@ -807,26 +964,92 @@ ANetworkSession::~ANetworkSession() {
 }
 
 status_t ANetworkSession::start() {
-    if (mThread != NULL) {
+    if (mStarted) {
+        return INVALID_OPERATION;
+    }
+
+    for (size_t i = 0; i < mShards.size(); ++i) {
+        status_t err = startShard(mShards.itemAt(i));
+
+        if (err != OK) {
+            while (i-- > 0) {
+                stopShard(mShards.itemAt(i));
+            }
+            return err;
+        }
+    }
+
+    mStarted = true;
+
+    return OK;
+}
+
+status_t ANetworkSession::stop() {
+    if (!mStarted) {
         return INVALID_OPERATION;
     }
 
-    int res = pipe(mPipeFd);
+    for (size_t i = 0; i < mShards.size(); ++i) {
+        stopShard(mShards.itemAt(i));
+    }
+
+    mStarted = false;
+
+    return OK;
+}
+
+status_t ANetworkSession::startShard(const sp<Shard> &shard) {
+    Mutex::Autolock autoLock(shard->mLock);
+
+    int res = pipe(shard->mPipeFd);
     if (res != 0) {
-        mPipeFd[0] = mPipeFd[1] = -1;
+        shard->mPipeFd[0] = shard->mPipeFd[1] = -1;
         return -errno;
     }
 
-    mThread = new NetworkThread(this);
+    status_t err = OK;
+
+    shard->mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (shard->mEpollFd < 0) {
+        err = -errno;
+    } else {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.u32 = kWakeupEventID;
+
+        res = epoll_ctl(shard->mEpollFd, EPOLL_CTL_ADD, shard->mPipeFd[0], &event);
+        if (res != 0) {
+            err = -errno;
+        }
+    }
+
+    if (err == OK) {
+        // sessions may have been created before we started
+        for (size_t i = 0; i < shard->mSessions.size(); ++i) {
+            updateEvents(shard, shard->mSessions.valueAt(i));
+        }
+
+        shard->mThread = new NetworkThread(this, shard);
 
-    status_t err = mThread->run("ANetworkSession", ANDROID_PRIORITY_AUDIO);
+        err = shard->mThread->run("ANetworkSession", ANDROID_PRIORITY_AUDIO);
+    }
 
     if (err != OK) {
-        mThread.clear();
+        shard->mThread.clear();
 
-        close(mPipeFd[0]);
-        close(mPipeFd[1]);
-        mPipeFd[0] = mPipeFd[1] = -1;
+        if (shard->mEpollFd >= 0) {
+            close(shard->mEpollFd);
+            shard->mEpollFd = -1;
+        }
+
+        for (size_t i = 0; i < shard->mSessions.size(); ++i) {
+            shard->mSessions.valueAt(i)->setEpollEvents(0);
+        }
+
+        close(shard->mPipeFd[0]);
+        close(shard->mPipeFd[1]);
+        shard->mPipeFd[0] = shard->mPipeFd[1] = -1;
 
         return err;
     }
@@ -834,22 +1057,84 @@ status_t ANetworkSession::start() {
     return OK;
 }
 
-status_t ANetworkSession::stop() {
-    if (mThread == NULL) {
-        return INVALID_OPERATION;
+void ANetworkSession::stopShard(const sp<Shard> &shard) {
+    shard->mThread->requestExit();
+    interrupt(shard);
+    shard->mThread->requestExitAndWait();
+
+    Mutex::Autolock autoLock(shard->mLock);
+
+    shard->mThread.clear();
+
+    // closing the epoll instance drops the registrations of the sessions
+    close(shard->mEpollFd);
+    shard->mEpollFd = -1;
+
+    for (size_t i = 0; i < shard->mSessions.size(); ++i) {
+        shard->mSessions.valueAt(i)->setEpollEvents(0);
     }
 
-    mThread->requestExit();
-    interrupt();
-    mThread->requestExitAndWait();
+    close(shard->mPipeFd[0]);
+    close(shard->mPipeFd[1]);
+    shard->mPipeFd[0] = shard->mPipeFd[1] = -1;
+}
+
+const sp<ANetworkSession::Shard> &ANetworkSession::shardFor(int32_t sessionID) const {
+    return mShards.itemAt(sessionID % mShards.size());
+}
 
-    mThread.clear();
+void ANetworkSession::addSession(const sp<Session> &session) {
+    const sp<Shard> &shard = shardFor(session->sessionID());
 
-    close(mPipeFd[0]);
-    close(mPipeFd[1]);
-    mPipeFd[0] = mPipeFd[1] = -1;
+    Mutex::Autolock autoLock(shard->mLock);
 
-    return OK;
+    shard->mSessions.add(session->sessionID(), session);
+    updateEvents(shard, session);
+}
+
+// The epoll instances are level triggered like select(), a session is only registered
+// while it wants to read or write. Called with the lock of |shard| held whenever that
+// may have changed.
+void ANetworkSession::updateEvents(const sp<Shard> &shard, const sp<Session> &session) {
+    if (shard->mEpollFd < 0) {
+        // startShard() registers it
+        return;
+    }
+
+    uint32_t events = 0;
+    if (session->wantsToRead()) {
+        events |= EPOLLIN;
+    }
+    if (session->wantsToWrite()) {
+        events |= EPOLLOUT;
+    }
+
+    uint32_t oldEvents = session->epollEvents();
+    if (events == oldEvents) {
+        return;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.u32 = session->sessionID();
+
+    int op = EPOLL_CTL_MOD;
+    if (oldEvents == 0) {
+        op = EPOLL_CTL_ADD;
+    } else if (events == 0) {
+        // or a session that failed would keep reporting EPOLLHUP
+        op = EPOLL_CTL_DEL;
+    }
+
+    int res = epoll_ctl(shard->mEpollFd, op, session->socket(), &event);
+    if (res != 0) {
+        ALOGE("epoll_ctl on socket %d failed w/ error %d (%s)",
+              session->socket(), errno, strerror(errno));
+        return;
+    }
+
+    session->setEpollEvents(events);
 }
 
 status_t ANetworkSession::createRTSPClient(
@@ -929,17 +1214,23 @@ status_t ANetworkSession::createTCPDatagramSession(
 }
 
 status_t ANetworkSession::destroySession(int32_t sessionID) {
-    Mutex::Autolock autoLock(mLock);
+    const sp<Shard> &shard = shardFor(sessionID);
+
+    Mutex::Autolock autoLock(shard->mLock);
 
-    ssize_t index = mSessions.indexOfKey(sessionID);
+    ssize_t index = shard->mSessions.indexOfKey(sessionID);
 
     if (index < 0) {
         return -ENOENT;
     }
 
-    mSessions.removeItemsAt(index);
+    const sp<Session> session = shard->mSessions.valueAt(index);
+    if (session->epollEvents() != 0 && shard->mEpollFd >= 0) {
+        epoll_ctl(shard->mEpollFd, EPOLL_CTL_DEL, session->socket(), NULL);
+        session->setEpollEvents(0);
+    }
 
-    interrupt();
+    shard->mSessions.removeItemsAt(index);
 
     return OK;
 }
@@ -967,8 +1258,6 @@ status_t ANetworkSession::createClientOrServer(
         unsigned remotePort,
         const sp<AMessage> &notify,
         int32_t *sessionID) {
-    Mutex::Autolock autoLock(mLock);
-
     *sessionID = 0;
     status_t err = OK;
     int s, res;
@@ -1137,7 +1426,7 @@ status_t ANetworkSession::createClientOrServer(
     }
 
     session = new Session(
-            mNextSessionID++,
+            android_atomic_inc(&mNextSessionID),
             state,
             s,
             notify);
@@ -1148,9 +1437,7 @@ status_t ANetworkSession::createClientOrServer(
         session->setMode(Session::MODE_RTSP);
     }
 
-    mSessions.add(session->sessionID(), session);
-
-    interrupt();
+    addSession(session);
 
     *sessionID = session->sessionID();
 
@@ -1166,10 +1453,12 @@ bail:
 
 status_t ANetworkSession::connectUDPSession(
         int32_t sessionID, const char *remoteHost, unsigned remotePort) {
-    Mutex::Autolock autoLock(mLock);
+    const sp<Shard> &shard = shardFor(sessionID);
+
+    Mutex::Autolock autoLock(shard->mLock);
 
     status_t err = OK;
-    ssize_t index = mSessions.indexOfKey(sessionID);
+    ssize_t index = shard->mSessions.indexOfKey(sessionID);
 
     if (index < 0) {
         return -ENOENT;
@@ -1180,7 +1469,7 @@ status_t ANetworkSession::connectUDPSession(
         return err;
     }
 
-    const sp<Session> session = mSessions.valueAt(index);
+    const sp<Session> session = shard->mSessions.valueAt(index);
     int s = session->socket();
 
     struct sockaddr_in remoteAddr;
@@ -1210,42 +1499,77 @@ status_t ANetworkSession::connectUDPSession(
 status_t ANetworkSession::sendRequest(
         int32_t sessionID, const void *data, ssize_t size,
         bool timeValid, int64_t timeUs) {
-    Mutex::Autolock autoLock(mLock);
+    const sp<Shard> &shard = shardFor(sessionID);
+
+    Mutex::Autolock autoLock(shard->mLock);
 
-    ssize_t index = mSessions.indexOfKey(sessionID);
+    ssize_t index = shard->mSessions.indexOfKey(sessionID);
 
     if (index < 0) {
         return -ENOENT;
     }
 
-    const sp<Session> session = mSessions.valueAt(index);
+    const sp<Session> session = shard->mSessions.valueAt(index);
 
     status_t err = session->sendRequest(data, size, timeValid, timeUs);
 
-    interrupt();
+    // registering for EPOLLOUT wakes up the network thread
+    updateEvents(shard, session);
+
+    return err;
+}
+
+status_t ANetworkSession::sendDatagrams(
+        int32_t sessionID, const List<sp<ABuffer> > &datagrams,
+        bool timeValid, int64_t timeUs) {
+    const sp<Shard> &shard = shardFor(sessionID);
+
+    Mutex::Autolock autoLock(shard->mLock);
+
+    ssize_t index = shard->mSessions.indexOfKey(sessionID);
+
+    if (index < 0) {
+        return -ENOENT;
+    }
+
+    const sp<Session> session = shard->mSessions.valueAt(index);
+
+    status_t err = OK;
+    for (List<sp<ABuffer> >::const_iterator it = datagrams.begin();
+            err == OK && it != datagrams.end(); ++it) {
+        List<sp<ABuffer> >::const_iterator next = it;
+        bool last = ++next == datagrams.end();
+
+        err = session->sendDatagram(*it, timeValid && last, timeUs);
+    }
+
+    // one wakeup of the network thread for the whole batch
+    updateEvents(shard, session);
 
     return err;
 }
 
 status_t ANetworkSession::switchToWebSocketMode(int32_t sessionID) {
-    Mutex::Autolock autoLock(mLock);
+    const sp<Shard> &shard = shardFor(sessionID);
+
+    Mutex::Autolock autoLock(shard->mLock);
 
-    ssize_t index = mSessions.indexOfKey(sessionID);
+    ssize_t index = shard->mSessions.indexOfKey(sessionID);
 
     if (index < 0) {
         return -ENOENT;
     }
 
-    const sp<Session> session = mSessions.valueAt(index);
+    const sp<Session> session = shard->mSessions.valueAt(index);
     return session->switchToWebSocketMode();
 }
 
-void ANetworkSession::interrupt() {
+void ANetworkSession::interrupt(const sp<Shard> &shard) {
     static const char dummy = 0;
 
     ssize_t n;
     do {
-        n = write(mPipeFd[1], &dummy, 1);
+        n = write(shard->mPipeFd[1], &dummy, 1);
     } while (n < 0 && errno == EINTR);
 
     if (n < 0) {
@@ -1253,43 +1577,10 @@ void ANetworkSession::interrupt() {
     }
 }
 
-void ANetworkSession::threadLoop() {
-    fd_set rs, ws;
-    FD_ZERO(&rs);
-    FD_ZERO(&ws);
-
-    FD_SET(mPipeFd[0], &rs);
-    int maxFd = mPipeFd[0];
-
-    {
-        Mutex::Autolock autoLock(mLock);
-
-        for (size_t i = 0; i < mSessions.size(); ++i) {
-            const sp<Session> &session = mSessions.valueAt(i);
-
-            int s = session->socket();
-
-            if (s < 0) {
-                continue;
-            }
-
-            if (session->wantsToRead()) {
-                FD_SET(s, &rs);
-                if (s > maxFd) {
-                    maxFd = s;
-                }
-            }
-
-            if (session->wantsToWrite()) {
-                FD_SET(s, &ws);
-                if (s > maxFd) {
-                    maxFd = s;
-                }
-            }
-        }
-    }
+void ANetworkSession::threadLoop(const sp<Shard> &shard) {
+    struct epoll_event events[kMaxEventsPerWait];
 
-    int res = select(maxFd + 1, &rs, &ws, NULL, NULL /* tv */);
+    int res = epoll_wait(shard->mEpollFd, events, kMaxEventsPerWait, -1 /* timeout */);
 
     if (res == 0) {
         return;
@@ -1300,43 +1591,48 @@ void ANetworkSession::threadLoop() {
             return;
         }
 
-        ALOGE("select failed w/ error %d (%s)", errno, strerror(errno));
+        ALOGE("epoll_wait failed w/ error %d (%s)", errno, strerror(errno));
         return;
     }
 
-    if (FD_ISSET(mPipeFd[0], &rs)) {
-        char c;
-        ssize_t n;
-        do {
-            n = read(mPipeFd[0], &c, 1);
-        } while (n < 0 && errno == EINTR);
-
-        if (n < 0) {
-            ALOGW("Error reading from pipe (%s)", strerror(errno));
-        }
-
-        --res;
-    }
+    List<sp<Session> > sessionsToAdd;
 
     {
-        Mutex::Autolock autoLock(mLock);
-
-        List<sp<Session> > sessionsToAdd;
+        Mutex::Autolock autoLock(shard->mLock);
 
-        for (size_t i = mSessions.size(); res > 0 && i-- > 0;) {
-            const sp<Session> &session = mSessions.valueAt(i);
+        for (int i = 0; i < res; ++i) {
+            const struct epoll_event &event = events[i];
 
-            int s = session->socket();
+            if (event.data.u32 == kWakeupEventID) {
+                char tmp[64];
+                ssize_t n;
+                do {
+                    n = read(shard->mPipeFd[0], tmp, sizeof(tmp));
+                } while (n < 0 && errno == EINTR);
 
-            if (s < 0) {
+                if (n < 0) {
+                    ALOGW("Error reading from pipe (%s)", strerror(errno));
+                }
                 continue;
             }
 
-            if (FD_ISSET(s, &rs) || FD_ISSET(s, &ws)) {
-                --res;
+            // the session may have been destroyed since
+            ssize_t index = shard->mSessions.indexOfKey(event.data.u32);
+            if (index < 0) {
+                continue;
             }
 
-            if (FD_ISSET(s, &rs)) {
+            sp<Session> session = shard->mSessions.valueAt(index);
+
+            int s = session->socket();
+
+            // like select(), errors and hangups make a socket readable and writable
+            bool readable = (session->epollEvents() & EPOLLIN)
+                && (event.events & (EPOLLIN | EPOLLERR | EPOLLHUP));
+            bool writable = (session->epollEvents() & EPOLLOUT)
+                && (event.events & (EPOLLOUT | EPOLLERR | EPOLLHUP));
+
+            if (readable) {
                 if (session->isRTSPServer() || session->isTCPDatagramServer()) {
                     struct sockaddr_in remoteAddr;
                     socklen_t remoteAddrLen = sizeof(remoteAddr);
@@ -1368,7 +1664,7 @@ void ANetworkSession::threadLoop() {
 
                             sp<Session> clientSession =
                                 new Session(
-                                        mNextSessionID++,
+                                        android_atomic_inc(&mNextSessionID),
                                         Session::CONNECTED,
                                         clientSocket,
                                         session->getNotificationMessage());
@@ -1393,23 +1689,26 @@ void ANetworkSession::threadLoop() {
                 }
             }
 
-            if (FD_ISSET(s, &ws)) {
+            if (writable) {
                 status_t err = session->writeMore();
                 if (err != OK) {
                     ALOGE("writeMore on socket %d failed w/ error %d (%s)",
                           s, err, strerror(-err));
                 }
             }
+
+            updateEvents(shard, session);
         }
+    }
 
-        while (!sessionsToAdd.empty()) {
-            sp<Session> session = *sessionsToAdd.begin();
-            sessionsToAdd.erase(sessionsToAdd.begin());
+    // they may belong to another shard, whose lock must not be taken with ours
+    while (!sessionsToAdd.empty()) {
+        sp<Session> session = *sessionsToAdd.begin();
+        sessionsToAdd.erase(sessionsToAdd.begin());
 
-            mSessions.add(session->sessionID(), session);
+        addSession(session);
 
-            ALOGI("added clientSession %d", session->sessionID());
-        }
+        ALOGI("added clientSession %d", session->sessionID());
     }
 }
 
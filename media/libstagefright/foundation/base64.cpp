@@ -21,20 +21,43 @@
 
 namespace android {
 
+// Maps each character to its 6 bit value, or -1 if it is not in the base64 alphabet.
+static const int8_t kDecodeTable[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1, -1, 63,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1, -1,
+    -1,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1,
+    -1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
 sp<ABuffer> decodeBase64(const AString &s) {
-    size_t n = s.size();
+    return decodeBase64(s.c_str(), s.size());
+}
+
+sp<ABuffer> decodeBase64(const char *s, size_t n) {
     if ((n % 4) != 0) {
         return NULL;
     }
 
     size_t padding = 0;
-    if (n >= 1 && s.c_str()[n - 1] == '=') {
+    if (n >= 1 && s[n - 1] == '=') {
         padding = 1;
 
-        if (n >= 2 && s.c_str()[n - 2] == '=') {
+        if (n >= 2 && s[n - 2] == '=') {
             padding = 2;
 
-            if (n >= 3 && s.c_str()[n - 3] == '=') {
+            if (n >= 3 && s[n - 3] == '=') {
                 padding = 3;
             }
         }
@@ -50,43 +73,46 @@ sp<ABuffer> decodeBase64(const AString &s) {
     if (out == NULL || buffer->size() < outLen) {
         return NULL;
     }
+    if (n == 0) {
+        return buffer;
+    }
+
+    const uint8_t *in = (const uint8_t *)s;
     size_t j = 0;
-    uint32_t accum = 0;
-    for (size_t i = 0; i < n; ++i) {
-        char c = s.c_str()[i];
-        unsigned value;
-        if (c >= 'A' && c <= 'Z') {
-            value = c - 'A';
-        } else if (c >= 'a' && c <= 'z') {
-            value = 26 + c - 'a';
-        } else if (c >= '0' && c <= '9') {
-            value = 52 + c - '0';
-        } else if (c == '+') {
-            value = 62;
-        } else if (c == '/') {
-            value = 63;
-        } else if (c != '=') {
+
+    // Padding can only appear in the last group, so every group before it
+    // decodes straight through the table.
+    const size_t lastGroup = n - 4;
+    for (size_t i = 0; i < lastGroup; i += 4) {
+        const int32_t v0 = kDecodeTable[in[i]];
+        const int32_t v1 = kDecodeTable[in[i + 1]];
+        const int32_t v2 = kDecodeTable[in[i + 2]];
+        const int32_t v3 = kDecodeTable[in[i + 3]];
+        if ((v0 | v1 | v2 | v3) < 0) {
             return NULL;
-        } else {
-            if (i < n - padding) {
+        }
+        const uint32_t accum = (v0 << 18) | (v1 << 12) | (v2 << 6) | v3;
+        out[j++] = accum >> 16;
+        out[j++] = (accum >> 8) & 0xff;
+        out[j++] = accum & 0xff;
+    }
+
+    uint32_t accum = 0;
+    for (size_t i = lastGroup; i < n; ++i) {
+        int value = kDecodeTable[in[i]];
+        if (value < 0) {
+            if (in[i] != '=' || i < n - padding) {
                 return NULL;
             }
-
             value = 0;
         }
-
         accum = (accum << 6) | value;
-
-        if (((i + 1) % 4) == 0) {
-            out[j++] = (accum >> 16);
-
-            if (j < outLen) { out[j++] = (accum >> 8) & 0xff; }
-            if (j < outLen) { out[j++] = accum & 0xff; }
-
-            accum = 0;
-        }
     }
 
+    if (j < outLen) { out[j++] = (accum >> 16); }
+    if (j < outLen) { out[j++] = (accum >> 8) & 0xff; }
+    if (j < outLen) { out[j++] = accum & 0xff; }
+
     return buffer;
 }
 
@@ -39,6 +39,7 @@
 
 #include <ctype.h>
 #include <inttypes.h>
+#include <math.h>
 
 namespace android {
 
@@ -54,6 +55,8 @@ const int64_t LiveSession::kReadyMarkUs = 5000000ll;
 const int64_t LiveSession::kPrepareMarkUs = 1500000ll;
 const int64_t LiveSession::kUnderflowMarkUs = 1000000ll;
 
+const int64_t LiveSession::kDefaultTargetDurationUs = 10000000ll;
+
 struct LiveSession::BandwidthEstimator : public RefBase {
     BandwidthEstimator();
 
@@ -61,11 +64,13 @@ struct LiveSession::BandwidthEstimator : public RefBase {
     bool estimateBandwidth(
             int32_t *bandwidth,
             bool *isStable = NULL,
-            int32_t *shortTermBps = NULL);
+            int32_t *shortTermBps = NULL,
+            int32_t *harmonicMeanBps = NULL);
 
 private:
     // Bandwidth estimation parameters
     static const int32_t kShortTermBandwidthItems = 3;
+    static const size_t kHarmonicMeanItems = 5;
     static const int32_t kMinBandwidthHistoryItems = 20;
     static const int64_t kMinBandwidthHistoryWindowUs = 5000000ll; // 5 sec
     static const int64_t kMaxBandwidthHistoryWindowUs = 30000000ll; // 30 sec
@@ -80,7 +85,10 @@ private:
     Mutex mLock;
     List<BandwidthEntry> mBandwidthHistory;
     List<int32_t> mPrevEstimates;
+    // throughput of the most recent segment downloads
+    List<int32_t> mSegmentThroughputs;
     int32_t mShortTermEstimate;
+    int32_t mHarmonicMeanEstimate;
     bool mHasNewSample;
     bool mIsStable;
     int64_t mTotalTransferTimeUs;
@@ -91,6 +99,7 @@ private:
 
 LiveSession::BandwidthEstimator::BandwidthEstimator() :
     mShortTermEstimate(0),
+    mHarmonicMeanEstimate(0),
     mHasNewSample(false),
     mIsStable(true),
     mTotalTransferTimeUs(0),
@@ -111,6 +120,13 @@ void LiveSession::BandwidthEstimator::addBandwidthMeasurement(
     mBandwidthHistory.push_back(entry);
     mHasNewSample = true;
 
+    if (delayUs > 0) {
+        mSegmentThroughputs.push_back(numBytes * 8E6 / delayUs);
+        while (mSegmentThroughputs.size() > kHarmonicMeanItems) {
+            mSegmentThroughputs.erase(mSegmentThroughputs.begin());
+        }
+    }
+
     // Remove no more than 10% of total transfer time at a time
     // to avoid sudden jump on bandwidth estimation. There might
     // be long blocking reads that takes up signification time,
@@ -138,7 +154,8 @@ void LiveSession::BandwidthEstimator::addBandwidthMeasurement(
 }
 
 bool LiveSession::BandwidthEstimator::estimateBandwidth(
-        int32_t *bandwidthBps, bool *isStable, int32_t *shortTermBps) {
+        int32_t *bandwidthBps, bool *isStable,
+        int32_t *shortTermBps, int32_t *harmonicMeanBps) {
     AutoMutex autoLock(mLock);
 
     if (mBandwidthHistory.size() < 2) {
@@ -153,6 +170,9 @@ bool LiveSession::BandwidthEstimator::estimateBandwidth(
         if (shortTermBps) {
             *shortTermBps = mShortTermEstimate;
         }
+        if (harmonicMeanBps) {
+            *harmonicMeanBps = mHarmonicMeanEstimate;
+        }
         return true;
     }
 
@@ -178,6 +198,19 @@ bool LiveSession::BandwidthEstimator::estimateBandwidth(
         *shortTermBps = mShortTermEstimate;
     }
 
+    // Harmonic mean of per-segment throughput: dominated by the slow
+    // downloads, so a single fast segment doesn't trigger an up switch.
+    double inverseSum = 0;
+    for (List<int32_t>::iterator it = mSegmentThroughputs.begin();
+            it != mSegmentThroughputs.end(); ++it) {
+        inverseSum += (*it > 0) ? 1.0 / *it : 1.0;
+    }
+    mHarmonicMeanEstimate = inverseSum > 0 ?
+            (mSegmentThroughputs.size() / inverseSum) : *bandwidthBps;
+    if (harmonicMeanBps) {
+        *harmonicMeanBps = mHarmonicMeanEstimate;
+    }
+
     int32_t minEstimate = -1, maxEstimate = -1;
     List<int32_t>::iterator it;
     for (it = mPrevEstimates.begin(); it != mPrevEstimates.end(); it++) {
@@ -302,6 +335,13 @@ LiveSession::LiveSession(
       mUpSwitchMark(kUpSwitchMarkUs),
       mDownSwitchMark(kDownSwitchMarkUs),
       mUpSwitchMargin(kUpSwitchMarginUs),
+      mReadyMark(kReadyMarkUs),
+      mPrepareMark(kPrepareMarkUs),
+      mUnderflowMark(kUnderflowMarkUs),
+      mLiveLatencyUs(0ll),
+      mTargetDurationUs(kDefaultTargetDurationUs),
+      mBufferedDurationUs(-1ll),
+      mABRPolicy(kABRPolicyThroughput),
       mFirstTimeUsValid(false),
       mFirstTimeUs(0),
       mLastSeekTimeUs(0),
@@ -314,6 +354,58 @@ LiveSession::LiveSession(
         mPacketSources.add(indexToType(i), new AnotherPacketSource(NULL /* meta */));
         mPacketSources2.add(indexToType(i), new AnotherPacketSource(NULL /* meta */));
     }
+
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.httplive.abr", value, NULL)
+            && !strcasecmp(value, "buffer")) {
+        mABRPolicy = kABRPolicyBuffer;
+    }
+
+    initBufferMarks();
+}
+
+void LiveSession::initBufferMarks() {
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.httplive.live-latency-ms", value, NULL)) {
+        mLiveLatencyUs = max(0ll, atoll(value) * 1000ll);
+    }
+
+    if (mLiveLatencyUs > 0) {
+        // Not much more than the target latency can ever be buffered
+        // behind the live edge, so the marks have to fit into it.
+        mPrepareMark = min(kPrepareMarkUs, mLiveLatencyUs / 3);
+        mReadyMark = min(kReadyMarkUs, mLiveLatencyUs / 2);
+        mUnderflowMark = min(kUnderflowMarkUs, mLiveLatencyUs / 6);
+    }
+
+    if (property_get("media.httplive.prepare-ms", value, NULL)) {
+        mPrepareMark = atoll(value) * 1000ll;
+    }
+    if (property_get("media.httplive.ready-ms", value, NULL)) {
+        mReadyMark = atoll(value) * 1000ll;
+    }
+    if (property_get("media.httplive.underflow-ms", value, NULL)) {
+        mUnderflowMark = atoll(value) * 1000ll;
+    }
+
+    updateSwitchMarks(kDefaultTargetDurationUs);
+
+    ALOGI("buffer marks: prepare %lld, ready %lld, underflow %lld us, "
+            "live latency %lld us",
+            (long long)mPrepareMark, (long long)mReadyMark,
+            (long long)mUnderflowMark, (long long)mLiveLatencyUs);
+}
+
+void LiveSession::updateSwitchMarks(int64_t targetDurationUs) {
+    mUpSwitchMark = min(kUpSwitchMarkUs, targetDurationUs * 7 / 4);
+    mDownSwitchMark = min(kDownSwitchMarkUs, targetDurationUs * 9 / 4);
+    mUpSwitchMargin = min(kUpSwitchMarginUs, targetDurationUs);
+
+    if (mLiveLatencyUs > 0) {
+        mUpSwitchMark = min(mUpSwitchMark, mLiveLatencyUs / 2);
+        mDownSwitchMark = min(mDownSwitchMark, mLiveLatencyUs * 2 / 3);
+        mUpSwitchMargin = min(mUpSwitchMargin, mLiveLatencyUs / 4);
+    }
 }
 
 LiveSession::~LiveSession() {
@@ -495,6 +587,10 @@ sp<HTTPDownloader> LiveSession::getHTTPDownloader() {
     return new HTTPDownloader(mHTTPService, mExtraHeaders);
 }
 
+int64_t LiveSession::getLiveLatencyUs() const {
+    return mLiveLatencyUs;
+}
+
 void LiveSession::connectAsync(
         const char *url, const KeyedVector<String8, String8> *headers) {
     sp<AMessage> msg = new AMessage(kWhatConnect, this);
@@ -719,9 +815,8 @@ void LiveSession::onMessageReceived(const sp<AMessage> &msg) {
                 {
                     int64_t targetDurationUs;
                     CHECK(msg->findInt64("targetDurationUs", &targetDurationUs));
-                    mUpSwitchMark = min(kUpSwitchMarkUs, targetDurationUs * 7 / 4);
-                    mDownSwitchMark = min(kDownSwitchMarkUs, targetDurationUs * 9 / 4);
-                    mUpSwitchMargin = min(kUpSwitchMarginUs, targetDurationUs);
+                    updateSwitchMarks(targetDurationUs);
+                    mTargetDurationUs = targetDurationUs;
                     break;
                 }
 
@@ -826,10 +921,10 @@ void LiveSession::onMessageReceived(const sp<AMessage> &msg) {
                         }
                     }
                     bool switchUp = (mCurBandwidthIndex > mOrigBandwidthIndex);
-                    // If switching up, require a cushion bigger than kUnderflowMark
+                    // If switching up, require a cushion bigger than mUnderflowMark
                     // to avoid buffering immediately after the switch.
                     // (If we don't have that cushion we'd rather cancel and try again.)
-                    int64_t delayUs = switchUp ? (kUnderflowMarkUs + 1000000ll) : 0;
+                    int64_t delayUs = switchUp ? (mUnderflowMark + 1000000ll) : 0;
                     bool needResumeUntil = false;
                     sp<AMessage> stopParams = msg;
                     if (checkSwitchProgress(stopParams, delayUs, &needResumeUntil)) {
@@ -1315,6 +1410,71 @@ void LiveSession::addBandwidthMeasurement(size_t numBytes, int64_t delayUs) {
     mBandwidthEstimator->addBandwidthMeasurement(numBytes, delayUs);
 }
 
+size_t LiveSession::getBandwidthIndexForBuffer(
+        int64_t bufferedDurationUs, int32_t bandwidthBps) {
+    // BOLA: pick the variant maximizing (V * (utility + gp) - buffer) / bitrate,
+    // where utility = ln(bitrate / lowest bitrate) + 1. V and gp are chosen so
+    // that the lowest variant wins at one segment of buffer and the highest at
+    // the up switch mark.
+    size_t lowest = getLowestValidBandwidthIndex();
+    size_t highest = mBandwidthItems.size() - 1;
+    while (highest > lowest && !isBandwidthValid(mBandwidthItems[highest])) {
+        --highest;
+    }
+    if (highest == lowest) {
+        return lowest;
+    }
+
+    double minBufferS = mTargetDurationUs / 1E6;
+    double targetBufferS = mUpSwitchMark / 1E6;
+    if (targetBufferS < minBufferS * 2) {
+        targetBufferS = minBufferS * 2;
+    }
+    double lowestBps = mBandwidthItems[lowest].mBandwidth;
+    double maxUtility = log(mBandwidthItems[highest].mBandwidth / lowestBps) + 1;
+    double gp = (maxUtility - 1) / (targetBufferS / minBufferS - 1);
+    double vp = minBufferS / gp;
+    double bufferS = bufferedDurationUs / 1E6;
+
+    size_t index = lowest;
+    double bestScore = 0;
+    for (size_t i = lowest; i <= highest; ++i) {
+        const BandwidthItem &item = mBandwidthItems[i];
+        if (!isBandwidthValid(item)) {
+            continue;
+        }
+        double utility = log(item.mBandwidth / lowestBps) + 1;
+        double score = (vp * (utility + gp) - bufferS) / item.mBandwidth;
+        if (i == lowest || score >= bestScore) {
+            index = i;
+            bestScore = score;
+        }
+    }
+
+    // don't let a full buffer switch up to a variant the network can't sustain
+    size_t throughputIndex = getBandwidthIndex(bandwidthBps);
+    if (index > throughputIndex && (ssize_t)index > mCurBandwidthIndex) {
+        index = max(throughputIndex, (size_t)mCurBandwidthIndex);
+    }
+    return index;
+}
+
+/*
+ * An up switch abandons the segment being downloaded for the current
+ * variant and has to fetch a segment of the new variant before it adds
+ * to the buffer. Only switch if the buffer can cover both downloads.
+ */
+bool LiveSession::isSwitchUpAffordable(
+        ssize_t bandwidthIndex, int32_t bandwidthBps) const {
+    if (bandwidthBps <= 0 || mBufferedDurationUs < 0) {
+        return false;
+    }
+    int64_t switchBps = mBandwidthItems.itemAt(mCurBandwidthIndex).mBandwidth
+            + mBandwidthItems.itemAt(bandwidthIndex).mBandwidth;
+    int64_t costUs = mTargetDurationUs * switchBps / bandwidthBps;
+    return mBufferedDurationUs - costUs > mUnderflowMark;
+}
+
 ssize_t LiveSession::getLowestValidBandwidthIndex() const {
     for (size_t index = 0; index < mBandwidthItems.size(); index++) {
         if (isBandwidthValid(mBandwidthItems[index])) {
@@ -2148,6 +2308,7 @@ bool LiveSession::checkBuffering(
     size_t activeCount, underflowCount, readyCount, downCount, upCount;
     activeCount = underflowCount = readyCount = downCount = upCount =0;
     int32_t minBufferPercent = -1;
+    int64_t minBufferedDurationUs = -1ll;
     int64_t durationUs;
     if (getDuration(&durationUs) != OK) {
         durationUs = -1;
@@ -2185,13 +2346,16 @@ bool LiveSession::checkBuffering(
         }
 
         ++activeCount;
-        int64_t readyMark = mInPreparationPhase ? kPrepareMarkUs : kReadyMarkUs;
+        int64_t readyMark = mInPreparationPhase ? mPrepareMark : mReadyMark;
         if (bufferedDurationUs > readyMark
                 || mPacketSources[i]->isFinished(0)) {
             ++readyCount;
         }
         if (!mPacketSources[i]->isFinished(0)) {
-            if (bufferedDurationUs < kUnderflowMarkUs) {
+            if (minBufferedDurationUs < 0 || bufferedDurationUs < minBufferedDurationUs) {
+                minBufferedDurationUs = bufferedDurationUs;
+            }
+            if (bufferedDurationUs < mUnderflowMark) {
                 ++underflowCount;
             }
             if (bufferedDurationUs > mUpSwitchMark) {
@@ -2206,6 +2370,7 @@ bool LiveSession::checkBuffering(
     if (minBufferPercent >= 0) {
         notifyBufferingUpdate(minBufferPercent);
     }
+    mBufferedDurationUs = minBufferedDurationUs;
 
     if (activeCount > 0) {
         up        = (upCount == activeCount);
@@ -2302,13 +2467,19 @@ bool LiveSession::switchBandwidthIfNeeded(bool bufferHigh, bool bufferLow) {
         return false;
     }
 
-    int32_t bandwidthBps, shortTermBps;
+    int32_t bandwidthBps, shortTermBps, harmonicMeanBps;
     bool isStable;
     if (mBandwidthEstimator->estimateBandwidth(
-            &bandwidthBps, &isStable, &shortTermBps)) {
+            &bandwidthBps, &isStable, &shortTermBps, &harmonicMeanBps)) {
         ALOGV("bandwidth estimated at %.2f kbps, "
-                "stable %d, shortTermBps %.2f kbps",
-                bandwidthBps / 1024.0f, isStable, shortTermBps / 1024.0f);
+                "stable %d, shortTermBps %.2f kbps, harmonicMeanBps %.2f kbps",
+                bandwidthBps / 1024.0f, isStable, shortTermBps / 1024.0f,
+                harmonicMeanBps / 1024.0f);
+        // the windowed average reacts to bursts; don't trust it beyond
+        // what recent segments were actually delivered at.
+        if (harmonicMeanBps > 0 && harmonicMeanBps < bandwidthBps) {
+            bandwidthBps = harmonicMeanBps;
+        }
         mLastBandwidthBps = bandwidthBps;
         mLastBandwidthStable = isStable;
     } else {
@@ -2316,6 +2487,30 @@ bool LiveSession::switchBandwidthIfNeeded(bool bufferHigh, bool bufferLow) {
         return false;
     }
 
+    if (mABRPolicy == kABRPolicyBuffer && !mInPreparationPhase
+            && mBufferedDurationUs >= 0) {
+        if (!isStable && shortTermBps < bandwidthBps) {
+            bandwidthBps = shortTermBps;
+        }
+        ssize_t bandwidthIndex =
+                getBandwidthIndexForBuffer(mBufferedDurationUs, bandwidthBps);
+        bool switchUp = bandwidthIndex > mCurBandwidthIndex;
+        bool affordable = !switchUp
+                || isSwitchUpAffordable(bandwidthIndex, bandwidthBps);
+        ALOGV("abr(buffer): buffered %.2fs, bw %d bps, index %zd -> %zd%s",
+                mBufferedDurationUs / 1E6, bandwidthBps,
+                mCurBandwidthIndex, bandwidthIndex,
+                affordable ? "" : ", switch too costly");
+        if (bandwidthIndex != mCurBandwidthIndex && affordable) {
+            ALOGI("abr(buffer): switching %zd -> %zd, buffered %.2fs, bw %d bps",
+                    mCurBandwidthIndex, bandwidthIndex,
+                    mBufferedDurationUs / 1E6, bandwidthBps);
+            changeConfiguration(-1ll, bandwidthIndex);
+            return true;
+        }
+        return false;
+    }
+
     int32_t curBandwidth = mBandwidthItems.itemAt(mCurBandwidthIndex).mBandwidth;
     // canSwithDown and canSwitchUp can't both be true.
     // we only want to switch up when measured bw is 120% higher than current variant,
@@ -2342,8 +2537,19 @@ bool LiveSession::switchBandwidthIfNeeded(bool bufferHigh, bool bufferLow) {
         // bandwidthIndex is < mCurBandwidthIndex, as getBandwidthIndex() only uses 70%
         // of measured bw. In that case we don't want to do anything, since we have
         // both enough buffer and enough bw.
+        if (canSwitchUp && bandwidthIndex > mCurBandwidthIndex
+                && !isSwitchUpAffordable(bandwidthIndex, bandwidthBps)) {
+            ALOGV("abr(throughput): switch %zd -> %zd too costly, buffered %.2fs",
+                    mCurBandwidthIndex, bandwidthIndex, mBufferedDurationUs / 1E6);
+            return false;
+        }
+
         if ((canSwitchUp && bandwidthIndex > mCurBandwidthIndex)
          || (canSwitchDown && bandwidthIndex < mCurBandwidthIndex)) {
+            ALOGI("abr(throughput): switching %zd -> %zd, buffered %.2fs, "
+                    "bw %d bps, stable %d",
+                    mCurBandwidthIndex, bandwidthIndex,
+                    mBufferedDurationUs / 1E6, bandwidthBps, isStable);
             // if not yet prepared, just restart again with new bw index.
             // this is faster and playback experience is cleaner.
             changeConfiguration(
@@ -79,6 +79,10 @@ struct LiveSession : public AHandler {
 
     sp<HTTPDownloader> getHTTPDownloader();
 
+    // Target distance from the live edge in low-latency live mode
+    // (media.httplive.live-latency-ms), or 0 if the mode is off.
+    int64_t getLiveLatencyUs() const;
+
     void connectAsync(
             const char *url,
             const KeyedVector<String8, String8> *headers = NULL);
@@ -142,6 +146,17 @@ private:
     static const int64_t kPrepareMarkUs;
     static const int64_t kUnderflowMarkUs;
 
+    // Used until the playlist reports its target duration
+    static const int64_t kDefaultTargetDurationUs;
+
+    // How the variant is picked once a switch is considered
+    enum ABRPolicy {
+        // by measured throughput, when the buffer is above/below the switch marks
+        kABRPolicyThroughput,
+        // by buffer occupancy (BOLA), capped by measured throughput
+        kABRPolicyBuffer,
+    };
+
     struct BandwidthEstimator;
     struct BandwidthItem {
         size_t mPlaylistIndex;
@@ -239,6 +254,14 @@ private:
     int64_t mUpSwitchMark;
     int64_t mDownSwitchMark;
     int64_t mUpSwitchMargin;
+    int64_t mReadyMark;
+    int64_t mPrepareMark;
+    int64_t mUnderflowMark;
+    int64_t mLiveLatencyUs;
+    int64_t mTargetDurationUs;
+    // lowest audio/video buffered duration seen by the last checkBuffering()
+    int64_t mBufferedDurationUs;
+    ABRPolicy mABRPolicy;
 
     sp<AReplyToken> mDisconnectReplyID;
     sp<AReplyToken> mSeekReplyID;
@@ -253,6 +276,9 @@ private:
 
     sp<PlaylistFetcher> addFetcher(const char *uri);
 
+    void initBufferMarks();
+    void updateSwitchMarks(int64_t targetDurationUs);
+
     void onConnect(const sp<AMessage> &msg);
     void onMasterPlaylistFetched(const sp<AMessage> &msg);
     void onSeek(const sp<AMessage> &msg);
@@ -270,6 +296,8 @@ private:
             ssize_t currentBWIndex, ssize_t targetBWIndex) const;
     void addBandwidthMeasurement(size_t numBytes, int64_t delayUs);
     size_t getBandwidthIndex(int32_t bandwidthBps);
+    size_t getBandwidthIndexForBuffer(int64_t bufferedDurationUs, int32_t bandwidthBps);
+    bool isSwitchUpAffordable(ssize_t bandwidthIndex, int32_t bandwidthBps) const;
     ssize_t getLowestValidBandwidthIndex() const;
     HLSTime latestMediaSegmentStartTime() const;
 
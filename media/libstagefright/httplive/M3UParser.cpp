@@ -243,7 +243,8 @@ bool M3UParser::MediaGroup::getActiveURI(AString *uri) const {
 ////////////////////////////////////////////////////////////////////////////////
 
 M3UParser::M3UParser(
-        const char *baseURI, const void *data, size_t size)
+        const char *baseURI, const void *data, size_t size,
+        const sp<M3UParser> &previous)
     : mInitCheck(NO_INIT),
       mBaseURI(baseURI),
       mIsExtM3U(false),
@@ -256,7 +257,12 @@ M3UParser::M3UParser(
       mDiscontinuitySeq(0),
       mDiscontinuityCount(0),
       mSelectedIndex(-1) {
-    mInitCheck = parse(data, size);
+    if (previous != NULL && (previous->mIsVariantPlaylist
+            || previous->initCheck() != OK || previous->mBaseURI != mBaseURI)) {
+        mInitCheck = parse(data, size, NULL);
+    } else {
+        mInitCheck = parse(data, size, previous);
+    }
 }
 
 M3UParser::~M3UParser() {
@@ -544,7 +550,8 @@ static bool MakeURL(const char *baseURL, const char *url, AString *out) {
     return true;
 }
 
-status_t M3UParser::parse(const void *_data, size_t size) {
+status_t M3UParser::parse(
+        const void *_data, size_t size, const sp<M3UParser> &previous) {
     int32_t lineNo = 0;
 
     sp<AMessage> itemMeta;
@@ -576,6 +583,16 @@ status_t M3UParser::parse(const void *_data, size_t size) {
             mIsExtM3U = true;
         }
 
+        if (previous != NULL && mIsExtM3U && !mIsVariantPlaylist
+                && itemMeta == NULL && IsItemStart(line)) {
+            size_t next = offset;
+            if (reuseItem(*previous, data, size, &next, &segmentRangeOffset)) {
+                offset = next;
+                ++lineNo;
+                continue;
+            }
+        }
+
         if (mIsExtM3U) {
             status_t err = OK;
 
@@ -701,6 +718,114 @@ status_t M3UParser::parse(const void *_data, size_t size) {
     return OK;
 }
 
+// static
+bool M3UParser::IsItemStart(const AString &line) {
+    if (!line.startsWith("#")) {
+        return true;
+    }
+    return line.startsWith("#EXTINF")
+            || line.startsWith("#EXT-X-KEY")
+            || line.startsWith("#EXT-X-BYTERANGE")
+            || (line.startsWith("#EXT-X-DISCONTINUITY")
+                    && !line.startsWith("#EXT-X-DISCONTINUITY-SEQUENCE"));
+}
+
+static bool LineStartsWith(const char *line, size_t len, const char *prefix) {
+    size_t prefixLen = strlen(prefix);
+    return len >= prefixLen && !strncmp(line, prefix, prefixLen);
+}
+
+/*
+ * Scans the lines of the item starting at |offset| up to and including its
+ * URI. If |previous| has an item with the same media sequence number and
+ * URI, shares that item instead of parsing the tags again, and advances
+ * |offset| past the URI line.
+ */
+bool M3UParser::reuseItem(
+        const M3UParser &previous, const char *data, size_t size,
+        size_t *offset, uint64_t *segmentRangeOffset) {
+    int32_t firstSeqNumber = 0;
+    if (mMeta != NULL) {
+        mMeta->findInt32("media-sequence", &firstSeqNumber);
+    }
+    int32_t seqNumber = firstSeqNumber + (int32_t)mItems.size();
+    if (seqNumber < previous.mFirstSeqNumber || seqNumber > previous.mLastSeqNumber) {
+        return false;
+    }
+    const Item &prevItem = previous.mItems[seqNumber - previous.mFirstSeqNumber];
+
+    int32_t numDiscontinuities = 0;
+    bool hasKey = false;
+    bool hasByteRange = false;
+    size_t pos = *offset;
+    while (pos < size) {
+        size_t lineEnd = pos;
+        while (lineEnd < size && data[lineEnd] != '\n') {
+            ++lineEnd;
+        }
+        const char *line = &data[pos];
+        size_t len = lineEnd - pos;
+        if (len > 0 && line[len - 1] == '\r') {
+            --len;
+        }
+        pos = lineEnd + 1;
+
+        if (len == 0) {
+            continue;
+        }
+
+        if (line[0] != '#') {
+            const AString &uri = prevItem.mURI;
+            if (uri.size() < len
+                    || memcmp(uri.c_str() + uri.size() - len, line, len)) {
+                return false;
+            }
+
+            // the tags must have been attached to the same item before
+            int32_t discontinuitySeq;
+            if (prevItem.mMeta == NULL
+                    || (numDiscontinuities > 0) != prevItem.mMeta->contains("discontinuity")
+                    || hasKey != prevItem.mMeta->contains("cipher-method")
+                    || hasByteRange != prevItem.mMeta->contains("range-offset")
+                    || !prevItem.mMeta->findInt32(
+                            "discontinuity-sequence", &discontinuitySeq)
+                    || discontinuitySeq != (int32_t)(mDiscontinuitySeq
+                            + mDiscontinuityCount + numDiscontinuities)) {
+                return false;
+            }
+
+            int64_t rangeOffset, rangeLength;
+            if (prevItem.mMeta->findInt64("range-offset", &rangeOffset)
+                    && prevItem.mMeta->findInt64("range-length", &rangeLength)) {
+                *segmentRangeOffset = rangeOffset + rangeLength;
+            }
+
+            mDiscontinuityCount += numDiscontinuities;
+            mItems.push(prevItem);
+            *offset = pos;
+            return true;
+        }
+
+        if (LineStartsWith(line, len, "#EXT-X-DISCONTINUITY-SEQUENCE")) {
+            return false;
+        } else if (LineStartsWith(line, len, "#EXT-X-DISCONTINUITY")) {
+            ++numDiscontinuities;
+        } else if (LineStartsWith(line, len, "#EXT-X-KEY")) {
+            hasKey = true;
+        } else if (LineStartsWith(line, len, "#EXT-X-BYTERANGE")) {
+            hasByteRange = true;
+        } else if (LineStartsWith(line, len, "#EXT-X-")
+                && !LineStartsWith(line, len, "#EXT-X-PROGRAM-DATE-TIME")) {
+            // anything else may change playlist state, parse it properly
+            return false;
+        }
+        // #EXTINF, #EXT-X-KEY and #EXT-X-BYTERANGE are already reflected
+        // in the previous item's meta.
+    }
+
+    return false;
+}
+
 // static
 status_t M3UParser::parseMetaData(
         const AString &line, sp<AMessage> *meta, const char *key) {
@@ -27,7 +27,11 @@
 namespace android {
 
 struct M3UParser : public RefBase {
-    M3UParser(const char *baseURI, const void *data, size_t size);
+    // Items that |previous| (an earlier version of the same live playlist)
+    // already has under the same media sequence number are shared with it
+    // instead of being parsed again.
+    M3UParser(const char *baseURI, const void *data, size_t size,
+            const sp<M3UParser> &previous = NULL);
 
     status_t initCheck() const;
 
@@ -86,7 +90,12 @@ private:
     // Media groups keyed by group ID.
     KeyedVector<AString, sp<MediaGroup> > mMediaGroups;
 
-    status_t parse(const void *data, size_t size);
+    status_t parse(const void *data, size_t size, const sp<M3UParser> &previous);
+
+    bool reuseItem(
+            const M3UParser &previous, const char *data, size_t size,
+            size_t *offset, uint64_t *segmentRangeOffset);
+    static bool IsItemStart(const AString &line);
 
     static status_t parseMetaData(
             const AString &line, sp<AMessage> *meta, const char *key);
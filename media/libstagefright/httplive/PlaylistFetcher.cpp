@@ -23,10 +23,12 @@
 #include "HTTPDownloader.h"
 #include "LiveSession.h"
 #include "M3UParser.h"
+#include "SegmentPrefetcher.h"
 #include "include/avc_utils.h"
 #include "include/ID3.h"
 #include "mpeg2ts/AnotherPacketSource.h"
 
+#include <cutils/properties.h>
 #include <media/stagefright/foundation/ABitReader.h>
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
@@ -50,6 +52,15 @@ const int64_t PlaylistFetcher::kMaxMonitorDelayUs = 3000000ll;
 // LCM of 188 (size of a TS packet) & 1k works well
 const int32_t PlaylistFetcher::kDownloadBlockSize = 47 * 1024;
 
+// limits for media.httplive.prefetch-segments / media.httplive.prefetch-parts
+static const int32_t kMaxPrefetchSegments = 4;
+static const int32_t kMaxPrefetchParts = 4;
+
+// In low-latency live mode the segment being downloaded is usually still
+// being produced, read it in small blocks so that its access units are
+// queued as soon as they arrive.
+static const int32_t kLowLatencyBlockSize = 32 * 188;
+
 struct PlaylistFetcher::DownloadState : public RefBase {
     DownloadState();
     void resetState();
@@ -169,9 +180,44 @@ PlaylistFetcher::PlaylistFetcher(
       mVideoBuffer(new AnotherPacketSource(NULL)),
       mThresholdRatio(-1.0f),
       mDownloadState(new DownloadState()),
-      mHasMetadata(false) {
+      mNumPrefetchSegments(0),
+      mSegmentPrefetched(false),
+      mHasMetadata(false),
+      mDownloadBlockSize(kDownloadBlockSize) {
     memset(mPlaylistHash, 0, sizeof(mPlaylistHash));
     mHTTPDownloader = mSession->getHTTPDownloader();
+
+    if (mSession->getLiveLatencyUs() > 0) {
+        mDownloadBlockSize = kLowLatencyBlockSize;
+    }
+
+    char value[PROPERTY_VALUE_MAX];
+    // prefetched segments are only handed over once complete, which
+    // would defeat low-latency live mode
+    if (mSession->getLiveLatencyUs() == 0
+            && property_get("media.httplive.prefetch-segments", value, NULL)) {
+        mNumPrefetchSegments = atoi(value);
+        if (mNumPrefetchSegments > kMaxPrefetchSegments) {
+            mNumPrefetchSegments = kMaxPrefetchSegments;
+        }
+    }
+    if (mNumPrefetchSegments > 0) {
+        int32_t numParts = 1;
+        if (property_get("media.httplive.prefetch-parts", value, NULL)) {
+            numParts = atoi(value);
+            if (numParts < 1) {
+                numParts = 1;
+            } else if (numParts > kMaxPrefetchParts) {
+                numParts = kMaxPrefetchParts;
+            }
+        }
+        // one connection per segment in flight, or per part of the current one
+        int32_t numWorkers = mNumPrefetchSegments + 1;
+        if (numWorkers < numParts) {
+            numWorkers = numParts;
+        }
+        mPrefetcher = new SegmentPrefetcher(mSession, numWorkers, numParts);
+    }
 }
 
 PlaylistFetcher::~PlaylistFetcher() {
@@ -449,6 +495,9 @@ void PlaylistFetcher::setStoppingThreshold(float thresholdRatio, bool disconnect
     }
     if (disconnect) {
         mHTTPDownloader->disconnect();
+        if (mPrefetcher != NULL) {
+            mPrefetcher->disconnect();
+        }
     }
 }
 
@@ -459,9 +508,15 @@ void PlaylistFetcher::resetStoppingThreshold(bool disconnect) {
     }
     if (disconnect) {
         mHTTPDownloader->disconnect();
+        if (mPrefetcher != NULL) {
+            mPrefetcher->disconnect();
+        }
     } else {
         // allow reconnect
         mHTTPDownloader->reconnect();
+        if (mPrefetcher != NULL) {
+            mPrefetcher->reconnect();
+        }
     }
 }
 
@@ -733,6 +788,10 @@ void PlaylistFetcher::onStop(const sp<AMessage> &msg) {
     mPacketSources.clear();
     mStreamTypeMask = 0;
 
+    if (mPrefetcher != NULL) {
+        mPrefetcher->flush();
+    }
+
     resetStoppingThreshold(true /* disconnect */);
 }
 
@@ -786,6 +845,16 @@ void PlaylistFetcher::onMonitorQueue() {
 
     int64_t bufferedDurationUs = 0ll;
     status_t finalResult = OK;
+    bool full = false;
+    for (size_t i = 0; i < mPacketSources.size(); ++i) {
+        if ((mStreamTypeMask & mPacketSources.keyAt(i))
+                && mPacketSources.valueAt(i)->isFull()) {
+            FSLOGV(mPacketSources.keyAt(i), "full, %zu bytes buffered",
+                    mPacketSources.valueAt(i)->getBufferedBytes());
+            full = true;
+        }
+    }
+
     if (mStreamTypeMask == LiveSession::STREAMTYPE_SUBTITLES) {
         sp<AnotherPacketSource> packetSource =
             mPacketSources.valueFor(LiveSession::STREAMTYPE_SUBTITLES);
@@ -819,7 +888,7 @@ void PlaylistFetcher::onMonitorQueue() {
         }
     }
 
-    if (finalResult == OK && bufferedDurationUs < kMinBufferedDurationUs) {
+    if (finalResult == OK && bufferedDurationUs < kMinBufferedDurationUs && !full) {
         FLOGV("monitoring, buffered=%lld < %lld",
                 (long long)bufferedDurationUs, (long long)kMinBufferedDurationUs);
 
@@ -833,7 +902,12 @@ void PlaylistFetcher::onMonitorQueue() {
         // We'd like to maintain buffering above durationToBufferUs, so try
         // again when buffer just about to go below durationToBufferUs
         // (or after targetDurationUs / 2, whichever is smaller).
+        // A full source may be short of durationToBufferUs, give it at
+        // least a second to drain.
         int64_t delayUs = bufferedDurationUs - kMinBufferedDurationUs + 1000000ll;
+        if (full && delayUs < 1000000ll) {
+            delayUs = 1000000ll;
+        }
         if (delayUs > targetDurationUs / 2) {
             delayUs = targetDurationUs / 2;
         }
@@ -851,7 +925,7 @@ status_t PlaylistFetcher::refreshPlaylist() {
     if (delayUsToRefreshPlaylist() <= 0) {
         bool unchanged;
         sp<M3UParser> playlist = mHTTPDownloader->fetchPlaylist(
-                mURI.c_str(), mPlaylistHash, &unchanged);
+                mURI.c_str(), mPlaylistHash, &unchanged, mPlaylist);
 
         if (playlist == NULL) {
             if (unchanged) {
@@ -974,11 +1048,7 @@ bool PlaylistFetcher::initDownloadState(
 
         if (mSegmentStartTimeUs < 0) {
             if (!mPlaylist->isComplete() && !mPlaylist->isEvent()) {
-                // If this is a live session, start 3 segments from the end on connect
-                mSeqNumber = lastSeqNumberInPlaylist - 3;
-                if (mSeqNumber < firstSeqNumberInPlaylist) {
-                    mSeqNumber = firstSeqNumberInPlaylist;
-                }
+                mSeqNumber = getLiveStartSeqNumber();
             } else {
                 // When seeking mSegmentStartTimeUs is unavailable (< 0), we
                 // use mStartTimeUs (client supplied timestamp) to determine both start segment
@@ -1060,8 +1130,8 @@ bool PlaylistFetcher::initDownloadState(
                 return false;
             }
 
-            // we've missed the boat, let's start 3 segments prior to the latest sequence
-            // number available and signal a discontinuity.
+            // we've missed the boat, let's restart from the live edge and signal
+            // a discontinuity.
 
             ALOGI("We've missed the boat, restarting playback."
                   "  mStartup=%d, was  looking for %d in %d-%d",
@@ -1075,10 +1145,7 @@ bool PlaylistFetcher::initDownloadState(
                 notifyStopReached();
                 return false;
             }
-            mSeqNumber = lastSeqNumberInPlaylist - 3;
-            if (mSeqNumber < firstSeqNumberInPlaylist) {
-                mSeqNumber = firstSeqNumberInPlaylist;
-            }
+            mSeqNumber = getLiveStartSeqNumber();
             discontinuity = true;
 
             // fall through
@@ -1205,6 +1272,31 @@ bool PlaylistFetcher::initDownloadState(
     return true;
 }
 
+ssize_t PlaylistFetcher::fetchPrefetchedSegment(
+        int32_t firstSeqNumberInPlaylist,
+        int32_t lastSeqNumberInPlaylist,
+        sp<ABuffer> *out) {
+    Vector<SegmentPrefetcher::SegmentInfo> segments;
+    for (int32_t seqNumber = mSeqNumber;
+            seqNumber <= lastSeqNumberInPlaylist
+                && seqNumber <= mSeqNumber + mNumPrefetchSegments;
+            ++seqNumber) {
+        SegmentPrefetcher::SegmentInfo info;
+        sp<AMessage> itemMeta;
+        CHECK(mPlaylist->itemAt(
+                seqNumber - firstSeqNumberInPlaylist, &info.mURI, &itemMeta));
+        if (!itemMeta->findInt64("range-offset", &info.mRangeOffset)
+                || !itemMeta->findInt64("range-length", &info.mRangeLength)) {
+            info.mRangeOffset = 0;
+            info.mRangeLength = -1;
+        }
+        segments.push(info);
+    }
+
+    mPrefetcher->setSegments(segments);
+    return mPrefetcher->takeSegment(segments[0], out);
+}
+
 void PlaylistFetcher::onDownloadNext() {
     AString uri;
     sp<AMessage> itemMeta;
@@ -1233,6 +1325,7 @@ void PlaylistFetcher::onDownloadNext() {
             return;
         }
         FLOGV("fetching: '%s'", uri.c_str());
+        mSegmentPrefetched = (mPrefetcher != NULL);
     }
 
     int64_t range_offset, range_length;
@@ -1247,11 +1340,26 @@ void PlaylistFetcher::onDownloadNext() {
     ssize_t bytesRead;
     do {
         int64_t startUs = ALooper::GetNowUs();
-        bytesRead = mHTTPDownloader->fetchBlock(
-                uri.c_str(), &buffer, range_offset, range_length, kDownloadBlockSize,
-                NULL /* actualURL */, connectHTTP);
+        if (!mSegmentPrefetched) {
+            bytesRead = mHTTPDownloader->fetchBlock(
+                    uri.c_str(), &buffer, range_offset, range_length, mDownloadBlockSize,
+                    NULL /* actualURL */, connectHTTP);
+        } else if (buffer == NULL) {
+            // the whole segment is handed over as a single block
+            bytesRead = fetchPrefetchedSegment(
+                    firstSeqNumberInPlaylist, lastSeqNumberInPlaylist, &buffer);
+        } else {
+            bytesRead = 0;
+        }
         int64_t delayUs = ALooper::GetNowUs() - startUs;
 
+        // prefetching downloads several segments at once, measure all of them
+        size_t numBytes = bytesRead > 0 ? bytesRead : 0;
+        if (mSegmentPrefetched
+                && !mPrefetcher->takeBandwidthSample(&numBytes, &delayUs)) {
+            numBytes = 0;
+        }
+
         if (bytesRead == ERROR_NOT_CONNECTED) {
             return;
         }
@@ -1265,14 +1373,14 @@ void PlaylistFetcher::onDownloadNext() {
         // add sample for bandwidth estimation, excluding samples from subtitles (as
         // its too small), or during startup/resumeUntil (when we could have more than
         // one connection open which affects bandwidth)
-        if (!mStartup && mStopParams == NULL && bytesRead > 0
+        if (!mStartup && mStopParams == NULL && numBytes > 0
                 && (mStreamTypeMask
                         & (LiveSession::STREAMTYPE_AUDIO
                         | LiveSession::STREAMTYPE_VIDEO))) {
-            mSession->addBandwidthMeasurement(bytesRead, delayUs);
+            mSession->addBandwidthMeasurement(numBytes, delayUs);
             if (delayUs > 2000000ll) {
-                FLOGV("bytesRead %zd took %.2f seconds - abnormal bandwidth dip",
-                        bytesRead, (double)delayUs / 1.0e6);
+                FLOGV("bytesRead %zu took %.2f seconds - abnormal bandwidth dip",
+                        numBytes, (double)delayUs / 1.0e6);
             }
         }
 
@@ -1520,6 +1628,48 @@ int32_t PlaylistFetcher::getSeqNumberForDiscontinuity(size_t discontinuitySeq) c
     return firstSeqNumberInPlaylist + mPlaylist->size();
 }
 
+/*
+ * returns the segment a live session should start from: 3 segments from
+ * the end, or in low-latency mode the last segment that starts at least
+ * the target latency before the live edge.
+ */
+int32_t PlaylistFetcher::getLiveStartSeqNumber() const {
+    int32_t firstSeqNumberInPlaylist, lastSeqNumberInPlaylist;
+    mPlaylist->getSeqNumberRange(
+            &firstSeqNumberInPlaylist, &lastSeqNumberInPlaylist);
+
+    int64_t latencyUs = mSession->getLiveLatencyUs();
+    if (latencyUs <= 0) {
+        int32_t seqNumber = lastSeqNumberInPlaylist - 3;
+        if (seqNumber < firstSeqNumberInPlaylist) {
+            seqNumber = firstSeqNumberInPlaylist;
+        }
+        return seqNumber;
+    }
+
+    int32_t seqNumber = lastSeqNumberInPlaylist;
+    int64_t durationUs = 0;
+    while (seqNumber > firstSeqNumberInPlaylist) {
+        sp<AMessage> itemMeta;
+        CHECK(mPlaylist->itemAt(
+                    seqNumber - firstSeqNumberInPlaylist, NULL /* uri */, &itemMeta));
+
+        int64_t itemDurationUs;
+        CHECK(itemMeta->findInt64("durationUs", &itemDurationUs));
+
+        durationUs += itemDurationUs;
+        if (durationUs >= latencyUs) {
+            break;
+        }
+        --seqNumber;
+    }
+
+    FLOGV("live start %d from (%d .. %d), %lld us behind the edge",
+            seqNumber, firstSeqNumberInPlaylist, lastSeqNumberInPlaylist,
+            (long long)durationUs);
+    return seqNumber;
+}
+
 int32_t PlaylistFetcher::getSeqNumberForTime(int64_t timeUs) const {
     size_t index = 0;
     int64_t segmentStartUs = 0;
@@ -1613,15 +1763,10 @@ status_t PlaylistFetcher::extractAndQueueAccessUnitsFromTs(const sp<ABuffer> &bu
         mNextPTSTimeUs = -1ll;
     }
 
-    size_t offset = 0;
-    while (offset + 188 <= buffer->size()) {
-        status_t err = mTSParser->feedTSPacket(buffer->data() + offset, 188);
-
-        if (err != OK) {
-            return err;
-        }
-
-        offset += 188;
+    size_t offset = buffer->size() / 188 * 188;
+    status_t err = mTSParser->feedTSPackets(buffer->data(), offset / 188);
+    if (err != OK) {
+        return err;
     }
     // setRange to indicate consumed bytes.
     buffer->setRange(buffer->offset() + offset, buffer->size() - offset);
@@ -1682,7 +1827,6 @@ status_t PlaylistFetcher::extractAndQueueAccessUnitsFromTs(const sp<ABuffer> &bu
         }
     }
 
-    status_t err = OK;
     for (size_t i = mPacketSources.size(); i-- > 0;) {
         sp<AnotherPacketSource> packetSource = mPacketSources.valueAt(i);
 
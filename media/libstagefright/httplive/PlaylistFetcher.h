@@ -31,6 +31,7 @@ class DataSource;
 struct HTTPBase;
 struct LiveDataSource;
 struct M3UParser;
+struct SegmentPrefetcher;
 class String8;
 
 struct PlaylistFetcher : public AHandler {
@@ -182,8 +183,17 @@ private:
 
     sp<DownloadState> mDownloadState;
 
+    // Downloads the next segments in parallel when
+    // media.httplive.prefetch-segments is set, NULL otherwise.
+    sp<SegmentPrefetcher> mPrefetcher;
+    int32_t mNumPrefetchSegments;
+    bool mSegmentPrefetched;
+
     bool mHasMetadata;
 
+    // kDownloadBlockSize, or smaller in low-latency live mode
+    int32_t mDownloadBlockSize;
+
     // Set first to true if decrypting the first segment of a playlist segment. When
     // first is true, reset the initialization vector based on the available
     // information in the manifest; otherwise, use the initialization vector as
@@ -224,6 +234,13 @@ private:
             int32_t &firstSeqNumberInPlaylist,
             int32_t &lastSeqNumberInPlaylist);
 
+    // Queues the current and the next mNumPrefetchSegments segments with
+    // mPrefetcher and waits for the current one to finish downloading.
+    ssize_t fetchPrefetchedSegment(
+            int32_t firstSeqNumberInPlaylist,
+            int32_t lastSeqNumberInPlaylist,
+            sp<ABuffer> *out);
+
     // Resume a fetcher to continue until the stopping point stored in msg.
     status_t onResumeUntil(const sp<AMessage> &msg);
 
@@ -246,6 +263,7 @@ private:
     bool adjustSeqNumberWithAnchorTime(int64_t anchorTimeUs);
     int32_t getSeqNumberForDiscontinuity(size_t discontinuitySeq) const;
     int32_t getSeqNumberForTime(int64_t timeUs) const;
+    int32_t getLiveStartSeqNumber() const;
 
     void updateDuration();
     void updateTargetDuration();
@@ -0,0 +1,380 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SegmentPrefetcher"
+#include <utils/Log.h>
+
+#include "SegmentPrefetcher.h"
+#include "HTTPDownloader.h"
+#include "LiveSession.h"
+#include "PlaylistFetcher.h"
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/MediaErrors.h>
+#include <utils/Thread.h>
+
+namespace android {
+
+struct SegmentPrefetcher::Segment : public RefBase {
+    Segment() : mPendingParts(0), mError(OK), mDropped(false) {}
+
+    SegmentInfo mInfo;
+    Vector<sp<ABuffer> > mParts;
+    size_t mPendingParts;
+    status_t mError;
+    bool mDropped;
+};
+
+struct SegmentPrefetcher::Worker : public Thread {
+    Worker(SegmentPrefetcher *owner, const sp<HTTPDownloader> &downloader)
+        : Thread(false /* canCallJava */),
+          mOwner(owner),
+          mDownloader(downloader) {
+    }
+
+    const sp<HTTPDownloader> &downloader() const {
+        return mDownloader;
+    }
+
+private:
+    SegmentPrefetcher *mOwner;
+    sp<HTTPDownloader> mDownloader;
+
+    virtual bool threadLoop() {
+        return mOwner->runJob(mDownloader);
+    }
+
+    DISALLOW_EVIL_CONSTRUCTORS(Worker);
+};
+
+static bool isSameSegment(
+        const SegmentPrefetcher::SegmentInfo &a,
+        const SegmentPrefetcher::SegmentInfo &b) {
+    return a.mURI == b.mURI
+            && a.mRangeOffset == b.mRangeOffset
+            && a.mRangeLength == b.mRangeLength;
+}
+
+SegmentPrefetcher::SegmentPrefetcher(
+        const sp<LiveSession> &session,
+        size_t numWorkers,
+        size_t numParts)
+    : mSession(session),
+      mNumWorkers(numWorkers),
+      mNumParts(numParts),
+      mDisconnecting(false),
+      mStopping(false),
+      mNumActiveWorkers(0),
+      mActiveSinceUs(0),
+      mActiveTimeUs(0),
+      mBytesDownloaded(0) {
+    CHECK_GT(mNumWorkers, 0u);
+    CHECK_GT(mNumParts, 0u);
+}
+
+SegmentPrefetcher::~SegmentPrefetcher() {
+    {
+        Mutex::Autolock autoLock(mLock);
+        mStopping = true;
+        for (size_t i = 0; i < mWorkers.size(); ++i) {
+            mWorkers[i]->downloader()->disconnect();
+        }
+        mCondition.broadcast();
+    }
+
+    for (size_t i = 0; i < mWorkers.size(); ++i) {
+        mWorkers[i]->requestExitAndWait();
+    }
+}
+
+void SegmentPrefetcher::setSegments(const Vector<SegmentInfo> &segments) {
+    Mutex::Autolock autoLock(mLock);
+
+    size_t i = 0;
+    while (i < mSegments.size()) {
+        bool found = false;
+        for (size_t j = 0; j < segments.size(); ++j) {
+            if (isSameSegment(mSegments[i]->mInfo, segments[j])) {
+                found = true;
+                break;
+            }
+        }
+        if (found && mSegments[i]->mError == OK) {
+            ++i;
+        } else {
+            dropSegment_l(i);
+        }
+    }
+
+    for (size_t j = 0; j < segments.size(); ++j) {
+        if (findSegment_l(segments[j]) < 0) {
+            queueSegment_l(segments[j]);
+        }
+    }
+}
+
+ssize_t SegmentPrefetcher::takeSegment(
+        const SegmentInfo &segment, sp<ABuffer> *out) {
+    Mutex::Autolock autoLock(mLock);
+
+    ssize_t index = findSegment_l(segment);
+    if (index < 0) {
+        return NAME_NOT_FOUND;
+    }
+
+    sp<Segment> s = mSegments[index];
+    while (s->mPendingParts > 0 && !s->mDropped && !mDisconnecting) {
+        mCondition.wait(mLock);
+    }
+
+    // a reconnect may have dropped the segment while we were waiting
+    if (mDisconnecting || s->mDropped) {
+        return ERROR_NOT_CONNECTED;
+    }
+
+    index = findSegment_l(segment);
+    CHECK_GE(index, 0);
+    dropSegment_l(index);
+
+    if (s->mError != OK) {
+        return s->mError;
+    }
+
+    sp<ABuffer> buffer;
+    if (s->mParts.size() == 1) {
+        buffer = s->mParts[0];
+    } else {
+        size_t size = 0;
+        for (size_t i = 0; i < s->mParts.size(); ++i) {
+            size += s->mParts[i]->size();
+        }
+        buffer = new ABuffer(size);
+        buffer->setRange(0, 0);
+        for (size_t i = 0; i < s->mParts.size(); ++i) {
+            const sp<ABuffer> &part = s->mParts[i];
+            memcpy(buffer->data() + buffer->size(), part->data(), part->size());
+            buffer->setRange(0, buffer->size() + part->size());
+        }
+    }
+
+    *out = buffer;
+    return buffer->size();
+}
+
+bool SegmentPrefetcher::takeBandwidthSample(size_t *numBytes, int64_t *delayUs) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (mNumActiveWorkers > 0) {
+        int64_t nowUs = ALooper::GetNowUs();
+        mActiveTimeUs += nowUs - mActiveSinceUs;
+        mActiveSinceUs = nowUs;
+    }
+
+    *numBytes = mBytesDownloaded;
+    *delayUs = mActiveTimeUs;
+    mBytesDownloaded = 0;
+    mActiveTimeUs = 0;
+
+    return *numBytes > 0 && *delayUs > 0;
+}
+
+void SegmentPrefetcher::disconnect() {
+    Mutex::Autolock autoLock(mLock);
+    mDisconnecting = true;
+    for (size_t i = 0; i < mWorkers.size(); ++i) {
+        mWorkers[i]->downloader()->disconnect();
+    }
+    mCondition.broadcast();
+}
+
+void SegmentPrefetcher::reconnect() {
+    Mutex::Autolock autoLock(mLock);
+    mDisconnecting = false;
+    for (size_t i = 0; i < mWorkers.size(); ++i) {
+        mWorkers[i]->downloader()->reconnect();
+    }
+
+    // downloads interrupted by the disconnect have to start over
+    size_t i = 0;
+    while (i < mSegments.size()) {
+        if (mSegments[i]->mError != OK) {
+            dropSegment_l(i);
+        } else {
+            ++i;
+        }
+    }
+    mCondition.broadcast();
+}
+
+void SegmentPrefetcher::flush() {
+    Mutex::Autolock autoLock(mLock);
+    while (!mSegments.isEmpty()) {
+        dropSegment_l(mSegments.size() - 1);
+    }
+}
+
+ssize_t SegmentPrefetcher::findSegment_l(const SegmentInfo &segment) const {
+    for (size_t i = 0; i < mSegments.size(); ++i) {
+        if (isSameSegment(mSegments[i]->mInfo, segment)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void SegmentPrefetcher::queueSegment_l(const SegmentInfo &segment) {
+    sp<Segment> s = new Segment();
+    s->mInfo = segment;
+
+    // Split segments of known length into up to mNumParts sub-ranges,
+    // each a multiple of the fetcher's download block size.
+    size_t numParts = 1;
+    int64_t partLength = segment.mRangeLength;
+    if (mNumParts > 1 && segment.mRangeLength > 0) {
+        const int64_t blockSize = PlaylistFetcher::kDownloadBlockSize;
+        partLength = (segment.mRangeLength + mNumParts - 1) / mNumParts;
+        partLength = (partLength + blockSize - 1) / blockSize * blockSize;
+        numParts = (segment.mRangeLength + partLength - 1) / partLength;
+    }
+
+    s->mParts.insertAt(sp<ABuffer>(), 0, numParts);
+    s->mPendingParts = numParts;
+
+    for (size_t i = 0; i < numParts; ++i) {
+        Job job;
+        job.mSegment = s;
+        job.mPartIndex = i;
+        job.mRangeOffset = segment.mRangeOffset + i * partLength;
+        job.mRangeLength = partLength;
+        if (partLength > 0 && (int64_t)(i + 1) * partLength > segment.mRangeLength) {
+            job.mRangeLength = segment.mRangeLength - i * partLength;
+        }
+        mJobs.push_back(job);
+    }
+
+    ALOGV("queued '%s' (%lld, %lld) in %zu part(s)",
+            segment.mURI.c_str(), (long long)segment.mRangeOffset,
+            (long long)segment.mRangeLength, numParts);
+
+    mSegments.push(s);
+    startWorkers_l();
+    mCondition.broadcast();
+}
+
+void SegmentPrefetcher::dropSegment_l(size_t index) {
+    sp<Segment> s = mSegments[index];
+    s->mDropped = true;
+
+    List<Job>::iterator it = mJobs.begin();
+    while (it != mJobs.end()) {
+        if (it->mSegment == s) {
+            it = mJobs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    mSegments.removeAt(index);
+}
+
+void SegmentPrefetcher::startWorkers_l() {
+    if (!mWorkers.isEmpty()) {
+        return;
+    }
+
+    for (size_t i = 0; i < mNumWorkers; ++i) {
+        sp<Worker> worker = new Worker(this, mSession->getHTTPDownloader());
+        if (mDisconnecting) {
+            worker->downloader()->disconnect();
+        }
+        worker->run("SegmentPrefetcher");
+        mWorkers.push(worker);
+    }
+}
+
+bool SegmentPrefetcher::runJob(const sp<HTTPDownloader> &downloader) {
+    Job job;
+    {
+        Mutex::Autolock autoLock(mLock);
+        while (!mStopping && (mJobs.empty() || mDisconnecting)) {
+            mCondition.wait(mLock);
+        }
+
+        if (mStopping) {
+            return false;
+        }
+
+        job = *mJobs.begin();
+        mJobs.erase(mJobs.begin());
+
+        if (mNumActiveWorkers++ == 0) {
+            mActiveSinceUs = ALooper::GetNowUs();
+        }
+    }
+
+    status_t err = download(downloader, job);
+
+    Mutex::Autolock autoLock(mLock);
+    if (--mNumActiveWorkers == 0) {
+        mActiveTimeUs += ALooper::GetNowUs() - mActiveSinceUs;
+    }
+
+    Segment *s = job.mSegment.get();
+    if (err != OK && s->mError == OK) {
+        ALOGV("failed to fetch '%s' part %zu, err %d",
+                s->mInfo.mURI.c_str(), job.mPartIndex, err);
+        s->mError = err;
+    }
+    --s->mPendingParts;
+    mCondition.broadcast();
+
+    return true;
+}
+
+status_t SegmentPrefetcher::download(
+        const sp<HTTPDownloader> &downloader, const Job &job) {
+    const char *uri = job.mSegment->mInfo.mURI.c_str();
+
+    sp<ABuffer> buffer;
+    bool connectHTTP = true;
+    ssize_t bytesRead;
+    do {
+        bytesRead = downloader->fetchBlock(
+                uri, &buffer, job.mRangeOffset, job.mRangeLength,
+                PlaylistFetcher::kDownloadBlockSize,
+                NULL /* actualURL */, connectHTTP);
+        if (bytesRead < 0) {
+            return bytesRead;
+        }
+        connectHTTP = false;
+
+        Mutex::Autolock autoLock(mLock);
+        mBytesDownloaded += bytesRead;
+        if (job.mSegment->mDropped) {
+            // nobody wants this segment anymore
+            return ERROR_NOT_CONNECTED;
+        }
+    } while (bytesRead != 0);
+
+    Mutex::Autolock autoLock(mLock);
+    job.mSegment->mParts.editItemAt(job.mPartIndex) = buffer;
+    return OK;
+}
+
+}  // namespace android
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SEGMENT_PREFETCHER_H_
+
+#define SEGMENT_PREFETCHER_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/Condition.h>
+#include <utils/List.h>
+#include <utils/Mutex.h>
+#include <utils/RefBase.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+struct ABuffer;
+struct HTTPDownloader;
+struct LiveSession;
+
+// Downloads media segments ahead of the PlaylistFetcher on a small pool of
+// worker threads, each with its own HTTP connection. Segments with a known
+// byte range length are split into sub-ranges that are downloaded in parallel.
+struct SegmentPrefetcher : public RefBase {
+    struct SegmentInfo {
+        AString mURI;
+        int64_t mRangeOffset;
+        int64_t mRangeLength;   // -1: entire file
+    };
+
+    SegmentPrefetcher(
+            const sp<LiveSession> &session,
+            size_t numWorkers,
+            size_t numParts);
+
+    // Makes |segments| the segments to download, in order. Segments that
+    // are already queued or downloaded are kept, all others are dropped.
+    void setSegments(const Vector<SegmentInfo> &segments);
+
+    // Blocks until |segment| is downloaded and returns its size, or returns
+    // an error. The segment must have been passed to setSegments.
+    ssize_t takeSegment(const SegmentInfo &segment, sp<ABuffer> *out);
+
+    // Returns the bytes downloaded by all workers together and the time at
+    // least one of them was busy since the previous call.
+    bool takeBandwidthSample(size_t *numBytes, int64_t *delayUs);
+
+    void disconnect();
+    void reconnect();
+    void flush();
+
+protected:
+    virtual ~SegmentPrefetcher();
+
+private:
+    struct Segment;
+    struct Worker;
+
+    struct Job {
+        sp<Segment> mSegment;
+        size_t mPartIndex;
+        int64_t mRangeOffset;
+        int64_t mRangeLength;
+    };
+
+    sp<LiveSession> mSession;
+    size_t mNumWorkers;
+    size_t mNumParts;
+
+    Mutex mLock;
+    Condition mCondition;
+    Vector<sp<Worker> > mWorkers;
+    Vector<sp<Segment> > mSegments;
+    List<Job> mJobs;
+    bool mDisconnecting;
+    bool mStopping;
+
+    // aggregate bandwidth over all workers
+    size_t mNumActiveWorkers;
+    int64_t mActiveSinceUs;
+    int64_t mActiveTimeUs;
+    size_t mBytesDownloaded;
+
+    ssize_t findSegment_l(const SegmentInfo &segment) const;
+    void queueSegment_l(const SegmentInfo &segment);
+    void dropSegment_l(size_t index);
+    void startWorkers_l();
+    bool runJob(const sp<HTTPDownloader> &downloader);
+    status_t download(const sp<HTTPDownloader> &downloader, const Job &job);
+
+    DISALLOW_EVIL_CONSTRUCTORS(SegmentPrefetcher);
+};
+
+}  // namespace android
+
+#endif  // SEGMENT_PREFETCHER_H_
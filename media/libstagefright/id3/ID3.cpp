@@ -30,6 +30,13 @@ namespace android {
 
 static const size_t kMaxMetadataSize = 3 * 1024 * 1024;
 
+// In lazy mode, frames larger than this are left in the source.
+static const size_t kMaxInlineFrameSize = 64 * 1024;
+
+// Bytes read ahead of lazily indexed album art to find where the picture
+// starts; covers the encoding, mime type, picture type and description.
+static const size_t kMaxPictureHeaderSize = 512;
+
 struct MemorySource : public DataSource {
     MemorySource(const uint8_t *data, size_t size)
         : mData(data),
@@ -56,13 +63,16 @@ private:
     DISALLOW_EVIL_CONSTRUCTORS(MemorySource);
 };
 
-ID3::ID3(const sp<DataSource> &source, bool ignoreV1, off64_t offset)
+ID3::ID3(const sp<DataSource> &source, bool ignoreV1, off64_t offset,
+        bool lazyFrames)
     : mIsValid(false),
       mData(NULL),
       mSize(0),
       mFirstFrameOffset(0),
       mVersion(ID3_UNKNOWN),
-      mRawSize(0) {
+      mRawSize(0),
+      mLazyFrames(lazyFrames),
+      mAlbumArt(NULL) {
     mIsValid = parseV2(source, offset);
 
     if (!mIsValid && !ignoreV1) {
@@ -76,7 +86,9 @@ ID3::ID3(const uint8_t *data, size_t size, bool ignoreV1)
       mSize(0),
       mFirstFrameOffset(0),
       mVersion(ID3_UNKNOWN),
-      mRawSize(0) {
+      mRawSize(0),
+      mLazyFrames(false),
+      mAlbumArt(NULL) {
     sp<MemorySource> source = new MemorySource(data, size);
 
     mIsValid = parseV2(source, 0);
@@ -91,6 +103,11 @@ ID3::~ID3() {
         free(mData);
         mData = NULL;
     }
+
+    if (mAlbumArt) {
+        free(mAlbumArt);
+        mAlbumArt = NULL;
+    }
 }
 
 bool ID3::isValid() const {
@@ -171,6 +188,22 @@ struct id3_header {
         return false;
     }
 
+    if (mLazyFrames && indexV2Frames(
+                source, offset + sizeof(header), size,
+                header.version_major, header.flags)) {
+        mRawSize = size + sizeof(header);
+
+        if (header.version_major == 2) {
+            mVersion = ID3_V2_2;
+        } else if (header.version_major == 3) {
+            mVersion = ID3_V2_3;
+        } else {
+            mVersion = ID3_V2_4;
+        }
+
+        return true;
+    }
+
     if (size > kMaxMetadataSize) {
         ALOGE("skipping huge ID3 metadata of size %zu", size);
         return false;
@@ -324,6 +357,173 @@ struct id3_header {
     return true;
 }
 
+// Builds mData from the headers and payloads of the small frames only, and
+// records where the payloads of the large ones are in the source. Returns
+// false, leaving the tag untouched, if the tag needs to be read as a whole.
+bool ID3::indexV2Frames(
+        const sp<DataSource> &source, off64_t offset, size_t size,
+        uint8_t versionMajor, uint8_t flags) {
+    struct FrameRange {
+        size_t mStart;
+        size_t mEnd;
+    };
+
+    if (versionMajor != 4 && (flags & 0x80)) {
+        // The whole tag is unsynchronized, frame boundaries are only known
+        // once all of it has been read.
+        return false;
+    }
+
+    const size_t headerLength = (versionMajor == 2) ? 6 : 10;
+    const size_t idLength = (versionMajor == 2) ? 3 : 4;
+    uint8_t buf[10];
+    size_t pos = 0;
+
+    if (versionMajor == 3 && (flags & 0x40)) {
+        if (size < 4 || source->readAt(offset, buf, 4) != 4) {
+            return false;
+        }
+
+        size_t extendedHeaderSize = U32_AT(buf);
+        if (extendedHeaderSize > size - 4) {
+            return false;
+        }
+        extendedHeaderSize += 4;
+
+        if (extendedHeaderSize >= 10) {
+            if (source->readAt(offset + 6, buf, 4) != 4) {
+                return false;
+            }
+
+            size_t paddingSize = U32_AT(buf);
+            if (paddingSize > size - extendedHeaderSize) {
+                return false;
+            }
+            size -= paddingSize;
+        }
+
+        pos = extendedHeaderSize;
+    } else if (versionMajor == 4 && (flags & 0x40)) {
+        if (size < 4 || source->readAt(offset, buf, 4) != 4
+                || !ParseSyncsafeInteger(buf, &pos)
+                || pos < 6 || pos > size) {
+            return false;
+        }
+    }
+
+    Vector<FrameRange> inlineRanges;
+    Vector<LazyFrame> lazyFrames;
+    size_t inlineSize = 0;
+
+    while (size >= headerLength && pos <= size - headerLength) {
+        if (source->readAt(offset + pos, buf, headerLength)
+                != (ssize_t)headerLength) {
+            return false;
+        }
+
+        if (!memcmp(buf, "\0\0\0\0", idLength)) {
+            break;
+        }
+
+        size_t frameSize;
+        uint16_t frameFlags = 0;
+        if (versionMajor == 2) {
+            frameSize = (buf[3] << 16) | (buf[4] << 8) | buf[5];
+        } else if (versionMajor == 3) {
+            frameSize = U32_AT(&buf[4]);
+            frameFlags = U16_AT(&buf[8]);
+        } else if (!ParseSyncsafeInteger(&buf[4], &frameSize)) {
+            return false;
+        } else {
+            frameFlags = U16_AT(&buf[8]);
+        }
+
+        if (frameSize == 0) {
+            break;
+        }
+
+        if (frameSize > size - pos - headerLength) {
+            if (versionMajor == 4) {
+                // Possibly a tag written with non-syncsafe frame sizes,
+                // let the full parse apply the iTunes hack.
+                return false;
+            }
+            break;
+        }
+
+        // Frames that have to be decoded before use are always read in.
+        bool encoded = (versionMajor == 4 && (frameFlags & 0x000f))
+                || (versionMajor == 3 && (frameFlags & 0x00c0));
+
+        if (frameSize > kMaxInlineFrameSize && !encoded) {
+            LazyFrame frame;
+            memset(frame.mID, 0, sizeof(frame.mID));
+            memcpy(frame.mID, buf, idLength);
+            frame.mOffset = offset + pos + headerLength;
+            frame.mSize = frameSize;
+            lazyFrames.push(frame);
+        } else {
+            size_t frameEnd = pos + headerLength + frameSize;
+            if (!inlineRanges.isEmpty() && inlineRanges.top().mEnd == pos) {
+                inlineRanges.editTop().mEnd = frameEnd;
+            } else {
+                FrameRange range;
+                range.mStart = pos;
+                range.mEnd = frameEnd;
+                inlineRanges.push(range);
+            }
+            inlineSize += headerLength + frameSize;
+        }
+
+        pos += headerLength + frameSize;
+    }
+
+    if (inlineSize > kMaxMetadataSize) {
+        ALOGE("skipping huge ID3 metadata of size %zu", inlineSize);
+        return false;
+    }
+
+    uint8_t *data = (uint8_t *)malloc(inlineSize > 0 ? inlineSize : 1);
+    if (data == NULL) {
+        return false;
+    }
+
+    // Adjacent small frames are read together.
+    size_t dataSize = 0;
+    for (size_t i = 0; i < inlineRanges.size(); ++i) {
+        const FrameRange &range = inlineRanges.itemAt(i);
+        size_t rangeSize = range.mEnd - range.mStart;
+
+        if (source->readAt(offset + range.mStart, &data[dataSize], rangeSize)
+                != (ssize_t)rangeSize) {
+            free(data);
+            return false;
+        }
+        dataSize += rangeSize;
+    }
+
+    mData = data;
+    mSize = dataSize;
+
+    if (versionMajor == 4
+            && !removeUnsynchronizationV2_4(false /* iTunesHack */)) {
+        free(mData);
+        mData = NULL;
+        mSize = 0;
+
+        return false;
+    }
+
+    mFirstFrameOffset = 0;
+    mSource = source;
+    mLazyFrameIndex = lazyFrames;
+
+    ALOGV("indexed ID3 tag: %zu bytes read, %zu frames left in source",
+          mSize, mLazyFrameIndex.size());
+
+    return true;
+}
+
 void ID3::removeUnsynchronization() {
     for (size_t i = 0; i + 1 < mSize; ++i) {
         if (mData[i] == 0xff && mData[i + 1] == 0x00) {
@@ -820,6 +1020,53 @@ static size_t StringSize(const uint8_t *start, uint8_t encoding) {
     return n + 2;
 }
 
+// static
+const uint8_t *ID3::ParsePictureFrame(
+        Version version, const uint8_t *data, size_t size,
+        size_t *length, String8 *mime) {
+    *length = 0;
+
+    if (version == ID3_V2_3 || version == ID3_V2_4) {
+        uint8_t encoding = data[0];
+        mime->setTo((const char *)&data[1]);
+        size_t mimeLen = strlen((const char *)&data[1]) + 1;
+
+        size_t descLen = StringSize(&data[2 + mimeLen], encoding);
+
+        if (size < 2 ||
+                size - 2 < mimeLen ||
+                size - 2 - mimeLen < descLen) {
+            ALOGW("bogus album art sizes");
+            return NULL;
+        }
+        *length = size - 2 - mimeLen - descLen;
+
+        return &data[2 + mimeLen + descLen];
+    }
+
+    uint8_t encoding = data[0];
+
+    if (!memcmp(&data[1], "PNG", 3)) {
+        mime->setTo("image/png");
+    } else if (!memcmp(&data[1], "JPG", 3)) {
+        mime->setTo("image/jpeg");
+    } else if (!memcmp(&data[1], "-->", 3)) {
+        mime->setTo("text/plain");
+    } else {
+        return NULL;
+    }
+
+    size_t descLen = StringSize(&data[5], encoding);
+
+    if (size < 5 || size - 5 < descLen) {
+        ALOGW("bogus album art sizes");
+        return NULL;
+    }
+    *length = size - 5 - descLen;
+
+    return &data[5 + descLen];
+}
+
 const void *
 ID3::getAlbumArt(size_t *length, String8 *mime) const {
     *length = 0;
@@ -829,66 +1076,74 @@ ID3::getAlbumArt(size_t *length, String8 *mime) const {
             *this,
             (mVersion == ID3_V2_3 || mVersion == ID3_V2_4) ? "APIC" : "PIC");
 
-    while (!it.done()) {
+    if (!it.done()) {
         size_t size;
         const uint8_t *data = it.getData(&size);
 
-        if (mVersion == ID3_V2_3 || mVersion == ID3_V2_4) {
-            uint8_t encoding = data[0];
-            mime->setTo((const char *)&data[1]);
-            size_t mimeLen = strlen((const char *)&data[1]) + 1;
+        return ParsePictureFrame(mVersion, data, size, length, mime);
+    }
 
-#if 0
-            uint8_t picType = data[1 + mimeLen];
-            if (picType != 0x03) {
-                // Front Cover Art
-                it.next();
-                continue;
-            }
-#endif
+    off64_t offset;
+    if (!getAlbumArtLocation(&offset, length, mime)) {
+        return NULL;
+    }
 
-            size_t descLen = StringSize(&data[2 + mimeLen], encoding);
+    // Read the picture alone, straight from the source.
+    free(mAlbumArt);
+    mAlbumArt = (uint8_t *)malloc(*length > 0 ? *length : 1);
+    if (mAlbumArt == NULL
+            || mSource->readAt(offset, mAlbumArt, *length) != (ssize_t)*length) {
+        free(mAlbumArt);
+        mAlbumArt = NULL;
+        *length = 0;
+        mime->setTo("");
 
-            if (size < 2 ||
-                    size - 2 < mimeLen ||
-                    size - 2 - mimeLen < descLen) {
-                ALOGW("bogus album art sizes");
-                return NULL;
-            }
-            *length = size - 2 - mimeLen - descLen;
+        return NULL;
+    }
 
-            return &data[2 + mimeLen + descLen];
-        } else {
-            uint8_t encoding = data[0];
-
-            if (!memcmp(&data[1], "PNG", 3)) {
-                mime->setTo("image/png");
-            } else if (!memcmp(&data[1], "JPG", 3)) {
-                mime->setTo("image/jpeg");
-            } else if (!memcmp(&data[1], "-->", 3)) {
-                mime->setTo("text/plain");
-            } else {
-                return NULL;
-            }
+    return mAlbumArt;
+}
 
-#if 0
-            uint8_t picType = data[4];
-            if (picType != 0x03) {
-                // Front Cover Art
-                it.next();
-                continue;
-            }
-#endif
+bool ID3::getAlbumArtLocation(
+        off64_t *offset, size_t *length, String8 *mime) const {
+    *length = 0;
+    mime->setTo("");
 
-            size_t descLen = StringSize(&data[5], encoding);
+    const char *id =
+        (mVersion == ID3_V2_3 || mVersion == ID3_V2_4) ? "APIC" : "PIC";
 
-            *length = size - 5 - descLen;
+    for (size_t i = 0; i < mLazyFrameIndex.size(); ++i) {
+        const LazyFrame &frame = mLazyFrameIndex.itemAt(i);
+        if (strcmp(frame.mID, id)) {
+            continue;
+        }
+
+        // Zero padded so that strings cut short by the read stay terminated.
+        uint8_t header[kMaxPictureHeaderSize + 4];
+        memset(header, 0, sizeof(header));
+
+        size_t headerSize =
+            frame.mSize < kMaxPictureHeaderSize ? frame.mSize : kMaxPictureHeaderSize;
+        if (mSource->readAt(frame.mOffset, header, headerSize)
+                != (ssize_t)headerSize) {
+            return false;
+        }
 
-            return &data[5 + descLen];
+        const uint8_t *picture =
+            ParsePictureFrame(mVersion, header, frame.mSize, length, mime);
+        if (picture == NULL || (size_t)(picture - header) >= headerSize) {
+            ALOGW("album art header not found in the first %zu bytes", headerSize);
+            *length = 0;
+            mime->setTo("");
+            return false;
         }
+
+        *offset = frame.mOffset + (picture - header);
+
+        return true;
     }
 
-    return NULL;
+    return false;
 }
 
 bool ID3::parseV1(const sp<DataSource> &source) {
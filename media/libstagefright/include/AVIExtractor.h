@@ -21,10 +21,13 @@
 #include <media/stagefright/foundation/ABase.h>
 #include <media/stagefright/MediaExtractor.h>
 #include <media/stagefright/MediaSource.h>
+#include <utils/Mutex.h>
 #include <utils/Vector.h>
 
 namespace android {
 
+struct ABuffer;
+
 struct AVIExtractor : public MediaExtractor {
     AVIExtractor(const sp<DataSource> &dataSource);
 
@@ -44,14 +47,39 @@ private:
     struct AVISource;
     struct MP3Splitter;
 
+    // 8 bytes per sample, the chunk size is kept so that reading a sample
+    // does not need a separate read of its chunk header.
     struct SampleInfo {
         uint32_t mOffset;
-        bool mIsKey;
+        uint32_t mSize : 31;
+        uint32_t mIsKey : 1;
+    };
+
+    // An OpenDML standard index chunk ('ix##') listed in a stream's super
+    // index ('indx').
+    struct IndexChunk {
+        off64_t mOffset;        // of the index entries
+        off64_t mBaseOffset;    // entries are relative to this
+        size_t mFirstSample;
+        size_t mNumSamples;
     };
 
     struct Track {
         sp<MetaData> mMeta;
+
+        // With an idx1 index, all samples of the track. With an OpenDML
+        // index, only the samples of mIndexChunks[mLoadedIndexChunk]; the
+        // other standard index chunks are read when they are needed, which
+        // bounds the memory used for very long files.
         Vector<SampleInfo> mSamples;
+        Vector<IndexChunk> mIndexChunks;
+        ssize_t mLoadedIndexChunk;
+        size_t mNumSamples;
+
+        // Offset of the stream's super index, 0 if it has none.
+        off64_t mSuperIndexOffset;
+        size_t mSuperIndexSize;
+
         uint32_t mRate;
         uint32_t mScale;
 
@@ -84,14 +112,39 @@ private:
     off64_t mMovieOffset;
     bool mFoundIndex;
     bool mOffsetsAreAbsolute;
+    bool mUseSuperIndex;
+
+    // Guards the lazily loaded OpenDML index chunks and the read-ahead
+    // window, both shared by all sources of this extractor.
+    Mutex mLock;
+
+    // Samples are read through a window so that small chunks interleaved in
+    // the movie list are fetched with one read of the data source.
+    enum {
+        kReadAheadSize = 256 * 1024,
+        kMaxReadAheadRequest = 64 * 1024,
+    };
+    sp<ABuffer> mReadAhead;
+    off64_t mReadAheadOffset;
 
     ssize_t parseChunk(off64_t offset, off64_t size, int depth = 0);
     status_t parseStreamHeader(off64_t offset, size_t size);
     status_t parseStreamFormat(off64_t offset, size_t size);
+    status_t parseSuperIndex(size_t trackIndex);
     status_t parseIndex(off64_t offset, size_t size);
+    bool hasSuperIndexes() const;
+    void updateSampleStats(Track *track, size_t sampleIndex, const SampleInfo &info);
+    status_t finishIndex();
 
     status_t parseHeaders();
 
+    status_t loadIndexChunk_l(Track *track, size_t chunkIndex);
+    status_t findSample(
+            size_t trackIndex, size_t sampleIndex,
+            SampleInfo *info, off64_t *chunkOffset);
+    status_t checkChunkHeader(size_t trackIndex, size_t sampleIndex);
+    ssize_t readSampleData(off64_t offset, void *data, size_t size);
+
     status_t getSampleInfo(
             size_t trackIndex, size_t sampleIndex,
             off64_t *offset, size_t *size, bool *isKey,
@@ -103,7 +156,7 @@ private:
     status_t getSampleIndexAtTime(
             size_t trackIndex,
             int64_t timeUs, MediaSource::ReadOptions::SeekMode mode,
-            size_t *sampleIndex) const;
+            size_t *sampleIndex);
 
     status_t addMPEG4CodecSpecificData(size_t trackIndex);
     status_t addH264CodecSpecificData(size_t trackIndex);
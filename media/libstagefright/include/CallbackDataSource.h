@@ -46,9 +46,11 @@ private:
 
 
 // A caching DataSource that wraps a CallbackDataSource. For reads smaller
-// than kCacheSize it will read up to kCacheSize ahead and cache it.
+// than the current cache window it will read up to a window ahead and cache it.
 // This reduces the number of binder round trips to the IDataSource and has a significant
 // impact on time taken for filetype sniffing and metadata extraction.
+// The window starts at kMinCacheSize and doubles, up to kMaxCacheSize, while
+// the reads stay sequential; any other access pattern shrinks it back.
 class TinyCacheSource : public DataSource {
 public:
     TinyCacheSource(const sp<DataSource>& source);
@@ -61,15 +63,18 @@ public:
 private:
     // 2kb comes from experimenting with the time-to-first-frame from a MediaPlayer
     // with an in-memory MediaDataSource source on a Nexus 5. Beyond 2kb there was
-    // no improvement.
+    // no improvement for sniffing, which is mostly small scattered reads.
+    // Sequential sample reads during playback benefit from the larger window.
     enum {
-        kCacheSize = 2048,
+        kMinCacheSize = 2048,
+        kMaxCacheSize = 64 * 1024,
     };
 
     sp<DataSource> mSource;
-    uint8_t mCache[kCacheSize];
+    uint8_t mCache[kMaxCacheSize];
     off64_t mCachedOffset;
     size_t mCachedSize;
+    size_t mCacheWindow;
 
     DISALLOW_EVIL_CONSTRUCTORS(TinyCacheSource);
 };
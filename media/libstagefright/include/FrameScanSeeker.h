@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FRAME_SCAN_SEEKER_H_
+
+#define FRAME_SCAN_SEEKER_H_
+
+#include "include/MP3Seeker.h"
+
+namespace android {
+
+class DataSource;
+
+// Seeks in MP3 files without a XING or VBRI header using a table of frame
+// offsets, built by scanning the frame headers on a background thread.
+// Tables are shared by all extractors opening the same local file.
+struct FrameScanSeeker : public MP3Seeker {
+    // Returns NULL unless the source is a local file.
+    static sp<FrameScanSeeker> CreateFromSource(
+            const sp<DataSource> &source, off64_t first_frame_pos, uint32_t fixed_header);
+
+    // Only available once the whole file has been scanned.
+    virtual bool getDuration(int64_t *durationUs);
+
+    // Fails while the scan has not reached the requested time yet.
+    virtual bool getOffsetForTime(int64_t *timeUs, off64_t *pos);
+
+private:
+    struct FrameTable;
+    struct ScanThread;
+
+    sp<FrameTable> mTable;
+
+    FrameScanSeeker(const sp<FrameTable> &table);
+
+    DISALLOW_EVIL_CONSTRUCTORS(FrameScanSeeker);
+};
+
+}  // namespace android
+
+#endif  // FRAME_SCAN_SEEKER_H_
@@ -14,6 +14,7 @@
 #include <media/stagefright/MediaExtractor.h>
 
 #include <media/stagefright/Utils.h>
+#include <utils/Condition.h>
 #include <utils/List.h>
 #include <utils/Vector.h>
 #include <utils/String8.h>
@@ -115,6 +116,8 @@ public:
     status_t GetNextSample(uint32_t index,bool is_sync);
     status_t CheckInterleaveEos(uint32_t index);
     status_t ClearTrackSource(uint32_t index);
+    bool isDemuxing() const;
+    void SignalDemux();
 
 
 protected:
@@ -144,7 +147,7 @@ private:
         bool bCodecInfoSent;
 
         bool bPartial;
-        sp<ABuffer> buffer;
+        MediaBuffer *buffer;   // sample being assembled
 
         int64_t outTs = 0;
         int32_t syncFrame = 0;
@@ -159,6 +162,18 @@ private:
     FslParserHandle  parserHandle;
 
     Mutex mLock;
+
+    // With media.stagefright.fsl-demux-depth set, a demux thread keeps up to
+    // that many frames queued in each started track's source, and the
+    // sources only wait for frames instead of demuxing themselves.
+    struct DemuxThread;
+    sp<DemuxThread> mDemuxThread;
+    size_t mDemuxDepth;
+    Mutex mDemuxLock;
+    Condition mDemuxCondition;
+    uint32_t mDemuxSignals;
+    bool mStopDemux;
+
     int64_t currentVideoTs;
     int64_t currentAudioTs;
     bool mVideoActived;
@@ -181,6 +196,11 @@ private:
             const void *_codecPrivate, size_t codecPrivateSize);
 
     bool isTrackModeParser();
+    status_t GetNextSample_l(uint32_t index,bool is_sync);
+    void StartDemuxing();
+    bool DemuxNextSample();
+    ssize_t PickDemuxTrack_l();
+    void SetDemuxError_l(size_t index,status_t err);
     status_t convertPCMData(sp<ABuffer> inBuffer, sp<ABuffer> outBuffer, int32_t bitPerSample);
     FslExtractor(const FslExtractor &);
     FslExtractor &operator=(const FslExtractor &);
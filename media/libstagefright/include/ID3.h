@@ -19,6 +19,7 @@
 #define ID3_H_
 
 #include <utils/RefBase.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -35,7 +36,12 @@ struct ID3 {
         ID3_V2_4,
     };
 
-    ID3(const sp<DataSource> &source, bool ignoreV1 = false, off64_t offset = 0);
+    // If lazyFrames is true, large frames of an ID3v2 tag are only indexed
+    // while parsing and their payload stays in the source until it is asked
+    // for. Such frames are not visited by Iterator; album art is still
+    // returned by getAlbumArt().
+    ID3(const sp<DataSource> &source, bool ignoreV1 = false, off64_t offset = 0,
+            bool lazyFrames = false);
     ID3(const uint8_t *data, size_t size, bool ignoreV1 = false);
     ~ID3();
 
@@ -45,6 +51,11 @@ struct ID3 {
 
     const void *getAlbumArt(size_t *length, String8 *mime) const;
 
+    // Returns the location of lazily indexed album art in the source, so that
+    // it can be streamed from there. Returns false if there is none, in which
+    // case any album art was read with the tag and getAlbumArt() returns it.
+    bool getAlbumArtLocation(off64_t *offset, size_t *length, String8 *mime) const;
+
     struct Iterator {
         Iterator(const ID3 &parent, const char *id);
         ~Iterator();
@@ -75,6 +86,12 @@ struct ID3 {
     size_t rawSize() const { return mRawSize; }
 
 private:
+    struct LazyFrame {
+        char mID[5];
+        off64_t mOffset;  // offset of the frame payload in mSource
+        size_t mSize;  // size of the frame payload
+    };
+
     bool mIsValid;
     uint8_t *mData;
     size_t mSize;
@@ -85,12 +102,23 @@ private:
     // only valid for IDV2+
     size_t mRawSize;
 
+    bool mLazyFrames;
+    sp<DataSource> mSource;
+    Vector<LazyFrame> mLazyFrameIndex;
+    mutable uint8_t *mAlbumArt;
+
     bool parseV1(const sp<DataSource> &source);
     bool parseV2(const sp<DataSource> &source, off64_t offset);
+    bool indexV2Frames(
+            const sp<DataSource> &source, off64_t offset, size_t size,
+            uint8_t versionMajor, uint8_t flags);
     void removeUnsynchronization();
     bool removeUnsynchronizationV2_4(bool iTunesHack);
 
     static bool ParseSyncsafeInteger(const uint8_t encoded[4], size_t *x);
+    static const uint8_t *ParsePictureFrame(
+            Version version, const uint8_t *data, size_t size,
+            size_t *length, String8 *mime);
 
     ID3(const ID3 &);
     ID3 &operator=(const ID3 &);
@@ -46,6 +46,7 @@ private:
     EAS_DATA_HANDLE mEasData;
     EAS_HANDLE mEasHandle;
     const S_EAS_LIB_CONFIG* mEasConfig;
+    int mNumCombineBuffers;  // Sonivox output buffers rendered per MediaBuffer
     bool mIsInitialized;
 };
 
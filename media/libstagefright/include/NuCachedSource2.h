@@ -26,6 +26,7 @@
 namespace android {
 
 struct ALooper;
+struct DiskCache;
 struct PageCache;
 
 struct NuCachedSource2 : public DataSource {
@@ -38,6 +39,11 @@ struct NuCachedSource2 : public DataSource {
 
     virtual ssize_t readAt(off64_t offset, void *data, size_t size);
 
+    // Data that is already in the page cache is returned as views of the
+    // cached pages, everything else is read via readAt().
+    virtual ssize_t readAtViews(
+            off64_t offset, size_t size, Vector<sp<ABuffer> > *views);
+
     virtual void disconnect();
 
     virtual status_t getSize(off64_t *size);
@@ -88,6 +94,11 @@ private:
         // Read data after a 15 sec timeout whether we're actively
         // fetching or not.
         kDefaultKeepAliveIntervalUs     = 15000000,
+
+        // Bound of the disk cache directory unless
+        // media.stagefright.disk-cache-kb says otherwise.
+        kDefaultDiskCacheSize           = 100 * 1024 * 1024,
+        kMaxDiskCacheBlocksPerFetch     = 8,
     };
 
     enum {
@@ -108,6 +119,7 @@ private:
     Condition mCondition;
 
     PageCache *mCache;
+    DiskCache *mDiskCache;
     off64_t mCacheOffset;
     status_t mFinalStatus;
     off64_t mLastAccessPos;
@@ -141,6 +153,11 @@ private:
 
     void updateCacheParamsFromSystemProperty();
 
+    // Pages released from mCache are kept on disk when
+    // media.stagefright.cache-dir is set.
+    void createDiskCacheFromSystemProperty();
+    void spillToDiskCache_l(size_t maxBytes);
+
     DISALLOW_EVIL_CONSTRUCTORS(NuCachedSource2);
 };
 
@@ -138,8 +138,13 @@ public:
             const void *data,
             size_t size);
 
+    virtual status_t createMessageRing(node_id node, sp<IMemory> *memory);
+
     virtual void binderDied(const wp<IBinder> &the_late_who);
 
+    // Lists the live nodes and their backup buffer copies, from MediaPlayerService::dump().
+    virtual status_t dump(int fd, const Vector<String16> &args);
+
     virtual bool isSecure(IOMX::node_id node);
 
     OMX_ERRORTYPE OnEvent(
@@ -174,6 +179,7 @@ private:
 
     node_id makeNodeID(OMXNodeInstance *instance);
     OMXNodeInstance *findInstance(node_id node);
+    OMXNodeInstance *findInstanceForClient(node_id node);
     sp<CallbackDispatcher> findDispatcher(node_id node);
 
     void invalidateNodeID_l(node_id node);
@@ -21,6 +21,7 @@
 #include "OMX.h"
 
 #include <utils/RefBase.h>
+#include <utils/String8.h>
 #include <utils/threads.h>
 
 namespace android {
@@ -28,6 +29,7 @@ namespace android {
 class IOMXObserver;
 struct OMXMaster;
 class GraphicBufferSource;
+class OMXMessageRing;
 
 status_t StatusFromOMXError(OMX_ERRORTYPE err);
 
@@ -125,6 +127,15 @@ struct OMXNodeInstance {
             const void *data,
             size_t size);
 
+    status_t createMessageRing(sp<IMemory> *memory);
+
+    // Runs the buffer commands the client has queued on the message ring. Called before
+    // each binder call from the client, so that they happen in order.
+    void runQueuedCommands();
+
+    // Appends the buffer counts and backup copy statistics of the node for dumpsys.
+    void dump(String8 &result);
+
     bool isSecure() const {
         return mIsSecure;
     }
@@ -154,6 +165,18 @@ private:
     // Access this through getGraphicBufferSource().
     sp<GraphicBufferSource> mGraphicBufferSource;
 
+    // The message ring, if the client has asked for it. mMessageRingLock orders the
+    // commands from the ring with the binder calls, mEventRingLock covers mEventRing
+    // which is only written to by the callback dispatcher.
+    struct CommandThread;
+    Mutex mMessageRingLock;
+    sp<OMXMessageRing> mCommandRing;
+    sp<CommandThread> mCommandThread;
+    bool mCommandRingFailed;
+    Mutex mEventRingLock;
+    sp<OMXMessageRing> mEventRing;
+    void stopMessageRing();
+
 
     struct ActiveBuffer {
         OMX_U32 mPortIndex;
@@ -176,6 +199,7 @@ private:
     int DEBUG_BUMP;
     SortedVector<OMX_BUFFERHEADERTYPE *> mInputBuffersWithCodec, mOutputBuffersWithCodec;
     size_t mDebugLevelBumpPendingBuffers[2];
+    uint64_t mBytesCopied[2];   // to and from the backup buffers, for dump()
     void bumpDebugLevel_l(size_t numInputBuffers, size_t numOutputBuffers);
     void unbumpDebugLevel_l(size_t portIndex);
 
@@ -113,12 +113,29 @@ private:
     uint32_t mTimeToSampleCount;
     uint32_t *mTimeToSample;
 
+    // Prefix index over the stts runs, one entry per mTimeToSample entry.
+    struct TimeToSampleRun {
+        uint64_t mFirstSample;
+        uint64_t mStartTime;
+    };
+    TimeToSampleRun *mTimeToSampleRuns;
+    uint64_t mTimeToSampleTotalTime;
+
     struct SampleTimeEntry {
         uint32_t mSampleIndex;
         uint32_t mCompositionTime;
     };
     SampleTimeEntry *mSampleTimeEntries;
 
+    // Set up by buildSampleEntriesTable().  When all samples share the same
+    // composition offset, presentation order is decode order and
+    // findSampleAtTime() searches mTimeToSampleRuns instead of materializing
+    // mSampleTimeEntries.
+    bool mSampleTimeIndexBuilt;
+    bool mPresentationInDecodeOrder;
+    uint32_t mUniformCompositionOffset;
+    uint32_t mNumPresentationSamples;
+
     uint32_t *mCompositionTimeDeltaEntries;
     size_t mNumCompositionTimeDeltaEntries;
     CompositionDeltaLookup *mCompositionDeltaLookup;
@@ -139,12 +156,22 @@ private:
 
     friend struct SampleIterator;
 
+    // Returns the stts run containing sampleIndex, or -1 if there are none.
+    ssize_t findTimeToSampleRun(uint32_t sampleIndex) const;
+
+    // Composition time of the sample at position index in presentation order.
+    uint32_t getPresentationTime(uint32_t index) const;
+
+    // Sample index of the sample at position index in presentation order.
+    inline uint32_t getPresentationSampleIndex(uint32_t index) const {
+        return mPresentationInDecodeOrder ? index : mSampleTimeEntries[index].mSampleIndex;
+    }
+
     // normally we don't round
     inline uint64_t getSampleTime(
-            size_t sample_index, uint64_t scale_num, uint64_t scale_den) const {
-        return (sample_index < (size_t)mNumSampleSizes && mSampleTimeEntries != NULL
-                && scale_den != 0)
-                ? (mSampleTimeEntries[sample_index].mCompositionTime * scale_num) / scale_den : 0;
+            size_t index, uint64_t scale_num, uint64_t scale_den) const {
+        return (index < (size_t)mNumPresentationSamples && scale_den != 0)
+                ? (getPresentationTime(index) * scale_num) / scale_den : 0;
     }
 
     status_t getSampleSize_l(uint32_t sample_index, size_t *sample_size);
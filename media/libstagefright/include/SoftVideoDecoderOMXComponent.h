@@ -23,12 +23,17 @@
 #include <media/stagefright/foundation/AHandlerReflector.h>
 #include <media/IOMX.h>
 
+#include <ui/GraphicBuffer.h>
+
+#include <utils/KeyedVector.h>
 #include <utils/RefBase.h>
 #include <utils/threads.h>
 #include <utils/Vector.h>
 
 namespace android {
 
+struct UseAndroidNativeBufferParams;
+
 struct SoftVideoDecoderOMXComponent : public SimpleSoftOMXComponent {
     SoftVideoDecoderOMXComponent(
             const char *name,
@@ -43,6 +48,8 @@ struct SoftVideoDecoderOMXComponent : public SimpleSoftOMXComponent {
             OMX_COMPONENTTYPE **component);
 
 protected:
+    virtual ~SoftVideoDecoderOMXComponent();
+
     virtual void onPortEnableCompleted(OMX_U32 portIndex, bool enabled);
     virtual void onReset();
 
@@ -82,12 +89,59 @@ protected:
             uint8_t *dst, const uint8_t *srcY, const uint8_t *srcU, const uint8_t *srcV,
             size_t srcYStride, size_t srcUStride, size_t srcVStride);
 
+    // The planes of an output buffer holding a frame of outputBufferWidth() x
+    // outputBufferHeight().
+    struct OutputPlanes {
+        uint8_t *mY;
+        uint8_t *mU;
+        uint8_t *mV;
+        size_t mYStride;
+        size_t mUVStride;
+    };
+
+    // Decoders writing their output through the functions below call this from their
+    // constructor to accept the gralloc buffers of a native window on the output port.
+    // The frames are then written straight into the buffers displayed, without the copy
+    // of the software renderer.
+    void supportNativeBuffers();
+
+    // Returns the planes of the output buffer of outHeader, mapping it if it is a gralloc
+    // buffer. The buffer must be unlocked again before it is returned to the client.
+    bool lockOutputBuffer(OMX_BUFFERHEADERTYPE *outHeader, OutputPlanes *planes);
+    void unlockOutputBuffer(OMX_BUFFERHEADERTYPE *outHeader);
+
+    void copyYV12FrameToOutputPlanes(
+            const OutputPlanes &planes,
+            const uint8_t *srcY, const uint8_t *srcU, const uint8_t *srcV,
+            size_t srcYStride, size_t srcUStride, size_t srcVStride);
+    bool copyYV12FrameToOutputBuffer(
+            OMX_BUFFERHEADERTYPE *outHeader,
+            const uint8_t *srcY, const uint8_t *srcU, const uint8_t *srcV,
+            size_t srcYStride, size_t srcUStride, size_t srcVStride);
+
+    // Reserves cores of the process wide budget shared by all software video decoders for
+    // the threads of this decoder, replacing any previous reservation. Returns the number of
+    // cores to use, between 1 and maxCores: the decoder threads parameter if it is set,
+    // otherwise what the other decoder instances leave of one per CPU core.
+    size_t acquireDecoderCores(size_t maxCores);
+    void releaseDecoderCores();
+
     enum {
         kInputPortIndex  = 0,
         kOutputPortIndex = 1,
         kMaxPortIndex = 1,
     };
 
+    enum {
+        // OMX_PARAM_U32TYPE on the output port, the number of decoder threads of this
+        // instance. 0 (the default) shares the CPU cores with the other decoders. Takes
+        // effect when the decoder is (re)initialized or reset.
+        kDecoderThreadsIndex = kPrepareForAdaptivePlaybackIndex + 1,
+        kEnableNativeBuffersIndex,
+        kGetNativeBufferUsageIndex,
+        kUseNativeBufferIndex,
+    };
+
     bool mIsAdaptive;
     uint32_t mAdaptiveMaxWidth, mAdaptiveMaxHeight;
     uint32_t mWidth, mHeight;
@@ -103,6 +157,18 @@ private:
     uint32_t mMinInputBufferSize;
     uint32_t mMinCompressionRatio;
 
+    uint32_t mNumDecoderThreads;    // requested by the client, 0 for automatic
+    size_t mNumReservedCores;       // counted in the process wide budget
+
+    bool mSupportsNativeBuffers;
+    bool mNativeBuffersEnabled;
+    // the gralloc buffers of the output buffers taken through kUseNativeBufferIndex
+    KeyedVector<OMX_BUFFERHEADERTYPE *, sp<GraphicBuffer> > mNativeBuffers;
+
+    OMX_COLOR_FORMATTYPE outputColorFormat() const;
+    OMX_ERRORTYPE useNativeBuffer(const UseAndroidNativeBufferParams *params);
+    ssize_t nativeBufferIndex(OMX_BUFFERHEADERTYPE *outHeader) const;
+
     const char *mComponentRole;
     OMX_VIDEO_CODINGTYPE mCodingType;
     const CodecProfileLevel *mProfileLevels;
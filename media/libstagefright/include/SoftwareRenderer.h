@@ -49,6 +49,8 @@ private:
     OMX_COLOR_FORMATTYPE mColorFormat;
     ColorConverter *mConverter;
     YUVMode mYUVMode;
+    int mHalFormat;         // of the window buffers
+    bool mYUVRejected;      // the window did not give YV12 buffers, use RGB565
     sp<ANativeWindow> mNativeWindow;
     int32_t mWidth, mHeight;
     int32_t mCropLeft, mCropTop, mCropRight, mCropBottom;
@@ -27,6 +27,8 @@ namespace android {
 
 class DataSource;
 class MediaExtractor;
+struct MediaSource;
+class MetaData;
 
 struct StagefrightMetadataRetriever : public MediaMetadataRetrieverInterface {
     StagefrightMetadataRetriever();
@@ -41,6 +43,8 @@ struct StagefrightMetadataRetriever : public MediaMetadataRetrieverInterface {
     virtual status_t setDataSource(const sp<DataSource>& source);
 
     virtual VideoFrame *getFrameAtTime(int64_t timeUs, int option);
+    virtual status_t getFramesAtTimes(
+            const Vector<int64_t> &timesUs, int option, FrameSink *sink);
     virtual MediaAlbumArt *extractAlbumArt();
     virtual const char *extractMetadata(int keyCode);
 
@@ -54,6 +58,7 @@ private:
     MediaAlbumArt *mAlbumArt;
 
     void parseMetaData();
+    sp<MediaSource> getVideoTrack(sp<MetaData> *trackMeta);
     // Delete album art and clear metadata.
     void clearMetadata();
 
@@ -25,6 +25,7 @@
 #include <media/stagefright/foundation/hexdump.h>
 #include <media/stagefright/DataSource.h>
 #include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaBufferGroup.h>
 #include <media/stagefright/MediaDefs.h>
 #include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/MediaSource.h>
@@ -36,9 +37,30 @@
 
 namespace android {
 
+// mkvparser reads EBML element headers a few bytes at a time; those small
+// reads are served from an aligned read-ahead buffer. Frame data and other
+// large reads go straight to the source.
 struct DataSourceReader : public mkvparser::IMkvReader {
+    enum {
+        kBufferSize = 64 * 1024,
+        kAlignment  = 4096,
+    };
+
     DataSourceReader(const sp<DataSource> &source)
-        : mSource(source) {
+        : mSource(source),
+          mBuffer(NULL),
+          mBufferPos(0),
+          mBufferLen(0) {
+        // Reading ahead could block at the live edge of a stream.
+        off64_t size;
+        if (mSource->getSize(&size) == OK) {
+            mBuffer = new uint8_t[kBufferSize];
+        }
+    }
+
+    virtual ~DataSourceReader() {
+        delete[] mBuffer;
+        mBuffer = NULL;
     }
 
     virtual int Read(long long position, long length, unsigned char* buffer) {
@@ -49,6 +71,27 @@ struct DataSourceReader : public mkvparser::IMkvReader {
             return 0;
         }
 
+        if (mBuffer != NULL && length <= kBufferSize / 2) {
+            Mutex::Autolock autoLock(mLock);
+
+            if (position < mBufferPos
+                    || position + length > mBufferPos + (off64_t)mBufferLen) {
+                off64_t start = position & ~((off64_t)kAlignment - 1);
+                ssize_t n = mSource->readAt(start, mBuffer, kBufferSize);
+                if (n <= 0 || start + n < position + length) {
+                    // near the end of the source, read directly
+                    mBufferLen = 0;
+                    n = mSource->readAt(position, buffer, length);
+                    return (n <= 0) ? -1 : 0;
+                }
+                mBufferPos = start;
+                mBufferLen = n;
+            }
+
+            memcpy(buffer, mBuffer + (position - mBufferPos), length);
+            return 0;
+        }
+
         ssize_t n = mSource->readAt(position, buffer, length);
 
         if (n <= 0) {
@@ -81,6 +124,12 @@ struct DataSourceReader : public mkvparser::IMkvReader {
 private:
     sp<DataSource> mSource;
 
+    // Frames are read outside of the extractor lock.
+    Mutex mLock;
+    uint8_t *mBuffer;
+    off64_t mBufferPos;
+    size_t mBufferLen;
+
     DataSourceReader(const DataSourceReader &);
     DataSourceReader &operator=(const DataSourceReader &);
 };
@@ -113,6 +162,12 @@ private:
 
     void advance_l();
 
+    // Moves to the first key frame of this track from the current position.
+    void seekToKeyFrame_l(int64_t seekTimeUs, bool isAudio, int64_t *actualFrameTimeUs);
+
+    // Finds the cluster to seek to when the file has no Cues.
+    bool seekWithoutCues_l(int64_t seekTimeNs);
+
     BlockIterator(const BlockIterator &);
     BlockIterator &operator=(const BlockIterator &);
 };
@@ -146,10 +201,17 @@ private:
     BlockIterator mBlockIter;
     size_t mNALSizeLen;  // for type AVC
 
+    enum {
+        kMaxPooledBuffers = 16,
+    };
+
     List<MediaBuffer *> mPendingFrames;
+    MediaBufferGroup *mBufferGroup;
 
     status_t advance();
 
+    MediaBuffer *allocateBuffer(size_t size);
+
     status_t readBlock();
     void clearPendingFrames();
 
@@ -213,7 +275,8 @@ MatroskaSource::MatroskaSource(
       mBlockIter(mExtractor.get(),
                  mExtractor->mTracks.itemAt(index).mTrackNum,
                  index),
-      mNALSizeLen(0) {
+      mNALSizeLen(0),
+      mBufferGroup(NULL) {
     sp<MetaData> meta = mExtractor->mTracks.itemAt(index).mMeta;
 
     const char *mime;
@@ -241,17 +304,27 @@ MatroskaSource::MatroskaSource(
 
 MatroskaSource::~MatroskaSource() {
     clearPendingFrames();
+
+    delete mBufferGroup;
+    mBufferGroup = NULL;
 }
 
 status_t MatroskaSource::start(MetaData * /* params */) {
     mBlockIter.reset();
 
+    if (mBufferGroup == NULL) {
+        mBufferGroup = new MediaBufferGroup(kMaxPooledBuffers);
+    }
+
     return OK;
 }
 
 status_t MatroskaSource::stop() {
     clearPendingFrames();
 
+    delete mBufferGroup;
+    mBufferGroup = NULL;
+
     return OK;
 }
 
@@ -401,14 +474,16 @@ void BlockIterator::seek(
                 break;
             }
         }
+    }
 
-        if (!pCues) {
-            ALOGE("No Cues in file");
+    if (!pCues) {
+        ALOGV("No Cues in file, seeking by cluster");
+        if (!seekWithoutCues_l(seekTimeNs)) {
+            ALOGE("Did not locate a cluster for seeking");
             return;
         }
-    }
-    else if (!pSH) {
-        ALOGE("No SeekHead");
+        mBlockEntryIndex = 0;
+        seekToKeyFrame_l(seekTimeUs, isAudio, actualFrameTimeUs);
         return;
     }
 
@@ -467,6 +542,42 @@ void BlockIterator::seek(
     CHECK_GT(pTP->m_block, 0);
     mBlockEntryIndex = pTP->m_block - 1;
 
+    seekToKeyFrame_l(seekTimeUs, isAudio, actualFrameTimeUs);
+}
+
+bool BlockIterator::seekWithoutCues_l(int64_t seekTimeNs) {
+    mkvparser::Segment* const pSegment = mExtractor->mSegment;
+
+    // Clusters are kept by the segment, so the ones loaded here serve later
+    // seeks on every track; only the cluster headers need to be parsed.
+    for (;;) {
+        const mkvparser::Cluster *last = pSegment->GetLast();
+        if (last != NULL && !last->EOS() && last->GetTime() > seekTimeNs) {
+            break;
+        }
+
+        long long pos;
+        long len;
+        if (pSegment->LoadCluster(pos, len) != 0) {
+            // no more clusters, or an error
+            break;
+        }
+    }
+
+    const mkvparser::Cluster *cluster = pSegment->FindCluster(seekTimeNs);
+    if (cluster == NULL || cluster->EOS()) {
+        return false;
+    }
+
+    mCluster = cluster;
+    return true;
+}
+
+void BlockIterator::seekToKeyFrame_l(
+        int64_t seekTimeUs, bool isAudio, int64_t *actualFrameTimeUs) {
+    const mkvparser::Track *thisTrack =
+            mExtractor->mSegment->GetTracks()->GetTrackByNumber(mTrackNum);
+
     for (;;) {
         advance_l();
 
@@ -511,6 +622,18 @@ void MatroskaSource::clearPendingFrames() {
     }
 }
 
+MediaBuffer *MatroskaSource::allocateBuffer(size_t size) {
+    MediaBuffer *buffer;
+    if (mBufferGroup == NULL
+            || mBufferGroup->acquire_buffer(&buffer, true /* nonBlocking */, size) != OK) {
+        // All pooled buffers are still out, e.g. queued at the decoder.
+        return new MediaBuffer(size);
+    }
+
+    buffer->set_range(0, size);
+    return buffer;
+}
+
 status_t MatroskaSource::readBlock() {
     CHECK(mPendingFrames.empty());
 
@@ -525,13 +648,15 @@ status_t MatroskaSource::readBlock() {
     for (int i = 0; i < block->GetFrameCount(); ++i) {
         const mkvparser::Block::Frame &frame = block->GetFrame(i);
 
-        MediaBuffer *mbuf = new MediaBuffer(frame.len);
+        MediaBuffer *mbuf = allocateBuffer(frame.len);
         mbuf->meta_data()->setInt64(kKeyTime, timeUs);
         mbuf->meta_data()->setInt32(kKeyIsSyncFrame, block->IsKey());
 
         long n = frame.Read(mExtractor->mReader, (unsigned char *)mbuf->data());
         if (n != 0) {
-            mPendingFrames.clear();
+            mbuf->release();
+            mbuf = NULL;
+            clearPendingFrames();
 
             mBlockIter.advance();
             return ERROR_IO;
@@ -657,7 +782,7 @@ status_t MatroskaSource::read(
         if (pass == 0) {
             dstSize = dstOffset;
 
-            buffer = new MediaBuffer(dstSize);
+            buffer = allocateBuffer(dstSize);
 
             int64_t timeUs;
             CHECK(frame->meta_data()->findInt64(kKeyTime, &timeUs));
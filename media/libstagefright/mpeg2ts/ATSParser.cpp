@@ -90,6 +90,9 @@ struct ATSParser::Program : public RefBase {
         return mParser->mFlags;
     }
 
+    // Set the bits of the elementary stream PIDs, see ATSParser::mPIDs.
+    void addStreamPIDs(uint32_t *pids) const;
+
 private:
     struct StreamInfo {
         unsigned mType;
@@ -242,6 +245,13 @@ bool ATSParser::Program::parsePSISection(
     return true;
 }
 
+void ATSParser::Program::addStreamPIDs(uint32_t *pids) const {
+    for (size_t i = 0; i < mStreams.size(); ++i) {
+        unsigned pid = mStreams.keyAt(i);
+        pids[pid >> 5] |= 1u << (pid & 31);
+    }
+}
+
 bool ATSParser::Program::parsePID(
         unsigned pid, unsigned continuity_counter,
         unsigned payload_unit_start_indicator,
@@ -717,8 +727,20 @@ status_t ATSParser::Stream::parse(
     }
 
     size_t neededSize = mBuffer->size() + payloadSizeBits / 8;
+    if (payload_unit_start_indicator && payloadSizeBits >= 48) {
+        // The buffer was just flushed, make room for the whole PES packet
+        // if its header tells the length.
+        const uint8_t *pes = br->data();
+        size_t PES_packet_length = (pes[4] << 8) | pes[5];
+        if (!memcmp(pes, "\x00\x00\x01", 3) && 6 + PES_packet_length > neededSize) {
+            neededSize = 6 + PES_packet_length;
+        }
+    }
     if (mBuffer->capacity() < neededSize) {
-        // Increment in multiples of 64K.
+        // Grow at least twofold, in multiples of 64K.
+        if (neededSize < 2 * mBuffer->capacity()) {
+            neededSize = 2 * mBuffer->capacity();
+        }
         neededSize = (neededSize + 65535) & ~65535;
 
         ALOGI("resizing buffer to %zu bytes", neededSize);
@@ -1160,6 +1182,7 @@ ATSParser::ATSParser(uint32_t flags)
       mTimeOffsetUs(0ll),
       mLastRecoveredPTS(-1ll),
       mNumTSPacketsParsed(0),
+      mPIDsValid(false),
       mNumPCRs(0) {
     mPSISections.add(0 /* PID */, new PSISection);
 }
@@ -1174,8 +1197,60 @@ status_t ATSParser::feedTSPacket(const void *data, size_t size,
         return BAD_VALUE;
     }
 
-    ABitReader br((const uint8_t *)data, kTSPacketSize);
-    return parseTS(&br, event);
+    return parseTS((const uint8_t *)data, event);
+}
+
+// Returns the first sync byte at or after ptr that is followed by another
+// one a packet later (or by the end of the data), or end if there is none.
+static const uint8_t *findTSPacketStart(const uint8_t *ptr, const uint8_t *end) {
+    while (end - ptr >= (ptrdiff_t)kTSPacketSize) {
+        const uint8_t *sync = (const uint8_t *)memchr(
+                ptr, 0x47, end - ptr - kTSPacketSize + 1);
+        if (sync == NULL) {
+            break;
+        }
+        if (sync + kTSPacketSize == end || sync[kTSPacketSize] == 0x47) {
+            return sync;
+        }
+        ptr = sync + 1;
+    }
+    return end;
+}
+
+status_t ATSParser::feedTSPackets(const void *data, size_t count) {
+    const uint8_t *ptr = (const uint8_t *)data;
+    const uint8_t *end = ptr + count * kTSPacketSize;
+
+    while (end - ptr >= (ptrdiff_t)kTSPacketSize) {
+        if (ptr[0] != 0x47) {
+            const uint8_t *next = findTSPacketStart(ptr + 1, end);
+            ALOGW("lost TS sync, skipping %zu bytes", (size_t)(next - ptr));
+            ptr = next;
+            continue;
+        }
+
+        status_t err = parseTS(ptr, NULL);
+        if (err != OK) {
+            return err;
+        }
+        ptr += kTSPacketSize;
+    }
+    return OK;
+}
+
+bool ATSParser::isPIDKnown(unsigned PID) {
+    if (!mPIDsValid) {
+        memset(mPIDs, 0, sizeof(mPIDs));
+        for (size_t i = 0; i < mPSISections.size(); ++i) {
+            unsigned pid = mPSISections.keyAt(i);
+            mPIDs[pid >> 5] |= 1u << (pid & 31);
+        }
+        for (size_t i = 0; i < mPrograms.size(); ++i) {
+            mPrograms.itemAt(i)->addStreamPIDs(mPIDs);
+        }
+        mPIDsValid = true;
+    }
+    return (mPIDs[PID >> 5] >> (PID & 31)) & 1;
 }
 
 void ATSParser::signalDiscontinuity(
@@ -1339,6 +1414,9 @@ status_t ATSParser::parsePID(
         }
         ABitReader sectionBits(section->data(), section->size());
 
+        // Programs, streams and PSI sections may come and go.
+        mPIDsValid = false;
+
         if (PID == 0) {
             parseProgramAssociationTable(&sectionBits);
         } else {
@@ -1452,48 +1530,57 @@ status_t ATSParser::parseAdaptationField(ABitReader *br, unsigned PID) {
     return OK;
 }
 
-status_t ATSParser::parseTS(ABitReader *br, SyncEvent *event) {
+status_t ATSParser::parseTS(const uint8_t *packet, SyncEvent *event) {
     ALOGV("---");
 
-    unsigned sync_byte = br->getBits(8);
+    // The 4 byte header is read directly, ABitReader takes over after it.
+    unsigned sync_byte = packet[0];
     if (sync_byte != 0x47u) {
         ALOGE("[error] parseTS: return error as sync_byte=0x%x", sync_byte);
         return BAD_VALUE;
     }
 
-    if (br->getBits(1)) {  // transport_error_indicator
+    if (packet[1] & 0x80) {  // transport_error_indicator
         // silently ignore.
         return OK;
     }
 
-    unsigned payload_unit_start_indicator = br->getBits(1);
+    unsigned payload_unit_start_indicator = (packet[1] >> 6) & 1;
     ALOGV("payload_unit_start_indicator = %u", payload_unit_start_indicator);
 
-    MY_LOGV("transport_priority = %u", br->getBits(1));
+    MY_LOGV("transport_priority = %u", (packet[1] >> 5) & 1);
 
-    unsigned PID = br->getBits(13);
+    unsigned PID = ((packet[1] & 0x1f) << 8) | packet[2];
     ALOGV("PID = 0x%04x", PID);
 
-    MY_LOGV("transport_scrambling_control = %u", br->getBits(2));
+    MY_LOGV("transport_scrambling_control = %u", packet[3] >> 6);
 
-    unsigned adaptation_field_control = br->getBits(2);
+    unsigned adaptation_field_control = (packet[3] >> 4) & 3;
     ALOGV("adaptation_field_control = %u", adaptation_field_control);
 
-    unsigned continuity_counter = br->getBits(4);
+    unsigned continuity_counter = packet[3] & 0x0f;
     ALOGV("PID = 0x%04x, continuity_counter = %u", PID, continuity_counter);
 
     // ALOGI("PID = 0x%04x, continuity_counter = %u", PID, continuity_counter);
 
     status_t err = OK;
 
-    if (adaptation_field_control == 2 || adaptation_field_control == 3) {
-        err = parseAdaptationField(br, PID);
-    }
-    if (err == OK) {
-        if (adaptation_field_control == 1 || adaptation_field_control == 3) {
-            err = parsePID(br, PID, continuity_counter,
+    // Nothing to do for the payload of an unknown PID, though its
+    // adaptation field may still carry the PCR.
+    bool hasPayload = (adaptation_field_control == 1 || adaptation_field_control == 3)
+            && isPIDKnown(PID);
+    if (hasPayload || adaptation_field_control >= 2) {
+        ABitReader br(packet + 4, kTSPacketSize - 4);
+
+        if (adaptation_field_control == 2 || adaptation_field_control == 3) {
+            err = parseAdaptationField(&br, PID);
+        }
+        if (err == OK && hasPayload) {
+            err = parsePID(&br, PID, continuity_counter,
                     payload_unit_start_indicator, event);
         }
+    } else if (adaptation_field_control == 1) {
+        ALOGV("PID 0x%04x not handled.", PID);
     }
 
     ++mNumTSPacketsParsed;
@@ -100,6 +100,13 @@ struct ATSParser : public RefBase {
     status_t feedTSPacket(
             const void *data, size_t size, SyncEvent *event = NULL);
 
+    // Feed count consecutive TS packets into the parser. Packets of PIDs
+    // that belong to no program or stream are skipped after their header,
+    // and if the sync byte is lost the parser resynchronizes on the next
+    // packet boundary within data. Parsing stops at the first error, which
+    // is returned.
+    status_t feedTSPackets(const void *data, size_t count);
+
     void signalDiscontinuity(
             DiscontinuityType type, const sp<AMessage> &extra);
 
@@ -158,6 +165,12 @@ private:
 
     size_t mNumTSPacketsParsed;
 
+    // One bit per PID that has a PSI section or an elementary stream,
+    // rebuilt after the PSI sections that can change them.
+    uint32_t mPIDs[8192 / 32];
+    bool mPIDsValid;
+    bool isPIDKnown(unsigned PID);
+
     void parseProgramAssociationTable(ABitReader *br);
     void parseProgramMap(ABitReader *br);
     // Parse PES packet where br is pointing to. If the PES contains a sync
@@ -177,8 +190,8 @@ private:
         SyncEvent *event);
 
     status_t parseAdaptationField(ABitReader *br, unsigned PID);
-    // see feedTSPacket().
-    status_t parseTS(ABitReader *br, SyncEvent *event);
+    // see feedTSPacket(). packet must hold kTSPacketSize bytes.
+    status_t parseTS(const uint8_t *packet, SyncEvent *event);
 
     void updatePCR(unsigned PID, uint64_t PCR, size_t byteOffsetFromStart);
 
@@ -38,8 +38,15 @@ namespace android {
 
 const int64_t kNearEOSMarkUs = 2000000ll; // 2 secs
 
+// Default limits, roughly a minute of high bitrate video.
+const size_t kDefaultMaxBufferedBytes = 16 * 1024 * 1024;
+const int64_t kDefaultMaxBufferedDurationUs = 60000000ll;
+
 AnotherPacketSource::AnotherPacketSource(const sp<MetaData> &meta)
-    : mIsAudio(false),
+    : mBufferedBytes(0),
+      mMaxBufferedBytes(kDefaultMaxBufferedBytes),
+      mMaxBufferedDurationUs(kDefaultMaxBufferedDurationUs),
+      mIsAudio(false),
       mIsVideo(false),
       mEnabled(true),
       mFormat(NULL),
@@ -121,8 +128,7 @@ status_t AnotherPacketSource::dequeueAccessUnit(sp<ABuffer> *buffer) {
     }
 
     if (!mBuffers.empty()) {
-        *buffer = *mBuffers.begin();
-        mBuffers.erase(mBuffers.begin());
+        *buffer = popBuffer_l();
 
         int32_t discontinuity;
         if ((*buffer)->meta()->findInt32("discontinuity", &discontinuity)) {
@@ -159,7 +165,7 @@ status_t AnotherPacketSource::dequeueAccessUnit(sp<ABuffer> *buffer) {
 void AnotherPacketSource::requeueAccessUnit(const sp<ABuffer> &buffer) {
     // TODO: update corresponding book keeping info.
     Mutex::Autolock autoLock(mLock);
-    mBuffers.push_front(buffer);
+    pushBuffer_l(buffer, true /* front */);
 }
 
 status_t AnotherPacketSource::read(
@@ -173,8 +179,7 @@ status_t AnotherPacketSource::read(
 
     if (!mBuffers.empty()) {
 
-        const sp<ABuffer> buffer = *mBuffers.begin();
-        mBuffers.erase(mBuffers.begin());
+        const sp<ABuffer> buffer = popBuffer_l();
 
         int32_t discontinuity;
         if (buffer->meta()->findInt32("discontinuity", &discontinuity)) {
@@ -244,7 +249,7 @@ void AnotherPacketSource::queueAccessUnit(const sp<ABuffer> &buffer) {
     }
 
     Mutex::Autolock autoLock(mLock);
-    mBuffers.push_back(buffer);
+    pushBuffer_l(buffer);
     mCondition.signal();
 
     int32_t discontinuity;
@@ -296,6 +301,7 @@ void AnotherPacketSource::clear() {
     Mutex::Autolock autoLock(mLock);
 
     mBuffers.clear();
+    mBufferedBytes = 0;
     mEOSResult = OK;
 
     mDiscontinuitySegments.clear();
@@ -320,6 +326,7 @@ void AnotherPacketSource::queueDiscontinuity(
             int32_t oldDiscontinuityType;
             if (!oldBuffer->meta()->findInt32(
                         "discontinuity", &oldDiscontinuityType)) {
+                mBufferedBytes -= GetFootprint(oldBuffer);
                 it = mBuffers.erase(it);
                 continue;
             }
@@ -350,7 +357,7 @@ void AnotherPacketSource::queueDiscontinuity(
     buffer->meta()->setInt32("discontinuity", static_cast<int32_t>(type));
     buffer->meta()->setMessage("extra", extra);
 
-    mBuffers.push_back(buffer);
+    pushBuffer_l(buffer);
     mCondition.signal();
 }
 
@@ -411,9 +418,12 @@ size_t AnotherPacketSource::getAvailableBufferCount(status_t *finalResult) {
 int64_t AnotherPacketSource::getBufferedDurationUs(status_t *finalResult) {
     Mutex::Autolock autoLock(mLock);
     *finalResult = mEOSResult;
+    return getBufferedDurationUs_l();
+}
 
+int64_t AnotherPacketSource::getBufferedDurationUs_l() const {
     int64_t durationUs = 0;
-    for (List<DiscontinuitySegment>::iterator it = mDiscontinuitySegments.begin();
+    for (List<DiscontinuitySegment>::const_iterator it = mDiscontinuitySegments.begin();
             it != mDiscontinuitySegments.end();
             ++it) {
         const DiscontinuitySegment &seg = *it;
@@ -425,6 +435,58 @@ int64_t AnotherPacketSource::getBufferedDurationUs(status_t *finalResult) {
     return durationUs;
 }
 
+size_t AnotherPacketSource::getBufferedBytes() {
+    Mutex::Autolock autoLock(mLock);
+    return mBufferedBytes;
+}
+
+void AnotherPacketSource::setBufferLimits(size_t maxBytes, int64_t maxDurationUs) {
+    Mutex::Autolock autoLock(mLock);
+    mMaxBufferedBytes = maxBytes;
+    mMaxBufferedDurationUs = maxDurationUs;
+}
+
+bool AnotherPacketSource::isFull() {
+    Mutex::Autolock autoLock(mLock);
+    if (mMaxBufferedBytes > 0 && mBufferedBytes >= mMaxBufferedBytes) {
+        return true;
+    }
+    return mMaxBufferedDurationUs > 0
+            && getBufferedDurationUs_l() >= mMaxBufferedDurationUs;
+}
+
+// static
+size_t AnotherPacketSource::GetFootprint(const sp<ABuffer> &buffer) {
+    // Every access unit carries an ABuffer and an AMessage for its meta,
+    // which outweigh the payload of small audio frames.
+    return buffer->capacity() + sizeof(ABuffer) + sizeof(AMessage);
+}
+
+void AnotherPacketSource::pushBuffer_l(const sp<ABuffer> &buffer, bool front) {
+    if (front) {
+        mBuffers.push_front(buffer);
+    } else {
+        mBuffers.push_back(buffer);
+    }
+    mBufferedBytes += GetFootprint(buffer);
+}
+
+sp<ABuffer> AnotherPacketSource::popBuffer_l() {
+    sp<ABuffer> buffer = *mBuffers.begin();
+    mBuffers.erase(mBuffers.begin());
+    mBufferedBytes -= GetFootprint(buffer);
+    return buffer;
+}
+
+List<sp<ABuffer> >::iterator AnotherPacketSource::eraseBuffers_l(
+        List<sp<ABuffer> >::iterator first,
+        List<sp<ABuffer> >::iterator last) {
+    for (List<sp<ABuffer> >::iterator it = first; it != last; ++it) {
+        mBufferedBytes -= GetFootprint(*it);
+    }
+    return mBuffers.erase(first, last);
+}
+
 status_t AnotherPacketSource::nextBufferTime(int64_t *timeUs) {
     *timeUs = 0;
 
@@ -544,7 +606,7 @@ void AnotherPacketSource::trimBuffersAfterMeta(
         newLastQueuedTimeUs = curTime.mTimeUs;
     }
 
-    mBuffers.erase(it, mBuffers.end());
+    eraseBuffers_l(it, mBuffers.end());
     mLatestEnqueuedMeta = newLatestEnqueuedMeta;
     mLastQueuedTimeUs = newLastQueuedTimeUs;
 
@@ -614,7 +676,7 @@ sp<AMessage> AnotherPacketSource::trimBuffersBeforeMeta(
             break;
         }
     }
-    mBuffers.erase(mBuffers.begin(), it);
+    eraseBuffers_l(mBuffers.begin(), it);
     mLatestDequeuedMeta = NULL;
 
     // CHECK(!mDiscontinuitySegments.empty());
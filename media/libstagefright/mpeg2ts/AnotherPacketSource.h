@@ -57,6 +57,16 @@ struct AnotherPacketSource : public MediaSource {
     // presentation timestamps since the last discontinuity (if any).
     int64_t getBufferedDurationUs(status_t *finalResult);
 
+    // Returns the memory held by queued access units, including the
+    // ABuffer and metadata overhead of each one.
+    size_t getBufferedBytes();
+
+    // Limits how much the source should hold, either limit may be 0 to
+    // disable it. Enqueueing never blocks or drops data, producers are
+    // expected to stop feeding while isFull() returns true.
+    void setBufferLimits(size_t maxBytes, int64_t maxDurationUs);
+    bool isFull();
+
     status_t nextBufferTime(int64_t *timeUs);
 
     void queueAccessUnit(const sp<ABuffer> &buffer);
@@ -108,6 +118,10 @@ private:
     Mutex mLock;
     Condition mCondition;
 
+    size_t mBufferedBytes;
+    size_t mMaxBufferedBytes;
+    int64_t mMaxBufferedDurationUs;
+
     bool mIsAudio;
     bool mIsVideo;
     bool mEnabled;
@@ -120,6 +134,14 @@ private:
 
     bool wasFormatChange(int32_t discontinuityType) const;
 
+    static size_t GetFootprint(const sp<ABuffer> &buffer);
+    void pushBuffer_l(const sp<ABuffer> &buffer, bool front = false);
+    sp<ABuffer> popBuffer_l();
+    List<sp<ABuffer> >::iterator eraseBuffers_l(
+            List<sp<ABuffer> >::iterator first,
+            List<sp<ABuffer> >::iterator last);
+    int64_t getBufferedDurationUs_l() const;
+
     DISALLOW_EVIL_CONSTRUCTORS(AnotherPacketSource);
 };
 
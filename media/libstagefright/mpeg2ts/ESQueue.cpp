@@ -40,6 +40,7 @@ ElementaryStreamQueue::ElementaryStreamQueue(Mode mode, uint32_t flags)
     : mMode(mode),
       mFlags(flags),
       mEOSReached(false) {
+    resetNALScan();
 }
 
 sp<MetaData> ElementaryStreamQueue::getFormat() {
@@ -48,8 +49,9 @@ sp<MetaData> ElementaryStreamQueue::getFormat() {
 
 void ElementaryStreamQueue::clear(bool clearFormat) {
     if (mBuffer != NULL) {
-        mBuffer->setRange(0, 0);
+        rewindBuffer();
     }
+    resetNALScan();
 
     mRangeInfos.clear();
 
@@ -429,7 +431,9 @@ status_t ElementaryStreamQueue::appendData(
     }
 
     size_t neededSize = (mBuffer == NULL ? 0 : mBuffer->size()) + size;
-    if (mBuffer == NULL || neededSize > mBuffer->capacity()) {
+    if (mBuffer == NULL || neededSize > mBuffer->capacity()
+            || (mBuffer->offset() + neededSize > mBuffer->capacity()
+                && isBufferShared())) {
         neededSize = (neededSize + 65535) & ~65535;
 
         ALOGV("resizing buffer to size %zu", neededSize);
@@ -443,6 +447,11 @@ status_t ElementaryStreamQueue::appendData(
         }
 
         mBuffer = buffer;
+    } else if (mBuffer->offset() + neededSize > mBuffer->capacity()) {
+        // Reclaim the space of the access units consumed so far. This moves
+        // the remaining data once per buffer full rather than per access unit.
+        memmove(mBuffer->base(), mBuffer->data(), mBuffer->size());
+        mBuffer->setRange(0, mBuffer->size());
     }
 
     memcpy(mBuffer->data() + mBuffer->size(), data, size);
@@ -463,6 +472,84 @@ status_t ElementaryStreamQueue::appendData(
     return OK;
 }
 
+sp<ABuffer> ElementaryStreamQueue::takeAccessUnit(size_t offset, size_t size) {
+    return mBuffer->slice(offset, size);
+}
+
+sp<ABuffer> ElementaryStreamQueue::allocateAccessUnit(size_t size) {
+    static const size_t kMaxPooledAccessUnits = 32;
+
+    ssize_t freeIndex = -1;
+    for (size_t i = 0; i < mAccessUnitPool.size(); ++i) {
+        const sp<ABuffer> &buffer = mAccessUnitPool.itemAt(i);
+        if (buffer->getStrongCount() > 1) {
+            // still queued or being decoded
+            continue;
+        }
+
+        // The meta may have been handed out on its own, e.g. as the
+        // latest enqueued meta of a packet source.
+        sp<AMessage> meta = buffer->meta();
+        if (meta->getStrongCount() > 2) {
+            continue;
+        }
+
+        // don't waste more than half of a recycled buffer
+        if (buffer->capacity() >= size && buffer->capacity() / 2 <= size) {
+            meta->clear();
+            buffer->setInt32Data(0);
+            buffer->setRange(0, size);
+            return buffer;
+        }
+        freeIndex = i;
+    }
+
+    sp<ABuffer> buffer = new ABuffer(size);
+    if (mAccessUnitPool.size() < kMaxPooledAccessUnits) {
+        mAccessUnitPool.push(buffer);
+    } else if (freeIndex >= 0) {
+        // replace an idle buffer of the wrong size
+        mAccessUnitPool.editItemAt(freeIndex) = buffer;
+    }
+    return buffer;
+}
+
+// Slices hold a reference to mBuffer, so a count above one means that some
+// consumed bytes are still in use. It can only drop behind our back.
+bool ElementaryStreamQueue::isBufferShared() const {
+    return mBuffer->getStrongCount() > 1;
+}
+
+// Drops all buffered data. The space is only reused if no slice needs it.
+void ElementaryStreamQueue::rewindBuffer() {
+    if (isBufferShared()) {
+        mBuffer = new ABuffer(mBuffer->capacity());
+    }
+    mBuffer->setRange(0, 0);
+}
+
+void ElementaryStreamQueue::consume(size_t size) {
+    mBuffer->setRange(mBuffer->offset() + size, mBuffer->size() - size);
+    if (mBuffer->size() == 0) {
+        if (isBufferShared()) {
+            // keep appending behind the handed out access units
+            mBuffer->setRange(mBuffer->offset(), 0);
+        } else {
+            mBuffer->setRange(0, 0);
+        }
+    }
+    resetNALScan();
+}
+
+void ElementaryStreamQueue::resetNALScan() {
+    mScanNALs.clear();
+    mScanOffset = 0;
+    mScanTotalSize = 0;
+    mScanSEICount = 0;
+    mScanFoundSlice = false;
+    mScanFoundIDR = false;
+}
+
 sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnit() {
     if ((mFlags & kFlag_AlignedData) && mMode == H264) {
         if (mRangeInfos.empty()) {
@@ -472,15 +559,10 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnit() {
         RangeInfo info = *mRangeInfos.begin();
         mRangeInfos.erase(mRangeInfos.begin());
 
-        sp<ABuffer> accessUnit = new ABuffer(info.mLength);
-        memcpy(accessUnit->data(), mBuffer->data(), info.mLength);
+        sp<ABuffer> accessUnit = takeAccessUnit(0, info.mLength);
         accessUnit->meta()->setInt64("timeUs", info.mTimestampUs);
 
-        memmove(mBuffer->data(),
-                mBuffer->data() + info.mLength,
-                mBuffer->size() - info.mLength);
-
-        mBuffer->setRange(0, mBuffer->size() - info.mLength);
+        consume(info.mLength);
 
         if (mFormat == NULL) {
             mFormat = MakeAVCCodecSpecificData(accessUnit);
@@ -541,7 +623,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitAC3() {
         mFormat = format;
     }
 
-    sp<ABuffer> accessUnit = new ABuffer(syncStartPos + payloadSize);
+    sp<ABuffer> accessUnit = allocateAccessUnit(syncStartPos + payloadSize);
     memcpy(accessUnit->data(), mBuffer->data(), syncStartPos + payloadSize);
 
     int64_t timeUs = fetchTimestamp(syncStartPos + payloadSize);
@@ -552,12 +634,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitAC3() {
     accessUnit->meta()->setInt64("timeUs", timeUs);
     accessUnit->meta()->setInt32("isSync", 1);
 
-    memmove(
-            mBuffer->data(),
-            mBuffer->data() + syncStartPos + payloadSize,
-            mBuffer->size() - syncStartPos - payloadSize);
-
-    mBuffer->setRange(0, mBuffer->size() - syncStartPos - payloadSize);
+    consume(syncStartPos + payloadSize);
 
     return accessUnit;
 }
@@ -603,7 +680,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitPCMAudio() {
         return NULL;
     }
 
-    sp<ABuffer> accessUnit = new ABuffer(payloadSize);
+    sp<ABuffer> accessUnit = allocateAccessUnit(payloadSize);
     memcpy(accessUnit->data(), mBuffer->data() + 4, payloadSize);
 
     int64_t timeUs = fetchTimestamp(payloadSize + 4);
@@ -619,12 +696,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitPCMAudio() {
         ptr[i] = ntohs(ptr[i]);
     }
 
-    memmove(
-            mBuffer->data(),
-            mBuffer->data() + 4 + payloadSize,
-            mBuffer->size() - 4 - payloadSize);
-
-    mBuffer->setRange(0, mBuffer->size() - 4 - payloadSize);
+    consume(4 + payloadSize);
 
     return accessUnit;
 }
@@ -737,12 +809,10 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitAAC() {
 
     int64_t timeUs = fetchTimestamp(offset);
 
-    sp<ABuffer> accessUnit = new ABuffer(offset);
+    sp<ABuffer> accessUnit = allocateAccessUnit(offset);
     memcpy(accessUnit->data(), mBuffer->data(), offset);
 
-    memmove(mBuffer->data(), mBuffer->data() + offset,
-            mBuffer->size() - offset);
-    mBuffer->setRange(0, mBuffer->size() - offset);
+    consume(offset);
 
     accessUnit->meta()->setInt64("timeUs", timeUs);
     accessUnit->meta()->setInt32("isSync", 1);
@@ -786,19 +856,20 @@ int64_t ElementaryStreamQueue::fetchTimestamp(size_t size) {
 }
 
 sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitH264() {
-    const uint8_t *data = mBuffer->data();
+    // Pick up the scan where the previous call ran out of data.
+    const uint8_t *data = mBuffer->data() + mScanOffset;
 
-    size_t size = mBuffer->size();
-    Vector<NALPosition> nals;
+    size_t size = mBuffer->size() - mScanOffset;
+    Vector<NALPosition> &nals = mScanNALs;
 
-    size_t totalSize = 0;
-    size_t seiCount = 0;
+    size_t &totalSize = mScanTotalSize;
+    size_t &seiCount = mScanSEICount;
 
     status_t err;
     const uint8_t *nalStart;
     size_t nalSize;
-    bool foundSlice = false;
-    bool foundIDR = false;
+    bool &foundSlice = mScanFoundSlice;
+    bool &foundIDR = mScanFoundIDR;
     while ((err = getNextNALUnit(&data, &size, &nalStart, &nalSize)) == OK) {
         if (nalSize == 0) continue;
 
@@ -836,7 +907,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitH264() {
             // the current one, separated by 0x00 0x00 0x00 0x01 startcodes.
 
             size_t auSize = 4 * nals.size() + totalSize;
-            sp<ABuffer> accessUnit = new ABuffer(auSize);
+            sp<ABuffer> accessUnit = allocateAccessUnit(auSize);
             sp<ABuffer> sei;
 
             if (seiCount > 0) {
@@ -890,11 +961,8 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitH264() {
             const NALPosition &pos = nals.itemAt(nals.size() - 1);
             size_t nextScan = pos.nalOffset + pos.nalSize;
 
-            memmove(mBuffer->data(),
-                    mBuffer->data() + nextScan,
-                    mBuffer->size() - nextScan);
-
-            mBuffer->setRange(0, mBuffer->size() - nextScan);
+            bool isSync = foundIDR;
+            consume(nextScan);
 
             int64_t timeUs = fetchTimestamp(nextScan);
             if (timeUs < 0ll) {
@@ -903,7 +971,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitH264() {
             }
 
             accessUnit->meta()->setInt64("timeUs", timeUs);
-            if (foundIDR) {
+            if (isSync) {
                 accessUnit->meta()->setInt32("isSync", 1);
             }
 
@@ -921,6 +989,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitH264() {
         nals.push(pos);
 
         totalSize += nalSize;
+        mScanOffset = data - mBuffer->data();
     }
     if (err != (status_t)-EAGAIN) {
         ALOGE("Unexpeted err");
@@ -955,14 +1024,9 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGAudio() {
 
     unsigned layer = 4 - ((header >> 17) & 3);
 
-    sp<ABuffer> accessUnit = new ABuffer(frameSize);
-    memcpy(accessUnit->data(), data, frameSize);
+    sp<ABuffer> accessUnit = takeAccessUnit(0, frameSize);
 
-    memmove(mBuffer->data(),
-            mBuffer->data() + frameSize,
-            mBuffer->size() - frameSize);
-
-    mBuffer->setRange(0, mBuffer->size() - frameSize);
+    consume(frameSize);
 
     int64_t timeUs = fetchTimestamp(frameSize);
     if (timeUs < 0ll) {
@@ -1067,11 +1131,11 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
         currentStartCode = data[offset + 3];
 
         if (currentStartCode == 0xb3 && mFormat == NULL) {
-            memmove(mBuffer->data(), mBuffer->data() + offset, size - offset);
+            consume(offset);
+            data = mBuffer->data();
             size -= offset;
             (void)fetchTimestamp(offset);
             offset = 0;
-            mBuffer->setRange(0, size);
         }
 
         if ((prevStartCode == 0xb3 && currentStartCode != 0xb5)
@@ -1100,11 +1164,8 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
                 sp<ABuffer> csd = new ABuffer(offset);
                 memcpy(csd->data(), data, offset);
 
-                memmove(mBuffer->data(),
-                        mBuffer->data() + offset,
-                        mBuffer->size() - offset);
-
-                mBuffer->setRange(0, mBuffer->size() - offset);
+                consume(offset);
+                data = mBuffer->data();
                 size -= offset;
                 (void)fetchTimestamp(offset);
                 offset = 0;
@@ -1132,14 +1193,9 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
             if (!sawPictureStart) {
                 sawPictureStart = true;
             } else {
-                sp<ABuffer> accessUnit = new ABuffer(offset);
-                memcpy(accessUnit->data(), data, offset);
+                sp<ABuffer> accessUnit = takeAccessUnit(0, offset);
 
-                memmove(mBuffer->data(),
-                        mBuffer->data() + offset,
-                        mBuffer->size() - offset);
-
-                mBuffer->setRange(0, mBuffer->size() - offset);
+                consume(offset);
 
                 int64_t timeUs = fetchTimestamp(offset);
                 if (timeUs < 0ll) {
@@ -1313,12 +1369,11 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEG4Video() {
 
                     offset += chunkSize;
 
-                    sp<ABuffer> accessUnit = new ABuffer(offset);
-                    memcpy(accessUnit->data(), data, offset);
+                    sp<ABuffer> accessUnit = takeAccessUnit(0, offset);
 
-                    memmove(data, &data[offset], size - offset);
+                    consume(offset);
+                    data = mBuffer->data();
                     size -= offset;
-                    mBuffer->setRange(0, size);
 
                     int64_t timeUs = fetchTimestamp(offset);
                     if (timeUs < 0ll) {
@@ -1354,10 +1409,10 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEG4Video() {
 
         if (discard) {
             (void)fetchTimestamp(offset);
-            memmove(data, &data[offset], size - offset);
+            consume(offset);
+            data = mBuffer->data();
             size -= offset;
             offset = 0;
-            mBuffer->setRange(0, size);
         } else {
             offset += chunkSize;
         }
@@ -1384,12 +1439,11 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMetadata() {
         return NULL;
     }
 
-    sp<ABuffer> accessUnit = new ABuffer(size);
+    sp<ABuffer> accessUnit = takeAccessUnit(0, size);
     int64_t timeUs = fetchTimestamp(size);
     accessUnit->meta()->setInt64("timeUs", timeUs);
 
-    memcpy(accessUnit->data(), mBuffer->data(), size);
-    mBuffer->setRange(0, 0);
+    consume(size);
 
     if (mFormat == NULL) {
         mFormat = new MetaData;
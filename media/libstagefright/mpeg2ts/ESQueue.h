@@ -22,6 +22,9 @@
 #include <utils/Errors.h>
 #include <utils/List.h>
 #include <utils/RefBase.h>
+#include <utils/Vector.h>
+
+#include "include/avc_utils.h"
 
 namespace android {
 
@@ -64,11 +67,30 @@ private:
     uint32_t mFlags;
     bool mEOSReached;
 
+    // Dequeued data is dropped from the front by advancing the range
+    // offset, appendData() reclaims the space when it runs out. Access
+    // units are handed out as slices of mBuffer where possible, so its
+    // consumed space is only reused once no slice refers to it anymore.
     sp<ABuffer> mBuffer;
     List<RangeInfo> mRangeInfos;
 
+    // State of the incremental NAL unit scan in dequeueAccessUnitH264(),
+    // so that the NAL units of an incomplete access unit are not searched
+    // again on every call. Offsets are relative to mBuffer->data().
+    Vector<NALPosition> mScanNALs;
+    size_t mScanOffset;
+    size_t mScanTotalSize;
+    size_t mScanSEICount;
+    bool mScanFoundSlice;
+    bool mScanFoundIDR;
+
     sp<MetaData> mFormat;
 
+    // Access units that had to be copied out of mBuffer. Once the consumer
+    // has released one (we hold the only reference), its memory is reused
+    // for a later access unit instead of going back to the heap.
+    Vector<sp<ABuffer> > mAccessUnitPool;
+
     sp<ABuffer> dequeueAccessUnitH264();
     sp<ABuffer> dequeueAccessUnitAAC();
     sp<ABuffer> dequeueAccessUnitAC3();
@@ -82,6 +104,19 @@ private:
     // returns its timestamp in us (or -1 if no time information).
     int64_t fetchTimestamp(size_t size);
 
+    // Returns size bytes at offset of mBuffer's range as a new buffer.
+    sp<ABuffer> takeAccessUnit(size_t offset, size_t size);
+
+    // Returns an empty access unit of the given size, from the pool if
+    // possible.
+    sp<ABuffer> allocateAccessUnit(size_t size);
+    bool isBufferShared() const;
+    void rewindBuffer();
+
+    // Drop the first size bytes of mBuffer, this invalidates the NAL scan.
+    void consume(size_t size);
+    void resetNALScan();
+
     DISALLOW_EVIL_CONSTRUCTORS(ElementaryStreamQueue);
 };
 
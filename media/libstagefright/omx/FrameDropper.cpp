@@ -28,7 +28,8 @@ static const int64_t kMaxJitterUs = 2000;
 
 FrameDropper::FrameDropper()
     : mDesiredMinTimeUs(-1),
-      mMinIntervalUs(0) {
+      mMinIntervalUs(0),
+      mMaxPendingFrames(0) {
 }
 
 FrameDropper::~FrameDropper() {
@@ -70,4 +71,18 @@ bool FrameDropper::shouldDrop(int64_t timeUs) {
     return false;
 }
 
+void FrameDropper::setMaxPendingFrames(size_t maxPendingFrames) {
+    mMaxPendingFrames = maxPendingFrames;
+}
+
+bool FrameDropper::shouldDropForBacklog(size_t numPendingFrames) {
+    if (mMaxPendingFrames == 0 || numPendingFrames <= mMaxPendingFrames) {
+        return false;
+    }
+
+    ALOGV("drop frame, %zu frames pending (max %zu)",
+            numPendingFrames, mMaxPendingFrames);
+    return true;
+}
+
 }  // namespace android
@@ -35,12 +35,21 @@ struct FrameDropper : public RefBase {
     // Returns false if max frame rate has not been set via setMaxFrameRate.
     bool shouldDrop(int64_t timeUs);
 
+    // Frames queued behind the current one beyond maxPendingFrames mean the
+    // encoder is falling behind; 0 disables backlog-based dropping.
+    void setMaxPendingFrames(size_t maxPendingFrames);
+
+    // Returns true if more than the max pending frames are waiting behind the
+    // current frame, so that it can be skipped in favor of a newer one.
+    bool shouldDropForBacklog(size_t numPendingFrames);
+
 protected:
     virtual ~FrameDropper();
 
 private:
     int64_t mDesiredMinTimeUs;
     int64_t mMinIntervalUs;
+    size_t mMaxPendingFrames;
 
     DISALLOW_EVIL_CONSTRUCTORS(FrameDropper);
 };
@@ -39,6 +39,11 @@ namespace android {
 
 static const bool EXTRA_CHECK = true;
 
+// Once frame dropping is enabled, frames are also skipped whenever more than
+// this many newer frames are already waiting in the BufferQueue, so that a
+// slow encoder catches up to the producer instead of holding it back.
+static const size_t kMaxPendingFramesBeforeDrop = 2;
+
 GraphicBufferSource::PersistentProxyListener::PersistentProxyListener(
         const wp<IGraphicBufferConsumer> &consumer,
         const wp<ConsumerListener>& consumerListener) :
@@ -408,7 +413,10 @@ void GraphicBufferSource::codecBufferEmptied(OMX_BUFFERHEADERTYPE* header, int f
         CHECK(!mEndOfStreamSent);
         ALOGV("buffer freed, %zu frames avail (eos=%d)",
                 mNumFramesAvailable, mEndOfStream);
-        fillCodecBuffer_l();
+        // A dropped frame does not use up the codec buffer, so keep going
+        // until one is submitted.
+        while (mNumFramesAvailable > 0 && fillCodecBuffer_l()) {
+        }
     } else if (mEndOfStream) {
         // No frames available, but EOS is pending, so use this buffer to
         // send that.
@@ -546,7 +554,14 @@ bool GraphicBufferSource::fillCodecBuffer_l() {
         }
 
         int64_t timeUs = item.mTimestamp / 1000;
-        if (mFrameDropper != NULL && mFrameDropper->shouldDrop(timeUs)) {
+        if (mFrameDropper != NULL
+                && mFrameDropper->shouldDropForBacklog(mNumFramesAvailable)) {
+            ALOGV("skipping frame (%lld), encoder is %zu frames behind",
+                    static_cast<long long>(timeUs), mNumFramesAvailable);
+            // set err to OK so that the skipped frame can still be saved as the lastest frame
+            err = OK;
+            dropped = true;
+        } else if (mFrameDropper != NULL && mFrameDropper->shouldDrop(timeUs)) {
             ALOGV("skipping frame (%lld) to meet max framerate", static_cast<long long>(timeUs));
             // set err to OK so that the skipped frame can still be saved as the lastest frame
             err = OK;
@@ -896,7 +911,10 @@ void GraphicBufferSource::onFrameAvailable(const BufferItem& /*item*/) {
     ++mRepeatLastFrameGeneration;
 
     if (mExecuting) {
-        fillCodecBuffer_l();
+        // Submit to every free codec buffer, so that the encoder can work on
+        // as many frames as it has input buffers for.
+        while (mNumFramesAvailable > 0 && fillCodecBuffer_l()) {
+        }
     }
 }
 
@@ -963,6 +981,7 @@ status_t GraphicBufferSource::setMaxFps(float maxFps) {
         mFrameDropper.clear();
         return err;
     }
+    mFrameDropper->setMaxPendingFrames(kMaxPendingFramesBeforeDrop);
 
     return OK;
 }
@@ -21,6 +21,7 @@
 #include <utils/Log.h>
 
 #include <dlfcn.h>
+#include <unistd.h>
 
 #include "../include/OMX.h"
 
@@ -28,6 +29,7 @@
 
 #include <binder/IMemory.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <utils/String8.h>
 #include <utils/threads.h>
 
 #include "OMXMaster.h"
@@ -194,6 +196,23 @@ void OMX::binderDied(const wp<IBinder> &the_late_who) {
     instance->onObserverDied(mMaster);
 }
 
+status_t OMX::dump(int fd, const Vector<String16> & /* args */) {
+    String8 result;
+
+    {
+        // nodes invalidate their ID under mLock before they go away
+        Mutex::Autolock autoLock(mLock);
+
+        result.appendFormat(" OMX nodes: %zu\n", mNodeIDToInstance.size());
+        for (size_t i = 0; i < mNodeIDToInstance.size(); ++i) {
+            mNodeIDToInstance.valueAt(i)->dump(result);
+        }
+    }
+
+    write(fd, result.string(), result.size());
+    return OK;
+}
+
 bool OMX::isSecure(node_id node) {
     OMXNodeInstance *instance = findInstance(node);
     return (instance == NULL ? false : instance->isSecure());
@@ -264,7 +283,7 @@ status_t OMX::allocateNode(
 }
 
 status_t OMX::freeNode(node_id node) {
-    OMXNodeInstance *instance = findInstance(node);
+    OMXNodeInstance *instance = findInstanceForClient(node);
 
     {
         Mutex::Autolock autoLock(mLock);
@@ -293,14 +312,14 @@ status_t OMX::freeNode(node_id node) {
 
 status_t OMX::sendCommand(
         node_id node, OMX_COMMANDTYPE cmd, OMX_S32 param) {
-    return findInstance(node)->sendCommand(cmd, param);
+    return findInstanceForClient(node)->sendCommand(cmd, param);
 }
 
 status_t OMX::getParameter(
         node_id node, OMX_INDEXTYPE index,
         void *params, size_t size) {
     ALOGV("getParameter(%u %#x %p %zd)", node, index, params, size);
-    return findInstance(node)->getParameter(
+    return findInstanceForClient(node)->getParameter(
             index, params, size);
 }
 
@@ -308,84 +327,84 @@ status_t OMX::setParameter(
         node_id node, OMX_INDEXTYPE index,
         const void *params, size_t size) {
     ALOGV("setParameter(%u %#x %p %zd)", node, index, params, size);
-    return findInstance(node)->setParameter(
+    return findInstanceForClient(node)->setParameter(
             index, params, size);
 }
 
 status_t OMX::getConfig(
         node_id node, OMX_INDEXTYPE index,
         void *params, size_t size) {
-    return findInstance(node)->getConfig(
+    return findInstanceForClient(node)->getConfig(
             index, params, size);
 }
 
 status_t OMX::setConfig(
         node_id node, OMX_INDEXTYPE index,
         const void *params, size_t size) {
-    return findInstance(node)->setConfig(
+    return findInstanceForClient(node)->setConfig(
             index, params, size);
 }
 
 status_t OMX::getState(
         node_id node, OMX_STATETYPE* state) {
-    return findInstance(node)->getState(
+    return findInstanceForClient(node)->getState(
             state);
 }
 
 status_t OMX::enableGraphicBuffers(
         node_id node, OMX_U32 port_index, OMX_BOOL enable) {
-    return findInstance(node)->enableGraphicBuffers(port_index, enable);
+    return findInstanceForClient(node)->enableGraphicBuffers(port_index, enable);
 }
 
 status_t OMX::getGraphicBufferUsage(
         node_id node, OMX_U32 port_index, OMX_U32* usage) {
-    return findInstance(node)->getGraphicBufferUsage(port_index, usage);
+    return findInstanceForClient(node)->getGraphicBufferUsage(port_index, usage);
 }
 
 status_t OMX::storeMetaDataInBuffers(
         node_id node, OMX_U32 port_index, OMX_BOOL enable, MetadataBufferType *type) {
-    return findInstance(node)->storeMetaDataInBuffers(port_index, enable, type);
+    return findInstanceForClient(node)->storeMetaDataInBuffers(port_index, enable, type);
 }
 
 status_t OMX::prepareForAdaptivePlayback(
         node_id node, OMX_U32 portIndex, OMX_BOOL enable,
         OMX_U32 maxFrameWidth, OMX_U32 maxFrameHeight) {
-    return findInstance(node)->prepareForAdaptivePlayback(
+    return findInstanceForClient(node)->prepareForAdaptivePlayback(
             portIndex, enable, maxFrameWidth, maxFrameHeight);
 }
 
 status_t OMX::configureVideoTunnelMode(
         node_id node, OMX_U32 portIndex, OMX_BOOL tunneled,
         OMX_U32 audioHwSync, native_handle_t **sidebandHandle) {
-    return findInstance(node)->configureVideoTunnelMode(
+    return findInstanceForClient(node)->configureVideoTunnelMode(
             portIndex, tunneled, audioHwSync, sidebandHandle);
 }
 
 status_t OMX::useBuffer(
         node_id node, OMX_U32 port_index, const sp<IMemory> &params,
         buffer_id *buffer, OMX_U32 allottedSize) {
-    return findInstance(node)->useBuffer(
+    return findInstanceForClient(node)->useBuffer(
             port_index, params, buffer, allottedSize);
 }
 
 status_t OMX::useGraphicBuffer(
         node_id node, OMX_U32 port_index,
         const sp<GraphicBuffer> &graphicBuffer, buffer_id *buffer) {
-    return findInstance(node)->useGraphicBuffer(
+    return findInstanceForClient(node)->useGraphicBuffer(
             port_index, graphicBuffer, buffer);
 }
 
 status_t OMX::updateGraphicBufferInMeta(
         node_id node, OMX_U32 port_index,
         const sp<GraphicBuffer> &graphicBuffer, buffer_id buffer) {
-    return findInstance(node)->updateGraphicBufferInMeta(
+    return findInstanceForClient(node)->updateGraphicBufferInMeta(
             port_index, graphicBuffer, buffer);
 }
 
 status_t OMX::createInputSurface(
         node_id node, OMX_U32 port_index,
         sp<IGraphicBufferProducer> *bufferProducer, MetadataBufferType *type) {
-    return findInstance(node)->createInputSurface(
+    return findInstanceForClient(node)->createInputSurface(
             port_index, bufferProducer, type);
 }
 
@@ -399,35 +418,35 @@ status_t OMX::createPersistentInputSurface(
 status_t OMX::setInputSurface(
         node_id node, OMX_U32 port_index,
         const sp<IGraphicBufferConsumer> &bufferConsumer, MetadataBufferType *type) {
-    return findInstance(node)->setInputSurface(port_index, bufferConsumer, type);
+    return findInstanceForClient(node)->setInputSurface(port_index, bufferConsumer, type);
 }
 
 
 status_t OMX::signalEndOfInputStream(node_id node) {
-    return findInstance(node)->signalEndOfInputStream();
+    return findInstanceForClient(node)->signalEndOfInputStream();
 }
 
 status_t OMX::allocateBuffer(
         node_id node, OMX_U32 port_index, size_t size,
         buffer_id *buffer, void **buffer_data) {
-    return findInstance(node)->allocateBuffer(
+    return findInstanceForClient(node)->allocateBuffer(
             port_index, size, buffer, buffer_data);
 }
 
 status_t OMX::allocateBufferWithBackup(
         node_id node, OMX_U32 port_index, const sp<IMemory> &params,
         buffer_id *buffer, OMX_U32 allottedSize) {
-    return findInstance(node)->allocateBufferWithBackup(
+    return findInstanceForClient(node)->allocateBufferWithBackup(
             port_index, params, buffer, allottedSize);
 }
 
 status_t OMX::freeBuffer(node_id node, OMX_U32 port_index, buffer_id buffer) {
-    return findInstance(node)->freeBuffer(
+    return findInstanceForClient(node)->freeBuffer(
             port_index, buffer);
 }
 
 status_t OMX::fillBuffer(node_id node, buffer_id buffer, int fenceFd) {
-    return findInstance(node)->fillBuffer(buffer, fenceFd);
+    return findInstanceForClient(node)->fillBuffer(buffer, fenceFd);
 }
 
 status_t OMX::emptyBuffer(
@@ -435,7 +454,7 @@ status_t OMX::emptyBuffer(
         buffer_id buffer,
         OMX_U32 range_offset, OMX_U32 range_length,
         OMX_U32 flags, OMX_TICKS timestamp, int fenceFd) {
-    return findInstance(node)->emptyBuffer(
+    return findInstanceForClient(node)->emptyBuffer(
             buffer, range_offset, range_length, flags, timestamp, fenceFd);
 }
 
@@ -443,7 +462,7 @@ status_t OMX::getExtensionIndex(
         node_id node,
         const char *parameter_name,
         OMX_INDEXTYPE *index) {
-    return findInstance(node)->getExtensionIndex(
+    return findInstanceForClient(node)->getExtensionIndex(
             parameter_name, index);
 }
 
@@ -453,7 +472,11 @@ status_t OMX::setInternalOption(
         InternalOptionType type,
         const void *data,
         size_t size) {
-    return findInstance(node)->setInternalOption(port_index, type, data, size);
+    return findInstanceForClient(node)->setInternalOption(port_index, type, data, size);
+}
+
+status_t OMX::createMessageRing(node_id node, sp<IMemory> *memory) {
+    return findInstanceForClient(node)->createMessageRing(memory);
 }
 
 OMX_ERRORTYPE OMX::OnEvent(
@@ -554,6 +577,15 @@ OMXNodeInstance *OMX::findInstance(node_id node) {
     return index < 0 ? NULL : mNodeIDToInstance.valueAt(index);
 }
 
+// Also runs what the client has queued on the message ring before the call.
+OMXNodeInstance *OMX::findInstanceForClient(node_id node) {
+    OMXNodeInstance *instance = findInstance(node);
+    if (instance != NULL) {
+        instance->runQueuedCommands();
+    }
+    return instance;
+}
+
 sp<OMX::CallbackDispatcher> OMX::findDispatcher(node_id node) {
     Mutex::Autolock autoLock(mLock);
 
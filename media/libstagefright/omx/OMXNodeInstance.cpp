@@ -34,6 +34,7 @@
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/MediaErrors.h>
+#include <private/media/OMXMessageRing.h>
 
 #include <utils/misc.h>
 
@@ -116,25 +117,28 @@ struct BufferMeta {
           mIsBackup(false) {
     }
 
-    void CopyFromOMX(const OMX_BUFFERHEADERTYPE *header) {
+    // these return the number of bytes copied
+    size_t CopyFromOMX(const OMX_BUFFERHEADERTYPE *header) {
         if (!mIsBackup) {
-            return;
+            return 0;
         }
 
         // check component returns proper range
         sp<ABuffer> codec = getBuffer(header, false /* backup */, true /* limit */);
 
         memcpy((OMX_U8 *)mMem->pointer() + header->nOffset, codec->data(), codec->size());
+        return codec->size();
     }
 
-    void CopyToOMX(const OMX_BUFFERHEADERTYPE *header) {
+    size_t CopyToOMX(const OMX_BUFFERHEADERTYPE *header) {
         if (!mIsBackup) {
-            return;
+            return 0;
         }
 
         memcpy(header->pBuffer + header->nOffset,
                 (const OMX_U8 *)mMem->pointer() + header->nOffset,
                 header->nFilledLen);
+        return header->nFilledLen;
     }
 
     // return either the codec or the backup buffer
@@ -191,6 +195,7 @@ OMXNodeInstance::OMXNodeInstance(
       mHandle(NULL),
       mObserver(observer),
       mDying(false),
+      mCommandRingFailed(false),
       mBufferIDCount(0)
 {
     mName = ADebug::GetDebugName(name);
@@ -201,6 +206,8 @@ OMXNodeInstance::OMXNodeInstance(
     mNumPortBuffers[1] = 0;
     mDebugLevelBumpPendingBuffers[0] = 0;
     mDebugLevelBumpPendingBuffers[1] = 0;
+    mBytesCopied[0] = 0;
+    mBytesCopied[1] = 0;
     mMetadataType[0] = kMetadataBufferTypeInvalid;
     mMetadataType[1] = kMetadataBufferTypeInvalid;
     mIsSecure = AString(name).endsWith(".secure");
@@ -265,6 +272,8 @@ status_t OMXNodeInstance::freeNode(OMXMaster *master) {
         return OK;
     }
 
+    stopMessageRing();
+
     // Transition the node from its current state all the way down
     // to "Loaded".
     // This ensures that all active buffers are properly freed even
@@ -1139,12 +1148,25 @@ status_t OMXNodeInstance::emptyBuffer(
         header->nFilledLen = rangeLength;
         header->nOffset = rangeOffset;
 
-        buffer_meta->CopyToOMX(header);
+        size_t copied = buffer_meta->CopyToOMX(header);
+        if (copied > 0) {
+            Mutex::Autolock _l(mDebugLock);
+            mBytesCopied[kPortIndexInput] += copied;
+        }
     }
 
     return emptyBuffer_l(header, flags, timestamp, (intptr_t)buffer, fenceFd);
 }
 
+void OMXNodeInstance::dump(String8 &result) {
+    Mutex::Autolock _l(mDebugLock);
+    result.appendFormat("  node %#x %s: buffers %zu/%zu, %zu/%zu with codec,"
+            " backup copies %" PRIu64 "/%" PRIu64 " bytes\n",
+            mNodeID, mName, mNumPortBuffers[kPortIndexInput], mNumPortBuffers[kPortIndexOutput],
+            mInputBuffersWithCodec.size(), mOutputBuffersWithCodec.size(),
+            mBytesCopied[kPortIndexInput], mBytesCopied[kPortIndexOutput]);
+}
+
 // log queued buffer activity for the next few input and/or output frames
 // if logging at internal state level
 void OMXNodeInstance::bumpDebugLevel_l(size_t numInputBuffers, size_t numOutputBuffers) {
@@ -1405,7 +1427,11 @@ bool OMXNodeInstance::handleMessage(omx_message &msg) {
             CLOG_ERROR(onFillBufferDone, OMX_ErrorBadParameter,
                     FULL_BUFFER(NULL, buffer, msg.fenceFd));
         }
-        buffer_meta->CopyFromOMX(buffer);
+        size_t copied = buffer_meta->CopyFromOMX(buffer);
+        if (copied > 0) {
+            Mutex::Autolock _l(mDebugLock);
+            mBytesCopied[kPortIndexOutput] += copied;
+        }
 
         if (bufferSource != NULL) {
             // fix up the buffer info (especially timestamp) if needed
@@ -1448,11 +1474,137 @@ void OMXNodeInstance::onMessages(std::list<omx_message> &messages) {
         }
     }
 
+    sp<OMXMessageRing> eventRing;
+    {
+        Mutex::Autolock autoLock(mEventRingLock);
+        eventRing = mEventRing;
+    }
+
+    // Queue the buffer done messages on the ring, up to the first one that cannot go
+    // there. The client handles the ring before the rest.
+    if (eventRing != NULL) {
+        OMXMessageRing::Entry entry;
+        while (!messages.empty()
+                && OMXMessageRing::MessageToEntry(messages.front(), &entry)
+                && eventRing->write(entry)) {
+            messages.pop_front();
+        }
+    }
+
     if (!messages.empty()) {
         mObserver->onMessages(messages);
     }
 }
 
+struct OMXNodeInstance::CommandThread : public Thread {
+    CommandThread(OMXNodeInstance *instance)
+        : Thread(false /* canCallJava */),
+          mInstance(instance) {
+    }
+
+private:
+    OMXNodeInstance *mInstance;
+
+    virtual bool threadLoop() {
+        if (!mInstance->mCommandRing->wait()) {
+            return false;
+        }
+        mInstance->runQueuedCommands();
+        return true;
+    }
+
+    DISALLOW_EVIL_CONSTRUCTORS(CommandThread);
+};
+
+status_t OMXNodeInstance::createMessageRing(sp<IMemory> *memory) {
+    Mutex::Autolock autoLock(mMessageRingLock);
+
+    if (mCommandRing != NULL) {
+        return ALREADY_EXISTS;
+    }
+
+    sp<IMemory> shared = OMXMessageRing::Allocate();
+    if (shared == NULL) {
+        return NO_MEMORY;
+    }
+
+    mCommandRing = new OMXMessageRing(shared, OMXMessageRing::kCommands);
+    mCommandThread = new CommandThread(this);
+    status_t err = mCommandThread->run("OMXCommandRing", ANDROID_PRIORITY_FOREGROUND);
+    if (err != OK) {
+        mCommandThread.clear();
+        mCommandRing.clear();
+        return err;
+    }
+
+    {
+        Mutex::Autolock autoLock(mEventRingLock);
+        mEventRing = new OMXMessageRing(shared, OMXMessageRing::kEvents);
+    }
+
+    CLOG_CONFIG(createMessageRing, "size=%zu", shared->size());
+    *memory = shared;
+    return OK;
+}
+
+void OMXNodeInstance::runQueuedCommands() {
+    Mutex::Autolock autoLock(mMessageRingLock);
+
+    if (mCommandRing == NULL || mCommandRingFailed) {
+        return;
+    }
+
+    OMXMessageRing::Entry entries[16];
+    ssize_t n;
+    while ((n = mCommandRing->read(entries, NELEM(entries))) > 0) {
+        for (ssize_t i = 0; i < n; ++i) {
+            const OMXMessageRing::Entry &entry = entries[i];
+            status_t err = BAD_VALUE;
+            if (findBufferHeader(entry.mBuffer) == NULL) {
+                // not one of ours, already logged
+            } else if (entry.mType == OMXMessageRing::kEmptyBuffer) {
+                err = emptyBuffer(entry.mBuffer, entry.mRangeOffset, entry.mRangeLength,
+                        entry.mFlags, entry.mTimestamp, -1 /* fenceFd */);
+            } else if (entry.mType == OMXMessageRing::kFillBuffer) {
+                err = fillBuffer(entry.mBuffer, -1 /* fenceFd */);
+            }
+
+            // the client is not waiting for a result, report it like a codec error
+            if (err != OK) {
+                CLOGW("queued command %#x on buffer %#x failed: %d",
+                        entry.mType, entry.mBuffer, err);
+                mOwner->OnEvent(mNodeID, OMX_EventError, OMX_ErrorUndefined, 0, NULL);
+            }
+        }
+    }
+
+    if (n < 0) {
+        CLOGW("command ring failed: %zd", n);
+        mCommandRingFailed = true;
+        mOwner->OnEvent(mNodeID, OMX_EventError, OMX_ErrorUndefined, 0, NULL);
+    }
+}
+
+void OMXNodeInstance::stopMessageRing() {
+    sp<CommandThread> thread;
+    {
+        Mutex::Autolock autoLock(mMessageRingLock);
+        if (mCommandRing == NULL) {
+            return;
+        }
+        mCommandRing->interrupt();
+        thread = mCommandThread;
+    }
+
+    // the thread takes mMessageRingLock
+    thread->requestExitAndWait();
+
+    {
+        Mutex::Autolock autoLock(mEventRingLock);
+        mEventRing.clear();
+    }
+}
+
 void OMXNodeInstance::onObserverDied(OMXMaster *master) {
     ALOGE("!!! Observer died. Quickly, do something, ... anything...");
 
@@ -94,7 +94,15 @@ bool SimpleSoftOMXComponent::isSetParameterAllowed(
         }
 
         default:
-            return false;
+        {
+            if (index < (OMX_INDEXTYPE)OMX_IndexVendorStartUnused) {
+                return false;
+            }
+
+            // the extension parameters of the components all start like OMX_PARAM_U32TYPE
+            portIndex = ((OMX_PARAM_U32TYPE *)params)->nPortIndex;
+            break;
+        }
     }
 
     CHECK(portIndex < mPorts.size());
@@ -189,6 +197,15 @@ OMX_ERRORTYPE SimpleSoftOMXComponent::useBuffer(
         OMX_U32 size,
         OMX_U8 *ptr) {
     Mutex::Autolock autoLock(mLock);
+    return internalUseBuffer(header, portIndex, appPrivate, size, ptr);
+}
+
+OMX_ERRORTYPE SimpleSoftOMXComponent::internalUseBuffer(
+        OMX_BUFFERHEADERTYPE **header,
+        OMX_U32 portIndex,
+        OMX_PTR appPrivate,
+        OMX_U32 size,
+        OMX_U8 *ptr) {
     CHECK_LT(portIndex, mPorts.size());
 
     *header = new OMX_BUFFERHEADERTYPE;
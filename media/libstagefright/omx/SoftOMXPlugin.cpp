@@ -21,10 +21,11 @@
 #include "SoftOMXPlugin.h"
 #include "include/SoftOMXComponent.h"
 
+#include <cutils/properties.h>
 #include <media/stagefright/foundation/ADebug.h>
-#include <media/stagefright/foundation/AString.h>
 
 #include <dlfcn.h>
+#include <stdlib.h>
 
 namespace android {
 
@@ -64,7 +65,63 @@ static const struct {
 static const size_t kNumComponents =
     sizeof(kComponents) / sizeof(kComponents[0]);
 
-SoftOMXPlugin::SoftOMXPlugin() {
+static String8 getLibName(const char *libNameSuffix) {
+    String8 libName("libstagefright_soft_");
+    libName.append(libNameSuffix);
+    libName.append(".so");
+    return libName;
+}
+
+SoftOMXPlugin::SoftOMXPlugin()
+    : mMaxWarmLibs(0) {
+    // Opt-in: "media.stagefright.soft-warm-libs" is the number of codec
+    // libraries to keep loaded once used, and "media.stagefright.soft-preload"
+    // a comma separated list of components whose libraries are loaded now.
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.stagefright.soft-warm-libs", value, NULL)) {
+        int maxWarmLibs = atoi(value);
+        if (maxWarmLibs > 0) {
+            mMaxWarmLibs = maxWarmLibs;
+        }
+    }
+
+    if (mMaxWarmLibs == 0
+            || !property_get("media.stagefright.soft-preload", value, NULL)) {
+        return;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+    char *savePtr;
+    for (char *name = strtok_r(value, ",", &savePtr); name != NULL;
+            name = strtok_r(NULL, ",", &savePtr)) {
+        for (size_t i = 0; i < kNumComponents; ++i) {
+            if (!strcmp(name, kComponents[i].mName)) {
+                keepWarm_l(getLibName(kComponents[i].mLibNameSuffix));
+                break;
+            }
+        }
+    }
+}
+
+SoftOMXPlugin::~SoftOMXPlugin() {
+    for (size_t i = 0; i < mWarmLibs.size(); ++i) {
+        dlclose(mWarmLibs.valueAt(i));
+    }
+}
+
+void SoftOMXPlugin::keepWarm_l(const String8 &libName) {
+    if (mWarmLibs.indexOfKey(libName) >= 0 || mWarmLibs.size() >= mMaxWarmLibs) {
+        return;
+    }
+
+    void *libHandle = dlopen(libName.string(), RTLD_NOW);
+    if (libHandle == NULL) {
+        ALOGW("unable to keep %s loaded: %s", libName.string(), dlerror());
+        return;
+    }
+
+    ALOGV("keeping %s loaded", libName.string());
+    mWarmLibs.add(libName, libHandle);
 }
 
 OMX_ERRORTYPE SoftOMXPlugin::makeComponentInstance(
@@ -79,18 +136,21 @@ OMX_ERRORTYPE SoftOMXPlugin::makeComponentInstance(
             continue;
         }
 
-        AString libName = "libstagefright_soft_";
-        libName.append(kComponents[i].mLibNameSuffix);
-        libName.append(".so");
+        String8 libName = getLibName(kComponents[i].mLibNameSuffix);
 
-        void *libHandle = dlopen(libName.c_str(), RTLD_NOW);
+        void *libHandle = dlopen(libName.string(), RTLD_NOW);
 
         if (libHandle == NULL) {
-            ALOGE("unable to dlopen %s: %s", libName.c_str(), dlerror());
+            ALOGE("unable to dlopen %s: %s", libName.string(), dlerror());
 
             return OMX_ErrorComponentNotFound;
         }
 
+        if (mMaxWarmLibs > 0) {
+            Mutex::Autolock autoLock(mLock);
+            keepWarm_l(libName);
+        }
+
         typedef SoftOMXComponent *(*CreateSoftOMXComponentFunc)(
                 const char *, const OMX_CALLBACKTYPE *,
                 OMX_PTR, OMX_COMPONENTTYPE **);
@@ -20,11 +20,15 @@
 
 #include <media/stagefright/foundation/ABase.h>
 #include <OMXPluginBase.h>
+#include <utils/KeyedVector.h>
+#include <utils/String8.h>
+#include <utils/threads.h>
 
 namespace android {
 
 struct SoftOMXPlugin : public OMXPluginBase {
     SoftOMXPlugin();
+    virtual ~SoftOMXPlugin();
 
     virtual OMX_ERRORTYPE makeComponentInstance(
             const char *name,
@@ -45,6 +49,14 @@ struct SoftOMXPlugin : public OMXPluginBase {
             Vector<String8> *roles);
 
 private:
+    // Codec libraries kept loaded after their last instance is destroyed, so
+    // that the next instance skips the dlopen. Holds our own dlopen handles.
+    Mutex mLock;
+    KeyedVector<String8, void *> mWarmLibs;
+    size_t mMaxWarmLibs;
+
+    void keepWarm_l(const String8 &libName);
+
     DISALLOW_EVIL_CONSTRUCTORS(SoftOMXPlugin);
 };
 
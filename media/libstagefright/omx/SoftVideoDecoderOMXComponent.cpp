@@ -22,15 +22,36 @@
 
 #include "include/SoftVideoDecoderOMXComponent.h"
 
+#include <hardware/gralloc.h>
 #include <media/hardware/HardwareAPI.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/foundation/AUtils.h>
 #include <media/stagefright/MediaDefs.h>
+#include <ui/Rect.h>
+
+#include <unistd.h>
 
 namespace android {
 
+// cores reserved by the decoder instances of this process, see acquireDecoderCores()
+static Mutex gDecoderCoresLock;
+static size_t gNumDecoderCoresInUse = 0;
+
+static size_t GetCPUCoreCount() {
+    long cpuCoreCount = 1;
+#if defined(_SC_NPROCESSORS_ONLN)
+    cpuCoreCount = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    // _SC_NPROC_ONLN must be defined...
+    cpuCoreCount = sysconf(_SC_NPROC_ONLN);
+#endif
+    CHECK(cpuCoreCount >= 1);
+    ALOGV("Number of CPU cores: %ld", cpuCoreCount);
+    return (size_t)cpuCoreCount;
+}
+
 template<class T>
 static void InitOMXParams(T *params) {
     params->nSize = sizeof(T);
@@ -64,12 +85,47 @@ SoftVideoDecoderOMXComponent::SoftVideoDecoderOMXComponent(
         mOutputPortSettingsChange(NONE),
         mMinInputBufferSize(384), // arbitrary, using one uncompressed macroblock
         mMinCompressionRatio(1),  // max input size is normally the output size
+        mNumDecoderThreads(0),
+        mNumReservedCores(0),
+        mSupportsNativeBuffers(false),
+        mNativeBuffersEnabled(false),
         mComponentRole(componentRole),
         mCodingType(codingType),
         mProfileLevels(profileLevels),
         mNumProfileLevels(numProfileLevels) {
 }
 
+SoftVideoDecoderOMXComponent::~SoftVideoDecoderOMXComponent() {
+    releaseDecoderCores();
+}
+
+size_t SoftVideoDecoderOMXComponent::acquireDecoderCores(size_t maxCores) {
+    Mutex::Autolock autoLock(gDecoderCoresLock);
+
+    gNumDecoderCoresInUse -= mNumReservedCores;
+
+    size_t numCores = mNumDecoderThreads;
+    if (numCores == 0) {
+        // leave the cores busy with other decoders alone instead of oversubscribing them
+        size_t numCPUCores = GetCPUCoreCount();
+        numCores = (gNumDecoderCoresInUse < numCPUCores)
+                ? numCPUCores - gNumDecoderCoresInUse : 1;
+    }
+    numCores = max(min(numCores, maxCores), (size_t)1);
+
+    mNumReservedCores = numCores;
+    gNumDecoderCoresInUse += numCores;
+    ALOGV("%zu decoder cores, %zu in use", numCores, gNumDecoderCoresInUse);
+    return numCores;
+}
+
+void SoftVideoDecoderOMXComponent::releaseDecoderCores() {
+    Mutex::Autolock autoLock(gDecoderCoresLock);
+
+    gNumDecoderCoresInUse -= mNumReservedCores;
+    mNumReservedCores = 0;
+}
+
 void SoftVideoDecoderOMXComponent::initPorts(
         OMX_U32 numInputBuffers,
         OMX_U32 inputBufferSize,
@@ -122,7 +178,7 @@ void SoftVideoDecoderOMXComponent::initPorts(
     def.format.video.xFramerate = 0;
     def.format.video.bFlagErrorConcealment = OMX_FALSE;
     def.format.video.eCompressionFormat = OMX_VIDEO_CodingUnused;
-    def.format.video.eColorFormat = OMX_COLOR_FormatYUV420Planar;
+    def.format.video.eColorFormat = outputColorFormat();
     def.format.video.pNativeWindow = NULL;
 
     addPort(def);
@@ -230,35 +286,162 @@ void SoftVideoDecoderOMXComponent::handlePortSettingsChange(
 void SoftVideoDecoderOMXComponent::copyYV12FrameToOutputBuffer(
         uint8_t *dst, const uint8_t *srcY, const uint8_t *srcU, const uint8_t *srcV,
         size_t srcYStride, size_t srcUStride, size_t srcVStride) {
-    size_t dstYStride = outputBufferWidth();
-    size_t dstUVStride = dstYStride / 2;
-    size_t dstHeight = outputBufferHeight();
-    uint8_t *dstStart = dst;
+    OutputPlanes planes;
+    planes.mYStride = outputBufferWidth();
+    planes.mUVStride = planes.mYStride / 2;
+    planes.mY = dst;
+    planes.mU = dst + planes.mYStride * outputBufferHeight();
+    planes.mV = planes.mU + planes.mUVStride * (outputBufferHeight() / 2);
+
+    copyYV12FrameToOutputPlanes(planes, srcY, srcU, srcV, srcYStride, srcUStride, srcVStride);
+}
 
+void SoftVideoDecoderOMXComponent::copyYV12FrameToOutputPlanes(
+        const OutputPlanes &planes,
+        const uint8_t *srcY, const uint8_t *srcU, const uint8_t *srcV,
+        size_t srcYStride, size_t srcUStride, size_t srcVStride) {
+    uint8_t *dst = planes.mY;
     for (size_t i = 0; i < mHeight; ++i) {
          memcpy(dst, srcY, mWidth);
          srcY += srcYStride;
-         dst += dstYStride;
+         dst += planes.mYStride;
     }
 
-    dst = dstStart + dstYStride * dstHeight;
+    dst = planes.mU;
     for (size_t i = 0; i < mHeight / 2; ++i) {
          memcpy(dst, srcU, mWidth / 2);
          srcU += srcUStride;
-         dst += dstUVStride;
+         dst += planes.mUVStride;
     }
 
-    dst = dstStart + (5 * dstYStride * dstHeight) / 4;
+    dst = planes.mV;
     for (size_t i = 0; i < mHeight / 2; ++i) {
          memcpy(dst, srcV, mWidth / 2);
          srcV += srcVStride;
-         dst += dstUVStride;
+         dst += planes.mUVStride;
+    }
+}
+
+bool SoftVideoDecoderOMXComponent::copyYV12FrameToOutputBuffer(
+        OMX_BUFFERHEADERTYPE *outHeader,
+        const uint8_t *srcY, const uint8_t *srcU, const uint8_t *srcV,
+        size_t srcYStride, size_t srcUStride, size_t srcVStride) {
+    OutputPlanes planes;
+    if (!lockOutputBuffer(outHeader, &planes)) {
+        return false;
+    }
+
+    copyYV12FrameToOutputPlanes(planes, srcY, srcU, srcV, srcYStride, srcUStride, srcVStride);
+
+    unlockOutputBuffer(outHeader);
+    return true;
+}
+
+void SoftVideoDecoderOMXComponent::supportNativeBuffers() {
+    mSupportsNativeBuffers = true;
+}
+
+OMX_COLOR_FORMATTYPE SoftVideoDecoderOMXComponent::outputColorFormat() const {
+    // the native window is allocated with the color format of the output port
+    return mNativeBuffersEnabled
+            ? (OMX_COLOR_FORMATTYPE)HAL_PIXEL_FORMAT_YV12 : OMX_COLOR_FormatYUV420Planar;
+}
+
+OMX_ERRORTYPE SoftVideoDecoderOMXComponent::useNativeBuffer(
+        const UseAndroidNativeBufferParams *params) {
+    if (!mNativeBuffersEnabled || params->nPortIndex != kOutputPortIndex) {
+        return OMX_ErrorUndefined;
+    }
+
+    sp<GraphicBuffer> graphicBuffer = new GraphicBuffer(params->nativeBuffer.get(), false);
+    if (graphicBuffer->getPixelFormat() != HAL_PIXEL_FORMAT_YV12) {
+        ALOGE("Unsupported native buffer format %#x", graphicBuffer->getPixelFormat());
+        return OMX_ErrorUnsupportedSetting;
+    }
+
+    PortInfo *port = editPortInfo(kOutputPortIndex);
+    if (port->mBuffers.isEmpty()) {
+        // the buffers of the previous allocation are all freed by now
+        mNativeBuffers.clear();
+    }
+
+    // the header points to the handle like for the useAndroidNativeBuffer2 extension
+    OMX_ERRORTYPE err = internalUseBuffer(
+            params->bufferHeader, kOutputPortIndex, params->pAppPrivate,
+            port->mDef.nBufferSize,
+            const_cast<OMX_U8 *>(reinterpret_cast<const OMX_U8 *>(graphicBuffer->handle)));
+    if (err != OMX_ErrorNone) {
+        return err;
+    }
+
+    mNativeBuffers.add(*params->bufferHeader, graphicBuffer);
+    return OMX_ErrorNone;
+}
+
+ssize_t SoftVideoDecoderOMXComponent::nativeBufferIndex(OMX_BUFFERHEADERTYPE *outHeader) const {
+    ssize_t index = mNativeBuffers.indexOfKey(outHeader);
+    if (index < 0 || !mNativeBuffersEnabled) {
+        return -1;
+    }
+
+    // the header may be a new byte buffer at the address of a freed one
+    const native_handle_t *handle = mNativeBuffers.valueAt(index)->handle;
+    return reinterpret_cast<const OMX_U8 *>(handle) == outHeader->pBuffer ? index : -1;
+}
+
+bool SoftVideoDecoderOMXComponent::lockOutputBuffer(
+        OMX_BUFFERHEADERTYPE *outHeader, OutputPlanes *planes) {
+    ssize_t index = nativeBufferIndex(outHeader);
+    if (index < 0) {
+        planes->mYStride = outputBufferWidth();
+        planes->mUVStride = planes->mYStride / 2;
+        planes->mY = outHeader->pBuffer;
+        planes->mU = planes->mY + planes->mYStride * outputBufferHeight();
+        planes->mV = planes->mU + planes->mUVStride * (outputBufferHeight() / 2);
+        return true;
+    }
+
+    const sp<GraphicBuffer> &graphicBuffer = mNativeBuffers.valueAt(index);
+    if (graphicBuffer->getWidth() < outputBufferWidth()
+            || graphicBuffer->getHeight() < outputBufferHeight()) {
+        ALOGE("Native buffer of %ux%u is too small for %ux%u",
+                graphicBuffer->getWidth(), graphicBuffer->getHeight(),
+                outputBufferWidth(), outputBufferHeight());
+        return false;
+    }
+
+    void *bits = NULL;
+    status_t err = graphicBuffer->lock(
+            GRALLOC_USAGE_SW_WRITE_OFTEN,
+            Rect(outputBufferWidth(), outputBufferHeight()), &bits);
+    if (err != OK) {
+        ALOGE("Unable to lock native buffer %p (%d)", graphicBuffer->handle, err);
+        return false;
+    }
+
+    // YV12 is Y, then Cr and Cb at half the stride rounded up to 16 bytes
+    size_t height = graphicBuffer->getHeight();
+    planes->mYStride = graphicBuffer->getStride();
+    planes->mUVStride = align(planes->mYStride / 2, 16);
+    planes->mY = (uint8_t *)bits;
+    planes->mV = planes->mY + planes->mYStride * height;
+    planes->mU = planes->mV + planes->mUVStride * (height / 2);
+    return true;
+}
+
+void SoftVideoDecoderOMXComponent::unlockOutputBuffer(OMX_BUFFERHEADERTYPE *outHeader) {
+    ssize_t index = nativeBufferIndex(outHeader);
+    if (index >= 0 && mNativeBuffers.valueAt(index)->unlock() != OK) {
+        ALOGE("Unable to unlock native buffer %p", mNativeBuffers.valueAt(index)->handle);
     }
 }
 
 OMX_ERRORTYPE SoftVideoDecoderOMXComponent::internalGetParameter(
         OMX_INDEXTYPE index, OMX_PTR params) {
-    switch (index) {
+    // Include extension index OMX_INDEXEXTTYPE.
+    const int32_t indexFull = index;
+
+    switch (indexFull) {
         case OMX_IndexParamVideoPortFormat:
         {
             OMX_VIDEO_PARAM_PORTFORMATTYPE *formatParams =
@@ -280,7 +463,7 @@ OMX_ERRORTYPE SoftVideoDecoderOMXComponent::internalGetParameter(
                 CHECK_EQ(formatParams->nPortIndex, 1u);
 
                 formatParams->eCompressionFormat = OMX_VIDEO_CodingUnused;
-                formatParams->eColorFormat = OMX_COLOR_FormatYUV420Planar;
+                formatParams->eColorFormat = outputColorFormat();
                 formatParams->xFramerate = 0;
             }
 
@@ -306,6 +489,32 @@ OMX_ERRORTYPE SoftVideoDecoderOMXComponent::internalGetParameter(
             return OMX_ErrorNone;
         }
 
+        case kDecoderThreadsIndex:
+        {
+            OMX_PARAM_U32TYPE *threadsParams = (OMX_PARAM_U32TYPE *)params;
+
+            if (threadsParams->nPortIndex != kOutputPortIndex) {
+                return OMX_ErrorUndefined;
+            }
+
+            threadsParams->nU32 = mNumDecoderThreads;
+            return OMX_ErrorNone;
+        }
+
+        case kGetNativeBufferUsageIndex:
+        {
+            GetAndroidNativeBufferUsageParams *usageParams =
+                (GetAndroidNativeBufferUsageParams *)params;
+
+            if (!mSupportsNativeBuffers || usageParams->nPortIndex != kOutputPortIndex) {
+                return OMX_ErrorUndefined;
+            }
+
+            // the frames are written by the CPU, see lockOutputBuffer()
+            usageParams->nUsage = GRALLOC_USAGE_SW_WRITE_OFTEN;
+            return OMX_ErrorNone;
+        }
+
         default:
             return SimpleSoftOMXComponent::internalGetParameter(index, params);
     }
@@ -351,7 +560,7 @@ OMX_ERRORTYPE SoftVideoDecoderOMXComponent::internalSetParameter(
                 }
             } else {
                 if (formatParams->eCompressionFormat != OMX_VIDEO_CodingUnused
-                        || formatParams->eColorFormat != OMX_COLOR_FormatYUV420Planar) {
+                        || formatParams->eColorFormat != outputColorFormat()) {
                     return OMX_ErrorUnsupportedSetting;
                 }
             }
@@ -377,6 +586,37 @@ OMX_ERRORTYPE SoftVideoDecoderOMXComponent::internalSetParameter(
             return OMX_ErrorNone;
         }
 
+        case kDecoderThreadsIndex:
+        {
+            const OMX_PARAM_U32TYPE *threadsParams = (const OMX_PARAM_U32TYPE *)params;
+
+            if (threadsParams->nPortIndex != kOutputPortIndex) {
+                return OMX_ErrorUndefined;
+            }
+
+            mNumDecoderThreads = threadsParams->nU32;
+            return OMX_ErrorNone;
+        }
+
+        case kEnableNativeBuffersIndex:
+        {
+            const EnableAndroidNativeBuffersParams *enableParams =
+                (const EnableAndroidNativeBuffersParams *)params;
+
+            if (!mSupportsNativeBuffers || enableParams->nPortIndex != kOutputPortIndex) {
+                return OMX_ErrorUndefined;
+            }
+
+            mNativeBuffersEnabled = enableParams->enable;
+            editPortInfo(kOutputPortIndex)->mDef.format.video.eColorFormat = outputColorFormat();
+            return OMX_ErrorNone;
+        }
+
+        case kUseNativeBufferIndex:
+        {
+            return useNativeBuffer((const UseAndroidNativeBufferParams *)params);
+        }
+
         case OMX_IndexParamPortDefinition:
         {
             OMX_PARAM_PORTDEFINITIONTYPE *newParams =
@@ -445,6 +685,28 @@ OMX_ERRORTYPE SoftVideoDecoderOMXComponent::getExtensionIndex(
         return OMX_ErrorNone;
     }
 
+    if (!strcmp(name, "OMX.google.android.index.decoderThreads")) {
+        *(int32_t*)index = kDecoderThreadsIndex;
+        return OMX_ErrorNone;
+    }
+
+    if (mSupportsNativeBuffers) {
+        if (!strcmp(name, "OMX.google.android.index.enableAndroidNativeBuffers")) {
+            *(int32_t*)index = kEnableNativeBuffersIndex;
+            return OMX_ErrorNone;
+        }
+
+        if (!strcmp(name, "OMX.google.android.index.getAndroidNativeBufferUsage")) {
+            *(int32_t*)index = kGetNativeBufferUsageIndex;
+            return OMX_ErrorNone;
+        }
+
+        if (!strcmp(name, "OMX.google.android.index.useAndroidNativeBuffer")) {
+            *(int32_t*)index = kUseNativeBufferIndex;
+            return OMX_ErrorNone;
+        }
+    }
+
     return SimpleSoftOMXComponent::getExtensionIndex(name, index);
 }
 
@@ -134,4 +134,16 @@ TEST_F(FrameDropperTest, TestVariableFps) {
     RunTest(testFramesVariableFps, ARRAY_SIZE(testFramesVariableFps));
 }
 
+TEST_F(FrameDropperTest, TestBacklog) {
+    EXPECT_FALSE(mFrameDropper->shouldDropForBacklog(10));
+
+    mFrameDropper->setMaxPendingFrames(2);
+    EXPECT_FALSE(mFrameDropper->shouldDropForBacklog(0));
+    EXPECT_FALSE(mFrameDropper->shouldDropForBacklog(2));
+    EXPECT_TRUE(mFrameDropper->shouldDropForBacklog(3));
+
+    mFrameDropper->setMaxPendingFrames(0);
+    EXPECT_FALSE(mFrameDropper->shouldDropForBacklog(3));
+}
+
 } // namespace android
@@ -159,8 +159,7 @@ bool AAVCAssembler::addSingleTimeAggregationPacket(const sp<ABuffer> &buffer) {
             return false;
         }
 
-        sp<ABuffer> unit = new ABuffer(nalSize);
-        memcpy(unit->data(), &data[2], nalSize);
+        sp<ABuffer> unit = buffer->slice(data + 2 - buffer->data(), nalSize);
 
         CopyTimes(unit, buffer);
 
@@ -212,7 +211,6 @@ ARTPAssembler::AssemblyStatus AAVCAssembler::addFragmentedNALUnit(
     uint32_t nri = (data[0] >> 5) & 3;
 
     uint32_t expectedSeqNo = (uint32_t)buffer->int32Data() + 1;
-    size_t totalSize = size - 2;
     size_t totalCount = 1;
     bool complete = false;
 
@@ -257,7 +255,6 @@ ARTPAssembler::AssemblyStatus AAVCAssembler::addFragmentedNALUnit(
                 return MALFORMED_PACKET;
             }
 
-            totalSize += size - 2;
             ++totalCount;
 
             expectedSeqNo = expectedSeqNo + 1;
@@ -279,60 +276,73 @@ ARTPAssembler::AssemblyStatus AAVCAssembler::addFragmentedNALUnit(
     mNextExpectedSeqNo = expectedSeqNo;
 
     // We found all the fragments that make up the complete NAL unit.
+    // Rather than gathering them into a buffer of their own, turn the FU
+    // header of the first fragment into the NAL unit header and queue the
+    // fragments as they are, submitAccessUnit() copies them straight into
+    // the access unit.
 
-    // Leave room for the header. So far totalSize did not include the
-    // header byte.
-    ++totalSize;
-
-    sp<ABuffer> unit = new ABuffer(totalSize);
-    CopyTimes(unit, *queue->begin());
-
-    unit->data()[0] = (nri << 5) | nalType;
-
-    size_t offset = 1;
     List<sp<ABuffer> >::iterator it = queue->begin();
     for (size_t i = 0; i < totalCount; ++i) {
-        const sp<ABuffer> &buffer = *it;
+        sp<ABuffer> buffer = *it;
 
         ALOGV("piece #%zu/%zu", i + 1, totalCount);
 #if !LOG_NDEBUG
         hexdump(buffer->data(), buffer->size());
 #endif
 
-        memcpy(unit->data() + offset, buffer->data() + 2, buffer->size() - 2);
-        offset += buffer->size() - 2;
-
         it = queue->erase(it);
-    }
 
-    unit->setRange(0, totalSize);
+        if (i == 0) {
+            buffer->data()[1] = (nri << 5) | nalType;
+            buffer->setRange(buffer->offset() + 1, buffer->size() - 1);
+
+            addSingleNALUnit(buffer);
+        } else {
+            buffer->setRange(buffer->offset() + 2, buffer->size() - 2);
+            buffer->meta()->setInt32("fu-continuation", true);
 
-    addSingleNALUnit(unit);
+            mNALUnits.push_back(buffer);
+        }
+    }
 
     ALOGV("successfully assembled a NAL unit from fragments.");
 
     return OK;
 }
 
+static bool IsFUContinuation(const sp<ABuffer> &buffer) {
+    int32_t continuation;
+    return buffer->meta()->findInt32("fu-continuation", &continuation)
+        && continuation;
+}
+
 void AAVCAssembler::submitAccessUnit() {
     CHECK(!mNALUnits.empty());
 
     ALOGV("Access unit complete (%zu nal units)", mNALUnits.size());
 
+    // Continuation fragments of a FU-A extend the NAL unit before them and
+    // get no start code of their own.
     size_t totalSize = 0;
     for (List<sp<ABuffer> >::iterator it = mNALUnits.begin();
          it != mNALUnits.end(); ++it) {
-        totalSize += 4 + (*it)->size();
+        if (!IsFUContinuation(*it)) {
+            totalSize += 4;
+        }
+        totalSize += (*it)->size();
     }
 
     sp<ABuffer> accessUnit = new ABuffer(totalSize);
     size_t offset = 0;
     for (List<sp<ABuffer> >::iterator it = mNALUnits.begin();
          it != mNALUnits.end(); ++it) {
-        memcpy(accessUnit->data() + offset, "\x00\x00\x00\x01", 4);
-        offset += 4;
-
         sp<ABuffer> nal = *it;
+
+        if (!IsFUContinuation(nal)) {
+            memcpy(accessUnit->data() + offset, "\x00\x00\x00\x01", 4);
+            offset += 4;
+        }
+
         memcpy(accessUnit->data() + offset, nal->data(), nal->size());
         offset += nal->size();
     }
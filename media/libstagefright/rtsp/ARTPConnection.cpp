@@ -32,11 +32,22 @@
 
 #include <arpa/inet.h>
 #include <sys/socket.h>
+#include <utils/Vector.h>
 
 namespace android {
 
 static const size_t kMaxUDPSize = 1500;
 
+// RTP packets are sized to fit the path MTU, a stream only switches to
+// buffers this large once it has sent a datagram that did not fit.
+static const size_t kMaxRTPPacketSize = 65536;
+
+// RTP packets taken from the kernel per recvmmsg() call
+static const size_t kMaxPacketsPerReceive = 16;
+
+// RTP packet buffers a stream reuses once the assemblers let go of them
+static const size_t kNumPooledPackets = 4 * kMaxPacketsPerReceive;
+
 static uint16_t u16at(const uint8_t *data) {
     return data[0] << 8 | data[1];
 }
@@ -65,6 +76,10 @@ struct ARTPConnection::StreamInfo {
     struct sockaddr_in mRemoteRTCPAddr;
 
     bool mIsInjected;
+
+    Vector<sp<ABuffer> > mPacketPool;
+    size_t mNextPooledPacket;
+    size_t mMaxPacketSize;
 };
 
 ARTPConnection::ARTPConnection(uint32_t flags)
@@ -205,6 +220,9 @@ void ARTPConnection::onAddStream(const sp<AMessage> &msg) {
     info->mNumRTPPacketsReceived = 0;
     memset(&info->mRemoteRTCPAddr, 0, sizeof(info->mRemoteRTCPAddr));
 
+    info->mNextPooledPacket = 0;
+    info->mMaxPacketSize = kMaxUDPSize;
+
     if (!injected) {
         postPollEvent();
     }
@@ -375,6 +393,10 @@ status_t ARTPConnection::receive(StreamInfo *s, bool receiveRTP) {
 
     CHECK(!s->mIsInjected);
 
+    if (receiveRTP) {
+        return receiveRTPPackets(s);
+    }
+
     sp<ABuffer> buffer = new ABuffer(65536);
 
     socklen_t remoteAddrLen =
@@ -410,6 +432,93 @@ status_t ARTPConnection::receive(StreamInfo *s, bool receiveRTP) {
     return err;
 }
 
+status_t ARTPConnection::receiveRTPPackets(StreamInfo *s) {
+    struct mmsghdr msgs[kMaxPacketsPerReceive];
+    struct iovec iovs[kMaxPacketsPerReceive];
+    sp<ABuffer> buffers[kMaxPacketsPerReceive];
+
+    for (size_t i = 0; i < kMaxPacketsPerReceive; ++i) {
+        buffers[i] = obtainRTPBuffer(s);
+
+        iovs[i].iov_base = buffers[i]->data();
+        iovs[i].iov_len = buffers[i]->capacity();
+
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    // select() reported at least one packet, take whatever else is already
+    // queued up without blocking.
+    int n;
+    do {
+        n = recvmmsg(
+                s->mRTPSocket, msgs, kMaxPacketsPerReceive, MSG_DONTWAIT,
+                NULL /* timeout */);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return OK;
+    }
+
+    if (n <= 0) {
+        return -ECONNRESET;
+    }
+
+    for (int i = 0; i < n; ++i) {
+        if (msgs[i].msg_len == 0) {
+            return -ECONNRESET;
+        }
+
+        if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+            if (s->mMaxPacketSize < kMaxRTPPacketSize) {
+                ALOGW("RTP packet exceeds %zu bytes, using larger buffers.",
+                      s->mMaxPacketSize);
+
+                s->mMaxPacketSize = kMaxRTPPacketSize;
+            }
+            continue;
+        }
+
+        buffers[i]->setRange(0, msgs[i].msg_len);
+
+        parseRTP(s, buffers[i]);
+    }
+
+    return OK;
+}
+
+sp<ABuffer> ARTPConnection::obtainRTPBuffer(StreamInfo *s) {
+    if (s->mPacketPool.size() < kNumPooledPackets) {
+        sp<ABuffer> buffer = new ABuffer(s->mMaxPacketSize);
+        s->mPacketPool.push_back(buffer);
+        return buffer;
+    }
+
+    for (size_t i = 0; i < kNumPooledPackets; ++i) {
+        size_t index = s->mNextPooledPacket;
+        s->mNextPooledPacket = (s->mNextPooledPacket + 1) % kNumPooledPackets;
+
+        // nothing but the pool refers to it any more
+        sp<ABuffer> &buffer = s->mPacketPool.editItemAt(index);
+        if (buffer->getStrongCount() == 1) {
+            if (buffer->capacity() < s->mMaxPacketSize) {
+                buffer = new ABuffer(s->mMaxPacketSize);
+            } else {
+                buffer->setRange(0, buffer->capacity());
+                buffer->meta()->clear();
+            }
+            return buffer;
+        }
+    }
+
+    // the assemblers hold on to all of them, replace the oldest
+    sp<ABuffer> buffer = new ABuffer(s->mMaxPacketSize);
+    s->mPacketPool.editItemAt(s->mNextPooledPacket) = buffer;
+    s->mNextPooledPacket = (s->mNextPooledPacket + 1) % kNumPooledPackets;
+    return buffer;
+}
+
 status_t ARTPConnection::parseRTP(StreamInfo *s, const sp<ABuffer> &buffer) {
     if (s->mNumRTPPacketsReceived++ == 0) {
         sp<AMessage> notify = s->mNotifyMsg->dup();
@@ -144,14 +144,25 @@ bool ARTPSource::queuePacket(const sp<ABuffer> &buffer) {
 
     buffer->setInt32Data(seqNum);
 
-    List<sp<ABuffer> >::iterator it = mQueue.begin();
-    while (it != mQueue.end() && (uint32_t)(*it)->int32Data() < seqNum) {
-        ++it;
-    }
+    // Packets almost always arrive in order, so look for the insertion point
+    // from the back of the queue. In-order packets are appended right away,
+    // reordered ones only walk back as far as they were overtaken.
+    List<sp<ABuffer> >::iterator it = mQueue.end();
+    while (it != mQueue.begin()) {
+        List<sp<ABuffer> >::iterator prev = it;
+        --prev;
+
+        uint32_t prevSeqNum = (uint32_t)(*prev)->int32Data();
+        if (prevSeqNum < seqNum) {
+            break;
+        }
+
+        if (prevSeqNum == seqNum) {
+            ALOGW("Discarding duplicate buffer");
+            return false;
+        }
 
-    if (it != mQueue.end() && (uint32_t)(*it)->int32Data() == seqNum) {
-        ALOGW("Discarding duplicate buffer");
-        return false;
+        it = prev;
     }
 
     mQueue.insert(it, buffer);
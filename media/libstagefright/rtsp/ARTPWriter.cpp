@@ -40,38 +40,79 @@ namespace android {
 // static const size_t kMaxPacketSize = 65507;  // maximum payload in UDP over IP
 static const size_t kMaxPacketSize = 1500;
 
+// where client 0 is sent to
+static const unsigned kDefaultRTPPort = 5634;
+
 static int UniformRand(int limit) {
     return ((double)rand() * limit) / RAND_MAX;
 }
 
+static void SetRTPHeader(uint8_t *data, uint16_t seqNo, uint32_t sourceID) {
+    data[2] = (seqNo >> 8) & 0xff;
+    data[3] = seqNo & 0xff;
+    data[8] = sourceID >> 24;
+    data[9] = (sourceID >> 16) & 0xff;
+    data[10] = (sourceID >> 8) & 0xff;
+    data[11] = sourceID & 0xff;
+}
+
+// Sets the SSRC of every packet in a compound RTCP packet.
+static void SetRTCPSourceIDs(const sp<ABuffer> &buffer, uint32_t sourceID) {
+    uint8_t *data = buffer->data();
+    size_t size = buffer->size();
+
+    while (size >= 8) {
+        data[4] = sourceID >> 24;
+        data[5] = (sourceID >> 16) & 0xff;
+        data[6] = (sourceID >> 8) & 0xff;
+        data[7] = sourceID & 0xff;
+
+        size_t length = 4 * ((data[2] << 8 | data[3]) + 1);
+        if (length > size) {
+            break;
+        }
+
+        data += length;
+        size -= length;
+    }
+}
+
 ARTPWriter::ARTPWriter(int fd)
     : mFlags(0),
       mFd(dup(fd)),
       mLooper(new ALooper),
-      mReflector(new AHandlerReflector<ARTPWriter>(this)) {
+      mReflector(new AHandlerReflector<ARTPWriter>(this)),
+      mNextClientID(0) {
     CHECK_GE(fd, 0);
 
     mLooper->setName("rtp writer");
     mLooper->registerHandler(mReflector);
     mLooper->start();
 
-    mSocket = socket(AF_INET, SOCK_DGRAM, 0);
-    CHECK_GE(mSocket, 0);
+    Client client;
+    client.mSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    CHECK_GE(client.mSocket, 0);
 
-    memset(mRTPAddr.sin_zero, 0, sizeof(mRTPAddr.sin_zero));
-    mRTPAddr.sin_family = AF_INET;
+    memset(client.mRTPAddr.sin_zero, 0, sizeof(client.mRTPAddr.sin_zero));
+    client.mRTPAddr.sin_family = AF_INET;
 
 #if 1
-    mRTPAddr.sin_addr.s_addr = INADDR_ANY;
+    client.mRTPAddr.sin_addr.s_addr = INADDR_ANY;
 #else
-    mRTPAddr.sin_addr.s_addr = inet_addr("172.19.18.246");
+    client.mRTPAddr.sin_addr.s_addr = inet_addr("172.19.18.246");
 #endif
 
-    mRTPAddr.sin_port = htons(5634);
-    CHECK_EQ(0, ntohs(mRTPAddr.sin_port) & 1);
+    client.mRTPAddr.sin_port = htons(kDefaultRTPPort);
+    CHECK_EQ(0, ntohs(client.mRTPAddr.sin_port) & 1);
+
+    client.mRTCPAddr = client.mRTPAddr;
+    client.mRTCPAddr.sin_port = htons(ntohs(client.mRTPAddr.sin_port) | 1);
+
+    client.mSeqNoOffset = 0;
+    client.mSourceIDMask = 0;
+    client.mNumPacketsDropped = 0;
 
-    mRTCPAddr = mRTPAddr;
-    mRTCPAddr.sin_port = htons(ntohs(mRTPAddr.sin_port) | 1);
+    mClients.add(mNextClientID++, client);
 
 #if LOG_TO_FILES
     mRTPFd = open(
@@ -97,8 +138,10 @@ ARTPWriter::~ARTPWriter() {
     mRTPFd = -1;
 #endif
 
-    close(mSocket);
-    mSocket = -1;
+    for (size_t i = 0; i < mClients.size(); ++i) {
+        close(mClients.valueAt(i).mSocket);
+    }
+    mClients.clear();
 
     close(mFd);
     mFd = -1;
@@ -173,6 +216,36 @@ status_t ARTPWriter::pause() {
     return OK;
 }
 
+status_t ARTPWriter::addClient(
+        const char *host, unsigned rtpPort, int32_t *clientID) {
+    sp<AMessage> msg = new AMessage(kWhatAddClient, mReflector);
+    msg->setString("host", host);
+    msg->setInt32("rtp-port", rtpPort);
+
+    sp<AMessage> response;
+    status_t err = msg->postAndAwaitResponse(&response);
+
+    if (err == OK && !response->findInt32("err", &err)) {
+        CHECK(response->findInt32("client-id", clientID));
+    }
+
+    return err;
+}
+
+status_t ARTPWriter::removeClient(int32_t clientID) {
+    sp<AMessage> msg = new AMessage(kWhatRemoveClient, mReflector);
+    msg->setInt32("client-id", clientID);
+
+    sp<AMessage> response;
+    status_t err = msg->postAndAwaitResponse(&response);
+
+    if (err == OK && !response->findInt32("err", &err)) {
+        err = OK;
+    }
+
+    return err;
+}
+
 static void StripStartcode(MediaBuffer *buffer) {
     if (buffer->range_length() < 4) {
         return;
@@ -258,6 +331,18 @@ void ARTPWriter::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatAddClient:
+        {
+            onAddClient(msg);
+            break;
+        }
+
+        case kWhatRemoveClient:
+        {
+            onRemoveClient(msg);
+            break;
+        }
+
         default:
             TRESPASS();
             break;
@@ -308,13 +393,84 @@ void ARTPWriter::onSendSR(const sp<AMessage> &msg) {
     msg->post(3000000);
 }
 
-void ARTPWriter::send(const sp<ABuffer> &buffer, bool isRTCP) {
-    ssize_t n = sendto(
-            mSocket, buffer->data(), buffer->size(), 0,
-            (const struct sockaddr *)(isRTCP ? &mRTCPAddr : &mRTPAddr),
-            sizeof(mRTCPAddr));
+void ARTPWriter::onAddClient(const sp<AMessage> &msg) {
+    sp<AReplyToken> replyID;
+    CHECK(msg->senderAwaitsResponse(&replyID));
 
-    CHECK_EQ(n, (ssize_t)buffer->size());
+    AString host;
+    CHECK(msg->findString("host", &host));
+
+    int32_t rtpPort;
+    CHECK(msg->findInt32("rtp-port", &rtpPort));
+
+    sp<AMessage> response = new AMessage;
+
+    Client client;
+    memset(&client.mRTPAddr, 0, sizeof(client.mRTPAddr));
+    client.mRTPAddr.sin_family = AF_INET;
+    client.mRTPAddr.sin_port = htons(rtpPort);
+
+    if (rtpPort <= 0 || rtpPort >= 65535 || (rtpPort & 1)
+            || inet_aton(host.c_str(), &client.mRTPAddr.sin_addr) == 0) {
+        response->setInt32("err", -EINVAL);
+        response->postReply(replyID);
+        return;
+    }
+
+    client.mRTCPAddr = client.mRTPAddr;
+    client.mRTCPAddr.sin_port = htons(rtpPort | 1);
+
+    // Every client gets a socket of its own, so that one filling up its
+    // send buffer doesn't affect the others.
+    client.mSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (client.mSocket < 0) {
+        response->setInt32("err", -errno);
+        response->postReply(replyID);
+        return;
+    }
+
+    client.mSeqNoOffset = UniformRand(65536);
+    client.mSourceIDMask = rand();
+    client.mNumPacketsDropped = 0;
+
+    int32_t clientID = mNextClientID++;
+    mClients.add(clientID, client);
+
+    ALOGI("added client %d (%s:%d)", clientID, host.c_str(), rtpPort);
+
+    response->setInt32("client-id", clientID);
+    response->postReply(replyID);
+}
+
+void ARTPWriter::onRemoveClient(const sp<AMessage> &msg) {
+    sp<AReplyToken> replyID;
+    CHECK(msg->senderAwaitsResponse(&replyID));
+
+    int32_t clientID;
+    CHECK(msg->findInt32("client-id", &clientID));
+
+    sp<AMessage> response = new AMessage;
+
+    ssize_t index = mClients.indexOfKey(clientID);
+    if (index < 0) {
+        response->setInt32("err", -ENOENT);
+    } else {
+        const Client &client = mClients.valueAt(index);
+
+        ALOGI("removed client %d, %u packets dropped",
+              clientID, client.mNumPacketsDropped);
+
+        close(client.mSocket);
+        mClients.removeItemsAt(index);
+    }
+
+    response->postReply(replyID);
+}
+
+void ARTPWriter::send(const sp<ABuffer> &buffer, bool isRTCP) {
+    for (size_t i = 0; i < mClients.size(); ++i) {
+        sendToClient(&mClients.editValueAt(i), buffer, isRTCP);
+    }
 
 #if LOG_TO_FILES
     int fd = isRTCP ? mRTCPFd : mRTPFd;
@@ -414,6 +570,54 @@ void ARTPWriter::addSDES(const sp<ABuffer> &buffer) {
     buffer->setRange(buffer->offset(), buffer->size() + offset);
 }
 
+void ARTPWriter::sendToClient(
+        Client *client, const sp<ABuffer> &buffer, bool isRTCP) {
+    uint8_t *data = buffer->data();
+
+    // The packets are built with the writer's own sequence numbers and SSRC,
+    // patch in the client's before handing them to its socket and restore
+    // them afterwards for the next client.
+    bool rewrite = client->mSeqNoOffset != 0 || client->mSourceIDMask != 0;
+    uint16_t seqNo = 0;
+
+    if (rewrite) {
+        uint32_t sourceID = mSourceID ^ client->mSourceIDMask;
+
+        if (isRTCP) {
+            SetRTCPSourceIDs(buffer, sourceID);
+        } else {
+            seqNo = data[2] << 8 | data[3];
+            SetRTPHeader(data, seqNo + client->mSeqNoOffset, sourceID);
+        }
+    }
+
+    ssize_t n;
+    do {
+        n = sendto(
+                client->mSocket, buffer->data(), buffer->size(), MSG_DONTWAIT,
+                (const struct sockaddr *)
+                    (isRTCP ? &client->mRTCPAddr : &client->mRTPAddr),
+                sizeof(client->mRTCPAddr));
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0) {
+        // Never block the source on a congested client, it loses the packet.
+        if (client->mNumPacketsDropped++ == 0) {
+            ALOGW("dropping packets to client (%s)", strerror(errno));
+        }
+    } else {
+        CHECK_EQ(n, (ssize_t)buffer->size());
+    }
+
+    if (rewrite) {
+        if (isRTCP) {
+            SetRTCPSourceIDs(buffer, mSourceID);
+        } else {
+            SetRTPHeader(data, seqNo, mSourceID);
+        }
+    }
+}
+
 // static
 uint64_t ARTPWriter::GetNowNTP() {
     uint64_t nowUs = ALooper::GetNowUs();
@@ -461,7 +665,7 @@ void ARTPWriter::dumpSessionDesc() {
         sdp.append("m=audio ");
     }
 
-    sdp.append(AStringPrintf("%d", ntohs(mRTPAddr.sin_port)));
+    sdp.append(AStringPrintf("%u", kDefaultRTPPort));
     sdp.append(
           " RTP/AVP " PT_STR "\r\n"
           "b=AS 320000\r\n"
@@ -23,6 +23,7 @@
 #include <media/stagefright/foundation/AString.h>
 #include <media/stagefright/foundation/base64.h>
 #include <media/stagefright/MediaWriter.h>
+#include <utils/KeyedVector.h>
 
 #include <arpa/inet.h>
 #include <sys/socket.h>
@@ -43,6 +44,13 @@ struct ARTPWriter : public MediaWriter {
     virtual status_t stop();
     virtual status_t pause();
 
+    // Fans the stream out to another destination, with its own sequence
+    // number offset and SSRC. Packets are only built once for all clients,
+    // a client whose socket is congested drops packets instead of stalling
+    // the source. The destination the writer was created with is client 0.
+    status_t addClient(const char *host, unsigned rtpPort, int32_t *clientID);
+    status_t removeClient(int32_t clientID);
+
     virtual void onMessageReceived(const sp<AMessage> &msg);
 
 protected:
@@ -54,6 +62,8 @@ private:
         kWhatStop   = 'stop',
         kWhatRead   = 'read',
         kWhatSendSR = 'sr  ',
+        kWhatAddClient      = 'addC',
+        kWhatRemoveClient   = 'remC',
     };
 
     enum {
@@ -76,9 +86,20 @@ private:
     sp<ALooper> mLooper;
     sp<AHandlerReflector<ARTPWriter> > mReflector;
 
-    int mSocket;
-    struct sockaddr_in mRTPAddr;
-    struct sockaddr_in mRTCPAddr;
+    struct Client {
+        int mSocket;
+        struct sockaddr_in mRTPAddr;
+        struct sockaddr_in mRTCPAddr;
+
+        // applied to the sequence numbers and SSRC the packets are built with
+        uint16_t mSeqNoOffset;
+        uint32_t mSourceIDMask;
+
+        uint32_t mNumPacketsDropped;
+    };
+
+    KeyedVector<int32_t, Client> mClients;
+    int32_t mNextClientID;
 
     AString mProfileLevel;
     AString mSeqParamSet;
@@ -106,6 +127,8 @@ private:
 
     void onRead(const sp<AMessage> &msg);
     void onSendSR(const sp<AMessage> &msg);
+    void onAddClient(const sp<AMessage> &msg);
+    void onRemoveClient(const sp<AMessage> &msg);
 
     void addSR(const sp<ABuffer> &buffer);
     void addSDES(const sp<ABuffer> &buffer);
@@ -119,6 +142,8 @@ private:
     void sendAMRData(MediaBuffer *mediaBuf);
 
     void send(const sp<ABuffer> &buffer, bool isRTCP);
+    void sendToClient(
+            Client *client, const sp<ABuffer> &buffer, bool isRTCP);
 
     DISALLOW_EVIL_CONSTRUCTORS(ARTPWriter);
 };
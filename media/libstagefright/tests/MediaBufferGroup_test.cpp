@@ -0,0 +1,152 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MediaBufferGroup_test"
+
+#include <gtest/gtest.h>
+#include <utils/Errors.h>
+#include <utils/Thread.h>
+
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaBufferGroup.h>
+
+namespace android {
+
+class MediaBufferGroupTest : public ::testing::Test {
+};
+
+TEST_F(MediaBufferGroupTest, TestFixedBuffers) {
+    MediaBufferGroup group;
+    group.add_buffer(new MediaBuffer(100));
+    group.add_buffer(new MediaBuffer(200));
+
+    MediaBuffer *a, *b, *c;
+    ASSERT_EQ(OK, group.acquire_buffer(&a, true /* nonBlocking */));
+    ASSERT_EQ(OK, group.acquire_buffer(&b, true /* nonBlocking */));
+    ASSERT_EQ(1, a->refcount());
+    ASSERT_NE(a, b);
+    ASSERT_EQ(WOULD_BLOCK, group.acquire_buffer(&c, true /* nonBlocking */));
+    ASSERT_TRUE(c == NULL);
+
+    a->release();
+    ASSERT_EQ(OK, group.acquire_buffer(&c, true /* nonBlocking */));
+    ASSERT_EQ(a, c);
+
+    b->release();
+    c->release();
+}
+
+TEST_F(MediaBufferGroupTest, TestRequestedSize) {
+    MediaBufferGroup group;
+    group.add_buffer(new MediaBuffer(400));
+    group.add_buffer(new MediaBuffer(100));
+    group.add_buffer(new MediaBuffer(200));
+
+    // the smallest buffer that fits is handed out first
+    MediaBuffer *a, *b;
+    ASSERT_EQ(OK, group.acquire_buffer(&a, true /* nonBlocking */, 150));
+    ASSERT_EQ(200u, a->size());
+    ASSERT_EQ(OK, group.acquire_buffer(&b, true /* nonBlocking */, 150));
+    ASSERT_EQ(400u, b->size());
+
+    MediaBuffer *c;
+    ASSERT_EQ(WOULD_BLOCK, group.acquire_buffer(&c, true /* nonBlocking */, 150));
+    ASSERT_EQ(BAD_VALUE, group.acquire_buffer(&c, false /* nonBlocking */, 1000));
+
+    a->release();
+    b->release();
+}
+
+TEST_F(MediaBufferGroupTest, TestGrowth) {
+    MediaBufferGroup group(2 /* growthLimit */);
+
+    MediaBuffer *a, *b, *c;
+    ASSERT_EQ(OK, group.acquire_buffer(&a, true /* nonBlocking */, 5000));
+    ASSERT_EQ(8192u, a->size());
+    ASSERT_EQ(OK, group.acquire_buffer(&b, true /* nonBlocking */, 100));
+    ASSERT_EQ(4096u, b->size());
+    ASSERT_EQ(WOULD_BLOCK, group.acquire_buffer(&c, true /* nonBlocking */, 100));
+
+    // at the limit, a free buffer that is too small is replaced
+    b->release();
+    ASSERT_EQ(OK, group.acquire_buffer(&c, true /* nonBlocking */, 20000));
+    ASSERT_EQ(32768u, c->size());
+
+    a->release();
+    c->release();
+}
+
+TEST_F(MediaBufferGroupTest, TestTimedAcquire) {
+    MediaBufferGroup group;
+    group.add_buffer(new MediaBuffer(100));
+
+    MediaBuffer *a, *b;
+    ASSERT_EQ(OK, group.acquire_buffer_timed(&a, 0 /* timeoutUs */));
+    ASSERT_EQ(TIMED_OUT, group.acquire_buffer_timed(&b, 10000 /* timeoutUs */));
+    ASSERT_TRUE(b == NULL);
+
+    a->release();
+    ASSERT_EQ(OK, group.acquire_buffer_timed(&b, 10000 /* timeoutUs */));
+    b->release();
+}
+
+// Returns buffers from another thread while the test acquires them.
+struct ReleaseThread : public Thread {
+    ReleaseThread(MediaBuffer **buffers, size_t count)
+        : mBuffers(buffers), mCount(count) {
+    }
+
+private:
+    MediaBuffer **mBuffers;
+    size_t mCount;
+
+    virtual bool threadLoop() {
+        for (size_t i = 0; i < mCount; ++i) {
+            mBuffers[i]->release();
+        }
+        return false;
+    }
+};
+
+TEST_F(MediaBufferGroupTest, TestConcurrentReturn) {
+    const size_t kNumBuffers = 8;
+    MediaBufferGroup group;
+    for (size_t i = 0; i < kNumBuffers; ++i) {
+        group.add_buffer(new MediaBuffer(100));
+    }
+
+    for (int round = 0; round < 100; ++round) {
+        MediaBuffer *buffers[kNumBuffers];
+        for (size_t i = 0; i < kNumBuffers; ++i) {
+            ASSERT_EQ(OK, group.acquire_buffer(&buffers[i]));
+        }
+
+        sp<ReleaseThread> thread = new ReleaseThread(buffers, kNumBuffers);
+        thread->run("ReleaseThread");
+
+        // blocks until the thread has returned the buffers
+        for (size_t i = 0; i < kNumBuffers; ++i) {
+            ASSERT_EQ(OK, group.acquire_buffer(&buffers[i]));
+        }
+        thread->join();
+        for (size_t i = 0; i < kNumBuffers; ++i) {
+            buffers[i]->release();
+        }
+    }
+}
+
+} // namespace android
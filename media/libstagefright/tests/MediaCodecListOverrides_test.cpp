@@ -37,6 +37,7 @@ static const char kTestOverridesStr[] =
 "    <Encoders>\n"
 "        <MediaCodec name=\"OMX.qcom.video.encoder.avc\" type=\"video/avc\" update=\"true\" >\n"
 "            <Limit name=\"max-supported-instances\" value=\"4\" />\n"
+"            <Limit name=\"measured-frame-rate-1280x720\" range=\"118-131\" />\n"
 "        </MediaCodec>\n"
 "        <MediaCodec name=\"OMX.qcom.video.encoder.mpeg4\" type=\"video/mp4v-es\" update=\"true\" >\n"
 "            <Limit name=\"max-supported-instances\" value=\"4\" />\n"
@@ -91,6 +92,8 @@ public:
         gR.add("supports-secure-with-non-secure-codec", "true");
         KeyedVector<AString, CodecSettings> eR;
         addMaxInstancesSetting("OMX.qcom.video.encoder.avc video/avc", "4", &eR);
+        eR.editValueAt(eR.indexOfKey(AString("OMX.qcom.video.encoder.avc video/avc"))).add(
+                AString("measured-frame-rate-1280x720"), AString("118-131"));
         addMaxInstancesSetting("OMX.qcom.video.encoder.mpeg4 video/mp4v-es", "4", &eR);
         KeyedVector<AString, CodecSettings> dR;
         addMaxInstancesSetting("OMX.qcom.video.decoder.avc.secure video/avc", "1", &dR);
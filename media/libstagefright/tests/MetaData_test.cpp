@@ -0,0 +1,113 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MetaData_test"
+
+#include <gtest/gtest.h>
+
+#include <media/stagefright/MetaData.h>
+
+namespace android {
+
+class MetaDataTest : public ::testing::Test {
+};
+
+TEST_F(MetaDataTest, TestManyKeys) {
+    // more keys than are stored inline
+    sp<MetaData> meta = new MetaData;
+    for (uint32_t key = 1; key <= 20; ++key) {
+        ASSERT_FALSE(meta->setInt64(key, key * 100));
+    }
+    ASSERT_TRUE(meta->setInt64(3, 7));
+
+    for (uint32_t key = 1; key <= 20; ++key) {
+        int64_t value;
+        ASSERT_TRUE(meta->findInt64(key, &value));
+        ASSERT_EQ(key == 3 ? 7 : (int64_t)key * 100, value);
+    }
+
+    ASSERT_TRUE(meta->remove(2));
+    ASSERT_TRUE(meta->remove(15));
+    ASSERT_FALSE(meta->remove(15));
+    ASSERT_FALSE(meta->hasData(2));
+    ASSERT_FALSE(meta->hasData(15));
+    ASSERT_TRUE(meta->hasData(1));
+    ASSERT_TRUE(meta->hasData(20));
+
+    meta->clear();
+    for (uint32_t key = 1; key <= 20; ++key) {
+        ASSERT_FALSE(meta->hasData(key));
+    }
+    ASSERT_FALSE(meta->setInt32(kKeyIsSyncFrame, 1));
+    int32_t sync;
+    ASSERT_TRUE(meta->findInt32(kKeyIsSyncFrame, &sync));
+    ASSERT_EQ(1, sync);
+}
+
+TEST_F(MetaDataTest, TestCopy) {
+    static const char kLong[] = "a string too long to be stored inline";
+
+    sp<MetaData> meta = new MetaData;
+    meta->setCString(kKeyMIMEType, kLong);
+    meta->setRect(kKeyCropRect, 1, 2, 3, 4);
+    for (uint32_t key = 1; key <= 10; ++key) {
+        meta->setInt32(key, key);
+    }
+
+    sp<MetaData> copy = new MetaData(*meta.get());
+    meta->setCString(kKeyMIMEType, "short");
+    meta->setInt32(10, 0);
+    meta->remove(kKeyCropRect);
+
+    const char *mime;
+    ASSERT_TRUE(copy->findCString(kKeyMIMEType, &mime));
+    ASSERT_STREQ(kLong, mime);
+    ASSERT_TRUE(meta->findCString(kKeyMIMEType, &mime));
+    ASSERT_STREQ("short", mime);
+
+    int32_t left, top, right, bottom;
+    ASSERT_FALSE(meta->findRect(kKeyCropRect, &left, &top, &right, &bottom));
+    ASSERT_TRUE(copy->findRect(kKeyCropRect, &left, &top, &right, &bottom));
+    ASSERT_EQ(4, bottom);
+
+    int32_t value;
+    ASSERT_TRUE(copy->findInt32(10, &value));
+    ASSERT_EQ(10, value);
+    ASSERT_TRUE(meta->findInt32(10, &value));
+    ASSERT_EQ(0, value);
+}
+
+TEST_F(MetaDataTest, TestGeneration) {
+    sp<MetaData> meta = new MetaData;
+    uint32_t generation = meta->generation();
+    ASSERT_EQ(generation, meta->generation());
+
+    meta->setInt32(kKeyWidth, 640);
+    ASSERT_NE(generation, meta->generation());
+    generation = meta->generation();
+
+    ASSERT_FALSE(meta->remove(kKeyHeight));
+    ASSERT_EQ(generation, meta->generation());
+
+    sp<MetaData> copy = new MetaData(*meta.get());
+    ASSERT_NE(generation, copy->generation());
+
+    meta->clear();
+    ASSERT_NE(generation, meta->generation());
+}
+
+} // namespace android
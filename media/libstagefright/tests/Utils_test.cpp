@@ -23,6 +23,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 
+#include <media/stagefright/foundation/ABitReader.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AStringUtils.h>
 #include <media/stagefright/foundation/AUtils.h>
@@ -281,4 +282,30 @@ TEST_F(UtilsTest, TestMathTemplates) {
     ASSERT_EQ(periodicError(-600, 100), 0);
 }
 
+TEST_F(UtilsTest, TestBitReader) {
+    // 1 | 010 | 011 | 00100 | 00101 | 0000001 0000000 (ue 0, 1, 2, 3, 4, 127)
+    const uint8_t data[] = {
+        0xa6, 0x42, 0x80, 0x80, 0xde, 0xad, 0xbe, 0xef, 0x12, 0x34, 0x56,
+    };
+    ABitReader br(data, sizeof(data));
+    ASSERT_EQ(br.getUE(), 0u);
+    ASSERT_EQ(br.getSE(), 1);
+    ASSERT_EQ(br.getSE(), -1);
+    ASSERT_EQ(br.getUE(), 3u);
+    ASSERT_EQ(br.getUE(), 4u);
+    ASSERT_EQ(br.getUE(), 127u);
+    ASSERT_EQ(br.numBitsLeft(), 56u);
+    ASSERT_EQ(br.getBits(32), 0xdeadbeefu);
+    br.putBits(0xef, 8);
+    ASSERT_EQ(br.getBits(12), 0xef1u);
+    br.skipBits(4);
+    ASSERT_EQ(br.getBits(16), 0x3456u);
+    ASSERT_EQ(br.numBitsLeft(), 0u);
+
+    // emulation_prevention_three_byte 0x03 after two zero bytes is skipped
+    const uint8_t nal[] = { 0x00, 0x00, 0x03, 0x01, 0xff };
+    NALBitReader nbr(nal, sizeof(nal));
+    ASSERT_EQ(nbr.getBits(32), 0x000001ffu);
+}
+
 } // namespace android
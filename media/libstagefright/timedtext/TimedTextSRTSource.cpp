@@ -35,7 +35,11 @@ namespace android {
 TimedTextSRTSource::TimedTextSRTSource(const sp<DataSource>& dataSource)
         : mSource(dataSource),
           mMetaData(new MetaData),
-          mIndex(0) {
+          mIndex(0),
+          mScanOffset(0),
+          mScanComplete(false),
+          mReadBufferOffset(0),
+          mReadBufferSize(0) {
     // TODO: Need to detect the language, because SRT doesn't give language
     // information explicitly.
     mMetaData->setCString(kKeyMediaLanguage, "und");
@@ -45,16 +49,25 @@ TimedTextSRTSource::~TimedTextSRTSource() {
 }
 
 status_t TimedTextSRTSource::start() {
-    status_t err = scanFile();
+    reset();
+
+    // Only the first subtitle is parsed up front, to check the format;
+    // the rest follows as playback gets to it.
+    status_t err = scanNext();
     if (err != OK) {
         reset();
+        return err == ERROR_END_OF_STREAM ? ERROR_MALFORMED : err;
     }
-    return err;
+    return OK;
 }
 
 void TimedTextSRTSource::reset() {
     mTextVector.clear();
     mIndex = 0;
+    mScanOffset = 0;
+    mScanComplete = false;
+    mReadBufferOffset = 0;
+    mReadBufferSize = 0;
 }
 
 status_t TimedTextSRTSource::stop() {
@@ -82,27 +95,34 @@ sp<MetaData> TimedTextSRTSource::getFormat() {
     return mMetaData;
 }
 
-status_t TimedTextSRTSource::scanFile() {
-    off64_t offset = 0;
+status_t TimedTextSRTSource::scanNext() {
+    if (mScanComplete) {
+        return ERROR_END_OF_STREAM;
+    }
+
     int64_t startTimeUs;
-    bool endOfFile = false;
-
-    while (!endOfFile) {
-        TextInfo info;
-        status_t err = getNextSubtitleInfo(&offset, &startTimeUs, &info);
-        switch (err) {
-            case OK:
-                mTextVector.add(startTimeUs, info);
-                break;
-            case ERROR_END_OF_STREAM:
-                endOfFile = true;
-                break;
-            default:
-                return err;
+    TextInfo info;
+    status_t err = getNextSubtitleInfo(&mScanOffset, &startTimeUs, &info);
+    if (err != OK) {
+        if (err != ERROR_END_OF_STREAM) {
+            ALOGW("Stopped parsing subtitles at offset %lld (err %d)",
+                    (long long)mScanOffset, err);
         }
+        mScanComplete = true;
+        return err;
     }
-    if (mTextVector.isEmpty()) {
-        return ERROR_MALFORMED;
+
+    mTextVector.add(startTimeUs, info);
+    return OK;
+}
+
+status_t TimedTextSRTSource::scanUntil(int64_t timeUs) {
+    while (mTextVector.isEmpty()
+            || mTextVector.valueAt(mTextVector.size() - 1).endTimeUs <= timeUs) {
+        status_t err = scanNext();
+        if (err != OK) {
+            return err;
+        }
     }
     return OK;
 }
@@ -174,12 +194,28 @@ status_t TimedTextSRTSource::getNextSubtitleInfo(
     return OK;
 }
 
+ssize_t TimedTextSRTSource::readCharAt(off64_t offset, char *character) {
+    if (offset < mReadBufferOffset
+            || offset >= mReadBufferOffset + (off64_t)mReadBufferSize) {
+        ssize_t n = mSource->readAt(offset, mReadBuffer, kReadBufferSize);
+        if (n <= 0) {
+            mReadBufferSize = 0;
+            return n;
+        }
+        mReadBufferOffset = offset;
+        mReadBufferSize = n;
+    }
+
+    *character = mReadBuffer[offset - mReadBufferOffset];
+    return 1;
+}
+
 status_t TimedTextSRTSource::readNextLine(off64_t *offset, AString *data) {
     data->clear();
     while (true) {
         ssize_t readSize;
         char character;
-        if ((readSize = mSource->readAt(*offset, &character, 1)) < 1) {
+        if ((readSize = readCharAt(*offset, &character)) < 1) {
             if (readSize == 0) {
                 return ERROR_END_OF_STREAM;
             }
@@ -192,7 +228,7 @@ status_t TimedTextSRTSource::readNextLine(off64_t *offset, AString *data) {
         if (character == 10) {
             break;
         } else if (character == 13) {
-            if ((readSize = mSource->readAt(*offset, &character, 1)) < 1) {
+            if ((readSize = readCharAt(*offset, &character)) < 1) {
                 if (readSize == 0) {  // end of the stream
                     return OK;
                 }
@@ -220,6 +256,11 @@ status_t TimedTextSRTSource::getText(
     int64_t seekTimeUs;
     MediaSource::ReadOptions::SeekMode mode;
     if (options != NULL && options->getSeekTo(&seekTimeUs, &mode)) {
+        status_t err = scanUntil(seekTimeUs);
+        if (err == ERROR_IO) {
+            return err;
+        }
+
         int64_t lastEndTimeUs =
                 mTextVector.valueAt(mTextVector.size() - 1).endTimeUs;
         if (seekTimeUs < 0) {
@@ -248,7 +289,10 @@ status_t TimedTextSRTSource::getText(
     }
 
     if (mIndex >= mTextVector.size()) {
-        return ERROR_END_OF_STREAM;
+        status_t err = scanNext();
+        if (err != OK || mIndex >= mTextVector.size()) {
+            return err == ERROR_IO ? err : ERROR_END_OF_STREAM;
+        }
     }
 
     const TextInfo &info = mTextVector.valueAt(mIndex);
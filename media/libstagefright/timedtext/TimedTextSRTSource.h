@@ -56,14 +56,32 @@ private:
         int textLen;
     };
 
+    enum {
+        kReadBufferSize = 4096,
+    };
+
     size_t mIndex;
     KeyedVector<int64_t, TextInfo> mTextVector;
 
+    // Subtitles are parsed on demand, as reads and seeks reach them.
+    // mScanOffset is where the next unparsed subtitle starts.
+    off64_t mScanOffset;
+    bool mScanComplete;
+
+    // File contents around the last offset readNextLine() looked at.
+    uint8_t mReadBuffer[kReadBufferSize];
+    off64_t mReadBufferOffset;
+    size_t mReadBufferSize;
+
     void reset();
-    status_t scanFile();
+    // Parses the next subtitle in the file into mTextVector.
+    status_t scanNext();
+    // Parses subtitles until one ends after timeUs, or the file ends.
+    status_t scanUntil(int64_t timeUs);
     status_t getNextSubtitleInfo(
             off64_t *offset, int64_t *startTimeUs, TextInfo *info);
     status_t readNextLine(off64_t *offset, AString *data);
+    ssize_t readCharAt(off64_t offset, char *character);
     status_t getText(
             const MediaSource::ReadOptions *options,
             AString *text, int64_t *startTimeUs, int64_t *endTimeUs);
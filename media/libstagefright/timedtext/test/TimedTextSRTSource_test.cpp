@@ -220,5 +220,61 @@ TEST_F(TimedTextSRTSourceTest, checkEdgeCase) {
     CheckDataEquals(parcel, subtitle.c_str());
 }
 
+TEST(TimedTextSRTSourceParseTest, stopsAtMalformedSubtitle) {
+    static const char *kData =
+        "1\n00:00:1,000 --> 00:00:1,500\n1\n\n"
+        "2\nnot a time range\n2\n\n"
+        "3\n00:00:3,000 --> 00:00:3,500\n3\n\n";
+    sp<TimedTextSource> source = new TimedTextSRTSource(
+            new SRTDataSourceStub(kData, strlen(kData)));
+    EXPECT_EQ(OK, source->start());
+
+    int64_t startTimeUs, endTimeUs;
+    Parcel parcel;
+    EXPECT_EQ(OK, source->read(&startTimeUs, &endTimeUs, &parcel));
+    EXPECT_EQ(1 * kSecToUsec, startTimeUs);
+    EXPECT_EQ(ERROR_END_OF_STREAM, source->read(&startTimeUs, &endTimeUs, &parcel));
+}
+
+TEST(TimedTextSRTSourceParseTest, malformedFirstSubtitle) {
+    static const char *kData = "1\nnot a time range\n1\n\n";
+    sp<TimedTextSource> source = new TimedTextSRTSource(
+            new SRTDataSourceStub(kData, strlen(kData)));
+    EXPECT_EQ(ERROR_MALFORMED, source->start());
+}
+
+TEST(TimedTextSRTSourceParseTest, seekIntoLargeFile) {
+    // Well beyond the size of the source's read buffer.
+    static const int kNumSubtitles = 1000;
+    AString data;
+    for (int i = 0; i < kNumSubtitles; i++) {
+        int h = i / 3600, m = (i / 60) % 60, s = i % 60;
+        data.append(AStringPrintf(
+                "%d\r\n%02d:%02d:%02d,000 --> %02d:%02d:%02d,500\r\n%d\r\n\r\n",
+                i + 1, h, m, s, h, m, s, i));
+    }
+    sp<TimedTextSource> source = new TimedTextSRTSource(
+            new SRTDataSourceStub(data.c_str(), data.size()));
+    EXPECT_EQ(OK, source->start());
+
+    int64_t startTimeUs, endTimeUs;
+    Parcel parcel;
+    MediaSource::ReadOptions options;
+    options.setSeekTo(900 * kSecToUsec + 200000, MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC);
+    EXPECT_EQ(OK, source->read(&startTimeUs, &endTimeUs, &parcel, &options));
+    EXPECT_EQ(900 * kSecToUsec, startTimeUs);
+    EXPECT_EQ(900 * kSecToUsec + 500000, endTimeUs);
+
+    EXPECT_EQ(OK, source->read(&startTimeUs, &endTimeUs, &parcel));
+    EXPECT_EQ(901 * kSecToUsec, startTimeUs);
+
+    options.setSeekTo(10 * kSecToUsec, MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC);
+    EXPECT_EQ(OK, source->read(&startTimeUs, &endTimeUs, &parcel, &options));
+    EXPECT_EQ(10 * kSecToUsec, startTimeUs);
+
+    options.setSeekTo(kNumSubtitles * kSecToUsec, MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC);
+    EXPECT_EQ(ERROR_END_OF_STREAM, source->read(&startTimeUs, &endTimeUs, &parcel, &options));
+}
+
 }  // namespace test
 }  // namespace android
@@ -24,11 +24,10 @@
 #include <media/stagefright/foundation/ADebug.h>
 #include <utils/Log.h>
 
+#include <inttypes.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
-#include <fcntl.h>
-#include <sys/mman.h>
 
 using namespace android;
 using namespace webm;
@@ -108,26 +107,41 @@ uint8_t *WebmElement::serialize(uint64_t& size) {
     return buf;
 }
 
-int WebmElement::write(int fd, uint64_t& size) {
-    uint8_t buf[8];
+int WebmElement::write(int fd, uint64_t& size, sp<ABuffer> *scratch) {
     size = totalSize();
-    off64_t off = ::lseek64(fd, (size - 1), SEEK_CUR) - (size - 1);
-    ::write(fd, buf, 1); // extend file
-
-    off64_t curOff = off + size;
-    off64_t alignedOff = off & ~(::sysconf(_SC_PAGE_SIZE) - 1);
-    off64_t mapSize = curOff - alignedOff;
-    off64_t pageOff = off - alignedOff;
-    void *dst = ::mmap64(NULL, mapSize, PROT_WRITE, MAP_SHARED, fd, alignedOff);
-    if (dst == MAP_FAILED) {
-        ALOGE("mmap64 failed; errno = %d", errno);
-        ALOGE("fd %d; flags: %o", fd, ::fcntl(fd, F_GETFL, 0));
-        return errno;
+
+    sp<ABuffer> buf;
+    if (scratch != NULL && *scratch != NULL && (*scratch)->capacity() >= size) {
+        buf = *scratch;
     } else {
-        serializeInto((uint8_t*) dst + pageOff);
-        ::msync(dst, mapSize, MS_SYNC);
-        return ::munmap(dst, mapSize);
+        // Round up so that a reused buffer does not grow for every slightly larger element.
+        buf = new ABuffer((size + kWriteBufferAlignment - 1) & ~(kWriteBufferAlignment - 1));
+        if (buf->data() == NULL) {
+            ALOGE("could not allocate %" PRIu64 " bytes", size);
+            return ENOMEM;
+        }
+        if (scratch != NULL) {
+            *scratch = buf;
+        }
+    }
+
+    serializeInto(buf->data());
+
+    const uint8_t *data = buf->data();
+    uint64_t remaining = size;
+    while (remaining > 0) {
+        ssize_t n = ::write(fd, data, remaining);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ALOGE("write failed; errno = %d", errno);
+            return errno;
+        }
+        data += n;
+        remaining -= n;
     }
+    return 0;
 }
 
 //=================================================================================================
@@ -25,6 +25,10 @@
 namespace android {
 
 struct WebmElement : public LightRefBase<WebmElement> {
+    enum {
+        kWriteBufferAlignment = 64 * 1024,
+    };
+
     const uint64_t mId, mSize;
 
     WebmElement(uint64_t id, uint64_t size);
@@ -35,7 +39,10 @@ struct WebmElement : public LightRefBase<WebmElement> {
     uint64_t totalSize();
     uint64_t serializeInto(uint8_t *buf);
     uint8_t *serialize(uint64_t& size);
-    int write(int fd, uint64_t& size);
+    // Serializes the element and writes it at the current offset of fd with a
+    // single write. If scratch is given, it is used as the serialization buffer
+    // when large enough, and replaced by a larger one otherwise.
+    int write(int fd, uint64_t& size, sp<ABuffer> *scratch = NULL);
 
     static sp<WebmElement> EbmlHeader(
             int ver = 1,
@@ -122,7 +122,7 @@ void WebmFrameSinkThread::writeCluster(List<sp<WebmElement> >& children) {
 
     uint64_t size;
     sp<WebmElement> cluster = new WebmMaster(kMkvCluster, children);
-    cluster->write(mFd, size);
+    cluster->write(mFd, size, &mClusterBuffer);
     children.clear();
 }
 
@@ -83,6 +83,8 @@ private:
     LinkedBlockingQueue<const sp<WebmFrame> >& mVideoFrames;
     LinkedBlockingQueue<const sp<WebmFrame> >& mAudioFrames;
     List<sp<WebmElement> >& mCues;
+    // Reused to serialize each cluster.
+    sp<ABuffer> mClusterBuffer;
 
     volatile bool mDone;
 
@@ -324,6 +324,10 @@ status_t WebmWriter::reset() {
     sp<WebmElement> space = new EbmlVoid(kMaxMetaSeekSize - metaSeekSize);
     space->write(mFd, spaceSize);
 
+    // Elements are written through the page cache; sync once at the end
+    // rather than after every cluster.
+    ::fsync(mFd);
+
     release();
     return err;
 }
@@ -106,6 +106,10 @@ status_t MediaSender::initAsync(
         }
         mTSPacketizer = new TSPacketizer(flags);
 
+        // leave room for the RTP headers, so the packets go out without a copy
+        mTSPacketizer->setPacketGrouping(
+                RTPBase::kMaxNumTSPacketsPerRTPPacket, RTPBase::kRTPHeaderSize);
+
         status_t err = OK;
         for (size_t i = 0; i < mTrackInfos.size(); ++i) {
             TrackInfo *info = &mTrackInfos.editItemAt(i);
@@ -255,7 +259,18 @@ status_t MediaSender::queueAccessUnit(
 
             if (err == OK) {
                 if (mLogFile != NULL) {
-                    fwrite(tsPackets->data(), 1, tsPackets->size(), mLogFile);
+                    size_t offset = 0;
+                    while (offset < tsPackets->size()) {
+                        size_t size = tsPackets->size() - offset;
+                        if (size > RTPBase::kRTPHeaderSize
+                                + RTPBase::kMaxNumTSPacketsPerRTPPacket * 188) {
+                            size = RTPBase::kRTPHeaderSize
+                                + RTPBase::kMaxNumTSPacketsPerRTPPacket * 188;
+                        }
+                        fwrite(tsPackets->data() + offset + RTPBase::kRTPHeaderSize,
+                               1, size - RTPBase::kRTPHeaderSize, mLogFile);
+                        offset += size;
+                    }
                 }
 
                 int64_t timeUs;
@@ -265,7 +280,7 @@ status_t MediaSender::queueAccessUnit(
                 err = mTSSender->queueBuffer(
                         tsPackets,
                         33 /* packetType */,
-                        RTPSender::PACKETIZATION_TRANSPORT_STREAM);
+                        RTPSender::PACKETIZATION_TRANSPORT_STREAM_IN_PLACE);
             }
 
             if (err != OK) {
@@ -26,6 +26,10 @@ struct RTPBase {
         PACKETIZATION_H264,
         PACKETIZATION_AAC,
         PACKETIZATION_NONE,
+        // The buffer came from a TSPacketizer grouping its packets by
+        // kMaxNumTSPacketsPerRTPPacket with kRTPHeaderSize bytes of headroom,
+        // the RTP headers are written in place.
+        PACKETIZATION_TRANSPORT_STREAM_IN_PLACE,
     };
 
     enum TransportMode {
@@ -39,6 +43,9 @@ struct RTPBase {
     enum {
         // Really UDP _payload_ size
         kMaxUDPPacketSize = 1472,   // 1472 good, 1473 bad on Android@Home
+
+        kRTPHeaderSize = 12,
+        kMaxNumTSPacketsPerRTPPacket = (kMaxUDPPacketSize - kRTPHeaderSize) / 188,
     };
 
     static int32_t PickRandomRTPPort();
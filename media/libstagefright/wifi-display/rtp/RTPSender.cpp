@@ -194,6 +194,10 @@ status_t RTPSender::queueBuffer(
             err = queueTSPackets(buffer, packetType);
             break;
 
+        case PACKETIZATION_TRANSPORT_STREAM_IN_PLACE:
+            err = queueTSPacketsInPlace(buffer, packetType);
+            break;
+
         case PACKETIZATION_H264:
             err  = queueAVCBuffer(buffer, packetType);
             break;
@@ -212,7 +216,8 @@ status_t RTPSender::queueRawPacket(
     int64_t timeUs;
     CHECK(packet->meta()->findInt64("timeUs", &timeUs));
 
-    sp<ABuffer> udpPacket = new ABuffer(12 + packet->size());
+    sp<ABuffer> udpPacket = obtainPacket();
+    udpPacket->setRange(0, 12 + packet->size());
 
     udpPacket->setInt32Data(mRTPSeqNo);
 
@@ -252,10 +257,11 @@ status_t RTPSender::queueTSPackets(
     int64_t timeUs;
     CHECK(tsPackets->meta()->findInt64("timeUs", &timeUs));
 
+    List<sp<ABuffer> > packets;
+
     size_t srcOffset = 0;
     while (srcOffset < tsPackets->size()) {
-        sp<ABuffer> udpPacket =
-            new ABuffer(12 + kMaxNumTSPacketsPerRTPPacket * 188);
+        sp<ABuffer> udpPacket = obtainPacket();
 
         udpPacket->setInt32Data(mRTPSeqNo);
 
@@ -290,20 +296,72 @@ status_t RTPSender::queueTSPackets(
         udpPacket->setRange(0, 12 + numTSPackets * 188);
 
         srcOffset += numTSPackets * 188;
-        bool isLastPacket = (srcOffset == tsPackets->size());
 
-        status_t err = sendRTPPacket(
-                udpPacket,
-                true /* storeInHistory */,
-                isLastPacket /* timeValid */,
-                timeUs);
+        packets.push_back(udpPacket);
+    }
 
-        if (err != OK) {
-            return err;
+    // only the last packet carries the time of the buffer
+    return sendRTPPackets(
+            packets,
+            true /* storeInHistory */,
+            true /* timeValid */,
+            timeUs);
+}
+
+status_t RTPSender::queueTSPacketsInPlace(
+        const sp<ABuffer> &tsPackets, uint8_t packetType) {
+    static const size_t kMaxRTPPacketSize =
+        kRTPHeaderSize + kMaxNumTSPacketsPerRTPPacket * 188;
+
+    int64_t timeUs;
+    CHECK(tsPackets->meta()->findInt64("timeUs", &timeUs));
+
+    List<sp<ABuffer> > packets;
+
+    size_t offset = 0;
+    while (offset < tsPackets->size()) {
+        size_t size = tsPackets->size() - offset;
+        if (size > kMaxRTPPacketSize) {
+            size = kMaxRTPPacketSize;
         }
+        CHECK_GT(size, (size_t)kRTPHeaderSize);
+        CHECK_EQ(0u, (size - kRTPHeaderSize) % 188);
+
+        uint8_t *rtp = tsPackets->data() + offset;
+        rtp[0] = 0x80;
+        rtp[1] = packetType;
+
+        rtp[2] = (mRTPSeqNo >> 8) & 0xff;
+        rtp[3] = mRTPSeqNo & 0xff;
+
+        int64_t nowUs = ALooper::GetNowUs();
+        uint32_t rtpTime = (nowUs * 9) / 100ll;
+
+        rtp[4] = rtpTime >> 24;
+        rtp[5] = (rtpTime >> 16) & 0xff;
+        rtp[6] = (rtpTime >> 8) & 0xff;
+        rtp[7] = rtpTime & 0xff;
+
+        rtp[8] = kSourceID >> 24;
+        rtp[9] = (kSourceID >> 16) & 0xff;
+        rtp[10] = (kSourceID >> 8) & 0xff;
+        rtp[11] = kSourceID & 0xff;
+
+        // the packets keep the TS buffer alive until they leave the history
+        sp<ABuffer> udpPacket = tsPackets->slice(offset, size);
+        udpPacket->setInt32Data(mRTPSeqNo);
+        ++mRTPSeqNo;
+
+        packets.push_back(udpPacket);
+        offset += size;
     }
 
-    return OK;
+    // only the last packet carries the time of the buffer
+    return sendRTPPackets(
+            packets,
+            true /* storeInHistory */,
+            true /* timeValid */,
+            timeUs);
 }
 
 status_t RTPSender::queueAVCBuffer(
@@ -315,7 +373,7 @@ status_t RTPSender::queueAVCBuffer(
 
     List<sp<ABuffer> > packets;
 
-    sp<ABuffer> out = new ABuffer(kMaxUDPPacketSize);
+    sp<ABuffer> out = obtainPacket();
     size_t outBytesUsed = 12;  // Placeholder for RTP header.
 
     const uint8_t *data = accessUnit->data();
@@ -348,7 +406,7 @@ status_t RTPSender::queueAVCBuffer(
             if (outBytesUsed > 12) {
                 out->setRange(0, outBytesUsed);
                 packets.push_back(out);
-                out = new ABuffer(kMaxUDPPacketSize);
+                out = obtainPacket();
                 outBytesUsed = 12;  // Placeholder for RTP header
             }
 
@@ -406,7 +464,7 @@ status_t RTPSender::queueAVCBuffer(
             out->setRange(0, outBytesUsed + copy + 2);
 
             packets.push_back(out);
-            out = new ABuffer(kMaxUDPPacketSize);
+            out = obtainPacket();
             outBytesUsed = 12;  // Placeholder for RTP header
         }
     }
@@ -414,15 +472,17 @@ status_t RTPSender::queueAVCBuffer(
     if (outBytesUsed > 12) {
         out->setRange(0, outBytesUsed);
         packets.push_back(out);
+    } else if (mFreePackets.size() < kMaxFreePackets) {
+        mFreePackets.push_back(out);
     }
 
-    while (!packets.empty()) {
-        sp<ABuffer> out = *packets.begin();
-        packets.erase(packets.begin());
+    for (List<sp<ABuffer> >::iterator it = packets.begin(); it != packets.end(); ++it) {
+        const sp<ABuffer> &out = *it;
 
         out->setInt32Data(mRTPSeqNo);
 
-        bool last = packets.empty();
+        List<sp<ABuffer> >::iterator next = it;
+        bool last = ++next == packets.end();
 
         uint8_t *dst = out->data();
 
@@ -445,39 +505,71 @@ status_t RTPSender::queueAVCBuffer(
         dst[9] = (kSourceID >> 16) & 0xff;
         dst[10] = (kSourceID >> 8) & 0xff;
         dst[11] = kSourceID & 0xff;
+    }
 
-        status_t err = sendRTPPacket(out, true /* storeInHistory */);
+    return sendRTPPackets(packets, true /* storeInHistory */);
+}
 
-        if (err != OK) {
-            return err;
-        }
+sp<ABuffer> RTPSender::obtainPacket() {
+    if (mFreePackets.isEmpty()) {
+        return new ABuffer(kMaxUDPPacketSize);
     }
 
-    return OK;
+    sp<ABuffer> packet = mFreePackets.top();
+    mFreePackets.pop();
+    packet->setRange(0, packet->capacity());
+    return packet;
 }
 
 status_t RTPSender::sendRTPPacket(
         const sp<ABuffer> &buffer, bool storeInHistory,
         bool timeValid, int64_t timeUs) {
+    List<sp<ABuffer> > packets;
+    packets.push_back(buffer);
+
+    return sendRTPPackets(packets, storeInHistory, timeValid, timeUs);
+}
+
+status_t RTPSender::sendRTPPackets(
+        const List<sp<ABuffer> > &packets, bool storeInHistory,
+        bool timeValid, int64_t timeUs) {
     CHECK(mRTPConnected);
 
-    status_t err = mNetSession->sendRequest(
-            mRTPSessionID, buffer->data(), buffer->size(),
-            timeValid, timeUs);
+    if (packets.empty()) {
+        return OK;
+    }
+
+    // The packets are not copied, the history and the network session share them.
+    status_t err = mNetSession->sendDatagrams(
+            mRTPSessionID, packets, timeValid, timeUs);
 
     if (err != OK) {
         return err;
     }
 
     mLastNTPTime = GetNowNTP();
-    mLastRTPTime = U32_AT(buffer->data() + 4);
+    mLastRTPTime = U32_AT((*--packets.end())->data() + 4);
+
+    for (List<sp<ABuffer> >::const_iterator it = packets.begin(); it != packets.end(); ++it) {
+        const sp<ABuffer> &buffer = *it;
 
-    ++mNumRTPSent;
-    mNumRTPOctetsSent += buffer->size() - 12;
+        ++mNumRTPSent;
+        mNumRTPOctetsSent += buffer->size() - 12;
+
+        if (!storeInHistory) {
+            continue;
+        }
 
-    if (storeInHistory) {
         if (mHistorySize == kMaxHistorySize) {
+            sp<ABuffer> evicted = *mHistory.begin();
             mHistory.erase(mHistory.begin());
+
+            // Unless the network session has yet to send it, nothing else refers to it.
+            // Slices of TS buffers are never as large as the pooled packets.
+            if (evicted->getStrongCount() == 1 && mFreePackets.size() < kMaxFreePackets
+                    && evicted->capacity() == kMaxUDPPacketSize) {
+                mFreePackets.push_back(evicted);
+            }
         } else {
             ++mHistorySize;
         }
@@ -21,6 +21,7 @@
 #include "RTPBase.h"
 
 #include <media/stagefright/foundation/AHandler.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -67,8 +68,8 @@ private:
     };
 
     enum {
-        kMaxNumTSPacketsPerRTPPacket = (kMaxUDPPacketSize - 12) / 188,
         kMaxHistorySize              = 1024,
+        kMaxFreePackets              = 256,
         kSourceID                    = 0xdeadbeef,
     };
 
@@ -92,16 +93,27 @@ private:
     List<sp<ABuffer> > mHistory;
     size_t mHistorySize;
 
+    // packets that left the history and the network session, all kMaxUDPPacketSize
+    Vector<sp<ABuffer> > mFreePackets;
+
     static uint64_t GetNowNTP();
 
     status_t queueRawPacket(const sp<ABuffer> &tsPackets, uint8_t packetType);
     status_t queueTSPackets(const sp<ABuffer> &tsPackets, uint8_t packetType);
+    status_t queueTSPacketsInPlace(const sp<ABuffer> &tsPackets, uint8_t packetType);
     status_t queueAVCBuffer(const sp<ABuffer> &accessUnit, uint8_t packetType);
 
+    sp<ABuffer> obtainPacket();
+
     status_t sendRTPPacket(
             const sp<ABuffer> &packet, bool storeInHistory,
             bool timeValid = false, int64_t timeUs = -1ll);
 
+    // |timeValid| and |timeUs| describe the last packet.
+    status_t sendRTPPackets(
+            const List<sp<ABuffer> > &packets, bool storeInHistory,
+            bool timeValid = false, int64_t timeUs = -1ll);
+
     void onNetNotify(bool isRTP, const sp<AMessage> &msg);
 
     status_t onRTCPData(const sp<ABuffer> &data);
@@ -25,7 +25,8 @@ RepeaterSource::RepeaterSource(const sp<MediaSource> &source, double rateHz)
       mResult(OK),
       mLastBufferUpdateUs(-1ll),
       mStartTimeUs(-1ll),
-      mFrameCount(0) {
+      mFrameCount(0),
+      mLastFrameTimeUs(-1ll) {
 }
 
 RepeaterSource::~RepeaterSource() {
@@ -64,6 +65,7 @@ status_t RepeaterSource::start(MetaData *params) {
     mResult = OK;
     mStartTimeUs = -1ll;
     mFrameCount = 0;
+    mLastFrameTimeUs = -1ll;
 
     mLooper = new ALooper;
     mLooper->setName("repeater_looper");
@@ -143,6 +145,25 @@ status_t RepeaterSource::read(
             if (delayUs > 0ll) {
                 usleep(delayUs);
             }
+
+            Mutex::Autolock autoLock(mLock);
+            if (mResult == OK && mLastBufferUpdateUs >= 0ll
+                    && bufferTimeUs - mLastBufferUpdateUs > kIdleTimeoutUs) {
+                // The screen is static, slow down unless a new frame arrives.
+                int64_t lastBufferUpdateUs = mLastBufferUpdateUs;
+                int64_t idleTimeUs = mLastFrameTimeUs + kIdleFrameIntervalUs;
+                nowUs = ALooper::GetNowUs();
+                while (mResult == OK && mLastBufferUpdateUs == lastBufferUpdateUs
+                        && nowUs < idleTimeUs) {
+                    mCondition.waitRelative(mLock, (idleTimeUs - nowUs) * 1000ll);
+                    nowUs = ALooper::GetNowUs();
+                }
+
+                // Restart the frame schedule from this frame on.
+                mStartTimeUs = nowUs;
+                mFrameCount = 0;
+                bufferTimeUs = nowUs;
+            }
         }
 
         bool stale = false;
@@ -166,6 +187,7 @@ status_t RepeaterSource::read(
                 *buffer = mBuffer;
                 (*buffer)->meta_data()->setInt64(kKeyTime, bufferTimeUs);
                 ++mFrameCount;
+                mLastFrameTimeUs = bufferTimeUs;
             }
         }
 
@@ -42,6 +42,12 @@ private:
         kWhatRead,
     };
 
+    // Once no new frame arrived for kIdleTimeoutUs, the last frame is only
+    // repeated every kIdleFrameIntervalUs instead of at mRateHz, until the
+    // next update.
+    static const int64_t kIdleTimeoutUs = 1000000ll;
+    static const int64_t kIdleFrameIntervalUs = 500000ll;
+
     Mutex mLock;
     Condition mCondition;
 
@@ -60,6 +66,7 @@ private:
 
     int64_t mStartTimeUs;
     int32_t mFrameCount;
+    int64_t mLastFrameTimeUs;
 
     void postRead();
 
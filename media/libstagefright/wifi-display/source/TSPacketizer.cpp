@@ -32,6 +32,73 @@
 
 namespace android {
 
+// The payload of a PES packet: the access unit, after the headers that go in front of it.
+// The pieces are copied to the TS packets in order, without joining them first.
+struct TSPacketizer::PESPayload {
+    PESPayload()
+        : mNumPieces(0),
+          mSize(0),
+          mPiece(0),
+          mPieceOffset(0) {
+    }
+
+    // false if there are too many pieces
+    bool append(const uint8_t *data, size_t size) {
+        if (mNumPieces == kMaxNumPieces) {
+            return false;
+        }
+        mPieces[mNumPieces].mData = data;
+        mPieces[mNumPieces].mSize = size;
+        ++mNumPieces;
+        mSize += size;
+        return true;
+    }
+
+    size_t size() const { return mSize; }
+
+    // Copies the next |size| bytes to |dst|.
+    void copyTo(uint8_t *dst, size_t size) {
+        while (size > 0) {
+            CHECK_LT(mPiece, mNumPieces);
+            const Piece &piece = mPieces[mPiece];
+
+            size_t copy = piece.mSize - mPieceOffset;
+            if (copy > size) {
+                copy = size;
+            }
+            memcpy(dst, piece.mData + mPieceOffset, copy);
+            dst += copy;
+            size -= copy;
+
+            mPieceOffset += copy;
+            if (mPieceOffset == piece.mSize) {
+                ++mPiece;
+                mPieceOffset = 0;
+            }
+        }
+    }
+
+    // room for the ADTS header
+    uint8_t mHeader[7];
+
+private:
+    enum {
+        kMaxNumPieces = 8,
+    };
+
+    struct Piece {
+        const uint8_t *mData;
+        size_t mSize;
+    };
+
+    Piece mPieces[kMaxNumPieces];
+    size_t mNumPieces;
+    size_t mSize;
+
+    size_t mPiece;
+    size_t mPieceOffset;
+};
+
 struct TSPacketizer::Track : public RefBase {
     Track(const sp<AMessage> &format,
           unsigned PID, unsigned streamType, unsigned streamID);
@@ -52,7 +119,11 @@ struct TSPacketizer::Track : public RefBase {
     bool isPCMAudio() const;
 
     sp<ABuffer> prependCSD(const sp<ABuffer> &accessUnit) const;
-    sp<ABuffer> prependADTSHeader(const sp<ABuffer> &accessUnit) const;
+
+    // Like prependCSD(), but the access unit is left where it is. false if the payload
+    // cannot take all the pieces.
+    bool appendCSD(PESPayload *payload) const;
+    void writeADTSHeader(uint8_t *header, size_t accessUnitSize) const;
 
     size_t countDescriptors() const;
     sp<ABuffer> descriptorAt(size_t index) const;
@@ -194,15 +265,23 @@ sp<ABuffer> TSPacketizer::Track::prependCSD(
     return dup;
 }
 
-sp<ABuffer> TSPacketizer::Track::prependADTSHeader(
-        const sp<ABuffer> &accessUnit) const {
+bool TSPacketizer::Track::appendCSD(PESPayload *payload) const {
+    for (size_t i = 0; i < mCSD.size(); ++i) {
+        const sp<ABuffer> &csd = mCSD.itemAt(i);
+
+        if (!payload->append(csd->data(), csd->size())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TSPacketizer::Track::writeADTSHeader(uint8_t *header, size_t accessUnitSize) const {
     CHECK_EQ(mCSD.size(), 1u);
 
     const uint8_t *codec_specific_data = mCSD.itemAt(0)->data();
 
-    const uint32_t aac_frame_length = accessUnit->size() + 7;
-
-    sp<ABuffer> dup = new ABuffer(aac_frame_length);
+    const uint32_t aac_frame_length = accessUnitSize + 7;
 
     unsigned profile = (codec_specific_data[0] >> 3) - 1;
 
@@ -213,7 +292,7 @@ sp<ABuffer> TSPacketizer::Track::prependADTSHeader(
     unsigned channel_configuration =
         (codec_specific_data[1] >> 3) & 0x0f;
 
-    uint8_t *ptr = dup->data();
+    uint8_t *ptr = header;
 
     *ptr++ = 0xff;
     *ptr++ = 0xf9;  // b11111001, ID=1(MPEG-2), layer=0, protection_absent=1
@@ -232,10 +311,6 @@ sp<ABuffer> TSPacketizer::Track::prependADTSHeader(
 
     // adts_buffer_fullness=0, number_of_raw_data_blocks_in_frame=0
     *ptr++ = 0;
-
-    memcpy(ptr, accessUnit->data(), accessUnit->size());
-
-    return dup;
 }
 
 size_t TSPacketizer::Track::countDescriptors() const {
@@ -344,6 +419,8 @@ void TSPacketizer::Track::finalize() {
 
 TSPacketizer::TSPacketizer(uint32_t flags)
     : mFlags(flags),
+      mNumTSPacketsPerGroup(0),
+      mGroupHeadroom(0),
       mPATContinuityCounter(0),
       mPMTContinuityCounter(0) {
     initCrcTable();
@@ -457,7 +534,7 @@ status_t TSPacketizer::packetize(
         uint32_t flags,
         const uint8_t *PES_private_data, size_t PES_private_data_len,
         size_t numStuffingBytes) {
-    sp<ABuffer> accessUnit = _accessUnit;
+    const sp<ABuffer> &accessUnit = _accessUnit;
 
     int64_t timeUs;
     CHECK(accessUnit->meta()->findInt64("timeUs", &timeUs));
@@ -470,13 +547,29 @@ status_t TSPacketizer::packetize(
 
     const sp<Track> &track = mTracks.itemAt(trackIndex);
 
+    PESPayload payload;
+    sp<ABuffer> joined;
     if (track->isH264() && (flags & PREPEND_SPS_PPS_TO_IDR_FRAMES)
             && IsIDR(accessUnit)) {
         // prepend codec specific data, i.e. SPS and PPS.
-        accessUnit = track->prependCSD(accessUnit);
+        if (!track->appendCSD(&payload)) {
+            joined = track->prependCSD(accessUnit);
+            payload = PESPayload();
+        }
     } else if (track->isAAC() && track->lacksADTSHeader()) {
         CHECK(!(flags & IS_ENCRYPTED));
-        accessUnit = track->prependADTSHeader(accessUnit);
+        track->writeADTSHeader(payload.mHeader, accessUnit->size());
+        payload.append(payload.mHeader, sizeof(payload.mHeader));
+    }
+
+    if (joined == NULL && !payload.append(accessUnit->data(), accessUnit->size())) {
+        // more parameter sets than pieces, join them after all
+        joined = track->prependCSD(accessUnit);
+        payload = PESPayload();
+    }
+
+    if (joined != NULL) {
+        payload.append(joined->data(), joined->size());
     }
 
     // 0x47
@@ -538,7 +631,7 @@ status_t TSPacketizer::packetize(
        followed by the payload
     */
 
-    size_t PES_packet_length = accessUnit->size() + 8 + numStuffingBytes;
+    size_t PES_packet_length = payload.size() + 8 + numStuffingBytes;
     if (PES_private_data_len > 0) {
         PES_packet_length += PES_private_data_len + 1;
     }
@@ -555,7 +648,7 @@ status_t TSPacketizer::packetize(
         CHECK_LE(PES_header_size, 188u - 4u);
 
         size_t sizeAvailableForPayload = 188 - 4 - PES_header_size;
-        size_t numBytesOfPayload = accessUnit->size();
+        size_t numBytesOfPayload = payload.size();
 
         if (numBytesOfPayload > sizeAvailableForPayload) {
             numBytesOfPayload = sizeAvailableForPayload;
@@ -569,7 +662,7 @@ status_t TSPacketizer::packetize(
         ALOGV("packet 1 contains %zd padding bytes and %zd bytes of payload",
               numPaddingBytes, numBytesOfPayload);
 
-        size_t numBytesOfPayloadRemaining = accessUnit->size() - numBytesOfPayload;
+        size_t numBytesOfPayloadRemaining = payload.size() - numBytesOfPayload;
 
 #if 0
         // The following hopefully illustrates the logic that led to the
@@ -639,8 +732,9 @@ status_t TSPacketizer::packetize(
         ++numTSPackets;
     }
 
-    sp<ABuffer> buffer = new ABuffer(numTSPackets * 188);
-    uint8_t *packetDataStart = buffer->data();
+    sp<ABuffer> buffer = new ABuffer(bufferSizeFor(numTSPackets));
+    size_t packetIndex = 0;
+    uint8_t *packetDataStart = packetAt(buffer, packetIndex, numTSPackets);
 
     if (flags & EMIT_PAT_AND_PMT) {
         // Program Association Table (PAT):
@@ -704,7 +798,7 @@ status_t TSPacketizer::packetize(
         size_t sizeLeft = packetDataStart + 188 - ptr;
         memset(ptr, 0xff, sizeLeft);
 
-        packetDataStart += 188;
+        packetDataStart = packetAt(buffer, ++packetIndex, numTSPackets);
 
         // Program Map (PMT):
         // 0x47
@@ -819,7 +913,7 @@ status_t TSPacketizer::packetize(
         sizeLeft = packetDataStart + 188 - ptr;
         memset(ptr, 0xff, sizeLeft);
 
-        packetDataStart += 188;
+        packetDataStart = packetAt(buffer, ++packetIndex, numTSPackets);
     }
 
     if (flags & EMIT_PCR) {
@@ -867,7 +961,7 @@ status_t TSPacketizer::packetize(
         size_t sizeLeft = packetDataStart + 188 - ptr;
         memset(ptr, 0xff, sizeLeft);
 
-        packetDataStart += 188;
+        packetDataStart = packetAt(buffer, ++packetIndex, numTSPackets);
     }
 
     uint64_t PTS = (timeUs * 9ll) / 100ll;
@@ -885,7 +979,7 @@ status_t TSPacketizer::packetize(
         sizeAvailableForPayload -= PES_private_data_len + 1;
     }
 
-    size_t copy = accessUnit->size();
+    size_t copy = payload.size();
 
     if (copy > sizeAvailableForPayload) {
         copy = sizeAvailableForPayload;
@@ -946,14 +1040,14 @@ status_t TSPacketizer::packetize(
         *ptr++ = 0xff;
     }
 
-    memcpy(ptr, accessUnit->data(), copy);
+    payload.copyTo(ptr, copy);
     ptr += copy;
 
     CHECK_EQ(ptr, packetDataStart + 188);
-    packetDataStart += 188;
+    packetDataStart = packetAt(buffer, ++packetIndex, numTSPackets);
 
     size_t offset = copy;
-    while (offset < accessUnit->size()) {
+    while (offset < payload.size()) {
         // for subsequent fragments of "buffer":
         // 0x47
         // transport_error_indicator = b0
@@ -967,7 +1061,7 @@ status_t TSPacketizer::packetize(
 
         size_t sizeAvailableForPayload = 188 - 4;
 
-        size_t copy = accessUnit->size() - offset;
+        size_t copy = payload.size() - offset;
 
         if (copy > sizeAvailableForPayload) {
             copy = sizeAvailableForPayload;
@@ -996,21 +1090,49 @@ status_t TSPacketizer::packetize(
             }
         }
 
-        memcpy(ptr, accessUnit->data() + offset, copy);
+        payload.copyTo(ptr, copy);
         ptr += copy;
         CHECK_EQ(ptr, packetDataStart + 188);
 
         offset += copy;
-        packetDataStart += 188;
+        packetDataStart = packetAt(buffer, ++packetIndex, numTSPackets);
     }
 
-    CHECK(packetDataStart == buffer->data() + buffer->capacity());
+    CHECK_EQ(packetIndex, numTSPackets);
 
     *packets = buffer;
 
     return OK;
 }
 
+void TSPacketizer::setPacketGrouping(size_t numTSPacketsPerGroup, size_t headroom) {
+    mNumTSPacketsPerGroup = numTSPacketsPerGroup;
+    mGroupHeadroom = numTSPacketsPerGroup > 0 ? headroom : 0;
+}
+
+size_t TSPacketizer::bufferSizeFor(size_t numTSPackets) const {
+    size_t size = numTSPackets * 188;
+    if (mNumTSPacketsPerGroup > 0) {
+        size_t numGroups =
+            (numTSPackets + mNumTSPacketsPerGroup - 1) / mNumTSPacketsPerGroup;
+        size += numGroups * mGroupHeadroom;
+    }
+    return size;
+}
+
+uint8_t *TSPacketizer::packetAt(
+        const sp<ABuffer> &buffer, size_t index, size_t numTSPackets) const {
+    if (index >= numTSPackets) {
+        return NULL;
+    }
+
+    size_t offset = index * 188;
+    if (mNumTSPacketsPerGroup > 0) {
+        offset += (index / mNumTSPacketsPerGroup + 1) * mGroupHeadroom;
+    }
+    return buffer->data() + offset;
+}
+
 void TSPacketizer::initCrcTable() {
     uint32_t poly = 0x04C11DB7;
 
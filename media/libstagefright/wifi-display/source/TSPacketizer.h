@@ -56,6 +56,11 @@ struct TSPacketizer : public RefBase {
 
     status_t extractCSDIfNecessary(size_t trackIndex);
 
+    // Leaves |headroom| bytes in front of every |numTSPacketsPerGroup| TS packets of the
+    // buffers from packetize(), for a transport to write its headers in place. 0 packets
+    // per group, the default, packs the TS packets.
+    void setPacketGrouping(size_t numTSPacketsPerGroup, size_t headroom);
+
     // XXX to be removed once encoder config option takes care of this for
     // encrypted mode.
     sp<ABuffer> prependCSD(
@@ -70,11 +75,15 @@ private:
         kPID_PCR = 0x1000,
     };
 
+    struct PESPayload;
     struct Track;
 
     uint32_t mFlags;
     Vector<sp<Track> > mTracks;
 
+    size_t mNumTSPacketsPerGroup;
+    size_t mGroupHeadroom;
+
     Vector<sp<ABuffer> > mProgramInfoDescriptors;
 
     unsigned mPATContinuityCounter;
@@ -82,6 +91,9 @@ private:
 
     uint32_t mCrcTable[256];
 
+    size_t bufferSizeFor(size_t numTSPackets) const;
+    uint8_t *packetAt(const sp<ABuffer> &buffer, size_t index, size_t numTSPackets) const;
+
     void initCrcTable();
     uint32_t crc32(const uint8_t *start, size_t size) const;
 
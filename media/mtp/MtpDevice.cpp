@@ -35,6 +35,7 @@
 #include <endian.h>
 
 #include <usbhost/usbhost.h>
+#include <utils/Timers.h>
 
 namespace android {
 
@@ -623,55 +624,8 @@ bool MtpDevice::readObject(MtpObjectHandle handle,
             free(initialData);
         }
 
-        // USB reads greater than 16K don't work
-        char buffer1[16384], buffer2[16384];
-        mRequestIn1->buffer = buffer1;
-        mRequestIn2->buffer = buffer2;
-        struct usb_request* req = mRequestIn1;
-        void* writeBuffer = NULL;
-        int writeLength = 0;
-
-        while (remaining > 0 || writeBuffer) {
-            if (remaining > 0) {
-                // queue up a read request
-                req->buffer_length = (remaining > sizeof(buffer1) ? sizeof(buffer1) : remaining);
-                if (mData.readDataAsync(req)) {
-                    ALOGE("readDataAsync failed");
-                    goto fail;
-                }
-            } else {
-                req = NULL;
-            }
-
-            if (writeBuffer) {
-                // write previous buffer
-                if (!callback(writeBuffer, offset, writeLength, clientData)) {
-                    ALOGE("write failed");
-                    // wait for pending read before failing
-                    if (req)
-                        mData.readDataWait(mDevice);
-                    goto fail;
-                }
-                offset += writeLength;
-                writeBuffer = NULL;
-            }
-
-            // wait for read to complete
-            if (req) {
-                int read = mData.readDataWait(mDevice);
-                if (read < 0)
-                    goto fail;
-
-                if (read > 0) {
-                    writeBuffer = req->buffer;
-                    writeLength = read;
-                    remaining -= read;
-                    req = (req == mRequestIn1 ? mRequestIn2 : mRequestIn1);
-                } else {
-                    writeBuffer = NULL;
-                }
-            }
-        }
+        if (!readObjectData(remaining, callback, offset, clientData))
+            goto fail;
 
         MtpResponseCode response = readResponse();
         if (response == MTP_RESPONSE_OK)
@@ -683,6 +637,11 @@ fail:
 }
 
 
+static bool writeToFd(void* data, int /* offset */, int length, void* clientData) {
+    int fd = *static_cast<int*>(clientData);
+    return write(fd, data, length) == length;
+}
+
 // reads the object's data and writes it to the specified file path
 bool MtpDevice::readObject(MtpObjectHandle handle, const char* destPath, int group, int perm) {
     ALOGD("readObject: %s", destPath);
@@ -724,54 +683,8 @@ bool MtpDevice::readObject(MtpObjectHandle handle, const char* destPath, int gro
             free(initialData);
         }
 
-        // USB reads greater than 16K don't work
-        char buffer1[16384], buffer2[16384];
-        mRequestIn1->buffer = buffer1;
-        mRequestIn2->buffer = buffer2;
-        struct usb_request* req = mRequestIn1;
-        void* writeBuffer = NULL;
-        int writeLength = 0;
-
-        while (remaining > 0 || writeBuffer) {
-            if (remaining > 0) {
-                // queue up a read request
-                req->buffer_length = (remaining > sizeof(buffer1) ? sizeof(buffer1) : remaining);
-                if (mData.readDataAsync(req)) {
-                    ALOGE("readDataAsync failed");
-                    goto fail;
-                }
-            } else {
-                req = NULL;
-            }
-
-            if (writeBuffer) {
-                // write previous buffer
-                if (write(fd, writeBuffer, writeLength) != writeLength) {
-                    ALOGE("write failed");
-                    // wait for pending read before failing
-                    if (req)
-                        mData.readDataWait(mDevice);
-                    goto fail;
-                }
-                writeBuffer = NULL;
-            }
-
-            // wait for read to complete
-            if (req) {
-                int read = mData.readDataWait(mDevice);
-                if (read < 0)
-                    goto fail;
-
-                if (read > 0) {
-                    writeBuffer = req->buffer;
-                    writeLength = read;
-                    remaining -= read;
-                    req = (req == mRequestIn1 ? mRequestIn2 : mRequestIn1);
-                } else {
-                    writeBuffer = NULL;
-                }
-            }
-        }
+        if (!readObjectData(remaining, writeToFd, 0, &fd))
+            goto fail;
 
         MtpResponseCode response = readResponse();
         if (response == MTP_RESPONSE_OK)
@@ -783,6 +696,75 @@ fail:
     return result;
 }
 
+// Reads the remaining data phase of GetObject and hands it to callback, keeping both IN requests
+// queued so that the next transfer is already in flight while a buffer is being consumed.
+bool MtpDevice::readObjectData(uint32_t remaining,
+        bool (* callback)(void* data, int offset, int length, void* clientData),
+        int offset, void* clientData) {
+    // USB reads greater than 16K don't work
+    char buffer1[16384], buffer2[16384];
+    struct usb_request* requests[2] = { mRequestIn1, mRequestIn2 };
+    mRequestIn1->buffer = buffer1;
+    mRequestIn2->buffer = buffer2;
+    // Never queue more than the data phase holds, or a request would swallow the response.
+    uint32_t unqueued = remaining;
+    int queued = 0;
+    int next = 0;
+    int head = 0;
+    uint32_t total = remaining;
+    nsecs_t startTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    bool result = true;
+
+    while (remaining > 0) {
+        while (queued < 2 && unqueued > 0) {
+            struct usb_request* req = requests[next];
+            req->buffer_length = (unqueued > sizeof(buffer1) ? sizeof(buffer1) : unqueued);
+            if (mData.readDataAsync(req)) {
+                ALOGE("readDataAsync failed");
+                result = false;
+                break;
+            }
+            unqueued -= req->buffer_length;
+            next ^= 1;
+            queued++;
+        }
+        if (!result || queued == 0)
+            break;
+
+        // requests on the same endpoint complete in the order they were queued
+        int read = mData.readDataWait(mDevice);
+        queued--;
+        if (read < 0) {
+            result = false;
+            break;
+        }
+        struct usb_request* req = requests[head];
+        head ^= 1;
+        // after a short read, the missing bytes still have to be requested
+        unqueued += req->buffer_length - read;
+        remaining -= read;
+        if (read > 0) {
+            if (!callback(req->buffer, offset, read, clientData)) {
+                ALOGE("write failed");
+                result = false;
+                break;
+            }
+            offset += read;
+        }
+    }
+
+    // wait for pending reads before returning
+    while (queued-- > 0)
+        mData.readDataWait(mDevice);
+
+    if (result) {
+        int64_t elapsedUs = ns2us(systemTime(SYSTEM_TIME_MONOTONIC) - startTime);
+        ALOGV("readObjectData: %u bytes in %lld us (%lld KB/s)", total, (long long) elapsedUs,
+                elapsedUs > 0 ? (long long) total * 1000000 / 1024 / elapsedUs : 0LL);
+    }
+    return result;
+}
+
 bool MtpDevice::sendRequest(MtpOperationCode operation) {
     ALOGV("sendRequest: %s\n", MtpDebug::getOperationCodeName(operation));
     mReceivedResponse = false;
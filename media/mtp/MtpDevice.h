@@ -106,6 +106,10 @@ private:
     bool                    sendRequest(MtpOperationCode operation);
     bool                    sendData();
     bool                    readData();
+    bool                    readObjectData(uint32_t remaining,
+                                    bool (* callback)(void* data, int offset,
+                                            int length, void* clientData),
+                                    int offset, void* clientData);
     bool                    writeDataHeader(MtpOperationCode operation, int dataLength);
     MtpResponseCode         readResponse();
 
@@ -16,6 +16,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
@@ -114,6 +115,7 @@ MtpServer::MtpServer(int fd, MtpDatabase* database, bool ptp,
 }
 
 MtpServer::~MtpServer() {
+    clearObjectInfoCache();
 }
 
 void MtpServer::addStorage(MtpStorage* storage) {
@@ -245,11 +247,13 @@ void MtpServer::run() {
 
 void MtpServer::sendObjectAdded(MtpObjectHandle handle) {
     ALOGV("sendObjectAdded %d\n", handle);
+    invalidateObjectInfo(handle);
     sendEvent(MTP_EVENT_OBJECT_ADDED, handle);
 }
 
 void MtpServer::sendObjectRemoved(MtpObjectHandle handle) {
     ALOGV("sendObjectRemoved %d\n", handle);
+    invalidateObjectInfo(handle);
     sendEvent(MTP_EVENT_OBJECT_REMOVED, handle);
 }
 
@@ -308,6 +312,82 @@ void MtpServer::removeEditObject(MtpObjectHandle handle) {
 
 void MtpServer::commitEdit(ObjectEdit* edit) {
     mDatabase->endSendObject((const char *)edit->mPath, edit->mHandle, edit->mFormat, true);
+    invalidateObjectInfo(edit->mHandle);
+}
+
+static void copyObjectInfo(const MtpObjectInfo& from, MtpObjectInfo& to) {
+    to.mStorageID = from.mStorageID;
+    to.mFormat = from.mFormat;
+    to.mProtectionStatus = from.mProtectionStatus;
+    to.mCompressedSize = from.mCompressedSize;
+    to.mThumbFormat = from.mThumbFormat;
+    to.mThumbCompressedSize = from.mThumbCompressedSize;
+    to.mThumbPixWidth = from.mThumbPixWidth;
+    to.mThumbPixHeight = from.mThumbPixHeight;
+    to.mImagePixWidth = from.mImagePixWidth;
+    to.mImagePixHeight = from.mImagePixHeight;
+    to.mImagePixDepth = from.mImagePixDepth;
+    to.mParent = from.mParent;
+    to.mAssociationType = from.mAssociationType;
+    to.mAssociationDesc = from.mAssociationDesc;
+    to.mSequenceNumber = from.mSequenceNumber;
+    free(to.mName);
+    to.mName = (from.mName ? strdup(from.mName) : NULL);
+    to.mDateCreated = from.mDateCreated;
+    to.mDateModified = from.mDateModified;
+    free(to.mKeywords);
+    to.mKeywords = (from.mKeywords ? strdup(from.mKeywords) : NULL);
+}
+
+MtpResponseCode MtpServer::getCachedObjectInfo(MtpObjectHandle handle, MtpObjectInfo& info) {
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    {
+        Mutex::Autolock autoLock(mObjectInfoCacheLock);
+        ssize_t index = mObjectInfoCache.indexOfKey(handle);
+        if (index >= 0) {
+            const CachedObjectInfo& cached = mObjectInfoCache.valueAt(index);
+            if (now - cached.mTime < kMaxObjectInfoAgeNs) {
+                copyObjectInfo(*cached.mInfo, info);
+                return MTP_RESPONSE_OK;
+            }
+            delete cached.mInfo;
+            mObjectInfoCache.removeItemsAt(index);
+        }
+    }
+
+    MtpResponseCode result = mDatabase->getObjectInfo(handle, info);
+    if (result != MTP_RESPONSE_OK)
+        return result;
+
+    MtpObjectInfo* copy = new MtpObjectInfo(handle);
+    copyObjectInfo(info, *copy);
+    Mutex::Autolock autoLock(mObjectInfoCacheLock);
+    if (mObjectInfoCache.size() >= kMaxCachedObjectInfos) {
+        for (size_t i = 0; i < mObjectInfoCache.size(); i++)
+            delete mObjectInfoCache.valueAt(i).mInfo;
+        mObjectInfoCache.clear();
+    }
+    CachedObjectInfo cached;
+    cached.mInfo = copy;
+    cached.mTime = now;
+    mObjectInfoCache.add(handle, cached);
+    return result;
+}
+
+void MtpServer::invalidateObjectInfo(MtpObjectHandle handle) {
+    Mutex::Autolock autoLock(mObjectInfoCacheLock);
+    ssize_t index = mObjectInfoCache.indexOfKey(handle);
+    if (index >= 0) {
+        delete mObjectInfoCache.valueAt(index).mInfo;
+        mObjectInfoCache.removeItemsAt(index);
+    }
+}
+
+void MtpServer::clearObjectInfoCache() {
+    Mutex::Autolock autoLock(mObjectInfoCacheLock);
+    for (size_t i = 0; i < mObjectInfoCache.size(); i++)
+        delete mObjectInfoCache.valueAt(i).mInfo;
+    mObjectInfoCache.clear();
 }
 
 
@@ -501,6 +581,7 @@ MtpResponseCode MtpServer::doOpenSession() {
     mSessionID = mRequest.getParameter(1);
     mSessionOpen = true;
 
+    clearObjectInfoCache();
     mDatabase->sessionStarted();
 
     return MTP_RESPONSE_OK;
@@ -512,6 +593,7 @@ MtpResponseCode MtpServer::doCloseSession() {
     mSessionID = 0;
     mSessionOpen = false;
     mDatabase->sessionEnded();
+    clearObjectInfoCache();
     return MTP_RESPONSE_OK;
 }
 
@@ -666,6 +748,7 @@ MtpResponseCode MtpServer::doSetObjectPropValue() {
     ALOGV("SetObjectPropValue %d %s\n", handle,
             MtpDebug::getObjectPropCodeName(property));
 
+    invalidateObjectInfo(handle);
     return mDatabase->setObjectPropertyValue(handle, property, mData);
 }
 
@@ -725,7 +808,7 @@ MtpResponseCode MtpServer::doGetObjectInfo() {
         return MTP_RESPONSE_INVALID_PARAMETER;
     MtpObjectHandle handle = mRequest.getParameter(1);
     MtpObjectInfo info(handle);
-    MtpResponseCode result = mDatabase->getObjectInfo(handle, info);
+    MtpResponseCode result = getCachedObjectInfo(handle, info);
     if (result == MTP_RESPONSE_OK) {
         char    date[20];
 
@@ -1051,6 +1134,7 @@ done:
 
     mDatabase->endSendObject(mSendObjectFilePath, mSendObjectHandle, mSendObjectFormat,
             result == MTP_RESPONSE_OK);
+    invalidateObjectInfo(mSendObjectHandle);
     mSendObjectHandle = kInvalidObjectHandle;
     mSendObjectFormat = 0;
     return result;
@@ -1135,6 +1219,8 @@ MtpResponseCode MtpServer::doDeleteObject() {
         // Don't delete the actual files unless the database deletion is allowed
         if (result == MTP_RESPONSE_OK) {
             deletePath((const char *)filePath);
+            // deleting a folder removes everything below it as well
+            clearObjectInfoCache();
         }
     }
 
@@ -24,11 +24,14 @@
 #include "mtp.h"
 #include "MtpUtils.h"
 
+#include <utils/KeyedVector.h>
 #include <utils/threads.h>
+#include <utils/Timers.h>
 
 namespace android {
 
 class MtpDatabase;
+class MtpObjectInfo;
 class MtpStorage;
 
 class MtpServer {
@@ -89,6 +92,21 @@ private:
     };
     Vector<ObjectEdit*>  mObjectEditList;
 
+    // GetObjectInfo results, so that hosts walking a large folder repeatedly do not go through
+    // the database for every object. Entries are dropped when this server changes the object or
+    // the database reports it removed, and are refetched once they are kMaxObjectInfoAgeNs old
+    // to pick up changes made on the device side.
+    struct CachedObjectInfo {
+        MtpObjectInfo*  mInfo;
+        nsecs_t         mTime;
+    };
+    enum { kMaxCachedObjectInfos = 4096 };
+    static const nsecs_t kMaxObjectInfoAgeNs = 10000000000LL;
+    // separate from mMutex, as sendObjectAdded() and sendObjectRemoved() are called from
+    // other threads, possibly while a request is being handled
+    Mutex               mObjectInfoCacheLock;
+    KeyedVector<MtpObjectHandle, CachedObjectInfo> mObjectInfoCache;
+
 public:
                         MtpServer(int fd, MtpDatabase* database, bool ptp,
                                     int fileGroup, int filePerm, int directoryPerm);
@@ -117,6 +135,11 @@ private:
     void                removeEditObject(MtpObjectHandle handle);
     void                commitEdit(ObjectEdit* edit);
 
+    // same as MtpDatabase::getObjectInfo(), but served from mObjectInfoCache when possible
+    MtpResponseCode     getCachedObjectInfo(MtpObjectHandle handle, MtpObjectInfo& info);
+    void                invalidateObjectInfo(MtpObjectHandle handle);
+    void                clearObjectInfoCache();
+
     bool                handleRequest();
 
     MtpResponseCode     doGetDeviceInfo();
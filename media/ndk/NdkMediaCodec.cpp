@@ -28,9 +28,11 @@
 #include <utils/StrongPointer.h>
 #include <gui/Surface.h>
 
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AMessage.h>
-#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/AString.h>
 
 #include <media/stagefright/MediaCodec.h>
 #include <media/stagefright/MediaErrors.h>
@@ -52,6 +54,7 @@ enum {
     kWhatActivityNotify,
     kWhatRequestActivityNotifications,
     kWhatStopActivityNotifications,
+    kWhatAsyncNotify,
 };
 
 
@@ -74,6 +77,11 @@ struct AMediaCodec {
     bool mRequestedActivityNotification;
     OnCodecEvent mCallback;
     void *mCallbackUserData;
+
+    // Set once AMediaCodec_setAsyncNotifyCallback has put the codec in asynchronous mode.
+    bool mAsyncMode;
+    AMediaCodecOnAsyncNotifyCallback mAsyncCallback;
+    void *mAsyncCallbackUserData;
 };
 
 CodecHandler::CodecHandler(AMediaCodec *codec) {
@@ -127,6 +135,88 @@ void CodecHandler::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatAsyncNotify:
+        {
+            int32_t cbID;
+            CHECK(msg->findInt32("callbackID", &cbID));
+
+            const AMediaCodecOnAsyncNotifyCallback &cb = mCodec->mAsyncCallback;
+            void *userdata = mCodec->mAsyncCallbackUserData;
+
+            switch (cbID) {
+                case MediaCodec::CB_INPUT_AVAILABLE:
+                {
+                    int32_t index;
+                    CHECK(msg->findInt32("index", &index));
+
+                    if (cb.onAsyncInputAvailable != NULL) {
+                        cb.onAsyncInputAvailable(mCodec, userdata, index);
+                    }
+                    break;
+                }
+
+                case MediaCodec::CB_OUTPUT_AVAILABLE:
+                {
+                    int32_t index;
+                    size_t offset;
+                    size_t size;
+                    int64_t timeUs;
+                    int32_t flags;
+                    CHECK(msg->findInt32("index", &index));
+                    CHECK(msg->findSize("offset", &offset));
+                    CHECK(msg->findSize("size", &size));
+                    CHECK(msg->findInt64("timeUs", &timeUs));
+                    CHECK(msg->findInt32("flags", &flags));
+
+                    AMediaCodecBufferInfo info;
+                    info.offset = offset;
+                    info.size = size;
+                    info.presentationTimeUs = timeUs;
+                    info.flags = flags;
+
+                    if (cb.onAsyncOutputAvailable != NULL) {
+                        cb.onAsyncOutputAvailable(mCodec, userdata, index, &info);
+                    }
+                    break;
+                }
+
+                case MediaCodec::CB_OUTPUT_FORMAT_CHANGED:
+                {
+                    sp<AMessage> format;
+                    CHECK(msg->findMessage("format", &format));
+
+                    if (cb.onAsyncFormatChanged != NULL) {
+                        // the callback takes ownership of the format
+                        cb.onAsyncFormatChanged(mCodec, userdata, AMediaFormat_fromMsg(&format));
+                    }
+                    break;
+                }
+
+                case MediaCodec::CB_ERROR:
+                case MediaCodec::CB_RESOURCE_RECLAIMED:
+                {
+                    int32_t err;
+                    int32_t actionCode = 0;
+                    AString detail;
+                    CHECK(msg->findInt32("err", &err));
+                    msg->findInt32("actionCode", &actionCode);
+                    msg->findString("detail", &detail);
+                    ALOGE("async error %d (action %d): %s", err, actionCode, detail.c_str());
+
+                    if (cb.onAsyncError != NULL) {
+                        cb.onAsyncError(mCodec, userdata, translate_error(err), actionCode,
+                                detail.c_str());
+                    }
+                    break;
+                }
+
+                default:
+                    ALOGE("unknown async callback %d", cbID);
+                    break;
+            }
+            break;
+        }
+
         default:
             ALOGE("shouldn't be here");
             break;
@@ -136,6 +226,10 @@ void CodecHandler::onMessageReceived(const sp<AMessage> &msg) {
 
 
 static void requestActivityNotification(AMediaCodec *codec) {
+    if (codec->mAsyncMode) {
+        // buffers are announced through the async callback instead
+        return;
+    }
     (new AMessage(kWhatRequestActivityNotifications, codec->mHandler))->post();
 }
 
@@ -163,6 +257,9 @@ static AMediaCodec * createAMediaCodec(const char *name, bool name_is_type, bool
     mData->mGeneration = 1;
     mData->mRequestedActivityNotification = false;
     mData->mCallback = NULL;
+    mData->mAsyncMode = false;
+    memset(&mData->mAsyncCallback, 0, sizeof(mData->mAsyncCallback));
+    mData->mAsyncCallbackUserData = NULL;
 
     return mData;
 }
@@ -261,40 +358,32 @@ ssize_t AMediaCodec_dequeueInputBuffer(AMediaCodec *mData, int64_t timeoutUs) {
     return translate_error(ret);
 }
 
+// Looks up a single client-owned buffer under MediaCodec's buffer lock, rather than
+// copying the whole buffer array through a message round-trip to the codec's looper.
+// This is also the only lookup MediaCodec allows in asynchronous mode.
+static uint8_t* getBuffer(const sp<ABuffer> &buf, status_t err, size_t idx, size_t *out_size) {
+    if (err != OK || buf == NULL) {
+        ALOGE("couldn't get buffer %zu (err %d)", idx, err);
+        return NULL;
+    }
+    if (out_size != NULL) {
+        *out_size = buf->capacity();
+    }
+    return buf->data();
+}
+
 EXPORT
 uint8_t* AMediaCodec_getInputBuffer(AMediaCodec *mData, size_t idx, size_t *out_size) {
-    android::Vector<android::sp<android::ABuffer> > abufs;
-    if (mData->mCodec->getInputBuffers(&abufs) == 0) {
-        size_t n = abufs.size();
-        if (idx >= n) {
-            ALOGE("buffer index %zu out of range", idx);
-            return NULL;
-        }
-        if (out_size != NULL) {
-            *out_size = abufs[idx]->capacity();
-        }
-        return abufs[idx]->data();
-    }
-    ALOGE("couldn't get input buffers");
-    return NULL;
+    sp<ABuffer> buf;
+    status_t err = mData->mCodec->getInputBuffer(idx, &buf);
+    return getBuffer(buf, err, idx, out_size);
 }
 
 EXPORT
 uint8_t* AMediaCodec_getOutputBuffer(AMediaCodec *mData, size_t idx, size_t *out_size) {
-    android::Vector<android::sp<android::ABuffer> > abufs;
-    if (mData->mCodec->getOutputBuffers(&abufs) == 0) {
-        size_t n = abufs.size();
-        if (idx >= n) {
-            ALOGE("buffer index %zu out of range", idx);
-            return NULL;
-        }
-        if (out_size != NULL) {
-            *out_size = abufs[idx]->capacity();
-        }
-        return abufs[idx]->data();
-    }
-    ALOGE("couldn't get output buffers");
-    return NULL;
+    sp<ABuffer> buf;
+    status_t err = mData->mCodec->getOutputBuffer(idx, &buf);
+    return getBuffer(buf, err, idx, out_size);
 }
 
 EXPORT
@@ -336,6 +425,56 @@ ssize_t AMediaCodec_dequeueOutputBuffer(AMediaCodec *mData,
     return translate_error(ret);
 }
 
+EXPORT
+media_status_t AMediaCodec_queueInputBuffers(AMediaCodec *mData,
+        const AMediaCodecBatchBuffer *buffers, size_t count, size_t *numQueued) {
+    Vector<MediaCodec::BatchBuffer> batch;
+    batch.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        MediaCodec::BatchBuffer &b = batch.editItemAt(i);
+        b.mIndex = buffers[i].index;
+        b.mOffset = buffers[i].info.offset;
+        b.mSize = buffers[i].info.size;
+        b.mPresentationTimeUs = buffers[i].info.presentationTimeUs;
+        b.mFlags = buffers[i].info.flags;
+    }
+
+    status_t ret = mData->mCodec->queueInputBuffers(batch.array(), count, numQueued);
+    return translate_error(ret);
+}
+
+EXPORT
+ssize_t AMediaCodec_dequeueOutputBuffers(AMediaCodec *mData,
+        AMediaCodecBatchBuffer *buffers, size_t maxCount, int64_t timeoutUs) {
+    Vector<MediaCodec::BatchBuffer> batch;
+    batch.resize(maxCount);
+    size_t count = 0;
+    status_t ret = mData->mCodec->dequeueOutputBuffers(
+            batch.editArray(), maxCount, &count, timeoutUs);
+    requestActivityNotification(mData);
+    switch (ret) {
+        case OK:
+            for (size_t i = 0; i < count; ++i) {
+                const MediaCodec::BatchBuffer &b = batch[i];
+                buffers[i].index = b.mIndex;
+                buffers[i].info.offset = b.mOffset;
+                buffers[i].info.size = b.mSize;
+                buffers[i].info.flags = b.mFlags;
+                buffers[i].info.presentationTimeUs = b.mPresentationTimeUs;
+            }
+            return count;
+        case -EAGAIN:
+            return AMEDIACODEC_INFO_TRY_AGAIN_LATER;
+        case android::INFO_FORMAT_CHANGED:
+            return AMEDIACODEC_INFO_OUTPUT_FORMAT_CHANGED;
+        case INFO_OUTPUT_BUFFERS_CHANGED:
+            return AMEDIACODEC_INFO_OUTPUT_BUFFERS_CHANGED;
+        default:
+            break;
+    }
+    return translate_error(ret);
+}
+
 EXPORT
 AMediaFormat* AMediaCodec_getOutputFormat(AMediaCodec *mData) {
     sp<AMessage> format;
@@ -359,6 +498,23 @@ media_status_t AMediaCodec_releaseOutputBufferAtTime(
     return translate_error(mData->mCodec->renderOutputBufferAndRelease(idx, timestampNs));
 }
 
+EXPORT
+media_status_t AMediaCodec_setAsyncNotifyCallback(AMediaCodec *mData,
+        AMediaCodecOnAsyncNotifyCallback callback, void *userdata) {
+    mData->mAsyncCallback = callback;
+    mData->mAsyncCallbackUserData = userdata;
+    if (mData->mAsyncMode) {
+        return AMEDIA_OK;
+    }
+
+    status_t err = mData->mCodec->setCallback(new AMessage(kWhatAsyncNotify, mData->mHandler));
+    if (err != OK) {
+        return translate_error(err);
+    }
+    mData->mAsyncMode = true;
+    return AMEDIA_OK;
+}
+
 //EXPORT
 media_status_t AMediaCodec_setNotificationCallback(AMediaCodec *mData, OnCodecEvent callback,
         void *userdata) {
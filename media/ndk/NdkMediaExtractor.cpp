@@ -174,6 +174,30 @@ ssize_t AMediaExtractor_readSampleData(AMediaExtractor *mData, uint8_t *buffer,
     return -1;
 }
 
+EXPORT
+ssize_t AMediaExtractor_readSampleDataBatch(AMediaExtractor *mData, uint8_t *buffer,
+        size_t capacity, AMediaExtractorSampleInfo *infos, size_t maxSamples) {
+    sp<ABuffer> tmp = new ABuffer(buffer, capacity);
+    Vector<NuMediaExtractor::SampleInfo> batch;
+    batch.resize(maxSamples);
+    size_t count;
+    if (mData->mImpl->readSampleDataBatch(tmp, batch.editArray(), maxSamples, &count) != OK) {
+        return -1;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        const NuMediaExtractor::SampleInfo &info = batch[i];
+        infos[i].offset = info.mOffset;
+        infos[i].size = info.mSize;
+        infos[i].presentationTimeUs = info.mTimeUs;
+        infos[i].trackIndex = info.mTrackIndex;
+        infos[i].flags = 0;
+        if (info.mFlags & NuMediaExtractor::SAMPLE_FLAG_SYNC) {
+            infos[i].flags |= AMEDIAEXTRACTOR_SAMPLE_FLAG_SYNC;
+        }
+    }
+    return count;
+}
+
 EXPORT
 uint32_t AMediaExtractor_getSampleFlags(AMediaExtractor *mData) {
     int sampleFlags = 0;
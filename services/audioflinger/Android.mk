@@ -73,7 +73,9 @@ LOCAL_SRC_FILES += \
     FastMixerState.cpp       \
     FastThread.cpp           \
     FastThreadDumpState.cpp  \
-    FastThreadState.cpp
+    FastThreadState.cpp      \
+    LatencyHistogram.cpp     \
+    CycleHistory.cpp
 
 LOCAL_CFLAGS += -DSTATE_QUEUE_INSTANTIATIONS='"StateQueueInstantiations.cpp"'
 
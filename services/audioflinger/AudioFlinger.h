@@ -55,6 +55,8 @@
 #include "FastMixer.h"
 #include <media/nbaio/NBAIO.h>
 #include "AudioWatchdog.h"
+#include "LatencyHistogram.h"
+#include "CycleHistory.h"
 #include "AudioMixer.h"
 #include "AudioStreamOut.h"
 #include "SpdifStreamOut.h"
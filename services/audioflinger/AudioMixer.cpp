@@ -19,14 +19,18 @@
 //#define LOG_NDEBUG 0
 
 #include "Configuration.h"
+#include <errno.h>
+#include <sched.h>
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 #include <math.h>
+#include <unistd.h>
 #include <sys/types.h>
 
 #include <utils/Errors.h>
 #include <utils/Log.h>
+#include <utils/Vector.h>
 
 #include <cutils/bitops.h>
 #include <cutils/compiler.h>
@@ -40,6 +44,7 @@
 #include <common_time/cc_helper.h>
 
 #include "AudioMixerOps.h"
+#include "AudioMixerOpsSimd.h"
 #include "AudioMixer.h"
 
 // The FCC_2 macro refers to the Fixed Channel Count of 2 for the legacy integer mixer.
@@ -85,6 +90,23 @@ static const bool kUseFloat = true;
 // Set to default copy buffer size in frames for input processing.
 static const size_t kCopyBufferFrameCount = 256;
 
+// Minimum number of enabled tracks before process__parallel() is used when worker
+// threads are configured. Below this the wakeup cost outweighs the parallelism.
+static const int kParallelMixMinTracks = 8;
+
+// Mixer configurations that get a compile-time specialized multi-track process hook
+// (process_NoResampleMultiTrack) instead of process__genericNoResampling, listed as
+// X(mixer channel count, mixer output type, mixer accumulation type).
+// The output type is int16_t or float, the accumulation type is float or int32_t (Q4.27).
+// A device build may override the list, e.g. with
+//   LOCAL_CFLAGS += -D'AUDIOMIXER_MULTITRACK_CONFIGS(X)=X(2, int16_t, float)'
+#ifndef AUDIOMIXER_MULTITRACK_CONFIGS
+#define AUDIOMIXER_MULTITRACK_CONFIGS(X) \
+    X(2, int16_t, float) \
+    X(2, float, float) \
+    X(8, float, float)
+#endif
+
 namespace android {
 
 // ----------------------------------------------------------------------------
@@ -97,6 +119,173 @@ T min(const T& a, const T& b)
 
 // ----------------------------------------------------------------------------
 
+// Worker threads for process__parallel().  Each worker mixes a subset of the tracks
+// of one main buffer group into its own partial buffer; the caller sums them afterwards.
+class AudioMixer::WorkerPool {
+public:
+    WorkerPool(uint32_t workers, size_t frameCount);
+    ~WorkerPool();
+
+    uint32_t workers() const { return mWorkers.size(); }
+    int32_t* partial(uint32_t worker) const { return mWorkers[worker]->mOutputTemp; }
+
+    // Starts mixing tracks[i] on worker i into its partial buffer; a zero mask leaves
+    // worker i idle.  The caller must call wait() before touching the partial buffers
+    // or any of the tracks handed out.
+    void start(state_t* state, int64_t pts, const uint32_t* tracks, uint32_t channelCount);
+    void wait();
+
+private:
+    class Worker : public Thread {
+    public:
+        Worker(WorkerPool* pool, uint32_t index, size_t frameCount);
+        virtual ~Worker();
+
+        int32_t* const mOutputTemp;
+        int32_t* const mResampleTemp;
+
+    private:
+        virtual status_t readyToRun();
+        virtual bool threadLoop();
+
+        WorkerPool* const mPool;
+        const uint32_t mIndex;
+        uint32_t mGeneration; // last request generation seen
+    };
+
+    Mutex mLock;
+    Condition mWorkCond;    // signaled by start() and the destructor
+    Condition mDoneCond;    // signaled by the last worker to finish a request
+    uint32_t mGeneration;   // incremented on each start()
+    uint32_t mPending;      // workers that have not yet finished the current request
+    bool mExiting;
+
+    // the current request
+    state_t* mState;
+    int64_t mPts;
+    uint32_t mTracks[MAX_NUM_WORKERS];
+    uint32_t mChannelCount;
+
+    Vector< sp<Worker> > mWorkers;
+};
+
+AudioMixer::WorkerPool::WorkerPool(uint32_t workers, size_t frameCount)
+    :   mGeneration(0), mPending(0), mExiting(false),
+        mState(NULL), mPts(0), mChannelCount(0)
+{
+    ALOG_ASSERT(workers <= MAX_NUM_WORKERS, "workers %u > MAX_NUM_WORKERS", workers);
+    for (uint32_t i = 0; i < workers; ++i) {
+        sp<Worker> worker = new Worker(this, i, frameCount);
+        mWorkers.add(worker);
+        worker->run("AudioMixerWorker", PRIORITY_URGENT_AUDIO);
+    }
+}
+
+AudioMixer::WorkerPool::~WorkerPool()
+{
+    {
+        Mutex::Autolock _l(mLock);
+        mExiting = true;
+        mWorkCond.broadcast();
+    }
+    for (size_t i = 0; i < mWorkers.size(); ++i) {
+        mWorkers[i]->requestExitAndWait();
+    }
+}
+
+void AudioMixer::WorkerPool::start(state_t* state, int64_t pts, const uint32_t* tracks,
+        uint32_t channelCount)
+{
+    Mutex::Autolock _l(mLock);
+    ALOG_ASSERT(mPending == 0, "start() called while a request is pending");
+    mState = state;
+    mPts = pts;
+    mChannelCount = channelCount;
+    for (size_t i = 0; i < mWorkers.size(); ++i) {
+        mTracks[i] = tracks[i];
+        if (tracks[i] != 0) {
+            mPending++;
+        }
+    }
+    if (mPending > 0) {
+        mGeneration++;
+        mWorkCond.broadcast();
+    }
+}
+
+void AudioMixer::WorkerPool::wait()
+{
+    Mutex::Autolock _l(mLock);
+    while (mPending > 0) {
+        mDoneCond.wait(mLock);
+    }
+}
+
+AudioMixer::WorkerPool::Worker::Worker(WorkerPool* pool, uint32_t index, size_t frameCount)
+    :   Thread(false /*canCallJava*/),
+        mOutputTemp(new int32_t[MAX_NUM_CHANNELS * frameCount]),
+        mResampleTemp(new int32_t[MAX_NUM_CHANNELS * frameCount]),
+        mPool(pool), mIndex(index), mGeneration(0)
+{
+}
+
+AudioMixer::WorkerPool::Worker::~Worker()
+{
+    delete [] mOutputTemp;
+    delete [] mResampleTemp;
+}
+
+status_t AudioMixer::WorkerPool::Worker::readyToRun()
+{
+    // Pin each worker to its own core, leaving the first core to the calling thread.
+    const long cpus = sysconf(_SC_NPROCESSORS_CONF);
+    if (cpus > 1) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET((mIndex + 1) % cpus, &set);
+        if (sched_setaffinity(0 /*self*/, sizeof(set), &set) != 0) {
+            ALOGW("AudioMixerWorker %u: sched_setaffinity failed: %s", mIndex, strerror(errno));
+        }
+    }
+    return NO_ERROR;
+}
+
+bool AudioMixer::WorkerPool::Worker::threadLoop()
+{
+    state_t* state;
+    int64_t pts;
+    uint32_t tracks;
+    uint32_t channelCount;
+    {
+        Mutex::Autolock _l(mPool->mLock);
+        while (!mPool->mExiting && mGeneration == mPool->mGeneration) {
+            mPool->mWorkCond.wait(mPool->mLock);
+        }
+        if (mPool->mExiting) {
+            return false;
+        }
+        mGeneration = mPool->mGeneration;
+        tracks = mPool->mTracks[mIndex];
+        if (tracks == 0) {
+            return true;
+        }
+        state = mPool->mState;
+        pts = mPool->mPts;
+        channelCount = mPool->mChannelCount;
+    }
+
+    memset(mOutputTemp, 0, sizeof(*mOutputTemp) * channelCount * state->frameCount);
+    mixTrackGroup(state, tracks, pts, mOutputTemp, mResampleTemp);
+
+    Mutex::Autolock _l(mPool->mLock);
+    if (--mPool->mPending == 0) {
+        mPool->mDoneCond.signal();
+    }
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+
 // Ensure mConfiguredNames bitmask is initialized properly on all architectures.
 // The value of 1 << x is undefined in C when x >= 32.
 
@@ -119,7 +308,7 @@ AudioMixer::AudioMixer(size_t frameCount, uint32_t sampleRate, uint32_t maxNumTr
     mState.outputTemp   = NULL;
     mState.resampleTemp = NULL;
     mState.mLog         = &mDummyLog;
-    // mState.reserved
+    mState.workers      = NULL;
 
     // FIXME Most of the following initialization is probably redundant since
     // tracks[i] should only be referenced if (mTrackNames & (1 << i)) != 0
@@ -147,6 +336,7 @@ AudioMixer::~AudioMixer()
     }
     delete [] mState.outputTemp;
     delete [] mState.resampleTemp;
+    delete mState.workers;
 }
 
 void AudioMixer::setLog(NBLog::Writer *log)
@@ -154,6 +344,27 @@ void AudioMixer::setLog(NBLog::Writer *log)
     mState.mLog = log;
 }
 
+status_t AudioMixer::setWorkerCount(uint32_t workers)
+{
+    if (workers > MAX_NUM_WORKERS) {
+        ALOGE("setWorkerCount(%u) exceeds MAX_NUM_WORKERS %u", workers, MAX_NUM_WORKERS);
+        return BAD_VALUE;
+    }
+    if (workers == workerCount()) {
+        return NO_ERROR;
+    }
+    delete mState.workers;
+    mState.workers = workers > 0 ? new WorkerPool(workers, mState.frameCount) : NULL;
+    // reselect the process hook
+    invalidateState(mTrackNames);
+    return NO_ERROR;
+}
+
+uint32_t AudioMixer::workerCount() const
+{
+    return mState.workers != NULL ? mState.workers->workers() : 0;
+}
+
 static inline audio_format_t selectMixerInFormat(audio_format_t inputFormat __unused) {
     return kUseFloat && kUseNewMixer ? AUDIO_FORMAT_PCM_FLOAT : AUDIO_FORMAT_PCM_16_BIT;
 }
@@ -335,18 +546,24 @@ status_t AudioMixer::track_t::prepareForDownmix()
     if (audio_channel_mask_get_representation(channelMask)
                 == AUDIO_CHANNEL_REPRESENTATION_POSITION
             && DownmixerBufferProvider::isMultichannelCapable()) {
-        DownmixerBufferProvider* pDbp = new DownmixerBufferProvider(channelMask,
-                mMixerChannelMask,
-                AUDIO_FORMAT_PCM_16_BIT /* TODO: use mMixerInFormat, now only PCM 16 */,
-                sampleRate, sessionId, kCopyBufferFrameCount);
-
-        if (pDbp->isValid()) { // if constructor completed properly
-            mDownmixRequiresFormat = AUDIO_FORMAT_PCM_16_BIT; // PCM 16 bit required for downmix
-            downmixerBufferProvider = pDbp;
-            reconfigureBufferProviders();
-            return NO_ERROR;
+        // Prefer downmixing in the mixer input format to avoid converting to PCM 16 and back,
+        // but fall back to PCM 16 for downmix effects that only support it.
+        const audio_format_t formats[] = { mMixerInFormat, AUDIO_FORMAT_PCM_16_BIT };
+        for (size_t i = 0; i < ARRAY_SIZE(formats); i++) {
+            if (i > 0 && formats[i] == formats[0]) {
+                break;
+            }
+            DownmixerBufferProvider* pDbp = new DownmixerBufferProvider(channelMask,
+                    mMixerChannelMask, formats[i], sampleRate, sessionId, kCopyBufferFrameCount);
+
+            if (pDbp->isValid()) { // if constructor completed properly
+                mDownmixRequiresFormat = formats[i];
+                downmixerBufferProvider = pDbp;
+                reconfigureBufferProviders();
+                return NO_ERROR;
+            }
+            delete pDbp;
         }
-        delete pDbp;
     }
 
     // Effect downmixer does not accept the channel conversion.  Let's use our remixer.
@@ -941,6 +1158,9 @@ void AudioMixer::process__validate(state_t* state, int64_t pts)
     bool all16BitsStereoNoResample = true;
     bool resampling = false;
     bool volumeRamp = false;
+    // whether all enabled tracks share the mixer channel count and formats of the first
+    bool uniformMixerConfig = true;
+    const track_t* first = NULL;
     uint32_t en = state->enabledTracks;
     while (en) {
         const int i = 31 - __builtin_clz(en);
@@ -948,6 +1168,13 @@ void AudioMixer::process__validate(state_t* state, int64_t pts)
 
         countActiveTracks++;
         track_t& t = state->tracks[i];
+        if (first == NULL) {
+            first = &t;
+        } else if (t.mMixerChannelCount != first->mMixerChannelCount
+                || t.mMixerInFormat != first->mMixerInFormat
+                || t.mMixerFormat != first->mMixerFormat) {
+            uniformMixerConfig = false;
+        }
         uint32_t n = 0;
         // FIXME can overflow (mask is only 3 bits)
         n |= NEEDS_CHANNEL_1 + t.channelCount - 1;
@@ -1001,14 +1228,16 @@ void AudioMixer::process__validate(state_t* state, int64_t pts)
     // select the processing hooks
     state->hook = process__nop;
     if (countActiveTracks > 0) {
-        if (resampling) {
+        const bool parallel = state->workers != NULL
+                && countActiveTracks >= kParallelMixMinTracks;
+        if (resampling || parallel) {
             if (!state->outputTemp) {
                 state->outputTemp = new int32_t[MAX_NUM_CHANNELS * state->frameCount];
             }
             if (!state->resampleTemp) {
                 state->resampleTemp = new int32_t[MAX_NUM_CHANNELS * state->frameCount];
             }
-            state->hook = process__genericResampling;
+            state->hook = parallel ? process__parallel : process__genericResampling;
         } else {
             if (state->outputTemp) {
                 delete [] state->outputTemp;
@@ -1019,6 +1248,13 @@ void AudioMixer::process__validate(state_t* state, int64_t pts)
                 state->resampleTemp = NULL;
             }
             state->hook = process__genericNoResampling;
+            if (uniformMixerConfig) {
+                process_hook_t hook = getProcessHook(PROCESSTYPE_NORESAMPLEMULTITRACK,
+                        first->mMixerChannelCount, first->mMixerInFormat, first->mMixerFormat);
+                if (hook != NULL) {
+                    state->hook = hook;
+                }
+            }
             if (all16BitsStereoNoResample && !volumeRamp) {
                 if (countActiveTracks == 1) {
                     const int i = 31 - __builtin_clz(state->enabledTracks);
@@ -1038,9 +1274,10 @@ void AudioMixer::process__validate(state_t* state, int64_t pts)
     }
 
     ALOGV("mixer configuration change: %d activeTracks (%08x) "
-        "all16BitsStereoNoResample=%d, resampling=%d, volumeRamp=%d",
+        "all16BitsStereoNoResample=%d, resampling=%d, volumeRamp=%d, parallel=%d",
         countActiveTracks, state->enabledTracks,
-        all16BitsStereoNoResample, resampling, volumeRamp);
+        all16BitsStereoNoResample, resampling, volumeRamp,
+        state->hook == process__parallel);
 
    state->hook(state, pts);
 
@@ -1548,46 +1785,139 @@ void AudioMixer::process__genericResampling(state_t* state, int64_t pts)
         e0 &= ~(e1);
         int32_t *out = t1.mainBuffer;
         memset(outTemp, 0, sizeof(*outTemp) * t1.mMixerChannelCount * state->frameCount);
-        while (e1) {
-            const int i = 31 - __builtin_clz(e1);
-            e1 &= ~(1<<i);
-            track_t& t = state->tracks[i];
-            int32_t *aux = NULL;
-            if (CC_UNLIKELY(t.needs & NEEDS_AUX)) {
-                aux = t.auxBuffer;
+        mixTrackGroup(state, e1, pts, outTemp, state->resampleTemp);
+        convertMixerFormat(out, t1.mMixerFormat,
+                outTemp, t1.mMixerInFormat, numFrames * t1.mMixerChannelCount);
+    }
+}
+
+// Mixes the given tracks, which must all share the same main buffer, into outTemp
+// for the full state->frameCount.  outTemp is accumulated into, not cleared.
+void AudioMixer::mixTrackGroup(state_t* state, uint32_t tracks, int64_t pts,
+        int32_t* outTemp, int32_t* resampleTemp)
+{
+    const size_t numFrames = state->frameCount;
+    while (tracks) {
+        const int i = 31 - __builtin_clz(tracks);
+        tracks &= ~(1<<i);
+        track_t& t = state->tracks[i];
+        int32_t *aux = NULL;
+        if (CC_UNLIKELY(t.needs & NEEDS_AUX)) {
+            aux = t.auxBuffer;
+        }
+
+        // this is a little goofy, on the resampling case we don't
+        // acquire/release the buffers because it's done by
+        // the resampler.
+        if (t.needs & NEEDS_RESAMPLE) {
+            t.resampler->setPTS(pts);
+            t.hook(&t, outTemp, numFrames, resampleTemp, aux);
+        } else {
+
+            size_t outFrames = 0;
+
+            while (outFrames < numFrames) {
+                t.buffer.frameCount = numFrames - outFrames;
+                int64_t outputPTS = calculateOutputPTS(t, pts, outFrames);
+                t.bufferProvider->getNextBuffer(&t.buffer, outputPTS);
+                t.in = t.buffer.raw;
+                // t.in == NULL can happen if the track was flushed just after having
+                // been enabled for mixing.
+                if (t.in == NULL) break;
+
+                if (CC_UNLIKELY(aux != NULL)) {
+                    aux += outFrames;
+                }
+                t.hook(&t, outTemp + outFrames * t.mMixerChannelCount, t.buffer.frameCount,
+                        resampleTemp, aux);
+                outFrames += t.buffer.frameCount;
+                t.bufferProvider->releaseBuffer(&t.buffer);
             }
+        }
+    }
+}
 
-            // this is a little goofy, on the resampling case we don't
-            // acquire/release the buffers because it's done by
-            // the resampler.
-            if (t.needs & NEEDS_RESAMPLE) {
-                t.resampler->setPTS(pts);
-                t.hook(&t, outTemp, numFrames, state->resampleTemp, aux);
-            } else {
+// generic code with resampling, with tracks split across the worker threads
+void AudioMixer::process__parallel(state_t* state, int64_t pts)
+{
+    ALOGVV("process__parallel\n");
+    WorkerPool* const workers = state->workers;
+    int32_t* const outTemp = state->outputTemp;
+    const size_t numFrames = state->frameCount;
+    const uint32_t numWorkers = workers->workers();
 
-                size_t outFrames = 0;
+    uint32_t e0 = state->enabledTracks;
+    while (e0) {
+        // process by group of tracks with same output buffer
+        uint32_t e1 = e0, e2 = e0;
+        int j = 31 - __builtin_clz(e1);
+        track_t& t1 = state->tracks[j];
+        e2 &= ~(1<<j);
+        while (e2) {
+            j = 31 - __builtin_clz(e2);
+            e2 &= ~(1<<j);
+            track_t& t2 = state->tracks[j];
+            if (CC_UNLIKELY(t2.mainBuffer != t1.mainBuffer)) {
+                e1 &= ~(1<<j);
+            }
+        }
+        e0 &= ~(e1);
 
-                while (outFrames < numFrames) {
-                    t.buffer.frameCount = numFrames - outFrames;
-                    int64_t outputPTS = calculateOutputPTS(t, pts, outFrames);
-                    t.bufferProvider->getNextBuffer(&t.buffer, outputPTS);
-                    t.in = t.buffer.raw;
-                    // t.in == NULL can happen if the track was flushed just after having
-                    // been enabled for mixing.
-                    if (t.in == NULL) break;
+        // Tracks with an aux send stay on this thread since several tracks may share
+        // an aux buffer.  The others are dealt out in track order, in contiguous runs,
+        // first to this thread and then to each worker.
+        uint32_t local = 0;
+        uint32_t remote = 0;
+        e2 = e1;
+        while (e2) {
+            j = 31 - __builtin_clz(e2);
+            e2 &= ~(1<<j);
+            ((state->tracks[j].needs & NEEDS_AUX) ? local : remote) |= 1<<j;
+        }
+        const uint32_t perThread = (__builtin_popcount(remote) + numWorkers) / (numWorkers + 1);
+        uint32_t tracks[MAX_NUM_WORKERS];
+        for (uint32_t w = 0; w <= numWorkers; ++w) {
+            uint32_t mask = 0;
+            for (uint32_t n = 0; n < perThread && remote; ++n) {
+                j = 31 - __builtin_clz(remote);
+                remote &= ~(1<<j);
+                mask |= 1<<j;
+            }
+            if (w == 0) {
+                local |= mask;
+            } else {
+                tracks[w - 1] = mask;
+            }
+        }
 
-                    if (CC_UNLIKELY(aux != NULL)) {
-                        aux += outFrames;
-                    }
-                    t.hook(&t, outTemp + outFrames * t.mMixerChannelCount, t.buffer.frameCount,
-                            state->resampleTemp, aux);
-                    outFrames += t.buffer.frameCount;
-                    t.bufferProvider->releaseBuffer(&t.buffer);
+        const size_t sampleCount = numFrames * t1.mMixerChannelCount;
+        workers->start(state, pts, tracks, t1.mMixerChannelCount);
+        memset(outTemp, 0, sizeof(*outTemp) * sampleCount);
+        mixTrackGroup(state, local, pts, outTemp, state->resampleTemp);
+        workers->wait();
+
+        // Sum the partial buffers in worker order so the result does not depend on
+        // which thread finishes first.  Integer mixing gives the same result as
+        // process__genericResampling().
+        for (uint32_t w = 0; w < numWorkers; ++w) {
+            if (tracks[w] == 0) {
+                continue;
+            }
+            const int32_t* partial = workers->partial(w);
+            if (t1.mMixerInFormat == AUDIO_FORMAT_PCM_FLOAT) {
+                float* sum = reinterpret_cast<float*>(outTemp);
+                const float* in = reinterpret_cast<const float*>(partial);
+                for (size_t k = 0; k < sampleCount; ++k) {
+                    sum[k] += in[k];
+                }
+            } else {
+                for (size_t k = 0; k < sampleCount; ++k) {
+                    outTemp[k] += partial[k];
                 }
             }
         }
-        convertMixerFormat(out, t1.mMixerFormat,
-                outTemp, t1.mMixerInFormat, numFrames * t1.mMixerChannelCount);
+        convertMixerFormat(t1.mainBuffer, t1.mMixerFormat,
+                outTemp, t1.mMixerInFormat, sampleCount);
     }
 }
 
@@ -1885,6 +2215,171 @@ void AudioMixer::process_NoResampleOneTrack(state_t* state, int64_t pts)
     }
 }
 
+// Maps the template types of process_NoResampleMultiTrack to mixer formats.
+template <typename T>
+struct MixerFormatTraits;
+
+template <>
+struct MixerFormatTraits<float> {
+    static const audio_format_t kMixerInFormat = AUDIO_FORMAT_PCM_FLOAT;
+    static const audio_format_t kMixerOutFormat = AUDIO_FORMAT_PCM_FLOAT;
+};
+
+template <>
+struct MixerFormatTraits<int32_t> { // Q4.27 accumulation of 16 bit input
+    static const audio_format_t kMixerInFormat = AUDIO_FORMAT_PCM_16_BIT;
+};
+
+template <>
+struct MixerFormatTraits<int16_t> {
+    static const audio_format_t kMixerOutFormat = AUDIO_FORMAT_PCM_16_BIT;
+};
+
+// Compile-time equivalents of convertMixerFormat().
+template <typename TO, typename TI>
+static inline void convertMixerOutput(TO *out, const TI *in, size_t sampleCount);
+
+template <>
+inline void convertMixerOutput<float, float>(float *out, const float *in, size_t sampleCount)
+{
+    memcpy(out, in, sampleCount * sizeof(float));
+}
+
+template <>
+inline void convertMixerOutput<int16_t, float>(int16_t *out, const float *in,
+        size_t sampleCount)
+{
+    memcpy_to_i16_from_float(out, in, sampleCount);
+}
+
+template <>
+inline void convertMixerOutput<float, int32_t>(float *out, const int32_t *in,
+        size_t sampleCount)
+{
+    memcpy_to_float_from_q4_27(out, in, sampleCount);
+}
+
+template <>
+inline void convertMixerOutput<int16_t, int32_t>(int16_t *out, const int32_t *in,
+        size_t sampleCount)
+{
+    // two int16_t are produced per iteration
+    ditherAndClamp((int32_t *)out, in, sampleCount >> 1);
+}
+
+/* This process hook is process__genericNoResampling() with the mixer channel count and
+ * formats fixed at compile time, so the per-block loops and the output conversion have
+ * no runtime dispatch.  Used when all enabled tracks share a configuration listed in
+ * AUDIOMIXER_MULTITRACK_CONFIGS, and none of them resample.
+ *
+ * NCHAN: mixer channel count
+ * TO: int16_t or float, the mixer output
+ * TI: int32_t (Q4.27) or float, the mixer accumulation buffer
+ */
+template <int NCHAN, typename TO, typename TI>
+void AudioMixer::process_NoResampleMultiTrack(state_t* state, int64_t pts)
+{
+    ALOGVV("process_NoResampleMultiTrack\n");
+    TI outTemp[BLOCKSIZE * NCHAN] __attribute__((aligned(32)));
+
+    // acquire each track's buffer
+    uint32_t enabledTracks = state->enabledTracks;
+    uint32_t e0 = enabledTracks;
+    while (e0) {
+        const int i = 31 - __builtin_clz(e0);
+        e0 &= ~(1<<i);
+        track_t& t = state->tracks[i];
+        ALOG_ASSERT(t.mMixerChannelCount == NCHAN);
+        t.buffer.frameCount = state->frameCount;
+        t.bufferProvider->getNextBuffer(&t.buffer, pts);
+        t.frameCount = t.buffer.frameCount;
+        t.in = t.buffer.raw;
+    }
+
+    e0 = enabledTracks;
+    while (e0) {
+        // process by group of tracks with same output buffer to
+        // optimize cache use
+        uint32_t e1 = e0, e2 = e0;
+        int j = 31 - __builtin_clz(e1);
+        track_t& t1 = state->tracks[j];
+        e2 &= ~(1<<j);
+        while (e2) {
+            j = 31 - __builtin_clz(e2);
+            e2 &= ~(1<<j);
+            track_t& t2 = state->tracks[j];
+            if (CC_UNLIKELY(t2.mainBuffer != t1.mainBuffer)) {
+                e1 &= ~(1<<j);
+            }
+        }
+        e0 &= ~(e1);
+        TO *out = reinterpret_cast<TO*>(t1.mainBuffer);
+        size_t numFrames = 0;
+        do {
+            memset(outTemp, 0, sizeof(outTemp));
+            e2 = e1;
+            while (e2) {
+                const int i = 31 - __builtin_clz(e2);
+                e2 &= ~(1<<i);
+                track_t& t = state->tracks[i];
+                size_t outFrames = BLOCKSIZE;
+                int32_t *aux = NULL;
+                if (CC_UNLIKELY(t.needs & NEEDS_AUX)) {
+                    aux = t.auxBuffer + numFrames;
+                }
+                while (outFrames) {
+                    // t.in == NULL can happen if the track was flushed just after having
+                    // been enabled for mixing.
+                    if (t.in == NULL) {
+                        enabledTracks &= ~(1<<i);
+                        e1 &= ~(1<<i);
+                        break;
+                    }
+                    size_t inFrames = (t.frameCount > outFrames)?outFrames:t.frameCount;
+                    if (inFrames > 0) {
+                        t.hook(&t, reinterpret_cast<int32_t*>(
+                                        outTemp + (BLOCKSIZE - outFrames) * NCHAN),
+                                inFrames, state->resampleTemp, aux);
+                        t.frameCount -= inFrames;
+                        outFrames -= inFrames;
+                        if (CC_UNLIKELY(aux != NULL)) {
+                            aux += inFrames;
+                        }
+                    }
+                    if (t.frameCount == 0 && outFrames) {
+                        t.bufferProvider->releaseBuffer(&t.buffer);
+                        t.buffer.frameCount = (state->frameCount - numFrames) -
+                                (BLOCKSIZE - outFrames);
+                        int64_t outputPTS = calculateOutputPTS(
+                            t, pts, numFrames + (BLOCKSIZE - outFrames));
+                        t.bufferProvider->getNextBuffer(&t.buffer, outputPTS);
+                        t.in = t.buffer.raw;
+                        if (t.in == NULL) {
+                            enabledTracks &= ~(1<<i);
+                            e1 &= ~(1<<i);
+                            break;
+                        }
+                        t.frameCount = t.buffer.frameCount;
+                    }
+                }
+            }
+
+            convertMixerOutput<TO, TI>(out, outTemp, BLOCKSIZE * NCHAN);
+            out += BLOCKSIZE * NCHAN;
+            numFrames += BLOCKSIZE;
+        } while (numFrames < state->frameCount);
+    }
+
+    // release each track's buffer
+    e0 = enabledTracks;
+    while (e0) {
+        const int i = 31 - __builtin_clz(e0);
+        e0 &= ~(1<<i);
+        track_t& t = state->tracks[i];
+        t.bufferProvider->releaseBuffer(&t.buffer);
+    }
+}
+
 /* This track hook is called to do resampling then mixing,
  * pulling from the track's upstream AudioBufferProvider.
  *
@@ -2061,6 +2556,20 @@ AudioMixer::hook_t AudioMixer::getTrackHook(int trackType, uint32_t channelCount
 AudioMixer::process_hook_t AudioMixer::getProcessHook(int processType, uint32_t channelCount,
         audio_format_t mixerInFormat, audio_format_t mixerOutFormat)
 {
+    if (processType == PROCESSTYPE_NORESAMPLEMULTITRACK) {
+        if (!kUseNewMixer) {
+            return NULL;
+        }
+#define MULTITRACK_PROCESS_HOOK(NCHAN, TO, TI) \
+        if (channelCount == NCHAN \
+                && mixerInFormat == MixerFormatTraits<TI>::kMixerInFormat \
+                && mixerOutFormat == MixerFormatTraits<TO>::kMixerOutFormat) { \
+            return process_NoResampleMultiTrack<NCHAN, TO, TI>; \
+        }
+        AUDIOMIXER_MULTITRACK_CONFIGS(MULTITRACK_PROCESS_HOOK)
+#undef MULTITRACK_PROCESS_HOOK
+        return NULL; // use process__genericNoResampling
+    }
     if (processType != PROCESSTYPE_NORESAMPLEONETRACK) { // Only NORESAMPLEONETRACK
         LOG_ALWAYS_FATAL("bad processType: %d", processType);
         return NULL;
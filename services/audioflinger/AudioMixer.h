@@ -59,6 +59,9 @@ public:
     // maximum number of channels supported for the content
     static const uint32_t MAX_NUM_CHANNELS_TO_DOWNMIX = AUDIO_CHANNEL_COUNT_MAX;
 
+    // maximum number of worker threads for parallel mixing, see setWorkerCount()
+    static const uint32_t MAX_NUM_WORKERS = 3;
+
     static const uint16_t UNITY_GAIN_INT = 0x1000;
     static const CONSTEXPR float UNITY_GAIN_FLOAT = 1.0f;
 
@@ -130,6 +133,14 @@ public:
 
     uint32_t    trackNames() const { return mTrackNames; }
 
+    // Set the number of worker threads used to mix tracks in parallel, up to MAX_NUM_WORKERS.
+    // Each worker mixes a subset of the enabled tracks into its own partial buffer, and the
+    // partial buffers are summed in a fixed order by the thread calling process().
+    // Tracks with an aux send are always mixed on the calling thread.
+    // 0 (the default) mixes all tracks on the calling thread.
+    status_t    setWorkerCount(uint32_t workers);
+    uint32_t    workerCount() const;
+
     size_t      getUnreleasedFrames(int name) const;
 
     static inline bool isValidPcmTrackFormat(audio_format_t format) {
@@ -280,6 +291,8 @@ private:
 
     typedef void (*process_hook_t)(state_t* state, int64_t pts);
 
+    class WorkerPool;
+
     // pad to 32-bytes to fill cache line
     struct state_t {
         uint32_t        enabledTracks;
@@ -289,7 +302,7 @@ private:
         int32_t         *outputTemp;
         int32_t         *resampleTemp;
         NBLog::Writer*  mLog;
-        int32_t         reserved[1];
+        WorkerPool*     workers;    // NULL unless parallel mixing is enabled
         // FIXME allocate dynamically to save some memory when maxNumTracks < MAX_NUM_TRACKS
         track_t         tracks[MAX_NUM_TRACKS] __attribute__((aligned(32)));
     };
@@ -332,6 +345,9 @@ private:
     static void process__nop(state_t* state, int64_t pts);
     static void process__genericNoResampling(state_t* state, int64_t pts);
     static void process__genericResampling(state_t* state, int64_t pts);
+    static void process__parallel(state_t* state, int64_t pts);
+    static void mixTrackGroup(state_t* state, uint32_t tracks, int64_t pts,
+            int32_t* outTemp, int32_t* resampleTemp);
     static void process__OneTrack16BitsStereoNoResampling(state_t* state,
                                                           int64_t pts);
 
@@ -360,6 +376,10 @@ private:
     // multi-format process hooks
     template <int MIXTYPE, typename TO, typename TI, typename TA>
     static void process_NoResampleOneTrack(state_t* state, int64_t pts);
+    // NCHAN is the mixer channel count, TO the mixer output type and TI the mixer
+    // accumulation type, shared by all enabled tracks
+    template <int NCHAN, typename TO, typename TI>
+    static void process_NoResampleMultiTrack(state_t* state, int64_t pts);
 
     // multi-format track hooks
     template <int MIXTYPE, typename TO, typename TI, typename TA>
@@ -375,6 +395,7 @@ private:
     // hook types
     enum {
         PROCESSTYPE_NORESAMPLEONETRACK,
+        PROCESSTYPE_NORESAMPLEMULTITRACK, // may return NULL if there is no specialization
     };
     enum {
         TRACKTYPE_NOP,
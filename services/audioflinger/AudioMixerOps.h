@@ -218,6 +218,23 @@ inline TO MixMulAux(TI value, TV volume, TA *auxaccum) {
     return MixMul<TO, TI, TV>(value, volume);
 }
 
+/* VolumeMultiAccelerated is an optional vectorized implementation of the constant
+ * volume, no aux send path of volumeMulti() below.  The generic version is not
+ * supported; specializations for particular <MIXTYPE, NCHAN, TO, TI, TV> combinations
+ * are provided by AudioMixerOpsSimd.h for targets with NEON or SSE2.
+ *
+ * kSupported is a compile time constant, so the check in volumeMulti() is
+ * removed by the compiler when no specialization exists.
+ */
+template <int MIXTYPE, int NCHAN, typename TO, typename TI, typename TV>
+struct VolumeMultiAccelerated {
+    static const bool kSupported = false;
+    static inline void process(TO* out __unused, size_t frameCount __unused,
+            const TI* in __unused, const TV* vol __unused) {
+        LOG_ALWAYS_FATAL("VolumeMultiAccelerated not specialized");
+    }
+};
+
 /* MIXTYPE is used to determine how the samples in the input frame
  * are mixed with volume gain into the output frame.
  * See the volumeRampMulti functions below for more details.
@@ -409,6 +426,11 @@ inline void volumeMulti(TO* out, size_t frameCount,
             *aux++ += MixMul<TA, TA, TAV>(auxaccum, vola);
         } while (--frameCount);
     } else {
+        if (VolumeMultiAccelerated<MIXTYPE, NCHAN, TO, TI, TV>::kSupported) {
+            VolumeMultiAccelerated<MIXTYPE, NCHAN, TO, TI, TV>::process(
+                    out, frameCount, in, vol);
+            return;
+        }
         do {
             switch (MIXTYPE) {
             case MIXTYPE_MULTI:
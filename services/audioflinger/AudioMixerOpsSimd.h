@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_MIXER_OPS_SIMD_H
+#define ANDROID_AUDIO_MIXER_OPS_SIMD_H
+
+// depends on AudioMixerOps.h
+
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define USE_MIXER_NEON (true)
+#define USE_MIXER_SSE (false)
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_MIXER_NEON (false)
+#define USE_MIXER_SSE (true)
+#else
+#define USE_MIXER_NEON (false)
+#define USE_MIXER_SSE (false)
+#endif
+
+namespace android {
+
+#if USE_MIXER_NEON || USE_MIXER_SSE
+
+//
+// Vectorized specializations of VolumeMultiAccelerated in AudioMixerOps.h.
+//
+// Only the constant volume path without aux send is covered; volume ramps
+// and aux accumulation keep using the scalar templates.
+//
+// The per-sample volume pattern must repeat within 4 samples, which holds for
+// NCHAN 1 and 2 with per-channel volumes and for any NCHAN with the MONOVOL
+// mixtypes (all that volumeMulti() uses for channel counts above 2).
+//
+// The integer kernels are bit-exact with the scalar MixMul<> variants.
+// The float kernels use a separate multiply and add, and match the scalar
+// code to within the rounding of a fused multiply-add if the compiler
+// contracts the scalar expression.
+//
+
+template <int MIXTYPE, int NCHAN>
+struct MixerSimdTraits {
+    static const bool kMonoVol = MIXTYPE == MIXTYPE_MULTI_MONOVOL
+            || MIXTYPE == MIXTYPE_MULTI_SAVEONLY_MONOVOL;
+    static const bool kSaveOnly = MIXTYPE == MIXTYPE_MULTI_SAVEONLY
+            || MIXTYPE == MIXTYPE_MULTI_SAVEONLY_MONOVOL;
+    static const bool kMonoExpand = MIXTYPE == MIXTYPE_MONOEXPAND;
+    static const bool kSupported = kMonoVol
+            || (kMonoExpand && NCHAN == 2)
+            || ((MIXTYPE == MIXTYPE_MULTI || MIXTYPE == MIXTYPE_MULTI_SAVEONLY)
+                    && (NCHAN == 1 || NCHAN == 2));
+
+    // Fills an 8 sample volume pattern for the output samples of a frame aligned buffer.
+    template <typename TV>
+    static inline void fillVolume(TV *vol8, const TV *vol) {
+        for (int i = 0; i < 8; ++i) {
+            vol8[i] = (kMonoVol || NCHAN == 1) ? vol[0] : vol[i & 1];
+        }
+    }
+};
+
+// out[i] (+)= in[i] * vol8[i & 7] for a frame aligned run of samples.
+template <bool ACCUMULATE>
+static inline void mixerSimdFloat(float *out, const float *in, size_t samples,
+        const float *vol8)
+{
+#if USE_MIXER_NEON
+    const float32x4_t v = vld1q_f32(vol8);
+    for (; samples >= 8; samples -= 8) {
+        float32x4_t x0 = vmulq_f32(vld1q_f32(in), v);
+        float32x4_t x1 = vmulq_f32(vld1q_f32(in + 4), v);
+        if (ACCUMULATE) {
+            x0 = vaddq_f32(vld1q_f32(out), x0);
+            x1 = vaddq_f32(vld1q_f32(out + 4), x1);
+        }
+        vst1q_f32(out, x0);
+        vst1q_f32(out + 4, x1);
+        in += 8;
+        out += 8;
+    }
+#else
+    const __m128 v = _mm_loadu_ps(vol8);
+    for (; samples >= 8; samples -= 8) {
+        __m128 x0 = _mm_mul_ps(_mm_loadu_ps(in), v);
+        __m128 x1 = _mm_mul_ps(_mm_loadu_ps(in + 4), v);
+        if (ACCUMULATE) {
+            x0 = _mm_add_ps(_mm_loadu_ps(out), x0);
+            x1 = _mm_add_ps(_mm_loadu_ps(out + 4), x1);
+        }
+        _mm_storeu_ps(out, x0);
+        _mm_storeu_ps(out + 4, x1);
+        in += 8;
+        out += 8;
+    }
+#endif
+    for (size_t i = 0; i < samples; ++i) {
+        const float x = MixMul<float, float, float>(in[i], vol8[i]);
+        out[i] = ACCUMULATE ? out[i] + x : x;
+    }
+}
+
+// out[2i] += in[i] * vol8[0], out[2i + 1] += in[i] * vol8[1].
+static inline void mixerSimdMonoExpandFloat(float *out, const float *in, size_t frames,
+        const float *vol8)
+{
+#if USE_MIXER_NEON
+    const float32x4_t v = vld1q_f32(vol8);
+    for (; frames >= 4; frames -= 4) {
+        const float32x4_t x = vld1q_f32(in);
+        const float32x4x2_t z = vzipq_f32(x, x);
+        vst1q_f32(out, vaddq_f32(vld1q_f32(out), vmulq_f32(z.val[0], v)));
+        vst1q_f32(out + 4, vaddq_f32(vld1q_f32(out + 4), vmulq_f32(z.val[1], v)));
+        in += 4;
+        out += 8;
+    }
+#else
+    const __m128 v = _mm_loadu_ps(vol8);
+    for (; frames >= 4; frames -= 4) {
+        const __m128 x = _mm_loadu_ps(in);
+        _mm_storeu_ps(out, _mm_add_ps(_mm_loadu_ps(out),
+                _mm_mul_ps(_mm_unpacklo_ps(x, x), v)));
+        _mm_storeu_ps(out + 4, _mm_add_ps(_mm_loadu_ps(out + 4),
+                _mm_mul_ps(_mm_unpackhi_ps(x, x), v)));
+        in += 4;
+        out += 8;
+    }
+#endif
+    for (; frames > 0; --frames) {
+        *out++ += MixMul<float, float, float>(*in, vol8[0]);
+        *out++ += MixMul<float, float, float>(*in, vol8[1]);
+        in++;
+    }
+}
+
+// out[i] += in[i] * vol8[i & 7] with Q4.27 accumulation (Q0.15 input, U4.12 volume).
+static inline void mixerSimdAccumInt16(int32_t *out, const int16_t *in, size_t samples,
+        const int16_t *vol8)
+{
+#if USE_MIXER_NEON
+    const int16x4_t v = vld1_s16(vol8);
+    for (; samples >= 8; samples -= 8) {
+        const int16x8_t x = vld1q_s16(in);
+        vst1q_s32(out, vmlal_s16(vld1q_s32(out), vget_low_s16(x), v));
+        vst1q_s32(out + 4, vmlal_s16(vld1q_s32(out + 4), vget_high_s16(x), v));
+        in += 8;
+        out += 8;
+    }
+#else
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(vol8));
+    for (; samples >= 8; samples -= 8) {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+        const __m128i lo = _mm_mullo_epi16(x, v);
+        const __m128i hi = _mm_mulhi_epi16(x, v);
+        __m128i *o = reinterpret_cast<__m128i *>(out);
+        _mm_storeu_si128(o, _mm_add_epi32(_mm_loadu_si128(o), _mm_unpacklo_epi16(lo, hi)));
+        _mm_storeu_si128(o + 1,
+                _mm_add_epi32(_mm_loadu_si128(o + 1), _mm_unpackhi_epi16(lo, hi)));
+        in += 8;
+        out += 8;
+    }
+#endif
+    for (size_t i = 0; i < samples; ++i) {
+        out[i] += MixMul<int32_t, int16_t, int16_t>(in[i], vol8[i]);
+    }
+}
+
+// out[2i] += in[i] * vol8[0], out[2i + 1] += in[i] * vol8[1] with Q4.27 accumulation.
+static inline void mixerSimdMonoExpandInt16(int32_t *out, const int16_t *in, size_t frames,
+        const int16_t *vol8)
+{
+#if USE_MIXER_NEON
+    const int16x4_t v = vld1_s16(vol8);
+    for (; frames >= 4; frames -= 4) {
+        const int16x4_t x = vld1_s16(in);
+        const int16x4x2_t z = vzip_s16(x, x);
+        vst1q_s32(out, vmlal_s16(vld1q_s32(out), z.val[0], v));
+        vst1q_s32(out + 4, vmlal_s16(vld1q_s32(out + 4), z.val[1], v));
+        in += 4;
+        out += 8;
+    }
+#else
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(vol8));
+    for (; frames >= 4; frames -= 4) {
+        __m128i x = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(in));
+        x = _mm_unpacklo_epi16(x, x);
+        const __m128i lo = _mm_mullo_epi16(x, v);
+        const __m128i hi = _mm_mulhi_epi16(x, v);
+        __m128i *o = reinterpret_cast<__m128i *>(out);
+        _mm_storeu_si128(o, _mm_add_epi32(_mm_loadu_si128(o), _mm_unpacklo_epi16(lo, hi)));
+        _mm_storeu_si128(o + 1,
+                _mm_add_epi32(_mm_loadu_si128(o + 1), _mm_unpackhi_epi16(lo, hi)));
+        in += 4;
+        out += 8;
+    }
+#endif
+    for (; frames > 0; --frames) {
+        *out++ += MixMul<int32_t, int16_t, int16_t>(*in, vol8[0]);
+        *out++ += MixMul<int32_t, int16_t, int16_t>(*in, vol8[1]);
+        in++;
+    }
+}
+
+// out[i] = clamp16((in[i] * vol8[i & 7]) >> 12).
+static inline void mixerSimdSaveInt16(int16_t *out, const int16_t *in, size_t samples,
+        const int16_t *vol8)
+{
+#if USE_MIXER_NEON
+    const int16x4_t v = vld1_s16(vol8);
+    for (; samples >= 8; samples -= 8) {
+        const int16x8_t x = vld1q_s16(in);
+        const int16x4_t y0 = vqshrn_n_s32(vmull_s16(vget_low_s16(x), v), 12);
+        const int16x4_t y1 = vqshrn_n_s32(vmull_s16(vget_high_s16(x), v), 12);
+        vst1q_s16(out, vcombine_s16(y0, y1));
+        in += 8;
+        out += 8;
+    }
+#else
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(vol8));
+    for (; samples >= 8; samples -= 8) {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+        const __m128i lo = _mm_mullo_epi16(x, v);
+        const __m128i hi = _mm_mulhi_epi16(x, v);
+        const __m128i y0 = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 12);
+        const __m128i y1 = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 12);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_packs_epi32(y0, y1));
+        in += 8;
+        out += 8;
+    }
+#endif
+    for (size_t i = 0; i < samples; ++i) {
+        out[i] = MixMul<int16_t, int16_t, int16_t>(in[i], vol8[i]);
+    }
+}
+
+/* float input, float output, float volume: used by the float mixer
+ * for track__NoResample and process_NoResampleOneTrack.
+ */
+template <int MIXTYPE, int NCHAN>
+struct VolumeMultiAccelerated<MIXTYPE, NCHAN, float, float, float> {
+    typedef MixerSimdTraits<MIXTYPE, NCHAN> traits;
+    static const bool kSupported = traits::kSupported;
+    static inline void process(float* out, size_t frameCount,
+            const float* in, const float* vol) {
+        float vol8[8];
+        traits::fillVolume(vol8, vol);
+        if (traits::kMonoExpand) {
+            mixerSimdMonoExpandFloat(out, in, frameCount, vol8);
+        } else if (traits::kSaveOnly) {
+            mixerSimdFloat<false>(out, in, frameCount * NCHAN, vol8);
+        } else {
+            mixerSimdFloat<true>(out, in, frameCount * NCHAN, vol8);
+        }
+    }
+};
+
+/* int16_t input, Q4.27 output, U4.12 volume: used by the integer mixer
+ * for track__NoResample.
+ */
+template <int MIXTYPE, int NCHAN>
+struct VolumeMultiAccelerated<MIXTYPE, NCHAN, int32_t, int16_t, int16_t> {
+    typedef MixerSimdTraits<MIXTYPE, NCHAN> traits;
+    static const bool kSupported = traits::kSupported && !traits::kSaveOnly;
+    static inline void process(int32_t* out, size_t frameCount,
+            const int16_t* in, const int16_t* vol) {
+        int16_t vol8[8];
+        traits::fillVolume(vol8, vol);
+        if (traits::kMonoExpand) {
+            mixerSimdMonoExpandInt16(out, in, frameCount, vol8);
+        } else {
+            mixerSimdAccumInt16(out, in, frameCount * NCHAN, vol8);
+        }
+    }
+};
+
+/* int16_t input, int16_t output, U4.12 volume: used by process_NoResampleOneTrack.
+ */
+template <int MIXTYPE, int NCHAN>
+struct VolumeMultiAccelerated<MIXTYPE, NCHAN, int16_t, int16_t, int16_t> {
+    typedef MixerSimdTraits<MIXTYPE, NCHAN> traits;
+    static const bool kSupported = traits::kSupported && traits::kSaveOnly;
+    static inline void process(int16_t* out, size_t frameCount,
+            const int16_t* in, const int16_t* vol) {
+        int16_t vol8[8];
+        traits::fillVolume(vol8, vol);
+        mixerSimdSaveInt16(out, in, frameCount * NCHAN, vol8);
+    }
+};
+
+#endif // USE_MIXER_NEON || USE_MIXER_SSE
+
+} // namespace android
+
+#endif /* ANDROID_AUDIO_MIXER_OPS_SIMD_H */
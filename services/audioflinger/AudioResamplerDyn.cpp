@@ -29,9 +29,10 @@
 #include <utils/Log.h>
 #include <audio_utils/primitives.h>
 
-#include "AudioResamplerFirOps.h" // USE_NEON and USE_INLINE_ASSEMBLY defined here
+#include "AudioResamplerFirOps.h" // USE_NEON, USE_SSE and USE_INLINE_ASSEMBLY defined here
 #include "AudioResamplerFirProcess.h"
 #include "AudioResamplerFirProcessNeon.h"
+#include "AudioResamplerFirProcessSSE.h"
 #include "AudioResamplerFirGen.h" // requires math.h
 #include "AudioResamplerDyn.h"
 
@@ -162,6 +163,92 @@ void AudioResamplerDyn<TC, TI, TO>::Constants::set(
     mHalfNumCoefs = halfNumCoefs;
 }
 
+template<typename TC, typename TI, typename TO>
+Mutex AudioResamplerDyn<TC, TI, TO>::FilterCache::sLock;
+
+template<typename TC, typename TI, typename TO>
+KeyedVector<uint64_t, typename AudioResamplerDyn<TC, TI, TO>::FilterCache::Entry>
+        AudioResamplerDyn<TC, TI, TO>::FilterCache::sEntries;
+
+template<typename TC, typename TI, typename TO>
+uint32_t AudioResamplerDyn<TC, TI, TO>::FilterCache::sUseCount;
+
+template<typename TC, typename TI, typename TO>
+const TC* AudioResamplerDyn<TC, TI, TO>::FilterCache::acquire(uint64_t key)
+{
+    Mutex::Autolock _l(sLock);
+    const ssize_t index = sEntries.indexOfKey(key);
+    if (index < 0) {
+        return NULL;
+    }
+    Entry& entry = sEntries.editValueAt(index);
+    entry.mRefCount++;
+    entry.mLastUse = ++sUseCount;
+    return entry.mCoefs;
+}
+
+template<typename TC, typename TI, typename TO>
+const TC* AudioResamplerDyn<TC, TI, TO>::FilterCache::add(uint64_t key, TC* coefs)
+{
+    Mutex::Autolock _l(sLock);
+    const ssize_t index = sEntries.indexOfKey(key);
+    if (index >= 0) {
+        free(coefs);
+        Entry& entry = sEntries.editValueAt(index);
+        entry.mRefCount++;
+        entry.mLastUse = ++sUseCount;
+        return entry.mCoefs;
+    }
+    Entry entry;
+    entry.mCoefs = coefs;
+    entry.mRefCount = 1;
+    entry.mLastUse = ++sUseCount;
+    sEntries.add(key, entry);
+    return coefs;
+}
+
+template<typename TC, typename TI, typename TO>
+void AudioResamplerDyn<TC, TI, TO>::FilterCache::release(const TC* coefs)
+{
+    Mutex::Autolock _l(sLock);
+    for (size_t i = 0; i < sEntries.size(); ++i) {
+        Entry& entry = sEntries.editValueAt(i);
+        if (entry.mCoefs == coefs) {
+            LOG_ALWAYS_FATAL_IF(entry.mRefCount <= 0, "FilterCache refcount underflow");
+            if (--entry.mRefCount == 0) {
+                trim_l();
+            }
+            return;
+        }
+    }
+    LOG_ALWAYS_FATAL("FilterCache::release() of unknown filter bank %p", coefs);
+}
+
+template<typename TC, typename TI, typename TO>
+void AudioResamplerDyn<TC, TI, TO>::FilterCache::trim_l()
+{
+    for (;;) {
+        size_t unused = 0;
+        ssize_t oldest = -1;
+        for (size_t i = 0; i < sEntries.size(); ++i) {
+            const Entry& entry = sEntries.valueAt(i);
+            if (entry.mRefCount == 0) {
+                // compare by age, which is safe across sUseCount wraparound
+                if (oldest < 0 || static_cast<int32_t>(
+                        sEntries.valueAt(oldest).mLastUse - entry.mLastUse) > 0) {
+                    oldest = i;
+                }
+                unused++;
+            }
+        }
+        if (unused <= kMaxUnusedEntries) {
+            return;
+        }
+        free(sEntries.valueAt(oldest).mCoefs);
+        sEntries.removeItemsAt(oldest);
+    }
+}
+
 template<typename TC, typename TI, typename TO>
 AudioResamplerDyn<TC, TI, TO>::AudioResamplerDyn(
         int inChannelCount, int32_t sampleRate, src_quality quality)
@@ -180,7 +267,9 @@ AudioResamplerDyn<TC, TI, TO>::AudioResamplerDyn(
 template<typename TC, typename TI, typename TO>
 AudioResamplerDyn<TC, TI, TO>::~AudioResamplerDyn()
 {
-    free(mCoefBuffer);
+    if (mCoefBuffer != NULL) {
+        FilterCache::release(mCoefBuffer);
+    }
 }
 
 template<typename TC, typename TI, typename TO>
@@ -210,7 +299,24 @@ template<typename T> T max(T a, T b) {return a > b ? a : b;}
 template<typename T> T absdiff(T a, T b) {return a > b ? a - b : b - a;}
 
 template<typename TC, typename TI, typename TO>
-void AudioResamplerDyn<TC, TI, TO>::createKaiserFir(Constants &c,
+void AudioResamplerDyn<TC, TI, TO>::createKaiserFir(Constants &c, uint64_t key,
+        double stopBandAtten, int inSampleRate, int outSampleRate, double tbwCheat)
+{
+    // reuse a filter bank designed by another resampler if possible
+    const TC* coefs = FilterCache::acquire(key);
+    if (coefs == NULL) {
+        coefs = designKaiserFir(c, stopBandAtten, inSampleRate, outSampleRate, tbwCheat);
+        coefs = FilterCache::add(key, const_cast<TC*>(coefs));
+    }
+    c.mFirCoefs = coefs;
+    if (mCoefBuffer != NULL) {
+        FilterCache::release(mCoefBuffer);
+    }
+    mCoefBuffer = coefs;
+}
+
+template<typename TC, typename TI, typename TO>
+TC* AudioResamplerDyn<TC, TI, TO>::designKaiserFir(const Constants &c,
         double stopBandAtten, int inSampleRate, int outSampleRate, double tbwCheat)
 {
     TC* buf = NULL;
@@ -224,13 +330,8 @@ void AudioResamplerDyn<TC, TI, TO>::createKaiserFir(Constants &c,
     } else { // downsample
         fcr = max(0.5*tbwCheat*outSampleRate/inSampleRate - tbw/2, tbw/2);
     }
-    // create and set filter
+    // create filter
     firKaiserGen(buf, c.mL, c.mHalfNumCoefs, stopBandAtten, fcr, atten);
-    c.mFirCoefs = buf;
-    if (mCoefBuffer) {
-        free(mCoefBuffer);
-    }
-    mCoefBuffer = buf;
 #ifdef DEBUG_RESAMPLER
     // print basic filter stats
     printf("L:%d  hnc:%d  stopBandAtten:%lf  fcr:%lf  atten:%lf  tbw:%lf\n",
@@ -245,6 +346,7 @@ void AudioResamplerDyn<TC, TI, TO>::createKaiserFir(Constants &c,
     printf("passband(%lf, %lf): %.8lf %.8lf %.8lf\n", 0., fp, passMin, passMax, passRipple);
     printf("stopband(%lf, %lf): %.8lf %.3lf\n", fs, 0.5, stopMax, stopRipple);
 #endif
+    return buf;
 }
 
 // recursive gcd. Using objdump, it appears the tail recursion is converted to a while loop.
@@ -381,8 +483,8 @@ void AudioResamplerDyn<TC, TI, TO>::setSampleRate(int32_t inSampleRate)
 
         // create the filter
         mConstants.set(phases, halfLength, inSampleRate, mSampleRate);
-        createKaiserFir(mConstants, stopBandAtten,
-                inSampleRate, mSampleRate, tbwCheat);
+        createKaiserFir(mConstants, filterKey(inSampleRate, mSampleRate, mFilterQuality),
+                stopBandAtten, inSampleRate, mSampleRate, tbwCheat);
     } // End Kaiser filter
 
     // update phase and state based on the new filter.
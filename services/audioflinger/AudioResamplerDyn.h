@@ -20,6 +20,8 @@
 #include <stdint.h>
 #include <sys/types.h>
 #include <cutils/log.h>
+#include <utils/KeyedVector.h>
+#include <utils/Mutex.h>
 
 #include "AudioResampler.h"
 
@@ -107,7 +109,53 @@ private:
         size_t mStateCount; // size of state in units of TI.
     };
 
-    void createKaiserFir(Constants &c, double stopBandAtten,
+    // Process-wide cache of polyphase filter banks, shared by all resamplers of this
+    // instantiation (and hence coefficient type TC) with the same filterKey().
+    // Entries are reference counted.  A few unreferenced entries are kept so that tracks
+    // repeatedly created at the same sample rates do not redesign the filter each time.
+    class FilterCache {
+    public:
+        // returns a new reference to the cached filter bank for key, or NULL if none.
+        static const TC* acquire(uint64_t key);
+
+        // adds a newly designed filter bank, taking ownership of coefs (which must have
+        // been allocated with posix_memalign) and returning a new reference.  If another
+        // thread added the same key first, coefs is freed and the cached bank returned.
+        static const TC* add(uint64_t key, TC* coefs);
+
+        // drops a reference obtained by acquire() or add().
+        static void release(const TC* coefs);
+
+    private:
+        struct Entry {
+            Entry() : mCoefs(NULL), mRefCount(0), mLastUse(0) {}
+            TC*      mCoefs;
+            int32_t  mRefCount;
+            uint32_t mLastUse;  // value of sUseCount when last referenced
+        };
+
+        static const size_t kMaxUnusedEntries = 4;
+
+        // frees the least recently used unreferenced entries above kMaxUnusedEntries.
+        static void trim_l();
+
+        static Mutex sLock;
+        static KeyedVector<uint64_t, Entry> sEntries;
+        static uint32_t sUseCount;
+    };
+
+    // The filter design depends only on the sample rates and quality;
+    // the channel count does not affect the coefficients.
+    static inline uint64_t filterKey(int32_t inSampleRate, int32_t outSampleRate,
+            src_quality quality) {
+        return (static_cast<uint64_t>(inSampleRate) << 32)
+                | (static_cast<uint64_t>(outSampleRate) << 4) | quality;
+    }
+
+    void createKaiserFir(Constants &c, uint64_t key, double stopBandAtten,
+            int inSampleRate, int outSampleRate, double tbwCheat);
+
+    static TC* designKaiserFir(const Constants &c, double stopBandAtten,
             int inSampleRate, int outSampleRate, double tbwCheat);
 
     template<int CHANNELS, bool LOCKED, int STRIDE>
@@ -124,7 +172,7 @@ private:
      resample_ABP_t mResampleFunc;     // called function for resampling
             int32_t mFilterSampleRate; // designed filter sample rate.
         src_quality mFilterQuality;    // designed filter quality.
-              void* mCoefBuffer;       // if a filter is created, this is not null
+           const TC* mCoefBuffer;      // filter bank reference held from FilterCache, or NULL
 };
 
 } // namespace android
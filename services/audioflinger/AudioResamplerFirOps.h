@@ -32,6 +32,13 @@ namespace android {
 #define USE_NEON (false)
 #endif
 
+#if !USE_NEON && defined(__SSE__)
+#define USE_SSE (true)
+#include <xmmintrin.h>
+#else
+#define USE_SSE (false)
+#endif
+
 template<typename T, typename U>
 struct is_same
 {
@@ -1207,6 +1207,116 @@ inline void Process<2, 16>(float* const out,
             lerpP, coefsP1, coefsN1);
 }
 
+// Multichannel (3 to 8 channel) float variants vectorize across the channels of a frame,
+// as the interleaved frame layout does not allow loading consecutive taps of one channel.
+template <int CHANNELS, bool FIXED>
+static inline void ProcessNeonMultichannel(float* out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* sP,
+        const float* sN,
+        const float* volumeLR,
+        float lerpP,
+        const float* coefsP1,
+        const float* coefsN1)
+{
+    COMPILE_TIME_ASSERT_FUNCTION_SCOPE(CHANNELS > 2 && CHANNELS <= 8);
+
+    // channels [0, 4) and [4, 8) in quads, a remaining pair, and a remaining single.
+    enum {
+        QUADS = CHANNELS / 4,
+        PAIR = (CHANNELS & 2) != 0,
+        SINGLE = (CHANNELS & 1) != 0,
+        PAIR_OFFSET = QUADS * 4,
+        SINGLE_OFFSET = QUADS * 4 + PAIR * 2,
+    };
+    float32x4_t accum0 = vdupq_n_f32(0);
+    float32x4_t accum1 = vdupq_n_f32(0);
+    float32x2_t accumPair = vdup_n_f32(0);
+    float accumSingle = 0;
+
+    for (int i = 0; i < count; ++i) {
+        float posCoef = coefsP[i];
+        float negCoef = coefsN[i];
+        if (!FIXED) { // interpolate, same as InterpCompute
+            posCoef = lerpP * (coefsP1[i] - posCoef) + posCoef;
+            negCoef = lerpP * (negCoef - coefsN1[i]) + coefsN1[i];
+        }
+        if (QUADS > 0) {
+            accum0 = vmlaq_n_f32(accum0, vld1q_f32(sP), posCoef);
+            accum0 = vmlaq_n_f32(accum0, vld1q_f32(sN), negCoef);
+        }
+        if (QUADS > 1) {
+            accum1 = vmlaq_n_f32(accum1, vld1q_f32(sP + 4), posCoef);
+            accum1 = vmlaq_n_f32(accum1, vld1q_f32(sN + 4), negCoef);
+        }
+        if (PAIR) {
+            accumPair = vmla_n_f32(accumPair, vld1_f32(sP + PAIR_OFFSET), posCoef);
+            accumPair = vmla_n_f32(accumPair, vld1_f32(sN + PAIR_OFFSET), negCoef);
+        }
+        if (SINGLE) {
+            accumSingle += posCoef * sP[SINGLE_OFFSET];
+            accumSingle += negCoef * sN[SINGLE_OFFSET];
+        }
+        sP -= CHANNELS;
+        sN += CHANNELS;
+    }
+
+    // multichannel output is written, not accumulated, and uses volumeLR[0] (see ProcessBase)
+    if (QUADS > 0) {
+        vst1q_f32(out, vmulq_n_f32(accum0, volumeLR[0]));
+    }
+    if (QUADS > 1) {
+        vst1q_f32(out + 4, vmulq_n_f32(accum1, volumeLR[0]));
+    }
+    if (PAIR) {
+        vst1_f32(out + PAIR_OFFSET, vmul_n_f32(accumPair, volumeLR[0]));
+    }
+    if (SINGLE) {
+        out[SINGLE_OFFSET] = accumSingle * volumeLR[0];
+    }
+}
+
+#define DEFINE_NEON_MULTICHANNEL_PROCESS(CHANNELS) \
+template<> \
+inline void ProcessL<CHANNELS, 16>(float* const out, \
+        int count, \
+        const float* coefsP, \
+        const float* coefsN, \
+        const float* sP, \
+        const float* sN, \
+        const float* const volumeLR) \
+{ \
+    ProcessNeonMultichannel<CHANNELS, true>(out, count, coefsP, coefsN, sP, sN, volumeLR, \
+            0 /*lerpP*/, NULL /*coefsP1*/, NULL /*coefsN1*/); \
+} \
+\
+template<> \
+inline void Process<CHANNELS, 16>(float* const out, \
+        int count, \
+        const float* coefsP, \
+        const float* coefsN, \
+        const float* coefsP1, \
+        const float* coefsN1, \
+        const float* sP, \
+        const float* sN, \
+        float lerpP, \
+        const float* const volumeLR) \
+{ \
+    ProcessNeonMultichannel<CHANNELS, false>(out, count, coefsP, coefsN, sP, sN, volumeLR, \
+            lerpP, coefsP1, coefsN1); \
+}
+
+DEFINE_NEON_MULTICHANNEL_PROCESS(3)
+DEFINE_NEON_MULTICHANNEL_PROCESS(4)
+DEFINE_NEON_MULTICHANNEL_PROCESS(5)
+DEFINE_NEON_MULTICHANNEL_PROCESS(6)
+DEFINE_NEON_MULTICHANNEL_PROCESS(7)
+DEFINE_NEON_MULTICHANNEL_PROCESS(8)
+
+#undef DEFINE_NEON_MULTICHANNEL_PROCESS
+
 #endif //USE_NEON
 
 } // namespace android
@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_RESAMPLER_FIR_PROCESS_SSE_H
+#define ANDROID_AUDIO_RESAMPLER_FIR_PROCESS_SSE_H
+
+namespace android {
+
+// depends on AudioResamplerFirOps.h, AudioResamplerFirProcess.h
+
+#if USE_SSE
+
+//
+// SSE specializations are enabled for Process() and ProcessL() in AudioResamplerFirProcess.h
+// for float coefficients and float samples (the float resampler used by AudioMixer).
+//
+// The mono and stereo variants vectorize across filter taps, like the NEON versions.
+// The multichannel (3 to 8 channel) variants vectorize across the channels of a frame.
+//
+
+template <int CHANNELS, int STRIDE, bool FIXED>
+static inline void ProcessSSEIntrinsic(float* out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* sP,
+        const float* sN,
+        const float* volumeLR,
+        float lerpP,
+        const float* coefsP1,
+        const float* coefsN1)
+{
+    ALOG_ASSERT(count > 0 && (count & 7) == 0); // multiple of 8
+    COMPILE_TIME_ASSERT_FUNCTION_SCOPE(CHANNELS == 1 || CHANNELS == 2);
+
+    sP -= CHANNELS * 3;  // the positive side consumes 4 frames backwards per step
+    __m128 accum = _mm_setzero_ps();
+    const __m128 interp = _mm_set1_ps(lerpP);
+
+    do {
+        __m128 posCoef = _mm_load_ps(coefsP);
+        __m128 negCoef = _mm_load_ps(coefsN);
+        coefsP += 4;
+        coefsN += 4;
+        if (!FIXED) { // interpolate
+            const __m128 posCoef1 = _mm_load_ps(coefsP1);
+            const __m128 negCoef1 = _mm_load_ps(coefsN1);
+            coefsP1 += 4;
+            coefsN1 += 4;
+            posCoef = _mm_add_ps(posCoef, _mm_mul_ps(interp, _mm_sub_ps(posCoef1, posCoef)));
+            negCoef = _mm_add_ps(negCoef1, _mm_mul_ps(interp, _mm_sub_ps(negCoef, negCoef1)));
+        }
+        switch (CHANNELS) {
+        case 1: {
+            // positive samples are in reverse order relative to the coefficients
+            __m128 posSamp = _mm_loadu_ps(sP);
+            const __m128 negSamp = _mm_loadu_ps(sN);
+            posSamp = _mm_shuffle_ps(posSamp, posSamp, _MM_SHUFFLE(0, 1, 2, 3));
+            sP -= 4;
+            sN += 4;
+            accum = _mm_add_ps(accum, _mm_mul_ps(posSamp, posCoef));
+            accum = _mm_add_ps(accum, _mm_mul_ps(negSamp, negCoef));
+        } break;
+        case 2: {
+            // each vector holds two stereo frames, pair each frame with its coefficient
+            const __m128 posSampLo = _mm_loadu_ps(sP + 4);   // frames -1, 0
+            const __m128 posSampHi = _mm_loadu_ps(sP);       // frames -3, -2
+            const __m128 negSampLo = _mm_loadu_ps(sN);       // frames 0, 1
+            const __m128 negSampHi = _mm_loadu_ps(sN + 4);   // frames 2, 3
+            sP -= 8;
+            sN += 8;
+            const __m128 posCoefLo = _mm_shuffle_ps(posCoef, posCoef, _MM_SHUFFLE(0, 0, 1, 1));
+            const __m128 posCoefHi = _mm_shuffle_ps(posCoef, posCoef, _MM_SHUFFLE(2, 2, 3, 3));
+            accum = _mm_add_ps(accum, _mm_mul_ps(posSampLo, posCoefLo));
+            accum = _mm_add_ps(accum, _mm_mul_ps(posSampHi, posCoefHi));
+            accum = _mm_add_ps(accum, _mm_mul_ps(negSampLo, _mm_unpacklo_ps(negCoef, negCoef)));
+            accum = _mm_add_ps(accum, _mm_mul_ps(negSampHi, _mm_unpackhi_ps(negCoef, negCoef)));
+        } break;
+        }
+    } while (count -= 4);
+
+    // reduce to L/R and accumulate with volume
+    float result[4];
+    if (CHANNELS == 1) {
+        accum = _mm_add_ps(accum, _mm_movehl_ps(accum, accum));
+        accum = _mm_add_ss(accum, _mm_shuffle_ps(accum, accum, _MM_SHUFFLE(1, 1, 1, 1)));
+        accum = _mm_shuffle_ps(accum, accum, _MM_SHUFFLE(0, 0, 0, 0));
+    } else {
+        accum = _mm_add_ps(accum, _mm_movehl_ps(accum, accum));
+    }
+    _mm_storeu_ps(result, accum);
+    out[0] += result[0] * volumeLR[0];
+    out[1] += result[1] * volumeLR[1];
+}
+
+template <int CHANNELS, bool FIXED>
+static inline void ProcessSSEMultichannel(float* out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* sP,
+        const float* sN,
+        const float* volumeLR,
+        float lerpP,
+        const float* coefsP1,
+        const float* coefsN1)
+{
+    COMPILE_TIME_ASSERT_FUNCTION_SCOPE(CHANNELS > 2 && CHANNELS <= 8);
+
+    // channels [0, 4) and [4, 8) in quads, a remaining pair, and a remaining single.
+    enum {
+        QUADS = CHANNELS / 4,
+        PAIR = (CHANNELS & 2) != 0,
+        SINGLE = (CHANNELS & 1) != 0,
+        PAIR_OFFSET = QUADS * 4,
+        SINGLE_OFFSET = QUADS * 4 + PAIR * 2,
+    };
+    __m128 accum0 = _mm_setzero_ps();
+    __m128 accum1 = _mm_setzero_ps();
+    __m128 accumPair = _mm_setzero_ps();
+    float accumSingle = 0;
+
+    for (int i = 0; i < count; ++i) {
+        float posCoef = coefsP[i];
+        float negCoef = coefsN[i];
+        if (!FIXED) { // interpolate, same as InterpCompute
+            posCoef = lerpP * (coefsP1[i] - posCoef) + posCoef;
+            negCoef = lerpP * (negCoef - coefsN1[i]) + coefsN1[i];
+        }
+        const __m128 pc = _mm_set1_ps(posCoef);
+        const __m128 nc = _mm_set1_ps(negCoef);
+        if (QUADS > 0) {
+            accum0 = _mm_add_ps(accum0, _mm_mul_ps(pc, _mm_loadu_ps(sP)));
+            accum0 = _mm_add_ps(accum0, _mm_mul_ps(nc, _mm_loadu_ps(sN)));
+        }
+        if (QUADS > 1) {
+            accum1 = _mm_add_ps(accum1, _mm_mul_ps(pc, _mm_loadu_ps(sP + 4)));
+            accum1 = _mm_add_ps(accum1, _mm_mul_ps(nc, _mm_loadu_ps(sN + 4)));
+        }
+        if (PAIR) {
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 ps = _mm_loadl_pi(zero, (const __m64*)(sP + PAIR_OFFSET));
+            const __m128 ns = _mm_loadl_pi(zero, (const __m64*)(sN + PAIR_OFFSET));
+            accumPair = _mm_add_ps(accumPair, _mm_mul_ps(pc, ps));
+            accumPair = _mm_add_ps(accumPair, _mm_mul_ps(nc, ns));
+        }
+        if (SINGLE) {
+            accumSingle += posCoef * sP[SINGLE_OFFSET];
+            accumSingle += negCoef * sN[SINGLE_OFFSET];
+        }
+        sP -= CHANNELS;
+        sN += CHANNELS;
+    }
+
+    // multichannel output is written, not accumulated, and uses volumeLR[0] (see ProcessBase)
+    const __m128 vol = _mm_set1_ps(volumeLR[0]);
+    if (QUADS > 0) {
+        _mm_storeu_ps(out, _mm_mul_ps(accum0, vol));
+    }
+    if (QUADS > 1) {
+        _mm_storeu_ps(out + 4, _mm_mul_ps(accum1, vol));
+    }
+    if (PAIR) {
+        _mm_storel_pi((__m64*)(out + PAIR_OFFSET), _mm_mul_ps(accumPair, vol));
+    }
+    if (SINGLE) {
+        out[SINGLE_OFFSET] = accumSingle * volumeLR[0];
+    }
+}
+
+template<>
+inline void ProcessL<1, 16>(float* const out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* sP,
+        const float* sN,
+        const float* const volumeLR)
+{
+    ProcessSSEIntrinsic<1, 16, true>(out, count, coefsP, coefsN, sP, sN, volumeLR,
+            0 /*lerpP*/, NULL /*coefsP1*/, NULL /*coefsN1*/);
+}
+
+template<>
+inline void ProcessL<2, 16>(float* const out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* sP,
+        const float* sN,
+        const float* const volumeLR)
+{
+    ProcessSSEIntrinsic<2, 16, true>(out, count, coefsP, coefsN, sP, sN, volumeLR,
+            0 /*lerpP*/, NULL /*coefsP1*/, NULL /*coefsN1*/);
+}
+
+template<>
+inline void Process<1, 16>(float* const out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* coefsP1,
+        const float* coefsN1,
+        const float* sP,
+        const float* sN,
+        float lerpP,
+        const float* const volumeLR)
+{
+    ProcessSSEIntrinsic<1, 16, false>(out, count, coefsP, coefsN, sP, sN, volumeLR,
+            lerpP, coefsP1, coefsN1);
+}
+
+template<>
+inline void Process<2, 16>(float* const out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* coefsP1,
+        const float* coefsN1,
+        const float* sP,
+        const float* sN,
+        float lerpP,
+        const float* const volumeLR)
+{
+    ProcessSSEIntrinsic<2, 16, false>(out, count, coefsP, coefsN, sP, sN, volumeLR,
+            lerpP, coefsP1, coefsN1);
+}
+
+// multichannel specializations, 3 to 8 channels
+#define DEFINE_SSE_MULTICHANNEL_PROCESS(CHANNELS) \
+template<> \
+inline void ProcessL<CHANNELS, 16>(float* const out, \
+        int count, \
+        const float* coefsP, \
+        const float* coefsN, \
+        const float* sP, \
+        const float* sN, \
+        const float* const volumeLR) \
+{ \
+    ProcessSSEMultichannel<CHANNELS, true>(out, count, coefsP, coefsN, sP, sN, volumeLR, \
+            0 /*lerpP*/, NULL /*coefsP1*/, NULL /*coefsN1*/); \
+} \
+\
+template<> \
+inline void Process<CHANNELS, 16>(float* const out, \
+        int count, \
+        const float* coefsP, \
+        const float* coefsN, \
+        const float* coefsP1, \
+        const float* coefsN1, \
+        const float* sP, \
+        const float* sN, \
+        float lerpP, \
+        const float* const volumeLR) \
+{ \
+    ProcessSSEMultichannel<CHANNELS, false>(out, count, coefsP, coefsN, sP, sN, volumeLR, \
+            lerpP, coefsP1, coefsN1); \
+}
+
+DEFINE_SSE_MULTICHANNEL_PROCESS(3)
+DEFINE_SSE_MULTICHANNEL_PROCESS(4)
+DEFINE_SSE_MULTICHANNEL_PROCESS(5)
+DEFINE_SSE_MULTICHANNEL_PROCESS(6)
+DEFINE_SSE_MULTICHANNEL_PROCESS(7)
+DEFINE_SSE_MULTICHANNEL_PROCESS(8)
+
+#undef DEFINE_SSE_MULTICHANNEL_PROCESS
+
+#endif //USE_SSE
+
+} // namespace android
+
+#endif /*ANDROID_AUDIO_RESAMPLER_FIR_PROCESS_SSE_H*/
@@ -331,6 +331,7 @@ TimestretchBufferProvider::TimestretchBufferProvider(int32_t channelCount,
         mLocalBufferFrameCount(0),
         mLocalBufferData(NULL),
         mRemaining(0),
+        mRemainingOffset(0),
         mSonicStream(sonicCreateStream(sampleRate, mChannelCount)),
         mFallbackFailErrorShown(false),
         mAudioPlaybackRateValid(false)
@@ -367,10 +368,21 @@ status_t TimestretchBufferProvider::getNextBuffer(
     // check if previously processed data is sufficient.
     if (pBuffer->frameCount <= mRemaining) {
         ALOGV("previous sufficient");
-        pBuffer->raw = mLocalBufferData;
+        pBuffer->raw = (uint8_t*)mLocalBufferData + mRemainingOffset * mFrameSize;
         return OK;
     }
 
+    // move any unconsumed data to the front before appending; releaseBuffer() only
+    // advances the offset so the shift happens at most once per refill.
+    if (mRemainingOffset != 0) {
+        if (mRemaining != 0) {
+            memmove(mLocalBufferData,
+                    (uint8_t*)mLocalBufferData + mRemainingOffset * mFrameSize,
+                    mRemaining * mFrameSize);
+        }
+        mRemainingOffset = 0;
+    }
+
     // do we need to resize our buffer?
     if (pBuffer->frameCount > mLocalBufferFrameCount) {
         void *newmem;
@@ -437,12 +449,11 @@ void TimestretchBufferProvider::releaseBuffer(AudioBufferProvider::Buffer *pBuff
 
     // LOG_ALWAYS_FATAL_IF(pBuffer->frameCount == 0, "Invalid framecount");
     if (pBuffer->frameCount < mRemaining) {
-        memcpy(mLocalBufferData,
-                (uint8_t*)mLocalBufferData + pBuffer->frameCount * mFrameSize,
-                (mRemaining - pBuffer->frameCount) * mFrameSize);
+        mRemainingOffset += pBuffer->frameCount;
         mRemaining -= pBuffer->frameCount;
     } else if (pBuffer->frameCount == mRemaining) {
         mRemaining = 0;
+        mRemainingOffset = 0;
     } else {
         LOG_ALWAYS_FATAL("Releasing more frames(%zu) than available(%zu)",
                 pBuffer->frameCount, mRemaining);
@@ -455,6 +466,7 @@ void TimestretchBufferProvider::releaseBuffer(AudioBufferProvider::Buffer *pBuff
 void TimestretchBufferProvider::reset()
 {
     mRemaining = 0;
+    mRemainingOffset = 0;
 }
 
 status_t TimestretchBufferProvider::setPlaybackRate(const AudioPlaybackRate &playbackRate)
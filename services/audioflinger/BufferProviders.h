@@ -185,6 +185,8 @@ private:
     void                *mLocalBufferData;        // internally allocated buffer for data returned
                                                   // to caller
     size_t               mRemaining;              // remaining data in local buffer
+    size_t               mRemainingOffset;        // frames already released at the start
+                                                  // of the local buffer
     sonicStream          mSonicStream;            // handle to sonic timestretch object
     //FIXME: this dependency should be abstracted out
     bool                 mFallbackFailErrorShown; // log fallback error only once
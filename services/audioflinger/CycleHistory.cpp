@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "CycleHistory"
+//#define LOG_NDEBUG 0
+
+#include "Configuration.h"
+#include <stdio.h>
+#include <string.h>
+#include <utils/Log.h>
+#include "CycleHistory.h"
+
+namespace android {
+
+void CycleHistory::reset()
+{
+    memset(mCycles, 0, sizeof(mCycles));
+    mNumCycles = 0;
+    memset(mSnapshots, 0, sizeof(mSnapshots));
+    mNumSnapshots = 0;
+}
+
+// static
+uint32_t CycleHistory::toUs(nsecs_t ns)
+{
+    if (ns <= 0) {
+        return 0;
+    }
+    if (ns / 1000 >= (nsecs_t) UINT32_MAX) {
+        return UINT32_MAX;
+    }
+    return (uint32_t) (ns / 1000);
+}
+
+void CycleHistory::add(const Cycle& cycle)
+{
+    mCycles[mNumCycles % kNumCycles] = cycle;
+    ++mNumCycles;
+}
+
+void CycleHistory::capture(nsecs_t nowNs, nsecs_t delayNs)
+{
+    Snapshot& snapshot = mSnapshots[mNumSnapshots % kNumSnapshots];
+    snapshot.mTimeNs = nowNs;
+    snapshot.mDelayUs = toUs(delayNs);
+    snapshot.mNumCycles = mNumCycles < kNumCycles ? mNumCycles : kNumCycles;
+    // unroll the ring so the snapshot is stored oldest first
+    const uint32_t first = mNumCycles - snapshot.mNumCycles;
+    for (uint32_t i = 0; i < snapshot.mNumCycles; ++i) {
+        snapshot.mCycles[i] = mCycles[(first + i) % kNumCycles];
+    }
+    ++mNumSnapshots;
+}
+
+void CycleHistory::dump(int fd) const
+{
+    if (mNumSnapshots == 0) {
+        dprintf(fd, "  Delayed write history: none\n");
+        return;
+    }
+    const uint32_t count = mNumSnapshots < kNumSnapshots ? mNumSnapshots : kNumSnapshots;
+    dprintf(fd, "  Delayed write history (last %u of %u):\n", count, mNumSnapshots);
+    const nsecs_t now = systemTime();
+    for (uint32_t i = mNumSnapshots - count; i != mNumSnapshots; ++i) {
+        const Snapshot& snapshot = mSnapshots[i % kNumSnapshots];
+        dprintf(fd, "    %lld ms ago, write delayed %u us; cycles (us) oldest first:\n",
+                (long long) ns2ms(now - snapshot.mTimeNs), snapshot.mDelayUs);
+        dprintf(fd, "      period      mix  effects    write  sleep+\n");
+        for (uint32_t j = 0; j < snapshot.mNumCycles; ++j) {
+            const Cycle& cycle = snapshot.mCycles[j];
+            const uint32_t periodUs = j > 0
+                    ? toUs(cycle.mStartNs - snapshot.mCycles[j - 1].mStartNs) : 0;
+            dprintf(fd, "      %6u %8u %8u %8u %7u\n", periodUs, cycle.mMixUs,
+                    cycle.mEffectsUs, cycle.mWriteUs, cycle.mSleepOverrunUs);
+        }
+    }
+}
+
+}   // namespace android
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_CYCLE_HISTORY_H
+#define ANDROID_AUDIO_CYCLE_HISTORY_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+// Keeps the timing breakdown of the last kNumCycles thread loop cycles, and a copy of that
+// history for each of the last kNumSnapshots delayed writes, so that an intermittent underrun
+// can be diagnosed from dumpsys after the fact.
+// Updated by a single thread without locks; a concurrent dump() may see a slightly
+// inconsistent snapshot, with the usual caveats for dumpsys.
+class CycleHistory {
+public:
+    // Durations of the phases of one thread loop cycle, in microseconds.
+    struct Cycle {
+        nsecs_t     mStartNs;       // systemTime() at the start of the cycle
+        uint32_t    mMixUs;         // threadLoop_mix()
+        uint32_t    mEffectsUs;     // effect chains process_l()
+        uint32_t    mWriteUs;       // threadLoop_write(), including blocking in the HAL
+        uint32_t    mSleepOverrunUs; // actual minus requested sleep
+    };
+
+    CycleHistory() { reset(); }
+
+    void        reset();
+
+    // Record one completed cycle, overwriting the oldest.
+    void        add(const Cycle& cycle);
+
+    // Save the current history; called when a write was delayed by delayNs.
+    void        capture(nsecs_t nowNs, nsecs_t delayNs);
+
+    // Dump the saved histories, oldest snapshot first.
+    void        dump(int fd) const;
+
+    // Convert a duration to the microsecond units of Cycle; negative values become 0.
+    static uint32_t toUs(nsecs_t ns);
+
+private:
+    static const uint32_t kNumCycles = 16;
+    static const uint32_t kNumSnapshots = 4;
+
+    struct Snapshot {
+        nsecs_t     mTimeNs;        // when the delayed write was detected
+        uint32_t    mDelayUs;       // time since the previous write
+        uint32_t    mNumCycles;     // valid entries in mCycles, oldest first
+        Cycle       mCycles[kNumCycles];
+    };
+
+    Cycle       mCycles[kNumCycles];
+    uint32_t    mNumCycles;         // total number of cycles added, wraps
+    Snapshot    mSnapshots[kNumSnapshots];
+    uint32_t    mNumSnapshots;      // total number of snapshots captured, wraps
+};
+
+}   // namespace android
+
+#endif  // ANDROID_AUDIO_CYCLE_HISTORY_H
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_EFFECT_BUFFER_OPS_H
+#define ANDROID_AUDIO_EFFECT_BUFFER_OPS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <audio_utils/primitives.h>
+
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define USE_EFFECT_NEON (true)
+#define USE_EFFECT_SSE (false)
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_EFFECT_NEON (false)
+#define USE_EFFECT_SSE (true)
+#else
+#define USE_EFFECT_NEON (false)
+#define USE_EFFECT_SSE (false)
+#endif
+
+namespace android {
+
+//
+// Buffer operations done by EffectModule around the effect engines.
+// The vector paths are bit-exact with the scalar audio_utils primitives.
+//
+
+// out[i] = clamp16(out[i] + in[i]) for count samples.
+// Used to pass an idle insert effect's input through onto its output.
+static inline void effectAccumulateClamp16(int16_t *out, const int16_t *in, size_t count)
+{
+#if USE_EFFECT_NEON
+    for (; count >= 8; count -= 8, in += 8, out += 8) {
+        vst1q_s16(out, vqaddq_s16(vld1q_s16(out), vld1q_s16(in)));
+    }
+#elif USE_EFFECT_SSE
+    for (; count >= 8; count -= 8, in += 8, out += 8) {
+        const __m128i o = _mm_loadu_si128((const __m128i *) out);
+        const __m128i i = _mm_loadu_si128((const __m128i *) in);
+        _mm_storeu_si128((__m128i *) out, _mm_adds_epi16(o, i));
+    }
+#endif
+    for (; count > 0; --count) {
+        *out = clamp16((int32_t) *out + (int32_t) *in++);
+        ++out;
+    }
+}
+
+// Same as ditherAndClamp(): converts pairs of Q4.27 samples in sums to pairs of
+// 16 bit samples packed in out.  out may be the same as sums.
+static inline void effectDitherAndClamp(int32_t *out, const int32_t *sums, size_t pairs)
+{
+#if USE_EFFECT_NEON
+    for (; pairs >= 4; pairs -= 4, sums += 8, out += 4) {
+        // both loads complete before the store, so in place conversion is safe
+        const int32x4_t lo = vld1q_s32(sums);
+        const int32x4_t hi = vld1q_s32(sums + 4);
+        vst1q_s16((int16_t *) out, vcombine_s16(vqshrn_n_s32(lo, 12), vqshrn_n_s32(hi, 12)));
+    }
+#elif USE_EFFECT_SSE
+    for (; pairs >= 4; pairs -= 4, sums += 8, out += 4) {
+        // both loads complete before the store, so in place conversion is safe
+        const __m128i lo = _mm_srai_epi32(_mm_loadu_si128((const __m128i *) sums), 12);
+        const __m128i hi = _mm_srai_epi32(_mm_loadu_si128((const __m128i *) (sums + 4)), 12);
+        _mm_storeu_si128((__m128i *) out, _mm_packs_epi32(lo, hi));
+    }
+#endif
+    if (pairs > 0) {
+        ditherAndClamp(out, sums, pairs);
+    }
+}
+
+} // namespace android
+
+#endif // ANDROID_AUDIO_EFFECT_BUFFER_OPS_H
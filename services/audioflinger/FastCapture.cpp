@@ -37,6 +37,8 @@ FastCapture::FastCapture() : FastThread(),
     // mDummyDumpState
     mTotalNativeFramesRead(0)
 {
+    mReadTs.tv_sec = 0;
+    mReadTs.tv_nsec = 0;
     mPrevious = &sInitial;
     mCurrent = &sInitial;
 
@@ -170,6 +172,9 @@ void FastCapture::onWork()
                 AudioBufferProvider::kInvalidPTS);
         ATRACE_END();
         dumpState->mReadSequence++;
+        if (framesRead > 0) {
+            clock_gettime(CLOCK_MONOTONIC, &mReadTs);
+        }
         if (framesRead >= 0) {
             LOG_ALWAYS_FATAL_IF((size_t) framesRead > frameCount);
             mTotalNativeFramesRead += framesRead;
@@ -201,6 +206,9 @@ void FastCapture::onWork()
                 int32_t rear = cblk->u.mStreaming.mRear;
                 android_atomic_release_store(framesWritten + rear, &cblk->u.mStreaming.mRear);
                 cblk->mServer += framesWritten;
+                if (current->mServerProxy != NULL) {
+                    current->mServerProxy->setTimestamp(mReadTs);
+                }
                 int32_t old = android_atomic_or(CBLK_FUTEX_WAKE, &cblk->mFutex);
                 if (!(old & CBLK_FUTEX_WAKE)) {
                     // client is never in server process, so don't use FUTEX_WAKE_PRIVATE
@@ -61,6 +61,7 @@ private:
     unsigned            mSampleRate;
     FastCaptureDumpState mDummyFastCaptureDumpState;
     uint32_t            mTotalNativeFramesRead; // copied to dumpState->mFramesRead
+    struct timespec     mReadTs;    // CLOCK_MONOTONIC time the last successful read returned
 
 };  // class FastCapture
 
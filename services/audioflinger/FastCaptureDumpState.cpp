@@ -48,6 +48,10 @@ void FastCaptureDumpState::dump(int fd) const
                 FastCaptureState::commandToString(mCommand), mReadSequence, mFramesRead,
                 mReadErrors, mSampleRate, mFrameCount, measuredWarmupMs, mWarmupCycles,
                 periodSec * 1e3);
+#ifdef FAST_THREAD_STATISTICS
+    dprintf(fd, "  Involuntary context switches=%u, underruns=%u of which preempted=%u\n",
+                mInvoluntarySwitches, mUnderruns, mPreemptedUnderruns);
+#endif
 }
 
 }   // android
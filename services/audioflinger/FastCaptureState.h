@@ -36,6 +36,8 @@ struct FastCaptureState : FastThreadState {
     int             mPipeSinkGen;       // increment when mPipeSink is assigned
     size_t          mFrameCount;        // number of frames per fast capture buffer
     audio_track_cblk_t* mCblk;          // control block for the single fast client, or NULL
+    AudioRecordServerProxy* mServerProxy; // server proxy of the fast client, or NULL;
+                                        // only used to report its capture timestamps
 
     // Extends FastThreadState::Command
     static const Command
@@ -284,6 +284,11 @@ void FastMixer::onStateChange()
         // finally process (potentially) modified tracks; these use the same slot
         // but may have a different buffer provider or volume provider
         unsigned modifiedTracks = currentTrackMask & previousTrackMask;
+        // if the mutator's delta is relative to the state we last applied, then only the
+        // tracks it marked can have changed, and the others need not be touched at all
+        if (current->mModifiedTracksGen == mFastTracksGen) {
+            modifiedTracks &= current->mModifiedTracks;
+        }
         while (modifiedTracks != 0) {
             int i = __builtin_ctz(modifiedTracks);
             modifiedTracks &= ~(1 << i);
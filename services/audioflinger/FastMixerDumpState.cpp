@@ -74,6 +74,8 @@ void FastMixerDumpState::dump(int fd) const
                 mSampleRate, mFrameCount, measuredWarmupMs, mWarmupCycles,
                 mixPeriodSec * 1e3);
 #ifdef FAST_THREAD_STATISTICS
+    dprintf(fd, "  Involuntary context switches=%u, underruns of preempted cycles=%u\n",
+                mInvoluntarySwitches, mPreemptedUnderruns);
     // find the interval of valid samples
     uint32_t bounds = mBounds;
     uint32_t newestOpen = bounds & 0xFFFF;
@@ -30,8 +30,8 @@ FastTrack::~FastTrack()
 
 FastMixerState::FastMixerState() : FastThreadState(),
     // mFastTracks
-    mFastTracksGen(0), mTrackMask(0), mOutputSink(NULL), mOutputSinkGen(0),
-    mFrameCount(0), mTeeSink(NULL)
+    mFastTracksGen(0), mTrackMask(0), mModifiedTracks(0), mModifiedTracksGen(0),
+    mOutputSink(NULL), mOutputSinkGen(0), mFrameCount(0), mTeeSink(NULL)
 {
 }
 
@@ -39,6 +39,19 @@ FastMixerState::~FastMixerState()
 {
 }
 
+void FastMixerState::trackModified(unsigned i)
+{
+    ALOG_ASSERT(i < kMaxFastTracks);
+    // The first modification after a push starts a new delta relative to the pushed state.
+    // If the previous mutation was not pushed, its delta is discarded here; the fast mixer
+    // then sees a mismatched mModifiedTracksGen and falls back to checking all tracks.
+    if (mModifiedTracksGen != mFastTracksGen) {
+        mModifiedTracks = 0;
+        mModifiedTracksGen = mFastTracksGen;
+    }
+    mModifiedTracks |= 1 << i;
+}
+
 // static
 const char *FastMixerState::commandToString(Command command)
 {
@@ -60,6 +60,9 @@ struct FastMixerState : FastThreadState {
     FastTrack   mFastTracks[kMaxFastTracks];
     int         mFastTracksGen; // increment when any mFastTracks[i].mGeneration is incremented
     unsigned    mTrackMask;     // bit i is set if and only if mFastTracks[i] is active
+    unsigned    mModifiedTracks;    // bit i is set if mFastTracks[i].mGeneration was incremented
+                                    // since the state whose mFastTracksGen is mModifiedTracksGen
+    int         mModifiedTracksGen; // mFastTracksGen that mModifiedTracks is relative to
     NBAIO_Sink* mOutputSink;    // HAL output device, must already be negotiated
     int         mOutputSinkGen; // increment when mOutputSink is assigned
     size_t      mFrameCount;    // number of frames per fast mix buffer
@@ -74,6 +77,11 @@ struct FastMixerState : FastThreadState {
     // This might be a one-time configuration rather than per-state
     NBAIO_Sink* mTeeSink;       // if non-NULL, then duplicate write()s to this non-blocking sink
 
+    // Called by the mutator each time it increments mFastTracks[i].mGeneration, before it
+    // increments mFastTracksGen for the same mutation.  This lets the fast mixer visit only
+    // the modified tracks instead of comparing the generation of every track.
+    void        trackModified(unsigned i);
+
     // never returns NULL; asserts if command is invalid
     static const char *commandToString(Command command);
 };  // struct FastMixerState
@@ -54,6 +54,8 @@ FastThread::FastThread() : Thread(false /*canCallJava*/),
 #ifdef FAST_THREAD_STATISTICS
     // mOldLoad
     mOldLoadValid(false),
+    // mOldInvoluntarySwitches
+    mOldInvoluntarySwitchesValid(false),
     mBounds(0),
     mFull(false),
     // mTcu
@@ -132,6 +134,7 @@ bool FastThread::threadLoop()
                     mOldTsValid = false;
 #ifdef FAST_THREAD_STATISTICS
                     mOldLoadValid = false;
+                    mOldInvoluntarySwitchesValid = false;
 #endif
                     mIgnoreNextOverrun = true;
                 }
@@ -253,14 +256,34 @@ bool FastThread::threadLoop()
                         mDumpState->mWarmupCycles = mWarmupCycles;
                     }
                 }
+#ifdef FAST_THREAD_STATISTICS
+                // number of times this thread was preempted during the previous cycle
+                long involuntarySwitches = 0;
+                long newInvoluntarySwitches;
+                if (ThreadCpuUsage::getInvoluntaryContextSwitches(newInvoluntarySwitches)) {
+                    if (mOldInvoluntarySwitchesValid) {
+                        involuntarySwitches = newInvoluntarySwitches - mOldInvoluntarySwitches;
+                    }
+                    mOldInvoluntarySwitches = newInvoluntarySwitches;
+                    mOldInvoluntarySwitchesValid = true;
+                }
+#endif
                 mSleepNs = -1;
                 if (mIsWarm) {
+#ifdef FAST_THREAD_STATISTICS
+                    mDumpState->mInvoluntarySwitches += involuntarySwitches;
+#endif
                     if (sec > 0 || nsec > mUnderrunNs) {
                         ATRACE_NAME("underrun");
                         // FIXME only log occasionally
                         ALOGV("underrun: time since last cycle %d.%03ld sec",
                                 (int) sec, nsec / 1000000L);
                         mDumpState->mUnderruns++;
+#ifdef FAST_THREAD_STATISTICS
+                        if (involuntarySwitches > 0) {
+                            mDumpState->mPreemptedUnderruns++;
+                        }
+#endif
                         mIgnoreNextOverrun = true;
                     } else if (nsec < mOverrunNs) {
                         if (mIgnoreNextOverrun) {
@@ -18,7 +18,7 @@
 #define ANDROID_AUDIO_FAST_THREAD_H
 
 #include "Configuration.h"
-#ifdef CPU_FREQUENCY_STATISTICS
+#ifdef FAST_THREAD_STATISTICS
 #include <cpustats/ThreadCpuUsage.h>
 #endif
 #include <utils/Thread.h>
@@ -69,6 +69,8 @@ protected:
 #ifdef FAST_THREAD_STATISTICS
     struct timespec mOldLoad;       // previous value of clock_gettime(CLOCK_THREAD_CPUTIME_ID)
     bool            mOldLoadValid;  // whether oldLoad is valid
+    long            mOldInvoluntarySwitches;    // previous involuntary context switch count
+    bool            mOldInvoluntarySwitchesValid;   // whether mOldInvoluntarySwitches is valid
     uint32_t        mBounds;
     bool            mFull;          // whether we have collected at least mSamplingN samples
 #ifdef CPU_FREQUENCY_STATISTICS
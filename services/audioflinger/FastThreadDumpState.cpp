@@ -23,7 +23,7 @@ FastThreadDumpState::FastThreadDumpState() :
     /* mMeasuredWarmupTs({0, 0}), */
     mWarmupCycles(0)
 #ifdef FAST_THREAD_STATISTICS
-    , mSamplingN(0), mBounds(0)
+    , mSamplingN(0), mBounds(0), mInvoluntarySwitches(0), mPreemptedUnderruns(0)
 #endif
 {
     mMeasuredWarmupTs.tv_sec = 0;
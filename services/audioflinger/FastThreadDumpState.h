@@ -55,6 +55,9 @@ struct FastThreadDumpState {
     // Number of valid samples is newest - oldest.
     uint32_t mBounds;                   // bounds for mMonotonicNs, mThreadCpuNs, and mCpukHz
     // The elements in the *Ns arrays are in units of nanoseconds <= 3999999999.
+    uint32_t mInvoluntarySwitches;      // total involuntary context switches while warm
+    uint32_t mPreemptedUnderruns;       // underruns of cycles during which the thread was
+                                        // involuntarily context switched
     uint32_t mMonotonicNs[kSamplingN];  // delta monotonic (wall clock) time
     uint32_t mLoadNs[kSamplingN];       // delta CPU load in time
 #ifdef CPU_FREQUENCY_STATISTICS
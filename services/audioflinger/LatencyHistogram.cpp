@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "LatencyHistogram"
+//#define LOG_NDEBUG 0
+
+#include "Configuration.h"
+#include <stdio.h>
+#include <string.h>
+#include <utils/Log.h>
+#include <utils/String8.h>
+#include "LatencyHistogram.h"
+
+namespace android {
+
+void LatencyHistogram::reset()
+{
+    mCount = 0;
+    mMinUs = UINT32_MAX;
+    mMaxUs = 0;
+    mTotalUs = 0;
+    memset(mBuckets, 0, sizeof(mBuckets));
+}
+
+// static
+uint32_t LatencyHistogram::bucketIndex(uint32_t us)
+{
+    if (us < kSubBuckets) {
+        return us;
+    }
+    const uint32_t exponent = 31 - __builtin_clz(us);   // >= kSubBucketBits
+    const uint32_t sub = (us >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+    return (exponent - kSubBucketBits + 1) * kSubBuckets + sub;
+}
+
+// static
+uint32_t LatencyHistogram::bucketLowerBound(uint32_t index)
+{
+    if (index < kSubBuckets) {
+        return index;
+    }
+    const uint32_t exponent = index / kSubBuckets + kSubBucketBits - 1;
+    const uint32_t sub = index % kSubBuckets;
+    return (kSubBuckets + sub) << (exponent - kSubBucketBits);
+}
+
+void LatencyHistogram::add(nsecs_t ns)
+{
+    uint32_t us;
+    if (ns <= 0) {
+        us = 0;
+    } else if (ns / 1000 >= (nsecs_t) UINT32_MAX) {
+        us = UINT32_MAX;
+    } else {
+        us = (uint32_t) (ns / 1000);
+    }
+    ++mBuckets[bucketIndex(us)];
+    ++mCount;
+    mTotalUs += us;
+    if (us < mMinUs) {
+        mMinUs = us;
+    }
+    if (us > mMaxUs) {
+        mMaxUs = us;
+    }
+}
+
+uint32_t LatencyHistogram::percentile(uint32_t permille) const
+{
+    const uint64_t target = ((uint64_t) mCount * permille + 999) / 1000;
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < kNumBuckets; ++i) {
+        sum += mBuckets[i];
+        if (sum >= target && sum > 0) {
+            // report the bucket's upper bound, but never more than the largest value seen
+            const uint32_t upper = i + 1 < kNumBuckets ? bucketLowerBound(i + 1) : UINT32_MAX;
+            return upper < mMaxUs ? upper : mMaxUs;
+        }
+    }
+    return mMaxUs;
+}
+
+void LatencyHistogram::dump(int fd, const char *name) const
+{
+    if (mCount == 0) {
+        dprintf(fd, "  %s: no samples\n", name);
+        return;
+    }
+    dprintf(fd, "  %s (us): count=%u min=%u mean=%llu p50=%u p90=%u p99=%u p99.9=%u max=%u\n",
+            name, mCount, mMinUs, (unsigned long long) (mTotalUs / mCount),
+            percentile(500), percentile(900), percentile(990), percentile(999), mMaxUs);
+    String8 result("   ");
+    for (uint32_t i = 0; i < kNumBuckets; ++i) {
+        if (mBuckets[i] != 0) {
+            result.appendFormat(" %u:%u", bucketLowerBound(i), mBuckets[i]);
+        }
+    }
+    dprintf(fd, "%s\n", result.string());
+}
+
+}   // namespace android
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_LATENCY_HISTOGRAM_H
+#define ANDROID_AUDIO_LATENCY_HISTOGRAM_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+// A fixed size histogram of durations, cheap enough to update on every thread loop cycle.
+// Durations are kept in microseconds.  Each power of two range is split into kSubBuckets
+// linear sub-buckets, so the relative error of a reported value is at most 1 / kSubBuckets
+// regardless of magnitude.
+// Updated by a single thread without locks; a concurrent dump() may see a slightly
+// inconsistent snapshot, with the usual caveats for dumpsys.
+class LatencyHistogram {
+public:
+    LatencyHistogram() { reset(); }
+
+    void        reset();
+
+    // Record one duration; negative values are recorded as 0.
+    void        add(nsecs_t ns);
+
+    // Dump a one line summary with percentiles, followed by the non-empty buckets.
+    void        dump(int fd, const char *name) const;
+
+private:
+    static const uint32_t kSubBucketBits = 2;
+    static const uint32_t kSubBuckets = 1 << kSubBucketBits;
+    // values below kSubBuckets have exact buckets, then kSubBuckets per remaining power of 2
+    static const uint32_t kNumBuckets = (32 - kSubBucketBits + 1) * kSubBuckets;
+
+    static uint32_t bucketIndex(uint32_t us);
+    static uint32_t bucketLowerBound(uint32_t index);
+    // smallest bucket upper bound that covers at least permille of the samples
+    uint32_t    percentile(uint32_t permille) const;
+
+    uint32_t    mCount;
+    uint32_t    mMinUs;
+    uint32_t    mMaxUs;
+    uint64_t    mTotalUs;
+    uint32_t    mBuckets[kNumBuckets];
+};
+
+}   // namespace android
+
+#endif  // ANDROID_AUDIO_LATENCY_HISTOGRAM_H
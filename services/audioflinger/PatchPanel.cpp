@@ -387,15 +387,23 @@ status_t AudioFlinger::PatchPanel::createPatchConnections(Patch *patch,
         return status;
     }
 
-    // use a pseudo LCM between input and output framecount
+    // The PatchRecord and PatchTrack share one buffer, so its size is the patch latency.
+    // Use the LCM of the input and output frame counts so that both threads always transfer whole
+    // periods, but no less than two periods of the slower side for double buffering.
     size_t playbackFrameCount = patch->mPlaybackThread->frameCount();
-    int playbackShift = __builtin_ctz(playbackFrameCount);
     size_t recordFramecount = patch->mRecordThread->frameCount();
-    int shift = __builtin_ctz(recordFramecount);
-    if (playbackShift < shift) {
-        shift = playbackShift;
+    size_t gcd = playbackFrameCount;
+    for (size_t rem = recordFramecount; rem != 0; ) {
+        size_t tmp = gcd % rem;
+        gcd = rem;
+        rem = tmp;
+    }
+    size_t frameCount = (playbackFrameCount / gcd) * recordFramecount;
+    const size_t minFrameCount = 2 * (playbackFrameCount > recordFramecount ?
+                                            playbackFrameCount : recordFramecount);
+    if (frameCount < minFrameCount) {
+        frameCount *= (minFrameCount + frameCount - 1) / frameCount;
     }
-    size_t frameCount = (playbackFrameCount * recordFramecount) >> shift;
     ALOGV("createPatchConnections() playframeCount %d recordFramecount %d frameCount %d ",
           playbackFrameCount, recordFramecount, frameCount);
 
@@ -186,6 +186,29 @@ class TimedTrack : public Track {
         uint32_t    mPosition;
     };
 
+    // FIFO of timed buffers kept on a ring, so that trimming the head neither
+    // shifts the remaining buffers nor reallocates. Storage only grows, by
+    // doubling, when a buffer is added to a full ring.
+    class TimedBufferQueue {
+      public:
+        TimedBufferQueue();
+        size_t size() const { return mSize; }
+        bool isEmpty() const { return mSize == 0; }
+        const TimedBuffer& operator[](size_t index) const {
+            return mItems[(mHead + index) % mItems.size()];
+        }
+        TimedBuffer& editItemAt(size_t index) {
+            return mItems.editItemAt((mHead + index) % mItems.size());
+        }
+        void add(const TimedBuffer& buffer);
+        void removeAt(size_t index) { removeItemsAt(index, 1); }
+        void removeItemsAt(size_t index, size_t count);
+      private:
+        Vector<TimedBuffer> mItems;
+        size_t              mHead;
+        size_t              mSize;
+    };
+
     // Mixer facing methods.
     virtual size_t framesReady() const;
 
@@ -217,7 +240,8 @@ class TimedTrack : public Track {
     void timedYieldSamples_l(AudioBufferProvider::Buffer* buffer);
     void timedYieldSilence_l(uint32_t numFrames,
                              AudioBufferProvider::Buffer* buffer);
-    void trimTimedBufferQueue_l();
+    bool getMediaTimeNow(int64_t* mediaTimeNow);
+    void trimTimedBufferQueue_l(int64_t mediaTimeNow);
     void trimTimedBufferQueueHead_l(const char* logTag);
     void updateFramesPendingAfterTrim_l(const TimedBuffer& buf,
                                         const char* logTag);
@@ -227,7 +251,7 @@ class TimedTrack : public Track {
     LinearTransform     mMediaTimeToSampleTransform;
     sp<MemoryDealer>    mTimedMemoryDealer;
 
-    Vector<TimedBuffer> mTimedBufferQueue;
+    TimedBufferQueue    mTimedBufferQueue;
     bool                mQueueHeadInFlight;
     bool                mTrimQueueHeadOnRelease;
     uint32_t            mFramesPendingInQueue;
@@ -238,6 +262,11 @@ class TimedTrack : public Track {
     bool                mTimedAudioOutputOnTime;
     CCHelper            mCCHelper;
 
+    // Copy of the media time transform for the mixer, guarded by
+    // mTimedBufferQueueLock so that getNextBuffer() takes just that one lock.
+    LinearTransform     mMixerMediaTimeTransform;
+    TimedAudioTrack::TargetTimeline mMixerMediaTimeTransformTarget;
+
     Mutex               mMediaTimeTransformLock;
     LinearTransform     mMediaTimeTransform;
     bool                mMediaTimeTransformValid;
@@ -54,6 +54,9 @@ public:
             void        handleSyncStartEvent(const sp<SyncEvent>& event);
             void        clearSyncStartEvent();
 
+            AudioRecordServerProxy* recordServerProxy() const
+                                { return static_cast<AudioRecordServerProxy*>(mServerProxy); }
+
 private:
     friend class AudioFlinger;  // for mState
 
@@ -17,6 +17,8 @@
 
 #define LOG_TAG "AudioFlinger"
 //#define LOG_NDEBUG 0
+#include <string.h>
+
 #include <hardware/audio.h>
 #include <utils/Log.h>
 
@@ -41,9 +43,18 @@ SpdifStreamOut::SpdifStreamOut(AudioHwDevice *dev,
         , mApplicationFormat(AUDIO_FORMAT_DEFAULT)
         , mApplicationSampleRate(0)
         , mApplicationChannelMask(0)
+        , mBurstBuffer(NULL)
+        , mBurstBufferSize(0)
+        , mBurstBufferUsed(0)
+        , mCollectingBursts(false)
 {
 }
 
+SpdifStreamOut::~SpdifStreamOut()
+{
+    delete[] mBurstBuffer;
+}
+
 status_t SpdifStreamOut::open(
                               audio_io_handle_t handle,
                               audio_devices_t devices,
@@ -74,6 +85,13 @@ status_t SpdifStreamOut::open(
     }
     customConfig.sample_rate = config->sample_rate * mRateMultiplier;
 
+    // An AC3 data burst carries 1536 stereo 16-bit frames, bursts of the
+    // higher rate formats scale with the rate multiplier.
+    delete[] mBurstBuffer;
+    mBurstBufferSize = kMaxCollectedBursts * 1536 * 2 * sizeof(int16_t) * mRateMultiplier;
+    mBurstBuffer = new uint8_t[mBurstBufferSize];
+    mBurstBufferUsed = 0;
+
     customConfig.format = AUDIO_FORMAT_PCM_16_BIT;
     customConfig.channel_mask = AUDIO_CHANNEL_OUT_STEREO;
 
@@ -105,24 +123,82 @@ status_t SpdifStreamOut::open(
 int SpdifStreamOut::flush()
 {
     mSpdifEncoder.reset();
+    mBurstBufferUsed = 0;
     return AudioStreamOut::flush();
 }
 
 int SpdifStreamOut::standby()
 {
     mSpdifEncoder.reset();
+    mBurstBufferUsed = 0;
     return AudioStreamOut::standby();
 }
 
+ssize_t SpdifStreamOut::writeInternal(const void* buffer, size_t bytes)
+{
+    // The HAL may accept less than asked for, keep going until it's all out.
+    const uint8_t* data = (const uint8_t*) buffer;
+    size_t remaining = bytes;
+    while (remaining > 0) {
+        ssize_t written = AudioStreamOut::write(data, remaining);
+        if (written <= 0) {
+            return (remaining < bytes) ? (ssize_t) (bytes - remaining) : written;
+        }
+        data += written;
+        remaining -= written;
+    }
+    return bytes;
+}
+
+status_t SpdifStreamOut::flushDataBursts()
+{
+    if (mBurstBufferUsed == 0) {
+        return NO_ERROR;
+    }
+    ssize_t written = writeInternal(mBurstBuffer, mBurstBufferUsed);
+    size_t used = mBurstBufferUsed;
+    mBurstBufferUsed = 0;
+    if (written < 0) {
+        return written;
+    }
+    return ((size_t) written == used) ? NO_ERROR : (status_t) WOULD_BLOCK;
+}
+
 ssize_t SpdifStreamOut::writeDataBurst(const void* buffer, size_t bytes)
 {
-    return AudioStreamOut::write(buffer, bytes);
+    if (!mCollectingBursts || mBurstBuffer == NULL) {
+        return writeInternal(buffer, bytes);
+    }
+
+    if (mBurstBufferUsed + bytes > mBurstBufferSize) {
+        status_t status = flushDataBursts();
+        if (status != NO_ERROR) {
+            return status;
+        }
+        if (bytes > mBurstBufferSize) {
+            return writeInternal(buffer, bytes);
+        }
+    }
+
+    memcpy(mBurstBuffer + mBurstBufferUsed, buffer, bytes);
+    mBurstBufferUsed += bytes;
+    return bytes;
 }
 
 ssize_t SpdifStreamOut::write(const void* buffer, size_t numBytes)
 {
-    // Write to SPDIF wrapper. It will call back to writeDataBurst().
-    return mSpdifEncoder.write(buffer, numBytes);
+    // Write to SPDIF wrapper. It will call back to writeDataBurst(), which
+    // collects the bursts until the whole buffer has been wrapped.
+    mCollectingBursts = true;
+    ssize_t result = mSpdifEncoder.write(buffer, numBytes);
+    mCollectingBursts = false;
+
+    status_t status = flushDataBursts();
+    if (result >= 0 && status != NO_ERROR) {
+        ALOGW("SpdifStreamOut::write() failed to write data bursts, status %d", status);
+        return status;
+    }
+    return result;
 }
 
 } // namespace android
@@ -41,7 +41,7 @@ public:
     SpdifStreamOut(AudioHwDevice *dev, audio_output_flags_t flags,
             audio_format_t format);
 
-    virtual ~SpdifStreamOut() { }
+    virtual ~SpdifStreamOut();
 
     virtual status_t open(
             audio_io_handle_t handle,
@@ -108,13 +108,24 @@ private:
         SpdifStreamOut * const mSpdifStreamOut;
     };
 
+    // Number of AC3 sized data bursts collected before they go to the HAL.
+    static const size_t kMaxCollectedBursts = 4;
+
     MySPDIFEncoder       mSpdifEncoder;
     audio_format_t       mApplicationFormat;
     uint32_t             mApplicationSampleRate;
     audio_channel_mask_t mApplicationChannelMask;
 
+    // Data bursts produced during one write() are collected here, so that
+    // the HAL sees a single large write instead of one write per burst.
+    uint8_t*             mBurstBuffer;
+    size_t               mBurstBufferSize;
+    size_t               mBurstBufferUsed;
+    bool                 mCollectingBursts;
+
     ssize_t  writeDataBurst(const void* data, size_t bytes);
     ssize_t  writeInternal(const void* buffer, size_t bytes);
+    status_t flushDataBursts();
 
 };
 
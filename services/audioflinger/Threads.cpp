@@ -162,6 +162,11 @@ static const enum {
     FastCapture_Static, // initialize if needed, then use all the time if initialized
 } kUseFastCapture = FastCapture_Static;
 
+// Whether a fast capture track may be granted at a sample rate, format or channel mask that
+// differs from the HAL input.  Such a track cannot share the fast capture pipe directly,
+// so it is served by the RecordThread from the pipe and converted by its RecordBufferConverter.
+static const bool kFastCaptureConversion = true;
+
 // Priorities for requestPriority
 static const int kPriorityAudioApp = 2;
 static const int kPriorityFastMixer = 3;
@@ -1595,6 +1600,12 @@ void AudioFlinger::PlaybackThread::dumpInternals(int fd, const Vector<String16>&
     audio_output_flags_t flags = output != NULL ? output->flags : AUDIO_OUTPUT_FLAG_NONE;
     String8 flagsAsString = outputFlagsToString(flags);
     dprintf(fd, "  AudioStreamOut: %p flags %#x (%s)\n", output, flags, flagsAsString.string());
+    dprintf(fd, "  Latency histograms:\n");
+    mMixHistogram.dump(fd, "Mix");
+    mEffectsHistogram.dump(fd, "Effects");
+    mWriteHistogram.dump(fd, "Write");
+    mSleepOverrunHistogram.dump(fd, "Sleep overrun");
+    mCycleHistory.dump(fd);
 }
 
 // Thread virtuals
@@ -2746,6 +2757,10 @@ bool AudioFlinger::PlaybackThread::threadLoop()
     {
         cpuStats.sample(myName);
 
+        CycleHistory::Cycle cycle;
+        memset(&cycle, 0, sizeof(cycle));
+        cycle.mStartNs = systemTime();
+
         Vector< sp<EffectChain> > effectChains;
 
         { // scope for mLock
@@ -2872,7 +2887,11 @@ bool AudioFlinger::PlaybackThread::threadLoop()
             mCurrentWriteLength = 0;
             if (mMixerStatus == MIXER_TRACKS_READY) {
                 // threadLoop_mix() sets mCurrentWriteLength
+                const nsecs_t mixStartNs = systemTime();
                 threadLoop_mix();
+                const nsecs_t mixNs = systemTime() - mixStartNs;
+                mMixHistogram.add(mixNs);
+                cycle.mMixUs = CycleHistory::toUs(mixNs);
             } else if ((mMixerStatus != MIXER_DRAIN_TRACK)
                         && (mMixerStatus != MIXER_DRAIN_ALL)) {
                 // threadLoop_sleepTime sets mSleepTimeUs to 0 if data
@@ -2909,10 +2928,14 @@ bool AudioFlinger::PlaybackThread::threadLoop()
             }
 
             // only process effects if we're going to write
-            if (mSleepTimeUs == 0 && mType != OFFLOAD) {
+            if (mSleepTimeUs == 0 && mType != OFFLOAD && effectChains.size() > 0) {
+                const nsecs_t effectsStartNs = systemTime();
                 for (size_t i = 0; i < effectChains.size(); i ++) {
                     effectChains[i]->process_l();
                 }
+                const nsecs_t effectsNs = systemTime() - effectsStartNs;
+                mEffectsHistogram.add(effectsNs);
+                cycle.mEffectsUs = CycleHistory::toUs(effectsNs);
             }
         }
         // Process effect chains for offloaded thread even if no audio
@@ -2943,7 +2966,11 @@ bool AudioFlinger::PlaybackThread::threadLoop()
             if (mSleepTimeUs == 0) {
                 ssize_t ret = 0;
                 if (mBytesRemaining) {
+                    const nsecs_t writeStartNs = systemTime();
                     ret = threadLoop_write();
+                    const nsecs_t writeNs = systemTime() - writeStartNs;
+                    mWriteHistogram.add(writeNs);
+                    cycle.mWriteUs = CycleHistory::toUs(writeNs);
                     if (ret < 0) {
                         mBytesRemaining = 0;
                     } else {
@@ -2954,12 +2981,14 @@ bool AudioFlinger::PlaybackThread::threadLoop()
                         (mMixerStatus == MIXER_DRAIN_ALL)) {
                     threadLoop_drain();
                 }
+                mCycleHistory.add(cycle);
                 if (mType == MIXER && !mStandby) {
                     // write blocked detection
                     nsecs_t now = systemTime();
                     nsecs_t delta = now - mLastWriteTime;
                     if (delta > maxPeriod) {
                         mNumDelayedWrites++;
+                        mCycleHistory.capture(now, delta);
                         if ((now - lastWarning) > kWarningThrottleNs) {
                             ATRACE_NAME("underrun");
                             ALOGW("write blocked for %llu msecs, %d delayed writes, thread %p",
@@ -3007,7 +3036,13 @@ bool AudioFlinger::PlaybackThread::threadLoop()
 
             } else {
                 ATRACE_BEGIN("sleep");
+                const nsecs_t sleepStartNs = systemTime();
                 usleep(mSleepTimeUs);
+                const nsecs_t sleepOverrunNs =
+                        systemTime() - sleepStartNs - (nsecs_t) mSleepTimeUs * 1000;
+                mSleepOverrunHistogram.add(sleepOverrunNs);
+                cycle.mSleepOverrunUs = CycleHistory::toUs(sleepOverrunNs);
+                mCycleHistory.add(cycle);
                 ATRACE_END();
             }
         }
@@ -3380,6 +3415,7 @@ AudioFlinger::MixerThread::MixerThread(const sp<AudioFlinger>& audioFlinger, Aud
         fastTrack->mChannelMask = mChannelMask; // mPipeSink channel mask for audio to FastMixer
         fastTrack->mFormat = mFormat; // mPipeSink format for audio to FastMixer
         fastTrack->mGeneration++;
+        state->trackModified(0);
         state->mFastTracksGen++;
         state->mTrackMask = 1;
         // fast mixer will use the HAL output sink
@@ -3833,6 +3869,7 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
                     fastTrack->mChannelMask = track->mChannelMask;
                     fastTrack->mFormat = track->mFormat;
                     fastTrack->mGeneration++;
+                    state->trackModified(j);
                     state->mTrackMask |= 1 << j;
                     didModify = true;
                     // no acknowledgement required for newly active tracks
@@ -3846,6 +3883,7 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
                 if (state->mTrackMask & (1 << j)) {
                     fastTrack->mBufferProvider = NULL;
                     fastTrack->mGeneration++;
+                    state->trackModified(j);
                     state->mTrackMask &= ~(1 << j);
                     didModify = true;
                     // If any fast tracks were removed, we must wait for acknowledgement
@@ -4348,20 +4386,32 @@ bool AudioFlinger::MixerThread::checkForNewParameter_l(const String8& keyValuePa
         }
     }
 
-    if (status == NO_ERROR) {
+    // the mixer worker count is handled here and not forwarded to the HAL
+    String8 halKeyValuePair = keyValuePair;
+    if (param.getInt(String8(AudioParameter::keyMixerWorkers), value) == NO_ERROR) {
+        if (value < 0 || mAudioMixer->setWorkerCount((uint32_t)value) != NO_ERROR) {
+            status = BAD_VALUE;
+        }
+        param.remove(String8(AudioParameter::keyMixerWorkers));
+        halKeyValuePair = param.toString();
+    }
+
+    if (status == NO_ERROR && !halKeyValuePair.isEmpty()) {
         status = mOutput->stream->common.set_parameters(&mOutput->stream->common,
-                                                keyValuePair.string());
+                                                halKeyValuePair.string());
         if (!mStandby && status == INVALID_OPERATION) {
             mOutput->standby();
             mStandby = true;
             mBytesWritten = 0;
             status = mOutput->stream->common.set_parameters(&mOutput->stream->common,
-                                                   keyValuePair.string());
+                                                   halKeyValuePair.string());
         }
         if (status == NO_ERROR && reconfig) {
             readOutputParameters_l();
+            const uint32_t mixerWorkers = mAudioMixer->workerCount();
             delete mAudioMixer;
             mAudioMixer = new AudioMixer(mNormalFrameCount, mSampleRate);
+            mAudioMixer->setWorkerCount(mixerWorkers);
             for (size_t i = 0; i < mTracks.size() ; i++) {
                 int name = getTrackName_l(mTracks[i]->mChannelMask,
                         mTracks[i]->mFormat, mTracks[i]->mSessionId);
@@ -4397,6 +4447,7 @@ void AudioFlinger::MixerThread::dumpInternals(int fd, const Vector<String16>& ar
     PlaybackThread::dumpInternals(fd, args);
     dprintf(fd, "  Thread throttle time (msecs): %u\n", mThreadThrottleTimeMs);
     dprintf(fd, "  AudioMixer tracks: 0x%08x\n", mAudioMixer->trackNames());
+    dprintf(fd, "  AudioMixer workers: %u\n", mAudioMixer->workerCount());
 
     // Make a non-atomic copy of fast mixer dump state so it won't change underneath us
     const FastMixerDumpState copy(mFastMixerDumpState);
@@ -5704,7 +5755,9 @@ reacquire_wakelock:
         // sleep with mutex unlocked
         if (sleepUs > 0) {
             ATRACE_BEGIN("sleep");
+            const nsecs_t sleepStartNs = systemTime();
             usleep(sleepUs);
+            mSleepOverrunHistogram.add(systemTime() - sleepStartNs - (nsecs_t) sleepUs * 1000);
             ATRACE_END();
             sleepUs = 0;
         }
@@ -5827,9 +5880,13 @@ reacquire_wakelock:
         // thread mutex is now unlocked, mActiveTracks unknown, activeTracks.size() > 0
 
         size_t size = effectChains.size();
-        for (size_t i = 0; i < size; i++) {
-            // thread mutex is not locked, but effect chain is locked
-            effectChains[i]->process_l();
+        if (size > 0) {
+            const nsecs_t effectsStartNs = systemTime();
+            for (size_t i = 0; i < size; i++) {
+                // thread mutex is not locked, but effect chain is locked
+                effectChains[i]->process_l();
+            }
+            mEffectsHistogram.add(systemTime() - effectsStartNs);
         }
 
         // Push a new fast capture state if fast capture is not already running, or cblk change
@@ -5858,6 +5915,7 @@ reacquire_wakelock:
             audio_track_cblk_t *cblkNew = fastTrack != 0 ? fastTrack->cblk() : NULL;
             if (cblkNew != cblkOld) {
                 state->mCblk = cblkNew;
+                state->mServerProxy = fastTrack != 0 ? fastTrack->recordServerProxy() : NULL;
                 // block until acked if removing a fast track
                 if (cblkOld != NULL) {
                     block = FastCaptureStateQueue::BLOCK_UNTIL_ACKED;
@@ -5887,6 +5945,7 @@ reacquire_wakelock:
         int32_t rear = mRsmpInRear & (mRsmpInFramesP2 - 1);
         ssize_t framesRead;
 
+        const nsecs_t readStartNs = systemTime();
         // If an NBAIO source is present, use it to read the normal capture's data
         if (mPipeSource != 0) {
             size_t framesToRead = mBufferSize / mFrameSize;
@@ -5906,6 +5965,8 @@ reacquire_wakelock:
                 framesRead = bytesRead / mFrameSize;
             }
         }
+        const nsecs_t readEndNs = systemTime();
+        mReadHistogram.add(readEndNs - readStartNs);
 
         if (framesRead < 0 || (framesRead == 0 && mPipeSource == 0)) {
             ALOGE("read failed: framesRead=%d", framesRead);
@@ -5949,6 +6010,7 @@ reacquire_wakelock:
                 OVERRUN_TRUE,
                 OVERRUN_FALSE
             } overrun = OVERRUN_UNKNOWN;
+            bool framesReleased = false;
 
             // loop over getNextBuffer to handle circular sink
             for (;;) {
@@ -5989,6 +6051,7 @@ reacquire_wakelock:
                     if (framesOut > 0) {
                         activeTrack->mSink.frameCount = framesOut;
                         activeTrack->releaseBuffer(&activeTrack->mSink);
+                        framesReleased = true;
                     }
                 } else {
                     // FIXME could do a partial drop of framesOut
@@ -6016,6 +6079,13 @@ reacquire_wakelock:
                 }
             }
 
+            if (framesReleased) {
+                struct timespec readEndTs;
+                readEndTs.tv_sec = readEndNs / 1000000000;
+                readEndTs.tv_nsec = readEndNs % 1000000000;
+                activeTrack->recordServerProxy()->setTimestamp(readEndTs);
+            }
+
             switch (overrun) {
             case OVERRUN_TRUE:
                 // client isn't retrieving buffers fast enough
@@ -6116,6 +6186,7 @@ sp<AudioFlinger::RecordThread::RecordTrack> AudioFlinger::RecordThread::createRe
     size_t frameCount = *pFrameCount;
     sp<RecordTrack> track;
     status_t lStatus;
+    bool fastConverted = false; // fast track that is converted from the pipe, not sharing it
 
     // client expresses a preference for FAST, but we get the final say
     if (*flags & IAudioFlinger::TRACK_FAST) {
@@ -6140,6 +6211,22 @@ sp<AudioFlinger::RecordThread::RecordTrack> AudioFlinger::RecordThread::createRe
         ) {
         ALOGV("AUDIO_INPUT_FLAG_FAST accepted: frameCount=%u mFrameCount=%u",
                 frameCount, mFrameCount);
+      } else if (kFastCaptureConversion &&
+            // frame count is not specified
+            (frameCount == 0) &&
+            // PCM data
+            audio_is_linear_pcm(format) &&
+            // valid input channel mask
+            audio_is_input_channel(channelMask) &&
+            // within the downsampling range of the record buffer converter
+            (mSampleRate <= sampleRate * AUDIO_RESAMPLER_DOWN_RATIO_MAX) &&
+            // record thread has an associated fast capture
+            hasFastCapture()
+        ) {
+        ALOGV("AUDIO_INPUT_FLAG_FAST accepted with conversion: format=%#x channelMask=%#x "
+                "sampleRate=%u mFormat=%#x mChannelMask=%#x mSampleRate=%u",
+                format, channelMask, sampleRate, mFormat, mChannelMask, mSampleRate);
+        fastConverted = true;
       } else {
         ALOGV("AUDIO_INPUT_FLAG_FAST denied: frameCount=%u mFrameCount=%u mPipeFramesP2=%u "
                 "format=%#x isLinear=%d channelMask=%#x sampleRate=%u mSampleRate=%u "
@@ -6152,7 +6239,13 @@ sp<AudioFlinger::RecordThread::RecordTrack> AudioFlinger::RecordThread::createRe
     }
 
     // compute track buffer size in frames, and suggest the notification frame count
-    if (*flags & IAudioFlinger::TRACK_FAST) {
+    if (fastConverted) {
+        // converted fast track: the resampled equivalent of the pipe depth,
+        // and notify once every resampled HAL buffer, as this thread reads one per cycle
+        // TODO This could be a roundupRatio inline
+        frameCount = ((int64_t) mPipeFramesP2 * sampleRate + mSampleRate - 1) / mSampleRate;
+        *notificationFrames = ((int64_t) mFrameCount * sampleRate + mSampleRate - 1) / mSampleRate;
+    } else if (*flags & IAudioFlinger::TRACK_FAST) {
         // fast track: frame count is exactly the pipe depth
         frameCount = mPipeFramesP2;
         // ignore requested notificationFrames, and always notify exactly once every HAL buffer
@@ -6190,9 +6283,12 @@ sp<AudioFlinger::RecordThread::RecordTrack> AudioFlinger::RecordThread::createRe
     { // scope for mLock
         Mutex::Autolock _l(mLock);
 
+        // a converted fast track is a normal track on the server side; the client still
+        // sees TRACK_FAST, and its callback thread gets the same priority as a fast track's
         track = new RecordTrack(this, client, sampleRate,
                       format, channelMask, frameCount, NULL, sessionId, uid,
-                      *flags, TrackBase::TYPE_DEFAULT);
+                      fastConverted ? (*flags & ~IAudioFlinger::TRACK_FAST) : *flags,
+                      TrackBase::TYPE_DEFAULT);
 
         lStatus = track->initCheck();
         if (lStatus != NO_ERROR) {
@@ -6415,6 +6511,10 @@ void AudioFlinger::RecordThread::dumpInternals(int fd, const Vector<String16>& a
     }
     dprintf(fd, "  Fast capture thread: %s\n", hasFastCapture() ? "yes" : "no");
     dprintf(fd, "  Fast track available: %s\n", mFastTrackAvail ? "yes" : "no");
+    dprintf(fd, "  Latency histograms:\n");
+    mReadHistogram.dump(fd, "Read");
+    mEffectsHistogram.dump(fd, "Effects");
+    mSleepOverrunHistogram.dump(fd, "Sleep overrun");
 
     //  Make a non-atomic copy of fast capture dump state so it won't change underneath us
     const FastCaptureDumpState copy(mFastCaptureDumpState);
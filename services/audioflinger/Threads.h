@@ -763,6 +763,14 @@ private:
     int                             mNumDelayedWrites;
     bool                            mInWrite;
 
+    // always-on hot path latency histograms, updated by threadLoop() and shown by dump
+    LatencyHistogram                mMixHistogram;          // threadLoop_mix()
+    LatencyHistogram                mEffectsHistogram;      // effect chains process_l()
+    LatencyHistogram                mWriteHistogram;        // threadLoop_write(), incl. blocking
+    LatencyHistogram                mSleepOverrunHistogram; // actual minus requested sleep
+    // timing of the cycles leading up to each of the last few delayed writes
+    CycleHistory                    mCycleHistory;
+
     // FIXME rename these former local variables of threadLoop to standard "m" names
     nsecs_t                         mStandbyTimeNs;
     size_t                          mSinkBufferSize;
@@ -1353,4 +1361,9 @@ private:
             sp<NBLog::Writer>                   mFastCaptureNBLogWriter;
 
             bool                                mFastTrackAvail;    // true if fast track available
+
+            // always-on hot path latency histograms, updated by threadLoop() and shown by dump
+            LatencyHistogram                    mReadHistogram;         // pipe or HAL read()
+            LatencyHistogram                    mEffectsHistogram;      // effect chains process_l()
+            LatencyHistogram                    mSleepOverrunHistogram; // actual minus requested
 };
@@ -1159,6 +1159,7 @@ AudioFlinger::PlaybackThread::TimedTrack::TimedTrack(
       mTimedSilenceBuffer(NULL),
       mTimedSilenceBufferSize(0),
       mTimedAudioOutputOnTime(false),
+      mMixerMediaTimeTransformTarget(TimedAudioTrack::LOCAL_TIME),
       mMediaTimeTransformValid(false)
 {
     LocalClock lc;
@@ -1187,9 +1188,16 @@ AudioFlinger::PlaybackThread::TimedTrack::~TimedTrack() {
 status_t AudioFlinger::PlaybackThread::TimedTrack::allocateTimedBuffer(
     size_t size, sp<IMemory>* buffer) {
 
+    // reading the common clock is a binder call, don't hold up the mixer
+    // with it
+    int64_t mediaTimeNow;
+    bool canTrim = getMediaTimeNow(&mediaTimeNow);
+
     Mutex::Autolock _l(mTimedBufferQueueLock);
 
-    trimTimedBufferQueue_l();
+    if (canTrim) {
+        trimTimedBufferQueue_l(mediaTimeNow);
+    }
 
     // lazily initialize the shared memory heap for timed buffers
     if (mTimedMemoryDealer == NULL) {
@@ -1211,28 +1219,27 @@ status_t AudioFlinger::PlaybackThread::TimedTrack::allocateTimedBuffer(
     return NO_ERROR;
 }
 
-// caller must hold mTimedBufferQueueLock
-void AudioFlinger::PlaybackThread::TimedTrack::trimTimedBufferQueue_l() {
-    int64_t mediaTimeNow;
-    {
-        Mutex::Autolock mttLock(mMediaTimeTransformLock);
-        if (!mMediaTimeTransformValid)
-            return;
+// must not be called with mTimedBufferQueueLock held
+bool AudioFlinger::PlaybackThread::TimedTrack::getMediaTimeNow(
+        int64_t* mediaTimeNow) {
+    Mutex::Autolock mttLock(mMediaTimeTransformLock);
+    if (!mMediaTimeTransformValid)
+        return false;
 
-        int64_t targetTimeNow;
-        status_t res = (mMediaTimeTransformTarget == TimedAudioTrack::COMMON_TIME)
-            ? mCCHelper.getCommonTime(&targetTimeNow)
-            : mCCHelper.getLocalTime(&targetTimeNow);
+    int64_t targetTimeNow;
+    status_t res = (mMediaTimeTransformTarget == TimedAudioTrack::COMMON_TIME)
+        ? mCCHelper.getCommonTime(&targetTimeNow)
+        : mCCHelper.getLocalTime(&targetTimeNow);
 
-        if (OK != res)
-            return;
+    if (OK != res)
+        return false;
 
-        if (!mMediaTimeTransform.doReverseTransform(targetTimeNow,
-                                                    &mediaTimeNow)) {
-            return;
-        }
-    }
+    return mMediaTimeTransform.doReverseTransform(targetTimeNow, mediaTimeNow);
+}
 
+// caller must hold mTimedBufferQueueLock
+void AudioFlinger::PlaybackThread::TimedTrack::trimTimedBufferQueue_l(
+        int64_t mediaTimeNow) {
     size_t trimEnd;
     for (trimEnd = 0; trimEnd < mTimedBufferQueue.size(); trimEnd++) {
         int64_t bufEnd;
@@ -1287,7 +1294,7 @@ void AudioFlinger::PlaybackThread::TimedTrack::trimTimedBufferQueue_l() {
         }
 
         // Now actually remove the buffers from the queue.
-        mTimedBufferQueue.removeItemsAt(trimStart, trimEnd);
+        mTimedBufferQueue.removeItemsAt(trimStart, trimEnd - trimStart);
     }
 }
 
@@ -1353,11 +1360,16 @@ status_t AudioFlinger::PlaybackThread::TimedTrack::setMediaTimeTransform(
         return BAD_VALUE;
     }
 
+    // same lock order as the mixer: queue lock first
+    Mutex::Autolock _l(mTimedBufferQueueLock);
     Mutex::Autolock lock(mMediaTimeTransformLock);
     mMediaTimeTransform = xform;
     mMediaTimeTransformTarget = target;
     mMediaTimeTransformValid = true;
 
+    mMixerMediaTimeTransform = xform;
+    mMixerMediaTimeTransformTarget = target;
+
     return NO_ERROR;
 }
 
@@ -1392,21 +1404,19 @@ status_t AudioFlinger::PlaybackThread::TimedTrack::getNextBuffer(
 
         // calculate the PTS of the head of the timed buffer queue expressed in
         // local time
+        // (buffers are only queued once a transform has been set, so the
+        // mixer's copy is valid here)
         int64_t headLocalPTS;
         {
-            Mutex::Autolock mttLock(mMediaTimeTransformLock);
-
-            ALOG_ASSERT(mMediaTimeTransformValid, "media time transform invalid");
-
-            if (mMediaTimeTransform.a_to_b_denom == 0) {
+            if (mMixerMediaTimeTransform.a_to_b_denom == 0) {
                 // the transform represents a pause, so yield silence
                 timedYieldSilence_l(buffer->frameCount, buffer);
                 return NO_ERROR;
             }
 
             int64_t transformedPTS;
-            if (!mMediaTimeTransform.doForwardTransform(head.pts(),
-                                                        &transformedPTS)) {
+            if (!mMixerMediaTimeTransform.doForwardTransform(head.pts(),
+                                                             &transformedPTS)) {
                 // the transform failed.  this shouldn't happen, but if it does
                 // then just drop this buffer
                 ALOGW("timedGetNextBuffer transform failed");
@@ -1416,7 +1426,7 @@ status_t AudioFlinger::PlaybackThread::TimedTrack::getNextBuffer(
                 return NO_ERROR;
             }
 
-            if (mMediaTimeTransformTarget == TimedAudioTrack::COMMON_TIME) {
+            if (mMixerMediaTimeTransformTarget == TimedAudioTrack::COMMON_TIME) {
                 if (OK != mCCHelper.commonTimeToLocalTime(transformedPTS,
                                                           &headLocalPTS)) {
                     buffer->raw = NULL;
@@ -1547,17 +1557,25 @@ void AudioFlinger::PlaybackThread::TimedTrack::timedYieldSamples_l(
 void AudioFlinger::PlaybackThread::TimedTrack::timedYieldSilence_l(
     uint32_t numFrames, AudioBufferProvider::Buffer* buffer) {
 
-    // lazily allocate a buffer filled with silence
+    // only as much silence as the mixer asked for is ever yielded
+    size_t framesRequested = buffer->frameCount;
+    numFrames = min(numFrames, framesRequested);
+
+    // lazily allocate a buffer filled with silence, growing it by at least
+    // doubling so that varying request sizes settle on one allocation
     if (mTimedSilenceBufferSize < numFrames * mFrameSize) {
+        uint32_t newSize = mTimedSilenceBufferSize * 2;
+        if (newSize < numFrames * mFrameSize) {
+            newSize = numFrames * mFrameSize;
+        }
         delete [] mTimedSilenceBuffer;
-        mTimedSilenceBufferSize = numFrames * mFrameSize;
+        mTimedSilenceBufferSize = newSize;
         mTimedSilenceBuffer = new uint8_t[mTimedSilenceBufferSize];
         memset(mTimedSilenceBuffer, 0, mTimedSilenceBufferSize);
     }
 
     buffer->raw = mTimedSilenceBuffer;
-    size_t framesRequested = buffer->frameCount;
-    buffer->frameCount = min(numFrames, framesRequested);
+    buffer->frameCount = numFrames;
 
     mTimedAudioOutputOnTime = false;
 }
@@ -1635,6 +1653,48 @@ AudioFlinger::PlaybackThread::TimedTrack::TimedBuffer::TimedBuffer(
     const sp<IMemory>& buffer, int64_t pts)
         : mBuffer(buffer), mPTS(pts), mPosition(0) {}
 
+AudioFlinger::PlaybackThread::TimedTrack::TimedBufferQueue::TimedBufferQueue()
+        : mHead(0), mSize(0) {
+    const size_t kInitialCapacity = 16;
+    mItems.insertAt(TimedBuffer(), 0, kInitialCapacity);
+}
+
+void AudioFlinger::PlaybackThread::TimedTrack::TimedBufferQueue::add(
+    const TimedBuffer& buffer) {
+    if (mSize == mItems.size()) {
+        // full: unroll the ring into twice the space
+        Vector<TimedBuffer> items;
+        items.setCapacity(mItems.size() * 2);
+        for (size_t i = 0; i < mSize; ++i) {
+            items.add((*this)[i]);
+        }
+        items.insertAt(TimedBuffer(), mSize, mItems.size() * 2 - mSize);
+        mItems = items;
+        mHead = 0;
+    }
+
+    mItems.editItemAt((mHead + mSize) % mItems.size()) = buffer;
+    ++mSize;
+}
+
+void AudioFlinger::PlaybackThread::TimedTrack::TimedBufferQueue::removeItemsAt(
+    size_t index, size_t count) {
+    ALOG_ASSERT(index + count <= mSize, "removing %zu buffers at %zu from %zu",
+                count, index, mSize);
+
+    // move the (few) buffers ahead of the removed range up, then advance the
+    // head past the freed slots
+    for (size_t i = index; i > 0; --i) {
+        editItemAt(i - 1 + count) = (*this)[i - 1];
+    }
+    for (size_t i = 0; i < count; ++i) {
+        // drop the IMemory references
+        editItemAt(i) = TimedBuffer();
+    }
+    mHead = (mHead + count) % mItems.size();
+    mSize -= count;
+}
+
 
 // ----------------------------------------------------------------------------
 
@@ -412,3 +412,98 @@ TEST(audioflinger_resampler, stopbandresponse_float_multichannel) {
     }
 }
 
+
+/* Throughput benchmark
+ *
+ * Times the resampler over a chirp signal and reports throughput for
+ * the dynamic resampler qualities at various channel counts.
+ * This is informational only and reports, but does not check, the timing.
+ *
+ * Two ratios - fixed phase (3:2 down) and interpolated phase (147:160 up)
+ */
+
+static inline int64_t systemTimeNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// TI = resampler input type, int16_t or float
+// TO = resampler output type, int32_t or float
+template <typename TI, typename TO>
+void testThroughput(size_t channels,
+        unsigned inputFreq, unsigned outputFreq,
+        enum android::AudioResampler::src_quality quality)
+{
+    // create the provider
+    std::vector<int> inputIncr;
+    SignalProvider provider;
+    provider.setChirp<TI>(channels,
+            0., inputFreq/2., inputFreq, inputFreq/8000.);
+    provider.setIncr(inputIncr);
+
+    // calculate the output size
+    size_t outputFrames = ((int64_t) provider.getNumFrames() * outputFreq) / inputFreq;
+    size_t outputFrameSize = channels * sizeof(TO);
+    size_t outputSize = outputFrameSize * outputFrames;
+    outputSize &= ~7;
+
+    // process in mixer sized chunks
+    std::vector<size_t> outIncr;
+    outIncr.push_back(outputFreq / 100);
+    void* output = malloc(outputSize);
+
+    // the first run warms up the caches, then take the best of the remaining runs.
+    // the resampler is recreated each run (reset() does not clear internal buffers).
+    int64_t bestNs = INT64_MAX;
+    for (int run = 0; run < 4; ++run) {
+        android::AudioResampler* resampler = android::AudioResampler::create(
+                is_same<TI, int16_t>::value ? AUDIO_FORMAT_PCM_16_BIT : AUDIO_FORMAT_PCM_FLOAT,
+                channels, outputFreq, quality);
+        resampler->setSampleRate(inputFreq);
+        resampler->setVolume(android::AudioResampler::UNITY_GAIN_FLOAT,
+                android::AudioResampler::UNITY_GAIN_FLOAT);
+        provider.reset();
+
+        const int64_t startNs = systemTimeNs();
+        resample(channels, output, outputFrames, outIncr, &provider, resampler);
+        const int64_t elapsedNs = systemTimeNs() - startNs;
+        if (run > 0 && elapsedNs < bestNs) {
+            bestNs = elapsedNs;
+        }
+        delete resampler;
+    }
+    ASSERT_GT(bestNs, 0);
+
+    const double seconds = bestNs * 1e-9;
+    printf("%s ch:%zu q:%d %u->%u  %.2f Msamples/s  %.1fx realtime\n",
+            is_same<TI, int16_t>::value ? "int16" : "float",
+            channels, quality, inputFreq, outputFreq,
+            outputFrames * channels / seconds * 1e-6,
+            outputFrames / (double) outputFreq / seconds);
+
+    free(output);
+}
+
+TEST(audioflinger_resampler, throughput) {
+    static const enum android::AudioResampler::src_quality kQualityArray[] = {
+            android::AudioResampler::DYN_LOW_QUALITY,
+            android::AudioResampler::DYN_MED_QUALITY,
+            android::AudioResampler::DYN_HIGH_QUALITY,
+    };
+    static const size_t kChannelArray[] = { 1, 2, 4, 6, 8 };
+
+    for (size_t i = 0; i < ARRAY_SIZE(kQualityArray); ++i) {
+        for (size_t j = 0; j < ARRAY_SIZE(kChannelArray); ++j) {
+            testThroughput<float, float>(
+                    kChannelArray[j], 48000, 32000, kQualityArray[i]);
+            testThroughput<float, float>(
+                    kChannelArray[j], 44100, 48000, kQualityArray[i]);
+            testThroughput<int16_t, int32_t>(
+                    kChannelArray[j], 48000, 32000, kQualityArray[i]);
+            testThroughput<int16_t, int32_t>(
+                    kChannelArray[j], 44100, 48000, kQualityArray[i]);
+        }
+    }
+}
@@ -265,6 +265,10 @@ public:
                                           bool &isSpeakerDrcEnabled);
 
 private:
+    // Maps the configuration file for in place parsing, or returns NULL if it cannot be
+    // mapped with a terminating NUL, in which case the caller reads it into memory instead.
+    static char *mapConfigFile(int fd, size_t *mapSize);
+
     static void loadHwModule(cnode *root, HwModuleCollection &hwModules,
                              DeviceVector &availableInputDevices,
                              DeviceVector &availableOutputDevices,
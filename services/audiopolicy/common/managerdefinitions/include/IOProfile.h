@@ -55,6 +55,8 @@ public:
 
     DeviceVector  mSupportedDevices; // supported devices
                                      // (devices this output can be routed to)
+    uint32_t      mMixerWorkers;     // outputs only: number of AudioMixer worker threads,
+                                     // 0 to mix all tracks on the playback thread
 };
 
 }; // namespace android
@@ -46,6 +46,8 @@
 #define CHANNELS_TAG "channel_masks"
 #define DEVICES_TAG "devices"
 #define FLAGS_TAG "flags"
+#define MIXER_WORKERS_TAG "mixer_workers" // optional, outputs only: number of AudioMixer
+                                      // worker threads for parallel track mixing
 
 #define DYNAMIC_VALUE_TAG "dynamic" // special value for "channel_masks", "sampling_rates" and
                                     // "formats" in outputs descriptors indicating that supported
@@ -22,6 +22,10 @@
 #include <hardware/audio.h>
 #include <utils/Log.h>
 #include <cutils/misc.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace android {
 
@@ -251,6 +255,28 @@ void ConfigParsingUtils::loadGlobalConfig(cnode *root, const sp<HwModule>& modul
     }
 }
 
+//static
+char *ConfigParsingUtils::mapConfigFile(int fd, size_t *mapSize)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        return NULL;
+    }
+    size_t size = (size_t)st.st_size;
+    // config_load() needs a NUL terminated string: rely on the zero filled tail of the last
+    // page, which does not exist when the file size is a multiple of the page size.
+    if ((size % getpagesize()) == 0) {
+        return NULL;
+    }
+    // private writable mapping: the parser terminates tokens in place
+    void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+    *mapSize = size;
+    return (char *)data;
+}
+
 //static
 status_t ConfigParsingUtils::loadAudioPolicyConfig(const char *path,
                                                    HwModuleCollection &hwModules,
@@ -261,11 +287,20 @@ status_t ConfigParsingUtils::loadAudioPolicyConfig(const char *path,
 {
     cnode *root;
     char *data;
+    size_t mapSize = 0;
 
-    data = (char *)load_file(path, NULL);
-    if (data == NULL) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
         return -ENODEV;
     }
+    data = mapConfigFile(fd, &mapSize);
+    close(fd);
+    if (data == NULL) {
+        data = (char *)load_file(path, NULL);
+        if (data == NULL) {
+            return -ENODEV;
+        }
+    }
     root = config_node("", "");
     config_load(root, data);
 
@@ -278,7 +313,11 @@ status_t ConfigParsingUtils::loadAudioPolicyConfig(const char *path,
                      defaultOutputDevices, isSpeakerDrcEnabled);
     config_free(root);
     free(root);
-    free(data);
+    if (mapSize != 0) {
+        munmap(data, mapSize);
+    } else {
+        free(data);
+    }
 
     ALOGI("loadAudioPolicyConfig() loaded %s\n", path);
 
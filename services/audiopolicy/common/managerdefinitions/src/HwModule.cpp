@@ -109,6 +109,8 @@ status_t HwModule::loadOutput(cnode *root)
                                                            mDeclaredDevices);
         } else if (strcmp(node->name, FLAGS_TAG) == 0) {
             profile->mFlags = ConfigParsingUtils::parseOutputFlagNames((char *)node->value);
+        } else if (strcmp(node->name, MIXER_WORKERS_TAG) == 0) {
+            profile->mMixerWorkers = (uint32_t)atoi((char *)node->value);
         } else if (strcmp(node->name, GAINS_TAG) == 0) {
             profile->loadGains(node);
         }
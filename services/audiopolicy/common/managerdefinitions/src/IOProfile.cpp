@@ -24,7 +24,7 @@
 namespace android {
 
 IOProfile::IOProfile(const String8& name, audio_port_role_t role)
-    : AudioPort(name, AUDIO_PORT_TYPE_MIX, role)
+    : AudioPort(name, AUDIO_PORT_TYPE_MIX, role), mMixerWorkers(0)
 {
 }
 
@@ -128,6 +128,10 @@ void IOProfile::dump(int fd)
 
     snprintf(buffer, SIZE, "    - flags: 0x%04x\n", mFlags);
     result.append(buffer);
+    if (mMixerWorkers != 0) {
+        snprintf(buffer, SIZE, "    - mixer workers: %u\n", mMixerWorkers);
+        result.append(buffer);
+    }
     snprintf(buffer, SIZE, "    - devices:\n");
     result.append(buffer);
     write(fd, result.string(), result.size());
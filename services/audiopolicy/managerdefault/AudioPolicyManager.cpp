@@ -346,7 +346,7 @@ void AudioPolicyManager::updateCallRouting(audio_devices_t rxDevice, int delayMs
 
         // request to reuse existing output stream if one is already opened to reach the RX device
         SortedVector<audio_io_handle_t> outputs =
-                                getOutputsForDevice(rxDevice, mOutputs);
+                                getOpenOutputsForDevice(rxDevice);
         audio_io_handle_t output = selectOutput(outputs,
                                                 AUDIO_OUTPUT_FLAG_NONE,
                                                 AUDIO_FORMAT_INVALID);
@@ -387,7 +387,7 @@ void AudioPolicyManager::updateCallRouting(audio_devices_t rxDevice, int delayMs
         txSinkDeviceDesc->toAudioPortConfig(&patch.sinks[0]);
 
         SortedVector<audio_io_handle_t> outputs =
-                                getOutputsForDevice(AUDIO_DEVICE_OUT_TELEPHONY_TX, mOutputs);
+                                getOpenOutputsForDevice(AUDIO_DEVICE_OUT_TELEPHONY_TX);
         audio_io_handle_t output = selectOutput(outputs,
                                                 AUDIO_OUTPUT_FLAG_NONE,
                                                 AUDIO_FORMAT_INVALID);
@@ -961,7 +961,7 @@ non_direct_output:
     if (audio_is_linear_pcm(format)) {
         // get which output is suitable for the specified stream. The actual
         // routing change will happen when startOutput() will be called
-        SortedVector<audio_io_handle_t> outputs = getOutputsForDevice(device, mOutputs);
+        SortedVector<audio_io_handle_t> outputs = getOpenOutputsForDevice(device);
 
         // at this stage we should ignore the DIRECT flag as no direct output could be found earlier
         flags = (audio_output_flags_t)(flags & ~AUDIO_OUTPUT_FLAG_DIRECT);
@@ -1842,7 +1842,7 @@ audio_io_handle_t AudioPolicyManager::getOutputForEffect(const effect_descriptor
 
     routing_strategy strategy = getStrategy(AUDIO_STREAM_MUSIC);
     audio_devices_t device = getDeviceForStrategy(strategy, false /*fromCache*/);
-    SortedVector<audio_io_handle_t> dstOutputs = getOutputsForDevice(device, mOutputs);
+    SortedVector<audio_io_handle_t> dstOutputs = getOpenOutputsForDevice(device);
 
     audio_io_handle_t output = selectOutputForEffects(dstOutputs);
     ALOGV("getOutputForEffect() got output %d for fx %s flags %x",
@@ -2408,7 +2408,7 @@ status_t AudioPolicyManager::createAudioPatch(const struct audio_patch *patch,
                         return INVALID_OPERATION;
                     }
                     SortedVector<audio_io_handle_t> outputs =
-                                            getOutputsForDevice(sinkDeviceDesc->type(), mOutputs);
+                                            getOpenOutputsForDevice(sinkDeviceDesc->type());
                     // if the sink device is reachable via an opened output stream, request to go via
                     // this output stream by adding a second source to the patch description
                     audio_io_handle_t output = selectOutput(outputs,
@@ -2617,7 +2617,7 @@ void AudioPolicyManager::checkStrategyRoute(routing_strategy strategy,
                                             audio_io_handle_t ouptutToSkip)
 {
     audio_devices_t device = getDeviceForStrategy(strategy, false /*fromCache*/);
-    SortedVector<audio_io_handle_t> outputs = getOutputsForDevice(device, mOutputs);
+    SortedVector<audio_io_handle_t> outputs = getOpenOutputsForDevice(device);
     for (size_t j = 0; j < mOutputs.size(); j++) {
         if (mOutputs.keyAt(j) == ouptutToSkip) {
             continue;
@@ -2997,6 +2997,7 @@ AudioPolicyManager::~AudioPolicyManager()
    mAvailableOutputDevices.clear();
    mAvailableInputDevices.clear();
    mOutputs.clear();
+   mOutputsForDevice.clear();
    mInputs.clear();
    mHwModules.clear();
 }
@@ -3170,12 +3171,21 @@ void AudioPolicyManager::addOutput(audio_io_handle_t output, sp<SwAudioOutputDes
 {
     outputDesc->setIoHandle(output);
     mOutputs.add(output, outputDesc);
+    mOutputsForDevice.clear();
     nextAudioPortGeneration();
+
+    if (outputDesc->mProfile != 0 && outputDesc->mProfile->mMixerWorkers != 0) {
+        AudioParameter param;
+        param.addInt(String8(AudioParameter::keyMixerWorkers),
+                     (int)outputDesc->mProfile->mMixerWorkers);
+        mpClientInterface->setParameters(output, param.toString());
+    }
 }
 
 void AudioPolicyManager::removeOutput(audio_io_handle_t output)
 {
     mOutputs.removeItem(output);
+    mOutputsForDevice.clear();
 }
 
 void AudioPolicyManager::addInput(audio_io_handle_t input, sp<AudioInputDescriptor> inputDesc)
@@ -3785,7 +3795,7 @@ void AudioPolicyManager::closeInput(audio_io_handle_t input)
 
 SortedVector<audio_io_handle_t> AudioPolicyManager::getOutputsForDevice(
                                                                 audio_devices_t device,
-                                                                SwAudioOutputCollection openOutputs)
+                                                                const SwAudioOutputCollection& openOutputs)
 {
     SortedVector<audio_io_handle_t> outputs;
 
@@ -3802,6 +3812,18 @@ SortedVector<audio_io_handle_t> AudioPolicyManager::getOutputsForDevice(
     return outputs;
 }
 
+SortedVector<audio_io_handle_t> AudioPolicyManager::getOpenOutputsForDevice(
+                                                                audio_devices_t device)
+{
+    ssize_t index = mOutputsForDevice.indexOfKey(device);
+    if (index >= 0) {
+        return mOutputsForDevice.valueAt(index);
+    }
+    SortedVector<audio_io_handle_t> outputs = getOutputsForDevice(device, mOutputs);
+    mOutputsForDevice.add(device, outputs);
+    return outputs;
+}
+
 bool AudioPolicyManager::vectorsEqual(SortedVector<audio_io_handle_t>& outputs1,
                                       SortedVector<audio_io_handle_t>& outputs2)
 {
@@ -3821,7 +3843,7 @@ void AudioPolicyManager::checkOutputForStrategy(routing_strategy strategy)
     audio_devices_t oldDevice = getDeviceForStrategy(strategy, true /*fromCache*/);
     audio_devices_t newDevice = getDeviceForStrategy(strategy, false /*fromCache*/);
     SortedVector<audio_io_handle_t> srcOutputs = getOutputsForDevice(oldDevice, mPreviousOutputs);
-    SortedVector<audio_io_handle_t> dstOutputs = getOutputsForDevice(newDevice, mOutputs);
+    SortedVector<audio_io_handle_t> dstOutputs = getOpenOutputsForDevice(newDevice);
 
     // also take into account external policy-related changes: add all outputs which are
     // associated with policies in the "before" and "after" output vectors
@@ -4041,7 +4063,7 @@ audio_devices_t AudioPolicyManager::getDevicesForStream(audio_stream_type_t stre
     audio_devices_t devices;
     routing_strategy strategy = getStrategy(stream);
     devices = getDeviceForStrategy(strategy, true /*fromCache*/);
-    SortedVector<audio_io_handle_t> outputs = getOutputsForDevice(devices, mOutputs);
+    SortedVector<audio_io_handle_t> outputs = getOpenOutputsForDevice(devices);
     for (size_t i = 0; i < outputs.size(); i++) {
         sp<AudioOutputDescriptor> outputDesc = mOutputs.valueFor(outputs[i]);
         if (isStrategyActive(outputDesc, strategy)) {
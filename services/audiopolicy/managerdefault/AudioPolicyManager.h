@@ -426,7 +426,10 @@ protected:
 #endif //AUDIO_POLICY_TEST
 
         SortedVector<audio_io_handle_t> getOutputsForDevice(audio_devices_t device,
-                                                            SwAudioOutputCollection openOutputs);
+                                                const SwAudioOutputCollection& openOutputs);
+        // Same as getOutputsForDevice(device, mOutputs), but memoized per device until an
+        // output is opened or closed.
+        SortedVector<audio_io_handle_t> getOpenOutputsForDevice(audio_devices_t device);
         bool vectorsEqual(SortedVector<audio_io_handle_t>& outputs1,
                                            SortedVector<audio_io_handle_t>& outputs2);
 
@@ -504,6 +507,8 @@ protected:
         // list of descriptors for outputs currently opened
 
         SwAudioOutputCollection mOutputs;
+        // getOpenOutputsForDevice() results; cleared whenever mOutputs changes
+        KeyedVector<audio_devices_t, SortedVector<audio_io_handle_t> > mOutputsForDevice;
         // copy of mOutputs before setDeviceConnectionState() opens new outputs
         // reset to mOutputs when updateDevicesAndOutputs() is called.
         SwAudioOutputCollection mPreviousOutputs;
@@ -404,6 +404,7 @@ AudioPolicyService::AudioCommandThread::AudioCommandThread(String8 name,
     : Thread(false), mName(name), mService(service)
 {
     mpToneGenerator = NULL;
+    memset(mCommandStats, 0, sizeof(mCommandStats));
 }
 
 
@@ -436,6 +437,7 @@ bool AudioPolicyService::AudioCommandThread::threadLoop()
                 sp<AudioCommand> command = mAudioCommands[0];
                 mAudioCommands.removeAt(0);
                 mLastCommand = command;
+                nsecs_t startTime = systemTime();
 
                 switch (command->mCommand) {
                 case START_TONE: {
@@ -460,23 +462,40 @@ bool AudioPolicyService::AudioCommandThread::threadLoop()
                     }break;
                 case SET_VOLUME: {
                     VolumeData *data = (VolumeData *)command->mParam.get();
+                    if (isSupersededLocked(command, curTime)) {
+                        ALOGV("AudioCommandThread() skipping superseded set volume stream %d, "
+                                "output %d", data->mStream, data->mIO);
+                        mCommandStats[SET_VOLUME].mSuperseded++;
+                        break;
+                    }
                     ALOGV("AudioCommandThread() processing set volume stream %d, \
                             volume %f, output %d", data->mStream, data->mVolume, data->mIO);
+                    mLock.unlock();
                     command->mStatus = AudioSystem::setStreamVolume(data->mStream,
                                                                     data->mVolume,
                                                                     data->mIO);
+                    mLock.lock();
                     }break;
                 case SET_PARAMETERS: {
                     ParametersData *data = (ParametersData *)command->mParam.get();
                     ALOGV("AudioCommandThread() processing set parameters string %s, io %d",
                             data->mKeyValuePairs.string(), data->mIO);
+                    mLock.unlock();
                     command->mStatus = AudioSystem::setParameters(data->mIO, data->mKeyValuePairs);
+                    mLock.lock();
                     }break;
                 case SET_VOICE_VOLUME: {
                     VoiceVolumeData *data = (VoiceVolumeData *)command->mParam.get();
+                    if (isSupersededLocked(command, curTime)) {
+                        ALOGV("AudioCommandThread() skipping superseded set voice volume");
+                        mCommandStats[SET_VOICE_VOLUME].mSuperseded++;
+                        break;
+                    }
                     ALOGV("AudioCommandThread() processing set voice volume volume %f",
                             data->mVolume);
+                    mLock.unlock();
                     command->mStatus = AudioSystem::setVoiceVolume(data->mVolume);
+                    mLock.lock();
                     }break;
                 case STOP_OUTPUT: {
                     StopOutputData *data = (StopOutputData *)command->mParam.get();
@@ -569,6 +588,17 @@ bool AudioPolicyService::AudioCommandThread::threadLoop()
                 default:
                     ALOGW("AudioCommandThread() unknown command %d", command->mCommand);
                 }
+                if (command->mCommand >= 0 && command->mCommand < kNumCommandTypes) {
+                    nsecs_t endTime = systemTime();
+                    CommandStats *stats = &mCommandStats[command->mCommand];
+                    nsecs_t delay = startTime - command->mTime;
+                    nsecs_t exec = endTime - startTime;
+                    stats->mCount++;
+                    stats->mTotalDelay += delay;
+                    stats->mTotalExec += exec;
+                    if (delay > stats->mMaxDelay) stats->mMaxDelay = delay;
+                    if (exec > stats->mMaxExec) stats->mMaxExec = exec;
+                }
                 {
                     Mutex::Autolock _l(command->mLock);
                     if (command->mWaitStatus) {
@@ -639,6 +669,21 @@ status_t AudioPolicyService::AudioCommandThread::dump(int fd)
     } else {
         result.append("     none\n");
     }
+    result.append("  Command Stats (ms)\n");
+    result.append("   Command Count    Skipped  Avg delay Max delay Avg exec  Max exec\n");
+    for (int i = 0; i < kNumCommandTypes; i++) {
+        const CommandStats& stats = mCommandStats[i];
+        if (stats.mCount == 0) {
+            continue;
+        }
+        snprintf(buffer, SIZE, "   %02d      %-8u %-8u %-9.3f %-9.3f %-9.3f %-9.3f\n",
+                i, stats.mCount, stats.mSuperseded,
+                (double)stats.mTotalDelay / stats.mCount / 1000000,
+                (double)stats.mMaxDelay / 1000000,
+                (double)stats.mTotalExec / stats.mCount / 1000000,
+                (double)stats.mMaxExec / 1000000);
+        result.append(buffer);
+    }
 
     write(fd, result.string(), result.size());
 
@@ -919,6 +964,15 @@ void AudioPolicyService::AudioCommandThread::insertCommand_l(sp<AudioCommand>& c
             delayMs = 1;
         } break;
 
+        case SET_VOICE_VOLUME: {
+            ALOGV("Filtering out voice volume command");
+            removedCommands.add(command2);
+            command->mTime = command2->mTime;
+            // force delayMs to non 0 so that code below does not request to wait for
+            // command status as the command is now delayed
+            delayMs = 1;
+        } break;
+
         case CREATE_AUDIO_PATCH:
         case RELEASE_AUDIO_PATCH: {
             audio_patch_handle_t handle;
@@ -1002,6 +1056,35 @@ void AudioPolicyService::AudioCommandThread::insertCommand_l(sp<AudioCommand>& c
     mAudioCommands.insertAt(command, i + 1);
 }
 
+// isSupersededLocked() must be called with mLock held
+bool AudioPolicyService::AudioCommandThread::isSupersededLocked(const sp<AudioCommand>& command,
+                                                                nsecs_t curTime)
+{
+    // A volume command can be skipped if a command for the same target is already due:
+    // only the last value of a burst (e.g. slider moves) needs to reach audio flinger.
+    for (size_t i = 0; i < mAudioCommands.size(); i++) {
+        sp<AudioCommand> command2 = mAudioCommands[i];
+        // commands are sorted by increasing time stamp: no need to scan the rest of mAudioCommands
+        if (command2->mTime > curTime) break;
+        if (command2->mCommand != command->mCommand) continue;
+
+        switch (command->mCommand) {
+        case SET_VOLUME: {
+            VolumeData *data = (VolumeData *)command->mParam.get();
+            VolumeData *data2 = (VolumeData *)command2->mParam.get();
+            if (data->mIO == data2->mIO && data->mStream == data2->mStream) {
+                return true;
+            }
+        } break;
+        case SET_VOICE_VOLUME:
+            return true;
+        default:
+            return false;
+        }
+    }
+    return false;
+}
+
 void AudioPolicyService::AudioCommandThread::exit()
 {
     ALOGV("AudioCommandThread::exit");
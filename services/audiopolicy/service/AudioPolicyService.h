@@ -385,11 +385,26 @@ private:
             int32_t mState;
         };
 
+        // per command type execution statistics (used by dump)
+        struct CommandStats {
+            uint32_t mCount;        // number of commands processed
+            uint32_t mSuperseded;   // number of commands skipped because of a newer one
+            nsecs_t mTotalDelay;    // sum of delays between due time and execution start
+            nsecs_t mMaxDelay;
+            nsecs_t mTotalExec;     // sum of execution times
+            nsecs_t mMaxExec;
+        };
+        static const int kNumCommandTypes = DYN_POLICY_MIX_STATE_UPDATE + 1;
+
+        // true if a due command in the queue makes this command obsolete
+        bool isSupersededLocked(const sp<AudioCommand>& command, nsecs_t curTime);
+
         Mutex   mLock;
         Condition mWaitWorkCV;
         Vector < sp<AudioCommand> > mAudioCommands; // list of pending commands
         ToneGenerator *mpToneGenerator;     // the tone generator
         sp<AudioCommand> mLastCommand;      // last processed command (used by dump)
+        CommandStats mCommandStats[kNumCommandTypes];
         String8 mName;                      // string used by wake lock fo delayed commands
         wp<AudioPolicyService> mService;
     };
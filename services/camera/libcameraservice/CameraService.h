@@ -875,11 +875,27 @@ status_t CameraService::connectHelper(const sp<CALLBACK>& cameraCb, const String
         LOG_ALWAYS_FATAL_IF(client.get() == nullptr, "%s: CameraService in invalid state",
                 __FUNCTION__);
 
-        if ((ret = client->initialize(mModule)) != OK) {
+        // Opening the HAL device is the slowest part of connect. Do not hold mServiceLock while
+        // doing so, but retain the condition blocking other clients from connecting in
+        // mServiceLockWrapper; this keeps status callbacks, torch requests and disconnects of
+        // other devices from stalling behind the open.
+        mServiceLock.unlock();
+        ret = client->initialize(mModule);
+        mServiceLock.lock();
+        if (ret != OK) {
             ALOGE("%s: Could not initialize client from HAL module.", __FUNCTION__);
             return ret;
         }
 
+        // Check again if the device was unplugged or something while we weren't holding
+        // mServiceLock
+        if ((ret = checkIfDeviceIsUsable(cameraId)) != NO_ERROR) {
+            mServiceLock.unlock();
+            client->disconnect();
+            mServiceLock.lock();
+            return ret;
+        }
+
         // Update shim paremeters for legacy clients
         if (effectiveApiLevel == API_1) {
             // Assume we have always received a Client subclass for API1
@@ -27,11 +27,76 @@
 #include "api1/Camera2Client.h"
 #include "api1/client2/CallbackProcessor.h"
 
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define USE_CALLBACK_NEON (true)
+#else
+#define USE_CALLBACK_NEON (false)
+#endif
+
 #define ALIGN(x, mask) ( ((x) + (mask) - 1) & ~((mask) - 1) )
 
 namespace android {
 namespace camera2 {
 
+/**
+ * Chroma row helpers for convertFromFlexibleYuv, covering the layouts HALs
+ * commonly use for YCbCr_420_888 (planar, NV12 and NV21) without going
+ * through the per-sample generic loops.
+ */
+
+// Interleave width Cr/Cb samples into NV21 CrCb pairs. The sources are
+// either planar (step 1) or the two halves of one semiplanar row (step 2).
+static void interleaveChromaRow(uint8_t *crcbDst, const uint8_t *crSrc,
+        const uint8_t *cbSrc, size_t width, size_t step) {
+    size_t col = 0;
+#if USE_CALLBACK_NEON
+    if (step == 1) {
+        for (; col + 16 <= width; col += 16) {
+            uint8x16x2_t crcb;
+            crcb.val[0] = vld1q_u8(crSrc + col);
+            crcb.val[1] = vld1q_u8(cbSrc + col);
+            vst2q_u8(crcbDst + col * 2, crcb);
+        }
+    } else if (cbSrc + 1 == crSrc) {
+        // NV12 source; swap each CbCr pair
+        for (; col + 16 <= width; col += 16) {
+            uint8x16x2_t cbcr = vld2q_u8(cbSrc + col * 2);
+            uint8x16x2_t crcb;
+            crcb.val[0] = cbcr.val[1];
+            crcb.val[1] = cbcr.val[0];
+            vst2q_u8(crcbDst + col * 2, crcb);
+        }
+    }
+#endif
+    for (; col < width; col++) {
+        crcbDst[col * 2] = crSrc[col * step];
+        crcbDst[col * 2 + 1] = cbSrc[col * step];
+    }
+}
+
+// Split width samples of a semiplanar (step 2) chroma row into Cr and Cb
+// planes.
+static void deinterleaveChromaRow(uint8_t *crDst, uint8_t *cbDst,
+        const uint8_t *crSrc, const uint8_t *cbSrc, size_t width) {
+    size_t col = 0;
+#if USE_CALLBACK_NEON
+    if (cbSrc + 1 == crSrc || crSrc + 1 == cbSrc) {
+        bool crFirst = crSrc < cbSrc;
+        const uint8_t *base = crFirst ? crSrc : cbSrc;
+        for (; col + 16 <= width; col += 16) {
+            uint8x16x2_t pairs = vld2q_u8(base + col * 2);
+            vst1q_u8(crDst + col, crFirst ? pairs.val[0] : pairs.val[1]);
+            vst1q_u8(cbDst + col, crFirst ? pairs.val[1] : pairs.val[0]);
+        }
+    }
+#endif
+    for (; col < width; col++) {
+        crDst[col] = crSrc[col * 2];
+        cbDst[col] = cbSrc[col * 2];
+    }
+}
+
 CallbackProcessor::CallbackProcessor(sp<Camera2Client> client):
         Thread(false),
         mClient(client),
@@ -512,6 +577,18 @@ status_t CallbackProcessor::convertFromFlexibleYuv(int32_t previewFormat,
                 crcbDst += src.width;
                 crSrc += src.chromaStride;
             }
+        } else if (src.chromaStep == 1 ||
+                (src.chromaStep == 2 && cbSrc + 1 == crSrc)) {
+            ALOGV("%s: Fast %s->NV21", __FUNCTION__,
+                    src.chromaStep == 1 ? "YV12" : "NV12");
+            // Planar or CbCr semiplanar chroma, interleave by rows
+            for (size_t row = 0; row < chromaHeight; row++) {
+                interleaveChromaRow(crcbDst, crSrc, cbSrc, chromaWidth,
+                        src.chromaStep);
+                crcbDst += src.width;
+                crSrc += src.chromaStride;
+                cbSrc += src.chromaStride;
+            }
         } else {
             ALOGV("%s: Generic->NV21", __FUNCTION__);
             // Generic copy, always works but not very efficient
@@ -545,6 +622,17 @@ status_t CallbackProcessor::convertFromFlexibleYuv(int32_t previewFormat,
                 cbDst += dstCStride;
                 cbSrc += src.chromaStride;
             }
+        } else if (src.chromaStep == 2 &&
+                (cbSrc + 1 == crSrc || crSrc + 1 == cbSrc)) {
+            ALOGV("%s: Fast NV12/NV21->YV12", __FUNCTION__);
+            // Semiplanar chroma, split by rows
+            for (size_t row = 0; row < chromaHeight; row++) {
+                deinterleaveChromaRow(crDst, cbDst, crSrc, cbSrc, chromaWidth);
+                crDst += dstCStride;
+                cbDst += dstCStride;
+                crSrc += src.chromaStride;
+                cbSrc += src.chromaStride;
+            }
         } else {
             ALOGV("%s: Generic->YV12", __FUNCTION__);
             // Generic copy, always works but not very efficient
@@ -23,9 +23,11 @@
 //#define LOG_NDEBUG 0
 
 #include <netinet/in.h>
+#include <unistd.h>
 
 #include <binder/MemoryBase.h>
 #include <binder/MemoryHeapBase.h>
+#include <cutils/properties.h>
 #include <utils/Log.h>
 #include <utils/Trace.h>
 #include <gui/Surface.h>
@@ -47,7 +49,17 @@ JpegProcessor::JpegProcessor(
         mSequencer(sequencer),
         mId(client->getCameraId()),
         mCaptureAvailable(false),
-        mCaptureStreamId(NO_STREAM) {
+        mCaptureStreamId(NO_STREAM),
+        mCaptureSlotCount(kDefaultCaptureSlots),
+        mCaptureSlotSize(0),
+        mNextCaptureSlot(0) {
+    char value[PROPERTY_VALUE_MAX];
+    property_get("camera.jpeg.capture_slots", value, "");
+    int slots = atoi(value);
+    if (slots > 0) {
+        mCaptureSlotCount = static_cast<size_t>(slots) < kMaxCaptureSlots ?
+                static_cast<size_t>(slots) : kMaxCaptureSlots;
+    }
 }
 
 JpegProcessor::~JpegProcessor() {
@@ -95,25 +107,34 @@ status_t JpegProcessor::updateStream(const Parameters &params) {
         mCaptureWindow = new Surface(producer);
     }
 
+    // Each slot is page aligned so that the MemoryBase offsets handed to the
+    // client stay mappable on their own.
+    const size_t pageSize = getpagesize();
+    const size_t slotSize =
+            (static_cast<size_t>(maxJpegSize) + pageSize - 1) & ~(pageSize - 1);
+    const size_t heapSize = slotSize * mCaptureSlotCount;
+
     // Since ashmem heaps are rounded up to page size, don't reallocate if
     // the capture heap isn't exactly the same size as the required JPEG buffer
     const size_t HEAP_SLACK_FACTOR = 2;
     if (mCaptureHeap == 0 ||
-            (mCaptureHeap->getSize() < static_cast<size_t>(maxJpegSize)) ||
-            (mCaptureHeap->getSize() >
-                    static_cast<size_t>(maxJpegSize) * HEAP_SLACK_FACTOR) ) {
+            (mCaptureHeap->getSize() < heapSize) ||
+            (mCaptureHeap->getSize() > heapSize * HEAP_SLACK_FACTOR) ) {
         // Create memory for API consumption
         mCaptureHeap.clear();
         mCaptureHeap =
-                new MemoryHeapBase(maxJpegSize, 0, "Camera2Client::CaptureHeap");
+                new MemoryHeapBase(heapSize, 0, "Camera2Client::CaptureHeap");
         if (mCaptureHeap->getSize() == 0) {
             ALOGE("%s: Camera %d: Unable to allocate memory for capture",
                     __FUNCTION__, mId);
             return NO_MEMORY;
         }
     }
-    ALOGV("%s: Camera %d: JPEG capture heap now %d bytes; requested %d bytes",
-            __FUNCTION__, mId, mCaptureHeap->getSize(), maxJpegSize);
+    mCaptureSlotSize = slotSize;
+    mNextCaptureSlot = 0;
+    ALOGV("%s: Camera %d: JPEG capture heap now %d bytes in %zu slots; "
+            "requested %d bytes", __FUNCTION__, mId, mCaptureHeap->getSize(),
+            mCaptureSlotCount, maxJpegSize);
 
     if (mCaptureStreamId != NO_STREAM) {
         // Check if stream parameters have to change
@@ -267,17 +288,22 @@ status_t JpegProcessor::processNewCapture() {
         if (jpegSize == 0) { // failed to find size, default to whole buffer
         jpegSize = size;//imgBuffer.width;
         }
-        size_t heapSize = mCaptureHeap->getSize();
-        if (jpegSize > heapSize) {
+        if (jpegSize > mCaptureSlotSize) {
             ALOGW("%s: JPEG image is larger than expected, truncating "
                     "(got %zu, expected at most %zu bytes)",
-                    __FUNCTION__, jpegSize, heapSize);
-            jpegSize = heapSize;
+                    __FUNCTION__, jpegSize, mCaptureSlotSize);
+            jpegSize = mCaptureSlotSize;
         }
 
+        // Rotate through the heap slots so that back-to-back burst captures
+        // don't overwrite a picture the client has not consumed yet.
+        size_t offset = mNextCaptureSlot * mCaptureSlotSize;
+        mNextCaptureSlot = (mNextCaptureSlot + 1) % mCaptureSlotCount;
+
         // TODO: Optimize this to avoid memcopy
-        captureBuffer = new MemoryBase(mCaptureHeap, 0, jpegSize);
-        void* captureMemory = mCaptureHeap->getBase();
+        captureBuffer = new MemoryBase(mCaptureHeap, offset, jpegSize);
+        uint8_t* captureMemory =
+                static_cast<uint8_t*>(mCaptureHeap->getBase()) + offset;
         memcpy(captureMemory, imgBuffer.data, jpegSize);
 
         mCaptureConsumer->unlockBuffer(imgBuffer);
@@ -56,6 +56,11 @@ class JpegProcessor:
     void dump(int fd, const Vector<String16>& args) const;
   private:
     static const nsecs_t kWaitDuration = 10000000; // 10 ms
+    // Number of JPEG-sized slots in the capture heap. Each capture is handed
+    // to the client from its own slot, so a burst can have several pictures
+    // in flight without the next one overwriting the last.
+    static const size_t kDefaultCaptureSlots = 3;
+    static const size_t kMaxCaptureSlots = 8;
     wp<CameraDeviceBase> mDevice;
     wp<CaptureSequencer> mSequencer;
     int mId;
@@ -72,6 +77,9 @@ class JpegProcessor:
     sp<CpuConsumer>    mCaptureConsumer;
     sp<Surface>        mCaptureWindow;
     sp<MemoryHeapBase> mCaptureHeap;
+    size_t mCaptureSlotCount;
+    size_t mCaptureSlotSize;
+    size_t mNextCaptureSlot;
 
     virtual bool threadLoop();
 
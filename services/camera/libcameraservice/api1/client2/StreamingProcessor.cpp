@@ -57,6 +57,7 @@ StreamingProcessor::StreamingProcessor(sp<Camera2Client> client):
         mRecordingFrameAvailable(false),
         mRecordingHeapCount(kDefaultRecordingHeapCount),
         mRecordingHeapFree(kDefaultRecordingHeapCount),
+        mRecordingHeapDroppedFrames(0),
         mRecordingFormat(kDefaultRecordingFormat),
         mRecordingDataSpace(kDefaultRecordingDataSpace),
         mRecordingGrallocUsage(kDefaultRecordingGrallocUsage),
@@ -827,6 +828,7 @@ status_t StreamingProcessor::processRecordingFrame() {
             if(mpHeapStatus == NULL) {
                 ALOGE("%s: Camera %d: malloc %d heap status item failed",
                             __FUNCTION__, mId, mRecordingHeapCount);
+                mRecordingConsumer->releaseBuffer(imgBuffer);
                 return NO_MEMORY;
             }
             memset(mpHeapStatus, 0, mRecordingHeapCount * sizeof(int32_t));
@@ -834,33 +836,39 @@ status_t StreamingProcessor::processRecordingFrame() {
 
 
         if (mRecordingHeapFree == 0) {
-            ALOGV("%s: Camera %d: No free recording buffers, dropping frame",
-                    __FUNCTION__, mId);
+            // Every heap slot is still held by the app; count it so the
+            // starvation shows up in dumpsys instead of only in verbose logs.
+            mRecordingHeapDroppedFrames++;
+            ALOGV("%s: Camera %d: No free recording buffers, dropping frame (%zu dropped)",
+                    __FUNCTION__, mId, mRecordingHeapDroppedFrames);
             mRecordingConsumer->releaseBuffer(imgBuffer);
             return NO_MEMORY;
         }
 
-        heapIdx = mRecordingHeapHead;
-        mRecordingHeapHead = (mRecordingHeapHead + 1) % mRecordingHeapCount;
-        mRecordingHeapFree--;
-
         //since the consuming order not assure same as producting order,
-        //so we need find a free slot
-		size_t nFreeIdx;
-        for(nFreeIdx = 0; nFreeIdx < mRecordingHeapCount; nFreeIdx++)
-        {
-            if(mpHeapStatus[nFreeIdx] == 0)
+        //so we need find a free slot. Start from the slot after the last one
+        //handed out, which is free whenever frames come back in order.
+        size_t nFreeIdx = mRecordingHeapCount;
+        for (size_t i = 0; i < mRecordingHeapCount; i++) {
+            size_t idx = (mRecordingHeapHead + i) % mRecordingHeapCount;
+            if (mpHeapStatus[idx] == 0) {
+                nFreeIdx = idx;
                 break;
+            }
         }
 
         //should not happed, add for protection
         if(nFreeIdx >= mRecordingHeapCount)
         {
             ALOGE("%s: Camera %d: No free heap idx, dropping frame", __FUNCTION__, mId);
+            mRecordingHeapDroppedFrames++;
+            mRecordingConsumer->releaseBuffer(imgBuffer);
             return NO_MEMORY;
         }
 
         heapIdx = nFreeIdx;
+        mRecordingHeapHead = (nFreeIdx + 1) % mRecordingHeapCount;
+        mRecordingHeapFree--;
         mpHeapStatus[nFreeIdx] = 1;
 
         ALOGVV("%s: Camera %d: Timestamp %lld",
@@ -924,13 +932,21 @@ void StreamingProcessor::releaseRecordingFrame(const sp<IMemory>& mem) {
         return;
     }
 
-    // Release the buffer back to the recording queue
-    size_t itemIndex;
-    for (itemIndex = 0; itemIndex < mRecordingBuffers.size(); itemIndex++) {
-        const BufferItem item = mRecordingBuffers[itemIndex];
-        if (item.mBuf != BufferItemConsumer::INVALID_BUFFER_SLOT &&
-                item.mGraphicBuffer->getNativeBuffer() == payload->pBuffer) {
-                break;
+    // Release the buffer back to the recording queue. The heap slot handed
+    // out for a frame is the same index as its entry in mRecordingBuffers,
+    // so look there first and only search if the app returned something else.
+    size_t itemIndex = mRecordingHeap->mBufSize > 0 ?
+            (size_t)offset / mRecordingHeap->mBufSize : mRecordingBuffers.size();
+    if (itemIndex >= mRecordingBuffers.size() ||
+            mRecordingBuffers[itemIndex].mBuf == BufferItemConsumer::INVALID_BUFFER_SLOT ||
+            mRecordingBuffers[itemIndex].mGraphicBuffer->getNativeBuffer() !=
+                    payload->pBuffer) {
+        for (itemIndex = 0; itemIndex < mRecordingBuffers.size(); itemIndex++) {
+            const BufferItem& item = mRecordingBuffers[itemIndex];
+            if (item.mBuf != BufferItemConsumer::INVALID_BUFFER_SLOT &&
+                    item.mGraphicBuffer->getNativeBuffer() == payload->pBuffer) {
+                    break;
+            }
         }
     }
 
@@ -1047,6 +1063,10 @@ status_t StreamingProcessor::dump(int fd, const Vector<String16>& /*args*/) {
     result.append(String8::format("   Active request: %s (paused: %s)\n",
                                   streamTypeString[mActiveRequest],
                                   mPaused ? "yes" : "no"));
+    result.append(String8::format("   Recording heap: %zu free of %zu, "
+                                  "%zu frames dropped for lack of a free buffer\n",
+                                  mRecordingHeapFree, mRecordingHeapCount,
+                                  mRecordingHeapDroppedFrames));
 
     write(fd, result.string(), result.size());
 
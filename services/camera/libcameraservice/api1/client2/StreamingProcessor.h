@@ -132,6 +132,8 @@ class StreamingProcessor:
     size_t mRecordingHeapCount;
     Vector<BufferItem> mRecordingBuffers;
     size_t mRecordingHeapHead, mRecordingHeapFree;
+    // frames dropped because every recording heap slot was still held by the app
+    size_t mRecordingHeapDroppedFrames;
 	int32_t *mpHeapStatus;
 
     static const int kDefaultRecordingFormat =
@@ -27,6 +27,7 @@
 
 #include <inttypes.h>
 
+#include <cutils/properties.h>
 #include <utils/Log.h>
 #include <utils/Trace.h>
 #include <gui/Surface.h>
@@ -51,6 +52,9 @@ ZslProcessor3::ZslProcessor3(
         mId(client->getCameraId()),
         mZslStreamId(NO_STREAM),
         mFrameListHead(0),
+        mLatestFrameTimestamp(0),
+        mCandidatePolicy(CANDIDATE_OLDEST),
+        mShutterLag(0),
         mZslQueueHead(0),
         mZslQueueTail(0),
         mHasFocuser(false) {
@@ -88,6 +92,18 @@ ZslProcessor3::ZslProcessor3(
 
     mZslQueue.insertAt(0, mBufferQueueDepth);
     mFrameList.insertAt(0, mFrameListDepth);
+    mFrameListTimestamps.insertAt(0, 0, mFrameListDepth);
+
+    char value[PROPERTY_VALUE_MAX];
+    property_get("camera.zsl.selection", value, "oldest");
+    if (!strcmp(value, "newest")) {
+        mCandidatePolicy = CANDIDATE_NEWEST;
+    } else if (!strcmp(value, "closest")) {
+        mCandidatePolicy = CANDIDATE_CLOSEST;
+        property_get("camera.zsl.shutter_lag_ms", value, "0");
+        mShutterLag = milliseconds(atoi(value));
+    }
+
     sp<CaptureSequencer> captureSequencer = mSequencer.promote();
     if (captureSequencer != 0) captureSequencer->setZslProcessor(this);
 }
@@ -123,7 +139,20 @@ void ZslProcessor3::onResultAvailable(const CaptureResult &result) {
     // Corresponding buffer has been cleared. No need to push into mFrameList
     if (timestamp <= mLatestClearedBufferTimestamp) return;
 
+    // Drop the entry being overwritten from the candidate index
+    nsecs_t oldTimestamp = mFrameListTimestamps[mFrameListHead];
+    if (oldTimestamp != 0) {
+        mCandidateIndex.removeItem(oldTimestamp);
+    }
+
     mFrameList.editItemAt(mFrameListHead) = result.mMetadata;
+    mFrameListTimestamps.editItemAt(mFrameListHead) = timestamp;
+    if (isCandidateFrame(result.mMetadata)) {
+        mCandidateIndex.add(timestamp, mFrameListHead);
+    }
+    if (timestamp > mLatestFrameTimestamp) {
+        mLatestFrameTimestamp = timestamp;
+    }
     mFrameListHead = (mFrameListHead + 1) % mFrameListDepth;
 }
 
@@ -451,6 +480,10 @@ void ZslProcessor3::clearZslResultQueueLocked() {
     mFrameList.clear();
     mFrameListHead = 0;
     mFrameList.insertAt(0, mFrameListDepth);
+    mFrameListTimestamps.clear();
+    mFrameListTimestamps.insertAt(0, 0, mFrameListDepth);
+    mCandidateIndex.clear();
+    mLatestFrameTimestamp = 0;
 }
 
 void ZslProcessor3::dump(int fd, const Vector<String16>& /*args*/) const {
@@ -521,115 +554,138 @@ bool ZslProcessor3::isFixedFocusMode(uint8_t afMode) const {
     }
 }
 
-nsecs_t ZslProcessor3::getCandidateTimestampLocked(size_t* metadataIdx) const {
+bool ZslProcessor3::isCandidateFrame(const CameraMetadata &frame) const {
     /**
-     * Find the smallest timestamp we know about so far
-     * - ensure that aeState is either converged or locked
+     * Ensure that aeState is either converged or locked, and that the frame
+     * has good focus if the focus mode isn't fixed
      */
+    camera_metadata_ro_entry_t entry;
+    entry = frame.find(ANDROID_CONTROL_AE_STATE);
 
-    size_t idx = 0;
-    nsecs_t minTimestamp = -1;
-
-    size_t emptyCount = mFrameList.size();
+    if (entry.count == 0) {
+        /**
+         * This is most likely a HAL bug. The aeState field is
+         * mandatory, so it should always be in a metadata packet.
+         */
+        ALOGW("%s: ZSL queue frame has no AE state field!",
+                __FUNCTION__);
+        return false;
+    }
+    if (entry.data.u8[0] != ANDROID_CONTROL_AE_STATE_CONVERGED &&
+            entry.data.u8[0] != ANDROID_CONTROL_AE_STATE_LOCKED) {
+        ALOGVV("%s: ZSL queue frame AE state is %d, need "
+               "full capture",  __FUNCTION__, entry.data.u8[0]);
+        return false;
+    }
 
-    for (size_t j = 0; j < mFrameList.size(); j++) {
-        const CameraMetadata &frame = mFrameList[j];
-        if (!frame.isEmpty()) {
+    entry = frame.find(ANDROID_CONTROL_AF_MODE);
+    if (entry.count == 0) {
+        ALOGW("%s: ZSL queue frame has no AF mode field!",
+                __FUNCTION__);
+        return false;
+    }
+    uint8_t afMode = entry.data.u8[0];
+    if (afMode == ANDROID_CONTROL_AF_MODE_OFF) {
+        // Skip all the ZSL buffer for manual AF mode, as we don't really
+        // know the af state.
+        return false;
+    }
 
-            emptyCount--;
+    // Check AF state if device has focuser and focus mode isn't fixed
+    if (mHasFocuser && !isFixedFocusMode(afMode)) {
+        // Make sure the candidate frame has good focus.
+        entry = frame.find(ANDROID_CONTROL_AF_STATE);
+        if (entry.count == 0) {
+            ALOGW("%s: ZSL queue frame has no AF state field!",
+                    __FUNCTION__);
+            return false;
+        }
+        uint8_t afState = entry.data.u8[0];
+        if (afState != ANDROID_CONTROL_AF_STATE_PASSIVE_FOCUSED &&
+                afState != ANDROID_CONTROL_AF_STATE_FOCUSED_LOCKED &&
+                afState != ANDROID_CONTROL_AF_STATE_NOT_FOCUSED_LOCKED) {
+            ALOGVV("%s: ZSL queue frame AF state is %d is not good for capture, skip it",
+                    __FUNCTION__, afState);
+            return false;
+        }
+    }
 
-            camera_metadata_ro_entry_t entry;
-            entry = frame.find(ANDROID_SENSOR_TIMESTAMP);
-            if (entry.count == 0) {
-                ALOGE("%s: Can't find timestamp in frame!",
-                        __FUNCTION__);
-                continue;
-            }
-            nsecs_t frameTimestamp = entry.data.i64[0];
-            if (minTimestamp > frameTimestamp || minTimestamp == -1) {
-
-                entry = frame.find(ANDROID_CONTROL_AE_STATE);
-
-                if (entry.count == 0) {
-                    /**
-                     * This is most likely a HAL bug. The aeState field is
-                     * mandatory, so it should always be in a metadata packet.
-                     */
-                    ALOGW("%s: ZSL queue frame has no AE state field!",
-                            __FUNCTION__);
-                    continue;
-                }
-                if (entry.data.u8[0] != ANDROID_CONTROL_AE_STATE_CONVERGED &&
-                        entry.data.u8[0] != ANDROID_CONTROL_AE_STATE_LOCKED) {
-                    ALOGVV("%s: ZSL queue frame AE state is %d, need "
-                           "full capture",  __FUNCTION__, entry.data.u8[0]);
-                    continue;
-                }
+    return true;
+}
 
-                entry = frame.find(ANDROID_CONTROL_AF_MODE);
-                if (entry.count == 0) {
-                    ALOGW("%s: ZSL queue frame has no AF mode field!",
-                            __FUNCTION__);
-                    continue;
-                }
-                uint8_t afMode = entry.data.u8[0];
-                if (afMode == ANDROID_CONTROL_AF_MODE_OFF) {
-                    // Skip all the ZSL buffer for manual AF mode, as we don't really
-                    // know the af state.
-                    continue;
-                }
+nsecs_t ZslProcessor3::getCandidateTimestampLocked(size_t* metadataIdx) const {
+    /**
+     * Pick a frame with good 3A state from the timestamp-sorted candidate
+     * index according to the selection policy
+     */
+    size_t count = mCandidateIndex.size();
+    if (count == 0) {
+        size_t emptyCount = 0;
+        for (size_t j = 0; j < mFrameListTimestamps.size(); j++) {
+            if (mFrameListTimestamps[j] == 0) emptyCount++;
+        }
+        if (emptyCount == mFrameListTimestamps.size()) {
+            /**
+             * This could be mildly bad and means our ZSL was triggered before
+             * there were any frames yet received by the camera framework.
+             *
+             * This is a fairly corner case which can happen under:
+             * + a user presses the shutter button real fast when the camera starts
+             *     (startPreview followed immediately by takePicture).
+             * + burst capture case (hitting shutter button as fast possible)
+             *
+             * If this happens in steady case (preview running for a while, call
+             *     a single takePicture) then this might be a fwk bug.
+             */
+            ALOGW("%s: ZSL queue has no metadata frames", __FUNCTION__);
+        }
+        ALOGV("%s: No candidate among %zu frames", __FUNCTION__,
+                mFrameListTimestamps.size() - emptyCount);
+        return -1;
+    }
 
-                // Check AF state if device has focuser and focus mode isn't fixed
-                if (mHasFocuser && !isFixedFocusMode(afMode)) {
-                    // Make sure the candidate frame has good focus.
-                    entry = frame.find(ANDROID_CONTROL_AF_STATE);
-                    if (entry.count == 0) {
-                        ALOGW("%s: ZSL queue frame has no AF state field!",
-                                __FUNCTION__);
-                        continue;
-                    }
-                    uint8_t afState = entry.data.u8[0];
-                    if (afState != ANDROID_CONTROL_AF_STATE_PASSIVE_FOCUSED &&
-                            afState != ANDROID_CONTROL_AF_STATE_FOCUSED_LOCKED &&
-                            afState != ANDROID_CONTROL_AF_STATE_NOT_FOCUSED_LOCKED) {
-                        ALOGVV("%s: ZSL queue frame AF state is %d is not good for capture, skip it",
-                                __FUNCTION__, afState);
-                        continue;
-                    }
+    size_t idx = 0;
+    switch (mCandidatePolicy) {
+        case CANDIDATE_OLDEST:
+            idx = 0;
+            break;
+        case CANDIDATE_NEWEST:
+            idx = count - 1;
+            break;
+        case CANDIDATE_CLOSEST: {
+            nsecs_t target = mLatestFrameTimestamp - mShutterLag;
+            // First candidate at or after the target
+            size_t lo = 0, hi = count;
+            while (lo < hi) {
+                size_t mid = lo + (hi - lo) / 2;
+                if (mCandidateIndex.keyAt(mid) < target) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
                 }
-
-                minTimestamp = frameTimestamp;
-                idx = j;
             }
-
-            ALOGVV("%s: Saw timestamp %" PRId64, __FUNCTION__, frameTimestamp);
+            if (lo == count) {
+                idx = count - 1;
+            } else if (lo > 0 &&
+                    target - mCandidateIndex.keyAt(lo - 1) <
+                    mCandidateIndex.keyAt(lo) - target) {
+                idx = lo - 1;
+            } else {
+                idx = lo;
+            }
+            break;
         }
     }
 
-    if (emptyCount == mFrameList.size()) {
-        /**
-         * This could be mildly bad and means our ZSL was triggered before
-         * there were any frames yet received by the camera framework.
-         *
-         * This is a fairly corner case which can happen under:
-         * + a user presses the shutter button real fast when the camera starts
-         *     (startPreview followed immediately by takePicture).
-         * + burst capture case (hitting shutter button as fast possible)
-         *
-         * If this happens in steady case (preview running for a while, call
-         *     a single takePicture) then this might be a fwk bug.
-         */
-        ALOGW("%s: ZSL queue has no metadata frames", __FUNCTION__);
-    }
-
-    ALOGV("%s: Candidate timestamp %" PRId64 " (idx %zu), empty frames: %zu",
-          __FUNCTION__, minTimestamp, idx, emptyCount);
+    nsecs_t candidateTimestamp = mCandidateIndex.keyAt(idx);
+    ALOGV("%s: Candidate timestamp %" PRId64 " (idx %zu), candidates: %zu",
+          __FUNCTION__, candidateTimestamp, mCandidateIndex.valueAt(idx), count);
 
     if (metadataIdx) {
-        *metadataIdx = idx;
+        *metadataIdx = mCandidateIndex.valueAt(idx);
     }
 
-    return minTimestamp;
+    return candidateTimestamp;
 }
 
 void ZslProcessor3::onBufferAcquired(const BufferInfo& /*bufferInfo*/) {
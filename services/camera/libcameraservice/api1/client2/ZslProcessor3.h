@@ -22,6 +22,7 @@
 #include <utils/Vector.h>
 #include <utils/Mutex.h>
 #include <utils/Condition.h>
+#include <utils/KeyedVector.h>
 #include <gui/BufferItem.h>
 #include <gui/BufferItemConsumer.h>
 #include <camera/CameraMetadata.h>
@@ -115,6 +116,27 @@ class ZslProcessor3 :
     Vector<CameraMetadata> mFrameList;
     size_t mFrameListHead;
 
+    // Sensor timestamp of each mFrameList entry, 0 when the entry is empty
+    Vector<nsecs_t> mFrameListTimestamps;
+    // Timestamp-sorted index of the mFrameList entries whose 3A state makes
+    // them usable for reprocessing, filled in as results arrive
+    KeyedVector<nsecs_t, size_t> mCandidateIndex;
+    nsecs_t mLatestFrameTimestamp;
+
+    // How getCandidateTimestampLocked picks among the usable frames, set
+    // with the camera.zsl.selection property
+    enum CandidatePolicy {
+        // Oldest usable frame, the least likely to be dropped meanwhile
+        CANDIDATE_OLDEST,
+        // Newest usable frame
+        CANDIDATE_NEWEST,
+        // Usable frame closest to the newest frame minus
+        // camera.zsl.shutter_lag_ms, to compensate for the time between what
+        // the user saw and the shutter press reaching the service
+        CANDIDATE_CLOSEST,
+    } mCandidatePolicy;
+    nsecs_t mShutterLag;
+
     ZslPair mNextPair;
 
     Vector<ZslPair> mZslQueue;
@@ -135,6 +157,9 @@ class ZslProcessor3 :
 
     nsecs_t getCandidateTimestampLocked(size_t* metadataIdx) const;
 
+    // Whether a result's 3A state is good enough for ZSL reprocessing
+    bool isCandidateFrame(const CameraMetadata &frame) const;
+
     bool isFixedFocusMode(uint8_t afMode) const;
 
     // Update the post-processing metadata with the default still capture request template
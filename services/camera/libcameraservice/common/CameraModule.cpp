@@ -214,16 +214,18 @@ int CameraModule::getCameraInfo(int cameraId, struct camera_info *info) {
             return ret;
         }
         int deviceVersion = rawInfo.device_version;
+        cameraInfo = rawInfo;
         if (deviceVersion < CAMERA_DEVICE_API_VERSION_2_0) {
-            // static_camera_characteristics is invalid
-            *info = rawInfo;
-            return ret;
+            // static_camera_characteristics is invalid; still cache the rest
+            // of the info so facing/version lookups on every connect don't
+            // go back to the HAL.
+            cameraInfo.static_camera_characteristics = NULL;
+        } else {
+            CameraMetadata m;
+            m = rawInfo.static_camera_characteristics;
+            deriveCameraCharacteristicsKeys(rawInfo.device_version, m);
+            cameraInfo.static_camera_characteristics = m.release();
         }
-        CameraMetadata m;
-        m = rawInfo.static_camera_characteristics;
-        deriveCameraCharacteristicsKeys(rawInfo.device_version, m);
-        cameraInfo = rawInfo;
-        cameraInfo.static_camera_characteristics = m.release();
         index = mCameraInfoMap.add(cameraId, cameraInfo);
     }
 
@@ -121,7 +121,7 @@ bool FrameProcessorBase::threadLoop() {
 void FrameProcessorBase::processNewFrames(const sp<CameraDeviceBase> &device) {
     status_t res;
     ATRACE_CALL();
-    CaptureResult result;
+    CaptureResult &result = mResult;
 
     ALOGV("%s: Camera %d: Process new frames", __FUNCTION__, device->getId());
 
@@ -145,7 +145,7 @@ void FrameProcessorBase::processNewFrames(const sp<CameraDeviceBase> &device) {
 
         if (!result.mMetadata.isEmpty()) {
             Mutex::Autolock al(mLastFrameMutex);
-            mLastFrame.acquire(result.mMetadata);
+            mLastFrame.swap(result.mMetadata);
         }
     }
     if (res != NOT_ENOUGH_DATA) {
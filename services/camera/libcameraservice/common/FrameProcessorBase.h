@@ -83,6 +83,10 @@ class FrameProcessorBase: public Thread {
                               const sp<CameraDeviceBase> &device);
 
     CameraMetadata mLastFrame;
+
+    // Holds the previous last frame's metadata until the next getNextResult,
+    // which lets the device reuse the buffer.
+    CaptureResult mResult;
 };
 
 
@@ -39,6 +39,7 @@
 
 #include <inttypes.h>
 
+#include <cutils/properties.h>
 #include <utils/Log.h>
 #include <utils/Trace.h>
 #include <utils/Timers.h>
@@ -64,11 +65,16 @@ Camera3Device::Camera3Device(int id):
         mStatusWaiters(0),
         mUsePartialResult(false),
         mNumPartialResults(1),
+        mStreamPreallocCount(NO_PREALLOCATION),
         mNextResultFrameNumber(0),
         mNextReprocessResultFrameNumber(0),
         mNextShutterFrameNumber(0),
         mNextReprocessShutterFrameNumber(0),
-        mListener(NULL)
+        mResultQueueHead(0),
+        mResultQueueCount(0),
+        mListener(NULL),
+        mResultEntryCapacity(0),
+        mResultDataCapacity(0)
 {
     ATRACE_CALL();
     camera3_callback_ops::notify = &sNotify;
@@ -81,6 +87,10 @@ Camera3Device::~Camera3Device()
     ATRACE_CALL();
     ALOGV("%s: Tearing down for camera id %d", __FUNCTION__, mId);
     disconnect();
+
+    for (size_t i = 0; i < mResultMetadataPool.size(); i++) {
+        free_camera_metadata(mResultMetadataPool[i]);
+    }
 }
 
 int Camera3Device::getId() const {
@@ -187,7 +197,28 @@ status_t Camera3Device::initialize(CameraModule *module)
         return res;
     }
 
-    mPreparerThread = new PreparerThread();
+    char value[PROPERTY_VALUE_MAX];
+    property_get("camera.stream_prealloc_threads", value, "0");
+    size_t preparerCount = kDefaultPreparerThreads;
+    if (atoi(value) > 0) {
+        preparerCount = atoi(value);
+        if (preparerCount > kMaxPreparerThreads) {
+            preparerCount = kMaxPreparerThreads;
+        }
+    }
+    mPreparerThreads.clear();
+    for (size_t i = 0; i < preparerCount; i++) {
+        mPreparerThreads.push(new PreparerThread());
+    }
+
+    property_get("camera.stream_prealloc", value, "lazy");
+    if (!strcmp(value, "eager")) {
+        mStreamPreallocCount = camera3::Camera3StreamInterface::ALLOCATE_PIPELINE_MAX;
+    } else if (atoi(value) > 0) {
+        mStreamPreallocCount = atoi(value);
+    } else {
+        mStreamPreallocCount = NO_PREALLOCATION;
+    }
 
     /** Everything is good to go */
 
@@ -281,6 +312,7 @@ status_t Camera3Device::disconnect() {
         // (which may be stuck in the HAL processCaptureRequest call)
         // could be dangerous.
         mRequestThread->join();
+        mRequestThread->joinSubmitThread();
     }
 
     if (mStatusTracker != NULL) {
@@ -1283,7 +1315,9 @@ status_t Camera3Device::setNotifyCallback(NotificationListener *listener) {
     }
     mListener = listener;
     mRequestThread->setNotificationListener(listener);
-    mPreparerThread->setNotificationListener(listener);
+    for (size_t i = 0; i < mPreparerThreads.size(); i++) {
+        mPreparerThreads[i]->setNotificationListener(listener);
+    }
 
     return OK;
 }
@@ -1296,7 +1330,7 @@ status_t Camera3Device::waitForNextFrame(nsecs_t timeout) {
     status_t res;
     Mutex::Autolock l(mOutputLock);
 
-    while (mResultQueue.empty()) {
+    while (mResultQueueCount == 0) {
         res = mResultSignal.waitRelative(mOutputLock, timeout);
         if (res == TIMED_OUT) {
             return res;
@@ -1313,7 +1347,7 @@ status_t Camera3Device::getNextResult(CaptureResult *frame) {
     ATRACE_CALL();
     Mutex::Autolock l(mOutputLock);
 
-    if (mResultQueue.empty()) {
+    if (mResultQueueCount == 0) {
         return NOT_ENOUGH_DATA;
     }
 
@@ -1322,14 +1356,106 @@ status_t Camera3Device::getNextResult(CaptureResult *frame) {
         return BAD_VALUE;
     }
 
-    CaptureResult &result = *(mResultQueue.begin());
+    CaptureResult &result = mResultQueue.editItemAt(mResultQueueHead);
     frame->mResultExtras = result.mResultExtras;
+    // Take back whatever the caller was done with before handing out the next result
+    recycleResultMetadataLocked(frame->mMetadata.release());
     frame->mMetadata.acquire(result.mMetadata);
-    mResultQueue.erase(mResultQueue.begin());
+    mResultQueueHead = (mResultQueueHead + 1) % mResultQueue.size();
+    mResultQueueCount--;
 
     return OK;
 }
 
+CaptureResult& Camera3Device::queueResultLocked() {
+    if (mResultQueueCount == mResultQueue.size()) {
+        // Grow the ring, moving the queued results to its start in order
+        size_t size = mResultQueue.size() * 2;
+        if (size < kMinResultQueueSize) {
+            size = kMinResultQueueSize;
+        }
+        Vector<CaptureResult> queue;
+        queue.insertAt(0, size);
+        for (size_t i = 0; i < mResultQueueCount; i++) {
+            CaptureResult &src =
+                    mResultQueue.editItemAt((mResultQueueHead + i) % mResultQueue.size());
+            CaptureResult &dst = queue.editItemAt(i);
+            dst.mResultExtras = src.mResultExtras;
+            dst.mMetadata.acquire(src.mMetadata);
+        }
+        mResultQueue = queue;
+        mResultQueueHead = 0;
+    }
+
+    size_t tail = (mResultQueueHead + mResultQueueCount) % mResultQueue.size();
+    mResultQueueCount++;
+    return mResultQueue.editItemAt(tail);
+}
+
+void Camera3Device::dequeueLastResultLocked() {
+    size_t tail = (mResultQueueHead + mResultQueueCount - 1) % mResultQueue.size();
+    recycleResultMetadataLocked(mResultQueue.editItemAt(tail).mMetadata.release());
+    mResultQueueCount--;
+}
+
+camera_metadata_t* Camera3Device::obtainResultMetadataLocked(size_t entryCount,
+        size_t dataCount) {
+    if (entryCount > mResultEntryCapacity) {
+        mResultEntryCapacity = entryCount;
+    }
+    if (dataCount > mResultDataCapacity) {
+        mResultDataCapacity = dataCount;
+    }
+
+    while (!mResultMetadataPool.isEmpty()) {
+        size_t last = mResultMetadataPool.size() - 1;
+        camera_metadata_t *buffer = mResultMetadataPool[last];
+        mResultMetadataPool.removeAt(last);
+
+        size_t entryCapacity = get_camera_metadata_entry_capacity(buffer);
+        size_t dataCapacity = get_camera_metadata_data_capacity(buffer);
+        if (entryCapacity >= mResultEntryCapacity && dataCapacity >= mResultDataCapacity) {
+            // Reset the buffer in place
+            return place_camera_metadata(buffer, get_camera_metadata_size(buffer),
+                    entryCapacity, dataCapacity);
+        }
+        // Results have outgrown this buffer
+        free_camera_metadata(buffer);
+    }
+
+    return allocate_camera_metadata(mResultEntryCapacity, mResultDataCapacity);
+}
+
+void Camera3Device::recycleResultMetadataLocked(camera_metadata_t *buffer) {
+    if (buffer == NULL) {
+        return;
+    }
+    if (mResultMetadataPool.size() >= kMaxResultMetadataPoolSize ||
+            get_camera_metadata_entry_capacity(buffer) < mResultEntryCapacity ||
+            get_camera_metadata_data_capacity(buffer) < mResultDataCapacity) {
+        free_camera_metadata(buffer);
+        return;
+    }
+    mResultMetadataPool.push(buffer);
+}
+
+camera_metadata_t* Camera3Device::cloneResultMetadata(const camera_metadata_t *src) {
+    Mutex::Autolock l(mOutputLock);
+
+    camera_metadata_t *buffer = obtainResultMetadataLocked(
+            get_camera_metadata_entry_count(src), get_camera_metadata_data_count(src));
+    if (buffer != NULL && append_camera_metadata(buffer, src) != OK) {
+        free_camera_metadata(buffer);
+        return clone_camera_metadata(src);
+    }
+    return buffer;
+}
+
+void Camera3Device::recycleResultMetadata(camera_metadata_t *buffer) {
+    Mutex::Autolock l(mOutputLock);
+    recycleResultMetadataLocked(buffer);
+}
+
 status_t Camera3Device::triggerAutofocus(uint32_t id) {
     ATRACE_CALL();
     Mutex::Autolock il(mInterfaceLock);
@@ -1458,7 +1584,7 @@ status_t Camera3Device::prepare(int maxCount, int streamId) {
         return BAD_VALUE;
     }
 
-    return mPreparerThread->prepare(maxCount, stream);
+    return getPreparerThread(streamId)->prepare(maxCount, stream);
 }
 
 status_t Camera3Device::tearDown(int streamId) {
@@ -1768,6 +1894,8 @@ status_t Camera3Device::configureStreamsLocked() {
     // across configure_streams() calls
     mRequestThread->configurationComplete();
 
+    preallocateStreamsLocked();
+
     // Boost priority of request thread for high speed recording to SCHED_FIFO
     if (mIsConstrainedHighSpeedConfiguration) {
         pid_t requestThreadTid = mRequestThread->getTid();
@@ -1798,6 +1926,36 @@ status_t Camera3Device::configureStreamsLocked() {
     return OK;
 }
 
+void Camera3Device::preallocateStreamsLocked() {
+    if (mStreamPreallocCount == NO_PREALLOCATION) return;
+
+    for (size_t i = 0; i < mOutputStreams.size(); i++) {
+        int streamId = mOutputStreams.keyAt(i);
+        sp<Camera3StreamInterface> stream = mOutputStreams.editValueAt(i);
+
+        // Skip the dummy stream, which has no buffers, and bidirectional streams, whose buffers
+        // come back from the HAL as input
+        if (streamId == mDummyStreamId ||
+                stream.get() == static_cast<Camera3StreamInterface*>(mInputStream.get())) {
+            continue;
+        }
+        if (stream->isUnpreparable() || stream->hasOutstandingBuffers()) {
+            continue;
+        }
+
+        status_t res = getPreparerThread(streamId)->prepare(mStreamPreallocCount, stream,
+                /*background*/true);
+        if (res != OK) {
+            ALOGW("%s: Camera %d: Unable to preallocate buffers for stream %d: %s (%d)",
+                    __FUNCTION__, mId, streamId, strerror(-res), res);
+        }
+    }
+}
+
+sp<Camera3Device::PreparerThread> Camera3Device::getPreparerThread(int streamId) const {
+    return mPreparerThreads[static_cast<size_t>(streamId) % mPreparerThreads.size()];
+}
+
 status_t Camera3Device::addDummyStreamLocked() {
     ATRACE_CALL();
     status_t res;
@@ -1989,13 +2147,12 @@ bool Camera3Device::processPartial3AResult(
 
     Mutex::Autolock l(mOutputLock);
 
-    CaptureResult captureResult;
-    captureResult.mResultExtras = resultExtras;
-    captureResult.mMetadata = CameraMetadata(kMinimal3AResultEntries, /*dataCapacity*/ 0);
     // TODO: change this to sp<CaptureResult>. This will need other changes, including,
     // but not limited to CameraDeviceBase::getNextResult
-    CaptureResult& min3AResult =
-            *mResultQueue.insert(mResultQueue.end(), captureResult);
+    CaptureResult& min3AResult = queueResultLocked();
+    min3AResult.mResultExtras = resultExtras;
+    min3AResult.mMetadata.acquire(
+            obtainResultMetadataLocked(kMinimal3AResultEntries, /*dataCount*/ 0));
 
     if (!insert3AResult(min3AResult.mMetadata, ANDROID_REQUEST_FRAME_COUNT,
             // TODO: This is problematic casting. Need to fix CameraMetadata.
@@ -2089,7 +2246,7 @@ template<typename T>
 bool Camera3Device::insert3AResult(CameraMetadata& result, int32_t tag,
         const T* value, uint32_t frameNumber) {
     if (result.update(tag, value, 1) != NO_ERROR) {
-        mResultQueue.erase(--mResultQueue.end(), mResultQueue.end());
+        dequeueLastResultLocked();
         SET_ERR("Frame %d: Failed to set %s in partial metadata",
                 frameNumber, get_camera_metadata_tag_name(tag));
         return false;
@@ -2165,13 +2322,13 @@ void Camera3Device::removeInFlightRequestIfReadyLocked(int idx) {
 }
 
 
-void Camera3Device::sendCaptureResult(CameraMetadata &pendingMetadata,
+void Camera3Device::sendCaptureResult(const camera_metadata_t *pendingMetadata,
         CaptureResultExtras &resultExtras,
         CameraMetadata &collectedPartialResult,
         uint32_t frameNumber,
         bool reprocess,
         const AeTriggerCancelOverride_t &aeTriggerCancelOverride) {
-    if (pendingMetadata.isEmpty())
+    if (pendingMetadata == NULL || get_camera_metadata_entry_count(pendingMetadata) == 0)
         return;
 
     Mutex::Autolock l(mOutputLock);
@@ -2195,14 +2352,30 @@ void Camera3Device::sendCaptureResult(CameraMetadata &pendingMetadata,
         mNextResultFrameNumber = frameNumber + 1;
     }
 
-    CaptureResult captureResult;
-    captureResult.mResultExtras = resultExtras;
-    captureResult.mMetadata = pendingMetadata;
+    // Merge everything into a single pooled buffer large enough for the
+    // pending metadata, the frame count, the partials and the 3A overrides.
+    size_t entryCount = get_camera_metadata_entry_count(pendingMetadata) + 3;
+    size_t dataCount = get_camera_metadata_data_count(pendingMetadata);
+    bool appendPartials = mUsePartialResult && !collectedPartialResult.isEmpty();
+    if (appendPartials) {
+        const camera_metadata_t *partials = collectedPartialResult.getAndLock();
+        entryCount += get_camera_metadata_entry_count(partials);
+        dataCount += get_camera_metadata_data_count(partials);
+        collectedPartialResult.unlock(partials);
+    }
+    CameraMetadata metadata(obtainResultMetadataLocked(entryCount, dataCount));
 
-    if (captureResult.mMetadata.update(ANDROID_REQUEST_FRAME_COUNT,
+    if (metadata.append(pendingMetadata) != OK) {
+        SET_ERR("Failed to copy metadata for frame %d", frameNumber);
+        recycleResultMetadataLocked(metadata.release());
+        return;
+    }
+
+    if (metadata.update(ANDROID_REQUEST_FRAME_COUNT,
             (int32_t*)&frameNumber, 1) != OK) {
         SET_ERR("Failed to set frame# in metadata (%d)",
                 frameNumber);
+        recycleResultMetadataLocked(metadata.release());
         return;
     } else {
         ALOGVV("%s: Camera %d: Set frame# in metadata (%d)",
@@ -2210,31 +2383,33 @@ void Camera3Device::sendCaptureResult(CameraMetadata &pendingMetadata,
     }
 
     // Append any previous partials to form a complete result
-    if (mUsePartialResult && !collectedPartialResult.isEmpty()) {
-        captureResult.mMetadata.append(collectedPartialResult);
+    if (appendPartials) {
+        metadata.append(collectedPartialResult);
     }
+    recycleResultMetadataLocked(collectedPartialResult.release());
 
-    captureResult.mMetadata.sort();
+    metadata.sort();
 
     // Check that there's a timestamp in the result metadata
-    camera_metadata_entry entry =
-            captureResult.mMetadata.find(ANDROID_SENSOR_TIMESTAMP);
+    camera_metadata_entry entry = metadata.find(ANDROID_SENSOR_TIMESTAMP);
     if (entry.count == 0) {
         SET_ERR("No timestamp provided by HAL for frame %d!",
                 frameNumber);
+        recycleResultMetadataLocked(metadata.release());
         return;
     }
 
-    overrideResultForPrecaptureCancel(&captureResult.mMetadata, aeTriggerCancelOverride);
+    overrideResultForPrecaptureCancel(&metadata, aeTriggerCancelOverride);
 
     // Valid result, insert into queue
-    List<CaptureResult>::iterator queuedResult =
-            mResultQueue.insert(mResultQueue.end(), CaptureResult(captureResult));
+    CaptureResult &queuedResult = queueResultLocked();
+    queuedResult.mResultExtras = resultExtras;
+    queuedResult.mMetadata.acquire(metadata);
     ALOGVV("%s: result requestId = %" PRId32 ", frameNumber = %" PRId64
            ", burstId = %" PRId32, __FUNCTION__,
-           queuedResult->mResultExtras.requestId,
-           queuedResult->mResultExtras.frameNumber,
-           queuedResult->mResultExtras.burstId);
+           queuedResult.mResultExtras.requestId,
+           queuedResult.mResultExtras.frameNumber,
+           queuedResult.mResultExtras.burstId);
 
     mResultSignal.signal();
 }
@@ -2313,7 +2488,12 @@ void Camera3Device::processCaptureResult(const camera3_capture_result *result) {
                 }
                 isPartialResult = (result->partial_result < mNumPartialResults);
                 if (isPartialResult) {
-                    request.partialResult.collectedResult.append(result->result);
+                    if (request.partialResult.collectedResult.isEmpty()) {
+                        request.partialResult.collectedResult.acquire(
+                                cloneResultMetadata(result->result));
+                    } else {
+                        request.partialResult.collectedResult.append(result->result);
+                    }
                 }
             } else {
                 camera_metadata_ro_entry_t partialResultEntry;
@@ -2326,8 +2506,13 @@ void Camera3Device::processCaptureResult(const camera3_capture_result *result) {
                     // A partial result. Flag this as such, and collect this
                     // set of metadata into the in-flight entry.
                     isPartialResult = true;
-                    request.partialResult.collectedResult.append(
-                        result->result);
+                    if (request.partialResult.collectedResult.isEmpty()) {
+                        request.partialResult.collectedResult.acquire(
+                                cloneResultMetadata(result->result));
+                    } else {
+                        request.partialResult.collectedResult.append(
+                            result->result);
+                    }
                     request.partialResult.collectedResult.erase(
                         ANDROID_QUIRKS_PARTIAL_RESULT);
                 }
@@ -2399,12 +2584,10 @@ void Camera3Device::processCaptureResult(const camera3_capture_result *result) {
 
         if (result->result != NULL && !isPartialResult) {
             if (shutterTimestamp == 0) {
-                request.pendingMetadata = result->result;
-                request.partialResult.collectedResult = collectedPartialResult;
+                request.pendingMetadata.acquire(cloneResultMetadata(result->result));
+                request.partialResult.collectedResult.acquire(collectedPartialResult);
             } else {
-                CameraMetadata metadata;
-                metadata = result->result;
-                sendCaptureResult(metadata, request.resultExtras,
+                sendCaptureResult(result->result, request.resultExtras,
                     collectedPartialResult, frameNumber, hasInputBufferInRequest,
                     request.aeTriggerCancelOverride);
             }
@@ -2578,9 +2761,11 @@ void Camera3Device::notifyShutter(const camera3_shutter_msg_t &msg,
             r.shutterTimestamp = msg.timestamp;
 
             // send pending result and buffers
-            sendCaptureResult(r.pendingMetadata, r.resultExtras,
+            camera_metadata_t *pendingMetadata = r.pendingMetadata.release();
+            sendCaptureResult(pendingMetadata, r.resultExtras,
                 r.partialResult.collectedResult, msg.frame_number,
                 r.hasInputBuffer, r.aeTriggerCancelOverride);
+            recycleResultMetadata(pendingMetadata);
             returnOutputBuffers(r.pendingOutputBuffers.array(),
                 r.pendingOutputBuffers.size(), r.shutterTimestamp);
             r.pendingOutputBuffers.clear();
@@ -2621,6 +2806,10 @@ Camera3Device::RequestThread::RequestThread(wp<Camera3Device> parent,
         mStatusTracker(statusTracker),
         mHal3Device(hal3Device),
         mId(getId(parent)),
+        mPipelineDepth(0),
+        mSubmitStatusId(-1),
+        mPipelineLockedSettings(0),
+        mSubmitFailed(false),
         mReconfigured(false),
         mDoPause(false),
         mPaused(true),
@@ -2631,6 +2820,51 @@ Camera3Device::RequestThread::RequestThread(wp<Camera3Device> parent,
         mRepeatingLastFrameNumber(NO_IN_FLIGHT_REPEATING_FRAMES),
         mAeLockAvailable(aeLockAvailable) {
     mStatusId = statusTracker->addComponent();
+
+    char value[PROPERTY_VALUE_MAX];
+    property_get("camera.request_pipeline_depth", value, "0");
+    int depth = atoi(value);
+    if (depth > 0) {
+        mPipelineDepth = depth;
+        if (mPipelineDepth > kMaxPipelineDepth) {
+            mPipelineDepth = kMaxPipelineDepth;
+        }
+        mSubmitStatusId = statusTracker->addComponent();
+        mSubmitThread = new SubmitThread(this);
+        ALOGI("%s: Camera %d: request pipeline depth %zu", __FUNCTION__, mId, mPipelineDepth);
+    }
+}
+
+status_t Camera3Device::RequestThread::readyToRun() {
+    if (mSubmitThread != NULL) {
+        status_t res = mSubmitThread->run(
+                String8::format("C3Dev-%d-Submit", mId).string());
+        if (res != OK) {
+            ALOGE("%s: Unable to start request submission thread: %s (%d)",
+                    __FUNCTION__, strerror(-res), res);
+            return res;
+        }
+    }
+    return OK;
+}
+
+void Camera3Device::RequestThread::joinSubmitThread() {
+    if (mSubmitThread == NULL) {
+        return;
+    }
+    mSubmitThread->join();
+
+    // Return the buffers of batches that were prepared but never submitted
+    List<Vector<NextRequest> > pendingBatches;
+    {
+        Mutex::Autolock l(mPipelineLock);
+        pendingBatches = mPreparedBatches;
+        mPreparedBatches.clear();
+        mPipelineLockedSettings = 0;
+    }
+    for (auto& batch : pendingBatches) {
+        returnFailedRequests(batch, /*sendRequestError*/ false);
+    }
 }
 
 void Camera3Device::RequestThread::setNotificationListener(
@@ -2843,9 +3077,13 @@ status_t Camera3Device::RequestThread::waitUntilRequestProcessed(
 void Camera3Device::RequestThread::requestExit() {
     // Call parent to set up shutdown
     Thread::requestExit();
+    if (mSubmitThread != NULL) {
+        mSubmitThread->requestExit();
+    }
     // The exit from any possible waits
     mDoPauseSignal.signal();
     mRequestSignal.signal();
+    mPipelineSignal.broadcast();
 }
 
 
@@ -2933,6 +3171,16 @@ bool Camera3Device::RequestThread::threadLoop() {
         latestRequestId = NAME_NOT_FOUND;
     }
 
+    // With request pipelining, the previous batches may still be waiting for
+    // the HAL; bound how far ahead this batch is prepared.
+    if (mPipelineDepth > 0) {
+        size_t maxQueued = needsPipelineDrain() ? 0 : mPipelineDepth;
+        if (!waitForPipelineRoom(maxQueued)) {
+            cleanUpFailedRequests(/*sendRequestError*/ false);
+            return false;
+        }
+    }
+
     // Prepare a batch of HAL requests and output buffers.
     res = prepareHalRequests();
     if (res == TIMED_OUT) {
@@ -2952,22 +3200,45 @@ bool Camera3Device::RequestThread::threadLoop() {
         mLatestRequestSignal.signal();
     }
 
+    if (mPipelineDepth > 0) {
+        // Hand the batch over to the submission thread
+        queuePreparedBatch();
+        return true;
+    }
+
     // Submit a batch of requests to HAL.
+    bool success = submitRequestBatch(mNextRequests);
+
+    // Unset as current request
+    {
+        Mutex::Autolock l(mRequestLock);
+        mNextRequests.clear();
+    }
+
+    return success;
+}
+
+bool Camera3Device::RequestThread::submitRequestBatch(Vector<NextRequest> &requests) {
+    status_t res;
+
     // Use flush lock only when submitting multilple requests in a batch.
     // TODO: The problem with flush lock is flush() will be blocked by process_capture_request()
     // which may take a long time to finish so synchronizing flush() and
     // process_capture_request() defeats the purpose of cancelling requests ASAP with flush().
     // For now, only synchronize for high speed recording and we should figure something out for
     // removing the synchronization.
-    bool useFlushLock = mNextRequests.size() > 1;
+    bool useFlushLock = requests.size() > 1;
 
     if (useFlushLock) {
         mFlushLock.lock();
     }
 
     ALOGVV("%s: %d: submitting %d requests in a batch.", __FUNCTION__, __LINE__,
-            mNextRequests.size());
-    for (auto& nextRequest : mNextRequests) {
+            requests.size());
+    for (auto& nextRequest : requests) {
+        // The batch may have been copied since it was prepared
+        nextRequest.halRequest.output_buffers = nextRequest.outputBuffers.array();
+
         // Submit request and block until ready for next one
         ATRACE_ASYNC_BEGIN("frame capture", nextRequest.halRequest.frame_number);
         ATRACE_BEGIN("camera3->process_capture_request");
@@ -2981,7 +3252,7 @@ bool Camera3Device::RequestThread::threadLoop() {
             SET_ERR("RequestThread: Unable to submit capture request %d to HAL"
                     " device: %s (%d)", nextRequest.halRequest.frame_number, strerror(-res),
                     res);
-            cleanUpFailedRequests(/*sendRequestError*/ false);
+            returnFailedRequests(requests, /*sendRequestError*/ false);
             if (useFlushLock) {
                 mFlushLock.unlock();
             }
@@ -3001,19 +3272,21 @@ bool Camera3Device::RequestThread::threadLoop() {
 
         if (nextRequest.halRequest.settings != NULL) {
             nextRequest.captureRequest->mSettings.unlock(nextRequest.halRequest.settings);
-        }
 
-        // Remove any previously queued triggers (after unlock)
-        res = removeTriggers(mPrevRequest);
-        if (res != OK) {
-            SET_ERR("RequestThread: Unable to remove triggers "
-                  "(capture request %d, HAL device: %s (%d)",
-                  nextRequest.halRequest.frame_number, strerror(-res), res);
-            cleanUpFailedRequests(/*sendRequestError*/ false);
-            if (useFlushLock) {
-                mFlushLock.unlock();
+            // Remove any previously queued triggers (after unlock). Triggers are only mixed
+            // into requests sent with new settings, so there is nothing to remove otherwise,
+            // while a later pipelined batch may already have inserted its own.
+            res = removeTriggers(nextRequest.captureRequest);
+            if (res != OK) {
+                SET_ERR("RequestThread: Unable to remove triggers "
+                      "(capture request %d, HAL device: %s (%d)",
+                      nextRequest.halRequest.frame_number, strerror(-res), res);
+                returnFailedRequests(requests, /*sendRequestError*/ false);
+                if (useFlushLock) {
+                    mFlushLock.unlock();
+                }
+                return false;
             }
-            return false;
         }
     }
 
@@ -3021,13 +3294,134 @@ bool Camera3Device::RequestThread::threadLoop() {
         mFlushLock.unlock();
     }
 
-    // Unset as current request
+    return true;
+}
+
+bool Camera3Device::RequestThread::needsPipelineDrain() {
+    // Batches that send new settings or mix in triggers modify the request metadata, which
+    // must not happen while an earlier batch still holds it locked or has triggers to remove.
     {
-        Mutex::Autolock l(mRequestLock);
-        mNextRequests.clear();
+        Mutex::Autolock l(mPipelineLock);
+        if (mPipelineLockedSettings > 0) {
+            return true;
+        }
     }
 
-    return true;
+    if (mPrevTriggers > 0) {
+        return true;
+    }
+
+    for (const auto& nextRequest : mNextRequests) {
+        if (nextRequest.captureRequest != mPrevRequest) {
+            return true;
+        }
+    }
+
+    Mutex::Autolock l(mTriggerMutex);
+    return !mTriggerMap.isEmpty();
+}
+
+bool Camera3Device::RequestThread::waitForPipelineRoom(size_t maxQueued) {
+    ATRACE_CALL();
+    Mutex::Autolock l(mPipelineLock);
+
+    while (mPreparedBatches.size() > maxQueued) {
+        if (exitPending() || mSubmitFailed) {
+            return false;
+        }
+        mPipelineSignal.waitRelative(mPipelineLock, kRequestTimeout);
+    }
+
+    return !mSubmitFailed;
+}
+
+void Camera3Device::RequestThread::queuePreparedBatch() {
+    Mutex::Autolock l(mRequestLock);
+    Mutex::Autolock pl(mPipelineLock);
+
+    for (const auto& nextRequest : mNextRequests) {
+        if (nextRequest.halRequest.settings != NULL) {
+            mPipelineLockedSettings++;
+            break;
+        }
+    }
+
+    if (mPreparedBatches.empty()) {
+        sp<StatusTracker> statusTracker = mStatusTracker.promote();
+        if (statusTracker != 0) {
+            statusTracker->markComponentActive(mSubmitStatusId);
+        }
+    }
+
+    mPreparedBatches.push_back(mNextRequests);
+    mNextRequests.clear();
+    mPipelineSignal.broadcast();
+}
+
+bool Camera3Device::RequestThread::submitPreparedBatch() {
+    List<Vector<NextRequest> >::iterator batch;
+    {
+        Mutex::Autolock l(mPipelineLock);
+        if (mPreparedBatches.empty()) {
+            // Return to let the thread check for exit
+            mPipelineSignal.waitRelative(mPipelineLock, kRequestTimeout);
+            if (mPreparedBatches.empty()) {
+                return true;
+            }
+        }
+        batch = mPreparedBatches.begin();
+    }
+
+    // The batch stays at the front of the queue while it is being submitted, so that
+    // isStreamPending() sees its unsubmitted requests. The RequestThread only appends.
+    bool success = submitRequestBatch(*batch);
+
+    List<Vector<NextRequest> > failedBatches;
+    {
+        Mutex::Autolock l(mPipelineLock);
+        for (const auto& nextRequest : *batch) {
+            if (nextRequest.halRequest.settings != NULL) {
+                mPipelineLockedSettings--;
+                break;
+            }
+        }
+        mPreparedBatches.erase(batch);
+
+        if (!success) {
+            // Nothing more can be sent to the HAL
+            mSubmitFailed = true;
+            failedBatches = mPreparedBatches;
+            mPreparedBatches.clear();
+            mPipelineLockedSettings = 0;
+        }
+
+        if (mPreparedBatches.empty()) {
+            sp<StatusTracker> statusTracker = mStatusTracker.promote();
+            if (statusTracker != 0) {
+                statusTracker->markComponentIdle(mSubmitStatusId, Fence::NO_FENCE);
+            }
+        }
+        mPipelineSignal.broadcast();
+    }
+
+    for (auto& failedBatch : failedBatches) {
+        returnFailedRequests(failedBatch, /*sendRequestError*/ false);
+    }
+
+    return success;
+}
+
+Camera3Device::RequestThread::SubmitThread::SubmitThread(wp<RequestThread> parent) :
+        Thread(/*canCallJava*/false),
+        mParent(parent) {
+}
+
+bool Camera3Device::RequestThread::SubmitThread::threadLoop() {
+    sp<RequestThread> parent = mParent.promote();
+    if (parent == NULL) {
+        return false;
+    }
+    return parent->submitPreparedBatch();
 }
 
 status_t Camera3Device::RequestThread::prepareHalRequests() {
@@ -3173,6 +3567,20 @@ bool Camera3Device::RequestThread::isStreamPending(
         }
     }
 
+    {
+        Mutex::Autolock pl(mPipelineLock);
+        for (const auto& batch : mPreparedBatches) {
+            for (const auto& nextRequest : batch) {
+                if (!nextRequest.submitted) {
+                    for (const auto& s : nextRequest.captureRequest->mOutputStreams) {
+                        if (stream == s) return true;
+                    }
+                    if (stream == nextRequest.captureRequest->mInputStream) return true;
+                }
+            }
+        }
+    }
+
     for (const auto& request : mRequestQueue) {
         for (const auto& s : request->mOutputStreams) {
             if (stream == s) return true;
@@ -3195,7 +3603,15 @@ void Camera3Device::RequestThread::cleanUpFailedRequests(bool sendRequestError)
         return;
     }
 
-    for (auto& nextRequest : mNextRequests) {
+    returnFailedRequests(mNextRequests, sendRequestError);
+
+    Mutex::Autolock l(mRequestLock);
+    mNextRequests.clear();
+}
+
+void Camera3Device::RequestThread::returnFailedRequests(Vector<NextRequest> &requests,
+        bool sendRequestError) {
+    for (auto& nextRequest : requests) {
         // Skip the ones that have been submitted successfully.
         if (nextRequest.submitted) {
             continue;
@@ -3228,9 +3644,6 @@ void Camera3Device::RequestThread::cleanUpFailedRequests(bool sendRequestError)
             }
         }
     }
-
-    Mutex::Autolock l(mRequestLock);
-    mNextRequests.clear();
 }
 
 void Camera3Device::RequestThread::waitForNextRequestBatch() {
@@ -3637,19 +4050,31 @@ Camera3Device::PreparerThread::~PreparerThread() {
     clear();
 }
 
-status_t Camera3Device::PreparerThread::prepare(int maxCount, sp<Camera3StreamInterface>& stream) {
+status_t Camera3Device::PreparerThread::prepare(int maxCount, sp<Camera3StreamInterface>& stream,
+        bool background) {
     status_t res;
 
     Mutex::Autolock l(mLock);
 
-    res = stream->startPrepare(maxCount);
+    // The earlier background request for this stream is still queued or running, and drives
+    // the preparation
+    if (background && mBackgroundStreamIds.indexOf(stream->getId()) >= 0) {
+        return OK;
+    }
+
+    res = stream->startPrepare(maxCount, background);
     if (res == OK) {
         // No preparation needed, fire listener right off
         ALOGV("%s: Stream %d already prepared", __FUNCTION__, stream->getId());
-        if (mListener) {
+        if (mListener && !background) {
             mListener->notifyPrepared(stream->getId());
         }
         return OK;
+    } else if (res == ALREADY_EXISTS) {
+        // Being prepared in the background by this thread; notify once that finishes
+        ALOGV("%s: Stream %d preparation moved to foreground", __FUNCTION__, stream->getId());
+        mBackgroundStreamIds.remove(stream->getId());
+        return OK;
     } else if (res != NOT_ENOUGH_DATA) {
         return res;
     }
@@ -3662,7 +4087,9 @@ status_t Camera3Device::PreparerThread::prepare(int maxCount, sp<Camera3StreamIn
         res = Thread::run("C3PrepThread", PRIORITY_BACKGROUND);
         if (res != OK) {
             ALOGE("%s: Unable to start preparer stream: %d (%s)", __FUNCTION__, res, strerror(-res));
-            if (mListener) {
+            if (background) {
+                stream->cancelPrepare();
+            } else if (mListener) {
                 mListener->notifyPrepared(stream->getId());
             }
             return res;
@@ -3673,6 +4100,9 @@ status_t Camera3Device::PreparerThread::prepare(int maxCount, sp<Camera3StreamIn
     }
 
     // queue up the work
+    if (background) {
+        mBackgroundStreamIds.add(stream->getId());
+    }
     mPendingStreams.push_back(stream);
     ALOGV("%s: Stream %d queued for preparing", __FUNCTION__, stream->getId());
 
@@ -3686,6 +4116,7 @@ status_t Camera3Device::PreparerThread::clear() {
 
     for (const auto& stream : mPendingStreams) {
         stream->cancelPrepare();
+        mBackgroundStreamIds.remove(stream->getId());
     }
     mPendingStreams.clear();
     mCancelNow = true;
@@ -3720,6 +4151,7 @@ bool Camera3Device::PreparerThread::threadLoop() {
             ALOGV("%s: Preparing stream %d", __FUNCTION__, mCurrentStream->getId());
         } else if (mCancelNow) {
             mCurrentStream->cancelPrepare();
+            mBackgroundStreamIds.remove(mCurrentStream->getId());
             ATRACE_ASYNC_END("stream prepare", mCurrentStream->getId());
             ALOGV("%s: Cancelling stream %d prepare", __FUNCTION__, mCurrentStream->getId());
             mCurrentStream.clear();
@@ -3738,9 +4170,13 @@ bool Camera3Device::PreparerThread::threadLoop() {
         mCurrentStream->cancelPrepare();
     }
 
-    // This stream has finished, notify listener
+    // This stream has finished, notify listener unless it was a background preparation
     Mutex::Autolock l(mLock);
-    if (mListener) {
+    ssize_t backgroundIdx = mBackgroundStreamIds.indexOf(mCurrentStream->getId());
+    if (backgroundIdx >= 0) {
+        ALOGV("%s: Stream %d background prepare done", __FUNCTION__, mCurrentStream->getId());
+        mBackgroundStreamIds.removeAt(backgroundIdx);
+    } else if (mListener) {
         ALOGV("%s: Stream %d prepare done, signaling listener", __FUNCTION__,
                 mCurrentStream->getId());
         mListener->notifyPrepared(mCurrentStream->getId());
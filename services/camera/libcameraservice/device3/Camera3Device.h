@@ -23,6 +23,7 @@
 #include <utils/Mutex.h>
 #include <utils/Thread.h>
 #include <utils/KeyedVector.h>
+#include <utils/SortedVector.h>
 #include <hardware/camera3.h>
 #include <camera/CaptureResult.h>
 #include <camera/camera2/ICameraDeviceUser.h>
@@ -350,6 +351,14 @@ class Camera3Device :
      */
     status_t           configureStreamsLocked();
 
+    /**
+     * Apply the stream preallocation policy to all output streams after a
+     * configuration. Buffers are allocated in the background and silently;
+     * a stream that is needed by a request before it is done just stops
+     * preallocating.
+     */
+    void               preallocateStreamsLocked();
+
     /**
      * Add a dummy stream to the current stream set as a workaround for
      * not allowing 0 streams in the camera HAL spec.
@@ -493,9 +502,16 @@ class Camera3Device :
          */
         bool isStreamPending(sp<camera3::Camera3StreamInterface>& stream);
 
+        /**
+         * Wait for the HAL submission thread to exit when request pipelining
+         * is enabled. Call after join(), once requestExit() has been called.
+         */
+        void     joinSubmitThread();
+
       protected:
 
         virtual bool threadLoop();
+        virtual status_t readyToRun();
 
       private:
         static int         getId(const wp<Camera3Device> &device);
@@ -513,6 +529,9 @@ class Camera3Device :
 
         static const nsecs_t kRequestTimeout = 50e6; // 50 ms
 
+        // Upper bound for the camera.request_pipeline_depth property
+        static const size_t kMaxPipelineDepth = 4;
+
         // Used to prepare a batch of requests.
         struct NextRequest {
             sp<CaptureRequest>              captureRequest;
@@ -521,6 +540,23 @@ class Camera3Device :
             bool                            submitted;
         };
 
+        /**
+         * Thread sending prepared request batches to the HAL when request
+         * pipelining is enabled, so that the RequestThread can merge metadata
+         * and dequeue buffers for the next batch while the HAL is still
+         * blocked in process_capture_request for the current one.
+         */
+        class SubmitThread : public Thread {
+          public:
+            SubmitThread(wp<RequestThread> parent);
+
+          protected:
+            virtual bool threadLoop();
+
+          private:
+            wp<RequestThread> mParent;
+        };
+
         // Wait for the next batch of requests and put them in mNextRequests. mNextRequests will
         // be empty if it times out.
         void waitForNextRequestBatch();
@@ -538,6 +574,24 @@ class Camera3Device :
         // ERROR state to mark them as not having valid data. mNextRequests will be cleared.
         void cleanUpFailedRequests(bool sendRequestError);
 
+        // Same as above for an arbitrary batch, which is left untouched apart from buffer state.
+        void returnFailedRequests(Vector<NextRequest> &requests, bool sendRequestError);
+
+        // Send a prepared batch to the HAL. Returns false on a fatal error, in which case the
+        // device has been put into the error state and the unsubmitted requests cleaned up.
+        bool submitRequestBatch(Vector<NextRequest> &requests);
+
+        // Request pipelining. Whether the batch in mNextRequests has to wait for every prepared
+        // batch to reach the HAL before it can be prepared itself.
+        bool needsPipelineDrain();
+        // Wait until at most maxQueued batches are waiting for submission. Returns false if the
+        // thread is exiting or the submission thread failed.
+        bool waitForPipelineRoom(size_t maxQueued);
+        // Move mNextRequests to the submission queue.
+        void queuePreparedBatch();
+        // Submission thread body; sends the oldest prepared batch to the HAL.
+        bool submitPreparedBatch();
+
         // Pause handling
         bool               waitIfPaused();
         void               unpauseForNewRequests();
@@ -573,6 +627,19 @@ class Camera3Device :
         // To protect flush() and sending a request batch to HAL.
         Mutex              mFlushLock;
 
+        // Request pipelining, enabled when mPipelineDepth > 0. Batches prepared ahead wait in
+        // mPreparedBatches for mSubmitThread; the batch at the front stays queued until it has
+        // been fully submitted. Lock order is mRequestLock, then mPipelineLock.
+        size_t             mPipelineDepth;
+        sp<SubmitThread>   mSubmitThread;
+        int                mSubmitStatusId;
+        Mutex              mPipelineLock;
+        Condition          mPipelineSignal;
+        List<Vector<NextRequest> > mPreparedBatches;
+        // Number of queued batches holding locked request settings
+        size_t             mPipelineLockedSettings;
+        bool               mSubmitFailed;
+
         bool               mReconfigured;
 
         // Used by waitIfPaused, waitForNextRequest, and waitUntilPaused
@@ -733,8 +800,13 @@ class Camera3Device :
          * Queue up a stream to be prepared. Streams are processed by a background thread in FIFO
          * order.  Pre-allocate up to maxCount buffers for the stream, or the maximum number needed
          * for the pipeline if maxCount is ALLOCATE_PIPELINE_MAX.
+         *
+         * Background preparation does not notify the listener when done, and gives way to any
+         * request that needs the stream. A later foreground prepare of the same stream takes over
+         * and is notified as usual; it must be queued on the same PreparerThread.
          */
-        status_t prepare(int maxCount, sp<camera3::Camera3StreamInterface>& stream);
+        status_t prepare(int maxCount, sp<camera3::Camera3StreamInterface>& stream,
+                bool background = false);
 
         /**
          * Cancel all current and pending stream preparation
@@ -750,6 +822,8 @@ class Camera3Device :
 
         NotificationListener *mListener;
         List<sp<camera3::Camera3StreamInterface> > mPendingStreams;
+        // IDs of queued or current streams being prepared in the background
+        SortedVector<int> mBackgroundStreamIds;
         bool mActive;
         bool mCancelNow;
 
@@ -757,7 +831,19 @@ class Camera3Device :
 
         sp<camera3::Camera3StreamInterface> mCurrentStream;
     };
-    sp<PreparerThread> mPreparerThread;
+    // Streams are spread over the preparer threads by ID, so buffers for different streams are
+    // allocated in parallel while each stream always stays with the same thread.
+    Vector<sp<PreparerThread> > mPreparerThreads;
+    sp<PreparerThread> getPreparerThread(int streamId) const;
+
+    static const size_t kDefaultPreparerThreads = 2;
+    static const size_t kMaxPreparerThreads = 4;
+
+    // Buffers to preallocate for each output stream after configuration: NO_PREALLOCATION
+    // (lazy, the default), ALLOCATE_PIPELINE_MAX (eager), or a fixed count. Set by the
+    // camera.stream_prealloc property.
+    static const int NO_PREALLOCATION = -1;
+    int mStreamPreallocCount;
 
     /**
      * Output result queue and current HAL device 3A state
@@ -775,12 +861,41 @@ class Camera3Device :
     uint32_t               mNextShutterFrameNumber;
     // the minimal frame number of the next reprocess shutter
     uint32_t               mNextReprocessShutterFrameNumber;
-    List<CaptureResult>   mResultQueue;
+    // Result queue, kept as a ring of reusable CaptureResult slots. Queued
+    // results occupy mResultQueueCount slots starting at mResultQueueHead.
+    Vector<CaptureResult>  mResultQueue;
+    size_t                 mResultQueueHead;
+    size_t                 mResultQueueCount;
     Condition              mResultSignal;
     NotificationListener  *mListener;
 
+    // Result metadata buffers handed back by getNextResult or released by
+    // in-flight requests, and the largest result seen so far, which sizes
+    // new buffers so that merging partials and adding the frame count
+    // doesn't reallocate.
+    Vector<camera_metadata_t*> mResultMetadataPool;
+    size_t                 mResultEntryCapacity;
+    size_t                 mResultDataCapacity;
+
+    static const size_t    kMinResultQueueSize = 8;
+    static const size_t    kMaxResultMetadataPoolSize = 8;
+
+    // Get an empty result metadata buffer with room for at least the given
+    // number of entries and data bytes.
+    camera_metadata_t* obtainResultMetadataLocked(size_t entryCount, size_t dataCount);
+    // Return a result metadata buffer to the pool, or free it. NULL is ignored.
+    void recycleResultMetadataLocked(camera_metadata_t *buffer);
+    // Add an empty slot at the tail of the result queue, growing it if needed
+    CaptureResult& queueResultLocked();
+    // Undo the last queueResultLocked()
+    void dequeueLastResultLocked();
+
     /**** End scope for mOutputLock ****/
 
+    // Copy HAL result metadata into a pooled buffer
+    camera_metadata_t* cloneResultMetadata(const camera_metadata_t *src);
+    void recycleResultMetadata(camera_metadata_t *buffer);
+
     /**
      * Callback functions from HAL device
      */
@@ -799,8 +914,9 @@ class Camera3Device :
             size_t numBuffers, nsecs_t timestamp);
 
     // Insert the capture result given the pending metadata, result extras,
-    // partial results, and the frame number to the result queue.
-    void sendCaptureResult(CameraMetadata &pendingMetadata,
+    // partial results, and the frame number to the result queue. The buffer of
+    // collectedPartialResult is merged and recycled.
+    void sendCaptureResult(const camera_metadata_t *pendingMetadata,
             CaptureResultExtras &resultExtras,
             CameraMetadata &collectedPartialResult, uint32_t frameNumber,
             bool reprocess, const AeTriggerCancelOverride_t &aeTriggerCancelOverride);
@@ -235,8 +235,15 @@ status_t Camera3IOStreamBase::returnAnyBufferLocked(
     // to enable clean shutdown. So we'll just return the error but otherwise
     // carry on
 
-    if (releaseFence != 0) {
-        mCombinedFence = Fence::merge(mName, mCombinedFence, releaseFence);
+    // Most buffers come back without a release fence. Merging an invalid fence
+    // would still make a new sync fd out of mCombinedFence, so skip it, and
+    // adopt the release fence as-is when there is nothing to merge it with.
+    if (releaseFence != 0 && releaseFence->isValid()) {
+        if (mCombinedFence->isValid()) {
+            mCombinedFence = Fence::merge(mName, mCombinedFence, releaseFence);
+        } else {
+            mCombinedFence = releaseFence;
+        }
     }
 
     if (output) {
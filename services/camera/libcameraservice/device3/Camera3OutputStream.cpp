@@ -193,19 +193,18 @@ status_t Camera3OutputStream::returnBufferCheckedLocked(
             mTraceFirstBuffer = false;
         }
 
-        res = native_window_set_buffers_timestamp(mConsumer.get(), timestamp);
+        res = native_window_set_buffers_timestamp(currentConsumer.get(), timestamp);
         if (res != OK) {
             ALOGE("%s: Stream %d: Error setting timestamp: %s (%d)",
                   __FUNCTION__, mId, strerror(-res), res);
-            return res;
-        }
-
-        res = currentConsumer->queueBuffer(currentConsumer.get(),
-                container_of(buffer.buffer, ANativeWindowBuffer, handle),
-                anwReleaseFence);
-        if (res != OK) {
-            ALOGE("%s: Stream %d: Error queueing buffer to native window: "
-                  "%s (%d)", __FUNCTION__, mId, strerror(-res), res);
+        } else {
+            res = currentConsumer->queueBuffer(currentConsumer.get(),
+                    container_of(buffer.buffer, ANativeWindowBuffer, handle),
+                    anwReleaseFence);
+            if (res != OK) {
+                ALOGE("%s: Stream %d: Error queueing buffer to native window: "
+                      "%s (%d)", __FUNCTION__, mId, strerror(-res), res);
+            }
         }
     }
     mLock.lock();
@@ -54,7 +54,8 @@ Camera3Stream::Camera3Stream(int id,
     mMaxSize(maxSize),
     mState(STATE_CONSTRUCTED),
     mStatusId(StatusTracker::NO_STATUS_ID),
-    mLastMaxCount(Camera3StreamInterface::ALLOCATE_PIPELINE_MAX) {
+    mLastMaxCount(Camera3StreamInterface::ALLOCATE_PIPELINE_MAX),
+    mPrepareInBackground(false) {
 
     camera3_stream::stream_type = type;
     camera3_stream::width = width;
@@ -97,6 +98,8 @@ camera3_stream* Camera3Stream::startConfiguration() {
     Mutex::Autolock l(mLock);
     status_t res;
 
+    abandonBackgroundPrepareLocked();
+
     switch (mState) {
         case STATE_ERROR:
             ALOGE("%s: In error state", __FUNCTION__);
@@ -253,7 +256,7 @@ bool Camera3Stream::isUnpreparable() {
     return mStreamUnpreparable;
 }
 
-status_t Camera3Stream::startPrepare(int maxCount) {
+status_t Camera3Stream::startPrepare(int maxCount, bool background) {
     ATRACE_CALL();
 
     Mutex::Autolock l(mLock);
@@ -265,6 +268,25 @@ status_t Camera3Stream::startPrepare(int maxCount) {
         return BAD_VALUE;
     }
 
+    size_t pipelineMax = getBufferCountLocked();
+    size_t clampedCount = (pipelineMax < static_cast<size_t>(maxCount)) ?
+            pipelineMax : static_cast<size_t>(maxCount);
+    size_t bufferCount = (maxCount == Camera3StreamInterface::ALLOCATE_PIPELINE_MAX) ?
+            pipelineMax : clampedCount;
+
+    // A client prepare() of a stream that is already being preallocated in the
+    // background takes over the ongoing preparation instead of failing.
+    if (mState == STATE_PREPARING && mPrepareInBackground && !background) {
+        mPrepareInBackground = false;
+        if (bufferCount > mPreparedBuffers.size()) {
+            mPreparedBuffers.insertAt(camera3_stream_buffer_t(),
+                    /*index*/mPreparedBuffers.size(),
+                    bufferCount - mPreparedBuffers.size());
+            mLastMaxCount = bufferCount;
+        }
+        return ALREADY_EXISTS;
+    }
+
     // This function should be only called when the stream is configured already.
     if (mState != STATE_CONFIGURED) {
         ALOGE("%s: Stream %d: Can't prepare stream if stream is not in CONFIGURED "
@@ -286,14 +308,6 @@ status_t Camera3Stream::startPrepare(int maxCount) {
         return INVALID_OPERATION;
     }
 
-
-
-    size_t pipelineMax = getBufferCountLocked();
-    size_t clampedCount = (pipelineMax < static_cast<size_t>(maxCount)) ?
-            pipelineMax : static_cast<size_t>(maxCount);
-    size_t bufferCount = (maxCount == Camera3StreamInterface::ALLOCATE_PIPELINE_MAX) ?
-            pipelineMax : clampedCount;
-
     mPrepared = bufferCount <= mLastMaxCount;
 
     if (mPrepared) return OK;
@@ -302,6 +316,7 @@ status_t Camera3Stream::startPrepare(int maxCount) {
 
     mPreparedBuffers.insertAt(camera3_stream_buffer_t(), /*index*/0, bufferCount);
     mPreparedBufferIdx = 0;
+    mPrepareInBackground = background;
 
     mState = STATE_PREPARING;
 
@@ -310,7 +325,7 @@ status_t Camera3Stream::startPrepare(int maxCount) {
 
 bool Camera3Stream::isPreparing() const {
     Mutex::Autolock l(mLock);
-    return mState == STATE_PREPARING;
+    return mState == STATE_PREPARING && !mPrepareInBackground;
 }
 
 status_t Camera3Stream::prepareNextBuffer() {
@@ -319,6 +334,12 @@ status_t Camera3Stream::prepareNextBuffer() {
     Mutex::Autolock l(mLock);
     status_t res = OK;
 
+    // A background preparation that was abandoned has nothing left to do
+    if (mState != STATE_PREPARING && mPrepareInBackground) {
+        mPrepareInBackground = false;
+        return OK;
+    }
+
     // This function should be only called when the stream is preparing
     if (mState != STATE_PREPARING) {
         ALOGE("%s: Stream %d: Can't prepare buffer if stream is not in PREPARING "
@@ -344,6 +365,7 @@ status_t Camera3Stream::prepareNextBuffer() {
     // Done with prepare - mark stream as such, and return all buffers
     // via cancelPrepare
     mPrepared = true;
+    mPrepareInBackground = false;
 
     return cancelPrepareLocked();
 }
@@ -353,6 +375,13 @@ status_t Camera3Stream::cancelPrepare() {
 
     Mutex::Autolock l(mLock);
 
+    bool background = mPrepareInBackground;
+    mPrepareInBackground = false;
+    if (background && mState != STATE_PREPARING) {
+        // Already abandoned
+        return OK;
+    }
+
     return cancelPrepareLocked();
 }
 
@@ -381,12 +410,28 @@ status_t Camera3Stream::cancelPrepareLocked() {
     return res;
 }
 
+void Camera3Stream::abandonBackgroundPrepareLocked() {
+    if (mState != STATE_PREPARING || !mPrepareInBackground) return;
+
+    ALOGV("%s: Stream %d: Abandoning background preparation after %zu of %zu buffers",
+            __FUNCTION__, mId, mPreparedBufferIdx, mPreparedBuffers.size());
+
+    // The buffers allocated so far stay with the queue; only count those as
+    // prepared. mPrepareInBackground stays set so that the preparer's next
+    // prepareNextBuffer() call finishes quietly.
+    int allocated = mPreparedBufferIdx;
+    cancelPrepareLocked();
+    mLastMaxCount = allocated;
+}
+
 status_t Camera3Stream::tearDown() {
     ATRACE_CALL();
     Mutex::Autolock l(mLock);
 
     status_t res = OK;
 
+    abandonBackgroundPrepareLocked();
+
     // This function should be only called when the stream is configured.
     if (mState != STATE_CONFIGURED) {
         ALOGE("%s: Stream %d: Can't tear down stream if stream is not in "
@@ -441,6 +486,9 @@ status_t Camera3Stream::getBuffer(camera3_stream_buffer *buffer) {
     Mutex::Autolock l(mLock);
     status_t res = OK;
 
+    // A request needs this stream now; don't make it wait on preallocation
+    abandonBackgroundPrepareLocked();
+
     // This function should be only called when the stream is configured already.
     if (mState != STATE_CONFIGURED) {
         ALOGE("%s: Stream %d: Can't get buffers if stream is not in CONFIGURED state %d",
@@ -597,6 +645,7 @@ status_t Camera3Stream::disconnect() {
     ATRACE_CALL();
     Mutex::Autolock l(mLock);
     ALOGV("%s: Stream %d: Disconnecting...", __FUNCTION__, mId);
+    abandonBackgroundPrepareLocked();
     status_t res = disconnectLocked();
 
     if (res == -ENOTCONN) {
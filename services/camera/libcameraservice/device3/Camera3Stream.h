@@ -198,18 +198,26 @@ class Camera3Stream :
      *
      * This call performs no allocation, so is quick to call.
      *
+     * A background preparation is abandoned, keeping the buffers allocated so
+     * far, as soon as the stream is needed for a request, reconfigured, torn
+     * down or disconnected.
+     *
      * Returns:
      *    OK if no more buffers need to be preallocated
      *    NOT_ENOUGH_DATA if calls to prepareNextBuffer are needed to finish
      *        buffer pre-allocation, and transitions to the PREPARING state.
+     *    ALREADY_EXISTS if a foreground preparation was requested while a
+     *        background one is in progress; the ongoing preparation continues
+     *        as a foreground one.
      *    NO_INIT in case of a serious error from the HAL device
      *    INVALID_OPERATION if called when not in CONFIGURED state, or a
      *        valid buffer has already been returned to this stream.
      */
-    status_t         startPrepare(int maxCount);
+    status_t         startPrepare(int maxCount, bool background);
 
     /**
-     * Check if the stream is mid-preparing.
+     * Check if the stream is mid-preparing. Background preparation is not
+     * reported, since it never blocks use of the stream.
      */
     bool             isPreparing() const;
 
@@ -436,6 +444,10 @@ class Camera3Stream :
 
     status_t        cancelPrepareLocked();
 
+    // Give up a background preparation so the stream can be used right away.
+    // No-op unless the stream is preparing in the background.
+    void            abandonBackgroundPrepareLocked();
+
     // Tracking for PREPARING state
 
     // State of buffer preallocation. Only true if either prepareNextBuffer
@@ -449,6 +461,10 @@ class Camera3Stream :
     // Number of buffers allocated on last prepare call.
     int mLastMaxCount;
 
+    // Whether the current (or just abandoned) preparation was started in the
+    // background, rather than by a client prepare() call.
+    bool mPrepareInBackground;
+
 }; // class Camera3Stream
 
 }; // namespace camera3
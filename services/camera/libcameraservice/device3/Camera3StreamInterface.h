@@ -111,18 +111,26 @@ class Camera3StreamInterface : public virtual RefBase {
      * PREPARING state. Otherwise, returns NOT_ENOUGH_DATA and transitions
      * to PREPARING.
      *
+     * A background preparation is abandoned, keeping the buffers allocated so
+     * far, as soon as the stream is needed for a request, reconfigured, torn
+     * down or disconnected.
+     *
      * Returns:
      *    OK if no more buffers need to be preallocated
      *    NOT_ENOUGH_DATA if calls to prepareNextBuffer are needed to finish
      *        buffer pre-allocation, and transitions to the PREPARING state.
+     *    ALREADY_EXISTS if a foreground preparation was requested while a
+     *        background one is in progress; the ongoing preparation continues
+     *        as a foreground one.
      *    NO_INIT in case of a serious error from the HAL device
      *    INVALID_OPERATION if called when not in CONFIGURED state, or a
      *        valid buffer has already been returned to this stream.
      */
-    virtual status_t startPrepare(int maxCount) = 0;
+    virtual status_t startPrepare(int maxCount, bool background) = 0;
 
     /**
-     * Check if the stream is mid-preparing.
+     * Check if the stream is mid-preparing. Background preparation is not
+     * reported, since it never blocks use of the stream.
      */
     virtual bool     isPreparing() const = 0;
 
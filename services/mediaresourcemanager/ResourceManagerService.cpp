@@ -27,6 +27,7 @@
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <unistd.h>
+#include <utils/Timers.h>
 
 #include "ResourceManagerService.h"
 #include "ServiceLog.h"
@@ -42,7 +43,7 @@ static String8 getString(const Vector<T> &items) {
     return itemsStr;
 }
 
-static bool hasResourceType(String8 type, Vector<MediaResource> resources) {
+static bool hasResourceType(const String8 &type, const Vector<MediaResource> &resources) {
     for (size_t i = 0; i < resources.size(); ++i) {
         if (resources[i].mType == type) {
             return true;
@@ -51,7 +52,7 @@ static bool hasResourceType(String8 type, Vector<MediaResource> resources) {
     return false;
 }
 
-static bool hasResourceType(String8 type, ResourceInfos infos) {
+static bool hasResourceType(const String8 &type, const ResourceInfos &infos) {
     for (size_t i = 0; i < infos.size(); ++i) {
         if (hasResourceType(type, infos[i].resources)) {
             return true;
@@ -156,12 +157,14 @@ status_t ResourceManagerService::dump(int fd, const Vector<String16>& /* args */
 ResourceManagerService::ResourceManagerService()
     : mProcessInfo(new ProcessInfo()),
       mServiceLog(new ServiceLog()),
+      mCachePriorities(false),
       mSupportsMultipleSecureCodecs(true),
       mSupportsSecureWithNonSecureCodec(true) {}
 
 ResourceManagerService::ResourceManagerService(sp<ProcessInfoInterface> processInfo)
     : mProcessInfo(processInfo),
       mServiceLog(new ServiceLog()),
+      mCachePriorities(false),
       mSupportsMultipleSecureCodecs(true),
       mSupportsSecureWithNonSecureCodec(true) {}
 
@@ -236,15 +239,33 @@ void ResourceManagerService::getClientForResource_l(
     }
 }
 
+// Enables the process priority cache for the lifetime of the object.
+class PriorityCacheScope {
+public:
+    PriorityCacheScope(bool *enabled, KeyedVector<int, int> *cache)
+        : mEnabled(enabled), mCache(cache) {
+        *mEnabled = true;
+    }
+    ~PriorityCacheScope() {
+        *mEnabled = false;
+        mCache->clear();
+    }
+private:
+    bool *mEnabled;
+    KeyedVector<int, int> *mCache;
+};
+
 bool ResourceManagerService::reclaimResource(
         int callingPid, const Vector<MediaResource> &resources) {
     String8 log = String8::format("reclaimResource(callingPid %d, resources %s)",
             callingPid, getString(resources).string());
     mServiceLog->add(log);
 
+    const nsecs_t startTime = systemTime(SYSTEM_TIME_MONOTONIC);
     Vector<sp<IResourceManagerClient>> clients;
     {
         Mutex::Autolock lock(mLock);
+        PriorityCacheScope priorityCacheScope(&mCachePriorities, &mPriorityCache);
         const MediaResource *secureCodec = NULL;
         const MediaResource *nonSecureCodec = NULL;
         const MediaResource *graphicMemory = NULL;
@@ -308,6 +329,7 @@ bool ResourceManagerService::reclaimResource(
         return false;
     }
 
+    const nsecs_t selectedTime = systemTime(SYSTEM_TIME_MONOTONIC);
     sp<IResourceManagerClient> failedClient;
     for (size_t i = 0; i < clients.size(); ++i) {
         log = String8::format("reclaimResource from client %p", clients[i].get());
@@ -317,6 +339,10 @@ bool ResourceManagerService::reclaimResource(
             break;
         }
     }
+    log = String8::format("reclaimResource took %lld us to select and %lld us to reclaim",
+            (long long) ns2us(selectedTime - startTime),
+            (long long) ns2us(systemTime(SYSTEM_TIME_MONOTONIC) - selectedTime));
+    mServiceLog->add(log);
 
     if (failedClient == NULL) {
         return true;
@@ -378,7 +404,7 @@ bool ResourceManagerService::getLowestPriorityBiggestClient_l(
     int lowestPriorityPid;
     int lowestPriority;
     int callingPriority;
-    if (!mProcessInfo->getPriority(callingPid, &callingPriority)) {
+    if (!getPriority_l(callingPid, &callingPriority)) {
         ALOGE("getLowestPriorityBiggestClient_l: can't get process priority for pid %d",
                 callingPid);
         return false;
@@ -413,7 +439,7 @@ bool ResourceManagerService::getLowestPriorityPid_l(
         }
         int tempPid = mMap.keyAt(i);
         int tempPriority;
-        if (!mProcessInfo->getPriority(tempPid, &tempPriority)) {
+        if (!getPriority_l(tempPid, &tempPriority)) {
             ALOGV("getLowestPriorityPid_l: can't get priority of pid %d, skipped", tempPid);
             // TODO: remove this pid from mMap?
             continue;
@@ -433,18 +459,34 @@ bool ResourceManagerService::getLowestPriorityPid_l(
 
 bool ResourceManagerService::isCallingPriorityHigher_l(int callingPid, int pid) {
     int callingPidPriority;
-    if (!mProcessInfo->getPriority(callingPid, &callingPidPriority)) {
+    if (!getPriority_l(callingPid, &callingPidPriority)) {
         return false;
     }
 
     int priority;
-    if (!mProcessInfo->getPriority(pid, &priority)) {
+    if (!getPriority_l(pid, &priority)) {
         return false;
     }
 
     return (callingPidPriority < priority);
 }
 
+bool ResourceManagerService::getPriority_l(int pid, int *priority) {
+    if (!mCachePriorities) {
+        return mProcessInfo->getPriority(pid, priority);
+    }
+    ssize_t index = mPriorityCache.indexOfKey(pid);
+    if (index >= 0) {
+        *priority = mPriorityCache.valueAt(index);
+        return true;
+    }
+    if (!mProcessInfo->getPriority(pid, priority)) {
+        return false;
+    }
+    mPriorityCache.add(pid, *priority);
+    return true;
+}
+
 bool ResourceManagerService::getBiggestClient_l(
         int pid, const String8 &type, sp<IResourceManagerClient> *client) {
     ssize_t index = mMap.indexOfKey(pid);
@@ -457,7 +499,7 @@ bool ResourceManagerService::getBiggestClient_l(
     uint64_t largestValue = 0;
     const ResourceInfos &infos = mMap.valueAt(index);
     for (size_t i = 0; i < infos.size(); ++i) {
-        Vector<MediaResource> resources = infos[i].resources;
+        const Vector<MediaResource> &resources = infos[i].resources;
         for (size_t j = 0; j < resources.size(); ++j) {
             if (resources[j].mType == type) {
                 if (resources[j].mValue > largestValue) {
@@ -98,6 +98,9 @@ private:
 
     bool isCallingPriorityHigher_l(int callingPid, int pid);
 
+    // Gets the priority of pid, from mPriorityCache while a reclaim pass is running.
+    bool getPriority_l(int pid, int *priority);
+
     // A helper function basically calls getLowestPriorityBiggestClient_l and add the result client
     // to the given Vector.
     void getClientForResource_l(
@@ -107,6 +110,10 @@ private:
     sp<ProcessInfoInterface> mProcessInfo;
     sp<ServiceLog> mServiceLog;
     PidResourceInfosMap mMap;
+    // Process priorities looked up during the current reclaimResource() pass. Each lookup is a
+    // binder call, and a pass may otherwise query the same pid once per client.
+    bool mCachePriorities;
+    KeyedVector<int, int> mPriorityCache;
     bool mSupportsMultipleSecureCodecs;
     bool mSupportsSecureWithNonSecureCodec;
 };
@@ -367,6 +367,11 @@ sp<IMemory> RadioService::CallbackThread::prepareEvent(radio_hal_event_t *halEve
     return eventMemory;
 }
 
+static int eventType(const sp<IMemory>& eventMemory)
+{
+    return ((struct radio_event *)eventMemory->pointer())->type;
+}
+
 void RadioService::CallbackThread::sendEvent(radio_hal_event_t *event)
  {
      sp<IMemory> eventMemory = prepareEvent(event);
@@ -375,7 +380,32 @@ void RadioService::CallbackThread::sendEvent(radio_hal_event_t *event)
      }
 
      AutoMutex lock(mCallbackLock);
-     mEventQueue.add(eventMemory);
+     size_t index = mEventQueue.size();
+     switch (event->type) {
+     case RADIO_EVENT_METADATA:
+     case RADIO_EVENT_TUNED:
+     case RADIO_EVENT_AF_SWITCH:
+         // metadata updates not delivered yet are superseded by the new metadata or program
+         for (size_t i = mEventQueue.size(); i > 0; i--) {
+             if (eventType(mEventQueue[i - 1]) == RADIO_EVENT_METADATA) {
+                 mEventQueue.removeAt(i - 1);
+             }
+         }
+         index = mEventQueue.size();
+         break;
+     case RADIO_EVENT_TA:
+     case RADIO_EVENT_ANTENNA:
+     case RADIO_EVENT_CONTROL:
+     case RADIO_EVENT_HW_FAILURE:
+         // state changes are delivered ahead of pending metadata updates
+         while (index > 0 && eventType(mEventQueue[index - 1]) == RADIO_EVENT_METADATA) {
+             index--;
+         }
+         break;
+     default:
+         break;
+     }
+     mEventQueue.insertAt(eventMemory, index);
      mCallbackCond.signal();
      ALOGV("%s DONE", __FUNCTION__);
 }
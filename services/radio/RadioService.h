@@ -123,7 +123,9 @@ public:
         wp<ModuleClient>      mModuleClient;    // client module the thread belongs to
         Condition             mCallbackCond;    // condition signaled when a new event is posted
         Mutex                 mCallbackLock;    // protects mEventQueue
-        Vector< sp<IMemory> > mEventQueue;      // pending callback events
+        Vector< sp<IMemory> > mEventQueue;      // pending callback events: pending metadata
+                                                // updates are coalesced and queued after
+                                                // state change events
         sp<MemoryDealer>      mMemoryDealer;    // shared memory for callback event
     }; // class CallbackThread
 
@@ -252,6 +252,10 @@ sp<IMemory> SoundTriggerHwService::prepareRecognitionEvent_l(
         return eventMemory;
     }
 
+    // The HAL only owns the event for the duration of the callback, so the event and its opaque
+    // data must be copied before being handed to the callback thread. The audio buffered after
+    // the key phrase is not part of it: it stays in the HAL and is read with an AudioRecord
+    // opened on the event's capture_session.
     size_t size = event->data_offset + event->data_size;
     eventMemory = mMemoryDealer->allocate(size);
     if (eventMemory == 0 || eventMemory->pointer() == NULL) {
@@ -15,3 +15,12 @@ LOCAL_MODULE := fir
 include $(BUILD_HOST_EXECUTABLE)
 
 
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+	fir_sweep.cpp
+
+LOCAL_MODULE := fir_sweep
+
+include $(BUILD_HOST_EXECUTABLE)
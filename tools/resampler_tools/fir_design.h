@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_RESAMPLER_TOOLS_FIR_DESIGN_H
+#define ANDROID_RESAMPLER_TOOLS_FIR_DESIGN_H
+
+#include <math.h>
+#include <stdint.h>
+
+// Kaiser windowed sinc helpers shared by fir and fir_sweep.
+
+static inline double sinc(double x) {
+    if (fabs(x) == 0.0f) return 1.0f;
+    return sin(x) / x;
+}
+
+static inline double sqr(double x) {
+    return x*x;
+}
+
+static inline int64_t toint(double x, int64_t maxval) {
+    int64_t v;
+
+    v = static_cast<int64_t>(floor(x * maxval + 0.5));
+    if (v >= maxval) {
+        return maxval - 1; // error!
+    }
+    return v;
+}
+
+static inline double I0(double x) {
+    // from the Numerical Recipes in C p. 237
+    double ax,ans,y;
+    ax=fabs(x);
+    if (ax < 3.75) {
+        y=x/3.75;
+        y*=y;
+        ans=1.0+y*(3.5156229+y*(3.0899424+y*(1.2067492
+                +y*(0.2659732+y*(0.360768e-1+y*0.45813e-2)))));
+    } else {
+        y=3.75/ax;
+        ans=(exp(ax)/sqrt(ax))*(0.39894228+y*(0.1328592e-1
+                +y*(0.225319e-2+y*(-0.157565e-2+y*(0.916281e-2
+                        +y*(-0.2057706e-1+y*(0.2635537e-1+y*(-0.1647633e-1
+                                +y*0.392377e-2))))))));
+    }
+    return ans;
+}
+
+static inline double kaiser(int k, int N, double beta) {
+    if (k < 0 || k > N)
+        return 0;
+    return I0(beta * sqrt(1.0 - sqr((2.0*k)/N - 1.0))) / I0(beta);
+}
+
+// Returns coefficient ix (0 <= ix <= N) of the right half of the interpolating filter,
+// as generated by fir for N = M * nzc coefficients on one side.
+static inline double firCoefficient(int ix, int N, int M, double Fcr, double beta) {
+    double x = (2.0 * M_PI * ix * Fcr) / M;
+    return kaiser(ix+N, 2*N, beta) * sinc(x) * 2.0 * Fcr;
+}
+
+#endif // ANDROID_RESAMPLER_TOOLS_FIR_DESIGN_H
@@ -0,0 +1,449 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// fir_sweep designs the interpolating filters generated by fir over a range of
+// zero-crossings, interpolation phases and kaiser betas, measures each design
+// and prints the Pareto-optimal ones for every requested stop-band attenuation.
+//
+// For each design it reports:
+//   stop    worst response above the stop-band edge, relative to DC
+//   ripple  peak-to-peak pass-band ripple
+//   interp  worst error of linearly interpolating coefficients between phases
+//   taps    multiply-accumulates per output frame and channel
+//   mem     size of the coefficient table
+//   ns      (with -t) time per output frame of a reference interpolating FIR,
+//           run on the machine the tool is built for
+//
+// Each result line ends with the fir command line generating its table.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "fir_design.h"
+
+struct Range {
+    double min;
+    double max;
+    double step;
+};
+
+struct Design {
+    int nzc;            // zero-crossings on one side
+    int lerpBits;       // log2 of the number of phases
+    double beta;        // kaiser window parameter
+
+    double stopDb;      // worst stop-band response, relative to DC (negative)
+    double rippleDb;    // peak-to-peak pass-band ripple
+    double interpDb;    // worst coefficient interpolation error, relative to peak (negative)
+    double attenDb;     // effective attenuation: min of the stop-band and interpolation floors
+    int taps;           // multiply-accumulates per output frame and channel
+    int memBytes;       // coefficient table size
+    double nsPerFrame;  // measured cost, 0 if not timed
+};
+
+static void usage(char* name) {
+    fprintf(stderr,
+            "usage: %s [-h] [-t] [-s sample_rate] [-c cut-off_frequency] [-P pass-band_edge]"
+            " [-S stop-band_edge] [-f {float|fixed|fixed16}] [-n min:max:step]"
+            " [-l min:max:step] [-b min:max:step] [-q dB,dB,...] [-r max_ripple_dB]\n"
+            "    -h    this help message\n"
+            "    -t    time a reference interpolating FIR for each Pareto-optimal design\n"
+            "    -s    sample rate (48000)\n"
+            "    -c    cut-off frequency (20478)\n"
+            "    -P    pass-band edge for the ripple measurement (2 * cut-off - sample_rate / 2)\n"
+            "    -S    stop-band edge for the attenuation measurement (sample_rate / 2)\n"
+            "    -f    coefficient format, can be fixed, fixed16, or float (fixed16)\n"
+            "    -n    range of zero-crossings on one side (4:32:2)\n"
+            "    -l    range of lerping bits, i.e. log2 of the number of phases (4:8:1)\n"
+            "    -b    range of kaiser window parameter beta (4:14:0.5)\n"
+            "    -q    stop-band attenuation required by each quality level (60,80,100,120)\n"
+            "    -r    maximum pass-band ripple in dB (0.1)\n",
+            name
+    );
+    exit(0);
+}
+
+static bool parseRange(const char* s, Range* range) {
+    int n = sscanf(s, "%lf:%lf:%lf", &range->min, &range->max, &range->step);
+    if (n == 1) {
+        range->max = range->min;
+        range->step = 1;
+        return true;
+    }
+    if (n == 2) {
+        range->step = 1;
+    }
+    return n >= 2 && range->step > 0 && range->max >= range->min;
+}
+
+static bool parseList(const char* s, std::vector<double>* list) {
+    list->clear();
+    while (*s) {
+        char* end;
+        double v = strtod(s, &end);
+        if (end == s) {
+            return false;
+        }
+        list->push_back(fabs(v));
+        s = *end == ',' ? end + 1 : end;
+    }
+    return !list->empty();
+}
+
+// In-place iterative radix-2 FFT, size must be a power of 2.
+static void fft(std::vector<double>& re, std::vector<double>& im) {
+    const size_t n = re.size();
+    for (size_t i = 1, j = 0; i < n; i++) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            std::swap(re[i], re[j]);
+            std::swap(im[i], im[j]);
+        }
+    }
+    for (size_t len = 2; len <= n; len <<= 1) {
+        double a = -2 * M_PI / len;
+        double wr = cos(a), wi = sin(a);
+        for (size_t i = 0; i < n; i += len) {
+            double cr = 1, ci = 0;
+            for (size_t k = 0; k < len / 2; k++) {
+                size_t p = i + k, q = p + len / 2;
+                double tr = re[q] * cr - im[q] * ci;
+                double ti = re[q] * ci + im[q] * cr;
+                re[q] = re[p] - tr;
+                im[q] = im[p] - ti;
+                re[p] += tr;
+                im[p] += ti;
+                double t = cr * wr - ci * wi;
+                ci = cr * wi + ci * wr;
+                cr = t;
+            }
+        }
+    }
+}
+
+static double quantize(double y, int nc) {
+    if (nc == 0) {
+        return y;
+    }
+    const int64_t maxval = 1LL << (nc - 1);
+    return double(toint(y, maxval)) / maxval;
+}
+
+// Generates the right half of the filter (N+1 coefficients) as fir would.
+static void generate(const Design& d, double Fcr, int nc, std::vector<double>* h) {
+    const int M = 1 << d.lerpBits;
+    const int N = M * d.nzc;
+    h->resize(N + 1);
+    for (int ix = 0; ix <= N; ix++) {
+        (*h)[ix] = quantize(firCoefficient(ix, N, M, Fcr, d.beta), nc);
+    }
+}
+
+static void measure(Design* d, double Fs, double Fcr, double Fp, double Fstop, int nc) {
+    const int M = 1 << d->lerpBits;
+    const int N = M * d->nzc;
+    std::vector<double> h;
+    generate(*d, Fcr, nc, &h);
+
+    // Response of the whole symmetric filter, running at M * Fs. Zero padding by
+    // at least 8x resolves the side lobes.
+    size_t L = 1;
+    while (L < 8 * size_t(2 * N + 1)) {
+        L <<= 1;
+    }
+    std::vector<double> re(L, 0.0), im(L, 0.0);
+    re[0] = h[0];
+    for (int k = 1; k <= N; k++) {
+        re[k] = h[k];
+        re[L - k] = h[k];
+    }
+    fft(re, im);
+
+    const double dc = fabs(re[0]);
+    const double binHz = M * Fs / L;
+    double passMin = HUGE_VAL, passMax = 0, stopMax = 0;
+    for (size_t i = 0; i <= L / 2; i++) {
+        double f = i * binHz;
+        double mag = sqrt(re[i] * re[i] + im[i] * im[i]) / dc;
+        if (f <= Fp) {
+            passMin = std::min(passMin, mag);
+            passMax = std::max(passMax, mag);
+        } else if (f >= Fstop) {
+            stopMax = std::max(stopMax, mag);
+        }
+    }
+    d->rippleDb = 20 * log10(passMax / passMin);
+    d->stopDb = 20 * log10(std::max(stopMax, 1e-12));
+
+    // Linear interpolation between phases, compared with the exact filter half way.
+    double peak = fabs(h[0]), interpErr = 0;
+    for (int ix = 0; ix < N; ix++) {
+        double exact = kaiser(2 * ix + 1 + 2 * N, 4 * N, d->beta)
+                * sinc(M_PI * (2 * ix + 1) * Fcr / M) * 2.0 * Fcr;
+        interpErr = std::max(interpErr, fabs(exact - 0.5 * (h[ix] + h[ix + 1])));
+    }
+    d->interpDb = 20 * log10(std::max(interpErr / peak, 1e-12));
+
+    d->attenDb = -std::max(d->stopDb, d->interpDb);
+    d->taps = 2 * d->nzc;
+    d->memBytes = (M + 1) * d->nzc * (nc == 0 ? 4 : nc / 8);
+    d->nsPerFrame = 0;
+}
+
+static int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Times a stereo float interpolating FIR with coefficient lerping, the structure used by
+// AudioResamplerSinc, converting 44.1 kHz to Fs. Returns the best ns per output frame.
+static double timeDesign(const Design& d, double Fs, double Fcr, int nc) {
+    const int M = 1 << d.lerpBits;
+    const int nzc = d.nzc;
+    std::vector<double> hd;
+    generate(d, Fcr, nc, &hd);
+    std::vector<float> h(hd.begin(), hd.end());
+
+    const int inFrames = 44100;
+    const int outFrames = int(inFrames * Fs / 44100);
+    std::vector<float> in(2 * (inFrames + 2 * nzc));
+    for (size_t i = 0; i < in.size(); i++) {
+        in[i] = float(sin(i * 0.01));
+    }
+    std::vector<float> out(2 * outFrames);
+    const uint32_t phaseInc = uint32_t((44100.0 / Fs) * (1LL << 32) / 2);  // Q31 step
+    const int fracBits = 31 - d.lerpBits;
+
+    double best = HUGE_VAL;
+    for (int trial = 0; trial < 3; trial++) {
+        int64_t start = nowNs();
+        uint64_t pos = 0;  // Q31 input position
+        for (int o = 0; o < outFrames; o++) {
+            const int idx = int(pos >> 31) + nzc;
+            const uint32_t phase = uint32_t(pos & 0x7fffffff);
+            const int l = phase >> fracBits;
+            const float frac = float(phase & ((1u << fracBits) - 1)) / (1u << fracBits);
+            float left = 0, right = 0;
+            // past samples use phase l, future samples the mirrored phase
+            for (int i = 0; i < nzc; i++) {
+                const int c = i * M + l;
+                const float cp = h[c] + (h[c + 1] - h[c]) * frac;
+                const int cm = i * M + (M - l);
+                const float cf = h[cm] - (h[cm] - h[cm - 1]) * frac;
+                left += cp * in[2 * (idx - i)] + cf * in[2 * (idx + 1 + i)];
+                right += cp * in[2 * (idx - i) + 1] + cf * in[2 * (idx + 1 + i) + 1];
+            }
+            out[2 * o] = left;
+            out[2 * o + 1] = right;
+            pos += phaseInc;
+        }
+        int64_t elapsed = nowNs() - start;
+        best = std::min(best, double(elapsed) / outFrames);
+    }
+    // keep the output live
+    volatile float sink = out[outFrames];
+    (void)sink;
+    return best;
+}
+
+// true if a is at least as good as b in every respect and better in one
+static bool dominates(const Design& a, const Design& b, bool timed) {
+    const double costA = timed ? a.nsPerFrame : a.taps;
+    const double costB = timed ? b.nsPerFrame : b.taps;
+    if (costA > costB || a.memBytes > b.memBytes || a.attenDb < b.attenDb) {
+        return false;
+    }
+    return costA < costB || a.memBytes < b.memBytes || a.attenDb > b.attenDb;
+}
+
+static bool byCost(const Design& a, const Design& b) {
+    if (a.taps != b.taps) return a.taps < b.taps;
+    if (a.memBytes != b.memBytes) return a.memBytes < b.memBytes;
+    return a.attenDb > b.attenDb;
+}
+
+int main(int argc, char** argv)
+{
+    double Fs = 48000;
+    double Fc = 20478;
+    double Fp = -1;
+    double Fstop = -1;
+    int nc = 16;        // coefficient bits, 0 for float
+    bool timing = false;
+    double maxRipple = 0.1;
+    Range nzcRange = { 4, 32, 2 };
+    Range lerpRange = { 4, 8, 1 };
+    Range betaRange = { 4, 14, 0.5 };
+    std::vector<double> levels;
+    levels.push_back(60);
+    levels.push_back(80);
+    levels.push_back(100);
+    levels.push_back(120);
+
+    int ch;
+    while ((ch = getopt(argc, argv, ":hts:c:P:S:f:n:l:b:q:r:")) != -1) {
+        switch (ch) {
+            case 't':
+                timing = true;
+                break;
+            case 's':
+                Fs = atof(optarg);
+                break;
+            case 'c':
+                Fc = atof(optarg);
+                break;
+            case 'P':
+                Fp = atof(optarg);
+                break;
+            case 'S':
+                Fstop = atof(optarg);
+                break;
+            case 'f':
+                if (!strcmp(optarg, "fixed")) {
+                    nc = 32;
+                }
+                else if (!strcmp(optarg, "fixed16")) {
+                    nc = 16;
+                }
+                else if (!strcmp(optarg, "float")) {
+                    nc = 0;
+                }
+                else {
+                    usage(argv[0]);
+                }
+                break;
+            case 'n':
+                if (!parseRange(optarg, &nzcRange)) usage(argv[0]);
+                break;
+            case 'l':
+                if (!parseRange(optarg, &lerpRange)) usage(argv[0]);
+                break;
+            case 'b':
+                if (!parseRange(optarg, &betaRange)) usage(argv[0]);
+                break;
+            case 'q':
+                if (!parseList(optarg, &levels)) usage(argv[0]);
+                break;
+            case 'r':
+                maxRipple = fabs(atof(optarg));
+                break;
+            case 'h':
+            default:
+                usage(argv[0]);
+                break;
+        }
+    }
+    // by default the transition band is centered on the cut-off and ends at Nyquist
+    if (Fp < 0) {
+        Fp = 2 * Fc - Fs / 2;
+    }
+    if (Fstop < 0) {
+        Fstop = Fs / 2;
+    }
+
+    // cut off frequency ratio Fc/Fs
+    const double Fcr = Fc / Fs;
+
+    std::vector<Design> designs;
+    for (double n = nzcRange.min; n <= nzcRange.max + 1e-9; n += nzcRange.step) {
+        for (double l = lerpRange.min; l <= lerpRange.max + 1e-9; l += lerpRange.step) {
+            for (double b = betaRange.min; b <= betaRange.max + 1e-9; b += betaRange.step) {
+                Design d;
+                d.nzc = int(n);
+                d.lerpBits = int(l);
+                d.beta = b;
+                if (d.nzc < 1 || d.lerpBits < 0 || d.lerpBits > 12) {
+                    continue;
+                }
+                measure(&d, Fs, Fcr, Fp, Fstop, nc);
+                if (d.rippleDb <= maxRipple) {
+                    designs.push_back(d);
+                }
+            }
+        }
+    }
+
+    printf("# fir_sweep:");
+    for (int i = 0; i < argc; i++) {
+        printf(" %s", argv[i]);
+    }
+    printf("\n# %zu designs within %.3g dB ripple, pass-band %.0f Hz, stop-band %.0f Hz\n",
+            designs.size(), maxRipple, Fp, Fstop);
+
+    std::sort(levels.begin(), levels.end());
+    for (size_t q = 0; q < levels.size(); q++) {
+        std::vector<Design> candidates;
+        for (size_t i = 0; i < designs.size(); i++) {
+            if (designs[i].attenDb >= levels[q]) {
+                candidates.push_back(designs[i]);
+            }
+        }
+        if (timing) {
+            // only time the designs that can still be Pareto-optimal by table size and taps
+            std::vector<Design> front;
+            for (size_t i = 0; i < candidates.size(); i++) {
+                bool dominated = false;
+                for (size_t j = 0; j < candidates.size() && !dominated; j++) {
+                    dominated = dominates(candidates[j], candidates[i], false);
+                }
+                if (!dominated) {
+                    front.push_back(candidates[i]);
+                    front.back().nsPerFrame = timeDesign(candidates[i], Fs, Fcr, nc);
+                }
+            }
+            candidates = front;
+        }
+
+        std::vector<Design> pareto;
+        for (size_t i = 0; i < candidates.size(); i++) {
+            bool dominated = false;
+            for (size_t j = 0; j < candidates.size() && !dominated; j++) {
+                dominated = dominates(candidates[j], candidates[i], timing);
+            }
+            if (!dominated) {
+                pareto.push_back(candidates[i]);
+            }
+        }
+        std::sort(pareto.begin(), pareto.end(), byCost);
+
+        printf("\n# quality level: %.0f dB, %zu Pareto-optimal designs\n",
+                levels[q], pareto.size());
+        for (size_t i = 0; i < pareto.size(); i++) {
+            const Design& d = pareto[i];
+            printf("taps=%-3d mem=%-7d stop=%.1f ripple=%.4f interp=%.1f",
+                    d.taps, d.memBytes, d.stopDb, d.rippleDb, d.interpDb);
+            if (timing) {
+                printf(" ns=%.1f", d.nsPerFrame);
+            }
+            printf("  : fir -s %.0f -c %.0f -n %d -l %d -b %.3f -f %s\n",
+                    Fs, Fc, d.nzc, d.lerpBits, d.beta,
+                    nc == 0 ? "float" : nc == 16 ? "fixed16" : "fixed");
+        }
+    }
+    return 0;
+}